@@ -0,0 +1,145 @@
+/*****************************************************************************
+ * File: compiler_bench.cpp
+ * Description: Throughput of each compiler phase on generated programs
+ *
+ * Each phase is timed alone on inputs prepared by the phases before it:
+ * tokens per second for the lexer, AST nodes per second for the parser,
+ * and the time to type-check, and to generate and optimize code at -O2.
+ * Every phase runs on four shapes of program, from generators.h.
+ *
+ * Google Benchmark writes the results as JSON with
+ *   tspp_bench --benchmark_out=results.json --benchmark_out_format=json
+ * or through the bench_json target, so runs can be compared over time.
+ *****************************************************************************/
+
+#include "codegen/codegen_options.h"
+#include "codegen/llvm/llvm_code_gen.h"
+#include "core/common/source_manager.h"
+#include "core/diagnostics/error_reporter.h"
+#include "generators.h"
+#include "lexer/lexer.h"
+#include "parser/parser.h"
+#include "parser/visitors/type_check_visitor/type_check_visitor.h"
+#include <benchmark/benchmark.h>
+#include <map>
+#include <memory>
+#include <utility>
+
+namespace {
+
+using Generator = std::string (*)(int);
+
+// Registers a generated program once, so that lexing it does not copy it
+core::FileId sourceFor(Generator generator, int scale) {
+  static std::map<std::pair<Generator, int>, core::FileId> sources;
+  auto [it, added] = sources.emplace(std::make_pair(generator, scale), 0);
+  if (added) {
+    it->second = core::SourceManager::instance().addFile(
+        "bench" + std::to_string(sources.size()) + ".tspp",
+        generator(scale));
+  }
+  return it->second;
+}
+
+// Lexes and parses a program outside the timed region
+std::unique_ptr<parser::Parser> parse(core::FileId source,
+                                      core::ErrorReporter &reporter) {
+  auto parser = std::make_unique<parser::Parser>(
+      lexer::Lexer(source).tokenize(), reporter);
+  return parser->parse(false) ? std::move(parser) : nullptr;
+}
+
+void lex(benchmark::State &state, Generator generator) {
+  core::FileId source = sourceFor(generator, static_cast<int>(state.range(0)));
+  size_t tokens = 0;
+  for (auto _ : state) {
+    auto result = lexer::Lexer(source).tokenize();
+    tokens = result.size();
+    benchmark::DoNotOptimize(result.data());
+  }
+  state.counters["tokens"] = static_cast<double>(tokens);
+  state.counters["tokens/s"] = benchmark::Counter(
+      static_cast<double>(tokens), benchmark::Counter::kIsIterationInvariantRate);
+  state.SetBytesProcessed(
+      static_cast<int64_t>(state.iterations()) *
+      static_cast<int64_t>(core::SourceManager::instance().getBuffer(source).size()));
+}
+
+void parseProgram(benchmark::State &state, Generator generator) {
+  core::FileId source = sourceFor(generator, static_cast<int>(state.range(0)));
+  auto tokens = lexer::Lexer(source).tokenize();
+  size_t nodes = 0;
+  for (auto _ : state) {
+    state.PauseTiming();
+    core::ErrorReporter reporter(false);
+    parser::Parser parser(tokens, reporter);
+    state.ResumeTiming();
+    if (!parser.parse(false)) {
+      state.SkipWithError("Generated program does not parse");
+      break;
+    }
+    nodes = parser.getAST().getContext().getNodeCount();
+  }
+  state.counters["nodes"] = static_cast<double>(nodes);
+  state.counters["nodes/s"] = benchmark::Counter(
+      static_cast<double>(nodes), benchmark::Counter::kIsIterationInvariantRate);
+}
+
+void typeCheck(benchmark::State &state, Generator generator) {
+  core::FileId source = sourceFor(generator, static_cast<int>(state.range(0)));
+  for (auto _ : state) {
+    state.PauseTiming();
+    core::ErrorReporter reporter(false);
+    auto parser = parse(source, reporter);
+    visitors::TypeScope scope;
+    state.ResumeTiming();
+    if (!parser ||
+        !visitors::TypeCheckVisitor(reporter, &scope).checkAST(parser->getAST()) ||
+        reporter.hasErrors()) {
+      state.SkipWithError("Generated program does not type-check");
+      break;
+    }
+  }
+}
+
+void generateCode(benchmark::State &state, Generator generator) {
+  core::FileId source = sourceFor(generator, static_cast<int>(state.range(0)));
+  codegen::CodeGenOptions options;
+  options.setOptimizationLevel(codegen::OptimizationLevel::O2);
+  for (auto _ : state) {
+    state.PauseTiming();
+    core::ErrorReporter reporter(false);
+    auto parser = parse(source, reporter);
+    visitors::TypeScope scope;
+    bool checked = parser && visitors::TypeCheckVisitor(reporter, &scope)
+                                 .checkAST(parser->getAST());
+    codegen::LLVMCodeGen codeGen(reporter);
+    codeGen.setOptions(options);
+    state.ResumeTiming();
+    if (!checked || !codeGen.generateCode(parser->getAST())) {
+      state.SkipWithError("Generated program does not compile");
+      break;
+    }
+  }
+}
+
+} // namespace
+
+// Scales give inputs of roughly 1k and 10k lines, or the equivalent depth
+#define TSPP_PHASE_BENCHMARKS(phase, unit)                                     \
+  BENCHMARK_CAPTURE(phase, functions, bench::generateFunctions)                \
+      ->Arg(150)->Arg(1500)->Unit(unit);                                       \
+  BENCHMARK_CAPTURE(phase, nested_expressions,                                 \
+                    bench::generateNestedExpressions)                          \
+      ->Arg(50)->Arg(200)->Unit(unit);                                         \
+  BENCHMARK_CAPTURE(phase, wide_classes, bench::generateWideClasses)           \
+      ->Arg(50)->Arg(500)->Unit(unit);                                         \
+  BENCHMARK_CAPTURE(phase, namespaces, bench::generateNamespaces)              \
+      ->Arg(125)->Arg(1250)->Unit(unit)
+
+TSPP_PHASE_BENCHMARKS(lex, benchmark::kMicrosecond);
+TSPP_PHASE_BENCHMARKS(parseProgram, benchmark::kMicrosecond);
+TSPP_PHASE_BENCHMARKS(typeCheck, benchmark::kMillisecond);
+TSPP_PHASE_BENCHMARKS(generateCode, benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,85 @@
+#include "generators.h"
+
+namespace bench {
+
+namespace {
+
+constexpr int kNestedFunctions = 20;
+constexpr int kWideClasses = 10;
+
+} // namespace
+
+std::string generateFunctions(int count) {
+  std::string source;
+  for (int i = 0; i < count; ++i) {
+    std::string n = std::to_string(i);
+    source += "function f" + n + "(a: int, b: int): int {\n"
+              "  let x: int = a * b + " + n + ";\n"
+              "  while (x > 100) {\n"
+              "    x = x - a;\n"
+              "  }\n";
+    // Each function calls the one before it, so calls resolve backwards
+    source += i == 0 ? "  return x;\n"
+                     : "  return x + f" + std::to_string(i - 1) + "(b, a);\n";
+    source += "}\n\n";
+  }
+  source += "function main(): int {\n  return f" + std::to_string(count - 1) +
+            "(1, 2) * 0;\n}\n";
+  return source;
+}
+
+std::string generateNestedExpressions(int depth) {
+  std::string source;
+  for (int f = 0; f < kNestedFunctions; ++f) {
+    // Alternating operators keep the tree from folding into a sum
+    std::string expression = "a";
+    for (int i = 0; i < depth; ++i) {
+      const char *op = i % 3 == 0 ? " + " : i % 3 == 1 ? " * " : " - ";
+      expression = "(" + expression + op + std::to_string(i % 7 + 1) + ")";
+    }
+    source += "function nested" + std::to_string(f) + "(a: int): int {\n"
+              "  return " + expression + ";\n}\n\n";
+  }
+  source += "function main(): int {\n  return nested0(1) * 0;\n}\n";
+  return source;
+}
+
+std::string generateWideClasses(int fields) {
+  std::string source;
+  for (int c = 0; c < kWideClasses; ++c) {
+    std::string name = "Wide" + std::to_string(c);
+    source += "class " + name + " {\n";
+    for (int f = 0; f < fields; ++f) {
+      source += "  let f" + std::to_string(f) + ": int;\n";
+    }
+    source += "}\n\nfunction sum" + name + "(w: " + name + "): int {\n"
+              "  let total: int = 0;\n";
+    for (int f = 0; f < fields; ++f) {
+      source += "  total = total + w.f" + std::to_string(f) + ";\n";
+    }
+    source += "  return total;\n}\n\n";
+  }
+  source += "function main(): int {\n"
+            "  let w: Wide0 = new Wide0();\n"
+            "  return sumWide0(w) * 0;\n}\n";
+  return source;
+}
+
+std::string generateNamespaces(int count) {
+  std::string source;
+  for (int i = 0; i < count; ++i) {
+    std::string n = std::to_string(i);
+    source += "namespace ns" + n + " {\n"
+              "  function first(a: int): int {\n"
+              "    return a + " + n + ";\n"
+              "  }\n"
+              "  function second(a: int): int {\n"
+              "    return first(a) * 2;\n"
+              "  }\n"
+              "}\n\n";
+  }
+  source += "function main(): int {\n  return 0;\n}\n";
+  return source;
+}
+
+} // namespace bench
@@ -0,0 +1,39 @@
+/*****************************************************************************
+ * File: generators.h
+ * Description: Synthetic TS++ programs for compiler throughput benchmarks
+ *
+ * Every generator returns a complete program that lexes, parses, type-checks
+ * and generates code without errors, so each phase can be measured alone
+ * on the same input. Sizes grow linearly with the scale argument.
+ *****************************************************************************/
+
+#pragma once
+#include <string>
+
+namespace bench {
+
+/**
+ * @brief Many small functions calling each other, about seven lines each
+ * @param count Number of functions
+ */
+std::string generateFunctions(int count);
+
+/**
+ * @brief Functions whose bodies are deeply nested arithmetic expressions
+ * @param depth Nesting depth of each expression
+ */
+std::string generateNestedExpressions(int depth);
+
+/**
+ * @brief Classes with many fields, each read by a function
+ * @param fields Number of fields of each of the ten classes
+ */
+std::string generateWideClasses(int fields);
+
+/**
+ * @brief Many namespaces, each declaring a few functions
+ * @param count Number of namespaces
+ */
+std::string generateNamespaces(int count);
+
+} // namespace bench
@@ -0,0 +1,244 @@
+/*****************************************************************************
+ * File: runtime_bench.cpp
+ * Description: Run time and code size of compiled benchmark programs
+ *
+ * Compiles every program of bench/programs at -O0, -O2 and -O3 with the
+ * tspp driver, links it against the runtime, and runs the executable a
+ * number of times. Each program checks its own result and exits with 0,
+ * so a miscompile fails the run instead of producing a fast number.
+ *
+ * Usage:
+ *   tspp_runbench [-runs=N] [-levels=0,2,3] [-out=results.json] [files...]
+ *
+ * Prints a table of the code size and the fastest and median run of each
+ * program at each level, and writes the same results as JSON with -out=.
+ *****************************************************************************/
+
+#include "codegen/llvm/llvm_target.h"
+#include "llvm/Object/ObjectFile.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Program.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Result {
+  std::string program;
+  int level;
+  uint64_t textBytes;
+  double minMillis;
+  double medianMillis;
+};
+
+// Compiles a program to an object file with the tspp driver
+bool compile(const std::string &source, int level, const std::string &object) {
+  std::string optimization = "-O" + std::to_string(level);
+  std::vector<llvm::StringRef> args = {TSPP_COMPILER, optimization, "-c",
+                                       source, "-o", object};
+  std::string error;
+  // The driver's own progress message is not part of the report
+  llvm::Optional<llvm::StringRef> redirects[] = {
+      llvm::None, llvm::StringRef(""), llvm::None};
+  int status = llvm::sys::ExecuteAndWait(TSPP_COMPILER, args, llvm::None,
+                                         redirects, 0, 0, &error);
+  if (status != 0) {
+    std::cerr << "Error: Failed to compile " << source << " at "
+              << optimization << (error.empty() ? "" : ": " + error) << "\n";
+    return false;
+  }
+  return true;
+}
+
+// Size of the executable sections of an object file, or 0 if unreadable
+uint64_t textSize(const std::string &object) {
+  auto file = llvm::object::ObjectFile::createObjectFile(object);
+  if (!file) {
+    llvm::consumeError(file.takeError());
+    return 0;
+  }
+  uint64_t size = 0;
+  for (const auto &section : file->getBinary()->sections()) {
+    if (section.isText()) {
+      size += section.getSize();
+    }
+  }
+  return size;
+}
+
+// Runs an executable, returning its wall time or a negative value on failure
+double runOnce(const std::string &executable) {
+  std::string error;
+  auto start = std::chrono::steady_clock::now();
+  int status = llvm::sys::ExecuteAndWait(executable, {executable}, llvm::None,
+                                         {}, 0, 0, &error);
+  auto end = std::chrono::steady_clock::now();
+  if (status != 0) {
+    std::cerr << "Error: " << executable << " exited with " << status
+              << (error.empty() ? "" : ": " + error) << "\n";
+    return -1;
+  }
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+bool writeJSON(const std::string &path, const std::vector<Result> &results,
+               int runs) {
+  std::error_code error;
+  llvm::raw_fd_ostream out(path, error);
+  if (error) {
+    std::cerr << "Error: Failed to open " << path << ": " << error.message()
+              << "\n";
+    return false;
+  }
+  llvm::json::OStream json(out, 2);
+  json.object([&] {
+    json.attribute("runs", runs);
+    json.attributeArray("results", [&] {
+      for (const auto &result : results) {
+        json.object([&] {
+          json.attribute("program", result.program);
+          json.attribute("level", "O" + std::to_string(result.level));
+          json.attribute("text_bytes", static_cast<int64_t>(result.textBytes));
+          json.attribute("min_ms", result.minMillis);
+          json.attribute("median_ms", result.medianMillis);
+        });
+      }
+    });
+  });
+  out << "\n";
+  return true;
+}
+
+// Parses a comma-separated list of optimization levels such as "0,2,3"
+bool parseLevels(llvm::StringRef text, std::vector<int> &levels) {
+  levels.clear();
+  llvm::SmallVector<llvm::StringRef, 4> parts;
+  text.split(parts, ',');
+  for (llvm::StringRef part : parts) {
+    unsigned level;
+    if (part.getAsInteger(10, level) || level > 3) {
+      return false;
+    }
+    levels.push_back(static_cast<int>(level));
+  }
+  return !levels.empty();
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  int runs = 5;
+  std::vector<int> levels = {0, 2, 3};
+  std::string outputFile;
+  std::vector<std::string> programs;
+
+  for (int i = 1; i < argc; ++i) {
+    llvm::StringRef arg = argv[i];
+    if (arg.consume_front("-runs=")) {
+      if (arg.getAsInteger(10, runs) || runs < 1) {
+        std::cerr << "Error: Invalid run count: " << arg.str() << "\n";
+        return 1;
+      }
+    } else if (arg.consume_front("-levels=")) {
+      if (!parseLevels(arg, levels)) {
+        std::cerr << "Error: Invalid optimization levels: " << arg.str()
+                  << "\n";
+        return 1;
+      }
+    } else if (arg.consume_front("-out=")) {
+      outputFile = arg.str();
+    } else {
+      programs.push_back(arg.str());
+    }
+  }
+
+  if (programs.empty()) {
+    std::error_code error;
+    for (llvm::sys::fs::directory_iterator it(TSPP_BENCH_PROGRAMS, error), end;
+         it != end && !error; it.increment(error)) {
+      if (llvm::sys::path::extension(it->path()) == ".tspp") {
+        programs.push_back(it->path());
+      }
+    }
+    std::sort(programs.begin(), programs.end());
+  }
+  if (programs.empty()) {
+    std::cerr << "Error: No benchmark programs in " << TSPP_BENCH_PROGRAMS
+              << "\n";
+    return 1;
+  }
+
+  llvm::SmallString<128> prefix, workDir;
+  llvm::sys::path::system_temp_directory(true, prefix);
+  llvm::sys::path::append(prefix, "tspp_runbench");
+  if (llvm::sys::fs::createUniqueDirectory(prefix, workDir)) {
+    std::cerr << "Error: Failed to create a temporary directory\n";
+    return 1;
+  }
+
+  std::cout << "Program              Level    Text (B)    Min (ms)  Median (ms)\n";
+  std::vector<Result> results;
+  bool failed = false;
+  for (const auto &source : programs) {
+    std::string name = llvm::sys::path::stem(source).str();
+    for (int level : levels) {
+      llvm::SmallString<128> base(workDir);
+      llvm::sys::path::append(base, name + ".O" + std::to_string(level));
+      std::string object = (base + ".o").str();
+      std::string executable = base.str().str();
+
+      codegen::LLVMTarget target;
+      if (!compile(source, level, object)) {
+        failed = true;
+        continue;
+      }
+      uint64_t textBytes = textSize(object);
+      codegen::CodeGenOptions linkOptions;
+      linkOptions.setPIC(false);
+      if (!target.linkExecutable({object}, executable, linkOptions)) {
+        std::cerr << "Error: " << target.getLastError() << "\n";
+        failed = true;
+        continue;
+      }
+
+      std::vector<double> times;
+      for (int run = 0; run < runs; ++run) {
+        double millis = runOnce(executable);
+        if (millis < 0) {
+          break;
+        }
+        times.push_back(millis);
+      }
+      llvm::sys::fs::remove(object);
+      llvm::sys::fs::remove(executable);
+      if (times.size() != static_cast<size_t>(runs)) {
+        failed = true;
+        continue;
+      }
+
+      std::sort(times.begin(), times.end());
+      Result result{name, level, textBytes, times.front(),
+                    times[times.size() / 2]};
+      results.push_back(result);
+      std::cout << std::left << std::setw(20) << name << " " << std::setw(5)
+                << ("O" + std::to_string(level)) << std::right << std::fixed
+                << std::setprecision(3) << std::setw(12) << result.textBytes
+                << std::setw(12) << result.minMillis << std::setw(13)
+                << result.medianMillis << "\n";
+    }
+  }
+  llvm::sys::fs::remove(workDir);
+
+  if (!outputFile.empty() && !writeJSON(outputFile, results, runs)) {
+    return 1;
+  }
+  return failed ? 1 : 0;
+}
@@ -1,4 +1,5 @@
 #include "codegen_options.h"
+#include <algorithm> // For min
 #include <cstdlib> // For getenv
 #include <sstream> // For stringstream
 #include <string>
@@ -6,11 +7,21 @@
 namespace codegen {
 
 CodeGenOptions::CodeGenOptions()
-    : optimizationLevel_(OptimizationLevel::O2), targetArch_(TargetArch::AUTO),
-      outputFormat_(OutputFormat::LLVM_IR), outputFilename_("output"),
-      moduleName_("tspp_module"), debugInfo_(false), pic_(true), simd_(true),
-      fastMath_(false), stackSize_(8 * 1024 * 1024) // 8 MB default stack size
+    : optimizationLevel_(OptimizationLevel::O2), ltoMode_(LTOMode::None),
+      targetArch_(TargetArch::AUTO), outputFormat_(OutputFormat::LLVM_IR),
+      outputFilename_("output"), moduleName_("tspp_module"),
+      debugInfo_(DebugInfoKind::None), pic_(true), simd_(true),
+      fastMath_(false), profileGenerate_(false), instrumentFunctions_(false),
+      instrumentLoops_(false), instrumentHooks_(false), allocProfile_(false),
+      defaultMain_(true),
+      stackSize_(8 * 1024 * 1024), // 8 MB default stack size
+      codeGenThreads_(1), optimizationLevelSet_(false), deadStrip_(true),
+      jitProfiling_(false)
 {
+#ifdef TSPP_RUNTIME_BITCODE
+  runtimeBitcode_ = TSPP_RUNTIME_BITCODE;
+#endif
+
   // Try to detect target architecture from environment
   detectTargetArch();
 
@@ -48,14 +59,45 @@ void CodeGenOptions::detectTargetArch() {
     }
   }
 
-  // Default to x86_64 if detection fails
-  targetArch_ = TargetArch::X86_64;
+  // Otherwise AUTO, which compiles for the host
+}
+
+void CodeGenOptions::setTargetArch(TargetArch arch) {
+  targetArch_ = arch;
+  if (arch == TargetArch::WASM) {
+    if (!optimizationLevelSet_) {
+      optimizationLevel_ = OptimizationLevel::Oz;
+    }
+    pic_ = false;
+  }
+  updateFileExtension();
+}
+
+void CodeGenOptions::setTargetTriple(const std::string &triple) {
+  targetTriple_ = triple;
+  std::string arch = triple.substr(0, triple.find('-'));
+  if (arch == "wasm32") {
+    setTargetArch(TargetArch::WASM);
+  } else if (arch == "x86_64" || arch == "amd64") {
+    setTargetArch(TargetArch::X86_64);
+  } else if (arch.size() == 4 && arch[0] == 'i' && arch.substr(2) == "86") {
+    setTargetArch(TargetArch::X86);
+  } else if (arch == "aarch64" || arch == "arm64") {
+    setTargetArch(TargetArch::AARCH64);
+  } else if (arch.compare(0, 3, "arm") == 0 ||
+             arch.compare(0, 5, "thumb") == 0) {
+    setTargetArch(TargetArch::ARM);
+  } else {
+    setTargetArch(TargetArch::AUTO);
+  }
 }
 
 void CodeGenOptions::updateFileExtension() {
-  // First remove any existing extension
+  // First remove any existing extension (dots in directories don't count)
   size_t dotPos = outputFilename_.find_last_of('.');
-  if (dotPos != std::string::npos) {
+  size_t slashPos = outputFilename_.find_last_of("/\\");
+  if (dotPos != std::string::npos &&
+      (slashPos == std::string::npos || dotPos > slashPos)) {
     outputFilename_ = outputFilename_.substr(0, dotPos);
   }
 
@@ -74,7 +116,12 @@ void CodeGenOptions::updateFileExtension() {
     outputFilename_ += ".o";
     break;
   case OutputFormat::EXECUTABLE:
-// No extension on Unix-like systems, .exe on Windows
+    // A linked WebAssembly module; no extension on Unix-like systems,
+    // .exe on Windows
+    if (targetArch_ == TargetArch::WASM) {
+      outputFilename_ += ".wasm";
+      break;
+    }
 #ifdef _WIN32
     outputFilename_ += ".exe";
 #endif
@@ -92,10 +139,21 @@ void CodeGenOptions::setOutputFilename(const std::string &filename) {
   updateFileExtension();
 }
 
+std::string CodeGenOptions::getRawProfilePath() const {
+  // The name clang's instrumented programs use, so the usual llvm-profdata
+  // merge of default_*.profraw works for both
+  if (profileDirectory_.empty()) {
+    return "default_%m.profraw";
+  }
+  return profileDirectory_ + "/default_%m.profraw";
+}
+
 std::string CodeGenOptions::optimizationLevelToString(OptimizationLevel level) {
   switch (level) {
   case OptimizationLevel::O0:
     return "O0";
+  case OptimizationLevel::Og:
+    return "Og";
   case OptimizationLevel::O1:
     return "O1";
   case OptimizationLevel::O2:
@@ -111,6 +169,40 @@ std::string CodeGenOptions::optimizationLevelToString(OptimizationLevel level) {
   }
 }
 
+DebugInfoKind CodeGenOptions::getDebugInfo() const {
+  if (debugInfo_ == DebugInfoKind::Full &&
+      optimizationLevel_ != OptimizationLevel::O0) {
+    return DebugInfoKind::LineTablesOnly;
+  }
+  return debugInfo_;
+}
+
+std::string CodeGenOptions::debugInfoKindToString(DebugInfoKind kind) {
+  switch (kind) {
+  case DebugInfoKind::None:
+    return "Disabled";
+  case DebugInfoKind::LineTablesOnly:
+    return "Line Tables";
+  case DebugInfoKind::Full:
+    return "Full";
+  default:
+    return "Unknown";
+  }
+}
+
+std::string CodeGenOptions::ltoModeToString(LTOMode mode) {
+  switch (mode) {
+  case LTOMode::None:
+    return "None";
+  case LTOMode::Thin:
+    return "Thin";
+  case LTOMode::Full:
+    return "Full";
+  default:
+    return "Unknown";
+  }
+}
+
 std::string CodeGenOptions::targetArchToString(TargetArch arch) {
   switch (arch) {
   case TargetArch::X86:
@@ -152,15 +244,36 @@ std::string CodeGenOptions::toString() const {
   ss << "Code Generation Options:\n";
   ss << "  Optimization Level: "
      << optimizationLevelToString(optimizationLevel_) << "\n";
+  ss << "  LTO: " << ltoModeToString(ltoMode_) << "\n";
   ss << "  Target Architecture: " << targetArchToString(targetArch_) << "\n";
+  ss << "  Target Triple: "
+     << (targetTriple_.empty() ? "default" : targetTriple_) << "\n";
+  ss << "  Target CPU: " << (targetCPU_.empty() ? "default" : targetCPU_)
+     << "\n";
+  ss << "  Target Features: "
+     << (targetFeatures_.empty() ? "default" : targetFeatures_) << "\n";
   ss << "  Output Format: " << outputFormatToString(outputFormat_) << "\n";
   ss << "  Output Filename: " << outputFilename_ << "\n";
   ss << "  Module Name: " << moduleName_ << "\n";
-  ss << "  Debug Info: " << (debugInfo_ ? "Enabled" : "Disabled") << "\n";
+  ss << "  Debug Info: " << debugInfoKindToString(getDebugInfo()) << "\n";
   ss << "  PIC: " << (pic_ ? "Enabled" : "Disabled") << "\n";
   ss << "  SIMD: " << (simd_ ? "Enabled" : "Disabled") << "\n";
   ss << "  Fast Math: " << (fastMath_ ? "Enabled" : "Disabled") << "\n";
+  ss << "  Profile Generate: "
+     << (profileGenerate_ ? getRawProfilePath() : "Disabled") << "\n";
+  ss << "  Profile Use: "
+     << (profileUseFile_.empty() ? "None" : profileUseFile_) << "\n";
+  ss << "  Runtime Bitcode: "
+     << (runtimeBitcode_.empty() ? "None" : runtimeBitcode_) << "\n";
+  ss << "  Instrument: " << (instrumentFunctions_ ? "functions " : "")
+     << (instrumentLoops_ ? "loops " : "")
+     << (instrumentHooks_ ? "hooks" : "") << "\n";
+  ss << "  Allocation Profile: " << (allocProfile_ ? "Enabled" : "Disabled")
+     << "\n";
+  ss << "  Default Main: " << (defaultMain_ ? "Enabled" : "Disabled") << "\n";
   ss << "  Stack Size: " << stackSize_ << " bytes\n";
+  ss << "  Codegen Threads: " << codeGenThreads_ << "\n";
+  ss << "  Dead Strip: " << (deadStrip_ ? "Enabled" : "Disabled") << "\n";
 
   if (!targetOptions_.empty()) {
     ss << "  Target Options:\n";
@@ -172,4 +285,162 @@ std::string CodeGenOptions::toString() const {
   return ss.str();
 }
 
+std::string CodeGenOptions::getCacheKey() const {
+  CodeGenOptions keyed = *this;
+  keyed.outputFilename_.clear();
+  return keyed.toString();
+}
+
+bool CodeGenOptions::parseFlag(const std::string &flag) {
+  // Optimization levels; an explicit one wins over a target's default
+  if (flag.size() == 3 && flag.compare(0, 2, "-O") == 0) {
+    optimizationLevelSet_ = true;
+  }
+  if (flag == "-O0") {
+    optimizationLevel_ = OptimizationLevel::O0;
+  } else if (flag == "-Og") {
+    optimizationLevel_ = OptimizationLevel::Og;
+  } else if (flag == "-O1") {
+    optimizationLevel_ = OptimizationLevel::O1;
+  } else if (flag == "-O2") {
+    optimizationLevel_ = OptimizationLevel::O2;
+  } else if (flag == "-O3") {
+    optimizationLevel_ = OptimizationLevel::O3;
+  } else if (flag == "-Os") {
+    optimizationLevel_ = OptimizationLevel::Os;
+  } else if (flag == "-Oz") {
+    optimizationLevel_ = OptimizationLevel::Oz;
+  }
+  // Link-time optimization pre-link pipelines
+  else if (flag == "-flto" || flag == "-flto=full") {
+    ltoMode_ = LTOMode::Full;
+  } else if (flag == "-flto=thin") {
+    ltoMode_ = LTOMode::Thin;
+  } else if (flag == "-fno-lto") {
+    ltoMode_ = LTOMode::None;
+  }
+  // Vectorization, including the hints on #simd loops
+  else if (flag == "-fsimd") {
+    simd_ = true;
+  } else if (flag == "-fno-simd") {
+    simd_ = false;
+  }
+  // Floating point may be reassociated, contracted and assume no NaNs
+  else if (flag == "-ffast-math") {
+    fastMath_ = true;
+  } else if (flag == "-fno-fast-math") {
+    fastMath_ = false;
+  }
+  // DWARF for debuggers and profilers
+  else if (flag == "-g") {
+    debugInfo_ = DebugInfoKind::Full;
+  } else if (flag == "-gline-tables-only") {
+    debugInfo_ = DebugInfoKind::LineTablesOnly;
+  } else if (flag == "-g0") {
+    debugInfo_ = DebugInfoKind::None;
+  }
+  // Profile-guided optimization: instrument, run, merge, then rebuild
+  else if (flag == "-fprofile-generate") {
+    setProfileGenerate("");
+  } else if (flag.compare(0, 19, "-fprofile-generate=") == 0) {
+    setProfileGenerate(flag.substr(19));
+  } else if (flag.compare(0, 14, "-fprofile-use=") == 0) {
+    setProfileUseFile(flag.substr(14));
+  } else if (flag == "-fno-profile-generate") {
+    profileGenerate_ = false;
+  } else if (flag == "-fno-profile-use") {
+    profileUseFile_.clear();
+  }
+  // The runtime's bitcode, for inlining its fast paths into the program
+  else if (flag.compare(0, 12, "-runtime-bc=") == 0) {
+    runtimeBitcode_ = flag.substr(12);
+  } else if (flag == "-fno-runtime-bc") {
+    runtimeBitcode_.clear();
+  }
+  // Counters for sampling without a PGO cycle: -instrument=functions,loops
+  else if (flag.compare(0, 12, "-instrument=") == 0 ||
+           flag.compare(0, 13, "--instrument=") == 0) {
+    std::string kinds = flag.substr(flag.find('=') + 1);
+    for (size_t start = 0; start <= kinds.size();) {
+      size_t comma = std::min(kinds.find(',', start), kinds.size());
+      std::string kind = kinds.substr(start, comma - start);
+      if (kind == "functions") {
+        instrumentFunctions_ = true;
+      } else if (kind == "loops") {
+        instrumentLoops_ = true;
+      } else if (kind == "none") {
+        instrumentFunctions_ = instrumentLoops_ = false;
+      } else {
+        return false;
+      }
+      start = comma + 1;
+    }
+  } else if (flag == "-finstrument-functions") {
+    instrumentHooks_ = true;
+  } else if (flag == "-fno-instrument-functions") {
+    instrumentHooks_ = false;
+  }
+  // Heap profile of new expressions, written as pprof
+  else if (flag == "-alloc-profile" || flag == "--alloc-profile") {
+    allocProfile_ = true;
+  } else if (flag == "-fno-alloc-profile") {
+    allocProfile_ = false;
+  }
+  // CPU to compile for; -mcpu=x86-64 builds for a whole fleet
+  else if (flag.compare(0, 6, "-mcpu=") == 0 ||
+           flag.compare(0, 6, "--cpu=") == 0) {
+    targetCPU_ = flag.substr(6) == "native" ? "" : flag.substr(6);
+  } else if (flag.compare(0, 7, "-mattr=") == 0) {
+    targetFeatures_ = flag.substr(7);
+  } else if (flag.compare(0, 11, "--features=") == 0) {
+    targetFeatures_ = flag.substr(11);
+  }
+  // Architecture or triple to compile for, e.g. -target=wasm32 for the
+  // browser or --target=aarch64-unknown-linux-gnu
+  else if (flag.compare(0, 8, "-target=") == 0 ||
+           flag.compare(0, 9, "--target=") == 0) {
+    std::string arch = flag.substr(flag.find('=') + 1);
+    targetTriple_.clear();
+    if (arch.find('-') != std::string::npos) {
+      setTargetTriple(arch);
+    } else if (arch == "wasm32" || arch == "wasm") {
+      setTargetArch(TargetArch::WASM);
+    } else if (arch == "x86_64" || arch == "x86-64") {
+      setTargetArch(TargetArch::X86_64);
+    } else if (arch == "x86" || arch == "i686") {
+      setTargetArch(TargetArch::X86);
+    } else if (arch == "aarch64" || arch == "arm64") {
+      setTargetArch(TargetArch::AARCH64);
+    } else if (arch == "arm") {
+      setTargetArch(TargetArch::ARM);
+    } else {
+      return false;
+    }
+  } else if (flag == "-fdead-strip") {
+    deadStrip_ = true;
+  } else if (flag == "-fno-dead-strip") {
+    deadStrip_ = false;
+  }
+  // Output formats
+  else if (flag == "-emit=ir" || flag == "-emit-llvm") {
+    setOutputFormat(OutputFormat::LLVM_IR);
+  } else if (flag == "-emit=bc") {
+    setOutputFormat(OutputFormat::LLVM_BC);
+  } else if (flag == "-emit=asm" || flag == "-S") {
+    setOutputFormat(OutputFormat::ASSEMBLY);
+  } else if (flag == "-emit=obj" || flag == "-c") {
+    setOutputFormat(OutputFormat::OBJECT);
+  } else if (flag == "-emit=exe") {
+    setOutputFormat(OutputFormat::EXECUTABLE);
+  }
+  // Parallel compilation, e.g. -j8, for the front end and code generation
+  else if (flag.size() > 2 && flag.compare(0, 2, "-j") == 0 &&
+           flag.find_first_not_of("0123456789", 2) == std::string::npos) {
+    setCodeGenThreads(static_cast<unsigned>(std::stoul(flag.substr(2))));
+  } else {
+    return false;
+  }
+  return true;
+}
+
 } // namespace codegen
\ No newline at end of file
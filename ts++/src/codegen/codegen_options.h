@@ -10,6 +10,7 @@ namespace codegen {
  */
 enum class OptimizationLevel {
   O0, // No optimization
+  Og, // Locals promoted to registers and cleaned up, nothing more
   O1, // Basic optimizations
   O2, // Moderate optimizations
   O3, // Aggressive optimizations
@@ -17,6 +18,26 @@ enum class OptimizationLevel {
   Oz  // Optimize for size aggressively
 };
 
+/**
+ * @enum LTOMode
+ * @brief Link-time optimization pre-link pipelines
+ */
+enum class LTOMode {
+  None, // Regular per-module pipeline
+  Thin, // ThinLTO pre-link pipeline
+  Full  // Full LTO pre-link pipeline
+};
+
+/**
+ * @enum DebugInfoKind
+ * @brief How much DWARF to emit
+ */
+enum class DebugInfoKind {
+  None,           // No debug information
+  LineTablesOnly, // Functions and line tables, enough for profilers
+  Full            // Also variables and their types; -O0 only
+};
+
 /**
  * @enum TargetArch
  * @brief Target architecture options
@@ -26,7 +47,7 @@ enum class TargetArch {
   X86_64,  // x86 64-bit
   ARM,     // ARM 32-bit
   AARCH64, // ARM 64-bit
-  WASM,    // WebAssembly
+  WASM,    // WebAssembly, wasm32
   AUTO     // Auto-detect host architecture
 };
 
@@ -70,11 +91,28 @@ public:
    */
   OptimizationLevel getOptimizationLevel() const { return optimizationLevel_; }
 
+  /**
+   * @brief Sets the link-time optimization mode
+   * @param mode The LTO mode
+   */
+  void setLTOMode(LTOMode mode) { ltoMode_ = mode; }
+
+  /**
+   * @brief Gets the link-time optimization mode
+   * @return The LTO mode
+   */
+  LTOMode getLTOMode() const { return ltoMode_; }
+
   /**
    * @brief Sets the target architecture
+   *
+   * WebAssembly modules are downloaded before they run, so unless a level
+   * was given with an -O flag they are optimized for size (-Oz), and they
+   * are never position independent.
+   *
    * @param arch The target architecture
    */
-  void setTargetArch(TargetArch arch) { targetArch_ = arch; }
+  void setTargetArch(TargetArch arch);
 
   /**
    * @brief Gets the target architecture
@@ -82,6 +120,89 @@ public:
    */
   TargetArch getTargetArch() const { return targetArch_; }
 
+  /**
+   * @brief Checks whether code is generated for WebAssembly
+   */
+  bool isWasm() const { return targetArch_ == TargetArch::WASM; }
+
+  /**
+   * @brief Enables or disables dead-function stripping
+   *
+   * Stripped wasm modules keep only their exports, the top-level
+   * functions, and what those reach; everything else is internalized and
+   * removed. A program with a main keeps only main external, and functions
+   * main never reaches are not generated at all.
+   *
+   * @param enable Whether to strip; on by default
+   */
+  void setDeadStrip(bool enable) { deadStrip_ = enable; }
+
+  /**
+   * @brief Checks if wasm modules are stripped of unreachable functions
+   * @return True when generating WebAssembly with stripping enabled
+   */
+  bool isDeadStripEnabled() const { return deadStrip_ && isWasm(); }
+
+  /**
+   * @brief Checks if a native program is generated from main alone
+   * @return True when stripping a module that has a main and no exports
+   */
+  bool isWholeProgram() const {
+    return deadStrip_ && defaultMain_ && !isWasm();
+  }
+
+  /**
+   * @brief Sets the CPU code is compiled for
+   *
+   * Empty selects the host CPU and its features when compiling for the
+   * host's architecture, and a generic CPU otherwise. A named CPU such as
+   * "x86-64" gives a baseline that #target versions can extend.
+   *
+   * @param cpu LLVM CPU name, or empty
+   */
+  void setTargetCPU(const std::string &cpu) { targetCPU_ = cpu; }
+
+  /**
+   * @brief Gets the CPU code is compiled for
+   * @return The CPU name, empty for the default
+   */
+  const std::string &getTargetCPU() const { return targetCPU_; }
+
+  /**
+   * @brief Sets the target triple, e.g. aarch64-unknown-linux-gnu
+   *
+   * The architecture follows from the triple. An empty triple compiles
+   * for the host, or for the host's OS on the architecture set with
+   * setTargetArch().
+   *
+   * @param triple LLVM target triple, or empty
+   */
+  void setTargetTriple(const std::string &triple);
+
+  /**
+   * @brief Gets the target triple
+   * @return The triple, empty for one derived from the architecture
+   */
+  const std::string &getTargetTriple() const { return targetTriple_; }
+
+  /**
+   * @brief Sets extra target features, e.g. "+avx2,-sse4.2"
+   *
+   * They are applied after the CPU's own features, or the host's when
+   * compiling for the host CPU.
+   *
+   * @param features Comma-separated LLVM features, each with + or -
+   */
+  void setTargetFeatures(const std::string &features) {
+    targetFeatures_ = features;
+  }
+
+  /**
+   * @brief Gets the extra target features
+   * @return The features, empty for none
+   */
+  const std::string &getTargetFeatures() const { return targetFeatures_; }
+
   /**
    * @brief Sets the output format
    * @param format The output format
@@ -107,16 +228,24 @@ public:
   const std::string &getOutputFilename() const { return outputFilename_; }
 
   /**
-   * @brief Enables or disables debug information
-   * @param enable Whether to enable debug information
+   * @brief Sets how much debug information to emit
+   * @param kind The debug information kind
+   */
+  void setDebugInfo(DebugInfoKind kind) { debugInfo_ = kind; }
+
+  /**
+   * @brief Gets the debug information to emit. Optimization moves and
+   * drops variables, so describing them is left to -O0; optimized code
+   * gets line tables only.
+   * @return The requested kind, lowered to line tables above -O0
    */
-  void setDebugInfo(bool enable) { debugInfo_ = enable; }
+  DebugInfoKind getDebugInfo() const;
 
   /**
    * @brief Checks if debug information is enabled
    * @return True if debug information is enabled
    */
-  bool isDebugInfoEnabled() const { return debugInfo_; }
+  bool isDebugInfoEnabled() const { return debugInfo_ != DebugInfoKind::None; }
 
   /**
    * @brief Enables or disables position-independent code
@@ -182,6 +311,123 @@ public:
    */
   bool isFastMathEnabled() const { return fastMath_; }
 
+  /**
+   * @brief Instruments the code to count how often each edge runs; the
+   * program writes the counts to a raw profile when it exits
+   * @param directory Where raw profiles go, empty for the working directory
+   */
+  void setProfileGenerate(const std::string &directory) {
+    profileGenerate_ = true;
+    profileDirectory_ = directory;
+    profileUseFile_.clear();
+  }
+
+  /**
+   * @brief Checks if the code is instrumented for profiling
+   * @return True if profile counters are inserted
+   */
+  bool isProfileGenerateEnabled() const { return profileGenerate_; }
+
+  /**
+   * @brief Gets the path pattern of the raw profiles instrumented code
+   * writes; %m stands for the module, so each module gets its own file
+   * @return The raw profile path
+   */
+  std::string getRawProfilePath() const;
+
+  /**
+   * @brief Optimizes with the counts of an indexed profile, as merged by
+   * llvm-profdata
+   * @param file The .profdata file
+   */
+  void setProfileUseFile(const std::string &file) {
+    profileUseFile_ = file;
+    profileGenerate_ = false;
+  }
+
+  /**
+   * @brief Gets the profile the optimizer reads
+   * @return The .profdata file, or empty if there is none
+   */
+  const std::string &getProfileUseFile() const { return profileUseFile_; }
+
+  /**
+   * @brief Links the runtime's bitcode into each optimized module, so its
+   * fast paths can be inlined into the program
+   * @param file The runtime .bc (or .ll) file; empty links nothing
+   */
+  void setRuntimeBitcode(const std::string &file) { runtimeBitcode_ = file; }
+
+  /**
+   * @brief Gets the runtime bitcode linked before optimization
+   * @return The bitcode file, or empty if the runtime stays external
+   */
+  const std::string &getRuntimeBitcode() const { return runtimeBitcode_; }
+
+  /**
+   * @brief Counts function entries in thread-local counters, which the
+   * program writes out with their source locations when it exits
+   * @param enable Whether to count entries
+   */
+  void setInstrumentFunctions(bool enable) { instrumentFunctions_ = enable; }
+
+  /**
+   * @brief Checks if function entries are counted
+   */
+  bool isInstrumentFunctionsEnabled() const { return instrumentFunctions_; }
+
+  /**
+   * @brief Counts loop iterations like function entries
+   * @param enable Whether to count iterations
+   */
+  void setInstrumentLoops(bool enable) { instrumentLoops_ = enable; }
+
+  /**
+   * @brief Checks if loop iterations are counted
+   */
+  bool isInstrumentLoopsEnabled() const { return instrumentLoops_; }
+
+  /**
+   * @brief Calls __cyg_profile_func_enter and __cyg_profile_func_exit,
+   * which an external profiler defines, around every function body
+   * @param enable Whether to call the hooks
+   */
+  void setInstrumentHooks(bool enable) { instrumentHooks_ = enable; }
+
+  /**
+   * @brief Checks if function bodies call the profiler hooks
+   */
+  bool isInstrumentHooksEnabled() const { return instrumentHooks_; }
+
+  /**
+   * @brief Records the site, size and lifetime of every object a new
+   * expression allocates; the program writes a pprof profile of them when
+   * it exits
+   * @param enable Whether to profile allocations
+   */
+  void setAllocProfile(bool enable) { allocProfile_ = enable; }
+
+  /**
+   * @brief Checks if new expressions are profiled
+   */
+  bool isAllocProfileEnabled() const { return allocProfile_; }
+
+  /**
+   * @brief Sets whether a program without main gets one
+   *
+   * The generated main runs the top-level statements. A library, whose
+   * functions are called from a program that has its own main, has none.
+   *
+   * @param enable Whether to generate a default main
+   */
+  void setDefaultMain(bool enable) { defaultMain_ = enable; }
+
+  /**
+   * @brief Checks if a program without main gets one
+   * @return True if a default main is generated
+   */
+  bool hasDefaultMain() const { return defaultMain_; }
+
   /**
    * @brief Sets the stack size for stack variables
    * @param size The stack size in bytes
@@ -194,12 +440,73 @@ public:
    */
   size_t getStackSize() const { return stackSize_; }
 
+  /**
+   * @brief Sets how many partitions are generated in parallel
+   * @param threads Number of code generation threads (1 = serial)
+   */
+  void setCodeGenThreads(unsigned threads) {
+    codeGenThreads_ = threads ? threads : 1;
+  }
+
+  /**
+   * @brief Gets the number of code generation threads
+   * @return The thread count, at least 1
+   */
+  unsigned getCodeGenThreads() const { return codeGenThreads_; }
+
+  /**
+   * @brief Sets where the JIT keeps compiled objects between runs
+   * @param directory The cache directory; empty compiles every run afresh
+   */
+  void setJITCacheDirectory(const std::string &directory) {
+    jitCacheDirectory_ = directory;
+  }
+
+  /**
+   * @brief Gets the JIT's object cache directory. It does not change the
+   * generated code, so it is not part of the cache key.
+   * @return The directory, or empty if objects are not cached
+   */
+  const std::string &getJITCacheDirectory() const {
+    return jitCacheDirectory_;
+  }
+
+  /**
+   * @brief Sets whether JITed functions are announced to profilers
+   * @param enable Whether to write a perf map and register the JIT listeners
+   */
+  void setJITProfiling(bool enable) { jitProfiling_ = enable; }
+
+  /**
+   * @brief Gets whether JITed functions are announced to profilers. Like
+   * the cache directory it does not change the generated code.
+   * @return True if profiling is enabled
+   */
+  bool getJITProfiling() const { return jitProfiling_; }
+
   /**
    * @brief Gets a string representation of the options
    * @return String representation
    */
   std::string toString() const;
 
+  /**
+   * @brief Gets every option that affects the generated code
+   *
+   * That is all of them but the output file name, so equal keys mean the
+   * same source compiles to the same output.
+   *
+   * @return The options as one string
+   */
+  std::string getCacheKey() const;
+
+  /**
+   * @brief Applies a command-line flag such as -O2, -emit=obj or -j4
+   * @param flag The flag, including its leading dash
+   * @return True if the flag was recognized
+   */
+  bool parseFlag(const std::string &flag);
+
 private:
   /**
    * @brief Detects the target architecture from environment
@@ -218,6 +525,15 @@ private:
    */
   static std::string optimizationLevelToString(OptimizationLevel level);
 
+  /**
+   * @brief Converts LTO mode to string
+   * @param mode The LTO mode
+   * @return String representation
+   */
+  static std::string ltoModeToString(LTOMode mode);
+
+  static std::string debugInfoKindToString(DebugInfoKind kind);
+
   /**
    * @brief Converts target architecture to string
    * @param arch The target architecture
@@ -233,16 +549,34 @@ private:
   static std::string outputFormatToString(OutputFormat format);
 
   OptimizationLevel optimizationLevel_;    // Optimization level
+  LTOMode ltoMode_;                        // LTO pre-link pipeline
   TargetArch targetArch_;                  // Target architecture
+  std::string targetCPU_;                  // -mcpu= CPU, empty for default
+  std::string targetTriple_;               // -target= triple, or empty
+  std::string targetFeatures_;             // -mattr= features, or empty
   OutputFormat outputFormat_;              // Output file format
   std::string outputFilename_;             // Output file path
   std::string moduleName_;                 // LLVM module name
   std::vector<std::string> targetOptions_; // Target-specific options
-  bool debugInfo_;                         // Whether to include debug info
+  DebugInfoKind debugInfo_;                // Debug info requested
   bool pic_;                               // Position-independent code
   bool simd_;                              // Enable SIMD optimizations
   bool fastMath_;                          // Enable fast math flags
+  bool profileGenerate_;                   // Insert profile counters
+  std::string profileDirectory_;           // Where raw profiles are written
+  std::string profileUseFile_;             // Indexed profile to optimize with
+  std::string runtimeBitcode_;             // Runtime linked in, or empty
+  bool instrumentFunctions_;               // Count function entries
+  bool instrumentLoops_;                   // Count loop iterations
+  bool instrumentHooks_;                   // Call __cyg_profile_func_*
+  bool allocProfile_;                      // Record new expression sites
+  bool defaultMain_;                       // Generate main if there is none
   size_t stackSize_;                       // Stack size for stack variables
+  unsigned codeGenThreads_;                // Parallel codegen partitions
+  bool optimizationLevelSet_;              // A level was given with -O
+  bool deadStrip_;                         // Strip code main or exports miss
+  std::string jitCacheDirectory_;          // JIT object cache, or empty
+  bool jitProfiling_;                      // Announce JITed code to profilers
 };
 
 } // namespace codegen
\ No newline at end of file
@@ -0,0 +1,322 @@
+#include "codegen/llvm/llvm_c_abi.h"
+#include "llvm/IR/Attributes.h"
+#include <algorithm>
+
+namespace codegen {
+
+namespace {
+
+bool isAggregate(llvm::Type *type) {
+  return type->isStructTy() || type->isArrayTy();
+}
+
+// Calls fn(scalar, offset) for each scalar in a value's layout
+template <typename Fn>
+void forEachScalar(const llvm::DataLayout &layout, llvm::Type *type,
+                   uint64_t offset, Fn &&fn) {
+  if (auto *structType = llvm::dyn_cast<llvm::StructType>(type)) {
+    const llvm::StructLayout *fields = layout.getStructLayout(structType);
+    for (unsigned i = 0; i < structType->getNumElements(); ++i) {
+      forEachScalar(layout, structType->getElementType(i),
+                    offset + fields->getElementOffset(i), fn);
+    }
+  } else if (auto *arrayType = llvm::dyn_cast<llvm::ArrayType>(type)) {
+    uint64_t stride = layout.getTypeAllocSize(arrayType->getElementType());
+    for (uint64_t i = 0; i < arrayType->getNumElements(); ++i) {
+      forEachScalar(layout, arrayType->getElementType(), offset + i * stride,
+                    fn);
+    }
+  } else {
+    fn(type, offset);
+  }
+}
+
+CABIValue indirect(bool byVal) {
+  CABIValue value;
+  value.kind = CABIValue::Kind::Indirect;
+  value.byVal = byVal;
+  return value;
+}
+
+CABIValue coerced(std::vector<llvm::Type *> parts) {
+  CABIValue value;
+  value.parts = std::move(parts);
+  return value;
+}
+
+} // namespace
+
+llvm::Type *CABIValue::getCoercedType(llvm::LLVMContext &context) const {
+  if (parts.size() == 1) {
+    return parts.front();
+  }
+  return llvm::StructType::get(context, parts);
+}
+
+llvm::AttributeList
+CABISignature::getAttributes(llvm::LLVMContext &context) const {
+  llvm::AttributeList attributes;
+  unsigned index = 0;
+  if (result.kind == CABIValue::Kind::Indirect) {
+    llvm::AttrBuilder sret(context);
+    sret.addStructRetAttr(resultType);
+    sret.addAttribute(llvm::Attribute::NoAlias);
+    attributes = attributes.addParamAttributes(context, index++, sret);
+  } else if (result.zeroExt) {
+    attributes = attributes.addRetAttribute(context, llvm::Attribute::ZExt);
+  }
+
+  for (size_t i = 0; i < params.size(); ++i) {
+    const CABIValue &param = params[i];
+    switch (param.kind) {
+    case CABIValue::Kind::Ignore:
+      break;
+    case CABIValue::Kind::Indirect:
+      if (param.byVal) {
+        attributes = attributes.addParamAttribute(
+            context, index,
+            llvm::Attribute::getWithByValType(context, paramTypes[i]));
+      }
+      ++index;
+      break;
+    case CABIValue::Kind::Direct:
+      if (param.zeroExt) {
+        attributes =
+            attributes.addParamAttribute(context, index, llvm::Attribute::ZExt);
+      }
+      index += param.parts.empty() ? 1 : param.parts.size();
+      break;
+    }
+  }
+  return attributes;
+}
+
+CABISignature CABILowering::lower(llvm::Type *resultType,
+                                  llvm::ArrayRef<llvm::Type *> paramTypes,
+                                  bool variadic) const {
+  CABISignature signature;
+  signature.resultType = resultType;
+  signature.paramTypes.assign(paramTypes.begin(), paramTypes.end());
+  RegisterBudget budget;
+
+  auto classify = [&](llvm::Type *type, bool isResult) {
+    if (type->isVoidTy() ||
+        (isAggregate(type) && layout_.getTypeAllocSize(type) == 0)) {
+      CABIValue ignored;
+      ignored.kind = CABIValue::Kind::Ignore;
+      return ignored;
+    }
+    if (triple_.getArch() == llvm::Triple::x86_64) {
+      return triple_.isOSWindows() ? classifyWin64(type)
+                                   : classifySysV(type, isResult, budget);
+    }
+    if (triple_.isAArch64()) {
+      return classifyAArch64(type, isResult);
+    }
+    return classifyDefault(type, isResult);
+  };
+
+  // sret takes the first integer register
+  signature.result = classify(resultType, true);
+  if (signature.result.kind == CABIValue::Kind::Indirect) {
+    --budget.integer;
+  }
+  for (llvm::Type *paramType : paramTypes) {
+    signature.params.push_back(classify(paramType, false));
+  }
+
+  llvm::LLVMContext &context = resultType->getContext();
+  llvm::Type *returnType = llvm::Type::getVoidTy(context);
+  std::vector<llvm::Type *> lowered;
+  if (signature.result.kind == CABIValue::Kind::Indirect) {
+    lowered.push_back(resultType->getPointerTo());
+  } else if (signature.result.kind == CABIValue::Kind::Direct) {
+    returnType = signature.result.parts.empty()
+                     ? resultType
+                     : signature.result.getCoercedType(context);
+  }
+  for (size_t i = 0; i < paramTypes.size(); ++i) {
+    const CABIValue &param = signature.params[i];
+    if (param.kind == CABIValue::Kind::Indirect) {
+      lowered.push_back(paramTypes[i]->getPointerTo());
+    } else if (param.kind == CABIValue::Kind::Direct) {
+      if (param.parts.empty()) {
+        lowered.push_back(paramTypes[i]);
+      } else {
+        lowered.insert(lowered.end(), param.parts.begin(), param.parts.end());
+      }
+    }
+  }
+  signature.type = llvm::FunctionType::get(returnType, lowered, variadic);
+  return signature;
+}
+
+llvm::Type *CABILowering::promoteVariadic(llvm::Type *type) {
+  if (type->isFloatTy()) {
+    return llvm::Type::getDoubleTy(type->getContext());
+  }
+  if (type->isIntegerTy() && type->getIntegerBitWidth() < 32) {
+    return llvm::Type::getInt32Ty(type->getContext());
+  }
+  return type;
+}
+
+CABIValue CABILowering::classifyScalar(llvm::Type *type) const {
+  CABIValue value;
+  value.zeroExt = type->isIntegerTy(1);
+  return value;
+}
+
+CABIValue CABILowering::classifySysV(llvm::Type *type, bool isResult,
+                                     RegisterBudget &budget) const {
+  if (!isAggregate(type)) {
+    unsigned &registers =
+        type->isFloatingPointTy() ? budget.sse : budget.integer;
+    if (!isResult && registers > 0) {
+      --registers;
+    }
+    return classifyScalar(type);
+  }
+
+  uint64_t size = layout_.getTypeAllocSize(type);
+  if (size > 16) {
+    return indirect(!isResult);
+  }
+
+  // Each eightbyte is SSE if it holds only floats, and integer otherwise;
+  // a field that is not naturally aligned puts the class in memory
+  enum class Class { None, Integer, SSE };
+  Class classes[2] = {Class::None, Class::None};
+  bool startsWithDouble[2] = {false, false};
+  bool inMemory = false;
+  forEachScalar(layout_, type, 0, [&](llvm::Type *scalar, uint64_t offset) {
+    if (scalar->isVectorTy() ||
+        offset % layout_.getABITypeAlign(scalar).value() != 0) {
+      inMemory = true;
+      return;
+    }
+    Class found = scalar->isFloatingPointTy() ? Class::SSE : Class::Integer;
+    Class &merged = classes[offset / 8];
+    merged = merged == Class::None || merged == found ? found : Class::Integer;
+    if (offset % 8 == 0 && scalar->isDoubleTy()) {
+      startsWithDouble[offset / 8] = true;
+    }
+  });
+  if (inMemory) {
+    return indirect(!isResult);
+  }
+
+  unsigned eightbytes = size > 8 ? 2 : 1;
+  unsigned integers = 0, sses = 0;
+  for (unsigned i = 0; i < eightbytes; ++i) {
+    (classes[i] == Class::SSE ? sses : integers)++;
+  }
+  if (!isResult) {
+    // C passes all of it in registers or all of it on the stack
+    if (integers > budget.integer || sses > budget.sse) {
+      return indirect(true);
+    }
+    budget.integer -= integers;
+    budget.sse -= sses;
+  }
+
+  llvm::LLVMContext &context = type->getContext();
+  std::vector<llvm::Type *> parts;
+  for (unsigned i = 0; i < eightbytes; ++i) {
+    uint64_t bytes = std::min<uint64_t>(8, size - i * 8);
+    if (classes[i] != Class::SSE) {
+      parts.push_back(llvm::IntegerType::get(context, bytes * 8));
+    } else if (startsWithDouble[i]) {
+      parts.push_back(llvm::Type::getDoubleTy(context));
+    } else if (bytes > 4) {
+      parts.push_back(
+          llvm::FixedVectorType::get(llvm::Type::getFloatTy(context), 2));
+    } else {
+      parts.push_back(llvm::Type::getFloatTy(context));
+    }
+  }
+  return coerced(std::move(parts));
+}
+
+CABIValue CABILowering::classifyWin64(llvm::Type *type) const {
+  if (!isAggregate(type)) {
+    return classifyScalar(type);
+  }
+  uint64_t size = layout_.getTypeAllocSize(type);
+  if (size == 1 || size == 2 || size == 4 || size == 8) {
+    return coerced({llvm::IntegerType::get(type->getContext(), size * 8)});
+  }
+  return indirect(false);
+}
+
+CABIValue CABILowering::classifyAArch64(llvm::Type *type,
+                                        bool isResult) const {
+  if (!isAggregate(type)) {
+    return classifyScalar(type);
+  }
+
+  // Homogeneous float aggregates travel in consecutive float registers
+  llvm::LLVMContext &context = type->getContext();
+  unsigned count = 0;
+  if (llvm::Type *member = getHomogeneousFloat(type, count)) {
+    if (isResult) {
+      return coerced(std::vector<llvm::Type *>(count, member));
+    }
+    return coerced({llvm::ArrayType::get(member, count)});
+  }
+
+  uint64_t size = layout_.getTypeAllocSize(type);
+  if (size > 16) {
+    return indirect(false);
+  }
+  llvm::Type *word = llvm::Type::getInt64Ty(context);
+  if (size <= 8) {
+    return coerced({word});
+  }
+  if (layout_.getABITypeAlign(type).value() == 16) {
+    return coerced({llvm::Type::getInt128Ty(context)});
+  }
+  return coerced({llvm::ArrayType::get(word, 2)});
+}
+
+CABIValue CABILowering::classifyDefault(llvm::Type *type,
+                                        bool isResult) const {
+  if (!isAggregate(type)) {
+    return classifyScalar(type);
+  }
+
+  // A class of one scalar is that scalar
+  llvm::Type *only = nullptr;
+  unsigned scalars = 0;
+  forEachScalar(layout_, type, 0, [&](llvm::Type *scalar, uint64_t) {
+    only = scalar;
+    ++scalars;
+  });
+  if (scalars == 1 &&
+      layout_.getTypeAllocSize(only) == layout_.getTypeAllocSize(type)) {
+    CABIValue value = coerced({only});
+    value.zeroExt = only->isIntegerTy(1);
+    return value;
+  }
+  return indirect(!isResult);
+}
+
+llvm::Type *CABILowering::getHomogeneousFloat(llvm::Type *type,
+                                              unsigned &count) const {
+  llvm::Type *member = nullptr;
+  bool homogeneous = true;
+  count = 0;
+  forEachScalar(layout_, type, 0, [&](llvm::Type *scalar, uint64_t) {
+    homogeneous &= scalar->isFloatingPointTy() && (!member || member == scalar);
+    member = scalar;
+    ++count;
+  });
+  if (!homogeneous || count == 0 || count > 4 ||
+      layout_.getTypeAllocSize(type) !=
+          count * layout_.getTypeAllocSize(member)) {
+    return nullptr;
+  }
+  return member;
+}
+
+} // namespace codegen
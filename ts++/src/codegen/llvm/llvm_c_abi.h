@@ -0,0 +1,125 @@
+/*****************************************************************************
+ * File: llvm_c_abi.h
+ * Description: Lowering of extern "C" signatures to the target's C ABI
+ *****************************************************************************/
+
+#pragma once
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/Triple.h"
+#include "llvm/IR/Attributes.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/DerivedTypes.h"
+#include <vector>
+
+namespace codegen {
+
+/**
+ * @brief How one parameter, or the result, crosses a call to C
+ */
+struct CABIValue {
+  enum class Kind {
+    Direct,   ///< In registers, as the value itself or as its parts
+    Indirect, ///< By the address of a copy; a result through sret
+    Ignore    ///< void, or a class without fields
+  };
+  Kind kind = Kind::Direct;
+
+  /// The values passed in place of a Direct one, loaded from its bytes in
+  /// order; empty when it passes as it is
+  std::vector<llvm::Type *> parts;
+
+  bool byVal = false;   ///< Indirect: the copy is made in the callee's frame
+  bool zeroExt = false; ///< Direct: a bool, which C expects widened
+
+  /**
+   * @brief Gets the type whose layout the parts follow: the only part, or
+   * a literal struct of them
+   */
+  llvm::Type *getCoercedType(llvm::LLVMContext &context) const;
+};
+
+/**
+ * @brief A C function's signature, lowered for one target
+ */
+struct CABISignature {
+  llvm::FunctionType *type = nullptr;   ///< Of the declaration and calls
+  llvm::Type *resultType = nullptr;     ///< The tspp result, or void
+  std::vector<llvm::Type *> paramTypes; ///< The tspp parameters
+  CABIValue result;
+  std::vector<CABIValue> params;
+
+  /**
+   * @brief Gets the sret, byval and zeroext attributes that the
+   * declaration and each call carry
+   */
+  llvm::AttributeList getAttributes(llvm::LLVMContext &context) const;
+};
+
+/**
+ * @class CABILowering
+ * @brief Lays out calls to C the way the target's C compiler does
+ *
+ * tspp values are already C's: int is int, float is float, bool is _Bool,
+ * T@ is a pointer, and a class value is a struct with the same fields.
+ * What differs by target is how aggregates travel, so each parameter and
+ * the result are classified once per declaration:
+ *
+ * - x86-64 System V: a class of up to 16 bytes is split into eightbytes,
+ *   passed in integer or SSE registers by what they hold, unless the
+ *   registers left cannot take all of it; larger ones are copied to the
+ *   stack (byval) or returned through sret.
+ * - Windows x64: classes of 1, 2, 4 or 8 bytes pass as an integer, others
+ *   by the address of a copy.
+ * - AArch64: a homogeneous float aggregate of up to four members passes
+ *   in float registers; other classes of up to 16 bytes as one or two
+ *   integer registers, and larger ones by the address of a copy.
+ * - Other targets, WebAssembly among them: a class with a single scalar
+ *   passes as that scalar, others by byval copy and sret.
+ *
+ * A call then moves each class between its parts through a stack slot,
+ * which the optimizer turns back into register moves.
+ */
+class CABILowering {
+public:
+  CABILowering(const llvm::Triple &triple, const llvm::DataLayout &layout)
+      : triple_(triple), layout_(layout) {}
+
+  /**
+   * @brief Lowers a signature
+   * @param resultType The tspp result, void for none
+   * @param paramTypes The tspp parameters, all sized
+   * @param variadic Whether more arguments may follow the parameters
+   */
+  CABISignature lower(llvm::Type *resultType,
+                      llvm::ArrayRef<llvm::Type *> paramTypes,
+                      bool variadic) const;
+
+  /**
+   * @brief Gets the type C's default argument promotions give a variadic
+   * argument: double for float and int for bool
+   */
+  static llvm::Type *promoteVariadic(llvm::Type *type);
+
+private:
+  // Registers left for the parameters of an x86-64 System V call
+  struct RegisterBudget {
+    unsigned integer = 6;
+    unsigned sse = 8;
+  };
+
+  CABIValue classifyScalar(llvm::Type *type) const;
+  CABIValue classifySysV(llvm::Type *type, bool isResult,
+                         RegisterBudget &budget) const;
+  CABIValue classifyWin64(llvm::Type *type) const;
+  CABIValue classifyAArch64(llvm::Type *type, bool isResult) const;
+  CABIValue classifyDefault(llvm::Type *type, bool isResult) const;
+
+  // The float type and member count of a homogeneous float aggregate of
+  // up to four members, or nullptr
+  llvm::Type *getHomogeneousFloat(llvm::Type *type, unsigned &count) const;
+
+  const llvm::Triple &triple_;
+  const llvm::DataLayout &layout_;
+};
+
+} // namespace codegen
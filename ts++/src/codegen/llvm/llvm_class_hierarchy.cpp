@@ -0,0 +1,304 @@
+#include "codegen/llvm/llvm_class_hierarchy.h"
+#include "parser/nodes/type_nodes.h"
+#include <algorithm>
+
+namespace codegen {
+
+namespace {
+
+bool hasModifier(const nodes::MethodDeclNode *method, tokens::TokenType type) {
+  const auto &modifiers = method->getModifiers();
+  return std::find(modifiers.begin(), modifiers.end(), type) !=
+         modifiers.end();
+}
+
+} // namespace
+
+void LLVMClassHierarchy::clear() {
+  classList_.clear();
+  interfaceList_.clear();
+  classes_.clear();
+  interfaces_.clear();
+  ordered_.clear();
+}
+
+void LLVMClassHierarchy::registerClass(const nodes::ClassDeclNode *decl) {
+  auto info = std::make_unique<ClassInfo>();
+  info->decl = decl;
+  for (const auto &member : decl->getMembers()) {
+    if (auto method = nodes::dyn_cast<nodes::MethodDeclNode>(member)) {
+      info->methods[method->getName()] = method;
+    }
+  }
+  classes_[decl->getName()] = info.get();
+  classList_.push_back(std::move(info));
+}
+
+void LLVMClassHierarchy::registerInterface(
+    const nodes::InterfaceDeclNode *decl) {
+  auto info = std::make_unique<InterfaceInfo>();
+  info->decl = decl;
+  interfaces_[decl->getName()] = info.get();
+  interfaceList_.push_back(std::move(info));
+}
+
+bool LLVMClassHierarchy::build(std::string &message) {
+  ordered_.clear();
+
+  for (const auto &iface : interfaceList_) {
+    iface->extended.clear();
+    for (const auto &type : iface->decl->getExtendedInterfaces()) {
+      auto it = interfaces_.find(typeName(type));
+      if (it == interfaces_.end()) {
+        message = "Interface '" + iface->getName() +
+                  "' extends an unknown interface";
+        return false;
+      }
+      iface->extended.push_back(it->second);
+    }
+  }
+  for (const auto &iface : interfaceList_) {
+    std::vector<InterfaceInfo *> stack;
+    if (!numberSlots(iface.get(), stack)) {
+      message = "Interface '" + iface->getName() + "' extends itself";
+      return false;
+    }
+  }
+
+  for (const auto &cls : classList_) {
+    cls->base = nullptr;
+    cls->derived.clear();
+    cls->interfaces.clear();
+  }
+  for (const auto &cls : classList_) {
+    if (const auto *baseType = cls->decl->getBaseClass()) {
+      auto it = classes_.find(typeName(baseType));
+      if (it == classes_.end()) {
+        message = "Class '" + cls->getName() + "' extends an unknown class";
+        return false;
+      }
+      cls->base = it->second;
+      it->second->derived.push_back(cls.get());
+    }
+    for (const auto &type : cls->decl->getInterfaces()) {
+      auto it = interfaces_.find(typeName(type));
+      if (it == interfaces_.end()) {
+        message = "Class '" + cls->getName() +
+                  "' implements an unknown interface";
+        return false;
+      }
+      cls->interfaces.push_back(it->second);
+    }
+  }
+
+  // Roots first; a class that is not reached extends itself
+  std::vector<ClassInfo *> sorted;
+  for (const auto &cls : classList_) {
+    if (!cls->base) {
+      order(cls.get(), sorted);
+    }
+  }
+  if (sorted.size() != classList_.size()) {
+    message = "Class hierarchy contains a cycle";
+    return false;
+  }
+
+  // Slots are inherited in order, so a base's slot means the same method
+  // in every class derived from it
+  for (ClassInfo *cls : sorted) {
+    cls->slots = cls->base ? cls->base->slots : std::vector<std::string>();
+    for (const auto &member : cls->decl->getMembers()) {
+      auto method = nodes::dyn_cast<nodes::MethodDeclNode>(member);
+      if (!method || std::find(cls->slots.begin(), cls->slots.end(),
+                               method->getName()) != cls->slots.end()) {
+        continue;
+      }
+      if (hasModifier(method, tokens::TokenType::VIRTUAL) ||
+          hasModifier(method, tokens::TokenType::ABSTRACT)) {
+        cls->slots.push_back(method->getName());
+      }
+    }
+  }
+
+  // One vtable pointer at the start of the root serves the whole hierarchy,
+  // so upcasts never move the object pointer
+  for (ClassInfo *cls : sorted) {
+    cls->hasVptr = false;
+  }
+  for (ClassInfo *cls : sorted) {
+    const ClassInfo *root = cls;
+    while (root->base) {
+      root = root->base;
+    }
+    if (!cls->slots.empty()) {
+      for (ClassInfo *member : sorted) {
+        if (derivesFrom(member, root)) {
+          member->hasVptr = true;
+        }
+      }
+    }
+  }
+
+  ordered_.assign(sorted.begin(), sorted.end());
+  return true;
+}
+
+const LLVMClassHierarchy::ClassInfo *
+LLVMClassHierarchy::getClass(const std::string &name) const {
+  auto it = classes_.find(name);
+  return it == classes_.end() ? nullptr : it->second;
+}
+
+const LLVMClassHierarchy::InterfaceInfo *
+LLVMClassHierarchy::getInterface(const std::string &name) const {
+  auto it = interfaces_.find(name);
+  return it == interfaces_.end() ? nullptr : it->second;
+}
+
+LLVMClassHierarchy::Resolution
+LLVMClassHierarchy::resolve(const ClassInfo *cls,
+                            const std::string &name) const {
+  for (; cls; cls = cls->base) {
+    auto it = cls->methods.find(name);
+    if (it != cls->methods.end()) {
+      return {cls, it->second};
+    }
+  }
+  return {};
+}
+
+int LLVMClassHierarchy::getSlot(const ClassInfo *cls,
+                                const std::string &name) const {
+  auto it = std::find(cls->slots.begin(), cls->slots.end(), name);
+  return it == cls->slots.end() ? -1
+                                : static_cast<int>(it - cls->slots.begin());
+}
+
+int LLVMClassHierarchy::getSlot(const InterfaceInfo *iface,
+                                const std::string &name) const {
+  for (size_t i = 0; i < iface->slots.size(); ++i) {
+    if (iface->slots[i]->getName() == name) {
+      return static_cast<int>(i);
+    }
+  }
+  return -1;
+}
+
+LLVMClassHierarchy::Resolution
+LLVMClassHierarchy::uniqueImplementation(const ClassInfo *cls,
+                                         const std::string &name) const {
+  Resolution unique = resolve(cls, name);
+  std::vector<const ClassInfo *> pending(cls->derived.begin(),
+                                         cls->derived.end());
+  while (unique && !pending.empty()) {
+    const ClassInfo *current = pending.back();
+    pending.pop_back();
+    if (!(resolve(current, name) == unique)) {
+      return {};
+    }
+    pending.insert(pending.end(), current->derived.begin(),
+                   current->derived.end());
+  }
+  return unique;
+}
+
+LLVMClassHierarchy::Resolution
+LLVMClassHierarchy::uniqueImplementation(const InterfaceInfo *iface,
+                                         const std::string &name) const {
+  Resolution unique;
+  for (const ClassInfo *cls : ordered_) {
+    if (!implements(cls, iface)) {
+      continue;
+    }
+    Resolution found = resolve(cls, name);
+    if (!found || (unique && !(found == unique))) {
+      return {};
+    }
+    unique = found;
+  }
+  return unique;
+}
+
+bool LLVMClassHierarchy::derivesFrom(const ClassInfo *cls,
+                                     const ClassInfo *base) {
+  for (; cls; cls = cls->base) {
+    if (cls == base) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool LLVMClassHierarchy::implements(const ClassInfo *cls,
+                                    const InterfaceInfo *iface) {
+  for (; cls; cls = cls->base) {
+    for (const InterfaceInfo *listed : cls->interfaces) {
+      if (extends(listed, iface)) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+bool LLVMClassHierarchy::extends(const InterfaceInfo *iface,
+                                 const InterfaceInfo *base) {
+  if (iface == base) {
+    return true;
+  }
+  for (const InterfaceInfo *extended : iface->extended) {
+    if (extends(extended, base)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+std::string LLVMClassHierarchy::typeName(const nodes::TypeNode *type) {
+  auto named = nodes::dyn_cast<nodes::NamedTypeNode>(type);
+  return named ? named->getName() : std::string();
+}
+
+bool LLVMClassHierarchy::numberSlots(InterfaceInfo *iface,
+                                     std::vector<InterfaceInfo *> &stack) {
+  if (std::find(stack.begin(), stack.end(), iface) != stack.end()) {
+    return false;
+  }
+  stack.push_back(iface);
+
+  iface->slots.clear();
+  auto add = [iface](const nodes::MethodSignatureNode *method) {
+    for (const auto *slot : iface->slots) {
+      if (slot->getName() == method->getName()) {
+        return;
+      }
+    }
+    iface->slots.push_back(method);
+  };
+  for (InterfaceInfo *extended : iface->extended) {
+    if (!numberSlots(extended, stack)) {
+      return false;
+    }
+    for (const auto *method : extended->slots) {
+      add(method);
+    }
+  }
+  for (const auto &member : iface->decl->getMembers()) {
+    if (auto method = nodes::dyn_cast<nodes::MethodSignatureNode>(member)) {
+      add(method);
+    }
+  }
+
+  stack.pop_back();
+  return true;
+}
+
+void LLVMClassHierarchy::order(ClassInfo *cls,
+                               std::vector<ClassInfo *> &sorted) {
+  sorted.push_back(cls);
+  for (ClassInfo *derived : cls->derived) {
+    order(derived, sorted);
+  }
+}
+
+} // namespace codegen
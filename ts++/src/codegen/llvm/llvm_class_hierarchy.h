@@ -0,0 +1,191 @@
+#pragma once
+#include "parser/nodes/declaration_nodes.h"
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace codegen {
+
+/**
+ * @class LLVMClassHierarchy
+ * @brief Whole-program view of classes and interfaces for dynamic dispatch
+ *
+ * Classes use single inheritance with the base object embedded as the
+ * first field, so a pointer to a class is also a pointer to each of its
+ * bases. When any class of a hierarchy declares a #virtual method, every
+ * object of that hierarchy starts with one pointer to its class's vtable.
+ *
+ * Vtable slots are stable down a hierarchy: a class inherits its base's
+ * slots in order, an override takes over the slot of the method it
+ * replaces, and a #virtual method that overrides nothing is appended.
+ * Interface methods are numbered the same way, extended interfaces first,
+ * and each (class, interface) pair gets an itable of that layout.
+ *
+ * Because the whole program is known, a call can be bound statically when
+ * every class that the receiver may be an instance of runs the same
+ * method. This covers leaf classes, methods that are never overridden and
+ * interfaces with a single implementation.
+ */
+class LLVMClassHierarchy {
+public:
+  struct InterfaceInfo;
+
+  /**
+   * @brief Layout and dispatch information of one class
+   */
+  struct ClassInfo {
+    const nodes::ClassDeclNode *decl = nullptr;
+    ClassInfo *base = nullptr;          // Class it extends, if any
+    std::vector<ClassInfo *> derived;   // Classes extending it directly
+    std::vector<InterfaceInfo *> interfaces; // Listed after `implements`
+    std::unordered_map<std::string, const nodes::MethodDeclNode *>
+        methods;                        // Methods declared by this class
+    std::vector<std::string> slots;     // Method name of each vtable slot
+    bool hasVptr = false;               // Objects start with a vtable pointer
+
+    const std::string &getName() const { return decl->getName(); }
+  };
+
+  /**
+   * @brief Method numbering of one interface
+   */
+  struct InterfaceInfo {
+    const nodes::InterfaceDeclNode *decl = nullptr;
+    std::vector<InterfaceInfo *> extended; // Interfaces it extends
+    std::vector<const nodes::MethodSignatureNode *>
+        slots; // Signature of each itable slot
+
+    const std::string &getName() const { return decl->getName(); }
+  };
+
+  /**
+   * @brief The method a call runs and the class declaring it
+   */
+  struct Resolution {
+    const ClassInfo *owner = nullptr;
+    const nodes::MethodDeclNode *method = nullptr;
+
+    explicit operator bool() const { return method != nullptr; }
+    bool operator==(const Resolution &other) const {
+      return method == other.method;
+    }
+  };
+
+  /**
+   * @brief Forgets every class and interface, e.g. for a new module
+   */
+  void clear();
+
+  /**
+   * @brief Records a class declaration
+   * @param decl The declaration
+   */
+  void registerClass(const nodes::ClassDeclNode *decl);
+
+  /**
+   * @brief Records an interface declaration
+   * @param decl The declaration
+   */
+  void registerInterface(const nodes::InterfaceDeclNode *decl);
+
+  /**
+   * @brief Links the recorded declarations and numbers their slots
+   * @param message Set to the problem when false is returned
+   * @return False if a base class or interface is unknown or cyclic
+   */
+  bool build(std::string &message);
+
+  /**
+   * @brief Finds a class by name
+   * @return The class, or nullptr if none has this name
+   */
+  const ClassInfo *getClass(const std::string &name) const;
+
+  /**
+   * @brief Finds an interface by name
+   * @return The interface, or nullptr if none has this name
+   */
+  const InterfaceInfo *getInterface(const std::string &name) const;
+
+  /**
+   * @brief Gets every class, each after its base
+   */
+  const std::vector<const ClassInfo *> &getClasses() const {
+    return ordered_;
+  }
+
+  /**
+   * @brief Finds the method a name resolves to on a class
+   *
+   * The class's own methods hide those of its bases.
+   */
+  Resolution resolve(const ClassInfo *cls, const std::string &name) const;
+
+  /**
+   * @brief Gets the vtable slot of a method
+   * @return The slot, or -1 if calls to the method are not dispatched
+   */
+  int getSlot(const ClassInfo *cls, const std::string &name) const;
+
+  /**
+   * @brief Gets the itable slot of an interface method
+   * @return The slot, or -1 if the interface has no such method
+   */
+  int getSlot(const InterfaceInfo *iface, const std::string &name) const;
+
+  /**
+   * @brief Finds the one method every instance of a class would run
+   *
+   * Instances include those of every class derived from it.
+   *
+   * @return The method, or an empty resolution if overrides disagree
+   */
+  Resolution uniqueImplementation(const ClassInfo *cls,
+                                  const std::string &name) const;
+
+  /**
+   * @brief Finds the one method every implementation of an interface runs
+   * @return The method, or an empty resolution if implementations disagree
+   *         or there are none
+   */
+  Resolution uniqueImplementation(const InterfaceInfo *iface,
+                                  const std::string &name) const;
+
+  /**
+   * @brief Checks whether a class is or derives from another
+   */
+  static bool derivesFrom(const ClassInfo *cls, const ClassInfo *base);
+
+  /**
+   * @brief Checks whether a class or one of its bases implements an
+   * interface, directly or through an interface extending it
+   */
+  static bool implements(const ClassInfo *cls, const InterfaceInfo *iface);
+
+  /**
+   * @brief Checks whether an interface is or extends another
+   */
+  static bool extends(const InterfaceInfo *iface, const InterfaceInfo *base);
+
+private:
+  // Resolves a type annotation naming a class or interface
+  static std::string typeName(const nodes::TypeNode *type);
+
+  // Numbers the slots of an interface after those it extends; false if
+  // the interface extends itself
+  bool numberSlots(InterfaceInfo *iface, std::vector<InterfaceInfo *> &stack);
+
+  // Appends a class's subtree, each class before those extending it
+  static void order(ClassInfo *cls, std::vector<ClassInfo *> &sorted);
+
+  // Declarations are kept in source order so output does not depend on
+  // hashing
+  std::vector<std::unique_ptr<ClassInfo>> classList_;
+  std::vector<std::unique_ptr<InterfaceInfo>> interfaceList_;
+  std::unordered_map<std::string, ClassInfo *> classes_;
+  std::unordered_map<std::string, InterfaceInfo *> interfaces_;
+  std::vector<const ClassInfo *> ordered_; // Bases before derived classes
+};
+
+} // namespace codegen
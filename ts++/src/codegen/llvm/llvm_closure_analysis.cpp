@@ -0,0 +1,656 @@
+#include "codegen/llvm/llvm_closure_analysis.h"
+#include <algorithm>
+
+namespace codegen {
+
+namespace {
+
+// Gathers the identifiers of a body, and `this`, once each
+class NameCollector {
+public:
+  std::vector<core::Symbol> names;
+
+  void add(core::Symbol name) {
+    if (std::find(names.begin(), names.end(), name) == names.end()) {
+      names.push_back(name);
+    }
+  }
+
+  void visitStmt(const nodes::StatementNode *node) {
+    if (!node) {
+      return;
+    }
+    switch (node->getNodeKind()) {
+    case nodes::NodeKind::DeclarationStmt: {
+      auto decl = nodes::cast<nodes::DeclarationStmtNode>(node);
+      if (auto var = nodes::dyn_cast<nodes::VarDeclNode>(decl->getDeclaration())) {
+        visitExpr(var->getInitializer());
+      }
+      break;
+    }
+    case nodes::NodeKind::Block:
+      for (const auto &stmt : nodes::cast<nodes::BlockNode>(node)->getStatements()) {
+        visitStmt(stmt);
+      }
+      break;
+    case nodes::NodeKind::ExpressionStmt:
+      visitExpr(nodes::cast<nodes::ExpressionStmtNode>(node)->getExpression());
+      break;
+    case nodes::NodeKind::IfStmt: {
+      auto ifStmt = nodes::cast<nodes::IfStmtNode>(node);
+      visitExpr(ifStmt->getCondition());
+      visitStmt(ifStmt->getThenBranch());
+      visitStmt(ifStmt->getElseBranch());
+      break;
+    }
+    case nodes::NodeKind::WhileStmt: {
+      auto loop = nodes::cast<nodes::WhileStmtNode>(node);
+      visitExpr(loop->getCondition());
+      visitStmt(loop->getBody());
+      break;
+    }
+    case nodes::NodeKind::DoWhileStmt: {
+      auto loop = nodes::cast<nodes::DoWhileStmtNode>(node);
+      visitStmt(loop->getBody());
+      visitExpr(loop->getCondition());
+      break;
+    }
+    case nodes::NodeKind::ForStmt: {
+      auto loop = nodes::cast<nodes::ForStmtNode>(node);
+      visitStmt(loop->getInitializer());
+      visitExpr(loop->getCondition());
+      visitExpr(loop->getIncrement());
+      visitStmt(loop->getBody());
+      break;
+    }
+    case nodes::NodeKind::ForOfStmt: {
+      auto loop = nodes::cast<nodes::ForOfStmtNode>(node);
+      visitExpr(loop->getIterable());
+      visitStmt(loop->getBody());
+      break;
+    }
+    case nodes::NodeKind::ReturnStmt:
+      visitExpr(nodes::cast<nodes::ReturnStmtNode>(node)->getValue());
+      break;
+    case nodes::NodeKind::ThrowStmt:
+      visitExpr(nodes::cast<nodes::ThrowStmtNode>(node)->getValue());
+      break;
+    case nodes::NodeKind::TryStmt: {
+      auto tryStmt = nodes::cast<nodes::TryStmtNode>(node);
+      visitStmt(tryStmt->getTryBlock());
+      for (const auto &clause : tryStmt->getCatchClauses()) {
+        visitStmt(clause.body);
+      }
+      visitStmt(tryStmt->getFinallyBlock());
+      break;
+    }
+    case nodes::NodeKind::SwitchStmt: {
+      auto switchStmt = nodes::cast<nodes::SwitchStmtNode>(node);
+      visitExpr(switchStmt->getExpression());
+      for (const auto &switchCase : switchStmt->getCases()) {
+        visitExpr(switchCase.value);
+        for (const auto &stmt : switchCase.body) {
+          visitStmt(stmt);
+        }
+      }
+      break;
+    }
+    case nodes::NodeKind::AssemblyStmt: {
+      auto assembly = nodes::cast<nodes::AssemblyStmtNode>(node);
+      for (const auto &operand : assembly->getOutputs()) {
+        visitExpr(operand.expression);
+      }
+      for (const auto &operand : assembly->getInputs()) {
+        visitExpr(operand.expression);
+      }
+      break;
+    }
+    case nodes::NodeKind::LabeledStatement:
+      visitStmt(nodes::cast<nodes::LabeledStatementNode>(node)->getStatement());
+      break;
+    default:
+      break;
+    }
+  }
+
+  void visitExpr(const nodes::ExpressionNode *node) {
+    if (!node) {
+      return;
+    }
+    switch (node->getNodeKind()) {
+    case nodes::NodeKind::IdentifierExpression:
+      add(nodes::cast<nodes::IdentifierExpressionNode>(node)->getSymbol());
+      break;
+    case nodes::NodeKind::ThisExpression:
+      add(core::Interner::instance().intern("this"));
+      break;
+    case nodes::NodeKind::BinaryExpression: {
+      auto binary = nodes::cast<nodes::BinaryExpressionNode>(node);
+      visitExpr(binary->getLeft());
+      visitExpr(binary->getRight());
+      break;
+    }
+    case nodes::NodeKind::UnaryExpression:
+      visitExpr(nodes::cast<nodes::UnaryExpressionNode>(node)->getOperand());
+      break;
+    case nodes::NodeKind::ArrayLiteral:
+      for (const auto &element :
+           nodes::cast<nodes::ArrayLiteralNode>(node)->getElements()) {
+        visitExpr(element);
+      }
+      break;
+    case nodes::NodeKind::ConditionalExpression: {
+      auto conditional = nodes::cast<nodes::ConditionalExpressionNode>(node);
+      visitExpr(conditional->getCondition());
+      visitExpr(conditional->getTrueExpression());
+      visitExpr(conditional->getFalseExpression());
+      break;
+    }
+    case nodes::NodeKind::AssignmentExpression: {
+      auto assignment = nodes::cast<nodes::AssignmentExpressionNode>(node);
+      visitExpr(assignment->getTarget());
+      visitExpr(assignment->getValue());
+      break;
+    }
+    case nodes::NodeKind::CallExpression: {
+      auto call = nodes::cast<nodes::CallExpressionNode>(node);
+      visitExpr(call->getCallee());
+      for (const auto &arg : call->getArguments()) {
+        visitExpr(arg);
+      }
+      break;
+    }
+    case nodes::NodeKind::MemberExpression:
+      visitExpr(nodes::cast<nodes::MemberExpressionNode>(node)->getObject());
+      break;
+    case nodes::NodeKind::IndexExpression: {
+      auto index = nodes::cast<nodes::IndexExpressionNode>(node);
+      visitExpr(index->getArray());
+      visitExpr(index->getIndex());
+      break;
+    }
+    case nodes::NodeKind::NewExpression:
+      for (const auto &arg :
+           nodes::cast<nodes::NewExpressionNode>(node)->getArguments()) {
+        visitExpr(arg);
+      }
+      break;
+    case nodes::NodeKind::CastExpression:
+      visitExpr(nodes::cast<nodes::CastExpressionNode>(node)->getExpression());
+      break;
+    case nodes::NodeKind::CompileTimeExpression:
+      visitExpr(
+          nodes::cast<nodes::CompileTimeExpressionNode>(node)->getOperand());
+      break;
+    case nodes::NodeKind::TemplateSpecialization:
+      visitExpr(nodes::cast<nodes::TemplateSpecializationNode>(node)->getBase());
+      break;
+    case nodes::NodeKind::PointerExpression:
+      visitExpr(nodes::cast<nodes::PointerExpressionNode>(node)->getOperand());
+      break;
+    case nodes::NodeKind::FunctionExpression:
+      visitStmt(nodes::cast<nodes::FunctionExpressionNode>(node)->getBody());
+      break;
+    default:
+      break;
+    }
+  }
+};
+
+} // namespace
+
+void LLVMClosureAnalysis::clear() {
+  holders_.clear();
+  closures_.clear();
+  functions_.clear();
+  frames_.clear();
+  loopDepth_ = 0;
+}
+
+bool LLVMClosureAnalysis::escapes(
+    const nodes::FunctionExpressionNode *closure) const {
+  auto it = closures_.find(closure);
+  return it == closures_.end() || holders_[it->second].escapes;
+}
+
+std::vector<core::Symbol> LLVMClosureAnalysis::getReferencedNames(
+    const nodes::FunctionExpressionNode *closure) {
+  NameCollector collector;
+  collector.visitStmt(closure->getBody());
+  return std::move(collector.names);
+}
+
+void LLVMClosureAnalysis::analyze(const parser::AST &ast) {
+  clear();
+
+  // Parameters first, so calls before a function's declaration find them
+  std::vector<const nodes::FunctionDeclNode *> functions;
+  std::vector<const nodes::ClassDeclNode *> classes;
+  for (nodes::NodePtr node : ast.getNodes()) {
+    if (auto stmt = nodes::dyn_cast<nodes::DeclarationStmtNode>(node)) {
+      node = stmt->getDeclaration();
+    }
+    if (auto cls = nodes::dyn_cast<nodes::ClassDeclNode>(node)) {
+      classes.push_back(cls);
+      continue;
+    }
+    auto function = nodes::dyn_cast<nodes::FunctionDeclNode>(node);
+    if (!function || function->isExternC()) {
+      continue;
+    }
+    functions.push_back(function);
+    // What a body that is not here does with its arguments is unknown
+    std::vector<size_t> params;
+    for (size_t i = 0; i < function->getParameters().size(); ++i) {
+      params.push_back(addHolder(function->isAsync() || !function->getBody(),
+                                 kParameterDepth));
+    }
+    auto name = core::Interner::instance().intern(function->getName());
+    if (!functions_.emplace(name, params).second) {
+      functions_[name].clear();
+    }
+  }
+
+  for (const auto *function : functions) {
+    auto it = functions_.find(
+        core::Interner::instance().intern(function->getName()));
+    std::vector<size_t> params = it->second;
+    if (params.size() != function->getParameters().size()) {
+      params.clear();
+    }
+    visitFunction(function->getParameters(), function->getBody(), params,
+                  kEscapes);
+  }
+  for (const auto *cls : classes) {
+    for (const auto &member : cls->getMembers()) {
+      if (auto method = nodes::dyn_cast<nodes::MethodDeclNode>(member)) {
+        visitFunction(method->getParameters(), method->getBody(), {},
+                      kEscapes);
+      } else if (auto constructor =
+                     nodes::dyn_cast<nodes::ConstructorDeclNode>(member)) {
+        visitFunction(constructor->getParameters(), constructor->getBody(), {},
+                      kEscapes);
+      }
+    }
+  }
+
+  // Top-level statements keep values in globals
+  for (nodes::NodePtr node : ast.getNodes()) {
+    if (auto stmt = nodes::dyn_cast<nodes::StatementNode>(node)) {
+      if (!nodes::isa<nodes::DeclarationStmtNode>(stmt)) {
+        visitStmt(stmt);
+      } else if (auto var = nodes::dyn_cast<nodes::VarDeclNode>(
+                     nodes::cast<nodes::DeclarationStmtNode>(stmt)
+                         ->getDeclaration())) {
+        visitExpr(var->getInitializer(), kEscapes);
+      }
+    } else if (auto var = nodes::dyn_cast<nodes::VarDeclNode>(node)) {
+      visitExpr(var->getInitializer(), kEscapes);
+    }
+  }
+
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (auto &holder : holders_) {
+      if (holder.escapes) {
+        continue;
+      }
+      for (size_t sink : holder.dependsOn) {
+        if (holders_[sink].escapes) {
+          holder.escapes = changed = true;
+          break;
+        }
+      }
+    }
+  }
+}
+
+size_t LLVMClosureAnalysis::addHolder(bool escapes, size_t loopDepth) {
+  Holder holder;
+  holder.escapes = escapes;
+  holder.loopDepth = loopDepth;
+  holders_.push_back(std::move(holder));
+  return holders_.size() - 1;
+}
+
+void LLVMClosureAnalysis::addFlow(size_t from, size_t sink) {
+  if (sink == kCalled) {
+    return;
+  }
+  if (sink == kEscapes || holders_[sink].loopDepth < holders_[from].loopDepth) {
+    holders_[from].escapes = true;
+    return;
+  }
+  holders_[from].dependsOn.push_back(sink);
+}
+
+void LLVMClosureAnalysis::declareLocal(core::Symbol name, size_t holder) {
+  if (!frames_.empty()) {
+    frames_.back().scopes.back()[name] = holder;
+  }
+}
+
+void LLVMClosureAnalysis::visitFunction(
+    const std::vector<nodes::ParamPtr> &params, const nodes::BlockNode *body,
+    const std::vector<size_t> &paramHolders, size_t closure) {
+  if (!body) {
+    return;
+  }
+  Frame frame;
+  frame.closure = closure;
+  frame.scopes.emplace_back();
+  for (size_t i = 0; i < params.size(); ++i) {
+    frame.scopes.back()[core::Interner::instance().intern(
+        params[i]->getName())] = i < paramHolders.size()
+                                     ? paramHolders[i]
+                                     : addHolder(false, kParameterDepth);
+  }
+  frames_.push_back(std::move(frame));
+  visitStmt(body);
+  frames_.pop_back();
+}
+
+void LLVMClosureAnalysis::visitStmt(const nodes::StatementNode *node) {
+  if (!node) {
+    return;
+  }
+  auto &interner = core::Interner::instance();
+  auto enterScope = [this]() {
+    if (!frames_.empty()) {
+      frames_.back().scopes.emplace_back();
+    }
+  };
+  auto exitScope = [this]() {
+    if (!frames_.empty()) {
+      frames_.back().scopes.pop_back();
+    }
+  };
+
+  switch (node->getNodeKind()) {
+  case nodes::NodeKind::DeclarationStmt: {
+    auto decl = nodes::cast<nodes::DeclarationStmtNode>(node)->getDeclaration();
+    auto var = nodes::dyn_cast<nodes::VarDeclNode>(decl);
+    if (!var) {
+      break;
+    }
+    size_t holder = frames_.empty() ? kEscapes : addHolder(false, loopDepth_);
+    visitExpr(var->getInitializer(), holder);
+    declareLocal(interner.intern(var->getName()), holder);
+    break;
+  }
+  case nodes::NodeKind::Block:
+    enterScope();
+    for (const auto &stmt : nodes::cast<nodes::BlockNode>(node)->getStatements()) {
+      visitStmt(stmt);
+    }
+    exitScope();
+    break;
+  case nodes::NodeKind::ExpressionStmt:
+    visitExpr(nodes::cast<nodes::ExpressionStmtNode>(node)->getExpression(),
+              kCalled);
+    break;
+  case nodes::NodeKind::IfStmt: {
+    auto ifStmt = nodes::cast<nodes::IfStmtNode>(node);
+    visitExpr(ifStmt->getCondition(), kEscapes);
+    visitStmt(ifStmt->getThenBranch());
+    visitStmt(ifStmt->getElseBranch());
+    break;
+  }
+  case nodes::NodeKind::WhileStmt: {
+    auto loop = nodes::cast<nodes::WhileStmtNode>(node);
+    ++loopDepth_;
+    visitExpr(loop->getCondition(), kEscapes);
+    visitStmt(loop->getBody());
+    --loopDepth_;
+    break;
+  }
+  case nodes::NodeKind::DoWhileStmt: {
+    auto loop = nodes::cast<nodes::DoWhileStmtNode>(node);
+    ++loopDepth_;
+    visitStmt(loop->getBody());
+    visitExpr(loop->getCondition(), kEscapes);
+    --loopDepth_;
+    break;
+  }
+  case nodes::NodeKind::ForStmt: {
+    auto loop = nodes::cast<nodes::ForStmtNode>(node);
+    enterScope();
+    visitStmt(loop->getInitializer());
+    ++loopDepth_;
+    visitExpr(loop->getCondition(), kEscapes);
+    visitExpr(loop->getIncrement(), kCalled);
+    visitStmt(loop->getBody());
+    --loopDepth_;
+    exitScope();
+    break;
+  }
+  case nodes::NodeKind::ForOfStmt: {
+    auto loop = nodes::cast<nodes::ForOfStmtNode>(node);
+    visitExpr(loop->getIterable(), kEscapes);
+    enterScope();
+    ++loopDepth_;
+    declareLocal(interner.intern(loop->getIdentifier()),
+                 addHolder(true, loopDepth_));
+    visitStmt(loop->getBody());
+    --loopDepth_;
+    exitScope();
+    break;
+  }
+  case nodes::NodeKind::ReturnStmt:
+    visitExpr(nodes::cast<nodes::ReturnStmtNode>(node)->getValue(), kEscapes);
+    break;
+  case nodes::NodeKind::ThrowStmt:
+    visitExpr(nodes::cast<nodes::ThrowStmtNode>(node)->getValue(), kEscapes);
+    break;
+  case nodes::NodeKind::TryStmt: {
+    auto tryStmt = nodes::cast<nodes::TryStmtNode>(node);
+    visitStmt(tryStmt->getTryBlock());
+    for (const auto &clause : tryStmt->getCatchClauses()) {
+      enterScope();
+      declareLocal(interner.intern(clause.parameter),
+                   addHolder(true, loopDepth_));
+      visitStmt(clause.body);
+      exitScope();
+    }
+    visitStmt(tryStmt->getFinallyBlock());
+    break;
+  }
+  case nodes::NodeKind::SwitchStmt: {
+    auto switchStmt = nodes::cast<nodes::SwitchStmtNode>(node);
+    visitExpr(switchStmt->getExpression(), kEscapes);
+    enterScope();
+    for (const auto &switchCase : switchStmt->getCases()) {
+      visitExpr(switchCase.value, kEscapes);
+      for (const auto &stmt : switchCase.body) {
+        visitStmt(stmt);
+      }
+    }
+    exitScope();
+    break;
+  }
+  case nodes::NodeKind::AssemblyStmt: {
+    auto assembly = nodes::cast<nodes::AssemblyStmtNode>(node);
+    for (const auto &operand : assembly->getOutputs()) {
+      visitExpr(operand.expression, kEscapes);
+    }
+    for (const auto &operand : assembly->getInputs()) {
+      visitExpr(operand.expression, kEscapes);
+    }
+    break;
+  }
+  case nodes::NodeKind::LabeledStatement:
+    visitStmt(nodes::cast<nodes::LabeledStatementNode>(node)->getStatement());
+    break;
+  default:
+    break;
+  }
+}
+
+void LLVMClosureAnalysis::visitExpr(const nodes::ExpressionNode *node,
+                                    size_t sink) {
+  if (!node) {
+    return;
+  }
+  switch (node->getNodeKind()) {
+  case nodes::NodeKind::IdentifierExpression:
+    visitIdentifier(nodes::cast<nodes::IdentifierExpressionNode>(node), sink);
+    break;
+  case nodes::NodeKind::CallExpression:
+    visitCall(nodes::cast<nodes::CallExpressionNode>(node), sink);
+    break;
+  case nodes::NodeKind::FunctionExpression: {
+    auto closure = nodes::cast<nodes::FunctionExpressionNode>(node);
+    size_t holder = addHolder(false, loopDepth_);
+    closures_[closure] = holder;
+    addFlow(holder, sink);
+    visitFunction(closure->getParameters(), closure->getBody(), {}, holder);
+    break;
+  }
+  case nodes::NodeKind::ConditionalExpression: {
+    // Either arm is the result
+    auto conditional = nodes::cast<nodes::ConditionalExpressionNode>(node);
+    visitExpr(conditional->getCondition(), kEscapes);
+    visitExpr(conditional->getTrueExpression(), sink);
+    visitExpr(conditional->getFalseExpression(), sink);
+    break;
+  }
+  case nodes::NodeKind::AssignmentExpression: {
+    // A local keeps what is assigned to it; other targets, parameters
+    // included, escape
+    auto assignment = nodes::cast<nodes::AssignmentExpressionNode>(node);
+    size_t target = kEscapes;
+    if (auto ident = nodes::dyn_cast<nodes::IdentifierExpressionNode>(
+            assignment->getTarget())) {
+      if (!frames_.empty()) {
+        for (const auto &scope : frames_.back().scopes) {
+          auto it = scope.find(ident->getSymbol());
+          if (it != scope.end()) {
+            target = it->second;
+          }
+        }
+      }
+    } else {
+      visitExpr(assignment->getTarget(), kEscapes);
+    }
+    if (target != kEscapes && holders_[target].loopDepth == kParameterDepth) {
+      target = kEscapes;
+    }
+    visitExpr(assignment->getValue(), target);
+    break;
+  }
+  case nodes::NodeKind::BinaryExpression: {
+    auto binary = nodes::cast<nodes::BinaryExpressionNode>(node);
+    visitExpr(binary->getLeft(), kEscapes);
+    visitExpr(binary->getRight(), kEscapes);
+    break;
+  }
+  case nodes::NodeKind::UnaryExpression:
+    visitExpr(nodes::cast<nodes::UnaryExpressionNode>(node)->getOperand(),
+              kEscapes);
+    break;
+  case nodes::NodeKind::ArrayLiteral:
+    for (const auto &element :
+         nodes::cast<nodes::ArrayLiteralNode>(node)->getElements()) {
+      visitExpr(element, kEscapes);
+    }
+    break;
+  case nodes::NodeKind::MemberExpression:
+    visitExpr(nodes::cast<nodes::MemberExpressionNode>(node)->getObject(),
+              kEscapes);
+    break;
+  case nodes::NodeKind::IndexExpression: {
+    auto index = nodes::cast<nodes::IndexExpressionNode>(node);
+    visitExpr(index->getArray(), kEscapes);
+    visitExpr(index->getIndex(), kEscapes);
+    break;
+  }
+  case nodes::NodeKind::NewExpression:
+    for (const auto &arg :
+         nodes::cast<nodes::NewExpressionNode>(node)->getArguments()) {
+      visitExpr(arg, kEscapes);
+    }
+    break;
+  case nodes::NodeKind::CastExpression:
+    visitExpr(nodes::cast<nodes::CastExpressionNode>(node)->getExpression(),
+              kEscapes);
+    break;
+  case nodes::NodeKind::CompileTimeExpression:
+    visitExpr(nodes::cast<nodes::CompileTimeExpressionNode>(node)->getOperand(),
+              kEscapes);
+    break;
+  case nodes::NodeKind::TemplateSpecialization:
+    visitExpr(nodes::cast<nodes::TemplateSpecializationNode>(node)->getBase(),
+              kEscapes);
+    break;
+  case nodes::NodeKind::PointerExpression:
+    visitExpr(nodes::cast<nodes::PointerExpressionNode>(node)->getOperand(),
+              kEscapes);
+    break;
+  default:
+    break;
+  }
+}
+
+void LLVMClosureAnalysis::visitIdentifier(
+    const nodes::IdentifierExpressionNode *node, size_t sink) {
+  // The innermost declaration, and the body declaring it
+  size_t holder = kEscapes;
+  size_t owner = frames_.size();
+  for (size_t frame = frames_.size(); frame-- > 0 && owner == frames_.size();) {
+    const auto &scopes = frames_[frame].scopes;
+    for (size_t scope = scopes.size(); scope-- > 0;) {
+      auto it = scopes[scope].find(node->getSymbol());
+      if (it != scopes[scope].end()) {
+        holder = it->second;
+        owner = frame;
+        break;
+      }
+    }
+  }
+  if (owner == frames_.size()) {
+    return; // A global or a function; flows from it are not tracked
+  }
+  if (owner + 1 < frames_.size()) {
+    // A copy of it is in the environment of every closure in between,
+    // which may only be called there if it is kept there
+    if (sink != kCalled) {
+      holders_[holder].escapes = true;
+    }
+    for (size_t frame = owner + 1; frame < frames_.size(); ++frame) {
+      if (frames_[frame].closure != kEscapes) {
+        holders_[holder].dependsOn.push_back(frames_[frame].closure);
+      }
+    }
+    return;
+  }
+  addFlow(holder, sink);
+}
+
+void LLVMClosureAnalysis::visitCall(const nodes::CallExpressionNode *node,
+                                    size_t sink) {
+  (void)sink; // A result is made by the callee, which decides for itself
+  const std::vector<size_t> *params = nullptr;
+  if (auto ident =
+          nodes::dyn_cast<nodes::IdentifierExpressionNode>(node->getCallee())) {
+    bool local = false;
+    for (const auto &frame : frames_) {
+      for (const auto &scope : frame.scopes) {
+        local |= scope.count(ident->getSymbol()) != 0;
+      }
+    }
+    auto it = functions_.find(ident->getSymbol());
+    if (!local && it != functions_.end()) {
+      params = &it->second;
+    }
+  }
+  visitExpr(node->getCallee(), kCalled);
+
+  const auto &args = node->getArguments();
+  for (size_t i = 0; i < args.size(); ++i) {
+    visitExpr(args[i],
+              params && i < params->size() ? (*params)[i] : kEscapes);
+  }
+}
+
+} // namespace codegen
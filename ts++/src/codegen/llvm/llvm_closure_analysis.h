@@ -0,0 +1,109 @@
+#pragma once
+#include "core/common/interner.h"
+#include "parser/ast.h"
+#include "parser/nodes/declaration_nodes.h"
+#include "parser/nodes/expression_nodes.h"
+#include "parser/nodes/statement_nodes.h"
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+namespace codegen {
+
+/**
+ * @class LLVMClosureAnalysis
+ * @brief Finds the function expressions whose environment may outlive the
+ * call that creates it
+ *
+ * Every place a function value can be kept is a holder: a function
+ * expression, a local variable, and a parameter of a top-level function.
+ * A value flows into a holder when it initializes or is assigned to the
+ * variable, or is passed for the parameter, and the holder it came from
+ * escapes if that one does. Calling a value keeps nothing. Anything else
+ * (returning it, storing it in an object, an array or a global, passing
+ * it to a method or an unknown function, capturing it in another closure
+ * that escapes) makes it escape, as does a parameter of an async
+ * function, whose frame outlives its caller's.
+ *
+ * The analysis is a greatest fixed point over those edges. A closure that
+ * does not escape is only called while the function creating it runs, so
+ * its environment can live in that function's frame.
+ */
+class LLVMClosureAnalysis {
+public:
+  /**
+   * @brief Analyzes every function of a module
+   * @param ast The module, with its bodies parsed
+   */
+  void analyze(const parser::AST &ast);
+
+  /**
+   * @brief Forgets every closure, e.g. for a new module
+   */
+  void clear();
+
+  /**
+   * @brief Checks whether a closure may be called after the function
+   * creating it returns; unknown closures may
+   */
+  bool escapes(const nodes::FunctionExpressionNode *closure) const;
+
+  /**
+   * @brief Gets the names a function expression refers to, in order of
+   * first use, including those of the closures it contains and `this`
+   * @return Candidates for capture; its parameters and locals are there
+   *         too, and are told apart by the code generator
+   */
+  static std::vector<core::Symbol>
+  getReferencedNames(const nodes::FunctionExpressionNode *closure);
+
+private:
+  // Flows into a call's callee keep nothing; anything unlisted escapes
+  static constexpr size_t kEscapes = static_cast<size_t>(-1);
+  static constexpr size_t kCalled = static_cast<size_t>(-2);
+  // Loop depth of parameters, which hold an argument for one call
+  static constexpr size_t kParameterDepth = static_cast<size_t>(-1);
+
+  struct Holder {
+    bool escapes = false;
+    size_t loopDepth = 0;          // Loops around where it is declared
+    std::vector<size_t> dependsOn; // Holders its value flows into
+  };
+
+  // The body of a function or closure being walked
+  struct Frame {
+    size_t closure = kEscapes; // Holder of the closure, if it is one
+    std::vector<std::unordered_map<core::Symbol, size_t>> scopes;
+  };
+
+  size_t addHolder(bool escapes, size_t loopDepth);
+
+  /**
+   * @brief Records that a value flows from one holder into a sink
+   *
+   * A value made inside a loop that reaches a holder declared outside it
+   * may meet the next iteration's, so it escapes.
+   */
+  void addFlow(size_t from, size_t sink);
+
+  void declareLocal(core::Symbol name, size_t holder);
+  void visitFunction(const std::vector<nodes::ParamPtr> &params,
+                     const nodes::BlockNode *body,
+                     const std::vector<size_t> &paramHolders,
+                     size_t closure);
+  void visitStmt(const nodes::StatementNode *node);
+  void visitExpr(const nodes::ExpressionNode *node, size_t sink);
+  void visitIdentifier(const nodes::IdentifierExpressionNode *node,
+                       size_t sink);
+  void visitCall(const nodes::CallExpressionNode *node, size_t sink);
+
+  std::vector<Holder> holders_;
+  std::unordered_map<const nodes::FunctionExpressionNode *, size_t> closures_;
+  // Parameter holders of each top-level function; a name declared twice
+  // maps to none
+  std::unordered_map<core::Symbol, std::vector<size_t>> functions_;
+  std::vector<Frame> frames_;
+  size_t loopDepth_ = 0;
+};
+
+} // namespace codegen
@@ -1,22 +1,77 @@
 #include "codegen/llvm/llvm_code_gen.h"
+#include "codegen/llvm/llvm_heap_to_stack.h"
+#include "codegen/llvm/llvm_inline_asm.h"
+#include "codegen/llvm/llvm_string_switch.h"
 #include "codegen/llvm/llvm_utils.h"
+#include "core/common/time_report.h"
+#include "runtime/tspp_runtime.h"
+#include "tokens/literal_value.h"
+#include "llvm/Analysis/ValueTracking.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/InlineAsm.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/IR/MDBuilder.h"
 #include "llvm/IR/Type.h"
 #include "llvm/IR/Verifier.h"
-#include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Linker/Linker.h"
+#include "llvm/MC/MCSubtargetInfo.h"
+#include "llvm/MC/TargetRegistry.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Transforms/Utils/Local.h"
+#include <algorithm>
+#include <cctype>
+#include <functional>
 #include <iostream>
-#include <regex>
+#include <map>
 #include <sstream>
+#include <string_view>
 
 namespace codegen {
 
 LLVMCodeGen::LLVMCodeGen(core::ErrorReporter &errorReporter,
                          const std::string &moduleName)
     : errorReporter_(errorReporter), context_(moduleName),
-      typeBuilder_(context_), optimizer_(context_) {}
+      typeBuilder_(context_), optimizer_(context_),
+      monomorphizer_(context_, typeBuilder_) {
+  setOptions(options_);
+}
+
+void LLVMCodeGen::setOptions(const CodeGenOptions &options) {
+  options_ = options;
+  optimizer_.setOptimizationLevel(options_.getOptimizationLevel());
+  optimizer_.setLTOMode(options_.getLTOMode());
+  optimizer_.setVectorization(options_.isSIMDEnabled());
+  optimizer_.setDeadStrip(options_.isDeadStripEnabled());
+  optimizer_.setProfileGenerate(options_.isProfileGenerateEnabled()
+                                    ? options_.getRawProfilePath()
+                                    : "");
+  optimizer_.setProfileUse(options_.getProfileUseFile());
+
+  // Floating point operations may be reassociated and contracted
+  llvm::FastMathFlags fastMath;
+  if (options_.isFastMathEnabled()) {
+    fastMath.setFast();
+  }
+  context_.getBuilder().setFastMathFlags(fastMath);
+
+  // Without a target machine the optimizer falls back to generic analyses
+  if (!target_.initialize(options_)) {
+    warning(core::SourceLocation(),
+            "Target unavailable, optimizing without target information: " +
+                target_.getLastError());
+  }
+  optimizer_.setTargetMachine(target_.getTargetMachine());
+}
 
 bool LLVMCodeGen::generateCode(const parser::AST &ast) {
+  // Diagnostics may be recorded without failing the visit that raised them
+  const int errorsBefore = errorReporter_.errorCount();
+  core::TimeReport::Scope timer("Code generation");
+
   try {
     auto &module = context_.getModule();
 
@@ -24,12 +79,41 @@ bool LLVMCodeGen::generateCode(const parser::AST &ast) {
     topLevelAssemblyStatements_.clear();
     topLevelExpressionStatements_.clear();
     functionTable_.clear();
+    throwingFunctions_.clear();
+    checkSites_.clear();
+    monomorphizer_.clear();
+    deferredBodies_.clear();
+
+    // Only a program's own main is called from outside; a partition's
+    // functions are called from the others
+    wholeProgram_ = options_.isWholeProgram() && !partition_;
+
+    // Struct layouts and alignments depend on the target's data layout
+    target_.configureModule(module);
+
+    // Line tables, and at -O0 variables, for debuggers and profilers
+    debugInfo_.reset();
+    if (options_.isDebugInfoEnabled()) {
+      debugInfo_ = std::make_unique<LLVMDebugInfo>(
+          module, typeBuilder_, options_.getDebugInfo(),
+          options_.getOptimizationLevel() != OptimizationLevel::O0);
+    }
+    instrumentation_.reset();
+    if (options_.isInstrumentFunctionsEnabled() ||
+        options_.isInstrumentLoopsEnabled() ||
+        options_.isAllocProfileEnabled()) {
+      instrumentation_ = std::make_unique<LLVMInstrumentation>(module);
+    }
 
     // First, declare external functions that might be needed
     declareExternalFunctions();
 
     // Pre-pass: declare all types first
     declareTypes(ast);
+    collectFunctionVersions(ast);
+    declareFunctions(ast);
+    closureAnalysis_.analyze(ast);
+    comptime_.declareAST(ast);
 
     // Process all top-level declarations in the AST
     for (const auto &node : ast.getNodes()) {
@@ -42,12 +126,31 @@ bool LLVMCodeGen::generateCode(const parser::AST &ast) {
 
     // Check if we have a main function, if not create one
     llvm::Function *mainFunc = module.getFunction("main");
-    if (!mainFunc) {
+    if (!mainFunc && options_.hasDefaultMain() &&
+        (!partition_ || partition_->ownsEntry)) {
       mainFunc = createDefaultMainFunction();
       if (!mainFunc) {
         error(core::SourceLocation(), "Failed to create main function");
         return false;
       }
+      if (options_.isWasm()) {
+        mainFunc->addFnAttr("wasm-export-name", "main");
+      }
+    }
+
+    if (!emitSpecializations() || !emitReachableBodies() ||
+        errorReporter_.errorCount() != errorsBefore) {
+      return false;
+    }
+    for (auto &function : module) {
+      dropEscapingFrees(function);
+    }
+    inferNoUnwind();
+    if (debugInfo_) {
+      debugInfo_->finalize();
+    }
+    if (instrumentation_) {
+      instrumentation_->finalize();
     }
 
     // Verify all functions in the module
@@ -60,6 +163,17 @@ bool LLVMCodeGen::generateCode(const parser::AST &ast) {
     }
 
     // Apply optimizations if requested
+    std::string profileError;
+    if (!optimizer_.checkProfile(profileError)) {
+      error(core::SourceLocation(), profileError);
+      return false;
+    }
+    if (!options_.getRuntimeBitcode().empty() && !options_.isWasm() &&
+        options_.getLTOMode() == LTOMode::None &&
+        options_.getOptimizationLevel() != OptimizationLevel::O0 &&
+        options_.getOptimizationLevel() != OptimizationLevel::Og) {
+      linkRuntimeBitcode();
+    }
     optimizer_.optimizeAll();
 
     return true;
@@ -77,25 +191,44 @@ void LLVMCodeGen::declareExternalFunctions() {
   // Declare printf function for assembly statements
   if (!module.getFunction("printf")) {
     std::vector<llvm::Type *> printfArgs;
-    printfArgs.push_back(llvm::Type::getInt8Ty(llvmContext));
+    printfArgs.push_back(llvm::Type::getInt8PtrTy(llvmContext));
     llvm::FunctionType *printfType =
         llvm::FunctionType::get(llvm::Type::getInt32Ty(llvmContext), printfArgs,
                                 true // varargs
         );
     llvm::Function::Create(printfType, llvm::Function::ExternalLinkage,
-                           "printf", module);
+                           "printf", module)
+        ->addFnAttr(llvm::Attribute::NoUnwind);
   }
 
   // Declare puts function
   if (!module.getFunction("puts")) {
     std::vector<llvm::Type *> putsArgs;
-    putsArgs.push_back(llvm::Type::getInt8Ty(llvmContext));
+    putsArgs.push_back(llvm::Type::getInt8PtrTy(llvmContext));
     llvm::FunctionType *putsType =
         llvm::FunctionType::get(llvm::Type::getInt32Ty(llvmContext), putsArgs,
                                 false // not varargs
         );
     llvm::Function::Create(putsType, llvm::Function::ExternalLinkage, "puts",
-                           module);
+                           module)
+        ->addFnAttr(llvm::Attribute::NoUnwind);
+  }
+
+  // Buffered standard output, which printf statements write through
+  if (!module.getFunction("tspp_write")) {
+    llvm::FunctionType *writeType = llvm::FunctionType::get(
+        llvm::Type::getVoidTy(llvmContext),
+        {llvm::Type::getInt8PtrTy(llvmContext),
+         llvm::Type::getInt64Ty(llvmContext)},
+        false);
+    llvm::Function *write =
+        llvm::Function::Create(writeType, llvm::Function::ExternalLinkage,
+                               "tspp_write", module);
+    write->addFnAttr(llvm::Attribute::NoUnwind);
+    // Reads the text, and otherwise only the runtime's own buffer
+    write->addFnAttr(llvm::Attribute::InaccessibleMemOrArgMemOnly);
+    write->addParamAttr(0, llvm::Attribute::NoCapture);
+    write->addParamAttr(0, llvm::Attribute::ReadOnly);
   }
 
   // Declare malloc and free for dynamic allocation
@@ -103,1009 +236,8320 @@ void LLVMCodeGen::declareExternalFunctions() {
     std::vector<llvm::Type *> mallocArgs;
     mallocArgs.push_back(llvm::Type::getInt64Ty(llvmContext)); // size_t
     llvm::FunctionType *mallocType = llvm::FunctionType::get(
-        llvm::Type::getInt8Ty(llvmContext), mallocArgs, false);
+        llvm::Type::getInt8PtrTy(llvmContext), mallocArgs, false);
     llvm::Function::Create(mallocType, llvm::Function::ExternalLinkage,
-                           "malloc", module);
+                           "malloc", module)
+        ->addFnAttr(llvm::Attribute::NoUnwind);
   }
 
   if (!module.getFunction("free")) {
     std::vector<llvm::Type *> freeArgs;
-    freeArgs.push_back(llvm::Type::getInt8Ty(llvmContext));
+    freeArgs.push_back(llvm::Type::getInt8PtrTy(llvmContext));
     llvm::FunctionType *freeType = llvm::FunctionType::get(
         llvm::Type::getVoidTy(llvmContext), freeArgs, false);
     llvm::Function::Create(freeType, llvm::Function::ExternalLinkage, "free",
-                           module);
+                           module)
+        ->addFnAttr(llvm::Attribute::NoUnwind);
   }
-}
 
-void LLVMCodeGen::declareTypes(const parser::AST &ast) {
-  // Pre-pass to declare all types before generating code
-  for (const auto &node : ast.getNodes()) {
-    if (auto classDecl =
-            std::dynamic_pointer_cast<nodes::ClassDeclNode>(node)) {
-      // Declare class type
-      std::vector<std::pair<std::string, llvm::Type *>> fields;
-      // This would be populated from the class definition
-      typeBuilder_.createStructType(classDecl->getName(), fields);
+  // Runtime allocator behind new and #heap storage. The attributes let
+  // the optimizer treat it like malloc: a fresh object of the given size.
+  // tspp_new serves new expressions, from the innermost #arena if any.
+  for (const char *allocator : {"tspp_alloc", "tspp_new"}) {
+    if (module.getFunction(allocator)) {
+      continue;
     }
-    // Handle other type declarations as needed
+    llvm::Type *sizeType = llvm::Type::getInt64Ty(llvmContext);
+    llvm::FunctionType *allocType =
+        llvm::FunctionType::get(llvm::Type::getInt8PtrTy(llvmContext),
+                                {sizeType, sizeType}, false);
+    llvm::Function *alloc = llvm::Function::Create(
+        allocType, llvm::Function::ExternalLinkage, allocator, module);
+    alloc->addRetAttr(llvm::Attribute::NoAlias);
+    alloc->addFnAttr(llvm::Attribute::NoUnwind);
+    alloc->addFnAttr(
+        llvm::Attribute::getWithAllocSizeArgs(llvmContext, 0, llvm::None));
   }
-}
-
-bool LLVMCodeGen::visitTopLevelDeclaration(const nodes::NodePtr &node) {
-  try {
-    if (auto funcDecl =
-            std::dynamic_pointer_cast<nodes::FunctionDeclNode>(node)) {
-      return visitFunctionDecl(funcDecl.get());
-    } else if (auto varDecl =
-                   std::dynamic_pointer_cast<nodes::VarDeclNode>(node)) {
-      return visitGlobalVarDecl(varDecl.get());
-    } else if (auto stmt =
-                   std::dynamic_pointer_cast<nodes::StatementNode>(node)) {
-      return visitTopLevelStatement(stmt.get());
-    } else if (auto exprStmt =
-                   std::dynamic_pointer_cast<nodes::ExpressionStmtNode>(node)) {
-      return visitTopLevelStatement(exprStmt.get());
-    } else if (auto classDecl =
-                   std::dynamic_pointer_cast<nodes::ClassDeclNode>(node)) {
-      visitClassDecl(classDecl.get());
-      return true;
-    } else if (auto namespaceDecl =
-                   std::dynamic_pointer_cast<nodes::NamespaceDeclNode>(node)) {
-      visitNamespaceDecl(namespaceDecl.get());
-      return true;
+  // -alloc-profile allocators, which also take the new expression's
+  // tspp_alloc_site
+  if (options_.isAllocProfileEnabled()) {
+    for (const char *allocator : {"tspp_new_at", "tspp_shared_alloc_at"}) {
+      if (module.getFunction(allocator)) {
+        continue;
+      }
+      llvm::Type *sizeType = llvm::Type::getInt64Ty(llvmContext);
+      llvm::Type *bytePtrType = llvm::Type::getInt8PtrTy(llvmContext);
+      bool shared = std::string(allocator) == "tspp_shared_alloc_at";
+      std::vector<llvm::Type *> params{sizeType, sizeType, bytePtrType};
+      if (shared) {
+        params.push_back(bytePtrType);
+      }
+      llvm::Function *alloc = llvm::Function::Create(
+          llvm::FunctionType::get(bytePtrType, params, false),
+          llvm::Function::ExternalLinkage, allocator, module);
+      alloc->addRetAttr(llvm::Attribute::NoAlias);
+      alloc->addFnAttr(llvm::Attribute::NoUnwind);
+      for (unsigned i = 2; i < params.size(); ++i) {
+        alloc->addParamAttr(i, llvm::Attribute::NoCapture);
+      }
+      if (!shared) {
+        alloc->addFnAttr(
+            llvm::Attribute::getWithAllocSizeArgs(llvmContext, 0, llvm::None));
+      }
     }
-
-    // Unsupported node type - log warning but continue
-    warning(core::SourceLocation(),
-            "Unsupported top-level declaration type encountered");
-    return true;
-  } catch (const std::exception &e) {
-    error(core::SourceLocation(),
-          "Error processing top-level declaration: " + std::string(e.what()));
-    return false;
   }
-}
-
-bool LLVMCodeGen::visitFunctionDecl(const nodes::FunctionDeclNode *node) {
-  auto &module = context_.getModule();
-  auto &llvmContext = context_.getContext();
+  if (!module.getFunction("tspp_arena_enter")) {
+    llvm::Function::Create(
+        llvm::FunctionType::get(llvm::Type::getInt8PtrTy(llvmContext), false),
+        llvm::Function::ExternalLinkage, "tspp_arena_enter", module)
+        ->addFnAttr(llvm::Attribute::NoUnwind);
+  }
+  if (!module.getFunction("tspp_arena_exit")) {
+    llvm::Function::Create(
+        llvm::FunctionType::get(llvm::Type::getVoidTy(llvmContext),
+                                {llvm::Type::getInt8PtrTy(llvmContext)},
+                                false),
+        llvm::Function::ExternalLinkage, "tspp_arena_exit", module)
+        ->addFnAttr(llvm::Attribute::NoUnwind);
+  }
 
-  try {
-    // Check if function already exists
-    if (module.getFunction(node->getName())) {
-      error(core::SourceLocation(),
-            "Function '" + node->getName() + "' already declared");
-      return false;
-    }
+  if (!module.getFunction("tspp_free")) {
+    llvm::FunctionType *freeType =
+        llvm::FunctionType::get(llvm::Type::getVoidTy(llvmContext),
+                                {llvm::Type::getInt8PtrTy(llvmContext)}, false);
+    llvm::Function *release = llvm::Function::Create(
+        freeType, llvm::Function::ExternalLinkage, "tspp_free", module);
+    release->addFnAttr(llvm::Attribute::NoUnwind);
+    release->addParamAttr(0, llvm::Attribute::NoCapture);
+  }
 
-    // Create function type
-    std::vector<llvm::Type *> paramTypes;
-    std::vector<std::string> paramNames;
+  // Reference counted objects behind #shared and #weak pointers, which
+  // also take the tspp_shared_type of their class
+  if (!module.getFunction("tspp_shared_alloc")) {
+    llvm::Type *sizeType = llvm::Type::getInt64Ty(llvmContext);
+    llvm::FunctionType *allocType = llvm::FunctionType::get(
+        llvm::Type::getInt8PtrTy(llvmContext),
+        {sizeType, sizeType, llvm::Type::getInt8PtrTy(llvmContext)}, false);
+    llvm::Function *alloc = llvm::Function::Create(
+        allocType, llvm::Function::ExternalLinkage, "tspp_shared_alloc",
+        module);
+    alloc->addRetAttr(llvm::Attribute::NoAlias);
+    alloc->addFnAttr(llvm::Attribute::NoUnwind);
+    alloc->addParamAttr(2, llvm::Attribute::NoCapture);
+  }
 
-    for (const auto &param : node->getParameters()) {
-      // Use type builder for proper type conversion
-      auto paramType = llvm::Type::getInt32Ty(llvmContext); // Simplified
-      paramTypes.push_back(paramType);
-      paramNames.push_back(param->getName());
+  llvm::FunctionType *countType =
+      llvm::FunctionType::get(llvm::Type::getVoidTy(llvmContext),
+                              {llvm::Type::getInt8PtrTy(llvmContext)}, false);
+  for (const char *name :
+       {"tspp_shared_publish", "tspp_shared_retain", "tspp_shared_release",
+        "tspp_weak_retain", "tspp_weak_release"}) {
+    if (!module.getFunction(name)) {
+      llvm::Function *update = llvm::Function::Create(
+          countType, llvm::Function::ExternalLinkage, name, module);
+      update->addFnAttr(llvm::Attribute::NoUnwind);
+      update->addParamAttr(0, llvm::Attribute::NoCapture);
     }
+  }
 
-    // Determine return type
-    llvm::Type *returnType = llvm::Type::getInt32Ty(llvmContext);
-    if (node->getReturnType()) {
-      // Use type builder for proper type conversion
-      returnType = llvm::Type::getInt32Ty(llvmContext); // Simplified
-    }
+  if (!module.getFunction("tspp_weak_lock")) {
+    llvm::FunctionType *lockType = llvm::FunctionType::get(
+        llvm::Type::getInt8PtrTy(llvmContext),
+        {llvm::Type::getInt8PtrTy(llvmContext)}, false);
+    llvm::Function *lock = llvm::Function::Create(
+        lockType, llvm::Function::ExternalLinkage, "tspp_weak_lock", module);
+    lock->addFnAttr(llvm::Attribute::NoUnwind);
+  }
 
-    llvm::FunctionType *functionType =
-        llvm::FunctionType::get(returnType, paramTypes, false);
+  // Exceptions. tspp_throw is the one runtime function that unwinds.
+  llvm::Type *bytePtrType = llvm::Type::getInt8PtrTy(llvmContext);
+  llvm::FunctionType *exceptionType = llvm::FunctionType::get(
+      llvm::Type::getVoidTy(llvmContext),
+      {bytePtrType, bytePtrType, llvm::Type::getInt64Ty(llvmContext)}, false);
+  if (!module.getFunction("tspp_throw")) {
+    llvm::Function *raise = llvm::Function::Create(
+        exceptionType, llvm::Function::ExternalLinkage, "tspp_throw", module);
+    raise->addFnAttr(llvm::Attribute::NoReturn);
+    raise->addFnAttr(llvm::Attribute::Cold);
+  }
 
-    llvm::Function *function = llvm::Function::Create(
-        functionType, llvm::Function::ExternalLinkage, node->getName(), module);
+  if (!module.getFunction("tspp_catch")) {
+    llvm::Function *handle = llvm::Function::Create(
+        exceptionType, llvm::Function::ExternalLinkage, "tspp_catch", module);
+    handle->addFnAttr(llvm::Attribute::NoUnwind);
+  }
 
-    // Set parameter names
-    unsigned idx = 0;
-    for (auto &arg : function->args()) {
-      if (idx < paramNames.size()) {
-        arg.setName(paramNames[idx++]);
-      }
-    }
+  // Strings; the concatenation allocates but never unwinds
+  llvm::PointerType *stringPtrType =
+      typeBuilder_.getStringType()->getPointerTo();
+  if (!module.getFunction("tspp_string_concat")) {
+    llvm::FunctionType *concatType = llvm::FunctionType::get(
+        llvm::Type::getVoidTy(llvmContext),
+        {stringPtrType, stringPtrType, llvm::Type::getInt32Ty(llvmContext)},
+        false);
+    llvm::Function::Create(concatType, llvm::Function::ExternalLinkage,
+                           "tspp_string_concat", module)
+        ->addFnAttr(llvm::Attribute::NoUnwind);
+  }
+  if (!module.getFunction("tspp_string_free")) {
+    llvm::Function::Create(
+        llvm::FunctionType::get(llvm::Type::getVoidTy(llvmContext),
+                                {stringPtrType}, false),
+        llvm::Function::ExternalLinkage, "tspp_string_free", module)
+        ->addFnAttr(llvm::Attribute::NoUnwind);
+  }
+  if (!module.getFunction("tspp_string_equals")) {
+    llvm::FunctionType *equalsType =
+        llvm::FunctionType::get(llvm::Type::getInt32Ty(llvmContext),
+                                {stringPtrType, stringPtrType}, false);
+    llvm::Function *equals =
+        llvm::Function::Create(equalsType, llvm::Function::ExternalLinkage,
+                               "tspp_string_equals", module);
+    equals->addFnAttr(llvm::Attribute::NoUnwind);
+    equals->addFnAttr(llvm::Attribute::ReadOnly);
+    equals->addFnAttr(llvm::Attribute::ArgMemOnly);
+  }
 
-    // Store in function table
-    functionTable_[node->getName()] = function;
+  // Switches over strings confirm a label with memcmp, which LLVM expands
+  // inline for the short constant lengths labels have
+  if (!module.getFunction("memcmp")) {
+    llvm::FunctionType *memcmpType = llvm::FunctionType::get(
+        llvm::Type::getInt32Ty(llvmContext),
+        {llvm::Type::getInt8PtrTy(llvmContext),
+         llvm::Type::getInt8PtrTy(llvmContext),
+         module.getDataLayout().getIntPtrType(llvmContext)},
+        false);
+    llvm::Function *compare = llvm::Function::Create(
+        memcmpType, llvm::Function::ExternalLinkage, "memcmp", module);
+    compare->addFnAttr(llvm::Attribute::NoUnwind);
+    compare->addFnAttr(llvm::Attribute::ReadOnly);
+    compare->addFnAttr(llvm::Attribute::ArgMemOnly);
+  }
 
-    // Create function body if present
-    if (node->getBody()) {
-      llvm::BasicBlock *entryBlock =
-          llvm::BasicBlock::Create(llvmContext, "entry", function);
-      context_.getBuilder().SetInsertPoint(entryBlock);
+  // Growable arrays, passed as tspp_array
+  llvm::Type *int64Type = llvm::Type::getInt64Ty(llvmContext);
+  llvm::PointerType *arrayPtrType =
+      typeBuilder_.getDynamicArrayType(llvm::Type::getInt8Ty(llvmContext))
+          ->getPointerTo();
+  if (!module.getFunction("tspp_array_grow")) {
+    llvm::FunctionType *growType =
+        llvm::FunctionType::get(llvm::Type::getVoidTy(llvmContext),
+                                {arrayPtrType, int64Type, int64Type}, false);
+    llvm::Function *grow = llvm::Function::Create(
+        growType, llvm::Function::ExternalLinkage, "tspp_array_grow", module);
+    grow->addFnAttr(llvm::Attribute::NoUnwind);
+    grow->addFnAttr(llvm::Attribute::Cold);
+  }
+  if (!module.getFunction("tspp_array_reserve")) {
+    llvm::FunctionType *reserveType = llvm::FunctionType::get(
+        llvm::Type::getVoidTy(llvmContext),
+        {arrayPtrType, int64Type, int64Type, int64Type}, false);
+    llvm::Function::Create(reserveType, llvm::Function::ExternalLinkage,
+                           "tspp_array_reserve", module)
+        ->addFnAttr(llvm::Attribute::NoUnwind);
+  }
+  if (!module.getFunction("tspp_array_free")) {
+    llvm::Function::Create(
+        llvm::FunctionType::get(llvm::Type::getVoidTy(llvmContext),
+                                {arrayPtrType}, false),
+        llvm::Function::ExternalLinkage, "tspp_array_free", module)
+        ->addFnAttr(llvm::Attribute::NoUnwind);
+  }
 
-      // Create function scope
-      currentFunction_ =
-          std::make_unique<LLVMFunction>(context_, function, nullptr);
+  // Failed array bounds check
+  if (!module.getFunction("tspp_bounds_fail")) {
+    llvm::Type *intType = llvm::Type::getInt32Ty(llvmContext);
+    llvm::FunctionType *failType = llvm::FunctionType::get(
+        llvm::Type::getVoidTy(llvmContext), {intType, intType, bytePtrType},
+        false);
+    llvm::Function *fail =
+        llvm::Function::Create(failType, llvm::Function::ExternalLinkage,
+                               "tspp_bounds_fail", module);
+    fail->addFnAttr(llvm::Attribute::NoReturn);
+    fail->addFnAttr(llvm::Attribute::NoUnwind);
+    fail->addFnAttr(llvm::Attribute::Cold);
+  }
 
-      // Map parameters to local variables
-      currentFunction_->mapParameters(paramNames);
+  // Host feature test behind multiversioned functions
+  if (!module.getFunction("tspp_cpu_supports")) {
+    llvm::FunctionType *supportsType = llvm::FunctionType::get(
+        llvm::Type::getInt32Ty(llvmContext), {bytePtrType}, false);
+    llvm::Function::Create(supportsType, llvm::Function::ExternalLinkage,
+                           "tspp_cpu_supports", module)
+        ->addFnAttr(llvm::Attribute::NoUnwind);
+  }
 
-      // Visit function body
-      visitBlock(node->getBody().get());
+  // Executor behind async functions; a task is the head of every promise
+  llvm::StructType *taskType =
+      llvm::StructType::getTypeByName(llvmContext, "tspp_task");
+  if (!taskType) {
+    taskType = llvm::StructType::create(
+        llvmContext, {bytePtrType, llvm::Type::getInt32Ty(llvmContext)},
+        "tspp_task");
+  }
+  if (!module.getFunction("tspp_task_complete")) {
+    llvm::FunctionType *completeType =
+        llvm::FunctionType::get(llvm::Type::getInt32Ty(llvmContext),
+                                {taskType->getPointerTo()}, false);
+    llvm::Function::Create(completeType, llvm::Function::ExternalLinkage,
+                           "tspp_task_complete", module)
+        ->addFnAttr(llvm::Attribute::NoUnwind);
+  }
+  if (!module.getFunction("tspp_task_spawn")) {
+    llvm::FunctionType *spawnType = llvm::FunctionType::get(
+        llvm::Type::getVoidTy(llvmContext),
+        {bytePtrType, taskType->getPointerTo()}, false);
+    llvm::Function::Create(spawnType, llvm::Function::ExternalLinkage,
+                           "tspp_task_spawn", module)
+        ->addFnAttr(llvm::Attribute::NoUnwind);
+  }
+  // These run other tasks while they block, so they may throw
+  if (!module.getFunction("tspp_task_run")) {
+    llvm::FunctionType *runType = llvm::FunctionType::get(
+        llvm::Type::getVoidTy(llvmContext), {bytePtrType}, false);
+    llvm::Function::Create(runType, llvm::Function::ExternalLinkage,
+                           "tspp_task_run", module);
+  }
+  if (!module.getFunction("tspp_async_sleep")) {
+    llvm::FunctionType *sleepType = llvm::FunctionType::get(
+        llvm::Type::getVoidTy(llvmContext),
+        {bytePtrType, llvm::Type::getInt32Ty(llvmContext)}, false);
+    llvm::Function::Create(sleepType, llvm::Function::ExternalLinkage,
+                           "tspp_async_sleep", module);
+  }
+  if (!module.getFunction("tspp_async_wait_fd")) {
+    llvm::Type *intType = llvm::Type::getInt32Ty(llvmContext);
+    llvm::FunctionType *waitType =
+        llvm::FunctionType::get(llvm::Type::getVoidTy(llvmContext),
+                                {bytePtrType, intType, intType}, false);
+    llvm::Function::Create(waitType, llvm::Function::ExternalLinkage,
+                           "tspp_async_wait_fd", module);
+  }
 
-      // Ensure function has a return statement
-      llvm::BasicBlock *currentBlock = context_.getBuilder().GetInsertBlock();
-      if (currentBlock && !currentBlock->getTerminator()) {
-        if (returnType->isVoidTy()) {
-          context_.getBuilder().CreateRetVoid();
-        } else {
-          // Return default value for the type
-          llvm::Value *defaultValue = llvm::Constant::getNullValue(returnType);
-          context_.getBuilder().CreateRet(defaultValue);
-        }
-      }
+  // Read-only file mappings behind mapFile
+  if (!module.getFunction("tspp_map_file")) {
+    llvm::FunctionType *mapType = llvm::FunctionType::get(
+        llvm::Type::getVoidTy(llvmContext),
+        {llvm::cast<llvm::StructType>(typeBuilder_.getTypeByName("bytes"))
+             ->getPointerTo(),
+         typeBuilder_.getStringType()->getPointerTo()},
+        false);
+    llvm::Function::Create(mapType, llvm::Function::ExternalLinkage,
+                           "tspp_map_file", module)
+        ->addFnAttr(llvm::Attribute::NoUnwind);
+  }
+  if (!module.getFunction("tspp_unmap_file")) {
+    llvm::FunctionType *unmapType = llvm::FunctionType::get(
+        llvm::Type::getVoidTy(llvmContext),
+        {llvm::Type::getInt8PtrTy(llvmContext),
+         llvm::Type::getInt64Ty(llvmContext)},
+        false);
+    llvm::Function::Create(unmapType, llvm::Function::ExternalLinkage,
+                           "tspp_unmap_file", module)
+        ->addFnAttr(llvm::Attribute::NoUnwind);
+  }
 
-      currentFunction_.reset();
+  // Concurrent containers, passed around as opaque handles
+  llvm::Type *int32Type = llvm::Type::getInt32Ty(llvmContext);
+  llvm::Type *voidType = llvm::Type::getVoidTy(llvmContext);
+  auto declareContainerFunction = [&](const std::string &name,
+                                      llvm::Type *result,
+                                      std::vector<llvm::Type *> params) {
+    if (!module.getFunction(name)) {
+      llvm::Function::Create(llvm::FunctionType::get(result, params, false),
+                             llvm::Function::ExternalLinkage, name, module)
+          ->addFnAttr(llvm::Attribute::NoUnwind);
     }
+  };
+  for (const char *queue : {"tspp_mpmc_", "tspp_spsc_"}) {
+    std::string prefix = queue;
+    declareContainerFunction(prefix + "new", bytePtrType,
+                             {int64Type, int64Type, int64Type});
+    declareContainerFunction(prefix + "try_push", int32Type,
+                             {bytePtrType, bytePtrType});
+    declareContainerFunction(prefix + "try_pop", int32Type,
+                             {bytePtrType, bytePtrType});
+    declareContainerFunction(prefix + "push", voidType,
+                             {bytePtrType, bytePtrType});
+    declareContainerFunction(prefix + "pop", voidType,
+                             {bytePtrType, bytePtrType});
+  }
+  declareContainerFunction("tspp_map_new", bytePtrType,
+                           {int64Type, int64Type});
+  declareContainerFunction("tspp_map_put", voidType,
+                           {bytePtrType, int64Type, bytePtrType});
+  declareContainerFunction("tspp_map_get", int32Type,
+                           {bytePtrType, int64Type, bytePtrType});
+  declareContainerFunction("tspp_map_remove", int32Type,
+                           {bytePtrType, int64Type});
+  declareContainerFunction("tspp_map_size", int64Type, {bytePtrType});
+
+  // Work-stealing scheduler behind #parallel loops
+  if (!module.getFunction("tspp_parallel_for")) {
+    llvm::Type *intType = llvm::Type::getInt32Ty(llvmContext);
+    llvm::FunctionType *forType =
+        llvm::FunctionType::get(llvm::Type::getVoidTy(llvmContext),
+                                {bytePtrType, bytePtrType, intType}, false);
+    llvm::Function::Create(forType, llvm::Function::ExternalLinkage,
+                           "tspp_parallel_for", module)
+        ->addFnAttr(llvm::Attribute::NoUnwind);
+  }
+  if (!module.getFunction("tspp_parallel_uncaught")) {
+    llvm::Function *uncaught = llvm::Function::Create(
+        llvm::FunctionType::get(llvm::Type::getVoidTy(llvmContext), false),
+        llvm::Function::ExternalLinkage, "tspp_parallel_uncaught", module);
+    uncaught->addFnAttr(llvm::Attribute::NoReturn);
+    uncaught->addFnAttr(llvm::Attribute::NoUnwind);
+    uncaught->addFnAttr(llvm::Attribute::Cold);
+  }
 
-    return true;
-  } catch (const std::exception &e) {
-    error(core::SourceLocation(), "Error in function declaration '" +
-                                      node->getName() + "': " + e.what());
-    return false;
+  if (!module.getFunction("tspp_personality")) {
+    llvm::FunctionType *personalityType = llvm::FunctionType::get(
+        llvm::Type::getInt32Ty(llvmContext),
+        {llvm::Type::getInt32Ty(llvmContext),
+         llvm::Type::getInt32Ty(llvmContext),
+         llvm::Type::getInt64Ty(llvmContext), bytePtrType, bytePtrType},
+        false);
+    llvm::Function::Create(personalityType, llvm::Function::ExternalLinkage,
+                           "tspp_personality", module)
+        ->addFnAttr(llvm::Attribute::NoUnwind);
   }
 }
 
-bool LLVMCodeGen::visitGlobalVarDecl(const nodes::VarDeclNode *node) {
-  auto &module = context_.getModule();
+void LLVMCodeGen::declareTypes(const parser::AST &ast) {
   auto &llvmContext = context_.getContext();
-
-  try {
-    // Check if global variable already exists
-    if (module.getGlobalVariable(node->getName())) {
-      error(core::SourceLocation(),
-            "Global variable '" + node->getName() + "' already declared");
-      return false;
+  classHierarchy_.clear();
+  methodFunctions_.clear();
+
+  // Pre-pass to declare all types before generating code. Generics are
+  // laid out per specialization, so they are only collected here.
+  for (nodes::NodePtr node : ast.getNodes()) {
+    // Functions may arrive wrapped in a declaration statement
+    if (auto stmt = nodes::dyn_cast<nodes::DeclarationStmtNode>(node)) {
+      node = stmt->getDeclaration();
     }
-
-    // Determine variable type
-    llvm::Type *varType = llvm::Type::getInt32Ty(llvmContext); // Simplified
-
-    llvm::Constant *initializer = llvm::Constant::getNullValue(varType);
-
-    // Handle initializer if present
-    if (node->getInitializer()) {
-      // Create a temporary function to evaluate the initializer
-      llvm::Function *tempFunc = llvm::Function::Create(
-          llvm::FunctionType::get(llvm::Type::getVoidTy(llvmContext), false),
-          llvm::Function::PrivateLinkage, "__temp_init", module);
-
-      llvm::BasicBlock *tempBlock =
-          llvm::BasicBlock::Create(llvmContext, "entry", tempFunc);
-      context_.getBuilder().SetInsertPoint(tempBlock);
-
-      LLVMValue initValue = visitExpr(node->getInitializer().get());
-      if (initValue.isValid()) {
-        if (auto constant =
-                llvm::dyn_cast<llvm::Constant>(initValue.getValue())) {
-          initializer = constant;
-        }
+    if (auto generic = nodes::dyn_cast<nodes::GenericFunctionDeclNode>(node)) {
+      monomorphizer_.registerFunction(generic);
+    } else if (auto generic =
+                   nodes::dyn_cast<nodes::GenericClassDeclNode>(node)) {
+      monomorphizer_.registerClass(generic);
+    } else if (auto classDecl = nodes::dyn_cast<nodes::ClassDeclNode>(node)) {
+      classHierarchy_.registerClass(classDecl);
+      const auto &modifiers = classDecl->getClassModifiers();
+      if (std::find(modifiers.begin(), modifiers.end(),
+                    tokens::TokenType::SOA) != modifiers.end()) {
+        typeBuilder_.declareStructOfArrays(classDecl->getName());
       }
-
-      // Clean up temporary function
-      tempFunc->eraseFromParent();
+    } else if (auto interfaceDecl =
+                   nodes::dyn_cast<nodes::InterfaceDeclNode>(node)) {
+      classHierarchy_.registerInterface(interfaceDecl);
+    } else if (auto enumDecl = nodes::dyn_cast<nodes::EnumDeclNode>(node)) {
+      visitEnumDecl(enumDecl);
     }
+    // Handle other type declarations as needed
+  }
 
-    llvm::GlobalVariable *globalVar = new llvm::GlobalVariable(
-        module, varType, node->isConst(), llvm::GlobalValue::ExternalLinkage,
-        initializer, node->getName());
-
-    return true;
-  } catch (const std::exception &e) {
-    error(core::SourceLocation(), "Error in global variable declaration '" +
-                                      node->getName() + "': " + e.what());
-    return false;
+  std::string message;
+  if (!classHierarchy_.build(message)) {
+    error(core::SourceLocation(), message);
+    return;
   }
-}
 
-bool LLVMCodeGen::visitTopLevelStatement(const nodes::StatementNode *node) {
-  try {
-    // Store top-level statements to be executed in main
-    if (auto asmStmt = dynamic_cast<const nodes::AssemblyStmtNode *>(node)) {
-      topLevelAssemblyStatements_.push_back(asmStmt);
-      return true;
-    } else if (auto exprStmt =
-                   dynamic_cast<const nodes::ExpressionStmtNode *>(node)) {
-      topLevelExpressionStatements_.push_back(exprStmt);
-      return true;
+  // An interface value is the object and the itable of its class
+  llvm::Type *slotType = llvm::Type::getInt8PtrTy(llvmContext);
+  for (nodes::NodePtr node : ast.getNodes()) {
+    if (auto interfaceDecl = nodes::dyn_cast<nodes::InterfaceDeclNode>(node)) {
+      typeBuilder_.createStructType(interfaceDecl->getName(),
+                                    {{"object", slotType},
+                                     {"itable", slotType->getPointerTo()}});
     }
+  }
 
-    // For other statement types, we might want to handle them differently
-    warning(core::SourceLocation(), "Unsupported top-level statement type");
-    return true;
-  } catch (const std::exception &e) {
-    error(core::SourceLocation(),
-          "Error processing top-level statement: " + std::string(e.what()));
-    return false;
+  // Bases are laid out before the classes that embed them
+  for (const auto *cls : classHierarchy_.getClasses()) {
+    declareClassType(cls);
   }
+  declareMethods();
 }
 
-llvm::Function *LLVMCodeGen::createDefaultMainFunction() {
-  auto &module = context_.getModule();
+void LLVMCodeGen::declareClassType(const LLVMClassHierarchy::ClassInfo *cls) {
   auto &llvmContext = context_.getContext();
-  auto &builder = context_.getBuilder();
-
-  try {
-    // Create main function
-    llvm::FunctionType *mainType =
-        llvm::FunctionType::get(llvm::Type::getInt32Ty(llvmContext), false);
+  const nodes::ClassDeclNode *classDecl = cls->decl;
+
+  std::vector<std::pair<std::string, llvm::Type *>> fields;
+  std::vector<PointerOwnership> ownership; // Of each field, by index
+  if (cls->base) {
+    fields.emplace_back(".base",
+                        typeBuilder_.getTypeByName(cls->base->getName()));
+  } else if (cls->hasVptr) {
+    fields.emplace_back(".vptr",
+                        llvm::Type::getInt8PtrTy(llvmContext)->getPointerTo());
+  }
 
-    llvm::Function *mainFunc = llvm::Function::Create(
-        mainType, llvm::Function::ExternalLinkage, "main", module);
+  for (const auto &member : classDecl->getMembers()) {
+    auto field = nodes::dyn_cast<nodes::FieldDeclNode>(member);
+    if (!field) {
+      continue;
+    }
+    // Classes declared later are held by pointer until they are sized
+    llvm::Type *fieldType = typeBuilder_.convertTypeNode(field->getType());
+    if (!fieldType->isSized()) {
+      fieldType = llvm::PointerType::getUnqual(
+          fieldType->isVoidTy() ? llvm::Type::getInt8Ty(llvmContext)
+                                : fieldType);
+    }
+    fields.emplace_back(field->getName(), fieldType);
+    ownership.resize(fields.size(), PointerOwnership::Raw);
+    ownership.back() = getOwnership(field->getType());
+  }
 
-    llvm::BasicBlock *entry =
-        llvm::BasicBlock::Create(llvmContext, "entry", mainFunc);
-    builder.SetInsertPoint(entry);
+  llvm::StructType *structType = typeBuilder_.createStructType(
+      classDecl->getName(), fields,
+      LLVMTypeBuilder::getClassLayout(classDecl));
+  ownership.resize(fields.size(), PointerOwnership::Raw);
+  fieldOwnership_[structType] = std::move(ownership);
+}
 
-    // Execute any top-level assembly statements
-    for (const auto &asmStmt : topLevelAssemblyStatements_) {
-      if (!visitAssemblyStatement(asmStmt)) {
-        warning(core::SourceLocation(), "Failed to process assembly statement");
+void LLVMCodeGen::declareMethods() {
+  auto &module = context_.getModule();
+  auto &llvmContext = context_.getContext();
+  llvm::Type *slotType = llvm::Type::getInt8PtrTy(llvmContext);
+
+  for (const auto *cls : classHierarchy_.getClasses()) {
+    llvm::Type *thisType =
+        typeBuilder_.getTypeByName(cls->getName())->getPointerTo();
+    for (const auto &member : cls->decl->getMembers()) {
+      auto method = nodes::dyn_cast<nodes::MethodDeclNode>(member);
+      if (!method) {
+        continue;
       }
-    }
-
-    // Execute any top-level expressions
-    for (const auto &exprStmt : topLevelExpressionStatements_) {
-      if (!visitExpressionStatement(exprStmt)) {
-        warning(core::SourceLocation(),
-                "Failed to process expression statement");
+      std::vector<llvm::Type *> paramTypes{thisType};
+      for (const auto &param : method->getParameters()) {
+        paramTypes.push_back(getParameterType(param));
+      }
+      // Unannotated methods return int, like functions
+      llvm::Type *returnType = method->getReturnType()
+                                   ? getReturnType(method->getReturnType())
+                                   : llvm::Type::getInt32Ty(llvmContext);
+
+      std::string name = cls->getName() + "." + method->getName();
+      llvm::Function *function = llvm::Function::Create(
+          llvm::FunctionType::get(returnType, paramTypes, false),
+          method->getBody() ? getDefinitionLinkage(name)
+                            : llvm::Function::ExternalLinkage,
+          name, module);
+      function->getArg(0)->setName("this");
+      for (size_t i = 0; i < method->getParameters().size(); ++i) {
+        function->getArg(i + 1)->setName(method->getParameters()[i]->getName());
+      }
+      applyParameterAttributes(function, method->getParameters(),
+                               method->getModifiers());
+      methodFunctions_[method] = function;
+      if (!method->getThrowsTypes().empty()) {
+        throwingFunctions_.insert(function);
       }
     }
+  }
 
-    // Return 0
-    builder.CreateRet(
-        llvm::ConstantInt::get(llvm::Type::getInt32Ty(llvmContext), 0, true));
-
-    return mainFunc;
-  } catch (const std::exception &e) {
-    error(core::SourceLocation(),
-          "Error creating main function: " + std::string(e.what()));
-    return nullptr;
+  // Every partition emits the same vtables; the linker keeps one copy
+  for (const auto *cls : classHierarchy_.getClasses()) {
+    if (!cls->hasVptr) {
+      continue;
+    }
+    std::vector<llvm::Constant *> entries;
+    for (const auto &name : cls->slots) {
+      auto resolved = classHierarchy_.resolve(cls, name);
+      entries.push_back(llvm::ConstantExpr::getBitCast(
+          methodFunctions_.at(resolved.method), slotType));
+    }
+    auto *vtableType = llvm::ArrayType::get(slotType, entries.size());
+    auto *vtable = new llvm::GlobalVariable(
+        module, vtableType, true, llvm::GlobalValue::LinkOnceODRLinkage,
+        llvm::ConstantArray::get(vtableType, entries),
+        cls->getName() + ".vtable");
+    vtable->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
   }
 }
 
-bool LLVMCodeGen::visitAssemblyStatement(const nodes::AssemblyStmtNode *node) {
-  auto &builder = context_.getBuilder();
-  auto &llvmContext = context_.getContext();
-  auto &module = context_.getModule();
-
+bool LLVMCodeGen::visitTopLevelDeclaration(const nodes::NodePtr &node) {
   try {
-    std::string asmCode = node->getCode();
-
-    // Handle printf calls specially
-    if (isSimplePrintfCall(asmCode)) {
-      llvm::Function *printfFunc = module.getFunction("printf");
-
-      if (printfFunc) {
-        // Extract the string from printf("string")
-        std::string printStr = extractPrintfString(asmCode);
-
-        // Create the string constant
-        llvm::Value *strConstant =
-            LLVMUtils::createGlobalString(context_, printStr, "printf_str");
-
-        // Call printf
-        builder.CreateCall(printfFunc, {strConstant});
-        return true;
-      } else {
-        error(core::SourceLocation(), "printf function not available");
-        return false;
+    switch (node->getNodeKind()) {
+    case nodes::NodeKind::FunctionDecl:
+      return visitFunctionDecl(nodes::cast<nodes::FunctionDeclNode>(node));
+    case nodes::NodeKind::VarDecl:
+      return visitGlobalVarDecl(nodes::cast<nodes::VarDeclNode>(node));
+    case nodes::NodeKind::ClassDecl:
+      visitClassDecl(nodes::cast<nodes::ClassDeclNode>(node));
+      return true;
+    case nodes::NodeKind::InterfaceDecl:
+      visitInterfaceDecl(nodes::cast<nodes::InterfaceDeclNode>(node));
+      return true;
+    case nodes::NodeKind::GenericFunctionDecl:
+    case nodes::NodeKind::GenericClassDecl:
+      // Generated per specialization when first used
+      return true;
+    case nodes::NodeKind::EnumDecl:
+      // Recorded with the other types
+      return true;
+    case nodes::NodeKind::NamespaceDecl:
+      visitNamespaceDecl(nodes::cast<nodes::NamespaceDeclNode>(node));
+      return true;
+    default:
+      if (nodes::isa<nodes::StatementNode>(node)) {
+        return visitTopLevelStatement(nodes::cast<nodes::StatementNode>(node));
       }
+      break;
     }
 
-    // For other assembly code, create inline assembly
-    std::vector<llvm::Type *> asmParamTypes;
-    llvm::FunctionType *asmType = llvm::FunctionType::get(
-        llvm::Type::getVoidTy(llvmContext), asmParamTypes, false);
-
-    llvm::InlineAsm *inlineAsm =
-        llvm::InlineAsm::get(asmType, asmCode, "", true, false);
-
-    builder.CreateCall(inlineAsm);
+    // Unsupported node type - log warning but continue
+    warning(core::SourceLocation(),
+            "Unsupported top-level declaration type encountered");
     return true;
   } catch (const std::exception &e) {
     error(core::SourceLocation(),
-          "Error processing assembly statement: " + std::string(e.what()));
+          "Error processing top-level declaration: " + std::string(e.what()));
     return false;
   }
 }
 
-bool LLVMCodeGen::visitExpressionStatement(
-    const nodes::ExpressionStmtNode *node) {
+bool LLVMCodeGen::visitFunctionDecl(const nodes::FunctionDeclNode *node) {
   try {
-    // Visit the expression (this might have side effects)
-    if (node->getExpression()) {
-      LLVMValue result = visitExpr(node->getExpression().get());
-      return result.isValid() || true; // Allow invalid results for statements
+    // A multiversioned function is generated with its first declaration
+    core::Symbol symbol = core::Interner::instance().intern(node->getName());
+    auto versions = functionVersions_.find(symbol);
+    if (versions != functionVersions_.end()) {
+      return versions->second.front() != node ||
+             emitFunctionVersions(versions->second);
     }
+
+    // Any other declaration of the name, here or in an earlier increment,
+    // is a redeclaration
+    auto declared = declaredFunctions_.find(node);
+    if (declared == declaredFunctions_.end()) {
+      error(node->getLocation(),
+            "Function '" + node->getName() + "' already declared");
+      return false;
+    }
+    llvm::Function *function = declared->second;
+
+    // Create function body if present and owned by this partition; a
+    // whole program's waits until something is found to call it
+    if (hasBodyToEmit(node) && wholeProgram_ && !isEntryPoint(node)) {
+      deferredBodies_.emplace_back(node, function);
+    } else if (hasBodyToEmit(node) &&
+               (!partition_ || partition_->definitions.count(node))) {
+      emitFunctionBody(node, function);
+    }
+
     return true;
   } catch (const std::exception &e) {
-    error(core::SourceLocation(),
-          "Error processing expression statement: " + std::string(e.what()));
+    error(core::SourceLocation(), "Error in function declaration '" +
+                                      node->getName() + "': " + e.what());
     return false;
   }
 }
 
-// String parsing helpers
-std::string LLVMCodeGen::parseStringLiteral(const std::string &input) {
-  std::string result = input;
-
-  // Handle escape sequences
-  std::regex newlineRegex(R"(\\n)");
-  result = std::regex_replace(result, newlineRegex, "\n");
-
-  std::regex tabRegex(R"(\\t)");
-  result = std::regex_replace(result, tabRegex, "\t");
+llvm::Function *LLVMCodeGen::createFunction(const nodes::FunctionDeclNode *node,
+                                            const std::string &name) {
+  std::vector<llvm::Type *> paramTypes;
+  for (const auto &param : node->getParameters()) {
+    paramTypes.push_back(getParameterType(param));
+  }
 
-  std::regex backslashRegex(R"(\\\\)");
-  result = std::regex_replace(result, backslashRegex, "\\");
+  // Unannotated functions return int
+  llvm::Type *returnType = llvm::Type::getInt32Ty(context_.getContext());
+  if (node->getReturnType()) {
+    returnType = getReturnType(node->getReturnType());
+  }
 
-  std::regex quoteRegex(R"(\\")");
-  result = std::regex_replace(result, quoteRegex, "\"");
+  // The ramp of an async function returns its coroutine; the result is
+  // read from the promise
+  if (node->isAsync()) {
+    asyncResults_[core::Interner::instance().intern(node->getName())] =
+        returnType;
+    returnType = llvm::Type::getInt8PtrTy(context_.getContext());
+  }
 
-  return result;
+  llvm::FunctionType *functionType =
+      llvm::FunctionType::get(returnType, paramTypes, false);
+  llvm::Function *function = llvm::Function::Create(
+      functionType,
+      hasBodyToEmit(node) && !isEntryPoint(node)
+          ? getDefinitionLinkage(name)
+          : llvm::Function::ExternalLinkage,
+      name, context_.getModule());
+
+  unsigned idx = 0;
+  for (auto &arg : function->args()) {
+    arg.setName(node->getParameters()[idx++]->getName());
+  }
+  applyParameterAttributes(function, node->getParameters(),
+                           node->getModifiers());
+  return function;
 }
 
-bool LLVMCodeGen::isSimplePrintfCall(const std::string &asmCode) {
-  // Check if it's a simple printf call: printf("...")
-  std::regex printfRegex(R"(printf\s*\(\s*\".*\"\s*\))");
-  return std::regex_match(asmCode, printfRegex);
+llvm::Type *LLVMCodeGen::getParameterType(const nodes::ParameterNode *param) {
+  llvm::Type *type = getStorageType(param->getType());
+  return param->isRef() ? type->getPointerTo() : type;
 }
 
-std::string LLVMCodeGen::extractPrintfString(const std::string &asmCode) {
-  // Extract string from printf("string")
-  std::regex stringRegex(R"(printf\s*\(\s*\"(.*)\"\s*\))");
-  std::smatch match;
-
-  if (std::regex_search(asmCode, match, stringRegex)) {
-    return parseStringLiteral(match[1].str());
+void LLVMCodeGen::applyParameterAttributes(
+    llvm::Function *function, const std::vector<nodes::ParamPtr> &params,
+    const std::vector<tokens::TokenType> &modifiers) {
+  const llvm::DataLayout &layout = context_.getModule().getDataLayout();
+  bool noAlias = std::find(modifiers.begin(), modifiers.end(),
+                           tokens::TokenType::NOALIAS) != modifiers.end();
+  unsigned first = function->arg_size() - params.size();
+  for (size_t i = 0; i < params.size(); ++i) {
+    llvm::Argument *arg = function->getArg(first + i);
+    if (params[i]->isRef()) {
+      // The checker keeps the other arguments of a call off a ref's
+      // storage, but the callee may still reach it as a global or through
+      // a pointer it loads, so only #noalias makes the address noalias
+      llvm::Type *type = getStorageType(params[i]->getType());
+      if (noAlias) {
+        arg->addAttr(llvm::Attribute::NoAlias);
+      }
+      arg->addAttr(llvm::Attribute::NoCapture);
+      arg->addAttr(llvm::Attribute::NonNull);
+      if (uint64_t size = layout.getTypeAllocSize(type)) {
+        arg->addAttr(llvm::Attribute::getWithDereferenceableBytes(
+            function->getContext(), size));
+      }
+      arg->addAttr(llvm::Attribute::getWithAlignment(
+          function->getContext(), typeBuilder_.getAlignment(type)));
+    } else if (noAlias && arg->getType()->isPointerTy()) {
+      arg->addAttr(llvm::Attribute::NoAlias);
+    }
   }
-
-  return "";
-}
-
-// Utility methods for loop management
-void LLVMCodeGen::pushLoop(llvm::BasicBlock *continueDest,
-                           llvm::BasicBlock *breakDest) {
-  loopStack_.push({continueDest, breakDest});
 }
 
-void LLVMCodeGen::popLoop() {
-  if (!loopStack_.empty()) {
-    loopStack_.pop();
+bool LLVMCodeGen::isRefArgument(const nodes::CallExpressionNode *node,
+                                size_t index) const {
+  auto calleeType = node->getCallee()->getResolvedType();
+  if (!calleeType ||
+      calleeType->getKind() != visitors::ResolvedType::TypeKind::Function ||
+      index >= calleeType->getParameterTypes().size()) {
+    return false;
   }
+  return calleeType->getParameterTypes()[index]->getKind() ==
+         visitors::ResolvedType::TypeKind::Reference;
 }
 
-LLVMCodeGen::LoopInfo *LLVMCodeGen::getCurrentLoop() {
-  if (loopStack_.empty()) {
+llvm::Function *
+LLVMCodeGen::declareCFunction(const nodes::FunctionDeclNode *node) {
+  auto &module = context_.getModule();
+  auto &llvmContext = context_.getContext();
+  const std::string &name = node->getName();
+
+  llvm::Type *resultType = llvm::Type::getVoidTy(llvmContext);
+  if (node->getReturnType()) {
+    resultType = getReturnType(node->getReturnType());
+  }
+  std::vector<llvm::Type *> paramTypes;
+  for (const auto &param : node->getParameters()) {
+    paramTypes.push_back(getStorageType(param->getType()));
+  }
+  CABISignature signature =
+      CABILowering(target_.getTriple(), module.getDataLayout())
+          .lower(resultType, paramTypes, node->isVariadic());
+
+  // C allows the same prototype twice, and the runtime's own
+  // declarations, such as printf's, are shared
+  core::Symbol symbol = core::Interner::instance().intern(name);
+  llvm::Function *function = module.getFunction(name);
+  bool tsppFunction =
+      (functionTable_.count(symbol) && !cFunctions_.count(symbol)) ||
+      incrementFunctions_.count(symbol);
+  if (tsppFunction || (function && (!function->isDeclaration() ||
+                                    function->getFunctionType() !=
+                                        signature.type))) {
+    error(core::SourceLocation(),
+          "C function '" + name + "' conflicts with another declaration");
     return nullptr;
   }
-  return &loopStack_.top();
+  if (!function) {
+    function = llvm::Function::Create(
+        signature.type, llvm::Function::ExternalLinkage, name, module);
+    if (options_.isWasm()) {
+      function->addFnAttr("wasm-import-module", "env");
+      function->addFnAttr("wasm-import-name", name);
+    }
+  }
+  function->setAttributes(
+      function->getAttributes().addFnAttribute(llvmContext,
+                                               llvm::Attribute::NoUnwind));
+  llvm::AttributeList abi = signature.getAttributes(llvmContext);
+  for (unsigned i = 0; i < function->arg_size(); ++i) {
+    function->addParamAttrs(i, llvm::AttrBuilder(llvmContext,
+                                                 abi.getParamAttrs(i)));
+  }
+  function->addRetAttrs(llvm::AttrBuilder(llvmContext, abi.getRetAttrs()));
+
+  cFunctions_[symbol] = std::move(signature);
+  declaredFunctions_[node] = function;
+  functionTable_[symbol] = function;
+  return function;
 }
 
-std::string LLVMCodeGen::getCurrentNamespacePrefix() const {
-  if (currentNamespace_.empty()) {
-    return "";
+void LLVMCodeGen::collectFunctionVersions(const parser::AST &ast) {
+  functionVersions_.clear();
+  std::unordered_map<core::Symbol, std::vector<const nodes::FunctionDeclNode *>>
+      byName;
+  for (nodes::NodePtr node : ast.getNodes()) {
+    if (auto stmt = nodes::dyn_cast<nodes::DeclarationStmtNode>(node)) {
+      node = stmt->getDeclaration();
+    }
+    if (node->getNodeKind() == nodes::NodeKind::FunctionDecl) {
+      auto function = nodes::cast<nodes::FunctionDeclNode>(node);
+      byName[core::Interner::instance().intern(function->getName())]
+          .push_back(function);
+    }
   }
 
-  std::stringstream ss;
-  for (size_t i = 0; i < currentNamespace_.size(); ++i) {
-    if (i > 0)
-      ss << "::";
-    ss << currentNamespace_[i];
+  // Repeated declarations without #target stay redeclaration errors
+  for (auto &entry : byName) {
+    const auto &declarations = entry.second;
+    if (declarations.size() > 1 &&
+        std::any_of(declarations.begin(), declarations.end(),
+                    [](const nodes::FunctionDeclNode *declaration) {
+                      return !declaration->getTarget().empty();
+                    })) {
+      functionVersions_.insert(std::move(entry));
+    }
   }
-  ss << "::";
-  return ss.str();
 }
 
-// Core visitor implementations
-LLVMValue LLVMCodeGen::visitVarDecl(const nodes::VarDeclNode *node,
-                                    bool isGlobal) {
-  if (isGlobal) {
-    visitGlobalVarDecl(node);
-    return LLVMValue();
+void LLVMCodeGen::declareFunctions(const parser::AST &ast) {
+  auto &module = context_.getModule();
+  declaredFunctions_.clear();
+  for (nodes::NodePtr node : ast.getNodes()) {
+    if (auto stmt = nodes::dyn_cast<nodes::DeclarationStmtNode>(node)) {
+      node = stmt->getDeclaration();
+    }
+    if (node->getNodeKind() != nodes::NodeKind::FunctionDecl) {
+      continue;
+    }
+    auto decl = nodes::cast<nodes::FunctionDeclNode>(node);
+    core::Symbol symbol = core::Interner::instance().intern(decl->getName());
+    if (decl->isExternC()) {
+      declareCFunction(decl);
+      continue;
+    }
+    if (functionVersions_.count(symbol) || module.getFunction(decl->getName()) ||
+        incrementFunctions_.count(symbol)) {
+      continue;
+    }
+
+    llvm::Function *function = createFunction(decl, decl->getName());
+    if (options_.isWasm()) {
+      // Top-level functions are the module's exports
+      function->addFnAttr("wasm-export-name", decl->getName());
+    }
+    declaredFunctions_[decl] = function;
+    functionTable_[symbol] = function;
+    if (!decl->getThrowsTypes().empty()) {
+      throwingFunctions_.insert(function);
+    }
   }
+}
 
-  // Local variable declaration
-  auto &builder = context_.getBuilder();
+bool LLVMCodeGen::emitFunctionVersions(
+    const std::vector<const nodes::FunctionDeclNode *> &versions) {
+  auto &module = context_.getModule();
   auto &llvmContext = context_.getContext();
+  auto &builder = context_.getBuilder();
+  const std::string &name = versions.front()->getName();
+  const int errorsBefore = errorReporter_.errorCount();
+
+  core::Symbol symbol = core::Interner::instance().intern(name);
+  if (module.getFunction(name) || incrementFunctions_.count(symbol)) {
+    error(versions.front()->getLocation(),
+          "Function '" + name + "' already declared");
+    return false;
+  }
 
-  // Determine variable type (simplified)
-  llvm::Type *varType = llvm::Type::getInt32Ty(llvmContext);
+  struct Version {
+    llvm::Function *function;
+    std::string features; ///< Enabled features the host must support
+    size_t rank;          ///< Feature count, implied features included
+  };
+  std::vector<Version> candidates;
+  llvm::Function *fallback = nullptr;
+  std::unordered_set<std::string> seen;
+  llvm::FunctionType *signature = nullptr;
+  bool throws = false;
+
+  llvm::TargetMachine *machine = target_.getTargetMachine();
+  for (const auto *node : versions) {
+    std::vector<std::string> enabled;
+    if (!node->getTarget().empty()) {
+      TargetSpec spec = parseTarget(name, node->getTarget());
+      if (!spec.cpu.empty()) {
+        error(node->getLocation(),
+              "Versions of '" + name +
+                  "' cannot select a CPU; name the features they need");
+      }
+      for (const auto &feature : spec.features) {
+        if (feature[0] == '+') {
+          enabled.push_back(feature.substr(1));
+        }
+      }
+      if (enabled.empty()) {
+        error(node->getLocation(),
+              "Version #target(\"" + node->getTarget() + "\") of '" + name +
+                  "' enables no instruction set to dispatch on");
+        continue;
+      }
+    } else if (fallback) {
+      error(node->getLocation(),
+            "Function '" + name + "' has more than one default version");
+      continue;
+    }
 
-  // Create allocation
-  llvm::AllocaInst *alloca =
-      builder.CreateAlloca(varType, nullptr, node->getName());
+    std::sort(enabled.begin(), enabled.end());
+    enabled.erase(std::unique(enabled.begin(), enabled.end()), enabled.end());
+    std::string features;
+    std::string suffix = enabled.empty() ? "default" : "";
+    for (const auto &feature : enabled) {
+      features += (features.empty() ? "" : ",") + feature;
+      suffix += (suffix.empty() ? "" : "_") + feature;
+    }
+    if (!seen.insert(suffix).second) {
+      error(node->getLocation(),
+            "Function '" + name + "' has two versions for " + suffix);
+      continue;
+    }
 
-  // Handle initializer
-  if (node->getInitializer()) {
-    LLVMValue initValue = visitExpr(node->getInitializer().get());
-    if (initValue.isValid()) {
-      llvm::Value *loaded = initValue.loadIfLValue(builder).getValue();
-      builder.CreateStore(loaded, alloca);
+    llvm::Function *function = createFunction(node, name + "." + suffix);
+    if (!signature) {
+      signature = function->getFunctionType();
+    } else if (function->getFunctionType() != signature) {
+      error(node->getLocation(),
+            "Versions of '" + name + "' must have the same signature");
     }
+    if (!node->getThrowsTypes().empty()) {
+      throws = true;
+      throwingFunctions_.insert(function);
+    }
+    if (hasBodyToEmit(node) &&
+        (!partition_ || partition_->definitions.count(node))) {
+      emitFunctionBody(node, function);
+    }
+
+    if (enabled.empty()) {
+      fallback = function;
+      continue;
+    }
+
+    // Versions that enable more, counting what their features imply, are
+    // tried first; the host's own features must not weigh in
+    size_t rank = enabled.size();
+    if (machine) {
+      std::string implied;
+      for (const auto &feature : enabled) {
+        implied += (implied.empty() ? "+" : ",+") + feature;
+      }
+      std::unique_ptr<llvm::MCSubtargetInfo> subtarget(
+          machine->getTarget().createMCSubtargetInfo(
+              machine->getTargetTriple().str(), "generic", implied));
+      if (subtarget) {
+        rank = subtarget->getFeatureBits().count();
+      }
+    }
+    candidates.push_back({function, features, rank});
   }
 
-  // Register variable in current scope
-  if (currentFunction_) {
-    LLVMValue varValue(alloca, nullptr, true); // It's an lvalue
-    currentFunction_->declareVariable(node->getName(), varValue);
+  if (!fallback) {
+    error(versions.front()->getLocation(),
+          "Function '" + name +
+              "' has #target versions but no default version");
+  }
+  if (errorReporter_.errorCount() != errorsBefore) {
+    return false;
+  }
+  std::stable_sort(candidates.begin(), candidates.end(),
+                   [](const Version &a, const Version &b) {
+                     return a.rank > b.rank;
+                   });
+
+  llvm::FunctionType *type = signature;
+  llvm::Function *dispatcher = createFunction(versions.front(), name);
+  functionTable_[symbol] = dispatcher;
+  if (throws) {
+    throwingFunctions_.insert(dispatcher);
+  }
+  if (partition_ && !partition_->ownsEntry) {
+    return true;
   }
 
-  return LLVMValue(alloca, nullptr, true);
+  // The pointer starts at the resolver, so no call sees it unset
+  llvm::Function *resolver = createFunction(versions.front(), name + ".resolve");
+  resolver->setLinkage(llvm::Function::InternalLinkage);
+  llvm::PointerType *pointerType = type->getPointerTo();
+  auto *resolved = new llvm::GlobalVariable(
+      module, pointerType, false, llvm::GlobalValue::InternalLinkage, resolver,
+      name + ".resolved");
+
+  // Both forward their arguments with a tail call the version returns from
+  auto forward = [&](llvm::Function *from, llvm::Value *callee) {
+    std::vector<llvm::Value *> args;
+    for (auto &arg : from->args()) {
+      args.push_back(&arg);
+    }
+    llvm::CallInst *call = builder.CreateCall(type, callee, args);
+    call->setTailCallKind(llvm::CallInst::TCK_MustTail);
+    if (type->getReturnType()->isVoidTy()) {
+      builder.CreateRetVoid();
+    } else {
+      builder.CreateRet(call);
+    }
+  };
+
+  builder.SetInsertPoint(
+      llvm::BasicBlock::Create(llvmContext, "entry", dispatcher));
+  llvm::LoadInst *current = builder.CreateLoad(pointerType, resolved, "impl");
+  current->setAtomic(llvm::AtomicOrdering::Monotonic);
+  forward(dispatcher, current);
+
+  // Racing first calls pick the same version, so plain atomics suffice
+  builder.SetInsertPoint(
+      llvm::BasicBlock::Create(llvmContext, "entry", resolver));
+  llvm::BasicBlock *chosen = llvm::BasicBlock::Create(llvmContext, "chosen");
+  std::vector<std::pair<llvm::Function *, llvm::BasicBlock *>> incoming;
+  llvm::Function *supports = module.getFunction("tspp_cpu_supports");
+  for (const auto &version : candidates) {
+    llvm::Value *supported = builder.CreateCall(
+        supports, {builder.CreateGlobalStringPtr(version.features,
+                                                 name + ".features")});
+    llvm::BasicBlock *next =
+        llvm::BasicBlock::Create(llvmContext, "next", resolver);
+    builder.CreateCondBr(builder.CreateICmpNE(
+                             supported, builder.getInt32(0)),
+                         chosen, next);
+    incoming.emplace_back(version.function, builder.GetInsertBlock());
+    builder.SetInsertPoint(next);
+  }
+  builder.CreateBr(chosen);
+  incoming.emplace_back(fallback, builder.GetInsertBlock());
+
+  chosen->insertInto(resolver);
+  builder.SetInsertPoint(chosen);
+  llvm::PHINode *choice =
+      builder.CreatePHI(pointerType, incoming.size(), "version");
+  for (const auto &entry : incoming) {
+    choice->addIncoming(entry.first, entry.second);
+  }
+  builder.CreateStore(choice, resolved)
+      ->setAtomic(llvm::AtomicOrdering::Monotonic);
+  forward(resolver, choice);
+  return true;
 }
 
-LLVMValue LLVMCodeGen::visitBlock(const nodes::BlockNode *node) {
-  // Enter new scope
-  if (currentFunction_) {
-    currentFunction_->enterScope();
+void LLVMCodeGen::emitFunctionBody(const nodes::FunctionDeclNode *node,
+                                   llvm::Function *function) {
+  // The stream reports why a body did not load, which fails generation
+  bool streamed = bodyStream_ && bodyStream_->streams(node);
+  if (streamed && !bodyStream_->load(node)) {
+    return;
+  }
+  emitBody(function, node->getParameters(), node->getReturnType(),
+           node->getModifiers(), node->getTarget(), node->getBody(), false,
+           node->isAsync());
+  if (streamed) {
+    bodyStream_->release(node);
   }
+}
 
-  LLVMValue lastValue;
-  for (const auto &stmt : node->getStatements()) {
-    lastValue = visitStmt(stmt.get());
+void LLVMCodeGen::emitBody(llvm::Function *function,
+                           const std::vector<nodes::ParamPtr> &params,
+                           const nodes::TypeNode *returnTypeNode,
+                           const std::vector<tokens::TokenType> &modifiers,
+                           const std::string &target,
+                           const nodes::BlockNode *body, bool isMethod,
+                           bool isAsync, const ClosureEnv *env) {
+  applyFunctionAttributes(function, modifiers, target);
+  if (options_.isInstrumentHooksEnabled()) {
+    // Expanded by the code generator, after inlining
+    function->addFnAttr("instrument-function-entry-inlined",
+                        "__cyg_profile_func_enter");
+    function->addFnAttr("instrument-function-exit-inlined",
+                        "__cyg_profile_func_exit");
+  }
+  llvm::BasicBlock *entryBlock =
+      llvm::BasicBlock::Create(context_.getContext(), "entry", function);
+  context_.getBuilder().SetInsertPoint(entryBlock);
+  if (debugInfo_) {
+    debugInfo_->beginFunction(function, body->getLocation());
+    debugInfo_->setLocation(context_.getBuilder(), body->getLocation());
   }
 
-  // Exit scope
-  if (currentFunction_) {
-    currentFunction_->exitScope();
+  // Create function scope
+  currentFunction_ =
+      std::make_unique<LLVMFunction>(context_, function, nullptr);
+  currentReturnType_ = returnTypeNode;
+  tryStack_.clear();
+  exceptionSlot_ = selectorSlot_ = nullptr;
+  resumeBlock_ = landingPad_ = nullptr;
+  if (isAsync) {
+    beginCoroutine(returnTypeNode
+                       ? getReturnType(returnTypeNode)
+                       : llvm::Type::getInt32Ty(context_.getContext()));
   }
 
-  return lastValue;
+  // Map parameters to local variables; `this` is a keyword, so it cannot
+  // clash with a parameter. A closure's environment comes first.
+  std::vector<std::string> paramNames;
+  std::vector<bool> refParams;
+  if (isMethod || env) {
+    paramNames.push_back(isMethod ? "this" : "");
+    refParams.push_back(false);
+  }
+  for (const auto &param : params) {
+    paramNames.push_back(param->getName());
+    refParams.push_back(param->isRef());
+  }
+  currentFunction_->mapParameters(paramNames, refParams);
+  if (env) {
+    // Captures are read from the environment, which the closure borrows
+    auto &builder = context_.getBuilder();
+    llvm::Argument *envArg = function->getArg(0);
+    envArg->setName("env");
+    llvm::Value *fields =
+        env->type ? builder.CreateBitCast(envArg, env->type->getPointerTo(),
+                                          "captures")
+                  : nullptr;
+    for (size_t i = 0; i < env->captures.size(); ++i) {
+      const auto &capture = env->captures[i];
+      LLVMValue captured(
+          builder.CreateStructGEP(env->type, fields, i, capture.first.str()),
+          capture.second.getType(), true);
+      captured.setPointeeAlignment(capture.second.getPointeeAlignment());
+      currentFunction_->declareVariable(capture.first, captured);
+    }
+  }
+  if (debugInfo_) {
+    size_t implicit = isMethod || env ? 1 : 0;
+    for (size_t i = env ? 1 : 0; i < paramNames.size(); ++i) {
+      // `this` is declared where the method is
+      const core::SourceLocation &location =
+          i < implicit ? body->getLocation()
+                       : params[i - implicit]->getLocation();
+      LLVMValue slot = currentFunction_->getVariable(
+          core::Interner::instance().intern(paramNames[i]));
+      if (auto alloca = llvm::dyn_cast_or_null<llvm::AllocaInst>(
+              slot.getValue())) {
+        debugInfo_->declareVariable(paramNames[i], alloca, location,
+                                    entryBlock, i + 1);
+      }
+    }
+  }
+
+  if (instrumentation_ && options_.isInstrumentFunctionsEnabled()) {
+    instrumentation_->countFunction(context_.getBuilder(),
+                                    function->getName().str(),
+                                    body->getLocation());
+  }
+
+  // Loops in #simd functions carry vectorization hints
+  simdFunction_ = std::find(modifiers.begin(), modifiers.end(),
+                            tokens::TokenType::SIMD) != modifiers.end();
+
+  uncheckedFunction_ = std::find(modifiers.begin(), modifiers.end(),
+                                 tokens::TokenType::UNSAFE) != modifiers.end();
+
+  tailCallFunction_ = std::find(modifiers.begin(), modifiers.end(),
+                                tokens::TokenType::TAILCALL) != modifiers.end();
+
+  // Visit function body
+  visitBlock(body);
+  simdFunction_ = false;
+  uncheckedFunction_ = false;
+  tailCallFunction_ = false;
+
+  // Ensure function has a return statement
+  llvm::Type *returnType = function->getReturnType();
+  llvm::BasicBlock *currentBlock = context_.getBuilder().GetInsertBlock();
+  if (coroutine_.handle) {
+    auto &builder = context_.getBuilder();
+    if (currentBlock && !currentBlock->getTerminator()) {
+      if (!coroutine_.resultType->isVoidTy()) {
+        builder.CreateStore(
+            llvm::Constant::getNullValue(coroutine_.resultType),
+            builder.CreateStructGEP(getPromiseType(coroutine_.resultType),
+                                    coroutine_.promise, 1));
+      }
+      builder.CreateBr(coroutine_.finalBlock);
+    }
+    endCoroutine();
+  } else if (currentBlock && !currentBlock->getTerminator()) {
+    if (returnType->isVoidTy()) {
+      context_.getBuilder().CreateRetVoid();
+    } else {
+      // Return default value for the type
+      llvm::Value *defaultValue = llvm::Constant::getNullValue(returnType);
+      context_.getBuilder().CreateRet(defaultValue);
+    }
+  }
+
+  // Drop the blocks that statements after a return or break were put in
+  llvm::removeUnreachableBlocks(*function);
+
+  // A function that can only throw is off its callers' hot paths
+  bool returns = false;
+  bool throws = false;
+  for (const auto &inst : llvm::instructions(function)) {
+    if (llvm::isa<llvm::ReturnInst>(inst)) {
+      returns = true;
+    } else if (auto call = llvm::dyn_cast<llvm::CallBase>(&inst)) {
+      llvm::Function *callee = call->getCalledFunction();
+      throws |= callee && callee->getName() == "tspp_throw";
+    }
+  }
+  if (throws && !returns &&
+      !function->hasFnAttribute(llvm::Attribute::AlwaysInline)) {
+    function->addFnAttr(llvm::Attribute::Cold);
+    function->addFnAttr(llvm::Attribute::NoInline);
+  }
+
+  currentFunction_.reset();
+  currentReturnType_ = nullptr;
+  if (debugInfo_) {
+    debugInfo_->endFunction(context_.getBuilder());
+  }
 }
 
-LLVMValue LLVMCodeGen::visitStmt(const nodes::StatementNode *node) {
-  if (auto exprStmt = dynamic_cast<const nodes::ExpressionStmtNode *>(node)) {
-    return visitExprStmt(exprStmt);
-  } else if (auto blockStmt = dynamic_cast<const nodes::BlockNode *>(node)) {
-    return visitBlock(blockStmt);
-  } else if (auto asmStmt =
-                 dynamic_cast<const nodes::AssemblyStmtNode *>(node)) {
-    visitAssemblyStatement(asmStmt);
-    return LLVMValue();
-  } else if (auto declStmt =
-                 dynamic_cast<const nodes::DeclarationStmtNode *>(node)) {
-    return visitDeclStmt(declStmt);
-  } else if (auto returnStmt =
-                 dynamic_cast<const nodes::ReturnStmtNode *>(node)) {
-    return visitReturnStmt(returnStmt);
+void LLVMCodeGen::beginCoroutine(llvm::Type *resultType) {
+  auto &builder = context_.getBuilder();
+  auto &llvmContext = context_.getContext();
+  auto &module = context_.getModule();
+  llvm::Function *function = builder.GetInsertBlock()->getParent();
+  llvm::PointerType *bytePtrType = builder.getInt8PtrTy();
+
+  // Every pipeline, -O0 included, splits functions marked this way
+  function->addFnAttr("coroutine.presplit", "0");
+
+  llvm::StructType *promiseType = getPromiseType(resultType);
+  llvm::Align align = module.getDataLayout().getABITypeAlign(promiseType);
+  coroutine_ = CoroutineInfo();
+  coroutine_.resultType = resultType;
+  coroutine_.promise = createEntryAlloca(promiseType, "promise");
+  llvm::Value *null = llvm::ConstantPointerNull::get(bytePtrType);
+  coroutine_.id = builder.CreateCall(
+      llvm::Intrinsic::getDeclaration(&module, llvm::Intrinsic::coro_id),
+      {builder.getInt32(align.value()),
+       builder.CreateBitCast(coroutine_.promise, bytePtrType), null, null},
+      "coro.id");
+
+  // CoroElide replaces coro.alloc with false where the caller holds the
+  // frame
+  llvm::BasicBlock *entry = builder.GetInsertBlock();
+  auto *allocBlock =
+      llvm::BasicBlock::Create(llvmContext, "coro.alloc", function);
+  auto *beginBlock =
+      llvm::BasicBlock::Create(llvmContext, "coro.begin", function);
+  builder.CreateCondBr(
+      builder.CreateCall(
+          llvm::Intrinsic::getDeclaration(&module, llvm::Intrinsic::coro_alloc),
+          {coroutine_.id}, "coro.needs.frame"),
+      allocBlock, beginBlock);
+
+  // LLVM 14 does not report the frame's alignment; 16 covers every type
+  builder.SetInsertPoint(allocBlock);
+  llvm::Value *size = builder.CreateCall(
+      llvm::Intrinsic::getDeclaration(&module, llvm::Intrinsic::coro_size,
+                                      {builder.getInt64Ty()}),
+      {}, "coro.size");
+  llvm::Value *allocated =
+      builder.CreateCall(module.getFunction("tspp_alloc"),
+                         {size, builder.getInt64(16)}, "coro.frame");
+  builder.CreateBr(beginBlock);
+
+  builder.SetInsertPoint(beginBlock);
+  llvm::PHINode *frame = builder.CreatePHI(bytePtrType, 2, "frame");
+  frame->addIncoming(null, entry);
+  frame->addIncoming(allocated, allocBlock);
+  coroutine_.handle = builder.CreateCall(
+      llvm::Intrinsic::getDeclaration(&module, llvm::Intrinsic::coro_begin),
+      {coroutine_.id, frame}, "coro.handle");
+  builder.CreateStore(
+      llvm::Constant::getNullValue(promiseType->getElementType(0)),
+      builder.CreateStructGEP(promiseType, coroutine_.promise, 0));
+
+  coroutine_.finalBlock = llvm::BasicBlock::Create(llvmContext, "coro.final");
+  coroutine_.cleanupBlock =
+      llvm::BasicBlock::Create(llvmContext, "coro.cleanup");
+  coroutine_.endBlock = llvm::BasicBlock::Create(llvmContext, "coro.end");
+}
+
+void LLVMCodeGen::endCoroutine() {
+  auto &builder = context_.getBuilder();
+  auto &llvmContext = context_.getContext();
+  auto &module = context_.getModule();
+  llvm::Function *function = builder.GetInsertBlock()->getParent();
+  llvm::StructType *promiseType = getPromiseType(coroutine_.resultType);
+
+  // Completing wakes the awaiting coroutine; a detached task has nobody
+  // left to destroy it, so it frees itself
+  coroutine_.finalBlock->insertInto(function);
+  builder.SetInsertPoint(coroutine_.finalBlock);
+  llvm::Value *detached = builder.CreateCall(
+      module.getFunction("tspp_task_complete"),
+      {builder.CreateStructGEP(promiseType, coroutine_.promise, 0)},
+      "detached");
+  auto *suspendBlock =
+      llvm::BasicBlock::Create(llvmContext, "coro.final.suspend", function);
+  builder.CreateCondBr(builder.CreateIsNotNull(detached),
+                       coroutine_.cleanupBlock, suspendBlock);
+
+  // The final suspend point, where the awaiting side finds the coroutine
+  // done; it is never resumed from there
+  builder.SetInsertPoint(suspendBlock);
+  llvm::Value *suspend = builder.CreateCall(
+      llvm::Intrinsic::getDeclaration(&module, llvm::Intrinsic::coro_suspend),
+      {llvm::ConstantTokenNone::get(llvmContext), builder.getTrue()},
+      "coro.suspend");
+  auto *unreachable =
+      llvm::BasicBlock::Create(llvmContext, "coro.final.resume", function);
+  llvm::SwitchInst *dispatch =
+      builder.CreateSwitch(suspend, coroutine_.endBlock, 2);
+  dispatch->addCase(builder.getInt8(0), unreachable);
+  dispatch->addCase(builder.getInt8(1), coroutine_.cleanupBlock);
+  builder.SetInsertPoint(unreachable);
+  builder.CreateUnreachable();
+
+  // coro.free is null where CoroElide put the frame in the caller
+  coroutine_.cleanupBlock->insertInto(function);
+  builder.SetInsertPoint(coroutine_.cleanupBlock);
+  builder.CreateCall(
+      module.getFunction("tspp_free"),
+      {builder.CreateCall(
+          llvm::Intrinsic::getDeclaration(&module, llvm::Intrinsic::coro_free),
+          {coroutine_.id, coroutine_.handle}, "coro.memory")});
+  builder.CreateBr(coroutine_.endBlock);
+
+  coroutine_.endBlock->insertInto(function);
+  builder.SetInsertPoint(coroutine_.endBlock);
+  builder.CreateCall(
+      llvm::Intrinsic::getDeclaration(&module, llvm::Intrinsic::coro_end),
+      {coroutine_.handle, builder.getFalse()});
+  builder.CreateRet(coroutine_.handle);
+  coroutine_ = CoroutineInfo();
+}
+
+void LLVMCodeGen::emitSuspend() {
+  auto &builder = context_.getBuilder();
+  auto &llvmContext = context_.getContext();
+  llvm::Function *function = builder.GetInsertBlock()->getParent();
+  llvm::Value *suspend = builder.CreateCall(
+      llvm::Intrinsic::getDeclaration(&context_.getModule(),
+                                      llvm::Intrinsic::coro_suspend),
+      {llvm::ConstantTokenNone::get(llvmContext), builder.getFalse()},
+      "coro.suspend");
+  auto *resumed = llvm::BasicBlock::Create(llvmContext, "resume", function);
+  llvm::SwitchInst *dispatch =
+      builder.CreateSwitch(suspend, coroutine_.endBlock, 2);
+  dispatch->addCase(builder.getInt8(0), resumed);
+  dispatch->addCase(builder.getInt8(1), coroutine_.cleanupBlock);
+  builder.SetInsertPoint(resumed);
+}
+
+llvm::StructType *LLVMCodeGen::getPromiseType(llvm::Type *resultType) {
+  llvm::StructType *taskType = llvm::StructType::getTypeByName(
+      context_.getContext(), "tspp_task");
+  if (resultType->isVoidTy()) {
+    return llvm::StructType::get(taskType);
   }
+  return llvm::StructType::get(taskType, resultType);
+}
 
-  // Add other statement types as needed
-  return LLVMValue();
+llvm::Value *LLVMCodeGen::getPromise(llvm::Value *handle,
+                                     llvm::Type *resultType) {
+  auto &builder = context_.getBuilder();
+  auto &module = context_.getModule();
+  llvm::StructType *promiseType = getPromiseType(resultType);
+  llvm::Align align = module.getDataLayout().getABITypeAlign(promiseType);
+  llvm::Value *promise = builder.CreateCall(
+      llvm::Intrinsic::getDeclaration(&module, llvm::Intrinsic::coro_promise),
+      {handle, builder.getInt32(align.value()), builder.getFalse()},
+      "promise");
+  return builder.CreateBitCast(promise, promiseType->getPointerTo());
 }
 
-LLVMValue LLVMCodeGen::visitExprStmt(const nodes::ExpressionStmtNode *node) {
-  if (node->getExpression()) {
-    return visitExpr(node->getExpression().get());
+void LLVMCodeGen::applyFunctionAttributes(
+    llvm::Function *function, const std::vector<tokens::TokenType> &modifiers,
+    const std::string &target) {
+  if (std::find(modifiers.begin(), modifiers.end(),
+                tokens::TokenType::COLD) != modifiers.end()) {
+    function->addFnAttr(llvm::Attribute::Cold);
+    function->addFnAttr(llvm::Attribute::NoInline);
+  } else if (std::find(modifiers.begin(), modifiers.end(),
+                       tokens::TokenType::INLINE) != modifiers.end()) {
+    function->addFnAttr(llvm::Attribute::AlwaysInline);
+    function->addFnAttr(llvm::Attribute::InlineHint);
+  }
+  if (!target.empty()) {
+    applyTarget(function, target);
   }
-  return LLVMValue();
 }
 
-LLVMValue LLVMCodeGen::visitExpr(const nodes::ExpressionNode *node) {
-  if (auto literal = dynamic_cast<const nodes::LiteralExpressionNode *>(node)) {
-    return visitLiteralExpr(literal);
-  } else if (auto identifier =
-                 dynamic_cast<const nodes::IdentifierExpressionNode *>(node)) {
-    return visitIdentifierExpr(identifier);
-  } else if (auto binary =
-                 dynamic_cast<const nodes::BinaryExpressionNode *>(node)) {
-    return visitBinaryExpr(binary);
-  } else if (auto call =
-                 dynamic_cast<const nodes::CallExpressionNode *>(node)) {
-    return visitCallExpr(call);
+void LLVMCodeGen::applyTarget(llvm::Function *function,
+                              const std::string &target) {
+  TargetSpec spec = parseTarget(function->getName().str(), target);
+  std::string features;
+  for (const auto &feature : spec.features) {
+    features += (features.empty() ? "" : ",") + feature;
   }
 
-  // Add other expression types as needed
-  return LLVMValue();
+  // A function's features replace the module's, so they extend them
+  // unless a CPU was chosen, whose own features are the baseline
+  llvm::TargetMachine *machine = target_.getTargetMachine();
+  if (!spec.cpu.empty()) {
+    function->addFnAttr("target-cpu", spec.cpu);
+  }
+  if (!features.empty()) {
+    std::string base;
+    if (machine && spec.cpu.empty()) {
+      base = machine->getTargetFeatureString().rtrim(',').str();
+    }
+    function->addFnAttr("target-features",
+                        base.empty() ? features : base + "," + features);
+  }
 }
 
-LLVMValue
-LLVMCodeGen::visitLiteralExpr(const nodes::LiteralExpressionNode *node) {
-  auto &llvmContext = context_.getContext();
+LLVMCodeGen::TargetSpec
+LLVMCodeGen::parseTarget(const std::string &functionName,
+                         const std::string &target) {
+  llvm::TargetMachine *machine = target_.getTargetMachine();
+  const llvm::MCSubtargetInfo *subtarget =
+      machine ? machine->getMCSubtargetInfo() : nullptr;
+  const llvm::Triple &triple = target_.getTriple();
+
+  TargetSpec spec;
+  std::stringstream entries(target);
+  std::string entry;
+  while (std::getline(entries, entry, ',')) {
+    entry.erase(0, entry.find_first_not_of(" \t"));
+    entry.erase(entry.find_last_not_of(" \t") + 1);
+    if (entry.empty()) {
+      continue;
+    }
 
-  switch (node->getExpressionType()) {
-  case tokens::TokenType::NUMBER: {
+    if (entry.compare(0, 5, "arch=") == 0) {
+      spec.cpu = entry.substr(5);
+      if (subtarget && !subtarget->isCPUStringValid(spec.cpu)) {
+        error(core::SourceLocation(), "Unknown CPU in #target of '" +
+                                          functionName + "': " + spec.cpu);
+      }
+      continue;
+    }
+
+    // An architecture name checks where the function is compiled
+    llvm::Triple::ArchType arch = llvm::Triple::getArchTypeForLLVMName(entry);
+    if (arch != llvm::Triple::UnknownArch) {
+      llvm::Triple wanted(triple);
+      wanted.setArch(arch);
+      bool matches = arch == triple.getArch() ||
+                     (wanted.isX86() && triple.isX86()) ||
+                     (wanted.isARM() && triple.isARM()) ||
+                     (wanted.isAArch64() && triple.isAArch64());
+      if (!matches) {
+        error(core::SourceLocation(),
+              "Function '" + functionName + "' is #target(\"" +
+                  entry + "\") but is compiled for " +
+                  triple.getArchName().str());
+      }
+      continue;
+    }
+
+    bool enable = true;
+    if (entry[0] == '+' || entry[0] == '-') {
+      enable = entry[0] == '+';
+      entry.erase(0, 1);
+    } else if (entry.compare(0, 3, "no-") == 0) {
+      enable = false;
+      entry.erase(0, 3);
+    }
+    spec.features.push_back((enable ? "+" : "-") + entry);
+  }
+  return spec;
+}
+
+bool LLVMCodeGen::emitSpecializations() {
+  LLVMMonomorphizer::PendingFunction pending;
+  while (monomorphizer_.takePending(pending)) {
+    if (!pending.decl->getBody()) {
+      error(core::SourceLocation(), "Generic function '" +
+                                        pending.decl->getName() +
+                                        "' has no body");
+      return false;
+    }
+
+    // Nothing outside a whole program shares its specializations
+    if (wholeProgram_) {
+      pending.function->setLinkage(llvm::Function::InternalLinkage);
+    }
     try {
-      int value = std::stoi(node->getValue());
-      auto intType = llvm::Type::getInt32Ty(llvmContext);
-      auto intValue = llvm::ConstantInt::get(intType, value);
-      return LLVMValue(intValue, nullptr);
+      monomorphizer_.pushBindings(pending.decl->getGenericParams(),
+                                  pending.typeArgs);
+      emitFunctionBody(pending.decl, pending.function);
+      monomorphizer_.popBindings();
     } catch (const std::exception &e) {
-      error(core::SourceLocation(),
-            "Invalid number literal: " + node->getValue());
-      return LLVMValue();
+      error(core::SourceLocation(), "Error in specialization of '" +
+                                        pending.decl->getName() +
+                                        "': " + e.what());
+      return false;
     }
   }
-  case tokens::TokenType::STRING_LITERAL: {
-    auto strValue = LLVMUtils::createGlobalString(context_, node->getValue());
-    return LLVMValue(strValue, nullptr);
-  }
-  case tokens::TokenType::TRUE:
-  case tokens::TokenType::FALSE: {
-    bool value = (node->getExpressionType() == tokens::TokenType::TRUE);
-    auto boolValue =
-        llvm::ConstantInt::get(llvm::Type::getInt1Ty(llvmContext), value);
-    return LLVMValue(boolValue, nullptr);
+  return true;
+}
+
+bool LLVMCodeGen::emitReachableBodies() {
+  // A body may call functions still waiting, or request specializations
+  // that do, so the list is rescanned until a pass generates nothing
+  bool emitted = true;
+  while (emitted) {
+    emitted = false;
+    for (auto &entry : deferredBodies_) {
+      if (!entry.second) {
+        continue;
+      }
+      entry.second->removeDeadConstantUsers();
+      if (entry.second->use_empty()) {
+        continue;
+      }
+      emitFunctionBody(entry.first, entry.second);
+      entry.second = nullptr;
+      emitted = true;
+    }
+    if (!emitSpecializations()) {
+      return false;
+    }
   }
-  default:
-    error(core::SourceLocation(), "Unsupported literal type");
-    return LLVMValue();
+
+  // What is left was never reached
+  auto &interner = core::Interner::instance();
+  for (const auto &entry : deferredBodies_) {
+    if (!entry.second) {
+      continue;
+    }
+    functionTable_.erase(interner.intern(entry.first->getName()));
+    declaredFunctions_.erase(entry.first);
+    throwingFunctions_.erase(entry.second);
+    entry.second->eraseFromParent();
   }
+  deferredBodies_.clear();
+  return true;
 }
 
-// Optimization and file writing methods
-void LLVMCodeGen::optimize(OptimizationLevel level) {
-  optimizer_.setOptimizationLevel(level);
-  optimizer_.optimizeAll();
+llvm::GlobalValue::LinkageTypes
+LLVMCodeGen::getDefinitionLinkage(const std::string &name) const {
+  return wholeProgram_ && name != "main" ? llvm::GlobalValue::InternalLinkage
+                                         : llvm::GlobalValue::ExternalLinkage;
 }
 
-bool LLVMCodeGen::writeToFile(const std::string &filename) const {
-  return context_.writeModuleToFile(filename);
-}
+bool LLVMCodeGen::visitGlobalVarDecl(const nodes::VarDeclNode *node) {
+  auto &module = context_.getModule();
+  auto &llvmContext = context_.getContext();
 
-bool LLVMCodeGen::executeCode() {
   try {
-    // Initialize LLVM targets
-    llvm::InitializeNativeTarget();
-    llvm::InitializeNativeTargetAsmPrinter();
-    llvm::InitializeNativeTargetAsmParser();
-
-    // Clone the module since ExecutionEngine takes ownership
-    auto moduleClone = llvm::CloneModule(context_.getModule());
-    if (!moduleClone) {
-      error(core::SourceLocation(), "Failed to clone module for execution");
+    // Check if global variable already exists, here or in an earlier
+    // increment
+    if (module.getGlobalVariable(node->getName(), true) ||
+        incrementGlobals_.count(
+            core::Interner::instance().intern(node->getName()))) {
+      error(core::SourceLocation(),
+            "Global variable '" + node->getName() + "' already declared");
       return false;
     }
 
-    // Create execution engine with proper error handling
-    std::string errorStr;
-    llvm::ExecutionEngine *executionEngine =
-        llvm::EngineBuilder(std::move(moduleClone))
-            .setErrorStr(&errorStr)
-            .setEngineKind(llvm::EngineKind::JIT)
-            .create();
-
-    if (!executionEngine) {
-      error(core::SourceLocation(),
-            "Failed to create execution engine: " + errorStr);
-      return false;
+    // Determine variable type
+    llvm::Type *varType = getStorageType(node->getType());
+    llvm::Align alignment = typeBuilder_.getAlignment(varType);
+    if (PointerOwnership ownership = getOwnership(node->getType());
+        ownership != PointerOwnership::Raw) {
+      // The initializer runs outside any function, with no scope to own it
+      if (node->getInitializer()) {
+        error(core::SourceLocation(),
+              "Smart pointer '" + node->getName() +
+                  "' must be assigned inside a function");
+        return false;
+      }
+      globalOwnership_[core::Interner::instance().intern(node->getName())] =
+          ownership;
+    }
+    if (unsigned pointeeAlignment =
+            LLVMTypeBuilder::getPointeeAlignment(node->getType())) {
+      globalPointeeAlignments_[core::Interner::instance().intern(
+          node->getName())] = pointeeAlignment;
     }
 
-    // Use unique_ptr for automatic cleanup
-    std::unique_ptr<llvm::ExecutionEngine> enginePtr(executionEngine);
+    // #comptime constants are computed here, and have the type of their
+    // value unless they declare one. One that fails is still declared, so
+    // that the failures of the others are reported too
+    if (node->getStorageClass() == tokens::TokenType::COMPTIME) {
+      llvm::Constant *initializer =
+          emitComptimeInitializer(node, node->getType() ? varType : nullptr);
+      if (!initializer) {
+        initializer = llvm::Constant::getNullValue(
+            node->getType() ? varType : llvm::Type::getInt32Ty(llvmContext));
+      }
+      bool defined = !partition_ || partition_->ownsEntry;
+      auto globalVar = new llvm::GlobalVariable(
+          module, initializer->getType(), true,
+          defined ? getDefinitionLinkage(node->getName())
+                  : llvm::GlobalValue::ExternalLinkage,
+          defined ? initializer : nullptr, node->getName());
+      globalVar->setAlignment(
+          typeBuilder_.getAlignment(initializer->getType()));
+      return true;
+    }
 
-    // Find the main function
-    llvm::Function *mainFunc = enginePtr->FindFunctionNamed("main");
-    if (!mainFunc) {
-      error(core::SourceLocation(), "No main function found for execution");
-      return false;
+    // Another partition defines it; an external declaration links to it
+    if (partition_ && !partition_->ownsEntry) {
+      auto declaration = new llvm::GlobalVariable(
+          module, varType, node->isConst(), llvm::GlobalValue::ExternalLinkage,
+          nullptr, node->getName());
+      declaration->setAlignment(alignment);
+      return true;
     }
 
-    // Finalize the engine (important for MCJIT)
-    enginePtr->finalizeObject();
+    llvm::Constant *initializer = llvm::Constant::getNullValue(varType);
+
+    // Handle initializer if present
+    if (node->getInitializer()) {
+      // Create a temporary function to evaluate the initializer
+      llvm::Function *tempFunc = llvm::Function::Create(
+          llvm::FunctionType::get(llvm::Type::getVoidTy(llvmContext), false),
+          llvm::Function::PrivateLinkage, "__temp_init", module);
+
+      llvm::BasicBlock *tempBlock =
+          llvm::BasicBlock::Create(llvmContext, "entry", tempFunc);
+      context_.getBuilder().SetInsertPoint(tempBlock);
 
-    // Prepare arguments (none for main in this case)
-    std::vector<llvm::GenericValue> args;
+      LLVMValue initValue = visitExpr(node->getInitializer());
+      llvm::Value *converted =
+          initValue.isValid() ? convertForStore(initValue.getValue(), varType,
+                                                node->getName())
+                              : nullptr;
+      if (auto constant = llvm::dyn_cast_or_null<llvm::Constant>(converted)) {
+        initializer = constant;
+      }
 
-    // Execute the function
-    llvm::GenericValue result = enginePtr->runFunction(mainFunc, args);
+      // Clean up temporary function
+      tempFunc->eraseFromParent();
+    }
 
-    // Print the return value
-    std::cout << "Program executed, returned: " << result.IntVal.getSExtValue()
-              << std::endl;
+    llvm::GlobalVariable *globalVar = new llvm::GlobalVariable(
+        module, varType, node->isConst(), getDefinitionLinkage(node->getName()),
+        initializer, node->getName());
+    globalVar->setAlignment(alignment);
 
     return true;
   } catch (const std::exception &e) {
-    error(core::SourceLocation(),
-          std::string("Error during execution: ") + e.what());
+    error(core::SourceLocation(), "Error in global variable declaration '" +
+                                      node->getName() + "': " + e.what());
     return false;
   }
 }
 
-// Error reporting
-void LLVMCodeGen::error(const core::SourceLocation &location,
-                        const std::string &message) {
-  errorReporter_.error(location, message);
-}
+llvm::Constant *
+LLVMCodeGen::emitComptimeInitializer(const nodes::VarDeclNode *node,
+                                     llvm::Type *type) {
+  using Value = visitors::ComptimeEvaluator::Value;
+  std::optional<Value> value = comptime_.evaluate(node);
+  if (!value) {
+    const core::Error &failure = comptime_.getError();
+    error(failure.location, failure.message + " (in #comptime '" +
+                                node->getName() + "')");
+    return nullptr;
+  }
 
-void LLVMCodeGen::warning(const core::SourceLocation &location,
-                          const std::string &message) {
-  errorReporter_.warning(location, message);
+  llvm::Constant *initializer = getComptimeConstant(*value, type);
+  if (!initializer) {
+    error(node->getLocation(), "Value of #comptime '" + node->getName() +
+                                   "' does not fit its type");
+  }
+  return initializer;
 }
 
-// Stub implementations for other required methods
-void LLVMCodeGen::visitGlobalDecl(const nodes::NodePtr &node) {}
-void LLVMCodeGen::visitClassDecl(const nodes::ClassDeclNode *node) {}
-void LLVMCodeGen::visitNamespaceDecl(const nodes::NamespaceDeclNode *node) {}
-void LLVMCodeGen::visitEnumDecl(const nodes::EnumDeclNode *node) {}
-void LLVMCodeGen::visitInterfaceDecl(const nodes::InterfaceDeclNode *node) {}
-LLVMValue LLVMCodeGen::visitParameter(const nodes::ParameterNode *node) {
-  return LLVMValue();
-}
-LLVMValue LLVMCodeGen::visitIfStmt(const nodes::IfStmtNode *node) {
-  return LLVMValue();
-}
-LLVMValue LLVMCodeGen::visitWhileStmt(const nodes::WhileStmtNode *node) {
-  return LLVMValue();
-}
-LLVMValue LLVMCodeGen::visitDoWhileStmt(const nodes::DoWhileStmtNode *node) {
-  return LLVMValue();
+llvm::Constant *LLVMCodeGen::getComptimeConstant(
+    const visitors::ComptimeEvaluator::Value &value, llvm::Type *type) {
+  using Kind = visitors::ComptimeEvaluator::Value::Kind;
+  auto &llvmContext = context_.getContext();
+  switch (value.kind) {
+  case Kind::Int:
+    type = type ? type : llvm::Type::getInt32Ty(llvmContext);
+    return type->isIntegerTy(32)
+               ? llvm::ConstantInt::get(type, value.scalar.int_value, true)
+               : nullptr;
+  case Kind::Float:
+    type = type ? type : llvm::Type::getFloatTy(llvmContext);
+    return type->isFloatTy()
+               ? llvm::ConstantFP::get(type, value.scalar.float_value)
+               : nullptr;
+  case Kind::Bool:
+    type = type ? type : llvm::Type::getInt1Ty(llvmContext);
+    return type->isIntegerTy(1)
+               ? llvm::ConstantInt::get(type, value.scalar.bool_value)
+               : nullptr;
+  case Kind::Array: {
+    auto arrayType = llvm::dyn_cast_or_null<llvm::ArrayType>(type);
+    if (type && (!arrayType ||
+                 arrayType->getNumElements() != value.elements.size())) {
+      return nullptr;
+    }
+    // Without a declared type the first element decides the others'
+    llvm::Type *elementType = arrayType ? arrayType->getElementType() : nullptr;
+    std::vector<llvm::Constant *> elements;
+    elements.reserve(value.elements.size());
+    for (const auto &element : value.elements) {
+      llvm::Constant *constant = getComptimeConstant(element, elementType);
+      if (!constant) {
+        return nullptr;
+      }
+      elementType = constant->getType();
+      elements.push_back(constant);
+    }
+    if (!elementType) {
+      return nullptr;
+    }
+    return llvm::ConstantArray::get(
+        llvm::ArrayType::get(elementType, elements.size()), elements);
+  }
+  }
+  return nullptr;
 }
-LLVMValue LLVMCodeGen::visitForStmt(const nodes::ForStmtNode *node) {
+
+bool LLVMCodeGen::visitTopLevelStatement(const nodes::StatementNode *node) {
+  try {
+    // Store top-level statements to be executed in main
+    switch (node->getNodeKind()) {
+    case nodes::NodeKind::DeclarationStmt:
+      return visitTopLevelDeclaration(
+          nodes::cast<nodes::DeclarationStmtNode>(node)->getDeclaration());
+    case nodes::NodeKind::AssemblyStmt:
+      topLevelAssemblyStatements_.push_back(
+          nodes::cast<nodes::AssemblyStmtNode>(node));
+      return true;
+    case nodes::NodeKind::ExpressionStmt:
+      topLevelExpressionStatements_.push_back(
+          nodes::cast<nodes::ExpressionStmtNode>(node));
+      return true;
+    default:
+      break;
+    }
+
+    // For other statement types, we might want to handle them differently
+    warning(core::SourceLocation(), "Unsupported top-level statement type");
+    return true;
+  } catch (const std::exception &e) {
+    error(core::SourceLocation(),
+          "Error processing top-level statement: " + std::string(e.what()));
+    return false;
+  }
+}
+
+llvm::Function *
+LLVMCodeGen::createDefaultMainFunction(const std::string &name) {
+  auto &module = context_.getModule();
+  auto &llvmContext = context_.getContext();
+  auto &builder = context_.getBuilder();
+
+  try {
+    // Create main function
+    llvm::FunctionType *mainType =
+        llvm::FunctionType::get(llvm::Type::getInt32Ty(llvmContext), false);
+
+    llvm::Function *mainFunc = llvm::Function::Create(
+        mainType, llvm::Function::ExternalLinkage, name, module);
+
+    llvm::BasicBlock *entry =
+        llvm::BasicBlock::Create(llvmContext, "entry", mainFunc);
+    builder.SetInsertPoint(entry);
+
+    // Execute any top-level assembly statements
+    for (const auto &asmStmt : topLevelAssemblyStatements_) {
+      if (!visitAssemblyStatement(asmStmt)) {
+        warning(core::SourceLocation(), "Failed to process assembly statement");
+      }
+    }
+
+    // Execute any top-level expressions
+    for (const auto &exprStmt : topLevelExpressionStatements_) {
+      if (!visitExpressionStatement(exprStmt)) {
+        warning(core::SourceLocation(),
+                "Failed to process expression statement");
+      }
+    }
+
+    // Return 0
+    builder.CreateRet(
+        llvm::ConstantInt::get(llvm::Type::getInt32Ty(llvmContext), 0, true));
+
+    return mainFunc;
+  } catch (const std::exception &e) {
+    error(core::SourceLocation(),
+          "Error creating main function: " + std::string(e.what()));
+    return nullptr;
+  }
+}
+
+bool LLVMCodeGen::visitAssemblyStatement(const nodes::AssemblyStmtNode *node) {
+  auto &builder = context_.getBuilder();
+  auto &llvmContext = context_.getContext();
+  auto &module = context_.getModule();
+
+  try {
+    std::string asmCode = unquoteAssembly(node->getCode());
+
+    // printf("...") has no arguments to format, so its text is known
+    // here and goes to the runtime's output buffer with its length
+    std::string printStr;
+    if (!node->isExtended() && extractPrintfString(asmCode, printStr)) {
+      llvm::Function *writeFunc = module.getFunction("tspp_write");
+      if (!writeFunc) {
+        error(core::SourceLocation(), "tspp_write function not available");
+        return false;
+      }
+      if (printStr.empty()) {
+        return true;
+      }
+      llvm::Value *strConstant =
+          LLVMUtils::createGlobalString(context_, printStr, "printf_str");
+      builder.CreateCall(writeFunc,
+                         {strConstant, builder.getInt64(printStr.size())});
+      return true;
+    }
+
+    // Other code is assembled as written, its escapes resolved
+    const std::string &literal = node->getCode();
+    std::string code =
+        literal.size() >= 2 && literal.front() == '"'
+            ? parseStringLiteral(
+                  std::string_view(literal).substr(1, literal.size() - 2))
+            : literal;
+    if (node->isExtended()) {
+      return emitExtendedAssembly(node, code);
+    }
+
+    InlineAsmTranslator translator(target_.getTriple());
+    std::string constraints;
+    for (const auto &clobber : translator.translateClobbers({})) {
+      constraints += (constraints.empty() ? "" : ",") + clobber;
+    }
+    llvm::FunctionType *asmType =
+        llvm::FunctionType::get(llvm::Type::getVoidTy(llvmContext), false);
+    builder.CreateCall(llvm::InlineAsm::get(
+        asmType, InlineAsmTranslator::escapeBasic(code), constraints, true));
+    return true;
+  } catch (const std::exception &e) {
+    error(core::SourceLocation(),
+          "Error processing assembly statement: " + std::string(e.what()));
+    return false;
+  }
+}
+
+bool LLVMCodeGen::emitExtendedAssembly(const nodes::AssemblyStmtNode *node,
+                                       const std::string &code) {
+  auto &builder = context_.getBuilder();
+  const auto &outputs = node->getOutputs();
+  const auto &inputs = node->getInputs();
+  InlineAsmTranslator translator(target_.getTriple());
+
+  std::vector<std::string> names;
+  for (const auto *operands : {&outputs, &inputs}) {
+    for (const auto &operand : *operands) {
+      names.push_back(operand.name);
+    }
+  }
+  std::string asmTemplate;
+  std::string problem = translator.translateTemplate(code, names, asmTemplate);
+  if (!problem.empty()) {
+    error(node->getLocation(), problem);
+    return false;
+  }
+  auto constraintOf = [this](const nodes::AsmOperand &operand) {
+    const std::string &literal = operand.constraint;
+    return AsmConstraint::parse(parseStringLiteral(
+        std::string_view(literal).substr(1, literal.size() - 2)));
+  };
+
+  // Register outputs come back as the call's result and are stored to
+  // their lvalues after it; memory outputs are written through their
+  // addresses. A '+' operand also passes its value in, tied to itself.
+  std::vector<std::string> constraints;
+  std::vector<llvm::Value *> args;
+  std::vector<LLVMValue> results;
+  std::vector<llvm::Type *> resultTypes;
+  std::vector<std::string> tiedConstraints;
+  std::vector<llvm::Value *> tiedArgs;
+  // What each memory operand's address points to, which LLVM requires;
+  // nullptr for values
+  std::vector<llvm::Type *> elementTypes;
+  std::vector<llvm::Type *> tiedElementTypes;
+  for (size_t i = 0; i < outputs.size(); ++i) {
+    AsmConstraint constraint = constraintOf(outputs[i]);
+    LLVMValue target = visitExpr(outputs[i].expression);
+    if (!target.isValid() || !target.isLValue()) {
+      error(outputs[i].expression->getLocation(),
+            "Output operand of an assembly statement must be assignable");
+      return false;
+    }
+    std::string prefix = constraint.earlyClobber ? "=&" : "=";
+    if (constraint.isMemory()) {
+      constraints.push_back(prefix + "*m");
+      args.push_back(target.getValue());
+      elementTypes.push_back(target.getStoredType());
+      if (constraint.readWrite) {
+        tiedConstraints.push_back("*m");
+        tiedArgs.push_back(target.getValue());
+        tiedElementTypes.push_back(target.getStoredType());
+      }
+      continue;
+    }
+    constraints.push_back(prefix +
+                          translator.translateCodes(constraint.codes));
+    resultTypes.push_back(target.getStoredType());
+    if (constraint.readWrite) {
+      tiedConstraints.push_back(std::to_string(i));
+      tiedArgs.push_back(target.loadIfLValue(builder).getValue());
+      tiedElementTypes.push_back(nullptr);
+    }
+    results.push_back(std::move(target));
+  }
+
+  for (const auto &input : inputs) {
+    AsmConstraint constraint = constraintOf(input);
+    LLVMValue value = visitExpr(input.expression);
+    if (!value.isValid()) {
+      return false;
+    }
+    if (constraint.isMemory()) {
+      constraints.push_back("*m");
+      if (value.isLValue()) {
+        args.push_back(value.getValue());
+        elementTypes.push_back(value.getStoredType());
+      } else {
+        args.push_back(spillToStack(value.getValue(), "asm.operand"));
+        elementTypes.push_back(value.getValue()->getType());
+      }
+      continue;
+    }
+    constraints.push_back(translator.translateCodes(constraint.codes));
+    args.push_back(value.loadIfLValue(builder).getValue());
+    elementTypes.push_back(nullptr);
+  }
+  constraints.insert(constraints.end(), tiedConstraints.begin(),
+                     tiedConstraints.end());
+  args.insert(args.end(), tiedArgs.begin(), tiedArgs.end());
+  elementTypes.insert(elementTypes.end(), tiedElementTypes.begin(),
+                      tiedElementTypes.end());
+  std::vector<std::string> clobbers;
+  for (const auto &literal : node->getClobbers()) {
+    clobbers.push_back(parseStringLiteral(
+        std::string_view(literal).substr(1, literal.size() - 2)));
+  }
+  for (auto &clobber : translator.translateClobbers(clobbers)) {
+    constraints.push_back(std::move(clobber));
+  }
+
+  std::string constraintString;
+  for (const auto &constraint : constraints) {
+    constraintString += (constraintString.empty() ? "" : ",") + constraint;
+  }
+  std::vector<llvm::Type *> argTypes;
+  for (llvm::Value *arg : args) {
+    argTypes.push_back(arg->getType());
+  }
+  llvm::Type *resultType =
+      resultTypes.empty() ? builder.getVoidTy()
+      : resultTypes.size() == 1
+          ? resultTypes.front()
+          : llvm::StructType::get(context_.getContext(), resultTypes);
+  auto *asmType = llvm::FunctionType::get(resultType, argTypes, false);
+  if (!llvm::InlineAsm::Verify(asmType, constraintString)) {
+    error(node->getLocation(),
+          "Invalid assembly constraints \"" + constraintString + "\"");
+    return false;
+  }
+
+  // Every #asm statement is volatile: it stays where it is written and
+  // runs each time, even when its outputs go unused
+  llvm::CallInst *call = builder.CreateCall(
+      llvm::InlineAsm::get(asmType, asmTemplate, constraintString, true),
+      args);
+  for (size_t i = 0; i < elementTypes.size(); ++i) {
+    if (elementTypes[i]) {
+      call->addParamAttr(i, llvm::Attribute::get(context_.getContext(),
+                                                 llvm::Attribute::ElementType,
+                                                 elementTypes[i]));
+    }
+  }
+  for (size_t i = 0; i < results.size(); ++i) {
+    llvm::Value *result =
+        results.size() == 1 ? call : builder.CreateExtractValue(call, i);
+    results[i].store(builder, result);
+  }
+  return true;
+}
+
+bool LLVMCodeGen::visitExpressionStatement(
+    const nodes::ExpressionStmtNode *node) {
+  try {
+    // Visit the expression (this might have side effects)
+    if (node->getExpression()) {
+      LLVMValue result = visitExpr(node->getExpression());
+      return result.isValid() || true; // Allow invalid results for statements
+    }
+    return true;
+  } catch (const std::exception &e) {
+    error(core::SourceLocation(),
+          "Error processing expression statement: " + std::string(e.what()));
+    return false;
+  }
+}
+
+// String parsing helpers
+std::string LLVMCodeGen::parseStringLiteral(std::string_view input) {
+  std::string result;
+  result.reserve(input.size());
+  tokens::appendUnescaped(input, result);
+  return result;
+}
+
+std::string LLVMCodeGen::unquoteAssembly(const std::string &literal) {
+  if (literal.size() < 2 || literal.front() != '"' || literal.back() != '"') {
+    return literal;
+  }
+  std::string code;
+  code.reserve(literal.size() - 2);
+  for (size_t i = 1; i + 1 < literal.size(); ++i) {
+    if (literal[i] == '\\' && i + 2 < literal.size() &&
+        (literal[i + 1] == '"' || literal[i + 1] == '\\')) {
+      ++i;
+    }
+    code += literal[i];
+  }
+  return code;
+}
+
+bool LLVMCodeGen::extractPrintfString(const std::string &asmCode,
+                                      std::string &format) {
+  // Match printf ( "..." ) with optional whitespace between the parts and
+  // no line break inside the quotes
+  std::string_view code = asmCode;
+  auto isSpace = [](char c) {
+    return std::isspace(static_cast<unsigned char>(c)) != 0;
+  };
+  auto skipSpace = [&](size_t pos) {
+    while (pos < code.size() && isSpace(code[pos])) {
+      ++pos;
+    }
+    return pos;
+  };
+  auto skipSpaceBack = [&](size_t end) {
+    while (end > 0 && isSpace(code[end - 1])) {
+      --end;
+    }
+    return end;
+  };
+
+  if (code.substr(0, 6) != "printf") {
+    return false;
+  }
+  size_t pos = skipSpace(6);
+  if (pos == code.size() || code[pos] != '(') {
+    return false;
+  }
+  size_t open = skipSpace(pos + 1);
+  if (open == code.size() || code[open] != '"') {
+    return false;
+  }
+  size_t end = code.size();
+  if (end == 0 || code[end - 1] != ')') {
+    return false;
+  }
+  size_t close = skipSpaceBack(end - 1);
+  if (close <= open + 1 || code[close - 1] != '"') {
+    return false;
+  }
+
+  std::string_view body = code.substr(open + 1, close - 1 - (open + 1));
+  if (body.find_first_of("\r\n") != std::string_view::npos) {
+    return false;
+  }
+  format = parseStringLiteral(body);
+
+  // Without arguments the only directive printf acts on is %%
+  size_t percent = 0;
+  while ((percent = format.find("%%", percent)) != std::string::npos) {
+    format.erase(percent, 1);
+    ++percent;
+  }
+  return true;
+}
+
+// Utility methods for loop management
+void LLVMCodeGen::pushLoop(llvm::BasicBlock *continueDest,
+                           llvm::BasicBlock *breakDest,
+                           const core::SourceLocation &location) {
+  if (instrumentation_ && options_.isInstrumentLoopsEnabled()) {
+    auto &builder = context_.getBuilder();
+    instrumentation_->countLoop(
+        builder, builder.GetInsertBlock()->getParent()->getName().str(),
+        location);
+  }
+  size_t depth = currentFunction_ ? currentFunction_->getScopeDepth() : 0;
+  loopStack_.push({continueDest, breakDest, depth, depth});
+}
+
+void LLVMCodeGen::popLoop() {
+  if (!loopStack_.empty()) {
+    loopStack_.pop();
+  }
+}
+
+LLVMCodeGen::LoopInfo *LLVMCodeGen::getCurrentLoop() {
+  if (loopStack_.empty()) {
+    return nullptr;
+  }
+  return &loopStack_.top();
+}
+
+llvm::Type *LLVMCodeGen::getStorageType(const nodes::TypeNode *type) {
+  if (llvm::Type *bound = monomorphizer_.convertBoundType(type)) {
+    return bound;
+  }
+  llvm::Type *converted = typeBuilder_.convertTypeNode(type);
+  if (converted->isSized()) {
+    return converted;
+  }
+
+  // void and classes without a body hold no value
+  error(core::SourceLocation(), "A value cannot be stored as an incomplete "
+                                "or void type");
+  return llvm::Type::getInt32Ty(context_.getContext());
+}
+
+llvm::Type *LLVMCodeGen::getReturnType(const nodes::TypeNode *type) {
+  if (llvm::Type *bound = monomorphizer_.convertBoundType(type)) {
+    return bound;
+  }
+  llvm::Type *converted = typeBuilder_.convertTypeNode(type);
+  return converted->isVoidTy() ? converted : getStorageType(type);
+}
+
+llvm::Value *LLVMCodeGen::convertNumeric(llvm::Value *value,
+                                         llvm::Type *type) {
+  auto &builder = context_.getBuilder();
+  llvm::Type *from = value->getType();
+
+  // Booleans are compared, not truncated
+  if (type->isIntegerTy(1) && from->isIntegerTy()) {
+    return builder.CreateICmpNE(value, llvm::ConstantInt::get(from, 0));
+  }
+  if (type->isIntegerTy() && from->isIntegerTy()) {
+    return builder.CreateIntCast(value, type, !from->isIntegerTy(1));
+  }
+  if (type->isFloatingPointTy() && from->isIntegerTy()) {
+    return from->isIntegerTy(1) ? builder.CreateUIToFP(value, type)
+                                : builder.CreateSIToFP(value, type);
+  }
+  if (type->isIntegerTy() && from->isFloatingPointTy()) {
+    return builder.CreateFPToSI(value, type);
+  }
+  if (type->isFloatingPointTy() && from->isFloatingPointTy()) {
+    return builder.CreateFPCast(value, type);
+  }
+  return nullptr;
+}
+
+llvm::Value *LLVMCodeGen::convertForStore(llvm::Value *value,
+                                          llvm::Type *storageType,
+                                          const std::string &name) {
+  if (value->getType() == storageType) {
+    return value;
+  }
+  auto &builder = context_.getBuilder();
+
+  if (typeBuilder_.getUnionArms(storageType)) {
+    return emitUnionValue(value, storageType, name);
+  }
+
+  if (typeBuilder_.getClosureSignature(storageType)) {
+    if (auto function = llvm::dyn_cast<llvm::Function>(value)) {
+      return emitFunctionValue(function,
+                               llvm::cast<llvm::StructType>(storageType), name);
+    }
+  }
+
+  // An object pointer converts to its interfaces and to its bases, whose
+  // objects it starts with
+  const auto *fromClass = getClassOf(value->getType());
+  if (fromClass && value->getType()->isPointerTy()) {
+    if (const auto *iface = getInterfaceOf(storageType)) {
+      if (LLVMClassHierarchy::implements(fromClass, iface)) {
+        llvm::Value *result = llvm::UndefValue::get(storageType);
+        result = builder.CreateInsertValue(
+            result, builder.CreateBitCast(value, builder.getInt8PtrTy()), 0);
+        return builder.CreateInsertValue(result, getItable(fromClass, iface),
+                                         1, name);
+      }
+    }
+    const auto *toClass = getClassOf(storageType);
+    if (toClass && toClass != fromClass &&
+        LLVMClassHierarchy::derivesFrom(fromClass, toClass)) {
+      value = builder.CreateBitCast(
+          value,
+          typeBuilder_.getTypeByName(toClass->getName())->getPointerTo(),
+          "upcast");
+      if (value->getType() == storageType) {
+        return value;
+      }
+    }
+  }
+
+  // Interface values narrow to an interface whose itable starts theirs
+  if (const auto *fromIface = getInterfaceOf(value->getType())) {
+    const auto *toIface = getInterfaceOf(storageType);
+    if (toIface && LLVMClassHierarchy::extends(fromIface, toIface) &&
+        std::equal(toIface->slots.begin(), toIface->slots.end(),
+                   fromIface->slots.begin())) {
+      llvm::Value *result = llvm::UndefValue::get(storageType);
+      result = builder.CreateInsertValue(
+          result, builder.CreateExtractValue(value, 0), 0);
+      return builder.CreateInsertValue(
+          result, builder.CreateExtractValue(value, 1), 1, name);
+    }
+  }
+
+  // Class variables hold the object itself, so a new object is copied in
+  if (auto pointerType = llvm::dyn_cast<llvm::PointerType>(value->getType())) {
+    if (pointerType->getPointerElementType() == storageType &&
+        storageType->isStructTy()) {
+      return context_.getBuilder().CreateAlignedLoad(
+          storageType, value, typeBuilder_.getAlignment(storageType));
+    }
+  }
+
+  // Growable arrays and strings are viewed in place by slices
+  if (LLVMTypeBuilder::isSliceType(storageType)) {
+    llvm::Type *dataType = storageType->getStructElementType(0);
+    llvm::Value *data = nullptr;
+    llvm::Value *length = nullptr;
+    if (LLVMTypeBuilder::isDynamicArrayType(value->getType()) &&
+        value->getType()->getStructElementType(0) == dataType) {
+      data = builder.CreateExtractValue(value, 0, "data");
+      length = builder.CreateExtractValue(value, 1, "length");
+    } else if (value->getType() == typeBuilder_.getStringType() &&
+               dataType == builder.getInt8PtrTy()) {
+      // A short string keeps its bytes in the value, so the view points
+      // into a copy that lives as long as the function
+      llvm::Value *string = spillToStack(value, "viewed");
+      length = builder.CreateExtractValue(value, 0, "length");
+      llvm::Value *small = builder.CreateBitCast(
+          builder.CreateStructGEP(typeBuilder_.getStringType(), string, 1),
+          dataType);
+      data = builder.CreateSelect(
+          builder.CreateICmpULT(length, builder.getInt64(getStringSmallLimit())),
+          small, builder.CreateExtractValue(value, 1), "data");
+    }
+    if (data) {
+      llvm::Value *result = llvm::UndefValue::get(storageType);
+      result = builder.CreateInsertValue(result, data, 0);
+      return builder.CreateInsertValue(result, length, 1, name);
+    }
+  }
+
+  if (llvm::Value *converted = convertNumeric(value, storageType)) {
+    return converted;
+  }
+
+  // Integers initialize pointers by address; 0 is the null pointer
+  if (storageType->isPointerTy() && value->getType()->isIntegerTy()) {
+    auto constant = llvm::dyn_cast<llvm::ConstantInt>(value);
+    if (constant && constant->isZero()) {
+      return llvm::Constant::getNullValue(storageType);
+    }
+    return context_.getBuilder().CreateIntToPtr(value, storageType);
+  }
+
+  error(core::SourceLocation(),
+        "Value does not match the type of '" + name + "'");
+  return nullptr;
+}
+
+llvm::Value *LLVMCodeGen::emitUnionValue(llvm::Value *value,
+                                         llvm::Type *unionType,
+                                         const std::string &name) {
+  auto &builder = context_.getBuilder();
+  auto &llvmContext = context_.getContext();
+  const auto &arms = *typeBuilder_.getUnionArms(unionType);
+
+  // The union is built in memory, which SROA takes apart again
+  llvm::Value *slot = createEntryAlloca(unionType, name + ".union");
+  auto storeArm = [&](llvm::Value *armValue) {
+    llvm::Type *from = armValue->getType();
+    auto accepts = [&](llvm::Type *arm) {
+      if (from->isIntegerTy() && !from->isIntegerTy(1)) {
+        return arm->isFloatingPointTy();
+      }
+      if (!from->isPointerTy()) {
+        return false;
+      }
+      // New objects are copied in, and classes convert to their bases
+      // and interfaces
+      if (from->getPointerElementType() == arm) {
+        return true;
+      }
+      const auto *fromClass = getClassOf(from);
+      if (!fromClass) {
+        return false;
+      }
+      if (const auto *iface = getInterfaceOf(arm)) {
+        return LLVMClassHierarchy::implements(fromClass, iface);
+      }
+      const auto *toClass = getClassOf(arm);
+      return arm->isPointerTy() && toClass &&
+             LLVMClassHierarchy::derivesFrom(fromClass, toClass);
+    };
+    auto found = std::find(arms.begin(), arms.end(), from);
+    if (found == arms.end()) {
+      found = std::find_if(arms.begin(), arms.end(), accepts);
+    }
+    if (found == arms.end()) {
+      error(core::SourceLocation(),
+            "Value matches no type of the union '" + name + "'");
+      return false;
+    }
+    llvm::Value *converted = convertForStore(armValue, *found, name);
+    if (!converted) {
+      return false;
+    }
+    builder.CreateStore(builder.getInt32(found - arms.begin()),
+                        builder.CreateStructGEP(unionType, slot, 0));
+    builder.CreateStore(converted, getUnionPayload(slot, unionType, *found));
+    return true;
+  };
+
+  const auto *fromArms = typeBuilder_.getUnionArms(value->getType());
+  if (!fromArms) {
+    if (!storeArm(value)) {
+      return nullptr;
+    }
+    return builder.CreateLoad(unionType, slot, name);
+  }
+
+  // Another union is retagged arm by arm
+  llvm::Function *function = builder.GetInsertBlock()->getParent();
+  llvm::Value *source = spillToStack(value, name + ".from");
+  llvm::BasicBlock *endBlock =
+      llvm::BasicBlock::Create(llvmContext, "union.end", function);
+  llvm::SwitchInst *table = builder.CreateSwitch(
+      emitUnionTag(LLVMValue(source, nullptr, true)), endBlock,
+      fromArms->size());
+  for (size_t i = 0; i < fromArms->size(); ++i) {
+    llvm::Type *arm = (*fromArms)[i];
+    auto armBlock =
+        llvm::BasicBlock::Create(llvmContext, "union.arm", function, endBlock);
+    table->addCase(builder.getInt32(i), armBlock);
+    builder.SetInsertPoint(armBlock);
+    llvm::Value *armValue = builder.CreateLoad(
+        arm, getUnionPayload(source, value->getType(), arm));
+    if (!storeArm(armValue)) {
+      return nullptr;
+    }
+    builder.CreateBr(endBlock);
+  }
+  builder.SetInsertPoint(endBlock);
+  return builder.CreateLoad(unionType, slot, name);
+}
+
+llvm::Value *LLVMCodeGen::getUnionPayload(llvm::Value *address,
+                                          llvm::Type *unionType,
+                                          llvm::Type *arm) {
+  auto &builder = context_.getBuilder();
+  return builder.CreateBitCast(builder.CreateStructGEP(unionType, address, 1),
+                               arm->getPointerTo(), "payload");
+}
+
+llvm::Value *LLVMCodeGen::emitUnionTag(const LLVMValue &value) {
+  auto &builder = context_.getBuilder();
+  if (!value.isLValue()) {
+    return builder.CreateExtractValue(value.getValue(), 0, "tag");
+  }
+  llvm::Value *address = value.getValue();
+  return builder.CreateLoad(
+      builder.getInt32Ty(),
+      builder.CreateStructGEP(address->getType()->getPointerElementType(),
+                              address, 0),
+      "tag");
+}
+
+int LLVMCodeGen::getUnionTag(
+    const std::shared_ptr<visitors::ResolvedType> &unionType,
+    const std::string &armName) {
+  const auto *arms =
+      typeBuilder_.getUnionArms(typeBuilder_.convertType(unionType));
+  if (!arms) {
+    return -1;
+  }
+  for (const auto &arm : unionType->getUnionArms()) {
+    if (arm->toString() == armName) {
+      auto found = std::find(arms->begin(), arms->end(),
+                             typeBuilder_.convertType(arm));
+      return found != arms->end() ? static_cast<int>(found - arms->begin())
+                                  : -1;
+    }
+  }
+  return -1;
+}
+
+llvm::Value *LLVMCodeGen::emitTypeTest(const nodes::TypeTest &test) {
+  auto &builder = context_.getBuilder();
+  const auto &type = test.operand->getResolvedType();
+  if (!type || type->getKind() != visitors::ResolvedType::TypeKind::Union) {
+    return nullptr;
+  }
+  int tag = getUnionTag(type, test.typeName);
+  LLVMValue value = visitExpr(test.operand);
+  if (tag < 0 || !value.isValid()) {
+    error(core::SourceLocation(),
+          "'" + test.typeName + "' is not a type of " + type->toString());
+    return nullptr;
+  }
+  llvm::Value *actual = emitUnionTag(value);
+  return test.negated ? builder.CreateICmpNE(actual, builder.getInt32(tag),
+                                             "not." + test.typeName)
+                      : builder.CreateICmpEQ(actual, builder.getInt32(tag),
+                                             "is." + test.typeName);
+}
+
+LLVMValue LLVMCodeGen::emitTypeOf(const nodes::ExpressionNode *operand) {
+  auto &builder = context_.getBuilder();
+  const auto &type = operand->getResolvedType();
+  if (!type) {
+    error(core::SourceLocation(), "The type of a typeof operand is unknown");
+    return LLVMValue();
+  }
+  if (type->getKind() != visitors::ResolvedType::TypeKind::Union) {
+    return LLVMValue(getStringLiteral(type->toString()), nullptr);
+  }
+
+  // The name is chosen by the tag
+  LLVMValue value = visitExpr(operand);
+  if (!value.isValid()) {
+    return LLVMValue();
+  }
+  llvm::Value *tag = emitUnionTag(value);
+  auto arms = type->getUnionArms();
+  llvm::Value *name = getStringLiteral(arms.back()->toString());
+  for (size_t i = arms.size() - 1; i-- > 0;) {
+    llvm::Value *isArm = builder.CreateICmpEQ(
+        tag, builder.getInt32(getUnionTag(type, arms[i]->toString())));
+    name = builder.CreateSelect(isArm, getStringLiteral(arms[i]->toString()),
+                                name, "typeof");
+  }
+  return LLVMValue(name, nullptr);
+}
+
+LLVMValue
+LLVMCodeGen::narrowUnion(const LLVMValue &variable,
+                         const nodes::IdentifierExpressionNode *node) {
+  const auto &narrowed = node->getResolvedType();
+  if (!variable.isLValue() || !narrowed ||
+      narrowed->getKind() == visitors::ResolvedType::TypeKind::Union ||
+      narrowed->getKind() == visitors::ResolvedType::TypeKind::Error) {
+    return variable;
+  }
+  llvm::Type *stored = variable.getValue()->getType()->getPointerElementType();
+  if (!typeBuilder_.getUnionArms(stored)) {
+    return variable;
+  }
+  return LLVMValue(getUnionPayload(variable.getValue(), stored,
+                                   typeBuilder_.convertType(narrowed)),
+                   nullptr, true);
+}
+
+llvm::Value *LLVMCodeGen::emitHeapAllocation(llvm::Type *type,
+                                             const std::string &name,
+                                             const char *allocator,
+                                             llvm::Constant *site,
+                                             llvm::Constant *sharedType) {
+  auto &builder = context_.getBuilder();
+  auto &module = context_.getModule();
+
+  uint64_t size = module.getDataLayout().getTypeAllocSize(type);
+  llvm::Align alignment = typeBuilder_.getAlignment(type);
+
+  std::vector<llvm::Value *> arguments{builder.getInt64(size),
+                                       builder.getInt64(alignment.value())};
+  if (sharedType) {
+    arguments.push_back(sharedType);
+  }
+  if (site) {
+    arguments.push_back(site);
+  }
+  llvm::Value *memory = builder.CreateCall(module.getFunction(allocator),
+                                           arguments, name + ".heap");
+  return builder.CreateBitCast(memory, llvm::PointerType::getUnqual(type),
+                               name);
+}
+
+llvm::Constant *LLVMCodeGen::getSharedType(llvm::StructType *structType) {
+  auto &module = context_.getModule();
+  llvm::Type *bytePtrType = llvm::Type::getInt8PtrTy(context_.getContext());
+  std::string name = structType->getName().str() + ".shared_type";
+  if (llvm::GlobalVariable *existing = module.getNamedGlobal(name)) {
+    return llvm::ConstantExpr::getBitCast(existing, bytePtrType);
+  }
+
+  std::vector<uint32_t> offsets[2]; // #shared, then #weak
+  for (auto [offset, ownership] : getCountedFields(structType)) {
+    offsets[ownership == PointerOwnership::Weak].push_back(offset);
+  }
+  if (offsets[0].empty() && offsets[1].empty()) {
+    return llvm::ConstantPointerNull::get(
+        llvm::cast<llvm::PointerType>(bytePtrType));
+  }
+
+  // Every partition emits the same tables; the linker keeps one copy
+  std::vector<uint32_t> all = offsets[0];
+  all.insert(all.end(), offsets[1].begin(), offsets[1].end());
+  auto &llvmContext = context_.getContext();
+  llvm::Constant *table =
+      llvm::ConstantDataArray::get(llvmContext, llvm::makeArrayRef(all));
+  auto *offsetsGlobal = new llvm::GlobalVariable(
+      module, table->getType(), true, llvm::GlobalValue::LinkOnceODRLinkage,
+      table, structType->getName().str() + ".shared_offsets");
+  offsetsGlobal->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+
+  llvm::Type *int32Type = llvm::Type::getInt32Ty(llvmContext);
+  llvm::Constant *zero = llvm::ConstantInt::get(int32Type, 0);
+  llvm::Constant *descriptor = llvm::ConstantStruct::getAnon(
+      {llvm::ConstantInt::get(int32Type, offsets[0].size()),
+       llvm::ConstantInt::get(int32Type, offsets[1].size()),
+       llvm::ConstantExpr::getInBoundsGetElementPtr(
+           table->getType(), offsetsGlobal,
+           llvm::ArrayRef<llvm::Constant *>{zero, zero})});
+  auto *global = new llvm::GlobalVariable(
+      module, descriptor->getType(), true,
+      llvm::GlobalValue::LinkOnceODRLinkage, descriptor, name);
+  global->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+  return llvm::ConstantExpr::getBitCast(global, bytePtrType);
+}
+
+std::vector<std::pair<uint64_t, PointerOwnership>>
+LLVMCodeGen::getCountedFields(llvm::StructType *structType) {
+  const llvm::DataLayout &layout = context_.getModule().getDataLayout();
+  std::vector<std::pair<uint64_t, PointerOwnership>> counted;
+  std::vector<std::pair<llvm::StructType *, uint64_t>> pending{
+      {structType, 0}};
+  while (!pending.empty()) {
+    auto [type, base] = pending.back();
+    pending.pop_back();
+    auto ownership = fieldOwnership_.find(type);
+    if (ownership == fieldOwnership_.end()) {
+      continue;
+    }
+    const llvm::StructLayout *fields = layout.getStructLayout(type);
+    for (size_t i = 0; i < ownership->second.size(); ++i) {
+      if (ownership->second[i] == PointerOwnership::Shared ||
+          ownership->second[i] == PointerOwnership::Weak) {
+        counted.emplace_back(base + fields->getElementOffset(i),
+                             ownership->second[i]);
+      }
+    }
+    // A derived class embeds its base as the first field
+    const auto *cls = getClassOf(type);
+    if (cls && cls->base) {
+      pending.emplace_back(llvm::cast<llvm::StructType>(type->getElementType(0)),
+                           base);
+    }
+  }
+  return counted;
+}
+
+PointerOwnership LLVMCodeGen::getOwnership(const nodes::TypeNode *type) {
+  auto smart = nodes::dyn_cast<nodes::SmartPointerTypeNode>(type);
+  if (!smart) {
+    return PointerOwnership::Raw;
+  }
+  switch (smart->getKind()) {
+  case nodes::SmartPointerTypeNode::SmartPointerKind::Shared:
+    return PointerOwnership::Shared;
+  case nodes::SmartPointerTypeNode::SmartPointerKind::Unique:
+    return PointerOwnership::Unique;
+  case nodes::SmartPointerTypeNode::SmartPointerKind::Weak:
+    return PointerOwnership::Weak;
+  }
+  return PointerOwnership::Raw;
+}
+
+llvm::Value *LLVMCodeGen::emitOwnedValue(const nodes::ExpressionNode *source,
+                                         PointerOwnership ownership,
+                                         llvm::Type *storageType,
+                                         const std::string &name) {
+  auto &builder = context_.getBuilder();
+
+  // A new object comes with the one reference the variable takes over
+  if (auto newExpr = nodes::dyn_cast<nodes::NewExpressionNode>(source)) {
+    if (ownership == PointerOwnership::Weak) {
+      error(core::SourceLocation(),
+            "#weak pointer '" + name + "' cannot own a new object");
+      return nullptr;
+    }
+    LLVMValue object = visitNewExpr(newExpr, ownership);
+    return object.isValid()
+               ? convertForStore(object.getValue(), storageType, name)
+               : nullptr;
+  }
+
+  LLVMValue value = visitExpr(source);
+  if (!value.isValid()) {
+    return nullptr;
+  }
+  llvm::Value *pointer = convertForStore(
+      value.loadIfLValue(builder).getValue(), storageType, name);
+  if (!pointer || llvm::isa<llvm::ConstantPointerNull>(pointer)) {
+    return pointer; // Null holds no reference
+  }
+
+  PointerOwnership from = value.getOwnership();
+  switch (ownership) {
+  case PointerOwnership::Shared:
+    if (from == PointerOwnership::Shared) {
+      emitRuntimeCall("tspp_shared_retain", pointer);
+      return pointer;
+    }
+    if (from == PointerOwnership::Weak) {
+      return builder.CreateBitCast(emitRuntimeCall("tspp_weak_lock", pointer),
+                                   storageType, name + ".locked");
+    }
+    break;
+  case PointerOwnership::Weak:
+    if (from == PointerOwnership::Shared || from == PointerOwnership::Weak) {
+      emitRuntimeCall("tspp_weak_retain", pointer);
+      return pointer;
+    }
+    break;
+  case PointerOwnership::Unique:
+    if (from == PointerOwnership::Unique) {
+      value.store(builder, llvm::Constant::getNullValue(storageType));
+      return pointer;
+    }
+    break;
+  case PointerOwnership::Raw:
+    return pointer;
+  case PointerOwnership::Arena:
+    break;
+  }
+
+  error(core::SourceLocation(),
+        "Cannot set '" + name + "' from a pointer with different ownership");
+  return nullptr;
+}
+
+void LLVMCodeGen::emitRelease(PointerOwnership ownership,
+                              llvm::Value *pointer) {
+  switch (ownership) {
+  case PointerOwnership::Shared:
+    emitRuntimeCall("tspp_shared_release", pointer);
+    break;
+  case PointerOwnership::Weak:
+    emitRuntimeCall("tspp_weak_release", pointer);
+    break;
+  case PointerOwnership::Unique:
+    // Classes have no destructors yet, so destruction is the free
+    emitRuntimeCall("tspp_free", pointer);
+    break;
+  case PointerOwnership::Arena:
+    emitRuntimeCall("tspp_arena_exit", pointer);
+    break;
+  case PointerOwnership::Raw:
+    break;
+  }
+}
+
+void LLVMCodeGen::freeCopiedObject(const nodes::ExpressionNode *source,
+                                   llvm::Value *object,
+                                   llvm::Type *storageType) {
+  // Interface values refer to the object instead of copying it
+  if (storageType->isStructTy() && !getInterfaceOf(storageType) &&
+      object->getType()->isPointerTy() &&
+      nodes::isa<nodes::NewExpressionNode>(source)) {
+    emitRuntimeCall("tspp_free", object);
+  }
+}
+
+void LLVMCodeGen::emitCleanups(size_t depth, bool unwinding) {
+  if (!currentFunction_) {
+    return;
+  }
+  auto &builder = context_.getBuilder();
+
+  // Innermost scope first, each in reverse declaration order
+  for (size_t scope = currentFunction_->getScopeDepth(); scope-- > depth;) {
+    const auto &cleanups = currentFunction_->getCleanups(scope);
+    for (auto it = cleanups.rbegin(); it != cleanups.rend(); ++it) {
+      if (it->getOwnership() == PointerOwnership::Raw) {
+        if (!unwinding) {
+          emitBufferFree(it->getValue());
+        }
+      } else {
+        emitRelease(it->getOwnership(), it->loadIfLValue(builder).getValue());
+      }
+    }
+  }
+}
+
+bool LLVMCodeGen::ownsBuffer(llvm::Type *type) {
+  return LLVMTypeBuilder::isDynamicArrayType(type) ||
+         type == typeBuilder_.getStringType();
+}
+
+void LLVMCodeGen::emitBufferFree(llvm::Value *value) {
+  llvm::Function *free = context_.getModule().getFunction(
+      LLVMTypeBuilder::isDynamicArrayType(value->getType()->getPointerElementType())
+          ? "tspp_array_free"
+          : "tspp_string_free");
+  context_.getBuilder().CreateCall(
+      free, context_.getBuilder().CreatePointerCast(
+                value, free->getFunctionType()->getParamType(0)));
+}
+
+void LLVMCodeGen::dropEscapingFrees(llvm::Function &function) {
+  auto calls = [](const llvm::Value *value, llvm::StringRef name) {
+    auto call = llvm::dyn_cast<llvm::CallInst>(value);
+    return call && call->getCalledFunction() &&
+           call->getCalledFunction()->getName() == name;
+  };
+  // A temporary that only a concatenation writes or reads
+  auto isConcatSlot = [&](llvm::Value *slot, unsigned operand) {
+    slot = slot->stripInBoundsOffsets();
+    if (!llvm::isa<llvm::AllocaInst>(slot)) {
+      return false;
+    }
+    std::vector<llvm::Value *> pending{slot};
+    while (!pending.empty()) {
+      llvm::Value *address = pending.back();
+      pending.pop_back();
+      for (llvm::User *user : address->users()) {
+        if (llvm::isa<llvm::GetElementPtrInst>(user) ||
+            llvm::isa<llvm::BitCastInst>(user)) {
+          pending.push_back(user);
+        } else if (calls(user, "tspp_string_concat")) {
+          if (llvm::cast<llvm::CallInst>(user)->getArgOperand(operand) !=
+              address) {
+            return false;
+          }
+        } else if (!llvm::isa<llvm::LoadInst>(user) &&
+                   !(llvm::isa<llvm::StoreInst>(user) &&
+                     llvm::cast<llvm::StoreInst>(user)->getPointerOperand() ==
+                         address)) {
+          return false;
+        }
+      }
+    }
+    return true;
+  };
+  // A value built here: a literal, an array literal's elements from
+  // tspp_alloc, or the result of a concatenation
+  auto isFresh = [&](llvm::Value *value) {
+    if (auto load = llvm::dyn_cast<llvm::LoadInst>(value)) {
+      return isConcatSlot(load->getPointerOperand(), 0);
+    }
+    while (auto insert = llvm::dyn_cast<llvm::InsertValueInst>(value)) {
+      if (insert->getIndices()[0] == 0) {
+        return calls(insert->getInsertedValueOperand()->stripInBoundsOffsets(),
+                     "tspp_alloc");
+      }
+      value = insert->getAggregateOperand();
+    }
+    return llvm::isa<llvm::Constant>(value);
+  };
+  auto escapes = [&](llvm::Value *local) {
+    std::vector<llvm::Value *> pending{local};
+    while (!pending.empty()) {
+      llvm::Value *address = pending.back();
+      pending.pop_back();
+      for (llvm::User *user : address->users()) {
+        if (llvm::isa<llvm::BitCastInst>(user) ||
+            llvm::isa<llvm::GetElementPtrInst>(user)) {
+          pending.push_back(user);
+        } else if (auto load = llvm::dyn_cast<llvm::LoadInst>(user)) {
+          // The whole value is only taken apart, or copied into a
+          // concatenation
+          if (load->getType()->isStructTy() &&
+              llvm::any_of(load->users(), [&](llvm::User *value) {
+                auto store = llvm::dyn_cast<llvm::StoreInst>(value);
+                return !llvm::isa<llvm::ExtractValueInst>(value) &&
+                       !(store && store->getValueOperand() == load &&
+                         isConcatSlot(store->getPointerOperand(), 1));
+              })) {
+            return true;
+          }
+        } else if (auto store = llvm::dyn_cast<llvm::StoreInst>(user)) {
+          llvm::Value *stored = store->getValueOperand();
+          if (stored == address ||
+              (stored->getType()->isStructTy() && !isFresh(stored))) {
+            return true;
+          }
+        } else if (auto call = llvm::dyn_cast<llvm::CallInst>(user)) {
+          llvm::Function *callee = call->getCalledFunction();
+          llvm::StringRef name = callee ? callee->getName() : "";
+          if (!call->isLifetimeStartOrEnd() &&
+              !llvm::isa<llvm::DbgInfoIntrinsic>(call) &&
+              name != "tspp_array_grow" && name != "tspp_array_reserve" &&
+              name != "tspp_array_free" && name != "tspp_string_free") {
+            return true;
+          }
+        } else {
+          return true;
+        }
+      }
+    }
+    return false;
+  };
+
+  std::vector<llvm::CallInst *> frees;
+  for (auto &block : function) {
+    for (auto &instruction : block) {
+      if (calls(&instruction, "tspp_array_free") ||
+          calls(&instruction, "tspp_string_free")) {
+        frees.push_back(llvm::cast<llvm::CallInst>(&instruction));
+      }
+    }
+  }
+  std::unordered_map<llvm::Value *, bool> escaped;
+  for (llvm::CallInst *free : frees) {
+    llvm::Value *local = free->getArgOperand(0)->stripPointerCasts();
+    auto known = escaped.find(local);
+    if (known == escaped.end()) {
+      known = escaped
+                  .emplace(local, !llvm::isa<llvm::AllocaInst>(local) ||
+                                      escapes(local))
+                  .first;
+    }
+    if (known->second) {
+      free->eraseFromParent();
+    }
+  }
+}
+
+void LLVMCodeGen::exitScope() {
+  if (!currentFunction_) {
+    return;
+  }
+  llvm::BasicBlock *block = context_.getBuilder().GetInsertBlock();
+  if (block && !block->getTerminator()) {
+    emitCleanups(currentFunction_->getScopeDepth() - 1);
+  }
+  currentFunction_->exitScope();
+}
+
+llvm::Value *LLVMCodeGen::emitRuntimeCall(const char *name,
+                                          llvm::Value *object) {
+  auto &builder = context_.getBuilder();
+  return builder.CreateCall(
+      context_.getModule().getFunction(name),
+      {builder.CreatePointerCast(object, builder.getInt8PtrTy())});
+}
+
+llvm::Value *LLVMCodeGen::emitCondition(const nodes::ExpressionNode *node) {
+  auto &builder = context_.getBuilder();
+
+  LLVMValue condition = visitExpr(node);
+  if (!condition.isValid()) {
+    error(core::SourceLocation(), "Invalid condition expression");
+    return nullptr;
+  }
+
+  llvm::Value *value = condition.loadIfLValue(builder).getValue();
+  llvm::Type *type = value->getType();
+  if (type->isIntegerTy(1)) {
+    return value;
+  }
+  if (type->isIntegerTy()) {
+    return builder.CreateICmpNE(value, llvm::ConstantInt::get(type, 0),
+                                "cond");
+  }
+  if (type->isFloatingPointTy()) {
+    return builder.CreateFCmpONE(value, llvm::ConstantFP::get(type, 0.0),
+                                 "cond");
+  }
+  if (type->isPointerTy()) {
+    return builder.CreateIsNotNull(value, "cond");
+  }
+
+  error(core::SourceLocation(), "Condition must be a boolean or numeric value");
+  return nullptr;
+}
+
+void LLVMCodeGen::annotateLoop(llvm::BasicBlock *header,
+                               llvm::BasicBlock *preheader) {
+  if (!simdFunction_ || !options_.isSIMDEnabled()) {
+    return;
+  }
+
+  auto &llvmContext = context_.getContext();
+  llvm::MDBuilder mdBuilder(llvmContext);
+  llvm::Type *i1 = llvm::Type::getInt1Ty(llvmContext);
+  llvm::Type *i32 = llvm::Type::getInt32Ty(llvmContext);
+
+  llvm::SmallVector<llvm::Metadata *, 4> operands;
+  operands.push_back(nullptr); // Replaced by the self reference below
+  operands.push_back(llvm::MDNode::get(
+      llvmContext,
+      {llvm::MDString::get(llvmContext, "llvm.loop.vectorize.enable"),
+       mdBuilder.createConstant(llvm::ConstantInt::getTrue(i1))}));
+
+  // Preferred width: lanes of the element type (i32) per vector register
+  if (llvm::TargetMachine *targetMachine = target_.getTargetMachine()) {
+    llvm::TargetTransformInfo info =
+        targetMachine->getTargetTransformInfo(*header->getParent());
+    uint64_t registerBits =
+        info.getRegisterBitWidth(
+                llvm::TargetTransformInfo::RGK_FixedWidthVector)
+            .getFixedSize();
+    uint64_t lanes = registerBits / i32->getPrimitiveSizeInBits();
+    if (lanes > 1) {
+      operands.push_back(llvm::MDNode::get(
+          llvmContext,
+          {llvm::MDString::get(llvmContext, "llvm.loop.vectorize.width"),
+           mdBuilder.createConstant(llvm::ConstantInt::get(i32, lanes))}));
+    }
+  }
+
+  llvm::MDNode *loopID = llvm::MDNode::getDistinct(llvmContext, operands);
+  loopID->replaceOperandWith(0, loopID);
+
+  // Every latch must carry the same loop ID, including continue edges
+  for (llvm::BasicBlock *predecessor : llvm::predecessors(header)) {
+    if (predecessor != preheader) {
+      predecessor->getTerminator()->setMetadata(llvm::LLVMContext::MD_loop,
+                                                loopID);
+    }
+  }
+}
+
+// Core visitor implementations
+LLVMValue LLVMCodeGen::visitVarDecl(const nodes::VarDeclNode *node,
+                                    bool isGlobal) {
+  if (isGlobal) {
+    visitGlobalVarDecl(node);
+    return LLVMValue();
+  }
+
+  // Local variable declaration
+  auto &builder = context_.getBuilder();
+
+  // Determine variable type; a function expression gives its own
+  llvm::Type *varType = getStorageType(node->getType());
+  auto closure =
+      nodes::dyn_cast<nodes::FunctionExpressionNode>(node->getInitializer());
+  if (closure && !node->getType()) {
+    varType = getClosureType(closure);
+  }
+  PointerOwnership ownership = getOwnership(node->getType());
+  if (ownership != PointerOwnership::Raw) {
+    if (node->getStorageClass() == tokens::TokenType::HEAP ||
+        node->getStorageClass() == tokens::TokenType::STATIC) {
+      error(core::SourceLocation(),
+            "Smart pointer '" + node->getName() +
+                "' cannot have a #heap or #static storage modifier");
+      return LLVMValue();
+    }
+  } else if (node->getStorageClass() == tokens::TokenType::STATIC) {
+    return visitStaticVarDecl(node, varType);
+  }
+
+  // Create allocation: #heap storage comes from the runtime allocator and
+  // is owned by the variable, so it is freed when the scope ends. #stack and
+  // unqualified locals live in the entry block. Heap storage that never
+  // escapes is moved back to the stack by the optimizer.
+  llvm::Value *storage = nullptr;
+  if (node->getStorageClass() == tokens::TokenType::HEAP) {
+    storage = emitHeapAllocation(varType, node->getName());
+    if (currentFunction_) {
+      LLVMValue block(storage, nullptr, false);
+      block.setOwnership(PointerOwnership::Unique);
+      currentFunction_->addCleanup(block);
+    }
+  } else {
+    llvm::AllocaInst *alloca = createEntryAlloca(varType, node->getName());
+    alloca->setAlignment(typeBuilder_.getAlignment(varType));
+    storage = alloca;
+    if (debugInfo_) {
+      debugInfo_->declareVariable(node->getName(), alloca, node->getLocation(),
+                                  builder.GetInsertBlock());
+    }
+  }
+
+  LLVMValue varValue(storage, nullptr, true); // It's an lvalue
+  varValue.setPointeeAlignment(
+      LLVMTypeBuilder::getPointeeAlignment(node->getType()));
+
+  // Smart pointers start out null and are released when the scope ends
+  if (ownership != PointerOwnership::Raw) {
+    varValue.setOwnership(ownership);
+    llvm::Value *initial = llvm::Constant::getNullValue(varType);
+    if (node->getInitializer()) {
+      initial = emitOwnedValue(node->getInitializer(), ownership, varType,
+                               node->getName());
+      if (!initial) {
+        return LLVMValue();
+      }
+    }
+    varValue.store(builder, initial);
+    if (currentFunction_) {
+      currentFunction_->declareVariable(node->getName(), varValue);
+      currentFunction_->addCleanup(varValue);
+    }
+    return varValue;
+  }
+
+  // Array literals are built in place, or with the declared element type
+  auto literal =
+      nodes::dyn_cast<nodes::ArrayLiteralNode>(node->getInitializer());
+  if (literal && varType->isArrayTy()) {
+    emitArrayElements(literal, storage,
+                      llvm::cast<llvm::ArrayType>(varType));
+  } else if (literal && LLVMTypeBuilder::isDynamicArrayType(varType)) {
+    LLVMValue initValue = visitArrayLiteral(
+        literal, varType->getStructElementType(0)->getPointerElementType());
+    if (initValue.isValid()) {
+      varValue.store(builder, initValue.getValue());
+    }
+  } else if (literal && typeBuilder_.getStructOfArraysElement(varType)) {
+    LLVMValue initValue = visitArrayLiteral(
+        literal, typeBuilder_.getStructOfArraysElement(varType));
+    if (initValue.isValid()) {
+      varValue.store(builder, initValue.getValue());
+    }
+  } else if (!node->getInitializer() &&
+             (LLVMTypeBuilder::isDynamicArrayType(varType) ||
+              typeBuilder_.getStructOfArraysElement(varType))) {
+    // Arrays start out empty
+    varValue.store(builder, llvm::Constant::getNullValue(varType));
+  } else if (!node->getInitializer() && varType->isStructTy()) {
+    // Class values start out as a new object would
+    auto structType = llvm::cast<llvm::StructType>(varType);
+    emitObjectInit(structType,
+                   structType->hasName() ? structType->getName().str() : "",
+                   storage);
+  } else if (emitNewInPlace(node->getInitializer(), varValue)) {
+    // Built where it is stored
+  } else if (node->getInitializer()) {
+    LLVMValue initValue = visitExpr(node->getInitializer());
+    if (initValue.isValid() &&
+        emitAggregateCopy(initValue, varValue, false)) {
+      // Copied field by field in one go
+    } else if (initValue.isValid()) {
+      llvm::Value *loaded = initValue.loadIfLValue(builder).getValue();
+      if (llvm::Value *converted =
+              convertForStore(loaded, varType, node->getName())) {
+        varValue.store(builder, converted);
+        freeCopiedObject(node->getInitializer(), loaded, varType);
+        // A call's result already holds references of its own
+        if (varType->isStructTy() &&
+            !nodes::isa<nodes::CallExpressionNode>(node->getInitializer())) {
+          emitFieldRetains(llvm::cast<llvm::StructType>(varType), storage);
+        }
+      }
+    }
+  }
+
+  // A local class value owns what its #shared and #weak fields refer to,
+  // and a local array or string its elements or bytes
+  if (ownsBuffer(varType)) {
+    if (currentFunction_) {
+      currentFunction_->addCleanup(varValue);
+    }
+  } else if (varType->isStructTy()) {
+    addFieldCleanups(llvm::cast<llvm::StructType>(varType), storage);
+  }
+
+  // Register variable in current scope
+  if (currentFunction_) {
+    currentFunction_->declareVariable(node->getName(), varValue);
+  }
+
+  return varValue;
+}
+
+LLVMValue LLVMCodeGen::visitStaticVarDecl(const nodes::VarDeclNode *node,
+                                          llvm::Type *varType) {
+  auto &builder = context_.getBuilder();
+  auto &llvmContext = context_.getContext();
+  auto &module = context_.getModule();
+  llvm::Function *function = builder.GetInsertBlock()->getParent();
+
+  auto storage = new llvm::GlobalVariable(
+      module, varType, false, llvm::GlobalValue::InternalLinkage,
+      llvm::Constant::getNullValue(varType),
+      function->getName() + "." + node->getName());
+  storage->setAlignment(typeBuilder_.getAlignment(varType));
+
+  LLVMValue varValue(storage, nullptr, true);
+  varValue.setPointeeAlignment(
+      LLVMTypeBuilder::getPointeeAlignment(node->getType()));
+  if (currentFunction_) {
+    currentFunction_->declareVariable(node->getName(), varValue);
+  }
+  if (!node->getInitializer()) {
+    return varValue;
+  }
+
+  // Evaluate into a block of its own first, so a constant leaves no code
+  llvm::BasicBlock *currentBlock = builder.GetInsertBlock();
+  llvm::BasicBlock *initBlock = llvm::BasicBlock::Create(
+      llvmContext, node->getName() + ".init", function);
+  builder.SetInsertPoint(initBlock);
+
+  llvm::Value *converted = nullptr;
+  LLVMValue initValue = visitExpr(node->getInitializer());
+  if (initValue.isValid()) {
+    converted = convertForStore(initValue.loadIfLValue(builder).getValue(),
+                                varType, node->getName());
+  }
+
+  auto constant = llvm::dyn_cast_or_null<llvm::Constant>(converted);
+  if (!converted || (constant && initBlock->empty() &&
+                     builder.GetInsertBlock() == initBlock)) {
+    if (constant) {
+      storage->setInitializer(constant);
+    }
+    initBlock->eraseFromParent();
+    builder.SetInsertPoint(currentBlock);
+    return varValue;
+  }
+
+  // Otherwise run the initializer once, behind a guard flag
+  auto guard = new llvm::GlobalVariable(
+      module, builder.getInt1Ty(), false, llvm::GlobalValue::InternalLinkage,
+      builder.getFalse(), storage->getName() + ".guard");
+  varValue.store(builder, converted);
+  builder.CreateStore(builder.getTrue(), guard);
+  llvm::BasicBlock *doneBlock = llvm::BasicBlock::Create(
+      llvmContext, node->getName() + ".done", function);
+  builder.CreateBr(doneBlock);
+
+  builder.SetInsertPoint(currentBlock);
+  llvm::Value *ready =
+      builder.CreateLoad(builder.getInt1Ty(), guard, node->getName() + ".ready");
+  builder.CreateCondBr(ready, doneBlock, initBlock);
+  builder.SetInsertPoint(doneBlock);
+  return varValue;
+}
+
+LLVMValue LLVMCodeGen::visitBlock(const nodes::BlockNode *node) {
+  // Enter new scope
+  if (currentFunction_) {
+    currentFunction_->enterScope();
+  }
+
+  // An #arena block releases its objects however it is left, including by
+  // an exception
+  if (node->isArena() && currentFunction_) {
+    LLVMValue arena(context_.getBuilder().CreateCall(
+                        context_.getModule().getFunction("tspp_arena_enter"),
+                        {}, "arena"),
+                    nullptr);
+    arena.setOwnership(PointerOwnership::Arena);
+    currentFunction_->addCleanup(arena);
+  }
+
+  LLVMValue lastValue;
+  for (const auto &stmt : node->getStatements()) {
+    lastValue = visitStmt(stmt);
+  }
+
+  exitScope();
+  return lastValue;
+}
+
+LLVMValue LLVMCodeGen::visitStmt(const nodes::StatementNode *node) {
+  if (debugInfo_) {
+    debugInfo_->setLocation(context_.getBuilder(), node->getLocation());
+  }
+  switch (node->getNodeKind()) {
+  case nodes::NodeKind::ExpressionStmt:
+    return visitExprStmt(nodes::cast<nodes::ExpressionStmtNode>(node));
+  case nodes::NodeKind::Block:
+    return visitBlock(nodes::cast<nodes::BlockNode>(node));
+  case nodes::NodeKind::AssemblyStmt:
+    visitAssemblyStatement(nodes::cast<nodes::AssemblyStmtNode>(node));
+    return LLVMValue();
+  case nodes::NodeKind::DeclarationStmt:
+    return visitDeclStmt(nodes::cast<nodes::DeclarationStmtNode>(node));
+  case nodes::NodeKind::ReturnStmt:
+    return visitReturnStmt(nodes::cast<nodes::ReturnStmtNode>(node));
+  case nodes::NodeKind::IfStmt:
+    return visitIfStmt(nodes::cast<nodes::IfStmtNode>(node));
+  case nodes::NodeKind::WhileStmt:
+    return visitWhileStmt(nodes::cast<nodes::WhileStmtNode>(node));
+  case nodes::NodeKind::DoWhileStmt:
+    return visitDoWhileStmt(nodes::cast<nodes::DoWhileStmtNode>(node));
+  case nodes::NodeKind::ForStmt:
+    return visitForStmt(nodes::cast<nodes::ForStmtNode>(node));
+  case nodes::NodeKind::ForOfStmt:
+    return visitForOfStmt(nodes::cast<nodes::ForOfStmtNode>(node));
+  case nodes::NodeKind::BreakStmt:
+    return visitBreakStmt(nodes::cast<nodes::BreakStmtNode>(node));
+  case nodes::NodeKind::ContinueStmt:
+    return visitContinueStmt(nodes::cast<nodes::ContinueStmtNode>(node));
+  case nodes::NodeKind::SwitchStmt:
+    return visitSwitchStmt(nodes::cast<nodes::SwitchStmtNode>(node));
+  case nodes::NodeKind::TryStmt:
+    return visitTryStmt(nodes::cast<nodes::TryStmtNode>(node));
+  case nodes::NodeKind::ThrowStmt:
+    return visitThrowStmt(nodes::cast<nodes::ThrowStmtNode>(node));
+  default:
+    break;
+  }
+
+  // Add other statement types as needed
+  return LLVMValue();
+}
+
+LLVMValue LLVMCodeGen::visitExprStmt(const nodes::ExpressionStmtNode *node) {
+  if (node->getExpression()) {
+    return visitExpr(node->getExpression());
+  }
+  return LLVMValue();
+}
+
+LLVMValue LLVMCodeGen::visitExpr(const nodes::ExpressionNode *node) {
+  LLVMValue value;
+  if (llvm::Constant *folded = getFoldedValue(node)) {
+    value = LLVMValue(folded, nullptr);
+  } else {
+    value = visitExprKind(node);
+  }
+  if (value.isValid() && !value.getType()) {
+    value.setType(node->getResolvedType());
+  }
+  return value;
+}
+
+LLVMValue LLVMCodeGen::visitExprKind(const nodes::ExpressionNode *node) {
+  switch (node->getNodeKind()) {
+  case nodes::NodeKind::LiteralExpression:
+    return visitLiteralExpr(nodes::cast<nodes::LiteralExpressionNode>(node));
+  case nodes::NodeKind::IdentifierExpression:
+    return visitIdentifierExpr(
+        nodes::cast<nodes::IdentifierExpressionNode>(node));
+  case nodes::NodeKind::BinaryExpression:
+    return visitBinaryExpr(nodes::cast<nodes::BinaryExpressionNode>(node));
+  case nodes::NodeKind::UnaryExpression:
+    return visitUnaryExpr(nodes::cast<nodes::UnaryExpressionNode>(node));
+  case nodes::NodeKind::CallExpression:
+    return visitCallExpr(nodes::cast<nodes::CallExpressionNode>(node));
+  case nodes::NodeKind::AssignmentExpression:
+    return visitAssignmentExpr(
+        nodes::cast<nodes::AssignmentExpressionNode>(node));
+  case nodes::NodeKind::NewExpression:
+    return visitNewExpr(nodes::cast<nodes::NewExpressionNode>(node));
+  case nodes::NodeKind::MemberExpression:
+    return visitMemberExpr(nodes::cast<nodes::MemberExpressionNode>(node));
+  case nodes::NodeKind::ThisExpression:
+    return visitThisExpr(nodes::cast<nodes::ThisExpressionNode>(node));
+  case nodes::NodeKind::IndexExpression:
+    return visitIndexExpr(nodes::cast<nodes::IndexExpressionNode>(node));
+  case nodes::NodeKind::ArrayLiteral:
+    return visitArrayLiteral(nodes::cast<nodes::ArrayLiteralNode>(node));
+  case nodes::NodeKind::FunctionExpression:
+    return visitFunctionExpr(nodes::cast<nodes::FunctionExpressionNode>(node));
+  default:
+    break;
+  }
+
+  // Add other expression types as needed
+  return LLVMValue();
+}
+
+LLVMValue
+LLVMCodeGen::visitLiteralExpr(const nodes::LiteralExpressionNode *node) {
+  auto &llvmContext = context_.getContext();
+
+  switch (node->getExpressionType()) {
+  case tokens::TokenType::NUMBER: {
+    // A fraction or exponent makes a float literal
+    const tokens::NumberValue &number = node->getNumber();
+    if (number.isFloat()) {
+      auto floatValue = llvm::ConstantFP::get(
+          llvm::Type::getFloatTy(llvmContext), number.real);
+      return LLVMValue(floatValue, nullptr);
+    }
+    if (!number.isInteger() || number.integer > INT32_MAX) {
+      error(node->getLocation(),
+            "Invalid number literal: " + node->getValue());
+      return LLVMValue();
+    }
+    auto intType = llvm::Type::getInt32Ty(llvmContext);
+    auto intValue = llvm::ConstantInt::get(intType, number.integer);
+    return LLVMValue(intValue, nullptr);
+  }
+  case tokens::TokenType::STRING_LITERAL: {
+    // The token keeps its quotes and escapes
+    std::string_view text = node->getValue();
+    if (text.size() >= 2 && (text[0] == '"' || text[0] == '\'') &&
+        text.back() == text[0]) {
+      text = text.substr(1, text.size() - 2);
+    }
+    return LLVMValue(getStringLiteral(parseStringLiteral(text)), nullptr);
+  }
+  case tokens::TokenType::TRUE:
+  case tokens::TokenType::FALSE: {
+    bool value = (node->getExpressionType() == tokens::TokenType::TRUE);
+    auto boolValue =
+        llvm::ConstantInt::get(llvm::Type::getInt1Ty(llvmContext), value);
+    return LLVMValue(boolValue, nullptr);
+  }
+  default:
+    error(core::SourceLocation(), "Unsupported literal type");
+    return LLVMValue();
+  }
+}
+
+// Optimization and file writing methods
+void LLVMCodeGen::optimize(OptimizationLevel level) {
+  optimizer_.setOptimizationLevel(level);
+  target_.configureModule(context_.getModule());
+  optimizer_.optimizeAll();
+}
+
+bool LLVMCodeGen::writeToFile(const std::string &filename) {
+  core::TimeReport::Scope timer("Emit", filename);
+  auto &module = context_.getModule();
+  target_.configureModule(module);
+
+  switch (options_.getOutputFormat()) {
+  case OutputFormat::LLVM_IR:
+    return context_.writeModuleToFile(filename);
+  case OutputFormat::LLVM_BC:
+    return context_.writeBitcodeToFile(filename);
+  case OutputFormat::ASSEMBLY:
+  case OutputFormat::OBJECT: {
+    auto fileType = options_.getOutputFormat() == OutputFormat::ASSEMBLY
+                        ? llvm::CGFT_AssemblyFile
+                        : llvm::CGFT_ObjectFile;
+    if (!target_.emitFile(module, filename, fileType)) {
+      error(core::SourceLocation(), target_.getLastError());
+      return false;
+    }
+    return true;
+  }
+  case OutputFormat::EXECUTABLE: {
+    // Only the link step leaves the process
+    std::string objectFile = filename + ".o";
+    bool success =
+        target_.emitFile(module, objectFile, llvm::CGFT_ObjectFile) &&
+        target_.linkExecutable({objectFile}, filename, options_);
+    llvm::sys::fs::remove(objectFile);
+    if (!success) {
+      error(core::SourceLocation(), target_.getLastError());
+    }
+    return success;
+  }
+  }
+  return false;
+}
+
+bool LLVMCodeGen::loadForExecution() {
+  // Hand the module to the JIT instead of cloning it. An empty module
+  // means it was already handed over, and its initializers have run.
+  auto &module = context_.getModule();
+  if (module.empty() && module.global_empty()) {
+    return true;
+  }
+  std::string moduleName = module.getName().str();
+  functionTable_.clear();
+  jit_.setObjectCacheDirectory(options_.getJITCacheDirectory());
+  jit_.setProfiling(options_.getJITProfiling());
+  if (!jit_.addModule(context_.takeModule(moduleName))) {
+    error(core::SourceLocation(),
+          "Failed to add module to JIT: " + jit_.getLastError());
+    return false;
+  }
+  if (!jit_.runInitializers()) {
+    error(core::SourceLocation(),
+          "Failed to run initializers: " + jit_.getLastError());
+    return false;
+  }
+  return true;
+}
+
+uint64_t LLVMCodeGen::getExecutionAddress(const std::string &name) {
+  return jit_.isInitialized() ? jit_.lookup(name) : 0;
+}
+
+bool LLVMCodeGen::executeCode() {
+  try {
+    if (!loadForExecution()) {
+      return false;
+    }
+
+    // Only main is compiled here; callees are compiled on first call
+    uint64_t mainAddress = jit_.lookup("main");
+    if (!mainAddress) {
+      error(core::SourceLocation(),
+            "No main function found for execution: " + jit_.getLastError());
+      return false;
+    }
+    auto *mainFunc = reinterpret_cast<int (*)()>(mainAddress);
+    int result = mainFunc();
+    tspp_flush();
+    tspp_counters_write();
+    tspp_alloc_profile_write();
+
+    // Print the return value
+    std::cout << "Program executed, returned: " << result << std::endl;
+
+    return true;
+  } catch (const std::exception &e) {
+    error(core::SourceLocation(),
+          std::string("Error during execution: ") + e.what());
+    return false;
+  }
+}
+
+bool LLVMCodeGen::executeIncremental(const parser::AST &ast) {
+  std::string moduleName = context_.getModule().getName().str();
+  std::string entryName =
+      "__tspp_increment_" + std::to_string(incrementCount_++);
+
+  try {
+    topLevelAssemblyStatements_.clear();
+    topLevelExpressionStatements_.clear();
+    functionTable_.clear();
+    throwingFunctions_.clear();
+    checkSites_.clear();
+    monomorphizer_.clear();
+    // Later inputs call this one's functions by name
+    wholeProgram_ = false;
+
+    declareExternalFunctions();
+    declareTypes(ast);
+    collectFunctionVersions(ast);
+    declareFunctions(ast);
+    closureAnalysis_.analyze(ast);
+    comptime_.declareAST(ast);
+
+    bool success = true;
+    for (const auto &node : ast.getNodes()) {
+      if (!visitTopLevelDeclaration(node)) {
+        success = false;
+        break;
+      }
+    }
+
+    // Top-level statements run once, in an entry of their own
+    llvm::Function *entry = nullptr;
+    if (success && (!topLevelAssemblyStatements_.empty() ||
+                    !topLevelExpressionStatements_.empty())) {
+      entry = createDefaultMainFunction(entryName);
+      success = entry != nullptr;
+    }
+    success = success && emitSpecializations();
+    if (success) {
+      inferNoUnwind();
+    }
+
+    for (auto &function : context_.getModule()) {
+      if (!success) {
+        break;
+      }
+      if (llvm::verifyFunction(function, &llvm::errs())) {
+        error(core::SourceLocation(),
+              "Function verification failed for: " + function.getName().str());
+        success = false;
+      }
+    }
+
+    // Drop the partial module so the next increment starts clean
+    if (!success) {
+      functionTable_.clear();
+      context_.createNewModule(moduleName);
+      return false;
+    }
+
+    target_.configureModule(context_.getModule());
+    optimizer_.optimizeAll();
+
+    // A module the JIT rejects leaves no definitions behind
+    auto savedFunctions = incrementFunctions_;
+    auto savedGlobals = incrementGlobals_;
+    recordIncrementDefinitions(entryName);
+    functionTable_.clear();
+
+    if (!jit_.addModuleNow(context_.takeModule(moduleName))) {
+      incrementFunctions_ = std::move(savedFunctions);
+      incrementGlobals_ = std::move(savedGlobals);
+      error(core::SourceLocation(),
+            "Failed to compile input: " + jit_.getLastError());
+      return false;
+    }
+
+    if (!entry) {
+      return true;
+    }
+
+    uint64_t entryAddress = jit_.lookup(entryName);
+    if (!entryAddress) {
+      error(core::SourceLocation(),
+            "Failed to look up " + entryName + ": " + jit_.getLastError());
+      return false;
+    }
+    reinterpret_cast<int (*)()>(entryAddress)();
+    // Each line's output shows before the next prompt
+    tspp_flush();
+    return true;
+  } catch (const std::exception &e) {
+    functionTable_.clear();
+    context_.createNewModule(moduleName);
+    error(core::SourceLocation(),
+          std::string("Error during execution: ") + e.what());
+    return false;
+  }
+}
+
+llvm::Function *LLVMCodeGen::lookupFunction(const std::string &name,
+                                            core::Symbol symbol) {
+  auto &module = context_.getModule();
+  if (llvm::Function *function = module.getFunction(name)) {
+    return function;
+  }
+
+  auto it = incrementFunctions_.find(symbol);
+  if (it != incrementFunctions_.end()) {
+    return llvm::Function::Create(it->second, llvm::Function::ExternalLinkage,
+                                  name, module);
+  }
+
+  for (const auto &import : imports_) {
+    auto type =
+        import->lookup(symbol, visitors::ModuleInterface::Kind::Function);
+    if (!type || type->getKind() != visitors::ResolvedType::TypeKind::Function) {
+      continue;
+    }
+
+    // Classes are laid out from their declarations, which imports lack
+    llvm::Type *returnType = typeBuilder_.convertType(type->getReturnType());
+    std::vector<llvm::Type *> paramTypes;
+    for (const auto &paramType : type->getParameterTypes()) {
+      paramTypes.push_back(typeBuilder_.convertType(paramType));
+    }
+    auto sized = [](llvm::Type *type) { return type->isSized(); };
+    if ((!returnType->isVoidTy() && !sized(returnType)) ||
+        !std::all_of(paramTypes.begin(), paramTypes.end(), sized)) {
+      error(core::SourceLocation(),
+            "Imported function '" + name +
+                "' passes a class by value, which cannot be declared from "
+                "its interface");
+      return nullptr;
+    }
+    if (type->isAsync()) {
+      asyncResults_[symbol] = returnType;
+      returnType = llvm::Type::getInt8PtrTy(context_.getContext());
+    }
+    llvm::Function *function = llvm::Function::Create(
+        llvm::FunctionType::get(returnType, paramTypes, false),
+        llvm::Function::ExternalLinkage, name, module);
+    if (options_.isWasm()) {
+      // Another module's exports are supplied by the embedder
+      function->addFnAttr("wasm-import-module", "env");
+      function->addFnAttr("wasm-import-name", name);
+    }
+    return function;
+  }
+  return nullptr;
+}
+
+llvm::GlobalVariable *LLVMCodeGen::lookupGlobal(const std::string &name) {
+  auto &module = context_.getModule();
+  if (llvm::GlobalVariable *global = module.getGlobalVariable(name, true)) {
+    return global;
+  }
+
+  auto it = incrementGlobals_.find(core::Interner::instance().intern(name));
+  if (it == incrementGlobals_.end()) {
+    return nullptr;
+  }
+  auto global = new llvm::GlobalVariable(
+      module, it->second.type, it->second.isConst,
+      llvm::GlobalValue::ExternalLinkage, nullptr, name);
+  global->setAlignment(it->second.alignment);
+  return global;
+}
+
+void LLVMCodeGen::recordIncrementDefinitions(const std::string &entryName) {
+  auto &interner = core::Interner::instance();
+  auto &module = context_.getModule();
+
+  for (const auto &function : module) {
+    if (!function.isDeclaration() && function.hasExternalLinkage() &&
+        function.getName() != entryName) {
+      incrementFunctions_[interner.intern(function.getName().str())] =
+          function.getFunctionType();
+    }
+  }
+
+  for (const auto &global : module.globals()) {
+    if (!global.isDeclaration() && global.hasExternalLinkage()) {
+      incrementGlobals_[interner.intern(global.getName().str())] = {
+          global.getValueType(), global.isConstant(), global.getAlign()};
+    }
+  }
+}
+
+// Error reporting
+void LLVMCodeGen::error(const core::SourceLocation &location,
+                        const std::string &message) {
+  errorReporter_.error(location, message);
+}
+
+void LLVMCodeGen::warning(const core::SourceLocation &location,
+                          const std::string &message) {
+  errorReporter_.warning(location, message);
+}
+
+// Stub implementations for other required methods
+void LLVMCodeGen::visitGlobalDecl(const nodes::NodePtr &node) {}
+void LLVMCodeGen::visitClassDecl(const nodes::ClassDeclNode *node) {
+  // Methods belong to the partition that emits the shared definitions
+  if (partition_ && !partition_->ownsEntry) {
+    return;
+  }
+  for (const auto &member : node->getMembers()) {
+    auto method = nodes::dyn_cast<nodes::MethodDeclNode>(member);
+    auto it = methodFunctions_.find(method);
+    if (!method || !method->getBody() || it == methodFunctions_.end()) {
+      continue;
+    }
+    emitBody(it->second, method->getParameters(), method->getReturnType(),
+             method->getModifiers(), method->getTarget(), method->getBody(),
+             true);
+  }
+}
+void LLVMCodeGen::visitNamespaceDecl(const nodes::NamespaceDeclNode *node) {}
+void LLVMCodeGen::visitEnumDecl(const nodes::EnumDeclNode *node) {
+  typeBuilder_.declareAlias(node->getName(),
+                            llvm::Type::getInt32Ty(context_.getContext()));
+  for (const auto *member : node->getMembers()) {
+    enumMembers_[core::Interner::instance().intern(node->getName())]
+                [core::Interner::instance().intern(member->getName())] =
+                    member->getConstantValue();
+  }
+}
+void LLVMCodeGen::visitInterfaceDecl(const nodes::InterfaceDeclNode *node) {
+  // Interfaces have no code of their own: their values are laid out with
+  // the other types, and each itable is built when a class first converts
+}
+LLVMValue LLVMCodeGen::visitParameter(const nodes::ParameterNode *node) {
+  return LLVMValue();
+}
+LLVMValue LLVMCodeGen::visitIfStmt(const nodes::IfStmtNode *node) {
+  auto &builder = context_.getBuilder();
+  auto &llvmContext = context_.getContext();
+  llvm::Function *function = builder.GetInsertBlock()->getParent();
+
+  llvm::Value *condition = emitCondition(node->getCondition());
+  if (!condition) {
+    condition = builder.getFalse();
+  }
+  llvm::BasicBlock *thenBlock =
+      llvm::BasicBlock::Create(llvmContext, "if.then", function);
+  llvm::BasicBlock *endBlock = llvm::BasicBlock::Create(llvmContext, "if.end");
+  llvm::BasicBlock *elseBlock =
+      node->getElseBranch() ? llvm::BasicBlock::Create(llvmContext, "if.else")
+                            : endBlock;
+  builder.CreateCondBr(condition, thenBlock, elseBlock);
+
+  builder.SetInsertPoint(thenBlock);
+  visitStmt(node->getThenBranch());
+  if (!builder.GetInsertBlock()->getTerminator()) {
+    builder.CreateBr(endBlock);
+  }
+
+  if (node->getElseBranch()) {
+    elseBlock->insertInto(function);
+    builder.SetInsertPoint(elseBlock);
+    visitStmt(node->getElseBranch());
+    if (!builder.GetInsertBlock()->getTerminator()) {
+      builder.CreateBr(endBlock);
+    }
+  }
+
+  endBlock->insertInto(function);
+  builder.SetInsertPoint(endBlock);
+  return LLVMValue();
+}
+LLVMValue LLVMCodeGen::visitWhileStmt(const nodes::WhileStmtNode *node) {
+  auto &builder = context_.getBuilder();
+  auto &llvmContext = context_.getContext();
+  llvm::Function *function = builder.GetInsertBlock()->getParent();
+
+  llvm::BasicBlock *condBlock =
+      llvm::BasicBlock::Create(llvmContext, "while.cond", function);
+  llvm::BasicBlock *bodyBlock =
+      llvm::BasicBlock::Create(llvmContext, "while.body", function);
+  llvm::BasicBlock *endBlock =
+      llvm::BasicBlock::Create(llvmContext, "while.end", function);
+
+  llvm::BasicBlock *preheader = builder.GetInsertBlock();
+  builder.CreateBr(condBlock);
+
+  // Condition
+  builder.SetInsertPoint(condBlock);
+  // An invalid condition is already reported; keep the IR well formed
+  llvm::Value *condition = emitCondition(node->getCondition());
+  if (!condition) {
+    condition = builder.getFalse();
+  }
+  builder.CreateCondBr(condition, bodyBlock, endBlock);
+
+  // Body
+  builder.SetInsertPoint(bodyBlock);
+  pushLoop(condBlock, endBlock, node->getLocation());
+  visitStmt(node->getBody());
+  popLoop();
+  if (!builder.GetInsertBlock()->getTerminator()) {
+    builder.CreateBr(condBlock);
+  }
+
+  annotateLoop(condBlock, preheader);
+  builder.SetInsertPoint(endBlock);
+  return LLVMValue();
+}
+LLVMValue LLVMCodeGen::visitDoWhileStmt(const nodes::DoWhileStmtNode *node) {
+  auto &builder = context_.getBuilder();
+  auto &llvmContext = context_.getContext();
+  llvm::Function *function = builder.GetInsertBlock()->getParent();
+
+  // Already in rotated form: the test at the bottom is the only latch
+  llvm::BasicBlock *bodyBlock =
+      llvm::BasicBlock::Create(llvmContext, "do.body", function);
+  llvm::BasicBlock *condBlock =
+      llvm::BasicBlock::Create(llvmContext, "do.cond", function);
+  llvm::BasicBlock *endBlock =
+      llvm::BasicBlock::Create(llvmContext, "do.end", function);
+
+  llvm::BasicBlock *preheader = builder.GetInsertBlock();
+  builder.CreateBr(bodyBlock);
+
+  // Body
+  builder.SetInsertPoint(bodyBlock);
+  pushLoop(condBlock, endBlock, node->getLocation());
+  visitStmt(node->getBody());
+  popLoop();
+  if (!builder.GetInsertBlock()->getTerminator()) {
+    builder.CreateBr(condBlock);
+  }
+
+  // Condition
+  builder.SetInsertPoint(condBlock);
+  llvm::Value *condition = emitCondition(node->getCondition());
+  if (!condition) {
+    condition = builder.getFalse();
+  }
+  builder.CreateCondBr(condition, bodyBlock, endBlock);
+
+  annotateLoop(bodyBlock, preheader);
+  builder.SetInsertPoint(endBlock);
+  return LLVMValue();
+}
+LLVMValue LLVMCodeGen::visitForStmt(const nodes::ForStmtNode *node) {
+  auto &builder = context_.getBuilder();
+  auto &llvmContext = context_.getContext();
+  llvm::Function *function = builder.GetInsertBlock()->getParent();
+
+  // The initializer's variables are scoped to the loop
+  if (currentFunction_) {
+    currentFunction_->enterScope();
+  }
+  if (node->getInitializer()) {
+    visitStmt(node->getInitializer());
+  }
+
+  llvm::BasicBlock *condBlock =
+      llvm::BasicBlock::Create(llvmContext, "for.cond", function);
+  llvm::BasicBlock *bodyBlock =
+      llvm::BasicBlock::Create(llvmContext, "for.body", function);
+  llvm::BasicBlock *incBlock =
+      llvm::BasicBlock::Create(llvmContext, "for.inc", function);
+  llvm::BasicBlock *endBlock =
+      llvm::BasicBlock::Create(llvmContext, "for.end", function);
+
+  llvm::BasicBlock *preheader = builder.GetInsertBlock();
+  builder.CreateBr(condBlock);
+
+  // Condition; an empty one loops until break
+  builder.SetInsertPoint(condBlock);
+  if (node->getCondition()) {
+    llvm::Value *condition = emitCondition(node->getCondition());
+    if (!condition) {
+      condition = builder.getFalse();
+    }
+    builder.CreateCondBr(condition, bodyBlock, endBlock);
+  } else {
+    builder.CreateBr(bodyBlock);
+  }
+
+  // Body
+  builder.SetInsertPoint(bodyBlock);
+  pushLoop(incBlock, endBlock, node->getLocation());
+  visitStmt(node->getBody());
+  popLoop();
+  if (!builder.GetInsertBlock()->getTerminator()) {
+    builder.CreateBr(incBlock);
+  }
+
+  // Increment
+  builder.SetInsertPoint(incBlock);
+  if (node->getIncrement()) {
+    visitExpr(node->getIncrement());
+  }
+  builder.CreateBr(condBlock);
+
+  annotateLoop(condBlock, preheader);
+  builder.SetInsertPoint(endBlock);
+
+  exitScope();
+  return LLVMValue();
+}
+LLVMValue LLVMCodeGen::visitForOfStmt(const nodes::ForOfStmtNode *node) {
+  auto &builder = context_.getBuilder();
+  auto &llvmContext = context_.getContext();
+  llvm::Function *function = builder.GetInsertBlock()->getParent();
+
+  LLVMValue array = visitExpr(node->getIterable());
+  if (!array.isValid()) {
+    return LLVMValue();
+  }
+  ArrayElements elements;
+  if (!getArrayElements(array, elements)) {
+    error(core::SourceLocation(), "for-of needs an array to iterate");
+    return LLVMValue();
+  }
+  if (node->isParallel()) {
+    return emitParallelForOf(node, elements);
+  }
+  if (elements.view) {
+    return emitSliceForOf(node, elements);
+  }
+
+  // A counted loop over the length at entry, so elements pushed by the
+  // body are not visited. The index counts up by one from zero and the
+  // bound is loop invariant, which is the form SCEV computes trip counts
+  // for.
+  if (currentFunction_) {
+    currentFunction_->enterScope();
+  }
+  llvm::AllocaInst *indexSlot =
+      createEntryAlloca(builder.getInt32Ty(), "forof.index");
+  builder.CreateStore(builder.getInt32(0), indexSlot);
+  llvm::AllocaInst *element =
+      createEntryAlloca(elements.elementType, node->getIdentifier());
+  element->setAlignment(typeBuilder_.getAlignment(elements.elementType));
+  if (debugInfo_) {
+    debugInfo_->declareVariable(node->getIdentifier(), element,
+                                node->getLocation(), builder.GetInsertBlock());
+  }
+  if (currentFunction_) {
+    // Borrowed from the array, which keeps ownership of its elements
+    currentFunction_->declareVariable(node->getIdentifier(),
+                                      LLVMValue(element, nullptr, true));
+  }
+
+  llvm::BasicBlock *condBlock =
+      llvm::BasicBlock::Create(llvmContext, "forof.cond", function);
+  llvm::BasicBlock *bodyBlock =
+      llvm::BasicBlock::Create(llvmContext, "forof.body", function);
+  llvm::BasicBlock *incBlock =
+      llvm::BasicBlock::Create(llvmContext, "forof.inc", function);
+  llvm::BasicBlock *endBlock =
+      llvm::BasicBlock::Create(llvmContext, "forof.end", function);
+
+  llvm::BasicBlock *preheader = builder.GetInsertBlock();
+  builder.CreateBr(condBlock);
+
+  builder.SetInsertPoint(condBlock);
+  llvm::Value *index =
+      builder.CreateLoad(builder.getInt32Ty(), indexSlot, "index");
+  builder.CreateCondBr(builder.CreateICmpSLT(index, elements.length, "more"),
+                       bodyBlock, endBlock);
+
+  // A push in the body may move a growable array's elements and an
+  // assignment may replace the array, so its data and length are read
+  // again on every iteration, and the loop ends early if it got shorter
+  builder.SetInsertPoint(bodyBlock);
+  ArrayElements current = elements;
+  if (array.isLValue() &&
+      (LLVMTypeBuilder::isDynamicArrayType(array.getStoredType()) ||
+       typeBuilder_.getStructOfArraysElement(array.getStoredType()))) {
+    current.columns.clear();
+    getArrayElements(array, current);
+    llvm::BasicBlock *loadBlock =
+        llvm::BasicBlock::Create(llvmContext, "forof.load", function, incBlock);
+    builder.CreateCondBr(
+        builder.CreateICmpSLT(index, current.length, "inbounds"), loadBlock,
+        endBlock);
+    builder.SetInsertPoint(loadBlock);
+  }
+  builder.CreateAlignedStore(emitElementLoad(current, index), element,
+                             typeBuilder_.getAlignment(elements.elementType));
+  pushLoop(incBlock, endBlock, node->getLocation());
+  visitStmt(node->getBody());
+  popLoop();
+  if (!builder.GetInsertBlock()->getTerminator()) {
+    builder.CreateBr(incBlock);
+  }
+
+  // The index is below the length, an int, so the increment cannot wrap
+  builder.SetInsertPoint(incBlock);
+  builder.CreateStore(builder.CreateNSWAdd(index, builder.getInt32(1)),
+                      indexSlot);
+  builder.CreateBr(condBlock);
+
+  annotateLoop(condBlock, preheader);
+  builder.SetInsertPoint(endBlock);
+
+  exitScope();
+  return LLVMValue();
+}
+LLVMValue LLVMCodeGen::emitSliceForOf(const nodes::ForOfStmtNode *node,
+                                      const ArrayElements &elements) {
+  auto &builder = context_.getBuilder();
+  auto &llvmContext = context_.getContext();
+  llvm::Function *function = builder.GetInsertBlock()->getParent();
+
+  // Nothing can resize what a slice views, so the loop bumps a pointer to
+  // the end computed at entry
+  if (currentFunction_) {
+    currentFunction_->enterScope();
+  }
+  llvm::Value *end = builder.CreateInBoundsGEP(
+      elements.elementType, elements.data, elements.length, "slice.end");
+  llvm::AllocaInst *cursorSlot =
+      createEntryAlloca(elements.data->getType(), "slice.cursor");
+  builder.CreateStore(elements.data, cursorSlot);
+  llvm::Type *valueType = elements.getValueType();
+  llvm::AllocaInst *element =
+      createEntryAlloca(valueType, node->getIdentifier());
+  element->setAlignment(typeBuilder_.getAlignment(valueType));
+  if (debugInfo_) {
+    debugInfo_->declareVariable(node->getIdentifier(), element,
+                                node->getLocation(), builder.GetInsertBlock());
+  }
+  if (currentFunction_) {
+    currentFunction_->declareVariable(node->getIdentifier(),
+                                      LLVMValue(element, nullptr, true));
+  }
+
+  llvm::BasicBlock *condBlock =
+      llvm::BasicBlock::Create(llvmContext, "forof.cond", function);
+  llvm::BasicBlock *bodyBlock =
+      llvm::BasicBlock::Create(llvmContext, "forof.body", function);
+  llvm::BasicBlock *incBlock =
+      llvm::BasicBlock::Create(llvmContext, "forof.inc", function);
+  llvm::BasicBlock *endBlock =
+      llvm::BasicBlock::Create(llvmContext, "forof.end", function);
+
+  llvm::BasicBlock *preheader = builder.GetInsertBlock();
+  builder.CreateBr(condBlock);
+
+  builder.SetInsertPoint(condBlock);
+  llvm::Value *cursor =
+      builder.CreateLoad(elements.data->getType(), cursorSlot, "cursor");
+  builder.CreateCondBr(builder.CreateICmpNE(cursor, end, "more"), bodyBlock,
+                       endBlock);
+
+  builder.SetInsertPoint(bodyBlock);
+  llvm::Value *value = builder.CreateAlignedLoad(
+      elements.elementType, cursor,
+      typeBuilder_.getAlignment(elements.elementType));
+  builder.CreateAlignedStore(builder.CreateZExtOrBitCast(value, valueType),
+                             element, typeBuilder_.getAlignment(valueType));
+  pushLoop(incBlock, endBlock, node->getLocation());
+  visitStmt(node->getBody());
+  popLoop();
+  if (!builder.GetInsertBlock()->getTerminator()) {
+    builder.CreateBr(incBlock);
+  }
+
+  builder.SetInsertPoint(incBlock);
+  builder.CreateStore(builder.CreateConstInBoundsGEP1_32(
+                          elements.elementType, cursor, 1, "next"),
+                      cursorSlot);
+  builder.CreateBr(condBlock);
+
+  annotateLoop(condBlock, preheader);
+  builder.SetInsertPoint(endBlock);
+
+  exitScope();
+  return LLVMValue();
+}
+
+LLVMValue LLVMCodeGen::emitParallelForOf(const nodes::ForOfStmtNode *node,
+                                         const ArrayElements &elements) {
+  auto &builder = context_.getBuilder();
+  auto &llvmContext = context_.getContext();
+  auto &module = context_.getModule();
+  llvm::Function *caller = builder.GetInsertBlock()->getParent();
+  llvm::PointerType *bytePtrType = builder.getInt8PtrTy();
+  llvm::Type *intType = builder.getInt32Ty();
+
+  // The environment holds the elements and every local in scope, by
+  // address, so iterations share the caller's variables as sequential
+  // ones would. Globals and constants are reachable as they are.
+  std::vector<std::pair<core::Symbol, LLVMValue>> captures;
+  std::vector<llvm::Value *> arrays = elements.columns;
+  if (arrays.empty()) {
+    arrays.push_back(elements.data);
+  }
+  std::vector<llvm::Type *> fields;
+  for (llvm::Value *data : arrays) {
+    fields.push_back(data->getType());
+  }
+  if (currentFunction_) {
+    for (auto &variable : currentFunction_->getVisibleVariables()) {
+      if (!llvm::isa<llvm::Constant>(variable.second.getValue())) {
+        fields.push_back(variable.second.getValue()->getType());
+        captures.push_back(std::move(variable));
+      }
+    }
+  }
+  llvm::StructType *envType = llvm::StructType::get(llvmContext, fields);
+  llvm::AllocaInst *env = createEntryAlloca(envType, "parallel.env");
+  for (size_t i = 0; i < arrays.size(); ++i) {
+    builder.CreateStore(arrays[i], builder.CreateStructGEP(envType, env, i));
+  }
+  for (size_t i = 0; i < captures.size(); ++i) {
+    builder.CreateStore(captures[i].second.getValue(),
+                        builder.CreateStructGEP(envType, env,
+                                                arrays.size() + i));
+  }
+
+  // The workers count their references to what the locals point to, so
+  // those objects switch to atomic counts before the fork. The checker
+  // keeps arrays of counted pointers out of the loop.
+  for (const auto &capture : captures) {
+    const LLVMValue &variable = capture.second;
+    if (!variable.isLValue()) {
+      continue;
+    }
+    if (variable.getOwnership() == PointerOwnership::Shared ||
+        variable.getOwnership() == PointerOwnership::Weak) {
+      emitRuntimeCall("tspp_shared_publish",
+                      variable.loadIfLValue(builder).getValue());
+    } else if (auto structType =
+                   llvm::dyn_cast<llvm::StructType>(variable.getStoredType())) {
+      for (auto [offset, ownership] : getCountedFields(structType)) {
+        emitRuntimeCall("tspp_shared_publish",
+                        builder.CreateLoad(builder.getInt8PtrTy(),
+                                           getCountedFieldAddress(
+                                               variable.getValue(), offset)));
+      }
+    }
+  }
+
+  // void body(i8* env, i32 begin, i32 end), compiled for the caller's
+  // target
+  llvm::Function *outlined = llvm::Function::Create(
+      llvm::FunctionType::get(builder.getVoidTy(),
+                              {bytePtrType, intType, intType}, false),
+      llvm::Function::InternalLinkage, caller->getName() + ".parallel",
+      module);
+  for (const char *attribute : {"target-cpu", "target-features"}) {
+    if (caller->hasFnAttribute(attribute)) {
+      outlined->addFnAttr(caller->getFnAttribute(attribute));
+    }
+  }
+  outlined->addParamAttr(0, llvm::Attribute::NoCapture);
+  outlined->addParamAttr(0, llvm::Attribute::ReadOnly);
+
+  // The caller's function state waits while the body is generated; the
+  // body's loops are the caller's #simd loops
+  EnclosingFunction callerState = suspendFunction();
+  simdFunction_ = callerState.simd;
+  uncheckedFunction_ = callerState.unchecked;
+
+  builder.SetInsertPoint(
+      llvm::BasicBlock::Create(llvmContext, "entry", outlined));
+  if (debugInfo_) {
+    debugInfo_->beginFunction(outlined, node->getLocation());
+    debugInfo_->setLocation(builder, node->getLocation());
+  }
+  currentFunction_ =
+      std::make_unique<LLVMFunction>(context_, outlined, nullptr);
+  auto args = outlined->arg_begin();
+  llvm::Value *envArg =
+      builder.CreateBitCast(&args[0], envType->getPointerTo(), "env");
+  llvm::Value *begin = &args[1];
+  llvm::Value *end = &args[2];
+  begin->setName("begin");
+  end->setName("end");
+  ArrayElements local = elements;
+  for (size_t i = 0; i < arrays.size(); ++i) {
+    llvm::Value *data = builder.CreateLoad(
+        fields[i], builder.CreateStructGEP(envType, envArg, i),
+        local.columns.empty() ? "data" : "column");
+    if (local.columns.empty()) {
+      local.data = data;
+    } else {
+      local.columns[i] = data;
+    }
+  }
+  for (size_t i = 0; i < captures.size(); ++i) {
+    const LLVMValue &original = captures[i].second;
+    size_t field = arrays.size() + i;
+    LLVMValue captured(
+        builder.CreateLoad(fields[field],
+                           builder.CreateStructGEP(envType, envArg, field)),
+        original.getType(), original.isLValue());
+    captured.setPointeeAlignment(original.getPointeeAlignment());
+    captured.setOwnership(original.getOwnership());
+    currentFunction_->declareVariable(captures[i].first, captured);
+  }
+
+  // Nothing may unwind into the runtime's threads; every exception is
+  // caught here and reported
+  auto *uncaughtBlock =
+      llvm::BasicBlock::Create(llvmContext, "parallel.uncaught", outlined);
+  tryStack_.push_back({nullptr, {nullptr}, uncaughtBlock,
+                       currentFunction_->getScopeDepth()});
+  {
+    llvm::IRBuilderBase::InsertPointGuard guard(builder);
+    builder.SetInsertPoint(uncaughtBlock);
+    builder.CreateCall(module.getFunction("tspp_parallel_uncaught"));
+    builder.CreateUnreachable();
+  }
+
+  currentFunction_->enterScope();
+  llvm::AllocaInst *indexSlot = createEntryAlloca(intType, "forof.index");
+  builder.CreateStore(begin, indexSlot);
+  llvm::Type *valueType = elements.getValueType();
+  llvm::AllocaInst *element =
+      createEntryAlloca(valueType, node->getIdentifier());
+  element->setAlignment(typeBuilder_.getAlignment(valueType));
+  if (debugInfo_) {
+    debugInfo_->declareVariable(node->getIdentifier(), element,
+                                node->getLocation(), builder.GetInsertBlock());
+  }
+  currentFunction_->declareVariable(node->getIdentifier(),
+                                    LLVMValue(element, nullptr, true));
+
+  llvm::BasicBlock *condBlock =
+      llvm::BasicBlock::Create(llvmContext, "forof.cond", outlined);
+  llvm::BasicBlock *bodyBlock =
+      llvm::BasicBlock::Create(llvmContext, "forof.body", outlined);
+  llvm::BasicBlock *incBlock =
+      llvm::BasicBlock::Create(llvmContext, "forof.inc", outlined);
+  llvm::BasicBlock *endBlock =
+      llvm::BasicBlock::Create(llvmContext, "forof.end", outlined);
+
+  llvm::BasicBlock *preheader = builder.GetInsertBlock();
+  builder.CreateBr(condBlock);
+
+  builder.SetInsertPoint(condBlock);
+  llvm::Value *index = builder.CreateLoad(intType, indexSlot, "index");
+  builder.CreateCondBr(builder.CreateICmpSLT(index, end, "more"), bodyBlock,
+                       endBlock);
+
+  builder.SetInsertPoint(bodyBlock);
+  builder.CreateAlignedStore(emitElementLoad(local, index), element,
+                             typeBuilder_.getAlignment(valueType));
+  pushLoop(incBlock, endBlock, node->getLocation());
+  visitStmt(node->getBody());
+  popLoop();
+  if (!builder.GetInsertBlock()->getTerminator()) {
+    builder.CreateBr(incBlock);
+  }
+
+  builder.SetInsertPoint(incBlock);
+  builder.CreateStore(builder.CreateNSWAdd(index, builder.getInt32(1)),
+                      indexSlot);
+  builder.CreateBr(condBlock);
+
+  annotateLoop(condBlock, preheader);
+  builder.SetInsertPoint(endBlock);
+  exitScope();
+  builder.CreateRetVoid();
+  llvm::removeUnreachableBlocks(*outlined);
+  if (debugInfo_) {
+    debugInfo_->endFunction(builder);
+  }
+
+  resumeFunction(std::move(callerState));
+
+  builder.CreateCall(module.getFunction("tspp_parallel_for"),
+                     {builder.CreateBitCast(outlined, bytePtrType),
+                      builder.CreateBitCast(env, bytePtrType),
+                      elements.length});
+  return LLVMValue();
+}
+
+LLVMCodeGen::EnclosingFunction LLVMCodeGen::suspendFunction() {
+  auto &builder = context_.getBuilder();
+  EnclosingFunction state;
+  state.insertPoint = builder.saveIP();
+  state.location = builder.getCurrentDebugLocation();
+  state.function = std::move(currentFunction_);
+  state.returnType = currentReturnType_;
+  std::swap(state.loops, loopStack_);
+  std::swap(state.tries, tryStack_);
+  state.exceptionSlot = exceptionSlot_;
+  state.selectorSlot = selectorSlot_;
+  state.resumeBlock = resumeBlock_;
+  state.landingPad = landingPad_;
+  state.landingPadKey = std::move(landingPadKey_);
+  state.coroutine = coroutine_;
+  state.simd = simdFunction_;
+  state.unchecked = uncheckedFunction_;
+  state.tailCall = tailCallFunction_;
+
+  currentReturnType_ = nullptr;
+  exceptionSlot_ = selectorSlot_ = nullptr;
+  resumeBlock_ = landingPad_ = nullptr;
+  landingPadKey_.clear();
+  coroutine_ = CoroutineInfo();
+  simdFunction_ = uncheckedFunction_ = tailCallFunction_ = false;
+  return state;
+}
+
+void LLVMCodeGen::resumeFunction(EnclosingFunction &&state) {
+  auto &builder = context_.getBuilder();
+  currentFunction_ = std::move(state.function);
+  currentReturnType_ = state.returnType;
+  loopStack_ = std::move(state.loops);
+  tryStack_ = std::move(state.tries);
+  exceptionSlot_ = state.exceptionSlot;
+  selectorSlot_ = state.selectorSlot;
+  resumeBlock_ = state.resumeBlock;
+  landingPad_ = state.landingPad;
+  landingPadKey_ = std::move(state.landingPadKey);
+  coroutine_ = state.coroutine;
+  simdFunction_ = state.simd;
+  uncheckedFunction_ = state.unchecked;
+  tailCallFunction_ = state.tailCall;
+  builder.restoreIP(state.insertPoint);
+  builder.SetCurrentDebugLocation(state.location);
+}
+
+LLVMValue LLVMCodeGen::visitReturnStmt(const nodes::ReturnStmtNode *node) {
+  auto &builder = context_.getBuilder();
+  llvm::Function *function = builder.GetInsertBlock()->getParent();
+  llvm::Type *returnType = coroutine_.handle ? coroutine_.resultType
+                                             : function->getReturnType();
+
+  // The value is computed before the scopes release what it may refer to
+  llvm::Value *result = nullptr;
+  if (node->getValue()) {
+    if (returnType->isVoidTy()) {
+      error(core::SourceLocation(), "A void function cannot return a value");
+      return LLVMValue();
+    }
+    PointerOwnership ownership = getOwnership(currentReturnType_);
+    if (ownership != PointerOwnership::Raw) {
+      // The caller takes over a reference of its own
+      result = emitOwnedValue(node->getValue(), ownership, returnType,
+                              "return value");
+    } else {
+      LLVMValue value = visitExpr(node->getValue());
+      if (!value.isValid()) {
+        return LLVMValue();
+      }
+      result = convertForStore(value.loadIfLValue(builder).getValue(),
+                               returnType, "return value");
+      // The caller's copy of a class value holds references of its own
+      if (result && returnType->isStructTy() && value.isLValue() &&
+          value.getStoredType()->isStructTy()) {
+        emitFieldRetains(llvm::cast<llvm::StructType>(returnType),
+                         value.getValue());
+      }
+    }
+    if (!result) {
+      return LLVMValue();
+    }
+  } else if (!returnType->isVoidTy()) {
+    error(core::SourceLocation(), "A non-void function must return a value");
+    return LLVMValue();
+  }
+
+  emitFinallyBlocks(0);
+  emitCleanups(0);
+  if (coroutine_.handle) {
+    // Awaiting callers read the result once the final suspend point wakes
+    // them
+    if (result) {
+      builder.CreateStore(
+          result, builder.CreateStructGEP(getPromiseType(returnType),
+                                          coroutine_.promise, 1));
+    }
+    builder.CreateBr(coroutine_.finalBlock);
+  } else if (result) {
+    markTailCall(result, function);
+    builder.CreateRet(result);
+  } else {
+    builder.CreateRetVoid();
+  }
+
+  // Statements after the return are unreachable but still need a block
+  builder.SetInsertPoint(llvm::BasicBlock::Create(
+      context_.getContext(), "return.after", function));
+  return LLVMValue();
+}
+LLVMValue LLVMCodeGen::visitBreakStmt(const nodes::BreakStmtNode *node) {
+  auto &builder = context_.getBuilder();
+
+  LoopInfo *currentLoop = getCurrentLoop();
+  if (!currentLoop) {
+    error(core::SourceLocation(), "Break statement outside of loop");
+    return LLVMValue();
+  }
+
+  emitFinallyBlocks(currentLoop->scopeDepth);
+  emitCleanups(currentLoop->scopeDepth);
+  builder.CreateBr(currentLoop->breakDest);
+
+  // Statements after the jump are unreachable but still need a block
+  builder.SetInsertPoint(
+      llvm::BasicBlock::Create(context_.getContext(), "break.after",
+                               builder.GetInsertBlock()->getParent()));
+  return LLVMValue();
+}
+LLVMValue LLVMCodeGen::visitContinueStmt(const nodes::ContinueStmtNode *node) {
+  auto &builder = context_.getBuilder();
+
+  // A switch passes continue on to the loop around it
+  LoopInfo *currentLoop = getCurrentLoop();
+  if (!currentLoop || !currentLoop->continueDest) {
+    error(core::SourceLocation(), "Continue statement outside of loop");
+    return LLVMValue();
+  }
+
+  emitFinallyBlocks(currentLoop->continueDepth);
+  emitCleanups(currentLoop->continueDepth);
+  builder.CreateBr(currentLoop->continueDest);
+
+  // Statements after the jump are unreachable but still need a block
+  builder.SetInsertPoint(
+      llvm::BasicBlock::Create(context_.getContext(), "continue.after",
+                               builder.GetInsertBlock()->getParent()));
+  return LLVMValue();
+}
+
+LLVMValue LLVMCodeGen::visitSwitchStmt(const nodes::SwitchStmtNode *node) {
+  auto &builder = context_.getBuilder();
+  auto &llvmContext = context_.getContext();
+  llvm::Function *function = builder.GetInsertBlock()->getParent();
+
+  // switch (typeof x) on a union is a switch on its tag
+  std::shared_ptr<visitors::ResolvedType> tested;
+  const nodes::ExpressionNode *expression = node->getExpression();
+  auto typeOf = nodes::dyn_cast<nodes::UnaryExpressionNode>(expression);
+  if (typeOf && typeOf->getExpressionType() == tokens::TokenType::TYPEOF &&
+      typeOf->getOperand()->getResolvedType() &&
+      typeOf->getOperand()->getResolvedType()->getKind() ==
+          visitors::ResolvedType::TypeKind::Union) {
+    tested = typeOf->getOperand()->getResolvedType();
+    expression = typeOf->getOperand();
+  }
+
+  LLVMValue discriminant = visitExpr(expression);
+  if (!discriminant.isValid()) {
+    return LLVMValue();
+  }
+  llvm::Value *value = tested
+                           ? emitUnionTag(discriminant)
+                           : discriminant.loadIfLValue(builder).getValue();
+  llvm::Type *type = value->getType();
+  bool overStrings = type == typeBuilder_.getStringType();
+  if (!type->isIntegerTy() && !type->isFloatingPointTy() && !overStrings) {
+    error(core::SourceLocation(),
+          "Switch expression must be an integer, a float or a string");
+    return LLVMValue();
+  }
+  llvm::Value *stringSlot =
+      overStrings ? spillToStack(value, "switch.string") : nullptr;
+
+  // Bodies are placed after the tests that select them
+  const auto &cases = node->getCases();
+  std::vector<llvm::BasicBlock *> bodies;
+  for (const auto &switchCase : cases) {
+    bodies.push_back(llvm::BasicBlock::Create(
+        llvmContext, switchCase.isDefault ? "switch.default" : "switch.case"));
+  }
+  llvm::BasicBlock *endBlock =
+      llvm::BasicBlock::Create(llvmContext, "switch.end");
+  llvm::BasicBlock *defaultDest = endBlock;
+
+  // Labels are tested in source order. A run of constant labels is one
+  // switch instruction whose default goes on to the next test, and over
+  // strings, a run of literals is one hashed dispatch.
+  llvm::SwitchInst *table = nullptr;
+  std::vector<std::pair<std::string, llvm::BasicBlock *>> literals;
+  for (size_t i = 0; i < cases.size(); ++i) {
+    if (cases[i].isDefault) {
+      defaultDest = bodies[i];
+      continue;
+    }
+    llvm::Value *labelValue = nullptr;
+    if (tested) {
+      auto literal =
+          nodes::dyn_cast<nodes::LiteralExpressionNode>(cases[i].value);
+      int tag = literal && literal->getValue().size() >= 2
+                    ? getUnionTag(tested, literal->getValue().substr(
+                                              1, literal->getValue().size() - 2))
+                    : -1;
+      labelValue = tag >= 0 ? builder.getInt32(tag) : nullptr;
+    } else {
+      LLVMValue label = visitExpr(cases[i].value);
+      if (!label.isValid()) {
+        continue;
+      }
+      labelValue = label.loadIfLValue(builder).getValue();
+      labelValue = !overStrings ? convertNumeric(labelValue, type)
+                   : labelValue->getType() == type ? labelValue
+                                                   : nullptr;
+    }
+    if (!labelValue) {
+      error(core::SourceLocation(),
+            "Case value type doesn't match switch expression type");
+      continue;
+    }
+
+    if (overStrings) {
+      // A repeated literal never matches; the first one wins
+      std::string text;
+      if (getStringLiteralText(labelValue, text)) {
+        if (std::none_of(literals.begin(), literals.end(),
+                         [&](const auto &literal) {
+                           return literal.first == text;
+                         })) {
+          literals.emplace_back(text, bodies[i]);
+        }
+        continue;
+      }
+      if (!literals.empty()) {
+        auto next = llvm::BasicBlock::Create(llvmContext, "switch.next",
+                                             function);
+        emitStringDispatch(stringSlot, literals, next);
+        literals.clear();
+        builder.SetInsertPoint(next);
+      }
+      llvm::Value *equal = builder.CreateCall(
+          context_.getModule().getFunction("tspp_string_equals"),
+          {stringSlot, spillToStack(labelValue, "case")});
+      auto next = llvm::BasicBlock::Create(llvmContext, "switch.test",
+                                           function);
+      builder.CreateCondBr(builder.CreateICmpNE(equal, builder.getInt32(0)),
+                           bodies[i], next);
+      builder.SetInsertPoint(next);
+      continue;
+    }
+
+    if (auto constant = llvm::dyn_cast<llvm::ConstantInt>(labelValue)) {
+      if (!table) {
+        auto next = llvm::BasicBlock::Create(llvmContext, "switch.next",
+                                             function);
+        table = builder.CreateSwitch(value, next, cases.size());
+        builder.SetInsertPoint(next);
+      }
+      // A repeated label never matches; the first one wins
+      if (table->findCaseValue(constant) == table->case_default()) {
+        table->addCase(constant, bodies[i]);
+      }
+      continue;
+    }
+
+    table = nullptr;
+    llvm::Value *match = type->isIntegerTy()
+                             ? builder.CreateICmpEQ(value, labelValue)
+                             : builder.CreateFCmpOEQ(value, labelValue);
+    auto next = llvm::BasicBlock::Create(llvmContext, "switch.test", function);
+    builder.CreateCondBr(match, bodies[i], next);
+    builder.SetInsertPoint(next);
+  }
+
+  // When the last test is a table, it can go to the default directly
+  llvm::BasicBlock *last = builder.GetInsertBlock();
+  if (!literals.empty()) {
+    emitStringDispatch(stringSlot, literals, defaultDest);
+  } else if (table && table->getDefaultDest() == last && last->empty()) {
+    table->setDefaultDest(defaultDest);
+    last->eraseFromParent();
+  } else {
+    builder.CreateBr(defaultDest);
+  }
+
+  // Break leaves the switch, and continue the loop around it
+  LoopInfo *outer = getCurrentLoop();
+  size_t depth = currentFunction_ ? currentFunction_->getScopeDepth() : 0;
+  loopStack_.push({outer ? outer->continueDest : nullptr, endBlock, depth,
+                   outer ? outer->continueDepth : 0});
+
+  for (size_t i = 0; i < cases.size(); ++i) {
+    bodies[i]->insertInto(function);
+    builder.SetInsertPoint(bodies[i]);
+    if (currentFunction_) {
+      currentFunction_->enterScope();
+    }
+    for (const auto &stmt : cases[i].body) {
+      visitStmt(stmt);
+    }
+    exitScope();
+
+    // Without a break, a case falls through to the next body
+    if (!builder.GetInsertBlock()->getTerminator()) {
+      builder.CreateBr(i + 1 < cases.size() ? bodies[i + 1] : endBlock);
+    }
+  }
+  popLoop();
+
+  endBlock->insertInto(function);
+  builder.SetInsertPoint(endBlock);
+  return LLVMValue();
+}
+
+void LLVMCodeGen::emitStringDispatch(
+    llvm::Value *slot,
+    const std::vector<std::pair<std::string, llvm::BasicBlock *>> &labels,
+    llvm::BasicBlock *miss) {
+  auto &builder = context_.getBuilder();
+  auto &llvmContext = context_.getContext();
+  auto &module = context_.getModule();
+  llvm::Function *function = builder.GetInsertBlock()->getParent();
+  llvm::StructType *stringType = typeBuilder_.getStringType();
+  llvm::Type *int64Type = builder.getInt64Ty();
+  llvm::Type *sizeType = module.getDataLayout().getIntPtrType(llvmContext);
+
+  std::map<uint64_t, std::vector<size_t>> byLength;
+  for (size_t i = 0; i < labels.size(); ++i) {
+    byLength[labels[i].first.size()].push_back(i);
+  }
+  llvm::Value *length = builder.CreateLoad(
+      int64Type, builder.CreateStructGEP(stringType, slot, 0), "length");
+  llvm::SwitchInst *lengths =
+      builder.CreateSwitch(length, miss, byLength.size());
+
+  // One memcmp tells whether the string is the label its hash selected
+  auto confirm = [&](llvm::Value *bytes, size_t label,
+                     llvm::BasicBlock *otherwise) {
+    const std::string &text = labels[label].first;
+    if (text.empty()) {
+      builder.CreateBr(labels[label].second);
+      return;
+    }
+    llvm::GlobalVariable *expected = context_.getStringConstant(text);
+    llvm::Value *order = builder.CreateCall(
+        module.getFunction("memcmp"),
+        {bytes,
+         builder.CreateConstInBoundsGEP2_64(expected->getValueType(),
+                                            expected, 0, 0),
+         llvm::ConstantInt::get(sizeType, text.size())});
+    builder.CreateCondBr(builder.CreateICmpEQ(order, builder.getInt32(0)),
+                         labels[label].second, otherwise);
+  };
+
+  for (const auto &[size, group] : byLength) {
+    auto block = llvm::BasicBlock::Create(llvmContext, "string.length",
+                                          function);
+    lengths->addCase(llvm::ConstantInt::get(
+                         llvm::cast<llvm::IntegerType>(int64Type), size),
+                     block);
+    builder.SetInsertPoint(block);
+
+    // Short strings hold their bytes where longer ones hold the pointer
+    llvm::Value *field = builder.CreateStructGEP(stringType, slot, 1);
+    llvm::Value *bytes =
+        size < getStringSmallLimit()
+            ? builder.CreateBitCast(field, builder.getInt8PtrTy(), "bytes")
+            : builder.CreateLoad(builder.getInt8PtrTy(), field, "bytes");
+
+    std::vector<std::string> texts;
+    for (size_t label : group) {
+      texts.push_back(labels[label].first);
+    }
+    StringSwitchPlan plan;
+    if (group.size() == 1 || !plan.build(texts)) {
+      // Without a plan, a label that fails goes on to the next
+      for (size_t i = 0; i + 1 < group.size(); ++i) {
+        auto next = llvm::BasicBlock::Create(llvmContext, "string.next",
+                                             function);
+        confirm(bytes, group[i], next);
+        builder.SetInsertPoint(next);
+      }
+      confirm(bytes, group.back(), miss);
+      continue;
+    }
+
+    // The hash of the plan's positions, then its bucket's displacement
+    llvm::Value *hash = builder.getInt64(plan.seed);
+    for (size_t position : plan.positions) {
+      llvm::Value *byte = builder.CreateLoad(
+          builder.getInt8Ty(),
+          builder.CreateConstInBoundsGEP1_64(builder.getInt8Ty(), bytes,
+                                             position));
+      hash = builder.CreateMul(
+          builder.CreateXor(hash, builder.CreateZExt(byte, int64Type)),
+          builder.getInt64(StringSwitchPlan::kStep), "hash");
+    }
+    llvm::Value *displacement = builder.getInt64(plan.displacements[0]);
+    if (plan.bucketBits) {
+      std::vector<llvm::Constant *> values;
+      for (uint32_t d : plan.displacements) {
+        values.push_back(builder.getInt32(d));
+      }
+      auto tableType = llvm::ArrayType::get(builder.getInt32Ty(),
+                                            values.size());
+      auto table = new llvm::GlobalVariable(
+          module, tableType, true, llvm::GlobalValue::PrivateLinkage,
+          llvm::ConstantArray::get(tableType, values), "switch.displacements");
+      table->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+      llvm::Value *bucket = builder.CreateLShr(
+          builder.CreateMul(hash,
+                            builder.getInt64(StringSwitchPlan::kBucketMix)),
+          64 - plan.bucketBits, "bucket");
+      displacement = builder.CreateZExt(
+          builder.CreateLoad(builder.getInt32Ty(),
+                             builder.CreateInBoundsGEP(
+                                 tableType, table,
+                                 {builder.getInt64(0), bucket})),
+          int64Type);
+    }
+    llvm::Value *index = builder.CreateTrunc(
+        builder.CreateLShr(
+            builder.CreateMul(builder.CreateXor(hash, displacement),
+                              builder.getInt64(StringSwitchPlan::kMix)),
+            64 - plan.slotBits),
+        builder.getInt32Ty(), "slot");
+
+    llvm::SwitchInst *slots =
+        builder.CreateSwitch(index, miss, group.size());
+    for (size_t i = 0; i < group.size(); ++i) {
+      auto check = llvm::BasicBlock::Create(llvmContext, "string.confirm",
+                                            function);
+      slots->addCase(builder.getInt32(plan.slots[i]), check);
+      builder.SetInsertPoint(check);
+      confirm(bytes, group[i], miss);
+    }
+  }
+}
+
+LLVMValue LLVMCodeGen::visitTryStmt(const nodes::TryStmtNode *node) {
+  auto &builder = context_.getBuilder();
+  auto &llvmContext = context_.getContext();
+  auto &module = context_.getModule();
+
+  if (!currentFunction_) {
+    error(core::SourceLocation(),
+          "Try statements are only supported inside functions");
+    return LLVMValue();
+  }
+  llvm::Function *function = builder.GetInsertBlock()->getParent();
+  const size_t depth = currentFunction_->getScopeDepth();
+  const auto &clauses = node->getCatchClauses();
+  const nodes::StatementNode *finallyBlock = node->getFinallyBlock();
+
+  // An untyped catch parameter catches everything, as an int like other
+  // unannotated variables
+  std::vector<llvm::Constant *> typeInfos;
+  std::vector<llvm::Type *> paramTypes;
+  for (const auto &clause : clauses) {
+    if (!clause.parameterType) {
+      typeInfos.push_back(nullptr);
+      paramTypes.push_back(llvm::Type::getInt32Ty(llvmContext));
+      continue;
+    }
+    llvm::Type *type = getStorageType(clause.parameterType);
+    llvm::Constant *typeInfo = getTypeInfo(type);
+    if (!typeInfo) {
+      error(core::SourceLocation(),
+            "Cannot catch values of type '" +
+                clause.parameterType->toString() + "'");
+      return LLVMValue();
+    }
+    typeInfos.push_back(typeInfo);
+    paramTypes.push_back(type);
+  }
+
+  llvm::BasicBlock *dispatch =
+      clauses.empty()
+          ? nullptr
+          : llvm::BasicBlock::Create(llvmContext, "catch.dispatch", function);
+  llvm::BasicBlock *unwind =
+      finallyBlock
+          ? llvm::BasicBlock::Create(llvmContext, "finally.unwind", function)
+          : nullptr;
+  llvm::BasicBlock *endBlock =
+      llvm::BasicBlock::Create(llvmContext, "try.end", function);
+
+  tryStack_.push_back({node, typeInfos, dispatch ? dispatch : unwind, depth});
+  visitStmt(node->getTryBlock());
+  tryStack_.pop_back();
+  if (!builder.GetInsertBlock()->getTerminator()) {
+    builder.CreateBr(endBlock);
+  }
+
+  if (dispatch) {
+    // Exceptions thrown by a catch body still run the finally block
+    if (unwind) {
+      tryStack_.push_back({node, {}, unwind, depth});
+    }
+    createExceptionSlots();
+    llvm::PointerType *bytePtrType = builder.getInt8PtrTy();
+    const llvm::DataLayout &layout = module.getDataLayout();
+    llvm::Function *typeIdFor =
+        llvm::Intrinsic::getDeclaration(&module, llvm::Intrinsic::eh_typeid_for);
+
+    builder.SetInsertPoint(dispatch);
+    llvm::Value *selector =
+        builder.CreateLoad(builder.getInt32Ty(), selectorSlot_, "sel");
+    for (size_t i = 0; i < clauses.size(); ++i) {
+      // Foreign exceptions arrive with selector 0, so even catch-alls
+      // compare
+      llvm::Constant *typeInfo =
+          typeInfos[i] ? typeInfos[i]
+                       : llvm::ConstantPointerNull::get(bytePtrType);
+      llvm::Value *typeId = builder.CreateCall(typeIdFor, {typeInfo}, "typeid");
+      auto *handler = llvm::BasicBlock::Create(llvmContext, "catch", function);
+      auto *next =
+          llvm::BasicBlock::Create(llvmContext, "catch.next", function);
+      builder.CreateCondBr(builder.CreateICmpEQ(selector, typeId, "matches"),
+                           handler, next);
+
+      // The parameter receives a copy of the value, so the exception is
+      // released before the body runs
+      builder.SetInsertPoint(handler);
+      currentFunction_->enterScope();
+      llvm::AllocaInst *param = currentFunction_->createEntryAlloca(
+          paramTypes[i], clauses[i].parameter);
+      param->setAlignment(typeBuilder_.getAlignment(paramTypes[i]));
+      builder.CreateCall(
+          module.getFunction("tspp_catch"),
+          {builder.CreateLoad(bytePtrType, exceptionSlot_, "exn"),
+           builder.CreatePointerCast(param, bytePtrType),
+           builder.getInt64(layout.getTypeAllocSize(paramTypes[i]))});
+      currentFunction_->declareVariable(clauses[i].parameter,
+                                        LLVMValue(param, nullptr, true));
+      visitStmt(clauses[i].body);
+      exitScope();
+      if (!builder.GetInsertBlock()->getTerminator()) {
+        builder.CreateBr(endBlock);
+      }
+      builder.SetInsertPoint(next);
+    }
+
+    if (unwind) {
+      tryStack_.pop_back();
+      builder.CreateBr(unwind);
+    } else {
+      emitUnwind();
+    }
+  }
+
+  if (unwind) {
+    // A try statement inside the finally block may reuse the slots
+    createExceptionSlots();
+    builder.SetInsertPoint(unwind);
+    llvm::Value *exception =
+        builder.CreateLoad(builder.getInt8PtrTy(), exceptionSlot_, "exn");
+    llvm::Value *selector =
+        builder.CreateLoad(builder.getInt32Ty(), selectorSlot_, "sel");
+    visitStmt(finallyBlock);
+    if (!builder.GetInsertBlock()->getTerminator()) {
+      builder.CreateStore(exception, exceptionSlot_);
+      builder.CreateStore(selector, selectorSlot_);
+      emitUnwind();
+    }
+  }
+
+  builder.SetInsertPoint(endBlock);
+  if (finallyBlock) {
+    visitStmt(finallyBlock);
+  }
+  return LLVMValue();
+}
+
+LLVMValue LLVMCodeGen::visitThrowStmt(const nodes::ThrowStmtNode *node) {
+  auto &builder = context_.getBuilder();
+  auto &module = context_.getModule();
+
+  LLVMValue value = visitExpr(node->getValue());
+  if (!value.isValid()) {
+    return LLVMValue();
+  }
+  llvm::Value *thrown = value.loadIfLValue(builder).getValue();
+  if (getInterfaceOf(thrown->getType())) {
+    error(core::SourceLocation(),
+          "Cannot throw an interface value; throw the object instead");
+    return LLVMValue();
+  }
+
+  // Objects are thrown by value, like class variables hold them. Other
+  // values are spilled so the runtime can copy them.
+  llvm::Type *type = thrown->getType();
+  llvm::Value *object = thrown;
+  if (type->isPointerTy() && getClassOf(type)) {
+    type = type->getPointerElementType();
+    if (nodes::isa<nodes::NewExpressionNode>(node->getValue())) {
+      // Nothing else refers to a new object, so the exception keeps the
+      // only copy
+      object = createEntryAlloca(type, "thrown");
+      builder.CreateStore(builder.CreateLoad(type, thrown), object);
+      emitRuntimeCall("tspp_free", thrown);
+    }
+  } else {
+    object = createEntryAlloca(type, "thrown");
+    builder.CreateStore(thrown, object);
+  }
+
+  llvm::Constant *typeInfo = getTypeInfo(type);
+  if (!typeInfo) {
+    error(core::SourceLocation(),
+          "Only class objects, numbers, booleans and strings can be thrown");
+    return LLVMValue();
+  }
+  emitCall(module.getFunction("tspp_throw"),
+           {typeInfo, builder.CreatePointerCast(object, builder.getInt8PtrTy()),
+            builder.getInt64(module.getDataLayout().getTypeAllocSize(type))});
+  builder.CreateUnreachable();
+
+  // Statements after the throw are unreachable but still need a block
+  builder.SetInsertPoint(
+      llvm::BasicBlock::Create(context_.getContext(), "throw.after",
+                               builder.GetInsertBlock()->getParent()));
+  return LLVMValue();
+}
+
+llvm::Value *LLVMCodeGen::emitCall(llvm::FunctionCallee callee,
+                                   llvm::ArrayRef<llvm::Value *> args,
+                                   const llvm::Twine &name) {
+  auto &builder = context_.getBuilder();
+
+  // Runtime and C library functions are declared nounwind
+  auto *function = llvm::dyn_cast<llvm::Function>(
+      callee.getCallee()->stripPointerCasts());
+  llvm::BasicBlock *landingPad =
+      function && function->doesNotThrow() ? nullptr : getLandingPad();
+  llvm::CallBase *result;
+  if (!landingPad) {
+    result = builder.CreateCall(callee, args, name);
+  } else {
+    auto *next =
+        llvm::BasicBlock::Create(context_.getContext(), "invoke.cont",
+                                 builder.GetInsertBlock()->getParent());
+    result = builder.CreateInvoke(callee, next, landingPad, args, name);
+    builder.SetInsertPoint(next);
+  }
+
+  // Calls must use the convention the callee was defined with
+  if (function) {
+    result->setCallingConv(function->getCallingConv());
+  }
+  return result;
+}
+
+void LLVMCodeGen::markTailCall(llvm::Value *result, llvm::Function *caller) {
+  auto *call = llvm::dyn_cast<llvm::CallBase>(result);
+  if (!call) {
+    return;
+  }
+  llvm::Function *callee = call->getCalledFunction();
+  std::string name = callee ? "'" + callee->getName().str() + "'" : "callee";
+  std::string callerName = "'" + caller->getName().str() + "'";
+  auto reject = [&](const std::string &reason) {
+    if (tailCallFunction_) {
+      error(core::SourceLocation(),
+            "Call to " + name + " cannot be a tail call: " + reason);
+    }
+  };
+
+  // Anything between the call and the return, even the branch out of an
+  // invoke, needs the caller's frame after the call
+  if (llvm::isa<llvm::InvokeInst>(call)) {
+    reject("an exception it throws is handled in " + callerName);
+    return;
+  }
+  if (&context_.getBuilder().GetInsertBlock()->back() != call) {
+    reject("its result is converted, or locals are released after it");
+    return;
+  }
+
+  // Neither kind of tail call may be handed the address of a local
+  for (llvm::Value *arg : call->args()) {
+    if (holdsFrameAddress(arg)) {
+      reject("an argument points into the frame of " + callerName);
+      return;
+    }
+  }
+
+  auto *tail = llvm::cast<llvm::CallInst>(call);
+  if (call->getFunctionType() == caller->getFunctionType() &&
+      call->getCallingConv() == caller->getCallingConv()) {
+    tail->setTailCallKind(llvm::CallInst::TCK_MustTail);
+  } else {
+    reject(name + " does not have the signature of " + callerName);
+    tail->setTailCallKind(llvm::CallInst::TCK_Tail);
+  }
+}
+
+bool LLVMCodeGen::holdsFrameAddress(llvm::Value *value) {
+  std::function<bool(llvm::Type *)> holdsPointer = [&](llvm::Type *type) {
+    if (type->isPointerTy()) {
+      return true;
+    }
+    return std::any_of(type->subtype_begin(), type->subtype_end(),
+                       holdsPointer);
+  };
+
+  std::vector<llvm::Value *> work = {value};
+  std::unordered_set<llvm::Value *> seen;
+  while (!work.empty()) {
+    llvm::Value *current = work.back();
+    work.pop_back();
+    if (current->getType()->isPointerTy()) {
+      current = llvm::getUnderlyingObject(current);
+      if (llvm::isa<llvm::AllocaInst>(current)) {
+        return true;
+      }
+    }
+    if (!seen.insert(current).second || llvm::isa<llvm::Constant>(current) ||
+        llvm::isa<llvm::Argument>(current)) {
+      continue;
+    }
+
+    // Follow the pieces an address may have come through
+    if (auto *insert = llvm::dyn_cast<llvm::InsertValueInst>(current)) {
+      work.push_back(insert->getAggregateOperand());
+      work.push_back(insert->getInsertedValueOperand());
+    } else if (auto *extract = llvm::dyn_cast<llvm::ExtractValueInst>(current)) {
+      work.push_back(extract->getAggregateOperand());
+    } else if (auto *phi = llvm::dyn_cast<llvm::PHINode>(current)) {
+      work.insert(work.end(), phi->incoming_values().begin(),
+                  phi->incoming_values().end());
+    } else if (auto *select = llvm::dyn_cast<llvm::SelectInst>(current)) {
+      work.push_back(select->getTrueValue());
+      work.push_back(select->getFalseValue());
+    } else if (current->getType()->isAggregateType() &&
+               holdsPointer(current->getType())) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void LLVMCodeGen::createExceptionSlots() {
+  if (exceptionSlot_) {
+    return;
+  }
+  exceptionSlot_ = currentFunction_->createEntryAlloca(
+      llvm::Type::getInt8PtrTy(context_.getContext()), "exn.slot");
+  selectorSlot_ = currentFunction_->createEntryAlloca(
+      llvm::Type::getInt32Ty(context_.getContext()), "ehselector.slot");
+}
+
+llvm::BasicBlock *LLVMCodeGen::getLandingPad() {
+  if (!currentFunction_) {
+    return nullptr;
+  }
+
+  // A landing pad is determined by the innermost try statement and the
+  // cleanups inside it that run while unwinding
+  size_t depth = tryStack_.empty() ? 0 : tryStack_.back().scopeDepth;
+  std::vector<const void *> key{tryStack_.empty() ? nullptr
+                                                  : tryStack_.back().dispatch};
+  for (size_t scope = depth; scope < currentFunction_->getScopeDepth();
+       ++scope) {
+    for (const auto &cleanup : currentFunction_->getCleanups(scope)) {
+      if (cleanup.getOwnership() != PointerOwnership::Raw) {
+        key.push_back(cleanup.getValue());
+      }
+    }
+  }
+  if (tryStack_.empty() && key.size() == 1) {
+    return nullptr;
+  }
+  if (landingPad_ && key == landingPadKey_) {
+    return landingPad_;
+  }
+
+  auto &builder = context_.getBuilder();
+  auto &llvmContext = context_.getContext();
+  llvm::Function *function = builder.GetInsertBlock()->getParent();
+  if (!function->hasPersonalityFn()) {
+    function->setPersonalityFn(
+        context_.getModule().getFunction("tspp_personality"));
+  }
+  createExceptionSlots();
+
+  llvm::IRBuilderBase::InsertPointGuard guard(builder);
+  auto *block = llvm::BasicBlock::Create(llvmContext, "lpad", function);
+  builder.SetInsertPoint(block);
+
+  // Every enclosing handler is listed, innermost first, so the unwinder
+  // stops here whichever of them catches
+  llvm::PointerType *bytePtrType = builder.getInt8PtrTy();
+  std::vector<llvm::Constant *> clauses;
+  for (auto it = tryStack_.rbegin(); it != tryStack_.rend(); ++it) {
+    for (llvm::Constant *typeInfo : it->typeInfos) {
+      clauses.push_back(typeInfo ? typeInfo
+                                 : llvm::ConstantPointerNull::get(bytePtrType));
+    }
+  }
+  llvm::LandingPadInst *pad = builder.CreateLandingPad(
+      llvm::StructType::get(bytePtrType, builder.getInt32Ty()),
+      clauses.size());
+  for (llvm::Constant *clause : clauses) {
+    pad->addClause(clause);
+  }
+  // Cleanups and finally blocks run even when the handler is further out
+  pad->setCleanup(true);
+
+  builder.CreateStore(builder.CreateExtractValue(pad, 0, "exn"),
+                      exceptionSlot_);
+  builder.CreateStore(builder.CreateExtractValue(pad, 1, "sel"),
+                      selectorSlot_);
+  emitUnwind();
+
+  landingPad_ = block;
+  landingPadKey_ = std::move(key);
+  return block;
+}
+
+llvm::BasicBlock *LLVMCodeGen::getResumeBlock() {
+  if (resumeBlock_) {
+    return resumeBlock_;
+  }
+  auto &builder = context_.getBuilder();
+  llvm::IRBuilderBase::InsertPointGuard guard(builder);
+  resumeBlock_ =
+      llvm::BasicBlock::Create(context_.getContext(), "eh.resume",
+                               builder.GetInsertBlock()->getParent());
+  builder.SetInsertPoint(resumeBlock_);
+
+  llvm::Type *padType =
+      llvm::StructType::get(builder.getInt8PtrTy(), builder.getInt32Ty());
+  llvm::Value *pad = llvm::UndefValue::get(padType);
+  pad = builder.CreateInsertValue(
+      pad, builder.CreateLoad(builder.getInt8PtrTy(), exceptionSlot_, "exn"),
+      0);
+  pad = builder.CreateInsertValue(
+      pad, builder.CreateLoad(builder.getInt32Ty(), selectorSlot_, "sel"), 1);
+  builder.CreateResume(pad);
+  return resumeBlock_;
+}
+
+void LLVMCodeGen::emitUnwind() {
+  auto &builder = context_.getBuilder();
+  if (tryStack_.empty()) {
+    emitCleanups(0, true);
+    builder.CreateBr(getResumeBlock());
+    return;
+  }
+  emitCleanups(tryStack_.back().scopeDepth, true);
+  builder.CreateBr(tryStack_.back().dispatch);
+}
+
+void LLVMCodeGen::emitFinallyBlocks(size_t depth) {
+  // Each finally block runs outside its own try statement, so a throw in
+  // it goes to the next one out
+  std::vector<TryInfo> saved = tryStack_;
+  while (!tryStack_.empty() && tryStack_.back().scopeDepth >= depth) {
+    const nodes::StatementNode *finallyBlock =
+        tryStack_.back().node ? tryStack_.back().node->getFinallyBlock()
+                              : nullptr;
+    tryStack_.pop_back();
+    if (finallyBlock) {
+      visitStmt(finallyBlock);
+    }
+  }
+  tryStack_ = std::move(saved);
+}
+
+llvm::Constant *LLVMCodeGen::getTypeInfo(llvm::Type *type) {
+  auto &module = context_.getModule();
+  auto &llvmContext = context_.getContext();
+  llvm::PointerType *bytePtrType = llvm::Type::getInt8PtrTy(llvmContext);
+
+  // Primitive values are named like their source types
+  std::string name;
+  llvm::Constant *base = llvm::ConstantPointerNull::get(bytePtrType);
+  const auto *cls = type->isStructTy() ? getClassOf(type) : nullptr;
+  if (cls) {
+    name = cls->getName();
+    if (cls->base) {
+      base = getTypeInfo(typeBuilder_.getTypeByName(cls->base->getName()));
+    }
+  } else if (type->isIntegerTy(32)) {
+    name = "int";
+  } else if (type->isFloatTy()) {
+    name = "float";
+  } else if (type->isIntegerTy(1)) {
+    name = "bool";
+  } else if (type == typeBuilder_.getStringType()) {
+    name = "string";
+  } else {
+    return nullptr;
+  }
+
+  // Like vtables, every module emits the typeinfos it uses and the linker
+  // keeps one
+  std::string symbol = name + ".typeinfo";
+  llvm::GlobalVariable *typeInfo = module.getNamedGlobal(symbol);
+  if (!typeInfo) {
+    auto *nameString = new llvm::GlobalVariable(
+        module, llvm::ArrayType::get(llvm::Type::getInt8Ty(llvmContext),
+                                     name.size() + 1),
+        true, llvm::GlobalValue::PrivateLinkage,
+        llvm::ConstantDataArray::getString(llvmContext, name), symbol + ".name");
+    nameString->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+
+    auto *infoType = llvm::StructType::get(bytePtrType, bytePtrType);
+    typeInfo = new llvm::GlobalVariable(
+        module, infoType, true, llvm::GlobalValue::LinkOnceODRLinkage,
+        llvm::ConstantStruct::get(
+            infoType,
+            {base, llvm::ConstantExpr::getBitCast(nameString, bytePtrType)}),
+        symbol);
+  }
+  return llvm::ConstantExpr::getBitCast(typeInfo, bytePtrType);
+}
+
+void LLVMCodeGen::inferNoUnwind() {
+  auto &module = context_.getModule();
+
+  // Start from every definition without a throws clause and drop those
+  // that call something that may unwind until none is left to drop, so
+  // recursive functions qualify too
+  std::unordered_set<const llvm::Function *> candidates;
+  for (auto &function : module) {
+    if (!function.isDeclaration() && !throwingFunctions_.count(&function)) {
+      candidates.insert(&function);
+    }
+  }
+  auto mayUnwind = [&](const llvm::CallBase &call) {
+    if (call.isInlineAsm()) {
+      return false;
+    }
+    const llvm::Function *callee = call.getCalledFunction();
+    return !callee || (!callee->doesNotThrow() && !candidates.count(callee));
+  };
+
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (auto it = candidates.begin(); it != candidates.end();) {
+      bool unwinds = false;
+      for (const auto &instruction : llvm::instructions(**it)) {
+        auto call = llvm::dyn_cast<llvm::CallBase>(&instruction);
+        if (call && mayUnwind(*call)) {
+          unwinds = true;
+          break;
+        }
+      }
+      if (unwinds) {
+        it = candidates.erase(it);
+        changed = true;
+      } else {
+        ++it;
+      }
+    }
+  }
+
+  for (auto &function : module) {
+    if (candidates.count(&function)) {
+      function.setDoesNotThrow();
+    }
+
+    // Calls that cannot unwind need no landing pad
+    std::vector<llvm::InvokeInst *> invokes;
+    for (auto &instruction : llvm::instructions(function)) {
+      auto invoke = llvm::dyn_cast<llvm::InvokeInst>(&instruction);
+      if (invoke && invoke->doesNotThrow()) {
+        invokes.push_back(invoke);
+      }
+    }
+    for (llvm::InvokeInst *invoke : invokes) {
+      llvm::changeToCall(invoke);
+    }
+    if (!invokes.empty()) {
+      llvm::removeUnreachableBlocks(function);
+    }
+
+    if (function.hasPersonalityFn() &&
+        llvm::none_of(function, [](const llvm::BasicBlock &block) {
+          return block.isLandingPad();
+        })) {
+      function.setPersonalityFn(nullptr);
+    }
+  }
+}
+
+void LLVMCodeGen::linkRuntimeBitcode() {
+  auto &module = context_.getModule();
+  const std::string &path = options_.getRuntimeBitcode();
+  core::TimeReport::Scope timer("Link runtime bitcode", path);
+
+  llvm::SMDiagnostic diagnostic;
+  std::unique_ptr<llvm::Module> runtime =
+      llvm::parseIRFile(path, diagnostic, module.getContext());
+  if (!runtime) {
+    warning(core::SourceLocation(), "Cannot read runtime bitcode " + path +
+                                        ": " +
+                                        diagnostic.getMessage().str());
+    return;
+  }
+  // Bitcode without a triple is taken to suit any target
+  llvm::Triple target(module.getTargetTriple());
+  llvm::Triple built(runtime->getTargetTriple());
+  if (!runtime->getTargetTriple().empty() &&
+      (target.getArch() != built.getArch() ||
+       target.getOS() != built.getOS())) {
+    warning(core::SourceLocation(), "Runtime bitcode " + path +
+                                        " is built for " + built.str() +
+                                        ", not " + target.str());
+    return;
+  }
+
+  // The globals each function or variable refers to, through constant
+  // expressions as well
+  std::unordered_map<const llvm::GlobalValue *,
+                     std::vector<const llvm::GlobalValue *>>
+      references;
+  auto collect = [&](const llvm::GlobalValue &from, const llvm::Value *root) {
+    std::vector<const llvm::Value *> pending{root};
+    std::unordered_set<const llvm::Value *> seen;
+    while (!pending.empty()) {
+      const llvm::Value *value = pending.back();
+      pending.pop_back();
+      if (!seen.insert(value).second) {
+        continue;
+      }
+      if (auto global = llvm::dyn_cast<llvm::GlobalValue>(value)) {
+        references[&from].push_back(global);
+      } else if (auto constant = llvm::dyn_cast<llvm::Constant>(value)) {
+        for (const llvm::Value *operand : constant->operands()) {
+          pending.push_back(operand);
+        }
+      }
+    }
+  };
+  for (const auto &function : *runtime) {
+    for (const auto &instruction : llvm::instructions(function)) {
+      for (const llvm::Value *operand : instruction.operands()) {
+        collect(function, operand);
+      }
+    }
+  }
+  for (const auto &variable : runtime->globals()) {
+    if (variable.hasInitializer()) {
+      collect(variable, variable.getInitializer());
+    }
+  }
+
+  // File-local state would be duplicated by a copy of the code using it,
+  // as would the state of the local functions and constants it reaches
+  std::unordered_set<const llvm::GlobalValue *> stateful;
+  for (const auto &variable : runtime->globals()) {
+    if (variable.hasLocalLinkage() && !variable.isConstant()) {
+      stateful.insert(&variable);
+    }
+  }
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (const auto &[from, globals] : references) {
+      if (stateful.count(from)) {
+        continue;
+      }
+      for (const llvm::GlobalValue *global : globals) {
+        if (global->hasLocalLinkage() && stateful.count(global)) {
+          stateful.insert(from);
+          changed = true;
+          break;
+        }
+      }
+    }
+  }
+
+  // The archive keeps the definitions: exported functions become inlining
+  // candidates only, and exported variables declarations. Target
+  // attributes go, so the runtime inlines into code tuned for any CPU.
+  for (auto &function : *runtime) {
+    if (function.isDeclaration() || function.hasLocalLinkage()) {
+      continue;
+    }
+    function.setComdat(nullptr);
+    if (stateful.count(&function)) {
+      function.deleteBody();
+      continue;
+    }
+    function.setLinkage(llvm::GlobalValue::AvailableExternallyLinkage);
+  }
+  for (auto &function : *runtime) {
+    function.removeFnAttr("target-cpu");
+    function.removeFnAttr("target-features");
+    function.removeFnAttr("tune-cpu");
+  }
+  for (auto &variable : runtime->globals()) {
+    if (variable.isDeclaration() || variable.hasLocalLinkage()) {
+      continue;
+    }
+    variable.setComdat(nullptr);
+    if (variable.isConstant() && !stateful.count(&variable)) {
+      variable.setLinkage(llvm::GlobalValue::AvailableExternallyLinkage);
+    } else {
+      variable.setInitializer(nullptr);
+      variable.setLinkage(llvm::GlobalValue::ExternalLinkage);
+    }
+  }
+
+  // Only what the module calls is linked, with the local helpers it needs
+  runtime->setDataLayout(module.getDataLayout());
+  runtime->setTargetTriple(module.getTargetTriple());
+  if (llvm::Linker::linkModules(module, std::move(runtime),
+                                llvm::Linker::Flags::LinkOnlyNeeded)) {
+    warning(core::SourceLocation(), "Cannot link runtime bitcode " + path);
+  }
+}
+LLVMValue LLVMCodeGen::visitDeclStmt(const nodes::DeclarationStmtNode *node) {
+  // Handle variable declarations within statements
+  if (auto varDecl = node->getDeclaration()) {
+    if (auto varDeclNode = nodes::dyn_cast<nodes::VarDeclNode>(varDecl)) {
+      return visitVarDecl(varDeclNode, false);
+    }
+  }
+  return LLVMValue();
+}
+
+LLVMValue
+LLVMCodeGen::visitBinaryExpr(const nodes::BinaryExpressionNode *node) {
+  auto &builder = context_.getBuilder();
+
+  // A typeof test of a union compares its tag, not a name
+  nodes::TypeTest test;
+  if (nodes::getTypeTest(node, test)) {
+    if (llvm::Value *result = emitTypeTest(test)) {
+      return LLVMValue(result, nullptr);
+    }
+  }
+
+  // A chain of + is evaluated operand by operand first, so that a string
+  // concatenation of any length is a single allocation
+  if (node->getExpressionType() == tokens::TokenType::PLUS) {
+    std::vector<llvm::Value *> operands;
+    if (!collectSumOperands(node, operands)) {
+      return LLVMValue();
+    }
+    llvm::Type *stringType = typeBuilder_.getStringType();
+    if (std::any_of(operands.begin(), operands.end(), [&](llvm::Value *v) {
+          return v->getType() == stringType;
+        })) {
+      llvm::Value *result = emitConcatenation(operands);
+      return result ? LLVMValue(result, nullptr) : LLVMValue();
+    }
+    size_t next = 0;
+    llvm::Value *sum = emitSum(node, operands, next);
+    return sum ? LLVMValue(sum, nullptr) : LLVMValue();
+  }
+
+  LLVMValue left = visitExpr(node->getLeft());
+  LLVMValue right = visitExpr(node->getRight());
+
+  if (!left.isValid() || !right.isValid()) {
+    error(core::SourceLocation(), "Invalid operands in binary expression");
+    return LLVMValue();
+  }
+
+  llvm::Value *result =
+      emitBinaryOperation(node->getExpressionType(),
+                          left.loadIfLValue(builder).getValue(),
+                          right.loadIfLValue(builder).getValue());
+  return result ? LLVMValue(result, nullptr) : LLVMValue();
+}
+
+bool LLVMCodeGen::collectSumOperands(const nodes::ExpressionNode *node,
+                                     std::vector<llvm::Value *> &operands) {
+  // A folded sum is one operand
+  auto sum = nodes::dyn_cast<nodes::BinaryExpressionNode>(node);
+  if (sum && sum->getExpressionType() == tokens::TokenType::PLUS &&
+      !sum->isFolded()) {
+    return collectSumOperands(sum->getLeft(), operands) &&
+           collectSumOperands(sum->getRight(), operands);
+  }
+  LLVMValue value = visitExpr(node);
+  if (!value.isValid()) {
+    error(core::SourceLocation(), "Invalid operands in binary expression");
+    return false;
+  }
+  operands.push_back(value.loadIfLValue(context_.getBuilder()).getValue());
+  return true;
+}
+
+llvm::Value *LLVMCodeGen::emitSum(const nodes::ExpressionNode *node,
+                                  const std::vector<llvm::Value *> &operands,
+                                  size_t &next) {
+  auto sum = nodes::dyn_cast<nodes::BinaryExpressionNode>(node);
+  if (!sum || sum->getExpressionType() != tokens::TokenType::PLUS ||
+      sum->isFolded()) {
+    return operands[next++];
+  }
+  llvm::Value *left = emitSum(sum->getLeft(), operands, next);
+  llvm::Value *right = emitSum(sum->getRight(), operands, next);
+  if (!left || !right) {
+    return nullptr;
+  }
+  return emitBinaryOperation(tokens::TokenType::PLUS, left, right);
+}
+
+llvm::Value *
+LLVMCodeGen::emitConcatenation(const std::vector<llvm::Value *> &operands) {
+  auto &builder = context_.getBuilder();
+  llvm::StructType *stringType = typeBuilder_.getStringType();
+  for (llvm::Value *operand : operands) {
+    if (operand->getType() != stringType) {
+      error(core::SourceLocation(), "Only strings can be concatenated");
+      return nullptr;
+    }
+  }
+
+  // Runs of literals become one literal
+  std::vector<llvm::Value *> joined;
+  std::string text;
+  for (size_t i = 0; i < operands.size(); ++i) {
+    std::string run;
+    size_t end = i;
+    while (end < operands.size() &&
+           getStringLiteralText(operands[end], text)) {
+      run += text;
+      ++end;
+    }
+    if (end - i > 1) {
+      joined.push_back(getStringLiteral(run));
+      i = end - 1;
+    } else {
+      joined.push_back(operands[i]);
+    }
+  }
+  if (joined.size() == 1) {
+    return joined[0];
+  }
+
+  // The parts are passed as one array of string values
+  auto partsType = llvm::ArrayType::get(stringType, joined.size());
+  llvm::Value *parts = spillToStack(llvm::UndefValue::get(partsType), "parts");
+  for (size_t i = 0; i < joined.size(); ++i) {
+    builder.CreateStore(joined[i], builder.CreateConstInBoundsGEP2_32(
+                                       partsType, parts, 0, i));
+  }
+  llvm::Value *result =
+      spillToStack(llvm::UndefValue::get(stringType), "concat");
+  builder.CreateCall(
+      context_.getModule().getFunction("tspp_string_concat"),
+      {result, builder.CreateConstInBoundsGEP2_32(partsType, parts, 0, 0),
+       builder.getInt32(joined.size())});
+  return builder.CreateLoad(stringType, result, "concat");
+}
+
+uint64_t LLVMCodeGen::getStringSmallLimit() {
+  // TSPP_STRING_SMALL as the runtime is compiled for the target
+  unsigned pointerBytes = context_.getModule().getDataLayout().getPointerSize();
+  return pointerBytes == 8 ? 16 : pointerBytes;
+}
+
+llvm::Constant *LLVMCodeGen::getStringLiteral(const std::string &text) {
+  auto &llvmContext = context_.getContext();
+  llvm::StructType *stringType = typeBuilder_.getStringType();
+  llvm::Type *int64Type = llvm::Type::getInt64Ty(llvmContext);
+  llvm::Constant *length = llvm::ConstantInt::get(int64Type, text.size());
+
+  // A short literal's bytes, NUL-padded, are the two words after the length
+  if (text.size() < getStringSmallLimit()) {
+    const llvm::DataLayout &layout = context_.getModule().getDataLayout();
+    uint64_t words[2] = {0, 0};
+    for (size_t i = 0; i < text.size(); ++i) {
+      unsigned shift = layout.isLittleEndian() ? (i % 8) * 8 : (7 - i % 8) * 8;
+      words[i / 8] |= uint64_t(static_cast<unsigned char>(text[i])) << shift;
+    }
+    return llvm::ConstantStruct::get(
+        stringType,
+        {length,
+         llvm::ConstantExpr::getIntToPtr(
+             llvm::ConstantInt::get(int64Type, words[0]),
+             stringType->getElementType(1)),
+         llvm::ConstantInt::get(int64Type, words[1])});
+  }
+
+  // Longer literals point at shared bytes they do not own
+  llvm::GlobalVariable *bytes = context_.getStringConstant(text);
+  return llvm::ConstantStruct::get(
+      stringType,
+      {length,
+       llvm::ConstantExpr::getInBoundsGetElementPtr(
+           bytes->getValueType(), bytes,
+           llvm::ArrayRef<llvm::Constant *>{
+               llvm::ConstantInt::get(int64Type, 0),
+               llvm::ConstantInt::get(int64Type, 0)}),
+       llvm::ConstantInt::get(int64Type, 0)});
+}
+
+bool LLVMCodeGen::getStringLiteralText(llvm::Value *value,
+                                       std::string &text) {
+  auto literal = llvm::dyn_cast<llvm::Constant>(value);
+  if (!literal || literal->getType() != typeBuilder_.getStringType()) {
+    return false;
+  }
+  auto length =
+      llvm::dyn_cast<llvm::ConstantInt>(literal->getAggregateElement(0u));
+  llvm::Constant *data = literal->getAggregateElement(1u);
+  if (!length || !data) {
+    return false;
+  }
+
+  // Long literals point into a string constant
+  if (length->getZExtValue() >= getStringSmallLimit()) {
+    auto global =
+        llvm::dyn_cast<llvm::GlobalVariable>(data->stripPointerCasts());
+    auto bytes = global ? llvm::dyn_cast<llvm::ConstantDataArray>(
+                              global->getInitializer())
+                        : nullptr;
+    if (!bytes) {
+      return false;
+    }
+    text = bytes->getAsCString().str();
+    return true;
+  }
+
+  // Short ones hold their bytes in the data and capacity words
+  uint64_t words[2] = {0, 0};
+  if (auto cast = llvm::dyn_cast<llvm::ConstantExpr>(data)) {
+    auto word = llvm::dyn_cast<llvm::ConstantInt>(cast->getOperand(0));
+    if (cast->getOpcode() != llvm::Instruction::IntToPtr || !word) {
+      return false;
+    }
+    words[0] = word->getZExtValue();
+  } else if (!data->isNullValue()) {
+    return false;
+  }
+  auto high =
+      llvm::dyn_cast<llvm::ConstantInt>(literal->getAggregateElement(2u));
+  if (!high) {
+    return false;
+  }
+  words[1] = high->getZExtValue();
+
+  const llvm::DataLayout &layout = context_.getModule().getDataLayout();
+  text.clear();
+  for (size_t i = 0; i < length->getZExtValue(); ++i) {
+    unsigned shift = layout.isLittleEndian() ? (i % 8) * 8 : (7 - i % 8) * 8;
+    text += static_cast<char>(words[i / 8] >> shift);
+  }
+  return true;
+}
+
+llvm::AllocaInst *LLVMCodeGen::createEntryAlloca(llvm::Type *type,
+                                                 const std::string &name) {
+  if (currentFunction_) {
+    return currentFunction_->createEntryAlloca(type, name);
+  }
+  // Code outside a function body, such as global initializers
+  llvm::Function *function =
+      context_.getBuilder().GetInsertBlock()->getParent();
+  return LLVMFunction::createEntryAlloca(*function, type, name);
+}
+
+llvm::Value *LLVMCodeGen::spillToStack(llvm::Value *value,
+                                       const std::string &name) {
+  auto &builder = context_.getBuilder();
+  llvm::AllocaInst *slot = createEntryAlloca(value->getType(), name);
+  if (!llvm::isa<llvm::UndefValue>(value)) {
+    builder.CreateStore(value, slot);
+  }
+  return slot;
+}
+
+llvm::Value *LLVMCodeGen::emitBinaryOperation(tokens::TokenType op,
+                                              llvm::Value *leftVal,
+                                              llvm::Value *rightVal) {
+  auto &builder = context_.getBuilder();
+
+  if (leftVal->getType()->isVectorTy() || rightVal->getType()->isVectorTy()) {
+    return emitVectorOperation(op, leftVal, rightVal);
+  }
+
+  // Mixed arithmetic happens in the float type; integers widen
+  if (leftVal->getType() != rightVal->getType()) {
+    llvm::Type *leftType = leftVal->getType();
+    llvm::Type *rightType = rightVal->getType();
+    llvm::Type *common = nullptr;
+    if (leftType->isFloatingPointTy() != rightType->isFloatingPointTy()) {
+      common = leftType->isFloatingPointTy() ? leftType : rightType;
+    } else if (leftType->isIntegerTy() && rightType->isIntegerTy()) {
+      common = leftType->getIntegerBitWidth() > rightType->getIntegerBitWidth()
+                   ? leftType
+                   : rightType;
+    } else if (leftType->isFloatingPointTy() &&
+               rightType->isFloatingPointTy()) {
+      common = leftType->getPrimitiveSizeInBits() >
+                       rightType->getPrimitiveSizeInBits()
+                   ? leftType
+                   : rightType;
+    }
+    if (common && (leftType->isIntegerTy() || leftType->isFloatingPointTy()) &&
+        (rightType->isIntegerTy() || rightType->isFloatingPointTy())) {
+      leftVal = convertNumeric(leftVal, common);
+      rightVal = convertNumeric(rightVal, common);
+    }
+  }
+
+  // Anything else has no implicit conversion
+  if (leftVal->getType() != rightVal->getType()) {
+    error(core::SourceLocation(),
+          "Mismatched operand types in binary expression");
+    return nullptr;
+  }
+
+  // Strings compare by length, then by bytes
+  llvm::Type *stringType = typeBuilder_.getStringType();
+  if (leftVal->getType() == stringType && rightVal->getType() == stringType &&
+      (op == tokens::TokenType::EQUALS_EQUALS ||
+       op == tokens::TokenType::EXCLAIM_EQUALS)) {
+    llvm::Value *equal = builder.CreateCall(
+        context_.getModule().getFunction("tspp_string_equals"),
+        {spillToStack(leftVal, "lhs"), spillToStack(rightVal, "rhs")});
+    return op == tokens::TokenType::EQUALS_EQUALS
+               ? builder.CreateICmpNE(equal, builder.getInt32(0), "eq")
+               : builder.CreateICmpEQ(equal, builder.getInt32(0), "ne");
+  }
+
+  llvm::Value *result = nullptr;
+
+  switch (op) {
+  case tokens::TokenType::PLUS:
+    if (leftVal->getType()->isIntegerTy() &&
+        rightVal->getType()->isIntegerTy()) {
+      result = builder.CreateAdd(leftVal, rightVal, "add");
+    } else if (leftVal->getType()->isFloatingPointTy() ||
+               rightVal->getType()->isFloatingPointTy()) {
+      // Handle float addition (would need proper type conversion)
+      result = builder.CreateFAdd(leftVal, rightVal, "fadd");
+    }
+    break;
+
+  case tokens::TokenType::MINUS:
+    if (leftVal->getType()->isIntegerTy() &&
+        rightVal->getType()->isIntegerTy()) {
+      result = builder.CreateSub(leftVal, rightVal, "sub");
+    } else {
+      result = builder.CreateFSub(leftVal, rightVal, "fsub");
+    }
+    break;
+
+  case tokens::TokenType::STAR:
+    if (leftVal->getType()->isIntegerTy() &&
+        rightVal->getType()->isIntegerTy()) {
+      result = builder.CreateMul(leftVal, rightVal, "mul");
+    } else {
+      result = builder.CreateFMul(leftVal, rightVal, "fmul");
+    }
+    break;
+
+  case tokens::TokenType::SLASH:
+    if (leftVal->getType()->isIntegerTy() &&
+        rightVal->getType()->isIntegerTy()) {
+      result = builder.CreateSDiv(leftVal, rightVal, "div");
+    } else {
+      result = builder.CreateFDiv(leftVal, rightVal, "fdiv");
+    }
+    break;
+
+  case tokens::TokenType::PERCENT:
+    if (leftVal->getType()->isIntegerTy() &&
+        rightVal->getType()->isIntegerTy()) {
+      result = builder.CreateSRem(leftVal, rightVal, "mod");
+    }
+    break;
+
+  case tokens::TokenType::EQUALS_EQUALS:
+    if (leftVal->getType()->isIntegerTy() &&
+        rightVal->getType()->isIntegerTy()) {
+      result = builder.CreateICmpEQ(leftVal, rightVal, "eq");
+    } else {
+      result = builder.CreateFCmpOEQ(leftVal, rightVal, "feq");
+    }
+    break;
+
+  case tokens::TokenType::EXCLAIM_EQUALS:
+    if (leftVal->getType()->isIntegerTy() &&
+        rightVal->getType()->isIntegerTy()) {
+      result = builder.CreateICmpNE(leftVal, rightVal, "ne");
+    } else {
+      result = builder.CreateFCmpONE(leftVal, rightVal, "fne");
+    }
+    break;
+
+  case tokens::TokenType::LESS:
+    if (leftVal->getType()->isIntegerTy() &&
+        rightVal->getType()->isIntegerTy()) {
+      result = builder.CreateICmpSLT(leftVal, rightVal, "lt");
+    } else {
+      result = builder.CreateFCmpOLT(leftVal, rightVal, "flt");
+    }
+    break;
+
+  case tokens::TokenType::GREATER:
+    if (leftVal->getType()->isIntegerTy() &&
+        rightVal->getType()->isIntegerTy()) {
+      result = builder.CreateICmpSGT(leftVal, rightVal, "gt");
+    } else {
+      result = builder.CreateFCmpOGT(leftVal, rightVal, "fgt");
+    }
+    break;
+
+  case tokens::TokenType::LESS_EQUALS:
+    if (leftVal->getType()->isIntegerTy() &&
+        rightVal->getType()->isIntegerTy()) {
+      result = builder.CreateICmpSLE(leftVal, rightVal, "le");
+    } else {
+      result = builder.CreateFCmpOLE(leftVal, rightVal, "fle");
+    }
+    break;
+
+  case tokens::TokenType::GREATER_EQUALS:
+    if (leftVal->getType()->isIntegerTy() &&
+        rightVal->getType()->isIntegerTy()) {
+      result = builder.CreateICmpSGE(leftVal, rightVal, "ge");
+    } else {
+      result = builder.CreateFCmpOGE(leftVal, rightVal, "fge");
+    }
+    break;
+
+    // case tokens::TokenType::LOGICAL_AND:
+    //   result = builder.CreateAnd(leftVal, rightVal, "and");
+    //   break;
+
+    // case tokens::TokenType::LOGICAL_OR:
+    //   result = builder.CreateOr(leftVal, rightVal, "or");
+    //   break;
+
+  default:
+    error(core::SourceLocation(), "Unsupported binary operator");
+    return nullptr;
+  }
+
+  if (!result) {
+    error(core::SourceLocation(), "Failed to generate binary operation");
+    return nullptr;
+  }
+
+  return result;
+}
+
+LLVMValue LLVMCodeGen::visitUnaryExpr(const nodes::UnaryExpressionNode *node) {
+  auto &builder = context_.getBuilder();
+  auto &llvmContext = context_.getContext();
+
+  if (node->getExpressionType() == tokens::TokenType::AWAIT) {
+    auto call = nodes::dyn_cast<nodes::CallExpressionNode>(node->getOperand());
+    if (!call || !coroutine_.handle) {
+      error(core::SourceLocation(),
+            "'await' needs a call inside an async function");
+      return LLVMValue();
+    }
+    return visitCallExpr(call, true);
+  }
+  if (node->getExpressionType() == tokens::TokenType::TYPEOF) {
+    return emitTypeOf(node->getOperand());
+  }
+
+  LLVMValue operand = visitExpr(node->getOperand());
+  if (!operand.isValid()) {
+    error(core::SourceLocation(), "Invalid operand in unary expression");
+    return LLVMValue();
+  }
+
+  llvm::Value *operandVal = operand.loadIfLValue(builder).getValue();
+  llvm::Value *result = nullptr;
+
+  switch (node->getExpressionType()) {
+  case tokens::TokenType::MINUS:
+    if (operandVal->getType()->isIntOrIntVectorTy()) {
+      result = builder.CreateNeg(operandVal, "neg");
+    } else {
+      result = builder.CreateFNeg(operandVal, "fneg");
+    }
+    break;
+
+  case tokens::TokenType::PLUS:
+    // Unary plus is essentially a no-op
+    result = operandVal;
+    break;
+
+  case tokens::TokenType::EXCLAIM:
+    result = builder.CreateNot(operandVal, "not");
+    break;
+
+  case tokens::TokenType::PLUS_PLUS:
+    if (operand.isLValue()) {
+      llvm::Value *one = llvm::ConstantInt::get(operandVal->getType(), 1);
+      result = builder.CreateAdd(operandVal, one, "inc");
+      builder.CreateStore(result, operand.getValue());
+      return operand; // Return the lvalue for pre-increment
+    }
+    break;
+
+  case tokens::TokenType::MINUS_MINUS:
+    if (operand.isLValue()) {
+      llvm::Value *one = llvm::ConstantInt::get(operandVal->getType(), 1);
+      result = builder.CreateSub(operandVal, one, "dec");
+      builder.CreateStore(result, operand.getValue());
+      return operand; // Return the lvalue for pre-decrement
+    }
+    break;
+
+  default:
+    error(core::SourceLocation(), "Unsupported unary operator");
+    return LLVMValue();
+  }
+
+  if (!result) {
+    error(core::SourceLocation(), "Failed to generate unary operation");
+    return LLVMValue();
+  }
+
+  return LLVMValue(result, nullptr);
+}
+
+LLVMValue
+LLVMCodeGen::visitIdentifierExpr(const nodes::IdentifierExpressionNode *node) {
+  const std::string &name = node->getName();
+
+  // First, look for local variables
+  if (currentFunction_) {
+    LLVMValue var = currentFunction_->getVariable(node->getSymbol());
+    if (var.isValid()) {
+      return narrowUnion(var, node);
+    }
+  }
+
+  // Then look for global variables
+  if (llvm::GlobalVariable *globalVar = lookupGlobal(name)) {
+    LLVMValue global(globalVar, nullptr, true); // Global variables are lvalues
+    auto it = globalPointeeAlignments_.find(node->getSymbol());
+    if (it != globalPointeeAlignments_.end()) {
+      global.setPointeeAlignment(it->second);
+    }
+    auto owner = globalOwnership_.find(node->getSymbol());
+    if (owner != globalOwnership_.end()) {
+      global.setOwnership(owner->second);
+    }
+    return narrowUnion(global, node);
+  }
+
+  // Look for functions
+  if (llvm::Function *func = lookupFunction(name, node->getSymbol())) {
+    return LLVMValue(func, nullptr);
+  }
+
+  error(core::SourceLocation(), "Undefined identifier: " + name);
   return LLVMValue();
 }
-LLVMValue LLVMCodeGen::visitForOfStmt(const nodes::ForOfStmtNode *node) {
-  return LLVMValue();
+
+llvm::StructType *
+LLVMCodeGen::getClosureType(const nodes::FunctionExpressionNode *node) {
+  std::vector<llvm::Type *> paramTypes;
+  for (const auto &param : node->getParameters()) {
+    paramTypes.push_back(getStorageType(param->getType()));
+  }
+  // Unannotated function expressions return nothing
+  llvm::Type *returnType =
+      node->getReturnType() ? getReturnType(node->getReturnType())
+                            : llvm::Type::getVoidTy(context_.getContext());
+  return typeBuilder_.getClosureType(
+      llvm::FunctionType::get(returnType, paramTypes, false));
+}
+
+LLVMValue
+LLVMCodeGen::visitFunctionExpr(const nodes::FunctionExpressionNode *node) {
+  auto &builder = context_.getBuilder();
+  auto &llvmContext = context_.getContext();
+  auto &module = context_.getModule();
+  if (!currentFunction_ || !builder.GetInsertBlock()) {
+    error(core::SourceLocation(),
+          "Function expressions are only supported inside functions");
+    return LLVMValue();
+  }
+  llvm::Function *caller = builder.GetInsertBlock()->getParent();
+  llvm::StructType *closureType = getClosureType(node);
+  llvm::FunctionType *signature = typeBuilder_.getClosureSignature(closureType);
+
+  // Locals of the enclosing function that the body uses are copied in;
+  // globals, functions and constants are reachable as they are
+  ClosureEnv env;
+  std::vector<llvm::Value *> values;
+  std::vector<llvm::Type *> fields;
+  for (core::Symbol name : LLVMClosureAnalysis::getReferencedNames(node)) {
+    bool isParam = false;
+    for (const auto &param : node->getParameters()) {
+      isParam |= param->getName() == name.str();
+    }
+    LLVMValue variable = currentFunction_->getVariable(name);
+    if (isParam || !variable.isValid() ||
+        llvm::isa<llvm::Constant>(variable.getValue())) {
+      continue;
+    }
+    llvm::Value *value = variable.loadIfLValue(builder).getValue();
+    values.push_back(value);
+    fields.push_back(value->getType());
+    env.captures.emplace_back(name, variable);
+  }
+
+  llvm::Value *envPointer =
+      llvm::ConstantPointerNull::get(builder.getInt8PtrTy());
+  if (!values.empty()) {
+    env.type = llvm::StructType::get(llvmContext, fields);
+    llvm::Value *storage = nullptr;
+    if (closureAnalysis_.escapes(node)) {
+      storage = emitHeapAllocation(env.type, "closure.env", "tspp_new");
+    } else {
+      storage = createEntryAlloca(env.type, "closure.env");
+    }
+    for (size_t i = 0; i < values.size(); ++i) {
+      builder.CreateStore(values[i],
+                          builder.CreateStructGEP(env.type, storage, i));
+    }
+    envPointer = builder.CreateBitCast(storage, builder.getInt8PtrTy());
+  }
+
+  // The code, compiled for the caller's target
+  llvm::Function *code = llvm::Function::Create(
+      LLVMTypeBuilder::getClosureCodeType(signature),
+      llvm::Function::InternalLinkage, caller->getName() + ".lambda", module);
+  for (const char *attribute : {"target-cpu", "target-features"}) {
+    if (caller->hasFnAttribute(attribute)) {
+      code->addFnAttr(caller->getFnAttribute(attribute));
+    }
+  }
+  code->addParamAttr(0, llvm::Attribute::NoCapture);
+  for (size_t i = 0; i < node->getParameters().size(); ++i) {
+    code->getArg(i + 1)->setName(node->getParameters()[i]->getName());
+  }
+
+  EnclosingFunction callerState = suspendFunction();
+  emitBody(code, node->getParameters(), node->getReturnType(), {}, "",
+           node->getBody(), false, false, &env);
+  resumeFunction(std::move(callerState));
+
+  llvm::Value *closure = llvm::UndefValue::get(closureType);
+  closure = builder.CreateInsertValue(closure, code, 0);
+  closure = builder.CreateInsertValue(closure, envPointer, 1, "closure");
+  return LLVMValue(closure, nullptr);
+}
+
+llvm::Value *LLVMCodeGen::emitFunctionValue(llvm::Function *function,
+                                            llvm::StructType *closureType,
+                                            const std::string &name) {
+  auto &module = context_.getModule();
+  llvm::FunctionType *signature = typeBuilder_.getClosureSignature(closureType);
+  if (function->getFunctionType() != signature) {
+    error(core::SourceLocation(),
+          "Function '" + function->getName().str() +
+              "' does not have the signature of '" + name + "'");
+    return nullptr;
+  }
+
+  std::string thunkName = function->getName().str() + ".closure";
+  llvm::Function *thunk = module.getFunction(thunkName);
+  if (!thunk) {
+    thunk = llvm::Function::Create(
+        LLVMTypeBuilder::getClosureCodeType(signature),
+        llvm::Function::InternalLinkage, thunkName, module);
+    thunk->getArg(0)->setName("env");
+    llvm::IRBuilder<> thunkBuilder(
+        llvm::BasicBlock::Create(context_.getContext(), "entry", thunk));
+    std::vector<llvm::Value *> args;
+    for (size_t i = 1; i < thunk->arg_size(); ++i) {
+      args.push_back(thunk->getArg(i));
+    }
+    llvm::CallInst *call = thunkBuilder.CreateCall(function, args);
+    call->setTailCall();
+    if (signature->getReturnType()->isVoidTy()) {
+      thunkBuilder.CreateRetVoid();
+    } else {
+      thunkBuilder.CreateRet(call);
+    }
+  }
+  return llvm::ConstantStruct::get(
+      closureType,
+      {thunk, llvm::ConstantPointerNull::get(
+                  llvm::Type::getInt8PtrTy(context_.getContext()))});
+}
+
+LLVMValue LLVMCodeGen::emitClosureCall(const nodes::CallExpressionNode *node) {
+  auto &builder = context_.getBuilder();
+  LLVMValue callee = visitExpr(node->getCallee());
+  if (!callee.isValid()) {
+    return LLVMValue();
+  }
+  llvm::Value *closure = callee.loadIfLValue(builder).getValue();
+  llvm::FunctionType *signature =
+      typeBuilder_.getClosureSignature(closure->getType());
+  if (!signature) {
+    error(core::SourceLocation(), "Cannot call a value that is not a function");
+    return LLVMValue();
+  }
+  const auto &arguments = node->getArguments();
+  if (arguments.size() != signature->getNumParams()) {
+    error(core::SourceLocation(),
+          "Argument count mismatch for function value: expected " +
+              std::to_string(signature->getNumParams()) + ", got " +
+              std::to_string(arguments.size()));
+    return LLVMValue();
+  }
+
+  std::vector<llvm::Value *> args{
+      builder.CreateExtractValue(closure, 1, "closure.env")};
+  for (size_t i = 0; i < arguments.size(); ++i) {
+    LLVMValue argValue = visitExpr(arguments[i]);
+    if (!argValue.isValid()) {
+      error(core::SourceLocation(), "Invalid argument in function call");
+      return LLVMValue();
+    }
+    llvm::Value *arg = convertForStore(
+        argValue.loadIfLValue(builder).getValue(), signature->getParamType(i),
+        "argument " + std::to_string(i + 1));
+    if (!arg) {
+      return LLVMValue();
+    }
+    args.push_back(arg);
+  }
+
+  llvm::Value *code = builder.CreateExtractValue(closure, 0, "closure.code");
+  llvm::Value *result =
+      emitCall(llvm::FunctionCallee(
+                   LLVMTypeBuilder::getClosureCodeType(signature), code),
+               args, signature->getReturnType()->isVoidTy() ? "" : "call");
+  return LLVMValue(result, nullptr);
+}
+
+LLVMValue LLVMCodeGen::visitCallExpr(const nodes::CallExpressionNode *node,
+                                     bool awaited) {
+  auto &builder = context_.getBuilder();
+
+  if (auto member =
+          nodes::dyn_cast<nodes::MemberExpressionNode>(node->getCallee())) {
+    return visitMethodCall(node, member);
+  }
+
+  // Get the function to call
+  // Function values are variables, or computed
+  auto identExpr = nodes::dyn_cast<nodes::IdentifierExpressionNode>(
+      node->getCallee());
+  if (!identExpr ||
+      (currentFunction_ &&
+       currentFunction_->getVariable(identExpr->getSymbol()).isValid()) ||
+      lookupGlobal(identExpr->getName())) {
+    return emitClosureCall(node);
+  }
+  const std::string &funcName = identExpr->getName();
+
+  if (auto generic = monomorphizer_.lookupFunction(identExpr->getSymbol())) {
+    return visitGenericCall(node, generic);
+  }
+
+  // Prefer the symbol table, falling back to the module for externals
+  llvm::Function *function = nullptr;
+  auto it = functionTable_.find(identExpr->getSymbol());
+  if (it != functionTable_.end()) {
+    function = it->second;
+  } else {
+    function = lookupFunction(funcName, identExpr->getSymbol());
+  }
+  if (!function && (funcName == "sleep" || funcName == "readable" ||
+                    funcName == "writable")) {
+    return emitAsyncBuiltin(node, funcName, awaited);
+  }
+  if (!function && (funcName == "mapFile" || funcName == "unmapFile")) {
+    return emitFileBuiltin(node, funcName);
+  }
+  if (!function && funcName == "blackBox") {
+    return emitBlackBox(node);
+  }
+  if (!function && node->getResolvedType() &&
+      node->getResolvedType()->getKind() ==
+          visitors::ResolvedType::TypeKind::Vector) {
+    return emitVectorConstruction(node);
+  }
+  auto foreign = cFunctions_.find(identExpr->getSymbol());
+  if (foreign != cFunctions_.end()) {
+    if (!function) {
+      // Declared by an earlier REPL input
+      function = llvm::Function::Create(foreign->second.type,
+                                        llvm::Function::ExternalLinkage,
+                                        funcName, context_.getModule());
+      function->addFnAttr(llvm::Attribute::NoUnwind);
+    }
+    return emitCCall(node, function, foreign->second);
+  }
+  if (!function) {
+    error(core::SourceLocation(), "Function not found: " + funcName);
+    return LLVMValue();
+  }
+
+  // Evaluate arguments
+  std::vector<llvm::Value *> args;
+  for (const auto &arg : node->getArguments()) {
+    LLVMValue argValue = visitExpr(arg);
+    bool byRef = isRefArgument(node, args.size());
+    if (!argValue.isValid() || (byRef && !argValue.isLValue())) {
+      error(core::SourceLocation(), "Invalid argument in function call");
+      return LLVMValue();
+    }
+
+    // Load the value if it's an lvalue; a ref parameter takes the address
+    llvm::Value *loadedArg =
+        byRef ? argValue.getValue() : argValue.loadIfLValue(builder).getValue();
+    args.push_back(loadedArg);
+  }
+
+  // Check argument count
+  if (args.size() != function->arg_size()) {
+    error(core::SourceLocation(), "Argument count mismatch for function " +
+                                      funcName + ": expected " +
+                                      std::to_string(function->arg_size()) +
+                                      ", got " + std::to_string(args.size()));
+    return LLVMValue();
+  }
+
+  // Arguments take the declared parameter types; varargs pass as they are
+  for (size_t i = 0; i < function->getFunctionType()->getNumParams(); ++i) {
+    args[i] = convertForStore(args[i], function->getArg(i)->getType(),
+                              function->getArg(i)->getName().str());
+    if (!args[i]) {
+      return LLVMValue();
+    }
+  }
+
+  // Create the call; a void result has no name
+  llvm::Value *result = emitCall(
+      function, args, function->getReturnType()->isVoidTy() ? "" : "call");
+  auto async = asyncResults_.find(identExpr->getSymbol());
+  if (async != asyncResults_.end()) {
+    return finishAsyncCall(result, async->second, awaited);
+  }
+  return LLVMValue(result, nullptr);
+}
+
+LLVMValue LLVMCodeGen::emitCCall(const nodes::CallExpressionNode *node,
+                                 llvm::Function *function,
+                                 const CABISignature &signature) {
+  auto &builder = context_.getBuilder();
+  auto &llvmContext = context_.getContext();
+  const llvm::DataLayout &layout = context_.getModule().getDataLayout();
+
+  // A slot holding a value that its parts are loaded from, or a result is
+  // stored to as its parts
+  auto createCoercionSlot = [&](llvm::Type *type, llvm::Type *coerced) {
+    llvm::AllocaInst *slot = createEntryAlloca(coerced, "coerce");
+    slot->setAlignment(std::max(layout.getPrefTypeAlign(type),
+                                layout.getPrefTypeAlign(coerced)));
+    return slot;
+  };
+
+  std::vector<llvm::Value *> args;
+  llvm::AllocaInst *resultSlot = nullptr;
+  if (signature.result.kind == CABIValue::Kind::Indirect) {
+    resultSlot = createEntryAlloca(signature.resultType, "sret");
+    args.push_back(resultSlot);
+  }
+
+  const auto &arguments = node->getArguments();
+  for (size_t i = 0; i < arguments.size(); ++i) {
+    LLVMValue argValue = visitExpr(arguments[i]);
+    if (!argValue.isValid()) {
+      error(core::SourceLocation(), "Invalid argument in function call");
+      return LLVMValue();
+    }
+    llvm::Value *value = argValue.loadIfLValue(builder).getValue();
+
+    // C's default argument promotions
+    if (i >= signature.params.size()) {
+      llvm::Type *promoted = CABILowering::promoteVariadic(value->getType());
+      if (value->getType()->isFloatTy()) {
+        value = builder.CreateFPExt(value, promoted, "vararg");
+      } else if (promoted != value->getType()) {
+        value = builder.CreateZExt(value, promoted, "vararg");
+      }
+      args.push_back(value);
+      continue;
+    }
+
+    llvm::Type *paramType = signature.paramTypes[i];
+    value = convertForStore(value, paramType, "arg");
+    if (!value) {
+      return LLVMValue();
+    }
+    const CABIValue &param = signature.params[i];
+    if (param.kind == CABIValue::Kind::Indirect) {
+      args.push_back(spillToStack(value, "arg.copy"));
+    } else if (param.kind == CABIValue::Kind::Direct && param.parts.empty()) {
+      args.push_back(value);
+    } else if (param.kind == CABIValue::Kind::Direct) {
+      llvm::Type *coerced = param.getCoercedType(llvmContext);
+      llvm::AllocaInst *slot = createCoercionSlot(paramType, coerced);
+      builder.CreateStore(
+          value, builder.CreateBitCast(slot, paramType->getPointerTo()));
+      if (param.parts.size() == 1) {
+        args.push_back(builder.CreateLoad(coerced, slot, "arg.part"));
+        continue;
+      }
+      for (unsigned part = 0; part < param.parts.size(); ++part) {
+        args.push_back(builder.CreateLoad(
+            param.parts[part], builder.CreateStructGEP(coerced, slot, part),
+            "arg.part"));
+      }
+    }
+  }
+
+  auto *call = llvm::cast<llvm::CallBase>(
+      emitCall(function, args,
+               function->getReturnType()->isVoidTy() ? "" : "call"));
+  call->setAttributes(signature.getAttributes(llvmContext));
+
+  switch (signature.result.kind) {
+  case CABIValue::Kind::Ignore:
+    // A class without fields has nothing to return
+    return LLVMValue(signature.resultType->isVoidTy()
+                         ? static_cast<llvm::Value *>(call)
+                         : llvm::Constant::getNullValue(signature.resultType),
+                     nullptr);
+  case CABIValue::Kind::Indirect:
+    return LLVMValue(
+        builder.CreateLoad(signature.resultType, resultSlot, "result"),
+        nullptr);
+  case CABIValue::Kind::Direct:
+    break;
+  }
+  if (signature.result.parts.empty()) {
+    return LLVMValue(call, nullptr);
+  }
+  llvm::AllocaInst *slot =
+      createCoercionSlot(signature.resultType, call->getType());
+  builder.CreateStore(call, slot);
+  return LLVMValue(
+      builder.CreateLoad(signature.resultType,
+                         builder.CreateBitCast(
+                             slot, signature.resultType->getPointerTo()),
+                         "result"),
+      nullptr);
 }
-LLVMValue LLVMCodeGen::visitReturnStmt(const nodes::ReturnStmtNode *node) {
-  return LLVMValue();
+
+LLVMValue LLVMCodeGen::finishAsyncCall(llvm::Value *handle,
+                                       llvm::Type *resultType, bool awaited) {
+  auto &builder = context_.getBuilder();
+  auto &llvmContext = context_.getContext();
+  auto &module = context_.getModule();
+  llvm::StructType *promiseType = getPromiseType(resultType);
+  llvm::Value *promise = getPromise(handle, resultType);
+
+  if (!coroutine_.handle) {
+    emitCall(module.getFunction("tspp_task_run"), {handle});
+  } else if (!awaited) {
+    return LLVMValue(
+        builder.CreateCall(module.getFunction("tspp_task_spawn"),
+                           {handle, builder.CreateStructGEP(promiseType,
+                                                            promise, 0)}),
+        nullptr);
+  } else {
+    // A task that finished without suspending is not waited for
+    llvm::Function *function = builder.GetInsertBlock()->getParent();
+    auto *waitBlock =
+        llvm::BasicBlock::Create(llvmContext, "await.suspend", function);
+    auto *readyBlock =
+        llvm::BasicBlock::Create(llvmContext, "await.ready", function);
+    builder.CreateCondBr(
+        builder.CreateCall(
+            llvm::Intrinsic::getDeclaration(&module,
+                                            llvm::Intrinsic::coro_done),
+            {handle}, "done"),
+        readyBlock, waitBlock);
+    builder.SetInsertPoint(waitBlock);
+    builder.CreateStore(coroutine_.handle,
+                        builder.CreateStructGEP(
+                            promiseType->getElementType(0),
+                            builder.CreateStructGEP(promiseType, promise, 0),
+                            0));
+    emitSuspend();
+    builder.CreateBr(readyBlock);
+    builder.SetInsertPoint(readyBlock);
+  }
+
+  llvm::Value *result = nullptr;
+  if (!resultType->isVoidTy()) {
+    result = builder.CreateLoad(
+        resultType, builder.CreateStructGEP(promiseType, promise, 1),
+        "result");
+  }
+  llvm::Value *destroy = builder.CreateCall(
+      llvm::Intrinsic::getDeclaration(&module, llvm::Intrinsic::coro_destroy),
+      {handle});
+  return LLVMValue(result ? result : destroy, nullptr);
 }
-LLVMValue LLVMCodeGen::visitBreakStmt(const nodes::BreakStmtNode *node) {
+
+LLVMValue LLVMCodeGen::emitFileBuiltin(const nodes::CallExpressionNode *node,
+                                       const std::string &name) {
+  auto &builder = context_.getBuilder();
+  auto &module = context_.getModule();
+  if (node->getArguments().size() != 1) {
+    error(core::SourceLocation(), name + " takes one argument");
+    return LLVMValue();
+  }
+  LLVMValue argument = visitExpr(node->getArguments()[0]);
+  if (!argument.isValid()) {
+    return LLVMValue();
+  }
+  llvm::Value *value = argument.loadIfLValue(builder).getValue();
+
+  llvm::Type *bytesType = typeBuilder_.getTypeByName("bytes");
+  if (name == "unmapFile") {
+    value = convertForStore(value, bytesType, "bytes");
+    if (!value) {
+      return LLVMValue();
+    }
+    builder.CreateCall(module.getFunction("tspp_unmap_file"),
+                       {builder.CreateExtractValue(value, 0),
+                        builder.CreateExtractValue(value, 1)});
+    return LLVMValue();
+  }
+
+  if (value->getType() != typeBuilder_.getStringType()) {
+    error(core::SourceLocation(), "mapFile needs a string path");
+    return LLVMValue();
+  }
+  llvm::AllocaInst *result = createEntryAlloca(bytesType, "mapped");
+  builder.CreateCall(module.getFunction("tspp_map_file"),
+                     {result, spillToStack(value, "path")});
+  return LLVMValue(builder.CreateLoad(bytesType, result, "bytes"), nullptr);
+}
+
+LLVMValue LLVMCodeGen::emitBlackBox(const nodes::CallExpressionNode *node) {
+  auto &builder = context_.getBuilder();
+  if (node->getArguments().size() != 1) {
+    error(core::SourceLocation(), "blackBox takes one argument");
+    return LLVMValue();
+  }
+  LLVMValue argument = visitExpr(node->getArguments()[0]);
+  if (!argument.isValid()) {
+    return LLVMValue();
+  }
+  llvm::Value *value = argument.loadIfLValue(builder).getValue();
+  llvm::Type *type = value->getType();
+  llvm::AllocaInst *slot = createEntryAlloca(type, "blackbox");
+  builder.CreateStore(value, slot);
+  auto *asmType = llvm::FunctionType::get(builder.getVoidTy(),
+                                          {slot->getType()}, false);
+  builder.CreateCall(llvm::InlineAsm::get(asmType, "", "r,~{memory}", true),
+                     {slot});
+  return LLVMValue(builder.CreateLoad(type, slot, "opaque"), nullptr);
+}
+
+LLVMValue LLVMCodeGen::emitAsyncBuiltin(const nodes::CallExpressionNode *node,
+                                        const std::string &name,
+                                        bool awaited) {
+  auto &builder = context_.getBuilder();
+  auto &module = context_.getModule();
+  if (coroutine_.handle && !awaited) {
+    error(core::SourceLocation(), "'" + name + "' must be awaited");
+    return LLVMValue();
+  }
+  if (node->getArguments().size() != 1) {
+    error(core::SourceLocation(), "'" + name + "' takes one argument");
+    return LLVMValue();
+  }
+  LLVMValue argument = visitExpr(node->getArguments()[0]);
+  if (!argument.isValid()) {
+    return LLVMValue();
+  }
+  llvm::Value *value =
+      convertForStore(argument.loadIfLValue(builder).getValue(),
+                      builder.getInt32Ty(), name + " argument");
+  if (!value) {
+    return LLVMValue();
+  }
+
+  // Without a coroutine to schedule, the runtime blocks instead
+  llvm::Value *handle = coroutine_.handle;
+  if (!handle) {
+    handle = llvm::ConstantPointerNull::get(builder.getInt8PtrTy());
+  }
+  llvm::Value *result;
+  if (name == "sleep") {
+    result =
+        emitCall(module.getFunction("tspp_async_sleep"), {handle, value});
+  } else {
+    int events = name == "readable" ? TSPP_WAIT_READABLE : TSPP_WAIT_WRITABLE;
+    result = emitCall(module.getFunction("tspp_async_wait_fd"),
+                      {handle, value, builder.getInt32(events)});
+  }
+  if (coroutine_.handle) {
+    emitSuspend();
+  }
+  return LLVMValue(result, nullptr);
+}
+
+LLVMValue
+LLVMCodeGen::visitGenericCall(const nodes::CallExpressionNode *node,
+                              const nodes::GenericFunctionDeclNode *decl) {
+  auto &builder = context_.getBuilder();
+
+  if (node->getArguments().size() != decl->getParameters().size()) {
+    error(core::SourceLocation(),
+          "Argument count mismatch for function " + decl->getName() +
+              ": expected " + std::to_string(decl->getParameters().size()) +
+              ", got " + std::to_string(node->getArguments().size()));
+    return LLVMValue();
+  }
+
+  std::vector<llvm::Value *> args;
+  std::vector<LLVMMonomorphizer::TypePtr> argTypes;
+  for (const auto &arg : node->getArguments()) {
+    LLVMValue argValue = visitExpr(arg);
+    if (!argValue.isValid()) {
+      error(core::SourceLocation(), "Invalid argument in function call");
+      return LLVMValue();
+    }
+    args.push_back(argValue.loadIfLValue(builder).getValue());
+    argTypes.push_back(arg->getResolvedType());
+  }
+
+  std::vector<LLVMMonomorphizer::TypePtr> typeArgs;
+  std::string message;
+  if (!monomorphizer_.inferTypeArguments(decl, node->getTypeArguments(), args,
+                                         argTypes, typeArgs, message)) {
+    error(core::SourceLocation(), message);
+    return LLVMValue();
+  }
+  llvm::Function *function = monomorphizer_.getFunction(decl, typeArgs);
+
+  // Literals are converted to the bound type, e.g. 2 for a float T
+  for (size_t i = 0; i < args.size(); ++i) {
+    args[i] = convertForStore(args[i], function->getArg(i)->getType(),
+                              decl->getParameters()[i]->getName());
+    if (!args[i]) {
+      return LLVMValue();
+    }
+  }
+
+  return LLVMValue(
+      emitCall(function, args,
+               function->getReturnType()->isVoidTy() ? "" : "call"),
+      nullptr);
+}
+
+LLVMValue
+LLVMCodeGen::visitMethodCall(const nodes::CallExpressionNode *node,
+                             const nodes::MemberExpressionNode *callee) {
+  auto &builder = context_.getBuilder();
+  const std::string &name = callee->getMember();
+
+  LLVMValue value = visitExpr(callee->getObject());
+  if (!value.isValid()) {
+    return LLVMValue();
+  }
+  if (value.isLValue() &&
+      (LLVMTypeBuilder::isDynamicArrayType(value.getStoredType()) ||
+       typeBuilder_.getStructOfArraysElement(value.getStoredType()))) {
+    return emitArrayMethod(node, name, value);
+  }
+  if (LLVMTypeBuilder::isSliceType(value.isLValue()
+                                       ? value.getStoredType()
+                                       : value.getValue()->getType())) {
+    return emitSliceMethod(node, name, value);
+  }
+  if (typeBuilder_.getContainer(value.isLValue()
+                                    ? value.getStoredType()
+                                    : value.getValue()->getType())) {
+    return emitContainerMethod(node, name, value);
+  }
+  if ((value.isLValue() ? value.getStoredType() : value.getValue()->getType())
+          ->isVectorTy()) {
+    return emitVectorMethod(node, name, value);
+  }
+  auto objectType = value.getType();
+  if (objectType &&
+      (objectType->getKind() == visitors::ResolvedType::TypeKind::Atomic ||
+       (objectType->getPointeeType() &&
+        objectType->getPointeeType()->getKind() ==
+            visitors::ResolvedType::TypeKind::Atomic))) {
+    return emitAtomicMethod(node, name, value);
+  }
+
+  bool exact = nodes::isa<nodes::NewExpressionNode>(callee->getObject());
+  llvm::Value *object = emitObject(value, exact);
+  if (!object) {
+    return LLVMValue();
+  }
+
+  std::vector<llvm::Value *> args{nullptr};
+  for (const auto &arg : node->getArguments()) {
+    LLVMValue argValue = visitExpr(arg);
+    bool byRef = isRefArgument(node, args.size() - 1);
+    if (!argValue.isValid() || (byRef && !argValue.isLValue())) {
+      error(core::SourceLocation(), "Invalid argument in method call");
+      return LLVMValue();
+    }
+    args.push_back(byRef ? argValue.getValue()
+                         : argValue.loadIfLValue(builder).getValue());
+  }
+
+  llvm::FunctionCallee target;
+  std::vector<std::string> paramNames{"this"};
+  if (const auto *iface = getInterfaceOf(object->getType())) {
+    int slot = classHierarchy_.getSlot(iface, name);
+    if (slot < 0) {
+      error(core::SourceLocation(), "Interface '" + iface->getName() +
+                                        "' has no method '" + name + "'");
+      return LLVMValue();
+    }
+    const nodes::MethodSignatureNode *signature = iface->slots[slot];
+    for (const auto &param : signature->getParameters()) {
+      paramNames.push_back(param->getName());
+    }
+    llvm::Value *receiver = builder.CreateExtractValue(object, 0, "object");
+
+    if (auto impl = classHierarchy_.uniqueImplementation(iface, name)) {
+      // Every implementation runs the same method
+      llvm::Function *function = methodFunctions_.at(impl.method);
+      args[0] = builder.CreateBitCast(receiver, function->getArg(0)->getType());
+      target = function;
+    } else {
+      std::vector<llvm::Type *> paramTypes{receiver->getType()};
+      for (const auto &param : signature->getParameters()) {
+        paramTypes.push_back(getParameterType(param));
+      }
+      llvm::Type *returnType =
+          signature->getReturnType()
+              ? getReturnType(signature->getReturnType())
+              : llvm::Type::getInt32Ty(context_.getContext());
+      auto *type = llvm::FunctionType::get(returnType, paramTypes, false);
+
+      llvm::Type *slotType = builder.getInt8PtrTy();
+      llvm::Value *itable = builder.CreateExtractValue(object, 1, "itable");
+      auto *method = builder.CreateLoad(
+          slotType,
+          builder.CreateConstInBoundsGEP1_32(slotType, itable, slot, "islot"),
+          "ifn");
+      method->setMetadata(llvm::LLVMContext::MD_invariant_load,
+                          llvm::MDNode::get(context_.getContext(), {}));
+      args[0] = receiver;
+      target = llvm::FunctionCallee(
+          type, builder.CreateBitCast(method, type->getPointerTo()));
+    }
+  } else {
+    const auto *cls = getClassOf(object->getType());
+    if (!cls || !object->getType()->isPointerTy()) {
+      error(core::SourceLocation(),
+            "Cannot call method '" + name + "' of a value that is not an "
+                                            "object");
+      return LLVMValue();
+    }
+    auto resolved = classHierarchy_.resolve(cls, name);
+    if (!resolved) {
+      error(core::SourceLocation(),
+            "Class '" + cls->getName() + "' has no method '" + name + "'");
+      return LLVMValue();
+    }
+    for (const auto &param : resolved.method->getParameters()) {
+      paramNames.push_back(param->getName());
+    }
+
+    // Virtual calls are bound statically when the object's class is known
+    // exactly or no derived class overrides the method
+    llvm::Function *function = methodFunctions_.at(resolved.method);
+    int slot = classHierarchy_.getSlot(cls, name);
+    args[0] = builder.CreateBitCast(object, function->getArg(0)->getType());
+    if (slot < 0 || exact ||
+        classHierarchy_.uniqueImplementation(cls, name)) {
+      target = function;
+    } else {
+      target = llvm::FunctionCallee(
+          function->getFunctionType(),
+          emitVtableLoad(object, slot, function->getFunctionType()));
+    }
+  }
+
+  llvm::FunctionType *type = target.getFunctionType();
+  if (args.size() != type->getNumParams()) {
+    error(core::SourceLocation(),
+          "Argument count mismatch for method " + name + ": expected " +
+              std::to_string(type->getNumParams() - 1) + ", got " +
+              std::to_string(args.size() - 1));
+    return LLVMValue();
+  }
+  for (size_t i = 1; i < args.size(); ++i) {
+    args[i] = convertForStore(args[i], type->getParamType(i), paramNames[i]);
+    if (!args[i]) {
+      return LLVMValue();
+    }
+  }
+
+  llvm::Value *result = emitCall(
+      target, args, type->getReturnType()->isVoidTy() ? "" : "call");
+  return LLVMValue(result, nullptr);
+}
+
+llvm::Value *LLVMCodeGen::emitObject(const nodes::ExpressionNode *node,
+                                     bool &exact) {
+  // A new object's class is the one it was created with
+  exact = nodes::isa<nodes::NewExpressionNode>(node);
+  LLVMValue value = visitExpr(node);
+  if (!value.isValid()) {
+    return nullptr;
+  }
+  return emitObject(value, exact);
+}
+
+llvm::Value *LLVMCodeGen::emitObject(const LLVMValue &value, bool &exact) {
+  auto &builder = context_.getBuilder();
+
+  // A class value is used where it is stored, and holds exactly its class
+  llvm::Type *storedType = value.isLValue() ? value.getStoredType() : nullptr;
+  if (storedType && storedType->isStructTy() && !getInterfaceOf(storedType)) {
+    exact = true;
+    return value.getValue();
+  }
+
+  llvm::Value *object = value.loadIfLValue(builder).getValue();
+  if (object->getType()->isStructTy() && !getInterfaceOf(object->getType())) {
+    if (!currentFunction_) {
+      error(core::SourceLocation(), "Objects can only be used in functions");
+      return nullptr;
+    }
+    llvm::AllocaInst *temporary =
+        currentFunction_->createEntryAlloca(object->getType(), "object");
+    builder.CreateStore(object, temporary);
+    exact = true;
+    return temporary;
+  }
+  return object;
+}
+
+LLVMValue
+LLVMCodeGen::visitMemberExpr(const nodes::MemberExpressionNode *node) {
+  auto &builder = context_.getBuilder();
+  const std::string &name = node->getMember();
+  if (llvm::Constant *value = getEnumMember(node)) {
+    return LLVMValue(value, nullptr);
+  }
+
+  // arr[i].field on a #soa array is arr.field[i]
+  LLVMValue value;
+  auto indexed = nodes::dyn_cast<nodes::IndexExpressionNode>(node->getObject());
+  if (indexed && isStructOfArrays(indexed->getArray())) {
+    bool found = false;
+    value = emitColumnElement(indexed, node->getMemberSymbol(), found);
+    if (found) {
+      return value;
+    }
+  } else {
+    value = visitExpr(node->getObject());
+  }
+  if (!value.isValid()) {
+    return LLVMValue();
+  }
+
+  // Strings know their length
+  if (value.getValue()->getType() == typeBuilder_.getStringType() ||
+      (value.isLValue() &&
+       value.getStoredType() == typeBuilder_.getStringType())) {
+    if (name != "length") {
+      error(core::SourceLocation(),
+            "Cannot access member '" + name + "' of a string");
+      return LLVMValue();
+    }
+    llvm::Value *string = value.loadIfLValue(builder).getValue();
+    return LLVMValue(
+        builder.CreateTrunc(builder.CreateExtractValue(string, 0),
+                            builder.getInt32Ty(), "length"),
+        nullptr);
+  }
+
+  // Arrays have a single member, their element count
+  ArrayElements elements;
+  if (getArrayElements(value, elements)) {
+    if (name != "length") {
+      error(core::SourceLocation(),
+            "Cannot access member '" + name + "' of an array");
+      return LLVMValue();
+    }
+    return LLVMValue(elements.length, nullptr);
+  }
+
+  bool exact = nodes::isa<nodes::NewExpressionNode>(node->getObject());
+  llvm::Value *object = emitObject(value, exact);
+  if (!object) {
+    return LLVMValue();
+  }
+  auto pointerType = llvm::dyn_cast<llvm::PointerType>(object->getType());
+  auto structType = pointerType ? llvm::dyn_cast<llvm::StructType>(
+                                      pointerType->getPointerElementType())
+                                : nullptr;
+  if (!structType || !structType->hasName() ||
+      getInterfaceOf(structType)) {
+    error(core::SourceLocation(), "Cannot access member '" + name +
+                                      "' of a value that is not an object");
+    return LLVMValue();
+  }
+
+  // Inherited fields are reached through the embedded base objects
+  const auto *objectClass = getClassOf(structType);
+  const auto *cls = objectClass;
+  while (true) {
+    int index = typeBuilder_.getFieldIndex(structType, node->getMemberSymbol());
+    if (index >= 0) {
+      LLVMValue field(builder.CreateStructGEP(structType, object, index, name),
+                      nullptr, true);
+      // #shared and #weak fields count their references like variables
+      auto ownership = fieldOwnership_.find(structType);
+      if (ownership != fieldOwnership_.end()) {
+        field.setOwnership(ownership->second[index]);
+      }
+      return field;
+    }
+    if (!cls || !cls->base) {
+      break;
+    }
+    object = builder.CreateStructGEP(structType, object, 0, "base");
+    cls = cls->base;
+    structType =
+        llvm::cast<llvm::StructType>(typeBuilder_.getTypeByName(cls->getName()));
+  }
+
+  error(core::SourceLocation(),
+        objectClass && classHierarchy_.resolve(objectClass, name)
+            ? "Method '" + name + "' can only be called"
+            : "Unknown member '" + name + "'");
   return LLVMValue();
 }
-LLVMValue LLVMCodeGen::visitContinueStmt(const nodes::ContinueStmtNode *node) {
+
+llvm::Constant *
+LLVMCodeGen::getEnumMember(const nodes::MemberExpressionNode *node) {
+  auto object =
+      nodes::dyn_cast<nodes::IdentifierExpressionNode>(node->getObject());
+  if (!object) {
+    return nullptr;
+  }
+
+  // Most member accesses are on objects, so enums are looked up first
+  auto enumIt = enumMembers_.find(object->getSymbol());
+  if (enumIt == enumMembers_.end()) {
+    return nullptr;
+  }
+  auto it = enumIt->second.find(node->getMemberSymbol());
+  if (it == enumIt->second.end()) {
+    return nullptr;
+  }
+
+  // Variables shadow the enum's name
+  const std::string &name = object->getName();
+  if ((currentFunction_ &&
+       currentFunction_->getVariable(object->getSymbol()).isValid()) ||
+      lookupGlobal(name)) {
+    return nullptr;
+  }
+  return llvm::ConstantInt::get(llvm::Type::getInt32Ty(context_.getContext()),
+                                it->second, true);
+}
+
+llvm::Constant *
+LLVMCodeGen::getFoldedValue(const nodes::ExpressionNode *node) {
+  const auto &type = node->getResolvedType();
+  if (!node->isFolded() || !type) {
+    return nullptr;
+  }
+  auto &llvmContext = context_.getContext();
+  core::LiteralValue value = node->getFoldedValue();
+  switch (type->getKind()) {
+  case visitors::ResolvedType::TypeKind::Int:
+    return llvm::ConstantInt::get(llvm::Type::getInt32Ty(llvmContext),
+                                  value.int_value, true);
+  case visitors::ResolvedType::TypeKind::Float:
+    return llvm::ConstantFP::get(llvm::Type::getFloatTy(llvmContext),
+                                 value.float_value);
+  case visitors::ResolvedType::TypeKind::Bool:
+    return llvm::ConstantInt::get(llvm::Type::getInt1Ty(llvmContext),
+                                  value.bool_value);
+  default:
+    return nullptr;
+  }
+}
+
+LLVMValue LLVMCodeGen::visitThisExpr(const nodes::ThisExpressionNode *node) {
+  static const core::Symbol kThis = core::Interner::instance().intern("this");
+  LLVMValue self =
+      currentFunction_ ? currentFunction_->getVariable(kThis) : LLVMValue();
+  if (!self.isValid()) {
+    error(node->getLocation(), "'this' used outside a method");
+    return LLVMValue();
+  }
+  return self.loadIfLValue(context_.getBuilder());
+}
+
+const LLVMClassHierarchy::ClassInfo *
+LLVMCodeGen::getClassOf(llvm::Type *type) const {
+  if (auto pointerType = llvm::dyn_cast<llvm::PointerType>(type)) {
+    type = pointerType->getPointerElementType();
+  }
+  auto structType = llvm::dyn_cast<llvm::StructType>(type);
+  return structType && structType->hasName()
+             ? classHierarchy_.getClass(structType->getName().str())
+             : nullptr;
+}
+
+const LLVMClassHierarchy::InterfaceInfo *
+LLVMCodeGen::getInterfaceOf(llvm::Type *type) const {
+  auto structType = llvm::dyn_cast<llvm::StructType>(type);
+  return structType && structType->hasName()
+             ? classHierarchy_.getInterface(structType->getName().str())
+             : nullptr;
+}
+
+llvm::Constant *
+LLVMCodeGen::getItable(const LLVMClassHierarchy::ClassInfo *cls,
+                       const LLVMClassHierarchy::InterfaceInfo *iface) {
+  auto &module = context_.getModule();
+  llvm::Type *slotType = llvm::Type::getInt8PtrTy(context_.getContext());
+
+  std::string name = cls->getName() + ".itable." + iface->getName();
+  llvm::GlobalVariable *itable = module.getNamedGlobal(name);
+  if (!itable) {
+    std::vector<llvm::Constant *> entries;
+    for (const auto *signature : iface->slots) {
+      const std::string &method = signature->getName();
+      auto resolved = classHierarchy_.resolve(cls, method);
+      if (!resolved) {
+        entries.push_back(llvm::Constant::getNullValue(slotType));
+        continue;
+      }
+      llvm::Function *function = methodFunctions_.at(resolved.method);
+      if (classHierarchy_.getSlot(cls, method) >= 0 &&
+          !classHierarchy_.uniqueImplementation(cls, method)) {
+        function = getDispatchThunk(cls, method);
+      }
+      entries.push_back(llvm::ConstantExpr::getBitCast(function, slotType));
+    }
+    auto *itableType = llvm::ArrayType::get(slotType, entries.size());
+    itable = new llvm::GlobalVariable(
+        module, itableType, true, llvm::GlobalValue::LinkOnceODRLinkage,
+        llvm::ConstantArray::get(itableType, entries), name);
+    itable->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+  }
+
+  llvm::Constant *zero =
+      llvm::ConstantInt::get(llvm::Type::getInt32Ty(context_.getContext()), 0);
+  return llvm::ConstantExpr::getInBoundsGetElementPtr(
+      itable->getValueType(), itable, llvm::ArrayRef<llvm::Constant *>{zero, zero});
+}
+
+llvm::Function *
+LLVMCodeGen::getDispatchThunk(const LLVMClassHierarchy::ClassInfo *cls,
+                              const std::string &name) {
+  auto &module = context_.getModule();
   auto &builder = context_.getBuilder();
 
-  LoopInfo *currentLoop = getCurrentLoop();
-  if (!currentLoop) {
-    error(core::SourceLocation(), "Continue statement outside of loop");
-    return LLVMValue();
+  std::string thunkName = cls->getName() + "." + name + ".dispatch";
+  if (llvm::Function *thunk = module.getFunction(thunkName)) {
+    return thunk;
   }
 
-  builder.CreateBr(currentLoop->continueDest);
-  return LLVMValue();
+  llvm::Function *method =
+      methodFunctions_.at(classHierarchy_.resolve(cls, name).method);
+  llvm::FunctionType *type = method->getFunctionType();
+  llvm::Function *thunk = llvm::Function::Create(
+      type, llvm::GlobalValue::LinkOnceODRLinkage, thunkName, module);
+
+  // Built aside, so the code being generated keeps its insertion point;
+  // the thunk has no source to attribute it to
+  llvm::IRBuilderBase::InsertPointGuard guard(builder);
+  builder.SetCurrentDebugLocation(llvm::DebugLoc());
+  builder.SetInsertPoint(
+      llvm::BasicBlock::Create(context_.getContext(), "entry", thunk));
+  std::vector<llvm::Value *> args;
+  for (auto &arg : thunk->args()) {
+    args.push_back(&arg);
+  }
+  llvm::CallInst *call = builder.CreateCall(
+      type,
+      emitVtableLoad(thunk->getArg(0), classHierarchy_.getSlot(cls, name),
+                     type),
+      args);
+  call->setTailCall();
+  if (type->getReturnType()->isVoidTy()) {
+    builder.CreateRetVoid();
+  } else {
+    builder.CreateRet(call);
+  }
+  return thunk;
 }
 
-LLVMValue LLVMCodeGen::visitSwitchStmt(const nodes::SwitchStmtNode *node) {
-  return LLVMValue();
-}
-LLVMValue LLVMCodeGen::visitTryStmt(const nodes::TryStmtNode *node) {
-  return LLVMValue();
-}
-LLVMValue LLVMCodeGen::visitThrowStmt(const nodes::ThrowStmtNode *node) {
-  return LLVMValue();
+llvm::Value *LLVMCodeGen::emitVtableLoad(llvm::Value *object, int slot,
+                                         llvm::FunctionType *type) {
+  auto &builder = context_.getBuilder();
+  llvm::Type *slotType = builder.getInt8PtrTy();
+  llvm::Type *vtableType = slotType->getPointerTo();
+
+  // The vtable pointer is the first word of every object that has one
+  llvm::Value *vtable = builder.CreateLoad(
+      vtableType,
+      builder.CreateBitCast(object, vtableType->getPointerTo(), "vptr"),
+      "vtable");
+  auto *method = builder.CreateLoad(
+      slotType, builder.CreateConstInBoundsGEP1_32(slotType, vtable, slot,
+                                                   "vslot"),
+      "vfn");
+
+  // Vtables are constant, so a loaded entry never changes
+  method->setMetadata(llvm::LLVMContext::MD_invariant_load,
+                      llvm::MDNode::get(context_.getContext(), {}));
+  return builder.CreateBitCast(method, type->getPointerTo());
 }
-LLVMValue LLVMCodeGen::visitDeclStmt(const nodes::DeclarationStmtNode *node) {
-  // Handle variable declarations within statements
-  if (auto varDecl = node->getDeclaration()) {
-    if (auto varDeclNode =
-            std::dynamic_pointer_cast<nodes::VarDeclNode>(varDecl)) {
-      return visitVarDecl(varDeclNode.get(), false);
+
+bool LLVMCodeGen::getArrayElements(const LLVMValue &array,
+                                   ArrayElements &elements) {
+  auto &builder = context_.getBuilder();
+
+  // Sized arrays are indexed where they are stored; a sized array value is
+  // spilled first
+  llvm::Type *storedType = array.isLValue() ? array.getStoredType() : nullptr;
+  llvm::Value *address = array.getValue();
+  if (!storedType) {
+    storedType = address->getType();
+    if (storedType->isArrayTy()) {
+      if (!currentFunction_) {
+        return false;
+      }
+      llvm::AllocaInst *temporary =
+          currentFunction_->createEntryAlloca(storedType, "array");
+      builder.CreateStore(address, temporary);
+      address = temporary;
     }
   }
-  return LLVMValue();
+  if (auto arrayType = llvm::dyn_cast<llvm::ArrayType>(storedType)) {
+    elements.elementType = arrayType->getElementType();
+    elements.data =
+        builder.CreateConstInBoundsGEP2_32(arrayType, address, 0, 0, "data");
+    elements.length = builder.getInt32(arrayType->getNumElements());
+    return true;
+  }
+  // A #soa array has a column per field, all of the same length
+  if (llvm::StructType *elementType =
+          typeBuilder_.getStructOfArraysElement(storedType)) {
+    if (elementType->getNumElements() == 0) {
+      return false;
+    }
+    llvm::Value *value = array.loadIfLValue(builder).getValue();
+    elements.elementType = elementType;
+    for (unsigned i = 0; i < elementType->getNumElements(); ++i) {
+      elements.columns.push_back(
+          builder.CreateExtractValue(value, {i, 0}, "column"));
+    }
+    elements.length = builder.CreateTrunc(
+        builder.CreateExtractValue(value, {0, 1}), builder.getInt32Ty(),
+        "length");
+    return true;
+  }
+  if (LLVMTypeBuilder::isSliceType(storedType)) {
+    llvm::Value *value = array.loadIfLValue(builder).getValue();
+    elements.data = builder.CreateExtractValue(value, 0, "data");
+    elements.elementType = elements.data->getType()->getPointerElementType();
+    elements.length = builder.CreateTrunc(builder.CreateExtractValue(value, 1),
+                                          builder.getInt32Ty(), "length");
+    elements.view = true;
+    return true;
+  }
+  if (!LLVMTypeBuilder::isDynamicArrayType(storedType)) {
+    return false;
+  }
+
+  // Indices are ints. The truncated length is never above the real one,
+  // so checks against it stay safe even for arrays of 2^32 elements.
+  llvm::Value *value = array.loadIfLValue(builder).getValue();
+  elements.data = builder.CreateExtractValue(value, 0, "data");
+  elements.elementType = elements.data->getType()->getPointerElementType();
+  elements.length = builder.CreateTrunc(builder.CreateExtractValue(value, 1),
+                                        builder.getInt32Ty(), "length");
+  return true;
 }
 
-LLVMValue
-LLVMCodeGen::visitBinaryExpr(const nodes::BinaryExpressionNode *node) {
+llvm::Value *LLVMCodeGen::emitElementLoad(const ArrayElements &elements,
+                                          llvm::Value *index) {
   auto &builder = context_.getBuilder();
-  auto &llvmContext = context_.getContext();
+  if (elements.columns.empty()) {
+    llvm::Value *element = builder.CreateAlignedLoad(
+        elements.elementType,
+        builder.CreateInBoundsGEP(elements.elementType, elements.data, index),
+        typeBuilder_.getAlignment(elements.elementType));
+    return builder.CreateZExtOrBitCast(element, elements.getValueType());
+  }
 
-  LLVMValue left = visitExpr(node->getLeft().get());
-  LLVMValue right = visitExpr(node->getRight().get());
+  auto structType = llvm::cast<llvm::StructType>(elements.elementType);
+  llvm::Value *element = llvm::UndefValue::get(structType);
+  for (unsigned i = 0; i < structType->getNumElements(); ++i) {
+    llvm::Type *fieldType = structType->getElementType(i);
+    llvm::Value *field = builder.CreateAlignedLoad(
+        fieldType,
+        builder.CreateInBoundsGEP(fieldType, elements.columns[i], index),
+        typeBuilder_.getAlignment(fieldType));
+    element = builder.CreateInsertValue(element, field, i);
+  }
+  return element;
+}
 
-  if (!left.isValid() || !right.isValid()) {
-    error(core::SourceLocation(), "Invalid operands in binary expression");
+LLVMValue LLVMCodeGen::emitArrayMethod(const nodes::CallExpressionNode *node,
+                                       const std::string &name,
+                                       const LLVMValue &array) {
+  auto &builder = context_.getBuilder();
+  auto &llvmContext = context_.getContext();
+  auto arrayValueType = llvm::cast<llvm::StructType>(array.getStoredType());
+  llvm::StructType *soaElement =
+      typeBuilder_.getStructOfArraysElement(arrayValueType);
+  llvm::Type *elementType =
+      soaElement ? soaElement
+                 : arrayValueType->getElementType(0)->getPointerElementType();
+  if ((name != "push" && name != "reserve") ||
+      node->getArguments().size() != 1) {
+    error(core::SourceLocation(), "Arrays have no method '" + name +
+                                      "' taking " +
+                                      std::to_string(node->getArguments().size()) +
+                                      " arguments");
+    return LLVMValue();
+  }
+  LLVMValue argument = visitExpr(node->getArguments()[0]);
+  if (!argument.isValid()) {
+    return LLVMValue();
+  }
+  llvm::Value *value = argument.loadIfLValue(builder).getValue();
+  if (name == "reserve" && !value->getType()->isIntegerTy()) {
+    error(core::SourceLocation(), "Array capacity must be an integer");
     return LLVMValue();
   }
 
-  // Load values if they are lvalues
-  llvm::Value *leftVal = left.loadIfLValue(builder).getValue();
-  llvm::Value *rightVal = right.loadIfLValue(builder).getValue();
-
-  llvm::Value *result = nullptr;
-
-  switch (node->getExpressionType()) {
-  case tokens::TokenType::PLUS:
-    if (leftVal->getType()->isIntegerTy() &&
-        rightVal->getType()->isIntegerTy()) {
-      result = builder.CreateAdd(leftVal, rightVal, "add");
-    } else if (leftVal->getType()->isFloatingPointTy() ||
-               rightVal->getType()->isFloatingPointTy()) {
-      // Handle float addition (would need proper type conversion)
-      result = builder.CreateFAdd(leftVal, rightVal, "fadd");
+  // The runtime sees the array as a tspp_array
+  const llvm::DataLayout &layout = context_.getModule().getDataLayout();
+  if (soaElement) {
+    if (name == "push") {
+      value = convertForStore(value, soaElement, "element");
+      if (value) {
+        emitColumnsPush(array.getValue(), value);
+      }
+      return LLVMValue();
     }
-    break;
-
-  case tokens::TokenType::MINUS:
-    if (leftVal->getType()->isIntegerTy() &&
-        rightVal->getType()->isIntegerTy()) {
-      result = builder.CreateSub(leftVal, rightVal, "sub");
-    } else {
-      result = builder.CreateFSub(leftVal, rightVal, "fsub");
+    // Every column makes room for the same number of elements
+    llvm::Value *capacity =
+        builder.CreateSExtOrTrunc(value, builder.getInt64Ty());
+    for (unsigned i = 0; i < soaElement->getNumElements(); ++i) {
+      llvm::Type *fieldType = soaElement->getElementType(i);
+      builder.CreateCall(
+          context_.getModule().getFunction("tspp_array_reserve"),
+          {builder.CreateBitCast(
+               builder.CreateStructGEP(arrayValueType, array.getValue(), i),
+               typeBuilder_.getDynamicArrayType(builder.getInt8Ty())
+                   ->getPointerTo()),
+           capacity, builder.getInt64(layout.getTypeAllocSize(fieldType)),
+           builder.getInt64(typeBuilder_.getAlignment(fieldType).value())});
     }
-    break;
+    return LLVMValue();
+  }
+  llvm::Value *runtimeArray = builder.CreateBitCast(
+      array.getValue(), typeBuilder_.getDynamicArrayType(builder.getInt8Ty())
+                            ->getPointerTo());
+  llvm::Value *elementSize =
+      builder.getInt64(layout.getTypeAllocSize(elementType));
+  llvm::Value *elementAlign =
+      builder.getInt64(typeBuilder_.getAlignment(elementType).value());
+
+  if (name == "reserve") {
+    builder.CreateCall(
+        context_.getModule().getFunction("tspp_array_reserve"),
+        {runtimeArray, builder.CreateSExtOrTrunc(value, builder.getInt64Ty()),
+         elementSize, elementAlign});
+    return LLVMValue();
+  }
 
-  case tokens::TokenType::STAR:
-    if (leftVal->getType()->isIntegerTy() &&
-        rightVal->getType()->isIntegerTy()) {
-      result = builder.CreateMul(leftVal, rightVal, "mul");
-    } else {
-      result = builder.CreateFMul(leftVal, rightVal, "fmul");
-    }
-    break;
+  value = convertForStore(value, elementType, "element");
+  if (!value) {
+    return LLVMValue();
+  }
 
-  case tokens::TokenType::SLASH:
-    if (leftVal->getType()->isIntegerTy() &&
-        rightVal->getType()->isIntegerTy()) {
-      result = builder.CreateSDiv(leftVal, rightVal, "div");
-    } else {
-      result = builder.CreateFDiv(leftVal, rightVal, "fdiv");
-    }
-    break;
+  // Growing is rare, so the common path is a compare and a store
+  llvm::Value *lengthAddress =
+      builder.CreateStructGEP(arrayValueType, array.getValue(), 1);
+  llvm::Value *length =
+      builder.CreateLoad(builder.getInt64Ty(), lengthAddress, "length");
+  llvm::Value *capacity = builder.CreateLoad(
+      builder.getInt64Ty(),
+      builder.CreateStructGEP(arrayValueType, array.getValue(), 2),
+      "capacity");
+  llvm::Function *function = builder.GetInsertBlock()->getParent();
+  llvm::BasicBlock *growBlock =
+      llvm::BasicBlock::Create(llvmContext, "push.grow", function);
+  llvm::BasicBlock *storeBlock =
+      llvm::BasicBlock::Create(llvmContext, "push.store", function);
+  llvm::MDBuilder mdBuilder(llvmContext);
+  builder.CreateCondBr(builder.CreateICmpEQ(length, capacity, "full"),
+                       growBlock, storeBlock,
+                       mdBuilder.createBranchWeights(1, 2000));
+
+  builder.SetInsertPoint(growBlock);
+  builder.CreateCall(context_.getModule().getFunction("tspp_array_grow"),
+                     {runtimeArray, elementSize, elementAlign});
+  builder.CreateBr(storeBlock);
+
+  builder.SetInsertPoint(storeBlock);
+  llvm::Value *data = builder.CreateLoad(
+      arrayValueType->getElementType(0),
+      builder.CreateStructGEP(arrayValueType, array.getValue(), 0), "data");
+  builder.CreateAlignedStore(
+      value, builder.CreateInBoundsGEP(elementType, data, length),
+      typeBuilder_.getAlignment(elementType));
+  builder.CreateStore(builder.CreateAdd(length, builder.getInt64(1)),
+                      lengthAddress);
+  return LLVMValue();
+}
 
-  case tokens::TokenType::PERCENT:
-    if (leftVal->getType()->isIntegerTy() &&
-        rightVal->getType()->isIntegerTy()) {
-      result = builder.CreateSRem(leftVal, rightVal, "mod");
-    }
-    break;
+void LLVMCodeGen::emitColumnsPush(llvm::Value *array, llvm::Value *element) {
+  auto &builder = context_.getBuilder();
+  auto &llvmContext = context_.getContext();
+  const llvm::DataLayout &layout = context_.getModule().getDataLayout();
+  auto arrayType =
+      llvm::cast<llvm::StructType>(array->getType()->getPointerElementType());
+  auto elementType = llvm::cast<llvm::StructType>(element->getType());
+  llvm::Type *runtimeArrayType =
+      typeBuilder_.getDynamicArrayType(builder.getInt8Ty())->getPointerTo();
+
+  auto firstColumnType =
+      llvm::cast<llvm::StructType>(arrayType->getElementType(0));
+  llvm::Value *firstColumn = builder.CreateStructGEP(arrayType, array, 0);
+  llvm::Value *length = builder.CreateLoad(
+      builder.getInt64Ty(),
+      builder.CreateStructGEP(firstColumnType, firstColumn, 1), "length");
+  llvm::Value *capacity = builder.CreateLoad(
+      builder.getInt64Ty(),
+      builder.CreateStructGEP(firstColumnType, firstColumn, 2), "capacity");
+  llvm::Function *function = builder.GetInsertBlock()->getParent();
+  llvm::BasicBlock *growBlock =
+      llvm::BasicBlock::Create(llvmContext, "push.grow", function);
+  llvm::BasicBlock *storeBlock =
+      llvm::BasicBlock::Create(llvmContext, "push.store", function);
+  llvm::MDBuilder mdBuilder(llvmContext);
+  builder.CreateCondBr(builder.CreateICmpEQ(length, capacity, "full"),
+                       growBlock, storeBlock,
+                       mdBuilder.createBranchWeights(1, 2000));
+
+  builder.SetInsertPoint(growBlock);
+  for (unsigned i = 0; i < elementType->getNumElements(); ++i) {
+    llvm::Type *fieldType = elementType->getElementType(i);
+    builder.CreateCall(
+        context_.getModule().getFunction("tspp_array_grow"),
+        {builder.CreateBitCast(builder.CreateStructGEP(arrayType, array, i),
+                               runtimeArrayType),
+         builder.getInt64(layout.getTypeAllocSize(fieldType)),
+         builder.getInt64(typeBuilder_.getAlignment(fieldType).value())});
+  }
+  builder.CreateBr(storeBlock);
+
+  builder.SetInsertPoint(storeBlock);
+  llvm::Value *newLength = builder.CreateAdd(length, builder.getInt64(1));
+  for (unsigned i = 0; i < elementType->getNumElements(); ++i) {
+    llvm::Type *fieldType = elementType->getElementType(i);
+    auto columnType = llvm::cast<llvm::StructType>(arrayType->getElementType(i));
+    llvm::Value *column = builder.CreateStructGEP(arrayType, array, i);
+    llvm::Value *data = builder.CreateLoad(
+        columnType->getElementType(0),
+        builder.CreateStructGEP(columnType, column, 0), "data");
+    builder.CreateAlignedStore(builder.CreateExtractValue(element, i),
+                               builder.CreateInBoundsGEP(fieldType, data,
+                                                         length),
+                               typeBuilder_.getAlignment(fieldType));
+    builder.CreateStore(newLength,
+                        builder.CreateStructGEP(columnType, column, 1));
+  }
+}
 
-  case tokens::TokenType::EQUALS_EQUALS:
-    if (leftVal->getType()->isIntegerTy() &&
-        rightVal->getType()->isIntegerTy()) {
-      result = builder.CreateICmpEQ(leftVal, rightVal, "eq");
-    } else {
-      result = builder.CreateFCmpOEQ(leftVal, rightVal, "feq");
+LLVMValue LLVMCodeGen::emitSliceMethod(const nodes::CallExpressionNode *node,
+                                       const std::string &name,
+                                       const LLVMValue &slice) {
+  auto &builder = context_.getBuilder();
+  if (name != "slice" || node->getArguments().size() != 2) {
+    error(core::SourceLocation(), "Slices have no method '" + name +
+                                      "' taking " +
+                                      std::to_string(node->getArguments().size()) +
+                                      " arguments");
+    return LLVMValue();
+  }
+  ArrayElements elements;
+  getArrayElements(slice, elements);
+  llvm::Value *bounds[2];
+  for (size_t i = 0; i < 2; ++i) {
+    LLVMValue argument = visitExpr(node->getArguments()[i]);
+    if (!argument.isValid()) {
+      return LLVMValue();
     }
-    break;
-
-  case tokens::TokenType::EXCLAIM_EQUALS:
-    if (leftVal->getType()->isIntegerTy() &&
-        rightVal->getType()->isIntegerTy()) {
-      result = builder.CreateICmpNE(leftVal, rightVal, "ne");
-    } else {
-      result = builder.CreateFCmpONE(leftVal, rightVal, "fne");
+    bounds[i] = argument.loadIfLValue(builder).getValue();
+    if (!bounds[i]->getType()->isIntegerTy()) {
+      error(core::SourceLocation(), "Slice bounds must be integers");
+      return LLVMValue();
     }
-    break;
+    bounds[i] = builder.CreateSExtOrTrunc(bounds[i], builder.getInt32Ty(),
+                                          i == 0 ? "begin" : "end");
+  }
 
-  case tokens::TokenType::LEFT_BRACKET:
-    if (leftVal->getType()->isIntegerTy() &&
-        rightVal->getType()->isIntegerTy()) {
-      result = builder.CreateICmpSLT(leftVal, rightVal, "lt");
-    } else {
-      result = builder.CreateFCmpOLT(leftVal, rightVal, "flt");
-    }
-    break;
+  // 0 <= begin <= end <= length; the length is an int, so adding one to it
+  // or to end cannot wrap
+  llvm::Value *begin = bounds[0];
+  llvm::Value *end = bounds[1];
+  emitBoundsCheck(
+      end, builder.CreateNUWAdd(elements.length, builder.getInt32(1)),
+      node->getLocation());
+  emitBoundsCheck(begin, builder.CreateNUWAdd(end, builder.getInt32(1)),
+                  node->getLocation());
+
+  llvm::Type *sliceType = slice.isLValue() ? slice.getStoredType()
+                                           : slice.getValue()->getType();
+  llvm::Value *result = llvm::UndefValue::get(sliceType);
+  result = builder.CreateInsertValue(
+      result,
+      builder.CreateInBoundsGEP(elements.elementType, elements.data, begin),
+      0);
+  return LLVMValue(
+      builder.CreateInsertValue(
+          result,
+          builder.CreateZExt(builder.CreateNSWSub(end, begin),
+                             builder.getInt64Ty()),
+          1, "slice"),
+      nullptr);
+}
 
-  case tokens::TokenType::RIGHT_BRACKET:
-    if (leftVal->getType()->isIntegerTy() &&
-        rightVal->getType()->isIntegerTy()) {
-      result = builder.CreateICmpSGT(leftVal, rightVal, "gt");
-    } else {
-      result = builder.CreateFCmpOGT(leftVal, rightVal, "fgt");
-    }
-    break;
+LLVMValue LLVMCodeGen::emitAtomicMethod(const nodes::CallExpressionNode *node,
+                                        const std::string &name,
+                                        const LLVMValue &atomic) {
+  auto &builder = context_.getBuilder();
+  const auto &args = node->getArguments();
+  size_t operands = name == "load"              ? 0
+                    : name == "compareExchange" ? 2
+                                                : 1;
+
+  // Through a pointer, the atomic is the one it points to
+  llvm::Value *address = atomic.getValue();
+  if (atomic.getType()->getKind() != visitors::ResolvedType::TypeKind::Atomic) {
+    address = atomic.loadIfLValue(builder).getValue();
+  } else if (!atomic.isLValue()) {
+    error(core::SourceLocation(), "Atomic operations need a variable or field");
+    return LLVMValue();
+  }
+  llvm::Type *valueType = address->getType()->getPointerElementType();
 
-  case tokens::TokenType::LESS_EQUALS:
-    if (leftVal->getType()->isIntegerTy() &&
-        rightVal->getType()->isIntegerTy()) {
-      result = builder.CreateICmpSLE(leftVal, rightVal, "le");
-    } else {
-      result = builder.CreateFCmpOLE(leftVal, rightVal, "fle");
+  std::vector<llvm::Value *> values;
+  for (size_t i = 0; i < operands && i < args.size(); ++i) {
+    LLVMValue argument = visitExpr(args[i]);
+    if (!argument.isValid()) {
+      return LLVMValue();
     }
-    break;
-
-  case tokens::TokenType::GREATER_EQUALS:
-    if (leftVal->getType()->isIntegerTy() &&
-        rightVal->getType()->isIntegerTy()) {
-      result = builder.CreateICmpSGE(leftVal, rightVal, "ge");
-    } else {
-      result = builder.CreateFCmpOGE(leftVal, rightVal, "fge");
+    values.push_back(convertForStore(argument.loadIfLValue(builder).getValue(),
+                                     valueType, "operand"));
+    if (!values.back()) {
+      return LLVMValue();
     }
-    break;
+  }
 
-    // case tokens::TokenType::LOGICAL_AND:
-    //   result = builder.CreateAnd(leftVal, rightVal, "and");
-    //   break;
+  // The checker has vetted the order; its quotes are still on
+  auto order = llvm::AtomicOrdering::SequentiallyConsistent;
+  if (args.size() > operands) {
+    std::string text =
+        nodes::cast<nodes::LiteralExpressionNode>(args.back())
+            ->getValue();
+    text = text.substr(1, text.size() - 2);
+    order = text == "relaxed"   ? llvm::AtomicOrdering::Monotonic
+            : text == "acquire" ? llvm::AtomicOrdering::Acquire
+            : text == "release" ? llvm::AtomicOrdering::Release
+            : text == "acq_rel" ? llvm::AtomicOrdering::AcquireRelease
+                                : llvm::AtomicOrdering::SequentiallyConsistent;
+  }
 
-    // case tokens::TokenType::LOGICAL_OR:
-    //   result = builder.CreateOr(leftVal, rightVal, "or");
-    //   break;
+  // Float add and subtract have atomicrmw forms of their own
+  llvm::Align alignment(
+      context_.getModule().getDataLayout().getTypeStoreSize(valueType));
+  if ((name == "fetchAdd" || name == "fetchSub") &&
+      valueType->isFloatingPointTy()) {
+    return LLVMValue(
+        builder.CreateAtomicRMW(name == "fetchAdd"
+                                    ? llvm::AtomicRMWInst::FAdd
+                                    : llvm::AtomicRMWInst::FSub,
+                                address, values[0], alignment, order),
+        nullptr);
+  }
 
-  default:
-    error(core::SourceLocation(), "Unsupported binary operator");
-    return LLVMValue();
+  // Everything else works on the value's bits, since LLVM has no atomic
+  // booleans and no float or pointer forms of every instruction
+  llvm::Type *bitsType = builder.getIntNTy(alignment.value() * 8);
+  auto toBits = [&](llvm::Value *value) -> llvm::Value * {
+    if (value->getType()->isIntegerTy()) {
+      return builder.CreateZExt(value, bitsType);
+    }
+    if (value->getType()->isPointerTy()) {
+      return builder.CreatePtrToInt(value, bitsType);
+    }
+    return builder.CreateBitCast(value, bitsType);
+  };
+  auto fromBits = [&](llvm::Value *bits) -> llvm::Value * {
+    if (valueType->isIntegerTy()) {
+      return builder.CreateTrunc(bits, valueType);
+    }
+    if (valueType->isPointerTy()) {
+      return builder.CreateIntToPtr(bits, valueType);
+    }
+    return builder.CreateBitCast(bits, valueType);
+  };
+  llvm::Value *bitsAddress =
+      builder.CreateBitCast(address, bitsType->getPointerTo());
+  for (auto &value : values) {
+    value = toBits(value);
   }
 
-  if (!result) {
-    error(core::SourceLocation(), "Failed to generate binary operation");
+  if (name == "load") {
+    llvm::LoadInst *load =
+        builder.CreateAlignedLoad(bitsType, bitsAddress, alignment, "atomic");
+    load->setAtomic(order);
+    return LLVMValue(fromBits(load), nullptr);
+  }
+  if (name == "store") {
+    builder.CreateAlignedStore(values[0], bitsAddress, alignment)
+        ->setAtomic(order);
     return LLVMValue();
   }
+  if (name == "compareExchange") {
+    // A failed exchange stores nothing, so it cannot release
+    auto failure = order == llvm::AtomicOrdering::Release
+                       ? llvm::AtomicOrdering::Monotonic
+                   : order == llvm::AtomicOrdering::AcquireRelease
+                       ? llvm::AtomicOrdering::Acquire
+                       : order;
+    llvm::Value *result = builder.CreateAtomicCmpXchg(
+        bitsAddress, values[0], values[1], alignment, order, failure);
+    return LLVMValue(builder.CreateExtractValue(result, 1, "exchanged"),
+                     nullptr);
+  }
 
-  return LLVMValue(result, nullptr);
+  llvm::AtomicRMWInst::BinOp operation =
+      name == "exchange"   ? llvm::AtomicRMWInst::Xchg
+      : name == "fetchAdd" ? llvm::AtomicRMWInst::Add
+      : name == "fetchSub" ? llvm::AtomicRMWInst::Sub
+      : name == "fetchAnd" ? llvm::AtomicRMWInst::And
+      : name == "fetchOr"  ? llvm::AtomicRMWInst::Or
+                           : llvm::AtomicRMWInst::Xor;
+  return LLVMValue(fromBits(builder.CreateAtomicRMW(
+                       operation, bitsAddress, values[0], alignment, order)),
+                   nullptr);
 }
 
-LLVMValue LLVMCodeGen::visitUnaryExpr(const nodes::UnaryExpressionNode *node) {
+llvm::Value *LLVMCodeGen::emitVectorOperation(tokens::TokenType op,
+                                              llvm::Value *leftVal,
+                                              llvm::Value *rightVal) {
   auto &builder = context_.getBuilder();
-  auto &llvmContext = context_.getContext();
-
-  LLVMValue operand = visitExpr(node->getOperand().get());
-  if (!operand.isValid()) {
-    error(core::SourceLocation(), "Invalid operand in unary expression");
-    return LLVMValue();
+  auto vectorType = llvm::cast<llvm::FixedVectorType>(
+      (leftVal->getType()->isVectorTy() ? leftVal : rightVal)->getType());
+  llvm::Type *element = vectorType->getElementType();
+  unsigned lanes = vectorType->getNumElements();
+
+  // A scalar takes the element type and is copied to every lane
+  for (llvm::Value **operand : {&leftVal, &rightVal}) {
+    if (!(*operand)->getType()->isVectorTy()) {
+      llvm::Value *scalar = convertNumeric(*operand, element);
+      if (!scalar) {
+        error(core::SourceLocation(),
+              "Mismatched operand types in binary expression");
+        return nullptr;
+      }
+      *operand = builder.CreateVectorSplat(lanes, scalar, "splat");
+    }
+  }
+  if (leftVal->getType() != rightVal->getType()) {
+    error(core::SourceLocation(),
+          "Mismatched operand types in binary expression");
+    return nullptr;
   }
 
-  llvm::Value *operandVal = operand.loadIfLValue(builder).getValue();
-  llvm::Value *result = nullptr;
-
-  switch (node->getOperand()->getExpressionType()) {
+  bool isFloat = element->isFloatingPointTy();
+  llvm::CmpInst::Predicate predicate;
+  switch (op) {
+  case tokens::TokenType::PLUS:
+    return isFloat ? builder.CreateFAdd(leftVal, rightVal, "fadd")
+                   : builder.CreateAdd(leftVal, rightVal, "add");
   case tokens::TokenType::MINUS:
-    if (operandVal->getType()->isIntegerTy()) {
-      result = builder.CreateNeg(operandVal, "neg");
-    } else {
-      result = builder.CreateFNeg(operandVal, "fneg");
-    }
+    return isFloat ? builder.CreateFSub(leftVal, rightVal, "fsub")
+                   : builder.CreateSub(leftVal, rightVal, "sub");
+  case tokens::TokenType::STAR:
+    return isFloat ? builder.CreateFMul(leftVal, rightVal, "fmul")
+                   : builder.CreateMul(leftVal, rightVal, "mul");
+  case tokens::TokenType::SLASH:
+    return isFloat ? builder.CreateFDiv(leftVal, rightVal, "fdiv")
+                   : builder.CreateSDiv(leftVal, rightVal, "div");
+  case tokens::TokenType::PERCENT:
+    return isFloat ? builder.CreateFRem(leftVal, rightVal, "fmod")
+                   : builder.CreateSRem(leftVal, rightVal, "mod");
+  case tokens::TokenType::EQUALS_EQUALS:
+    predicate = isFloat ? llvm::CmpInst::FCMP_OEQ : llvm::CmpInst::ICMP_EQ;
     break;
-
-  case tokens::TokenType::PLUS:
-    // Unary plus is essentially a no-op
-    result = operandVal;
+  case tokens::TokenType::EXCLAIM_EQUALS:
+    predicate = isFloat ? llvm::CmpInst::FCMP_ONE : llvm::CmpInst::ICMP_NE;
     break;
-
-  case tokens::TokenType::EXCLAIM:
-    result = builder.CreateNot(operandVal, "not");
+  case tokens::TokenType::LESS:
+    predicate = isFloat ? llvm::CmpInst::FCMP_OLT : llvm::CmpInst::ICMP_SLT;
+    break;
+  case tokens::TokenType::GREATER:
+    predicate = isFloat ? llvm::CmpInst::FCMP_OGT : llvm::CmpInst::ICMP_SGT;
+    break;
+  case tokens::TokenType::LESS_EQUALS:
+    predicate = isFloat ? llvm::CmpInst::FCMP_OLE : llvm::CmpInst::ICMP_SLE;
+    break;
+  case tokens::TokenType::GREATER_EQUALS:
+    predicate = isFloat ? llvm::CmpInst::FCMP_OGE : llvm::CmpInst::ICMP_SGE;
     break;
+  default:
+    error(core::SourceLocation(), "Unsupported vector operator");
+    return nullptr;
+  }
 
-  case tokens::TokenType::PLUS_PLUS:
-    if (operand.isLValue()) {
-      llvm::Value *one = llvm::ConstantInt::get(operandVal->getType(), 1);
-      result = builder.CreateAdd(operandVal, one, "inc");
-      builder.CreateStore(result, operand.getValue());
-      return operand; // Return the lvalue for pre-increment
+  // A lane where the comparison holds is all ones, as in OpenCL
+  llvm::Value *mask = builder.CreateCmp(predicate, leftVal, rightVal, "cmp");
+  return builder.CreateSExt(
+      mask, llvm::FixedVectorType::get(builder.getInt32Ty(), lanes), "mask");
+}
+
+LLVMValue
+LLVMCodeGen::emitVectorConstruction(const nodes::CallExpressionNode *node) {
+  auto &builder = context_.getBuilder();
+  auto vectorType = llvm::cast<llvm::FixedVectorType>(
+      typeBuilder_.convertType(node->getResolvedType()));
+  std::vector<llvm::Value *> values;
+  for (const auto &arg : node->getArguments()) {
+    LLVMValue argument = visitExpr(arg);
+    if (!argument.isValid()) {
+      return LLVMValue();
     }
-    break;
+    values.push_back(convertNumeric(argument.loadIfLValue(builder).getValue(),
+                                    vectorType->getElementType()));
+    if (!values.back()) {
+      error(core::SourceLocation(), "Vector lanes must be numbers");
+      return LLVMValue();
+    }
+  }
+
+  if (values.size() == 1) {
+    return LLVMValue(builder.CreateVectorSplat(vectorType->getNumElements(),
+                                               values[0], "splat"),
+                     nullptr);
+  }
+  // Constant lanes fold into a constant vector
+  llvm::Value *vector = llvm::PoisonValue::get(vectorType);
+  for (size_t i = 0; i < values.size(); ++i) {
+    vector = builder.CreateInsertElement(vector, values[i],
+                                         builder.getInt32(i), "vector");
+  }
+  return LLVMValue(vector, nullptr);
+}
 
-  case tokens::TokenType::MINUS_MINUS:
-    if (operand.isLValue()) {
-      llvm::Value *one = llvm::ConstantInt::get(operandVal->getType(), 1);
-      result = builder.CreateSub(operandVal, one, "dec");
-      builder.CreateStore(result, operand.getValue());
-      return operand; // Return the lvalue for pre-decrement
+LLVMValue LLVMCodeGen::emitVectorMethod(const nodes::CallExpressionNode *node,
+                                        const std::string &name,
+                                        const LLVMValue &vector) {
+  auto &builder = context_.getBuilder();
+  const auto &args = node->getArguments();
+  llvm::Value *value = vector.loadIfLValue(builder).getValue();
+  auto vectorType = llvm::cast<llvm::FixedVectorType>(value->getType());
+  llvm::Type *element = vectorType->getElementType();
+  bool isFloat = element->isFloatingPointTy();
+
+  // The checker has vetted the lane indices, integer literals
+  if (name == "shuffle") {
+    llvm::Value *other = nullptr;
+    size_t first = 0;
+    if (!args.empty() && args[0]->getResolvedType() &&
+        args[0]->getResolvedType()->getKind() ==
+            visitors::ResolvedType::TypeKind::Vector) {
+      LLVMValue otherValue = visitExpr(args[0]);
+      if (!otherValue.isValid()) {
+        return LLVMValue();
+      }
+      other = otherValue.loadIfLValue(builder).getValue();
+      first = 1;
     }
-    break;
+    std::vector<int> mask;
+    for (size_t i = first; i < args.size(); ++i) {
+      mask.push_back(std::stoi(
+          nodes::cast<nodes::LiteralExpressionNode>(args[i])->getValue()));
+    }
+    return LLVMValue(other ? builder.CreateShuffleVector(value, other, mask,
+                                                         "shuffle")
+                           : builder.CreateShuffleVector(value, mask,
+                                                         "shuffle"),
+                     nullptr);
+  }
 
-  default:
-    error(core::SourceLocation(), "Unsupported unary operator");
-    return LLVMValue();
+  if (name == "extract" || name == "insert") {
+    LLVMValue laneValue = visitExpr(args[0]);
+    if (!laneValue.isValid()) {
+      return LLVMValue();
+    }
+    llvm::Value *lane = builder.CreateSExtOrTrunc(
+        laneValue.loadIfLValue(builder).getValue(), builder.getInt32Ty(),
+        "lane");
+    emitBoundsCheck(lane, builder.getInt32(vectorType->getNumElements()),
+                    node->getLocation());
+    if (name == "extract") {
+      return LLVMValue(builder.CreateExtractElement(value, lane, "extract"),
+                       nullptr);
+    }
+    LLVMValue argument = visitExpr(args[1]);
+    if (!argument.isValid()) {
+      return LLVMValue();
+    }
+    llvm::Value *scalar =
+        convertNumeric(argument.loadIfLValue(builder).getValue(), element);
+    if (!scalar) {
+      error(core::SourceLocation(), "Vector lanes must be numbers");
+      return LLVMValue();
+    }
+    return LLVMValue(builder.CreateInsertElement(value, scalar, lane, "insert"),
+                     nullptr);
   }
 
-  if (!result) {
-    error(core::SourceLocation(), "Failed to generate unary operation");
+  // Horizontal reductions
+  llvm::Value *result = nullptr;
+  if (name == "sum") {
+    result = isFloat ? builder.CreateFAddReduce(
+                           llvm::ConstantFP::getNegativeZero(element), value)
+                     : builder.CreateAddReduce(value);
+  } else if (name == "product") {
+    result = isFloat ? builder.CreateFMulReduce(
+                           llvm::ConstantFP::get(element, 1.0), value)
+                     : builder.CreateMulReduce(value);
+  } else if (name == "min") {
+    result = isFloat ? builder.CreateFPMinReduce(value)
+                     : builder.CreateIntMinReduce(value, true);
+  } else if (name == "max") {
+    result = isFloat ? builder.CreateFPMaxReduce(value)
+                     : builder.CreateIntMaxReduce(value, true);
+  } else {
+    error(core::SourceLocation(), "Unknown vector operation: " + name);
     return LLVMValue();
   }
-
+  // Float lanes may be combined in any order, which is what makes a
+  // reduction a few shuffles instead of a chain of adds
+  if (isFloat && (name == "sum" || name == "product")) {
+    llvm::cast<llvm::Instruction>(result)->setHasAllowReassoc(true);
+  }
   return LLVMValue(result, nullptr);
 }
 
 LLVMValue
-LLVMCodeGen::visitIdentifierExpr(const nodes::IdentifierExpressionNode *node) {
-  std::string name = node->getName();
+LLVMCodeGen::emitContainerMethod(const nodes::CallExpressionNode *node,
+                                 const std::string &name,
+                                 const LLVMValue &container) {
+  auto &builder = context_.getBuilder();
+  llvm::Module &module = context_.getModule();
+  llvm::Value *handle = container.loadIfLValue(builder).getValue();
+  const ContainerType *type = typeBuilder_.getContainer(handle->getType());
+  bool isMap = type->name == "ConcurrentMap";
+  llvm::Type *elementType = type->elementTypes.back();
+  handle = builder.CreateBitCast(handle, builder.getInt8PtrTy(), "handle");
+
+  const auto &args = node->getArguments();
+  size_t expected = name == "pop" || name == "size"               ? 0
+                    : isMap && (name == "put" || name == "find") ? 2
+                                                                  : 1;
+  bool known = isMap ? name == "put" || name == "find" || name == "has" ||
+                           name == "remove" || name == "size"
+                     : name == "push" || name == "tryPush" ||
+                           name == "pop" || name == "tryPop";
+  if (!known || args.size() != expected) {
+    error(core::SourceLocation(), type->name + " has no method '" + name +
+                                      "' taking " +
+                                      std::to_string(args.size()) +
+                                      " arguments");
+    return LLVMValue();
+  }
+  auto operand = [&](size_t i, llvm::Type *operandType) -> llvm::Value * {
+    LLVMValue argument = visitExpr(args[i]);
+    if (!argument.isValid()) {
+      return nullptr;
+    }
+    return convertForStore(argument.loadIfLValue(builder).getValue(),
+                           operandType, "operand");
+  };
+  // An element's slot; tryPop and find leave their fallback in it
+  llvm::Value *slot = nullptr;
+  auto fillSlot = [&](size_t i) -> bool {
+    llvm::Value *element = operand(i, elementType);
+    if (!element) {
+      return false;
+    }
+    slot = createEntryAlloca(elementType, "element");
+    builder.CreateStore(element, slot);
+    return true;
+  };
+  auto slotBytes = [&]() {
+    return builder.CreateBitCast(slot, builder.getInt8PtrTy());
+  };
+
+  if (!isMap) {
+    std::string prefix =
+        type->name == "MpmcQueue" ? "tspp_mpmc_" : "tspp_spsc_";
+    if (name == "pop") {
+      slot = createEntryAlloca(elementType, "element");
+    } else if (!fillSlot(0)) {
+      return LLVMValue();
+    }
+    std::string function = name == "push"      ? "push"
+                           : name == "tryPush" ? "try_push"
+                           : name == "pop"     ? "pop"
+                                               : "try_pop";
+    llvm::Value *result = builder.CreateCall(
+        module.getFunction(prefix + function), {handle, slotBytes()});
+    if (name == "push") {
+      return LLVMValue();
+    }
+    if (name == "tryPush") {
+      return LLVMValue(
+          builder.CreateICmpNE(result, builder.getInt32(0), "pushed"),
+          nullptr);
+    }
+    return LLVMValue(builder.CreateLoad(elementType, slot, "popped"),
+                     nullptr);
+  }
 
-  // First, look for local variables
-  if (currentFunction_) {
-    LLVMValue var = currentFunction_->getVariable(name);
-    if (var.isValid()) {
-      return var;
+  if (name == "size") {
+    return LLVMValue(
+        builder.CreateTrunc(
+            builder.CreateCall(module.getFunction("tspp_map_size"), {handle}),
+            builder.getInt32Ty(), "size"),
+        nullptr);
+  }
+  // Keys are hashed as 64-bit integers
+  llvm::Value *key = operand(0, type->elementTypes[0]);
+  if (!key) {
+    return LLVMValue();
+  }
+  key = key->getType()->isPointerTy()
+            ? builder.CreatePtrToInt(key, builder.getInt64Ty(), "key")
+        : key->getType()->isIntegerTy(1)
+            ? builder.CreateZExt(key, builder.getInt64Ty(), "key")
+            : builder.CreateSExt(key, builder.getInt64Ty(), "key");
+  if (name == "put") {
+    if (!fillSlot(1)) {
+      return LLVMValue();
     }
+    builder.CreateCall(module.getFunction("tspp_map_put"),
+                       {handle, key, slotBytes()});
+    return LLVMValue();
+  }
+  if (name == "find") {
+    if (!fillSlot(1)) {
+      return LLVMValue();
+    }
+    builder.CreateCall(module.getFunction("tspp_map_get"),
+                       {handle, key, slotBytes()});
+    return LLVMValue(builder.CreateLoad(elementType, slot, "value"), nullptr);
   }
+  llvm::Value *found =
+      name == "has"
+          ? builder.CreateCall(
+                module.getFunction("tspp_map_get"),
+                {handle, key,
+                 llvm::ConstantPointerNull::get(builder.getInt8PtrTy())})
+          : builder.CreateCall(module.getFunction("tspp_map_remove"),
+                               {handle, key});
+  return LLVMValue(builder.CreateICmpNE(found, builder.getInt32(0), "found"),
+                   nullptr);
+}
 
-  // Then look for global variables
-  auto &module = context_.getModule();
-  if (llvm::GlobalVariable *globalVar = module.getGlobalVariable(name)) {
-    return LLVMValue(globalVar, nullptr, true); // Global variables are lvalues
+LLVMValue LLVMCodeGen::visitIndexExpr(const nodes::IndexExpressionNode *node) {
+  auto &builder = context_.getBuilder();
+  auto arrayType = node->getArray()->getResolvedType();
+  if (arrayType &&
+      arrayType->getKind() == visitors::ResolvedType::TypeKind::Vector) {
+    return emitVectorIndex(node);
+  }
+  ArrayElements elements;
+  llvm::Value *index = nullptr;
+  if (!emitCheckedIndex(node, elements, index)) {
+    return LLVMValue();
   }
 
-  // Look for functions
-  if (llvm::Function *func = module.getFunction(name)) {
-    return LLVMValue(func, nullptr);
+  // A #soa element has no address; it is gathered when used whole. A byte
+  // is read as an int.
+  if (!elements.columns.empty() ||
+      elements.getValueType() != elements.elementType) {
+    return LLVMValue(emitElementLoad(elements, index), nullptr);
   }
 
-  error(core::SourceLocation(), "Undefined identifier: " + name);
-  return LLVMValue();
+  // The check keeps the index in bounds, so the address is inbounds too
+  llvm::Value *element = builder.CreateInBoundsGEP(
+      elements.elementType, elements.data, index, "element");
+  return LLVMValue(element, nullptr, true);
+}
+
+LLVMValue
+LLVMCodeGen::emitVectorIndex(const nodes::IndexExpressionNode *node) {
+  auto &builder = context_.getBuilder();
+  LLVMValue vector = visitExpr(node->getArray());
+  LLVMValue indexValue = visitExpr(node->getIndex());
+  if (!vector.isValid() || !indexValue.isValid()) {
+    return LLVMValue();
+  }
+  llvm::Value *index = builder.CreateSExtOrTrunc(
+      indexValue.loadIfLValue(builder).getValue(), builder.getInt32Ty(),
+      "index");
+  auto vectorType = llvm::cast<llvm::FixedVectorType>(
+      vector.isLValue() ? vector.getStoredType()
+                        : vector.getValue()->getType());
+  emitBoundsCheck(index, builder.getInt32(vectorType->getNumElements()),
+                  node->getLocation());
+
+  // A lane of a variable or field has an address, so it can be assigned
+  if (vector.isLValue()) {
+    llvm::Value *lane = builder.CreateInBoundsGEP(
+        vectorType, vector.getValue(), {builder.getInt32(0), index}, "lane");
+    return LLVMValue(lane, nullptr, true);
+  }
+  return LLVMValue(
+      builder.CreateExtractElement(vector.getValue(), index, "lane"), nullptr);
 }
 
-LLVMValue LLVMCodeGen::visitCallExpr(const nodes::CallExpressionNode *node) {
+bool LLVMCodeGen::emitCheckedIndex(const nodes::IndexExpressionNode *node,
+                                   ArrayElements &elements,
+                                   llvm::Value *&index) {
   auto &builder = context_.getBuilder();
-  auto &module = context_.getModule();
+  LLVMValue array = visitExpr(node->getArray());
+  if (!array.isValid()) {
+    return false;
+  }
+  if (!getArrayElements(array, elements)) {
+    error(core::SourceLocation(), "Only arrays can be indexed");
+    return false;
+  }
 
-  // Get the function to call
-  std::string funcName;
-  if (auto identExpr = dynamic_cast<const nodes::IdentifierExpressionNode *>(
-          node->getCallee().get())) {
-    funcName = identExpr->getName();
-  } else {
-    error(core::SourceLocation(), "Complex function calls not yet supported");
-    return LLVMValue();
+  LLVMValue indexValue = visitExpr(node->getIndex());
+  if (!indexValue.isValid()) {
+    return false;
+  }
+  index = indexValue.loadIfLValue(builder).getValue();
+  if (!index->getType()->isIntegerTy()) {
+    error(core::SourceLocation(), "Array index must be an integer");
+    return false;
   }
+  index = builder.CreateSExtOrTrunc(index, builder.getInt32Ty(), "index");
+  emitBoundsCheck(index, elements.length, node->getLocation());
+  return true;
+}
 
-  llvm::Function *function = module.getFunction(funcName);
-  if (!function) {
-    error(core::SourceLocation(), "Function not found: " + funcName);
-    return LLVMValue();
+bool LLVMCodeGen::isStructOfArrays(const nodes::ExpressionNode *array) {
+  auto type = array->getResolvedType();
+  if (!type || type->getKind() != visitors::ResolvedType::TypeKind::Array ||
+      !type->getElementType() ||
+      type->getElementType()->getKind() !=
+          visitors::ResolvedType::TypeKind::Named) {
+    return false;
   }
+  llvm::Type *elementType =
+      typeBuilder_.getTypeByName(type->getElementType()->getName());
+  return elementType && typeBuilder_.getStructOfArraysElement(
+                            typeBuilder_.getDynamicArrayType(elementType));
+}
 
-  // Evaluate arguments
-  std::vector<llvm::Value *> args;
-  for (const auto &arg : node->getArguments()) {
-    LLVMValue argValue = visitExpr(arg.get());
-    if (!argValue.isValid()) {
-      error(core::SourceLocation(), "Invalid argument in function call");
-      return LLVMValue();
-    }
+LLVMValue
+LLVMCodeGen::emitColumnElement(const nodes::IndexExpressionNode *node,
+                               core::Symbol field, bool &found) {
+  auto &builder = context_.getBuilder();
+  found = false;
+  ArrayElements elements;
+  llvm::Value *index = nullptr;
+  if (!emitCheckedIndex(node, elements, index)) {
+    return LLVMValue();
+  }
+  auto structType = llvm::cast<llvm::StructType>(elements.elementType);
 
-    // Load the value if it's an lvalue
-    llvm::Value *loadedArg = argValue.loadIfLValue(builder).getValue();
-    args.push_back(loadedArg);
+  // Inherited fields are in the column of base objects
+  int column = typeBuilder_.getFieldIndex(structType, field);
+  found = column >= 0;
+  if (column < 0) {
+    column = 0;
   }
+  llvm::Type *fieldType = structType->getElementType(column);
+  return LLVMValue(builder.CreateInBoundsGEP(fieldType,
+                                             elements.columns[column], index,
+                                             found ? field.str() : "base"),
+                   nullptr, true);
+}
 
-  // Check argument count
-  if (args.size() != function->arg_size()) {
-    error(core::SourceLocation(), "Argument count mismatch for function " +
-                                      funcName + ": expected " +
-                                      std::to_string(function->arg_size()) +
-                                      ", got " + std::to_string(args.size()));
+LLVMValue LLVMCodeGen::emitColumnsStore(const nodes::IndexExpressionNode *node,
+                                        const nodes::ExpressionNode *value) {
+  auto &builder = context_.getBuilder();
+  ArrayElements elements;
+  llvm::Value *index = nullptr;
+  if (!emitCheckedIndex(node, elements, index)) {
+    return LLVMValue();
+  }
+  LLVMValue rhs = visitExpr(value);
+  if (!rhs.isValid()) {
+    return LLVMValue();
+  }
+  llvm::Value *loaded = rhs.loadIfLValue(builder).getValue();
+  llvm::Value *element =
+      convertForStore(loaded, elements.elementType, "element");
+  if (!element) {
     return LLVMValue();
   }
 
-  // Create the call
-  llvm::Value *result = builder.CreateCall(function, args, "call");
-  return LLVMValue(result, nullptr);
+  auto structType = llvm::cast<llvm::StructType>(elements.elementType);
+  for (unsigned i = 0; i < structType->getNumElements(); ++i) {
+    llvm::Type *fieldType = structType->getElementType(i);
+    builder.CreateAlignedStore(
+        builder.CreateExtractValue(element, i),
+        builder.CreateInBoundsGEP(fieldType, elements.columns[i], index),
+        typeBuilder_.getAlignment(fieldType));
+  }
+  freeCopiedObject(value, loaded, structType);
+  return LLVMValue(element, nullptr);
 }
 
-LLVMValue
-LLVMCodeGen::visitMemberExpr(const nodes::MemberExpressionNode *node) {
-  return LLVMValue();
+void LLVMCodeGen::emitBoundsCheck(llvm::Value *index, llvm::Value *length,
+                                  const core::SourceLocation &location) {
+  if (uncheckedFunction_) {
+    return;
+  }
+  auto constantIndex = llvm::dyn_cast<llvm::ConstantInt>(index);
+  auto constantLength = llvm::dyn_cast<llvm::ConstantInt>(length);
+  if (constantIndex && constantLength) {
+    if (constantIndex->getValue().uge(constantLength->getValue())) {
+      error(location,
+            "Index " + std::to_string(constantIndex->getSExtValue()) +
+                " is out of bounds for an array of length " +
+                std::to_string(constantLength->getZExtValue()));
+    }
+    return;
+  }
+
+  // A negative index wraps to a large unsigned one, so one compare covers
+  // both ends
+  auto &builder = context_.getBuilder();
+  auto &llvmContext = context_.getContext();
+  llvm::Function *function = builder.GetInsertBlock()->getParent();
+  llvm::BasicBlock *failBlock =
+      llvm::BasicBlock::Create(llvmContext, "bounds.fail", function);
+  llvm::BasicBlock *okBlock =
+      llvm::BasicBlock::Create(llvmContext, "bounds.ok", function);
+  llvm::Value *inBounds = builder.CreateICmpULT(index, length, "inbounds");
+  // Weighted like __builtin_expect, so the failure path is laid out last
+  llvm::MDBuilder mdBuilder(llvmContext);
+  builder.CreateCondBr(inBounds, okBlock, failBlock,
+                       mdBuilder.createBranchWeights(2000, 1));
+
+  builder.SetInsertPoint(failBlock);
+  builder.CreateCall(context_.getModule().getFunction("tspp_bounds_fail"),
+                     {index, length, getCheckSite(location)});
+  builder.CreateUnreachable();
+  builder.SetInsertPoint(okBlock);
 }
-LLVMValue LLVMCodeGen::visitIndexExpr(const nodes::IndexExpressionNode *node) {
-  return LLVMValue();
+
+llvm::Constant *
+LLVMCodeGen::getCheckSite(const core::SourceLocation &location) {
+  const std::string &file = location.getFilename();
+  std::string key = file + ":" + std::to_string(location.getLine()) + ":" +
+                    std::to_string(location.getColumn());
+  auto it = checkSites_.find(key);
+  if (it != checkSites_.end()) {
+    return it->second;
+  }
+
+  // The runtime's tspp_check_site
+  auto &llvmContext = context_.getContext();
+  llvm::Type *bytePtr = llvm::Type::getInt8PtrTy(llvmContext);
+  llvm::Type *int32 = llvm::Type::getInt32Ty(llvmContext);
+  auto *siteType = llvm::StructType::getTypeByName(llvmContext,
+                                                   "tspp_check_site");
+  if (!siteType) {
+    siteType = llvm::StructType::create(llvmContext, {bytePtr, int32, int32},
+                                        "tspp_check_site");
+  }
+  llvm::GlobalVariable *name =
+      context_.getStringConstant(file.empty() ? "<unknown>" : file);
+  auto *site = new llvm::GlobalVariable(
+      context_.getModule(), siteType, true, llvm::GlobalValue::PrivateLinkage,
+      llvm::ConstantStruct::get(
+          siteType, {llvm::ConstantExpr::getInBoundsGetElementPtr(
+                         name->getValueType(), name,
+                         llvm::ArrayRef<llvm::Constant *>{
+                             llvm::ConstantInt::get(int32, 0),
+                             llvm::ConstantInt::get(int32, 0)}),
+                     llvm::ConstantInt::get(int32, location.getLine()),
+                     llvm::ConstantInt::get(int32, location.getColumn())}),
+      "__tspp_check_site");
+  site->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+  llvm::Constant *address = llvm::ConstantExpr::getPointerCast(site, bytePtr);
+  checkSites_.emplace(std::move(key), address);
+  return address;
 }
 
 LLVMValue
 LLVMCodeGen::visitAssignmentExpr(const nodes::AssignmentExpressionNode *node) {
   auto &builder = context_.getBuilder();
 
+  // Compound operators would need the binary operation first
+  if (node->getExpressionType() != tokens::TokenType::EQUALS) {
+    error(core::SourceLocation(), "Compound assignment is not supported yet");
+    return LLVMValue();
+  }
+
+  // An element of a #soa array is stored a field per column
+  auto indexed = nodes::dyn_cast<nodes::IndexExpressionNode>(node->getTarget());
+  if (indexed && isStructOfArrays(indexed->getArray())) {
+    return emitColumnsStore(indexed, node->getValue());
+  }
+
   // Get the left-hand side (must be an lvalue)
-  LLVMValue lhs = visitExpr(node->getValue().get());
+  LLVMValue lhs = visitExpr(node->getTarget());
   if (!lhs.isValid() || !lhs.isLValue()) {
     error(core::SourceLocation(),
           "Left-hand side of assignment must be an lvalue");
     return LLVMValue();
   }
 
+  auto identifier =
+      nodes::dyn_cast<nodes::IdentifierExpressionNode>(node->getTarget());
+  const std::string targetName =
+      identifier ? identifier->getName() : "assignment target";
+
+  // Smart pointers take their new reference before dropping the old one,
+  // which keeps self-assignment safe
+  if (PointerOwnership ownership = lhs.getOwnership();
+      ownership != PointerOwnership::Raw) {
+    llvm::Value *owned = emitOwnedValue(node->getValue(), ownership,
+                                        lhs.getStoredType(), targetName);
+    if (!owned) {
+      return LLVMValue();
+    }
+    // Any thread may read a global, so its counts must be atomic
+    if (ownership != PointerOwnership::Unique &&
+        llvm::isa<llvm::GlobalVariable>(
+            lhs.getValue()->stripInBoundsConstantOffsets())) {
+      emitRuntimeCall("tspp_shared_publish", owned);
+    }
+    llvm::Value *previous = lhs.loadIfLValue(builder).getValue();
+    lhs.store(builder, owned);
+    emitRelease(ownership, previous);
+    return lhs;
+  }
+
+  if (emitNewInPlace(node->getValue(), lhs)) {
+    return lhs;
+  }
+
   // Get the right-hand side
-  LLVMValue rhs = visitExpr(node->getTarget().get());
+  LLVMValue rhs = visitExpr(node->getValue());
   if (!rhs.isValid()) {
     error(core::SourceLocation(), "Invalid right-hand side in assignment");
     return LLVMValue();
   }
+  if (emitAggregateCopy(rhs, lhs, true)) {
+    return lhs;
+  }
 
   // Load the right-hand side value
   llvm::Value *rhsValue = rhs.loadIfLValue(builder).getValue();
+  rhsValue = convertForStore(rhsValue, lhs.getStoredType(), targetName);
+  if (!rhsValue) {
+    return LLVMValue();
+  }
+
+  // A local array or string gives up the elements or bytes it owned
+  if (identifier && ownsBuffer(lhs.getStoredType())) {
+    emitBufferFree(lhs.getValue());
+  }
 
   // Store the value
-  builder.CreateStore(rhsValue, lhs.getValue());
+  lhs.store(builder, rhsValue);
+  freeCopiedObject(node->getValue(), rhs.getValue(), lhs.getStoredType());
 
   // Return the lvalue
   return lhs;
 }
 
-LLVMValue LLVMCodeGen::visitNewExpr(const nodes::NewExpressionNode *node) {
-  return LLVMValue();
+LLVMValue LLVMCodeGen::visitNewExpr(const nodes::NewExpressionNode *node,
+                                    PointerOwnership ownership) {
+  if (visitors::ResolvedType::getContainerArity(node->getClassName()) &&
+      !typeBuilder_.getTypeByName(node->getClassName())) {
+    return emitContainerNew(node);
+  }
+  llvm::StructType *structType = getNewType(node);
+  if (!structType) {
+    return LLVMValue();
+  }
+  bool shared = ownership == PointerOwnership::Shared;
+  const char *allocator = shared ? "tspp_shared_alloc" : "tspp_new";
+  llvm::Constant *site = nullptr;
+  if (instrumentation_ && options_.isAllocProfileEnabled()) {
+    allocator = shared ? "tspp_shared_alloc_at" : "tspp_new_at";
+    site = instrumentation_->allocationSite(
+        context_.getBuilder().GetInsertBlock()->getParent()->getName().str(),
+        node->getClassName(),
+        context_.getModule().getDataLayout().getTypeAllocSize(structType),
+        node->getLocation());
+  }
+  llvm::Value *object =
+      emitHeapAllocation(structType, node->getClassName(), allocator, site,
+                         shared ? getSharedType(structType) : nullptr);
+  emitObjectInit(structType, node->getClassName(), object);
+  return LLVMValue(object, nullptr);
+}
+
+LLVMValue
+LLVMCodeGen::emitContainerNew(const nodes::NewExpressionNode *node) {
+  auto &builder = context_.getBuilder();
+  const std::string &name = node->getClassName();
+  std::vector<llvm::Type *> elementTypes;
+  for (const auto &typeName : node->getTypeArguments()) {
+    elementTypes.push_back(
+        monomorphizer_.convertType(monomorphizer_.resolveTypeName(typeName)));
+  }
+  if (elementTypes.size() != visitors::ResolvedType::getContainerArity(name)) {
+    error(core::SourceLocation(),
+          "Wrong number of type arguments for " + name);
+    return LLVMValue();
+  }
+
+  // The runtime copies elements by size into cells aligned for them
+  const llvm::DataLayout &layout = context_.getModule().getDataLayout();
+  llvm::Type *stored = elementTypes.back();
+  llvm::Value *size = builder.getInt64(layout.getTypeAllocSize(stored));
+  llvm::Value *align = builder.getInt64(layout.getABITypeAlignment(stored));
+  llvm::Value *handle = nullptr;
+  if (name == "ConcurrentMap") {
+    handle = builder.CreateCall(
+        context_.getModule().getFunction("tspp_map_new"), {size, align});
+  } else {
+    if (node->getArguments().size() != 1) {
+      error(core::SourceLocation(), name + " takes a capacity");
+      return LLVMValue();
+    }
+    LLVMValue capacity = visitExpr(node->getArguments()[0]);
+    if (!capacity.isValid()) {
+      return LLVMValue();
+    }
+    llvm::Value *count = capacity.loadIfLValue(builder).getValue();
+    if (!count->getType()->isIntegerTy()) {
+      error(core::SourceLocation(), "Queue capacity must be an integer");
+      return LLVMValue();
+    }
+    handle = builder.CreateCall(
+        context_.getModule().getFunction(name == "MpmcQueue" ? "tspp_mpmc_new"
+                                                             : "tspp_spsc_new"),
+        {builder.CreateSExtOrTrunc(count, builder.getInt64Ty()), size, align});
+  }
+  return LLVMValue(
+      builder.CreateBitCast(handle,
+                            typeBuilder_.getContainerType(name, elementTypes),
+                            "container"),
+      nullptr);
+}
+
+llvm::StructType *
+LLVMCodeGen::getNewType(const nodes::NewExpressionNode *node) {
+  const std::string &className = node->getClassName();
+
+  llvm::StructType *structType = nullptr;
+  if (auto generic = monomorphizer_.lookupClass(className)) {
+    // new Box<int>() allocates the specialization for its type arguments
+    std::vector<LLVMMonomorphizer::TypePtr> typeArgs;
+    for (const auto &name : node->getTypeArguments()) {
+      typeArgs.push_back(monomorphizer_.resolveTypeName(name));
+    }
+    if (typeArgs.size() != generic->getGenericParams().size()) {
+      error(core::SourceLocation(),
+            "Wrong number of type arguments for class " + className);
+      return nullptr;
+    }
+    structType = monomorphizer_.getClass(generic, typeArgs);
+  } else {
+    structType = llvm::dyn_cast_or_null<llvm::StructType>(
+        typeBuilder_.getTypeByName(className));
+  }
+  if (!structType || !structType->isSized()) {
+    error(core::SourceLocation(), "Unknown class in new expression: " +
+                                      className);
+    return nullptr;
+  }
+  if (!node->getArguments().empty()) {
+    error(core::SourceLocation(),
+          "Constructor arguments are not supported yet");
+    return nullptr;
+  }
+  return structType;
+}
+
+void LLVMCodeGen::emitObjectInit(llvm::StructType *type,
+                                 const std::string &className,
+                                 llvm::Value *object) {
+  auto &builder = context_.getBuilder();
+
+  // Fields start zeroed, like those of a global object
+  builder.CreateAlignedStore(llvm::Constant::getNullValue(type), object,
+                             typeBuilder_.getAlignment(type));
+
+  // The vtable pointer identifies the class the object was created with
+  const auto *cls = classHierarchy_.getClass(className);
+  if (cls && cls->hasVptr) {
+    llvm::GlobalVariable *vtable =
+        context_.getModule().getNamedGlobal(className + ".vtable");
+    llvm::Constant *first = llvm::ConstantExpr::getInBoundsGetElementPtr(
+        vtable->getValueType(), vtable,
+        llvm::ArrayRef<llvm::Constant *>{builder.getInt32(0),
+                                         builder.getInt32(0)});
+    builder.CreateStore(
+        first, builder.CreateBitCast(
+                   object, first->getType()->getPointerTo(), "vptr"));
+  }
+}
+
+bool LLVMCodeGen::emitNewInPlace(const nodes::ExpressionNode *source,
+                                 const LLVMValue &target) {
+  auto node = nodes::dyn_cast<nodes::NewExpressionNode>(source);
+  if (!node || !node->getArguments().empty() ||
+      !target.getStoredType()->isStructTy()) {
+    return false;
+  }
+  llvm::StructType *structType = getNewType(node);
+  if (!structType) {
+    return true; // Reported
+  }
+  // A derived object stored as its base would be sliced; that copies
+  if (structType != target.getStoredType()) {
+    return false;
+  }
+  emitObjectInit(structType, node->getClassName(), target.getValue());
+  return true;
+}
+
+bool LLVMCodeGen::emitAggregateCopy(const LLVMValue &source,
+                                    const LLVMValue &target, bool replace) {
+  llvm::Type *type = target.getStoredType();
+  if (!type->isStructTy() || !source.isLValue() ||
+      source.getStoredType() != type) {
+    return false;
+  }
+  auto &builder = context_.getBuilder();
+  auto counted = getCountedFields(llvm::cast<llvm::StructType>(type));
+
+  // What the target held is released only once the copy holds its own
+  // references, as source and target may be the same value
+  std::vector<llvm::Value *> previous;
+  if (replace) {
+    for (auto [offset, ownership] : counted) {
+      previous.push_back(builder.CreateLoad(
+          builder.getInt8PtrTy(),
+          getCountedFieldAddress(target.getValue(), offset)));
+    }
+  }
+  const llvm::DataLayout &layout = context_.getModule().getDataLayout();
+  builder.CreateMemCpy(target.getValue(), target.getAlignment(),
+                       source.getValue(), source.getAlignment(),
+                       layout.getTypeStoreSize(type));
+  emitFieldRetains(llvm::cast<llvm::StructType>(type), target.getValue());
+  for (size_t i = 0; i < previous.size(); ++i) {
+    emitRelease(counted[i].second, previous[i]);
+  }
+  return true;
+}
+
+llvm::Value *LLVMCodeGen::getCountedFieldAddress(llvm::Value *object,
+                                                 uint64_t offset) {
+  auto &builder = context_.getBuilder();
+  llvm::Type *pointerType = builder.getInt8PtrTy();
+  llvm::Value *address = builder.CreateConstInBoundsGEP1_64(
+      builder.getInt8Ty(), builder.CreatePointerCast(object, pointerType),
+      offset);
+  return builder.CreatePointerCast(address, pointerType->getPointerTo());
+}
+
+void LLVMCodeGen::emitFieldRetains(llvm::StructType *structType,
+                                   llvm::Value *object) {
+  auto &builder = context_.getBuilder();
+  for (auto [offset, ownership] : getCountedFields(structType)) {
+    emitRuntimeCall(ownership == PointerOwnership::Shared ? "tspp_shared_retain"
+                                                          : "tspp_weak_retain",
+                    builder.CreateLoad(builder.getInt8PtrTy(),
+                                       getCountedFieldAddress(object, offset)));
+  }
+}
+
+void LLVMCodeGen::addFieldCleanups(llvm::StructType *structType,
+                                   llvm::Value *object) {
+  if (!currentFunction_) {
+    return;
+  }
+  for (auto [offset, ownership] : getCountedFields(structType)) {
+    LLVMValue field(getCountedFieldAddress(object, offset), nullptr, true);
+    field.setOwnership(ownership);
+    currentFunction_->addCleanup(field);
+  }
 }
+
 LLVMValue LLVMCodeGen::visitCastExpr(const nodes::CastExpressionNode *node) {
   return LLVMValue();
 }
-LLVMValue LLVMCodeGen::visitArrayLiteral(const nodes::ArrayLiteralNode *node) {
-  return LLVMValue();
+LLVMValue LLVMCodeGen::visitArrayLiteral(const nodes::ArrayLiteralNode *node,
+                                         llvm::Type *elementType) {
+  auto &builder = context_.getBuilder();
+  const auto &elements = node->getElements();
+
+  // Evaluate the elements first; without a declared type, the first one
+  // gives the element type
+  std::vector<llvm::Value *> values;
+  for (const auto &element : elements) {
+    LLVMValue value = visitExpr(element);
+    if (!value.isValid()) {
+      return LLVMValue();
+    }
+    values.push_back(value.loadIfLValue(builder).getValue());
+  }
+  if (!elementType) {
+    elementType = values.empty() ? builder.getInt32Ty() : values[0]->getType();
+  }
+  for (llvm::Value *&value : values) {
+    value = convertForStore(value, elementType, "element");
+    if (!value) {
+      return LLVMValue();
+    }
+  }
+
+  llvm::StructType *arrayValueType =
+      typeBuilder_.getDynamicArrayType(elementType);
+  llvm::Value *result = llvm::Constant::getNullValue(arrayValueType);
+  if (values.empty()) {
+    return LLVMValue(result, nullptr);
+  }
+
+  // A #soa array's columns are filled an element at a time
+  if (typeBuilder_.getStructOfArraysElement(arrayValueType)) {
+    if (!currentFunction_) {
+      error(core::SourceLocation(), "Objects can only be used in functions");
+      return LLVMValue();
+    }
+    llvm::AllocaInst *array =
+        currentFunction_->createEntryAlloca(arrayValueType, "array");
+    builder.CreateStore(result, array);
+    for (llvm::Value *value : values) {
+      emitColumnsPush(array, value);
+    }
+    return LLVMValue(builder.CreateLoad(arrayValueType, array), nullptr);
+  }
+
+  // The array owns its elements, so it can grow; the optimizer moves them
+  // to the stack when the array does not escape
+  auto arrayType = llvm::ArrayType::get(elementType, values.size());
+  llvm::Value *storage = emitHeapAllocation(arrayType, "elements");
+  if (llvm::Constant *initial = getConstantArray(arrayType, values)) {
+    // Constant elements are copied from read-only data in one go
+    auto *constant = new llvm::GlobalVariable(
+        context_.getModule(), arrayType, true,
+        llvm::GlobalValue::PrivateLinkage, initial, "array");
+    constant->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+    llvm::Align alignment = typeBuilder_.getAlignment(arrayType);
+    constant->setAlignment(alignment);
+    builder.CreateMemCpy(
+        storage, alignment, constant, alignment,
+        context_.getModule().getDataLayout().getTypeAllocSize(arrayType));
+  } else {
+    for (size_t i = 0; i < values.size(); ++i) {
+      builder.CreateAlignedStore(
+          values[i],
+          builder.CreateConstInBoundsGEP2_32(arrayType, storage, 0, i),
+          typeBuilder_.getAlignment(elementType));
+    }
+  }
+
+  result = builder.CreateInsertValue(
+      result, builder.CreateConstInBoundsGEP2_32(arrayType, storage, 0, 0), 0);
+  result = builder.CreateInsertValue(result, builder.getInt64(values.size()), 1);
+  result = builder.CreateInsertValue(result, builder.getInt64(values.size()), 2,
+                                     "array");
+  return LLVMValue(result, nullptr);
+}
+
+llvm::Constant *
+LLVMCodeGen::getConstantArray(llvm::ArrayType *arrayType,
+                              const std::vector<llvm::Value *> &values) {
+  std::vector<llvm::Constant *> elements;
+  for (llvm::Value *value : values) {
+    auto constant = llvm::dyn_cast<llvm::Constant>(value);
+    if (!constant) {
+      return nullptr;
+    }
+    elements.push_back(constant);
+  }
+  // Elements past the given ones are zero
+  elements.resize(arrayType->getNumElements(),
+                  llvm::Constant::getNullValue(arrayType->getElementType()));
+  return llvm::ConstantArray::get(arrayType, elements);
+}
+
+bool LLVMCodeGen::emitArrayElements(const nodes::ArrayLiteralNode *node,
+                                    llvm::Value *storage,
+                                    llvm::ArrayType *arrayType) {
+  auto &builder = context_.getBuilder();
+  const auto &elements = node->getElements();
+  if (elements.size() > arrayType->getNumElements()) {
+    error(core::SourceLocation(),
+          "Array literal has " + std::to_string(elements.size()) +
+              " elements, but the array holds " +
+              std::to_string(arrayType->getNumElements()));
+    return false;
+  }
+
+  llvm::Type *elementType = arrayType->getElementType();
+  std::vector<llvm::Value *> values;
+  for (const auto &element : elements) {
+    LLVMValue value = visitExpr(element);
+    if (!value.isValid()) {
+      return false;
+    }
+    llvm::Value *converted = convertForStore(
+        value.loadIfLValue(builder).getValue(), elementType, "element");
+    if (!converted) {
+      return false;
+    }
+    values.push_back(converted);
+  }
+
+  // Constant elements are stored as one constant; elements without an
+  // initializer are zero
+  llvm::Align alignment = typeBuilder_.getAlignment(arrayType);
+  if (llvm::Constant *initial = getConstantArray(arrayType, values)) {
+    builder.CreateAlignedStore(initial, storage, alignment);
+    return true;
+  }
+  builder.CreateAlignedStore(llvm::Constant::getNullValue(arrayType), storage,
+                             alignment);
+  for (size_t i = 0; i < values.size(); ++i) {
+    builder.CreateAlignedStore(
+        values[i], builder.CreateConstInBoundsGEP2_32(arrayType, storage, 0, i),
+        typeBuilder_.getAlignment(elementType));
+  }
+  return true;
 }
 
 } // namespace codegen
\ No newline at end of file
@@ -1,28 +1,49 @@
 #pragma once
 #include "core/diagnostics/error_reporter.h"
+#include "llvm_c_abi.h"
+#include "llvm_class_hierarchy.h"
+#include "llvm_closure_analysis.h"
 #include "llvm_context.h"
+#include "llvm_debug_info.h"
 #include "llvm_function.h"
+#include "llvm_instrumentation.h"
+#include "llvm_jit.h"
+#include "llvm_monomorphizer.h"
 #include "llvm_optimizer.h"
+#include "llvm_target.h"
 #include "llvm_type_builder.h"
 #include "llvm_value.h"
 #include "parser/ast.h"
+#include "parser/body_stream.h"
 #include "parser/nodes/declaration_nodes.h"
 #include "parser/nodes/expression_nodes.h"
 #include "parser/nodes/statement_nodes.h"
 #include "parser/nodes/type_nodes.h"
-#include "llvm/ExecutionEngine/ExecutionEngine.h"
-#include "llvm/ExecutionEngine/GenericValue.h"
-#include "llvm/ExecutionEngine/MCJIT.h"
-#include "llvm/Support/TargetSelect.h"
-#include "llvm/Transforms/Utils/Cloning.h"
+#include "parser/visitors/comptime_evaluator/comptime_evaluator.h"
+#include "parser/visitors/type_check_visitor/module_interface.h"
+#include <algorithm>
 #include <memory>
 #include <stack>
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 namespace codegen {
 
+/**
+ * @brief The share of a program that one code generator emits
+ *
+ * Functions outside the partition are only declared, so partitions can be
+ * generated independently and linked afterwards.
+ */
+struct CodeGenPartition {
+  std::unordered_set<const nodes::FunctionDeclNode *>
+      definitions;        ///< Functions whose bodies this partition emits
+  bool ownsEntry = false; ///< Defines globals, top-level code and main
+};
+
 /**
  * @class LLVMCodeGen
  * @brief Main LLVM code generator for TS++
@@ -42,6 +63,56 @@ public:
   LLVMCodeGen(core::ErrorReporter &errorReporter,
               const std::string &moduleName = "tspp_module");
 
+  /**
+   * @brief Applies code generation options
+   *
+   * Selects the target machine and the optimization pipeline that
+   * generateCode() runs.
+   *
+   * @param options The options to use
+   */
+  void setOptions(const CodeGenOptions &options);
+
+  /**
+   * @brief Restricts generateCode() to one partition of the program
+   * @param partition The partition, or nullptr to generate everything; it
+   *        must outlive code generation
+   */
+  void setPartition(const CodeGenPartition *partition) {
+    partition_ = partition;
+  }
+
+  /**
+   * @brief Gets the active code generation options
+   */
+  const CodeGenOptions &getOptions() const { return options_; }
+
+  /**
+   * @brief Makes the functions of a separately compiled program callable
+   *
+   * A function the program calls but does not define is declared from the
+   * interface on first use, and the linker resolves it.
+   *
+   * @param interface The imported interface
+   */
+  void addImport(std::shared_ptr<const visitors::ModuleInterface> interface) {
+    imports_.push_back(std::move(interface));
+  }
+
+  /**
+   * @brief Takes the bodies of streamed functions from a stream
+   *
+   * Each is loaded just before it is generated and released right after,
+   * and #comptime initializers load those they call.
+   *
+   * @param stream The stream, or nullptr if every body is parsed; it must
+   *        outlive code generation
+   */
+  void setBodyStream(parser::BodyStream *stream) {
+    bodyStream_ = stream;
+    comptime_.setBodyStream(stream);
+  }
+
   /**
    * @brief Generates code for an AST
    * @param ast The TS++ AST
@@ -57,10 +128,15 @@ public:
 
   /**
    * @brief Writes the generated code to a file
+   *
+   * The output format option selects textual IR, bitcode, assembly, an
+   * object file or a linked executable. Everything but the final link step
+   * runs in-process through the target machine.
+   *
    * @param filename Path to the output file
    * @return True if the operation was successful
    */
-  bool writeToFile(const std::string &filename) const;
+  bool writeToFile(const std::string &filename);
 
   /**
    * @brief Gets the LLVM context
@@ -69,12 +145,57 @@ public:
   LLVMContext &getContext() { return context_; }
 
   /**
-   * @brief Executes the generated code using LLVM JIT
+   * @brief Gets the target machine selected by the options
+   * @return Reference to the target
+   */
+  LLVMTarget &getTarget() { return target_; }
+
+  /**
+   * @brief Executes the generated code using the ORC JIT
+   *
+   * The current module is moved into a JIT session that is kept for the
+   * lifetime of the generator, and is replaced by an empty module. Functions
+   * are compiled lazily when main first reaches them.
+   *
    * @return True if execution was successful
    */
   bool executeCode();
 
+  /**
+   * @brief Moves the current module into the JIT session and runs its
+   * initializers, without running main
+   *
+   * Does nothing if the module was already handed over.
+   *
+   * @return True if the module was loaded
+   */
+  bool loadForExecution();
+
+  /**
+   * @brief Gets the address of a function loaded by loadForExecution()
+   * @param name Name of the function
+   * @return The address, compiling the function if needed, or 0
+   */
+  uint64_t getExecutionAddress(const std::string &name);
+
+  /**
+   * @brief Generates and runs one increment of a long-lived program
+   *
+   * Used by the REPL. The AST becomes a new, small module in the JIT session
+   * that earlier increments live in, so their functions and globals are
+   * called through the JIT rather than regenerated. Top-level statements run
+   * in a uniquely named entry function. On failure the partial module is
+   * discarded and earlier definitions are unaffected.
+   *
+   * @param ast The increment to add
+   * @return True if the increment was compiled and run
+   */
+  bool executeIncremental(const parser::AST &ast);
+
 private:
+  struct ClosureEnv;
+  struct EnclosingFunction;
+
   // External function declarations
   /**
    * @brief Declares external functions needed by generated code
@@ -98,6 +219,26 @@ private:
    */
   void declareTypes(const parser::AST &ast);
 
+  /**
+   * @brief Lays out a class after its base
+   *
+   * The base object comes first, or else the vtable pointer if the class's
+   * hierarchy has one, followed by the class's own fields.
+   *
+   * @param cls The class
+   */
+  void declareClassType(const LLVMClassHierarchy::ClassInfo *cls);
+
+  /**
+   * @brief Declares every method and builds the vtables
+   *
+   * Methods are functions named Class.method that take the object as
+   * their first parameter, `this`. Vtables are constant, so once the
+   * optimizer knows which vtable an object has, calls through it fold to
+   * direct calls.
+   */
+  void declareMethods();
+
   // Declaration visitors
   void visitGlobalDecl(const nodes::NodePtr &node);
 
@@ -116,6 +257,257 @@ private:
    */
   bool visitFunctionDecl(const nodes::FunctionDeclNode *node);
 
+  /**
+   * @brief Generates the body of a declared function
+   *
+   * A streamed body is loaded for this and released after.
+   *
+   * @param node The function declaration node
+   * @param function The function to fill in
+   */
+  void emitFunctionBody(const nodes::FunctionDeclNode *node,
+                        llvm::Function *function);
+
+  /**
+   * @brief Checks whether a function has a body to generate, parsed or
+   * left to the body stream
+   */
+  bool hasBodyToEmit(const nodes::FunctionDeclNode *node) const {
+    return node->getBody() || (bodyStream_ && bodyStream_->streams(node));
+  }
+
+  /**
+   * @brief Checks whether a function is called from outside the program,
+   * as main and #bench functions are, so it is always kept and exported
+   */
+  static bool isEntryPoint(const nodes::FunctionDeclNode *node) {
+    const auto &modifiers = node->getModifiers();
+    return node->getName() == "main" ||
+           std::find(modifiers.begin(), modifiers.end(),
+                     tokens::TokenType::BENCH) != modifiers.end();
+  }
+
+  /**
+   * @brief Generates the body of a function or method
+   * @param function The function to fill in
+   * @param params The declared parameters
+   * @param returnType The declared return type, or nullptr
+   * @param modifiers The function's modifiers
+   * @param target The #target("...") string, empty if none
+   * @param body The body
+   * @param isMethod The first argument is `this`
+   * @param isAsync The function is a coroutine, whose ramp returns its
+   *        handle
+   * @param env The captures of a closure, whose first argument is its
+   *        environment; null for other functions
+   */
+  void emitBody(llvm::Function *function,
+                const std::vector<nodes::ParamPtr> &params,
+                const nodes::TypeNode *returnType,
+                const std::vector<tokens::TokenType> &modifiers,
+                const std::string &target, const nodes::BlockNode *body,
+                bool isMethod, bool isAsync = false,
+                const ClosureEnv *env = nullptr);
+
+  /**
+   * @brief Starts the coroutine of an async function in its entry block
+   *
+   * The frame holds a promise, a tspp_task followed by the result, and is
+   * allocated with tspp_alloc unless CoroElide finds that the caller can
+   * hold it. Leaves the builder where the body goes.
+   *
+   * @param resultType Type of the function's result, void for none
+   */
+  void beginCoroutine(llvm::Type *resultType);
+
+  /**
+   * @brief Emits the final suspend point of the current coroutine, where
+   * returns branch, and the blocks that free its frame and return
+   */
+  void endCoroutine();
+
+  /**
+   * @brief Suspends the current coroutine; the builder continues where it
+   * resumes
+   */
+  void emitSuspend();
+
+  /**
+   * @brief Gets the promise type of async functions with a result type
+   */
+  llvm::StructType *getPromiseType(llvm::Type *resultType);
+
+  /**
+   * @brief Gets the promise of a coroutine from its handle
+   */
+  llvm::Value *getPromise(llvm::Value *handle, llvm::Type *resultType);
+
+  /**
+   * @brief Turns a function's modifiers into LLVM function attributes
+   *
+   * #inline makes the function alwaysinline, with inlinehint for callers
+   * the always-inliner cannot handle. #cold marks it cold and noinline,
+   * which keeps it off its callers' hot paths and overrides #inline.
+   *
+   * @param function The function being defined
+   * @param modifiers The function's modifiers
+   * @param target The #target("...") string, empty if none
+   */
+  void applyFunctionAttributes(llvm::Function *function,
+                               const std::vector<tokens::TokenType> &modifiers,
+                               const std::string &target);
+
+  /**
+   * @brief Compiles a function for the instruction sets #target names
+   *
+   * The string lists comma-separated entries, as GCC's target attribute
+   * does: "avx2" or "+avx2" enables an instruction set, "no-avx2" disables
+   * it and "arch=haswell" selects the CPU. An architecture name such as
+   * "x86" only asserts that the function is compiled for that architecture.
+   * The result becomes the function's target-cpu and target-features, so
+   * one module can hold versions of a function for several ISAs.
+   *
+   * @param function The function being defined
+   * @param target The #target("...") string
+   */
+  void applyTarget(llvm::Function *function, const std::string &target);
+
+  /**
+   * @brief A #target string split into the CPU and feature changes
+   */
+  struct TargetSpec {
+    std::string cpu;                   ///< arch= CPU, empty for the module's
+    std::vector<std::string> features; ///< "+name" or "-name" entries
+  };
+
+  /**
+   * @brief Parses a #target string, reporting unknown CPUs and mismatched
+   * architectures
+   * @param functionName Function the string belongs to, for diagnostics
+   * @param target The #target("...") string
+   * @return The CPU and feature changes the string asks for
+   */
+  TargetSpec parseTarget(const std::string &functionName,
+                         const std::string &target);
+
+  /**
+   * @brief Records top-level functions declared once per #target
+   *
+   * Several declarations of one name, at most one of them without
+   * #target, form a multiversioned function.
+   *
+   * @param ast The AST being generated
+   */
+  void collectFunctionVersions(const parser::AST &ast);
+
+  /**
+   * @brief Declares the top-level functions before any body is generated
+   *
+   * A function can then call functions defined after it, which mutually
+   * recursive functions need. Multiversioned functions and redeclarations
+   * are left to visitFunctionDecl.
+   *
+   * @param ast The AST being generated
+   */
+  void declareFunctions(const parser::AST &ast);
+
+  /**
+   * @brief Generates a multiversioned function
+   *
+   * Each version becomes name.features, compiled for its instruction sets,
+   * and the default becomes name.default. Calls go to name, which jumps
+   * through a pointer that starts out at a resolver. The first call runs
+   * the resolver, which asks the runtime which versions the host supports,
+   * tries them from the largest instruction set down and stores the choice,
+   * so the host is only queried once.
+   *
+   * @param versions The declarations, in source order
+   * @return True if successful
+   */
+  bool emitFunctionVersions(
+      const std::vector<const nodes::FunctionDeclNode *> &versions);
+
+  /**
+   * @brief Creates the LLVM function for a declaration
+   * @param node The function declaration node
+   * @param name Name of the LLVM function
+   * @return The function, without a body
+   */
+  llvm::Function *createFunction(const nodes::FunctionDeclNode *node,
+                                 const std::string &name);
+
+  /**
+   * @brief Gets the type a parameter is passed as; a ref parameter is
+   * passed as the address of the variable it names
+   */
+  llvm::Type *getParameterType(const nodes::ParameterNode *param);
+
+  /**
+   * @brief Tells LLVM what a function's pointer parameters may alias
+   *
+   * A ref parameter is noalias and nocapture, and dereferenceable and
+   * aligned for its type: the checker rejects calls in which another
+   * argument reaches the same storage, and the callee has no way to keep
+   * the address. #noalias makes every pointer parameter noalias, which
+   * promises, as C's restrict does, that nothing one of them reaches is
+   * reached through another.
+   *
+   * @param function The function, whose parameters end with params
+   * @param params The declared parameters
+   * @param modifiers The function's modifiers
+   */
+  void applyParameterAttributes(llvm::Function *function,
+                                const std::vector<nodes::ParamPtr> &params,
+                                const std::vector<tokens::TokenType> &modifiers);
+
+  /**
+   * @brief Whether a call passes an argument to a ref parameter, which
+   * takes its address instead of its value
+   */
+  bool isRefArgument(const nodes::CallExpressionNode *node, size_t index) const;
+
+  /**
+   * @brief Declares an extern "C" function, lowered to the target's C ABI
+   *
+   * The declaration is a plain external one, or the module's own when the
+   * runtime already declared the name with the same lowered type, and is
+   * nounwind, so calls are direct and never invoke.
+   *
+   * @param node The declaration, which has no body
+   * @return The function, or nullptr after an error
+   */
+  llvm::Function *declareCFunction(const nodes::FunctionDeclNode *node);
+
+  /**
+   * @brief Generates the bodies of all queued generic specializations
+   *
+   * Runs after the rest of the module, since any function may request a
+   * specialization. Bodies that call further specializations extend the
+   * queue.
+   *
+   * @return True if successful
+   */
+  bool emitSpecializations();
+
+  /**
+   * @brief Generates the deferred bodies of a whole program's functions
+   *
+   * Only functions something already generated calls or takes the address
+   * of get a body; specializations they request are generated along the
+   * way. The others are removed, so code main never reaches costs no time.
+   *
+   * @return True if successful
+   */
+  bool emitReachableBodies();
+
+  /**
+   * @brief Gets the linkage of a function or global variable definition
+   * @param name Name of the definition
+   * @return Internal in a whole program, except for main; else external
+   */
+  llvm::GlobalValue::LinkageTypes
+  getDefinitionLinkage(const std::string &name) const;
+
   /**
    * @brief Processes a global variable declaration
    * @param node The variable declaration node
@@ -123,8 +515,51 @@ private:
    */
   bool visitGlobalVarDecl(const nodes::VarDeclNode *node);
 
+  /**
+   * @brief Evaluates a #comptime constant and builds its initializer
+   * @param node The declaration, a global const
+   * @param type The global's type, or null to take the value's
+   * @return The initializer, or null after reporting why there is none
+   */
+  llvm::Constant *emitComptimeInitializer(const nodes::VarDeclNode *node,
+                                          llvm::Type *type);
+
+  /**
+   * @brief Converts an evaluated value to a constant of an LLVM type
+   * @param type The type, or null for the value's own
+   * @return The constant, or null if the value does not fit the type
+   */
+  llvm::Constant *
+  getComptimeConstant(const visitors::ComptimeEvaluator::Value &value,
+                      llvm::Type *type);
+
+  /**
+   * @brief Processes a #static local variable
+   *
+   * The variable is an internal global named after its function. A
+   * constant initializer becomes the global's initializer; any other runs
+   * once, on the first pass through the declaration.
+   *
+   * @param node The variable declaration node
+   * @param varType The variable's storage type
+   * @return The variable as an lvalue
+   */
+  LLVMValue visitStaticVarDecl(const nodes::VarDeclNode *node,
+                               llvm::Type *varType);
+
+  /**
+   * @brief Generates the bodies of a class's methods
+   * @param node The class declaration node
+   */
   void visitClassDecl(const nodes::ClassDeclNode *node);
   void visitNamespaceDecl(const nodes::NamespaceDeclNode *node);
+
+  /**
+   * @brief Records an enum's members, whose values the type checker folded
+   *
+   * The enum's name becomes an alias of int, and each member expression
+   * Enum.Member is emitted as a constant.
+   */
   void visitEnumDecl(const nodes::EnumDeclNode *node);
   void visitInterfaceDecl(const nodes::InterfaceDeclNode *node);
   LLVMValue visitParameter(const nodes::ParameterNode *node);
@@ -161,8 +596,58 @@ private:
   LLVMValue visitReturnStmt(const nodes::ReturnStmtNode *node);
   LLVMValue visitBreakStmt(const nodes::BreakStmtNode *node);
   LLVMValue visitContinueStmt(const nodes::ContinueStmtNode *node);
+
+  /**
+   * @brief Processes a switch statement
+   *
+   * Consecutive cases with constant integer labels, enum members included,
+   * share one LLVM switch instruction, which the backend lowers to a jump
+   * table or a binary search. Other labels are compared in source order
+   * between those runs. Case bodies fall through to the next one.
+   *
+   * Over strings, a run of literal labels is dispatched by
+   * emitStringDispatch() instead.
+   */
   LLVMValue visitSwitchStmt(const nodes::SwitchStmtNode *node);
+
+  /**
+   * @brief Selects among string literal labels without comparing them in
+   * turn
+   *
+   * A switch on the length leads to the labels of that length. A lone
+   * label is confirmed with memcmp; several are told apart by a
+   * StringSwitchPlan, whose slot is switched on before the one memcmp.
+   * The length also says whether the bytes are inline or behind the data
+   * pointer, so no runtime call is made.
+   *
+   * @param slot Address of the switch's string
+   * @param labels Distinct label texts with the body each one selects
+   * @param miss Where a string matching no label goes
+   */
+  void emitStringDispatch(
+      llvm::Value *slot,
+      const std::vector<std::pair<std::string, llvm::BasicBlock *>> &labels,
+      llvm::BasicBlock *miss);
+
+  /**
+   * @brief Processes a try statement
+   *
+   * Calls in the try block are invokes whose landing pads compare the
+   * exception's selector with the catch clauses' types. Nothing is set up
+   * on entry, so the block runs as fast as it would outside the try. The
+   * finally block is emitted on each way out: falling through, return,
+   * break or continue, and unwinding.
+   *
+   * @param node The try statement node
+   * @return An invalid value
+   */
   LLVMValue visitTryStmt(const nodes::TryStmtNode *node);
+
+  /**
+   * @brief Throws a copy of a class object or primitive value
+   * @param node The throw statement node
+   * @return An invalid value
+   */
   LLVMValue visitThrowStmt(const nodes::ThrowStmtNode *node);
   LLVMValue visitDeclStmt(const nodes::DeclarationStmtNode *node);
 
@@ -173,6 +658,16 @@ private:
    */
   bool visitAssemblyStatement(const nodes::AssemblyStmtNode *node);
 
+  /**
+   * @brief Emits an assembly statement with GCC-style operands as a call
+   * to llvm::InlineAsm, binding its operands to tspp values
+   * @param node The assembly statement node
+   * @param code Its template, escapes resolved
+   * @return True if successful
+   */
+  bool emitExtendedAssembly(const nodes::AssemblyStmtNode *node,
+                            const std::string &code);
+
   /**
    * @brief Processes a top-level statement
    * @param node The statement node
@@ -183,11 +678,23 @@ private:
   // Expression visitors
   /**
    * @brief Processes any expression node
+   *
+   * A value whose visitor gives it no TS++ type takes the one the type
+   * checker recorded on the node, if any. A node the constant folder
+   * computed a value for is that value, as an immediate.
+   *
    * @param node The expression node
    * @return The generated LLVM value
    */
   LLVMValue visitExpr(const nodes::ExpressionNode *node);
 
+  /**
+   * @brief Dispatches an expression node to the visitor of its kind
+   * @param node The expression node
+   * @return The generated LLVM value
+   */
+  LLVMValue visitExprKind(const nodes::ExpressionNode *node);
+
   /**
    * @brief Processes a binary expression with proper type handling
    * @param node The binary expression node
@@ -196,107 +703,774 @@ private:
   LLVMValue visitBinaryExpr(const nodes::BinaryExpressionNode *node);
 
   /**
-   * @brief Processes a unary expression
-   * @param node The unary expression node
-   * @return The generated LLVM value
+   * @brief Applies a binary operator to two evaluated operands
+   * @param op The operator
+   * @param leftVal The left operand, loaded
+   * @param rightVal The right operand, loaded
+   * @return The result, or nullptr after reporting an error
    */
-  LLVMValue visitUnaryExpr(const nodes::UnaryExpressionNode *node);
+  llvm::Value *emitBinaryOperation(tokens::TokenType op, llvm::Value *leftVal,
+                                   llvm::Value *rightVal);
 
   /**
-   * @brief Processes a literal expression
-   * @param node The literal expression node
-   * @return The generated LLVM value
+   * @brief Applies a binary operator lane by lane
+   *
+   * A scalar operand is splatted to the other's type first. Comparisons
+   * give an int vector with -1 in each lane where they hold and 0 elsewhere.
+   *
+   * @return The result, or nullptr after reporting an error
    */
-  LLVMValue visitLiteralExpr(const nodes::LiteralExpressionNode *node);
+  llvm::Value *emitVectorOperation(tokens::TokenType op, llvm::Value *leftVal,
+                                   llvm::Value *rightVal);
 
   /**
-   * @brief Processes an identifier expression
-   * @param node The identifier expression node
-   * @return The generated LLVM value
+   * @brief Builds a vector from a value for each lane, or splats one value
    */
-  LLVMValue visitIdentifierExpr(const nodes::IdentifierExpressionNode *node);
+  LLVMValue emitVectorConstruction(const nodes::CallExpressionNode *node);
 
   /**
-   * @brief Processes a function call expression
-   * @param node The call expression node
-   * @return The generated LLVM value
+   * @brief Evaluates the operands of a chain of + from left to right
+   *
+   * Operands that are not themselves a + are evaluated as a whole, so
+   * a + b * c has two operands.
+   *
+   * @return False if an operand is invalid
    */
-  LLVMValue visitCallExpr(const nodes::CallExpressionNode *node);
-
-  LLVMValue visitMemberExpr(const nodes::MemberExpressionNode *node);
-  LLVMValue visitIndexExpr(const nodes::IndexExpressionNode *node);
+  bool collectSumOperands(const nodes::ExpressionNode *node,
+                          std::vector<llvm::Value *> &operands);
 
   /**
-   * @brief Processes an assignment expression
-   * @param node The assignment expression node
-   * @return The generated LLVM value
+   * @brief Adds up evaluated operands in the shape of the chain of +
+   * @param node The chain
+   * @param operands Its operands, from collectSumOperands
+   * @param next Index of the next unused operand
+   * @return The sum, or nullptr after reporting an error
    */
-  LLVMValue visitAssignmentExpr(const nodes::AssignmentExpressionNode *node);
-
-  LLVMValue visitNewExpr(const nodes::NewExpressionNode *node);
-  LLVMValue visitCastExpr(const nodes::CastExpressionNode *node);
-  LLVMValue visitArrayLiteral(const nodes::ArrayLiteralNode *node);
+  llvm::Value *emitSum(const nodes::ExpressionNode *node,
+                       const std::vector<llvm::Value *> &operands,
+                       size_t &next);
 
-  // Main function creation
   /**
-   * @brief Creates a default main function if none exists
-   * @return Pointer to the created main function, or nullptr on failure
+   * @brief Joins strings with one runtime call and at most one allocation
+   *
+   * Adjacent literals are joined at compile time.
+   *
+   * @param operands The strings, in order
+   * @return The concatenation
    */
-  llvm::Function *createDefaultMainFunction();
+  llvm::Value *emitConcatenation(const std::vector<llvm::Value *> &operands);
 
-  // Helper methods
   /**
-   * @brief Reports an error with location information
-   * @param location Source location of the error
-   * @param message Error message
+   * @brief Gets the length from which a string's bytes are out of line
+   *
+   * The runtime's TSPP_STRING_SMALL depends on the pointer width, so this
+   * follows the target rather than the host the compiler runs on.
    */
-  void error(const core::SourceLocation &location, const std::string &message);
+  uint64_t getStringSmallLimit();
 
   /**
-   * @brief Reports a warning with location information
-   * @param location Source location of the warning
-   * @param message Warning message
+   * @brief Creates the string value of a literal
+   *
+   * Short literals are constants holding their bytes; longer ones point at
+   * a string constant shared by every equal literal in the module.
+   *
+   * @param text The literal's bytes
+   * @return A constant %string
    */
-  void warning(const core::SourceLocation &location,
-               const std::string &message);
+  llvm::Constant *getStringLiteral(const std::string &text);
 
-  // String parsing helpers for assembly statements
   /**
-   * @brief Parses escape sequences in string literals
-   * @param input The input string with escape sequences
-   * @return The parsed string with escape sequences resolved
+   * @brief Recovers the text of a value made by getStringLiteral
+   * @return False if the value is not a string literal
    */
-  std::string parseStringLiteral(const std::string &input);
+  bool getStringLiteralText(llvm::Value *value, std::string &text);
 
   /**
-   * @brief Checks if assembly code is a simple printf call
-   * @param asmCode The assembly code to check
-   * @return True if it's a simple printf call
+   * @brief Creates a stack slot at the top of the entry block of the
+   * function being emitted, where mem2reg and SROA can promote it
    */
-  bool isSimplePrintfCall(const std::string &asmCode);
+  llvm::AllocaInst *createEntryAlloca(llvm::Type *type,
+                                      const std::string &name);
 
   /**
-   * @brief Extracts the string from a printf call
-   * @param asmCode The assembly code containing the printf call
-   * @return The extracted string
+   * @brief Stores a value in a new entry block slot, for runtime calls
+   * that take it by address
    */
-  std::string extractPrintfString(const std::string &asmCode);
+  llvm::Value *spillToStack(llvm::Value *value, const std::string &name);
+
+  /**
+   * @brief Processes a unary expression
+   * @param node The unary expression node
+   * @return The generated LLVM value
+   */
+  LLVMValue visitUnaryExpr(const nodes::UnaryExpressionNode *node);
+
+  /**
+   * @brief Processes a literal expression
+   * @param node The literal expression node
+   * @return The generated LLVM value
+   */
+  LLVMValue visitLiteralExpr(const nodes::LiteralExpressionNode *node);
+
+  /**
+   * @brief Processes an identifier expression
+   * @param node The identifier expression node
+   * @return The generated LLVM value
+   */
+  LLVMValue visitIdentifierExpr(const nodes::IdentifierExpressionNode *node);
+
+  /**
+   * @brief Processes a function call expression
+   * @param node The call expression node
+   * @param awaited The call is the operand of await
+   * @return The generated LLVM value
+   */
+  LLVMValue visitCallExpr(const nodes::CallExpressionNode *node,
+                          bool awaited = false);
+
+  /**
+   * @brief Calls a function value, through its code pointer with its
+   * environment first
+   * @param node The call, whose callee is not a named function
+   * @return The result
+   */
+  LLVMValue emitClosureCall(const nodes::CallExpressionNode *node);
+
+  /**
+   * @brief Generates a function expression as a closure
+   *
+   * Its body becomes an internal function that takes the environment
+   * first. The environment holds a copy of each local of the enclosing
+   * function that the body uses; it is an entry-block slot of that
+   * function unless LLVMClosureAnalysis finds that the closure may
+   * outlive it, and then comes from tspp_new, or the arena of #arena
+   * code. A closure that uses no locals has a null environment.
+   *
+   * @param node The function expression
+   * @return The { code, environment } pair
+   */
+  LLVMValue visitFunctionExpr(const nodes::FunctionExpressionNode *node);
+
+  /**
+   * @brief Gets the storage of a function expression's value, from its
+   * declared parameter and return types
+   */
+  llvm::StructType *getClosureType(const nodes::FunctionExpressionNode *node);
+
+  /**
+   * @brief Makes a named function a function value
+   *
+   * Its code is a thunk, <name>.closure, that ignores the environment and
+   * forwards its arguments; calls through a known value inline both.
+   *
+   * @param function The named function
+   * @param closureType The function value's storage
+   * @param name The variable or parameter, for diagnostics
+   * @return The value, or nullptr if the signatures differ
+   */
+  llvm::Value *emitFunctionValue(llvm::Function *function,
+                                 llvm::StructType *closureType,
+                                 const std::string &name);
+
+  /**
+   * @brief Finishes a call of an async function, whose ramp returned
+   *
+   * An awaited call suspends the caller until the task completes, unless
+   * it already has, and a call outside async functions runs the executor
+   * until then. Either reads the result from the task's promise and
+   * destroys the coroutine. A call inside an async function that is not
+   * awaited detaches the task instead, and has no value.
+   *
+   * @param handle The coroutine the ramp returned
+   * @param resultType Type of the function's result, void for none
+   * @param awaited The call is the operand of await
+   * @return The result
+   */
+  LLVMValue finishAsyncCall(llvm::Value *handle, llvm::Type *resultType,
+                            bool awaited);
+
+  /**
+   * @brief Calls mapFile or unmapFile
+   *
+   * mapFile(path) maps the file read-only through tspp_map_file and views
+   * its bytes; unmapFile(bytes) releases the mapping.
+   *
+   * @param node The call
+   * @param name The builtin
+   */
+  LLVMValue emitFileBuiltin(const nodes::CallExpressionNode *node,
+                            const std::string &name);
+
+  /**
+   * @brief Generates blackBox(x)
+   *
+   * The value is stored to a stack slot that an empty volatile asm takes
+   * the address of and may read or write, and is loaded back from there.
+   * The optimizer can neither drop the computation of x nor fold what is
+   * done with the result, yet the barrier costs no instructions.
+   *
+   * @param node The call
+   */
+  LLVMValue emitBlackBox(const nodes::CallExpressionNode *node);
+
+  /**
+   * @brief Calls an extern "C" function
+   *
+   * Arguments convert to the parameter types and then cross as the
+   * signature lowered them: as they are, split into their parts through a
+   * stack slot, or by the address of a copy. Variadic arguments get C's
+   * default promotions. A result comes back the same ways, or through an
+   * sret slot.
+   *
+   * @param node The call
+   * @param function The declaration in the current module
+   * @param signature The lowered signature
+   * @return The result, or no value for void
+   */
+  LLVMValue emitCCall(const nodes::CallExpressionNode *node,
+                      llvm::Function *function,
+                      const CABISignature &signature);
+
+  /**
+   * @brief Calls sleep, readable or writable, which the executor
+   * implements
+   *
+   * Awaited, the runtime schedules the coroutine and it suspends; outside
+   * async functions the runtime runs other tasks until the wait is over.
+   *
+   * @param node The call expression node
+   * @param name The builtin's name
+   * @param awaited The call is the operand of await
+   * @return The call, or an invalid value if it is not one of them
+   */
+  LLVMValue emitAsyncBuiltin(const nodes::CallExpressionNode *node,
+                             const std::string &name, bool awaited);
+
+  /**
+   * @brief Calls the specialization of a generic function
+   *
+   * The type arguments are written at the call or inferred from the
+   * arguments; each distinct list is instantiated once per module.
+   *
+   * @param node The call expression node
+   * @param decl The called generic
+   * @return The generated LLVM value
+   */
+  LLVMValue visitGenericCall(const nodes::CallExpressionNode *node,
+                             const nodes::GenericFunctionDeclNode *decl);
+
+  /**
+   * @brief Calls a method of a class or interface
+   *
+   * The call is direct when the receiver's class is known exactly, as for
+   * a class value or a new object, or when every class it may be an
+   * instance of runs the same method. Otherwise it loads the method from
+   * the object's vtable or the interface value's itable.
+   *
+   * @param node The call expression node
+   * @param callee The member naming the method
+   * @return The generated LLVM value
+   */
+  LLVMValue visitMethodCall(const nodes::CallExpressionNode *node,
+                            const nodes::MemberExpressionNode *callee);
+
+  /**
+   * @brief Evaluates the object whose member is accessed
+   * @param node The object expression
+   * @param exact Set when the object's class is exactly its static type
+   * @return Pointer to the object, an interface value, or nullptr on error
+   */
+  llvm::Value *emitObject(const nodes::ExpressionNode *node, bool &exact);
+
+  /**
+   * @brief Turns an evaluated expression into the object whose member is
+   * accessed
+   * @param value The evaluated object expression
+   * @param exact Set when the object's class is exactly its static type
+   * @return Pointer to the object, an interface value, or nullptr on error
+   */
+  llvm::Value *emitObject(const LLVMValue &value, bool &exact);
+
+  /**
+   * @brief Accesses a field of a class, inherited ones included
+   * @return The field as an lvalue
+   */
+  LLVMValue visitMemberExpr(const nodes::MemberExpressionNode *node);
+
+  /**
+   * @brief Loads `this` in a method
+   */
+  LLVMValue visitThisExpr(const nodes::ThisExpressionNode *node);
+
+  /**
+   * @brief Finds the class a struct type or pointer to one lays out
+   * @return The class, or nullptr for other types
+   */
+  const LLVMClassHierarchy::ClassInfo *getClassOf(llvm::Type *type) const;
+
+  /**
+   * @brief Gets the value of an Enum.Member expression
+   * @return The constant, or nullptr if the expression names no enum member
+   */
+  llvm::Constant *getEnumMember(const nodes::MemberExpressionNode *node);
+
+  /**
+   * @brief Gets the value the constant folder computed for an expression
+   * @return The constant, or nullptr if the expression was not folded
+   */
+  llvm::Constant *getFoldedValue(const nodes::ExpressionNode *node);
+
+  /**
+   * @brief Finds the interface whose values have the given type
+   * @return The interface, or nullptr for other types
+   */
+  const LLVMClassHierarchy::InterfaceInfo *
+  getInterfaceOf(llvm::Type *type) const;
+
+  /**
+   * @brief Gets the itable of a class for one of its interfaces
+   *
+   * Entries are the class's methods. A method that objects of derived
+   * classes override is entered as a thunk that calls through the vtable.
+   */
+  llvm::Constant *getItable(const LLVMClassHierarchy::ClassInfo *cls,
+                            const LLVMClassHierarchy::InterfaceInfo *iface);
+
+  /**
+   * @brief Gets a function that calls a virtual method through the vtable
+   * @param cls The class whose objects the thunk receives
+   * @param name The method
+   */
+  llvm::Function *getDispatchThunk(const LLVMClassHierarchy::ClassInfo *cls,
+                                   const std::string &name);
+
+  /**
+   * @brief Loads a method from the vtable of an object
+   * @param object Pointer to an object whose class has a vtable pointer
+   * @param slot The method's slot
+   * @param type The method's function type
+   * @return Pointer to the method
+   */
+  llvm::Value *emitVtableLoad(llvm::Value *object, int slot,
+                              llvm::FunctionType *type);
+
+  /**
+   * @brief Elements of an array value
+   */
+  struct ArrayElements {
+    llvm::Value *data = nullptr;        ///< Address of the first element
+    llvm::Type *elementType = nullptr;  ///< Type of the elements
+    llvm::Value *length = nullptr;      ///< Element count, an i32
+    std::vector<llvm::Value *> columns; ///< First element of each field's
+                                        ///< column, for a #soa array
+    bool view = false;                  ///< Elements of a slice, only read
+
+    /// Type the elements are read as; bytes are read as ints
+    llvm::Type *getValueType() const {
+      return view && elementType->isIntegerTy(8)
+                 ? llvm::Type::getInt32Ty(elementType->getContext())
+                 : elementType;
+    }
+  };
+
+  /**
+   * @brief Finds the elements of a sized or growable array, or a slice
+   * @param array The evaluated array expression
+   * @param elements Receives the elements
+   * @return False if the value is not an array
+   */
+  bool getArrayElements(const LLVMValue &array, ArrayElements &elements);
+
+  /**
+   * @brief Loads an element of an array
+   *
+   * An element of a #soa array is gathered from its columns, and a byte
+   * is widened to an int.
+   *
+   * @param elements The array
+   * @param index The element's index, an i32
+   * @return The element's value
+   */
+  llvm::Value *emitElementLoad(const ArrayElements &elements,
+                               llvm::Value *index);
+
+  /**
+   * @brief Checks whether an array expression has #soa storage
+   * @param array The array expression, already type checked
+   */
+  bool isStructOfArrays(const nodes::ExpressionNode *array);
+
+  /**
+   * @brief Reaches a field of a #soa array element, arr[i].field, as
+   * arr.field[i]; only the field's column is touched
+   * @param node The index expression
+   * @param field Interned name of the field
+   * @param found Set when the field has a column; an inherited field is
+   *        found in the returned base object instead
+   * @return The field, or the element's base object, as an lvalue
+   */
+  LLVMValue emitColumnElement(const nodes::IndexExpressionNode *node,
+                              core::Symbol field, bool &found);
+
+  /**
+   * @brief Stores a whole element of a #soa array, a field per column
+   * @param node The index expression
+   * @param value The element's new value
+   * @return The stored value
+   */
+  LLVMValue emitColumnsStore(const nodes::IndexExpressionNode *node,
+                             const nodes::ExpressionNode *value);
+
+  /**
+   * @brief Generates a #parallel for-of loop
+   *
+   * The body is outlined into a function that runs a range of iterations,
+   * and tspp_parallel_for hands ranges of the array to its workers. The
+   * outlined function reaches the caller's locals through an environment
+   * of their addresses; an exception that leaves it aborts the program.
+   *
+   * @param node The loop
+   * @param elements The array, whose length is read once at entry
+   */
+  LLVMValue emitParallelForOf(const nodes::ForOfStmtNode *node,
+                              const ArrayElements &elements);
+
+  /**
+   * @brief Sets aside the state of the function being generated, so that
+   * another can be generated from inside it
+   * @return What resumeFunction() restores
+   */
+  EnclosingFunction suspendFunction();
+
+  /**
+   * @brief Goes back to generating a function set aside by
+   * suspendFunction()
+   */
+  void resumeFunction(EnclosingFunction &&function);
+
+  /**
+   * @brief Generates a for-of loop over a slice
+   *
+   * A pointer steps from the first element to the end instead of an index
+   * counting to the length.
+   *
+   * @param node The loop
+   * @param elements The slice
+   */
+  LLVMValue emitSliceForOf(const nodes::ForOfStmtNode *node,
+                           const ArrayElements &elements);
+
+  /**
+   * @brief Indexes an array after checking the index
+   * @return The element as an lvalue; an element of a #soa array is a
+   *         copy
+   */
+  LLVMValue visitIndexExpr(const nodes::IndexExpressionNode *node);
+
+  /**
+   * @brief Evaluates the array and index of an index expression and
+   * checks the index
+   * @param node The index expression
+   * @param elements Receives the array's elements
+   * @param index Receives the index, an i32
+   * @return False if an error was reported
+   */
+  bool emitCheckedIndex(const nodes::IndexExpressionNode *node,
+                        ArrayElements &elements, llvm::Value *&index);
+
+  /**
+   * @brief Traps unless 0 <= index < length
+   *
+   * Nothing is emitted in #unsafe functions, and constant indices into
+   * sized arrays are checked at compile time. The remaining checks are a
+   * single unsigned compare that branches to a cold failure block, the
+   * shape the optimizer's range check elimination recognizes: checks
+   * implied by a loop's condition are removed, and checks on induction
+   * variables are replaced by one test before the loop.
+   *
+   * @param index The index, an i32
+   * @param length The element count, an i32
+   * @param location The access, reported if the check fails
+   */
+  void emitBoundsCheck(llvm::Value *index, llvm::Value *length,
+                       const core::SourceLocation &location);
+
+  /**
+   * @brief Gets the tspp_check_site a failing check reports
+   *
+   * The failure branch passes the site's address to the runtime, which
+   * only reads it once a check has failed; checks at one location share
+   * a site.
+   *
+   * @param location The check's location
+   * @return The site as an i8*
+   */
+  llvm::Constant *getCheckSite(const core::SourceLocation &location);
+
+  /**
+   * @brief Processes an assignment expression
+   * @param node The assignment expression node
+   * @return The generated LLVM value
+   */
+  LLVMValue visitAssignmentExpr(const nodes::AssignmentExpressionNode *node);
+
+  /**
+   * @brief Allocates and zeroes a class instance
+   * @param node The new expression node
+   * @param ownership Smart pointer kind that will own the object; #shared
+   *        objects get a reference count header
+   * @return Pointer to the object
+   */
+  LLVMValue visitNewExpr(const nodes::NewExpressionNode *node,
+                         PointerOwnership ownership = PointerOwnership::Raw);
+
+  /**
+   * @brief Creates a concurrent container in the runtime
+   *
+   * new MpmcQueue<T>(capacity) and SpscQueue<T> pass the capacity and T's
+   * size and alignment; new ConcurrentMap<K, V>() passes V's.
+   *
+   * @return The container's handle
+   */
+  LLVMValue emitContainerNew(const nodes::NewExpressionNode *node);
+
+  /**
+   * @brief Finds the struct a new expression creates, reporting unknown
+   * classes and constructor arguments
+   * @return The class's struct, or null
+   */
+  llvm::StructType *getNewType(const nodes::NewExpressionNode *node);
+
+  /**
+   * @brief Zeroes a class instance and points it at its class's vtable
+   * @param type The class's struct
+   * @param className The class, which names the vtable
+   * @param object Where the instance lives
+   */
+  void emitObjectInit(llvm::StructType *type, const std::string &className,
+                      llvm::Value *object);
+  LLVMValue visitCastExpr(const nodes::CastExpressionNode *node);
+
+  /**
+   * @brief Creates a growable array holding the elements of a literal
+   *
+   * The elements live in runtime memory, which the optimizer moves to the
+   * stack when the array does not escape. Constant elements are copied
+   * from a read-only constant instead of being stored one by one.
+   *
+   * @param node The array literal
+   * @param elementType Type of the elements, or nullptr to use the first
+   *        element's type
+   * @return The { T*, i64, i64 } array
+   */
+  LLVMValue visitArrayLiteral(const nodes::ArrayLiteralNode *node,
+                              llvm::Type *elementType = nullptr);
+
+  /**
+   * @brief Stores the elements of an array literal into a sized array
+   * @param node The array literal
+   * @param storage The [N x T] storage
+   * @param arrayType Its type
+   * @return False if there are more elements than the array holds
+   */
+  bool emitArrayElements(const nodes::ArrayLiteralNode *node,
+                         llvm::Value *storage, llvm::ArrayType *arrayType);
+
+  /**
+   * @brief Builds a constant array from element values
+   * @return The constant, zero-padded to the array's size, or nullptr if
+   *         an element is not a constant
+   */
+  llvm::Constant *getConstantArray(llvm::ArrayType *arrayType,
+                                   const std::vector<llvm::Value *> &values);
+
+  /**
+   * @brief Calls a method of a growable array
+   *
+   * push(x) appends an element, growing the array geometrically when it is
+   * full. reserve(n) makes room for n elements up front.
+   *
+   * @param node The call
+   * @param name The method
+   * @param array The array, an lvalue
+   */
+  LLVMValue emitArrayMethod(const nodes::CallExpressionNode *node,
+                            const std::string &name, const LLVMValue &array);
+
+  /**
+   * @brief Appends an element to a #soa array
+   *
+   * The columns grow together, so the first one's length and capacity
+   * stand for all of them.
+   *
+   * @param array Address of the array
+   * @param element The element, of the array's class
+   */
+  void emitColumnsPush(llvm::Value *array, llvm::Value *element);
+
+  /**
+   * @brief Calls a method of a slice
+   *
+   * slice(begin, end) views elements begin..end-1 of the slice, after
+   * checking that 0 <= begin <= end <= length. Nothing is copied.
+   *
+   * @param node The call
+   * @param name The method
+   * @param slice The slice
+   */
+  LLVMValue emitSliceMethod(const nodes::CallExpressionNode *node,
+                            const std::string &name, const LLVMValue &slice);
+
+  /**
+   * @brief Calls an operation of an #atomic value
+   *
+   * Loads and stores become atomic loads and stores, exchange and the fetch
+   * operations atomicrmw, and compareExchange a strong cmpxchg. A trailing
+   * string literal names the memory order, seq_cst when left out.
+   *
+   * @param node The call
+   * @param name The operation
+   * @param atomic The atomic, an lvalue, or a pointer to one
+   */
+  LLVMValue emitAtomicMethod(const nodes::CallExpressionNode *node,
+                             const std::string &name, const LLVMValue &atomic);
+
+  /**
+   * @brief Calls an operation of a vector
+   *
+   * extract and insert become extractelement and insertelement, shuffle a
+   * shufflevector of one vector or two, and sum, product, min and max the
+   * llvm.vector.reduce intrinsics. Float sums and products may reassociate.
+   *
+   * @param node The call
+   * @param name The operation
+   * @param vector The vector
+   */
+  LLVMValue emitVectorMethod(const nodes::CallExpressionNode *node,
+                             const std::string &name, const LLVMValue &vector);
+
+  /**
+   * @brief Reads a lane of a vector, or addresses it if the vector is stored
+   */
+  LLVMValue emitVectorIndex(const nodes::IndexExpressionNode *node);
+
+  /**
+   * @brief Calls a method of a concurrent container
+   *
+   * Elements travel to and from the runtime through stack slots. Keys are
+   * widened to i64. tryPop and find store their fallback in the slot first,
+   * so it is what they return when the runtime finds nothing.
+   *
+   * @param node The call
+   * @param name The method
+   * @param container The container's handle
+   */
+  LLVMValue emitContainerMethod(const nodes::CallExpressionNode *node,
+                                const std::string &name,
+                                const LLVMValue &container);
+
+  // Main function creation
+  /**
+   * @brief Creates a default main function if none exists
+   * @param name Name of the function, which runs the top-level statements
+   * @return Pointer to the created main function, or nullptr on failure
+   */
+  llvm::Function *createDefaultMainFunction(const std::string &name = "main");
+
+  // Symbol lookup across JIT increments
+  /**
+   * @brief Finds a function in the current module, an earlier increment or
+   * an imported interface
+   *
+   * A function that was handed to the JIT earlier, or that an imported
+   * program defines, is declared in the current module on first use, so the
+   * JIT or the linker links the call to the existing code.
+   *
+   * @param name Function name
+   * @param symbol Interned function name
+   * @return The function, or nullptr if it is unknown
+   */
+  llvm::Function *lookupFunction(const std::string &name, core::Symbol symbol);
+
+  /**
+   * @brief Finds a global in the current module or an earlier increment
+   * @param name Global variable name
+   * @return The global variable, or nullptr if it is unknown
+   */
+  llvm::GlobalVariable *lookupGlobal(const std::string &name);
+
+  /**
+   * @brief Records the definitions of the current module before it is
+   * handed to the JIT
+   * @param entryName Entry function to leave out
+   */
+  void recordIncrementDefinitions(const std::string &entryName);
+
+  // Helper methods
+  /**
+   * @brief Reports an error with location information
+   * @param location Source location of the error
+   * @param message Error message
+   */
+  void error(const core::SourceLocation &location, const std::string &message);
+
+  /**
+   * @brief Reports a warning with location information
+   * @param location Source location of the warning
+   * @param message Warning message
+   */
+  void warning(const core::SourceLocation &location,
+               const std::string &message);
+
+  // String parsing helpers for assembly statements
+  /**
+   * @brief Parses escape sequences in string literals
+   * @param input The input string with escape sequences
+   * @return The parsed string with escape sequences resolved
+   */
+  std::string parseStringLiteral(std::string_view input);
+
+  /**
+   * @brief Gets the code of an assembly statement from its string literal
+   *
+   * Only the quotes and the \" and \\ escapes belong to the literal; other
+   * escapes are left to the code, such as a printf string inside it.
+   *
+   * @param literal The literal as written, with its quotes
+   * @return The code
+   */
+  std::string unquoteAssembly(const std::string &literal);
+
+  /**
+   * @brief Extracts the string from assembly code that is a simple
+   *        printf("...") call
+   * @param asmCode The assembly code to check
+   * @param format Receives the text printf would print: escape sequences
+   * resolved and %% collapsed
+   * @return True if it's a simple printf call
+   */
+  bool extractPrintfString(const std::string &asmCode, std::string &format);
 
   // Loop management for break/continue
   /**
    * @brief Information about a loop for break/continue handling
    */
   struct LoopInfo {
-    llvm::BasicBlock *continueDest; ///< Destination for continue statements
+    llvm::BasicBlock *continueDest; ///< Destination for continue, if any
     llvm::BasicBlock *breakDest;    ///< Destination for break statements
+    size_t scopeDepth;              ///< Scopes open outside the loop body
+    size_t continueDepth;           ///< Scopes open outside continueDest's loop
   };
 
   /**
-   * @brief Pushes a new loop onto the loop stack
+   * @brief Pushes a new loop onto the loop stack; call where its body
+   * starts, which counts an iteration under -instrument=loops
    * @param continueDest Basic block to jump to for continue
    * @param breakDest Basic block to jump to for break
+   * @param location Where the loop is
    */
-  void pushLoop(llvm::BasicBlock *continueDest, llvm::BasicBlock *breakDest);
+  void pushLoop(llvm::BasicBlock *continueDest, llvm::BasicBlock *breakDest,
+                const core::SourceLocation &location);
 
   /**
    * @brief Pops the current loop from the loop stack
@@ -309,30 +1483,532 @@ private:
    */
   LoopInfo *getCurrentLoop();
 
+  /**
+   * @brief Chooses the storage type of a variable from its annotation
+   *
+   * Every type is laid out as declared, and a type parameter of the
+   * specialization being generated uses its bound type. Unannotated values
+   * are int.
+   *
+   * @param type The declared type, or nullptr if inferred
+   * @return The LLVM type to allocate
+   */
+  llvm::Type *getStorageType(const nodes::TypeNode *type);
+
+  /**
+   * @brief Chooses the return type of a function from its annotation
+   * @param type The declared return type
+   * @return The LLVM type, which unlike a storage type may be void
+   */
+  llvm::Type *getReturnType(const nodes::TypeNode *type);
+
+  /**
+   * @brief Converts between integer, boolean and floating point values
+   * @param value The value to convert
+   * @param type The numeric type to produce
+   * @return The converted value, or nullptr if either type is not numeric
+   */
+  llvm::Value *convertNumeric(llvm::Value *value, llvm::Type *type);
+
+  /**
+   * @brief Converts a value about to be stored to the variable's type
+   * @param value The initial or assigned value
+   * @param storageType The variable's storage type
+   * @param name The variable name for diagnostics
+   * @return The converted value, or nullptr if the types are incompatible
+   */
+  llvm::Value *convertForStore(llvm::Value *value, llvm::Type *storageType,
+                               const std::string &name);
+
+  /**
+   * @brief Tags a value of one of a union's arms, or of another union,
+   * into the union
+   *
+   * An arm's value is stored as the first arm it converts to. Another
+   * union's value is retagged by a switch on its tag, arm by arm.
+   *
+   * @return The union value, or nullptr if no arm takes the value
+   */
+  llvm::Value *emitUnionValue(llvm::Value *value, llvm::Type *unionType,
+                              const std::string &name);
+
+  /**
+   * @brief Gets the address of a union's payload as one of its arms
+   * @param address The union in memory
+   * @param unionType Its storage type
+   * @param arm The arm's storage type
+   */
+  llvm::Value *getUnionPayload(llvm::Value *address, llvm::Type *unionType,
+                               llvm::Type *arm);
+
+  /**
+   * @brief Loads or extracts the tag of a union value
+   */
+  llvm::Value *emitUnionTag(const LLVMValue &value);
+
+  /**
+   * @brief Finds the tag of a union's arm by its type's name
+   * @param unionType The union as the checker resolved it
+   * @param armName The arm's type, written as in typeof tests
+   * @return The tag, or -1 if no arm has the name
+   */
+  int getUnionTag(const std::shared_ptr<visitors::ResolvedType> &unionType,
+                  const std::string &armName);
+
+  /**
+   * @brief Evaluates typeof x == "T" against a union as one compare of its
+   * tag
+   * @return The i1 result, or nullptr if x is not a union
+   */
+  llvm::Value *emitTypeTest(const nodes::TypeTest &test);
+
+  /**
+   * @brief Evaluates typeof x, the name of the type x holds
+   */
+  LLVMValue emitTypeOf(const nodes::ExpressionNode *operand);
+
+  /**
+   * @brief Uses a variable that a typeof test narrowed as the arm it holds
+   * @param variable The variable's storage
+   * @param node The use, whose resolved type is the narrowed one
+   * @return The arm's payload as an lvalue, or the variable itself
+   */
+  LLVMValue narrowUnion(const LLVMValue &variable,
+                        const nodes::IdentifierExpressionNode *node);
+
+  /**
+   * @brief Allocates heap storage for one object of the given type
+   *
+   * Calls a runtime allocator with the type's size and alignment. Both
+   * are constant, so HeapToStackPass can move the object to the stack when
+   * the pointer does not escape.
+   *
+   * @param type The object type
+   * @param name Name of the resulting pointer
+   * @param allocator tspp_alloc; tspp_new for new expressions, which honors
+   *        #arena blocks; or tspp_shared_alloc, which adds a reference count;
+   *        or the _at variant of either for -alloc-profile
+   * @param site The tspp_alloc_site an _at allocator takes, or nullptr
+   * @param sharedType The tspp_shared_type a shared allocator takes, or
+   *        nullptr
+   * @return Pointer to the uninitialized object
+   */
+  llvm::Value *emitHeapAllocation(llvm::Type *type, const std::string &name,
+                                  const char *allocator = "tspp_alloc",
+                                  llvm::Constant *site = nullptr,
+                                  llvm::Constant *sharedType = nullptr);
+
+  /**
+   * @brief Gets the tspp_shared_type of a class, emitting it if new
+   *
+   * Lists the byte offsets of the class's #shared and #weak fields, which
+   * the runtime releases when a #shared object dies and follows to find
+   * cycles.
+   *
+   * @param structType The class's struct type
+   * @return The descriptor as an i8*, or null if no field is counted
+   */
+  llvm::Constant *getSharedType(llvm::StructType *structType);
+
+  /**
+   * @brief Gets the byte offsets of a class's #shared and #weak fields,
+   * inherited ones included, with the ownership of each
+   */
+  std::vector<std::pair<uint64_t, PointerOwnership>>
+  getCountedFields(llvm::StructType *structType);
+
+  /**
+   * @brief Gets the smart pointer kind of a declared type
+   * @param type The declared type, or nullptr if inferred
+   * @return Raw unless the type is #shared<T>, #unique<T> or #weak<T>
+   */
+  static PointerOwnership getOwnership(const nodes::TypeNode *type);
+
+  /**
+   * @brief Evaluates the value a smart pointer variable is set to
+   *
+   * The result carries the reference the variable takes over: new objects
+   * start with one, #shared and #weak sources are retained, and a #unique
+   * source is moved out of (set to null).
+   *
+   * @param source The initializer or assigned expression
+   * @param ownership The variable's smart pointer kind
+   * @param storageType The variable's pointer type
+   * @param name The variable name for diagnostics
+   * @return The owned pointer, or nullptr on error
+   */
+  llvm::Value *emitOwnedValue(const nodes::ExpressionNode *source,
+                              PointerOwnership ownership,
+                              llvm::Type *storageType,
+                              const std::string &name);
+
+  /**
+   * @brief Drops the reference a smart pointer holds
+   * @param ownership The pointer's smart pointer kind
+   * @param pointer The loaded pointer, possibly null
+   */
+  void emitRelease(PointerOwnership ownership, llvm::Value *pointer);
+
+  /**
+   * @brief Frees a new object once it has been copied into a class value
+   *
+   * Class variables hold the object itself, so `let n: Node = new Node()`
+   * copies the allocation and nothing else refers to it afterwards.
+   *
+   * @param source Expression the value came from
+   * @param object The value before it was converted for the store
+   * @param storageType Type of the variable that received the copy
+   */
+  void freeCopiedObject(const nodes::ExpressionNode *source,
+                        llvm::Value *object, llvm::Type *storageType);
+
+  /**
+   * @brief Builds a new object straight into the class value receiving it
+   *
+   * `let v: Vec3 = new Vec3()` needs no allocation to copy from and free.
+   *
+   * @param source Expression being stored
+   * @param target The class value, an lvalue
+   * @return True if the source was a new expression built in place
+   */
+  bool emitNewInPlace(const nodes::ExpressionNode *source,
+                      const LLVMValue &target);
+
+  /**
+   * @brief Copies one class value over another with memcpy
+   *
+   * The copy takes its own reference to what each #shared and #weak field
+   * refers to. Overwriting a value gives up the references it held.
+   *
+   * @param replace Whether the target held a value before
+   * @return True if both are lvalues of the same struct type and were copied
+   */
+  bool emitAggregateCopy(const LLVMValue &source, const LLVMValue &target,
+                         bool replace);
+
+  /**
+   * @brief Gets the address of a counted field of a class value as an i8**
+   */
+  llvm::Value *getCountedFieldAddress(llvm::Value *object, uint64_t offset);
+
+  /**
+   * @brief Takes a reference to what each #shared and #weak field of a
+   * class value refers to
+   */
+  void emitFieldRetains(llvm::StructType *structType, llvm::Value *object);
+
+  /**
+   * @brief Releases the #shared and #weak fields of a local class value
+   * when its scope ends
+   */
+  void addFieldCleanups(llvm::StructType *structType, llvm::Value *object);
+
+  /**
+   * @brief Releases the smart pointers, #heap storage, array elements and
+   * string bytes of the innermost scopes
+   * @param depth Scopes below this depth are kept
+   * @param unwinding Whether an exception is leaving the scopes; arrays
+   *        and strings keep their blocks then, so that their locals need
+   *        no landing pads
+   */
+  void emitCleanups(size_t depth, bool unwinding = false);
+
+  /**
+   * @brief Whether locals of a type own a block: the elements of a T[]
+   * or the bytes of a long string
+   */
+  bool ownsBuffer(llvm::Type *type);
+
+  /**
+   * @brief Frees the block of a T[] or string local, if it owns one
+   * @param value Address of the local
+   */
+  void emitBufferFree(llvm::Value *value);
+
+  /**
+   * @brief Drops the frees of T[] and string locals whose value is copied
+   * out
+   *
+   * Copies share their elements or bytes, so a local is only freed if
+   * every value it holds is built in place, by a literal, pushes or a
+   * concatenation, and it is only taken apart or concatenated.
+   */
+  void dropEscapingFrees(llvm::Function &function);
+
+  /**
+   * @brief Leaves the innermost scope, releasing its smart pointers
+   *
+   * Nothing is emitted when the block already ended in a jump; break and
+   * continue release the scopes they leave themselves.
+   */
+  void exitScope();
+
+  /**
+   * @brief Calls a runtime function that takes one object pointer
+   * @param name The runtime function
+   * @param object The object pointer, cast to i8*
+   * @return The call's result
+   */
+  llvm::Value *emitRuntimeCall(const char *name, llvm::Value *object);
+
+  /**
+   * @brief Evaluates a loop or branch condition as an i1 value
+   * @param node The condition expression
+   * @return The i1 condition, or nullptr if it could not be generated
+   */
+  llvm::Value *emitCondition(const nodes::ExpressionNode *node);
+
+  /**
+   * @brief Attaches vectorization hints to every back edge of a loop
+   *
+   * Only applies inside #simd functions when SIMD is enabled. The hints ask
+   * the loop vectorizer for the target's preferred vector width; it emits
+   * the vector body and the scalar epilogue.
+   *
+   * @param header The loop header block
+   * @param preheader The block that enters the loop
+   */
+  void annotateLoop(llvm::BasicBlock *header, llvm::BasicBlock *preheader);
+
+  // Exception handling
+  /**
+   * @brief A try statement whose handlers or finally block are active
+   *
+   * Catch bodies get an entry of their own without handlers, so that an
+   * exception they throw still runs the finally block.
+   */
+  struct TryInfo {
+    const nodes::TryStmtNode *node;          ///< The try statement, or null
+    std::vector<llvm::Constant *> typeInfos; ///< Caught types; null catches all
+    llvm::BasicBlock *dispatch;              ///< Selects a catch clause
+    size_t scopeDepth;                       ///< Scopes open outside the try
+  };
+
+  /**
+   * @brief Calls a function, unwinding to the current landing pad
+   *
+   * Emits an invoke inside try statements and scopes with cleanups, and a
+   * plain call elsewhere. Invokes of functions found not to throw are
+   * turned back into calls once the module is complete.
+   *
+   * @param callee The function to call
+   * @param args The arguments
+   * @param name Name of the result
+   * @return The result
+   */
+  llvm::Value *emitCall(llvm::FunctionCallee callee,
+                        llvm::ArrayRef<llvm::Value *> args,
+                        const llvm::Twine &name = "");
+
+  /**
+   * @brief Gets the landing pad for calls at the insert point
+   *
+   * The landing pad catches the types of every enclosing catch clause,
+   * releases the scopes inside the innermost try and branches to its
+   * dispatch block. Consecutive calls with the same cleanups share one.
+   *
+   * @return The landing pad, or nullptr if unwinding needs no code here
+   */
+  llvm::BasicBlock *getLandingPad();
+
+  /**
+   * @brief Creates the slots landing pads store the exception and its
+   * selector in, once per function
+   */
+  void createExceptionSlots();
+
+  /**
+   * @brief Gets the block that continues unwinding out of the function
+   */
+  llvm::BasicBlock *getResumeBlock();
+
+  /**
+   * @brief Continues unwinding at the innermost active try statement
+   *
+   * Releases the scopes opened inside it, then branches to its dispatch
+   * block, or out of the function if there is none.
+   */
+  void emitUnwind();
+
+  /**
+   * @brief Emits the finally blocks of the try statements a jump leaves
+   * @param depth Try statements with at least this many scopes outside
+   *        them are left
+   */
+  void emitFinallyBlocks(size_t depth);
+
+  /**
+   * @brief Marks the call a return statement returns as a tail call
+   *
+   * The call must be the last instruction before the return. It is
+   * musttail when the callee has the caller's prototype and no argument
+   * points into the caller's frame, and tail otherwise. In a #tailcall
+   * function a call that cannot be musttail is an error.
+   *
+   * @param result The value being returned
+   * @param caller The function returning it
+   */
+  void markTailCall(llvm::Value *result, llvm::Function *caller);
+
+  /**
+   * @brief Whether a value is, or holds, the address of a local
+   *
+   * Closures carry their environment and string slices their bytes inside
+   * an aggregate, so those are looked through. An aggregate loaded or
+   * returned from elsewhere that holds a pointer may hold any address.
+   */
+  static bool holdsFrameAddress(llvm::Value *value);
+
+  /**
+   * @brief Gets the typeinfo that identifies thrown values of a type
+   * @param type A class or primitive type
+   * @return The typeinfo cast to i8*, or nullptr if the type cannot be
+   *         thrown
+   */
+  llvm::Constant *getTypeInfo(llvm::Type *type);
+
+  /**
+   * @brief Marks functions that cannot unwind as nounwind
+   *
+   * A function qualifies when its throws clause is empty and everything it
+   * calls qualifies; recursion is allowed. Invokes of such functions
+   * become calls and their landing pads are dropped.
+   */
+  void inferNoUnwind();
+
+  /**
+   * @brief Links the runtime's bitcode into an optimized native module
+   *
+   * Runtime functions the module calls get their bodies as
+   * available_externally, so the optimizer can inline them while the
+   * archive still provides the symbols. Functions that touch the runtime's
+   * file-local state stay declarations, since a copy would get state of
+   * its own. A runtime that cannot be read or is built for another target
+   * is skipped with a warning.
+   */
+  void linkRuntimeBitcode();
+
   // Core components
   core::ErrorReporter &errorReporter_; ///< Error reporter for diagnostics
   CodeGenOptions options_;             ///< Code generation options
   LLVMContext context_;                ///< LLVM context manager
   LLVMTypeBuilder typeBuilder_;        ///< Type conversion utilities
   LLVMOptimizer optimizer_;            ///< Code optimization manager
+  LLVMMonomorphizer monomorphizer_;    ///< Generic specialization cache
+  LLVMClassHierarchy classHierarchy_;  ///< Classes and interfaces to dispatch
+  LLVMTarget target_;                  ///< Target machine for the options
+  std::unique_ptr<LLVMDebugInfo> debugInfo_; ///< DWARF, if requested
+  /// -instrument= counters, if requested
+  std::unique_ptr<LLVMInstrumentation> instrumentation_;
+  const CodeGenPartition *partition_ = nullptr; ///< Share to emit, or all
+  parser::BodyStream *bodyStream_ = nullptr; ///< Of bodies not parsed yet
+  bool wholeProgram_ = false; ///< Only main is external; bodies on demand
+  LLVMJIT jit_;                        ///< Reusable execution session
 
   // Function generation state
   std::unique_ptr<LLVMFunction>
       currentFunction_;            ///< Current function being generated
+  const nodes::TypeNode *currentReturnType_ =
+      nullptr;                     ///< Declared return type of currentFunction_
   std::stack<LoopInfo> loopStack_; ///< Stack of nested loops
+  bool simdFunction_ = false;      ///< Current function is marked #simd
+  bool uncheckedFunction_ = false; ///< #unsafe: array indices are unchecked
+  bool tailCallFunction_ = false;  ///< #tailcall: returned calls are musttail
+  std::vector<TryInfo> tryStack_;  ///< Enclosing try statements, innermost last
+  llvm::AllocaInst *exceptionSlot_ = nullptr; ///< Exception being dispatched
+  llvm::AllocaInst *selectorSlot_ = nullptr;  ///< Its catch clause selector
+  llvm::BasicBlock *resumeBlock_ = nullptr;   ///< Unwinds out of the function
+  llvm::BasicBlock *landingPad_ = nullptr;    ///< Last landing pad created
+  std::vector<const void *> landingPadKey_;   ///< State landingPad_ serves
 
-  // Namespace tracking
-  std::vector<std::string> currentNamespace_; ///< Current namespace path
+  // Functions whose throws clause is not empty
+  std::unordered_set<const llvm::Function *> throwingFunctions_;
 
-  /**
-   * @brief Gets the current namespace prefix for symbol names
-   * @return The namespace prefix string
-   */
-  std::string getCurrentNamespacePrefix() const;
+  // tspp_check_site constants of the module, by "file:line:column"
+  std::unordered_map<std::string, llvm::Constant *> checkSites_;
+
+  // The coroutine of the async function being generated
+  struct CoroutineInfo {
+    llvm::Value *id = nullptr;        ///< Token of llvm.coro.id
+    llvm::Value *handle = nullptr;    ///< Frame, from llvm.coro.begin
+    llvm::Value *promise = nullptr;   ///< Slot of the promise
+    llvm::Type *resultType = nullptr; ///< Result in the promise, or void
+    llvm::BasicBlock *finalBlock = nullptr;   ///< Where returns branch
+    llvm::BasicBlock *cleanupBlock = nullptr; ///< Frees the frame
+    llvm::BasicBlock *endBlock = nullptr;     ///< Returns to the resumer
+  };
+  CoroutineInfo coroutine_; ///< Handle is null outside async functions
+
+  // State of a function whose generation waits for a nested one's
+  struct EnclosingFunction {
+    llvm::IRBuilderBase::InsertPoint insertPoint;
+    llvm::DebugLoc location;
+    std::unique_ptr<LLVMFunction> function;
+    const nodes::TypeNode *returnType = nullptr;
+    std::stack<LoopInfo> loops;
+    std::vector<TryInfo> tries;
+    llvm::AllocaInst *exceptionSlot = nullptr;
+    llvm::AllocaInst *selectorSlot = nullptr;
+    llvm::BasicBlock *resumeBlock = nullptr;
+    llvm::BasicBlock *landingPad = nullptr;
+    std::vector<const void *> landingPadKey;
+    CoroutineInfo coroutine;
+    bool simd = false;
+    bool unchecked = false;
+    bool tailCall = false;
+  };
+
+  // What a closure captured, and how its creator had each value
+  struct ClosureEnv {
+    llvm::StructType *type = nullptr; ///< One field per capture, or none
+    std::vector<std::pair<core::Symbol, LLVMValue>> captures;
+  };
+
+  LLVMClosureAnalysis closureAnalysis_; ///< Closures that outlive their frame
+  visitors::ComptimeEvaluator comptime_; ///< Runs #comptime initializers
+
+  // Result type of each async function by interned name, void for none;
+  // kept across REPL inputs
+  std::unordered_map<core::Symbol, llvm::Type *> asyncResults_;
+
+  // T@aligned(N) alignments of global pointer variables
+  std::unordered_map<core::Symbol, unsigned> globalPointeeAlignments_;
+
+  // Smart pointer kinds of global variables
+  std::unordered_map<core::Symbol, PointerOwnership> globalOwnership_;
+
+  // Smart pointer kinds of the fields of each class, by field index
+  std::unordered_map<llvm::StructType *, std::vector<PointerOwnership>>
+      fieldOwnership_;
+
+  // Values of enum members by interned enum and member names; kept across
+  // REPL inputs
+  std::unordered_map<core::Symbol, std::unordered_map<core::Symbol, int64_t>>
+      enumMembers_;
+
+  // Function of each class method
+  std::unordered_map<const nodes::MethodDeclNode *, llvm::Function *>
+      methodFunctions_;
+
+  // Top-level functions declared once per #target, by name
+  std::unordered_map<core::Symbol, std::vector<const nodes::FunctionDeclNode *>>
+      functionVersions_;
+
+  // Functions declared ahead of their bodies by declareFunctions
+  std::unordered_map<const nodes::FunctionDeclNode *, llvm::Function *>
+      declaredFunctions_;
+
+  // Lowered signatures of extern "C" functions by interned name; kept
+  // across REPL inputs
+  std::unordered_map<core::Symbol, CABISignature> cFunctions_;
+
+  // Functions of a whole program whose bodies wait for a caller
+  std::vector<std::pair<const nodes::FunctionDeclNode *, llvm::Function *>>
+      deferredBodies_;
 
   // Function lookup table
-  std::unordered_map<std::string, llvm::Function *>
-      functionTable_; ///< Function name to LLVM function mapping
+  std::unordered_map<core::Symbol, llvm::Function *>
+      functionTable_; ///< Interned function name to LLVM function mapping
 
   // Top-level statement collections
   std::vector<const nodes::AssemblyStmtNode *>
@@ -340,6 +2016,20 @@ private:
   std::vector<const nodes::ExpressionStmtNode *>
       topLevelExpressionStatements_; ///< Expression statements to execute in
                                      ///< main
+
+  // Definitions already handed to the JIT by executeIncremental
+  struct IncrementGlobal {
+    llvm::Type *type;           ///< Value type of the global
+    bool isConst;               ///< Whether the global is constant
+    llvm::MaybeAlign alignment; ///< Alignment of the definition
+  };
+  std::unordered_map<core::Symbol, llvm::FunctionType *>
+      incrementFunctions_; ///< JIT-resident functions by interned name
+  std::vector<std::shared_ptr<const visitors::ModuleInterface>>
+      imports_; ///< Separately compiled programs, in import order
+  std::unordered_map<core::Symbol, IncrementGlobal>
+      incrementGlobals_; ///< JIT-resident globals by interned name
+  unsigned incrementCount_ = 0; ///< Entry functions created so far
 };
 
 } // namespace codegen
\ No newline at end of file
@@ -1,5 +1,9 @@
 #include "codegen/llvm/llvm_context.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/GlobalVariable.h"
 #include "llvm/IR/Module.h"
+#include "llvm/Support/FileSystem.h"
 #include "llvm/Support/raw_ostream.h"
 #include <fstream>
 
@@ -13,8 +17,31 @@ LLVMContext::LLVMContext(const std::string& moduleName)
 LLVMContext::~LLVMContext() = default;
 
 void LLVMContext::createNewModule(const std::string& moduleName) {
-    module_ = std::make_unique<llvm::Module>(moduleName, *context_);
-    builder_ = std::make_unique<llvm::IRBuilder<>>(*context_);
+    module_ = std::make_unique<llvm::Module>(moduleName, getContext());
+    builder_ = std::make_unique<llvm::IRBuilder<>>(getContext());
+    strings_.clear();
+}
+
+llvm::GlobalVariable *LLVMContext::getStringConstant(llvm::StringRef text,
+                                                     const std::string &name) {
+    llvm::GlobalVariable *&global = strings_[text.str()];
+    if (!global) {
+        llvm::Constant *bytes =
+            llvm::ConstantDataArray::getString(getContext(), text, true);
+        global = new llvm::GlobalVariable(*module_, bytes->getType(), true,
+                                          llvm::GlobalValue::PrivateLinkage,
+                                          bytes, name);
+        global->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+        global->setAlignment(llvm::Align(1));
+    }
+    return global;
+}
+
+llvm::orc::ThreadSafeModule
+LLVMContext::takeModule(const std::string& nextModuleName) {
+    llvm::orc::ThreadSafeModule module(std::move(module_), context_);
+    createNewModule(nextModuleName);
+    return module;
 }
 
 void LLVMContext::dumpModule() const {
@@ -33,6 +60,18 @@ bool LLVMContext::writeModuleToFile(const std::string& filename) const {
     return true;
 }
 
+bool LLVMContext::writeBitcodeToFile(const std::string& filename) const {
+    std::error_code EC;
+    llvm::raw_fd_ostream dest(filename, EC, llvm::sys::fs::OF_None);
+
+    if (EC) {
+        return false;
+    }
+
+    llvm::WriteBitcodeToFile(*module_, dest);
+    return true;
+}
+
 std::string LLVMContext::getModuleIR() const {
     std::string IR;
     llvm::raw_string_ostream OS(IR);
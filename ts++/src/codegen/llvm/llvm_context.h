@@ -1,9 +1,11 @@
 #pragma once
+#include "llvm/ExecutionEngine/Orc/ThreadSafeModule.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
 #include <memory>
 #include <string>
+#include <unordered_map>
 
 namespace codegen {
 
@@ -32,7 +34,7 @@ public:
    * @brief Gets the underlying LLVM context
    * @return Reference to the LLVM context
    */
-  llvm::LLVMContext &getContext() { return *context_; }
+  llvm::LLVMContext &getContext() { return *context_.getContext(); }
 
   /**
    * @brief Gets the current module
@@ -52,6 +54,31 @@ public:
    */
   void createNewModule(const std::string &moduleName);
 
+  /**
+   * @brief Hands the current module over to a JIT without copying it
+   *
+   * The returned module shares ownership of the LLVM context, so types and
+   * constants the code generator has cached stay valid. A fresh empty module
+   * replaces the current one.
+   *
+   * @param nextModuleName Name of the replacement module
+   * @return The previous module, ready for the ORC JIT
+   */
+  llvm::orc::ThreadSafeModule takeModule(const std::string &nextModuleName);
+
+  /**
+   * @brief Gets the constant holding a string's bytes
+   *
+   * Equal strings share one NUL-terminated global per module. The globals
+   * are unnamed_addr, so the linker merges copies from other modules too.
+   *
+   * @param text The string
+   * @param name Name of the global if it has to be created
+   * @return The [N x i8] global
+   */
+  llvm::GlobalVariable *getStringConstant(llvm::StringRef text,
+                                          const std::string &name = ".str");
+
   /**
    * @brief Dumps the current module IR to the console (for debugging)
    */
@@ -64,6 +91,13 @@ public:
    */
   bool writeModuleToFile(const std::string &filename) const;
 
+  /**
+   * @brief Writes the module as LLVM bitcode
+   * @param filename Path to the output file
+   * @return True if the operation was successful
+   */
+  bool writeBitcodeToFile(const std::string &filename) const;
+
   /**
    * @brief Gets a string representation of the module IR
    * @return String containing the module IR
@@ -71,9 +105,11 @@ public:
   std::string getModuleIR() const;
 
 private:
-  std::unique_ptr<llvm::LLVMContext> context_; // LLVM context
+  llvm::orc::ThreadSafeContext context_;       // Shared LLVM context
   std::unique_ptr<llvm::Module> module_;       // Current module
   std::unique_ptr<llvm::IRBuilder<>> builder_; // IR instruction builder
+  std::unordered_map<std::string, llvm::GlobalVariable *>
+      strings_; // String constants of the current module
 };
 
 } // namespace codegen
\ No newline at end of file
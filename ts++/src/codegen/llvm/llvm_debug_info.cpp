@@ -0,0 +1,210 @@
+#include "codegen/llvm/llvm_debug_info.h"
+#include "core/common/source_manager.h"
+#include "llvm/BinaryFormat/Dwarf.h"
+#include "llvm/IR/DebugInfoMetadata.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+
+namespace codegen {
+
+LLVMDebugInfo::LLVMDebugInfo(llvm::Module &module,
+                             const LLVMTypeBuilder &typeBuilder,
+                             DebugInfoKind kind, bool optimized)
+    : module_(module), typeBuilder_(typeBuilder), kind_(kind),
+      optimized_(optimized), builder_(module) {
+  // Without these the backend drops the descriptions
+  if (!module_.getModuleFlag("Debug Info Version")) {
+    module_.addModuleFlag(llvm::Module::Warning, "Debug Info Version",
+                          llvm::DEBUG_METADATA_VERSION);
+  }
+  if (!module_.getModuleFlag("Dwarf Version")) {
+    module_.addModuleFlag(llvm::Module::Max, "Dwarf Version", 4);
+  }
+}
+
+llvm::DIFile *LLVMDebugInfo::getFile(const core::SourceLocation &location) {
+  core::FileId id = location.getFileId();
+  auto it = files_.find(id);
+  if (it != files_.end()) {
+    return it->second;
+  }
+
+  // Absolute, so the debugger finds the source from any directory
+  llvm::SmallString<128> path(id == core::INVALID_FILE_ID
+                                  ? module_.getSourceFileName()
+                                  : location.getFilename());
+  llvm::sys::fs::make_absolute(path);
+  llvm::DIFile *file =
+      builder_.createFile(llvm::sys::path::filename(path),
+                          llvm::sys::path::parent_path(path));
+  files_.emplace(id, file);
+
+  // The unit is named after the first file with code
+  if (!unit_) {
+    unit_ = builder_.createCompileUnit(
+        llvm::dwarf::DW_LANG_C_plus_plus, file, "tspp", optimized_, "", 0,
+        "", kind_ == DebugInfoKind::Full
+                ? llvm::DICompileUnit::FullDebug
+                : llvm::DICompileUnit::LineTablesOnly);
+  }
+  return file;
+}
+
+void LLVMDebugInfo::beginFunction(llvm::Function *function,
+                                  const core::SourceLocation &location) {
+  llvm::DIFile *file = getFile(location);
+
+  // Line tables need no signature; full debug info describes it
+  llvm::SmallVector<llvm::Metadata *, 8> signature;
+  if (kind_ == DebugInfoKind::Full) {
+    llvm::Type *returnType = function->getReturnType();
+    signature.push_back(returnType->isVoidTy() ? nullptr
+                                               : getType(returnType));
+    for (auto &arg : function->args()) {
+      signature.push_back(getType(arg.getType()));
+    }
+  }
+  llvm::DISubroutineType *type = builder_.createSubroutineType(
+      builder_.getOrCreateTypeArray(signature));
+
+  auto flags = llvm::DISubprogram::SPFlagDefinition;
+  if (optimized_) {
+    flags |= llvm::DISubprogram::SPFlagOptimized;
+  }
+  if (function->hasLocalLinkage()) {
+    flags |= llvm::DISubprogram::SPFlagLocalToUnit;
+  }
+  if (subprogram_) {
+    enclosing_.push_back(subprogram_);
+  }
+  unsigned line = location.getLine();
+  subprogram_ = builder_.createFunction(
+      file, function->getName(), function->getName(), file, line, type, line,
+      llvm::DINode::FlagPrototyped, flags);
+  function->setSubprogram(subprogram_);
+}
+
+void LLVMDebugInfo::endFunction(llvm::IRBuilderBase &builder) {
+  if (subprogram_) {
+    builder_.finalizeSubprogram(subprogram_);
+    subprogram_ = nullptr;
+  }
+  if (!enclosing_.empty()) {
+    subprogram_ = enclosing_.back();
+    enclosing_.pop_back();
+  }
+  builder.SetCurrentDebugLocation(llvm::DebugLoc());
+}
+
+void LLVMDebugInfo::setLocation(llvm::IRBuilderBase &builder,
+                                const core::SourceLocation &location) {
+  if (!subprogram_ || location.getLine() == 0) {
+    return;
+  }
+  builder.SetCurrentDebugLocation(
+      llvm::DILocation::get(module_.getContext(), location.getLine(),
+                            location.getColumn(), subprogram_));
+}
+
+void LLVMDebugInfo::declareVariable(const std::string &name,
+                                    llvm::AllocaInst *slot,
+                                    const core::SourceLocation &location,
+                                    llvm::BasicBlock *block,
+                                    unsigned argNumber) {
+  if (kind_ != DebugInfoKind::Full || !subprogram_) {
+    return;
+  }
+  llvm::DIFile *file = getFile(location);
+  llvm::DIType *type = getType(slot->getAllocatedType());
+  llvm::DILocalVariable *variable =
+      argNumber ? builder_.createParameterVariable(subprogram_, name,
+                                                   argNumber, file,
+                                                   location.getLine(), type)
+                : builder_.createAutoVariable(subprogram_, name, file,
+                                              location.getLine(), type);
+  builder_.insertDeclare(
+      slot, variable, builder_.createExpression(),
+      llvm::DILocation::get(module_.getContext(), location.getLine(),
+                            location.getColumn(), subprogram_),
+      block);
+}
+
+llvm::DIType *LLVMDebugInfo::getType(llvm::Type *type) {
+  auto it = types_.find(type);
+  if (it != types_.end()) {
+    return it->second;
+  }
+
+  const llvm::DataLayout &layout = module_.getDataLayout();
+  uint64_t bits = type->isSized() ? layout.getTypeSizeInBits(type) : 0;
+  llvm::DIType *described = nullptr;
+  if (type->isIntegerTy(1)) {
+    described =
+        builder_.createBasicType("bool", 8, llvm::dwarf::DW_ATE_boolean);
+  } else if (type->isIntegerTy()) {
+    unsigned width = type->getIntegerBitWidth();
+    std::string name = width == 32   ? "int"
+                       : width == 64 ? "long"
+                                     : "i" + std::to_string(width);
+    described = builder_.createBasicType(name, width,
+                                         llvm::dwarf::DW_ATE_signed);
+  } else if (type->isFloatingPointTy()) {
+    described = builder_.createBasicType(type->isFloatTy() ? "float"
+                                                           : "double",
+                                         bits, llvm::dwarf::DW_ATE_float);
+  } else if (type->isPointerTy()) {
+    // Byte pointers are untyped memory, described as void *
+    llvm::Type *pointee = type->getPointerElementType();
+    described = builder_.createPointerType(
+        pointee->isIntegerTy(8) || !pointee->isSized() ? nullptr
+                                                       : getType(pointee),
+        bits);
+  } else if (auto arrayType = llvm::dyn_cast<llvm::ArrayType>(type)) {
+    llvm::Metadata *range =
+        builder_.getOrCreateSubrange(0, arrayType->getNumElements());
+    described = builder_.createArrayType(
+        bits, layout.getABITypeAlign(type).value() * 8,
+        getType(arrayType->getElementType()),
+        builder_.getOrCreateArray(range));
+  } else if (auto structType = llvm::dyn_cast<llvm::StructType>(type)) {
+    // Cached before the fields are, since a class may point to itself
+    std::string name =
+        structType->hasName() ? structType->getName().str() : "";
+    llvm::DIFile *file = unit_->getFile();
+    llvm::DICompositeType *composite = builder_.createStructType(
+        unit_, name, file, 0, bits, layout.getABITypeAlign(type).value() * 8,
+        llvm::DINode::FlagZero, nullptr, builder_.getOrCreateArray({}));
+    types_[type] = composite;
+
+    std::vector<core::Symbol> names = typeBuilder_.getFieldNames(structType);
+    const llvm::StructLayout *fields = layout.getStructLayout(structType);
+    llvm::SmallVector<llvm::Metadata *, 8> members;
+    for (unsigned i = 0; i < structType->getNumElements(); ++i) {
+      llvm::Type *fieldType = structType->getElementType(i);
+      std::string fieldName = "_" + std::to_string(i);
+      if (i < names.size() && names[i].isValid()) {
+        fieldName = names[i].str();
+      } else if (LLVMTypeBuilder::isDynamicArrayType(structType)) {
+        static const char *const kArrayFields[] = {"data", "length",
+                                                   "capacity"};
+        fieldName = kArrayFields[i];
+      }
+      members.push_back(builder_.createMemberType(
+          composite, fieldName, file, 0, layout.getTypeSizeInBits(fieldType),
+          layout.getABITypeAlign(fieldType).value() * 8,
+          fields->getElementOffsetInBits(i), llvm::DINode::FlagZero,
+          getType(fieldType)));
+    }
+    builder_.replaceArrays(composite, builder_.getOrCreateArray(members));
+    return composite;
+  } else {
+    // Functions and whatever else has no data to show
+    described = builder_.createUnspecifiedType("opaque");
+  }
+  types_[type] = described;
+  return described;
+}
+
+void LLVMDebugInfo::finalize() { builder_.finalize(); }
+
+} // namespace codegen
@@ -0,0 +1,98 @@
+#pragma once
+#include "codegen/codegen_options.h"
+#include "codegen/llvm/llvm_type_builder.h"
+#include "core/common/common_types.h"
+#include "llvm/IR/DIBuilder.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Module.h"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace codegen {
+
+/**
+ * @class LLVMDebugInfo
+ * @brief Describes the generated code to debuggers and profilers in DWARF
+ *
+ * Every function with a body gets a subprogram at its source line, and
+ * every statement's instructions carry the statement's line and column,
+ * so perf, gdb and sanitizers can map addresses back to the source. That
+ * is all line tables emit; they cost little to build and nothing at run
+ * time. Full debug info also describes parameters and locals with their
+ * types, through the stack slots -O0 keeps them in.
+ */
+class LLVMDebugInfo {
+public:
+  /**
+   * @brief Starts the compile unit of a module
+   * @param module The module being generated
+   * @param typeBuilder Names the fields of class types
+   * @param kind LineTablesOnly or Full
+   * @param optimized Whether the module is optimized after generation
+   */
+  LLVMDebugInfo(llvm::Module &module, const LLVMTypeBuilder &typeBuilder,
+                DebugInfoKind kind, bool optimized);
+
+  /**
+   * @brief Starts describing a function; what is emitted until
+   * endFunction() is attributed to it. A function started inside another,
+   * such as an outlined loop body, returns to it at endFunction().
+   * @param function The function whose body is about to be emitted
+   * @param location Where the function is defined
+   */
+  void beginFunction(llvm::Function *function,
+                     const core::SourceLocation &location);
+
+  /**
+   * @brief Finishes the current function and clears the builder's
+   * location, so code emitted outside it is not attributed to it
+   */
+  void endFunction(llvm::IRBuilderBase &builder);
+
+  /**
+   * @brief Attributes the instructions emitted next to a source location
+   * @param builder The builder emitting them
+   * @param location The statement being emitted; unknown ones are skipped
+   */
+  void setLocation(llvm::IRBuilderBase &builder,
+                   const core::SourceLocation &location);
+
+  /**
+   * @brief Describes a variable that lives in a stack slot, with full
+   * debug info only
+   * @param name The variable's name
+   * @param slot Its storage
+   * @param location Where it is declared
+   * @param block Block the declaration is emitted in
+   * @param argNumber One-based parameter position, 0 for a local
+   */
+  void declareVariable(const std::string &name, llvm::AllocaInst *slot,
+                       const core::SourceLocation &location,
+                       llvm::BasicBlock *block, unsigned argNumber = 0);
+
+  /**
+   * @brief Resolves the descriptions; call once the module is complete
+   */
+  void finalize();
+
+private:
+  // The file of a location, or the compile unit's for an unknown one
+  llvm::DIFile *getFile(const core::SourceLocation &location);
+
+  // Describes an LLVM type by its shape; class fields are named
+  llvm::DIType *getType(llvm::Type *type);
+
+  llvm::Module &module_;
+  const LLVMTypeBuilder &typeBuilder_;
+  DebugInfoKind kind_;
+  bool optimized_;
+  llvm::DIBuilder builder_;
+  llvm::DICompileUnit *unit_ = nullptr;        // Created with the first file
+  llvm::DISubprogram *subprogram_ = nullptr;   // Function being emitted
+  std::vector<llvm::DISubprogram *> enclosing_; // Functions it interrupted
+  std::unordered_map<core::FileId, llvm::DIFile *> files_;
+  std::unordered_map<llvm::Type *, llvm::DIType *> types_;
+};
+
+} // namespace codegen
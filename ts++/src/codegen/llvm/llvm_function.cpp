@@ -1,4 +1,5 @@
 #include "codegen/llvm/llvm_function.h"
+#include "parser/visitors/type_check_visitor/type_context.h"
 
 namespace codegen {
 
@@ -9,32 +10,52 @@ LLVMFunction::LLVMFunction(LLVMContext &context, llvm::Function *func,
   enterScope();
 }
 
-void LLVMFunction::enterScope() { scopes_.push_back(Scope()); }
+void LLVMFunction::enterScope() { scopes_.push_back({slots_.size(), {}}); }
 
 void LLVMFunction::exitScope() {
-  if (scopes_.size() > 1) { // Always keep at least one scope
-    scopes_.pop_back();
+  if (scopes_.size() <= 1) { // Always keep at least one scope
+    return;
   }
+  // Names hidden by the scope's variables are visible again
+  size_t firstSlot = scopes_.back().firstSlot;
+  while (slots_.size() > firstSlot) {
+    const Slot &slot = slots_.back();
+    if (slot.hidden == kNoSlot) {
+      innermost_.erase(slot.name);
+    } else {
+      innermost_[slot.name] = slot.hidden;
+    }
+    slots_.pop_back();
+  }
+  scopes_.pop_back();
+}
+
+void LLVMFunction::declareVariable(core::Symbol name, const LLVMValue &value) {
+  auto [it, inserted] = innermost_.try_emplace(name, slots_.size());
+  slots_.push_back({name, value, inserted ? kNoSlot : it->second});
+  it->second = slots_.size() - 1;
 }
 
-void LLVMFunction::declareVariable(const std::string &name,
-                                   const LLVMValue &value) {
+void LLVMFunction::addCleanup(const LLVMValue &value) {
   if (!scopes_.empty()) {
-    scopes_.back().variables[name] = value;
+    scopes_.back().cleanups.push_back(value);
   }
 }
 
-LLVMValue LLVMFunction::getVariable(const std::string &name) const {
-  // Search scopes from innermost to outermost
-  for (auto it = scopes_.rbegin(); it != scopes_.rend(); ++it) {
-    auto varIt = it->variables.find(name);
-    if (varIt != it->variables.end()) {
-      return varIt->second;
+LLVMValue LLVMFunction::getVariable(core::Symbol name) const {
+  auto it = innermost_.find(name);
+  return it != innermost_.end() ? slots_[it->second].value : LLVMValue();
+}
+
+std::vector<std::pair<core::Symbol, LLVMValue>>
+LLVMFunction::getVisibleVariables() const {
+  std::vector<std::pair<core::Symbol, LLVMValue>> visible;
+  for (size_t slot = 0; slot < slots_.size(); ++slot) {
+    if (innermost_.at(slots_[slot].name) == slot) {
+      visible.emplace_back(slots_[slot].name, slots_[slot].value);
     }
   }
-
-  // Variable not found
-  return LLVMValue();
+  return visible;
 }
 
 llvm::BasicBlock *LLVMFunction::createBasicBlock(const std::string &name) {
@@ -45,14 +66,40 @@ void LLVMFunction::setInsertPoint(llvm::BasicBlock *block) {
   context_.getBuilder().SetInsertPoint(block);
 }
 
-void LLVMFunction::mapParameters(const std::vector<std::string> &paramNames) {
+llvm::AllocaInst *LLVMFunction::createEntryAlloca(llvm::Type *type,
+                                                  const std::string &name) {
+  return createEntryAlloca(*function_, type, name);
+}
+
+llvm::AllocaInst *LLVMFunction::createEntryAlloca(llvm::Function &function,
+                                                  llvm::Type *type,
+                                                  const llvm::Twine &name) {
+  // Keep allocas together, in declaration order, ahead of other code
+  llvm::BasicBlock &entryBlock = function.getEntryBlock();
+  auto insertPoint = entryBlock.begin();
+  while (insertPoint != entryBlock.end() &&
+         llvm::isa<llvm::AllocaInst>(*insertPoint)) {
+    ++insertPoint;
+  }
+
+  llvm::IRBuilder<> entryBuilder(&entryBlock, insertPoint);
+  return entryBuilder.CreateAlloca(type, nullptr, name);
+}
+
+void LLVMFunction::mapParameters(const std::vector<std::string> &paramNames,
+                                 const std::vector<bool> &refParams) {
   // Create entry block for parameter allocations
   llvm::BasicBlock *entryBlock = &function_->getEntryBlock();
   llvm::IRBuilder<> tempBuilder(entryBlock, entryBlock->begin());
 
   unsigned int paramIndex = 0;
   for (auto &arg : function_->args()) {
-    if (paramIndex < paramNames.size()) {
+    if (paramIndex < paramNames.size() && paramNames[paramIndex].empty()) {
+      // Read by the caller of mapParameters, such as an environment
+    } else if (paramIndex < refParams.size() && refParams[paramIndex]) {
+      declareVariable(paramNames[paramIndex],
+                      LLVMValue(&arg, nullptr, true));
+    } else if (paramIndex < paramNames.size()) {
       // Create an allocation for the parameter
       llvm::AllocaInst *alloca = tempBuilder.CreateAlloca(
           arg.getType(), nullptr, paramNames[paramIndex]);
@@ -61,8 +108,7 @@ void LLVMFunction::mapParameters(const std::vector<std::string> &paramNames) {
       context_.getBuilder().CreateStore(&arg, alloca);
 
       // Create a placeholder type for now
-      auto paramType = std::make_shared<visitors::ResolvedType>(
-          visitors::ResolvedType::Int());
+      auto paramType = visitors::TypeContext::instance().getInt();
 
       // Declare the variable in the current scope
       declareVariable(paramNames[paramIndex],
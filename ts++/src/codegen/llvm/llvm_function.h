@@ -1,9 +1,11 @@
 #pragma once
+#include "core/common/interner.h"
 #include "llvm_context.h"
 #include "llvm_value.h"
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace codegen {
@@ -14,6 +16,12 @@ namespace codegen {
  *
  * This class encapsulates function generation, including parameter handling,
  * variable scoping, and basic block management.
+ *
+ * Locals live in one vector in declaration order, each in the slot it was
+ * declared in, and a scope is the slots declared since it was entered. A
+ * table maps the interned name of each variable in scope to its innermost
+ * slot, and each slot remembers the one it hides, so lookups hash a symbol
+ * id and entering a block allocates nothing.
  */
 class LLVMFunction {
 public:
@@ -54,14 +62,45 @@ public:
    * @param name The variable name
    * @param value The variable value
    */
-  void declareVariable(const std::string& name, const LLVMValue& value);
+  void declareVariable(core::Symbol name, const LLVMValue& value);
+  void declareVariable(const std::string& name, const LLVMValue& value) {
+    declareVariable(core::Interner::instance().intern(name), value);
+  }
   
+  /**
+   * @brief Registers an owner to release at scope exit
+   * @param value A smart pointer variable, or the block of a #heap variable,
+   *              with its ownership set
+   */
+  void addCleanup(const LLVMValue& value);
+
+  /**
+   * @brief Gets the owners a scope releases
+   * @param depth Index of the scope, 0 being the function scope
+   * @return The variables in declaration order
+   */
+  const std::vector<LLVMValue>& getCleanups(size_t depth) const {
+    return scopes_[depth].cleanups;
+  }
+
+  /**
+   * @brief Gets the number of open scopes
+   * @return The depth, counting the function scope
+   */
+  size_t getScopeDepth() const { return scopes_.size(); }
+
   /**
    * @brief Looks up a variable in the current and parent scopes
-   * @param name The variable name
+   * @param name The interned variable name
    * @return The variable value, or an invalid value if not found
    */
-  LLVMValue getVariable(const std::string& name) const;
+  LLVMValue getVariable(core::Symbol name) const;
+
+  /**
+   * @brief Gets every variable a lookup can currently find
+   * @return The innermost variable of each name, in declaration order
+   */
+  std::vector<std::pair<core::Symbol, LLVMValue>> getVisibleVariables() const;
 
   /**
    * @brief Creates a new basic block
@@ -76,20 +115,59 @@ public:
    */
   void setInsertPoint(llvm::BasicBlock* block);
 
+  /**
+   * @brief Creates a stack slot at the top of the entry block
+   *
+   * Entry-block allocas are allocated once per call, even when declared
+   * inside a loop, and are what mem2reg and SROA promote.
+   *
+   * @param type The allocated type
+   * @param name The slot name
+   * @return The created alloca
+   */
+  llvm::AllocaInst* createEntryAlloca(llvm::Type* type,
+                                      const std::string& name);
+
+  /**
+   * @brief Creates a stack slot at the top of any function's entry block,
+   * after the slots already there
+   */
+  static llvm::AllocaInst* createEntryAlloca(llvm::Function& function,
+                                             llvm::Type* type,
+                                             const llvm::Twine& name);
+
   /**
    * @brief Creates a function parameter map
+   *
+   * A parameter is copied to a slot of its own, except a ref parameter,
+   * whose argument is the address of the variable it names. An argument
+   * without a name is left unmapped.
+   *
    * @param paramNames Parameter names
+   * @param refParams Whether each parameter is a ref one; none if empty
    */
-  void mapParameters(const std::vector<std::string>& paramNames);
+  void mapParameters(const std::vector<std::string>& paramNames,
+                     const std::vector<bool>& refParams = {});
 
 private:
   LLVMContext& context_;  // The LLVM context
   llvm::Function* function_;  // The LLVM function
   std::shared_ptr<visitors::ResolvedType> returnType_;  // Function return type
   
+  // A declared variable, and the slot of the variable of that name it hides
+  struct Slot {
+    core::Symbol name;
+    LLVMValue value;
+    size_t hidden;
+  };
+  static constexpr size_t kNoSlot = static_cast<size_t>(-1);
+  std::vector<Slot> slots_;
+  std::unordered_map<core::Symbol, size_t> innermost_; // Slot by name
+
   // Variable scopes, with innermost scope at the back
   struct Scope {
-    std::unordered_map<std::string, LLVMValue> variables;
+    size_t firstSlot;                // Slots from here on are the scope's
+    std::vector<LLVMValue> cleanups; // Owners released on exit
   };
   std::vector<Scope> scopes_;
 };
@@ -0,0 +1,171 @@
+#include "codegen/llvm/llvm_heap_to_stack.h"
+#include "codegen/llvm/llvm_function.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/IntrinsicInst.h"
+#include <algorithm>
+
+namespace codegen {
+
+namespace {
+
+// Size and alignment operands of an allocator call, or false if the callee
+// is not an allocator: tspp_alloc(size, align), tspp_new(size, align),
+// tspp_new_at(size, align, site), malloc(size) or aligned_alloc(align, size)
+bool allocatorOperands(const llvm::CallInst *call, llvm::Value *&size,
+                       llvm::Value *&alignment) {
+  llvm::Function *callee = call->getCalledFunction();
+  if (!callee) {
+    return false;
+  }
+  llvm::StringRef name = callee->getName();
+  if (name == "tspp_alloc" || name == "tspp_new" || name == "tspp_new_at") {
+    size = call->getArgOperand(0);
+    alignment = call->getArgOperand(1);
+  } else if (name == "aligned_alloc") {
+    size = call->getArgOperand(1);
+    alignment = call->getArgOperand(0);
+  } else if (name == "malloc") {
+    size = call->getArgOperand(0);
+    alignment = nullptr;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+bool isFree(const llvm::CallInst *call) {
+  llvm::Function *callee = call->getCalledFunction();
+  return callee &&
+         (callee->getName() == "tspp_free" || callee->getName() == "free");
+}
+
+} // namespace
+
+llvm::PreservedAnalyses
+HeapToStackPass::run(llvm::Function &function,
+                     llvm::FunctionAnalysisManager &) {
+  if (promoteAllocations(function) == 0) {
+    return llvm::PreservedAnalyses::all();
+  }
+  llvm::PreservedAnalyses preserved;
+  preserved.preserveSet<llvm::CFGAnalyses>();
+  return preserved;
+}
+
+unsigned HeapToStackPass::promoteAllocations(llvm::Function &function) {
+  if (function.isDeclaration()) {
+    return 0;
+  }
+
+  // Collect first; promotion edits the instruction lists
+  llvm::SmallVector<llvm::CallInst *, 8> allocations;
+  for (auto &block : function) {
+    for (auto &instruction : block) {
+      auto call = llvm::dyn_cast<llvm::CallInst>(&instruction);
+      llvm::Value *size = nullptr;
+      llvm::Value *alignment = nullptr;
+      if (call && allocatorOperands(call, size, alignment)) {
+        allocations.push_back(call);
+      }
+    }
+  }
+
+  unsigned promoted = 0;
+  for (llvm::CallInst *allocation : allocations) {
+    llvm::Value *sizeOperand = nullptr;
+    llvm::Value *alignmentOperand = nullptr;
+    allocatorOperands(allocation, sizeOperand, alignmentOperand);
+    auto size = llvm::dyn_cast<llvm::ConstantInt>(sizeOperand);
+    if (!size || size->isZero() || size->getZExtValue() > kMaxStackBytes) {
+      continue;
+    }
+
+    // The allocator's guarantee without an explicit alignment
+    uint64_t alignment = kMallocAlignment;
+    if (alignmentOperand) {
+      auto requested = llvm::dyn_cast<llvm::ConstantInt>(alignmentOperand);
+      if (!requested || !llvm::isPowerOf2_64(requested->getZExtValue())) {
+        continue;
+      }
+      alignment = std::max(alignment, requested->getZExtValue());
+    }
+
+    llvm::SmallVector<llvm::CallInst *, 4> frees;
+    if (escapes(allocation, frees)) {
+      continue;
+    }
+
+    // One slot per call of the function; the object never outlives it. A
+    // sized array rather than an array allocation, so SROA can split it
+    llvm::AllocaInst *slot = LLVMFunction::createEntryAlloca(
+        function,
+        llvm::ArrayType::get(llvm::Type::getInt8Ty(function.getContext()),
+                             size->getZExtValue()),
+        allocation->getName() + ".stack");
+    llvm::IRBuilder<> builder(slot->getNextNode());
+    slot->setAlignment(llvm::Align(alignment));
+    llvm::Value *bytes = builder.CreateBitCast(slot, allocation->getType(),
+                                               slot->getName() + ".bytes");
+
+    for (llvm::CallInst *release : frees) {
+      release->eraseFromParent();
+    }
+    allocation->replaceAllUsesWith(bytes);
+    allocation->eraseFromParent();
+    ++promoted;
+  }
+  return promoted;
+}
+
+bool HeapToStackPass::escapes(llvm::CallInst *allocation,
+                              llvm::SmallVectorImpl<llvm::CallInst *> &frees) {
+  llvm::SmallVector<llvm::Value *, 8> worklist{allocation};
+  llvm::SmallPtrSet<llvm::Value *, 8> visited{allocation};
+
+  while (!worklist.empty()) {
+    llvm::Value *pointer = worklist.pop_back_val();
+    for (llvm::User *user : pointer->users()) {
+      auto instruction = llvm::dyn_cast<llvm::Instruction>(user);
+      if (!instruction) {
+        return true;
+      }
+
+      if (llvm::isa<llvm::LoadInst>(instruction) ||
+          llvm::isa<llvm::ICmpInst>(instruction)) {
+        continue;
+      }
+      if (auto store = llvm::dyn_cast<llvm::StoreInst>(instruction)) {
+        // Storing through the pointer is fine; storing the pointer is not
+        if (store->getValueOperand() == pointer) {
+          return true;
+        }
+        continue;
+      }
+      if (llvm::isa<llvm::BitCastInst>(instruction) ||
+          llvm::isa<llvm::GetElementPtrInst>(instruction)) {
+        if (visited.insert(instruction).second) {
+          worklist.push_back(instruction);
+        }
+        continue;
+      }
+      if (auto call = llvm::dyn_cast<llvm::CallInst>(instruction)) {
+        if (isFree(call)) {
+          frees.push_back(call);
+          continue;
+        }
+        // memset/memcpy/lifetime markers only touch the bytes
+        if (llvm::isa<llvm::MemIntrinsic>(call) ||
+            call->isLifetimeStartOrEnd()) {
+          continue;
+        }
+      }
+      // Calls, returns, phis, selects, ptrtoint and anything else
+      return true;
+    }
+  }
+  return false;
+}
+
+} // namespace codegen
@@ -0,0 +1,53 @@
+#pragma once
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/PassManager.h"
+
+namespace codegen {
+
+/**
+ * @class HeapToStackPass
+ * @brief Moves heap allocations that never escape into the entry block
+ *
+ * Looks at every constant-size tspp_alloc call in a function (the
+ * allocations emitted for new and #heap), as well as malloc and
+ * aligned_alloc. If the pointer is only
+ * loaded from, stored through, offset, compared or freed, the object dies
+ * with the call, so it is replaced by an entry-block alloca and its frees
+ * are dropped. A pointer that is stored somewhere, passed to another call,
+ * returned, or merged through a phi/select escapes and stays on the heap.
+ *
+ * The pass runs after mem2reg, where locals holding the pointer have
+ * become SSA values.
+ */
+class HeapToStackPass : public llvm::PassInfoMixin<HeapToStackPass> {
+public:
+  // Larger objects stay on the heap to bound stack growth
+  static constexpr uint64_t kMaxStackBytes = 4096;
+
+  // Alignment every allocator guarantees, whatever was requested
+  static constexpr uint64_t kMallocAlignment = 16;
+
+  llvm::PreservedAnalyses run(llvm::Function &function,
+                              llvm::FunctionAnalysisManager &);
+
+  /**
+   * @brief Promotes every non-escaping allocation in a function
+   * @param function The function to transform
+   * @return Number of allocations moved to the stack
+   */
+  static unsigned promoteAllocations(llvm::Function &function);
+
+private:
+  /**
+   * @brief Follows all uses of an allocation through casts and offsets
+   * @param allocation The allocator call
+   * @param frees Receives the free calls that release it
+   * @return True if the pointer may outlive the function
+   */
+  static bool escapes(llvm::CallInst *allocation,
+                      llvm::SmallVectorImpl<llvm::CallInst *> &frees);
+};
+
+} // namespace codegen
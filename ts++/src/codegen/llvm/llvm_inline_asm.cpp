@@ -0,0 +1,163 @@
+#include "codegen/llvm/llvm_inline_asm.h"
+#include <algorithm>
+#include <cctype>
+
+namespace codegen {
+
+namespace {
+
+bool isDigit(char c) { return std::isdigit(static_cast<unsigned char>(c)); }
+
+bool isLetter(char c) { return std::isalpha(static_cast<unsigned char>(c)); }
+
+} // namespace
+
+AsmConstraint AsmConstraint::parse(const std::string &constraint) {
+  AsmConstraint parsed;
+  size_t i = 0;
+  if (i < constraint.size() && (constraint[i] == '=' || constraint[i] == '+')) {
+    parsed.output = true;
+    parsed.readWrite = constraint[i] == '+';
+    ++i;
+  }
+  if (i < constraint.size() && constraint[i] == '&') {
+    parsed.earlyClobber = true;
+    ++i;
+  }
+  parsed.codes = constraint.substr(i);
+  return parsed;
+}
+
+std::string
+InlineAsmTranslator::translateTemplate(const std::string &code,
+                                       const std::vector<std::string> &names,
+                                       std::string &result) const {
+  result.clear();
+  result.reserve(code.size());
+  for (size_t i = 0; i < code.size(); ++i) {
+    char c = code[i];
+    if (c == '$') {
+      result += "$$";
+      continue;
+    }
+    if (c != '%') {
+      result += c;
+      continue;
+    }
+    if (++i == code.size()) {
+      return "Assembly template ends with '%'";
+    }
+    c = code[i];
+    if (c == '%') {
+      result += '%';
+      continue;
+    }
+    if (c == '=') {
+      // A number unique to each copy of the statement, for local labels
+      result += "${:uid}";
+      continue;
+    }
+
+    // %N, %[name], or either after a modifier letter
+    char modifier = 0;
+    if (isLetter(c) && i + 1 < code.size() &&
+        (isDigit(code[i + 1]) || code[i + 1] == '[')) {
+      modifier = c;
+      c = code[++i];
+    }
+    size_t operand = 0;
+    if (c == '[') {
+      size_t close = code.find(']', i);
+      if (close == std::string::npos) {
+        return "Expected ']' after operand name in assembly template";
+      }
+      std::string name = code.substr(i + 1, close - i - 1);
+      auto found = std::find(names.begin(), names.end(), name);
+      if (name.empty() || found == names.end()) {
+        return "Assembly template names no operand '" + name + "'";
+      }
+      operand = found - names.begin();
+      i = close;
+    } else if (isDigit(c)) {
+      while (i < code.size() && isDigit(code[i]) && operand < names.size()) {
+        operand = operand * 10 + (code[i++] - '0');
+      }
+      --i;
+      if (operand >= names.size()) {
+        return "Assembly template refers to operand " +
+               std::to_string(operand) + " of " +
+               std::to_string(names.size());
+      }
+    } else {
+      return std::string("Invalid '%") + c +
+             "' in assembly template; write %% for a literal '%'";
+    }
+    result += modifier ? "${" + std::to_string(operand) + ":" + modifier + "}"
+                       : "$" + std::to_string(operand);
+  }
+  return "";
+}
+
+std::string InlineAsmTranslator::escapeBasic(const std::string &code) {
+  std::string result;
+  result.reserve(code.size());
+  for (char c : code) {
+    result += c;
+    if (c == '$') {
+      result += '$';
+    }
+  }
+  return result;
+}
+
+std::string
+InlineAsmTranslator::translateCodes(const std::string &codes) const {
+  if (!triple_.isX86() || codes.size() != 1) {
+    return codes;
+  }
+  switch (codes[0]) {
+  case 'a':
+    return "{ax}";
+  case 'b':
+    return "{bx}";
+  case 'c':
+    return "{cx}";
+  case 'd':
+    return "{dx}";
+  case 'S':
+    return "{si}";
+  case 'D':
+    return "{di}";
+  default:
+    return codes;
+  }
+}
+
+std::vector<std::string> InlineAsmTranslator::translateClobbers(
+    const std::vector<std::string> &clobbers) const {
+  bool x86 = triple_.isX86();
+  std::vector<std::string> result;
+  auto add = [&result](const std::string &constraint) {
+    if (std::find(result.begin(), result.end(), constraint) == result.end()) {
+      result.push_back(constraint);
+    }
+  };
+  for (std::string clobber : clobbers) {
+    if (!clobber.empty() && clobber[0] == '%') {
+      clobber.erase(0, 1);
+    }
+    // x86 calls the condition codes flags, which are clobbered anyway
+    if (clobber.empty() || (x86 && clobber == "cc")) {
+      continue;
+    }
+    add("~{" + clobber + "}");
+  }
+  if (x86) {
+    add("~{dirflag}");
+    add("~{fpsr}");
+    add("~{flags}");
+  }
+  return result;
+}
+
+} // namespace codegen
@@ -0,0 +1,83 @@
+/*****************************************************************************
+ * File: llvm_inline_asm.h
+ * Description: Translation of GCC-style #asm statements to LLVM inline asm
+ *****************************************************************************/
+
+#pragma once
+#include "llvm/ADT/Triple.h"
+#include <string>
+#include <vector>
+
+namespace codegen {
+
+/**
+ * @brief An operand constraint as GCC writes it, taken apart
+ */
+struct AsmConstraint {
+  bool output = false;       ///< Starts with '=' or '+'
+  bool readWrite = false;    ///< '+': the output's value is also read
+  bool earlyClobber = false; ///< '&': written before all inputs are read
+  std::string codes;         ///< What is left: "r", "m", "a", "0", ...
+
+  /// Whether the operand is the memory at an address, not a value
+  bool isMemory() const { return codes == "m"; }
+
+  /**
+   * @brief Takes a constraint apart
+   * @param constraint The constraint without its quotes
+   */
+  static AsmConstraint parse(const std::string &constraint);
+};
+
+/**
+ * @class InlineAsmTranslator
+ * @brief Rewrites #asm statements in the form llvm::InlineAsm takes
+ *
+ * GCC names operand N of a template %N, %[name], or %kN with the operand
+ * modifier k, and writes a literal % as %%; LLVM writes them $N and ${N:k}
+ * and a literal $ as $$. Operands are numbered GCC's way, outputs before
+ * inputs, so a '+' operand's hidden input goes after all of them. x86's
+ * one-register constraints name their register, and each clobber becomes
+ * ~{reg}; on x86 every statement also clobbers the flags and the direction
+ * flag, which GCC assumes too.
+ */
+class InlineAsmTranslator {
+public:
+  explicit InlineAsmTranslator(const llvm::Triple &triple) : triple_(triple) {}
+
+  /**
+   * @brief Translates the template of a statement with operands
+   * @param code The template, escapes resolved
+   * @param names The symbolic name of each operand, empty for none
+   * @param result Receives LLVM's template
+   * @return An empty string, or what is wrong with the template
+   */
+  std::string translateTemplate(const std::string &code,
+                                const std::vector<std::string> &names,
+                                std::string &result) const;
+
+  /**
+   * @brief Escapes the code of a statement without operands, in which
+   * only $ means something to LLVM
+   */
+  static std::string escapeBasic(const std::string &code);
+
+  /**
+   * @brief Translates the codes of a constraint, such as x86's "a" for
+   * eax, which LLVM writes "{ax}"
+   */
+  std::string translateCodes(const std::string &codes) const;
+
+  /**
+   * @brief Gets the constraints a statement's clobbers add, including the
+   * target's implicit ones
+   * @param clobbers Registers, "cc" and "memory", without their quotes
+   */
+  std::vector<std::string>
+  translateClobbers(const std::vector<std::string> &clobbers) const;
+
+private:
+  const llvm::Triple &triple_;
+};
+
+} // namespace codegen
@@ -0,0 +1,152 @@
+#include "codegen/llvm/llvm_inline_hints.h"
+#include "llvm/ADT/SCCIterator.h"
+#include "llvm/Analysis/CallGraph.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
+
+namespace codegen {
+
+namespace {
+
+// A load or store of a local's slot, which mem2reg removes
+bool accessesSlot(const llvm::Instruction &instruction) {
+  const llvm::Value *pointer = nullptr;
+  if (auto load = llvm::dyn_cast<llvm::LoadInst>(&instruction)) {
+    pointer = load->getPointerOperand();
+  } else if (auto store = llvm::dyn_cast<llvm::StoreInst>(&instruction)) {
+    pointer = store->getPointerOperand();
+  }
+  return pointer && llvm::isa<llvm::AllocaInst>(pointer);
+}
+
+// Functions whose attributes already settle the question
+bool isDecided(const llvm::Function &function) {
+  return function.isDeclaration() || function.isVarArg() ||
+         function.hasFnAttribute(llvm::Attribute::AlwaysInline) ||
+         function.hasFnAttribute(llvm::Attribute::NoInline) ||
+         function.hasFnAttribute(llvm::Attribute::Cold) ||
+         function.hasFnAttribute(llvm::Attribute::OptimizeNone) ||
+         // Async functions must reach CoroSplit before they can inline
+         function.hasFnAttribute("coroutine.presplit") ||
+         // #target versions may only run where their features exist
+         function.hasFnAttribute("target-features") ||
+         function.hasFnAttribute("target-cpu");
+}
+
+} // namespace
+
+llvm::PreservedAnalyses InlineHintPass::run(llvm::Module &module,
+                                            llvm::ModuleAnalysisManager &) {
+  annotate(module, optimizeForSize_);
+  // Attributes only; no analysis looks at them
+  return llvm::PreservedAnalyses::all();
+}
+
+unsigned InlineHintPass::annotate(llvm::Module &module,
+                                  bool optimizeForSize) {
+  llvm::DenseSet<const llvm::Function *> recursive = findRecursive(module);
+
+  unsigned annotated = 0;
+  for (auto &function : module) {
+    if (isDecided(function) || recursive.count(&function)) {
+      continue;
+    }
+
+    if (isStraightLine(function)) {
+      unsigned budget = isPackedMethod(function) ? kPackedMethodBudget
+                                                 : kAccessorBudget;
+      if (cost(function) <= budget) {
+        function.addFnAttr(llvm::Attribute::AlwaysInline);
+        ++annotated;
+        continue;
+      }
+    }
+
+    if (optimizeForSize) {
+      continue;
+    }
+    unsigned calls = 0;
+    bool addressTaken = false;
+    for (const llvm::Use &use : function.uses()) {
+      auto call = llvm::dyn_cast<llvm::CallBase>(use.getUser());
+      if (call && call->isCallee(&use)) {
+        ++calls;
+      } else {
+        addressTaken = true;
+      }
+    }
+    if ((calls == 1 && !addressTaken) || takesClosure(function)) {
+      function.addFnAttr(llvm::Attribute::InlineHint);
+      ++annotated;
+    }
+  }
+  return annotated;
+}
+
+unsigned InlineHintPass::cost(const llvm::Function &function) {
+  unsigned weight = 0;
+  for (const auto &instruction : llvm::instructions(function)) {
+    if (llvm::isa<llvm::AllocaInst>(instruction) ||
+        llvm::isa<llvm::DbgInfoIntrinsic>(instruction) ||
+        accessesSlot(instruction)) {
+      continue;
+    }
+    ++weight;
+  }
+  return weight;
+}
+
+llvm::DenseSet<const llvm::Function *>
+InlineHintPass::findRecursive(llvm::Module &module) {
+  llvm::DenseSet<const llvm::Function *> recursive;
+  llvm::CallGraph graph(module);
+  for (auto scc = llvm::scc_begin(&graph); !scc.isAtEnd(); ++scc) {
+    if (!scc.hasCycle()) {
+      continue;
+    }
+    for (llvm::CallGraphNode *node : *scc) {
+      if (node->getFunction()) {
+        recursive.insert(node->getFunction());
+      }
+    }
+  }
+  return recursive;
+}
+
+bool InlineHintPass::isStraightLine(const llvm::Function &function) {
+  if (function.size() != 1) {
+    return false;
+  }
+  for (const auto &instruction : function.getEntryBlock()) {
+    auto call = llvm::dyn_cast<llvm::CallBase>(&instruction);
+    if (call && !llvm::isa<llvm::IntrinsicInst>(call)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool InlineHintPass::isPackedMethod(const llvm::Function &function) {
+  if (function.arg_empty() || function.getArg(0)->getName() != "this") {
+    return false;
+  }
+  auto pointer =
+      llvm::dyn_cast<llvm::PointerType>(function.getArg(0)->getType());
+  auto object = pointer ? llvm::dyn_cast<llvm::StructType>(
+                              pointer->getPointerElementType())
+                        : nullptr;
+  return object && object->isPacked();
+}
+
+bool InlineHintPass::takesClosure(const llvm::Function &function) {
+  for (const auto &arg : function.args()) {
+    auto type = llvm::dyn_cast<llvm::StructType>(arg.getType());
+    if (type && type->hasName() && type->getName().startswith("closure")) {
+      return true;
+    }
+  }
+  return false;
+}
+
+} // namespace codegen
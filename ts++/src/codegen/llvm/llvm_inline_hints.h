@@ -0,0 +1,82 @@
+#pragma once
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/PassManager.h"
+
+namespace codegen {
+
+/**
+ * @class InlineHintPass
+ * @brief Decides ahead of LLVM's inliner which tspp functions to inline
+ *
+ * Generated code calls tiny methods far more often than LLVM's cost model
+ * expects, and at pipeline start each of them still spills its arguments
+ * to stack slots, which makes them look larger than they are. This pass
+ * runs before any simplification and weighs each function by what will
+ * be left of it once its slots are promoted:
+ *
+ * - An accessor, a straight-line body of field loads and stores with no
+ *   calls, is made alwaysinline, so a getter collapses to a field load.
+ * - A method of a #packed class gets the same treatment at a larger
+ *   budget, since such classes are small values whose methods are meant
+ *   to disappear into their callers.
+ * - A function called from exactly one place, whose address is never
+ *   taken, gets inlinehint; inlining it moves code rather than copying it.
+ *   Size levels leave this to LLVM.
+ * - A function with a function value parameter, such as a map or filter
+ *   helper, also gets inlinehint: where it is inlined, the value is
+ *   usually known, its indirect calls become direct, and LLVM's inliner
+ *   goes back for them. Size levels leave this to LLVM too.
+ *
+ * Recursive functions, #cold and noinline functions, and #target versions
+ * are never touched, and #inline functions are already decided.
+ */
+class InlineHintPass : public llvm::PassInfoMixin<InlineHintPass> {
+public:
+  // Weighted instructions an accessor may have
+  static constexpr unsigned kAccessorBudget = 8;
+
+  // Weighted instructions a #packed class method may have
+  static constexpr unsigned kPackedMethodBudget = 32;
+
+  explicit InlineHintPass(bool optimizeForSize = false)
+      : optimizeForSize_(optimizeForSize) {}
+
+  llvm::PreservedAnalyses run(llvm::Module &module,
+                              llvm::ModuleAnalysisManager &);
+
+  /**
+   * @brief Adds the inlining attributes to every function of a module
+   * @param module The module, before it is optimized
+   * @param optimizeForSize Whether to leave single-call functions alone
+   * @return Number of functions given an attribute
+   */
+  static unsigned annotate(llvm::Module &module, bool optimizeForSize);
+
+  /**
+   * @brief Weighs a function by what remains after its slots are promoted
+   * @param function A function definition
+   * @return Instructions other than allocas, loads and stores of their
+   * slots, and debug intrinsics
+   */
+  static unsigned cost(const llvm::Function &function);
+
+private:
+  // Functions that can reach themselves through direct calls
+  static llvm::DenseSet<const llvm::Function *>
+  findRecursive(llvm::Module &module);
+
+  // One block, and no calls other than to intrinsics
+  static bool isStraightLine(const llvm::Function &function);
+
+  // A method whose this is a #packed class
+  static bool isPackedMethod(const llvm::Function &function);
+
+  // A parameter is a closure, a { code, environment } pair
+  static bool takesClosure(const llvm::Function &function);
+
+  bool optimizeForSize_;
+};
+
+} // namespace codegen
@@ -0,0 +1,166 @@
+#include "codegen/llvm/llvm_instrumentation.h"
+#include "core/common/source_manager.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/Transforms/Utils/ModuleUtils.h"
+
+namespace codegen {
+
+namespace {
+
+// "file:line:column", resolved through the SourceManager
+std::string describe(const core::SourceLocation &location) {
+  const std::string &file = location.getFilename();
+  return (file.empty() ? "<unknown>" : file) + ":" +
+         std::to_string(location.getLine()) + ":" +
+         std::to_string(location.getColumn());
+}
+
+} // namespace
+
+LLVMInstrumentation::LLVMInstrumentation(llvm::Module &module)
+    : module_(module) {}
+
+void LLVMInstrumentation::countFunction(llvm::IRBuilderBase &builder,
+                                        const std::string &function,
+                                        const core::SourceLocation &location) {
+  count(builder, describe(location) + " function " + function);
+}
+
+void LLVMInstrumentation::countLoop(llvm::IRBuilderBase &builder,
+                                    const std::string &function,
+                                    const core::SourceLocation &location) {
+  count(builder, describe(location) + " loop in " + function);
+}
+
+llvm::Constant *
+LLVMInstrumentation::allocationSite(const std::string &function,
+                                   const std::string &type, uint64_t size,
+                                   const core::SourceLocation &location) {
+  llvm::LLVMContext &context = module_.getContext();
+  llvm::Type *bytePtr = llvm::Type::getInt8PtrTy(context);
+  llvm::Type *int32 = llvm::Type::getInt32Ty(context);
+  llvm::Type *int64 = llvm::Type::getInt64Ty(context);
+
+  // The runtime's tspp_alloc_site
+  auto *siteType = llvm::StructType::getTypeByName(context, "tspp_alloc_site");
+  if (!siteType) {
+    siteType = llvm::StructType::create(
+        context, {bytePtr, bytePtr, bytePtr, int32, int32, int64},
+        "tspp_alloc_site");
+  }
+  const std::string &file = location.getFilename();
+  auto *site = new llvm::GlobalVariable(
+      module_, siteType, true, llvm::GlobalValue::PrivateLinkage,
+      llvm::ConstantStruct::get(
+          siteType,
+          {getString(function, "__tspp_alloc_function"),
+           getString(file.empty() ? "<unknown>" : file, "__tspp_alloc_file"),
+           getString(type, "__tspp_alloc_type"),
+           llvm::ConstantInt::get(int32, location.getLine()),
+           llvm::ConstantInt::get(int32, location.getColumn()),
+           llvm::ConstantInt::get(int64, size)}),
+      "__tspp_alloc_site");
+  return llvm::ConstantExpr::getPointerCast(site, bytePtr);
+}
+
+llvm::Constant *LLVMInstrumentation::getString(const std::string &text,
+                                               const char *name) {
+  llvm::LLVMContext &context = module_.getContext();
+  auto *value = llvm::ConstantDataArray::getString(context, text);
+  auto *global =
+      new llvm::GlobalVariable(module_, value->getType(), true,
+                               llvm::GlobalValue::PrivateLinkage, value, name);
+  global->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+  return llvm::ConstantExpr::getPointerCast(global,
+                                            llvm::Type::getInt8PtrTy(context));
+}
+
+void LLVMInstrumentation::count(llvm::IRBuilderBase &builder,
+                                const std::string &site) {
+  llvm::Type *int64 = builder.getInt64Ty();
+  auto *counter = new llvm::GlobalVariable(
+      module_, int64, false, llvm::GlobalValue::InternalLinkage,
+      builder.getInt64(0), "__tspp_count", nullptr,
+      llvm::GlobalValue::InitialExecTLSModel);
+  counters_.push_back(counter);
+  sites_.push_back(site);
+
+  llvm::Value *value = builder.CreateLoad(int64, counter, "count");
+  builder.CreateStore(builder.CreateAdd(value, builder.getInt64(1)), counter);
+}
+
+void LLVMInstrumentation::finalize() {
+  if (counters_.empty()) {
+    return;
+  }
+  llvm::LLVMContext &context = module_.getContext();
+  llvm::IRBuilder<> builder(context);
+  llvm::Type *int64 = builder.getInt64Ty();
+  llvm::Type *bytePtr = builder.getInt8PtrTy();
+  auto *voidFunction = llvm::FunctionType::get(builder.getVoidTy(), false);
+
+  auto *totalsType = llvm::ArrayType::get(int64, counters_.size());
+  auto *totals = new llvm::GlobalVariable(
+      module_, totalsType, false, llvm::GlobalValue::InternalLinkage,
+      llvm::ConstantAggregateZero::get(totalsType), "__tspp_count_totals");
+
+  std::vector<llvm::Constant *> descriptions;
+  for (const auto &site : sites_) {
+    descriptions.push_back(getString(site, "__tspp_count_site"));
+  }
+  auto *sitesType = llvm::ArrayType::get(bytePtr, sites_.size());
+  auto *sites = new llvm::GlobalVariable(
+      module_, sitesType, true, llvm::GlobalValue::InternalLinkage,
+      llvm::ConstantArray::get(sitesType, descriptions), "__tspp_count_sites");
+
+  // Adds the calling thread's counts to the totals and starts it over
+  auto *flush =
+      llvm::Function::Create(voidFunction, llvm::GlobalValue::InternalLinkage,
+                             "__tspp_count_flush", module_);
+  flush->setDoesNotThrow();
+  builder.SetInsertPoint(llvm::BasicBlock::Create(context, "entry", flush));
+  for (size_t i = 0; i < counters_.size(); ++i) {
+    llvm::Value *value = builder.CreateLoad(int64, counters_[i]);
+    builder.CreateAtomicRMW(
+        llvm::AtomicRMWInst::Add,
+        builder.CreateConstInBoundsGEP2_64(totalsType, totals, 0, i), value,
+        llvm::MaybeAlign(8), llvm::AtomicOrdering::Monotonic);
+    builder.CreateStore(builder.getInt64(0), counters_[i]);
+  }
+  builder.CreateRetVoid();
+
+  // The runtime's tspp_counters, linked into its list by registration
+  auto *tableType = llvm::StructType::create(context, "tspp_counters");
+  tableType->setBody({int64, int64->getPointerTo(), bytePtr->getPointerTo(),
+                      flush->getType(), tableType->getPointerTo()});
+  auto *table = new llvm::GlobalVariable(
+      module_, tableType, false, llvm::GlobalValue::InternalLinkage,
+      llvm::ConstantStruct::get(
+          tableType,
+          {builder.getInt64(counters_.size()),
+           llvm::ConstantExpr::getInBoundsGetElementPtr(
+               totalsType, totals,
+               llvm::ArrayRef<llvm::Constant *>{builder.getInt64(0),
+                                                builder.getInt64(0)}),
+           llvm::ConstantExpr::getInBoundsGetElementPtr(
+               sitesType, sites,
+               llvm::ArrayRef<llvm::Constant *>{builder.getInt64(0),
+                                                builder.getInt64(0)}),
+           flush, llvm::ConstantPointerNull::get(tableType->getPointerTo())}),
+      "__tspp_counters");
+
+  auto registerType = llvm::FunctionType::get(
+      builder.getVoidTy(), {tableType->getPointerTo()}, false);
+  llvm::FunctionCallee registerCounters =
+      module_.getOrInsertFunction("tspp_counters_register", registerType);
+  auto *constructor =
+      llvm::Function::Create(voidFunction, llvm::GlobalValue::InternalLinkage,
+                             "__tspp_count_register", module_);
+  builder.SetInsertPoint(
+      llvm::BasicBlock::Create(context, "entry", constructor));
+  builder.CreateCall(registerCounters, {table});
+  builder.CreateRetVoid();
+  llvm::appendToGlobalCtors(module_, constructor, 0);
+}
+
+} // namespace codegen
@@ -0,0 +1,83 @@
+#pragma once
+#include "core/common/common_types.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Module.h"
+#include <string>
+#include <vector>
+
+namespace codegen {
+
+/**
+ * @class LLVMInstrumentation
+ * @brief Counts function entries and loop iterations for -instrument=,
+ * and describes new expressions for -alloc-profile
+ *
+ * Each counted site gets a thread-local 64-bit counter, so counting is a
+ * load, an add and a store with no atomics or sharing between cores. A
+ * generated flush function adds the calling thread's counters to the
+ * module's totals; the runtime calls it when a #parallel worker finishes
+ * a chunk and on exit, then writes every site's total with the location
+ * it was compiled from (see tspp_counters in tspp_runtime.h).
+ *
+ * Profiled new expressions pass a constant tspp_alloc_site to the
+ * allocator, which keeps the statistics itself.
+ */
+class LLVMInstrumentation {
+public:
+  /**
+   * @brief Starts counting in a module
+   * @param module The module being generated
+   */
+  explicit LLVMInstrumentation(llvm::Module &module);
+
+  /**
+   * @brief Counts a function's entries; call at the start of its body
+   * @param builder The builder emitting the body
+   * @param function The function's name
+   * @param location Where it is defined
+   */
+  void countFunction(llvm::IRBuilderBase &builder, const std::string &function,
+                     const core::SourceLocation &location);
+
+  /**
+   * @brief Counts a loop's iterations; call at the start of its body
+   * @param builder The builder emitting the body
+   * @param function The name of the function holding the loop
+   * @param location Where the loop is
+   */
+  void countLoop(llvm::IRBuilderBase &builder, const std::string &function,
+                 const core::SourceLocation &location);
+
+  /**
+   * @brief Gets the descriptor of a profiled new expression, for
+   * tspp_new_at or tspp_shared_alloc_at
+   * @param function The name of the function holding the expression
+   * @param type The class of the object
+   * @param size Bytes of the object
+   * @param location Where the expression is
+   * @return Pointer to a constant tspp_alloc_site, as an i8*
+   */
+  llvm::Constant *allocationSite(const std::string &function,
+                                 const std::string &type, uint64_t size,
+                                 const core::SourceLocation &location);
+
+  /**
+   * @brief Emits the totals, the flush function and the registration of
+   * the module's counters; call once the module is complete
+   */
+  void finalize();
+
+private:
+  // Adds a counter for a site described as "file:line:column kind name"
+  void count(llvm::IRBuilderBase &builder, const std::string &site);
+
+  // A private constant holding text, as an i8*
+  llvm::Constant *getString(const std::string &text, const char *name);
+
+  llvm::Module &module_;
+  std::vector<llvm::GlobalVariable *> counters_; // Thread-local, per site
+  std::vector<std::string> sites_;               // Descriptions, per site
+};
+
+} // namespace codegen
@@ -0,0 +1,393 @@
+#include "codegen/llvm/llvm_jit.h"
+#include "codegen/llvm/llvm_utils.h"
+#include "runtime/tspp_runtime.h"
+#include "llvm/ExecutionEngine/Orc/CompileUtils.h"
+#include "llvm/ExecutionEngine/Orc/ExecutionUtils.h"
+#include "llvm/ExecutionEngine/Orc/RTDyldObjectLinkingLayer.h"
+#include "llvm/ExecutionEngine/SectionMemoryManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Object/SymbolSize.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/raw_ostream.h"
+#include <mutex>
+
+namespace codegen {
+
+namespace {
+
+/**
+ * Appends "address size name" lines for the functions of each loaded
+ * object to /tmp/perf-<pid>.map, where perf looks up addresses it finds
+ * in no mapped file. Lazily compiled functions may be loaded from any
+ * thread that first calls them.
+ */
+class PerfMapWriter : public llvm::JITEventListener {
+public:
+  PerfMapWriter() {
+    std::string path = "/tmp/perf-" +
+                       std::to_string(llvm::sys::Process::getProcessId()) +
+                       ".map";
+    std::error_code error;
+    out_ = std::make_unique<llvm::raw_fd_ostream>(path, error,
+                                                  llvm::sys::fs::OF_Append);
+    if (error) {
+      out_.reset();
+    }
+  }
+
+  void notifyObjectLoaded(
+      ObjectKey, const llvm::object::ObjectFile &object,
+      const llvm::RuntimeDyld::LoadedObjectInfo &info) override {
+    if (!out_) {
+      return;
+    }
+    // The debug object has the sections at their load addresses
+    llvm::object::OwningBinary<llvm::object::ObjectFile> loaded =
+        info.getObjectForDebug(object);
+    if (!loaded.getBinary()) {
+      return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto &[symbol, size] :
+         llvm::object::computeSymbolSizes(*loaded.getBinary())) {
+      auto type = symbol.getType();
+      auto name = symbol.getName();
+      auto address = symbol.getAddress();
+      if (!type || !name || !address) {
+        llvm::consumeError(type.takeError());
+        llvm::consumeError(name.takeError());
+        llvm::consumeError(address.takeError());
+        continue;
+      }
+      if (*type != llvm::object::SymbolRef::ST_Function || size == 0) {
+        continue;
+      }
+      *out_ << llvm::format("%llx %llx ",
+                            static_cast<unsigned long long>(*address),
+                            static_cast<unsigned long long>(size))
+            << LLVMUtils::demangleFunctionName(sourceSymbol(*name)) << "\n";
+    }
+    out_->flush();
+  }
+
+private:
+  // Lazy compilation gives internal functions it splits off a module
+  // external names, __orc_lcl.<name>.<n>
+  static std::string sourceSymbol(llvm::StringRef name) {
+    if (name.consume_front("__orc_lcl.")) {
+      llvm::StringRef counter = name.rsplit('.').second;
+      if (!counter.empty() &&
+          counter.find_first_not_of("0123456789") == llvm::StringRef::npos) {
+        name = name.drop_back(counter.size() + 1);
+      }
+    }
+    return name.str();
+  }
+
+  std::unique_ptr<llvm::raw_fd_ostream> out_;
+  std::mutex mutex_;
+};
+
+} // namespace
+
+bool LLVMJIT::initialize() {
+  if (jit_) {
+    return true;
+  }
+
+  llvm::InitializeNativeTarget();
+  llvm::InitializeNativeTargetAsmPrinter();
+  llvm::InitializeNativeTargetAsmParser();
+
+  auto targetBuilder = llvm::orc::JITTargetMachineBuilder::detectHost();
+  if (!targetBuilder) {
+    return fail(targetBuilder.takeError());
+  }
+  llvm::orc::LLLazyJITBuilder builder;
+  builder.setJITTargetMachineBuilder(*targetBuilder);
+
+  // Cached objects are only valid for the exact target they were built for
+  if (!cacheDirectory_.empty()) {
+    std::string target = targetBuilder->getTargetTriple().str() + " " +
+                         targetBuilder->getCPU() + " " +
+                         targetBuilder->getFeatures().getString();
+    cache_ = std::make_unique<LLVMObjectCache>(cacheDirectory_, target);
+    builder.setCompileFunctionCreator(
+        [cache = cache_.get()](llvm::orc::JITTargetMachineBuilder machine)
+            -> llvm::Expected<
+                std::unique_ptr<llvm::orc::IRCompileLayer::IRCompiler>> {
+          auto targetMachine = machine.createTargetMachine();
+          if (!targetMachine) {
+            return targetMachine.takeError();
+          }
+          return std::make_unique<llvm::orc::TMOwningSimpleCompiler>(
+              std::move(*targetMachine), cache);
+        });
+  }
+
+  // Profilers learn of each object as the linking layer loads it
+  if (profiling_) {
+    perfMap_ = std::make_unique<PerfMapWriter>();
+    builder.setObjectLinkingLayerCreator(
+        [this](llvm::orc::ExecutionSession &session, const llvm::Triple &)
+            -> llvm::Expected<std::unique_ptr<llvm::orc::ObjectLayer>> {
+          auto layer = std::make_unique<llvm::orc::RTDyldObjectLinkingLayer>(
+              session, [] {
+                return std::make_unique<llvm::SectionMemoryManager>();
+              });
+          layer->registerJITEventListener(*perfMap_);
+          for (llvm::JITEventListener *listener :
+               {llvm::JITEventListener::createPerfJITEventListener(),
+                llvm::JITEventListener::createIntelJITEventListener()}) {
+            if (listener) {
+              layer->registerJITEventListener(*listener);
+            }
+          }
+          return layer;
+        });
+  }
+
+  auto jit = builder.create();
+  if (!jit) {
+    return fail(jit.takeError());
+  }
+
+  // Keep materialization errors for the caller instead of printing them
+  (*jit)->getExecutionSession().setErrorReporter([this](llvm::Error error) {
+    if (!sessionErrors_.empty()) {
+      sessionErrors_ += "; ";
+    }
+    sessionErrors_ += llvm::toString(std::move(error));
+  });
+
+  // Let generated code call into the C library linked into this process
+  auto &dylib = (*jit)->getMainJITDylib();
+  auto generator =
+      llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+          (*jit)->getDataLayout().getGlobalPrefix());
+  if (!generator) {
+    return fail(generator.takeError());
+  }
+  dylib.addGenerator(std::move(*generator));
+
+  // The runtime is linked into this binary but not exported from it
+  llvm::orc::MangleAndInterner mangle((*jit)->getExecutionSession(),
+                                      (*jit)->getDataLayout());
+  const std::pair<const char *, llvm::JITEvaluatedSymbol> runtime[] = {
+      {"tspp_alloc", llvm::JITEvaluatedSymbol::fromPointer(&tspp_alloc)},
+      {"tspp_new", llvm::JITEvaluatedSymbol::fromPointer(&tspp_new)},
+      {"tspp_alloc_count",
+       llvm::JITEvaluatedSymbol::fromPointer(&tspp_alloc_count)},
+      {"tspp_arena_enter",
+       llvm::JITEvaluatedSymbol::fromPointer(&tspp_arena_enter)},
+      {"tspp_arena_exit",
+       llvm::JITEvaluatedSymbol::fromPointer(&tspp_arena_exit)},
+      {"tspp_free", llvm::JITEvaluatedSymbol::fromPointer(&tspp_free)},
+      {"tspp_shared_alloc",
+       llvm::JITEvaluatedSymbol::fromPointer(&tspp_shared_alloc)},
+      {"tspp_shared_publish",
+       llvm::JITEvaluatedSymbol::fromPointer(&tspp_shared_publish)},
+      {"tspp_shared_retain",
+       llvm::JITEvaluatedSymbol::fromPointer(&tspp_shared_retain)},
+      {"tspp_shared_release",
+       llvm::JITEvaluatedSymbol::fromPointer(&tspp_shared_release)},
+      {"tspp_shared_collect",
+       llvm::JITEvaluatedSymbol::fromPointer(&tspp_shared_collect)},
+      {"tspp_weak_retain",
+       llvm::JITEvaluatedSymbol::fromPointer(&tspp_weak_retain)},
+      {"tspp_weak_release",
+       llvm::JITEvaluatedSymbol::fromPointer(&tspp_weak_release)},
+      {"tspp_weak_lock", llvm::JITEvaluatedSymbol::fromPointer(&tspp_weak_lock)},
+      {"tspp_throw", llvm::JITEvaluatedSymbol::fromPointer(&tspp_throw)},
+      {"tspp_catch", llvm::JITEvaluatedSymbol::fromPointer(&tspp_catch)},
+      {"tspp_personality",
+       llvm::JITEvaluatedSymbol::fromPointer(&tspp_personality)},
+      {"tspp_string_concat",
+       llvm::JITEvaluatedSymbol::fromPointer(&tspp_string_concat)},
+      {"tspp_string_equals",
+       llvm::JITEvaluatedSymbol::fromPointer(&tspp_string_equals)},
+      {"tspp_string_free",
+       llvm::JITEvaluatedSymbol::fromPointer(&tspp_string_free)},
+      {"tspp_array_grow",
+       llvm::JITEvaluatedSymbol::fromPointer(&tspp_array_grow)},
+      {"tspp_array_reserve",
+       llvm::JITEvaluatedSymbol::fromPointer(&tspp_array_reserve)},
+      {"tspp_array_free",
+       llvm::JITEvaluatedSymbol::fromPointer(&tspp_array_free)},
+      {"tspp_bounds_fail",
+       llvm::JITEvaluatedSymbol::fromPointer(&tspp_bounds_fail)},
+      {"tspp_runtime_fail",
+       llvm::JITEvaluatedSymbol::fromPointer(&tspp_runtime_fail)},
+      {"tspp_cpu_supports",
+       llvm::JITEvaluatedSymbol::fromPointer(&tspp_cpu_supports)},
+      {"tspp_write", llvm::JITEvaluatedSymbol::fromPointer(&tspp_write)},
+      {"tspp_write_int",
+       llvm::JITEvaluatedSymbol::fromPointer(&tspp_write_int)},
+      {"tspp_write_float",
+       llvm::JITEvaluatedSymbol::fromPointer(&tspp_write_float)},
+      {"tspp_flush", llvm::JITEvaluatedSymbol::fromPointer(&tspp_flush)},
+      {"tspp_map_file",
+       llvm::JITEvaluatedSymbol::fromPointer(&tspp_map_file)},
+      {"tspp_unmap_file",
+       llvm::JITEvaluatedSymbol::fromPointer(&tspp_unmap_file)},
+      {"tspp_task_complete",
+       llvm::JITEvaluatedSymbol::fromPointer(&tspp_task_complete)},
+      {"tspp_task_spawn",
+       llvm::JITEvaluatedSymbol::fromPointer(&tspp_task_spawn)},
+      {"tspp_task_run", llvm::JITEvaluatedSymbol::fromPointer(&tspp_task_run)},
+      {"tspp_async_sleep",
+       llvm::JITEvaluatedSymbol::fromPointer(&tspp_async_sleep)},
+      {"tspp_async_wait_fd",
+       llvm::JITEvaluatedSymbol::fromPointer(&tspp_async_wait_fd)},
+      {"tspp_parallel_for",
+       llvm::JITEvaluatedSymbol::fromPointer(&tspp_parallel_for)},
+      {"tspp_parallel_uncaught",
+       llvm::JITEvaluatedSymbol::fromPointer(&tspp_parallel_uncaught)},
+      {"tspp_mpmc_new", llvm::JITEvaluatedSymbol::fromPointer(&tspp_mpmc_new)},
+      {"tspp_mpmc_try_push",
+       llvm::JITEvaluatedSymbol::fromPointer(&tspp_mpmc_try_push)},
+      {"tspp_mpmc_try_pop",
+       llvm::JITEvaluatedSymbol::fromPointer(&tspp_mpmc_try_pop)},
+      {"tspp_mpmc_push",
+       llvm::JITEvaluatedSymbol::fromPointer(&tspp_mpmc_push)},
+      {"tspp_mpmc_pop", llvm::JITEvaluatedSymbol::fromPointer(&tspp_mpmc_pop)},
+      {"tspp_spsc_new", llvm::JITEvaluatedSymbol::fromPointer(&tspp_spsc_new)},
+      {"tspp_spsc_try_push",
+       llvm::JITEvaluatedSymbol::fromPointer(&tspp_spsc_try_push)},
+      {"tspp_spsc_try_pop",
+       llvm::JITEvaluatedSymbol::fromPointer(&tspp_spsc_try_pop)},
+      {"tspp_spsc_push",
+       llvm::JITEvaluatedSymbol::fromPointer(&tspp_spsc_push)},
+      {"tspp_spsc_pop", llvm::JITEvaluatedSymbol::fromPointer(&tspp_spsc_pop)},
+      {"tspp_map_new", llvm::JITEvaluatedSymbol::fromPointer(&tspp_map_new)},
+      {"tspp_map_put", llvm::JITEvaluatedSymbol::fromPointer(&tspp_map_put)},
+      {"tspp_map_get", llvm::JITEvaluatedSymbol::fromPointer(&tspp_map_get)},
+      {"tspp_map_remove",
+       llvm::JITEvaluatedSymbol::fromPointer(&tspp_map_remove)},
+      {"tspp_map_size", llvm::JITEvaluatedSymbol::fromPointer(&tspp_map_size)},
+      {"tspp_counters_register",
+       llvm::JITEvaluatedSymbol::fromPointer(&tspp_counters_register)},
+      {"tspp_new_at", llvm::JITEvaluatedSymbol::fromPointer(&tspp_new_at)},
+      {"tspp_shared_alloc_at",
+       llvm::JITEvaluatedSymbol::fromPointer(&tspp_shared_alloc_at)},
+  };
+  llvm::orc::SymbolMap symbols;
+  for (const auto &entry : runtime) {
+    symbols[mangle(entry.first)] = entry.second;
+  }
+  if (auto error = dylib.define(llvm::orc::absoluteSymbols(symbols))) {
+    return fail(std::move(error));
+  }
+
+  jit_ = std::move(*jit);
+  return true;
+}
+
+bool LLVMJIT::addModule(llvm::orc::ThreadSafeModule module) {
+  if (!initialize()) {
+    return false;
+  }
+
+  // The module is compiled for the host, whatever it was generated for
+  module.withModuleDo([this](llvm::Module &m) {
+    m.setDataLayout(jit_->getDataLayout());
+    m.setTargetTriple(jit_->getTargetTriple().str());
+    keepFramePointers(m);
+  });
+
+  if (auto error = jit_->addLazyIRModule(std::move(module))) {
+    return fail(std::move(error));
+  }
+  return true;
+}
+
+bool LLVMJIT::addModuleNow(llvm::orc::ThreadSafeModule module) {
+  if (!initialize()) {
+    return false;
+  }
+
+  sessionErrors_.clear();
+  auto &session = jit_->getExecutionSession();
+  llvm::orc::MangleAndInterner mangle(session, jit_->getDataLayout());
+  llvm::orc::SymbolLookupSet definitions;
+  module.withModuleDo([&](llvm::Module &m) {
+    m.setDataLayout(jit_->getDataLayout());
+    m.setTargetTriple(jit_->getTargetTriple().str());
+    keepFramePointers(m);
+    for (const auto &global : m.global_values()) {
+      if (!global.isDeclaration() && !global.hasLocalLinkage()) {
+        definitions.add(mangle(global.getName()));
+      }
+    }
+  });
+
+  // A tracker of its own lets a failed module be removed again
+  auto &dylib = jit_->getMainJITDylib();
+  auto tracker = dylib.createResourceTracker();
+  if (auto error = jit_->addIRModule(tracker, std::move(module))) {
+    return fail(std::move(error));
+  }
+  if (definitions.empty()) {
+    return true;
+  }
+
+  auto symbols = session.lookup(llvm::orc::makeJITDylibSearchOrder(&dylib),
+                                std::move(definitions));
+  if (!symbols) {
+    // The session error names the cause; the lookup error only the symbols
+    fail(symbols.takeError());
+    if (!sessionErrors_.empty()) {
+      lastError_ = sessionErrors_;
+    }
+    if (auto error = tracker->remove()) {
+      lastError_ += "; " + llvm::toString(std::move(error));
+    }
+    return false;
+  }
+  return true;
+}
+
+bool LLVMJIT::runInitializers() {
+  if (!initialize()) {
+    return false;
+  }
+  sessionErrors_.clear();
+  if (auto error = jit_->initialize(jit_->getMainJITDylib())) {
+    fail(std::move(error));
+    if (!sessionErrors_.empty()) {
+      lastError_ = sessionErrors_;
+    }
+    return false;
+  }
+  return true;
+}
+
+uint64_t LLVMJIT::lookup(const std::string &name) {
+  if (!initialize()) {
+    return 0;
+  }
+
+  auto symbol = jit_->lookup(name);
+  if (!symbol) {
+    fail(symbol.takeError());
+    return 0;
+  }
+  return symbol->getAddress();
+}
+
+void LLVMJIT::keepFramePointers(llvm::Module &module) {
+  for (llvm::Function &function : module) {
+    if (!function.isDeclaration()) {
+      function.addFnAttr("frame-pointer", "all");
+    }
+  }
+}
+
+bool LLVMJIT::fail(llvm::Error error) {
+  lastError_ = llvm::toString(std::move(error));
+  return false;
+}
+
+} // namespace codegen
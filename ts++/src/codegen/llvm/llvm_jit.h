@@ -0,0 +1,132 @@
+#pragma once
+#include "codegen/llvm/llvm_object_cache.h"
+#include "llvm/ExecutionEngine/JITEventListener.h"
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+#include "llvm/ExecutionEngine/Orc/ThreadSafeModule.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace codegen {
+
+/**
+ * @class LLVMJIT
+ * @brief Long-lived ORC JIT session for executing generated modules
+ *
+ * Wraps an llvm::orc::LLLazyJIT. Modules are added without being cloned and
+ * each function is only compiled the first time it is called, so running a
+ * program only pays for the code it actually reaches. Symbols from the host
+ * process (printf and friends) are resolved automatically, and every added
+ * module lands in the same JITDylib so later modules can call earlier ones.
+ * REPL increments use addModuleNow() instead, which compiles eagerly so a
+ * broken increment can be reported and dropped before anything calls it.
+ * With a cache directory, compiled objects are kept on disk and later
+ * sessions load them instead of running the code generator again.
+ *
+ * JIT code keeps its frame pointers, so profilers can walk through it.
+ * With profiling on, each compiled function is also named for them: in
+ * /tmp/perf-<pid>.map, which perf reads as it is, by tspp name; and
+ * through LLVM's perf jitdump and Intel JIT event listeners, where LLVM
+ * was built with them, for perf inject and VTune.
+ */
+class LLVMJIT {
+public:
+  LLVMJIT() = default;
+
+  /**
+   * @brief Sets up the native target and the JIT session
+   * @return True if the session is ready; see getLastError() otherwise
+   */
+  bool initialize();
+
+  /**
+   * @brief Keeps compiled objects in a directory across sessions
+   *
+   * Only takes effect before the session is initialized.
+   *
+   * @param directory Where objects are kept; empty disables the cache
+   */
+  void setObjectCacheDirectory(const std::string &directory) {
+    cacheDirectory_ = directory;
+  }
+
+  /**
+   * @brief Names compiled functions for profilers
+   *
+   * Only takes effect before the session is initialized.
+   */
+  void setProfiling(bool enabled) { profiling_ = enabled; }
+
+  /**
+   * @brief Gets how many objects were loaded from the cache
+   */
+  unsigned getCachedObjectCount() const {
+    return cache_ ? cache_->getHitCount() : 0;
+  }
+
+  /**
+   * @brief Checks whether initialize() has succeeded
+   */
+  bool isInitialized() const { return jit_ != nullptr; }
+
+  /**
+   * @brief Adds a module whose functions are compiled on first call
+   * @param module Module to take ownership of
+   * @return True if the module was added
+   */
+  bool addModule(llvm::orc::ThreadSafeModule module);
+
+  /**
+   * @brief Adds a module and compiles it right away
+   *
+   * Every definition is looked up before returning, so unresolved symbols
+   * and compile errors are reported here rather than on the first call. A
+   * module that fails is removed from the session again, leaving the
+   * JITDylib as it was before the call.
+   *
+   * @param module Module to take ownership of
+   * @return True if the module was added and materialized
+   */
+  bool addModuleNow(llvm::orc::ThreadSafeModule module);
+
+  /**
+   * @brief Runs the llvm.global_ctors of the modules added since the last
+   * call, as a program's loader would before main
+   * @return True if they ran
+   */
+  bool runInitializers();
+
+  /**
+   * @brief Looks up the address of a JIT-compiled symbol
+   * @param name Unmangled symbol name
+   * @return The symbol address, or 0 if it could not be resolved
+   */
+  uint64_t lookup(const std::string &name);
+
+  /**
+   * @brief Gets the message of the most recent failure
+   */
+  const std::string &getLastError() const { return lastError_; }
+
+private:
+  /**
+   * @brief Records an LLVM error and consumes it
+   * @return Always false, for use in return statements
+   */
+  bool fail(llvm::Error error);
+
+  /**
+   * @brief Marks every function of a module to keep its frame pointer
+   */
+  static void keepFramePointers(llvm::Module &module);
+
+  std::string cacheDirectory_;             // Object cache root, or empty
+  std::unique_ptr<LLVMObjectCache> cache_; // Outlives the compilers using it
+  bool profiling_ = false;                 // Name functions for profilers
+  std::unique_ptr<llvm::JITEventListener> perfMap_; // Outlives the linker
+  std::unique_ptr<llvm::orc::LLLazyJIT> jit_; // Lazy compiling JIT
+  std::string lastError_;                     // Last failure message
+  std::string sessionErrors_; // Reported by the session since addModuleNow
+};
+
+} // namespace codegen
@@ -0,0 +1,492 @@
+#include "codegen/llvm/llvm_monomorphizer.h"
+#include "codegen/llvm/llvm_utils.h"
+
+namespace codegen {
+
+namespace {
+
+// Name of a generic parameter, or empty if the node is not one
+const std::string &genericParamName(const nodes::TypePtr &param) {
+  static const std::string empty;
+  auto genericParam = nodes::dyn_cast<nodes::GenericParamNode>(param);
+  return genericParam ? genericParam->getName() : empty;
+}
+
+} // namespace
+
+LLVMMonomorphizer::LLVMMonomorphizer(LLVMContext &context,
+                                     LLVMTypeBuilder &typeBuilder)
+    : context_(context), typeBuilder_(typeBuilder),
+      types_(visitors::TypeContext::instance()) {}
+
+void LLVMMonomorphizer::clear() {
+  genericFunctions_.clear();
+  genericClasses_.clear();
+  functions_.clear();
+  layouts_.clear();
+  classes_.clear();
+  classTypes_.clear();
+  pending_.clear();
+  bindings_.clear();
+}
+
+void LLVMMonomorphizer::registerFunction(
+    const nodes::GenericFunctionDeclNode *decl) {
+  genericFunctions_[core::Interner::instance().intern(decl->getName())] = decl;
+}
+
+void LLVMMonomorphizer::registerClass(const nodes::GenericClassDeclNode *decl) {
+  genericClasses_[decl->getName()] = decl;
+}
+
+const nodes::GenericFunctionDeclNode *
+LLVMMonomorphizer::lookupFunction(core::Symbol name) const {
+  auto it = genericFunctions_.find(name);
+  return it != genericFunctions_.end() ? it->second : nullptr;
+}
+
+const nodes::GenericClassDeclNode *
+LLVMMonomorphizer::lookupClass(const std::string &name) const {
+  auto it = genericClasses_.find(name);
+  return it != genericClasses_.end() ? it->second : nullptr;
+}
+
+LLVMMonomorphizer::SpecializationKey
+LLVMMonomorphizer::makeKey(const nodes::DeclarationNode *decl,
+                           const std::vector<TypePtr> &typeArgs) {
+  SpecializationKey key(decl, {});
+  key.second.reserve(typeArgs.size());
+  for (const auto &typeArg : typeArgs) {
+    key.second.push_back(typeArg.get());
+  }
+  return key;
+}
+
+/*****************************************************************************
+ * Type arguments
+ *****************************************************************************/
+
+bool LLVMMonomorphizer::inferTypeArguments(
+    const nodes::GenericFunctionDeclNode *decl,
+    const std::vector<std::string> &explicitArgs,
+    const std::vector<llvm::Value *> &args,
+    const std::vector<TypePtr> &argTypes, std::vector<TypePtr> &typeArgs,
+    std::string &message) {
+  const auto &params = decl->getGenericParams();
+  typeArgs.assign(params.size(), nullptr);
+
+  if (!explicitArgs.empty()) {
+    if (explicitArgs.size() != params.size()) {
+      message = "Wrong number of type arguments for '" + decl->getName() + "'";
+      return false;
+    }
+    for (size_t i = 0; i < params.size(); ++i) {
+      typeArgs[i] = resolveTypeName(explicitArgs[i]);
+    }
+    return true;
+  }
+
+  const auto &parameters = decl->getParameters();
+  for (size_t i = 0; i < params.size(); ++i) {
+    const std::string &name = genericParamName(params[i]);
+    for (size_t j = 0; j < parameters.size() && j < args.size(); ++j) {
+      auto named =
+          nodes::dyn_cast<nodes::NamedTypeNode>(parameters[j]->getType());
+      if (named && named->getName() == name) {
+        typeArgs[i] = checkedType(j < argTypes.size() ? argTypes[j] : nullptr);
+        if (!typeArgs[i]) {
+          typeArgs[i] = typeOfValue(args[j]->getType());
+        }
+        break;
+      }
+    }
+    if (!typeArgs[i]) {
+      message = "Cannot infer type argument '" + name + "' of '" +
+                decl->getName() + "'";
+      return false;
+    }
+  }
+  return true;
+}
+
+LLVMMonomorphizer::TypePtr
+LLVMMonomorphizer::checkedType(const TypePtr &type) const {
+  if (!type) {
+    return nullptr;
+  }
+  switch (type->getKind()) {
+  case visitors::ResolvedType::TypeKind::Int:
+  case visitors::ResolvedType::TypeKind::Float:
+  case visitors::ResolvedType::TypeKind::Bool:
+  case visitors::ResolvedType::TypeKind::String:
+  case visitors::ResolvedType::TypeKind::Named:
+    return type;
+  default:
+    // Pointers and arrays are bound as the LLVM values they are passed as
+    return nullptr;
+  }
+}
+
+LLVMMonomorphizer::TypePtr LLVMMonomorphizer::typeOfValue(llvm::Type *type) {
+  if (type->isIntegerTy(1)) {
+    return types_.getBool();
+  }
+  if (type->isIntegerTy()) {
+    return types_.getInt();
+  }
+  if (type->isFloatingPointTy()) {
+    return types_.getFloat();
+  }
+
+  // Objects are handled by pointer
+  if (auto pointer = llvm::dyn_cast<llvm::PointerType>(type)) {
+    type = pointer->getPointerElementType();
+    if (type->isIntegerTy(8)) {
+      return types_.getString();
+    }
+  }
+  if (auto structType = llvm::dyn_cast<llvm::StructType>(type)) {
+    auto it = classTypes_.find(structType);
+    if (it != classTypes_.end()) {
+      return it->second;
+    }
+    if (structType->hasName()) {
+      return types_.getNamed(structType->getName().str());
+    }
+  }
+  return nullptr;
+}
+
+LLVMMonomorphizer::TypePtr
+LLVMMonomorphizer::resolveTypeName(const std::string &name) {
+  // Only the innermost specialization's parameters are in scope
+  if (!bindings_.empty()) {
+    auto it = bindings_.back().find(name);
+    if (it != bindings_.back().end()) {
+      return it->second;
+    }
+  }
+
+  if (name == "int") {
+    return types_.getInt();
+  }
+  if (name == "float") {
+    return types_.getFloat();
+  }
+  if (name == "bool" || name == "boolean") {
+    return types_.getBool();
+  }
+  if (name == "string") {
+    return types_.getString();
+  }
+  if (name == "void") {
+    return types_.getVoid();
+  }
+  return types_.getNamed(name);
+}
+
+LLVMMonomorphizer::TypePtr
+LLVMMonomorphizer::resolveTypeNode(const nodes::TypeNode *type) {
+  if (!type) {
+    return types_.getInt();
+  }
+
+  switch (type->getNodeKind()) {
+  case nodes::NodeKind::PrimitiveType: {
+    auto primitive = nodes::cast<nodes::PrimitiveTypeNode>(type);
+    if (primitive->isVector()) {
+      return types_.getVector(primitive->getType() == tokens::TokenType::FLOAT
+                                  ? types_.getFloat()
+                                  : types_.getInt(),
+                              primitive->getLanes());
+    }
+    switch (primitive->getType()) {
+    case tokens::TokenType::VOID:
+      return types_.getVoid();
+    case tokens::TokenType::FLOAT:
+      return types_.getFloat();
+    case tokens::TokenType::BOOLEAN:
+      return types_.getBool();
+    case tokens::TokenType::STRING:
+      return types_.getString();
+    default:
+      return types_.getInt();
+    }
+  }
+
+  case nodes::NodeKind::NamedType:
+    return resolveTypeName(nodes::cast<nodes::NamedTypeNode>(type)->getName());
+
+  case nodes::NodeKind::TemplateType: {
+    auto templateType = nodes::cast<nodes::TemplateTypeNode>(type);
+    auto base = nodes::dyn_cast<nodes::NamedTypeNode>(templateType->getBaseType());
+    if (!base) {
+      return types_.getError();
+    }
+    std::vector<TypePtr> args;
+    for (const auto &arg : templateType->getArguments()) {
+      args.push_back(resolveTypeNode(arg));
+    }
+    return types_.getTemplate(base->getName(), args);
+  }
+
+  case nodes::NodeKind::PointerType:
+    return types_.getPointer(resolveTypeNode(
+        nodes::cast<nodes::PointerTypeNode>(type)->getBaseType()));
+
+  case nodes::NodeKind::ReferenceType:
+    return types_.getReference(resolveTypeNode(
+        nodes::cast<nodes::ReferenceTypeNode>(type)->getBaseType()));
+
+  case nodes::NodeKind::ArrayType:
+    return types_.getArray(resolveTypeNode(
+        nodes::cast<nodes::ArrayTypeNode>(type)->getElementType()));
+
+  case nodes::NodeKind::AtomicType:
+    return types_.getAtomic(resolveTypeNode(
+        nodes::cast<nodes::AtomicTypeNode>(type)->getValueType()));
+
+  case nodes::NodeKind::SmartPointerType: {
+    auto smart = nodes::cast<nodes::SmartPointerTypeNode>(type);
+    auto kind = visitors::ResolvedType::SmartKind::Shared;
+    if (smart->getKind() == nodes::SmartPointerTypeNode::SmartPointerKind::Unique) {
+      kind = visitors::ResolvedType::SmartKind::Unique;
+    } else if (smart->getKind() ==
+               nodes::SmartPointerTypeNode::SmartPointerKind::Weak) {
+      kind = visitors::ResolvedType::SmartKind::Weak;
+    }
+    return types_.getSmart(resolveTypeNode(smart->getPointeeType()), kind);
+  }
+
+  case nodes::NodeKind::FunctionType: {
+    auto function = nodes::cast<nodes::FunctionTypeNode>(type);
+    std::vector<TypePtr> params;
+    for (const auto *param : function->getParameterTypes()) {
+      params.push_back(resolveTypeNode(param));
+    }
+    return types_.getFunction(function->getReturnType()
+                                  ? resolveTypeNode(function->getReturnType())
+                                  : types_.getVoid(),
+                              params);
+  }
+
+  default:
+    // Other annotations are still simplified to int
+    return types_.getInt();
+  }
+}
+
+/*****************************************************************************
+ * Type conversion
+ *****************************************************************************/
+
+llvm::Type *LLVMMonomorphizer::convertType(const TypePtr &type) {
+  using Kind = visitors::ResolvedType::TypeKind;
+
+  switch (type->getKind()) {
+  case Kind::Template:
+    if (auto decl = lookupClass(type->getName())) {
+      if (decl->getGenericParams().size() == type->getTemplateArgs().size()) {
+        return getClass(decl, type->getTemplateArgs());
+      }
+    } else if (visitors::ResolvedType::getContainerArity(type->getName()) ==
+               type->getTemplateArgs().size()) {
+      // Built-in containers may hold specializations too
+      std::vector<llvm::Type *> elementTypes;
+      for (const auto &arg : type->getTemplateArgs()) {
+        elementTypes.push_back(convertType(arg));
+      }
+      return typeBuilder_.getContainerType(type->getName(), elementTypes);
+    }
+    break;
+  case Kind::Pointer:
+  case Kind::Reference:
+  case Kind::Smart: {
+    llvm::Type *pointee = convertType(type->getPointeeType());
+    if (pointee->isVoidTy()) {
+      pointee = llvm::Type::getInt8Ty(context_.getContext());
+    }
+    return llvm::PointerType::getUnqual(pointee);
+  }
+  case Kind::Array:
+    return llvm::PointerType::getUnqual(convertType(type->getElementType()));
+  case Kind::Function: {
+    std::vector<llvm::Type *> paramTypes;
+    for (const auto &paramType : type->getParameterTypes()) {
+      paramTypes.push_back(convertType(paramType));
+    }
+    return typeBuilder_.getClosureType(llvm::FunctionType::get(
+        convertType(type->getReturnType()), paramTypes, false));
+  }
+  default:
+    break;
+  }
+  return typeBuilder_.convertType(type);
+}
+
+llvm::Type *LLVMMonomorphizer::convertBoundType(const nodes::TypeNode *type) {
+  if (auto named = nodes::dyn_cast<nodes::NamedTypeNode>(type)) {
+    if (!bindings_.empty()) {
+      auto it = bindings_.back().find(named->getName());
+      if (it != bindings_.back().end()) {
+        return convertType(it->second);
+      }
+    }
+    return nullptr;
+  }
+
+  if (auto templateType = nodes::dyn_cast<nodes::TemplateTypeNode>(type)) {
+    auto base = nodes::dyn_cast<nodes::NamedTypeNode>(templateType->getBaseType());
+    if (base && (lookupClass(base->getName()) ||
+                 (visitors::ResolvedType::getContainerArity(base->getName()) &&
+                  !typeBuilder_.getTypeByName(base->getName())))) {
+      return convertType(resolveTypeNode(type));
+    }
+  }
+
+  // function(T): T binds its parameters like any other annotation
+  if (type && type->getNodeKind() == nodes::NodeKind::FunctionType &&
+      !bindings_.empty()) {
+    return convertType(resolveTypeNode(type));
+  }
+  return nullptr;
+}
+
+llvm::Type *LLVMMonomorphizer::convertSignatureType(const nodes::TypeNode *type,
+                                                    bool isReturn) {
+  auto &llvmContext = context_.getContext();
+  if (!type) {
+    return llvm::Type::getInt32Ty(llvmContext);
+  }
+
+  llvm::Type *converted = convertType(resolveTypeNode(type));
+  if (converted->isVoidTy()) {
+    return isReturn ? converted : llvm::Type::getInt32Ty(llvmContext);
+  }
+  // Objects are passed by pointer, like the result of new; strings and
+  // function values by value
+  if (converted->isStructTy() && converted->isSized() &&
+      converted != typeBuilder_.getStringType() &&
+      !typeBuilder_.getClosureSignature(converted)) {
+    return llvm::PointerType::getUnqual(converted);
+  }
+  if (!converted->isSized()) {
+    return llvm::Type::getInt32Ty(llvmContext);
+  }
+  return converted;
+}
+
+/*****************************************************************************
+ * Specializations
+ *****************************************************************************/
+
+llvm::Function *
+LLVMMonomorphizer::getFunction(const nodes::GenericFunctionDeclNode *decl,
+                               const std::vector<TypePtr> &typeArgs) {
+  SpecializationKey key = makeKey(decl, typeArgs);
+  auto it = functions_.find(key);
+  if (it != functions_.end()) {
+    return it->second;
+  }
+
+  // Arguments that lower to the same types generate the same body
+  std::pair<const nodes::DeclarationNode *, std::vector<llvm::Type *>> layout(
+      decl, {});
+  for (const auto &typeArg : typeArgs) {
+    layout.second.push_back(convertType(typeArg));
+  }
+  auto shared = layouts_.find(layout);
+  if (shared != layouts_.end()) {
+    functions_.emplace(std::move(key), shared->second);
+    return shared->second;
+  }
+
+  // The signature is lowered with the type parameters bound
+  pushBindings(decl->getGenericParams(), typeArgs);
+  std::vector<llvm::Type *> paramTypes;
+  for (const auto &param : decl->getParameters()) {
+    paramTypes.push_back(convertSignatureType(param->getType(), false));
+  }
+  llvm::Type *returnType = convertSignatureType(decl->getReturnType(), true);
+  popBindings();
+
+  llvm::FunctionType *functionType =
+      llvm::FunctionType::get(returnType, paramTypes, false);
+  llvm::Function *function = llvm::Function::Create(
+      functionType, llvm::Function::LinkOnceODRLinkage,
+      LLVMUtils::mangleFunctionName(decl->getName(), typeArgs),
+      context_.getModule());
+
+  unsigned idx = 0;
+  for (auto &arg : function->args()) {
+    arg.setName(decl->getParameters()[idx++]->getName());
+  }
+
+  functions_.emplace(std::move(key), function);
+  layouts_.emplace(std::move(layout), function);
+  pending_.push_back({decl, typeArgs, function});
+  return function;
+}
+
+bool LLVMMonomorphizer::takePending(PendingFunction &pending) {
+  if (pending_.empty()) {
+    return false;
+  }
+  pending = std::move(pending_.back());
+  pending_.pop_back();
+  return true;
+}
+
+llvm::StructType *
+LLVMMonomorphizer::getClass(const nodes::GenericClassDeclNode *decl,
+                            const std::vector<TypePtr> &typeArgs) {
+  SpecializationKey key = makeKey(decl, typeArgs);
+  auto it = classes_.find(key);
+  if (it != classes_.end()) {
+    return it->second;
+  }
+
+  // Declared before the fields are lowered, so they may refer to the class
+  std::string name = LLVMUtils::mangleFunctionName(decl->getName(), typeArgs);
+  auto forward = llvm::cast<llvm::StructType>(
+      typeBuilder_.convertType(types_.getNamed(name)));
+  classes_.emplace(key, forward);
+  classTypes_[forward] = types_.getTemplate(decl->getName(), typeArgs);
+
+  pushBindings(decl->getGenericParams(), typeArgs);
+  std::vector<std::pair<std::string, llvm::Type *>> fields;
+  for (const auto &member : decl->getMembers()) {
+    auto field = nodes::dyn_cast<nodes::FieldDeclNode>(member);
+    if (!field) {
+      continue;
+    }
+    llvm::Type *fieldType = convertBoundType(field->getType());
+    if (!fieldType) {
+      fieldType = typeBuilder_.convertTypeNode(field->getType());
+    }
+    // Classes that are not laid out yet are held by pointer
+    if (!fieldType->isSized()) {
+      fieldType = llvm::PointerType::getUnqual(
+          fieldType->isVoidTy() ? llvm::Type::getInt8Ty(context_.getContext())
+                                : fieldType);
+    }
+    fields.emplace_back(field->getName(), fieldType);
+  }
+  popBindings();
+
+  return typeBuilder_.createStructType(
+      name, fields, LLVMTypeBuilder::getClassLayout(decl));
+}
+
+void LLVMMonomorphizer::pushBindings(const std::vector<nodes::TypePtr> &params,
+                                     const std::vector<TypePtr> &typeArgs) {
+  std::unordered_map<std::string, TypePtr> bindings;
+  for (size_t i = 0; i < params.size() && i < typeArgs.size(); ++i) {
+    bindings[genericParamName(params[i])] = typeArgs[i];
+  }
+  bindings_.push_back(std::move(bindings));
+}
+
+void LLVMMonomorphizer::popBindings() { bindings_.pop_back(); }
+
+} // namespace codegen
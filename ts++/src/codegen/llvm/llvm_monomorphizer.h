@@ -0,0 +1,227 @@
+#pragma once
+#include "core/common/interner.h"
+#include "llvm_context.h"
+#include "llvm_type_builder.h"
+#include "parser/nodes/declaration_nodes.h"
+#include "parser/nodes/type_nodes.h"
+#include "parser/visitors/type_check_visitor/resolved_type.h"
+#include "parser/visitors/type_check_visitor/type_context.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Function.h"
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace codegen {
+
+/**
+ * @class LLVMMonomorphizer
+ * @brief Specializes generic functions and classes per list of type arguments
+ *
+ * Each distinct list of type arguments gets its own copy of a generic, with
+ * the type parameters bound to those types, so generic code runs on its
+ * real types without boxing. Type arguments are interned ResolvedTypes, so
+ * the specialization cache is keyed by the declaration and the addresses of
+ * its arguments. Every use with the same arguments shares one
+ * instantiation, named by LLVMUtils::mangleFunctionName.
+ *
+ * A specialization's body only sees its type arguments as the LLVM types
+ * they lower to, so arguments that lower alike share one: pick<Color>
+ * reuses pick<int>, since an enum is an int. LLVMOptimizer's
+ * MergeFunctions folds what is still identical after optimization.
+ *
+ * Function specializations are emitted with linkonce_odr linkage. The
+ * partitions of a parallel build may emit the same one, and the linker keeps
+ * a single copy. Their bodies are generated after the declaration that
+ * asked for them, so new instantiations wait in a queue.
+ */
+class LLVMMonomorphizer {
+public:
+  using TypePtr = std::shared_ptr<visitors::ResolvedType>;
+
+  /**
+   * @brief A function specialization whose body is still to be generated
+   */
+  struct PendingFunction {
+    const nodes::GenericFunctionDeclNode *decl = nullptr; // The generic
+    std::vector<TypePtr> typeArgs; // Bound to its type parameters
+    llvm::Function *function = nullptr; // Declared specialization
+  };
+
+  /**
+   * @brief Constructs a monomorphizer emitting into a context's module
+   * @param context The LLVM context
+   * @param typeBuilder Converts the non-generic parts of a type
+   */
+  LLVMMonomorphizer(LLVMContext &context, LLVMTypeBuilder &typeBuilder);
+
+  /**
+   * @brief Forgets every generic and specialization, e.g. for a new module
+   */
+  void clear();
+
+  /**
+   * @brief Records a generic function to specialize when it is called
+   * @param decl The declaration
+   */
+  void registerFunction(const nodes::GenericFunctionDeclNode *decl);
+
+  /**
+   * @brief Records a generic class to specialize when it is named
+   * @param decl The declaration
+   */
+  void registerClass(const nodes::GenericClassDeclNode *decl);
+
+  /**
+   * @brief Finds a generic function by name
+   * @param name The interned function name
+   * @return The declaration, or nullptr if no generic has this name
+   */
+  const nodes::GenericFunctionDeclNode *lookupFunction(core::Symbol name) const;
+
+  /**
+   * @brief Finds a generic class by name
+   * @param name The class name
+   * @return The declaration, or nullptr if no generic has this name
+   */
+  const nodes::GenericClassDeclNode *lookupClass(const std::string &name) const;
+
+  /**
+   * @brief Determines the type arguments of a generic call
+   *
+   * Explicit arguments (id<int>(x)) are resolved by name. Otherwise each
+   * type parameter is taken from the first argument whose parameter is
+   * declared with exactly that type: from the type the checker resolved for
+   * it if it is a primitive or a class, else from its LLVM type.
+   *
+   * @param decl The called generic
+   * @param explicitArgs Type argument names written at the call, if any
+   * @param args The generated call arguments
+   * @param argTypes The checked type of each argument, null if unknown
+   * @param typeArgs Receives one type per type parameter
+   * @param message Receives the reason on failure
+   * @return True if every type parameter was bound
+   */
+  bool inferTypeArguments(const nodes::GenericFunctionDeclNode *decl,
+                          const std::vector<std::string> &explicitArgs,
+                          const std::vector<llvm::Value *> &args,
+                          const std::vector<TypePtr> &argTypes,
+                          std::vector<TypePtr> &typeArgs,
+                          std::string &message);
+
+  /**
+   * @brief Gets the specialization of a generic function
+   *
+   * A first request declares the function and queues its body.
+   *
+   * @param decl The generic
+   * @param typeArgs One interned type per type parameter
+   * @return The specialized function
+   */
+  llvm::Function *getFunction(const nodes::GenericFunctionDeclNode *decl,
+                              const std::vector<TypePtr> &typeArgs);
+
+  /**
+   * @brief Takes the next specialization whose body is still missing
+   * @param pending Receives the specialization
+   * @return False once the queue is empty
+   */
+  bool takePending(PendingFunction &pending);
+
+  /**
+   * @brief Gets the struct type of a generic class specialization
+   * @param decl The generic
+   * @param typeArgs One interned type per type parameter
+   * @return The struct type, laid out with the parameters bound
+   */
+  llvm::StructType *getClass(const nodes::GenericClassDeclNode *decl,
+                             const std::vector<TypePtr> &typeArgs);
+
+  /**
+   * @brief Binds type parameters while a specialization is generated
+   * @param params Generic parameters of the declaration
+   * @param typeArgs Their types
+   */
+  void pushBindings(const std::vector<nodes::TypePtr> &params,
+                    const std::vector<TypePtr> &typeArgs);
+
+  /**
+   * @brief Restores the bindings from before the last pushBindings
+   */
+  void popBindings();
+
+  /**
+   * @brief Resolves a type annotation under the current bindings
+   * @param type The annotation, or nullptr for an unannotated value
+   * @return The interned type (int when unannotated)
+   */
+  TypePtr resolveTypeNode(const nodes::TypeNode *type);
+
+  /**
+   * @brief Resolves a type name under the current bindings
+   * @param name A type parameter, builtin or class name
+   * @return The interned type
+   */
+  TypePtr resolveTypeName(const std::string &name);
+
+  /**
+   * @brief Converts a type, specializing any generic class it names
+   * @param type The interned type
+   * @return The LLVM type
+   */
+  llvm::Type *convertType(const TypePtr &type);
+
+  /**
+   * @brief Converts an annotation that depends on a binding or generic class
+   * @param type The annotation
+   * @return The LLVM type, or nullptr if the annotation names neither a
+   *         bound type parameter nor a generic class
+   */
+  llvm::Type *convertBoundType(const nodes::TypeNode *type);
+
+private:
+  // Declaration and argument addresses; interned types compare by address
+  using SpecializationKey =
+      std::pair<const nodes::DeclarationNode *,
+                std::vector<const visitors::ResolvedType *>>;
+
+  static SpecializationKey makeKey(const nodes::DeclarationNode *decl,
+                                   const std::vector<TypePtr> &typeArgs);
+
+  // A checked argument type a parameter can be bound to, or nullptr
+  TypePtr checkedType(const TypePtr &type) const;
+
+  // Recovers the type of a generated value, or nullptr if unknown
+  TypePtr typeOfValue(llvm::Type *type);
+
+  // Lower a parameter or return annotation of a function specialization
+  llvm::Type *convertSignatureType(const nodes::TypeNode *type,
+                                   bool isReturn);
+
+  LLVMContext &context_;
+  LLVMTypeBuilder &typeBuilder_;
+  visitors::TypeContext &types_;
+
+  std::unordered_map<core::Symbol, const nodes::GenericFunctionDeclNode *>
+      genericFunctions_; // Generic functions by interned name
+  std::unordered_map<std::string, const nodes::GenericClassDeclNode *>
+      genericClasses_; // Generic classes by name
+
+  std::map<SpecializationKey, llvm::Function *> functions_; // Cache
+  std::map<std::pair<const nodes::DeclarationNode *,
+                     std::vector<llvm::Type *>>,
+           llvm::Function *>
+      layouts_; // Function specializations by lowered type arguments
+  std::map<SpecializationKey, llvm::StructType *> classes_; // Cache
+  std::unordered_map<llvm::StructType *, TypePtr>
+      classTypes_; // Specialized structs back to their template types
+  std::vector<PendingFunction> pending_; // Bodies still to generate
+
+  // Type parameter bindings of the specializations being generated
+  std::vector<std::unordered_map<std::string, TypePtr>> bindings_;
+};
+
+} // namespace codegen
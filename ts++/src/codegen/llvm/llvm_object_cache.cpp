@@ -0,0 +1,106 @@
+#include "codegen/llvm/llvm_object_cache.h"
+#include "core/utils/cache_key.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/SHA1.h"
+#include "llvm/Support/raw_ostream.h"
+
+namespace codegen {
+
+using core::utils::addKeyField;
+
+LLVMObjectCache::LLVMObjectCache(std::string directory,
+                                 const std::string &target)
+    : directory_(std::move(directory)) {
+  llvm::SHA1 hasher;
+  addKeyField(hasher, "jit object llvm " LLVM_VERSION_STRING);
+  addKeyField(hasher, target);
+  if (!core::utils::addCompilerStamp(hasher)) {
+    return;
+  }
+  context_ = llvm::toHex(hasher.final(), true);
+}
+
+std::string LLVMObjectCache::computeKey(const llvm::Module &module) const {
+  if (context_.empty()) {
+    return "";
+  }
+  llvm::SmallString<0> bitcode;
+  llvm::raw_svector_ostream stream(bitcode);
+  llvm::WriteBitcodeToFile(module, stream);
+
+  llvm::SHA1 hasher;
+  addKeyField(hasher, context_);
+  addKeyField(hasher, bitcode);
+  return llvm::toHex(hasher.final(), true);
+}
+
+std::string LLVMObjectCache::getEntryPath(const std::string &key) const {
+  llvm::SmallString<128> path(directory_);
+  llvm::sys::path::append(path, llvm::StringRef(key).take_front(2),
+                          llvm::StringRef(key).drop_front(2));
+  return path.str().str();
+}
+
+std::unique_ptr<llvm::MemoryBuffer>
+LLVMObjectCache::getObject(const llvm::Module *module) {
+  std::string key = computeKey(*module);
+  if (key.empty()) {
+    return nullptr;
+  }
+  auto buffer = llvm::MemoryBuffer::getFile(getEntryPath(key));
+  if (buffer) {
+    ++hits_;
+    return std::move(*buffer);
+  }
+
+  // Remembered so the object is stored without hashing the module again
+  std::lock_guard<std::mutex> lock(mutex_);
+  pending_[module] = std::move(key);
+  return nullptr;
+}
+
+void LLVMObjectCache::notifyObjectCompiled(const llvm::Module *module,
+                                           llvm::MemoryBufferRef object) {
+  std::string key;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = pending_.find(module);
+    if (it == pending_.end()) {
+      return;
+    }
+    key = std::move(it->second);
+    pending_.erase(it);
+  }
+
+  std::string entry = getEntryPath(key);
+  if (llvm::sys::fs::create_directories(llvm::sys::path::parent_path(entry))) {
+    return;
+  }
+
+  // Readers only ever see a complete entry
+  llvm::SmallString<128> temporary;
+  int fd;
+  if (llvm::sys::fs::createUniqueFile(entry + ".tmp%%%%%%", fd, temporary)) {
+    return;
+  }
+  bool written;
+  {
+    llvm::raw_fd_ostream stream(fd, /*shouldClose=*/true);
+    stream << object.getBuffer();
+    stream.close();
+    written = !stream.has_error();
+    stream.clear_error();
+  }
+  if (!written || llvm::sys::fs::rename(temporary, entry)) {
+    llvm::sys::fs::remove(temporary);
+  }
+}
+
+} // namespace codegen
@@ -0,0 +1,71 @@
+/*****************************************************************************
+ * File: llvm_object_cache.h
+ * Description: On-disk cache of JIT-compiled objects, keyed by module hash
+ *****************************************************************************/
+
+#pragma once
+#include "llvm/ExecutionEngine/ObjectCache.h"
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace codegen {
+
+/**
+ * @class LLVMObjectCache
+ * @brief Lets the JIT load machine code compiled by an earlier process
+ *
+ * Each module the JIT compiles, which for lazy compilation is a single
+ * function's partition, is keyed by a SHA-1 of its bitcode, the target the
+ * session compiles for (triple, CPU and features), and the compiler by
+ * LLVM version and the size and modification time of its executable. Objects are relocatable and symbols are resolved when they
+ * are linked into the session, so an entry holds no addresses of the
+ * process that wrote it.
+ *
+ * Entries use the layout of the driver's compilation cache and are written
+ * through a temporary file, so processes sharing a directory never load a
+ * partial object. Any failure to read or write just means a miss.
+ */
+class LLVMObjectCache : public llvm::ObjectCache {
+public:
+  /**
+   * @brief Opens a cache
+   * @param directory Where entries are kept
+   * @param target Describes the code the session generates
+   */
+  LLVMObjectCache(std::string directory, const std::string &target);
+
+  void notifyObjectCompiled(const llvm::Module *module,
+                            llvm::MemoryBufferRef object) override;
+
+  std::unique_ptr<llvm::MemoryBuffer>
+  getObject(const llvm::Module *module) override;
+
+  /**
+   * @brief Gets how many objects were loaded instead of compiled
+   */
+  unsigned getHitCount() const { return hits_; }
+
+private:
+  /**
+   * @brief Computes the key of a module
+   * @return The key, or empty if the module cannot be cached
+   */
+  std::string computeKey(const llvm::Module &module) const;
+
+  /**
+   * @brief Gets the path of the entry for a key
+   */
+  std::string getEntryPath(const std::string &key) const;
+
+  std::string directory_; ///< Cache root
+  std::string context_;   ///< Hex SHA-1 of the target and compiler
+  std::atomic<unsigned> hits_{0};
+
+  std::mutex mutex_; ///< Guards pending_; functions compile on any thread
+  /// Keys of modules that missed, until their object is compiled
+  std::unordered_map<const llvm::Module *, std::string> pending_;
+};
+
+} // namespace codegen
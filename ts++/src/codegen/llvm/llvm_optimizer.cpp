@@ -1,18 +1,133 @@
 #include "codegen/llvm/llvm_optimizer.h"
+#include "codegen/llvm/llvm_heap_to_stack.h"
+#include "codegen/llvm/llvm_inline_hints.h"
+#include "codegen/llvm/llvm_refcount_elision.h"
+#include "core/common/time_report.h"
+#include "llvm/ADT/Triple.h"
+#include "llvm/Analysis/LazyCallGraph.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/PassInstrumentation.h"
 #include "llvm/Passes/PassBuilder.h"
+#include "llvm/ProfileData/InstrProfReader.h"
+#include "llvm/Support/PGOOptions.h"
+#include "llvm/Transforms/Coroutines/CoroCleanup.h"
+#include "llvm/Transforms/Coroutines/CoroEarly.h"
+#include "llvm/Transforms/Coroutines/CoroSplit.h"
+#include "llvm/Transforms/IPO/AlwaysInliner.h"
+#include "llvm/Transforms/IPO/GlobalDCE.h"
+#include "llvm/Transforms/IPO/HotColdSplitting.h"
+#include "llvm/Transforms/IPO/Internalize.h"
+#include "llvm/Transforms/InstCombine/InstCombine.h"
+#include "llvm/Transforms/Instrumentation/InstrProfiling.h"
+#include "llvm/Transforms/Instrumentation/PGOInstrumentation.h"
+#include "llvm/Transforms/Scalar/InductiveRangeCheckElimination.h"
+#include "llvm/Transforms/Scalar/SROA.h"
+#include "llvm/Transforms/Scalar/SimplifyCFG.h"
+#include "llvm/Transforms/Utils/EntryExitInstrumenter.h"
 #include <llvm/Pass.h>
 
 namespace codegen {
 
+namespace {
+
+// Pass managers and adaptors only run other passes, which are timed alone
+bool isTimedPass(llvm::StringRef pass) {
+  return !llvm::isSpecialPass(pass, {"PassManager", "PassAdaptor",
+                                     "AnalysisManagerProxy",
+                                     "DevirtSCCRepeatedPass",
+                                     "ModuleInlinerWrapperPass"});
+}
+
+// Name of the module, SCC, function or loop a pass runs on
+std::string unitName(llvm::Any unit) {
+  if (llvm::any_isa<const llvm::Module *>(unit)) {
+    return llvm::any_cast<const llvm::Module *>(unit)->getName().str();
+  }
+  if (llvm::any_isa<const llvm::LazyCallGraph::SCC *>(unit)) {
+    return llvm::any_cast<const llvm::LazyCallGraph::SCC *>(unit)->getName();
+  }
+  if (llvm::any_isa<const llvm::Function *>(unit)) {
+    return llvm::any_cast<const llvm::Function *>(unit)->getName().str();
+  }
+  if (llvm::any_isa<const llvm::Loop *>(unit)) {
+    return llvm::any_cast<const llvm::Loop *>(unit)->getName().str();
+  }
+  return "";
+}
+
+// Times every pass that runs into the TimeReport
+void registerPassTimers(llvm::PassInstrumentationCallbacks &callbacks) {
+  auto &report = core::TimeReport::instance();
+  callbacks.registerBeforeNonSkippedPassCallback(
+      [&report](llvm::StringRef pass, llvm::Any unit) {
+        if (isTimedPass(pass)) {
+          report.begin(pass, unitName(unit), core::TimeReport::Category::Pass);
+        }
+      });
+  callbacks.registerAfterPassCallback(
+      [&report](llvm::StringRef pass, llvm::Any, const llvm::PreservedAnalyses &) {
+        if (isTimedPass(pass)) {
+          report.end();
+        }
+      });
+  callbacks.registerAfterPassInvalidatedCallback(
+      [&report](llvm::StringRef pass, const llvm::PreservedAnalyses &) {
+        if (isTimedPass(pass)) {
+          report.end();
+        }
+      });
+}
+
+} // namespace
+
 LLVMOptimizer::LLVMOptimizer(LLVMContext &context)
-    : context_(context), level_(OptimizationLevel::O0) {}
+    : context_(context), level_(OptimizationLevel::O0),
+      ltoMode_(LTOMode::None), vectorize_(true), deadStrip_(false),
+      targetMachine_(nullptr) {}
 
 void LLVMOptimizer::setOptimizationLevel(OptimizationLevel level) {
   level_ = level;
 }
 
+void LLVMOptimizer::registerPasses(llvm::PassBuilder &passBuilder) {
+  // Decided on the unsimplified module, before the inliner weighs anything
+  passBuilder.registerPipelineStartEPCallback(
+      [](llvm::ModulePassManager &MPM, llvm::OptimizationLevel level) {
+        if (level != llvm::OptimizationLevel::O0) {
+          MPM.addPass(InlineHintPass(level.getSizeLevel() > 0));
+        }
+      });
+
+  // Runs after each instcombine, so mem2reg has exposed the pointers
+  passBuilder.registerPeepholeEPCallback(
+      [](llvm::FunctionPassManager &FPM, llvm::OptimizationLevel) {
+        FPM.addPass(HeapToStackPass());
+        FPM.addPass(RefCountElisionPass());
+      });
+
+  // Array bounds checks on induction variables become one test before the
+  // loop; checks the loop condition already implies are dropped
+  passBuilder.registerScalarOptimizerLateEPCallback(
+      [](llvm::FunctionPassManager &FPM, llvm::OptimizationLevel level) {
+        if (level.getSpeedupLevel() > 1) {
+          FPM.addPass(llvm::IRCEPass());
+        }
+      });
+
+  // Cold regions, like the failure paths of runtime checks and code a
+  // profile never saw run, move out to functions of their own once
+  // inlining is done, so the hot code around them stays dense
+  passBuilder.registerOptimizerLastEPCallback(
+      [](llvm::ModulePassManager &MPM, llvm::OptimizationLevel level) {
+        if (level != llvm::OptimizationLevel::O0) {
+          MPM.addPass(llvm::HotColdSplittingPass());
+        }
+      });
+}
+
 void LLVMOptimizer::optimizeFunctions() {
   llvm::PassBuilder passBuilder;
+  registerPasses(passBuilder);
 
   // Create and register analysis managers
   llvm::LoopAnalysisManager LAM;
@@ -41,29 +156,144 @@ void LLVMOptimizer::optimizeFunctions() {
     }
   }
 }
-// void LLVMOptimizer::optimizeModule() {
-//     // Create a new pass manager
-//     llvm::PassManager MPM;
 
-//     // Add module-level passes
-//     if (level_ >= OptimizationLevel::O2) {
-//         MPM.add(llvm::createFunctionInliningPass());
-//         // Add more passes as needed
-//     }
+void LLVMOptimizer::optimizeModule() {
+  llvm::Module &module = context_.getModule();
+  llvm::OptimizationLevel level = llvmOptimizationLevel();
+
+  // The vectorizers are off unless requested; like clang, enable them from
+  // -O2 up (and for -Os) but keep them out of -O1 and -Oz
+  llvm::PipelineTuningOptions tuning;
+  bool vectorize = vectorize_ && level.getSpeedupLevel() > 1 &&
+                   level != llvm::OptimizationLevel::Oz;
+  tuning.LoopVectorization = vectorize;
+  tuning.SLPVectorization = vectorize;
+  // Specializations and helpers that lower to the same instructions are
+  // folded into one, at the end of the pipeline where they are simplest
+  tuning.MergeFunctions = level != llvm::OptimizationLevel::O0;
+  llvm::PassInstrumentationCallbacks callbacks;
+  if (core::TimeReport::instance().isEnabled()) {
+    registerPassTimers(callbacks);
+  }
+  llvm::PassBuilder passBuilder(targetMachine_, tuning, pgoOptions(),
+                                &callbacks);
+  registerPasses(passBuilder);
+
+  llvm::LoopAnalysisManager LAM;
+  llvm::FunctionAnalysisManager FAM;
+  llvm::CGSCCAnalysisManager CGAM;
+  llvm::ModuleAnalysisManager MAM;
 
-//     // Run the passes
-//     MPM.run(context_.getModule());
-// }
+  // Library info for the module's triple; registered first so it is not
+  // replaced by the default one
+  llvm::TargetLibraryInfoImpl libraryInfo(
+      llvm::Triple(module.getTargetTriple()));
+  FAM.registerPass([&] { return llvm::TargetLibraryAnalysis(libraryInfo); });
+
+  passBuilder.registerModuleAnalyses(MAM);
+  passBuilder.registerCGSCCAnalyses(CGAM);
+  passBuilder.registerFunctionAnalyses(FAM);
+  passBuilder.registerLoopAnalyses(LAM);
+  passBuilder.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+
+  llvm::ModulePassManager MPM;
+  if (deadStrip_) {
+    // Whatever the exports do not reach is removed even at -O0
+    llvm::ModulePassManager strip;
+    strip.addPass(llvm::InternalizePass([](const llvm::GlobalValue &value) {
+      auto function = llvm::dyn_cast<llvm::Function>(&value);
+      return function && function->hasFnAttribute("wasm-export-name");
+    }));
+    strip.addPass(llvm::GlobalDCEPass());
+    strip.run(module, MAM);
+  }
+  if (level_ == OptimizationLevel::Og) {
+    MPM = buildDevelopmentPipeline();
+  } else if (level == llvm::OptimizationLevel::O0) {
+    MPM = passBuilder.buildO0DefaultPipeline(level, ltoMode_ != LTOMode::None);
+  } else if (ltoMode_ == LTOMode::Thin) {
+    MPM = passBuilder.buildThinLTOPreLinkDefaultPipeline(level);
+  } else if (ltoMode_ == LTOMode::Full) {
+    MPM = passBuilder.buildLTOPreLinkDefaultPipeline(level);
+  } else {
+    MPM = passBuilder.buildPerModuleDefaultPipeline(level);
+  }
+  // Profiler hooks go in after inlining, into whatever functions remain;
+  // functions without the hook attributes are left alone
+  MPM.addPass(llvm::createModuleToFunctionPassAdaptor(
+      llvm::EntryExitInstrumenterPass(/*PostInlining=*/true)));
+
+  MPM.run(module, MAM);
+}
+
+bool LLVMOptimizer::checkProfile(std::string &message) const {
+  if (profileFile_.empty()) {
+    return true;
+  }
+  auto reader = llvm::IndexedInstrProfReader::create(profileFile_);
+  if (!reader) {
+    message = "Cannot read profile " + profileFile_ + ": " +
+              llvm::toString(reader.takeError());
+    return false;
+  }
+  return true;
+}
+
+llvm::Optional<llvm::PGOOptions> LLVMOptimizer::pgoOptions() const {
+  if (!rawProfilePath_.empty()) {
+    return llvm::PGOOptions(rawProfilePath_, "", "",
+                            llvm::PGOOptions::IRInstr);
+  }
+  if (!profileFile_.empty()) {
+    return llvm::PGOOptions(profileFile_, "", "", llvm::PGOOptions::IRUse);
+  }
+  return llvm::None;
+}
+
+llvm::ModulePassManager LLVMOptimizer::buildDevelopmentPipeline() const {
+  // Every local is an entry block alloca, so SROA turns them all into SSA
+  // values; instcombine and simplifycfg then remove the copies, casts and
+  // branches the code generator leaves behind. That is most of what -O1
+  // gains on generated code, at a fraction of its compile time. The
+  // coroutine passes are the ones the default pipelines run, which async
+  // functions cannot do without.
+  llvm::FunctionPassManager FPM;
+  FPM.addPass(llvm::CoroCleanupPass());
+  FPM.addPass(llvm::SROAPass());
+  FPM.addPass(llvm::InstCombinePass());
+  FPM.addPass(llvm::SimplifyCFGPass());
+
+  llvm::ModulePassManager MPM;
+  MPM.addPass(llvm::createModuleToFunctionPassAdaptor(llvm::CoroEarlyPass()));
+  MPM.addPass(InlineHintPass());
+  MPM.addPass(llvm::AlwaysInlinerPass());
+  MPM.addPass(llvm::createModuleToPostOrderCGSCCPassAdaptor(
+      llvm::CoroSplitPass(true)));
+  // Counters go in before the cleanups, as at -O0, so a profile taken
+  // from a -Og build matches the CFG every level instruments
+  if (!rawProfilePath_.empty()) {
+    MPM.addPass(llvm::PGOInstrumentationGen());
+    llvm::InstrProfOptions instrumentation;
+    instrumentation.InstrProfileOutput = rawProfilePath_;
+    MPM.addPass(llvm::InstrProfiling(instrumentation));
+  } else if (!profileFile_.empty()) {
+    MPM.addPass(llvm::PGOInstrumentationUse(profileFile_));
+  }
+  MPM.addPass(llvm::createModuleToFunctionPassAdaptor(std::move(FPM)));
+  return MPM;
+}
 
 void LLVMOptimizer::optimizeAll() {
-  optimizeFunctions();
-  //   optimizeModule();
+  core::TimeReport::Scope timer("Optimize");
+  // The module pipelines already contain the function simplification passes
+  optimizeModule();
 }
 
 llvm::OptimizationLevel LLVMOptimizer::llvmOptimizationLevel() const {
   switch (level_) {
   case OptimizationLevel::O0:
     return llvm::OptimizationLevel::O0;
+  case OptimizationLevel::Og:
   case OptimizationLevel::O1:
     return llvm::OptimizationLevel::O1;
   case OptimizationLevel::O2:
@@ -5,6 +5,7 @@
 #include "llvm/Analysis/TargetTransformInfo.h"
 #include "llvm/IR/PassManager.h"
 #include "llvm/Passes/PassBuilder.h"
+#include "llvm/Target/TargetMachine.h"
 #include <memory>
 #include <string>
 
@@ -14,7 +15,9 @@ namespace codegen {
  * @class LLVMOptimizer
  * @brief Manages LLVM optimizations for generated code
  *
- * This class sets up and runs LLVM optimization passes on the IR.
+ * This class sets up and runs LLVM optimization passes on the IR. With a
+ * target machine set, the pipelines use its cost model and the target's
+ * library info.
  */
 class LLVMOptimizer {
 public:
@@ -36,13 +39,67 @@ public:
    */
   OptimizationLevel getOptimizationLevel() const { return level_; }
 
+  /**
+   * @brief Selects the regular or an LTO pre-link module pipeline
+   * @param mode The LTO mode
+   */
+  void setLTOMode(LTOMode mode) { ltoMode_ = mode; }
+
+  /**
+   * @brief Enables the loop and SLP vectorizers in the module pipelines
+   * @param enable Whether to vectorize at -O2 and above
+   */
+  void setVectorization(bool enable) { vectorize_ = enable; }
+
+  /**
+   * @brief Drops everything the module does not export before optimizing
+   * @param enable Whether only functions with a wasm-export-name, and what
+   * they reach, are kept
+   */
+  void setDeadStrip(bool enable) { deadStrip_ = enable; }
+
+  /**
+   * @brief Inserts profile counters into every function
+   * @param rawProfilePath Where the program writes its counts, or empty
+   * for no instrumentation
+   */
+  void setProfileGenerate(const std::string &rawProfilePath) {
+    rawProfilePath_ = rawProfilePath;
+  }
+
+  /**
+   * @brief Annotates branches and calls with the counts of a profile,
+   * which guide inlining, block layout and hot/cold splitting
+   * @param profileFile The indexed profile, or empty for none
+   */
+  void setProfileUse(const std::string &profileFile) {
+    profileFile_ = profileFile;
+  }
+
+  /**
+   * @brief Checks that the profile set with setProfileUse can be read;
+   * LLVM treats an unreadable one as a fatal error
+   * @param message Receives the reason if it cannot
+   * @return True if there is no profile or it can be read
+   */
+  bool checkProfile(std::string &message) const;
+
+  /**
+   * @brief Sets the target machine used for target-aware analyses
+   * @param targetMachine The target machine, or nullptr for generic analyses
+   */
+  void setTargetMachine(llvm::TargetMachine *targetMachine) {
+    targetMachine_ = targetMachine;
+  }
+
   /**
    * @brief Runs function-level optimizations on the module
    */
   void optimizeFunctions();
 
   /**
-   * @brief Runs module-level optimizations on the module
+   * @brief Runs the full per-module (or LTO pre-link) pipeline, including
+   * inlining and interprocedural passes
    */
   void optimizeModule();
 
@@ -52,14 +109,39 @@ public:
   void optimizeAll();
 
 private:
+  /**
+   * @brief Adds the compiler's own passes to a pipeline's extension points
+   * @param passBuilder The pass builder about to build the pipeline
+   */
+  static void registerPasses(llvm::PassBuilder &passBuilder);
+
+  /**
+   * @brief Builds the -Og pipeline: mem2reg and local cleanups only, plus
+   * the profile passes
+   * @return The module pass manager to run
+   */
+  llvm::ModulePassManager buildDevelopmentPipeline() const;
+
+  /**
+   * @brief Describes the profile instrumentation or use to the pipelines
+   * @return The options, or None without profiling
+   */
+  llvm::Optional<llvm::PGOOptions> pgoOptions() const;
+
   /**
    * @brief Converts our optimization level to LLVM's optimization level
    * @return The LLVM optimization level
    */
   llvm::OptimizationLevel llvmOptimizationLevel() const;
 
-  LLVMContext &context_;    // The LLVM context
-  OptimizationLevel level_; // Current optimization level
+  LLVMContext &context_;               // The LLVM context
+  OptimizationLevel level_;            // Current optimization level
+  LTOMode ltoMode_;                    // Module pipeline variant
+  bool vectorize_;                     // Run the loop and SLP vectorizers
+  bool deadStrip_;                     // Internalize all but the exports
+  llvm::TargetMachine *targetMachine_; // Target for cost models, or null
+  std::string rawProfilePath_;         // Instrumentation output, if any
+  std::string profileFile_;            // Profile to optimize with, if any
 };
 
 } // namespace codegen
\ No newline at end of file
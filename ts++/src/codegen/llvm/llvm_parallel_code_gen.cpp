@@ -0,0 +1,247 @@
+#include "codegen/llvm/llvm_parallel_code_gen.h"
+#include "core/common/time_report.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/Linker/Linker.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <utility>
+
+namespace codegen {
+
+namespace {
+
+// Returns the function a top-level node defines, if any
+const nodes::FunctionDeclNode *definedFunction(const nodes::BaseNode *node) {
+  if (auto declStmt = nodes::dyn_cast<nodes::DeclarationStmtNode>(node)) {
+    node = declStmt->getDeclaration();
+  }
+  auto function = nodes::dyn_cast<nodes::FunctionDeclNode>(node);
+  return function && function->hasBody() ? function : nullptr;
+}
+
+// Rough code size of a function, used to balance partitions; a reused
+// function's body may never have been parsed
+size_t estimateCost(const nodes::FunctionDeclNode *function) {
+  return function->getBody() ? function->getBody()->getStatements().size() + 1
+                             : 1;
+}
+
+} // namespace
+
+LLVMParallelCodeGen::LLVMParallelCodeGen(core::ErrorReporter &errorReporter,
+                                         const CodeGenOptions &options)
+    : errorReporter_(errorReporter), options_(options),
+      pool_(llvm::hardware_concurrency(options.getCodeGenThreads())) {}
+
+void LLVMParallelCodeGen::partitionFunctions(const parser::AST &ast) {
+  std::vector<std::pair<size_t, const nodes::FunctionDeclNode *>> functions;
+  for (const auto &node : ast.getNodes()) {
+    if (auto function = definedFunction(node)) {
+      functions.emplace_back(estimateCost(function), function);
+    }
+  }
+
+  // A cached function must not depend on what it was generated with
+  if (caching_) {
+    linkOrder_.clear();
+    assignments_.assign(1, CodeGenPartition());
+    assignments_[0].ownsEntry = true;
+    for (const auto &node : ast.getNodes()) {
+      auto function = definedFunction(node);
+      if (function && reused_.count(function)) {
+        linkOrder_.push_back(function);
+      } else if (function) {
+        assignments_.emplace_back();
+        assignments_.back().definitions.insert(function);
+      }
+    }
+    return;
+  }
+
+  size_t count = std::max<size_t>(
+      1, std::min<size_t>(options_.getCodeGenThreads(), functions.size()));
+  assignments_.assign(count, CodeGenPartition());
+  assignments_[0].ownsEntry = true;
+
+  // Largest function first onto the least loaded partition
+  std::stable_sort(
+      functions.begin(), functions.end(),
+      [](const auto &a, const auto &b) { return a.first > b.first; });
+
+  using Load = std::pair<size_t, size_t>; // (cost so far, partition)
+  std::priority_queue<Load, std::vector<Load>, std::greater<Load>> loads;
+  for (size_t i = 0; i < count; ++i) {
+    loads.emplace(0, i);
+  }
+  for (const auto &function : functions) {
+    Load least = loads.top();
+    loads.pop();
+    assignments_[least.second].definitions.insert(function.second);
+    loads.emplace(least.first + function.first, least.second);
+  }
+}
+
+bool LLVMParallelCodeGen::generateCode(const parser::AST &ast) {
+  partitionFunctions(ast);
+
+  // Executables are linked from one object per partition
+  CodeGenOptions partitionOptions = options_;
+  if (assignments_.size() > 1 && !caching_ &&
+      options_.getOutputFormat() == OutputFormat::EXECUTABLE) {
+    partitionOptions.setOutputFormat(OutputFormat::OBJECT);
+  }
+
+  // Targets are created up front; LLVM's target registry is not thread-safe
+  partitions_.clear();
+  for (size_t i = 0; i < assignments_.size(); ++i) {
+    partitions_.push_back(std::make_unique<LLVMCodeGen>(
+        errorReporter_, options_.getModuleName()));
+    partitions_[i]->setOptions(partitionOptions);
+    for (const auto &import : imports_) {
+      partitions_[i]->addImport(import);
+    }
+    partitions_[i]->setBodyStream(bodyStream_);
+    if (assignments_.size() > 1 || caching_) {
+      partitions_[i]->setPartition(&assignments_[i]);
+    }
+  }
+
+  if (partitions_.size() == 1) {
+    return partitions_[0]->generateCode(ast);
+  }
+
+  std::vector<char> results(partitions_.size(), false);
+  for (size_t i = 0; i < partitions_.size(); ++i) {
+    pool_.async([this, &ast, &results, i] {
+      results[i] = partitions_[i]->generateCode(ast);
+    });
+  }
+  pool_.wait();
+
+  return std::all_of(results.begin(), results.end(),
+                     [](char result) { return result; });
+}
+
+bool LLVMParallelCodeGen::linkPartitions() {
+  core::TimeReport::Scope timer("Link partitions");
+  // Serialize in parallel; modules cannot move between LLVM contexts
+  std::vector<llvm::SmallVector<char, 0>> bitcode(partitions_.size());
+  for (size_t i = 1; i < partitions_.size(); ++i) {
+    pool_.async([this, &bitcode, i] {
+      llvm::raw_svector_ostream stream(bitcode[i]);
+      llvm::WriteBitcodeToFile(partitions_[i]->getContext().getModule(),
+                               stream);
+    });
+  }
+  pool_.wait();
+
+  // Each generated function is one partition, to be cached as it is
+  std::vector<std::pair<std::string, llvm::StringRef>> modules;
+  generated_.clear();
+  for (size_t i = 1; i < partitions_.size(); ++i) {
+    llvm::StringRef contents(bitcode[i].data(), bitcode[i].size());
+    modules.emplace_back("partition" + std::to_string(i), contents);
+    if (caching_) {
+      generated_.emplace_back(*assignments_[i].definitions.begin(),
+                              contents.str());
+    }
+  }
+  for (const auto *function : linkOrder_) {
+    modules.emplace_back("reused " + function->getName(),
+                         reused_.at(function));
+  }
+
+  LLVMContext &primary = partitions_[0]->getContext();
+  for (const auto &[name, contents] : modules) {
+    llvm::MemoryBufferRef buffer(contents, name);
+    auto module = llvm::parseBitcodeFile(buffer, primary.getContext());
+    if (!module) {
+      errorReporter_.error(core::SourceLocation(),
+                           "Failed to load " + name + ": " +
+                               llvm::toString(module.takeError()));
+      return false;
+    }
+    if (llvm::Linker::linkModules(primary.getModule(), std::move(*module))) {
+      errorReporter_.error(core::SourceLocation(), "Failed to link " + name);
+      return false;
+    }
+  }
+
+  partitions_.resize(1);
+  return true;
+}
+
+bool LLVMParallelCodeGen::writeExecutable(const std::string &filename) {
+  std::vector<std::string> objectFiles;
+  for (size_t i = 0; i < partitions_.size(); ++i) {
+    objectFiles.push_back(filename + ".part" + std::to_string(i) + ".o");
+  }
+
+  std::vector<char> results(partitions_.size(), false);
+  for (size_t i = 0; i < partitions_.size(); ++i) {
+    pool_.async([this, &objectFiles, &results, i] {
+      results[i] = partitions_[i]->writeToFile(objectFiles[i]);
+    });
+  }
+  pool_.wait();
+
+  bool success = std::all_of(results.begin(), results.end(),
+                             [](char result) { return result; });
+  LLVMTarget &target = partitions_[0]->getTarget();
+  if (success &&
+      !target.linkExecutable(objectFiles, filename, options_)) {
+    errorReporter_.error(core::SourceLocation(), target.getLastError());
+    success = false;
+  }
+
+  for (const auto &objectFile : objectFiles) {
+    llvm::sys::fs::remove(objectFile);
+  }
+  return success;
+}
+
+bool LLVMParallelCodeGen::writeToFile(const std::string &filename) {
+  if (partitions_.empty()) {
+    return false;
+  }
+  if (partitions_.size() > 1 && !caching_ &&
+      options_.getOutputFormat() == OutputFormat::EXECUTABLE) {
+    return writeExecutable(filename);
+  }
+  if ((partitions_.size() > 1 || caching_) && !linkPartitions()) {
+    return false;
+  }
+  return partitions_[0]->writeToFile(filename);
+}
+
+bool LLVMParallelCodeGen::executeCode() {
+  if (partitions_.empty()) {
+    return false;
+  }
+  if ((partitions_.size() > 1 || caching_) && !linkPartitions()) {
+    return false;
+  }
+  return partitions_[0]->executeCode();
+}
+
+bool LLVMParallelCodeGen::loadForExecution() {
+  if (partitions_.empty()) {
+    return false;
+  }
+  if ((partitions_.size() > 1 || caching_) && !linkPartitions()) {
+    return false;
+  }
+  return partitions_[0]->loadForExecution();
+}
+
+uint64_t LLVMParallelCodeGen::getExecutionAddress(const std::string &name) {
+  return partitions_.empty() ? 0
+                             : partitions_[0]->getExecutionAddress(name);
+}
+
+} // namespace codegen
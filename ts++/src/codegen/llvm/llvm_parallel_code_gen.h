@@ -0,0 +1,159 @@
+#pragma once
+#include "codegen/codegen_options.h"
+#include "core/diagnostics/error_reporter.h"
+#include "llvm_code_gen.h"
+#include "parser/ast.h"
+#include "llvm/Support/ThreadPool.h"
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace codegen {
+
+/**
+ * @class LLVMParallelCodeGen
+ * @brief Generates and optimizes a program as parallel partitions
+ *
+ * Splits the top-level functions into one partition per code generation
+ * thread, balanced by body size. Each partition has its own LLVMCodeGen, and
+ * so its own llvm::LLVMContext and IRBuilder, and is generated and optimized
+ * on a thread pool. Functions of other partitions are only declared. For an
+ * executable every partition is emitted as its own object and the objects
+ * are linked; other outputs link the partitions into the first one.
+ *
+ * Inlining cannot cross partition boundaries. With a single thread this is
+ * an ordinary LLVMCodeGen run.
+ *
+ * With function caching, as for incremental builds, every function that is
+ * not reused gets a partition of its own and the first one only holds the
+ * entry. Each new function's bitcode is then self-contained and can be
+ * cached, and reused bitcode is linked in with the rest.
+ */
+class LLVMParallelCodeGen {
+public:
+  /**
+   * @brief Constructs a parallel code generator
+   * @param errorReporter Error reporter shared by all partitions
+   * @param options Code generation options, including the thread count
+   */
+  LLVMParallelCodeGen(core::ErrorReporter &errorReporter,
+                      const CodeGenOptions &options);
+
+  /**
+   * @brief Makes the functions of a separately compiled program callable
+   * @param interface The imported interface
+   */
+  void addImport(std::shared_ptr<const visitors::ModuleInterface> interface) {
+    imports_.push_back(std::move(interface));
+  }
+
+  /**
+   * @brief Takes the bodies of streamed functions from a stream
+   * @param stream The stream, shared by every partition
+   */
+  void setBodyStream(parser::BodyStream *stream) { bodyStream_ = stream; }
+
+  /**
+   * @brief Generates each function alone and links in earlier bitcode
+   * @param reused Bitcode of the functions not to generate again
+   */
+  void setFunctionCaching(
+      std::unordered_map<const nodes::FunctionDeclNode *, std::string>
+          reused) {
+    caching_ = true;
+    reused_ = std::move(reused);
+  }
+
+  /**
+   * @brief Gets the bitcode of each function generated with caching
+   *
+   * Filled in by writeToFile(), in program order.
+   */
+  const std::vector<std::pair<const nodes::FunctionDeclNode *, std::string>> &
+  getGeneratedFunctions() const {
+    return generated_;
+  }
+
+  /**
+   * @brief Generates and optimizes all partitions of an AST
+   * @param ast The TS++ AST
+   * @return True if every partition was generated successfully
+   */
+  bool generateCode(const parser::AST &ast);
+
+  /**
+   * @brief Writes the program in the configured output format
+   * @param filename Path to the output file
+   * @return True if the operation was successful
+   */
+  bool writeToFile(const std::string &filename);
+
+  /**
+   * @brief Links the partitions and runs main in a JIT session
+   *
+   * The session lives as long as this generator. As with writeToFile(),
+   * the bitcode of each function generated with caching is kept.
+   *
+   * @return True if main was run
+   */
+  bool executeCode();
+
+  /**
+   * @brief Links the partitions and loads them into a JIT session without
+   * running main
+   * @return True if the program was loaded
+   */
+  bool loadForExecution();
+
+  /**
+   * @brief Gets the address of a function loaded by loadForExecution()
+   * @param name Name of the function
+   * @return The address, or 0 if there is none
+   */
+  uint64_t getExecutionAddress(const std::string &name);
+
+  /**
+   * @brief Gets the number of partitions of the last generateCode() call
+   */
+  size_t getPartitionCount() const { return partitions_.size(); }
+
+private:
+  /**
+   * @brief Assigns function definitions to partitions, largest first
+   * @param ast The TS++ AST
+   */
+  void partitionFunctions(const parser::AST &ast);
+
+  /**
+   * @brief Links every partition and any reused bitcode into the first one
+   * @return True if linking succeeded
+   */
+  bool linkPartitions();
+
+  /**
+   * @brief Emits one object per partition and links them
+   * @param filename Path to the executable
+   * @return True if the executable was written
+   */
+  bool writeExecutable(const std::string &filename);
+
+  core::ErrorReporter &errorReporter_;                   ///< Shared diagnostics
+  CodeGenOptions options_;                               ///< Requested options
+  std::vector<CodeGenPartition> assignments_;            ///< Share of each
+  std::vector<std::unique_ptr<LLVMCodeGen>> partitions_; ///< One per share
+  std::vector<std::shared_ptr<const visitors::ModuleInterface>>
+      imports_; ///< Passed to every partition
+  parser::BodyStream *bodyStream_ = nullptr; ///< Passed to every partition
+  bool caching_ = false; ///< One partition per generated function
+  std::unordered_map<const nodes::FunctionDeclNode *, std::string>
+      reused_; ///< Bitcode of functions that are not generated
+  std::vector<const nodes::FunctionDeclNode *>
+      linkOrder_; ///< Reused functions in program order
+  std::vector<std::pair<const nodes::FunctionDeclNode *, std::string>>
+      generated_;         ///< Bitcode of functions that were
+  llvm::ThreadPool pool_; ///< Worker threads
+};
+
+} // namespace codegen
@@ -0,0 +1,110 @@
+#include "codegen/llvm/llvm_refcount_elision.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/IntrinsicInst.h"
+
+namespace codegen {
+
+namespace {
+
+llvm::StringRef calleeName(const llvm::CallInst *call) {
+  llvm::Function *callee = call->getCalledFunction();
+  return callee ? callee->getName() : llvm::StringRef();
+}
+
+// The release that undoes a retain, or an empty name
+llvm::StringRef releaseFor(llvm::StringRef retain) {
+  if (retain == "tspp_shared_retain") {
+    return "tspp_shared_release";
+  }
+  if (retain == "tspp_weak_retain") {
+    return "tspp_weak_release";
+  }
+  return llvm::StringRef();
+}
+
+// Runtime calls that do nothing for a null object
+bool ignoresNull(llvm::StringRef name) {
+  return !releaseFor(name).empty() || name == "tspp_shared_release" ||
+         name == "tspp_weak_release" || name == "tspp_shared_publish" ||
+         name == "tspp_free";
+}
+
+} // namespace
+
+llvm::PreservedAnalyses
+RefCountElisionPass::run(llvm::Function &function,
+                         llvm::FunctionAnalysisManager &) {
+  if (elidePairs(function) == 0) {
+    return llvm::PreservedAnalyses::all();
+  }
+  llvm::PreservedAnalyses preserved;
+  preserved.preserveSet<llvm::CFGAnalyses>();
+  return preserved;
+}
+
+unsigned RefCountElisionPass::elidePairs(llvm::Function &function) {
+  // Collect first; removing pairs edits the instruction lists
+  llvm::SmallVector<llvm::CallInst *, 8> retains;
+  llvm::SmallVector<llvm::CallInst *, 8> nullUpdates;
+  for (auto &block : function) {
+    for (auto &instruction : block) {
+      auto call = llvm::dyn_cast<llvm::CallInst>(&instruction);
+      if (!call) {
+        continue;
+      }
+      llvm::StringRef name = calleeName(call);
+      bool isNull = call->arg_size() == 1 &&
+                    llvm::isa<llvm::ConstantPointerNull>(
+                        call->getArgOperand(0)->stripPointerCasts());
+      // A moved-from #unique or never-set #shared local releases null
+      if (isNull && ignoresNull(name)) {
+        nullUpdates.push_back(call);
+      } else if (!releaseFor(name).empty()) {
+        retains.push_back(call);
+      }
+    }
+  }
+
+  unsigned elided = 0;
+  for (llvm::CallInst *update : nullUpdates) {
+    update->eraseFromParent();
+    ++elided;
+  }
+  for (llvm::CallInst *retain : retains) {
+    if (llvm::CallInst *release = findRelease(retain)) {
+      release->eraseFromParent();
+      retain->eraseFromParent();
+      ++elided;
+    }
+  }
+  return elided;
+}
+
+llvm::CallInst *RefCountElisionPass::findRelease(llvm::CallInst *retain) {
+  llvm::StringRef release = releaseFor(calleeName(retain));
+  llvm::Value *object = retain->getArgOperand(0)->stripPointerCasts();
+
+  for (auto it = std::next(retain->getIterator()),
+            end = retain->getParent()->end();
+       it != end; ++it) {
+    auto call = llvm::dyn_cast<llvm::CallInst>(&*it);
+    if (!call || llvm::isa<llvm::DbgInfoIntrinsic>(call)) {
+      // Loads, stores and arithmetic never drop a reference
+      continue;
+    }
+
+    llvm::StringRef name = calleeName(call);
+    if (name == release &&
+        call->getArgOperand(0)->stripPointerCasts() == object) {
+      return call;
+    }
+    // Extra references and publishing keep everything alive; anything else
+    // may release an alias of the object
+    if (releaseFor(name).empty() && name != "tspp_shared_publish") {
+      return nullptr;
+    }
+  }
+  return nullptr;
+}
+
+} // namespace codegen
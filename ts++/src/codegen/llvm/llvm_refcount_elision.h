@@ -0,0 +1,44 @@
+#pragma once
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/PassManager.h"
+
+namespace codegen {
+
+/**
+ * @class RefCountElisionPass
+ * @brief Removes reference count updates that cancel out within a block
+ *
+ * Copying a #shared or #weak pointer into a local retains the object and
+ * the local's scope exit releases it again. When the release of the same
+ * object follows in the same block, with no call in between that could
+ * drop another reference, the copy never needed its own count and both
+ * calls are removed. Retains of other objects do not block a pair.
+ * Count updates and frees of a null pointer, left behind by moved-from
+ * #unique pointers, are dropped as well.
+ *
+ * The pass runs after mem2reg, where copies of one pointer have become
+ * the same SSA value.
+ */
+class RefCountElisionPass : public llvm::PassInfoMixin<RefCountElisionPass> {
+public:
+  llvm::PreservedAnalyses run(llvm::Function &function,
+                              llvm::FunctionAnalysisManager &);
+
+  /**
+   * @brief Removes every cancelling retain/release pair in a function
+   * @param function The function to transform
+   * @return Number of pairs and null updates removed
+   */
+  static unsigned elidePairs(llvm::Function &function);
+
+private:
+  /**
+   * @brief Finds the release that cancels a retain
+   * @param retain A tspp_shared_retain or tspp_weak_retain call
+   * @return The matching release later in the block, or nullptr
+   */
+  static llvm::CallInst *findRelease(llvm::CallInst *retain);
+};
+
+} // namespace codegen
@@ -0,0 +1,172 @@
+#include "codegen/llvm/llvm_string_switch.h"
+#include <algorithm>
+#include <numeric>
+#include <set>
+
+namespace codegen {
+
+namespace {
+
+// Displacements tried for one bucket before another seed is tried
+constexpr uint32_t kMaxDisplacement = 1u << 16;
+
+// Seeds tried for each table size
+constexpr unsigned kSeeds = 64;
+
+// Labels in a bucket, on average
+constexpr size_t kBucketSize = 4;
+
+unsigned ceilLog2(size_t value) {
+  unsigned bits = 0;
+  while ((size_t(1) << bits) < value) {
+    ++bits;
+  }
+  return bits;
+}
+
+// SplitMix64, so each attempt starts from an unrelated seed
+uint64_t seedFor(unsigned attempt) {
+  uint64_t z = (attempt + 1) * 0x9e3779b97f4a7c15;
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+  return z ^ (z >> 31);
+}
+
+} // namespace
+
+bool StringSwitchPlan::build(const std::vector<std::string> &labels) {
+  if (labels.empty() || !selectPositions(labels)) {
+    return false;
+  }
+
+  // Slots are the next power of two, so they are over half full; a second
+  // round doubles them in case no seed fits
+  unsigned baseBits = ceilLog2(labels.size());
+  bucketBits = ceilLog2((labels.size() + kBucketSize - 1) / kBucketSize);
+  for (unsigned extra = 0; extra < 2; ++extra) {
+    slotBits = baseBits + extra;
+    for (unsigned attempt = 0; attempt < kSeeds; ++attempt) {
+      seed = seedFor(attempt);
+      if (place(labels)) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+bool StringSwitchPlan::selectPositions(const std::vector<std::string> &labels) {
+  // Greedily adds the position that splits the labels into the most
+  // classes until every label is alone in its class
+  size_t length = labels.front().size();
+  std::vector<std::string> keys(labels.size());
+  size_t classes = 1;
+  positions.clear();
+  while (classes < labels.size()) {
+    size_t best = length;
+    size_t bestClasses = classes;
+    for (size_t position = 0; position < length; ++position) {
+      std::set<std::string> distinct;
+      for (size_t i = 0; i < labels.size(); ++i) {
+        distinct.insert(keys[i] + labels[i][position]);
+      }
+      if (distinct.size() > bestClasses) {
+        best = position;
+        bestClasses = distinct.size();
+      }
+    }
+    // Only equal labels are left together
+    if (best == length) {
+      return false;
+    }
+    positions.push_back(best);
+    for (size_t i = 0; i < labels.size(); ++i) {
+      keys[i] += labels[i][best];
+    }
+    classes = bestClasses;
+  }
+  return true;
+}
+
+bool StringSwitchPlan::place(const std::vector<std::string> &labels) {
+  // Labels whose whole hashes agree can never be told apart
+  std::vector<uint64_t> hashes;
+  for (const auto &label : labels) {
+    hashes.push_back(hash(label.data()));
+  }
+  std::vector<uint64_t> sorted = hashes;
+  std::sort(sorted.begin(), sorted.end());
+  if (std::adjacent_find(sorted.begin(), sorted.end()) != sorted.end()) {
+    return false;
+  }
+
+  std::vector<std::vector<size_t>> buckets(size_t(1) << bucketBits);
+  for (size_t i = 0; i < labels.size(); ++i) {
+    buckets[bucketOf(hashes[i])].push_back(i);
+  }
+  std::vector<size_t> order(buckets.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return buckets[a].size() > buckets[b].size();
+  });
+
+  // The fullest buckets go first, while most slots are still free
+  std::vector<bool> used(size_t(1) << slotBits);
+  displacements.assign(buckets.size(), 0);
+  slots.assign(labels.size(), 0);
+  for (size_t bucket : order) {
+    const auto &members = buckets[bucket];
+    if (members.empty()) {
+      continue;
+    }
+    bool placed = false;
+    for (uint32_t d = 0; d < kMaxDisplacement && !placed; ++d) {
+      std::vector<uint32_t> taken;
+      for (size_t member : members) {
+        uint32_t slot = slotOf(hashes[member], d);
+        if (used[slot] ||
+            std::find(taken.begin(), taken.end(), slot) != taken.end()) {
+          break;
+        }
+        taken.push_back(slot);
+      }
+      if (taken.size() != members.size()) {
+        continue;
+      }
+      displacements[bucket] = d;
+      for (size_t i = 0; i < members.size(); ++i) {
+        used[taken[i]] = true;
+        slots[members[i]] = taken[i];
+      }
+      placed = true;
+    }
+    if (!placed) {
+      return false;
+    }
+  }
+  return true;
+}
+
+uint64_t StringSwitchPlan::hash(const char *bytes) const {
+  uint64_t h = seed;
+  for (size_t position : positions) {
+    h = (h ^ static_cast<unsigned char>(bytes[position])) * kStep;
+  }
+  return h;
+}
+
+uint32_t StringSwitchPlan::bucketOf(uint64_t hash) const {
+  return bucketBits ? uint32_t((hash * kBucketMix) >> (64 - bucketBits)) : 0;
+}
+
+uint32_t StringSwitchPlan::slotOf(uint64_t hash, uint32_t displacement) const {
+  return slotBits ? uint32_t(((hash ^ displacement) * kMix) >> (64 - slotBits))
+                  : 0;
+}
+
+uint32_t StringSwitchPlan::slotOf(const char *bytes) const {
+  uint64_t h = hash(bytes);
+  return slotOf(h, displacements[bucketOf(h)]);
+}
+
+} // namespace codegen
@@ -0,0 +1,74 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace codegen {
+
+/**
+ * @class StringSwitchPlan
+ * @brief Compile-time perfect hash of the case labels of one length in a
+ * switch over strings
+ *
+ * A switch over strings first dispatches on the length, which leaves a
+ * group of labels with the same number of bytes. Only a few byte
+ * positions are needed to tell them apart, so only those are hashed,
+ * in the style of gperf:
+ *
+ *   h = seed; for each position p: h = (h ^ bytes[p]) * kStep
+ *
+ * The hash then picks a slot by hash and displace. Its top bits after
+ * mixing name a bucket, and the bucket's displacement, chosen here, is
+ * mixed back in:
+ *
+ *   bucket = (h * kBucketMix) >> (64 - bucketBits)
+ *   slot = ((h ^ displacements[bucket]) * kMix) >> (64 - slotBits)
+ *
+ * Every label gets its own slot, and there are fewer than twice as many
+ * slots as labels unless no seed fits that many, so a switch on the slot
+ * is dense enough for a jump table. A string that reaches a slot may still differ from its label
+ * anywhere else, which a single memcmp confirms.
+ */
+class StringSwitchPlan {
+public:
+  static constexpr uint64_t kStep = 0x100000001b3;           // FNV prime
+  static constexpr uint64_t kBucketMix = 0xc2b2ae3d27d4eb4f; // Murmur3
+  static constexpr uint64_t kMix = 0x9e3779b97f4a7c15;       // 2^64 / phi
+
+  /**
+   * @brief Finds a perfect hash of some labels
+   * @param labels Distinct strings, all of the same length
+   * @return False if none was found, which is not expected in practice;
+   *         the labels are then compared one by one
+   */
+  bool build(const std::vector<std::string> &labels);
+
+  /**
+   * @brief Hashes the selected positions of a string's bytes
+   */
+  uint64_t hash(const char *bytes) const;
+
+  /**
+   * @brief Gets the bucket of a hash
+   */
+  uint32_t bucketOf(uint64_t hash) const;
+
+  /**
+   * @brief Gets the slot a string's bytes select
+   */
+  uint32_t slotOf(const char *bytes) const;
+
+  std::vector<size_t> positions;       // Bytes that are hashed, in order
+  uint64_t seed = 0;                   // Starting value of the hash
+  unsigned bucketBits = 0;             // log2 of the number of buckets
+  unsigned slotBits = 0;               // log2 of the number of slots
+  std::vector<uint32_t> displacements; // One for each bucket
+  std::vector<uint32_t> slots;         // Slot of each label, in order
+
+private:
+  bool selectPositions(const std::vector<std::string> &labels);
+  bool place(const std::vector<std::string> &labels);
+  uint32_t slotOf(uint64_t hash, uint32_t displacement) const;
+};
+
+} // namespace codegen
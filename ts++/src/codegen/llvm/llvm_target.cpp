@@ -0,0 +1,322 @@
+#include "codegen/llvm/llvm_target.h"
+#include "core/common/time_report.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/MC/MCSubtargetInfo.h"
+#include "llvm/MC/TargetRegistry.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/Program.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetOptions.h"
+#include <mutex>
+#include <unordered_map>
+
+namespace codegen {
+
+namespace {
+
+llvm::CodeGenOpt::Level codeGenOptLevel(OptimizationLevel level) {
+  switch (level) {
+  case OptimizationLevel::O0:
+    return llvm::CodeGenOpt::None;
+  case OptimizationLevel::Og:
+  case OptimizationLevel::O1:
+    return llvm::CodeGenOpt::Less;
+  case OptimizationLevel::O3:
+    return llvm::CodeGenOpt::Aggressive;
+  default:
+    return llvm::CodeGenOpt::Default;
+  }
+}
+
+// The host's CPU and features, which are queried once per process
+struct HostCPU {
+  std::string name;
+  std::string features; ///< "+feature,-feature,..."
+};
+
+const HostCPU &getHostCPU() {
+  static const HostCPU host = [] {
+    HostCPU result{llvm::sys::getHostCPUName().str(), ""};
+    llvm::StringMap<bool> features;
+    if (llvm::sys::getHostCPUFeatures(features)) {
+      for (const auto &feature : features) {
+        result.features +=
+            (feature.second ? "+" : "-") + feature.first().str() + ",";
+      }
+    }
+    return result;
+  }();
+  return host;
+}
+
+// Target machines no code generator holds, by everything they were
+// created from. A machine caches subtargets as it compiles, so each one
+// serves a single code generator at a time.
+struct MachinePool {
+  std::mutex mutex;
+  std::unordered_map<std::string,
+                     std::vector<std::unique_ptr<llvm::TargetMachine>>>
+      idle;
+  unsigned created = 0;
+};
+
+MachinePool &getMachinePool() {
+  static MachinePool pool;
+  return pool;
+}
+
+} // namespace
+
+LLVMTarget::~LLVMTarget() { release(); }
+
+bool LLVMTarget::initialize(const CodeGenOptions &options) {
+  static std::once_flag initialized;
+  std::call_once(initialized, [] {
+    llvm::InitializeAllTargetInfos();
+    llvm::InitializeAllTargets();
+    llvm::InitializeAllTargetMCs();
+    llvm::InitializeAllAsmPrinters();
+    llvm::InitializeAllAsmParsers();
+  });
+  release();
+
+  triple_ = options.getTargetTriple().empty()
+                ? resolveTriple(options.getTargetArch())
+                : llvm::Triple(
+                      llvm::Triple::normalize(options.getTargetTriple()));
+
+  // Tune for the host CPU when compiling for the host itself, unless a
+  // CPU was asked for
+  std::string cpu = options.getTargetCPU().empty() ? "generic"
+                                                   : options.getTargetCPU();
+  std::string features;
+  if (options.getTargetCPU().empty() &&
+      triple_.getArch() ==
+          llvm::Triple(llvm::sys::getProcessTriple()).getArch()) {
+    cpu = getHostCPU().name;
+    features = getHostCPU().features;
+  }
+  features += options.getTargetFeatures();
+
+  auto relocModel = options.isPICEnabled() && !triple_.isWasm()
+                        ? llvm::Reloc::PIC_
+                        : llvm::Reloc::Static;
+  auto optLevel = codeGenOptLevel(options.getOptimizationLevel());
+  machineKey_ = triple_.str() + "\n" + cpu + "\n" + features + "\n" +
+                std::to_string(relocModel) + "\n" + std::to_string(optLevel);
+
+  MachinePool &pool = getMachinePool();
+  {
+    std::lock_guard<std::mutex> lock(pool.mutex);
+    auto it = pool.idle.find(machineKey_);
+    if (it != pool.idle.end() && !it->second.empty()) {
+      targetMachine_ = std::move(it->second.back());
+      it->second.pop_back();
+      return true;
+    }
+  }
+
+  std::string error;
+  const llvm::Target *target =
+      llvm::TargetRegistry::lookupTarget(triple_.str(), error);
+  if (!target) {
+    lastError_ = error;
+    return false;
+  }
+
+  llvm::TargetOptions targetOptions;
+  targetMachine_.reset(target->createTargetMachine(
+      triple_.str(), cpu, features, targetOptions, relocModel, llvm::None,
+      optLevel));
+  if (!targetMachine_) {
+    lastError_ = "Could not create target machine for " + triple_.str();
+    return false;
+  }
+  if (!targetMachine_->getMCSubtargetInfo()->isCPUStringValid(cpu)) {
+    lastError_ = "Unknown CPU " + cpu + " for " + triple_.str();
+    targetMachine_.reset();
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(pool.mutex);
+  ++pool.created;
+  return true;
+}
+
+unsigned LLVMTarget::getCreatedMachineCount() {
+  MachinePool &pool = getMachinePool();
+  std::lock_guard<std::mutex> lock(pool.mutex);
+  return pool.created;
+}
+
+void LLVMTarget::release() {
+  if (!targetMachine_) {
+    return;
+  }
+  MachinePool &pool = getMachinePool();
+  std::lock_guard<std::mutex> lock(pool.mutex);
+  pool.idle[machineKey_].push_back(std::move(targetMachine_));
+}
+
+void LLVMTarget::configureModule(llvm::Module &module) const {
+  if (!targetMachine_) {
+    return;
+  }
+  module.setTargetTriple(triple_.str());
+  module.setDataLayout(targetMachine_->createDataLayout());
+}
+
+bool LLVMTarget::emitFile(llvm::Module &module, const std::string &filename,
+                          llvm::CodeGenFileType fileType) {
+  if (!targetMachine_) {
+    lastError_ = "No target machine for " + triple_.str();
+    return false;
+  }
+  configureModule(module);
+
+  std::error_code errorCode;
+  llvm::raw_fd_ostream dest(filename, errorCode, llvm::sys::fs::OF_None);
+  if (errorCode) {
+    lastError_ = "Could not open " + filename + ": " + errorCode.message();
+    return false;
+  }
+
+  // The legacy pass manager still drives the code generator in LLVM 14
+  llvm::legacy::PassManager passManager;
+  if (targetMachine_->addPassesToEmitFile(passManager, dest, nullptr,
+                                          fileType)) {
+    lastError_ = "Target " + triple_.str() + " cannot emit this file type";
+    return false;
+  }
+
+  passManager.run(module);
+  dest.flush();
+  return true;
+}
+
+bool LLVMTarget::linkExecutable(const std::vector<std::string> &objectFiles,
+                                const std::string &outputFile,
+                                const CodeGenOptions &options) {
+  core::TimeReport::Scope timer("Link", outputFile);
+  if (triple_.isWasm()) {
+    return linkWasmModule(objectFiles, outputFile);
+  }
+
+  // Use whichever C compiler driver is installed to link against libc.
+  // Instrumented code needs clang, which links in LLVM's profile runtime;
+  // gcc would link gcov, which does not know LLVM's counters.
+  bool instrumented = options.isProfileGenerateEnabled();
+  std::vector<const char *> drivers = {"cc", "clang", "gcc"};
+  if (instrumented) {
+    drivers = {"clang"};
+  }
+  llvm::ErrorOr<std::string> driver =
+      std::make_error_code(std::errc::no_such_file_or_directory);
+  for (const char *name : drivers) {
+    driver = llvm::sys::findProgramByName(name);
+    if (driver) {
+      break;
+    }
+  }
+  if (!driver) {
+    lastError_ = instrumented
+                     ? "Instrumented executables are linked with clang, "
+                       "which was not found in PATH"
+                     : "No linker driver (cc, clang or gcc) found in PATH";
+    return false;
+  }
+
+  std::vector<llvm::StringRef> args = {*driver};
+  args.insert(args.end(), objectFiles.begin(), objectFiles.end());
+  args.push_back(TSPP_RUNTIME_LIBRARY);
+  args.push_back("-pthread"); // For the workers of #parallel loops
+  args.push_back("-o");
+  args.push_back(outputFile);
+  if (!options.isPICEnabled()) {
+    args.push_back("-no-pie");
+  }
+  if (instrumented) {
+    args.push_back("-fprofile-generate");
+  }
+
+  std::string error;
+  int status = llvm::sys::ExecuteAndWait(*driver, args, llvm::None, {}, 0, 0,
+                                         &error);
+  if (status != 0) {
+    lastError_ = "Linking failed" + (error.empty() ? "" : ": " + error);
+    return false;
+  }
+  return true;
+}
+
+bool LLVMTarget::linkWasmModule(const std::vector<std::string> &objectFiles,
+                                const std::string &outputFile) {
+#ifdef TSPP_WASM_RUNTIME_LIBRARY
+  llvm::ErrorOr<std::string> linker =
+      std::make_error_code(std::errc::no_such_file_or_directory);
+  for (const char *name : {"wasm-ld", "wasm-ld-14"}) {
+    linker = llvm::sys::findProgramByName(name);
+    if (linker) {
+      break;
+    }
+  }
+  if (!linker) {
+    lastError_ = "WebAssembly modules are linked with wasm-ld, which was not "
+                 "found in PATH";
+    return false;
+  }
+
+  // There is no entry point; the host calls the exported functions. What
+  // the exports cannot reach is dropped, down to the runtime's functions.
+  std::vector<llvm::StringRef> args = {*linker, "--no-entry", "--gc-sections",
+                                       "--strip-all"};
+  args.insert(args.end(), objectFiles.begin(), objectFiles.end());
+  args.push_back(TSPP_WASM_RUNTIME_LIBRARY);
+  args.push_back("-o");
+  args.push_back(outputFile);
+
+  std::string error;
+  int status = llvm::sys::ExecuteAndWait(*linker, args, llvm::None, {}, 0, 0,
+                                         &error);
+  if (status != 0) {
+    lastError_ = "Linking failed" + (error.empty() ? "" : ": " + error);
+    return false;
+  }
+  return true;
+#else
+  (void)objectFiles;
+  (void)outputFile;
+  lastError_ = "This compiler was built without the WebAssembly runtime "
+               "(see TSPP_WASI_SYSROOT); emit an object with -c instead";
+  return false;
+#endif
+}
+
+llvm::Triple LLVMTarget::resolveTriple(TargetArch arch) {
+  llvm::Triple triple(llvm::sys::getDefaultTargetTriple());
+
+  switch (arch) {
+  case TargetArch::X86:
+    triple.setArch(llvm::Triple::x86);
+    break;
+  case TargetArch::X86_64:
+    triple.setArch(llvm::Triple::x86_64);
+    break;
+  case TargetArch::ARM:
+    triple.setArch(llvm::Triple::arm);
+    break;
+  case TargetArch::AARCH64:
+    triple.setArch(llvm::Triple::aarch64);
+    break;
+  case TargetArch::WASM:
+    triple = llvm::Triple("wasm32-unknown-unknown");
+    break;
+  case TargetArch::AUTO:
+    break;
+  }
+  return triple;
+}
+
+} // namespace codegen
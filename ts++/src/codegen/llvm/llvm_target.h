@@ -0,0 +1,133 @@
+#pragma once
+#include "codegen/codegen_options.h"
+#include "llvm/ADT/Triple.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Target/TargetMachine.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace codegen {
+
+/**
+ * @class LLVMTarget
+ * @brief Target machine selected by the code generation options
+ *
+ * Resolves the target triple from the requested triple or architecture
+ * and provides the matching llvm::TargetMachine. The optimizer uses it for
+ * target-aware cost models, and modules are stamped with its triple and
+ * data layout, which the type builder sizes types by.
+ *
+ * Machines are created once per target, CPU, features, relocation model
+ * and level, and go back to a process-wide pool when their LLVMTarget is
+ * reinitialized or destroyed. Later code generators, partitions and
+ * rebuilds in the same process, and runs forked by a compile server,
+ * reuse them; only code generators running at the same time get machines
+ * of their own.
+ */
+class LLVMTarget {
+public:
+  LLVMTarget() = default;
+  ~LLVMTarget();
+
+  LLVMTarget(const LLVMTarget &) = delete;
+  LLVMTarget &operator=(const LLVMTarget &) = delete;
+
+  /**
+   * @brief Takes the target machine for the given options from the pool,
+   * creating it if none is idle
+   * @param options Code generation options (triple or architecture, CPU,
+   * features, PIC, level)
+   * @return True on success; see getLastError() otherwise
+   */
+  bool initialize(const CodeGenOptions &options);
+
+  /**
+   * @brief Gets how many target machines this process has created
+   */
+  static unsigned getCreatedMachineCount();
+
+  /**
+   * @brief Checks whether a target machine is available
+   */
+  bool isInitialized() const { return targetMachine_ != nullptr; }
+
+  /**
+   * @brief Gets the target machine, or nullptr before initialize()
+   */
+  llvm::TargetMachine *getTargetMachine() const { return targetMachine_.get(); }
+
+  /**
+   * @brief Gets the resolved target triple
+   */
+  const llvm::Triple &getTriple() const { return triple_; }
+
+  /**
+   * @brief Sets the module's target triple and data layout
+   * @param module Module to configure
+   */
+  void configureModule(llvm::Module &module) const;
+
+  /**
+   * @brief Emits assembly or an object file for a module in-process
+   * @param module Module to compile; configured for this target first
+   * @param filename Path to the output file
+   * @param fileType Assembly or object output
+   * @return True on success; see getLastError() otherwise
+   */
+  bool emitFile(llvm::Module &module, const std::string &filename,
+                llvm::CodeGenFileType fileType);
+
+  /**
+   * @brief Links object files into an executable with the system driver
+   *
+   * The tspp runtime library (tspp_alloc and friends) is linked in after
+   * the objects. Instrumented code also needs LLVM's profile runtime,
+   * which only clang links in. WebAssembly objects are linked into a
+   * module instead; see linkWasmModule().
+   *
+   * @param objectFiles Object files produced by emitFile()
+   * @param outputFile Path to the executable
+   * @param options Whether the executable is position independent and
+   * instrumented
+   * @return True on success; see getLastError() otherwise
+   */
+  bool linkExecutable(const std::vector<std::string> &objectFiles,
+                      const std::string &outputFile,
+                      const CodeGenOptions &options);
+
+  /**
+   * @brief Gets the message of the most recent failure
+   */
+  const std::string &getLastError() const { return lastError_; }
+
+private:
+  /**
+   * @brief Links wasm32 objects and the runtime built for wasm32 into a
+   * module with wasm-ld, keeping only what its exports reach
+   * @param objectFiles Object files produced by emitFile()
+   * @param outputFile Path to the .wasm module
+   * @return True on success; see getLastError() otherwise
+   */
+  bool linkWasmModule(const std::vector<std::string> &objectFiles,
+                      const std::string &outputFile);
+
+  /**
+   * @brief Maps an architecture option onto the host triple
+   * @param arch Requested architecture
+   * @return The triple to compile for
+   */
+  static llvm::Triple resolveTriple(TargetArch arch);
+
+  /**
+   * @brief Returns the target machine to the pool
+   */
+  void release();
+
+  std::unique_ptr<llvm::TargetMachine> targetMachine_; // Selected machine
+  std::string machineKey_;                             // Pool entry
+  llvm::Triple triple_;                                // Resolved triple
+  std::string lastError_;                              // Last failure message
+};
+
+} // namespace codegen
@@ -1,5 +1,9 @@
 #include "codegen/llvm/llvm_type_builder.h"
+#include "parser/nodes/expression_nodes.h"
 #include "parser/visitors/type_check_visitor/resolved_type.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
 
 namespace codegen {
 
@@ -9,8 +13,18 @@ LLVMTypeBuilder::LLVMTypeBuilder(LLVMContext &context) : context_(context) {
   typeCache_["int"] = llvm::Type::getInt32Ty(context_.getContext());
   typeCache_["float"] = llvm::Type::getFloatTy(context_.getContext());
   typeCache_["bool"] = llvm::Type::getInt1Ty(context_.getContext());
-  typeCache_["string"] = llvm::PointerType::getUnqual(
-      llvm::Type::getInt8Ty(context_.getContext()));
+  typeCache_["string"] = llvm::StructType::create(
+      context_.getContext(),
+      {llvm::Type::getInt64Ty(context_.getContext()),
+       llvm::Type::getInt8PtrTy(context_.getContext()),
+       llvm::Type::getInt64Ty(context_.getContext())},
+      "string");
+  typeCache_["bytes"] =
+      getSliceType(llvm::Type::getInt8Ty(context_.getContext()));
+}
+
+llvm::StructType *LLVMTypeBuilder::getStringType() {
+  return llvm::cast<llvm::StructType>(typeCache_["string"]);
 }
 
 llvm::Type *LLVMTypeBuilder::convertType(
@@ -18,8 +32,18 @@ llvm::Type *LLVMTypeBuilder::convertType(
   if (!type) {
     return llvm::Type::getVoidTy(context_.getContext());
   }
+  auto it = converted_.find(type.get());
+  if (it != converted_.end()) {
+    return it->second.second;
+  }
+  llvm::Type *result = convertUncached(*type);
+  converted_.emplace(type.get(), std::make_pair(type, result));
+  return result;
+}
 
-  switch (type->getKind()) {
+llvm::Type *
+LLVMTypeBuilder::convertUncached(const visitors::ResolvedType &type) {
+  switch (type.getKind()) {
   case visitors::ResolvedType::TypeKind::Void:
     return llvm::Type::getVoidTy(context_.getContext());
 
@@ -33,11 +57,10 @@ llvm::Type *LLVMTypeBuilder::convertType(
     return llvm::Type::getInt1Ty(context_.getContext());
 
   case visitors::ResolvedType::TypeKind::String:
-    return llvm::PointerType::getUnqual(
-        llvm::Type::getInt8Ty(context_.getContext()));
+    return getStringType();
 
   case visitors::ResolvedType::TypeKind::Named: {
-    auto typeName = type->getName();
+    auto typeName = type.getName();
     auto it = typeCache_.find(typeName);
     if (it != typeCache_.end()) {
       return it->second;
@@ -48,24 +71,55 @@ llvm::Type *LLVMTypeBuilder::convertType(
     return structType;
   }
 
-  case visitors::ResolvedType::TypeKind::Array: {
-    auto elemType = convertType(type->getElementType());
-    // Use a pointer for now, as LLVM arrays are fixed size
-    return llvm::PointerType::getUnqual(elemType);
-  }
+  case visitors::ResolvedType::TypeKind::Array:
+    return getDynamicArrayType(convertType(type.getElementType()));
+
+  case visitors::ResolvedType::TypeKind::Slice:
+    return getSliceType(
+        type.isBytes() ? llvm::Type::getInt8Ty(context_.getContext())
+                       : convertType(type.getElementType()));
+
+  case visitors::ResolvedType::TypeKind::Template:
+    if (visitors::ResolvedType::getContainerArity(type.getName()) ==
+            type.getTemplateArgs().size() &&
+        !getTypeByName(type.getName())) {
+      std::vector<llvm::Type *> elementTypes;
+      for (const auto &arg : type.getTemplateArgs()) {
+        elementTypes.push_back(convertType(arg));
+      }
+      return getContainerType(type.getName(), elementTypes);
+    }
+    return llvm::PointerType::getUnqual(
+        llvm::Type::getInt8Ty(context_.getContext()));
+
+  case visitors::ResolvedType::TypeKind::Atomic:
+    // Only the operations on it differ
+    return convertType(type.getElementType());
+
+  case visitors::ResolvedType::TypeKind::Vector:
+    return llvm::FixedVectorType::get(convertType(type.getElementType()),
+                                      type.getLanes());
 
   case visitors::ResolvedType::TypeKind::Pointer: {
-    auto pointeeType = convertType(type->getPointeeType());
+    auto pointeeType = convertType(type.getPointeeType());
     return llvm::PointerType::getUnqual(pointeeType);
   }
 
+  case visitors::ResolvedType::TypeKind::Union: {
+    std::vector<llvm::Type *> arms;
+    for (const auto &arm : type.getUnionArms()) {
+      arms.push_back(convertType(arm));
+    }
+    return getUnionType(std::move(arms));
+  }
+
   case visitors::ResolvedType::TypeKind::Function: {
-    auto returnType = convertType(type->getReturnType());
+    auto returnType = convertType(type.getReturnType());
     std::vector<llvm::Type *> paramTypes;
-    for (const auto &paramType : type->getParameterTypes()) {
+    for (const auto &paramType : type.getParameterTypes()) {
       paramTypes.push_back(convertType(paramType));
     }
-    return llvm::PointerType::getUnqual(
+    return getClosureType(
         llvm::FunctionType::get(returnType, paramTypes, false));
   }
 
@@ -76,6 +130,146 @@ llvm::Type *LLVMTypeBuilder::convertType(
   }
 }
 
+llvm::Type *LLVMTypeBuilder::convertTypeNode(const nodes::TypeNode *type) {
+  auto &llvmContext = context_.getContext();
+  if (!type) {
+    return llvm::Type::getInt32Ty(llvmContext);
+  }
+
+  switch (type->getNodeKind()) {
+  case nodes::NodeKind::PrimitiveType: {
+    auto primitive = nodes::cast<nodes::PrimitiveTypeNode>(type);
+    if (primitive->isVector()) {
+      return llvm::FixedVectorType::get(
+          primitive->getType() == tokens::TokenType::FLOAT
+              ? llvm::Type::getFloatTy(llvmContext)
+              : llvm::Type::getInt32Ty(llvmContext),
+          primitive->getLanes());
+    }
+    switch (primitive->getType()) {
+    case tokens::TokenType::VOID:
+      return llvm::Type::getVoidTy(llvmContext);
+    case tokens::TokenType::FLOAT:
+      return llvm::Type::getFloatTy(llvmContext);
+    case tokens::TokenType::BOOLEAN:
+      return llvm::Type::getInt1Ty(llvmContext);
+    case tokens::TokenType::STRING:
+      return typeCache_["string"];
+    default:
+      return llvm::Type::getInt32Ty(llvmContext);
+    }
+  }
+
+  case nodes::NodeKind::NamedType: {
+    const std::string &typeName =
+        nodes::cast<nodes::NamedTypeNode>(type)->getName();
+    if (llvm::Type *known = getTypeByName(typeName)) {
+      return known;
+    }
+    // Forward declaration, completed when the class is declared
+    auto structType = llvm::StructType::create(llvmContext, typeName);
+    typeCache_[typeName] = structType;
+    return structType;
+  }
+
+  case nodes::NodeKind::ArrayType: {
+    auto array = nodes::cast<nodes::ArrayTypeNode>(type);
+    llvm::Type *element = convertTypeNode(array->getElementType());
+    if (element->isVoidTy()) {
+      element = llvm::Type::getInt8Ty(llvmContext);
+    }
+
+    // A constant size is stored inline; anything else can grow
+    const nodes::ExpressionNode *size = array->getSize();
+    if (size && size->isFolded()) {
+      return llvm::ArrayType::get(element, size->getFoldedValue().int_value);
+    }
+    auto literal = nodes::dyn_cast<nodes::LiteralExpressionNode>(size);
+    if (literal && literal->getExpressionType() == tokens::TokenType::NUMBER &&
+        literal->getNumber().isInteger()) {
+      return llvm::ArrayType::get(element, literal->getNumber().integer);
+    }
+    return getDynamicArrayType(element);
+  }
+
+  case nodes::NodeKind::AtomicType:
+    return convertTypeNode(
+        nodes::cast<nodes::AtomicTypeNode>(type)->getValueType());
+
+  case nodes::NodeKind::TemplateType: {
+    auto templateType = nodes::cast<nodes::TemplateTypeNode>(type);
+    auto base =
+        nodes::dyn_cast<nodes::NamedTypeNode>(templateType->getBaseType());
+    const auto &args = templateType->getArguments();
+    if (base && base->getName() == "slice" && !getTypeByName("slice") &&
+        args.size() == 1) {
+      return getSliceType(convertTypeNode(args[0]));
+    }
+    if (base &&
+        visitors::ResolvedType::getContainerArity(base->getName()) ==
+            args.size() &&
+        !getTypeByName(base->getName())) {
+      std::vector<llvm::Type *> elementTypes;
+      for (const auto *arg : args) {
+        elementTypes.push_back(convertTypeNode(arg));
+      }
+      return getContainerType(base->getName(), elementTypes);
+    }
+    return llvm::Type::getInt32Ty(llvmContext);
+  }
+
+  case nodes::NodeKind::PointerType:
+  case nodes::NodeKind::ReferenceType:
+  case nodes::NodeKind::SmartPointerType: {
+    const nodes::TypeNode *baseType = nullptr;
+    if (auto pointer = nodes::dyn_cast<nodes::PointerTypeNode>(type)) {
+      baseType = pointer->getBaseType();
+    } else if (auto reference =
+                   nodes::dyn_cast<nodes::ReferenceTypeNode>(type)) {
+      baseType = reference->getBaseType();
+    } else {
+      baseType =
+          nodes::cast<nodes::SmartPointerTypeNode>(type)->getPointeeType();
+    }
+    llvm::Type *pointee = convertTypeNode(baseType);
+    if (pointee->isVoidTy()) {
+      pointee = llvm::Type::getInt8Ty(llvmContext);
+    }
+    return llvm::PointerType::getUnqual(pointee);
+  }
+
+  case nodes::NodeKind::UnionType: {
+    std::vector<llvm::Type *> arms;
+    std::vector<const nodes::TypeNode *> pending{type};
+    while (!pending.empty()) {
+      const nodes::TypeNode *next = pending.back();
+      pending.pop_back();
+      if (auto join = nodes::dyn_cast<nodes::UnionTypeNode>(next)) {
+        pending.push_back(join->getRight());
+        pending.push_back(join->getLeft());
+      } else {
+        arms.push_back(convertTypeNode(next));
+      }
+    }
+    return getUnionType(std::move(arms));
+  }
+
+  case nodes::NodeKind::FunctionType: {
+    auto function = nodes::cast<nodes::FunctionTypeNode>(type);
+    std::vector<llvm::Type *> paramTypes;
+    for (const auto *paramType : function->getParameterTypes()) {
+      paramTypes.push_back(convertTypeNode(paramType));
+    }
+    return getClosureType(llvm::FunctionType::get(
+        convertTypeNode(function->getReturnType()), paramTypes, false));
+  }
+
+  default:
+    // Other annotations are still simplified to i32
+    return llvm::Type::getInt32Ty(llvmContext);
+  }
+}
+
 llvm::Type *LLVMTypeBuilder::getTypeByName(const std::string &typeName) {
   auto it = typeCache_.find(typeName);
   if (it != typeCache_.end()) {
@@ -84,17 +278,251 @@ llvm::Type *LLVMTypeBuilder::getTypeByName(const std::string &typeName) {
   return nullptr;
 }
 
+void LLVMTypeBuilder::declareAlias(const std::string &typeName,
+                                   llvm::Type *type) {
+  // Conversions may have made a struct of the name
+  typeCache_[typeName] = type;
+  converted_.clear();
+}
+
+llvm::StructType *
+LLVMTypeBuilder::getDynamicArrayType(llvm::Type *elementType) {
+  auto structType = llvm::dyn_cast<llvm::StructType>(elementType);
+  if (structType && structType->hasName() &&
+      soaClasses_.count(structType->getName().str())) {
+    auto it = soaArrays_.find(structType);
+    if (it != soaArrays_.end()) {
+      return it->second;
+    }
+    // Named, so arrays of a class that is not laid out yet can be declared
+    auto arrayType = llvm::StructType::create(
+        context_.getContext(), structType->getName().str() + ".soa");
+    soaArrays_[structType] = arrayType;
+    soaElements_[arrayType] = structType;
+    if (!structType->isOpaque()) {
+      setStructOfArraysBody(arrayType, structType);
+    }
+    return arrayType;
+  }
+
+  llvm::Type *sizeType = llvm::Type::getInt64Ty(context_.getContext());
+  return llvm::StructType::get(context_.getContext(),
+                               {elementType->getPointerTo(), sizeType, sizeType});
+}
+
+void LLVMTypeBuilder::declareStructOfArrays(const std::string &typeName) {
+  soaClasses_.insert(typeName);
+}
+
+llvm::StructType *
+LLVMTypeBuilder::getStructOfArraysElement(llvm::Type *type) const {
+  auto structType = llvm::dyn_cast_or_null<llvm::StructType>(type);
+  if (!structType) {
+    return nullptr;
+  }
+  auto it = soaElements_.find(structType);
+  return it != soaElements_.end() ? it->second : nullptr;
+}
+
+void LLVMTypeBuilder::setStructOfArraysBody(llvm::StructType *arrayType,
+                                            llvm::StructType *elementType) {
+  // Columns are plain growable arrays, even of another #soa class
+  llvm::Type *sizeType = llvm::Type::getInt64Ty(context_.getContext());
+  std::vector<llvm::Type *> columns;
+  for (llvm::Type *fieldType : elementType->elements()) {
+    columns.push_back(llvm::StructType::get(
+        context_.getContext(),
+        {fieldType->getPointerTo(), sizeType, sizeType}));
+  }
+  arrayType->setBody(columns);
+
+  // Columns go by the names of their fields
+  auto it = fieldIndices_.find(elementType);
+  if (it != fieldIndices_.end()) {
+    fieldIndices_[arrayType] = it->second;
+  }
+}
+
+llvm::StructType *LLVMTypeBuilder::getUnionType(std::vector<llvm::Type *> arms) {
+  auto name = [](llvm::Type *type) {
+    std::string text;
+    llvm::raw_string_ostream stream(text);
+    type->print(stream);
+    return stream.str();
+  };
+  std::sort(arms.begin(), arms.end(), [&](llvm::Type *a, llvm::Type *b) {
+    return name(a) < name(b);
+  });
+  arms.erase(std::unique(arms.begin(), arms.end()), arms.end());
+  auto it = unions_.find(arms);
+  if (it != unions_.end()) {
+    return it->second;
+  }
+
+  // The payload is sized and aligned for the largest arm: integers up to
+  // 8 bytes, and beyond that the most aligned arm itself (a vector), so the
+  // struct's own layout places it
+  const llvm::DataLayout &dataLayout = context_.getModule().getDataLayout();
+  uint64_t size = 1;
+  uint64_t alignment = 1;
+  llvm::Type *unit = nullptr;
+  for (llvm::Type *arm : arms) {
+    if (!arm->isSized()) {
+      continue;
+    }
+    size = std::max<uint64_t>(size, dataLayout.getTypeAllocSize(arm));
+    uint64_t armAlignment = dataLayout.getABITypeAlign(arm).value();
+    if (armAlignment > alignment) {
+      alignment = armAlignment;
+      unit = arm;
+    }
+  }
+  if (alignment <= 8) {
+    unit = llvm::Type::getIntNTy(context_.getContext(), alignment * 8);
+  }
+  uint64_t unitSize = dataLayout.getTypeAllocSize(unit);
+  llvm::Type *payload =
+      llvm::ArrayType::get(unit, (size + unitSize - 1) / unitSize);
+  auto unionType = llvm::StructType::create(
+      context_.getContext(),
+      {llvm::Type::getInt32Ty(context_.getContext()), payload}, "union");
+  unions_[arms] = unionType;
+  unionArms_[unionType] = std::move(arms);
+  return unionType;
+}
+
+const std::vector<llvm::Type *> *
+LLVMTypeBuilder::getUnionArms(llvm::Type *type) const {
+  auto structType = llvm::dyn_cast_or_null<llvm::StructType>(type);
+  if (!structType) {
+    return nullptr;
+  }
+  auto it = unionArms_.find(structType);
+  return it != unionArms_.end() ? &it->second : nullptr;
+}
+
+llvm::StructType *
+LLVMTypeBuilder::getClosureType(llvm::FunctionType *signature) {
+  auto it = closures_.find(signature);
+  if (it != closures_.end()) {
+    return it->second;
+  }
+  auto closureType = llvm::StructType::create(
+      context_.getContext(),
+      {getClosureCodeType(signature)->getPointerTo(),
+       llvm::Type::getInt8PtrTy(context_.getContext())},
+      "closure");
+  closures_[signature] = closureType;
+  closureSignatures_[closureType] = signature;
+  return closureType;
+}
+
+llvm::FunctionType *
+LLVMTypeBuilder::getClosureSignature(llvm::Type *type) const {
+  auto structType = llvm::dyn_cast_or_null<llvm::StructType>(type);
+  if (!structType) {
+    return nullptr;
+  }
+  auto it = closureSignatures_.find(structType);
+  return it != closureSignatures_.end() ? it->second : nullptr;
+}
+
+llvm::FunctionType *
+LLVMTypeBuilder::getClosureCodeType(llvm::FunctionType *signature) {
+  std::vector<llvm::Type *> paramTypes{
+      llvm::Type::getInt8PtrTy(signature->getContext())};
+  paramTypes.insert(paramTypes.end(), signature->param_begin(),
+                    signature->param_end());
+  return llvm::FunctionType::get(signature->getReturnType(), paramTypes,
+                                 false);
+}
+
+llvm::StructType *LLVMTypeBuilder::getSliceType(llvm::Type *elementType) {
+  return llvm::StructType::get(
+      context_.getContext(),
+      {elementType->getPointerTo(),
+       llvm::Type::getInt64Ty(context_.getContext())});
+}
+
+bool LLVMTypeBuilder::isSliceType(llvm::Type *type) {
+  auto structType = llvm::dyn_cast<llvm::StructType>(type);
+  return structType && structType->isLiteral() &&
+         structType->getNumElements() == 2 &&
+         structType->getElementType(0)->isPointerTy() &&
+         structType->getElementType(1)->isIntegerTy(64);
+}
+
+llvm::PointerType *
+LLVMTypeBuilder::getContainerType(const std::string &name,
+                                  const std::vector<llvm::Type *> &elementTypes) {
+  std::string structName;
+  llvm::raw_string_ostream os(structName);
+  os << name << '<';
+  for (size_t i = 0; i < elementTypes.size(); ++i) {
+    os << (i ? ", " : "") << *elementTypes[i];
+  }
+  os << '>';
+  os.flush();
+
+  auto it = containerStructs_.find(structName);
+  if (it == containerStructs_.end()) {
+    auto structType =
+        llvm::StructType::create(context_.getContext(), structName);
+    it = containerStructs_.emplace(structName, structType).first;
+    containers_[structType] = ContainerType{name, elementTypes};
+  }
+  return it->second->getPointerTo();
+}
+
+const ContainerType *LLVMTypeBuilder::getContainer(llvm::Type *type) const {
+  auto pointerType = llvm::dyn_cast_or_null<llvm::PointerType>(type);
+  if (!pointerType) {
+    return nullptr;
+  }
+  auto structType =
+      llvm::dyn_cast<llvm::StructType>(pointerType->getPointerElementType());
+  auto it = containers_.find(structType);
+  return it != containers_.end() ? &it->second : nullptr;
+}
+
+bool LLVMTypeBuilder::isDynamicArrayType(llvm::Type *type) {
+  auto structType = llvm::dyn_cast<llvm::StructType>(type);
+  return structType && structType->isLiteral() &&
+         structType->getNumElements() == 3 &&
+         structType->getElementType(0)->isPointerTy() &&
+         structType->getElementType(1)->isIntegerTy(64) &&
+         structType->getElementType(2)->isIntegerTy(64);
+}
+
 llvm::StructType *LLVMTypeBuilder::createStructType(
     const std::string &typeName,
-    const std::vector<std::pair<std::string, llvm::Type *>> &fields) {
+    const std::vector<std::pair<std::string, llvm::Type *>> &fields,
+    const StructLayout &layout) {
+  auto &llvmContext = context_.getContext();
 
   // Collect field types
   std::vector<llvm::Type *> fieldTypes;
-  std::unordered_map<std::string, size_t> fieldIndices;
+  std::unordered_map<core::Symbol, size_t> fieldIndices;
 
   for (size_t i = 0; i < fields.size(); ++i) {
     fieldTypes.push_back(fields[i].second);
-    fieldIndices[fields[i].first] = i;
+    fieldIndices[core::Interner::instance().intern(fields[i].first)] = i;
+  }
+
+  // Pad the size up to the requested alignment with a trailing byte array
+  llvm::MaybeAlign alignment;
+  if (layout.alignment > 0) {
+    alignment = llvm::Align(layout.alignment);
+    const llvm::DataLayout &dataLayout = context_.getModule().getDataLayout();
+    llvm::StructType *unpadded =
+        llvm::StructType::get(llvmContext, fieldTypes, layout.packed);
+    uint64_t size = dataLayout.getTypeAllocSize(unpadded);
+    uint64_t paddedSize =
+        llvm::alignTo(std::max<uint64_t>(size, 1), *alignment);
+    if (paddedSize > size) {
+      fieldTypes.push_back(llvm::ArrayType::get(
+          llvm::Type::getInt8Ty(llvmContext), paddedSize - size));
+    }
   }
 
   // Check if the type already exists as a forward declaration
@@ -103,34 +531,93 @@ llvm::StructType *LLVMTypeBuilder::createStructType(
   if (it != typeCache_.end() && llvm::isa<llvm::StructType>(it->second)) {
     structType = llvm::cast<llvm::StructType>(it->second);
     if (structType->isOpaque()) {
-      structType->setBody(fieldTypes);
+      structType->setBody(fieldTypes, layout.packed);
     }
   } else {
-    // Create a new struct type
-    structType =
-        llvm::StructType::create(context_.getContext(), fieldTypes, typeName);
+    // Create a new struct type; conversions may have used an alias
+    structType = llvm::StructType::create(llvmContext, fieldTypes, typeName,
+                                          layout.packed);
+    if (it != typeCache_.end()) {
+      converted_.clear();
+    }
     typeCache_[typeName] = structType;
   }
 
   // Store the field indices
-  structInfo_[typeName] = {structType, std::move(fieldIndices)};
+  fieldIndices_[structType] = std::move(fieldIndices);
+  if (alignment) {
+    structAlignments_[structType] = *alignment;
+  }
+
+  // Arrays of the class declared before it was laid out
+  auto soa = soaArrays_.find(structType);
+  if (soa != soaArrays_.end() && soa->second->isOpaque()) {
+    setStructOfArraysBody(soa->second, structType);
+  }
 
   return structType;
 }
 
-int LLVMTypeBuilder::getFieldIndex(const std::string &structType,
-                                   const std::string &fieldName) {
-  auto structIt = structInfo_.find(structType);
-  if (structIt == structInfo_.end()) {
+llvm::Align LLVMTypeBuilder::getAlignment(llvm::Type *type) const {
+  const llvm::DataLayout &dataLayout = context_.getModule().getDataLayout();
+  llvm::Align preferred = dataLayout.getPrefTypeAlign(type);
+
+  if (auto structType = llvm::dyn_cast<llvm::StructType>(type)) {
+    // Packed layouts keep their byte alignment unless #aligned raises it
+    if (structType->isPacked()) {
+      preferred = dataLayout.getABITypeAlign(type);
+    }
+    auto it = structAlignments_.find(structType);
+    if (it != structAlignments_.end()) {
+      return std::max(it->second, preferred);
+    }
+  }
+  return preferred;
+}
+
+unsigned LLVMTypeBuilder::getPointeeAlignment(const nodes::TypeNode *type) {
+  // The parser validated N as it does for #aligned classes
+  auto pointer = nodes::dyn_cast<nodes::PointerTypeNode>(type);
+  return pointer ? pointer->getAlignment() : 0;
+}
+
+StructLayout LLVMTypeBuilder::getClassLayout(const nodes::ClassDeclNode *decl) {
+  const auto &modifiers = decl->getClassModifiers();
+  StructLayout layout;
+  layout.packed = std::find(modifiers.begin(), modifiers.end(),
+                            tokens::TokenType::PACKED) != modifiers.end();
+  layout.alignment = decl->getAlignment();
+  return layout;
+}
+
+int LLVMTypeBuilder::getFieldIndex(llvm::StructType *structType,
+                                   core::Symbol fieldName) const {
+  auto structIt = fieldIndices_.find(structType);
+  if (structIt == fieldIndices_.end()) {
     return -1;
   }
 
-  auto fieldIt = structIt->second.fieldIndices.find(fieldName);
-  if (fieldIt == structIt->second.fieldIndices.end()) {
+  auto fieldIt = structIt->second.find(fieldName);
+  if (fieldIt == structIt->second.end()) {
     return -1;
   }
 
   return static_cast<int>(fieldIt->second);
 }
 
+std::vector<core::Symbol>
+LLVMTypeBuilder::getFieldNames(llvm::StructType *structType) const {
+  auto structIt = fieldIndices_.find(structType);
+  if (structIt == fieldIndices_.end()) {
+    return {};
+  }
+  std::vector<core::Symbol> names(structType->getNumElements());
+  for (const auto &field : structIt->second) {
+    if (field.second < names.size()) {
+      names[field.second] = field.first;
+    }
+  }
+  return names;
+}
+
 } // namespace codegen
\ No newline at end of file
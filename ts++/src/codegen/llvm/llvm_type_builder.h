@@ -1,13 +1,37 @@
 #pragma once
+#include "core/common/interner.h"
 #include "llvm_context.h"
+#include "parser/nodes/declaration_nodes.h"
+#include "parser/nodes/type_nodes.h"
 #include "parser/visitors/type_check_visitor/resolved_type.h"
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/Type.h"
+#include "llvm/Support/Alignment.h"
+#include <map>
 #include <memory>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 namespace codegen {
 
+/**
+ * @brief Layout requested by a class's #packed and #aligned(N) modifiers
+ */
+struct StructLayout {
+  bool packed = false;    // No padding between fields, alignment 1
+  unsigned alignment = 0; // Minimum alignment in bytes, 0 if natural
+};
+
+/**
+ * @brief A built-in concurrent container's specialization, found from its
+ * handle type
+ */
+struct ContainerType {
+  std::string name;                       // MpmcQueue, SpscQueue or ConcurrentMap
+  std::vector<llvm::Type *> elementTypes; // The element, or key and value
+};
+
 /**
  * @class LLVMTypeBuilder
  * @brief Translates TS++ types to LLVM IR types
@@ -25,6 +49,10 @@ public:
 
   /**
    * @brief Converts a TS++ type to an LLVM type
+   *
+   * Types are interned, so each is converted once and then found by its
+   * address, until a name it may contain is declared again.
+   *
    * @param type The TS++ type to convert
    * @return The corresponding LLVM type
    */
@@ -37,26 +65,229 @@ public:
    */
   llvm::Type *getTypeByName(const std::string &typeName);
 
+  /**
+   * @brief Makes a type name stand for an existing type
+   * @param typeName Name used in type annotations, e.g. an enum's
+   * @param type The LLVM type it stands for
+   */
+  void declareAlias(const std::string &typeName, llvm::Type *type);
+
+  /**
+   * @brief Converts a parsed type annotation to an LLVM type
+   * @param type The type node, or nullptr for an unannotated value
+   * @return The corresponding LLVM type (i32 when unannotated)
+   */
+  llvm::Type *convertTypeNode(const nodes::TypeNode *type);
+
+  /**
+   * @brief Gets the storage of a string, the runtime's tspp_string
+   *
+   * { i64 length, i8* data, i64 capacity }. Strings shorter than
+   * TSPP_STRING_SMALL bytes keep their bytes in the data and capacity
+   * fields instead (only the data field with 32-bit pointers), so the
+   * length is always the first field.
+   *
+   * @return The %string struct
+   */
+  llvm::StructType *getStringType();
+
+  /**
+   * @brief Gets the storage of a growable array, T[]
+   *
+   * The runtime's tspp_array: the address of the first element, the
+   * element count and the number of elements allocated. Elements are
+   * stored unboxed, so int[] is contiguous i32s and an array of a class
+   * holds the objects themselves. Sized arrays, T[N], are stored inline as
+   * [N x T].
+   *
+   * An array of a #soa class is stored a column per field instead; see
+   * declareStructOfArrays().
+   *
+   * @param elementType The element type
+   * @return The { T*, i64, i64 } struct
+   */
+  llvm::StructType *getDynamicArrayType(llvm::Type *elementType);
+
+  /**
+   * @brief Lays out growable arrays of a class as a structure of arrays
+   *
+   * Each field of the class gets a growable array of its own, so T[] is
+   * { { F0*, i64, i64 }, { F1*, i64, i64 }, ... }, named T.soa. The
+   * columns always have the same length and capacity. Must be called
+   * before any array of the class is converted.
+   *
+   * @param typeName Name of a #soa class
+   */
+  void declareStructOfArrays(const std::string &typeName);
+
+  /**
+   * @brief Finds the element type of a structure-of-arrays array
+   * @param type Any LLVM type
+   * @return The class whose arrays the type stores, or nullptr if it is
+   *         not a structure of arrays
+   */
+  llvm::StructType *getStructOfArraysElement(llvm::Type *type) const;
+
+  /**
+   * @brief Gets the storage of a read-only view, slice<T> or bytes
+   *
+   * The address of the first element viewed and the element count. Slices
+   * own nothing: they point into an array, a string or a mapped file.
+   * bytes views i8s that read as ints.
+   *
+   * @param elementType The element type as stored
+   * @return The { T*, i64 } struct
+   */
+  llvm::StructType *getSliceType(llvm::Type *elementType);
+
+  /**
+   * @brief Checks whether a type is the storage of a slice
+   * @param type Any LLVM type
+   * @return True for a type returned by getSliceType
+   */
+  static bool isSliceType(llvm::Type *type);
+
+  /**
+   * @brief Gets the handle of a concurrent container, e.g. MpmcQueue<T>
+   *
+   * A pointer to an opaque struct that the runtime allocates. Each
+   * specialization has a struct of its own, named after the container and
+   * its element types, so getContainer() can find them again.
+   *
+   * @param name MpmcQueue, SpscQueue or ConcurrentMap
+   * @param elementTypes The element type, or the key and value types
+   * @return The handle's pointer type
+   */
+  llvm::PointerType *
+  getContainerType(const std::string &name,
+                   const std::vector<llvm::Type *> &elementTypes);
+
+  /**
+   * @brief Finds the container a handle type was made for
+   * @param type Any LLVM type
+   * @return The container, or nullptr if the type is not a handle
+   */
+  const ContainerType *getContainer(llvm::Type *type) const;
+
+  /**
+   * @brief Gets the storage of a union, A | B
+   *
+   * A tag and the arm's value inline, with no boxing: { i32, [N x iK] },
+   * where the payload is as large and as aligned as the largest arm (K is
+   * the alignment in bits; past 64, the most aligned arm is the element
+   * instead). The tag is the arm's index in the arm list, which is sorted,
+   * so every spelling of a union shares one layout. Arms stored alike are
+   * one arm.
+   *
+   * @param arms The arms' storage types, in any order
+   * @return The %union struct
+   */
+  llvm::StructType *getUnionType(std::vector<llvm::Type *> arms);
+
+  /**
+   * @brief Finds the arms of a union's storage
+   * @param type Any LLVM type
+   * @return The arms, indexed by tag, or nullptr if the type is not a union
+   */
+  const std::vector<llvm::Type *> *getUnionArms(llvm::Type *type) const;
+
+  /**
+   * @brief Gets the storage of a function value, function(P...): R
+   *
+   * A fat pointer, { R (i8*, P...)*, i8* }: the code, which takes the
+   * environment as its first argument, and the environment, which holds
+   * what a function expression captured, or null for a named function.
+   * Each signature has a struct of its own, named closure, so
+   * getClosureSignature() can find it again.
+   *
+   * @param signature The function's type as declared, without the
+   *        environment
+   * @return The %closure struct
+   */
+  llvm::StructType *getClosureType(llvm::FunctionType *signature);
+
+  /**
+   * @brief Finds the declared signature of a function value's storage
+   * @param type Any LLVM type
+   * @return The signature, without the environment, or nullptr if the type
+   *         is not a function value
+   */
+  llvm::FunctionType *getClosureSignature(llvm::Type *type) const;
+
+  /**
+   * @brief Gets the type of the code a function value points to
+   * @param signature The declared signature
+   * @return The signature with an i8* environment in front
+   */
+  static llvm::FunctionType *getClosureCodeType(llvm::FunctionType *signature);
+
+  /**
+   * @brief Checks whether a type is the storage of a growable array
+   * @param type Any LLVM type
+   * @return True for a type returned by getDynamicArrayType
+   */
+  static bool isDynamicArrayType(llvm::Type *type);
+
   /**
    * @brief Registers a class/struct type with its fields
+   *
+   * A packed layout drops all padding. An explicit alignment pads the size
+   * to a multiple of it, so array elements and neighbouring objects never
+   * share the aligned block (e.g. a cache line).
+   *
    * @param typeName Name of the class/struct
    * @param fields Field names and types
+   * @param layout Packing and alignment from the class modifiers
    * @return The created LLVM struct type
    */
   llvm::StructType *createStructType(
       const std::string &typeName,
-      const std::vector<std::pair<std::string, llvm::Type *>> &fields);
+      const std::vector<std::pair<std::string, llvm::Type *>> &fields,
+      const StructLayout &layout = StructLayout());
+
+  /**
+   * @brief Gets the alignment storage of a type must have
+   * @param type The stored type
+   * @return The #aligned(N) alignment for such structs, or the preferred
+   *         alignment from the module's data layout
+   */
+  llvm::Align getAlignment(llvm::Type *type) const;
+
+  /**
+   * @brief Gets the alignment promised by a T@aligned(N) pointer type
+   * @param type The type node
+   * @return N, or 0 if the type is not an aligned pointer
+   */
+  static unsigned getPointeeAlignment(const nodes::TypeNode *type);
+
+  /**
+   * @brief Gets the layout a class's #packed and #aligned(N) modifiers ask
+   * for, whether the class is generic or not
+   * @param decl The class declaration
+   */
+  static StructLayout getClassLayout(const nodes::ClassDeclNode *decl);
 
   /**
    * @brief Gets the field index in a struct type
-   * @param structType Name of the struct type
-   * @param fieldName Name of the field
+   * @param structType The struct type, as createStructType() returned it
+   * @param fieldName Interned name of the field
    * @return Index of the field or -1 if not found
    */
-  int getFieldIndex(const std::string &structType,
-                    const std::string &fieldName);
+  int getFieldIndex(llvm::StructType *structType, core::Symbol fieldName) const;
+
+  /**
+   * @brief Gets the names of a struct type's fields by index
+   * @param structType The struct type, as createStructType() returned it
+   * @return One name per element; fields without one, such as the vtable
+   * pointer, have an invalid symbol. Empty for other structs.
+   */
+  std::vector<core::Symbol> getFieldNames(llvm::StructType *structType) const;
 
 private:
+  // Converts a type that is not in the conversion cache
+  llvm::Type *convertUncached(const visitors::ResolvedType &type);
+
+
   // Convert primitive types
   llvm::Type *convertPrimitiveType(const visitors::ResolvedType &type);
 
@@ -72,6 +303,10 @@ private:
   // Convert struct/class types
   llvm::Type *convertStructType(const visitors::ResolvedType &type);
 
+  // Gives a structure-of-arrays array its columns once the class has fields
+  void setStructOfArraysBody(llvm::StructType *arrayType,
+                             llvm::StructType *elementType);
+
   // Convert smart pointer types
   llvm::Type *convertSmartPointerType(const visitors::ResolvedType &type);
 
@@ -80,12 +315,37 @@ private:
   // Maps type names to their LLVM representation
   std::unordered_map<std::string, llvm::Type *> typeCache_;
 
-  // Maps struct types to their field information
-  struct StructInfo {
-    llvm::StructType *type;
-    std::unordered_map<std::string, size_t> fieldIndices;
-  };
-  std::unordered_map<std::string, StructInfo> structInfo_;
+  // Converted types by address; holding them keeps the addresses unique
+  std::unordered_map<const visitors::ResolvedType *,
+                     std::pair<std::shared_ptr<visitors::ResolvedType>,
+                               llvm::Type *>>
+      converted_;
+
+  // Field indices of each struct type, by interned field name
+  std::unordered_map<llvm::StructType *,
+                     std::unordered_map<core::Symbol, size_t>>
+      fieldIndices_;
+
+  // #soa classes by name, and their arrays' types both ways
+  std::unordered_set<std::string> soaClasses_;
+  std::unordered_map<llvm::StructType *, llvm::StructType *> soaArrays_;
+  std::unordered_map<llvm::StructType *, llvm::StructType *> soaElements_;
+
+  // Concurrent container handles' structs by name, and what each holds
+  std::unordered_map<std::string, llvm::StructType *> containerStructs_;
+  std::unordered_map<llvm::StructType *, ContainerType> containers_;
+
+  // Unions by their sorted arms, and the arms of each
+  std::map<std::vector<llvm::Type *>, llvm::StructType *> unions_;
+  std::unordered_map<llvm::StructType *, std::vector<llvm::Type *>> unionArms_;
+
+  // Function values by declared signature, and the signature of each
+  std::unordered_map<llvm::FunctionType *, llvm::StructType *> closures_;
+  std::unordered_map<llvm::StructType *, llvm::FunctionType *>
+      closureSignatures_;
+
+  // Explicit #aligned(N) alignments by struct type
+  std::unordered_map<llvm::StructType *, llvm::Align> structAlignments_;
 };
 
 } // namespace codegen
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include "llvm/IR/Function.h"
 #include "llvm/IR/GlobalVariable.h"
 #include "llvm/IR/Instructions.h"
+#include <cctype>
 #include <sstream>
 #include <string>
 
@@ -12,36 +13,13 @@ namespace LLVMUtils {
 
 llvm::Value *createGlobalString(LLVMContext &context, const std::string &str,
                                 const std::string &name) {
-  llvm::IRBuilder<> &builder = context.getBuilder();
-  llvm::Module &module = context.getModule();
-
-  // Create a global string constant
-  llvm::Constant *strConstant = llvm::ConstantDataArray::getString(
-      context.getContext(), str, true // Include null terminator
-  );
-
-  // Create a unique name if none is provided
-  std::string varName = name;
-  if (varName.empty()) {
-    static int counter = 0;
-    std::stringstream ss;
-    ss << ".str." << counter++;
-    varName = ss.str();
-  }
-
-  // Create a global variable for the string
-  llvm::GlobalVariable *globalStr = new llvm::GlobalVariable(
-      module, strConstant->getType(),
-      true, // isConstant
-      llvm::GlobalValue::PrivateLinkage, strConstant, varName);
+  // Equal strings share one constant
+  llvm::GlobalVariable *globalStr =
+      context.getStringConstant(str, name.empty() ? ".str" : name);
 
   // Get a pointer to the first character
-  llvm::Value *zero =
-      llvm::ConstantInt::get(llvm::Type::getInt32Ty(context.getContext()), 0);
-
-  llvm::Value *indices[] = {zero, zero};
-  return builder.CreateInBoundsGEP(globalStr->getValueType(), globalStr,
-                                   indices, "str");
+  return context.getBuilder().CreateConstInBoundsGEP2_32(
+      globalStr->getValueType(), globalStr, 0, 0, "str");
 }
 
 llvm::Value *createIntConstant(LLVMContext &context, int64_t value,
@@ -74,7 +52,7 @@ llvm::Value *createNullPointer(LLVMContext &context, llvm::PointerType *type) {
 
 LLVMValue castNumeric(LLVMContext &context, const LLVMValue &value,
                       std::shared_ptr<visitors::ResolvedType> toType) {
-  if (!value.isValid() || !toType) {
+  if (!value.isValid() || !value.getType() || !toType) {
     return LLVMValue();
   }
 
@@ -194,53 +172,201 @@ bool canCast(std::shared_ptr<visitors::ResolvedType> fromType,
   return fromType->isExplicitlyConvertibleTo(*toType);
 }
 
-void emitRuntimeError(LLVMContext &context, const std::string &message) {
+void emitRuntimeError(LLVMContext &context, const std::string &message,
+                      llvm::Constant *site) {
   llvm::IRBuilder<> &builder = context.getBuilder();
   llvm::Module &module = context.getModule();
-
-  // Get the printf function
-  llvm::Function *printfFunc = module.getFunction("printf");
-  if (!printfFunc) {
-    // Declare printf if not already declared
-    llvm::FunctionType *printfType = llvm::FunctionType::get(
-        llvm::Type::getInt32Ty(context.getContext()),
-        {llvm::PointerType::get(llvm::Type::getInt8Ty(context.getContext()),
-                                0)},
-        true // varargs
-    );
-
-    printfFunc = llvm::Function::Create(
-        printfType, llvm::Function::ExternalLinkage, "printf", module);
+  llvm::Type *bytePtr = builder.getInt8PtrTy();
+
+  // One out-of-line report for every kind of check
+  llvm::Function *fail = module.getFunction("tspp_runtime_fail");
+  if (!fail) {
+    fail = llvm::Function::Create(
+        llvm::FunctionType::get(builder.getVoidTy(), {bytePtr, bytePtr},
+                                false),
+        llvm::Function::ExternalLinkage, "tspp_runtime_fail", module);
+    fail->addFnAttr(llvm::Attribute::NoReturn);
+    fail->addFnAttr(llvm::Attribute::NoUnwind);
+    fail->addFnAttr(llvm::Attribute::Cold);
   }
 
-  // Create the error message string
-  std::string errorMsg = "Runtime error: " + message + "\n";
-  llvm::Value *msgGlobal = createGlobalString(context, errorMsg);
-
-  // Call printf with the error message
-  builder.CreateCall(printfFunc, {msgGlobal});
+  builder.CreateCall(
+      fail, {createGlobalString(context, message),
+             site ? site : llvm::ConstantPointerNull::get(
+                               llvm::cast<llvm::PointerType>(bytePtr))});
+  builder.CreateUnreachable();
+}
 
-  // Get the exit function
-  llvm::Function *exitFunc = module.getFunction("exit");
-  if (!exitFunc) {
-    // Declare exit if not already declared
-    llvm::FunctionType *exitType = llvm::FunctionType::get(
-        llvm::Type::getVoidTy(context.getContext()),
-        {llvm::Type::getInt32Ty(context.getContext())}, false);
+namespace {
 
-    exitFunc = llvm::Function::Create(exitType, llvm::Function::ExternalLinkage,
-                                      "exit", module);
+// Reads a <length><name> pair at pos
+bool demangleSourceName(const std::string &mangled, size_t &pos,
+                        std::string &name) {
+  size_t length = 0;
+  size_t start = pos;
+  while (pos < mangled.size() && std::isdigit(static_cast<unsigned char>(
+                                     mangled[pos]))) {
+    length = length * 10 + (mangled[pos++] - '0');
   }
+  if (pos == start || length > mangled.size() - pos) {
+    return false;
+  }
+  name = mangled.substr(pos, length);
+  pos += length;
+  return true;
+}
 
-  // Call exit with status code 1
-  builder.CreateCall(exitFunc,
-                     {llvm::ConstantInt::get(
-                         llvm::Type::getInt32Ty(context.getContext()), 1)});
+// Reads the code of one type at pos, the inverse of mangleType
+bool demangleType(const std::string &mangled, size_t &pos, std::string &type) {
+  if (pos >= mangled.size()) {
+    return false;
+  }
+  char code = mangled[pos];
+  std::string inner;
+  switch (code) {
+  case 'v':
+    type = "void";
+    break;
+  case 'i':
+    type = "int";
+    break;
+  case 'f':
+    type = "float";
+    break;
+  case 'b':
+    type = "bool";
+    break;
+  case 'u':
+    type = "unknown_type";
+    break;
+  case 'P':
+  case 'R':
+    ++pos;
+    if (!demangleType(mangled, pos, inner)) {
+      return false;
+    }
+    type = inner + (code == 'P' ? "@" : "&");
+    return true;
+  case 'U':
+    if (mangled.compare(pos, 9, "U7_Atomic") != 0) {
+      return false;
+    }
+    pos += 9;
+    if (!demangleType(mangled, pos, inner)) {
+      return false;
+    }
+    type = "#atomic<" + inner + ">";
+    return true;
+  case 'D': {
+    size_t underscore = mangled.find('_', pos);
+    if (mangled.compare(pos, 2, "Dv") != 0 || underscore == std::string::npos) {
+      return false;
+    }
+    std::string lanes = mangled.substr(pos + 2, underscore - pos - 2);
+    pos = underscore + 1;
+    if (!demangleType(mangled, pos, inner)) {
+      return false;
+    }
+    type = inner + lanes;
+    return true;
+  }
+  default: {
+    if (!demangleSourceName(mangled, pos, type)) {
+      return false;
+    }
+    // A specialized class is named by mangleFunctionName itself
+    type = demangleFunctionName(type);
+    if (pos >= mangled.size() || mangled[pos] != 'I') {
+      return true;
+    }
+    ++pos;
+    std::vector<std::string> args;
+    while (pos < mangled.size() && mangled[pos] != 'E') {
+      if (!demangleType(mangled, pos, inner)) {
+        return false;
+      }
+      args.push_back(inner);
+    }
+    if (pos >= mangled.size()) {
+      return false;
+    }
+    ++pos; // E
+    type += "<";
+    for (size_t i = 0; i < args.size(); ++i) {
+      type += (i ? ", " : "") + args[i];
+    }
+    type += ">";
+    return true;
+  }
+  }
+  ++pos;
+  return true;
+}
 
-  // Add unreachable instruction
-  builder.CreateUnreachable();
+// Appends the code for one type; components are mangled recursively so
+// specializations of one generic get distinct names
+void mangleType(std::ostream &mangled, const visitors::ResolvedType &type) {
+  switch (type.getKind()) {
+  case visitors::ResolvedType::TypeKind::Void:
+    mangled << "v";
+    break;
+  case visitors::ResolvedType::TypeKind::Int:
+    mangled << "i";
+    break;
+  case visitors::ResolvedType::TypeKind::Float:
+    mangled << "f";
+    break;
+  case visitors::ResolvedType::TypeKind::Bool:
+    mangled << "b";
+    break;
+  case visitors::ResolvedType::TypeKind::String:
+    mangled << "6string"; // The runtime's tspp_string value
+    break;
+  case visitors::ResolvedType::TypeKind::Pointer:
+  case visitors::ResolvedType::TypeKind::Smart:
+    mangled << "P";
+    mangleType(mangled, *type.getPointeeType());
+    break;
+  case visitors::ResolvedType::TypeKind::Reference:
+    mangled << "R";
+    mangleType(mangled, *type.getPointeeType());
+    break;
+  case visitors::ResolvedType::TypeKind::Atomic:
+    mangled << "U7_Atomic"; // As C11 _Atomic qualifies a type
+    mangleType(mangled, *type.getElementType());
+    break;
+  case visitors::ResolvedType::TypeKind::Vector:
+    // As Itanium mangles vector_size and ext_vector_type vectors
+    mangled << "Dv" << type.getLanes() << "_";
+    mangleType(mangled, *type.getElementType());
+    break;
+  case visitors::ResolvedType::TypeKind::Array:
+    // Arrays mangle like a pointer to their elements
+    mangled << "P";
+    mangleType(mangled, *type.getElementType());
+    break;
+  case visitors::ResolvedType::TypeKind::Named: {
+    const std::string &typeName = type.getName();
+    mangled << typeName.length() << typeName;
+    break;
+  }
+  case visitors::ResolvedType::TypeKind::Template: {
+    const std::string &typeName = type.getName();
+    mangled << typeName.length() << typeName << "I";
+    for (const auto &arg : type.getTemplateArgs()) {
+      mangleType(mangled, *arg);
+    }
+    mangled << "E";
+    break;
+  }
+  default:
+    mangled << "u"; // Unknown/unsupported type
+    break;
+  }
 }
 
+} // namespace
+
 std::string mangleFunctionName(
     const std::string &name,
     const std::vector<std::shared_ptr<visitors::ResolvedType>> &paramTypes) {
@@ -252,45 +378,45 @@ std::string mangleFunctionName(
 
   // Append parameter types
   for (const auto &paramType : paramTypes) {
-    if (!paramType) {
-      continue;
+    if (paramType) {
+      mangleType(mangled, *paramType);
     }
+  }
 
-    // Simple parameter mangling based on type kind
-    switch (paramType->getKind()) {
-    case visitors::ResolvedType::TypeKind::Void:
-      mangled << "v";
-      break;
-    case visitors::ResolvedType::TypeKind::Int:
-      mangled << "i";
-      break;
-    case visitors::ResolvedType::TypeKind::Float:
-      mangled << "f";
-      break;
-    case visitors::ResolvedType::TypeKind::Bool:
-      mangled << "b";
-      break;
-    case visitors::ResolvedType::TypeKind::String:
-      mangled << "PKc"; // Pointer to constant char
-      break;
-    case visitors::ResolvedType::TypeKind::Pointer:
-      mangled << "P";
-      // Recursively mangle the pointee type
-      // This is a simplification - a real implementation would recurse
-      mangled << "v"; // Assume void* for now
-      break;
-    case visitors::ResolvedType::TypeKind::Named: {
-      std::string typeName = paramType->getName();
-      mangled << typeName.length() << typeName;
-      break;
-    }
-    default:
-      mangled << "u"; // Unknown/unsupported type
-      break;
+  return mangled.str();
+}
+
+std::string demangleFunctionName(const std::string &symbol) {
+  if (symbol.compare(0, 2, "_Z") != 0) {
+    return symbol;
+  }
+
+  // Methods and helpers append .suffix to the mangled name they belong to
+  size_t dot = symbol.find('.');
+  std::string mangled = symbol.substr(0, dot);
+  size_t pos = 2;
+  std::string name;
+  if (!demangleSourceName(mangled, pos, name)) {
+    return symbol;
+  }
+  std::vector<std::string> args;
+  while (pos < mangled.size()) {
+    std::string type;
+    if (!demangleType(mangled, pos, type)) {
+      return symbol;
     }
+    args.push_back(type);
   }
 
-  return mangled.str();
+  std::string result = name;
+  if (!args.empty()) {
+    result += "<";
+    for (size_t i = 0; i < args.size(); ++i) {
+      result += (i ? ", " : "") + args[i];
+    }
+    result += ">";
+  }
+  return dot == std::string::npos ? result : result + symbol.substr(dot);
 }
 
 } // namespace LLVMUtils
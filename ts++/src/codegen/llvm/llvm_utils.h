@@ -13,7 +13,10 @@ namespace codegen {
 namespace LLVMUtils {
 
 /**
- * @brief Creates a global string constant
+ * @brief Gets a pointer to a NUL-terminated string constant
+ *
+ * Equal strings in a module share one constant.
+ *
  * @param context The LLVM context
  * @param str The string value
  * @param name Optional name for the global
@@ -78,11 +81,17 @@ bool canCast(std::shared_ptr<visitors::ResolvedType> fromType,
              std::shared_ptr<visitors::ResolvedType> toType);
 
 /**
- * @brief Emits a runtime error at the current insert point
+ * @brief Ends the current block with a call to tspp_runtime_fail
+ *
+ * The block should be the cold branch of a check, weighted as unlikely;
+ * only the message, the site and the call are emitted there.
+ *
  * @param context The LLVM context
  * @param message The error message
+ * @param site The check's tspp_check_site as an i8*, or nullptr
  */
-void emitRuntimeError(LLVMContext &context, const std::string &message);
+void emitRuntimeError(LLVMContext &context, const std::string &message,
+                      llvm::Constant *site);
 
 /**
  * @brief Gets the mangled name for a function
@@ -94,6 +103,18 @@ std::string mangleFunctionName(
     const std::string &name,
     const std::vector<std::shared_ptr<visitors::ResolvedType>> &paramTypes);
 
+/**
+ * @brief Recovers the tspp spelling of a symbol named by mangleFunctionName
+ *
+ * The type arguments are written as ResolvedType::toString() would, so
+ * _Z3Boxi.get becomes Box<int>.get. Pointers, smart pointers and arrays
+ * mangle alike and come back as T@.
+ *
+ * @param symbol A symbol of a generated module
+ * @return The readable name, or the symbol itself if it is not mangled
+ */
+std::string demangleFunctionName(const std::string &symbol);
+
 } // namespace LLVMUtils
 
 } // namespace codegen
\ No newline at end of file
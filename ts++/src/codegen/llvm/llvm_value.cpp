@@ -1,7 +1,43 @@
 #include "codegen/llvm/llvm_value.h"
+#include "llvm/IR/Argument.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/MDBuilder.h"
 
 namespace codegen {
 
+namespace {
+
+// The !tbaa tag of a load or store of a value of the type. Numbers and
+// pointers of different types never share storage, so each scalar type is
+// its own node under the language's root. Bytes and bools are also how
+// other values are copied, and aggregates and vectors are accessed a field
+// or lane at a time as well, so their accesses are left untagged and may
+// alias anything. Nodes are uniqued by the context, so building them again
+// finds the same ones.
+llvm::MDNode *getAccessTag(llvm::Type *type) {
+  const char *name = nullptr;
+  if (type->isPointerTy()) {
+    name = "any pointer";
+  } else if (type->isIntegerTy(32)) {
+    name = "int";
+  } else if (type->isIntegerTy(64)) {
+    name = "long";
+  } else if (type->isFloatTy()) {
+    name = "float";
+  } else if (type->isDoubleTy()) {
+    name = "double";
+  } else {
+    return nullptr;
+  }
+  llvm::MDBuilder builder(type->getContext());
+  llvm::MDNode *root = builder.createTBAARoot("tspp TBAA");
+  llvm::MDNode *scalar = builder.createTBAAScalarTypeNode(name, root);
+  return builder.createTBAAStructTagNode(scalar, scalar, 0);
+}
+
+} // namespace
+
 LLVMValue::LLVMValue() : value_(nullptr), isLValue_(false) {}
 
 LLVMValue::LLVMValue(llvm::Value *value,
@@ -9,25 +45,68 @@ LLVMValue::LLVMValue(llvm::Value *value,
                      bool isLValue)
     : value_(value), type_(std::move(type)), isLValue_(isLValue) {}
 
+llvm::Type *LLVMValue::getStoredType() const {
+  // Get the element type correctly
+  if (auto alloca = llvm::dyn_cast<llvm::AllocaInst>(value_)) {
+    return alloca->getAllocatedType();
+  }
+  if (auto global = llvm::dyn_cast<llvm::GlobalVariable>(value_)) {
+    return global->getValueType();
+  }
+  if (auto ptrType = llvm::dyn_cast<llvm::PointerType>(value_->getType())) {
+    return ptrType->getPointerElementType();
+  }
+  // Fallback - though this shouldn't happen for proper lvalues
+  return llvm::Type::getInt8Ty(value_->getContext());
+}
+
+llvm::MaybeAlign LLVMValue::getAlignment() const {
+  if (auto alloca = llvm::dyn_cast_or_null<llvm::AllocaInst>(value_)) {
+    return alloca->getAlign();
+  }
+  if (auto global = llvm::dyn_cast_or_null<llvm::GlobalVariable>(value_)) {
+    return global->getAlign();
+  }
+  if (auto argument = llvm::dyn_cast_or_null<llvm::Argument>(value_)) {
+    return argument->getParamAlign();
+  }
+  return llvm::None;
+}
+
 LLVMValue LLVMValue::loadIfLValue(llvm::IRBuilder<> &builder) const {
   if (!isLValue_ || !value_) {
     return *this;
   }
 
-  // Get the element type correctly
-  llvm::Type *elementType = nullptr;
-  llvm::PointerType *ptrType =
-      llvm::dyn_cast<llvm::PointerType>(value_->getType());
-  if (ptrType) {
-    elementType = ptrType->getExtendedType();
-  } else {
-    // Fallback - though this shouldn't happen for proper lvalues
-    elementType = llvm::Type::getInt8Ty(builder.getContext());
+  // Use the correct CreateLoad signature
+  llvm::Type *elementType = getStoredType();
+  llvm::LoadInst *loadedValue =
+      builder.CreateAlignedLoad(elementType, value_, getAlignment(), "load");
+  if (llvm::MDNode *tag = getAccessTag(elementType)) {
+    loadedValue->setMetadata(llvm::LLVMContext::MD_tbaa, tag);
+  }
+  if (pointeeAlignment_ > 1 && elementType->isPointerTy()) {
+    llvm::LLVMContext &context = builder.getContext();
+    llvm::Metadata *alignment =
+        llvm::ConstantAsMetadata::get(llvm::ConstantInt::get(
+            llvm::Type::getInt64Ty(context), pointeeAlignment_));
+    loadedValue->setMetadata(llvm::LLVMContext::MD_align,
+                             llvm::MDNode::get(context, alignment));
   }
 
-  // Use the correct CreateLoad signature
-  llvm::Value *loadedValue = builder.CreateLoad(elementType, value_, "load");
-  return LLVMValue(loadedValue, type_, false);
+  LLVMValue result(loadedValue, type_, false);
+  result.setPointeeAlignment(pointeeAlignment_);
+  return result;
+}
+
+llvm::StoreInst *LLVMValue::store(llvm::IRBuilder<> &builder,
+                                  llvm::Value *value) const {
+  llvm::StoreInst *store =
+      builder.CreateAlignedStore(value, value_, getAlignment());
+  if (llvm::MDNode *tag = getAccessTag(value->getType())) {
+    store->setMetadata(llvm::LLVMContext::MD_tbaa, tag);
+  }
+  return store;
 }
 
 } // namespace codegen
\ No newline at end of file
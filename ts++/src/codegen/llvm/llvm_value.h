@@ -7,6 +7,16 @@
 
 namespace codegen {
 
+/**
+ * @brief How a pointer variable owns the object it points to
+ *
+ * #unique pointers are bare pointers freed when they go out of scope and
+ * moved on copy. #shared and #weak pointers count references in the
+ * runtime's object header. An #arena block's handle owns every object
+ * allocated while the block runs.
+ */
+enum class PointerOwnership { Raw, Shared, Unique, Weak, Arena };
+
 /**
  * @class LLVMValue
  * @brief Represents a value in LLVM IR generation
@@ -42,6 +52,14 @@ public:
    */
   std::shared_ptr<visitors::ResolvedType> getType() const { return type_; }
 
+  /**
+   * @brief Sets the TS++ type, e.g. the one the checker resolved
+   * @param type The TS++ type
+   */
+  void setType(std::shared_ptr<visitors::ResolvedType> type) {
+    type_ = std::move(type);
+  }
+
   /**
    * @brief Checks if this is an lvalue
    * @return True if this is an lvalue
@@ -50,17 +68,74 @@ public:
 
   /**
    * @brief Checks if this value is valid
-   * @return True if this value is valid
+   *
+   * The source-level type is optional; most generated values carry only
+   * their LLVM type.
+   *
+   * @return True if this value holds an LLVM value
    */
-  bool isValid() const { return value_ != nullptr && type_ != nullptr; }
+  bool isValid() const { return value_ != nullptr; }
+
+  /**
+   * @brief Gets the alignment a loaded pointer is known to have
+   * @return The T@aligned(N) alignment in bytes, or 0 if unknown
+   */
+  unsigned getPointeeAlignment() const { return pointeeAlignment_; }
+
+  /**
+   * @brief Records the alignment of the pointer this value holds or stores
+   * @param alignment Alignment in bytes, or 0 if unknown
+   */
+  void setPointeeAlignment(unsigned alignment) {
+    pointeeAlignment_ = alignment;
+  }
+
+  /**
+   * @brief Gets the smart pointer kind of the variable behind an lvalue
+   * @return Raw for anything that is not a #shared/#unique/#weak variable
+   */
+  PointerOwnership getOwnership() const { return ownership_; }
+
+  /**
+   * @brief Marks this lvalue as a smart pointer variable
+   * @param ownership The declared smart pointer kind
+   */
+  void setOwnership(PointerOwnership ownership) { ownership_ = ownership; }
+
+  /**
+   * @brief Gets the type held by the storage behind an lvalue
+   * @return The stored type (i8 if it cannot be determined)
+   */
+  llvm::Type *getStoredType() const;
+
+  /**
+   * @brief Gets the alignment of the storage behind an lvalue
+   * @return The alloca, global or ref parameter alignment, or none if
+   * unknown
+   */
+  llvm::MaybeAlign getAlignment() const;
 
   /**
    * @brief Loads the value if it's an lvalue
+   *
+   * The load uses the storage's alignment. A loaded aligned pointer is
+   * tagged with !align so later accesses through it can use it too, and a
+   * loaded number or pointer with !tbaa for its type.
+   *
    * @param builder The LLVM builder to use for loading
    * @return A new LLVMValue containing the loaded value
    */
   LLVMValue loadIfLValue(llvm::IRBuilder<> &builder) const;
 
+  /**
+   * @brief Stores into this lvalue with the storage's alignment, tagged
+   * with !tbaa like loads
+   * @param builder The LLVM builder to use for storing
+   * @param value The value to store
+   * @return The store instruction
+   */
+  llvm::StoreInst *store(llvm::IRBuilder<> &builder, llvm::Value *value) const;
+
   /**
    * @brief Gets a string representation of this value (for debugging)
    * @return String representation
@@ -71,6 +146,8 @@ private:
   llvm::Value *value_;                           // The LLVM value
   std::shared_ptr<visitors::ResolvedType> type_; // The TS++ type
   bool isLValue_;                                // Whether this is an lvalue
+  unsigned pointeeAlignment_ = 0;                // Aligned pointer, or 0
+  PointerOwnership ownership_ = PointerOwnership::Raw; // Smart pointer kind
 };
 
 } // namespace codegen
\ No newline at end of file
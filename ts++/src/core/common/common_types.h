@@ -10,7 +10,8 @@
  *****************************************************************************/
 
 #pragma once
-#include <fstream>
+#include "source_manager.h"
+#include <cstdint>
 #include <sstream>
 #include <string>
 
@@ -35,22 +36,34 @@ public:
 
   // Constructors matching TokenLocation interface
   SourceLocation(unsigned int ln = 0, unsigned int col = 0,
-                 std::string file = "")
-      : line_(ln), column_(col), filename_(std::move(file)) {
-    loadLineContent();
-  }
+                 const std::string &file = "")
+      : fileId_(SourceManager::instance().getFileId(file)), offset_(0),
+        line_(ln), column_(col) {}
+
+  // Constructor for locations inside a buffer owned by the SourceManager
+  SourceLocation(FileId fileId, std::uint32_t offset, unsigned int ln,
+                 unsigned int col)
+      : fileId_(fileId), offset_(offset), line_(ln), column_(col) {}
 
   // TokenLocation compatible interface
   unsigned int getLine() const { return line_; }
   unsigned int getColumn() const { return column_; }
-  const std::string &getFilename() const { return filename_; }
+  const std::string &getFilename() const {
+    return SourceManager::instance().getFilename(fileId_);
+  }
 
-  // Extended functionality
-  const std::string &getLineContent() const { return line_content_; }
+  // Compact location accessors
+  FileId getFileId() const { return fileId_; }
+  std::uint32_t getOffset() const { return offset_; }
+
+  // Extended functionality (line text is fetched on demand)
+  std::string getLineContent() const {
+    return SourceManager::instance().getLineContent(fileId_, line_);
+  }
 
   // Comparison operator
   bool operator==(const SourceLocation &other) const {
-    return filename_ == other.filename_ && line_ == other.line_ &&
+    return fileId_ == other.fileId_ && line_ == other.line_ &&
            column_ == other.column_;
   }
 
@@ -58,48 +71,24 @@ public:
   std::string toString() const {
     std::stringstream output;
     // File location
-    output << filename_ << ":" << line_ << ":" << column_ << "\n";
+    output << getFilename() << ":" << line_ << ":" << column_ << "\n";
 
     // Show line content with error pointer if available
-    if (!line_content_.empty()) {
-      output << line_content_ << "\n";
-      std::string pointer_line(column_ - 1, ' ');
+    std::string lineContent = getLineContent();
+    if (!lineContent.empty()) {
+      output << lineContent << "\n";
+      std::string pointer_line(column_ > 0 ? column_ - 1 : 0, ' ');
       output << pointer_line << RED << "^" << RESET;
     }
 
     return output.str();
   }
 
-  // Reload line content (useful if file changes)
-  void reloadContent() { loadLineContent(); }
-
 private:
-  unsigned int line_;        // Line number (1-based)
-  unsigned int column_;      // Column number (1-based)
-  std::string filename_;     // Source file name
-  std::string line_content_; // Content of the error line
-
-  // Load the source line for error display
-  void loadLineContent() {
-    std::ifstream file(filename_);
-    if (!file.is_open()) {
-      line_content_ = "";
-      return;
-    }
-
-    std::string current_line;
-    unsigned int current_line_num = 1;
-
-    while (std::getline(file, current_line)) {
-      if (current_line_num == line_) {
-        line_content_ = current_line;
-        break;
-      }
-      current_line_num++;
-    }
-
-    file.close();
-  }
+  FileId fileId_;         // Source buffer id (see SourceManager)
+  std::uint32_t offset_;  // Byte offset into the buffer
+  unsigned int line_;     // Line number (1-based)
+  unsigned int column_;   // Column number (1-based)
 };
 
 /*****************************************************************************
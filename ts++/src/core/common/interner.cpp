@@ -0,0 +1,38 @@
+/*****************************************************************************
+ * File: interner.cpp
+ * Description: Implementation of the global string interning table.
+ *****************************************************************************/
+
+#include "interner.h"
+
+namespace core {
+
+Symbol Interner::intern(std::string_view text) {
+  if (text.empty()) {
+    return Symbol();
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  auto it = ids_.find(text);
+  if (it != ids_.end()) {
+    return it->second;
+  }
+
+  strings_.emplace_back(text);
+  Symbol symbol(static_cast<std::uint32_t>(strings_.size()));
+  ids_.emplace(strings_.back(), symbol);
+  return symbol;
+}
+
+const std::string &Interner::lookup(Symbol symbol) const {
+  static const std::string empty;
+  if (!symbol.isValid()) {
+    return empty;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  return strings_[symbol.getId() - 1];
+}
+
+} // namespace core
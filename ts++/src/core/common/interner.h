@@ -0,0 +1,93 @@
+/*****************************************************************************
+ * File: interner.h
+ * Description: Global string interning table for identifiers and literals
+ *
+ * Contains:
+ * - Symbol handle type with integer hashing and comparison
+ * - Interner singleton mapping strings to stable symbols
+ *****************************************************************************/
+
+#pragma once
+#include "macros.h"
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace core {
+
+/**
+ * @brief Compact handle to an interned string
+ *
+ * Two symbols compare equal iff their strings are equal, so symbol tables
+ * can hash and compare the id instead of the text. Id 0 is the empty
+ * (invalid) symbol.
+ */
+class Symbol {
+public:
+  constexpr Symbol() : id_(0) {}
+  constexpr explicit Symbol(std::uint32_t id) : id_(id) {}
+
+  constexpr std::uint32_t getId() const { return id_; }
+  constexpr bool isValid() const { return id_ != 0; }
+
+  /**
+   * @brief Gets the interned text of this symbol
+   * @return Reference that stays valid for the lifetime of the process
+   */
+  const std::string &str() const;
+
+  constexpr bool operator==(Symbol other) const { return id_ == other.id_; }
+  constexpr bool operator!=(Symbol other) const { return id_ != other.id_; }
+
+private:
+  std::uint32_t id_;
+};
+
+/**
+ * @class Interner
+ * @brief Owns one copy of every identifier and literal spelling
+ *
+ * Strings are stored in a deque so references returned by lookup() are
+ * never invalidated by later insertions.
+ */
+class Interner {
+  SINGLETON(Interner);
+
+public:
+  /**
+   * @brief Interns a string
+   * @param text Text to intern
+   * @return Symbol for the text; the same text always yields the same symbol
+   */
+  Symbol intern(std::string_view text);
+
+  /**
+   * @brief Gets the text of a symbol
+   * @param symbol Symbol to resolve
+   * @return Interned text, or an empty string for the invalid symbol
+   */
+  const std::string &lookup(Symbol symbol) const;
+
+private:
+  std::deque<std::string> strings_;                  // Indexed by id - 1
+  std::unordered_map<std::string_view, Symbol> ids_; // Views into strings_
+  mutable std::mutex mutex_;
+};
+
+inline const std::string &Symbol::str() const {
+  return Interner::instance().lookup(*this);
+}
+
+} // namespace core
+
+namespace std {
+template <> struct hash<core::Symbol> {
+  size_t operator()(core::Symbol symbol) const noexcept {
+    return std::hash<std::uint32_t>()(symbol.getId());
+  }
+};
+} // namespace std
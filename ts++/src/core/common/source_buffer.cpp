@@ -0,0 +1,72 @@
+/*****************************************************************************
+ * File: source_buffer.cpp
+ * Description: Implementation of mmap-backed and in-memory source buffers.
+ *****************************************************************************/
+
+#include "source_buffer.h"
+#include <fstream>
+#include <sstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define TSPP_HAS_MMAP 1
+#endif
+
+namespace core {
+
+SourceBuffer::~SourceBuffer() {
+#ifdef TSPP_HAS_MMAP
+  if (mapped_) {
+    munmap(const_cast<char *>(data_), size_);
+  }
+#endif
+}
+
+std::unique_ptr<SourceBuffer> SourceBuffer::fromFile(const std::string &path) {
+#ifdef TSPP_HAS_MMAP
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return nullptr;
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+    size_t size = static_cast<size_t>(info.st_size);
+    void *address = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (address != MAP_FAILED) {
+      close(fd); // The mapping keeps the file referenced
+      madvise(address, size, MADV_SEQUENTIAL);
+
+      std::unique_ptr<SourceBuffer> buffer(new SourceBuffer());
+      buffer->data_ = static_cast<const char *>(address);
+      buffer->size_ = size;
+      buffer->mapped_ = true;
+      return buffer;
+    }
+  }
+  close(fd);
+  // Empty files, pipes and failed mappings fall through to a plain read
+#endif
+
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    return nullptr;
+  }
+
+  std::stringstream contents;
+  contents << file.rdbuf();
+  return fromString(contents.str());
+}
+
+std::unique_ptr<SourceBuffer> SourceBuffer::fromString(std::string text) {
+  std::unique_ptr<SourceBuffer> buffer(new SourceBuffer());
+  buffer->storage_ = std::move(text);
+  buffer->data_ = buffer->storage_.data();
+  buffer->size_ = buffer->storage_.size();
+  return buffer;
+}
+
+} // namespace core
@@ -0,0 +1,66 @@
+/*****************************************************************************
+ * File: source_buffer.h
+ * Description: Read-only source text storage, memory-mapped where possible
+ *
+ * Contains:
+ * - mmap-backed file buffers on POSIX systems
+ * - Read-into-memory fallback for other platforms and unmappable files
+ * - In-memory buffers for REPL input and generated code
+ *****************************************************************************/
+
+#pragma once
+#include "macros.h"
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace core {
+
+/**
+ * @class SourceBuffer
+ * @brief Immutable view of a source file's bytes
+ *
+ * The text is scanned in place by the lexer and tokens keep views into it,
+ * so a buffer must outlive every token created from it. The SourceManager
+ * owns all buffers for the lifetime of the process.
+ */
+class SourceBuffer {
+public:
+  NON_COPYABLE(SourceBuffer);
+  ~SourceBuffer();
+
+  /**
+   * @brief Opens a file, mapping it into memory when supported
+   * @param path Path of the file to open
+   * @return Buffer holding the file contents, or nullptr if it can't be read
+   */
+  static std::unique_ptr<SourceBuffer> fromFile(const std::string &path);
+
+  /**
+   * @brief Wraps in-memory text
+   * @param text Source text (moved into the buffer)
+   * @return Buffer owning the text
+   */
+  static std::unique_ptr<SourceBuffer> fromString(std::string text);
+
+  /**
+   * @brief Gets the buffer contents
+   */
+  std::string_view getText() const { return std::string_view(data_, size_); }
+
+  /**
+   * @brief Checks whether the contents are memory-mapped
+   */
+  bool isMapped() const { return mapped_; }
+
+private:
+  SourceBuffer() = default;
+
+  const char *data_ = nullptr; // Start of the text
+  std::size_t size_ = 0;       // Length of the text in bytes
+  bool mapped_ = false;        // Whether data_ points into a file mapping
+  std::string storage_;        // Owned text when not mapped
+};
+
+} // namespace core
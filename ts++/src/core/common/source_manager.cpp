@@ -0,0 +1,188 @@
+/*****************************************************************************
+ * File: source_manager.cpp
+ * Description: Implementation of the central source buffer registry.
+ *****************************************************************************/
+
+#include "source_manager.h"
+#include <algorithm>
+
+namespace core {
+
+/*****************************************************************************
+ * Registration
+ *****************************************************************************/
+FileId SourceManager::addFile(const std::string &filename, std::string content) {
+  return addFile(filename, SourceBuffer::fromString(std::move(content)));
+}
+
+FileId SourceManager::addFile(const std::string &filename,
+                              std::unique_ptr<SourceBuffer> buffer) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  auto file = std::make_unique<SourceFile>();
+  file->name = filename;
+  file->buffer = std::move(buffer);
+  file->loaded = true;
+  buildLineTable(*file);
+
+  files_.push_back(std::move(file));
+  FileId id = static_cast<FileId>(files_.size());
+  fileIds_[filename] = id;
+  return id;
+}
+
+FileId SourceManager::getFileId(const std::string &filename) {
+  if (filename.empty()) {
+    return INVALID_FILE_ID;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  auto it = fileIds_.find(filename);
+  if (it != fileIds_.end()) {
+    return it->second;
+  }
+
+  // Register the name only; content is read on first use
+  auto file = std::make_unique<SourceFile>();
+  file->name = filename;
+  files_.push_back(std::move(file));
+  FileId id = static_cast<FileId>(files_.size());
+  fileIds_[filename] = id;
+  return id;
+}
+
+void SourceManager::releaseFile(FileId id) {
+  std::vector<std::function<void(FileId)>> listeners;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    SourceFile *file = lookup(id);
+    if (!file) {
+      return;
+    }
+    auto name = fileIds_.find(file->name);
+    if (name != fileIds_.end() && name->second == id) {
+      fileIds_.erase(name);
+    }
+    // The slot stays, so the id is not handed out again
+    files_[id - 1].reset();
+    listeners = releaseListeners_;
+  }
+  for (const auto &listener : listeners) {
+    listener(id);
+  }
+}
+
+void SourceManager::onRelease(std::function<void(FileId)> listener) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  releaseListeners_.push_back(std::move(listener));
+}
+
+/*****************************************************************************
+ * Queries
+ *****************************************************************************/
+const std::string &SourceManager::getFilename(FileId id) const {
+  static const std::string empty;
+  const SourceFile *file = loadedFile(id);
+  return file ? file->name : empty;
+}
+
+std::string_view SourceManager::getBuffer(FileId id) const {
+  const SourceFile *file = loadedFile(id);
+  if (!file) {
+    return std::string_view();
+  }
+  return file->buffer->getText();
+}
+
+std::pair<unsigned int, unsigned int>
+SourceManager::getLineColumn(FileId id, std::uint32_t offset) const {
+  const SourceFile *file = loadedFile(id);
+  if (!file) {
+    return {0, 0};
+  }
+
+  // Last line start that is <= offset
+  auto it = std::upper_bound(file->lineOffsets.begin(),
+                             file->lineOffsets.end(), offset);
+  size_t lineIndex = static_cast<size_t>(it - file->lineOffsets.begin()) - 1;
+  unsigned int column = offset - file->lineOffsets[lineIndex] + 1;
+  return {static_cast<unsigned int>(lineIndex + 1), column};
+}
+
+std::string SourceManager::getLineContent(FileId id, unsigned int line) const {
+  const SourceFile *file = loadedFile(id);
+  if (!file || line == 0) {
+    return "";
+  }
+
+  if (line > file->lineOffsets.size()) {
+    return "";
+  }
+
+  std::string_view text = file->buffer->getText();
+  size_t start = file->lineOffsets[line - 1];
+  size_t end = line < file->lineOffsets.size() ? file->lineOffsets[line] - 1
+                                               : text.size();
+  if (start > end) {
+    return "";
+  }
+  return std::string(text.substr(start, end - start));
+}
+
+/*****************************************************************************
+ * Internal Helpers
+ *****************************************************************************/
+void SourceManager::ensureLoaded(SourceFile &file) const {
+  if (file.loaded) {
+    return;
+  }
+  file.loaded = true;
+
+  file.buffer = SourceBuffer::fromFile(file.name);
+  if (!file.buffer) {
+    file.buffer = SourceBuffer::fromString("");
+  }
+  buildLineTable(file);
+}
+
+void SourceManager::buildLineTable(SourceFile &file) {
+  std::string_view text = file.buffer->getText();
+  file.lineOffsets.clear();
+  file.lineOffsets.push_back(0);
+  for (size_t i = text.find('\n'); i != std::string_view::npos;
+       i = text.find('\n', i + 1)) {
+    file.lineOffsets.push_back(static_cast<std::uint32_t>(i + 1));
+  }
+}
+
+const SourceManager::SourceFile *SourceManager::loadedFile(FileId id) const {
+  // Loaded files never change and live until released, after which they
+  // are not queried, so once a thread has seen one it reads it without
+  // the lock
+  thread_local std::vector<const SourceFile *> cache;
+  if (id < cache.size() && cache[id]) {
+    return cache[id];
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  SourceFile *file = lookup(id);
+  if (!file) {
+    return nullptr;
+  }
+  ensureLoaded(*file);
+  if (cache.size() <= id) {
+    cache.resize(id + 1, nullptr);
+  }
+  cache[id] = file;
+  return file;
+}
+
+SourceManager::SourceFile *SourceManager::lookup(FileId id) const {
+  if (id == INVALID_FILE_ID || id > files_.size()) {
+    return nullptr;
+  }
+  return files_[id - 1].get();
+}
+
+} // namespace core
@@ -0,0 +1,144 @@
+/*****************************************************************************
+ * File: source_manager.h
+ * Description: Central registry of source buffers used during compilation
+ *
+ * Contains:
+ * - File id allocation for source buffers
+ * - Line-offset tables for offset <-> line/column mapping
+ * - On-demand line content retrieval for diagnostics
+ *****************************************************************************/
+
+#pragma once
+#include "macros.h"
+#include "source_buffer.h"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace core {
+
+/**
+ * @brief Compact identifier of a source buffer owned by the SourceManager
+ *
+ * Id 0 is reserved for locations that do not belong to any file.
+ */
+using FileId = std::uint32_t;
+constexpr FileId INVALID_FILE_ID = 0;
+
+/**
+ * @class SourceManager
+ * @brief Owns every source buffer and its line-offset table
+ *
+ * Each file is read (or mapped) at most once. Source locations only carry a FileId and
+ * offset, and line text is materialized when a diagnostic is printed.
+ * Buffers are never replaced once registered, so views into them stay valid
+ * until the file is released, and ids are never reused. The lock only
+ * guards registration and a thread's first query of each file; later
+ * queries read the loaded file directly, which keeps token lexeme and
+ * location lookups lock-free.
+ */
+class SourceManager {
+  SINGLETON(SourceManager);
+
+public:
+  /**
+   * @brief Registers an in-memory source buffer
+   * @param filename Name used for diagnostics
+   * @param content Source text (moved into the manager)
+   * @return Id of the newly registered buffer
+   */
+  FileId addFile(const std::string &filename, std::string content);
+
+  /**
+   * @brief Registers an already opened source buffer
+   * @param filename Name used for diagnostics
+   * @param buffer Buffer to take ownership of (e.g. a mapped file)
+   * @return Id of the newly registered buffer
+   */
+  FileId addFile(const std::string &filename,
+                 std::unique_ptr<SourceBuffer> buffer);
+
+  /**
+   * @brief Gets the id for a filename, registering the name if unknown
+   * @param filename Name of the file
+   * @return Id of the latest buffer registered under this name
+   * @note Content for names registered this way is loaded lazily from disk
+   */
+  FileId getFileId(const std::string &filename);
+
+  /**
+   * @brief Frees a buffer nothing refers to any more
+   * @param id Buffer id; unknown and released ids are ignored
+   * @note No token, location or view of the buffer may be used afterwards,
+   *       on any thread, as a thread that queried the id before may still
+   *       read the freed file. A thread that did not finds no file.
+   */
+  void releaseFile(FileId id);
+
+  /**
+   * @brief Calls a function with the id of every buffer released from now
+   * on, for side tables that key entries by file id
+   * @param listener Called outside the lock, on the releasing thread
+   */
+  void onRelease(std::function<void(FileId)> listener);
+
+  /**
+   * @brief Gets the filename of a buffer
+   * @param id Buffer id
+   * @return Filename, or an empty string for INVALID_FILE_ID
+   */
+  const std::string &getFilename(FileId id) const;
+
+  /**
+   * @brief Gets the full source text of a buffer
+   * @param id Buffer id
+   * @return View of the buffer, empty if unknown
+   */
+  std::string_view getBuffer(FileId id) const;
+
+  /**
+   * @brief Converts a byte offset into a 1-based line and column
+   * @param id Buffer id
+   * @param offset Byte offset into the buffer
+   * @return Pair of (line, column), or (0, 0) if unknown
+   */
+  std::pair<unsigned int, unsigned int> getLineColumn(FileId id,
+                                                      std::uint32_t offset) const;
+
+  /**
+   * @brief Gets the text of a single line without its terminator
+   * @param id Buffer id
+   * @param line 1-based line number
+   * @return Line content, empty if out of range
+   */
+  std::string getLineContent(FileId id, unsigned int line) const;
+
+private:
+  struct SourceFile {
+    std::string name;                       // Filename for diagnostics
+    std::unique_ptr<SourceBuffer> buffer;   // Full source text
+    std::vector<std::uint32_t> lineOffsets; // Offset of each line start
+    bool loaded = false;                    // Whether content is present
+  };
+
+  // Fills content and line table for files registered by name only
+  void ensureLoaded(SourceFile &file) const;
+  // Gets a file with its content loaded, or nullptr for an unknown id
+  const SourceFile *loadedFile(FileId id) const;
+  static void buildLineTable(SourceFile &file);
+  SourceFile *lookup(FileId id) const;
+
+  std::vector<std::unique_ptr<SourceFile>> files_; // Indexed by id - 1, null
+                                                   // once released
+  std::unordered_map<std::string, FileId> fileIds_; // Latest id per name
+  std::vector<std::function<void(FileId)>> releaseListeners_;
+  mutable std::mutex mutex_;
+};
+
+} // namespace core
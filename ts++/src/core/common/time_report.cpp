@@ -0,0 +1,220 @@
+#include "time_report.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <sys/resource.h>
+#include <unordered_map>
+
+namespace core {
+
+namespace {
+
+// An event that has begun on this thread and not ended yet
+struct OpenEvent {
+  TimeReport::Category category;
+  std::string name;
+  std::string detail;
+  int64_t wall;
+  int64_t cpu;
+  int64_t peak;
+  int64_t nestedWall = 0; // Of the events of the same category inside
+  int64_t nestedCPU = 0;
+};
+
+thread_local std::vector<OpenEvent> openEvents;
+thread_local uint32_t threadId = 0; // 0 until the thread records an event
+
+int64_t wallMicros() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+int64_t threadCPUMicros() {
+  timespec time;
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time) != 0) {
+    return 0;
+  }
+  return static_cast<int64_t>(time.tv_sec) * 1000000 + time.tv_nsec / 1000;
+}
+
+// Peak resident set of the process so far, in kilobytes
+int64_t peakKilobytes() {
+  rusage usage;
+  return getrusage(RUSAGE_SELF, &usage) == 0 ? usage.ru_maxrss : 0;
+}
+
+const char *categoryName(TimeReport::Category category) {
+  return category == TimeReport::Category::Pass ? "pass" : "phase";
+}
+
+void writeJSONString(std::ostream &out, std::string_view text) {
+  out << '"';
+  for (char c : text) {
+    switch (c) {
+    case '"':
+      out << "\\\"";
+      break;
+    case '\\':
+      out << "\\\\";
+      break;
+    case '\n':
+      out << "\\n";
+      break;
+    case '\t':
+      out << "\\t";
+      break;
+    default:
+      if (static_cast<unsigned char>(c) < 0x20) {
+        char escaped[8];
+        std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+        out << escaped;
+      } else {
+        out << c;
+      }
+    }
+  }
+  out << '"';
+}
+
+} // namespace
+
+TimeReport::Scope::Scope(std::string_view name, std::string_view detail,
+                         Category category)
+    : active_(TimeReport::instance().isEnabled()) {
+  if (active_) {
+    TimeReport::instance().begin(name, detail, category);
+  }
+}
+
+TimeReport::Scope::~Scope() {
+  if (active_) {
+    TimeReport::instance().end();
+  }
+}
+
+void TimeReport::begin(std::string_view name, std::string_view detail,
+                       Category category) {
+  openEvents.push_back({category, std::string(name), std::string(detail),
+                        wallMicros(), threadCPUMicros(), peakKilobytes()});
+}
+
+void TimeReport::end() {
+  if (openEvents.empty()) {
+    return;
+  }
+  int64_t wall = wallMicros();
+  int64_t cpu = threadCPUMicros();
+  int64_t peak = peakKilobytes();
+  OpenEvent open = std::move(openEvents.back());
+  openEvents.pop_back();
+  if (!openEvents.empty() && openEvents.back().category == open.category) {
+    openEvents.back().nestedWall += wall - open.wall;
+    openEvents.back().nestedCPU += cpu - open.cpu;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (threadId == 0) {
+    threadId = ++threads_;
+  }
+  if (origin_ < 0 || open.wall < origin_) {
+    // Events are stored relative to the earliest start seen
+    int64_t shift = origin_ < 0 ? 0 : origin_ - open.wall;
+    for (auto &event : events_) {
+      event.start += shift;
+    }
+    origin_ = open.wall;
+  }
+  events_.push_back({open.category, std::move(open.name),
+                     std::move(open.detail), threadId, open.wall - origin_,
+                     wall - open.wall, wall - open.wall - open.nestedWall,
+                     cpu - open.cpu - open.nestedCPU, peak - open.peak});
+}
+
+void TimeReport::print(std::ostream &out) const {
+  struct Total {
+    std::string name;
+    int64_t wall = 0;
+    int64_t cpu = 0;
+    int64_t peakGrowth = 0;
+    size_t count = 0;
+  };
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (Category table : {Category::Phase, Category::Pass}) {
+    std::vector<Total> totals;
+    std::unordered_map<std::string_view, size_t> index;
+    for (const auto &event : events_) {
+      if (event.category != table) {
+        continue;
+      }
+      auto [it, added] = index.emplace(event.name, totals.size());
+      if (added) {
+        totals.push_back({event.name});
+      }
+      Total &total = totals[it->second];
+      total.wall += event.selfWall;
+      total.cpu += event.selfCPU;
+      total.peakGrowth += event.peakGrowth;
+      ++total.count;
+    }
+    if (totals.empty()) {
+      continue;
+    }
+    std::stable_sort(totals.begin(), totals.end(),
+                     [](const Total &a, const Total &b) {
+                       return a.wall > b.wall;
+                     });
+
+    const char *title = table == Category::Phase
+                            ? "Compilation phases"
+                            : "LLVM passes, by pass";
+    out << "===" << std::string(73, '-') << "===\n"
+        << "  " << title << "\n"
+        << "===" << std::string(73, '-') << "===\n"
+        << "   Wall (ms)     CPU (ms)  Peak +KB   Count  Name\n";
+    Total sum;
+    for (const auto &total : totals) {
+      out << std::fixed << std::setprecision(3) << std::setw(12)
+          << total.wall / 1000.0 << " " << std::setw(12) << total.cpu / 1000.0
+          << " " << std::setw(9) << total.peakGrowth << " " << std::setw(7)
+          << total.count << "  " << total.name << "\n";
+      sum.wall += total.wall;
+      sum.cpu += total.cpu;
+      sum.peakGrowth += total.peakGrowth;
+      sum.count += total.count;
+    }
+    out << std::setw(12) << sum.wall / 1000.0 << " " << std::setw(12)
+        << sum.cpu / 1000.0 << " " << std::setw(9) << sum.peakGrowth << " "
+        << std::setw(7) << sum.count << "  Total\n\n";
+  }
+}
+
+bool TimeReport::writeTrace(const std::string &path) const {
+  std::ofstream out(path);
+  if (!out) {
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  for (size_t i = 0; i < events_.size(); ++i) {
+    const Event &event = events_[i];
+    out << (i ? ",\n" : "\n") << "{\"ph\":\"X\",\"pid\":1,\"tid\":"
+        << event.thread << ",\"ts\":" << event.start
+        << ",\"dur\":" << event.wall << ",\"cat\":\""
+        << categoryName(event.category) << "\",\"name\":";
+    writeJSONString(out, event.name);
+    out << ",\"args\":{\"detail\":";
+    writeJSONString(out, event.detail);
+    out << ",\"self_cpu_us\":" << event.selfCPU
+        << ",\"peak_growth_kb\":" << event.peakGrowth << "}}";
+  }
+  out << "\n]}\n";
+  return static_cast<bool>(out);
+}
+
+} // namespace core
@@ -0,0 +1,127 @@
+/*****************************************************************************
+ * File: time_report.h
+ * Description: Where compile time and memory go, by phase and by pass
+ *
+ * Contains:
+ * - Scoped timers for the phases of a compilation
+ * - A summary table of wall time, CPU time and memory growth per phase
+ * - Chrome trace event output, for chrome://tracing and Perfetto
+ *****************************************************************************/
+
+#pragma once
+#include "macros.h"
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace core {
+
+/**
+ * @class TimeReport
+ * @brief Records how long each phase of a compilation takes
+ *
+ * A Scope around a phase records an event with its wall time, the CPU time
+ * of its thread, and how far it raised the peak resident set of the process.
+ * Phases of different files or partitions run on several threads and are
+ * recorded from each; the summary adds up all events of a name, so a phase
+ * split across threads can show more CPU than wall time.
+ *
+ * An event that starts inside another of the same category is left out of
+ * the outer one's time in the summary, so each table adds up to the time
+ * spent. The trace keeps every event whole, for viewers to nest them.
+ *
+ * Recording is off until enable() is called, and a disabled Scope does not
+ * read any clock. The optimizer reports each LLVM pass as an event of the
+ * pass category, under the name of the pass.
+ */
+class TimeReport {
+  SINGLETON(TimeReport);
+
+public:
+  // Events of different categories are summarized in tables of their own
+  enum class Category { Phase, Pass };
+
+  /**
+   * @class Scope
+   * @brief Records an event from its construction to its destruction
+   */
+  class Scope {
+  public:
+    NON_COPYABLE(Scope);
+
+    /**
+     * @brief Starts an event if the report is enabled
+     * @param name Name the event is summarized under
+     * @param detail What it works on, such as a file; only traced
+     * @param category Table the event is summarized in
+     */
+    explicit Scope(std::string_view name, std::string_view detail = "",
+                   Category category = Category::Phase);
+    ~Scope();
+
+  private:
+    bool active_; ///< Whether the report was enabled at construction
+  };
+
+  /**
+   * @brief Starts recording
+   */
+  void enable() { enabled_ = true; }
+
+  /**
+   * @brief Checks whether events are being recorded
+   */
+  bool isEnabled() const { return enabled_; }
+
+  /**
+   * @brief Starts an event on the calling thread
+   *
+   * For callbacks that cannot hold a Scope; every begin() must be matched
+   * by an end() on the same thread, innermost first.
+   */
+  void begin(std::string_view name, std::string_view detail,
+             Category category);
+
+  /**
+   * @brief Ends the innermost event of the calling thread
+   */
+  void end();
+
+  /**
+   * @brief Prints the summary tables, longest first
+   * @param out Stream to print to
+   */
+  void print(std::ostream &out) const;
+
+  /**
+   * @brief Writes every event as Chrome trace JSON
+   * @param path Path of the trace file
+   * @return True if the file was written
+   */
+  bool writeTrace(const std::string &path) const;
+
+private:
+  struct Event {
+    Category category;
+    std::string name;
+    std::string detail;
+    uint32_t thread;     ///< Small id of the recording thread
+    int64_t start;       ///< Wall clock, microseconds since the first event
+    int64_t wall;        ///< Microseconds
+    int64_t selfWall;    ///< Less the nested events of the same category
+    int64_t selfCPU;     ///< Microseconds of the thread's CPU time, likewise
+    int64_t peakGrowth;  ///< Kilobytes the peak resident set grew by
+  };
+
+  std::atomic<bool> enabled_{false};  ///< Whether events are recorded
+  mutable std::mutex mutex_;          ///< Guards the members below
+  std::vector<Event> events_;         ///< In order of completion
+  int64_t origin_ = -1;               ///< Wall clock of the first event
+  uint32_t threads_ = 0;              ///< Threads seen so far
+};
+
+} // namespace core
@@ -4,7 +4,12 @@
  *****************************************************************************/
 
 #include "error_reporter.h"
+#include "../utils/output_buffer.h"
+#include <algorithm>
 #include <iostream>
+#include <numeric>
+#include <tuple>
+#include <unordered_map>
 
 namespace core {
 
@@ -18,7 +23,6 @@ const String RESET = "\033[0m";     // Reset color
 void ErrorReporter::error(const SourceLocation &location, const String &message,
                           const String &code) {
   report(Diagnostic::Severity::Error, location, message, code);
-  errorCount_++;
 }
 
 void ErrorReporter::warning(const SourceLocation &location,
@@ -31,64 +35,161 @@ void ErrorReporter::info(const SourceLocation &location, const String &message,
   report(Diagnostic::Severity::Info, location, message, code);
 }
 
+ErrorReporter::~ErrorReporter() {
+  if (echo_) {
+    flush();
+  }
+}
+
 void ErrorReporter::clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
   diagnostics_.clear();
   errorCount_ = 0;
+  flushed_ = 0;
+  errorsShown_ = 0;
+  warningsShown_ = 0;
+}
+
+void ErrorReporter::append(const ErrorReporter &other) {
+  for (const auto &diag : other.getDiagnostics()) {
+    report(diag.severity, diag.location, diag.message, diag.code);
+  }
 }
 
 void ErrorReporter::report(Diagnostic::Severity severity,
                            const SourceLocation &location,
                            const String &message, const String &code) {
-  // Store diagnostic
+  std::lock_guard<std::mutex> lock(mutex_);
   diagnostics_.emplace_back(severity, location, message, code);
-  auto &diag = diagnostics_.back();
-
-  // Select color based on severity
-  const String &color = severity == Diagnostic::Severity::Error     ? RED
-                        : severity == Diagnostic::Severity::Warning ? YELLOW
-                                                                    : BLUE;
+  if (severity == Diagnostic::Severity::Error) {
+    errorCount_++;
+  }
+}
 
-  const char *sevStr = severity == Diagnostic::Severity::Error     ? "error"
-                       : severity == Diagnostic::Severity::Warning ? "warning"
-                                                                   : "info";
+void ErrorReporter::flush() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (flushed_ < diagnostics_.size()) {
+    render(flushed_, diagnostics_.size(), true);
+    flushed_ = diagnostics_.size();
+  }
+}
 
-  // Use toString() for location display
-  std::cerr << location.toString();
+void ErrorReporter::printAllErrors() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  render(0, diagnostics_.size(), false);
+}
 
-  // Add severity and code
-  std::cerr << color << sevStr << RESET;
-  if (!code.empty()) {
-    std::cerr << "[" << code << "]";
+void ErrorReporter::render(size_t begin, size_t end, bool limited) {
+  // Diagnostics come in the order passes found them. Files keep the order
+  // they first appear in, which the driver makes the input order; within
+  // a file they are shown in source order, those at one location in the
+  // order they were reported.
+  std::unordered_map<FileId, size_t> fileRanks;
+  for (size_t i = begin; i < end; ++i) {
+    fileRanks.emplace(diagnostics_[i].location.getFileId(), fileRanks.size());
+  }
+  std::vector<size_t> order(end - begin);
+  std::iota(order.begin(), order.end(), begin);
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    const SourceLocation &x = diagnostics_[a].location;
+    const SourceLocation &y = diagnostics_[b].location;
+    return std::make_tuple(fileRanks[x.getFileId()], x.getLine(),
+                           x.getColumn()) <
+           std::make_tuple(fileRanks[y.getFileId()], y.getLine(),
+                           y.getColumn());
+  });
+
+  utils::OutputBuffer out(std::cerr);
+  const bool sarif = format_ == DiagnosticFormat::SARIF;
+  if (sarif) {
+    out << "{\"$schema\":\"https://json.schemastore.org/sarif-2.1.0.json\","
+           "\"version\":\"2.1.0\",\"runs\":[{\"tool\":{\"driver\":{"
+           "\"name\":\"tspp\"}},\"results\":[";
   }
 
-  // Add message
-  std::cerr << ": " << message << "\n";
-}
+  unsigned hiddenErrors = 0;
+  unsigned hiddenWarnings = 0;
+  bool first = true;
+  for (size_t index : order) {
+    const Diagnostic &diag = diagnostics_[index];
+    if (limited && diag.severity == Diagnostic::Severity::Error) {
+      if (errorLimit_ && errorsShown_ >= errorLimit_) {
+        ++hiddenErrors;
+        continue;
+      }
+      ++errorsShown_;
+    } else if (limited && diag.severity == Diagnostic::Severity::Warning) {
+      if (warningLimit_ && warningsShown_ >= warningLimit_) {
+        ++hiddenWarnings;
+        continue;
+      }
+      ++warningsShown_;
+    }
+
+    const SourceLocation &location = diag.location;
+    const char *severity = diag.severity == Diagnostic::Severity::Error ? "error"
+                           : diag.severity == Diagnostic::Severity::Warning
+                               ? "warning"
+                               : "info";
+    if (sarif) {
+      out << (first ? "{" : ",{");
+      first = false;
+      if (!diag.code.empty()) {
+        out << "\"ruleId\":";
+        out.writeJSONString(diag.code);
+        out << ',';
+      }
+      out << "\"level\":\""
+          << (diag.severity == Diagnostic::Severity::Info ? "note" : severity)
+          << "\",\"message\":{\"text\":";
+      out.writeJSONString(diag.message);
+      out << '}';
+      if (location.getLine() > 0) {
+        out << ",\"locations\":[{\"physicalLocation\":{"
+               "\"artifactLocation\":{\"uri\":";
+        out.writeJSONString(location.getFilename());
+        out << "},\"region\":{\"startLine\":" << location.getLine()
+            << ",\"startColumn\":"
+            << std::max(location.getColumn(), 1u) << "}}}]";
+      }
+      out << '}';
+      continue;
+    }
+
+    // The location, and the line it points into with a caret under it
+    out << location.getFilename() << ':' << location.getLine() << ':'
+        << location.getColumn() << '\n';
+    std::string line = location.getLineContent();
+    if (!line.empty()) {
+      out << line << '\n';
+      out.spaces(location.getColumn() > 0 ? location.getColumn() - 1 : 0);
+      out << RED << '^' << RESET;
+    }
 
-void ErrorReporter::printAllErrors() const {
-  for (const auto &diag : diagnostics_) {
     const String &color = diag.severity == Diagnostic::Severity::Error ? RED
                           : diag.severity == Diagnostic::Severity::Warning
                               ? YELLOW
                               : BLUE;
-
-    const char *sevStr = diag.severity == Diagnostic::Severity::Error ? "error"
-                         : diag.severity == Diagnostic::Severity::Warning
-                             ? "warning"
-                             : "info";
-
-    // Use toString() for formatting
-    std::cerr << diag.location.toString();
-
-    // Add severity and code
-    std::cerr << color << sevStr << RESET;
+    out << color << severity << RESET;
     if (!diag.code.empty()) {
-      std::cerr << " [" << diag.code << "]";
+      out << '[' << diag.code << ']';
     }
+    out << ": " << diag.message << '\n';
+  }
 
-    // Add message
-    std::cerr << ": " << diag.message << "\n";
+  if (sarif) {
+    out << "]}]}\n";
+    return;
+  }
+  if (hiddenErrors > 0) {
+    out << BLUE << "info" << RESET << ": " << hiddenErrors
+        << " more errors not shown (-ferror-limit=" << errorLimit_ << ")\n";
+  }
+  if (hiddenWarnings > 0) {
+    out << BLUE << "info" << RESET << ": " << hiddenWarnings
+        << " more warnings not shown (-fwarning-limit=" << warningLimit_
+        << ")\n";
   }
 }
 
-} // namespace core
\ No newline at end of file
+} // namespace core
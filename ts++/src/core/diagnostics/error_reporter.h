@@ -5,6 +5,8 @@
 
 #pragma once
 #include "../common/common_types.h"
+#include <atomic>
+#include <mutex>
 #include <vector>
 
 namespace core {
@@ -26,8 +28,24 @@ struct Diagnostic {
   String code;             // Optional diagnostic code (e.g., "E001")
 };
 
+// How an echoing reporter renders its diagnostics
+enum class DiagnosticFormat {
+  Text, // Location, source line and caret, then the message
+  SARIF // A SARIF 2.1.0 log, one run per flush
+};
+
+// Reporting is serialized, so code generation threads may share a reporter.
+// A reporter that does not echo only collects; parallel work gives each task
+// one and appends them in a fixed order, so output does not depend on timing.
+//
+// Echoed diagnostics are not written as they are reported. flush() renders
+// those reported since the last flush, sorted by location, into one buffer
+// that is written at once; an echoing reporter flushes when destroyed.
 class ErrorReporter {
 public:
+  explicit ErrorReporter(bool echo = true) : echo_(echo) {}
+  ~ErrorReporter();
+
   // Report different types of diagnostics
   void error(const SourceLocation &location, const String &message,
              const String &code = "");
@@ -47,15 +65,34 @@ public:
 
   // Diagnostic management
   void clear();
-  void printAllErrors() const;
+  void append(const ErrorReporter &other); // Reports other's diagnostics
+  void printAllErrors();                   // Renders every diagnostic again
+
+  // Rendering; a limit of 0 renders every error or warning, otherwise the
+  // rest are only counted
+  void setErrorLimit(unsigned limit) { errorLimit_ = limit; }
+  void setWarningLimit(unsigned limit) { warningLimit_ = limit; }
+  void setFormat(DiagnosticFormat format) { format_ = format; }
+  void flush();
 
 private:
   std::vector<Diagnostic> diagnostics_; // All collected diagnostics
-  int errorCount_ = 0;                  // Number of errors encountered
+  std::atomic<int> errorCount_{0};      // Number of errors encountered
+  std::mutex mutex_;                    // Guards diagnostics and output
+  bool echo_;                           // Render diagnostics on flush
+  size_t flushed_ = 0;                  // Diagnostics already rendered
+  unsigned errorLimit_ = 0;
+  unsigned warningLimit_ = 0;
+  unsigned errorsShown_ = 0; // Rendered so far, counted against the limits
+  unsigned warningsShown_ = 0;
+  DiagnosticFormat format_ = DiagnosticFormat::Text;
 
   // Common reporting logic
   void report(Diagnostic::Severity severity, const SourceLocation &location,
               const String &message, const String &code);
+
+  // Writes diagnostics_[begin, end) sorted by location
+  void render(size_t begin, size_t end, bool limited);
 };
 
 } // namespace core
\ No newline at end of file
@@ -0,0 +1,483 @@
+#include "core/utils/ast_json_writer.h"
+#include "core/utils/ast_printer.h"
+#include "parser/nodes/declaration_nodes.h"
+#include "parser/nodes/expression_nodes.h"
+#include "parser/nodes/statement_nodes.h"
+#include "parser/nodes/type_nodes.h"
+
+namespace core {
+
+namespace {
+
+using nodes::NodeKind;
+
+std::string_view kindName(NodeKind kind) {
+  switch (kind) {
+  case NodeKind::BinaryExpression:
+    return "BinaryExpression";
+  case NodeKind::UnaryExpression:
+    return "UnaryExpression";
+  case NodeKind::LiteralExpression:
+    return "LiteralExpression";
+  case NodeKind::IdentifierExpression:
+    return "IdentifierExpression";
+  case NodeKind::ArrayLiteral:
+    return "ArrayLiteral";
+  case NodeKind::ConditionalExpression:
+    return "ConditionalExpression";
+  case NodeKind::AssignmentExpression:
+    return "AssignmentExpression";
+  case NodeKind::CallExpression:
+    return "CallExpression";
+  case NodeKind::MemberExpression:
+    return "MemberExpression";
+  case NodeKind::IndexExpression:
+    return "IndexExpression";
+  case NodeKind::ThisExpression:
+    return "ThisExpression";
+  case NodeKind::NewExpression:
+    return "NewExpression";
+  case NodeKind::CastExpression:
+    return "CastExpression";
+  case NodeKind::CompileTimeExpression:
+    return "CompileTimeExpression";
+  case NodeKind::TemplateSpecialization:
+    return "TemplateSpecialization";
+  case NodeKind::PointerExpression:
+    return "PointerExpression";
+  case NodeKind::FunctionExpression:
+    return "FunctionExpression";
+  case NodeKind::Attribute:
+    return "Attribute";
+  case NodeKind::DeclarationStmt:
+    return "DeclarationStmt";
+  case NodeKind::Block:
+    return "Block";
+  case NodeKind::ExpressionStmt:
+    return "ExpressionStmt";
+  case NodeKind::IfStmt:
+    return "IfStmt";
+  case NodeKind::WhileStmt:
+    return "WhileStmt";
+  case NodeKind::DoWhileStmt:
+    return "DoWhileStmt";
+  case NodeKind::ForStmt:
+    return "ForStmt";
+  case NodeKind::ForOfStmt:
+    return "ForOfStmt";
+  case NodeKind::BreakStmt:
+    return "BreakStmt";
+  case NodeKind::ContinueStmt:
+    return "ContinueStmt";
+  case NodeKind::ReturnStmt:
+    return "ReturnStmt";
+  case NodeKind::TryStmt:
+    return "TryStmt";
+  case NodeKind::ThrowStmt:
+    return "ThrowStmt";
+  case NodeKind::SwitchStmt:
+    return "SwitchStmt";
+  case NodeKind::AssemblyStmt:
+    return "AssemblyStmt";
+  case NodeKind::LabeledStatement:
+    return "LabeledStatement";
+  case NodeKind::VarDecl:
+    return "VarDecl";
+  case NodeKind::Parameter:
+    return "Parameter";
+  case NodeKind::FunctionDecl:
+    return "FunctionDecl";
+  case NodeKind::GenericFunctionDecl:
+    return "GenericFunctionDecl";
+  case NodeKind::ClassDecl:
+    return "ClassDecl";
+  case NodeKind::GenericClassDecl:
+    return "GenericClassDecl";
+  case NodeKind::ConstructorDecl:
+    return "ConstructorDecl";
+  case NodeKind::MethodDecl:
+    return "MethodDecl";
+  case NodeKind::FieldDecl:
+    return "FieldDecl";
+  case NodeKind::PropertyDecl:
+    return "PropertyDecl";
+  case NodeKind::NamespaceDecl:
+    return "NamespaceDecl";
+  case NodeKind::EnumMember:
+    return "EnumMember";
+  case NodeKind::EnumDecl:
+    return "EnumDecl";
+  case NodeKind::MethodSignature:
+    return "MethodSignature";
+  case NodeKind::PropertySignature:
+    return "PropertySignature";
+  case NodeKind::InterfaceDecl:
+    return "InterfaceDecl";
+  case NodeKind::GenericInterfaceDecl:
+    return "GenericInterfaceDecl";
+  case NodeKind::TypedefDecl:
+    return "TypedefDecl";
+  case NodeKind::PrimitiveType:
+    return "PrimitiveType";
+  case NodeKind::NamedType:
+    return "NamedType";
+  case NodeKind::QualifiedType:
+    return "QualifiedType";
+  case NodeKind::ArrayType:
+    return "ArrayType";
+  case NodeKind::PointerType:
+    return "PointerType";
+  case NodeKind::ReferenceType:
+    return "ReferenceType";
+  case NodeKind::FunctionType:
+    return "FunctionType";
+  case NodeKind::TemplateType:
+    return "TemplateType";
+  case NodeKind::SmartPointerType:
+    return "SmartPointerType";
+  case NodeKind::AtomicType:
+    return "AtomicType";
+  case NodeKind::UnionType:
+    return "UnionType";
+  case NodeKind::GenericParam:
+    return "GenericParam";
+  case NodeKind::BuiltinConstraint:
+    return "BuiltinConstraint";
+  }
+  return "Unknown";
+}
+
+} // namespace
+
+void ASTJSONWriter::write(const parser::AST &ast) {
+  for (const auto &node : ast.getNodes()) {
+    writeNode(node, 0, "top");
+  }
+  out_.flush();
+}
+
+void ASTJSONWriter::writeField(std::string_view key, std::string_view value) {
+  out_ << ",\"" << key << "\":";
+  out_.writeJSONString(value);
+}
+
+void ASTJSONWriter::writeNode(const nodes::BaseNode *node, size_t parent,
+                              std::string_view role) {
+  using namespace nodes;
+  if (!node) {
+    return;
+  }
+  size_t id = ++lastId_;
+  const core::SourceLocation &location = node->getLocation();
+  out_ << "{\"id\":" << id << ",\"parent\":" << parent << ",\"role\":\""
+       << role << "\",\"kind\":\"" << kindName(node->getNodeKind())
+       << "\",\"line\":" << location.getLine()
+       << ",\"column\":" << location.getColumn();
+
+  if (auto decl = dyn_cast<DeclarationNode>(node)) {
+    writeField("name", decl->getName());
+  } else if (auto type = dyn_cast<TypeNode>(node)) {
+    writeField("type", type->toString());
+  } else if (auto literal = dyn_cast<LiteralExpressionNode>(node)) {
+    writeField("value", literal->getValue());
+  } else if (auto identifier = dyn_cast<IdentifierExpressionNode>(node)) {
+    writeField("value", identifier->getName());
+  } else if (auto member = dyn_cast<MemberExpressionNode>(node)) {
+    writeField("value", member->getMember());
+  } else if (auto newExpr = dyn_cast<NewExpressionNode>(node)) {
+    writeField("value", newExpr->getClassName());
+  } else if (auto castExpr = dyn_cast<CastExpressionNode>(node)) {
+    writeField("type", castExpr->getTargetType());
+  } else if (auto attribute = dyn_cast<AttributeNode>(node)) {
+    writeField("name", attribute->getName());
+  } else if (auto labeled = dyn_cast<LabeledStatementNode>(node)) {
+    writeField("value", labeled->getLabel());
+  } else if (auto assembly = dyn_cast<AssemblyStmtNode>(node)) {
+    writeField("value", assembly->getCode());
+  }
+  switch (node->getNodeKind()) {
+  case NodeKind::BinaryExpression:
+  case NodeKind::UnaryExpression:
+  case NodeKind::AssignmentExpression:
+    writeField("op", ASTPrinter::tokenTypeToString(
+                         cast<ExpressionNode>(node)->getExpressionType()));
+    break;
+  default:
+    break;
+  }
+  out_ << "}\n";
+
+  writeChildren(node, id);
+}
+
+void ASTJSONWriter::writeChildren(const nodes::BaseNode *node, size_t id) {
+  using namespace nodes;
+  auto each = [&](const auto &children, std::string_view role) {
+    for (const auto &child : children) {
+      writeNode(child, id, role);
+    }
+  };
+
+  if (auto decl = dyn_cast<DeclarationNode>(node)) {
+    each(decl->getAttributes(), "attribute");
+  }
+  switch (node->getNodeKind()) {
+  // Expressions
+  case NodeKind::BinaryExpression: {
+    auto binary = cast<BinaryExpressionNode>(node);
+    writeNode(binary->getLeft(), id, "left");
+    writeNode(binary->getRight(), id, "right");
+    break;
+  }
+  case NodeKind::UnaryExpression:
+    writeNode(cast<UnaryExpressionNode>(node)->getOperand(), id, "operand");
+    break;
+  case NodeKind::ArrayLiteral:
+    each(cast<ArrayLiteralNode>(node)->getElements(), "element");
+    break;
+  case NodeKind::ConditionalExpression: {
+    auto conditional = cast<ConditionalExpressionNode>(node);
+    writeNode(conditional->getCondition(), id, "condition");
+    writeNode(conditional->getTrueExpression(), id, "then");
+    writeNode(conditional->getFalseExpression(), id, "else");
+    break;
+  }
+  case NodeKind::AssignmentExpression: {
+    auto assignment = cast<AssignmentExpressionNode>(node);
+    writeNode(assignment->getTarget(), id, "target");
+    writeNode(assignment->getValue(), id, "value");
+    break;
+  }
+  case NodeKind::CallExpression: {
+    auto call = cast<CallExpressionNode>(node);
+    writeNode(call->getCallee(), id, "callee");
+    each(call->getArguments(), "argument");
+    break;
+  }
+  case NodeKind::MemberExpression:
+    writeNode(cast<MemberExpressionNode>(node)->getObject(), id, "object");
+    break;
+  case NodeKind::IndexExpression: {
+    auto index = cast<IndexExpressionNode>(node);
+    writeNode(index->getArray(), id, "array");
+    writeNode(index->getIndex(), id, "index");
+    break;
+  }
+  case NodeKind::NewExpression:
+    each(cast<NewExpressionNode>(node)->getArguments(), "argument");
+    break;
+  case NodeKind::CastExpression:
+    writeNode(cast<CastExpressionNode>(node)->getExpression(), id,
+              "expression");
+    break;
+  case NodeKind::CompileTimeExpression:
+    writeNode(cast<CompileTimeExpressionNode>(node)->getOperand(), id,
+              "operand");
+    break;
+  case NodeKind::TemplateSpecialization:
+    writeNode(cast<TemplateSpecializationNode>(node)->getBase(), id, "base");
+    break;
+  case NodeKind::PointerExpression:
+    writeNode(cast<PointerExpressionNode>(node)->getOperand(), id, "operand");
+    break;
+  case NodeKind::FunctionExpression: {
+    auto function = cast<FunctionExpressionNode>(node);
+    each(function->getParameters(), "parameter");
+    writeNode(function->getReturnType(), id, "returnType");
+    writeNode(function->getBody(), id, "body");
+    break;
+  }
+  case NodeKind::Attribute:
+    writeNode(cast<AttributeNode>(node)->getArgument(), id, "argument");
+    break;
+
+  // Statements
+  case NodeKind::DeclarationStmt:
+    writeNode(cast<DeclarationStmtNode>(node)->getDeclaration(), id,
+              "declaration");
+    break;
+  case NodeKind::Block:
+    each(cast<BlockNode>(node)->getStatements(), "statement");
+    break;
+  case NodeKind::ExpressionStmt:
+    writeNode(cast<ExpressionStmtNode>(node)->getExpression(), id,
+              "expression");
+    break;
+  case NodeKind::IfStmt: {
+    auto ifStmt = cast<IfStmtNode>(node);
+    writeNode(ifStmt->getCondition(), id, "condition");
+    writeNode(ifStmt->getThenBranch(), id, "then");
+    writeNode(ifStmt->getElseBranch(), id, "else");
+    break;
+  }
+  case NodeKind::WhileStmt: {
+    auto whileStmt = cast<WhileStmtNode>(node);
+    writeNode(whileStmt->getCondition(), id, "condition");
+    writeNode(whileStmt->getBody(), id, "body");
+    break;
+  }
+  case NodeKind::DoWhileStmt: {
+    auto doWhile = cast<DoWhileStmtNode>(node);
+    writeNode(doWhile->getBody(), id, "body");
+    writeNode(doWhile->getCondition(), id, "condition");
+    break;
+  }
+  case NodeKind::ForStmt: {
+    auto forStmt = cast<ForStmtNode>(node);
+    writeNode(forStmt->getInitializer(), id, "initializer");
+    writeNode(forStmt->getCondition(), id, "condition");
+    writeNode(forStmt->getIncrement(), id, "increment");
+    writeNode(forStmt->getBody(), id, "body");
+    break;
+  }
+  case NodeKind::ForOfStmt: {
+    auto forOf = cast<ForOfStmtNode>(node);
+    writeNode(forOf->getIterable(), id, "iterable");
+    writeNode(forOf->getBody(), id, "body");
+    break;
+  }
+  case NodeKind::ReturnStmt:
+    writeNode(cast<ReturnStmtNode>(node)->getValue(), id, "value");
+    break;
+  case NodeKind::ThrowStmt:
+    writeNode(cast<ThrowStmtNode>(node)->getValue(), id, "value");
+    break;
+  case NodeKind::AssemblyStmt: {
+    auto assembly = cast<AssemblyStmtNode>(node);
+    for (const auto &output : assembly->getOutputs()) {
+      writeNode(output.expression, id, "output");
+    }
+    for (const auto &input : assembly->getInputs()) {
+      writeNode(input.expression, id, "input");
+    }
+    break;
+  }
+  case NodeKind::TryStmt: {
+    auto tryStmt = cast<TryStmtNode>(node);
+    writeNode(tryStmt->getTryBlock(), id, "try");
+    for (const auto &clause : tryStmt->getCatchClauses()) {
+      writeNode(clause.parameterType, id, "catchType");
+      writeNode(clause.body, id, "catch");
+    }
+    writeNode(tryStmt->getFinallyBlock(), id, "finally");
+    break;
+  }
+  case NodeKind::SwitchStmt: {
+    auto switchStmt = cast<SwitchStmtNode>(node);
+    writeNode(switchStmt->getExpression(), id, "expression");
+    for (const auto &switchCase : switchStmt->getCases()) {
+      writeNode(switchCase.value, id, "case");
+      each(switchCase.body, "caseBody");
+    }
+    break;
+  }
+  case NodeKind::LabeledStatement:
+    writeNode(cast<LabeledStatementNode>(node)->getStatement(), id,
+              "statement");
+    break;
+
+  // Declarations
+  case NodeKind::VarDecl: {
+    auto var = cast<VarDeclNode>(node);
+    writeNode(var->getType(), id, "type");
+    writeNode(var->getInitializer(), id, "initializer");
+    break;
+  }
+  case NodeKind::Parameter: {
+    auto param = cast<ParameterNode>(node);
+    writeNode(param->getType(), id, "type");
+    writeNode(param->getDefaultValue(), id, "default");
+    break;
+  }
+  case NodeKind::FunctionDecl:
+  case NodeKind::GenericFunctionDecl: {
+    auto function = cast<FunctionDeclNode>(node);
+    if (auto generic = dyn_cast<GenericFunctionDeclNode>(node)) {
+      each(generic->getGenericParams(), "genericParam");
+    }
+    each(function->getParameters(), "parameter");
+    writeNode(function->getReturnType(), id, "returnType");
+    each(function->getThrowsTypes(), "throws");
+    writeNode(function->getBody(), id, "body");
+    break;
+  }
+  case NodeKind::ClassDecl:
+  case NodeKind::GenericClassDecl: {
+    auto classDecl = cast<ClassDeclNode>(node);
+    if (auto generic = dyn_cast<GenericClassDeclNode>(node)) {
+      each(generic->getGenericParams(), "genericParam");
+    }
+    writeNode(classDecl->getBaseClass(), id, "base");
+    each(classDecl->getInterfaces(), "interface");
+    each(classDecl->getMembers(), "member");
+    break;
+  }
+  case NodeKind::ConstructorDecl: {
+    auto constructor = cast<ConstructorDeclNode>(node);
+    each(constructor->getParameters(), "parameter");
+    writeNode(constructor->getBody(), id, "body");
+    break;
+  }
+  case NodeKind::MethodDecl: {
+    auto method = cast<MethodDeclNode>(node);
+    each(method->getParameters(), "parameter");
+    writeNode(method->getReturnType(), id, "returnType");
+    each(method->getThrowsTypes(), "throws");
+    writeNode(method->getBody(), id, "body");
+    break;
+  }
+  case NodeKind::FieldDecl: {
+    auto field = cast<FieldDeclNode>(node);
+    writeNode(field->getType(), id, "type");
+    writeNode(field->getInitializer(), id, "initializer");
+    break;
+  }
+  case NodeKind::PropertyDecl: {
+    auto property = cast<PropertyDeclNode>(node);
+    writeNode(property->getPropertyType(), id, "type");
+    writeNode(property->getBody(), id, "body");
+    break;
+  }
+  case NodeKind::NamespaceDecl:
+    each(cast<NamespaceDeclNode>(node)->getDeclarations(), "declaration");
+    break;
+  case NodeKind::EnumMember:
+    writeNode(cast<EnumMemberNode>(node)->getValue(), id, "value");
+    break;
+  case NodeKind::EnumDecl: {
+    auto enumDecl = cast<EnumDeclNode>(node);
+    writeNode(enumDecl->getUnderlyingType(), id, "underlyingType");
+    each(enumDecl->getMembers(), "member");
+    break;
+  }
+  case NodeKind::MethodSignature: {
+    auto signature = cast<MethodSignatureNode>(node);
+    each(signature->getParameters(), "parameter");
+    writeNode(signature->getReturnType(), id, "returnType");
+    each(signature->getThrowsTypes(), "throws");
+    break;
+  }
+  case NodeKind::PropertySignature:
+    writeNode(cast<PropertySignatureNode>(node)->getType(), id, "type");
+    break;
+  case NodeKind::InterfaceDecl:
+  case NodeKind::GenericInterfaceDecl: {
+    auto interface = cast<InterfaceDeclNode>(node);
+    if (auto generic = dyn_cast<GenericInterfaceDeclNode>(node)) {
+      each(generic->getGenericParams(), "genericParam");
+    }
+    each(interface->getExtendedInterfaces(), "extends");
+    each(interface->getMembers(), "member");
+    break;
+  }
+  case NodeKind::TypedefDecl:
+    writeNode(cast<TypedefDeclNode>(node)->getAliasedType(), id, "type");
+    break;
+
+  // Types are leaves, written with their spelling
+  default:
+    break;
+  }
+}
+
+} // namespace core
@@ -0,0 +1,49 @@
+#pragma once
+#include "core/utils/output_buffer.h"
+#include "parser/ast.h"
+#include <ostream>
+#include <string_view>
+
+namespace core {
+
+/**
+ * @class ASTJSONWriter
+ * @brief Dumps an AST as JSON Lines, one object per node
+ *
+ * Nodes are written in preorder, each on a line of its own:
+ *
+ *   {"id":2,"parent":1,"role":"condition","kind":"BinaryExpression",
+ *    "line":3,"column":7,"op":"<"}
+ *
+ * Top-level nodes have parent 0. The role names the field of the parent
+ * that holds the node, and nodes in lists share a role. Declarations carry
+ * their "name", literals and identifiers a "value", operators an "op",
+ * and types, which are leaves, their spelling as "type". Unlike the
+ * pretty format, nothing is indented or colored, so the dump costs little
+ * more than writing it out.
+ */
+class ASTJSONWriter {
+public:
+  explicit ASTJSONWriter(std::ostream &out) : out_(out) {}
+
+  void write(const parser::AST &ast);
+
+  // Writes a subtree as if it were a top-level node
+  void write(const nodes::BaseNode *node) { writeNode(node, 0, "top"); }
+
+  void flush() { out_.flush(); }
+
+private:
+  void writeNode(const nodes::BaseNode *node, size_t parent,
+                 std::string_view role);
+
+  // Writes the children of a node with the given id
+  void writeChildren(const nodes::BaseNode *node, size_t id);
+
+  void writeField(std::string_view key, std::string_view value);
+
+  utils::OutputBuffer out_;
+  size_t lastId_ = 0;
+};
+
+} // namespace core
@@ -5,7 +5,7 @@
 #include "parser/nodes/statement_nodes.h"
 #include "parser/nodes/type_nodes.h"
 #include "tokens/token_type.h"
-#include <functional>
+#include "core/utils/output_buffer.h"
 #include <iostream>
 #include <ostream>
 #include <string>
@@ -21,16 +21,19 @@ private:
   static constexpr const char *YELLOW = "\033[33m";
   static constexpr const char *BLUE = "\033[34m";
 
+  // Output, written to the stream in chunks
+  utils::OutputBuffer out_;
+
   // Current indentation level
   int indentLevel_ = 0;
 
   // Helper: Print indentation spaces based on indentLevel_
-  void indent() const { std::cout << std::string(indentLevel_ * 2, ' '); }
+  void indent() { out_.spaces(indentLevel_ * 2); }
 
   // Helper: Print a line with a label and optional color, and a newline.
   void printLine(const std::string &label, const char *color = RESET) {
     indent();
-    std::cout << color << label << RESET << "\n";
+    out_ << color << label << RESET << "\n";
   }
 
   // Helper: Get source location as a string "(line:column)".
@@ -40,7 +43,7 @@ private:
   }
 
   // Helper: A lambda-style function to manage indent scope.
-  void withIndent(const std::function<void()> &func) {
+  template <typename Func> void withIndent(Func &&func) {
     indentLevel_++;
     func();
     indentLevel_--;
@@ -64,7 +67,7 @@ private:
         });
       }
       if (auto genericClass =
-              dynamic_cast<const nodes::GenericClassDeclNode *>(node)) {
+              nodes::dyn_cast<nodes::GenericClassDeclNode>(node)) {
         if (!genericClass->getGenericParams().empty()) {
           printLine("Generic Parameters:");
           withIndent([&]() {
@@ -84,14 +87,14 @@ private:
 
       if (node->getBaseClass()) {
         printLine("Base Class:");
-        withIndent([&]() { visitType(node->getBaseClass().get()); });
+        withIndent([&]() { visitType(node->getBaseClass()); });
       }
       const auto &interfaces = node->getInterfaces();
       if (!interfaces.empty()) {
         printLine("Interfaces:");
         withIndent([&]() {
           for (const auto &iface : interfaces)
-            visitType(iface.get());
+            visitType(iface);
         });
       }
       const auto &members = node->getMembers();
@@ -115,18 +118,18 @@ private:
         printLine("Parameters:");
         withIndent([&]() {
           for (const auto &param : parameters)
-            visitParameter(param.get());
+            visitParameter(param);
         });
       }
       if (node->getReturnType()) {
         printLine("Return Type:");
-        withIndent([&]() { visitType(node->getReturnType().get()); });
+        withIndent([&]() { visitType(node->getReturnType()); });
       }
       if (!node->getThrowsTypes().empty()) {
         printLine("Throws:");
         withIndent([&]() {
           for (const auto &throwT : node->getThrowsTypes())
-            visitType(throwT.get());
+            visitType(throwT);
         });
       }
       if (!node->getModifiers().empty()) {
@@ -138,7 +141,7 @@ private:
       }
       if (node->getBody()) {
         printLine("Body:");
-        withIndent([&]() { visitBlock(node->getBody().get()); });
+        withIndent([&]() { visitBlock(node->getBody()); });
       }
     });
   }
@@ -153,12 +156,12 @@ private:
         printLine("Parameters:");
         withIndent([&]() {
           for (const auto &param : params)
-            visitParameter(param.get());
+            visitParameter(param);
         });
       }
       if (node->getBody()) {
         printLine("Body:");
-        withIndent([&]() { visitBlock(node->getBody().get()); });
+        withIndent([&]() { visitBlock(node->getBody()); });
       }
     });
   }
@@ -172,11 +175,11 @@ private:
       printLine("Name: '" + node->getName() + "'");
       if (node->getType()) {
         printLine("Type:");
-        withIndent([&]() { visitType(node->getType().get()); });
+        withIndent([&]() { visitType(node->getType()); });
       }
       if (node->getInitializer()) {
         printLine("Initializer:");
-        withIndent([&]() { visitExpr(node->getInitializer().get()); });
+        withIndent([&]() { visitExpr(node->getInitializer()); });
       }
     });
   }
@@ -194,7 +197,7 @@ private:
       }
       printLine("Name: '" + node->getName() + "'");
       if (auto genericFunc =
-              dynamic_cast<const nodes::GenericFunctionDeclNode *>(node)) {
+              nodes::dyn_cast<nodes::GenericFunctionDeclNode>(node)) {
         if (!genericFunc->getGenericParams().empty()) {
           printLine("Generic Parameters:");
           withIndent([&]() {
@@ -214,22 +217,22 @@ private:
       printLine("Parameters:");
       withIndent([&]() {
         for (const auto &param : node->getParameters())
-          visitParameter(param.get());
+          visitParameter(param);
       });
       if (node->getReturnType()) {
         printLine("Return Type:");
-        withIndent([&]() { visitType(node->getReturnType().get()); });
+        withIndent([&]() { visitType(node->getReturnType()); });
       }
       if (!node->getThrowsTypes().empty()) {
         printLine("Throws:");
         withIndent([&]() {
           for (const auto &throwType : node->getThrowsTypes())
-            visitType(throwType.get());
+            visitType(throwType);
         });
       }
       if (node->getBody()) {
         printLine("Body:");
-        withIndent([&]() { visitBlock(node->getBody().get()); });
+        withIndent([&]() { visitBlock(node->getBody()); });
       }
       if (node->isAsync())
         printLine("Async: true");
@@ -242,39 +245,42 @@ private:
       printLine("Name: '" + node->getName() + "' " +
                 getLocationString(node->getLocation()));
       indent();
-      std::cout << "Storage: ";
+      out_ << "Storage: ";
       switch (node->getStorageClass()) {
       case tokens::TokenType::HEAP:
-        std::cout << "#heap";
+        out_ << "#heap";
         break;
       case tokens::TokenType::STACK:
-        std::cout << "#stack";
+        out_ << "#stack";
         break;
       case tokens::TokenType::STATIC:
-        std::cout << "#static";
+        out_ << "#static";
+        break;
+      case tokens::TokenType::COMPTIME:
+        out_ << "#comptime";
         break;
       default:
-        std::cout << "none";
+        out_ << "none";
         break;
       }
-      std::cout << "\n";
+      out_ << "\n";
       if (node->isConst())
         printLine("Qualifier: const");
       if (node->getType()) {
         printLine("Type:");
-        withIndent([&]() { visitType(node->getType().get()); });
+        withIndent([&]() { visitType(node->getType()); });
       }
       const auto &attributes = node->getAttributes();
       if (!attributes.empty()) {
         printLine("Attributes:");
         withIndent([&]() {
           for (const auto &attr : attributes)
-            visitAttribute(attr.get());
+            visitAttribute(attr);
         });
       }
       if (node->getInitializer()) {
         printLine("Initializer:");
-        withIndent([&]() { visitExpr(node->getInitializer().get()); });
+        withIndent([&]() { visitExpr(node->getInitializer()); });
       }
     });
   }
@@ -287,7 +293,7 @@ private:
       // Print underlying type if present
       if (node->getUnderlyingType()) {
         printLine("Underlying Type:");
-        withIndent([&]() { visitType(node->getUnderlyingType().get()); });
+        withIndent([&]() { visitType(node->getUnderlyingType()); });
       }
 
       // Print enum members
@@ -296,7 +302,7 @@ private:
         printLine("Members:");
         withIndent([&]() {
           for (const auto &member : members) {
-            visitEnumMember(member.get());
+            visitEnumMember(member);
           }
         });
       }
@@ -312,7 +318,7 @@ private:
     if (node->getValue()) {
       withIndent([&]() {
         printLine("Value:");
-        withIndent([&]() { visitExpr(node->getValue().get()); });
+        withIndent([&]() { visitExpr(node->getValue()); });
       });
     }
   }
@@ -329,12 +335,12 @@ private:
 
       // Check if this is a generic interface
       if (auto genericInterface =
-              dynamic_cast<const nodes::GenericInterfaceDeclNode *>(node)) {
+              nodes::dyn_cast<nodes::GenericInterfaceDeclNode>(node)) {
         if (!genericInterface->getGenericParams().empty()) {
           printLine("Generic Parameters:");
           withIndent([&]() {
             for (const auto &param : genericInterface->getGenericParams()) {
-              visitType(param.get());
+              visitType(param);
             }
           });
         }
@@ -346,7 +352,7 @@ private:
         printLine("Extends:");
         withIndent([&]() {
           for (const auto &iface : extended) {
-            visitType(iface.get());
+            visitType(iface);
           }
         });
       }
@@ -371,7 +377,7 @@ private:
     withIndent([&]() {
       if (node->getType()) {
         printLine("Type:");
-        withIndent([&]() { visitType(node->getType().get()); });
+        withIndent([&]() { visitType(node->getType()); });
       }
       if (node->isRef())
         printLine("Modifier: ref");
@@ -379,7 +385,7 @@ private:
         printLine("Modifier: const");
       if (node->getDefaultValue()) {
         printLine("Default Value:");
-        withIndent([&]() { visitExpr(node->getDefaultValue().get()); });
+        withIndent([&]() { visitExpr(node->getDefaultValue()); });
       }
     });
   }
@@ -391,7 +397,7 @@ private:
 
       if (node->getAliasedType()) {
         printLine("Aliased Type:");
-        withIndent([&]() { visitType(node->getAliasedType().get()); });
+        withIndent([&]() { visitType(node->getAliasedType()); });
       }
 
       // Print attributes if present
@@ -400,7 +406,7 @@ private:
         printLine("Attributes:");
         withIndent([&]() {
           for (const auto &attr : attributes) {
-            visitAttribute(attr.get());
+            visitAttribute(attr);
           }
         });
       }
@@ -412,10 +418,11 @@ private:
   //---------------------------------------------------------------------------
 
   void visitBlock(const nodes::BlockNode *node) {
-    printLine("Block " + getLocationString(node->getLocation()));
+    printLine((node->isArena() ? "Block #arena " : "Block ") +
+              getLocationString(node->getLocation()));
     withIndent([&]() {
       for (const auto &stmt : node->getStatements())
-        visitStmt(stmt.get());
+        visitStmt(stmt);
     });
   }
 
@@ -424,69 +431,63 @@ private:
       printLine("null-statement", RED);
       return;
     }
-    if (auto exprStmt = dynamic_cast<const nodes::ExpressionStmtNode *>(stmt))
+    if (auto exprStmt = nodes::dyn_cast<nodes::ExpressionStmtNode>(stmt))
       visitExprStmt(exprStmt);
-    else if (auto returnStmt =
-                 dynamic_cast<const nodes::ReturnStmtNode *>(stmt))
+    else if (auto returnStmt = nodes::dyn_cast<nodes::ReturnStmtNode>(stmt))
       visitReturnStmt(returnStmt);
-    else if (auto ifStmt = dynamic_cast<const nodes::IfStmtNode *>(stmt))
+    else if (auto ifStmt = nodes::dyn_cast<nodes::IfStmtNode>(stmt))
       visitIfStmt(ifStmt);
-    else if (auto declStmt =
-                 dynamic_cast<const nodes::DeclarationStmtNode *>(stmt))
+    else if (auto declStmt = nodes::dyn_cast<nodes::DeclarationStmtNode>(stmt))
       visitDeclStmt(declStmt);
-    else if (auto whileStmt = dynamic_cast<const nodes::WhileStmtNode *>(stmt))
+    else if (auto whileStmt = nodes::dyn_cast<nodes::WhileStmtNode>(stmt))
       visitWhileStmt(whileStmt);
-    else if (auto doWhileStmt =
-                 dynamic_cast<const nodes::DoWhileStmtNode *>(stmt))
+    else if (auto doWhileStmt = nodes::dyn_cast<nodes::DoWhileStmtNode>(stmt))
       visitDoWhileStmt(doWhileStmt);
-    else if (auto forStmt = dynamic_cast<const nodes::ForStmtNode *>(stmt))
+    else if (auto forStmt = nodes::dyn_cast<nodes::ForStmtNode>(stmt))
       visitForStmt(forStmt);
-    else if (auto forOfStmt = dynamic_cast<const nodes::ForOfStmtNode *>(stmt))
+    else if (auto forOfStmt = nodes::dyn_cast<nodes::ForOfStmtNode>(stmt))
       visitForOfStmt(forOfStmt);
-    else if (auto blockStmt = dynamic_cast<const nodes::BlockNode *>(stmt))
+    else if (auto blockStmt = nodes::dyn_cast<nodes::BlockNode>(stmt))
       visitBlock(blockStmt);
-    else if (auto breakStmt = dynamic_cast<const nodes::BreakStmtNode *>(stmt))
+    else if (auto breakStmt = nodes::dyn_cast<nodes::BreakStmtNode>(stmt))
       visitBreakStmt(breakStmt);
-    else if (auto continueStmt =
-                 dynamic_cast<const nodes::ContinueStmtNode *>(stmt))
+    else if (auto continueStmt = nodes::dyn_cast<nodes::ContinueStmtNode>(stmt))
       visitContinueStmt(continueStmt);
-    else if (auto tryStmt = dynamic_cast<const nodes::TryStmtNode *>(stmt))
+    else if (auto tryStmt = nodes::dyn_cast<nodes::TryStmtNode>(stmt))
       visitTryStmt(tryStmt);
-    else if (auto throwStmt = dynamic_cast<const nodes::ThrowStmtNode *>(stmt))
+    else if (auto throwStmt = nodes::dyn_cast<nodes::ThrowStmtNode>(stmt))
       visitThrowStmt(throwStmt);
-    else if (auto switchStmt =
-                 dynamic_cast<const nodes::SwitchStmtNode *>(stmt)) {
-      std::cout << "visiting switch statement\n";
+    else if (auto switchStmt = nodes::dyn_cast<nodes::SwitchStmtNode>(stmt)) {
+      out_ << "visiting switch statement\n";
       visitSwitchStmt(switchStmt);
-    } else if (auto asmStmt =
-                   dynamic_cast<const nodes::AssemblyStmtNode *>(stmt)) {
+    } else if (auto asmStmt = nodes::dyn_cast<nodes::AssemblyStmtNode>(stmt)) {
       visitAsmStmt(asmStmt);
     } else if (auto labeledStmt =
-                   dynamic_cast<const nodes::LabeledStatementNode *>(stmt)) {
+                   nodes::dyn_cast<nodes::LabeledStatementNode>(stmt)) {
       visitLabeledStmt(labeledStmt);
     } else {
       indent();
-      std::cout << RED << "Unknown statement type at "
+      out_ << RED << "Unknown statement type at "
                 << stmt->getLocation().getLine() << ":"
                 << stmt->getLocation().getColumn();
-      std::cout << " (typeid: " << typeid(*stmt).name() << ")" << RESET << "\n";
+      out_ << " (typeid: " << typeid(*stmt).name() << ")" << RESET << "\n";
     }
   }
 
   void visitExprStmt(const nodes::ExpressionStmtNode *node) {
     printLine("ExpressionStatement " + getLocationString(node->getLocation()));
-    withIndent([&]() { visitExpr(node->getExpression().get()); });
+    withIndent([&]() { visitExpr(node->getExpression()); });
   }
 
   void visitAttribute(const nodes::AttributeNode *node) {
     indent();
-    std::cout << "Attribute: " << node->getName();
+    out_ << "Attribute: " << node->getName();
     if (node->getArgument()) {
-      std::cout << " (";
-      visitExpr(node->getArgument().get());
-      std::cout << ")";
+      out_ << " (";
+      visitExpr(node->getArgument());
+      out_ << ")";
     }
-    std::cout << "\n";
+    out_ << "\n";
   }
 
   // Updated visitExpr to properly output assignment targets (especially
@@ -497,76 +498,70 @@ private:
       return;
     }
     // Literal expression.
-    if (auto literal =
-            dynamic_cast<const nodes::LiteralExpressionNode *>(expr)) {
+    if (auto literal = nodes::dyn_cast<nodes::LiteralExpressionNode>(expr)) {
       indent();
-      std::cout << "Literal: '" << literal->getValue() << "' "
+      out_ << "Literal: '" << literal->getValue() << "' "
                 << getLocationString(literal->getLocation()) << "\n";
     }
     // Binary expression.
-    else if (auto binary =
-                 dynamic_cast<const nodes::BinaryExpressionNode *>(expr)) {
+    else if (auto binary = nodes::dyn_cast<nodes::BinaryExpressionNode>(expr)) {
       indent();
-      std::cout << "BinaryExpression: "
+      out_ << "BinaryExpression: "
                 << tokenTypeToString(binary->getExpressionType()) << " "
                 << getLocationString(binary->getLocation()) << "\n";
       withIndent([&]() {
         printLine("Left:");
-        withIndent([&]() { visitExpr(binary->getLeft().get()); });
+        withIndent([&]() { visitExpr(binary->getLeft()); });
         printLine("Right:");
-        withIndent([&]() { visitExpr(binary->getRight().get()); });
+        withIndent([&]() { visitExpr(binary->getRight()); });
       });
     }
     // Identifier expression.
     else if (auto ident =
-                 dynamic_cast<const nodes::IdentifierExpressionNode *>(expr)) {
+                 nodes::dyn_cast<nodes::IdentifierExpressionNode>(expr)) {
       indent();
-      std::cout << "Identifier: '" << ident->getName() << "' "
+      out_ << "Identifier: '" << ident->getName() << "' "
                 << getLocationString(ident->getLocation()) << "\n";
     }
     // Member access expression.
-    else if (auto member =
-                 dynamic_cast<const nodes::MemberExpressionNode *>(expr)) {
+    else if (auto member = nodes::dyn_cast<nodes::MemberExpressionNode>(expr)) {
       indent();
-      std::cout << "MemberAccess: ";
+      out_ << "MemberAccess: ";
       // If the object is 'this', print it directly.
-      if (dynamic_cast<const nodes::ThisExpressionNode *>(
-              member->getObject().get()))
-        std::cout << "this";
+      if (nodes::dyn_cast<nodes::ThisExpressionNode>(member->getObject()))
+        out_ << "this";
       else
-        visitExpr(member->getObject().get());
-      std::cout << "." << member->getMember() << " "
+        visitExpr(member->getObject());
+      out_ << "." << member->getMember() << " "
                 << getLocationString(member->getLocation()) << "\n";
     }
     // Assignment expression.
     else if (auto assign =
-                 dynamic_cast<const nodes::AssignmentExpressionNode *>(expr)) {
+                 nodes::dyn_cast<nodes::AssignmentExpressionNode>(expr)) {
       indent();
-      std::cout << "Assignment: "
+      out_ << "Assignment: "
                 << tokenTypeToString(assign->getExpressionType()) << " "
                 << getLocationString(assign->getLocation()) << "\n";
       withIndent([&]() {
         printLine("Target:");
-        withIndent([&]() { visitExpr(assign->getTarget().get()); });
+        withIndent([&]() { visitExpr(assign->getTarget()); });
         printLine("Value:");
-        withIndent([&]() { visitExpr(assign->getValue().get()); });
+        withIndent([&]() { visitExpr(assign->getValue()); });
       });
     }
     // Unary expression.
-    else if (auto unary =
-                 dynamic_cast<const nodes::UnaryExpressionNode *>(expr)) {
+    else if (auto unary = nodes::dyn_cast<nodes::UnaryExpressionNode>(expr)) {
       visitUnaryExpr(unary);
-    } else if (auto newExpr =
-                   dynamic_cast<const nodes::NewExpressionNode *>(expr)) {
+    } else if (auto newExpr = nodes::dyn_cast<nodes::NewExpressionNode>(expr)) {
       visitNewExpr(newExpr);
     } else if (auto callExpt =
-                   dynamic_cast<const nodes::CallExpressionNode *>(expr)) {
+                   nodes::dyn_cast<nodes::CallExpressionNode>(expr)) {
       visitCallExpt(callExpt);
     }
     // Generic expression fallback.
     else {
       indent();
-      std::cout << "Expression: "
+      out_ << "Expression: "
                 << tokenTypeToString(expr->getExpressionType()) << " "
                 << getLocationString(expr->getLocation()) << "\n";
     }
@@ -578,19 +573,18 @@ private:
       return;
     }
     indent();
-    std::cout << type->toString() << "\n";
+    out_ << type->toString() << "\n";
     withIndent([&]() {
-      if (auto arrType = dynamic_cast<const nodes::ArrayTypeNode *>(type)) {
+      if (auto arrType = nodes::dyn_cast<nodes::ArrayTypeNode>(type)) {
         printLine("ElementType:");
-        withIndent([&]() { visitType(arrType->getElementType().get()); });
+        withIndent([&]() { visitType(arrType->getElementType()); });
         if (arrType->getSize()) {
           printLine("Size:");
-          withIndent([&]() { visitExpr(arrType->getSize().get()); });
+          withIndent([&]() { visitExpr(arrType->getSize()); });
         }
-      } else if (auto ptrType =
-                     dynamic_cast<const nodes::PointerTypeNode *>(type)) {
+      } else if (auto ptrType = nodes::dyn_cast<nodes::PointerTypeNode>(type)) {
         printLine("BaseType:");
-        withIndent([&]() { visitType(ptrType->getBaseType().get()); });
+        withIndent([&]() { visitType(ptrType->getBaseType()); });
       }
     });
   }
@@ -599,9 +593,9 @@ private:
     printLine("While " + getLocationString(node->getLocation()));
     withIndent([&]() {
       printLine("Condition:");
-      withIndent([&]() { visitExpr(node->getCondition().get()); });
+      withIndent([&]() { visitExpr(node->getCondition()); });
       printLine("Body:");
-      withIndent([&]() { visitStmt(node->getBody().get()); });
+      withIndent([&]() { visitStmt(node->getBody()); });
     });
   }
 
@@ -609,32 +603,32 @@ private:
     printLine("DoWhile " + getLocationString(node->getLocation()));
     withIndent([&]() {
       printLine("Body:");
-      withIndent([&]() { visitStmt(node->getBody().get()); });
+      withIndent([&]() { visitStmt(node->getBody()); });
       printLine("Condition:");
-      withIndent([&]() { visitExpr(node->getCondition().get()); });
+      withIndent([&]() { visitExpr(node->getCondition()); });
     });
   }
 
   void visitBreakStmt(const nodes::BreakStmtNode *node) {
     indent();
-    std::cout << "Break";
+    out_ << "Break";
     if (!node->getLabel().empty())
-      std::cout << " " << node->getLabel();
-    std::cout << " " << getLocationString(node->getLocation()) << "\n";
+      out_ << " " << node->getLabel();
+    out_ << " " << getLocationString(node->getLocation()) << "\n";
   }
 
   void visitContinueStmt(const nodes::ContinueStmtNode *node) {
     indent();
-    std::cout << "Continue";
+    out_ << "Continue";
     if (!node->getLabel().empty())
-      std::cout << " " << node->getLabel();
-    std::cout << " " << getLocationString(node->getLocation()) << "\n";
+      out_ << " " << node->getLabel();
+    out_ << " " << getLocationString(node->getLocation()) << "\n";
   }
 
   void visitReturnStmt(const nodes::ReturnStmtNode *node) {
     printLine("Return " + getLocationString(node->getLocation()));
     if (node->getValue()) {
-      withIndent([&]() { visitExpr(node->getValue().get()); });
+      withIndent([&]() { visitExpr(node->getValue()); });
     }
   }
 
@@ -642,12 +636,12 @@ private:
     printLine("If " + getLocationString(node->getLocation()));
     withIndent([&]() {
       printLine("Condition:");
-      withIndent([&]() { visitExpr(node->getCondition().get()); });
+      withIndent([&]() { visitExpr(node->getCondition()); });
       printLine("Then:");
-      withIndent([&]() { visitStmt(node->getThenBranch().get()); });
+      withIndent([&]() { visitStmt(node->getThenBranch()); });
       if (node->getElseBranch()) {
         printLine("Else:");
-        withIndent([&]() { visitStmt(node->getElseBranch().get()); });
+        withIndent([&]() { visitStmt(node->getElseBranch()); });
       }
     });
   }
@@ -658,39 +652,39 @@ private:
       printLine("Initializer:");
       withIndent([&]() {
         if (node->getInitializer())
-          visitStmt(node->getInitializer().get());
+          visitStmt(node->getInitializer());
         else
           printLine("<empty>");
       });
       printLine("Condition:");
       withIndent([&]() {
         if (node->getCondition())
-          visitExpr(node->getCondition().get());
+          visitExpr(node->getCondition());
         else
           printLine("<empty>");
       });
       printLine("Increment:");
       withIndent([&]() {
         if (node->getIncrement())
-          visitExpr(node->getIncrement().get());
+          visitExpr(node->getIncrement());
         else
           printLine("<empty>");
       });
       printLine("Body:");
-      withIndent([&]() { visitStmt(node->getBody().get()); });
+      withIndent([&]() { visitStmt(node->getBody()); });
     });
   }
 
   void visitArrayLiteral(const nodes::ArrayLiteralNode *node) {
     indent();
-    std::cout << "ArrayLiteral " << getLocationString(node->getLocation())
+    out_ << "ArrayLiteral " << getLocationString(node->getLocation())
               << "\n";
     indentLevel_++;
     indent();
-    std::cout << "Elements:\n";
+    out_ << "Elements:\n";
     indentLevel_++;
     for (const auto &element : node->getElements()) {
-      visitExpr(element.get());
+      visitExpr(element);
     }
     indentLevel_--;
     indentLevel_--;
@@ -698,20 +692,21 @@ private:
 
   void visitForOfStmt(const nodes::ForOfStmtNode *node) {
     indent();
-    std::cout << "ForOf " << getLocationString(node->getLocation()) << "\n";
+    out_ << (node->isParallel() ? "ForOf #parallel " : "ForOf ")
+         << getLocationString(node->getLocation()) << "\n";
     indentLevel_++;
     indent();
-    std::cout << (node->isConst() ? "const " : "let ") << node->getIdentifier()
+    out_ << (node->isConst() ? "const " : "let ") << node->getIdentifier()
               << "\n";
     indent();
-    std::cout << "Iterable:\n";
+    out_ << "Iterable:\n";
     indentLevel_++;
-    visitExpr(node->getIterable().get());
+    visitExpr(node->getIterable());
     indentLevel_--;
     indent();
-    std::cout << "Body:\n";
+    out_ << "Body:\n";
     indentLevel_++;
-    visitStmt(node->getBody().get());
+    visitStmt(node->getBody());
     indentLevel_--;
     indentLevel_--;
   }
@@ -720,21 +715,32 @@ private:
     indent();
     printLine("Assembly Statement: " + node->getCode());
     withIndent([&]() {
-      for (const auto &constraint : node->getConstraints()) {
-        printLine(constraint);
+      auto printOperands = [&](const char *label,
+                               const std::vector<nodes::AsmOperand> &operands) {
+        for (const auto &operand : operands) {
+          printLine(std::string(label) +
+                    (operand.name.empty() ? "" : " [" + operand.name + "]") +
+                    " " + operand.constraint);
+          withIndent([&]() { visitExpr(operand.expression); });
+        }
+      };
+      printOperands("Output", node->getOutputs());
+      printOperands("Input", node->getInputs());
+      for (const auto &clobber : node->getClobbers()) {
+        printLine("Clobber " + clobber);
       }
     });
   }
 
   void visitUnaryExpr(const nodes::UnaryExpressionNode *node) {
     indent();
-    std::cout << "UnaryExpression "
+    out_ << "UnaryExpression "
               << (node->isPrefix() ? "(prefix) " : "(postfix) ")
               << tokenTypeToString(node->getExpressionType()) << " "
               << getLocationString(node->getLocation()) << "\n";
     withIndent([&]() {
       printLine("Operand:");
-      withIndent([&]() { visitExpr(node->getOperand().get()); });
+      withIndent([&]() { visitExpr(node->getOperand()); });
     });
   }
   // MethodDeclNode
@@ -742,17 +748,17 @@ private:
     printLine("Declaration Statement " +
               getLocationString(node->getLocation()));
     withIndent([&]() {
-      if (auto varDecl = std::dynamic_pointer_cast<nodes::VarDeclNode>(
+      if (auto varDecl = nodes::dyn_cast<nodes::VarDeclNode>(
               node->getDeclaration()))
-        visitVarDecl(varDecl.get());
+        visitVarDecl(varDecl);
       else if (auto funcDecl =
-                   std::dynamic_pointer_cast<nodes::FunctionDeclNode>(
+                   nodes::dyn_cast<nodes::FunctionDeclNode>(
                        node->getDeclaration()))
-        visitFuncDecl(funcDecl.get());
+        visitFuncDecl(funcDecl);
       else if (auto methodDecl =
-                   std::dynamic_pointer_cast<nodes::MethodDeclNode>(
+                   nodes::dyn_cast<nodes::MethodDeclNode>(
                        node->getDeclaration()))
-        visitMethodDecl(methodDecl.get());
+        visitMethodDecl(methodDecl);
       else
         printLine("Unknown declaration type", RED);
     });
@@ -762,7 +768,7 @@ private:
     printLine("Try " + getLocationString(node->getLocation()));
     withIndent([&]() {
       printLine("Try Block:");
-      withIndent([&]() { visitStmt(node->getTryBlock().get()); });
+      withIndent([&]() { visitStmt(node->getTryBlock()); });
       const auto &catchClauses = node->getCatchClauses();
       if (!catchClauses.empty()) {
         printLine("Catch Clauses:");
@@ -772,24 +778,24 @@ private:
             if (clause.parameterType) {
               withIndent([&]() {
                 printLine("Parameter Type:");
-                withIndent([&]() { visitType(clause.parameterType.get()); });
+                withIndent([&]() { visitType(clause.parameterType); });
               });
             }
             printLine("Catch Body:");
-            withIndent([&]() { visitStmt(clause.body.get()); });
+            withIndent([&]() { visitStmt(clause.body); });
           }
         });
       }
       if (node->getFinallyBlock()) {
         printLine("Finally Block:");
-        withIndent([&]() { visitStmt(node->getFinallyBlock().get()); });
+        withIndent([&]() { visitStmt(node->getFinallyBlock()); });
       }
     });
   }
 
   void visitNewExpr(const nodes::NewExpressionNode *node) {
     indent();
-    std::cout << "NewExpression: " << node->getClassName() << " "
+    out_ << "NewExpression: " << node->getClassName() << " "
               << getLocationString(node->getLocation()) << "\n";
     withIndent([&]() {
       const auto &args = node->getArguments();
@@ -797,7 +803,7 @@ private:
         printLine("Arguments:");
         withIndent([&]() {
           for (const auto &arg : args) {
-            visitExpr(arg.get());
+            visitExpr(arg);
           }
         });
       }
@@ -806,12 +812,12 @@ private:
 
   void visitCallExpt(const nodes::CallExpressionNode *node) {
     indent();
-    if (auto identNode = dynamic_cast<nodes::IdentifierExpressionNode *>(
-            node->getCallee().get())) {
+    if (auto identNode = nodes::dyn_cast<nodes::IdentifierExpressionNode>(
+            node->getCallee())) {
       // For simple function calls like: functionName()
       std::string functionName = identNode->getName();
 
-      std::cout << "CallExpression: " << functionName << "\n";
+      out_ << "CallExpression: " << functionName << "\n";
     }
     withIndent([&]() {
       const auto &typeArgs = node->getTypeArguments();
@@ -820,7 +826,7 @@ private:
         withIndent([&]() {
           indent();
           for (const auto &typeArg : typeArgs) {
-            std::cout << typeArg << "\n";
+            out_ << typeArg << "\n";
           }
         });
       }
@@ -829,7 +835,7 @@ private:
         printLine("Arguments: ");
         withIndent([&]() {
           for (const auto &arg : args) {
-            visitExpr(arg.get());
+            visitExpr(arg);
           }
         });
       }
@@ -840,7 +846,7 @@ private:
     printLine("Switch " + getLocationString(node->getLocation()));
     withIndent([&]() {
       printLine("Expression:");
-      withIndent([&]() { visitExpr(node->getExpression().get()); });
+      withIndent([&]() { visitExpr(node->getExpression()); });
       const auto &cases = node->getCases();
       if (!cases.empty()) {
         printLine("Cases:");
@@ -852,14 +858,14 @@ private:
               printLine("Case:");
               withIndent([&]() {
                 printLine("Value:");
-                withIndent([&]() { visitExpr(caseItem.value.get()); });
+                withIndent([&]() { visitExpr(caseItem.value); });
               });
             }
             if (!caseItem.body.empty()) {
               printLine("Body:");
               withIndent([&]() {
                 for (const auto &stmt : caseItem.body) {
-                  visitStmt(stmt.get());
+                  visitStmt(stmt);
                 }
               });
             }
@@ -879,25 +885,25 @@ private:
                                                                 : "Setter"));
       if (node->getPropertyType()) {
         printLine("Property Type:");
-        withIndent([&]() { visitType(node->getPropertyType().get()); });
+        withIndent([&]() { visitType(node->getPropertyType()); });
       }
 
       if (node->getBody()) {
         printLine("Body:");
-        withIndent([&]() { visitBlock(node->getBody().get()); });
+        withIndent([&]() { visitBlock(node->getBody()); });
       }
     });
   }
 
   void visitThrowStmt(const nodes::ThrowStmtNode *node) {
     printLine("Throw " + getLocationString(node->getLocation()));
-    withIndent([&]() { visitExpr(node->getValue().get()); });
+    withIndent([&]() { visitExpr(node->getValue()); });
   }
 
   void visitLabeledStmt(const nodes::LabeledStatementNode *node) {
     printLine("Labeled Statement: " + node->getLabel() + " " +
               getLocationString(node->getLocation()));
-    withIndent([&]() { visitStmt(node->getStatement().get()); });
+    withIndent([&]() { visitStmt(node->getStatement()); });
   }
 
   void visitMethodSignature(const nodes::MethodSignatureNode *node) {
@@ -912,20 +918,20 @@ private:
         printLine("Parameters:");
         withIndent([&]() {
           for (const auto &param : parameters)
-            visitParameter(param.get());
+            visitParameter(param);
         });
       }
 
       if (node->getReturnType()) {
         printLine("Return Type:");
-        withIndent([&]() { visitType(node->getReturnType().get()); });
+        withIndent([&]() { visitType(node->getReturnType()); });
       }
 
       if (!node->getThrowsTypes().empty()) {
         printLine("Throws:");
         withIndent([&]() {
           for (const auto &throwType : node->getThrowsTypes())
-            visitType(throwType.get());
+            visitType(throwType);
         });
       }
     });
@@ -940,7 +946,7 @@ private:
 
       if (node->getType()) {
         printLine("Type:");
-        withIndent([&]() { visitType(node->getType().get()); });
+        withIndent([&]() { visitType(node->getType()); });
       }
 
       if (node->hasGetter())
@@ -969,6 +975,13 @@ private:
     });
   }
 
+public:
+  // Writes to out through a buffer; the output is complete once the
+  // printer is destroyed or flushed
+  explicit ASTPrinter(std::ostream &out = std::cout) : out_(out) {}
+
+  void flush() { out_.flush(); }
+
   //---------------------------------------------------------------------------
   // Utility Functions
   //---------------------------------------------------------------------------
@@ -1009,12 +1022,16 @@ private:
       return "%";
     case tokens::TokenType::OF:
       return "of";
+    case tokens::TokenType::AWAIT:
+      return "await";
     case tokens::TokenType::STACK:
       return "#stack";
     case tokens::TokenType::HEAP:
       return "#heap";
     case tokens::TokenType::STATIC:
       return "#static";
+    case tokens::TokenType::COMPTIME:
+      return "#comptime";
     case tokens::TokenType::INT:
       return "int";
     case tokens::TokenType::FLOAT:
@@ -1039,12 +1056,22 @@ private:
       return "#unsafe";
     case tokens::TokenType::SIMD:
       return "#simd";
+    case tokens::TokenType::TAILCALL:
+      return "#tailcall";
+    case tokens::TokenType::COLD:
+      return "#cold";
+    case tokens::TokenType::NOALIAS:
+      return "#noalias";
+    case tokens::TokenType::BENCH:
+      return "#bench";
     case tokens::TokenType::PACKED:
       return "#packed";
     case tokens::TokenType::ABSTRACT:
       return "#abstract";
     case tokens::TokenType::ALIGNED:
       return "#aligned";
+    case tokens::TokenType::SOA:
+      return "#soa";
     default:
       return std::to_string(static_cast<int>(type));
     }
@@ -1060,73 +1087,69 @@ private:
       return "#unsafe";
     case tokens::TokenType::SIMD:
       return "#simd";
+    case tokens::TokenType::TAILCALL:
+      return "#tailcall";
+    case tokens::TokenType::COLD:
+      return "#cold";
+    case tokens::TokenType::NOALIAS:
+      return "#noalias";
+    case tokens::TokenType::BENCH:
+      return "#bench";
     default:
       return "unknown";
     }
   }
 
-public:
   void print(const parser::AST &ast) {
-    std::cout << "\nAbstract Syntax Tree:\n" << std::string(80, '-') << "\n";
+    out_ << "\nAbstract Syntax Tree:\n" << std::string(80, '-') << "\n";
     const auto &nodes = ast.getNodes();
     if (nodes.empty()) {
       printLine("Empty AST", RED);
       return;
     }
     for (const auto &node : nodes) {
-      if (auto classDecl =
-              std::dynamic_pointer_cast<nodes::ClassDeclNode>(node))
-        visitClassDecl(classDecl.get());
-      else if (auto methodDecl =
-                   std::dynamic_pointer_cast<nodes::MethodDeclNode>(node))
-        visitMethodDecl(methodDecl.get());
+      if (auto classDecl = nodes::dyn_cast<nodes::ClassDeclNode>(node))
+        visitClassDecl(classDecl);
+      else if (auto methodDecl = nodes::dyn_cast<nodes::MethodDeclNode>(node))
+        visitMethodDecl(methodDecl);
       else if (auto ctorDecl =
-                   std::dynamic_pointer_cast<nodes::ConstructorDeclNode>(node))
-        visitConstructorDecl(ctorDecl.get());
-      else if (auto fieldDecl =
-                   std::dynamic_pointer_cast<nodes::FieldDeclNode>(node))
-        visitFieldDecl(fieldDecl.get());
-      else if (auto funcDecl =
-                   std::dynamic_pointer_cast<nodes::FunctionDeclNode>(node))
-        visitFuncDecl(funcDecl.get());
-      else if (auto varDecl =
-                   std::dynamic_pointer_cast<nodes::VarDeclNode>(node))
-        visitVarDecl(varDecl.get());
-      else if (auto stmt =
-                   std::dynamic_pointer_cast<nodes::StatementNode>(node))
-        visitStmt(stmt.get());
-      else if (auto exprStmt =
-                   std::dynamic_pointer_cast<nodes::ExpressionStmtNode>(node))
-        visitExprStmt(exprStmt.get());
-      else if (auto expr =
-                   std::dynamic_pointer_cast<nodes::ExpressionNode>(node))
-        visitExpr(expr.get());
-      else if (auto throwStmt =
-                   std::dynamic_pointer_cast<nodes::ThrowStmtNode>(node))
-        visitThrowStmt(throwStmt.get());
+                   nodes::dyn_cast<nodes::ConstructorDeclNode>(node))
+        visitConstructorDecl(ctorDecl);
+      else if (auto fieldDecl = nodes::dyn_cast<nodes::FieldDeclNode>(node))
+        visitFieldDecl(fieldDecl);
+      else if (auto funcDecl = nodes::dyn_cast<nodes::FunctionDeclNode>(node))
+        visitFuncDecl(funcDecl);
+      else if (auto varDecl = nodes::dyn_cast<nodes::VarDeclNode>(node))
+        visitVarDecl(varDecl);
+      else if (auto stmt = nodes::dyn_cast<nodes::StatementNode>(node))
+        visitStmt(stmt);
+      else if (auto exprStmt = nodes::dyn_cast<nodes::ExpressionStmtNode>(node))
+        visitExprStmt(exprStmt);
+      else if (auto expr = nodes::dyn_cast<nodes::ExpressionNode>(node))
+        visitExpr(expr);
+      else if (auto throwStmt = nodes::dyn_cast<nodes::ThrowStmtNode>(node))
+        visitThrowStmt(throwStmt);
       else if (auto propertyDecl =
-                   std::dynamic_pointer_cast<nodes::PropertyDeclNode>(node))
-        visitPropertyDecl(propertyDecl.get());
-      else if (auto enumDecl =
-                   std::dynamic_pointer_cast<nodes::EnumDeclNode>(node))
-        visitEnumDecl(enumDecl.get());
+                   nodes::dyn_cast<nodes::PropertyDeclNode>(node))
+        visitPropertyDecl(propertyDecl);
+      else if (auto enumDecl = nodes::dyn_cast<nodes::EnumDeclNode>(node))
+        visitEnumDecl(enumDecl);
       else if (auto interfaceDecl =
-                   std::dynamic_pointer_cast<nodes::InterfaceDeclNode>(node))
-        visitInterfaceDecl(interfaceDecl.get());
-      else if (auto typedefDecl =
-                   std::dynamic_pointer_cast<nodes::TypedefDeclNode>(node))
-        visitTypedefDecl(typedefDecl.get());
+                   nodes::dyn_cast<nodes::InterfaceDeclNode>(node))
+        visitInterfaceDecl(interfaceDecl);
+      else if (auto typedefDecl = nodes::dyn_cast<nodes::TypedefDeclNode>(node))
+        visitTypedefDecl(typedefDecl);
       else if (auto namespaceDecl =
-                   std::dynamic_pointer_cast<nodes::NamespaceDeclNode>(node))
-        visitNamespaceDecl(namespaceDecl.get());
+                   nodes::dyn_cast<nodes::NamespaceDeclNode>(node))
+        visitNamespaceDecl(namespaceDecl);
       else {
         indent();
-        std::cout << RED << "Unknown node type at gfgfgf"
+        out_ << RED << "Unknown node type at gfgfgf"
                   << node->getLocation().getLine() << ":"
                   << node->getLocation().getColumn() << RESET << "\n";
       }
     }
-    std::cout << std::string(80, '-') << "\n";
+    out_ << std::string(80, '-') << "\n";
   }
 
   void print(const nodes::NodePtr &node) {
@@ -1134,87 +1157,68 @@ public:
       printLine("nullptr", RED);
       return;
     }
-    if (auto classDecl = std::dynamic_pointer_cast<nodes::ClassDeclNode>(node))
-      visitClassDecl(classDecl.get());
-    else if (auto methodDecl =
-                 std::dynamic_pointer_cast<nodes::MethodDeclNode>(node))
-      visitMethodDecl(methodDecl.get());
-    else if (auto ctorDecl =
-                 std::dynamic_pointer_cast<nodes::ConstructorDeclNode>(node))
-      visitConstructorDecl(ctorDecl.get());
-    else if (auto fieldDecl =
-                 std::dynamic_pointer_cast<nodes::FieldDeclNode>(node))
-      visitFieldDecl(fieldDecl.get());
+    if (auto classDecl = nodes::dyn_cast<nodes::ClassDeclNode>(node))
+      visitClassDecl(classDecl);
+    else if (auto methodDecl = nodes::dyn_cast<nodes::MethodDeclNode>(node))
+      visitMethodDecl(methodDecl);
+    else if (auto ctorDecl = nodes::dyn_cast<nodes::ConstructorDeclNode>(node))
+      visitConstructorDecl(ctorDecl);
+    else if (auto fieldDecl = nodes::dyn_cast<nodes::FieldDeclNode>(node))
+      visitFieldDecl(fieldDecl);
     else if (auto genericFunc =
-                 std::dynamic_pointer_cast<nodes::GenericFunctionDeclNode>(
-                     node))
-      visitFuncDecl(genericFunc.get());
-    else if (auto funcDecl =
-                 std::dynamic_pointer_cast<nodes::FunctionDeclNode>(node))
-      visitFuncDecl(funcDecl.get());
-    else if (auto varDecl = std::dynamic_pointer_cast<nodes::VarDeclNode>(node))
-      visitVarDecl(varDecl.get());
-    else if (auto blockStmt = std::dynamic_pointer_cast<nodes::BlockNode>(node))
-      visitBlock(blockStmt.get());
-    else if (auto ifStmt = std::dynamic_pointer_cast<nodes::IfStmtNode>(node))
-      visitIfStmt(ifStmt.get());
-    else if (auto whileStmt =
-                 std::dynamic_pointer_cast<nodes::WhileStmtNode>(node))
-      visitWhileStmt(whileStmt.get());
-    else if (auto doWhileStmt =
-                 std::dynamic_pointer_cast<nodes::DoWhileStmtNode>(node))
-      visitDoWhileStmt(doWhileStmt.get());
-    else if (auto forStmt = std::dynamic_pointer_cast<nodes::ForStmtNode>(node))
-      visitForStmt(forStmt.get());
-    else if (auto forOfStmt =
-                 std::dynamic_pointer_cast<nodes::ForOfStmtNode>(node))
-      visitForOfStmt(forOfStmt.get());
-    else if (auto breakStmt =
-                 std::dynamic_pointer_cast<nodes::BreakStmtNode>(node))
-      visitBreakStmt(breakStmt.get());
-    else if (auto continueStmt =
-                 std::dynamic_pointer_cast<nodes::ContinueStmtNode>(node))
-      visitContinueStmt(continueStmt.get());
-    else if (auto returnStmt =
-                 std::dynamic_pointer_cast<nodes::ReturnStmtNode>(node))
-      visitReturnStmt(returnStmt.get());
-    else if (auto exprStmt =
-                 std::dynamic_pointer_cast<nodes::ExpressionStmtNode>(node))
-      visitExprStmt(exprStmt.get());
-    else if (auto expr = std::dynamic_pointer_cast<nodes::ExpressionNode>(node))
-      visitExpr(expr.get());
-    else if (auto tryStmt = std::dynamic_pointer_cast<nodes::TryStmtNode>(node))
-      visitTryStmt(tryStmt.get());
-    else if (auto propertyDecl =
-                 std::dynamic_pointer_cast<nodes::PropertyDeclNode>(node))
-      visitPropertyDecl(propertyDecl.get());
-    else if (auto propertyDecl =
-                 std::dynamic_pointer_cast<nodes::PropertyDeclNode>(node))
-      visitPropertyDecl(propertyDecl.get());
+                 nodes::dyn_cast<nodes::GenericFunctionDeclNode>(node))
+      visitFuncDecl(genericFunc);
+    else if (auto funcDecl = nodes::dyn_cast<nodes::FunctionDeclNode>(node))
+      visitFuncDecl(funcDecl);
+    else if (auto varDecl = nodes::dyn_cast<nodes::VarDeclNode>(node))
+      visitVarDecl(varDecl);
+    else if (auto blockStmt = nodes::dyn_cast<nodes::BlockNode>(node))
+      visitBlock(blockStmt);
+    else if (auto ifStmt = nodes::dyn_cast<nodes::IfStmtNode>(node))
+      visitIfStmt(ifStmt);
+    else if (auto whileStmt = nodes::dyn_cast<nodes::WhileStmtNode>(node))
+      visitWhileStmt(whileStmt);
+    else if (auto doWhileStmt = nodes::dyn_cast<nodes::DoWhileStmtNode>(node))
+      visitDoWhileStmt(doWhileStmt);
+    else if (auto forStmt = nodes::dyn_cast<nodes::ForStmtNode>(node))
+      visitForStmt(forStmt);
+    else if (auto forOfStmt = nodes::dyn_cast<nodes::ForOfStmtNode>(node))
+      visitForOfStmt(forOfStmt);
+    else if (auto breakStmt = nodes::dyn_cast<nodes::BreakStmtNode>(node))
+      visitBreakStmt(breakStmt);
+    else if (auto continueStmt = nodes::dyn_cast<nodes::ContinueStmtNode>(node))
+      visitContinueStmt(continueStmt);
+    else if (auto returnStmt = nodes::dyn_cast<nodes::ReturnStmtNode>(node))
+      visitReturnStmt(returnStmt);
+    else if (auto exprStmt = nodes::dyn_cast<nodes::ExpressionStmtNode>(node))
+      visitExprStmt(exprStmt);
+    else if (auto expr = nodes::dyn_cast<nodes::ExpressionNode>(node))
+      visitExpr(expr);
+    else if (auto tryStmt = nodes::dyn_cast<nodes::TryStmtNode>(node))
+      visitTryStmt(tryStmt);
+    else if (auto propertyDecl = nodes::dyn_cast<nodes::PropertyDeclNode>(node))
+      visitPropertyDecl(propertyDecl);
+    else if (auto propertyDecl = nodes::dyn_cast<nodes::PropertyDeclNode>(node))
+      visitPropertyDecl(propertyDecl);
     // Add to your print method for NodePtr
-    else if (auto methodSig =
-                 std::dynamic_pointer_cast<nodes::MethodSignatureNode>(node))
-      visitMethodSignature(methodSig.get());
-    else if (auto propSig =
-                 std::dynamic_pointer_cast<nodes::PropertySignatureNode>(node))
-      visitPropertySignature(propSig.get());
+    else if (auto methodSig = nodes::dyn_cast<nodes::MethodSignatureNode>(node))
+      visitMethodSignature(methodSig);
+    else if (auto propSig = nodes::dyn_cast<nodes::PropertySignatureNode>(node))
+      visitPropertySignature(propSig);
 
     // Add to your print method for AST nodes too
-    else if (auto methodSig =
-                 std::dynamic_pointer_cast<nodes::MethodSignatureNode>(node))
-      visitMethodSignature(methodSig.get());
-    else if (auto propSig =
-                 std::dynamic_pointer_cast<nodes::PropertySignatureNode>(node))
-      visitPropertySignature(propSig.get());
-    else if (auto typedefDecl =
-                 std::dynamic_pointer_cast<nodes::TypedefDeclNode>(node))
-      visitTypedefDecl(typedefDecl.get());
+    else if (auto methodSig = nodes::dyn_cast<nodes::MethodSignatureNode>(node))
+      visitMethodSignature(methodSig);
+    else if (auto propSig = nodes::dyn_cast<nodes::PropertySignatureNode>(node))
+      visitPropertySignature(propSig);
+    else if (auto typedefDecl = nodes::dyn_cast<nodes::TypedefDeclNode>(node))
+      visitTypedefDecl(typedefDecl);
     else if (auto namespaceDecl =
-                 std::dynamic_pointer_cast<nodes::NamespaceDeclNode>(node))
-      visitNamespaceDecl(namespaceDecl.get());
+                 nodes::dyn_cast<nodes::NamespaceDeclNode>(node))
+      visitNamespaceDecl(namespaceDecl);
     else {
       indent();
-      std::cout << RED << "Unknown node type at "
+      out_ << RED << "Unknown node type at "
                 << node->getLocation().getLine() << ":"
                 << node->getLocation().getColumn() << RESET << "\n";
     }
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/SHA1.h"
+#include <cstdint>
+#include <string>
+
+/**
+ * Pieces of the SHA-1 keys of the compilation cache, the dependency
+ * graph's declaration hashes and the JIT object cache, kept in one place
+ * so that the keys cannot drift apart. Header-only, as core does not link
+ * LLVM; each user does.
+ */
+namespace core::utils {
+
+/**
+ * @brief Feeds a length-prefixed field, so that no two sequences of fields
+ * hash the same bytes
+ */
+inline void addKeyField(llvm::SHA1 &hasher, llvm::StringRef field) {
+  std::uint64_t size = field.size();
+  hasher.update(llvm::StringRef(reinterpret_cast<const char *>(&size),
+                                sizeof(size)));
+  hasher.update(field);
+}
+
+/**
+ * @brief Feeds the size and modification time of the running compiler,
+ * as a rebuilt compiler may generate different code at the same version
+ * @return false if the executable cannot be found, when nothing may be
+ *         cached
+ */
+inline bool addCompilerStamp(llvm::SHA1 &hasher) {
+  std::string executable = llvm::sys::fs::getMainExecutable(nullptr, nullptr);
+  llvm::sys::fs::file_status status;
+  if (executable.empty() || llvm::sys::fs::status(executable, status)) {
+    return false;
+  }
+  addKeyField(hasher, std::to_string(status.getSize()) + " " +
+                          std::to_string(status.getLastModificationTime()
+                                             .time_since_epoch()
+                                             .count()));
+  return true;
+}
+
+} // namespace core::utils
@@ -1,4 +1,5 @@
 #include "file_utils.h"
+#include <algorithm>
 #include <filesystem>
 #include <fstream>
 #include <sstream>
@@ -21,6 +22,10 @@ std::optional<String> FileUtils::readFile(const String &path) {
   return buffer.str();
 }
 
+std::unique_ptr<SourceBuffer> FileUtils::openSource(const String &path) {
+  return SourceBuffer::fromFile(path);
+}
+
 bool FileUtils::writeFile(const String &path, const String &content) {
   // Open file in output mode
   std::ofstream file(path);
@@ -50,6 +55,26 @@ String FileUtils::getExtension(const String &path) {
   return pos == String::npos ? "" : path.substr(pos + 1);
 }
 
+bool FileUtils::isDirectory(const String &path) {
+  std::error_code error;
+  return std::filesystem::is_directory(path, error);
+}
+
+std::vector<String> FileUtils::listFiles(const String &path,
+                                         const String &extension) {
+  std::vector<String> files;
+  std::error_code error;
+  for (std::filesystem::recursive_directory_iterator it(path, error), end;
+       !error && it != end; it.increment(error)) {
+    if (it->is_regular_file(error) &&
+        it->path().extension() == "." + extension) {
+      files.push_back(it->path().string());
+    }
+  }
+  std::sort(files.begin(), files.end());
+  return files;
+}
+
 bool FileUtils::createDirectories(const String &path) {
   // Create directories recursively
   return std::filesystem::create_directories(path);
@@ -1,7 +1,10 @@
 #pragma once
 
 #include "../common/common_types.h"
+#include "../common/source_buffer.h"
+#include <memory>
 #include <optional>
+#include <vector>
 
 namespace core::utils {
 
@@ -23,6 +26,15 @@ public:
    */
   static std::optional<String> readFile(const String &path);
 
+  /**
+   * @brief Opens a file as a source buffer without copying its contents
+   * @param path Path to the file to open
+   * @return Memory-mapped buffer (or a read copy where mapping is not
+   *         available), or nullptr if the file can't be read
+   * @throws None
+   */
+  static std::unique_ptr<SourceBuffer> openSource(const String &path);
+
   /**
    * @brief Writes string content to a file
    * @param path Path to the file to write
@@ -49,6 +61,24 @@ public:
    */
   static String getExtension(const String &path);
 
+  /**
+   * @brief Checks if a path names a directory
+   * @param path Path to check
+   * @return True if the path exists and is a directory
+   * @throws None
+   */
+  static bool isDirectory(const String &path);
+
+  /**
+   * @brief Lists the files under a directory that have an extension
+   * @param path Directory to search, including its subdirectories
+   * @param extension Extension to match, without the dot
+   * @return Paths of the matching files, sorted so the order is stable
+   * @throws None
+   */
+  static std::vector<String> listFiles(const String &path,
+                                       const String &extension);
+
   // Directory Management
   /**
    * @brief Creates directories recursively at the specified path
@@ -1,46 +1,91 @@
 #include "core/utils/log_utils.h"
+#include "ast_json_writer.h"
 #include "ast_printer.h"
 #include "lexer/patterns/token_maps.h"
-#include <iomanip>
+#include "output_buffer.h"
 
-void printToken(const tokens::Token &token) {
-  std::cout << "Token{type=" << static_cast<int>(token.getType())
-            << ", category=\""
-            << lexer::TokenMapUtils::getTokenCategory(token.getType()) << "\""
-            << ", lexeme=\"" << token.getLexeme() << "\""
-            << ", line=" << token.getLocation().getLine()
-            << ", column=" << token.getLocation().getColumn();
-
-  if (const auto &filename = token.getLocation().getFilename();
-      !filename.empty()) {
-    std::cout << ", file=\"" << filename << "\"";
+namespace {
+
+using core::utils::OutputBuffer;
+
+void writeToken(OutputBuffer &out, const tokens::Token &token) {
+  core::SourceLocation location = token.getLocation();
+  out << "Token{type=" << static_cast<int>(token.getType())
+      << ", category=\""
+      << lexer::TokenMapUtils::getTokenCategory(token.getType()) << "\""
+      << ", lexeme=\"" << token.getLexeme() << "\""
+      << ", line=" << location.getLine()
+      << ", column=" << location.getColumn();
+
+  if (const auto &filename = location.getFilename(); !filename.empty()) {
+    out << ", file=\"" << filename << "\"";
   }
 
-  if (token.getErrorMessage()) {
-    std::cout << ", error=\"" << *token.getErrorMessage() << "\"";
+  if (auto error = token.getErrorMessage()) {
+    out << ", error=\"" << *error << "\"";
   }
 
-  std::cout << "}\n";
+  out << "}\n";
 }
 
-void printTokenStream(const std::vector<tokens::Token> &tokens) {
-  std::cout << "Token Stream:\n" << std::string(80, '-') << "\n";
+// One object per line, with the fields of the pretty format
+void writeTokenLine(OutputBuffer &out, const tokens::Token &token) {
+  core::SourceLocation location = token.getLocation();
+  out << "{\"type\":" << static_cast<int>(token.getType())
+      << ",\"category\":";
+  out.writeJSONString(lexer::TokenMapUtils::getTokenCategory(token.getType()));
+  out << ",\"lexeme\":";
+  out.writeJSONString(token.getLexeme());
+  out << ",\"line\":" << location.getLine()
+      << ",\"column\":" << location.getColumn();
+  if (auto error = token.getErrorMessage()) {
+    out << ",\"error\":";
+    out.writeJSONString(*error);
+  }
+  out << "}\n";
+}
 
-  for (size_t i = 0; i < tokens.size(); ++i) {
-    std::cout << std::setw(4) << i << ": ";
-    printToken(tokens[i]);
+} // namespace
+
+void printToken(const tokens::Token &token) {
+  OutputBuffer out(std::cout);
+  writeToken(out, token);
+}
+
+void printTokenStream(const std::vector<tokens::Token> &tokens,
+                      std::ostream &stream, DumpFormat format) {
+  OutputBuffer out(stream);
+  if (format == DumpFormat::JSONLines) {
+    for (const auto &token : tokens) {
+      writeTokenLine(out, token);
+    }
+    return;
   }
 
-  std::cout << std::string(80, '-') << "\n"
-            << "Total tokens: " << tokens.size() << "\n";
+  out << "Token Stream:\n";
+  out.write(std::string(80, '-'));
+  out << "\n";
+  for (size_t i = 0; i < tokens.size(); ++i) {
+    // Right-aligned in four columns, as std::setw(4) would
+    std::string index = std::to_string(i);
+    out.spaces(index.size() < 4 ? 4 - index.size() : 0);
+    out << index << ": ";
+    writeToken(out, tokens[i]);
+  }
+  out.write(std::string(80, '-'));
+  out << "\nTotal tokens: " << tokens.size() << "\n";
 }
 
-void printAST(const parser::AST &ast) {
-  core::ASTPrinter printer;
+void printAST(const parser::AST &ast, std::ostream &out, DumpFormat format) {
+  if (format == DumpFormat::JSONLines) {
+    core::ASTJSONWriter(out).write(ast);
+    return;
+  }
+  core::ASTPrinter printer(out);
   printer.print(ast);
 }
 
 void printASTNode(const nodes::NodePtr &node, int indent) {
   core::ASTPrinter printer;
   printer.print(node);
-}
\ No newline at end of file
+}
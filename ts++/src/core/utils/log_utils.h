@@ -1,8 +1,17 @@
 #pragma once
 #include "tokens/tokens.h"
 #include "parser/ast.h"
+#include <iostream>
 #include <vector>
 
+/**
+ * @brief Layout of token and AST dumps
+ *
+ * Pretty is for people. JSONLines writes one JSON object per token or
+ * node, for tools; see core::ASTJSONWriter for the AST records.
+ */
+enum class DumpFormat { Pretty, JSONLines };
+
 /**
  * @brief Prints details of a single token to the console
  * @param token Token to print
@@ -11,11 +20,15 @@
 void printToken(const tokens::Token &token);
 
 /**
- * @brief Prints the entire token stream to the console
+ * @brief Prints the entire token stream, buffered
  * @param tokens Token vector to print
+ * @param out Stream to write to
+ * @param format Layout of the dump
  * @throws None
  */
-void printTokenStream(const std::vector<tokens::Token> &tokens);
+void printTokenStream(const std::vector<tokens::Token> &tokens,
+                      std::ostream &out = std::cout,
+                      DumpFormat format = DumpFormat::Pretty);
 
 /**
  * @brief Prints AST node with indentation and detailed info
@@ -25,7 +38,10 @@ void printTokenStream(const std::vector<tokens::Token> &tokens);
 void printASTNode(const nodes::NodePtr& node, int indent = 0);
 
 /**
- * @brief Prints the entire AST structure
+ * @brief Prints the entire AST structure, buffered
  * @param ast Abstract Syntax Tree to print
+ * @param out Stream to write to
+ * @param format Layout of the dump
  */
-void printAST(const parser::AST& ast);
\ No newline at end of file
+void printAST(const parser::AST &ast, std::ostream &out = std::cout,
+              DumpFormat format = DumpFormat::Pretty);
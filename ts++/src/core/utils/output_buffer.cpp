@@ -0,0 +1,66 @@
+#include "output_buffer.h"
+#include <charconv>
+#include <cstdio>
+
+namespace core::utils {
+
+OutputBuffer::OutputBuffer(std::ostream &out, size_t chunkSize)
+    : out_(out), chunkSize_(chunkSize) {
+  // Room for a chunk and the piece that overflows it
+  buffer_.reserve(chunkSize_ + chunkSize_ / 4);
+}
+
+void OutputBuffer::writeNumber(long long value) {
+  char digits[24];
+  auto result = std::to_chars(digits, digits + sizeof(digits), value);
+  write(std::string_view(digits, result.ptr - digits));
+}
+
+void OutputBuffer::writeUnsigned(unsigned long long value) {
+  char digits[24];
+  auto result = std::to_chars(digits, digits + sizeof(digits), value);
+  write(std::string_view(digits, result.ptr - digits));
+}
+
+void OutputBuffer::writeJSONString(std::string_view text) {
+  buffer_.push_back('"');
+  for (char c : text) {
+    switch (c) {
+    case '"':
+      buffer_ += "\\\"";
+      break;
+    case '\\':
+      buffer_ += "\\\\";
+      break;
+    case '\n':
+      buffer_ += "\\n";
+      break;
+    case '\r':
+      buffer_ += "\\r";
+      break;
+    case '\t':
+      buffer_ += "\\t";
+      break;
+    default:
+      if (static_cast<unsigned char>(c) < 0x20) {
+        char escaped[8];
+        std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+        buffer_ += escaped;
+      } else {
+        buffer_.push_back(c);
+      }
+    }
+  }
+  buffer_.push_back('"');
+  flushIfFull();
+}
+
+void OutputBuffer::flush() {
+  if (!buffer_.empty()) {
+    out_.write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+    buffer_.clear();
+  }
+  out_.flush();
+}
+
+} // namespace core::utils
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "../common/macros.h"
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace core::utils {
+
+/**
+ * @class OutputBuffer
+ * @brief Collects output in one large buffer and writes it in chunks
+ *
+ * Dumps of large token streams and ASTs are made of many short pieces.
+ * Streaming each piece through std::cout costs more than formatting it,
+ * so pieces are appended to a buffer that is handed to the stream only
+ * once it holds a chunk, and when the buffer is flushed or destroyed.
+ * Numbers are formatted with std::to_chars and indentation is written
+ * without building strings.
+ */
+class OutputBuffer {
+public:
+  NON_COPYABLE(OutputBuffer);
+
+  static constexpr size_t kChunkSize = 256 * 1024;
+
+  explicit OutputBuffer(std::ostream &out, size_t chunkSize = kChunkSize);
+  ~OutputBuffer() { flush(); }
+
+  void write(std::string_view text) {
+    buffer_.append(text.data(), text.size());
+    flushIfFull();
+  }
+
+  void put(char c) {
+    buffer_.push_back(c);
+    flushIfFull();
+  }
+
+  // Writes count spaces
+  void spaces(size_t count) {
+    buffer_.append(count, ' ');
+    flushIfFull();
+  }
+
+  void writeNumber(long long value);
+  void writeUnsigned(unsigned long long value);
+
+  // Writes text as a quoted JSON string
+  void writeJSONString(std::string_view text);
+
+  OutputBuffer &operator<<(std::string_view text) {
+    write(text);
+    return *this;
+  }
+  OutputBuffer &operator<<(const char *text) {
+    write(text);
+    return *this;
+  }
+  OutputBuffer &operator<<(const std::string &text) {
+    write(text);
+    return *this;
+  }
+  OutputBuffer &operator<<(char c) {
+    put(c);
+    return *this;
+  }
+  template <typename T,
+            typename = std::enable_if_t<std::is_integral_v<T> &&
+                                        !std::is_same_v<T, char> &&
+                                        !std::is_same_v<T, bool>>>
+  OutputBuffer &operator<<(T value) {
+    if constexpr (std::is_signed_v<T>) {
+      writeNumber(value);
+    } else {
+      writeUnsigned(value);
+    }
+    return *this;
+  }
+
+  // Hands what is buffered to the stream
+  void flush();
+
+private:
+  void flushIfFull() {
+    if (buffer_.size() >= chunkSize_) {
+      flush();
+    }
+  }
+
+  std::ostream &out_;
+  size_t chunkSize_;
+  std::string buffer_;
+};
+
+} // namespace core::utils
@@ -0,0 +1,153 @@
+#include "driver/benchmark.h"
+#include "parser/nodes/declaration_nodes.h"
+#include "parser/nodes/statement_nodes.h"
+#include "runtime/tspp_runtime.h"
+#include "llvm/Support/FormatVariadic.h"
+#include "llvm/Support/JSON.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+
+namespace driver {
+
+namespace {
+
+// Calibration stops growing the batch past this many calls
+constexpr uint64_t kMaxIterations = uint64_t(1) << 40;
+
+// Nanoseconds taken by count calls in a row
+double timeCalls(void (*function)(), uint64_t count) {
+  auto start = std::chrono::steady_clock::now();
+  for (uint64_t i = 0; i < count; ++i) {
+    function();
+  }
+  return std::chrono::duration<double, std::nano>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+} // namespace
+
+std::vector<std::string>
+BenchmarkRunner::findBenchmarks(const parser::AST &ast) {
+  std::vector<std::string> names;
+  for (nodes::NodePtr node : ast.getNodes()) {
+    if (auto stmt = nodes::dyn_cast<nodes::DeclarationStmtNode>(node)) {
+      node = stmt->getDeclaration();
+    }
+    auto function = nodes::dyn_cast<nodes::FunctionDeclNode>(node);
+    if (!function) {
+      continue;
+    }
+    const auto &modifiers = function->getModifiers();
+    if (std::find(modifiers.begin(), modifiers.end(),
+                  tokens::TokenType::BENCH) != modifiers.end()) {
+      names.push_back(function->getName());
+    }
+  }
+  return names;
+}
+
+bool BenchmarkRunner::run(codegen::LLVMParallelCodeGen &codeGen,
+                          const std::vector<std::string> &names,
+                          std::vector<BenchmarkResult> &results) {
+  if (!codeGen.loadForExecution()) {
+    return false;
+  }
+  for (const auto &name : names) {
+    uint64_t address = codeGen.getExecutionAddress(name);
+    if (!address) {
+      std::cerr << "Error: Could not compile benchmark: " << name << "\n";
+      return false;
+    }
+    results.push_back(
+        measure(name, reinterpret_cast<void (*)()>(address)));
+  }
+  tspp_flush();
+  return true;
+}
+
+BenchmarkResult BenchmarkRunner::measure(const std::string &name,
+                                         void (*function)()) {
+  BenchmarkResult result;
+  result.name = name;
+  unsigned samples = std::max(options_.samples, 1u);
+  double sampleNs = options_.timeMs * 1e6 / samples;
+
+  // The first call compiles the function and warms the caches
+  function();
+
+  // Each step aims a little past a sample's time from the last batch's
+  // rate, growing at most a hundredfold so one slow call does not mislead
+  uint64_t iterations = 1;
+  double elapsed = timeCalls(function, iterations);
+  while (elapsed < sampleNs && iterations < kMaxIterations) {
+    double scale = elapsed > 0 ? sampleNs * 1.2 / elapsed : 100.0;
+    auto next = static_cast<uint64_t>(iterations * std::min(scale, 100.0));
+    iterations = std::min(std::max(next, iterations + 1), kMaxIterations);
+    elapsed = timeCalls(function, iterations);
+  }
+
+  std::vector<double> perOp;
+  uint64_t allocations = tspp_alloc_count();
+  for (unsigned i = 0; i < samples; ++i) {
+    perOp.push_back(timeCalls(function, iterations) / iterations);
+  }
+  allocations = tspp_alloc_count() - allocations;
+
+  double sum = 0;
+  for (double ns : perOp) {
+    sum += ns;
+  }
+  double mean = sum / samples;
+  double squares = 0;
+  for (double ns : perOp) {
+    squares += (ns - mean) * (ns - mean);
+  }
+
+  result.iterations = iterations;
+  result.nsPerOp = mean;
+  result.stddevNs = samples > 1 ? std::sqrt(squares / (samples - 1)) : 0;
+  result.allocsPerOp =
+      static_cast<double>(allocations) / (double(iterations) * samples);
+  return result;
+}
+
+void BenchmarkRunner::print(const std::vector<BenchmarkResult> &results,
+                            std::ostream &out, bool json) {
+  if (json) {
+    llvm::json::Array array;
+    for (const auto &result : results) {
+      array.push_back(
+          llvm::json::Object{{"name", result.name},
+                             {"iterations", int64_t(result.iterations)},
+                             {"ns_per_op", result.nsPerOp},
+                             {"stddev_ns", result.stddevNs},
+                             {"allocs_per_op", result.allocsPerOp}});
+    }
+    llvm::json::Object report{{"benchmarks", std::move(array)}};
+    out << llvm::formatv("{0:2}", llvm::json::Value(std::move(report))).str()
+        << "\n";
+    return;
+  }
+
+  size_t width = 9; // "Benchmark"
+  for (const auto &result : results) {
+    width = std::max(width, result.name.size());
+  }
+  out << std::left << std::setw(int(width)) << "Benchmark" << std::right
+      << std::setw(14) << "iterations" << std::setw(14) << "ns/op"
+      << std::setw(12) << "stddev" << std::setw(12) << "allocs/op" << "\n";
+  out << std::fixed;
+  for (const auto &result : results) {
+    out << std::left << std::setw(int(width)) << result.name << std::right
+        << std::setw(14) << result.iterations << std::setprecision(2)
+        << std::setw(14) << result.nsPerOp << std::setw(12)
+        << result.stddevNs << std::setw(12) << result.allocsPerOp << "\n";
+  }
+  out << std::defaultfloat;
+}
+
+} // namespace driver
@@ -0,0 +1,82 @@
+/*****************************************************************************
+ * File: benchmark.h
+ * Description: Runs the #bench functions of a program in the JIT
+ *****************************************************************************/
+
+#pragma once
+#include "codegen/llvm/llvm_parallel_code_gen.h"
+#include "parser/ast.h"
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace driver {
+
+/**
+ * @brief How long and how often each benchmark is measured
+ */
+struct BenchmarkOptions {
+  unsigned timeMs = 1000; // Spent measuring each benchmark, roughly
+  unsigned samples = 10;  // Timed runs; their spread gives the stddev
+  bool json = false;
+};
+
+struct BenchmarkResult {
+  std::string name;
+  uint64_t iterations = 0; // Calls in each sample
+  double nsPerOp = 0;      // Mean over the samples
+  double stddevNs = 0;     // Sample standard deviation of ns/op
+  double allocsPerOp = 0;  // Runtime allocations per call
+};
+
+/**
+ * @class BenchmarkRunner
+ * @brief Measures the #bench functions of a program, as -bench asks
+ *
+ * The program is loaded into the code generator's JIT session, where each
+ * benchmark is called once untimed, which also compiles it. Calibration
+ * then grows the number of calls until one batch takes the time of a
+ * sample, and that many calls are timed for every sample. Allocations are
+ * read from the runtime's count for the calling thread.
+ *
+ * A #bench function takes no parameters and returns a number, a bool or
+ * nothing, so it is called through a pointer to a function returning
+ * void; its result stays in a register nobody reads. Work the optimizer
+ * could otherwise drop goes through blackBox().
+ */
+class BenchmarkRunner {
+public:
+  explicit BenchmarkRunner(BenchmarkOptions options) : options_(options) {}
+
+  /**
+   * @brief Gets the names of a program's #bench functions in source order
+   */
+  static std::vector<std::string> findBenchmarks(const parser::AST &ast);
+
+  /**
+   * @brief Loads a generated program and measures each benchmark
+   * @param codeGen Generator that generateCode() succeeded on
+   * @param names Functions to measure
+   * @param results Filled with one result for each name
+   * @return False if the program could not be loaded or a benchmark was
+   *         not found; errors go to the generator's reporter or stderr
+   */
+  bool run(codegen::LLVMParallelCodeGen &codeGen,
+           const std::vector<std::string> &names,
+           std::vector<BenchmarkResult> &results);
+
+  /**
+   * @brief Writes results as an aligned table, or as a JSON object with a
+   * "benchmarks" array
+   */
+  static void print(const std::vector<BenchmarkResult> &results,
+                    std::ostream &out, bool json);
+
+private:
+  BenchmarkResult measure(const std::string &name, void (*function)());
+
+  BenchmarkOptions options_;
+};
+
+} // namespace driver
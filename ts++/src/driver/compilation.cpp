@@ -0,0 +1,526 @@
+#include "driver/compilation.h"
+#include "core/common/source_manager.h"
+#include "core/common/time_report.h"
+#include "core/utils/file_utils.h"
+#include "core/utils/string_utils.h"
+#include "lexer/lexer.h"
+#include "parser/top_level_split.h"
+#include <algorithm>
+#include <filesystem>
+#include <sstream>
+
+namespace driver {
+
+using core::utils::FileUtils;
+
+namespace {
+
+// Files at least this large are parsed in parts when there are workers
+constexpr uintmax_t kSplitBytes = 256 * 1024;
+
+// Fewer tokens are not worth a task of their own
+constexpr size_t kMinPartTokens = 8 * 1024;
+
+// Nor are fewer bytes to lex
+constexpr size_t kMinLexChunkBytes = 64 * 1024;
+
+// Nor are fewer function or class bodies to type-check
+constexpr size_t kMinCheckBatch = 32;
+
+// Parses a stream into an AST of its own
+bool parseStream(tokens::TokenStream stream, core::ErrorReporter &diagnostics,
+                 parser::AST &ast, bool deferBodies) {
+  parser::Parser parser(std::move(stream), diagnostics);
+  parser.setDeferBodies(deferBodies);
+  bool success = parser.parse(false);
+  ast = parser.takeAST();
+  return success;
+}
+
+} // namespace
+
+Compilation::Compilation(core::ErrorReporter &errorReporter, unsigned threads)
+    : errorReporter_(errorReporter),
+      pool_(llvm::hardware_concurrency(threads)) {}
+
+bool Compilation::addInput(const std::string &input) {
+  inputs_.push_back(input);
+  return expandInput(input);
+}
+
+bool Compilation::expandInput(const std::string &input) {
+  // A manifest lists inputs relative to itself
+  if (input.size() > 1 && input[0] == '@') {
+    std::string manifest = input.substr(1);
+    auto contents = FileUtils::readFile(manifest);
+    if (!contents) {
+      errorReporter_.error(core::SourceLocation(),
+                           "Could not read manifest: " + manifest);
+      return false;
+    }
+    std::filesystem::path base = std::filesystem::path(manifest).parent_path();
+    std::istringstream lines(*contents);
+    bool success = true;
+    for (std::string line; std::getline(lines, line);) {
+      line = core::utils::StringUtils::trim(line);
+      if (line.empty() || line[0] == '#') {
+        continue;
+      }
+      std::filesystem::path path(line);
+      if (path.is_relative()) {
+        path = base / path;
+      }
+      success = expandInput(path.lexically_normal().string()) && success;
+    }
+    return success;
+  }
+
+  if (FileUtils::isDirectory(input)) {
+    auto sources = FileUtils::listFiles(input, "tspp");
+    if (sources.empty()) {
+      errorReporter_.error(core::SourceLocation(),
+                           "No .tspp files in directory: " + input);
+      return false;
+    }
+    bool success = true;
+    for (const auto &source : sources) {
+      success = addFile(source) && success;
+    }
+    return success;
+  }
+  return addFile(input);
+}
+
+bool Compilation::addFile(const std::string &path) {
+  if (FileUtils::getExtension(path) != "tspp") {
+    errorReporter_.error(core::SourceLocation(),
+                         "File must have .tspp extension: " + path);
+    return false;
+  }
+  std::error_code error;
+  uintmax_t size = std::filesystem::file_size(path, error);
+  auto modified = std::filesystem::last_write_time(path, error);
+  if (error) {
+    errorReporter_.error(core::SourceLocation(),
+                         "File does not exist: " + path);
+    return false;
+  }
+
+  // A file named twice, say by a directory and by itself, is compiled once
+  std::string normal = std::filesystem::path(path).lexically_normal().string();
+  if (std::find(files_.begin(), files_.end(), normal) != files_.end()) {
+    return true;
+  }
+  files_.push_back(normal);
+  states_.push_back(std::make_unique<FileState>());
+  states_.back()->path = normal;
+  states_.back()->size = size;
+  states_.back()->modified = modified;
+  return true;
+}
+
+bool Compilation::update() {
+  bool changed = false;
+  for (size_t i = 0; i < states_.size();) {
+    FileState &file = *states_[i];
+    std::error_code error;
+    uintmax_t size = std::filesystem::file_size(file.path, error);
+    auto modified = std::filesystem::last_write_time(file.path, error);
+    if (error) {
+      removed_.push_back(file.fileId);
+      files_.erase(files_.begin() + static_cast<std::ptrdiff_t>(i));
+      states_.erase(states_.begin() + static_cast<std::ptrdiff_t>(i));
+      changed = true;
+      continue;
+    }
+    if (size != file.size || modified != file.modified) {
+      file.size = size;
+      file.modified = modified;
+      file.current = false;
+      changed = true;
+    }
+    ++i;
+  }
+
+  // Files the inputs name now; those already known are not added twice
+  size_t known = files_.size();
+  for (const auto &input : inputs_) {
+    expandInput(input);
+  }
+  return changed || files_.size() != known;
+}
+
+bool Compilation::addImport(const std::string &path) {
+  std::string error;
+  std::shared_ptr<visitors::ModuleInterface> interface =
+      visitors::ModuleInterface::openShared(path, error);
+  if (!interface) {
+    errorReporter_.error(core::SourceLocation(), error);
+    return false;
+  }
+  declarations_.addImport(interface);
+  imports_.push_back(std::move(interface));
+  return true;
+}
+
+bool Compilation::parse() {
+  // The parts of split files are tasks too, so this waits for them as well
+  runOnFiles(&Compilation::parseFile);
+  bool parsed = true;
+  for (const auto &file : states_) {
+    joinParts(*file);
+    parsed = file->success && parsed;
+  }
+  reportFiles();
+
+  // What parsed is kept even after syntax errors, for the linter
+  program_.clear();
+  for (const auto &file : states_) {
+    for (const auto &node : file->ast.getNodes()) {
+      program_.addNode(node);
+    }
+  }
+  releaseSupersededFiles();
+  return parsed;
+}
+
+bool Compilation::check() {
+  // Streamed bodies are left to load(), and with the reused ones are not
+  // parsed here
+  unparsed_ = reused_;
+  if (streaming_) {
+    collectStreamed();
+    for (const auto &entry : streamed_) {
+      unparsed_.insert(entry.first);
+    }
+  }
+
+  // Deferred bodies are parsed first, so syntax errors stop the check
+  if (deferBodies_ || streaming_) {
+    bool parsed = runOnFiles(&Compilation::parseBodies);
+    reportFiles();
+    if (!parsed) {
+      return false;
+    }
+  }
+
+  // Declaring is one pass over signatures, so it is not worth splitting
+  const int errorsBefore = errorReporter_.errorCount();
+  declarations_ = visitors::TypeScope();
+  for (const auto &interface : imports_) {
+    declarations_.addImport(interface);
+  }
+  {
+    core::TimeReport::Scope timer("Declare");
+    visitors::TypeCheckVisitor(errorReporter_, &declarations_)
+        .declareAST(program_);
+  }
+
+  // The batches of a file's bodies are tasks too
+  runOnFiles(&Compilation::checkFile);
+  bool checked = true;
+  for (const auto &file : states_) {
+    joinChecks(*file);
+    checked = file->success && checked;
+  }
+  if (checked && errorReporter_.errorCount() == errorsBefore) {
+    // Folding needs the checked types, and global constants come first
+    constants_ = visitors::ConstantFolder::Globals();
+    {
+      core::TimeReport::Scope timer("Fold constants");
+      visitors::ConstantFolder(errorReporter_, &constants_)
+          .declareAST(program_);
+    }
+    checked = runOnFiles(&Compilation::foldFile);
+  }
+  reportFiles();
+  return checked && errorReporter_.errorCount() == errorsBefore;
+}
+
+bool Compilation::writeInterface(const std::string &path) const {
+  if (!FileUtils::writeFile(
+          path, visitors::ModuleInterface::serialize(program_, declarations_))) {
+    errorReporter_.error(core::SourceLocation(),
+                         "Could not write interface: " + path);
+    return false;
+  }
+  return true;
+}
+
+bool Compilation::streams(const nodes::FunctionDeclNode *function) const {
+  return streamed_.count(function) != 0;
+}
+
+bool Compilation::load(const nodes::FunctionDeclNode *function) {
+  std::lock_guard<std::mutex> lock(streamMutex_);
+  auto found = streamed_.find(function);
+  if (found == streamed_.end()) {
+    return function->getBody() != nullptr;
+  }
+  StreamedBody &body = found->second;
+  if (body.loads > 0) {
+    ++body.loads;
+    return true;
+  }
+
+  // The body is checked in the scope check() would have checked it in
+  core::TimeReport::Scope timer("Stream body", function->getName());
+  core::ErrorReporter diagnostics(false);
+  auto arena = std::make_unique<parser::ASTContext>();
+  bool success =
+      parser::Parser::parseBody(body.function, *arena, diagnostics);
+  if (success) {
+    visitors::TypeCheckVisitor::DeferredCheck check;
+    check.globals = body.scope;
+    check.definitions.push_back(body.function);
+    check.check();
+    diagnostics.append(check.diagnostics);
+    success = check.success && !diagnostics.hasErrors();
+  }
+  if (success) {
+    success = visitors::ConstantFolder(diagnostics, &constants_)
+                  .foldDefinition(body.function);
+  }
+  errorReporter_.append(diagnostics);
+  if (!success) {
+    body.function->setBody(nullptr);
+    body.function->deferBody(body.range);
+    return false;
+  }
+  body.arena = std::move(arena);
+  body.loads = 1;
+  return true;
+}
+
+void Compilation::release(const nodes::FunctionDeclNode *function) {
+  std::lock_guard<std::mutex> lock(streamMutex_);
+  auto found = streamed_.find(function);
+  if (found == streamed_.end() || found->second.loads == 0 ||
+      --found->second.loads > 0) {
+    return;
+  }
+  StreamedBody &body = found->second;
+  body.function->setBody(nullptr);
+  body.function->deferBody(body.range);
+  body.arena.reset();
+}
+
+void Compilation::collectStreamed() {
+  streamed_.clear();
+  for (nodes::NodePtr node : program_.getNodes()) {
+    if (auto stmt = nodes::dyn_cast<nodes::DeclarationStmtNode>(node)) {
+      node = stmt->getDeclaration();
+    }
+    auto function = nodes::dyn_cast<nodes::FunctionDeclNode>(node);
+    if (function && function->getNodeKind() == nodes::NodeKind::FunctionDecl &&
+        function->getDeferredBody() && !reused_.count(function)) {
+      StreamedBody &body = streamed_[function];
+      body.function = function;
+      body.range = function->getDeferredBody();
+    }
+  }
+}
+
+void Compilation::parseFile(FileState &file) {
+  if (file.current) {
+    file.success = true;
+    return;
+  }
+  auto buffer = FileUtils::openSource(file.path);
+  if (!buffer) {
+    file.diagnostics.error(core::SourceLocation(),
+                           "Could not read file: " + file.path);
+    return;
+  }
+  core::FileId fileId =
+      core::SourceManager::instance().addFile(file.path, std::move(buffer));
+  file.superseded = file.fileId;
+  file.fileId = fileId;
+
+  unsigned threads = pool_.getThreadCount();
+  if (file.size >= kSplitBytes && threads > 1 && !streaming_) {
+    std::shared_ptr<std::vector<tokens::Token>> tokens;
+    std::vector<size_t> starts;
+    {
+      // Chunks between line breaks are lexed on the workers too
+      core::TimeReport::Scope timer("Lex", file.path);
+      size_t chunkBytes = std::max<size_t>(kMinLexChunkBytes,
+                                           file.size / (threads * 2));
+      tokens = std::make_shared<std::vector<tokens::Token>>(
+          lexer::Lexer::tokenizeInChunks(
+              fileId, chunkBytes,
+              [this](std::function<void()> task) { pool_.async(task); }));
+      // A few parts per worker, so that workers finishing early help out
+      starts = parser::splitTopLevel(
+          *tokens, std::max(kMinPartTokens, tokens->size() / (threads * 4)));
+    }
+
+    // Each part moves its own range out of the tokens, and ends in an EOF
+    // token where the next part starts
+    file.parts.clear();
+    for (size_t i = 0; i < starts.size(); ++i) {
+      size_t end = i + 1 < starts.size() ? starts[i + 1] : tokens->size();
+      file.parts.push_back(std::make_unique<Part>());
+      Part *part = file.parts.back().get();
+      pool_.async([this, tokens, part, begin = starts[i], end,
+                   path = file.path] {
+        core::TimeReport::Scope timer("Parse", path);
+        std::vector<tokens::Token> range(
+            std::make_move_iterator(tokens->begin() + begin),
+            std::make_move_iterator(tokens->begin() + end));
+        if (end < tokens->size()) {
+          const tokens::Token &next = (*tokens)[end];
+          range.push_back(tokens::Token::createSynthetic(
+              tokens::TokenType::END_OF_FILE, next.getFileId(),
+              next.getOffset()));
+        }
+        part->success =
+            parseStream(tokens::TokenStream(std::move(range)),
+                        part->diagnostics, part->ast, deferBodies_);
+      });
+    }
+    return;
+  }
+
+  // The lexer scans the mapped buffer in place, as the parser asks for
+  // tokens, so lexing is part of the parse phase and only the parser's
+  // lookahead is held in memory
+  core::TimeReport::Scope timer("Parse", file.path);
+  file.success = parseStream(lexer::Lexer::stream(fileId), file.diagnostics,
+                             file.ast, deferBodies_ || streaming_);
+  file.current = file.success;
+}
+
+void Compilation::joinParts(FileState &file) {
+  if (file.parts.empty()) {
+    return;
+  }
+  file.ast = parser::AST();
+  file.success = true;
+  for (const auto &part : file.parts) {
+    file.diagnostics.append(part->diagnostics);
+    file.ast.append(std::move(part->ast));
+    file.success = part->success && file.success;
+  }
+  file.parts.clear();
+  file.current = file.success;
+}
+
+void Compilation::parseBodies(FileState &file) {
+  core::TimeReport::Scope timer("Parse", file.path);
+  file.success =
+      parser::Parser::parseBodies(file.ast, file.diagnostics, unparsed_);
+}
+
+void Compilation::checkFile(FileState &file) {
+  // Each file declares its locals into a scope of its own
+  core::TimeReport::Scope timer("Type check", file.path);
+  visitors::TypeScope scope = declarations_;
+  file.checks.clear();
+  try {
+    visitors::TypeCheckVisitor checker(file.diagnostics, &scope);
+
+    // With workers, bodies are left to batches, a few per worker, that
+    // are checked as tasks once what extends the scope has been checked.
+    // Streaming defers each body alone, for its scope.
+    unsigned threads = pool_.getThreadCount();
+    if (streaming_) {
+      checker.deferBodies(&file.checks, 1);
+    } else if (threads > 1) {
+      checker.deferBodies(&file.checks,
+                          std::max(kMinCheckBatch, file.ast.getNodes().size() /
+                                                       (threads * 4)));
+    }
+    file.success = checker.checkDefinitions(file.ast, reused_) &&
+                   !file.diagnostics.hasErrors();
+  } catch (const std::exception &e) {
+    file.diagnostics.error(core::SourceLocation(),
+                           std::string("Unexpected error during compilation: ") +
+                               e.what());
+    file.success = false;
+  }
+
+  for (const auto &check : file.checks) {
+    if (!check->isPending()) {
+      continue;
+    }
+    // A streamed body keeps the scope, and is checked when it is loaded
+    if (streaming_ && check->definitions.size() == 1) {
+      auto streamed = streamed_.find(check->definitions.front());
+      if (streamed != streamed_.end()) {
+        streamed->second.scope = std::move(check->globals);
+        continue;
+      }
+    }
+    pool_.async([check = check.get(), path = file.path] {
+      core::TimeReport::Scope timer("Type check", path);
+      try {
+        check->check();
+      } catch (const std::exception &e) {
+        check->diagnostics.error(
+            core::SourceLocation(),
+            std::string("Unexpected error during compilation: ") + e.what());
+        check->success = false;
+      }
+    });
+  }
+}
+
+void Compilation::foldFile(FileState &file) {
+  core::TimeReport::Scope timer("Fold constants", file.path);
+  file.success = visitors::ConstantFolder(file.diagnostics, &constants_)
+                     .foldDefinitions(file.ast, unparsed_);
+}
+
+void Compilation::joinChecks(FileState &file) {
+  if (file.checks.empty()) {
+    return;
+  }
+  for (const auto &check : file.checks) {
+    file.diagnostics.append(check->diagnostics);
+    file.success = check->success && file.success;
+  }
+  file.success = file.success && !file.diagnostics.hasErrors();
+  file.checks.clear();
+}
+
+bool Compilation::runOnFiles(void (Compilation::*step)(FileState &)) {
+  std::vector<FileState *> order;
+  for (const auto &file : states_) {
+    order.push_back(file.get());
+  }
+  std::stable_sort(order.begin(), order.end(),
+                   [](const FileState *a, const FileState *b) {
+                     return a->size > b->size;
+                   });
+
+  for (FileState *file : order) {
+    pool_.async([this, step, file] { (this->*step)(*file); });
+  }
+  pool_.wait();
+
+  return std::all_of(states_.begin(), states_.end(),
+                     [](const auto &file) { return file->success; });
+}
+
+void Compilation::reportFiles() {
+  for (const auto &file : states_) {
+    errorReporter_.append(file->diagnostics);
+    file->diagnostics.clear();
+  }
+}
+
+void Compilation::releaseSupersededFiles() {
+  // The old ASTs were replaced while parsing, and their nodes left
+  // program_ above; streamed bodies are collected again by check()
+  for (const auto &file : states_) {
+    removed_.push_back(file->superseded);
+    file->superseded = core::INVALID_FILE_ID;
+  }
+  for (core::FileId id : removed_) {
+    core::SourceManager::instance().releaseFile(id);
+  }
+  removed_.clear();
+}
+
+} // namespace driver
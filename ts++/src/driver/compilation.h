@@ -0,0 +1,301 @@
+/*****************************************************************************
+ * File: compilation.h
+ * Description: Front end for a program made of several source files
+ *****************************************************************************/
+
+#pragma once
+#include "core/diagnostics/error_reporter.h"
+#include "parser/ast.h"
+#include "parser/body_stream.h"
+#include "parser/parser.h"
+#include "parser/visitors/constant_folder/constant_folder.h"
+#include "parser/visitors/type_check_visitor/module_interface.h"
+#include "parser/visitors/type_check_visitor/type_check_visitor.h"
+#include "parser/visitors/type_check_visitor/type_scope.h"
+#include "llvm/Support/ThreadPool.h"
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace driver {
+
+/**
+ * @class Compilation
+ * @brief Lexes, parses and type-checks the files of one program in parallel
+ *
+ * Every file is lexed and parsed as a task of its own on a thread pool.
+ * Idle workers take the next queued file, and the largest files are queued
+ * first so that no long file starts last. A file too large to leave to
+ * one worker is lexed whole and cut between its top-level declarations,
+ * and the parts are parsed as tasks of their own into ASTs of their own,
+ * which are then joined in order. The declarations of all files
+ * are then entered into one scope, which is cheap and done serially, and
+ * each file's bodies are type-checked as another task against a copy of
+ * that scope, so files can use each other's types and functions.
+ *
+ * Tasks report into reporters of their own that only collect. They are
+ * appended to the shared reporter in input order, so the diagnostics are
+ * the same whatever the schedule. Once the program checks, its constant
+ * expressions are folded the same way: global constants serially, then
+ * each file's bodies as a task. The program AST holds the files'
+ * top-level nodes in input order, for the code generator to partition.
+ *
+ * A streaming compilation leaves the bodies of top-level functions to the
+ * code generator, as a parser::BodyStream: each is parsed, checked and
+ * folded when its function is generated, and freed right after.
+ */
+class Compilation : public parser::BodyStream {
+public:
+  /**
+   * @brief Constructs a compilation
+   * @param errorReporter Reporter the diagnostics of every file end up in
+   * @param threads Number of front end threads (1 = serial)
+   */
+  Compilation(core::ErrorReporter &errorReporter, unsigned threads);
+
+  /**
+   * @brief Adds the source files an input names
+   *
+   * A .tspp file is added as it is, a directory adds every .tspp file
+   * under it in sorted order, and @path adds the files a manifest lists,
+   * one per line, relative to the manifest. Blank lines and lines starting
+   * with '#' are skipped.
+   *
+   * @param input The input as given on the command line
+   * @return True if the input named only readable .tspp files
+   */
+  bool addInput(const std::string &input);
+
+  /**
+   * @brief Makes the declarations of a separately compiled program visible
+   *
+   * Names the sources do not declare resolve against the interface, which
+   * is only decoded as far as they use it.
+   *
+   * @param path Path of an interface written by writeInterface()
+   * @return True if the interface could be opened
+   */
+  bool addImport(const std::string &path);
+
+  /**
+   * @brief Gets the interfaces imported so far, in import order
+   */
+  const std::vector<std::shared_ptr<visitors::ModuleInterface>> &
+  getImports() const {
+    return imports_;
+  }
+
+  /**
+   * @brief Catches up with the files on disk, for a compilation run again
+   *
+   * Files that are gone are dropped, and files the inputs name now are
+   * added. Files whose size or modification time changed are read again
+   * by the next parse(); the tokens and AST of the others are kept.
+   *
+   * @return True if any file was added, dropped or changed
+   */
+  bool update();
+
+  /**
+   * @brief Gets the source files added so far, in input order
+   */
+  const std::vector<std::string> &getFiles() const { return files_; }
+
+  /**
+   * @brief Lexes, parses and type-checks every file
+   * @return True if no file had errors
+   */
+  bool run() { return parse() && check(); }
+
+  /**
+   * @brief Lexes and parses every file, the first half of run()
+   *
+   * Files parsed before that did not change since are not read again.
+   * After syntax errors the AST holds the nodes that could be parsed.
+   *
+   * @return True if no file had syntax errors
+   */
+  bool parse();
+
+  /**
+   * @brief Declares, type-checks and folds what parse() read, the rest of
+   * run()
+   * @return True if no file had type errors
+   */
+  bool check();
+
+  /**
+   * @brief Leaves function definitions out of check()
+   *
+   * For definitions whose code an incremental build reuses, and which thus
+   * checked cleanly before. Their signatures are still declared.
+   *
+   * @param reused The definitions to skip
+   */
+  void setReused(std::unordered_set<const nodes::BaseNode *> reused) {
+    reused_ = std::move(reused);
+  }
+
+  /**
+   * @brief Parses function and method bodies only once check() needs them
+   *
+   * parse() then skips every body by matching braces and keeps its source
+   * range, and check() parses the bodies it checks before declaring the
+   * program. Bodies of functions left out by setReused() are never parsed,
+   * and until check() the AST holds declarations only.
+   *
+   * @param defer Whether to defer bodies
+   */
+  void setDeferBodies(bool defer) { deferBodies_ = defer; }
+
+  /**
+   * @brief Leaves the bodies of top-level functions to the code generator
+   *
+   * parse() skips them, check() checks their signatures and takes a
+   * snapshot of the scope each body is to be checked in, and load() does
+   * the rest. Generic functions, methods and reused functions are not
+   * streamed. Large files are not split, since that lexes them whole.
+   *
+   * @param stream Whether to stream bodies
+   */
+  void setStreaming(bool stream) { streaming_ = stream; }
+
+  // parser::BodyStream, for the code generator of a streaming compilation
+  bool streams(const nodes::FunctionDeclNode *function) const override;
+  bool load(const nodes::FunctionDeclNode *function) override;
+  void release(const nodes::FunctionDeclNode *function) override;
+
+  /**
+   * @brief Gets the top-level nodes of every file, in input order
+   */
+  const parser::AST &getAST() const { return program_; }
+
+  /**
+   * @brief Writes the interface of the declarations of every file
+   * @param path Path of the interface file
+   * @return True if the file was written
+   */
+  bool writeInterface(const std::string &path) const;
+
+private:
+  // A range of a large file's top-level declarations, parsed on its own
+  struct Part {
+    core::ErrorReporter diagnostics{false};
+    parser::AST ast;
+    bool success = false;
+  };
+
+  // A top-level function whose body is parsed only while it is loaded
+  struct StreamedBody {
+    nodes::FunctionDeclNode *function = nullptr;
+    nodes::DeferredBody range;
+    std::shared_ptr<const visitors::TypeCheckVisitor::Globals> scope;
+    std::unique_ptr<parser::ASTContext> arena; // Holds the body while loaded
+    size_t loads = 0;
+  };
+
+  // State of one file; its nodes belong to its AST
+  struct FileState {
+    std::string path;
+    uintmax_t size = 0;
+    std::filesystem::file_time_type modified;
+    core::ErrorReporter diagnostics{false};
+    parser::AST ast;
+    std::vector<std::unique_ptr<Part>> parts; // While being parsed in parts
+    std::vector<std::unique_ptr<visitors::TypeCheckVisitor::DeferredCheck>>
+        checks; // While its bodies are checked in batches
+    bool success = false;
+    bool current = false; // Parsed, and unchanged on disk since
+    core::FileId fileId = core::INVALID_FILE_ID;     // Buffer of the AST
+    core::FileId superseded = core::INVALID_FILE_ID; // Until parse() ends
+  };
+
+  /**
+   * @brief Adds the source files an input names, without recording it
+   */
+  bool expandInput(const std::string &input);
+
+  /**
+   * @brief Adds a file, or reports why it cannot be compiled
+   * @return True if the file was added
+   */
+  bool addFile(const std::string &path);
+
+  /**
+   * @brief Lexes and parses one file, without type checking it
+   */
+  void parseFile(FileState &file);
+
+  /**
+   * @brief Puts a file parsed in parts back together, in source order
+   */
+  void joinParts(FileState &file);
+
+  /**
+   * @brief Parses the bodies of one file that parse() deferred
+   */
+  void parseBodies(FileState &file);
+
+  /**
+   * @brief Finds the functions whose bodies a streaming compilation leaves
+   * to the code generator
+   */
+  void collectStreamed();
+
+  /**
+   * @brief Type-checks one file's bodies against the program's declarations
+   */
+  void checkFile(FileState &file);
+
+  /**
+   * @brief Reports the batches a file's bodies were checked in, in order
+   */
+  void joinChecks(FileState &file);
+
+  /**
+   * @brief Folds the constant expressions of one checked file
+   */
+  void foldFile(FileState &file);
+
+  /**
+   * @brief Runs a step on every file, largest first, and waits for all
+   * @param step The step to run
+   * @return True if the step succeeded for every file
+   */
+  bool runOnFiles(void (Compilation::*step)(FileState &));
+
+  /**
+   * @brief Appends every file's diagnostics to the shared reporter
+   */
+  void reportFiles();
+
+  /**
+   * @brief Frees the buffers of files parsed again or removed, once the
+   * program no longer holds their nodes
+   */
+  void releaseSupersededFiles();
+
+  core::ErrorReporter &errorReporter_;              ///< Shared diagnostics
+  std::vector<std::string> inputs_;                 ///< As given to addInput
+  std::vector<std::string> files_;                  ///< Source paths
+  std::vector<std::unique_ptr<FileState>> states_;  ///< One per file
+  std::vector<core::FileId> removed_;               ///< Buffers to release
+  visitors::TypeScope declarations_;                ///< Of every file
+  visitors::ConstantFolder::Globals constants_;     ///< Of every file
+  std::vector<std::shared_ptr<visitors::ModuleInterface>> imports_; ///< Used
+  parser::AST program_;                             ///< Every file's nodes
+  std::unordered_set<const nodes::BaseNode *> reused_; ///< Not checked
+  std::unordered_set<const nodes::BaseNode *> unparsed_; ///< Not in check
+  std::unordered_map<const nodes::BaseNode *, StreamedBody> streamed_;
+  std::mutex streamMutex_;                          ///< Guards streamed_
+  bool deferBodies_ = false;                        ///< Bodies parsed by check
+  bool streaming_ = false;                          ///< Bodies loaded later
+  llvm::ThreadPool pool_;                           ///< Worker threads
+};
+
+} // namespace driver
@@ -0,0 +1,192 @@
+#include "driver/compilation_cache.h"
+#include "core/utils/cache_key.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/SHA1.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <cstdlib>
+
+namespace driver {
+
+using core::utils::addKeyField;
+
+CompilationCache::CompilationCache(std::string directory)
+    : directory_(std::move(directory)) {}
+
+std::string CompilationCache::getDefaultDirectory() {
+  const char *directory = std::getenv("TSPP_CACHE_DIR");
+  return directory ? directory : "";
+}
+
+bool CompilationCache::computeKey(const std::vector<std::string> &files,
+                                  const std::vector<std::string> &imports,
+                                  const codegen::CodeGenOptions &options) {
+  key_.clear();
+  context_.clear();
+  if (directory_.empty()) {
+    return false;
+  }
+
+  // The context is everything an output depends on besides the sources
+  llvm::SHA1 hasher;
+  addKeyField(hasher, "tspp " TSPP_VERSION " llvm " LLVM_VERSION_STRING);
+  if (!core::utils::addCompilerStamp(hasher)) {
+    return false;
+  }
+
+  // Without -mcpu the code is tuned for the host
+  addKeyField(hasher, options.getCacheKey());
+  if (options.getTargetCPU().empty()) {
+    std::string host = llvm::sys::getHostCPUName().str();
+    llvm::StringMap<bool> features;
+    if (llvm::sys::getHostCPUFeatures(features)) {
+      std::vector<std::string> enabled;
+      for (const auto &feature : features) {
+        if (feature.getValue()) {
+          enabled.push_back(feature.getKey().str());
+        }
+      }
+      std::sort(enabled.begin(), enabled.end());
+      for (const auto &feature : enabled) {
+        host += " +" + feature;
+      }
+    }
+    addKeyField(hasher, host);
+  }
+
+  for (const auto &import : imports) {
+    auto buffer = llvm::MemoryBuffer::getFile(import);
+    if (!buffer) {
+      return false;
+    }
+    addKeyField(hasher, (*buffer)->getBuffer());
+  }
+
+  // A new profile or runtime changes the code even when the flag that
+  // names it is the same
+  if (!options.getProfileUseFile().empty()) {
+    auto profile = llvm::MemoryBuffer::getFile(options.getProfileUseFile());
+    if (!profile) {
+      return false;
+    }
+    addKeyField(hasher, (*profile)->getBuffer());
+  }
+  if (!options.getRuntimeBitcode().empty()) {
+    auto runtime = llvm::MemoryBuffer::getFile(options.getRuntimeBitcode());
+    if (!runtime) {
+      return false;
+    }
+    addKeyField(hasher, (*runtime)->getBuffer());
+  }
+  context_ = llvm::toHex(hasher.final(), true);
+
+  // Executables also depend on the runtime and the system linker
+  if (options.getOutputFormat() == codegen::OutputFormat::EXECUTABLE) {
+    return false;
+  }
+  llvm::SHA1 output;
+  addKeyField(output, context_);
+  for (const auto &file : files) {
+    auto buffer = llvm::MemoryBuffer::getFile(file);
+    if (!buffer) {
+      return false;
+    }
+    addKeyField(output, (*buffer)->getBuffer());
+  }
+  key_ = llvm::toHex(output.final(), true);
+  return true;
+}
+
+std::string CompilationCache::getEntryPath(const std::string &key) const {
+  llvm::SmallString<128> path(directory_);
+  llvm::sys::path::append(path, llvm::StringRef(key).take_front(2),
+                          llvm::StringRef(key).drop_front(2));
+  return path.str().str();
+}
+
+std::string
+CompilationCache::getFunctionKey(const std::string &fingerprint) const {
+  llvm::SHA1 hasher;
+  addKeyField(hasher, context_);
+  addKeyField(hasher, "function");
+  addKeyField(hasher, fingerprint);
+  return llvm::toHex(hasher.final(), true);
+}
+
+bool CompilationCache::fetch(const std::string &output) const {
+  if (key_.empty()) {
+    return false;
+  }
+  std::string entry = getEntryPath(key_);
+  return llvm::sys::fs::exists(entry) &&
+         !llvm::sys::fs::copy_file(entry, output);
+}
+
+void CompilationCache::store(const std::string &output) const {
+  if (key_.empty()) {
+    return;
+  }
+  storeEntry(key_, [&](llvm::StringRef temporary) {
+    return !llvm::sys::fs::copy_file(output, temporary);
+  });
+}
+
+bool CompilationCache::fetchFunction(const std::string &fingerprint,
+                                     std::string &bitcode) const {
+  if (context_.empty()) {
+    return false;
+  }
+  auto buffer =
+      llvm::MemoryBuffer::getFile(getEntryPath(getFunctionKey(fingerprint)));
+  if (!buffer) {
+    return false;
+  }
+  bitcode = (*buffer)->getBuffer().str();
+  return true;
+}
+
+void CompilationCache::storeFunction(const std::string &fingerprint,
+                                     llvm::StringRef bitcode) const {
+  if (context_.empty()) {
+    return;
+  }
+  storeEntry(getFunctionKey(fingerprint), [&](llvm::StringRef temporary) {
+    std::error_code error;
+    llvm::raw_fd_ostream stream(temporary, error);
+    if (error) {
+      return false;
+    }
+    stream << bitcode;
+    stream.close();
+    return !stream.has_error();
+  });
+}
+
+void CompilationCache::storeEntry(
+    const std::string &key,
+    llvm::function_ref<bool(llvm::StringRef)> write) const {
+  std::string entry = getEntryPath(key);
+  if (llvm::sys::fs::create_directories(llvm::sys::path::parent_path(entry))) {
+    return;
+  }
+
+  // Readers only ever see a complete entry
+  llvm::SmallString<128> temporary;
+  int fd;
+  if (llvm::sys::fs::createUniqueFile(entry + ".tmp%%%%%%", fd, temporary)) {
+    return;
+  }
+  llvm::sys::Process::SafelyCloseFileDescriptor(fd);
+  if (!write(temporary) || llvm::sys::fs::rename(temporary, entry)) {
+    llvm::sys::fs::remove(temporary);
+  }
+}
+
+} // namespace driver
@@ -0,0 +1,124 @@
+/*****************************************************************************
+ * File: compilation_cache.h
+ * Description: On-disk cache of compiler outputs, keyed by content hash
+ *****************************************************************************/
+
+#pragma once
+#include "codegen/codegen_options.h"
+#include "llvm/ADT/STLFunctionalExtras.h"
+#include "llvm/ADT/StringRef.h"
+#include <string>
+#include <vector>
+
+namespace driver {
+
+/**
+ * @class CompilationCache
+ * @brief Reuses the output of an earlier identical compilation
+ *
+ * The key is a SHA-1 of everything the output depends on: the bytes of
+ * every source file in input order and of every imported interface, the
+ * code generation options other than the output name, the host CPU when
+ * the code is tuned for it, and the compiler itself, by version and by the
+ * size and modification time of its executable so that a rebuilt compiler
+ * never sees stale entries. On a hit
+ * the cached file is copied to the output and nothing is lexed, parsed or
+ * generated. Executables depend on the runtime and the system linker too,
+ * so only IR, bitcode, assembly and objects are cached.
+ *
+ * Incremental builds also keep the bitcode of single functions, keyed by
+ * their fingerprint and the same options and compiler, so a build that
+ * misses as a whole can still reuse every function that did not change.
+ *
+ * Entries are written to a temporary file and renamed into place, so
+ * concurrent builds sharing a cache never see a partial entry. Any failure
+ * to read or write the cache just means a miss.
+ */
+class CompilationCache {
+public:
+  /**
+   * @brief Opens a cache
+   * @param directory Where entries are kept; empty disables the cache
+   */
+  explicit CompilationCache(std::string directory);
+
+  /**
+   * @brief Gets the cache directory named by TSPP_CACHE_DIR, if any
+   */
+  static std::string getDefaultDirectory();
+
+  /**
+   * @brief Computes the key of compiling files with options
+   * @param files The source files, in input order
+   * @param imports The imported interfaces, in import order
+   * @param options The code generation options
+   * @return True if the output can be cached; false if the cache is
+   *         disabled, the format is not cached or a file cannot be read
+   */
+  bool computeKey(const std::vector<std::string> &files,
+                  const std::vector<std::string> &imports,
+                  const codegen::CodeGenOptions &options);
+
+  /**
+   * @brief Checks whether single functions can be cached
+   *
+   * True once computeKey() has run with the cache enabled and every import
+   * readable, whatever the output format.
+   */
+  bool canCacheFunctions() const { return !context_.empty(); }
+
+  /**
+   * @brief Reads the cached bitcode of a function
+   * @param fingerprint The function's fingerprint
+   * @param bitcode Set to the bitcode on a hit
+   * @return True on a hit
+   */
+  bool fetchFunction(const std::string &fingerprint,
+                     std::string &bitcode) const;
+
+  /**
+   * @brief Stores the bitcode of a function
+   * @param fingerprint The function's fingerprint
+   * @param bitcode The function's module as bitcode
+   */
+  void storeFunction(const std::string &fingerprint,
+                     llvm::StringRef bitcode) const;
+
+  /**
+   * @brief Copies the cached output for the key to a file
+   * @param output Path of the output file
+   * @return True on a hit
+   */
+  bool fetch(const std::string &output) const;
+
+  /**
+   * @brief Stores an output that was just generated under the key
+   * @param output Path of the output file
+   */
+  void store(const std::string &output) const;
+
+private:
+  /**
+   * @brief Gets the path of the entry for a key
+   */
+  std::string getEntryPath(const std::string &key) const;
+
+  /**
+   * @brief Gets the key of a function from its fingerprint
+   */
+  std::string getFunctionKey(const std::string &fingerprint) const;
+
+  /**
+   * @brief Writes an entry through a temporary file
+   * @param key The entry's key
+   * @param write Writes the contents to a path; false on failure
+   */
+  void storeEntry(const std::string &key,
+                  llvm::function_ref<bool(llvm::StringRef)> write) const;
+
+  std::string directory_; ///< Cache root, empty if disabled
+  std::string key_;       ///< Hex SHA-1 of the inputs, empty if uncacheable
+  std::string context_;   ///< Hex SHA-1 of all but the sources, or empty
+};
+
+} // namespace driver
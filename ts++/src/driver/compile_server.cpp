@@ -0,0 +1,389 @@
+#include "driver/compile_server.h"
+#include "codegen/codegen_options.h"
+#include "codegen/llvm/llvm_target.h"
+#include "parser/visitors/type_check_visitor/module_interface.h"
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+extern char **environ;
+
+namespace driver {
+
+namespace {
+
+// Standard input, output and error travel with every request
+constexpr int kStreamCount = 3;
+
+// Requests larger than this are malformed
+constexpr uint32_t kMaxRequestSize = 64u << 20;
+
+// A request is its size, then its strings, each prefixed by its length:
+// the working directory, the number of arguments, the arguments, and the
+// environment to the end
+void appendString(std::string &out, const std::string &value) {
+  uint32_t size = static_cast<uint32_t>(value.size());
+  out.append(reinterpret_cast<const char *>(&size), sizeof(size));
+  out.append(value);
+}
+
+bool readString(const std::string &in, size_t &offset, std::string &value) {
+  uint32_t size;
+  if (in.size() - offset < sizeof(size)) {
+    return false;
+  }
+  std::memcpy(&size, in.data() + offset, sizeof(size));
+  offset += sizeof(size);
+  if (in.size() - offset < size) {
+    return false;
+  }
+  value.assign(in, offset, size);
+  offset += size;
+  return true;
+}
+
+bool writeAll(int fd, const void *data, size_t size) {
+  const char *bytes = static_cast<const char *>(data);
+  while (size > 0) {
+    ssize_t written = ::write(fd, bytes, size);
+    if (written < 0 && errno == EINTR) {
+      continue;
+    }
+    if (written <= 0) {
+      return false;
+    }
+    bytes += written;
+    size -= static_cast<size_t>(written);
+  }
+  return true;
+}
+
+bool readAll(int fd, void *data, size_t size) {
+  char *bytes = static_cast<char *>(data);
+  while (size > 0) {
+    ssize_t got = ::read(fd, bytes, size);
+    if (got < 0 && errno == EINTR) {
+      continue;
+    }
+    if (got <= 0) {
+      return false;
+    }
+    bytes += got;
+    size -= static_cast<size_t>(got);
+  }
+  return true;
+}
+
+// Set by SIGTERM and SIGINT, which stop the server between requests
+volatile std::sig_atomic_t stopping = 0;
+
+void stop(int) { stopping = 1; }
+
+bool makeAddress(const std::string &path, sockaddr_un &address) {
+  std::memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+    return false;
+  }
+  std::memcpy(address.sun_path, path.data(), path.size());
+  return true;
+}
+
+struct Request {
+  std::string directory;
+  std::vector<std::string> args;
+  std::vector<std::string> environment;
+};
+
+bool parseRequest(const std::string &payload, Request &request) {
+  size_t offset = 0;
+  std::string count;
+  if (!readString(payload, offset, request.directory) ||
+      !readString(payload, offset, count)) {
+    return false;
+  }
+  char *end = nullptr;
+  unsigned long argCount = std::strtoul(count.c_str(), &end, 10);
+  if (*end != '\0') {
+    return false;
+  }
+  request.args.resize(argCount);
+  for (auto &arg : request.args) {
+    if (!readString(payload, offset, arg)) {
+      return false;
+    }
+  }
+  while (offset < payload.size()) {
+    request.environment.emplace_back();
+    if (!readString(payload, offset, request.environment.back())) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Runs a request in the forked child, as if the client had run it
+[[noreturn]] void runRequest(const Request &request,
+                             const CompileServer::Compiler &compiler,
+                             int connection) {
+  int status = 1;
+  if (::chdir(request.directory.c_str()) != 0) {
+    std::cerr << "Error: Compile server cannot enter " << request.directory
+              << "\n";
+  } else {
+    ::clearenv();
+    for (const auto &variable : request.environment) {
+      size_t equals = variable.find('=');
+      if (equals != std::string::npos) {
+        ::setenv(variable.substr(0, equals).c_str(),
+                 variable.substr(equals + 1).c_str(), 1);
+      }
+    }
+    try {
+      status = compiler(request.args);
+    } catch (const std::exception &e) {
+      std::cerr << "Fatal error: " << e.what() << "\n";
+    }
+  }
+
+  std::cout.flush();
+  std::cerr.flush();
+  std::fflush(nullptr);
+  int32_t reply = status;
+  writeAll(connection, &reply, sizeof(reply));
+  ::_exit(0);
+}
+
+} // namespace
+
+CompileServer::CompileServer(std::string socketPath, Compiler compiler)
+    : socketPath_(std::move(socketPath)), compiler_(std::move(compiler)) {}
+
+int CompileServer::serve(unsigned idleSeconds) {
+  sockaddr_un address;
+  if (!makeAddress(socketPath_, address)) {
+    std::cerr << "Error: Invalid socket path: " << socketPath_ << "\n";
+    return 1;
+  }
+
+  // Set up once what every run needs, so forks start with it done; the
+  // default target's machine stays pooled for them
+  codegen::LLVMTarget().initialize(codegen::CodeGenOptions());
+
+  // A socket left behind by a server that is gone is replaced
+  struct stat status;
+  if (::stat(socketPath_.c_str(), &status) == 0 && S_ISSOCK(status.st_mode)) {
+    int probe = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    bool live = probe >= 0 &&
+                ::connect(probe, reinterpret_cast<sockaddr *>(&address),
+                          sizeof(address)) == 0;
+    if (probe >= 0) {
+      ::close(probe);
+    }
+    if (live) {
+      std::cerr << "Error: A compile server is already listening on "
+                << socketPath_ << "\n";
+      return 1;
+    }
+    ::unlink(socketPath_.c_str());
+  }
+
+  listener_ = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listener_ < 0 ||
+      ::bind(listener_, reinterpret_cast<sockaddr *>(&address),
+             sizeof(address)) != 0 ||
+      ::listen(listener_, SOMAXCONN) != 0) {
+    std::cerr << "Error: Cannot listen on " << socketPath_ << ": "
+              << std::strerror(errno) << "\n";
+    if (listener_ >= 0) {
+      ::close(listener_);
+    }
+    return 1;
+  }
+
+  // Runs are reaped by the kernel; a signal to stop interrupts the wait
+  std::signal(SIGCHLD, SIG_IGN);
+  struct sigaction action {};
+  action.sa_handler = stop;
+  ::sigaction(SIGTERM, &action, nullptr);
+  ::sigaction(SIGINT, &action, nullptr);
+
+  while (!stopping) {
+    pollfd waiting{listener_, POLLIN, 0};
+    int ready = ::poll(&waiting, 1,
+                       idleSeconds ? static_cast<int>(idleSeconds) * 1000 : -1);
+    if (ready < 0 && errno == EINTR) {
+      continue;
+    }
+    if (ready <= 0) {
+      break;
+    }
+    int connection = ::accept(listener_, nullptr, nullptr);
+    if (connection >= 0) {
+      handle(connection);
+      ::close(connection);
+    }
+  }
+
+  ::close(listener_);
+  ::unlink(socketPath_.c_str());
+  return 0;
+}
+
+void CompileServer::handle(int connection) {
+  // A client that connects and stalls must not hold up the others
+  timeval timeout{5, 0};
+  ::setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+  // The size of the request carries the client's streams
+  uint32_t size = 0;
+  iovec header{&size, sizeof(size)};
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * kStreamCount)];
+  msghdr message{};
+  message.msg_iov = &header;
+  message.msg_iovlen = 1;
+  message.msg_control = control;
+  message.msg_controllen = sizeof(control);
+  ssize_t got;
+  do {
+    got = ::recvmsg(connection, &message, MSG_CMSG_CLOEXEC);
+  } while (got < 0 && errno == EINTR);
+
+  std::vector<int> streams;
+  for (cmsghdr *cmsg = CMSG_FIRSTHDR(&message); cmsg;
+       cmsg = CMSG_NXTHDR(&message, cmsg)) {
+    if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+      size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+      const int *fds = reinterpret_cast<const int *>(CMSG_DATA(cmsg));
+      streams.insert(streams.end(), fds, fds + count);
+    }
+  }
+  auto closeStreams = [&] {
+    for (int fd : streams) {
+      ::close(fd);
+    }
+  };
+
+  Request request;
+  std::string payload;
+  if (got != sizeof(size) || streams.size() != kStreamCount ||
+      size > kMaxRequestSize) {
+    closeStreams();
+    return;
+  }
+  payload.resize(size);
+  if (!readAll(connection, payload.data(), size) ||
+      !parseRequest(payload, request)) {
+    closeStreams();
+    return;
+  }
+
+  // Interfaces stay mapped in the server for the runs after this one
+  for (const auto &arg : request.args) {
+    if (arg.rfind("-import=", 0) == 0) {
+      std::string error;
+      visitors::ModuleInterface::openShared(
+          (std::filesystem::path(request.directory) / arg.substr(8)).string(),
+          error);
+    }
+  }
+
+  pid_t child = ::fork();
+  if (child == 0) {
+    ::close(listener_);
+    std::signal(SIGCHLD, SIG_DFL);
+    std::signal(SIGTERM, SIG_DFL);
+    std::signal(SIGINT, SIG_DFL);
+    for (int i = 0; i < kStreamCount; ++i) {
+      ::dup2(streams[i], i);
+    }
+    closeStreams();
+    runRequest(request, compiler_, connection);
+  }
+  if (child < 0) {
+    std::string error = "Error: Compile server cannot fork: " +
+                        std::string(std::strerror(errno)) + "\n";
+    writeAll(streams[2], error.data(), error.size());
+    int32_t reply = 1;
+    writeAll(connection, &reply, sizeof(reply));
+  }
+  closeStreams();
+}
+
+bool CompileServer::forward(const std::string &socketPath,
+                            const std::vector<std::string> &args,
+                            int &status) {
+  sockaddr_un address;
+  if (!makeAddress(socketPath, address)) {
+    return false;
+  }
+  int connection = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (connection < 0) {
+    return false;
+  }
+  if (::connect(connection, reinterpret_cast<sockaddr *>(&address),
+                sizeof(address)) != 0) {
+    ::close(connection);
+    return false;
+  }
+
+  std::error_code error;
+  std::string payload;
+  appendString(payload, std::filesystem::current_path(error).string());
+  appendString(payload, std::to_string(args.size()));
+  for (const auto &arg : args) {
+    appendString(payload, arg);
+  }
+  for (char **variable = environ; *variable; ++variable) {
+    appendString(payload, *variable);
+  }
+
+  // The streams go with the size, so the run writes where this process would
+  uint32_t size = static_cast<uint32_t>(payload.size());
+  iovec header{&size, sizeof(size)};
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * kStreamCount)];
+  std::memset(control, 0, sizeof(control));
+  msghdr message{};
+  message.msg_iov = &header;
+  message.msg_iovlen = 1;
+  message.msg_control = control;
+  message.msg_controllen = sizeof(control);
+  cmsghdr *cmsg = CMSG_FIRSTHDR(&message);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int) * kStreamCount);
+  int streams[kStreamCount] = {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO};
+  std::memcpy(CMSG_DATA(cmsg), streams, sizeof(streams));
+
+  ssize_t sent;
+  do {
+    sent = ::sendmsg(connection, &message, MSG_NOSIGNAL);
+  } while (sent < 0 && errno == EINTR);
+  if (error || sent != sizeof(size) ||
+      !writeAll(connection, payload.data(), payload.size())) {
+    ::close(connection);
+    return false;
+  }
+
+  // Once the request is sent, the run is the server's
+  int32_t reply;
+  if (!readAll(connection, &reply, sizeof(reply))) {
+    std::cerr << "Error: Compile server closed the connection\n";
+    reply = 1;
+  }
+  ::close(connection);
+  status = reply;
+  return true;
+}
+
+} // namespace driver
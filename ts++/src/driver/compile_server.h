@@ -0,0 +1,70 @@
+/*****************************************************************************
+ * File: compile_server.h
+ * Description: Long-running compiler process that clients hand runs to
+ *****************************************************************************/
+
+#pragma once
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace driver {
+
+/**
+ * @class CompileServer
+ * @brief Serves compiler invocations over a Unix socket
+ *
+ * The server initializes LLVM's targets and queries the host once, then
+ * waits for clients. A client sends its arguments, working directory and
+ * environment with its standard input, output and error attached, and the
+ * server forks a compilation for it. The fork starts with everything the
+ * server has already set up, runs the compiler in the client's directory
+ * and environment as if it had been started there, and sends back the exit
+ * status. Before forking, the server opens the interfaces a run imports,
+ * so later runs find them mapped already.
+ *
+ * Each run is a process of its own, so runs proceed concurrently, share
+ * nothing they could corrupt, and a crash only fails its client.
+ */
+class CompileServer {
+public:
+  // Runs the compiler on command-line arguments, returning the exit status
+  using Compiler = std::function<int(const std::vector<std::string> &)>;
+
+  /**
+   * @brief Constructs a server
+   * @param socketPath Path of the Unix socket to listen on
+   * @param compiler Runs one invocation
+   */
+  CompileServer(std::string socketPath, Compiler compiler);
+
+  /**
+   * @brief Serves clients until no request came for a while
+   * @param idleSeconds Seconds to wait for a request; 0 waits forever
+   * @return The exit status of the server
+   */
+  int serve(unsigned idleSeconds);
+
+  /**
+   * @brief Runs an invocation on a server
+   * @param socketPath Path of the server's socket
+   * @param args The arguments of the invocation
+   * @param status Set to the exit status of the run
+   * @return False if no server could be reached, so nothing ran
+   */
+  static bool forward(const std::string &socketPath,
+                      const std::vector<std::string> &args, int &status);
+
+private:
+  /**
+   * @brief Reads a request and forks its run
+   * @param connection The client's connection
+   */
+  void handle(int connection);
+
+  std::string socketPath_; ///< Where clients connect
+  Compiler compiler_;      ///< Runs one invocation
+  int listener_ = -1;      ///< Listening socket
+};
+
+} // namespace driver
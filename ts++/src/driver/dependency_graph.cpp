@@ -0,0 +1,168 @@
+#include "driver/dependency_graph.h"
+#include "core/common/source_manager.h"
+#include "core/utils/cache_key.h"
+#include "parser/nodes/statement_nodes.h"
+#include "tokens/token_type.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/SHA1.h"
+#include <algorithm>
+#include <cctype>
+#include <unordered_set>
+
+namespace driver {
+
+using core::utils::addKeyField;
+
+namespace {
+
+bool isIdentifierStart(char c) {
+  return std::isalpha(static_cast<unsigned char>(c)) || c == '_';
+}
+
+bool isIdentifierPart(char c) {
+  return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+}
+
+// Modifiers such as #inline and #tailcall, and the #target instruction sets
+std::string attributesOf(const nodes::FunctionDeclNode *function) {
+  std::string attributes = function->getTarget();
+  for (tokens::TokenType modifier : function->getModifiers()) {
+    attributes += " " + std::to_string(static_cast<int>(modifier));
+  }
+  return attributes;
+}
+
+} // namespace
+
+DependencyGraph::DependencyGraph(const parser::AST &program) {
+  const auto &nodes = program.getNodes();
+  auto &sources = core::SourceManager::instance();
+
+  // A node spans up to the next node of its file, or the end of the file
+  std::vector<std::pair<const nodes::BaseNode *, std::string_view>> spans;
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    const core::SourceLocation &location = nodes[i]->getLocation();
+    std::string_view buffer = sources.getBuffer(location.getFileId());
+    size_t begin = std::min<size_t>(location.getOffset(), buffer.size());
+    size_t end = buffer.size();
+    if (i + 1 < nodes.size() &&
+        nodes[i + 1]->getLocation().getFileId() == location.getFileId()) {
+      end = std::clamp<size_t>(nodes[i + 1]->getLocation().getOffset(), begin,
+                               buffer.size());
+    }
+
+    nodes::NodePtr node = nodes[i];
+    if (auto stmt = nodes::dyn_cast<nodes::DeclarationStmtNode>(node)) {
+      node = stmt->getDeclaration();
+    }
+    spans.emplace_back(node, buffer.substr(begin, end - begin));
+  }
+
+  // Names first, so that texts can be matched against all of them
+  for (const auto &[node, text] : spans) {
+    auto decl = nodes::dyn_cast<nodes::DeclarationNode>(node);
+    if (!decl) {
+      continue;
+    }
+
+    Declaration declaration{text, "", {}};
+    if (node->getNodeKind() == nodes::NodeKind::FunctionDecl) {
+      auto function = nodes::cast<nodes::FunctionDeclNode>(node);
+      declaration.attributes = attributesOf(function);
+      if (function->hasBody()) {
+        // Callers see the signature; the body is the function's own
+        size_t bodyOffset =
+            function->getBody()
+                ? function->getBody()->getLocation().getOffset()
+                : function->getDeferredBody().begin;
+        size_t begin = node->getLocation().getOffset();
+        if (bodyOffset > begin && bodyOffset - begin <= text.size()) {
+          declaration.interface = text.substr(0, bodyOffset - begin);
+        }
+        bodies_[function] = {text, declaration.attributes, {}};
+        functions_.push_back(function);
+      }
+    }
+    declarations_[decl->getName()].push_back(declaration);
+  }
+
+  for (auto &[name, declarations] : declarations_) {
+    for (auto &declaration : declarations) {
+      declaration.names = namesIn(declaration.interface);
+    }
+  }
+  for (auto &[function, body] : bodies_) {
+    body.names = namesIn(body.text);
+  }
+}
+
+std::vector<std::string_view>
+DependencyGraph::namesIn(std::string_view text) const {
+  std::vector<std::string_view> names;
+  std::unordered_set<std::string_view> seen;
+  for (size_t i = 0; i < text.size();) {
+    if (!isIdentifierStart(text[i])) {
+      ++i;
+      continue;
+    }
+    size_t start = i;
+    while (i < text.size() && isIdentifierPart(text[i])) {
+      ++i;
+    }
+    auto it = declarations_.find(text.substr(start, i - start));
+    if (it != declarations_.end() && seen.insert(it->first).second) {
+      names.push_back(it->first);
+    }
+  }
+  return names;
+}
+
+std::vector<std::string> DependencyGraph::getDependencies(
+    const nodes::FunctionDeclNode *function) const {
+  auto body = bodies_.find(function);
+  if (body == bodies_.end()) {
+    return {};
+  }
+
+  // Closure over the names that interfaces mention
+  std::unordered_set<std::string_view> reached(body->second.names.begin(),
+                                               body->second.names.end());
+  std::vector<std::string_view> pending = body->second.names;
+  while (!pending.empty()) {
+    std::string_view name = pending.back();
+    pending.pop_back();
+    for (const auto &declaration : declarations_.at(name)) {
+      for (std::string_view next : declaration.names) {
+        if (reached.insert(next).second) {
+          pending.push_back(next);
+        }
+      }
+    }
+  }
+
+  std::vector<std::string> dependencies(reached.begin(), reached.end());
+  std::sort(dependencies.begin(), dependencies.end());
+  return dependencies;
+}
+
+std::string DependencyGraph::getFingerprint(
+    const nodes::FunctionDeclNode *function) const {
+  auto body = bodies_.find(function);
+  if (body == bodies_.end()) {
+    return "";
+  }
+
+  llvm::SHA1 hasher;
+  addKeyField(hasher, body->second.text);
+  addKeyField(hasher, body->second.attributes);
+  for (const auto &name : getDependencies(function)) {
+    addKeyField(hasher, name);
+    for (const auto &declaration : declarations_.at(name)) {
+      addKeyField(hasher, declaration.interface);
+      addKeyField(hasher, declaration.attributes);
+    }
+  }
+  return llvm::toHex(hasher.final(), true);
+}
+
+} // namespace driver
@@ -0,0 +1,84 @@
+/*****************************************************************************
+ * File: dependency_graph.h
+ * Description: Which top-level declarations each function depends on
+ *****************************************************************************/
+
+#pragma once
+#include "parser/ast.h"
+#include "parser/nodes/declaration_nodes.h"
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace driver {
+
+/**
+ * @class DependencyGraph
+ * @brief Fingerprints function definitions for incremental rebuilds
+ *
+ * Every top-level declaration owns the source text from where it starts to
+ * where the next one starts. Its interface is the part others depend on:
+ * the signature of a function, and the whole text of anything else, since
+ * the layout of a class or the body of a generic function is compiled into
+ * its users. A function depends on the declarations its text names, and
+ * transitively on those their interfaces name, so a function that returns
+ * a class depends on the class's fields too.
+ *
+ * The fingerprint of a function hashes its own text, modifiers and target
+ * with the interfaces it depends on. Code generated for a function with an
+ * unchanged fingerprint is the same, so it can be reused from an earlier
+ * build; editing one body changes only that function's fingerprint, and
+ * editing a signature only those of the functions that use it. Names are
+ * matched as plain identifiers, so a local that shadows a declaration adds
+ * a dependency that is not needed, which is safe.
+ */
+class DependencyGraph {
+public:
+  /**
+   * @brief Builds the graph of a parsed program
+   * @param program The top-level nodes of every file, in file order
+   */
+  explicit DependencyGraph(const parser::AST &program);
+
+  /**
+   * @brief Gets the non-generic functions with bodies, in program order
+   */
+  const std::vector<const nodes::FunctionDeclNode *> &getFunctions() const {
+    return functions_;
+  }
+
+  /**
+   * @brief Gets the declarations a function depends on, sorted
+   */
+  std::vector<std::string>
+  getDependencies(const nodes::FunctionDeclNode *function) const;
+
+  /**
+   * @brief Gets the fingerprint of a function, as hex SHA-1
+   */
+  std::string getFingerprint(const nodes::FunctionDeclNode *function) const;
+
+private:
+  struct Declaration {
+    std::string_view interface;          // The part its users depend on
+    std::string attributes;              // Modifiers and target of functions
+    std::vector<std::string_view> names; // Declarations the interface names
+  };
+
+  struct Function {
+    std::string_view text;               // Signature and body
+    std::string attributes;              // Modifiers and target
+    std::vector<std::string_view> names; // Declarations the text names
+  };
+
+  // Names that the text mentions and the program declares, deduplicated
+  std::vector<std::string_view> namesIn(std::string_view text) const;
+
+  std::unordered_map<std::string_view, std::vector<Declaration>>
+      declarations_; // By name; a name may be declared more than once
+  std::unordered_map<const nodes::FunctionDeclNode *, Function> bodies_;
+  std::vector<const nodes::FunctionDeclNode *> functions_;
+};
+
+} // namespace driver
@@ -0,0 +1,197 @@
+#include "driver/file_watcher.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <thread>
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace driver {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Events closer together than this belong to the same save
+constexpr int kSettleMilliseconds = 50;
+
+// How often the watched paths are scanned where inotify is missing
+constexpr auto kScanInterval = std::chrono::milliseconds(500);
+
+bool isSource(const fs::path &path) { return path.extension() == ".tspp"; }
+
+} // namespace
+
+FileWatcher::FileWatcher() {
+#ifdef __linux__
+  fd_ = inotify_init1(IN_CLOEXEC);
+#endif
+}
+
+FileWatcher::~FileWatcher() {
+#ifdef __linux__
+  if (fd_ >= 0) {
+    ::close(fd_);
+  }
+#endif
+}
+
+bool FileWatcher::watch(const std::string &path) {
+  std::error_code error;
+  fs::path watched = fs::path(path).lexically_normal();
+  bool directory = fs::is_directory(watched, error);
+  if (!directory && !fs::exists(watched, error)) {
+    lastError_ = "No such file or directory: " + path;
+    return false;
+  }
+  roots_.push_back(watched);
+  if (fd_ < 0) {
+    // Remember the current times, so the first scan reports no changes
+    modified_ = scan();
+    return true;
+  }
+  if (directory) {
+    return watchDirectory(watched, true);
+  }
+  files_.insert(watched.string());
+  return watchDirectory(watched.parent_path(), false);
+}
+
+bool FileWatcher::watchDirectory(const fs::path &directory, bool all) {
+#ifdef __linux__
+  std::string name = directory.empty() ? "." : directory.string();
+  int wd = inotify_add_watch(fd_, name.c_str(),
+                             IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM |
+                                 IN_CREATE | IN_DELETE | IN_ONLYDIR);
+  if (wd < 0) {
+    lastError_ = "Could not watch " + name + ": " + std::strerror(errno);
+    return false;
+  }
+  // A directory named twice is one watch, for all files if either wants
+  Directory &watched = directories_[wd];
+  watched.path = directory;
+  watched.all = watched.all || all;
+  if (!all) {
+    return true;
+  }
+
+  std::error_code error;
+  for (fs::directory_iterator it(name, error), end; it != end && !error;
+       it.increment(error)) {
+    if (it->is_directory(error) &&
+        !watchDirectory(directory / it->path().filename(), true)) {
+      return false;
+    }
+  }
+#else
+  (void)directory;
+  (void)all;
+#endif
+  return true;
+}
+
+std::unordered_map<std::string, fs::file_time_type> FileWatcher::scan() const {
+  std::unordered_map<std::string, fs::file_time_type> times;
+  std::error_code error;
+  auto add = [&](const fs::path &path) {
+    auto time = fs::last_write_time(path, error);
+    if (!error) {
+      times.emplace(path.lexically_normal().string(), time);
+    }
+  };
+  for (const auto &root : roots_) {
+    if (!fs::is_directory(root, error)) {
+      add(root);
+      continue;
+    }
+    for (fs::recursive_directory_iterator it(root, error), end;
+         it != end && !error; it.increment(error)) {
+      if (it->is_regular_file(error) && isSource(it->path())) {
+        add(it->path());
+      }
+    }
+  }
+  return times;
+}
+
+std::vector<std::string> FileWatcher::wait() {
+  std::vector<std::string> changed;
+#ifdef __linux__
+  if (fd_ >= 0) {
+    // Block for the first event, then read on until the burst settles
+    int timeout = -1;
+    alignas(inotify_event) char buffer[16 * 1024];
+    while (true) {
+      pollfd request = {fd_, POLLIN, 0};
+      int ready = ::poll(&request, 1, timeout);
+      if (ready < 0 && errno == EINTR) {
+        continue;
+      }
+      if (ready < 0) {
+        lastError_ = std::string("Could not wait for changes: ") +
+                     std::strerror(errno);
+        return {};
+      }
+      if (ready == 0) {
+        if (!changed.empty()) {
+          break;
+        }
+        // Only other files changed; wait for the next event
+        timeout = -1;
+        continue;
+      }
+      ssize_t size = ::read(fd_, buffer, sizeof(buffer));
+      if (size <= 0) {
+        continue;
+      }
+      timeout = kSettleMilliseconds;
+      for (ssize_t offset = 0; offset < size;) {
+        const auto *event =
+            reinterpret_cast<const inotify_event *>(buffer + offset);
+        offset += sizeof(inotify_event) + event->len;
+        auto it = directories_.find(event->wd);
+        if (it == directories_.end() || event->len == 0) {
+          continue;
+        }
+        fs::path path = it->second.path / event->name;
+        if (event->mask & IN_ISDIR) {
+          if (it->second.all && (event->mask & (IN_CREATE | IN_MOVED_TO))) {
+            watchDirectory(path, true);
+          }
+          continue;
+        }
+        if (isSource(path) &&
+            (it->second.all || files_.count(path.string()))) {
+          changed.push_back(path.string());
+        }
+      }
+    }
+  }
+#endif
+  while (fd_ < 0 && changed.empty()) {
+    std::this_thread::sleep_for(kScanInterval);
+    auto times = scan();
+    for (const auto &[path, time] : times) {
+      auto it = modified_.find(path);
+      if (it == modified_.end() || it->second != time) {
+        changed.push_back(path);
+      }
+    }
+    for (const auto &[path, time] : modified_) {
+      if (!times.count(path)) {
+        changed.push_back(path);
+      }
+    }
+    modified_ = std::move(times);
+  }
+
+  std::sort(changed.begin(), changed.end());
+  changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+  return changed;
+}
+
+} // namespace driver
@@ -0,0 +1,81 @@
+/*****************************************************************************
+ * File: file_watcher.h
+ * Description: Notifications of changed source files, for watch mode
+ *****************************************************************************/
+
+#pragma once
+#include "core/common/macros.h"
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace driver {
+
+/**
+ * @class FileWatcher
+ * @brief Waits for .tspp files under watched paths to change
+ *
+ * On Linux the watcher is notified by inotify and costs nothing while the
+ * files are left alone. Directories are watched rather than files, since
+ * editors often save by writing a new file and renaming it over the old
+ * one; directories created under a watched one are watched too. Elsewhere
+ * the watched paths are scanned for new modification times twice a second.
+ *
+ * A save is often several events in a row, so wait() only returns once no
+ * event came for a short while, with every file that changed meanwhile.
+ */
+class FileWatcher {
+public:
+  FileWatcher();
+  ~FileWatcher();
+  NON_COPYABLE(FileWatcher);
+
+  /**
+   * @brief Watches a source file, or every source file under a directory
+   * @param path The file or directory
+   * @return True if the path can be watched; see getLastError() otherwise
+   */
+  bool watch(const std::string &path);
+
+  /**
+   * @brief Blocks until watched source files change
+   * @return The paths of the changed, added and removed files, sorted;
+   *         empty if waiting failed, see getLastError()
+   */
+  std::vector<std::string> wait();
+
+  /**
+   * @brief Gets the message of the most recent failure
+   */
+  const std::string &getLastError() const { return lastError_; }
+
+private:
+  // A directory being watched, for every file in it or for some only
+  struct Directory {
+    std::filesystem::path path;
+    bool all = false; ///< Whether any source file in it counts
+  };
+
+  /**
+   * @brief Watches a directory, and those under it if all files count
+   */
+  bool watchDirectory(const std::filesystem::path &directory, bool all);
+
+  /**
+   * @brief Gets the source files under the watched paths and their times
+   */
+  std::unordered_map<std::string, std::filesystem::file_time_type>
+  scan() const;
+
+  int fd_ = -1; ///< inotify instance, -1 where there is none
+  std::unordered_map<int, Directory> directories_; ///< By watch descriptor
+  std::unordered_set<std::string> files_; ///< Watched alone, not by directory
+  std::vector<std::filesystem::path> roots_; ///< Watched paths, for scanning
+  std::unordered_map<std::string, std::filesystem::file_time_type>
+      modified_;           ///< Last scan, where inotify is missing
+  std::string lastError_;  ///< Last failure message
+};
+
+} // namespace driver
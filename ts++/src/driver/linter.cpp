@@ -0,0 +1,450 @@
+#include "driver/linter.h"
+#include "core/common/source_manager.h"
+#include "core/common/time_report.h"
+#include "core/utils/file_utils.h"
+#include "parser/nodes/declaration_nodes.h"
+#include "parser/nodes/expression_nodes.h"
+#include "parser/nodes/statement_nodes.h"
+#include "parser/nodes/type_nodes.h"
+#include "llvm/Support/FormatVariadic.h"
+#include "llvm/Support/JSON.h"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <sstream>
+#include <tuple>
+#include <unordered_map>
+
+namespace driver {
+
+using core::utils::FileUtils;
+
+namespace {
+
+using Level = LintMessage::Level;
+
+std::string trim(const std::string &text) {
+  size_t begin = text.find_first_not_of(" \t\r");
+  if (begin == std::string::npos) {
+    return "";
+  }
+  size_t end = text.find_last_not_of(" \t\r");
+  return text.substr(begin, end - begin + 1);
+}
+
+const char *levelName(Level level) {
+  switch (level) {
+  case Level::Error:
+    return "ERROR";
+  case Level::Warning:
+    return "WARNING";
+  case Level::Info:
+    return "INFO";
+  }
+  return "ERROR";
+}
+
+/**
+ * Checks the rules of one file; the AST rules walk its top-level nodes
+ */
+class FileLinter {
+public:
+  FileLinter(const LintConfig &config, std::string path,
+             std::vector<LintMessage> &messages)
+      : config_(config), path_(std::move(path)), messages_(messages) {}
+
+  // W002, E002 and E003, in one pass over the buffer
+  void checkText(std::string_view text) {
+    int braces[2] = {0, 0};
+    int parens[2] = {0, 0};
+    unsigned line = 1;
+    size_t lineStart = 0;
+    char quote = 0;
+    bool blockComment = false;
+    for (size_t i = 0; i <= text.size(); ++i) {
+      if (i == text.size() || text[i] == '\n') {
+        checkLineLength(line, text.substr(lineStart, i - lineStart));
+        ++line;
+        lineStart = i + 1;
+        continue;
+      }
+      char c = text[i];
+      char next = i + 1 < text.size() ? text[i + 1] : '\0';
+      if (blockComment) {
+        if (c == '*' && next == '/') {
+          blockComment = false;
+          ++i;
+        }
+      } else if (quote) {
+        if (c == '\\') {
+          // The escaped character may not be a line end
+          if (next != '\n') {
+            ++i;
+          }
+        } else if (c == quote) {
+          quote = 0;
+        }
+      } else if (c == '/' && next == '/') {
+        while (i + 1 < text.size() && text[i + 1] != '\n') {
+          ++i;
+        }
+      } else if (c == '/' && next == '*') {
+        blockComment = true;
+        ++i;
+      } else if (c == '"' || c == '\'' || c == '`') {
+        quote = c;
+      } else if (c == '{' || c == '}') {
+        ++braces[c == '}'];
+      } else if (c == '(' || c == ')') {
+        ++parens[c == ')'];
+      }
+    }
+
+    if (braces[0] != braces[1]) {
+      add(1, 1, Level::Error, "E002",
+          "Unmatched curly braces: " + std::to_string(braces[0]) +
+              " opening, " + std::to_string(braces[1]) + " closing");
+    }
+    if (parens[0] != parens[1]) {
+      add(1, 1, Level::Error, "E003",
+          "Unmatched parentheses: " + std::to_string(parens[0]) +
+              " opening, " + std::to_string(parens[1]) + " closing");
+    }
+  }
+
+  void checkNode(const nodes::BaseNode *node) {
+    if (auto stmt = nodes::dyn_cast<nodes::StatementNode>(node)) {
+      checkStatement(stmt);
+    } else if (auto decl = nodes::dyn_cast<nodes::DeclarationNode>(node)) {
+      checkDeclaration(decl);
+    }
+  }
+
+private:
+  void add(unsigned line, unsigned column, Level level, const char *code,
+           std::string message) {
+    if (config_.isEnabled(code)) {
+      messages_.push_back(
+          {path_, line, column, level, code, std::move(message)});
+    }
+  }
+
+  void add(const nodes::BaseNode *node, Level level, const char *code,
+           std::string message) {
+    const core::SourceLocation &location = node->getLocation();
+    add(location.getLine(), location.getColumn(), level, code,
+        std::move(message));
+  }
+
+  void checkLineLength(unsigned line, std::string_view text) {
+    size_t end = text.find_last_not_of(" \t\r");
+    size_t length = end == std::string_view::npos ? 0 : end + 1;
+    if (length > config_.maxLineLength) {
+      add(line, config_.maxLineLength + 1, Level::Warning, "W002",
+          "Line too long (" + std::to_string(length) + " > " +
+              std::to_string(config_.maxLineLength) + ")");
+    }
+  }
+
+  // W101 and I001 for the raw pointers a declared type is made of
+  void checkType(const nodes::DeclarationNode *decl,
+                 const nodes::TypeNode *type) {
+    using namespace nodes;
+    while (type) {
+      if (auto pointer = dyn_cast<PointerTypeNode>(type)) {
+        if (pointer->getKind() == PointerTypeNode::PointerKind::Raw &&
+            !unsafe_) {
+          add(decl, Level::Warning, "W101",
+              "Raw pointer used outside unsafe block");
+          add(decl, Level::Info, "I001",
+              "Consider using smart pointers (#shared<T> or #unique<T>) "
+              "instead of raw pointers");
+          return;
+        }
+        type = pointer->getBaseType();
+      } else if (auto array = dyn_cast<ArrayTypeNode>(type)) {
+        type = array->getElementType();
+      } else {
+        return;
+      }
+    }
+  }
+
+  void checkReturnType(const nodes::DeclarationNode *decl,
+                       const nodes::TypeNode *returnType) {
+    if (!returnType) {
+      add(decl, Level::Warning, "W003",
+          "Missing return type for function '" + decl->getName() + "'");
+    }
+  }
+
+  // Types, parameters and body of a function, method or constructor
+  void checkFunction(const nodes::DeclarationNode *decl,
+                     const std::vector<tokens::TokenType> &modifiers,
+                     const std::vector<nodes::ParamPtr> &params,
+                     const nodes::TypeNode *returnType,
+                     const nodes::BlockNode *body) {
+    bool wasUnsafe = unsafe_;
+    unsafe_ = unsafe_ || std::find(modifiers.begin(), modifiers.end(),
+                                   tokens::TokenType::UNSAFE) !=
+                             modifiers.end();
+    checkType(decl, returnType);
+    for (auto param : params) {
+      checkType(param, param->getType());
+    }
+    checkStatement(body);
+    unsafe_ = wasUnsafe;
+  }
+
+  void checkVariable(const nodes::VarDeclNode *var) {
+    if (!var->getType() && config_.enforceTypes) {
+      add(var, Level::Error, "E005",
+          "Missing type annotation for variable '" + var->getName() + "'");
+    }
+    checkType(var, var->getType());
+
+    // Without a placement, arrays and new objects go wherever the
+    // compiler decides
+    auto init = var->getInitializer();
+    tokens::TokenType storage = var->getStorageClass();
+    if (config_.recommendMemoryAttrs && init &&
+        (nodes::isa<nodes::NewExpressionNode>(init) ||
+         nodes::isa<nodes::ArrayLiteralNode>(init)) &&
+        storage != tokens::TokenType::STACK &&
+        storage != tokens::TokenType::HEAP &&
+        storage != tokens::TokenType::STATIC &&
+        storage != tokens::TokenType::COMPTIME) {
+      add(var, Level::Warning, "W104",
+          "Missing memory placement attribute for variable '" +
+              var->getName() + "'");
+    }
+  }
+
+  void checkDeclaration(const nodes::DeclarationNode *decl) {
+    using namespace nodes;
+    if (!decl) {
+      return;
+    }
+    if (auto var = dyn_cast<VarDeclNode>(decl)) {
+      checkVariable(var);
+    } else if (auto function = dyn_cast<FunctionDeclNode>(decl)) {
+      checkReturnType(function, function->getReturnType());
+      checkFunction(function, function->getModifiers(),
+                    function->getParameters(), function->getReturnType(),
+                    function->getBody());
+    } else if (auto method = dyn_cast<MethodDeclNode>(decl)) {
+      checkReturnType(method, method->getReturnType());
+      checkFunction(method, method->getModifiers(), method->getParameters(),
+                    method->getReturnType(), method->getBody());
+    } else if (auto constructor = dyn_cast<ConstructorDeclNode>(decl)) {
+      checkFunction(constructor, {}, constructor->getParameters(), nullptr,
+                    constructor->getBody());
+    } else if (auto property = dyn_cast<PropertyDeclNode>(decl)) {
+      checkType(property, property->getPropertyType());
+      checkStatement(property->getBody());
+    } else if (auto field = dyn_cast<FieldDeclNode>(decl)) {
+      checkType(field, field->getType());
+    } else if (auto classDecl = dyn_cast<ClassDeclNode>(decl)) {
+      for (auto member : classDecl->getMembers()) {
+        checkDeclaration(member);
+      }
+    } else if (auto space = dyn_cast<NamespaceDeclNode>(decl)) {
+      for (auto nested : space->getDeclarations()) {
+        checkDeclaration(nested);
+      }
+    }
+  }
+
+  void checkStatement(const nodes::StatementNode *stmt) {
+    using namespace nodes;
+    if (!stmt) {
+      return;
+    }
+    switch (stmt->getNodeKind()) {
+    case NodeKind::DeclarationStmt:
+      checkDeclaration(cast<DeclarationStmtNode>(stmt)->getDeclaration());
+      break;
+    case NodeKind::Block:
+      for (auto nested : cast<BlockNode>(stmt)->getStatements()) {
+        checkStatement(nested);
+      }
+      break;
+    case NodeKind::IfStmt:
+      checkStatement(cast<IfStmtNode>(stmt)->getThenBranch());
+      checkStatement(cast<IfStmtNode>(stmt)->getElseBranch());
+      break;
+    case NodeKind::WhileStmt:
+      checkStatement(cast<WhileStmtNode>(stmt)->getBody());
+      break;
+    case NodeKind::DoWhileStmt:
+      checkStatement(cast<DoWhileStmtNode>(stmt)->getBody());
+      break;
+    case NodeKind::ForStmt:
+      checkStatement(cast<ForStmtNode>(stmt)->getInitializer());
+      checkStatement(cast<ForStmtNode>(stmt)->getBody());
+      break;
+    case NodeKind::ForOfStmt:
+      checkStatement(cast<ForOfStmtNode>(stmt)->getBody());
+      break;
+    case NodeKind::TryStmt: {
+      auto tryStmt = cast<TryStmtNode>(stmt);
+      checkStatement(tryStmt->getTryBlock());
+      for (const auto &clause : tryStmt->getCatchClauses()) {
+        checkStatement(clause.body);
+      }
+      checkStatement(tryStmt->getFinallyBlock());
+      break;
+    }
+    case NodeKind::SwitchStmt:
+      for (const auto &switchCase : cast<SwitchStmtNode>(stmt)->getCases()) {
+        for (auto nested : switchCase.body) {
+          checkStatement(nested);
+        }
+      }
+      break;
+    case NodeKind::LabeledStatement:
+      checkStatement(cast<LabeledStatementNode>(stmt)->getStatement());
+      break;
+    default:
+      break;
+    }
+  }
+
+  const LintConfig &config_;
+  std::string path_;
+  std::vector<LintMessage> &messages_;
+  bool unsafe_ = false; // Within an #unsafe function or method
+};
+
+} // namespace
+
+bool LintConfig::load(const std::string &path, LintConfig &config,
+                      std::string &error) {
+  auto content = FileUtils::readFile(path);
+  if (!content) {
+    error = "Could not read lint config: " + path;
+    return false;
+  }
+  std::istringstream lines(*content);
+  std::string line;
+  unsigned lineNumber = 0;
+  while (std::getline(lines, line)) {
+    ++lineNumber;
+    line = trim(line);
+    size_t equals = line.find('=');
+    if (line.empty() || line[0] == '#' || equals == std::string::npos) {
+      continue;
+    }
+    std::string key = trim(line.substr(0, equals));
+    std::string value = trim(line.substr(equals + 1));
+    std::string lower = value;
+    std::transform(lower.begin(), lower.end(), lower.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    bool flag = lower == "true" || lower == "yes" || lower == "on";
+
+    if (key == "max_line_length" || key == "indent_size") {
+      unsigned number = 0;
+      const char *end = value.data() + value.size();
+      auto [stop, status] = std::from_chars(value.data(), end, number);
+      if (status != std::errc() || stop != end) {
+        error = path + ":" + std::to_string(lineNumber) + ": " + key +
+                " must be a whole number below 2^32, not '" + value + "'";
+        return false;
+      }
+      (key == "indent_size" ? config.indentSize : config.maxLineLength) =
+          number;
+    } else if (key == "require_semicolons") {
+      config.requireSemicolons = flag;
+    } else if (key == "enforce_types") {
+      config.enforceTypes = flag;
+    } else if (key == "recommend_memory_attrs") {
+      config.recommendMemoryAttrs = flag;
+    } else if (key == "ignored_rules" && value.size() >= 2 &&
+               value.front() == '[' && value.back() == ']') {
+      std::istringstream items(value.substr(1, value.size() - 2));
+      std::string item;
+      while (std::getline(items, item, ',')) {
+        if (!(item = trim(item)).empty()) {
+          config.ignoredRules.insert(item);
+        }
+      }
+    }
+  }
+  return true;
+}
+
+Linter::Linter(LintConfig config, unsigned threads)
+    : config_(std::move(config)), pool_(llvm::hardware_concurrency(threads)) {}
+
+std::vector<LintMessage> Linter::lint(const Compilation &compilation) {
+  auto &sources = core::SourceManager::instance();
+  const auto &files = compilation.getFiles();
+
+  // The program holds every file's top-level nodes, in input order
+  std::unordered_map<core::FileId, std::vector<const nodes::BaseNode *>>
+      nodesOf;
+  for (const auto &node : compilation.getAST().getNodes()) {
+    nodesOf[node->getLocation().getFileId()].push_back(node);
+  }
+
+  std::vector<std::vector<LintMessage>> results(files.size());
+  for (size_t i = 0; i < files.size(); ++i) {
+    core::FileId fileId = sources.getFileId(files[i]);
+    const auto *nodes = nodesOf.count(fileId) ? &nodesOf[fileId] : nullptr;
+    pool_.async([this, &sources, &results, &files, i, fileId, nodes] {
+      core::TimeReport::Scope timer("Lint", files[i]);
+      FileLinter linter(config_, files[i], results[i]);
+      linter.checkText(sources.getBuffer(fileId));
+      if (nodes) {
+        for (const auto *node : *nodes) {
+          linter.checkNode(node);
+        }
+      }
+    });
+  }
+  pool_.wait();
+
+  std::vector<LintMessage> messages;
+  for (auto &result : results) {
+    messages.insert(messages.end(), std::make_move_iterator(result.begin()),
+                    std::make_move_iterator(result.end()));
+  }
+  std::stable_sort(messages.begin(), messages.end(),
+                   [](const LintMessage &a, const LintMessage &b) {
+                     return std::tie(a.file, a.line, a.column) <
+                            std::tie(b.file, b.line, b.column);
+                   });
+  return messages;
+}
+
+void Linter::print(const std::vector<LintMessage> &messages,
+                   std::ostream &out, bool json) {
+  if (!json) {
+    for (const auto &message : messages) {
+      out << message.file << ":" << message.line << ":" << message.column
+          << " - " << levelName(message.level) << " " << message.code << ": "
+          << message.message << "\n";
+    }
+    return;
+  }
+
+  llvm::json::Array array;
+  for (const auto &message : messages) {
+    array.push_back(llvm::json::Object{{"file", message.file},
+                                       {"line", message.line},
+                                       {"column", message.column},
+                                       {"level", levelName(message.level)},
+                                       {"code", message.code},
+                                       {"message", message.message}});
+  }
+  out << llvm::formatv("{0:2}", llvm::json::Value(std::move(array))).str()
+      << "\n";
+}
+
+bool Linter::hasErrors(const std::vector<LintMessage> &messages) {
+  return std::any_of(messages.begin(), messages.end(), [](const auto &m) {
+    return m.level == LintMessage::Level::Error;
+  });
+}
+
+} // namespace driver
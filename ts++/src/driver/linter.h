@@ -0,0 +1,104 @@
+/*****************************************************************************
+ * File: linter.h
+ * Description: Style and safety rules checked over the parsed program
+ *****************************************************************************/
+
+#pragma once
+#include "driver/compilation.h"
+#include "llvm/Support/ThreadPool.h"
+#include <ostream>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace driver {
+
+/**
+ * @brief Options of the linter, as tspp_lint.conf sets them
+ */
+struct LintConfig {
+  unsigned maxLineLength = 100;
+  unsigned indentSize = 4;
+  bool requireSemicolons = true;
+  bool enforceTypes = true;         // E005
+  bool recommendMemoryAttrs = true; // W104
+  std::set<std::string> ignoredRules;
+
+  /**
+   * @brief Reads a configuration file
+   *
+   * Lines are `key = value`, where a value is an integer, true or false,
+   * or a list such as [W002, I004]. Blank lines and lines starting with
+   * '#' are skipped, and so are keys the linter does not know.
+   *
+   * @param path Path of the file
+   * @param config Configuration the file's settings are written into
+   * @param error Set to what is wrong when false is returned
+   * @return True if the file could be read and its numbers are unsigned
+   *         ints
+   */
+  static bool load(const std::string &path, LintConfig &config,
+                   std::string &error);
+
+  bool isEnabled(const std::string &code) const {
+    return !ignoredRules.count(code);
+  }
+};
+
+struct LintMessage {
+  enum class Level { Error, Warning, Info };
+
+  std::string file;
+  unsigned line = 0;
+  unsigned column = 0;
+  Level level = Level::Warning;
+  std::string code; // e.g. "W003"
+  std::string message;
+};
+
+/**
+ * @class Linter
+ * @brief Checks the rules of tools/linter over the compiler's own AST
+ *
+ * The rules of the Python linter are checked against what the parser
+ * read rather than against regular expressions over lines:
+ *
+ *  - E002, E003: unbalanced braces and parentheses, outside comments and
+ *    string literals
+ *  - E005: a variable declared without a type
+ *  - W002: a line longer than maxLineLength
+ *  - W003: a function or method declared without a return type
+ *  - W101, I001: a raw pointer type outside an #unsafe function
+ *  - W104: a variable initialized by new or an array literal without
+ *    #stack, #heap or #static
+ *
+ * Each file is checked as a task of its own on a thread pool, over the
+ * nodes and buffer Compilation::parse() left, so linting costs little
+ * more than parsing. Messages are sorted by file, line and column.
+ */
+class Linter {
+public:
+  Linter(LintConfig config, unsigned threads);
+
+  /**
+   * @brief Checks every file of a parsed compilation
+   * @param compilation A compilation parse() was run on
+   * @return The messages, sorted by file, line and column
+   */
+  std::vector<LintMessage> lint(const Compilation &compilation);
+
+  /**
+   * @brief Writes messages as `file:line:column - LEVEL CODE: message`
+   * lines, or as a JSON array
+   */
+  static void print(const std::vector<LintMessage> &messages,
+                    std::ostream &out, bool json);
+
+  static bool hasErrors(const std::vector<LintMessage> &messages);
+
+private:
+  LintConfig config_;
+  llvm::ThreadPool pool_;
+};
+
+} // namespace driver
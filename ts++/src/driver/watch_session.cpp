@@ -0,0 +1,131 @@
+#include "driver/watch_session.h"
+#include "codegen/llvm/llvm_parallel_code_gen.h"
+#include "driver/dependency_graph.h"
+#include "driver/file_watcher.h"
+#include <iostream>
+#include <unordered_set>
+
+namespace driver {
+
+WatchSession::WatchSession(core::ErrorReporter &errorReporter,
+                           Compilation &compilation,
+                           const codegen::CodeGenOptions &options, bool run)
+    : errorReporter_(errorReporter), compilation_(compilation),
+      options_(options), run_(run) {}
+
+int WatchSession::watch(const std::vector<std::string> &inputs) {
+  // Directories are watched for new files too; a manifest's files by name
+  FileWatcher watcher;
+  std::vector<std::string> paths;
+  for (const auto &input : inputs) {
+    if (input[0] != '@') {
+      paths.push_back(input);
+    }
+  }
+  paths.insert(paths.end(), compilation_.getFiles().begin(),
+               compilation_.getFiles().end());
+  for (const auto &path : paths) {
+    if (!watcher.watch(path)) {
+      std::cerr << "Error: " << watcher.getLastError() << "\n";
+      return 1;
+    }
+  }
+
+  build();
+  errorReporter_.flush();
+  while (true) {
+    std::cout << "Watching for changes..." << std::endl;
+    std::vector<std::string> changed;
+    do {
+      changed = watcher.wait();
+      if (changed.empty()) {
+        std::cerr << "Error: " << watcher.getLastError() << "\n";
+        return 1;
+      }
+    } while (!compilation_.update());
+
+    std::cout << "Changed:";
+    for (const auto &path : changed) {
+      std::cout << " " << path;
+    }
+    std::cout << std::endl;
+    errorReporter_.clear();
+    build();
+    errorReporter_.flush();
+  }
+}
+
+bool WatchSession::build() {
+  if (compilation_.getFiles().empty()) {
+    std::cerr << "Error: No source files left to compile\n";
+    return false;
+  }
+  if (!compilation_.parse()) {
+    return false;
+  }
+
+  // Functions whose bitcode the last build kept are not checked again
+  DependencyGraph graph(compilation_.getAST());
+  std::unordered_map<const nodes::FunctionDeclNode *, std::string> fingerprints;
+  std::unordered_map<const nodes::FunctionDeclNode *, std::string> reused;
+  std::unordered_set<const nodes::BaseNode *> unchecked;
+  std::unordered_map<std::string, std::string> kept;
+  for (const auto *function : graph.getFunctions()) {
+    std::string fingerprint = graph.getFingerprint(function);
+    auto it = bitcode_.find(fingerprint);
+    if (it != bitcode_.end()) {
+      reused.emplace(function, it->second);
+      unchecked.insert(function);
+      kept.emplace(fingerprint, it->second);
+    }
+    fingerprints.emplace(function, std::move(fingerprint));
+  }
+  compilation_.setReused(std::move(unchecked));
+  if (!compilation_.check()) {
+    return false;
+  }
+
+  const auto &ast = compilation_.getAST();
+  if (ast.getNodes().empty()) {
+    return true;
+  }
+  codegen::LLVMParallelCodeGen codeGen(errorReporter_, options_);
+  for (const auto &import : compilation_.getImports()) {
+    codeGen.addImport(import);
+  }
+  size_t reusedCount = reused.size();
+  codeGen.setFunctionCaching(std::move(reused));
+  if (!codeGen.generateCode(ast)) {
+    errorReporter_.flush();
+    std::cerr << "Code generation failed." << std::endl;
+    return false;
+  }
+
+  std::cout << "Regenerated " << fingerprints.size() - reusedCount << " of "
+            << fingerprints.size() << " functions" << std::endl;
+  bool success;
+  if (run_) {
+    errorReporter_.flush();
+    success = codeGen.executeCode();
+  } else {
+    success = codeGen.writeToFile(options_.getOutputFilename());
+    if (success) {
+      std::cout << "Output written to " << options_.getOutputFilename()
+                << std::endl;
+    }
+  }
+  if (!success) {
+    std::cerr << (run_ ? "Execution failed." : "Failed to write output file.")
+              << std::endl;
+    return false;
+  }
+
+  // Only the bitcode of the functions of this build is worth keeping
+  for (const auto &[function, bitcode] : codeGen.getGeneratedFunctions()) {
+    kept[fingerprints.at(function)] = bitcode;
+  }
+  bitcode_ = std::move(kept);
+  return true;
+}
+
+} // namespace driver
@@ -0,0 +1,65 @@
+/*****************************************************************************
+ * File: watch_session.h
+ * Description: Rebuilds a program whenever one of its files is saved
+ *****************************************************************************/
+
+#pragma once
+#include "codegen/codegen_options.h"
+#include "core/diagnostics/error_reporter.h"
+#include "driver/compilation.h"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace driver {
+
+/**
+ * @class WatchSession
+ * @brief Keeps a compilation in memory and rebuilds it on every change
+ *
+ * The first build compiles everything. After that, a FileWatcher reports
+ * saved files, and only those are lexed and parsed again; the tokens and
+ * ASTs of the others stay in memory. Functions are fingerprinted as for
+ * -incremental builds, and the bitcode of each is kept in memory rather
+ * than in the cache directory, so only functions whose fingerprint changed
+ * are type-checked and generated again.
+ *
+ * Each build writes the output, or with run set, runs main in a fresh JIT
+ * session of this process, so the program is reloaded without restarting
+ * the compiler. A build that fails leaves the last output in place.
+ */
+class WatchSession {
+public:
+  /**
+   * @brief Constructs a session
+   * @param errorReporter Reporter every build reports into
+   * @param compilation The program, with its inputs added
+   * @param options Code generation options, including the output file
+   * @param run Whether to run main instead of writing the output
+   */
+  WatchSession(core::ErrorReporter &errorReporter, Compilation &compilation,
+               const codegen::CodeGenOptions &options, bool run);
+
+  /**
+   * @brief Builds, then rebuilds after every change until interrupted
+   * @param inputs The inputs as given on the command line
+   * @return The exit status, should watching fail
+   */
+  int watch(const std::vector<std::string> &inputs);
+
+private:
+  /**
+   * @brief Brings the program up to date with its files
+   * @return True if the output was written or main ran
+   */
+  bool build();
+
+  core::ErrorReporter &errorReporter_; ///< Diagnostics of every build
+  Compilation &compilation_;           ///< Files kept between builds
+  codegen::CodeGenOptions options_;    ///< Output and optimization options
+  bool run_;                           ///< Run main rather than write
+  std::unordered_map<std::string, std::string>
+      bitcode_; ///< Of the last build's functions, by fingerprint
+};
+
+} // namespace driver
@@ -4,6 +4,10 @@
  *****************************************************************************/
 
 #include "lexer.h"
+#include "line_split.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
 
 namespace lexer {
 
@@ -12,6 +16,13 @@ Lexer::Lexer(std::string source, std::string filename)
           std::make_shared<LexerState>(std::move(source), std::move(filename))),
       scanner_(state_) {}
 
+Lexer::Lexer(core::FileId fileId)
+    : state_(std::make_shared<LexerState>(fileId)), scanner_(state_) {}
+
+Lexer::Lexer(core::FileId fileId, std::uint32_t begin, std::uint32_t end)
+    : state_(std::make_shared<LexerState>(fileId, begin, end)),
+      scanner_(state_) {}
+
 std::vector<tokens::Token> Lexer::tokenize() {
   while (!state_->isAtEnd()) {
     tokens::Token token = scanner_.scanToken();
@@ -28,7 +39,107 @@ std::vector<tokens::Token> Lexer::tokenize() {
     }
   }
 
-  return state_->getTokens();
+  return state_->takeTokens();
+}
+
+tokens::Token Lexer::next() {
+  // A line break may add a semicolon before the token it precedes
+  while (!state_->hasTokens()) {
+    if (finished_ || state_->isAtEnd()) {
+      finished_ = true;
+      return tokens::Token::createSynthetic(
+          tokens::TokenType::END_OF_FILE, state_->getFileId(),
+          static_cast<std::uint32_t>(state_->getSource().size()));
+    }
+
+    tokens::Token token = scanner_.scanToken();
+    if (token.isError()) {
+      addError(token);
+      continue;
+    }
+    finished_ = token.getType() == tokens::TokenType::END_OF_FILE;
+    state_->addToken(token);
+  }
+  return state_->takeToken();
+}
+
+tokens::TokenStream Lexer::stream(core::FileId fileId) {
+  auto lexer = std::make_shared<Lexer>(fileId);
+  return tokens::TokenStream([lexer] { return lexer->next(); });
+}
+
+std::vector<tokens::Token> Lexer::tokenizeInChunks(core::FileId fileId,
+                                                   size_t chunkBytes,
+                                                   const Spawn &spawn) {
+  std::string_view source = core::SourceManager::instance().getBuffer(fileId);
+  std::vector<std::uint32_t> starts = findLineSplits(source, chunkBytes);
+  if (starts.size() == 1) {
+    return Lexer(fileId).tokenize();
+  }
+
+  // Shared with the spawned tasks, which may only start once the chunks
+  // are done
+  struct Chunks {
+    std::vector<std::uint32_t> starts;
+    std::uint32_t end;
+    std::vector<std::vector<tokens::Token>> tokens;
+    std::vector<char> endedInComment;
+    std::atomic<size_t> next{0};
+    size_t finished = 0;
+    std::mutex mutex;
+    std::condition_variable allFinished;
+  };
+  auto chunks = std::make_shared<Chunks>();
+  const size_t count = starts.size();
+  chunks->starts = std::move(starts);
+  chunks->end = static_cast<std::uint32_t>(source.size());
+  chunks->tokens.resize(count);
+  chunks->endedInComment.resize(count);
+
+  auto lexChunks = [chunks, fileId, count] {
+    for (size_t i; (i = chunks->next++) < count;) {
+      std::uint32_t end = i + 1 < count ? chunks->starts[i + 1] : chunks->end;
+      Lexer lexer(fileId, chunks->starts[i], end);
+      std::vector<tokens::Token> tokens = lexer.tokenize();
+      if (i + 1 < count && !tokens.empty() && tokens.back().isEOF()) {
+        tokens.pop_back();
+      }
+
+      std::lock_guard<std::mutex> lock(chunks->mutex);
+      chunks->tokens[i] = std::move(tokens);
+      chunks->endedInComment[i] = lexer.state_->hasUnterminatedComment();
+      if (++chunks->finished == count) {
+        chunks->allFinished.notify_all();
+      }
+    }
+  };
+  for (size_t i = 1; i < count; ++i) {
+    spawn(lexChunks);
+  }
+  lexChunks();
+  {
+    std::unique_lock<std::mutex> lock(chunks->mutex);
+    chunks->allFinished.wait(lock,
+                             [&] { return chunks->finished == count; });
+  }
+
+  // A cut inside a block comment the pre-pass missed changes the tokens
+  for (size_t i = 0; i + 1 < count; ++i) {
+    if (chunks->endedInComment[i]) {
+      return Lexer(fileId).tokenize();
+    }
+  }
+
+  size_t total = 0;
+  for (const auto &tokens : chunks->tokens) {
+    total += tokens.size();
+  }
+  std::vector<tokens::Token> tokens;
+  tokens.reserve(total);
+  for (auto &chunk : chunks->tokens) {
+    tokens.insert(tokens.end(), chunk.begin(), chunk.end());
+  }
+  return tokens;
 }
 
 void Lexer::addError(const tokens::Token &token) {
@@ -6,6 +6,8 @@
 #pragma once
 #include "scanner/token_scanner.h"
 #include "state/lexer_state.h"
+#include "tokens/stream/token_stream.h"
+#include <functional>
 #include <memory>
 #include <string>
 #include <vector>
@@ -16,9 +18,36 @@ class Lexer {
 public:
   explicit Lexer(std::string source, std::string filename = "");
 
+  // Tokenize a buffer registered with the SourceManager without copying it
+  explicit Lexer(core::FileId fileId);
+
+  // Tokenize only [begin, end) of a registered buffer, such as a body
+  // whose parsing was deferred
+  Lexer(core::FileId fileId, std::uint32_t begin, std::uint32_t end);
+
   // Process source and return all tokens
   std::vector<tokens::Token> tokenize();
 
+  // Lex just the next token, for parsing while lexing. Returns
+  // END_OF_FILE at the end of the source, and again on every later call.
+  tokens::Token next();
+
+  // A token stream that lexes the buffer as the parser reads it, so only
+  // the tokens within the parser's lookahead are held at a time
+  static tokens::TokenStream stream(core::FileId fileId);
+
+  // Runs a task on another thread
+  using Spawn = std::function<void(std::function<void()>)>;
+
+  // Tokenize a registered buffer in chunks split at line breaks (see
+  // findLineSplits), lexed on the calling thread and on tasks it spawns,
+  // with the same result as tokenize(). Chunks are claimed from a counter,
+  // so the caller never waits on a task that has not started; a spawned
+  // task that finds no chunk left returns at once.
+  static std::vector<tokens::Token>
+  tokenizeInChunks(core::FileId fileId, size_t chunkBytes,
+                   const Spawn &spawn);
+
   // Get any lexical errors that occurred
   const std::vector<std::string> &getErrors() const { return errors_; }
 
@@ -29,6 +58,7 @@ private:
   std::shared_ptr<LexerState> state_;
   TokenScanner scanner_;
   std::vector<std::string> errors_;
+  bool finished_ = false; // next() has returned END_OF_FILE
 
   void addError(const tokens::Token &token);
 };
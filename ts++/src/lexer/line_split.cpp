@@ -0,0 +1,62 @@
+/*****************************************************************************
+ * File: line_split.cpp
+ * Description: Pre-pass finding line breaks outside comments and literals
+ *****************************************************************************/
+
+#include "line_split.h"
+#include "patterns/simd_scan.h"
+
+namespace lexer {
+
+std::vector<std::uint32_t> findLineSplits(std::string_view source,
+                                          size_t chunkBytes) {
+  std::vector<std::uint32_t> starts{0};
+  const char *data = source.data();
+  const size_t size = source.size();
+  size_t target = chunkBytes;
+  size_t i = 0;
+  while (chunkBytes > 0 && target < size) {
+    i += scan::findAnyByte(data + i, size - i, '\n', '"', '\'', '/');
+    if (i >= size) {
+      break;
+    }
+
+    const char c = data[i];
+    const char next = i + 1 < size ? data[i + 1] : '\0';
+    if (c == '\n') {
+      if (++i >= target && i < size) {
+        starts.push_back(static_cast<std::uint32_t>(i));
+        target = i + chunkBytes;
+      }
+    } else if (c == '/' && next == '/') {
+      // The line break ending the comment is seen on the next step
+      i += scan::findByte(data + i, size - i, '\n');
+    } else if (c == '/' && next == '*') {
+      for (i += 2; i < size; ++i) {
+        i += scan::findByte(data + i, size - i, '*');
+        if (i + 1 < size && data[i + 1] == '/') {
+          i += 2;
+          break;
+        }
+      }
+    } else if (c == '/') {
+      ++i;
+    } else {
+      // A literal ends at its quote, or unterminated at the line break
+      for (++i; i < size;) {
+        i += scan::findAnyByte(data + i, size - i, c, '\\', '\n', c);
+        if (i >= size || data[i] == '\n') {
+          break;
+        }
+        if (data[i] == c) {
+          ++i;
+          break;
+        }
+        i += i + 1 < size && data[i + 1] != '\n' ? 2 : 1;
+      }
+    }
+  }
+  return starts;
+}
+
+} // namespace lexer
@@ -0,0 +1,36 @@
+/*****************************************************************************
+ * File: line_split.h
+ * Description: Splits a source buffer at line breaks for parallel lexing
+ *****************************************************************************/
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace lexer {
+
+/**
+ * @brief Finds line starts a large buffer can be lexed from independently
+ *
+ * Tokens never span a line break, except inside a block comment: strings
+ * and character literals end at one, with an error if unterminated. So
+ * after a line break outside a block comment the lexer is back in its
+ * initial state; the semicolon a line break may insert belongs to the
+ * line before. A pre-pass finds such line breaks by skipping from quote,
+ * slash and line break to the next in blocks, tracking only whether it is
+ * in a string, a character literal or a comment.
+ *
+ * The pass does not reproduce the lexer's error recovery inside literals,
+ * so a cut is only a candidate: Lexer::tokenizeInChunks confirms that the
+ * chunk before each cut did not end in a block comment.
+ *
+ * @param source The buffer
+ * @param chunkBytes Bytes a chunk should have at least
+ * @return The offset every chunk starts at, starting with 0
+ */
+std::vector<std::uint32_t> findLineSplits(std::string_view source,
+                                          size_t chunkBytes);
+
+} // namespace lexer
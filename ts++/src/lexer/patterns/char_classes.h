@@ -0,0 +1,144 @@
+// char_classes.h
+/**
+ * @file char_classes.h
+ * @brief Byte classification for the scanners, one table load per test
+ *
+ * The <cctype> functions follow the C locale, take an int that must not
+ * be a negative char, and are calls the scanners' loops cannot see
+ * through. Every byte's classes are instead a constant bit set:
+ * - Identifier start and continuation, ASCII letters, digits and '_'
+ * - Decimal and hexadecimal digits
+ * - Blanks (space, tab, CR, VT, FF) and the newline, kept apart for line
+ *   tracking
+ * - Bytes an operator may start with, and the two halves of two-byte
+ *   operators
+ *
+ * Identifiers may also hold any non-ASCII character. UTF-8 lead bytes
+ * have a class of their own, which the identifier tests include, and
+ * utf8Length() confirms that a whole, well-formed sequence follows; ASCII
+ * never leaves the table.
+ */
+
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace lexer {
+namespace chars {
+
+enum Class : std::uint16_t {
+  kIdentifierStart = 1 << 0, // ASCII only, as are the other classes
+  kIdentifierPart = 1 << 1,
+  kDigit = 1 << 2,
+  kHexDigit = 1 << 3,
+  kBlank = 1 << 4,
+  kNewline = 1 << 5,
+  kOperatorStart = 1 << 6,
+  kCompoundFirst = 1 << 7,  // May begin a two-byte operator
+  kCompoundSecond = 1 << 8, // May end one
+  kUtf8Lead = 1 << 9,       // Begins a multi-byte UTF-8 sequence
+};
+
+namespace detail {
+
+constexpr void mark(std::array<std::uint16_t, 256> &table,
+                    std::string_view bytes, std::uint16_t classes) {
+  for (char c : bytes) {
+    table[static_cast<unsigned char>(c)] |= classes;
+  }
+}
+
+constexpr std::array<std::uint16_t, 256> buildTable() {
+  std::array<std::uint16_t, 256> table{};
+  for (int c = 'a'; c <= 'z'; ++c) {
+    table[c] |= kIdentifierStart | kIdentifierPart;
+    table[c - 'a' + 'A'] |= kIdentifierStart | kIdentifierPart;
+  }
+  mark(table, "_", kIdentifierStart | kIdentifierPart);
+  mark(table, "0123456789", kDigit | kHexDigit | kIdentifierPart);
+  mark(table, "abcdefABCDEF", kHexDigit);
+  mark(table, " \t\r\v\f", kBlank);
+  mark(table, "\n", kNewline);
+  mark(table, "+-*/%&|^~!<>=?:.@#{}()[]", kOperatorStart);
+  mark(table, "+-*/%&|^<>=!.", kCompoundFirst);
+  mark(table, "+-*/%&|^<>=!.?:", kCompoundSecond);
+
+  // C0 and C1 would start overlong forms, F5 and up code points past
+  // U+10FFFF
+  for (int c = 0xC2; c <= 0xF4; ++c) {
+    table[c] |= kUtf8Lead;
+  }
+  return table;
+}
+
+} // namespace detail
+
+inline constexpr std::array<std::uint16_t, 256> kTable = detail::buildTable();
+
+/**
+ * @brief Tests whether a byte is in any of the given classes
+ */
+constexpr bool is(char c, std::uint16_t classes) {
+  return (kTable[static_cast<unsigned char>(c)] & classes) != 0;
+}
+
+// Non-ASCII identifier characters pass on their lead byte alone
+constexpr bool isIdentifierStart(char c) {
+  return is(c, kIdentifierStart | kUtf8Lead);
+}
+constexpr bool isIdentifierPart(char c) {
+  return is(c, kIdentifierPart | kUtf8Lead);
+}
+constexpr bool isDigit(char c) { return is(c, kDigit); }
+constexpr bool isHexDigit(char c) { return is(c, kHexDigit); }
+constexpr bool isBlank(char c) { return is(c, kBlank); }
+constexpr bool isWhitespace(char c) { return is(c, kBlank | kNewline); }
+
+/**
+ * @brief Length of the well-formed UTF-8 sequence of a non-ASCII code
+ * point at data, or 0 if there is none
+ *
+ * Overlong forms, surrogates and code points past U+10FFFF are rejected,
+ * as are sequences cut short by the end of the input.
+ */
+constexpr std::size_t utf8Length(const char *data, std::size_t length) {
+  if (length == 0 || !is(data[0], kUtf8Lead)) {
+    return 0;
+  }
+  auto byte = [&](std::size_t i) {
+    return static_cast<unsigned char>(data[i]);
+  };
+  unsigned char lead = byte(0);
+  std::size_t size = lead < 0xE0 ? 2 : lead < 0xF0 ? 3 : 4;
+  if (length < size) {
+    return 0;
+  }
+
+  // The second byte's range depends on the lead; later ones are plain
+  // continuation bytes
+  unsigned char low = 0x80;
+  unsigned char high = 0xBF;
+  if (lead == 0xE0) {
+    low = 0xA0;
+  } else if (lead == 0xED) {
+    high = 0x9F;
+  } else if (lead == 0xF0) {
+    low = 0x90;
+  } else if (lead == 0xF4) {
+    high = 0x8F;
+  }
+  if (byte(1) < low || byte(1) > high) {
+    return 0;
+  }
+  for (std::size_t i = 2; i < size; ++i) {
+    if (byte(i) < 0x80 || byte(i) > 0xBF) {
+      return 0;
+    }
+  }
+  return size;
+}
+
+} // namespace chars
+} // namespace lexer
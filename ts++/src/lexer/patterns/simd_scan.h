@@ -0,0 +1,346 @@
+// simd_scan.h
+/**
+ * @file simd_scan.h
+ * @brief Block-at-a-time character run scanning for the lexer hot loops
+ *
+ * Classifies 16 (SSE2/NEON) or 32 (AVX2) bytes per step:
+ * - Blank runs (space, tab, CR, VT, FF; newlines are left to the caller)
+ * - Identifier continuation runs [A-Za-z0-9_]
+ * - Searches for one, two or four delimiter bytes ('\n', '*', quotes)
+ * - Byte counting for tab-aware column tracking
+ *
+ * The instruction set is chosen at compile time; targets without a vector
+ * unit use the scalar tail loop for the whole input.
+ */
+
+#pragma once
+#include "lexer/patterns/char_classes.h"
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define TSPP_SCAN_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define TSPP_SCAN_SSE2 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define TSPP_SCAN_NEON 1
+#endif
+
+namespace lexer {
+namespace scan {
+
+/*****************************************************************************
+ * Scalar Character Classes
+ *****************************************************************************/
+inline bool isBlank(char c) { return chars::isBlank(c); }
+
+// ASCII only, like the vector classifier; UTF-8 is left to the caller
+inline bool isIdentifierChar(char c) {
+  return chars::is(c, chars::kIdentifierPart);
+}
+
+namespace detail {
+
+/*****************************************************************************
+ * Vector Block Classifiers
+ *
+ * Each classifier returns a mask with kBitsPerByte set bits for every byte
+ * of the block that belongs to the class.
+ *****************************************************************************/
+#if defined(TSPP_SCAN_AVX2)
+using Mask = std::uint32_t;
+constexpr std::size_t kBlockSize = 32;
+constexpr unsigned kBitsPerByte = 1;
+
+inline __m256i load(const char *p) {
+  return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+}
+inline Mask toMask(__m256i v) {
+  return static_cast<Mask>(_mm256_movemask_epi8(v));
+}
+inline __m256i eq(__m256i v, char c) {
+  return _mm256_cmpeq_epi8(v, _mm256_set1_epi8(c));
+}
+inline __m256i inRange(__m256i v, char lo, char hi) {
+  return _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8(lo - 1)),
+                          _mm256_cmpgt_epi8(_mm256_set1_epi8(hi + 1), v));
+}
+
+inline Mask blankMask(const char *p) {
+  __m256i v = load(p);
+  __m256i m = _mm256_or_si256(
+      _mm256_or_si256(eq(v, ' '), eq(v, '\t')),
+      _mm256_or_si256(eq(v, '\r'), _mm256_or_si256(eq(v, '\v'), eq(v, '\f'))));
+  return toMask(m);
+}
+inline Mask identifierMask(const char *p) {
+  __m256i v = load(p);
+  __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+  __m256i m = _mm256_or_si256(
+      _mm256_or_si256(inRange(lower, 'a', 'z'), inRange(v, '0', '9')),
+      eq(v, '_'));
+  return toMask(m);
+}
+inline Mask byteMask(const char *p, char c) { return toMask(eq(load(p), c)); }
+inline Mask byteMask(const char *p, char a, char b) {
+  __m256i v = load(p);
+  return toMask(_mm256_or_si256(eq(v, a), eq(v, b)));
+}
+inline Mask byteMask(const char *p, char a, char b, char c, char d) {
+  __m256i v = load(p);
+  return toMask(_mm256_or_si256(_mm256_or_si256(eq(v, a), eq(v, b)),
+                                _mm256_or_si256(eq(v, c), eq(v, d))));
+}
+
+#elif defined(TSPP_SCAN_SSE2)
+using Mask = std::uint32_t;
+constexpr std::size_t kBlockSize = 16;
+constexpr unsigned kBitsPerByte = 1;
+
+inline __m128i load(const char *p) {
+  return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+}
+inline Mask toMask(__m128i v) {
+  return static_cast<Mask>(_mm_movemask_epi8(v));
+}
+inline __m128i eq(__m128i v, char c) {
+  return _mm_cmpeq_epi8(v, _mm_set1_epi8(c));
+}
+inline __m128i inRange(__m128i v, char lo, char hi) {
+  return _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(lo - 1)),
+                       _mm_cmplt_epi8(v, _mm_set1_epi8(hi + 1)));
+}
+
+inline Mask blankMask(const char *p) {
+  __m128i v = load(p);
+  __m128i m = _mm_or_si128(
+      _mm_or_si128(eq(v, ' '), eq(v, '\t')),
+      _mm_or_si128(eq(v, '\r'), _mm_or_si128(eq(v, '\v'), eq(v, '\f'))));
+  return toMask(m);
+}
+inline Mask identifierMask(const char *p) {
+  __m128i v = load(p);
+  __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+  __m128i m = _mm_or_si128(
+      _mm_or_si128(inRange(lower, 'a', 'z'), inRange(v, '0', '9')),
+      eq(v, '_'));
+  return toMask(m);
+}
+inline Mask byteMask(const char *p, char c) { return toMask(eq(load(p), c)); }
+inline Mask byteMask(const char *p, char a, char b) {
+  __m128i v = load(p);
+  return toMask(_mm_or_si128(eq(v, a), eq(v, b)));
+}
+inline Mask byteMask(const char *p, char a, char b, char c, char d) {
+  __m128i v = load(p);
+  return toMask(_mm_or_si128(_mm_or_si128(eq(v, a), eq(v, b)),
+                             _mm_or_si128(eq(v, c), eq(v, d))));
+}
+
+#elif defined(TSPP_SCAN_NEON)
+// NEON has no movemask; narrowing gives 4 bits per byte instead
+using Mask = std::uint64_t;
+constexpr std::size_t kBlockSize = 16;
+constexpr unsigned kBitsPerByte = 4;
+
+inline uint8x16_t load(const char *p) {
+  return vld1q_u8(reinterpret_cast<const std::uint8_t *>(p));
+}
+inline Mask toMask(uint8x16_t v) {
+  uint8x8_t narrowed = vshrn_n_u16(vreinterpretq_u16_u8(v), 4);
+  return vget_lane_u64(vreinterpret_u64_u8(narrowed), 0);
+}
+inline uint8x16_t eq(uint8x16_t v, char c) {
+  return vceqq_u8(v, vdupq_n_u8(static_cast<std::uint8_t>(c)));
+}
+inline uint8x16_t inRange(uint8x16_t v, char lo, char hi) {
+  // Unsigned wrap-around turns the range test into a single compare
+  uint8x16_t offset = vsubq_u8(v, vdupq_n_u8(static_cast<std::uint8_t>(lo)));
+  return vcleq_u8(offset, vdupq_n_u8(static_cast<std::uint8_t>(hi - lo)));
+}
+
+inline Mask blankMask(const char *p) {
+  uint8x16_t v = load(p);
+  // '\t'..'\r' also covers '\n'; clear it so the caller sees newlines
+  uint8x16_t m = vbicq_u8(vorrq_u8(eq(v, ' '), inRange(v, '\t', '\r')),
+                          eq(v, '\n'));
+  return toMask(m);
+}
+inline Mask identifierMask(const char *p) {
+  uint8x16_t v = load(p);
+  uint8x16_t lower = vorrq_u8(v, vdupq_n_u8(0x20));
+  uint8x16_t m = vorrq_u8(
+      vorrq_u8(inRange(lower, 'a', 'z'), inRange(v, '0', '9')), eq(v, '_'));
+  return toMask(m);
+}
+inline Mask byteMask(const char *p, char c) { return toMask(eq(load(p), c)); }
+inline Mask byteMask(const char *p, char a, char b) {
+  uint8x16_t v = load(p);
+  return toMask(vorrq_u8(eq(v, a), eq(v, b)));
+}
+inline Mask byteMask(const char *p, char a, char b, char c, char d) {
+  uint8x16_t v = load(p);
+  return toMask(
+      vorrq_u8(vorrq_u8(eq(v, a), eq(v, b)), vorrq_u8(eq(v, c), eq(v, d))));
+}
+#endif
+
+#if defined(TSPP_SCAN_AVX2) || defined(TSPP_SCAN_SSE2) ||                     \
+    defined(TSPP_SCAN_NEON)
+#define TSPP_SCAN_VECTOR 1
+
+constexpr Mask kFullMask =
+    kBitsPerByte * kBlockSize >= sizeof(Mask) * 8
+        ? ~Mask(0)
+        : (Mask(1) << (kBitsPerByte * kBlockSize)) - 1;
+
+inline unsigned countTrailingZeros(Mask mask) {
+#if defined(__GNUC__) || defined(__clang__)
+  return static_cast<unsigned>(__builtin_ctzll(mask));
+#else
+  unsigned count = 0;
+  while (!(mask & 1)) {
+    mask >>= 1;
+    ++count;
+  }
+  return count;
+#endif
+}
+
+inline unsigned popCount(Mask mask) {
+#if defined(__GNUC__) || defined(__clang__)
+  return static_cast<unsigned>(__builtin_popcountll(mask));
+#else
+  unsigned count = 0;
+  for (; mask; mask &= mask - 1) {
+    ++count;
+  }
+  return count;
+#endif
+}
+#endif
+
+} // namespace detail
+
+/*****************************************************************************
+ * Run Scanning
+ *****************************************************************************/
+
+/**
+ * @brief Length of the leading run of blanks (newlines excluded)
+ */
+inline std::size_t countBlankRun(const char *data, std::size_t length) {
+  std::size_t i = 0;
+#if defined(TSPP_SCAN_VECTOR)
+  for (; i + detail::kBlockSize <= length; i += detail::kBlockSize) {
+    detail::Mask other = ~detail::blankMask(data + i) & detail::kFullMask;
+    if (other) {
+      return i + detail::countTrailingZeros(other) / detail::kBitsPerByte;
+    }
+  }
+#endif
+  while (i < length && isBlank(data[i])) {
+    ++i;
+  }
+  return i;
+}
+
+/**
+ * @brief Length of the leading run of identifier characters
+ */
+inline std::size_t countIdentifierRun(const char *data, std::size_t length) {
+  std::size_t i = 0;
+#if defined(TSPP_SCAN_VECTOR)
+  for (; i + detail::kBlockSize <= length; i += detail::kBlockSize) {
+    detail::Mask other = ~detail::identifierMask(data + i) & detail::kFullMask;
+    if (other) {
+      return i + detail::countTrailingZeros(other) / detail::kBitsPerByte;
+    }
+  }
+#endif
+  while (i < length && isIdentifierChar(data[i])) {
+    ++i;
+  }
+  return i;
+}
+
+/**
+ * @brief Offset of the first occurrence of c, or length if absent
+ */
+inline std::size_t findByte(const char *data, std::size_t length, char c) {
+  std::size_t i = 0;
+#if defined(TSPP_SCAN_VECTOR)
+  for (; i + detail::kBlockSize <= length; i += detail::kBlockSize) {
+    if (detail::Mask hit = detail::byteMask(data + i, c)) {
+      return i + detail::countTrailingZeros(hit) / detail::kBitsPerByte;
+    }
+  }
+#endif
+  while (i < length && data[i] != c) {
+    ++i;
+  }
+  return i;
+}
+
+/**
+ * @brief Offset of the first occurrence of a or b, or length if absent
+ */
+inline std::size_t findEitherByte(const char *data, std::size_t length,
+                                  char a, char b) {
+  std::size_t i = 0;
+#if defined(TSPP_SCAN_VECTOR)
+  for (; i + detail::kBlockSize <= length; i += detail::kBlockSize) {
+    if (detail::Mask hit = detail::byteMask(data + i, a, b)) {
+      return i + detail::countTrailingZeros(hit) / detail::kBitsPerByte;
+    }
+  }
+#endif
+  while (i < length && data[i] != a && data[i] != b) {
+    ++i;
+  }
+  return i;
+}
+
+/**
+ * @brief Offset of the first occurrence of a, b, c or d, or length if absent
+ */
+inline std::size_t findAnyByte(const char *data, std::size_t length, char a,
+                               char b, char c, char d) {
+  std::size_t i = 0;
+#if defined(TSPP_SCAN_VECTOR)
+  for (; i + detail::kBlockSize <= length; i += detail::kBlockSize) {
+    if (detail::Mask hit = detail::byteMask(data + i, a, b, c, d)) {
+      return i + detail::countTrailingZeros(hit) / detail::kBitsPerByte;
+    }
+  }
+#endif
+  while (i < length && data[i] != a && data[i] != b && data[i] != c &&
+         data[i] != d) {
+    ++i;
+  }
+  return i;
+}
+
+/**
+ * @brief Number of occurrences of c
+ */
+inline std::size_t countByte(const char *data, std::size_t length, char c) {
+  std::size_t count = 0;
+  std::size_t i = 0;
+#if defined(TSPP_SCAN_VECTOR)
+  for (; i + detail::kBlockSize <= length; i += detail::kBlockSize) {
+    count += detail::popCount(detail::byteMask(data + i, c)) /
+             detail::kBitsPerByte;
+  }
+#endif
+  for (; i < length; ++i) {
+    count += data[i] == c;
+  }
+  return count;
+}
+
+} // namespace scan
+} // namespace lexer
@@ -14,64 +14,81 @@
 #pragma once
 #include "tokens/token_type.h"
 #include <string>
-#include <unordered_set>
 
 namespace lexer {
 
 class TokenMapUtils {
 public:
   // Operator Classification
-  static bool isUnaryOperator(const std::string &op, bool prefix = true) {
-    static const std::unordered_set<std::string> prefixOps = {
-        "+", "-", "!", "~", "*", "&", "++", "--", "@"};
-    static const std::unordered_set<std::string> postfixOps = {"++", "--"};
-    return prefix ? prefixOps.count(op) > 0 : postfixOps.count(op) > 0;
-  }
-
-  static bool isBinaryOperator(const std::string &op) {
-    static const std::unordered_set<std::string> binaryOps = {
-        "+",  "-",  "*", "/", "%", "==", "!=", "<", ">",  "<=", ">=",
-        "&&", "||", "&", "|", "^", "<<", ">>", ".", "->", "@"};
-    return binaryOps.count(op) > 0;
+  static bool isUnaryOperator(tokens::TokenType type, bool prefix = true) {
+    using tokens::TokenType;
+    static constexpr tokens::TokenSet prefixOps = {
+        TokenType::PLUS,      TokenType::MINUS,     TokenType::EXCLAIM,
+        TokenType::TILDE,     TokenType::STAR,      TokenType::AMPERSAND,
+        TokenType::PLUS_PLUS, TokenType::MINUS_MINUS, TokenType::AT};
+    static constexpr tokens::TokenSet postfixOps = {TokenType::PLUS_PLUS,
+                                                    TokenType::MINUS_MINUS};
+    return (prefix ? prefixOps : postfixOps).contains(type);
+  }
+
+  static bool isBinaryOperator(tokens::TokenType type) {
+    using tokens::TokenType;
+    static constexpr tokens::TokenSet binaryOps = {
+        TokenType::PLUS,          TokenType::MINUS,
+        TokenType::STAR,          TokenType::SLASH,
+        TokenType::PERCENT,       TokenType::EQUALS_EQUALS,
+        TokenType::EXCLAIM_EQUALS, TokenType::LESS,
+        TokenType::GREATER,       TokenType::LESS_EQUALS,
+        TokenType::GREATER_EQUALS, TokenType::AMPERSAND_AMPERSAND,
+        TokenType::PIPE_PIPE,     TokenType::AMPERSAND,
+        TokenType::PIPE,          TokenType::CARET,
+        TokenType::LEFT_SHIFT,    TokenType::RIGHT_SHIFT,
+        TokenType::DOT,           TokenType::ARROW,
+        TokenType::AT};
+    return binaryOps.contains(type);
   }
 
   // Type System
   static bool isTypeModifier(tokens::TokenType type) {
-    static const std::unordered_set<tokens::TokenType> modifiers = {
+    static constexpr tokens::TokenSet modifiers = {
         tokens::TokenType::SHARED, tokens::TokenType::UNIQUE,
-        tokens::TokenType::WEAK, tokens::TokenType::REF};
-    return modifiers.count(type) > 0;
+        tokens::TokenType::WEAK, tokens::TokenType::ATOMIC,
+        tokens::TokenType::REF};
+    return modifiers.contains(type);
   }
 
   static bool isStorageModifier(tokens::TokenType type) {
-    static const std::unordered_set<tokens::TokenType> modifiers = {
-        tokens::TokenType::STACK, tokens::TokenType::HEAP,
-        tokens::TokenType::STATIC};
-    return modifiers.count(type) > 0;
+    static constexpr tokens::TokenSet modifiers = {tokens::TokenType::STACK,
+                                                   tokens::TokenType::HEAP,
+                                                   tokens::TokenType::STATIC};
+    return modifiers.contains(type);
   }
 
   static bool isPrimitiveType(tokens::TokenType type) {
-    static const std::unordered_set<tokens::TokenType> primitives = {
+    static constexpr tokens::TokenSet primitives = {
         tokens::TokenType::VOID, tokens::TokenType::INT,
         tokens::TokenType::FLOAT, tokens::TokenType::BOOLEAN,
         tokens::TokenType::STRING};
-    return primitives.count(type) > 0;
+    return primitives.contains(type);
   }
 
   // Function & Class Modifiers
   static bool isFunctionModifier(tokens::TokenType type) {
-    static const std::unordered_set<tokens::TokenType> modifiers = {
+    static constexpr tokens::TokenSet modifiers = {
         tokens::TokenType::INLINE, tokens::TokenType::VIRTUAL,
         tokens::TokenType::UNSAFE, tokens::TokenType::SIMD,
-        tokens::TokenType::TARGET};
-    return modifiers.count(type) > 0;
+        tokens::TokenType::TARGET, tokens::TokenType::TAILCALL,
+        tokens::TokenType::COLD,   tokens::TokenType::NOALIAS,
+        tokens::TokenType::BENCH};
+    return modifiers.contains(type);
   }
 
   static bool isClassModifier(tokens::TokenType type) {
-    static const std::unordered_set<tokens::TokenType> modifiers = {
+    static constexpr tokens::TokenSet modifiers = {
         tokens::TokenType::ALIGNED, tokens::TokenType::PACKED,
-        tokens::TokenType::ABSTRACT, tokens::TokenType::ZEROCAST};
-    return modifiers.count(type) > 0;
+        tokens::TokenType::ABSTRACT, tokens::TokenType::ZEROCAST,
+        tokens::TokenType::SOA};
+    return modifiers.contains(type);
   }
 
   // Token Classification
@@ -86,9 +103,9 @@ public:
   }
 
   static bool requiresParentheses(tokens::TokenType type) {
-    static const std::unordered_set<tokens::TokenType> needsParams = {
+    static constexpr tokens::TokenSet needsParams = {
         tokens::TokenType::ALIGNED, tokens::TokenType::TARGET};
-    return needsParams.count(type) > 0;
+    return needsParams.contains(type);
   }
 
   // Sequence Validation
@@ -77,23 +77,18 @@ tokens::Token ScannerBase::makeToken(tokens::TokenType type, size_t start,
     return makeErrorToken("Token position/length exceeds source length");
   }
 
-  std::string_view lexeme = source.substr(start, length);
-
-  core::SourceLocation location(state_->getLine(), state_->getColumn(),
-                                 state_->getFileName());
-
-  return tokens::Token(type, std::string(lexeme), location);
+  return tokens::Token(type, state_->getFileId(),
+                       static_cast<std::uint32_t>(start),
+                       static_cast<std::uint32_t>(length));
 }
 
 tokens::Token ScannerBase::makeErrorToken(const std::string &message) {
-  core::SourceLocation location(state_->getLine(), state_->getColumn(),
-                                 state_->getFileName());
-
-  auto lexeme = state_->getCurrentLexeme();
-  std::string errorLexeme =
-      lexeme.empty() ? "" : std::string(lexeme.substr(0, 1));
+  // The error lexeme is the offending character, if any
+  std::uint32_t length = state_->getCurrentLexeme().empty() ? 0 : 1;
 
-  return tokens::Token::createError(errorLexeme, location, message);
+  return tokens::Token::createError(
+      state_->getFileId(), static_cast<std::uint32_t>(state_->getPosition()),
+      length, message);
 }
 
 } // namespace lexer
\ No newline at end of file
@@ -7,76 +7,171 @@
  *****************************************************************************/
 
 #include "identifier_scanner.h"
+#include "lexer/patterns/char_classes.h"
+#include "lexer/patterns/simd_scan.h"
 #include "tokens/token_type.h"
 #include "tokens/tokens.h"
-#include <algorithm>
 
 namespace lexer {
 
 namespace {
-// Cache the keyword map as a static member for efficiency
-const std::unordered_map<std::string, tokens::TokenType> &getKeywordMapImpl() {
-  static const std::unordered_map<std::string, tokens::TokenType> keywords = {
-      {"let", tokens::TokenType::LET},
-      {"const", tokens::TokenType::CONST},
-      {"function", tokens::TokenType::FUNCTION},
-      {"class", tokens::TokenType::CLASS},
-      {"constructor", tokens::TokenType::CONSTRUCTOR},
-      {"interface", tokens::TokenType::INTERFACE},
-      {"enum", tokens::TokenType::ENUM},
-      {"typedef", tokens::TokenType::TYPEDEF},
-      {"namespace", tokens::TokenType::NAMESPACE},
-      {"if", tokens::TokenType::IF},
-      {"else", tokens::TokenType::ELSE},
-      {"for", tokens::TokenType::FOR},
-      {"of", tokens::TokenType::OF},
-      {"finally", tokens::TokenType::FINALLY},
-      {"while", tokens::TokenType::WHILE},
-      {"do", tokens::TokenType::DO},
-      {"break", tokens::TokenType::BREAK},
-      {"continue", tokens::TokenType::CONTINUE},
-      {"return", tokens::TokenType::RETURN},
-      {"true", tokens::TokenType::TRUE},
-      {"false", tokens::TokenType::FALSE},
-      {"null", tokens::TokenType::NULL_VALUE},
-      {"undefined", tokens::TokenType::UNDEFINED},
-      {"this", tokens::TokenType::THIS},
-      {"void", tokens::TokenType::VOID},
-      {"int", tokens::TokenType::INT},
-      {"float", tokens::TokenType::FLOAT},
-      {"bool", tokens::TokenType::BOOLEAN},
-      {"string", tokens::TokenType::STRING},
-      {"try", tokens::TokenType::TRY},
-      {"catch", tokens::TokenType::CATCH},
-      {"switch", tokens::TokenType::SWITCH},
-      {"case", tokens::TokenType::CASE},
-      {"default", tokens::TokenType::DEFAULT},
-      {"extends", tokens::TokenType::EXTENDS},
-      {"implements", tokens::TokenType::IMPLEMENTS},
-      {"public", tokens::TokenType::PUBLIC},
-      {"private", tokens::TokenType::PRIVATE},
-      {"protected", tokens::TokenType::PROTECTED},
-      {"new", tokens::TokenType::NEW},
-      {"throw", tokens::TokenType::THROW},
-      {"typeof", tokens::TokenType::TYPEOF},
-      {"unsafe", tokens::TokenType::UNSAFE},
-      {"aligned", tokens::TokenType::ALIGNED},
-      {"ref", tokens::TokenType::REF},
-      {"where", tokens::TokenType::WHERE},
-      {"throws", tokens::TokenType::THROWS},
-      {"get", tokens::TokenType::GET},
-      {"set", tokens::TokenType::SET},
-      {"#inline", tokens::TokenType::INLINE},
-      {"#virtual", tokens::TokenType::VIRTUAL},
-      {"#unsafe", tokens::TokenType::UNSAFE},
-      {"#simd", tokens::TokenType::SIMD},
-      {"#target", tokens::TokenType::TARGET},
-      {"#packed", tokens::TokenType::PACKED},
-      {"#abstract", tokens::TokenType::ABSTRACT},
-      {"#zerocast", tokens::TokenType::ZEROCAST},
-      {"cast", tokens::TokenType::CAST}};
-  return keywords;
+
+/*****************************************************************************
+ * Keyword Tables
+ *
+ * Keywords and attribute names are resolved through a perfect hash computed
+ * at compile time. The hash mixes the first, middle and last characters with
+ * the length, and the static_asserts below reject any table that collides,
+ * so adding a keyword may require retuning the multipliers in keywordHash().
+ *****************************************************************************/
+struct Keyword {
+  std::string_view spelling;
+  tokens::TokenType type;
+};
+
+constexpr Keyword kKeywords[] = {
+    {"let", tokens::TokenType::LET},
+    {"const", tokens::TokenType::CONST},
+    {"function", tokens::TokenType::FUNCTION},
+    {"async", tokens::TokenType::ASYNC},
+    {"await", tokens::TokenType::AWAIT},
+    {"class", tokens::TokenType::CLASS},
+    {"constructor", tokens::TokenType::CONSTRUCTOR},
+    {"interface", tokens::TokenType::INTERFACE},
+    {"enum", tokens::TokenType::ENUM},
+    {"typedef", tokens::TokenType::TYPEDEF},
+    {"namespace", tokens::TokenType::NAMESPACE},
+    {"extern", tokens::TokenType::EXTERN},
+    {"if", tokens::TokenType::IF},
+    {"else", tokens::TokenType::ELSE},
+    {"for", tokens::TokenType::FOR},
+    {"of", tokens::TokenType::OF},
+    {"finally", tokens::TokenType::FINALLY},
+    {"while", tokens::TokenType::WHILE},
+    {"do", tokens::TokenType::DO},
+    {"break", tokens::TokenType::BREAK},
+    {"continue", tokens::TokenType::CONTINUE},
+    {"return", tokens::TokenType::RETURN},
+    {"true", tokens::TokenType::TRUE},
+    {"false", tokens::TokenType::FALSE},
+    {"null", tokens::TokenType::NULL_VALUE},
+    {"undefined", tokens::TokenType::UNDEFINED},
+    {"this", tokens::TokenType::THIS},
+    {"void", tokens::TokenType::VOID},
+    {"int", tokens::TokenType::INT},
+    {"float", tokens::TokenType::FLOAT},
+    {"bool", tokens::TokenType::BOOLEAN},
+    {"string", tokens::TokenType::STRING},
+    {"try", tokens::TokenType::TRY},
+    {"catch", tokens::TokenType::CATCH},
+    {"switch", tokens::TokenType::SWITCH},
+    {"case", tokens::TokenType::CASE},
+    {"default", tokens::TokenType::DEFAULT},
+    {"extends", tokens::TokenType::EXTENDS},
+    {"implements", tokens::TokenType::IMPLEMENTS},
+    {"public", tokens::TokenType::PUBLIC},
+    {"private", tokens::TokenType::PRIVATE},
+    {"protected", tokens::TokenType::PROTECTED},
+    {"new", tokens::TokenType::NEW},
+    {"throw", tokens::TokenType::THROW},
+    {"typeof", tokens::TokenType::TYPEOF},
+    {"unsafe", tokens::TokenType::UNSAFE},
+    {"aligned", tokens::TokenType::ALIGNED},
+    {"ref", tokens::TokenType::REF},
+    {"where", tokens::TokenType::WHERE},
+    {"throws", tokens::TokenType::THROWS},
+    {"get", tokens::TokenType::GET},
+    {"set", tokens::TokenType::SET},
+    {"cast", tokens::TokenType::CAST}};
+
+// Attribute names as written after '#'
+constexpr Keyword kAttributes[] = {
+    {"stack", tokens::TokenType::STACK},
+    {"heap", tokens::TokenType::HEAP},
+    {"static", tokens::TokenType::STATIC},
+    {"shared", tokens::TokenType::SHARED},
+    {"unique", tokens::TokenType::UNIQUE},
+    {"weak", tokens::TokenType::WEAK},
+    {"atomic", tokens::TokenType::ATOMIC},
+    {"inline", tokens::TokenType::INLINE},
+    {"virtual", tokens::TokenType::VIRTUAL},
+    {"unsafe", tokens::TokenType::UNSAFE},
+    {"simd", tokens::TokenType::SIMD},
+    {"const", tokens::TokenType::CONST},
+    {"target", tokens::TokenType::TARGET},
+    {"tailcall", tokens::TokenType::TAILCALL},
+    {"cold", tokens::TokenType::COLD},
+    {"noalias", tokens::TokenType::NOALIAS},
+    {"bench", tokens::TokenType::BENCH},
+    {"comptime", tokens::TokenType::COMPTIME},
+    {"asm", tokens::TokenType::ASM},
+    {"parallel", tokens::TokenType::PARALLEL},
+    {"arena", tokens::TokenType::ARENA},
+    {"packed", tokens::TokenType::PACKED},
+    {"abstract", tokens::TokenType::ABSTRACT},
+    {"soa", tokens::TokenType::SOA},
+    {"aligned", tokens::TokenType::ALIGNED}};
+
+constexpr size_t kHashTableSize = 128; // Must be a power of two
+
+constexpr size_t keywordHash(std::string_view word) {
+  return (static_cast<unsigned char>(word.front()) * 14u +
+          static_cast<unsigned char>(word.back()) * 50u +
+          static_cast<unsigned char>(word[word.size() / 2]) * 51u +
+          word.size()) &
+         (kHashTableSize - 1);
 }
+
+/**
+ * Collision-free lookup table: each slot holds the index + 1 of the single
+ * keyword that hashes there, or 0 if none does
+ */
+class KeywordTable {
+public:
+  template <size_t N>
+  constexpr KeywordTable(const Keyword (&words)[N])
+      : words_(words), slots_(), maxLength_(0), perfect_(true) {
+    for (size_t i = 0; i < N; ++i) {
+      size_t hash = keywordHash(words[i].spelling);
+      if (slots_[hash] != 0) {
+        perfect_ = false;
+      }
+      slots_[hash] = static_cast<std::uint8_t>(i + 1);
+      if (words[i].spelling.size() > maxLength_) {
+        maxLength_ = words[i].spelling.size();
+      }
+    }
+  }
+
+  constexpr bool isPerfect() const { return perfect_; }
+
+  tokens::TokenType find(std::string_view word,
+                         tokens::TokenType fallback) const {
+    if (word.empty() || word.size() > maxLength_) {
+      return fallback;
+    }
+    std::uint8_t slot = slots_[keywordHash(word)];
+    if (slot != 0 && words_[slot - 1].spelling == word) {
+      return words_[slot - 1].type;
+    }
+    return fallback;
+  }
+
+private:
+  const Keyword *words_;
+  std::uint8_t slots_[kHashTableSize];
+  size_t maxLength_;
+  bool perfect_;
+};
+
+constexpr KeywordTable kKeywordTable(kKeywords);
+constexpr KeywordTable kAttributeTable(kAttributes);
+
+static_assert(kKeywordTable.isPerfect(),
+              "Keyword hash collides; retune keywordHash()");
+static_assert(kAttributeTable.isPerfect(),
+              "Attribute hash collides; retune keywordHash()");
+
 } // namespace
 
 /*****************************************************************************
@@ -91,10 +186,24 @@ IdentifierScanner::IdentifierScanner(std::shared_ptr<LexerState> state)
 tokens::Token IdentifierScanner::scan() {
   size_t start = state_->getPosition();
 
-  // Scan identifier characters
-  while (!isAtEnd() && (std::isalnum(peek()) || peek() == '_')) {
+  // ASCII runs go a block at a time; a non-ASCII character is taken whole
+  std::string_view rest = state_->getCurrentLexeme();
+  size_t scanned = 0;
+  for (;;) {
+    scanned += scan::countIdentifierRun(rest.data() + scanned,
+                                        rest.size() - scanned);
+    size_t character =
+        chars::utf8Length(rest.data() + scanned, rest.size() - scanned);
+    if (character == 0) {
+      break;
+    }
+    scanned += character;
+  }
+  if (scanned == 0) {
     advance();
+    return makeErrorToken("Invalid UTF-8 sequence");
   }
+  state_->advance(scanned);
 
   // Directly get source data and length - avoiding intermediate string_view
   const char *data = state_->getSource().data() + start;
@@ -133,7 +242,7 @@ tokens::Token IdentifierScanner::scanAttribute() {
   size_t nameStart = state_->getPosition(); // Start after #
 
   // Scan attribute name
-  while (!isAtEnd() && (std::isalpha(peek()) || peek() == '_')) {
+  while (!isAtEnd() && chars::is(peek(), chars::kIdentifierStart)) {
     advance();
   }
 
@@ -142,48 +251,16 @@ tokens::Token IdentifierScanner::scanAttribute() {
   size_t length = state_->getPosition() - nameStart;
   std::string_view attrName(data, length);
 
-  // "#inline" | "#virtual" | "#unsafe" | "#simd"
-  //                 | "#const" | "#target"
   // Map attribute to token type
-  tokens::TokenType type;
-  if (attrName == "stack")
-    type = tokens::TokenType::STACK;
-  else if (attrName == "heap")
-    type = tokens::TokenType::HEAP;
-  else if (attrName == "static")
-    type = tokens::TokenType::STATIC;
-  else if (attrName == "shared")
-    type = tokens::TokenType::SHARED;
-  else if (attrName == "unique")
-    type = tokens::TokenType::UNIQUE;
-  else if (attrName == "weak")
-    type = tokens::TokenType::WEAK;
-  else if (attrName == "inline")
-    type = tokens::TokenType::INLINE;
-  else if (attrName == "virtual") {
-    type = tokens::TokenType::VIRTUAL;
-  } else if (attrName == "unsafe") {
-    type = tokens::TokenType::UNSAFE;
-  } else if (attrName == "simd") {
-    type = tokens::TokenType::SIMD;
-  } else if (attrName == "const") {
-    type = tokens::TokenType::CONST;
-  } else if (attrName == "target") {
-    type = tokens::TokenType::TARGET;
-  } else if (attrName == "asm") {
-    type = tokens::TokenType::ASM;
-    return makeToken(type, start, state_->getPosition() - start);
-  } else if (attrName == "packed") {
-    type = tokens::TokenType::PACKED;
-  } else if (attrName == "abstract") {
-    type = tokens::TokenType::ABSTRACT;
-  } else if (attrName == "aligned") {
-    type = tokens::TokenType::ALIGNED;
-    // Return just the 'aligned' token, let the parser handle the parentheses
-    // and number
+  tokens::TokenType type =
+      kAttributeTable.find(attrName, tokens::TokenType::ATTRIBUTE);
+
+  // Return just the '#asm' / '#aligned' / '#target' token, let the parser
+  // handle the parentheses and operands
+  if (type == tokens::TokenType::ASM || type == tokens::TokenType::ALIGNED ||
+      type == tokens::TokenType::TARGET) {
     return makeToken(type, start, state_->getPosition() - start);
-  } else
-    type = tokens::TokenType::ATTRIBUTE;
+  }
 
   // Handle aligned attribute parameters if present
   if (peek() == '(') {
@@ -202,32 +279,33 @@ tokens::Token IdentifierScanner::scanAttribute() {
 /*****************************************************************************
  * Private Helper Methods
  *****************************************************************************/
-const std::unordered_map<std::string, tokens::TokenType> &
-IdentifierScanner::getKeywordMap() {
-  return getKeywordMapImpl();
-}
-
 bool IdentifierScanner::validateIdentifier(std::string_view lexeme) {
   if (lexeme.empty()) {
     return false;
   }
 
-  // First character must be letter or underscore
-  if (!std::isalpha(lexeme[0]) && lexeme[0] != '_') {
+  // First character must be a letter, underscore or non-ASCII character
+  if (!chars::isIdentifierStart(lexeme[0])) {
     return false;
   }
 
-  // Remaining characters must be alphanumeric or underscore
-  return std::all_of(lexeme.begin() + 1, lexeme.end(),
-                     [](char c) { return std::isalnum(c) || c == '_'; });
+  // The rest may also hold digits; non-ASCII ones must be whole UTF-8
+  for (size_t i = 0; i < lexeme.size();) {
+    if (chars::is(lexeme[i], chars::kIdentifierPart)) {
+      ++i;
+      continue;
+    }
+    size_t character = chars::utf8Length(lexeme.data() + i, lexeme.size() - i);
+    if (character == 0) {
+      return false;
+    }
+    i += character;
+  }
+  return true;
 }
 
 tokens::TokenType IdentifierScanner::identifierType(std::string_view lexeme) {
-  auto &keywords = getKeywordMap();
-  // Convert to string for lookup
-  std::string key(lexeme);
-  auto it = keywords.find(key);
-  return it != keywords.end() ? it->second : tokens::TokenType::IDENTIFIER;
+  return kKeywordTable.find(lexeme, tokens::TokenType::IDENTIFIER);
 }
 
 } // namespace lexer
\ No newline at end of file
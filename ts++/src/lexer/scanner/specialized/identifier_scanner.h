@@ -18,7 +18,6 @@
 #include "tokens/tokens.h"
 #include <string>
 #include <string_view>
-#include <unordered_map>
 
 namespace lexer {
 
@@ -39,8 +38,6 @@ public:
   tokens::Token scanAttribute();
 
 private:
-  static const std::unordered_map<std::string, tokens::TokenType> &
-  getKeywordMap();
   bool validateIdentifier(std::string_view lexeme);
   tokens::TokenType identifierType(std::string_view lexeme);
 };
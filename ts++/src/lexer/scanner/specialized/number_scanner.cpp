@@ -7,8 +7,7 @@
  *****************************************************************************/
 
 #include "number_scanner.h"
-#include "lexer/patterns/lexer_patterns.h"
-#include <cctype>
+#include "lexer/patterns/char_classes.h"
 #include <iostream>
 
 namespace lexer {
@@ -48,7 +47,7 @@ tokens::Token NumberScanner::scan() {
     }
 
     // Regular number starting with 0
-    if (std::isdigit(peek())) {
+    if (chars::isDigit(peek())) {
       if (!scanDigits()) {
         return makeErrorToken("Invalid decimal number");
       }
@@ -89,14 +88,9 @@ tokens::Token NumberScanner::scan() {
 /*****************************************************************************
  * Private Helper Methods
  *****************************************************************************/
-bool NumberScanner::validateNumber(std::string_view lexeme) {
-  return std::regex_match(lexeme.begin(), lexeme.end(),
-                          LexerPatterns::getNumberPattern());
-}
-
 bool NumberScanner::scanDigits() {
   bool hasDigit = false;
-  while (std::isdigit(peek()) || peek() == '_') {
+  while (chars::isDigit(peek()) || peek() == '_') {
     if (peek() != '_') {
       hasDigit = true;
     }
@@ -107,7 +101,7 @@ bool NumberScanner::scanDigits() {
 
 bool NumberScanner::scanHexDigits() {
   bool hasDigit = false;
-  while (std::isxdigit(peek()) || peek() == '_') {
+  while (chars::isHexDigit(peek()) || peek() == '_') {
     if (peek() != '_') {
       hasDigit = true;
     }
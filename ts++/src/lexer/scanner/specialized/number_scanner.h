@@ -22,7 +22,6 @@ public:
   tokens::Token scan();
 
 private:
-  bool validateNumber(std::string_view lexeme);
   bool scanDigits();       // Scans sequence of digits
   bool scanHexDigits();    // Scans sequence of hex digits
   bool scanBinaryDigits(); // Scans sequence of binary digits
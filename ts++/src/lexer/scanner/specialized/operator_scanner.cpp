@@ -4,6 +4,7 @@
  *****************************************************************************/
 
 #include "operator_scanner.h"
+#include "lexer/patterns/char_classes.h"
 #include "lexer/patterns/lexer_patterns.h"
 #include "tokens/token_type.h"
 #include <iostream>
@@ -93,6 +94,13 @@ tokens::Token OperatorScanner::scan() {
   size_t start = state_->getPosition();
   char firstChar = peek();
   advance();
+  // The only three-character operator, ending variadic parameters
+  if (firstChar == '.' && peek() == '.' && peekNext(1) == '.') {
+    advance();
+    advance();
+    return makeToken(tokens::TokenType::ELLIPSIS, start, 3);
+  }
+
   // Try compound operator first (+=, -=, ++, etc)
   if (isCompoundOperator(firstChar)) {
     char nextChar = peek();
@@ -122,8 +130,7 @@ tokens::Token OperatorScanner::scan() {
  * Private Helper Methods Implementation
  *****************************************************************************/
 bool OperatorScanner::isCompoundOperator(char c) const {
-  static const std::string compoundable = "+-*/%&|^<>=!.";
-  return compoundable.find(c) != std::string::npos;
+  return chars::is(c, chars::kCompoundFirst);
 }
 
 bool OperatorScanner::scanCompoundOperator() {
@@ -4,8 +4,7 @@
  *****************************************************************************/
 
 #include "string_scanner.h"
-#include <algorithm>
-#include <cctype>
+#include "lexer/patterns/char_classes.h"
 
 namespace lexer {
 
@@ -26,8 +25,7 @@ tokens::Token StringScanner::scanString() {
   // Process string contents
   while (!isAtEnd() && peek() != '"') {
     if (peek() == '\\') {
-      std::string escape = scanEscapeSequence();
-      if (escape.empty()) {
+      if (!scanEscapeSequence()) {
         return makeErrorToken("Invalid escape sequence");
       }
     } else if (!validateCharacter(peek())) {
@@ -53,8 +51,7 @@ tokens::Token StringScanner::scanCharacter() {
 
   // Process character content
   if (peek() == '\\') {
-    std::string escape = scanEscapeSequence();
-    if (escape.empty()) {
+    if (!scanEscapeSequence()) {
       return makeErrorToken("Invalid escape sequence");
     }
   } else if (!validateCharacter(peek())) {
@@ -76,10 +73,10 @@ tokens::Token StringScanner::scanCharacter() {
 /*****************************************************************************
  * Private Helper Methods Implementation
  *****************************************************************************/
-std::string StringScanner::scanEscapeSequence() {
+bool StringScanner::scanEscapeSequence() {
   advance(); // Skip backslash
 
-  // Handle escape sequences
+  // Escapes are only checked here; tokens::appendUnescaped decodes them
   switch (peek()) {
   // Simple escape sequences
   case '\'':
@@ -88,51 +85,35 @@ std::string StringScanner::scanEscapeSequence() {
   case 'n':
   case 'r':
   case 't':
-  case '0': {
-    char c = peek();
+  case '0':
     advance();
-    return std::string(1, c);
-  }
+    return true;
   // Hex escape sequence
-  case 'x': {
+  case 'x':
     advance();
-    std::string hex;
-    for (int i = 0; i < 2 && !isAtEnd() && std::isxdigit(peek()); ++i) {
-      hex += peek();
-      advance();
-    }
-    return (hex.length() == 2 && validateEscapeSequence(hex)) ? hex : "";
-  }
+    return scanHexDigits(2);
   // Unicode escape sequence
-  case 'u': {
+  case 'u':
     advance();
-    std::string unicode;
-    for (int i = 0; i < 4 && !isAtEnd() && std::isxdigit(peek()); ++i) {
-      unicode += peek();
-      advance();
-    }
-    return (unicode.length() == 4 && validateEscapeSequence(unicode)) ? unicode
-                                                                      : "";
-  }
+    return scanHexDigits(4);
   default:
-    return "";
+    return false;
   }
 }
 
+bool StringScanner::scanHexDigits(int count) {
+  for (int i = 0; i < count; ++i) {
+    if (isAtEnd() || !chars::isHexDigit(peek())) {
+      return false;
+    }
+    advance();
+  }
+  return true;
+}
+
 bool StringScanner::validateCharacter(char c) const {
   return c >= 32 && c <= 126; // Printable ASCII range
 }
 
-bool StringScanner::validateEscapeSequence(const std::string &sequence) const {
-  // Check hex escape sequence
-  if (sequence.length() == 2) {
-    return std::all_of(sequence.begin(), sequence.end(), ::isxdigit);
-  }
-  // Check unicode escape sequence
-  if (sequence.length() == 4) {
-    return std::all_of(sequence.begin(), sequence.end(), ::isxdigit);
-  }
-  return false;
-}
 
 } // namespace lexer
\ No newline at end of file
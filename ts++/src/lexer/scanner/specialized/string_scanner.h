@@ -39,10 +39,16 @@ public:
 
 private:
   /**
-   * @brief Process escape sequence in string/char literal
-   * @return Valid escape sequence or empty string if invalid
+   * @brief Skip an escape sequence in a string/char literal
+   * @return true if the sequence is valid; nothing is decoded or copied
    */
-  std::string scanEscapeSequence();
+  bool scanEscapeSequence();
+
+  /**
+   * @brief Skip exactly count hex digits of a \x or \u escape
+   * @return true if all digits were present
+   */
+  bool scanHexDigits(int count);
 
   /**
    * @brief Check if character is valid in string/char literal
@@ -51,12 +57,6 @@ private:
    */
   bool validateCharacter(char c) const;
 
-  /**
-   * @brief Validate hex/unicode escape sequence
-   * @param sequence Escape sequence to validate
-   * @return true if sequence is valid
-   */
-  bool validateEscapeSequence(const std::string &sequence) const;
 };
 
 } // namespace lexer
\ No newline at end of file
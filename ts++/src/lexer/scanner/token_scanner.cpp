@@ -4,6 +4,8 @@
  *****************************************************************************/
 #include "token_scanner.h"
 #include "core/common/common_types.h"
+#include "lexer/patterns/char_classes.h"
+#include "lexer/patterns/simd_scan.h"
 
 namespace lexer {
 
@@ -41,12 +43,12 @@ tokens::Token TokenScanner::scanToken() {
   }
 
   // Handle numbers (including decimals)
-  if (std::isdigit(c) || (c == '.' && std::isdigit(state_->peekNext()))) {
+  if (chars::isDigit(c) || (c == '.' && chars::isDigit(state_->peekNext()))) {
     return numberScanner_.scan();
   }
 
-  // Handle identifiers and keywords
-  if (std::isalpha(c) || c == '_') {
+  // Handle identifiers and keywords, non-ASCII ones included
+  if (chars::isIdentifierStart(c)) {
     return identifierScanner_.scan();
   }
 
@@ -64,13 +66,12 @@ tokens::Token TokenScanner::scanToken() {
  *****************************************************************************/
 void TokenScanner::skipWhitespace() {
   while (!state_->isAtEnd()) {
-    char c = state_->getCurrentChar();
-    if (std::isspace(c)) {
-      if (c == '\n') {
-        state_->newLine();
-      } else {
-        state_->advance();
-      }
+    // Skip the blank run in blocks, stopping at newlines for line tracking
+    std::string_view rest = state_->getCurrentLexeme();
+    state_->advance(scan::countBlankRun(rest.data(), rest.size()));
+
+    if (state_->getCurrentChar() == '\n') {
+      state_->newLine();
     } else {
       break;
     }
@@ -92,9 +93,12 @@ bool TokenScanner::checkComment() {
 }
 
 void TokenScanner::skipLineComment() {
-  while (!state_->isAtEnd() && state_->getCurrentChar() != '\n') {
-    state_->advance();
-  }
+  std::string_view rest = state_->getCurrentLexeme();
+  size_t length = scan::findByte(rest.data(), rest.size(), '\n');
+
+  // Without a newline the comment runs to the end; step past it so that
+  // isAtEnd() holds, as the per-character loop did
+  state_->advance(length < rest.size() ? length : rest.size() + 1);
 }
 
 void TokenScanner::skipBlockComment() {
@@ -102,6 +106,16 @@ void TokenScanner::skipBlockComment() {
   state_->advance(); // Skip *
 
   while (!state_->isAtEnd()) {
+    // Jump to the next candidate terminator or line break
+    std::string_view rest = state_->getCurrentLexeme();
+    size_t length = scan::findEitherByte(rest.data(), rest.size(), '*', '\n');
+    if (length == rest.size()) {
+      state_->advance(length + 1); // Unterminated comment
+      state_->setUnterminatedComment();
+      return;
+    }
+    state_->advance(length);
+
     if (state_->getCurrentChar() == '*' && state_->peekNext(1) == '/') {
       state_->advance(); // Skip *
       state_->advance(); // Skip /
@@ -117,9 +131,9 @@ void TokenScanner::skipBlockComment() {
 }
 
 tokens::Token TokenScanner::makeEndToken() {
-  core::SourceLocation location(state_->getLine(), state_->getColumn(),
-                                 state_->getFileName());
-  return tokens::Token(tokens::TokenType::END_OF_FILE, "", location);
+  return tokens::Token::createSynthetic(
+      tokens::TokenType::END_OF_FILE, state_->getFileId(),
+      static_cast<std::uint32_t>(state_->getPosition()));
 }
 
 } // namespace lexer
\ No newline at end of file
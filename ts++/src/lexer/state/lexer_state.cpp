@@ -5,6 +5,8 @@
  *****************************************************************************/
 
 #include "lexer_state.h"
+#include "lexer/patterns/simd_scan.h"
+#include <algorithm>
 
 namespace lexer {
 
@@ -16,7 +18,7 @@ std::string_view LexerState::getCurrentLexeme() const {
   if (position_ >= source_.length()) {
     return std::string_view();
   }
-  return std::string_view(source_).substr(position_);
+  return source_.substr(position_);
 }
 
 char LexerState::getCurrentChar() const {
@@ -63,7 +65,7 @@ std::string_view LexerState::getLineContent() const {
     lineEnd = source_.length();
   }
 
-  return std::string_view(source_).substr(lineStart, lineEnd - lineStart);
+  return source_.substr(lineStart, lineEnd - lineStart);
 }
 
 /*****************************************************************************
@@ -71,18 +73,21 @@ std::string_view LexerState::getLineContent() const {
  *****************************************************************************/
 
 void LexerState::advance(size_t count) {
-  if (count == 0)
+  // Positions run one past the end of the source so isAtEnd() can trip
+  size_t limit = source_.length() + 1;
+  if (count == 0 || position_ >= limit)
     return;
 
-  // Advance position and track columns, handling tabs
-  for (size_t i = 0; i < count && !isAtEnd(); ++i) {
-    if (getCurrentChar() == '\t') {
-      column_ += 4; // Use 4 spaces per tab
-    } else {
-      column_++;
-    }
-    position_++;
-  }
+  count = std::min(count, limit - position_);
+
+  // Track columns, handling tabs
+  size_t inSource = std::min(count, source_.length() - position_);
+  size_t tabs = count == 1
+                    ? (inSource == 1 && source_[position_] == '\t')
+                    : scan::countByte(source_.data() + position_, inSource,
+                                      '\t');
+  column_ += static_cast<unsigned int>(count + tabs * 3); // 4 spaces per tab
+  position_ += count;
 }
 
 void LexerState::newLine() {
@@ -95,32 +100,43 @@ void LexerState::newLine() {
   column_ = 1;
   position_++;
 
-  // Add implicit semicolon if needed (automatic semicolon insertion)
-  if (!tokens_.empty()) {
-    const auto &lastToken = tokens_.back();
-    if (lastToken.getType() != tokens::TokenType::SEMICOLON &&
-        lastToken.getType() != tokens::TokenType::LEFT_BRACE &&
-        lastToken.getType() != tokens::TokenType::RIGHT_BRACE) {
-
-      addToken(tokens::Token(tokens::TokenType::SEMICOLON, ";",
-                             core::SourceLocation(line_ - 1, column_)));
-    }
+  // Add implicit semicolon if needed (automatic semicolon insertion). The
+  // last token may have been taken already when lexing on demand.
+  if (lastType_ != tokens::TokenType::SEMICOLON &&
+      lastType_ != tokens::TokenType::LEFT_BRACE &&
+      lastType_ != tokens::TokenType::RIGHT_BRACE) {
+    addToken(tokens::Token::createSynthetic(
+        tokens::TokenType::SEMICOLON, fileId_,
+        static_cast<std::uint32_t>(position_ - 1)));
   }
 }
 
 void LexerState::addToken(tokens::Token token) {
   // Validate token location
-  assert(token.getLocation().getLine() <= line_);
-  assert(token.getLocation().getColumn() <= column_);
+  assert(token.getOffset() <= position_);
 
+  lastType_ = token.getType();
   tokens_.push_back(std::move(token));
 }
 
+tokens::Token LexerState::takeToken() {
+  assert(hasTokens() && "Cannot take a token from empty collection");
+  tokens::Token token = std::move(tokens_[taken_++]);
+  if (taken_ == tokens_.size()) {
+    tokens_.clear();
+    taken_ = 0;
+  }
+  return token;
+}
+
 void LexerState::reset() {
   position_ = 0;
   line_ = 1;
   column_ = 1;
   tokens_.clear();
+  taken_ = 0;
+  lastType_ = tokens::TokenType::SEMICOLON;
+  unterminatedComment_ = false;
 }
 
 /*****************************************************************************
@@ -28,11 +28,46 @@ public:
    * @brief Constructs lexer state with source code
    * @param source Source code to tokenize
    * @param fileName Source file name for error reporting
+   * @note The source is moved into the SourceManager, which keeps the
+   *       buffer alive for token lexemes and diagnostics
    */
   LexerState(std::string source, std::string fileName)
-      : source_(std::move(source)), fileName_(std::move(fileName)),
+      : fileName_(std::move(fileName)),
+        fileId_(core::SourceManager::instance().addFile(fileName_,
+                                                        std::move(source))),
+        source_(core::SourceManager::instance().getBuffer(fileId_)),
         position_(0), line_(1), column_(1), tokens_() {}
 
+  /**
+   * @brief Constructs lexer state over a buffer already registered with the
+   *        SourceManager (e.g. a memory-mapped file), scanning it in place
+   * @param fileId Id of the buffer to tokenize
+   */
+  explicit LexerState(core::FileId fileId)
+      : fileName_(core::SourceManager::instance().getFilename(fileId)),
+        fileId_(fileId),
+        source_(core::SourceManager::instance().getBuffer(fileId_)),
+        position_(0), line_(1), column_(1), tokens_() {}
+
+  /**
+   * @brief Constructs lexer state over a range of a registered buffer, as
+   *        if the buffer ended there; tokens keep their offsets in the file
+   * @param fileId Id of the buffer
+   * @param begin Offset to start scanning at
+   * @param end Offset to stop scanning at
+   */
+  LexerState(core::FileId fileId, std::uint32_t begin, std::uint32_t end)
+      : fileName_(core::SourceManager::instance().getFilename(fileId)),
+        fileId_(fileId),
+        source_(core::SourceManager::instance().getBuffer(fileId_).substr(0,
+                                                                         end)),
+        position_(begin), line_(1), column_(1), tokens_() {
+    auto [line, column] =
+        core::SourceManager::instance().getLineColumn(fileId, begin);
+    line_ = line;
+    column_ = column;
+  }
+
   /*****************************************************************************
    * Source Inspection Methods
    *****************************************************************************/
@@ -91,6 +126,11 @@ public:
    */
   void addToken(tokens::Token token);
 
+  /**
+   * @brief Records that a block comment ran to the end of the source
+   */
+  void setUnterminatedComment() { unterminatedComment_ = true; }
+
   /**
    * @brief Reset lexer state to initial conditions
    */
@@ -106,9 +146,9 @@ public:
   bool isAtEnd() const { return position_ > source_.length(); }
 
   /**
-   * @brief Check if any tokens collected
+   * @brief Check if any collected tokens have not been taken yet
    */
-  bool hasTokens() const { return !tokens_.empty(); }
+  bool hasTokens() const { return taken_ < tokens_.size(); }
 
   /**
    * @brief Get last collected token
@@ -118,20 +158,41 @@ public:
   const tokens::Token &getLastToken() const;
 
   // Basic accessors
-  const std::string &getSource() const { return source_; }
+  std::string_view getSource() const { return source_; }
   const std::string &getFileName() const { return fileName_; }
+  core::FileId getFileId() const { return fileId_; }
   size_t getPosition() const { return position_; }
   unsigned int getLine() const { return line_; }
   unsigned int getColumn() const { return column_; }
   const std::vector<tokens::Token> &getTokens() const { return tokens_; }
+  bool hasUnterminatedComment() const { return unterminatedComment_; }
+
+  /**
+   * @brief Move collected tokens out of the state
+   * @return Collected tokens; the state's collection is left empty
+   */
+  std::vector<tokens::Token> takeTokens() { return std::move(tokens_); }
+
+  /**
+   * @brief Take the oldest collected token, for lexing on demand
+   * @return The token; the collection holds only tokens not taken yet
+   * @pre hasTokens() must be true
+   */
+  tokens::Token takeToken();
 
 private:
-  std::string source_;                ///< Source code being tokenized
   std::string fileName_;              ///< Source file name for errors
+  core::FileId fileId_;               ///< Buffer id in the SourceManager
+  std::string_view source_;           ///< Source code being tokenized
   size_t position_;                   ///< Current position in source
   unsigned int line_;                 ///< Current line number (1-based)
   unsigned int column_;               ///< Current column number (1-based)
   std::vector<tokens::Token> tokens_; ///< Collected tokens
+  size_t taken_ = 0;                  ///< Tokens taken one by one so far
+  /// Type of the last token added, for automatic semicolon insertion. It
+  /// starts as a semicolon, after which none is inserted either.
+  tokens::TokenType lastType_ = tokens::TokenType::SEMICOLON;
+  bool unterminatedComment_ = false; ///< A block comment ran to the end
 };
 
 } // namespace lexer
\ No newline at end of file
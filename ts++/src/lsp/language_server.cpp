@@ -0,0 +1,400 @@
+/*****************************************************************************
+ * File: language_server.cpp
+ * Description: Implementation of the Language Server Protocol front end
+ *****************************************************************************/
+
+#include "lsp/language_server.h"
+#include "core/utils/file_utils.h"
+#include "llvm/Support/raw_ostream.h"
+#include <cctype>
+#include <charconv>
+#include <cstdio>
+#include <stdexcept>
+
+namespace lsp {
+
+namespace {
+
+using core::utils::FileUtils;
+namespace json = llvm::json;
+
+// JSON-RPC error codes
+constexpr int kParseError = -32700;
+constexpr int kInvalidRequest = -32600;
+constexpr int kMethodNotFound = -32601;
+constexpr int kInvalidParams = -32602;
+constexpr int kInternalError = -32603;
+
+// Larger messages are skipped instead of buffered
+constexpr size_t kMaxContentLength = 64 << 20;
+
+constexpr char kFileScheme[] = "file://";
+
+// Paths travel as file:// URIs, with reserved characters percent-encoded
+std::string uriToPath(llvm::StringRef uri) {
+  if (!uri.consume_front(kFileScheme)) {
+    throw std::invalid_argument("Not a file URI: " + uri.str());
+  }
+  std::string path;
+  for (size_t i = 0; i < uri.size(); ++i) {
+    unsigned value;
+    if (uri[i] == '%' && i + 2 < uri.size() &&
+        !uri.substr(i + 1, 2).getAsInteger(16, value)) {
+      path += static_cast<char>(value);
+      i += 2;
+    } else {
+      path += uri[i];
+    }
+  }
+  return path;
+}
+
+std::string pathToUri(const std::string &path) {
+  std::string uri = kFileScheme;
+  for (unsigned char c : path) {
+    if (std::isalnum(c) || std::string("/-._~").find(c) != std::string::npos) {
+      uri += static_cast<char>(c);
+    } else {
+      char escaped[4];
+      std::snprintf(escaped, sizeof(escaped), "%%%02X", c);
+      uri += escaped;
+    }
+  }
+  return uri;
+}
+
+const json::Object &getObject(const json::Object &object, llvm::StringRef key) {
+  const json::Object *value = object.getObject(key);
+  if (!value) {
+    throw std::invalid_argument("Missing object: " + key.str());
+  }
+  return *value;
+}
+
+std::string getString(const json::Object &object, llvm::StringRef key) {
+  auto value = object.getString(key);
+  if (!value) {
+    throw std::invalid_argument("Missing string: " + key.str());
+  }
+  return value->str();
+}
+
+std::uint32_t getIndex(const json::Object &object, llvm::StringRef key) {
+  auto value = object.getInteger(key);
+  if (!value || *value < 0) {
+    throw std::invalid_argument("Missing index: " + key.str());
+  }
+  return static_cast<std::uint32_t>(*value);
+}
+
+std::string getDocument(const json::Object &params) {
+  return uriToPath(getString(getObject(params, "textDocument"), "uri"));
+}
+
+Position getPosition(const json::Object &object) {
+  return {getIndex(object, "line"), getIndex(object, "character")};
+}
+
+json::Value toJSON(const Position &position) {
+  return json::Object{{"line", position.line},
+                      {"character", position.character}};
+}
+
+json::Value toJSON(const Range &range) {
+  return json::Object{{"start", toJSON(range.start)},
+                      {"end", toJSON(range.end)}};
+}
+
+int toSeverity(core::Diagnostic::Severity severity) {
+  switch (severity) {
+  case core::Diagnostic::Severity::Error:
+    return 1;
+  case core::Diagnostic::Severity::Warning:
+    return 2;
+  case core::Diagnostic::Severity::Info:
+    return 3;
+  }
+  return 1;
+}
+
+} // namespace
+
+LanguageServer::LanguageServer(std::istream &in, std::ostream &out)
+    : in_(in), out_(out) {}
+
+int LanguageServer::run() {
+  std::string content;
+  while (read(content)) {
+    auto message = json::parse(content);
+    if (!message) {
+      fail(nullptr, kParseError, llvm::toString(message.takeError()));
+      continue;
+    }
+    const json::Object *object = message->getAsObject();
+    if (!object) {
+      fail(nullptr, kInvalidRequest, "Message is not an object");
+      continue;
+    }
+    if (!handle(*object)) {
+      return shutdown_ ? 0 : 1;
+    }
+  }
+  return 1;
+}
+
+bool LanguageServer::read(std::string &content) {
+  // Headers end at an empty line; only Content-Length matters
+  size_t length = 0;
+  bool sized = false;
+  std::string line;
+  while (std::getline(in_, line)) {
+    if (!line.empty() && line.back() == '\r') {
+      line.pop_back();
+    }
+    if (line.empty()) {
+      if (!sized) {
+        continue;
+      }
+      if (length > kMaxContentLength) {
+        // Skipped without being stored
+        in_.ignore(static_cast<std::streamsize>(length));
+        sized = false;
+        continue;
+      }
+      content.resize(length);
+      return static_cast<bool>(in_.read(&content[0], length)) || length == 0;
+    }
+    const std::string header = "Content-Length:";
+    if (line.compare(0, header.size(), header) == 0) {
+      // A bad length is answered; the client's next message may be fine
+      llvm::StringRef value =
+          llvm::StringRef(line).drop_front(header.size()).trim();
+      auto [end, error] =
+          std::from_chars(value.begin(), value.end(), length);
+      sized = error == std::errc() && end == value.end() && !value.empty();
+      if (!sized) {
+        fail(nullptr, kInvalidRequest,
+             "Invalid Content-Length: " + value.str());
+      } else if (length > kMaxContentLength) {
+        fail(nullptr, kInvalidRequest,
+             "Content-Length " + value.str() + " is over the limit of " +
+                 std::to_string(kMaxContentLength) + " bytes");
+      }
+    }
+  }
+  return false;
+}
+
+void LanguageServer::send(json::Value message) {
+  std::string content;
+  llvm::raw_string_ostream stream(content);
+  stream << message;
+  stream.flush();
+  out_ << "Content-Length: " << content.size() << "\r\n\r\n" << content;
+  out_.flush();
+}
+
+void LanguageServer::respond(const json::Value &id, json::Value result) {
+  send(json::Object{{"jsonrpc", "2.0"}, {"id", id}, {"result", std::move(result)}});
+}
+
+void LanguageServer::fail(const json::Value &id, int code,
+                          const std::string &message) {
+  send(json::Object{{"jsonrpc", "2.0"},
+                    {"id", id},
+                    {"error", json::Object{{"code", code},
+                                           {"message", message}}}});
+}
+
+bool LanguageServer::handle(const json::Object &message) {
+  auto method = message.getString("method");
+  const json::Value *id = message.get("id");
+  if (!method) {
+    // A response to a request of ours; none are sent
+    return true;
+  }
+  static const json::Object kNoParams;
+  const json::Object *params = message.getObject("params");
+  if (!params) {
+    params = &kNoParams;
+  }
+
+  try {
+    if (!id) {
+      if (*method == "exit") {
+        return false;
+      }
+      if (*method == "textDocument/didOpen") {
+        didOpen(*params);
+      } else if (*method == "textDocument/didChange") {
+        didChange(*params);
+      } else if (*method == "textDocument/didClose") {
+        didClose(*params);
+      } else {
+        // initialized, didSave and the rest need no answer
+        return true;
+      }
+      publishDiagnostics();
+      return true;
+    }
+
+    if (*method == "initialize") {
+      respond(*id, initialize(*params));
+    } else if (*method == "shutdown") {
+      shutdown_ = true;
+      respond(*id, nullptr);
+    } else if (*method == "textDocument/hover") {
+      respond(*id, hover(*params));
+    } else if (*method == "textDocument/definition") {
+      respond(*id, definition(*params));
+    } else {
+      fail(*id, kMethodNotFound, "Unknown method: " + method->str());
+    }
+  } catch (const std::invalid_argument &e) {
+    if (id) {
+      fail(*id, kInvalidParams, e.what());
+    }
+  } catch (const std::exception &e) {
+    if (id) {
+      fail(*id, kInternalError, e.what());
+    }
+  }
+  return true;
+}
+
+json::Value LanguageServer::initialize(const json::Object &params) {
+  if (auto root = params.getString("rootUri")) {
+    loadWorkspace(uriToPath(*root));
+  } else if (auto path = params.getString("rootPath")) {
+    loadWorkspace(path->str());
+  }
+
+  json::Object capabilities{
+      {"textDocumentSync",
+       json::Object{{"openClose", true}, {"change", 2}}}, // Incremental
+      {"hoverProvider", true},
+      {"definitionProvider", true}};
+  const json::Object *client = params.getObject("capabilities");
+  const json::Object *general = client ? client->getObject("general") : nullptr;
+  const json::Array *encodings =
+      general ? general->getArray("positionEncodings") : nullptr;
+  if (encodings) {
+    for (const auto &encoding : *encodings) {
+      if (encoding.getAsString() == llvm::StringRef("utf-8")) {
+        capabilities["positionEncoding"] = "utf-8";
+      }
+    }
+  }
+  return json::Object{
+      {"capabilities", std::move(capabilities)},
+      {"serverInfo", json::Object{{"name", "tspp-lsp"}}}};
+}
+
+json::Value LanguageServer::hover(const json::Object &params) {
+  std::string text = database_.hover(getDocument(params),
+                                     getPosition(getObject(params, "position")));
+  if (text.empty()) {
+    return nullptr;
+  }
+  return json::Object{{"contents", json::Object{{"kind", "plaintext"},
+                                                {"value", std::move(text)}}}};
+}
+
+json::Value LanguageServer::definition(const json::Object &params) {
+  auto location = database_.definition(
+      getDocument(params), getPosition(getObject(params, "position")));
+  if (!location) {
+    return nullptr;
+  }
+  return json::Object{{"uri", pathToUri(location->path)},
+                      {"range", toJSON(location->range)}};
+}
+
+void LanguageServer::didOpen(const json::Object &params) {
+  const json::Object &document = getObject(params, "textDocument");
+  std::string path = uriToPath(getString(document, "uri"));
+  database_.setText(path, getString(document, "text"));
+  open_.insert(path);
+}
+
+void LanguageServer::didChange(const json::Object &params) {
+  std::string path = getDocument(params);
+  const json::Array *changes = params.getArray("contentChanges");
+  if (!changes) {
+    throw std::invalid_argument("Missing array: contentChanges");
+  }
+  for (const auto &value : *changes) {
+    const json::Object *change = value.getAsObject();
+    if (!change) {
+      throw std::invalid_argument("Content change is not an object");
+    }
+    std::string text = getString(*change, "text");
+    const json::Object *range = change->getObject("range");
+    if (!range) {
+      database_.setText(path, std::move(text));
+      continue;
+    }
+    // Each change applies to the text the ones before it left
+    std::uint32_t start =
+        database_.toOffset(path, getPosition(getObject(*range, "start")));
+    std::uint32_t end =
+        database_.toOffset(path, getPosition(getObject(*range, "end")));
+    if (end < start) {
+      throw std::invalid_argument("Change ends before it starts");
+    }
+    database_.applyEdit(path, {start, end - start, std::move(text)});
+  }
+}
+
+void LanguageServer::didClose(const json::Object &params) {
+  std::string path = getDocument(params);
+  open_.erase(path);
+  published_.erase(path);
+
+  // The file on disk stays part of the program; clear what was shown
+  if (auto text = FileUtils::readFile(path)) {
+    database_.setText(path, std::move(*text));
+  } else {
+    database_.removeFile(path);
+  }
+  send(json::Object{
+      {"jsonrpc", "2.0"},
+      {"method", "textDocument/publishDiagnostics"},
+      {"params", json::Object{{"uri", pathToUri(path)},
+                              {"diagnostics", json::Array()}}}});
+}
+
+void LanguageServer::publishDiagnostics() {
+  for (const auto &path : open_) {
+    SemanticDatabase::Revision changed = database_.diagnosticsChangedAt(path);
+    auto published = published_.find(path);
+    if (published != published_.end() && published->second == changed) {
+      continue;
+    }
+    published_[path] = changed;
+
+    json::Array diagnostics;
+    for (const auto &diagnostic : database_.diagnostics(path)) {
+      diagnostics.push_back(
+          json::Object{{"range", toJSON(diagnostic.range)},
+                       {"severity", toSeverity(diagnostic.severity)},
+                       {"source", "tspp"},
+                       {"message", diagnostic.message}});
+    }
+    send(json::Object{
+        {"jsonrpc", "2.0"},
+        {"method", "textDocument/publishDiagnostics"},
+        {"params", json::Object{{"uri", pathToUri(path)},
+                                {"diagnostics", std::move(diagnostics)}}}});
+  }
+}
+
+void LanguageServer::loadWorkspace(const std::string &root) {
+  for (const auto &path : FileUtils::listFiles(root, "tspp")) {
+    if (auto text = FileUtils::readFile(path)) {
+      database_.setText(path, std::move(*text));
+    }
+  }
+}
+
+} // namespace lsp
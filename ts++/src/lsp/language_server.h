@@ -0,0 +1,90 @@
+/*****************************************************************************
+ * File: language_server.h
+ * Description: Language Server Protocol front end of the semantic database
+ *****************************************************************************/
+
+#pragma once
+#include "lsp/semantic_database.h"
+#include "llvm/Support/JSON.h"
+#include <istream>
+#include <map>
+#include <ostream>
+#include <set>
+#include <string>
+
+namespace lsp {
+
+/**
+ * @class LanguageServer
+ * @brief Serves an editor over JSON-RPC with Content-Length framing
+ *
+ * On initialize, every .tspp file under the workspace root is read into
+ * the database, so that names resolve across the project. Open documents
+ * then take over from the disk: didOpen sets their text, didChange applies
+ * incremental or full changes, and didClose reads the file back. After
+ * every change the diagnostics of each open document are asked for again,
+ * and published only if they changed; the database recomputes just what
+ * the change invalidated.
+ *
+ * Hover and go-to-definition answer from the same database. Positions
+ * count bytes, which match the UTF-16 units the protocol defaults to for
+ * ASCII sources; a client that offers utf-8 positions gets them.
+ */
+class LanguageServer {
+public:
+  LanguageServer(std::istream &in, std::ostream &out);
+
+  /**
+   * @brief Serves requests until the client sends exit or closes input
+   * @return 0 if the client shut the server down first, 1 otherwise
+   */
+  int run();
+
+  SemanticDatabase &getDatabase() { return database_; }
+
+private:
+  /**
+   * @brief Reads the content of the next message
+   *
+   * A malformed Content-Length, or one over the size limit, is answered
+   * with an error and its message skipped.
+   *
+   * @return False at the end of the input
+   */
+  bool read(std::string &content);
+
+  void send(llvm::json::Value message);
+  void respond(const llvm::json::Value &id, llvm::json::Value result);
+  void fail(const llvm::json::Value &id, int code, const std::string &message);
+
+  /**
+   * @brief Handles a request, or a notification when it has no id
+   * @return False once the client sent exit
+   */
+  bool handle(const llvm::json::Object &message);
+
+  // Request handlers; they throw std::invalid_argument on bad params
+  llvm::json::Value initialize(const llvm::json::Object &params);
+  llvm::json::Value hover(const llvm::json::Object &params);
+  llvm::json::Value definition(const llvm::json::Object &params);
+
+  // Notification handlers
+  void didOpen(const llvm::json::Object &params);
+  void didChange(const llvm::json::Object &params);
+  void didClose(const llvm::json::Object &params);
+
+  // Publishes the diagnostics of the open documents that changed
+  void publishDiagnostics();
+
+  // Reads every source file under a directory into the database
+  void loadWorkspace(const std::string &root);
+
+  std::istream &in_;
+  std::ostream &out_;
+  SemanticDatabase database_;
+  std::set<std::string> open_; // Paths of the open documents
+  std::map<std::string, SemanticDatabase::Revision> published_;
+  bool shutdown_ = false;
+};
+
+} // namespace lsp
@@ -0,0 +1,13 @@
+/*****************************************************************************
+ * File: main.cpp
+ * Description: Entry point of tspp-lsp, which serves editors over stdio
+ *****************************************************************************/
+
+#include "lsp/language_server.h"
+#include <iostream>
+
+int main() {
+  std::ios::sync_with_stdio(false);
+  lsp::LanguageServer server(std::cin, std::cout);
+  return server.run();
+}
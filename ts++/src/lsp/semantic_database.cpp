@@ -0,0 +1,706 @@
+/*****************************************************************************
+ * File: semantic_database.cpp
+ * Description: Implementation of the language server's memoized queries
+ *****************************************************************************/
+
+#include "lsp/semantic_database.h"
+#include "parser/nodes/statement_nodes.h"
+#include "parser/visitors/type_check_visitor/type_check_visitor.h"
+#include "parser/visitors/type_check_visitor/type_context.h"
+#include <algorithm>
+#include <functional>
+#include <set>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_set>
+
+namespace lsp {
+
+namespace {
+
+// Tokens after the start of a declaration that may hold its name
+constexpr size_t kNameLookahead = 8;
+
+using Revision = SemanticDatabase::Revision;
+using DeclVisitor = std::function<void(const nodes::DeclarationNode *)>;
+
+template <typename T, typename = void> struct Comparable : std::false_type {};
+template <typename T>
+struct Comparable<T, std::void_t<decltype(std::declval<const T &>() ==
+                                          std::declval<const T &>())>>
+    : std::true_type {};
+
+// Brings a memo up to date. It is only computed again when an input
+// changed after it was last verified, and a value equal to the last one
+// keeps the revision it changed at, so what depends on it stays current.
+template <typename Memo, typename Compute>
+void refresh(Memo &memo, Revision revision, Revision inputsChangedAt,
+             Compute compute) {
+  if (memo.verifiedAt != 0 && inputsChangedAt <= memo.verifiedAt) {
+    memo.verifiedAt = revision;
+    return;
+  }
+  auto value = compute();
+  if constexpr (Comparable<decltype(memo.value)>::value) {
+    if (memo.verifiedAt != 0 && value == memo.value) {
+      memo.verifiedAt = revision;
+      return;
+    }
+  }
+  memo.value = std::move(value);
+  memo.verifiedAt = revision;
+  memo.changedAt = revision;
+}
+
+// Top-level declarations may come wrapped in a statement
+const nodes::DeclarationNode *unwrap(const nodes::BaseNode *node) {
+  if (auto stmt = nodes::dyn_cast<nodes::DeclarationStmtNode>(node)) {
+    node = stmt->getDeclaration();
+  }
+  return nodes::dyn_cast<nodes::DeclarationNode>(node);
+}
+
+// Visits the variables a statement and the statements in it declare
+void forEachLocal(const nodes::StatementNode *stmt, const DeclVisitor &visit) {
+  using namespace nodes;
+  if (!stmt) {
+    return;
+  }
+  switch (stmt->getNodeKind()) {
+  case NodeKind::DeclarationStmt:
+    visit(cast<DeclarationStmtNode>(stmt)->getDeclaration());
+    break;
+  case NodeKind::Block:
+    for (auto nested : cast<BlockNode>(stmt)->getStatements()) {
+      forEachLocal(nested, visit);
+    }
+    break;
+  case NodeKind::IfStmt:
+    forEachLocal(cast<IfStmtNode>(stmt)->getThenBranch(), visit);
+    forEachLocal(cast<IfStmtNode>(stmt)->getElseBranch(), visit);
+    break;
+  case NodeKind::WhileStmt:
+    forEachLocal(cast<WhileStmtNode>(stmt)->getBody(), visit);
+    break;
+  case NodeKind::DoWhileStmt:
+    forEachLocal(cast<DoWhileStmtNode>(stmt)->getBody(), visit);
+    break;
+  case NodeKind::ForStmt:
+    forEachLocal(cast<ForStmtNode>(stmt)->getInitializer(), visit);
+    forEachLocal(cast<ForStmtNode>(stmt)->getBody(), visit);
+    break;
+  case NodeKind::ForOfStmt:
+    forEachLocal(cast<ForOfStmtNode>(stmt)->getBody(), visit);
+    break;
+  case NodeKind::TryStmt: {
+    auto tryStmt = cast<TryStmtNode>(stmt);
+    forEachLocal(tryStmt->getTryBlock(), visit);
+    for (const auto &clause : tryStmt->getCatchClauses()) {
+      forEachLocal(clause.body, visit);
+    }
+    forEachLocal(tryStmt->getFinallyBlock(), visit);
+    break;
+  }
+  case NodeKind::SwitchStmt:
+    for (const auto &switchCase : cast<SwitchStmtNode>(stmt)->getCases()) {
+      for (auto nested : switchCase.body) {
+        forEachLocal(nested, visit);
+      }
+    }
+    break;
+  case NodeKind::LabeledStatement:
+    forEachLocal(cast<LabeledStatementNode>(stmt)->getStatement(), visit);
+    break;
+  default:
+    break;
+  }
+}
+
+void forEachInFunction(const std::vector<nodes::ParamPtr> &params,
+                       const nodes::BlockNode *body, const DeclVisitor &visit) {
+  for (auto param : params) {
+    visit(param);
+  }
+  forEachLocal(body, visit);
+}
+
+// Visits the members of a declaration, and the parameters and locals of
+// it or of its members
+void forEachNested(const nodes::DeclarationNode *decl,
+                   const DeclVisitor &member, const DeclVisitor &local) {
+  using namespace nodes;
+  if (auto function = dyn_cast<FunctionDeclNode>(decl)) {
+    forEachInFunction(function->getParameters(), function->getBody(), local);
+  } else if (auto method = dyn_cast<MethodDeclNode>(decl)) {
+    forEachInFunction(method->getParameters(), method->getBody(), local);
+  } else if (auto constructor = dyn_cast<ConstructorDeclNode>(decl)) {
+    forEachInFunction(constructor->getParameters(), constructor->getBody(),
+                      local);
+  } else if (auto property = dyn_cast<PropertyDeclNode>(decl)) {
+    forEachLocal(property->getBody(), local);
+  } else if (auto classDecl = dyn_cast<ClassDeclNode>(decl)) {
+    for (auto nested : classDecl->getMembers()) {
+      member(nested);
+      forEachNested(nested, member, local);
+    }
+  } else if (auto interface = dyn_cast<InterfaceDeclNode>(decl)) {
+    for (auto nested : interface->getMembers()) {
+      member(nested);
+    }
+  } else if (auto enumDecl = dyn_cast<EnumDeclNode>(decl)) {
+    for (auto nested : enumDecl->getMembers()) {
+      member(nested);
+    }
+  }
+}
+
+// Offsets of the opening braces of the bodies within a declaration
+void collectBodies(const nodes::DeclarationNode *decl,
+                   std::set<std::pair<core::FileId, std::uint32_t>> &bodies) {
+  using namespace nodes;
+  const BlockNode *body = nullptr;
+  if (auto function = dyn_cast<FunctionDeclNode>(decl)) {
+    body = function->getBody();
+  } else if (auto method = dyn_cast<MethodDeclNode>(decl)) {
+    body = method->getBody();
+  } else if (auto constructor = dyn_cast<ConstructorDeclNode>(decl)) {
+    body = constructor->getBody();
+  } else if (auto property = dyn_cast<PropertyDeclNode>(decl)) {
+    body = property->getBody();
+  } else if (auto classDecl = dyn_cast<ClassDeclNode>(decl)) {
+    for (auto member : classDecl->getMembers()) {
+      collectBodies(member, bodies);
+    }
+  } else if (auto space = dyn_cast<NamespaceDeclNode>(decl)) {
+    for (auto nested : space->getDeclarations()) {
+      collectBodies(nested, bodies);
+    }
+  }
+  if (body) {
+    const core::SourceLocation &location = body->getLocation();
+    bodies.emplace(location.getFileId(), location.getOffset());
+  }
+}
+
+} // namespace
+
+void SemanticDatabase::setText(const std::string &path, std::string text) {
+  ++revision_;
+  auto found = files_.find(path);
+  if (found == files_.end()) {
+    found = files_.emplace(path, std::make_unique<File>(path)).first;
+    filesChangedAt_ = revision_;
+  }
+  found->second->parser.parse(std::move(text));
+  found->second->changedAt = revision_;
+}
+
+void SemanticDatabase::applyEdit(const std::string &path,
+                                 const parser::TextEdit &edit) {
+  File &file = getFile(path);
+  ++revision_;
+  file.parser.edit(edit);
+  file.changedAt = revision_;
+}
+
+void SemanticDatabase::removeFile(const std::string &path) {
+  if (files_.erase(path)) {
+    filesChangedAt_ = ++revision_;
+  }
+}
+
+const std::string &SemanticDatabase::getText(const std::string &path) const {
+  auto found = files_.find(path);
+  if (found == files_.end()) {
+    throw std::out_of_range("Unknown document: " + path);
+  }
+  return found->second->parser.getSource();
+}
+
+std::vector<std::string> SemanticDatabase::getFiles() const {
+  std::vector<std::string> paths;
+  for (const auto &entry : files_) {
+    paths.push_back(entry.first);
+  }
+  return paths;
+}
+
+SemanticDatabase::File &SemanticDatabase::getFile(const std::string &path) {
+  auto found = files_.find(path);
+  if (found == files_.end()) {
+    throw std::out_of_range("Unknown document: " + path);
+  }
+  return *found->second;
+}
+
+const SemanticDatabase::TokenIndex &SemanticDatabase::tokens(File &file) {
+  refresh(file.tokens, revision_, file.changedAt, [&] {
+    return TokenIndex{file.parser.getTokens(), file.parser.getTokenOffsets()};
+  });
+  return file.tokens.value;
+}
+
+const std::vector<std::uint32_t> &SemanticDatabase::lines(File &file) {
+  refresh(file.lines, revision_, file.changedAt, [&] {
+    const std::string &text = file.parser.getSource();
+    std::vector<std::uint32_t> starts = {0};
+    for (size_t i = 0; i < text.size(); ++i) {
+      if (text[i] == '\n') {
+        starts.push_back(static_cast<std::uint32_t>(i + 1));
+      }
+    }
+    return starts;
+  });
+  return file.lines.value;
+}
+
+const parser::AST &SemanticDatabase::ast(const std::string &path) {
+  File &file = getFile(path);
+  refresh(file.ast, revision_, file.changedAt, [&] {
+    parser::AST view;
+    for (auto node : file.parser.getNodes()) {
+      view.addNode(node);
+    }
+    return view;
+  });
+  return file.ast.value;
+}
+
+const std::string &SemanticDatabase::signature(const std::string &path) {
+  File &file = getFile(path);
+  refresh(file.signature, revision_, file.changedAt, [&] {
+    ++stats_.signatures;
+    std::set<std::pair<core::FileId, std::uint32_t>> bodies;
+    for (auto node : ast(path).getNodes()) {
+      collectBodies(unwrap(node), bodies);
+    }
+
+    // The tokens with each body reduced to its braces
+    const std::vector<tokens::Token> &all = tokens(file).tokens;
+    std::string result;
+    for (size_t i = 0; i < all.size(); ++i) {
+      const tokens::Token &token = all[i];
+      if (token.getType() == tokens::TokenType::LEFT_BRACE &&
+          bodies.count({token.getFileId(), token.getOffset()})) {
+        int depth = 0;
+        for (; i < all.size(); ++i) {
+          if (all[i].getType() == tokens::TokenType::LEFT_BRACE) {
+            ++depth;
+          } else if (all[i].getType() == tokens::TokenType::RIGHT_BRACE &&
+                     --depth == 0) {
+            break;
+          }
+        }
+        result += "{} ";
+        continue;
+      }
+      result += token.getLexeme();
+      result += ' ';
+    }
+    return result;
+  });
+  return file.signature.value;
+}
+
+SemanticDatabase::Program &SemanticDatabase::program() {
+  Revision inputs = filesChangedAt_;
+  for (const auto &entry : files_) {
+    signature(entry.first);
+    inputs = std::max(inputs, entry.second->signature.changedAt);
+  }
+  refresh(program_, revision_, inputs, [&] {
+    ++stats_.declarations;
+    auto declared = std::make_unique<Program>();
+    parser::AST view;
+    for (const auto &entry : files_) {
+      for (auto node : ast(entry.first).getNodes()) {
+        view.addNode(node);
+      }
+    }
+    core::ErrorReporter reporter(false);
+    try {
+      visitors::TypeCheckVisitor(reporter, &declared->scope).declareAST(view);
+    } catch (const std::exception &e) {
+      reporter.error(core::SourceLocation(),
+                     std::string("Unexpected error during type checking: ") +
+                         e.what());
+    }
+    declared->diagnostics = reporter.getDiagnostics();
+    declared->types = declared->scope;
+    return declared;
+  });
+  return *program_.value;
+}
+
+const visitors::TypeScope &SemanticDatabase::declarations() {
+  return program().scope;
+}
+
+const std::vector<Diagnostic> &
+SemanticDatabase::diagnostics(const std::string &path) {
+  File &file = getFile(path);
+  const Program &declared = program();
+  Revision inputs = std::max(file.changedAt, program_.changedAt);
+  refresh(file.diagnostics, revision_, inputs, [&] {
+    ++stats_.diagnostics;
+    std::vector<core::Diagnostic> found = file.parser.getDiagnostics();
+    for (const auto &diagnostic : declared.diagnostics) {
+      if (file.parser.ownsFile(diagnostic.location.getFileId())) {
+        found.push_back(diagnostic);
+      }
+    }
+
+    // A partial AST is not checked; its syntax errors come first
+    if (!file.parser.hasErrors()) {
+      // Function definitions checked against the current declarations
+      // are skipped, and the rest of the file is checked in one pass
+      const auto &nodes = file.parser.getNodes();
+      std::unordered_map<NodeKey, DefinitionCheck, NodeKeyHash> checks;
+      std::unordered_set<const nodes::BaseNode *> skip;
+      std::vector<size_t> checked; // Indices of the definitions checked
+      for (size_t i = 0; i < nodes.size(); ++i) {
+        auto function = nodes::dyn_cast<nodes::FunctionDeclNode>(
+            unwrap(nodes[i]));
+        if (!function || nodes::isa<nodes::GenericFunctionDeclNode>(function)) {
+          continue;
+        }
+        NodeKey key(nodes[i]->getLocation().getFileId(), nodes[i]);
+        auto previous = file.checks.find(key);
+        if (previous != file.checks.end() &&
+            previous->second.checkedAt == program_.changedAt) {
+          checks.insert(*previous);
+          skip.insert(function);
+        } else {
+          checks[key].checkedAt = program_.changedAt;
+          checked.push_back(i);
+        }
+      }
+      stats_.checkedDefinitions += checked.size();
+
+      core::ErrorReporter reporter(false);
+      visitors::TypeScope scope = declared.scope;
+      try {
+        visitors::TypeCheckVisitor(reporter, &scope)
+            .checkDefinitions(ast(path), skip);
+      } catch (const std::exception &e) {
+        reporter.error(core::SourceLocation(),
+                       std::string("Unexpected error during type checking: ") +
+                           e.what());
+      }
+
+      // A definition owns the diagnostics between its start and the next
+      // node's, when both lie in the same buffer
+      for (const auto &diagnostic : reporter.getDiagnostics()) {
+        const core::SourceLocation &location = diagnostic.location;
+        DefinitionCheck *owner = nullptr;
+        for (size_t i : checked) {
+          const core::SourceLocation &start = nodes[i]->getLocation();
+          bool bounded = i + 1 < nodes.size() &&
+                         nodes[i + 1]->getLocation().getFileId() ==
+                             start.getFileId();
+          if (location.getFileId() == start.getFileId() &&
+              location.getOffset() >= start.getOffset() &&
+              (!bounded ||
+               location.getOffset() < nodes[i + 1]->getLocation().getOffset())) {
+            owner = &checks[NodeKey(start.getFileId(), nodes[i])];
+            break;
+          }
+        }
+        if (owner) {
+          owner->diagnostics.push_back(diagnostic);
+        } else {
+          found.push_back(diagnostic);
+        }
+      }
+      for (const auto &entry : checks) {
+        found.insert(found.end(), entry.second.diagnostics.begin(),
+                     entry.second.diagnostics.end());
+      }
+      file.checks = std::move(checks);
+    }
+
+    std::vector<Diagnostic> result;
+    for (const auto &diagnostic : found) {
+      result.push_back(convert(file, diagnostic));
+    }
+    std::stable_sort(result.begin(), result.end(),
+                     [](const Diagnostic &a, const Diagnostic &b) {
+                       return std::make_pair(a.range.start.line,
+                                             a.range.start.character) <
+                              std::make_pair(b.range.start.line,
+                                             b.range.start.character);
+                     });
+    return result;
+  });
+  return file.diagnostics.value;
+}
+
+SemanticDatabase::Revision
+SemanticDatabase::diagnosticsChangedAt(const std::string &path) {
+  diagnostics(path);
+  return getFile(path).diagnostics.changedAt;
+}
+
+Diagnostic SemanticDatabase::convert(File &file,
+                                     const core::Diagnostic &diagnostic) {
+  std::uint32_t start = file.parser.currentOffset(
+      diagnostic.location.getFileId(), diagnostic.location.getOffset());
+  std::uint32_t end = start;
+  const TokenIndex &index = tokens(file);
+  auto at = std::lower_bound(index.offsets.begin(), index.offsets.end(), start);
+  if (at != index.offsets.end() && *at == start) {
+    end += index.tokens[at - index.offsets.begin()].getLength();
+  }
+  Diagnostic result;
+  result.range = {toPosition(file.path, start), toPosition(file.path, end)};
+  result.severity = diagnostic.severity;
+  result.message = diagnostic.message;
+  return result;
+}
+
+std::shared_ptr<visitors::ResolvedType>
+SemanticDatabase::typeOf(const nodes::DeclarationNode *decl) {
+  using namespace nodes;
+  Program &declared = program();
+  if (typesAt_ != program_.changedAt) {
+    types_.clear();
+    typesAt_ = program_.changedAt;
+  }
+  NodeKey key(decl->getLocation().getFileId(), decl);
+  auto found = types_.find(key);
+  if (found != types_.end()) {
+    return found->second;
+  }
+
+  core::ErrorReporter reporter(false);
+  visitors::TypeCheckVisitor checker(reporter, &declared.types);
+  auto &context = visitors::TypeContext::instance();
+  auto resolve = [&](const TypeNode *type) {
+    return type ? checker.visitType(type) : nullptr;
+  };
+  auto function = [&](const std::vector<ParamPtr> &params,
+                      const TypeNode *returnType) {
+    std::vector<std::shared_ptr<visitors::ResolvedType>> paramTypes;
+    for (auto param : params) {
+      auto type = resolve(param->getType());
+      paramTypes.push_back(type ? type : context.getError());
+    }
+    auto result = returnType ? resolve(returnType) : context.getVoid();
+    return context.getFunction(result, paramTypes);
+  };
+
+  std::shared_ptr<visitors::ResolvedType> type;
+  try {
+    if (isa<GenericFunctionDeclNode>(decl)) {
+      type = declared.types.lookupFunction(decl->getName());
+    } else if (auto functionDecl = dyn_cast<FunctionDeclNode>(decl)) {
+      type = function(functionDecl->getParameters(),
+                      functionDecl->getReturnType());
+    } else if (auto method = dyn_cast<MethodDeclNode>(decl)) {
+      type = function(method->getParameters(), method->getReturnType());
+    } else if (auto constructor = dyn_cast<ConstructorDeclNode>(decl)) {
+      type = function(constructor->getParameters(), nullptr);
+    } else if (auto var = dyn_cast<VarDeclNode>(decl)) {
+      type = resolve(var->getType());
+    } else if (auto param = dyn_cast<ParameterNode>(decl)) {
+      type = resolve(param->getType());
+    } else if (auto field = dyn_cast<FieldDeclNode>(decl)) {
+      type = resolve(field->getType());
+    } else if (auto property = dyn_cast<PropertyDeclNode>(decl)) {
+      type = resolve(property->getPropertyType());
+    } else if (isa<ClassDeclNode>(decl) || isa<InterfaceDeclNode>(decl) ||
+               isa<EnumDeclNode>(decl) || isa<TypedefDeclNode>(decl)) {
+      type = declared.types.lookupType(decl->getName());
+    }
+  } catch (const std::exception &) {
+    type = nullptr;
+  }
+  types_.emplace(key, type);
+  return type;
+}
+
+const SemanticDatabase::Symbols &SemanticDatabase::symbols(File &file) {
+  refresh(file.symbols, revision_, file.changedAt, [&] {
+    Symbols result;
+    const TokenIndex &index = tokens(file);
+    size_t top = 0;
+    auto add = [&](const nodes::DeclarationNode *decl, Symbol::Kind kind) {
+      if (!decl || decl->getName().empty()) {
+        return;
+      }
+      const core::SourceLocation &location = decl->getLocation();
+      std::uint32_t offset = file.parser.currentOffset(location.getFileId(),
+                                                       location.getOffset());
+      // A declaration starts at its keyword; point at its name
+      size_t i = std::lower_bound(index.offsets.begin(), index.offsets.end(),
+                                  offset) -
+                 index.offsets.begin();
+      for (size_t end = std::min(i + kNameLookahead, index.tokens.size());
+           i < end; ++i) {
+        if (index.tokens[i].getType() == tokens::TokenType::IDENTIFIER &&
+            index.tokens[i].getLexeme() == decl->getName()) {
+          offset = index.offsets[i];
+          break;
+        }
+      }
+      result.symbols.push_back({decl, offset, top, kind});
+    };
+
+    // Members of namespaces are globals too
+    std::function<void(const nodes::DeclarationNode *)> global =
+        [&](const nodes::DeclarationNode *decl) {
+          add(decl, Symbol::Kind::Global);
+          if (auto space = nodes::dyn_cast<nodes::NamespaceDeclNode>(decl)) {
+            for (auto nested : space->getDeclarations()) {
+              global(nested);
+            }
+          }
+          forEachNested(
+              decl, [&](auto member) { add(member, Symbol::Kind::Member); },
+              [&](auto local) { add(local, Symbol::Kind::Local); });
+        };
+
+    for (auto node : file.parser.getNodes()) {
+      const core::SourceLocation &location = node->getLocation();
+      result.tops.push_back(file.parser.currentOffset(location.getFileId(),
+                                                      location.getOffset()));
+      if (auto decl = unwrap(node)) {
+        global(decl);
+      } else if (auto stmt = nodes::dyn_cast<nodes::StatementNode>(node)) {
+        forEachLocal(stmt, [&](auto local) { add(local, Symbol::Kind::Local); });
+      }
+      ++top;
+    }
+    return result;
+  });
+  return file.symbols.value;
+}
+
+std::pair<SemanticDatabase::File *, const SemanticDatabase::Symbol *>
+SemanticDatabase::resolve(const std::string &path, Position position) {
+  File &file = getFile(path);
+  std::uint32_t offset = toOffset(path, position);
+  const TokenIndex &index = tokens(file);
+
+  // The token at the position, or ending there
+  auto after =
+      std::upper_bound(index.offsets.begin(), index.offsets.end(), offset);
+  if (after == index.offsets.begin()) {
+    return {nullptr, nullptr};
+  }
+  size_t at = after - index.offsets.begin() - 1;
+  const tokens::Token &token = index.tokens[at];
+  if (token.getType() != tokens::TokenType::IDENTIFIER ||
+      offset > index.offsets[at] + token.getLength()) {
+    return {nullptr, nullptr};
+  }
+  std::string_view name = token.getLexeme();
+  bool member =
+      at > 0 && index.tokens[at - 1].getType() == tokens::TokenType::DOT;
+
+  // The nearest local declared before it within the same top-level node
+  const Symbols &own = symbols(file);
+  if (!member) {
+    size_t top = std::upper_bound(own.tops.begin(), own.tops.end(), offset) -
+                 own.tops.begin();
+    const Symbol *nearest = nullptr;
+    for (const Symbol &symbol : own.symbols) {
+      if (symbol.kind == Symbol::Kind::Local && symbol.top + 1 == top &&
+          symbol.offset <= offset && symbol.decl->getName() == name &&
+          (!nearest || symbol.offset > nearest->offset)) {
+        nearest = &symbol;
+      }
+    }
+    if (nearest) {
+      return {&file, nearest};
+    }
+  }
+
+  // Then a global or member, of this document first
+  Symbol::Kind kind = member ? Symbol::Kind::Member : Symbol::Kind::Global;
+  auto search = [&](const Symbols &symbols) -> const Symbol * {
+    for (const Symbol &symbol : symbols.symbols) {
+      if (symbol.kind == kind && symbol.decl->getName() == name) {
+        return &symbol;
+      }
+    }
+    return nullptr;
+  };
+  if (const Symbol *found = search(own)) {
+    return {&file, found};
+  }
+  for (const auto &entry : files_) {
+    if (entry.second.get() != &file) {
+      if (const Symbol *found = search(symbols(*entry.second))) {
+        return {entry.second.get(), found};
+      }
+    }
+  }
+  return {nullptr, nullptr};
+}
+
+std::optional<Location> SemanticDatabase::definition(const std::string &path,
+                                                     Position position) {
+  auto [file, symbol] = resolve(path, position);
+  if (!symbol) {
+    return std::nullopt;
+  }
+  std::uint32_t end =
+      symbol->offset + static_cast<std::uint32_t>(symbol->decl->getName().size());
+  return Location{file->path, {toPosition(file->path, symbol->offset),
+                               toPosition(file->path, end)}};
+}
+
+std::string SemanticDatabase::hover(const std::string &path,
+                                    Position position) {
+  using namespace nodes;
+  const Symbol *symbol = resolve(path, position).second;
+  if (!symbol) {
+    return "";
+  }
+  const DeclarationNode *decl = symbol->decl;
+  if (isa<ClassDeclNode>(decl)) {
+    return "class " + decl->getName();
+  }
+  if (isa<InterfaceDeclNode>(decl)) {
+    return "interface " + decl->getName();
+  }
+  if (isa<EnumDeclNode>(decl)) {
+    return "enum " + decl->getName();
+  }
+  if (isa<NamespaceDeclNode>(decl)) {
+    return "namespace " + decl->getName();
+  }
+  auto type = typeOf(decl);
+  if (isa<TypedefDeclNode>(decl)) {
+    return "typedef " + decl->getName() +
+           (type ? " = " + type->toString() : "");
+  }
+  return decl->getName() + (type ? ": " + type->toString() : "");
+}
+
+std::uint32_t SemanticDatabase::toOffset(const std::string &path,
+                                         Position position) {
+  File &file = getFile(path);
+  const std::vector<std::uint32_t> &starts = lines(file);
+  std::uint32_t size =
+      static_cast<std::uint32_t>(file.parser.getSource().size());
+  if (position.line >= starts.size()) {
+    return size;
+  }
+  // A character past the end of the line stands for its end
+  std::uint32_t end =
+      position.line + 1 < starts.size() ? starts[position.line + 1] - 1 : size;
+  return std::min(starts[position.line] + position.character, end);
+}
+
+Position SemanticDatabase::toPosition(const std::string &path,
+                                      std::uint32_t offset) {
+  const std::vector<std::uint32_t> &starts = lines(getFile(path));
+  size_t line =
+      std::upper_bound(starts.begin(), starts.end(), offset) - starts.begin() -
+      1;
+  return {static_cast<std::uint32_t>(line), offset - starts[line]};
+}
+
+} // namespace lsp
@@ -0,0 +1,229 @@
+/*****************************************************************************
+ * File: semantic_database.h
+ * Description: Memoized queries over the documents a language server holds
+ *****************************************************************************/
+
+#pragma once
+#include "core/common/macros.h"
+#include "core/diagnostics/error_reporter.h"
+#include "parser/ast.h"
+#include "parser/incremental_parser.h"
+#include "parser/nodes/declaration_nodes.h"
+#include "parser/visitors/type_check_visitor/resolved_type.h"
+#include "parser/visitors/type_check_visitor/type_scope.h"
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace lsp {
+
+// Zero-based line and byte offset within it
+struct Position {
+  std::uint32_t line = 0;
+  std::uint32_t character = 0;
+
+  bool operator==(const Position &other) const {
+    return line == other.line && character == other.character;
+  }
+};
+
+struct Range {
+  Position start;
+  Position end;
+
+  bool operator==(const Range &other) const {
+    return start == other.start && end == other.end;
+  }
+};
+
+struct Location {
+  std::string path;
+  Range range;
+};
+
+struct Diagnostic {
+  Range range;
+  core::Diagnostic::Severity severity = core::Diagnostic::Severity::Error;
+  std::string message;
+
+  bool operator==(const Diagnostic &other) const {
+    return range == other.range && severity == other.severity &&
+           message == other.message;
+  }
+};
+
+/**
+ * @class SemanticDatabase
+ * @brief Answers editor questions about a set of documents, salsa style
+ *
+ * The texts of the documents are the inputs; everything else is a query
+ * derived from them: the tokens and AST of a document, its signature, the
+ * declarations of the whole program, the diagnostics of a document, the
+ * type of a declaration. Each query keeps its last result with the
+ * revision it was last verified at and the revision its value last
+ * changed at. Setting a text starts a new revision, and a query asked for
+ * again only recomputes when one of its inputs changed after it was last
+ * verified.
+ *
+ * A query whose result compares equal to the last one keeps its old
+ * changedAt, which cuts off the queries depending on it. The signature of
+ * a document is its tokens outside function, method and property bodies,
+ * so an edit inside a body leaves the program's declarations alone and
+ * no other document is checked again. Within the edited document the
+ * parser reuses the top-level items the edit did not touch, and the
+ * checks of reused function definitions are reused as long as the
+ * declarations did not change, so an edit in a body checks that body.
+ *
+ * Documents are parsed with parser::IncrementalParser, so reused tokens
+ * and nodes keep the locations of the buffer they were lexed from; every
+ * position a query hands out is mapped to the current text.
+ */
+class SemanticDatabase {
+public:
+  NON_COPYABLE(SemanticDatabase);
+  using Revision = std::uint64_t;
+
+  SemanticDatabase() = default;
+
+  // Inputs; each call starts a new revision
+  void setText(const std::string &path, std::string text);
+  void applyEdit(const std::string &path, const parser::TextEdit &edit);
+  void removeFile(const std::string &path);
+
+  bool hasFile(const std::string &path) const { return files_.count(path); }
+  const std::string &getText(const std::string &path) const;
+  std::vector<std::string> getFiles() const;
+  Revision getRevision() const { return revision_; }
+
+  // Queries
+  const parser::AST &ast(const std::string &path);
+  const std::string &signature(const std::string &path);
+  const visitors::TypeScope &declarations();
+  const std::vector<Diagnostic> &diagnostics(const std::string &path);
+  std::shared_ptr<visitors::ResolvedType>
+  typeOf(const nodes::DeclarationNode *decl);
+
+  // Revision the diagnostics of a document last changed at
+  Revision diagnosticsChangedAt(const std::string &path);
+
+  /**
+   * @brief Finds the declaration a name refers to
+   * @param path The document
+   * @param position Position of the name
+   * @return Where it is declared, if anywhere
+   */
+  std::optional<Location> definition(const std::string &path,
+                                     Position position);
+
+  /**
+   * @brief Describes the declaration a name refers to
+   * @return Its name and type, or "" if the position names nothing known
+   */
+  std::string hover(const std::string &path, Position position);
+
+  // Conversions between positions and offsets in the current text
+  std::uint32_t toOffset(const std::string &path, Position position);
+  Position toPosition(const std::string &path, std::uint32_t offset);
+
+  // How often each query was computed, for tests and logging
+  struct Stats {
+    size_t signatures = 0;
+    size_t declarations = 0;
+    size_t diagnostics = 0;
+    size_t checkedDefinitions = 0; // Function definitions checked
+  };
+  const Stats &getStats() const { return stats_; }
+
+private:
+  template <typename T> struct Memo {
+    T value{};
+    Revision verifiedAt = 0; // 0 until computed
+    Revision changedAt = 0;
+  };
+
+  // Tokens with their offsets in the current text
+  struct TokenIndex {
+    std::vector<tokens::Token> tokens;
+    std::vector<std::uint32_t> offsets;
+  };
+
+  // A declaration an editor may jump to
+  struct Symbol {
+    const nodes::DeclarationNode *decl = nullptr;
+    std::uint32_t offset = 0; // Of its name in the current text
+    size_t top = 0;           // Index of the top-level node holding it
+    enum class Kind { Global, Member, Local } kind = Kind::Global;
+  };
+
+  struct Symbols {
+    std::vector<Symbol> symbols;
+    std::vector<std::uint32_t> tops; // Offsets of the top-level nodes
+  };
+
+  // Check of one top-level function definition, against declarations
+  // that last changed at checkedAt
+  struct DefinitionCheck {
+    Revision checkedAt = 0;
+    std::vector<core::Diagnostic> diagnostics;
+  };
+
+  // Identifies a node across edits; a reparsed node lives in a new buffer
+  using NodeKey = std::pair<core::FileId, const nodes::BaseNode *>;
+  struct NodeKeyHash {
+    size_t operator()(const NodeKey &key) const {
+      return std::hash<const void *>()(key.second) ^ key.first;
+    }
+  };
+
+  struct File {
+    std::string path;
+    parser::IncrementalParser parser;
+    Revision changedAt = 0;
+    Memo<TokenIndex> tokens;
+    Memo<std::vector<std::uint32_t>> lines; // Offset of each line
+    Memo<parser::AST> ast;                  // Views the parser's nodes
+    Memo<std::string> signature;
+    Memo<std::vector<Diagnostic>> diagnostics;
+    Memo<Symbols> symbols;
+    std::unordered_map<NodeKey, DefinitionCheck, NodeKeyHash> checks;
+
+    explicit File(const std::string &path) : path(path), parser(path) {}
+  };
+
+  // Declarations of the whole program
+  struct Program {
+    visitors::TypeScope scope;
+    std::vector<core::Diagnostic> diagnostics; // From declaring
+    visitors::TypeScope types; // Copy that typeOf resolves types against
+  };
+
+  File &getFile(const std::string &path);
+  const TokenIndex &tokens(File &file);
+  const std::vector<std::uint32_t> &lines(File &file);
+  const Symbols &symbols(File &file);
+  Program &program();
+
+  // Diagnostic of a location in a file, spanning the token there
+  Diagnostic convert(File &file, const core::Diagnostic &diagnostic);
+
+  // Symbol the identifier at a position refers to, and its file
+  std::pair<File *, const Symbol *> resolve(const std::string &path,
+                                            Position position);
+
+  Revision revision_ = 1;
+  Revision filesChangedAt_ = 1; // Last revision a file was added or removed
+  std::map<std::string, std::unique_ptr<File>> files_; // In program order
+  Memo<std::unique_ptr<Program>> program_;
+  std::unordered_map<NodeKey, std::shared_ptr<visitors::ResolvedType>,
+                     NodeKeyHash>
+      types_; // typeOf, for the current declarations
+  Revision typesAt_ = 0; // Declarations revision types_ holds
+  Stats stats_;
+};
+
+} // namespace lsp
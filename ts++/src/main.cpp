@@ -1,68 +1,326 @@
 #include "codegen/codegen_options.h"
 #include "codegen/llvm/llvm_code_gen.h"
+#include "codegen/llvm/llvm_parallel_code_gen.h"
+#include "core/common/source_manager.h"
+#include "core/common/time_report.h"
 #include "core/diagnostics/error_reporter.h"
 #include "core/utils/file_utils.h"
 #include "core/utils/log_utils.h"
+#include "driver/benchmark.h"
+#include "driver/compilation.h"
+#include "driver/compile_server.h"
+#include "driver/compilation_cache.h"
+#include "driver/dependency_graph.h"
+#include "driver/linter.h"
+#include "driver/watch_session.h"
 #include "lexer/lexer.h"
-#include "parser/parser.h"
 #include "repl/repl.h"
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
+#include <unordered_map>
+#include <unordered_set>
 
-int main(int argc, char *argv[]) {
+namespace {
+
+// Compiles as the command line asks, returning the exit status
+int compileProgram(const std::vector<std::string> &args) {
   try {
     core::ErrorReporter errorReporter;
 
-    if (argc == 1) {
+    // Split the command line into flags and the inputs
+    codegen::CodeGenOptions options;
+    std::vector<std::string> inputs;
+    std::string outputPath;
+    std::string cacheDirectory = driver::CompilationCache::getDefaultDirectory();
+    std::vector<std::string> imports;
+    std::string interfacePath;
+    bool incremental = false;
+    bool stream = false;
+    bool watch = false;
+    bool run = false;
+    bool bench = false;
+    driver::BenchmarkOptions benchOptions;
+    bool dumpTokens = false;
+    bool dumpAST = false;
+    DumpFormat dumpFormat = DumpFormat::Pretty;
+    bool lint = false;
+    bool lintJSON = false;
+    driver::LintConfig lintConfig;
+    for (size_t i = 0; i < args.size(); ++i) {
+      const std::string &arg = args[i];
+      if (arg == "-o") {
+        if (i + 1 == args.size()) {
+          std::cerr << "Error: Missing file name after -o\n";
+          return 1;
+        }
+        outputPath = args[++i];
+      } else if (arg.rfind("-cache-dir=", 0) == 0) {
+        cacheDirectory = arg.substr(11);
+      } else if (arg == "-incremental") {
+        incremental = true;
+      } else if (arg == "-stream") {
+        // Parses each function body only while it is generated
+        stream = true;
+      } else if (arg == "-watch") {
+        watch = true;
+      } else if (arg == "-run") {
+        // Runs main in the JIT instead of writing the output
+        run = true;
+      } else if (arg == "-bench") {
+        // Measures the #bench functions in the JIT instead of running main
+        bench = true;
+      } else if (arg == "-jit-profile") {
+        // Names JITed functions for perf and the other JIT-aware profilers
+        options.setJITProfiling(true);
+      } else if (arg == "-bench-format=json" || arg == "-bench-format=table") {
+        benchOptions.json = arg == "-bench-format=json";
+      } else if (arg.rfind("-bench-time=", 0) == 0) {
+        char *end = nullptr;
+        auto ms = std::strtoul(arg.c_str() + 12, &end, 10);
+        if (arg.size() == 12 || *end != '\0' || ms == 0) {
+          std::cerr << "Error: Invalid option: " << arg << "\n";
+          return 1;
+        }
+        benchOptions.timeMs = static_cast<unsigned>(ms);
+      } else if (arg == "-dump-tokens") {
+        // Prints the tokens or AST of every input instead of compiling
+        dumpTokens = true;
+      } else if (arg == "-dump-ast") {
+        dumpAST = true;
+      } else if (arg == "-dump-format=jsonl" || arg == "-dump-format=pretty") {
+        dumpFormat = arg == "-dump-format=jsonl" ? DumpFormat::JSONLines
+                                                  : DumpFormat::Pretty;
+      } else if (arg == "-lint") {
+        // Checks the rules of tools/linter instead of compiling
+        lint = true;
+      } else if (arg.rfind("-lint-config=", 0) == 0) {
+        std::string error;
+        if (!driver::LintConfig::load(arg.substr(13), lintConfig, error)) {
+          std::cerr << "Error: " << error << "\n";
+          return 1;
+        }
+      } else if (arg.rfind("-lint-ignore=", 0) == 0) {
+        std::string rules = arg.substr(13);
+        for (size_t start = 0; start <= rules.size();) {
+          size_t comma = std::min(rules.find(',', start), rules.size());
+          if (comma > start) {
+            lintConfig.ignoredRules.insert(rules.substr(start, comma - start));
+          }
+          start = comma + 1;
+        }
+      } else if (arg == "-lint-format=json" || arg == "-lint-format=text") {
+        lintJSON = arg == "-lint-format=json";
+      } else if (arg.rfind("-ferror-limit=", 0) == 0 ||
+                 arg.rfind("-fwarning-limit=", 0) == 0) {
+        // Diagnostics past the limit are counted but not shown; 0 shows all
+        size_t equals = arg.find('=');
+        char *end = nullptr;
+        auto limit = static_cast<unsigned>(
+            std::strtoul(arg.c_str() + equals + 1, &end, 10));
+        if (equals + 1 == arg.size() || *end != '\0') {
+          std::cerr << "Error: Invalid option: " << arg << "\n";
+          return 1;
+        }
+        if (arg[2] == 'e') {
+          errorReporter.setErrorLimit(limit);
+        } else {
+          errorReporter.setWarningLimit(limit);
+        }
+      } else if (arg == "-fdiagnostics-format=sarif" ||
+                 arg == "-fdiagnostics-format=text") {
+        errorReporter.setFormat(arg == "-fdiagnostics-format=sarif"
+                                    ? core::DiagnosticFormat::SARIF
+                                    : core::DiagnosticFormat::Text);
+      } else if (arg.rfind("-import=", 0) == 0) {
+        imports.push_back(arg.substr(8));
+      } else if (arg.rfind("-emit-interface=", 0) == 0) {
+        // A program that exports an interface is a library
+        interfacePath = arg.substr(16);
+        options.setDefaultMain(false);
+      } else if (arg.size() > 1 && arg[0] == '-') {
+        if (!options.parseFlag(arg)) {
+          std::cerr << "Error: Unknown option: " << arg << "\n";
+          return 1;
+        }
+      } else {
+        inputs.push_back(arg);
+      }
+    }
+
+    if (inputs.empty()) {
       repl::Repl repl(errorReporter);
       repl.start();
       return 0;
     }
 
-    const std::string filePath = argv[1];
+    // Files, directories and @manifests all name source files of one
+    // program, which -j threads lex, parse and type-check
+    driver::Compilation compilation(errorReporter, options.getCodeGenThreads());
+    for (const auto &input : inputs) {
+      if (!compilation.addInput(input)) {
+        return 1;
+      }
+    }
+    for (const auto &import : imports) {
+      if (!compilation.addImport(import)) {
+        return 1;
+      }
+    }
+    const auto &files = compilation.getFiles();
 
-    if (core::utils::FileUtils::getExtension(filePath) != "tspp") {
-      std::cerr << "Error: File must have .tspp extension\n";
+    if (dumpTokens) {
+      auto &sources = core::SourceManager::instance();
+      for (const auto &file : files) {
+        auto buffer = core::utils::FileUtils::openSource(file);
+        if (!buffer) {
+          std::cerr << "Error: Could not read file: " << file << "\n";
+          return 1;
+        }
+        core::FileId fileId = sources.addFile(file, std::move(buffer));
+        printTokenStream(lexer::Lexer(fileId).tokenize(), std::cout,
+                         dumpFormat);
+      }
+      return 0;
+    }
+    if (dumpAST) {
+      bool parsed = compilation.parse();
+      printAST(compilation.getAST(), std::cout, dumpFormat);
+      return parsed ? 0 : 1;
+    }
+
+    // Linting parses every file as a compilation does and checks the rules
+    // over their ASTs on -j threads; syntax errors are reported as usual
+    if (lint) {
+      bool parsed = compilation.parse();
+      driver::Linter linter(lintConfig, options.getCodeGenThreads());
+      auto messages = linter.lint(compilation);
+      driver::Linter::print(messages, std::cout, lintJSON);
+      return parsed && !driver::Linter::hasErrors(messages) ? 0 : 1;
+    }
+
+    if (bench && (run || watch || incremental || stream)) {
+      std::cerr << "Error: -bench cannot be combined with -run, -watch, "
+                   "-incremental or -stream\n";
       return 1;
     }
+    if (files.size() > 1 && outputPath.empty() && !run && !bench) {
+      std::cerr << "Error: Several source files need an output name (-o)\n";
+      return 1;
+    }
+    const std::string &filePath = files.front();
 
-    if (!core::utils::FileUtils::exists(filePath)) {
-      std::cerr << "Error: File does not exist: " << filePath << "\n";
+    // The extension follows the output format (.ll, .bc, .s, .o). An
+    // executable is named after the source without its extension.
+    if (!outputPath.empty()) {
+      options.setOutputFilename(outputPath);
+    } else if (options.getOutputFormat() == codegen::OutputFormat::EXECUTABLE) {
+      options.setOutputFilename(filePath);
+    } else {
+      options.setOutputFilename(filePath + ".ll");
+    }
+    if (std::find(files.begin(), files.end(), options.getOutputFilename()) !=
+        files.end()) {
+      std::cerr << "Error: Output would overwrite an input file\n";
       return 1;
     }
 
-    auto sourceCode = core::utils::FileUtils::readFile(filePath);
-    if (!sourceCode) {
-      std::cerr << "Error: Could not read file: " << filePath << "\n";
+    // A program that is run keeps the JIT's machine code in the cache, and
+    // calls the runtime linked into the compiler rather than its bitcode
+    if (run || bench) {
+      options.setJITCacheDirectory(cacheDirectory);
+      options.setRuntimeBitcode("");
+    }
+
+    if (stream && (incremental || watch)) {
+      std::cerr << "Error: -stream cannot be combined with -incremental "
+                   "or -watch\n";
       return 1;
     }
 
-    // Lexical analysis
-    lexer::Lexer lexer(*sourceCode, filePath);
-    auto tokens = lexer.tokenize();
+    // Watch mode keeps the program in memory and rebuilds it on changes;
+    // bodies are parsed when their function is first generated
+    if (watch) {
+      compilation.setDeferBodies(true);
+      return driver::WatchSession(errorReporter, compilation, options, run)
+          .watch(inputs);
+    }
+
+    // An identical earlier compilation skips the front end and codegen.
+    // Imports are inputs too; an interface to write is not cached, and
+    // neither is a program that is run or measured.
+    driver::CompilationCache cache(
+        interfacePath.empty() && !run && !bench ? cacheDirectory : "");
+    if (cache.computeKey(files, imports, options) &&
+        cache.fetch(options.getOutputFilename())) {
+      std::cout << "Compilation cached. Output written to "
+                << options.getOutputFilename() << std::endl;
+      return 0;
+    }
+    if (incremental && !cache.canCacheFunctions()) {
+      std::cerr << "Error: -incremental needs a cache directory "
+                   "(-cache-dir= or TSPP_CACHE_DIR)\n";
+      return 1;
+    }
 
-    if (tokens.empty()) {
-      std::cerr << "Fatal errors occurred during lexical analysis.\n";
+    // Bodies of reused functions are not even parsed, and streamed ones
+    // only when they are generated
+    compilation.setDeferBodies(incremental);
+    compilation.setStreaming(stream);
+    if (!compilation.parse()) {
       return 1;
     }
 
-    // Print tokens if you want to see the lexer output
-    // printTokenStream(tokens);
+    // Functions whose fingerprint is cached are neither checked nor
+    // generated again
+    std::unordered_map<const nodes::FunctionDeclNode *, std::string>
+        fingerprints;
+    std::unordered_map<const nodes::FunctionDeclNode *, std::string> reused;
+    if (incremental) {
+      driver::DependencyGraph graph(compilation.getAST());
+      std::unordered_set<const nodes::BaseNode *> unchecked;
+      for (const auto *function : graph.getFunctions()) {
+        std::string fingerprint = graph.getFingerprint(function);
+        std::string bitcode;
+        if (cache.fetchFunction(fingerprint, bitcode)) {
+          reused.emplace(function, std::move(bitcode));
+          unchecked.insert(function);
+        }
+        fingerprints.emplace(function, std::move(fingerprint));
+      }
+      compilation.setReused(std::move(unchecked));
+    }
 
-    // Parsing
-    parser::Parser parser(std::move(tokens), errorReporter);
-    if (!parser.parse()) {
+    if (!compilation.check()) {
+      return 1;
+    }
+    if (!interfacePath.empty() && !compilation.writeInterface(interfacePath)) {
       return 1;
     }
 
     // Get AST for next phase
-    const auto &ast = parser.getAST();
-    // TODO: Next phases (type checking, optimization, code generation)
+    const auto &ast = compilation.getAST();
+    std::vector<std::string> benchmarks;
+    if (bench) {
+      benchmarks = driver::BenchmarkRunner::findBenchmarks(ast);
+      if (benchmarks.empty()) {
+        std::cerr << "Error: No #bench functions to run\n";
+        return 1;
+      }
+    }
     if (!ast.getNodes().empty()) {
-      // Create code generator
-      codegen::CodeGenOptions options;
-      options.setOutputFilename(filePath + ".ll"); // Output LLVM IR
-
-      codegen::LLVMCodeGen codeGen(errorReporter);
+      // Partitions across -j threads; a single thread is a plain LLVMCodeGen
+      codegen::LLVMParallelCodeGen codeGen(errorReporter, options);
+      for (const auto &import : compilation.getImports()) {
+        codeGen.addImport(import);
+      }
+      if (stream) {
+        codeGen.setBodyStream(&compilation);
+      }
+      size_t reusedCount = reused.size();
+      if (incremental) {
+        codeGen.setFunctionCaching(std::move(reused));
+      }
 
       // if (codeGen.generateCode(ast)) {
       //   // Need to pass the options filename to the code generator
@@ -80,9 +338,41 @@ int main(int argc, char *argv[]) {
       //     return 1;
       //   }
       if (codeGen.generateCode(ast)) {
-        if (codeGen.writeToFile(options.getOutputFilename())) {
+        if (bench) {
+          errorReporter.flush();
+          driver::BenchmarkRunner runner(benchOptions);
+          std::vector<driver::BenchmarkResult> results;
+          if (!runner.run(codeGen, benchmarks, results)) {
+            errorReporter.flush();
+            std::cerr << "Benchmarks failed." << std::endl;
+            return 1;
+          }
+          driver::BenchmarkRunner::print(results, std::cout,
+                                         benchOptions.json);
+        } else if (run) {
+          // Warnings come before anything the program prints
+          errorReporter.flush();
+          if (!codeGen.executeCode()) {
+            std::cerr << "Execution failed." << std::endl;
+            return 1;
+          }
+          for (const auto &[function, bitcode] :
+               codeGen.getGeneratedFunctions()) {
+            cache.storeFunction(fingerprints.at(function), bitcode);
+          }
+        } else if (codeGen.writeToFile(options.getOutputFilename())) {
+          cache.store(options.getOutputFilename());
+          for (const auto &[function, bitcode] :
+               codeGen.getGeneratedFunctions()) {
+            cache.storeFunction(fingerprints.at(function), bitcode);
+          }
           std::cout << "Code generation successful. Output written to "
                     << options.getOutputFilename() << std::endl;
+          if (incremental) {
+            std::cout << "Incremental build: regenerated "
+                      << fingerprints.size() - reusedCount << " of "
+                      << fingerprints.size() << " functions" << std::endl;
+          }
 
           // Disable execution for now to avoid crashes
           // You can view the generated LLVM IR in the .ll file
@@ -92,6 +382,7 @@ int main(int argc, char *argv[]) {
         }
 
       } else {
+        errorReporter.flush();
         std::cerr << "Code generation failed." << std::endl;
         return 1;
       }
@@ -101,4 +392,76 @@ int main(int argc, char *argv[]) {
     std::cerr << "Fatal error: " << e.what() << "\n";
     return 1;
   }
-}
\ No newline at end of file
+}
+
+// Compiles, reporting where the time went if -time-report or -trace-out=
+// asks for it, however the compilation ends
+int compile(const std::vector<std::string> &args) {
+  bool timeReport = false;
+  std::string tracePath;
+  std::vector<std::string> compilerArgs;
+  for (const auto &arg : args) {
+    if (arg == "-time-report") {
+      timeReport = true;
+    } else if (arg.rfind("-trace-out=", 0) == 0) {
+      tracePath = arg.substr(11);
+    } else {
+      compilerArgs.push_back(arg);
+    }
+  }
+  if (!timeReport && tracePath.empty()) {
+    return compileProgram(compilerArgs);
+  }
+
+  auto &report = core::TimeReport::instance();
+  report.enable();
+  int status = compileProgram(compilerArgs);
+  if (timeReport) {
+    report.print(std::cerr);
+  }
+  if (!tracePath.empty() && !report.writeTrace(tracePath)) {
+    std::cerr << "Error: Could not write trace: " << tracePath << "\n";
+    status = status ? status : 1;
+  }
+  return status;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  std::vector<std::string> args(argv + 1, argv + argc);
+
+  // -server=<socket> keeps a compiler running for clients; -connect=<socket>
+  // or TSPP_SERVER hands this run to one, or runs it here if none answers
+  std::string serverPath;
+  unsigned idleSeconds = 0;
+  const char *connectPath = std::getenv("TSPP_SERVER");
+  std::string clientPath = connectPath ? connectPath : "";
+  std::vector<std::string> compilerArgs;
+  for (const auto &arg : args) {
+    if (arg.rfind("-server=", 0) == 0) {
+      serverPath = arg.substr(8);
+    } else if (arg.rfind("-server-timeout=", 0) == 0) {
+      char *end = nullptr;
+      idleSeconds = static_cast<unsigned>(std::strtoul(arg.c_str() + 16, &end, 10));
+      if (*end != '\0') {
+        std::cerr << "Error: Invalid option: " << arg << "\n";
+        return 1;
+      }
+    } else if (arg.rfind("-connect=", 0) == 0) {
+      clientPath = arg.substr(9);
+    } else {
+      compilerArgs.push_back(arg);
+    }
+  }
+
+  if (!serverPath.empty()) {
+    return driver::CompileServer(serverPath, compile).serve(idleSeconds);
+  }
+  int status;
+  if (!clientPath.empty() &&
+      driver::CompileServer::forward(clientPath, compilerArgs, status)) {
+    return status;
+  }
+  return compile(compilerArgs);
+}
@@ -4,24 +4,55 @@
  *****************************************************************************/
 
 #pragma once
+#include "ast_context.h"
 #include "nodes/base_node.h"
+#include <memory>
 #include <vector>
 
 namespace parser {
 
 class AST {
 public:
+  AST() : context_(std::make_unique<ASTContext>()) {}
+
+  // The AST owns its node arena, so it can be moved but not copied
+  AST(const AST &) = delete;
+  AST &operator=(const AST &) = delete;
+  AST(AST &&) = default;
+  AST &operator=(AST &&) = default;
+
   // Add a node to the AST (usually called during parsing)
-  void addNode(nodes::NodePtr node) { nodes_.push_back(std::move(node)); }
+  void addNode(nodes::NodePtr node) { nodes_.push_back(node); }
 
   // Access nodes
   const std::vector<nodes::NodePtr> &getNodes() const { return nodes_; }
 
-  // Clear the AST
-  void clear() { nodes_.clear(); }
+  // Append another AST's nodes, taking over the arenas that own them
+  void append(AST &&other) {
+    nodes_.insert(nodes_.end(), other.nodes_.begin(), other.nodes_.end());
+    adopted_.push_back(std::move(other.context_));
+    for (auto &context : other.adopted_) {
+      adopted_.push_back(std::move(context));
+    }
+    other.nodes_.clear();
+    other.adopted_.clear();
+  }
+
+  // Arena that owns every node reachable from this AST
+  ASTContext &getContext() { return *context_; }
+  const ASTContext &getContext() const { return *context_; }
+
+  // Clear the AST, releasing all nodes at once
+  void clear() {
+    nodes_.clear();
+    adopted_.clear();
+    context_ = std::make_unique<ASTContext>();
+  }
 
 private:
-  std::vector<nodes::NodePtr> nodes_; // Top-level nodes in the AST
+  std::unique_ptr<ASTContext> context_; // Owns all nodes
+  std::vector<std::unique_ptr<ASTContext>> adopted_; // Of appended ASTs
+  std::vector<nodes::NodePtr> nodes_;   // Top-level nodes in the AST
 };
 
-} // namespace parser
\ No newline at end of file
+} // namespace parser
@@ -0,0 +1,40 @@
+/*****************************************************************************
+ * File: ast_context.cpp
+ * Description: Implementation of the AST node arena
+ *****************************************************************************/
+
+#include "ast_context.h"
+#include <algorithm>
+#include <cstdint>
+
+namespace parser {
+
+ASTContext::~ASTContext() {
+  // Children are referenced by raw pointer, so destruction order is free;
+  // reverse order mirrors construction
+  for (auto it = nodes_.rbegin(); it != nodes_.rend(); ++it) {
+    (*it)->~BaseNode();
+  }
+}
+
+void *ASTContext::allocate(size_t size, size_t alignment) {
+  auto address = reinterpret_cast<std::uintptr_t>(cursor_);
+  std::uintptr_t aligned = (address + alignment - 1) & ~(alignment - 1);
+
+  if (!cursor_ || aligned + size > reinterpret_cast<std::uintptr_t>(end_)) {
+    // Oversized nodes get a dedicated slab
+    size_t slabSize = std::max(kSlabSize, size + alignment);
+    slabs_.emplace_back(new char[slabSize]);
+    cursor_ = slabs_.back().get();
+    end_ = cursor_ + slabSize;
+
+    address = reinterpret_cast<std::uintptr_t>(cursor_);
+    aligned = (address + alignment - 1) & ~(alignment - 1);
+  }
+
+  cursor_ = reinterpret_cast<char *>(aligned + size);
+  bytesAllocated_ += size;
+  return reinterpret_cast<void *>(aligned);
+}
+
+} // namespace parser
@@ -0,0 +1,61 @@
+/*****************************************************************************
+ * File: ast_context.h
+ * Description: Arena owning every AST node of a compilation
+ *****************************************************************************/
+
+#pragma once
+#include "core/common/macros.h"
+#include "nodes/base_node.h"
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace parser {
+
+/**
+ * @brief Bump-pointer arena for AST nodes
+ *
+ * Nodes are carved out of large slabs and referenced through raw pointers,
+ * so building and walking the tree does no per-node heap allocation or
+ * reference counting. All nodes are destroyed together with the context.
+ */
+class ASTContext {
+public:
+  ASTContext() = default;
+  NON_COPYABLE(ASTContext);
+  ~ASTContext();
+
+  /**
+   * @brief Allocates and constructs a node in the arena
+   * @param args Constructor arguments forwarded to the node
+   * @return Node owned by this context
+   */
+  template <typename T, typename... Args> T *create(Args &&...args) {
+    static_assert(std::is_base_of<nodes::BaseNode, T>::value,
+                  "ASTContext only allocates AST nodes");
+    void *memory = allocate(sizeof(T), alignof(T));
+    T *node = new (memory) T(std::forward<Args>(args)...);
+    nodes_.push_back(node);
+    return node;
+  }
+
+  // Arena statistics
+  size_t getNodeCount() const { return nodes_.size(); }
+  size_t getBytesAllocated() const { return bytesAllocated_; }
+
+private:
+  void *allocate(size_t size, size_t alignment);
+
+  static constexpr size_t kSlabSize = 64 * 1024;
+
+  std::vector<std::unique_ptr<char[]>> slabs_; // Backing memory
+  char *cursor_ = nullptr;                     // Next free byte in the slab
+  char *end_ = nullptr;                        // End of the current slab
+  std::vector<nodes::BaseNode *> nodes_;       // For running destructors
+  size_t bytesAllocated_ = 0;                  // Bytes handed out to nodes
+};
+
+} // namespace parser
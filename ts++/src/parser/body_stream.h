@@ -0,0 +1,42 @@
+/*****************************************************************************
+ * File: body_stream.h
+ * Description: Function bodies parsed only while something needs them
+ *****************************************************************************/
+
+#pragma once
+#include "parser/nodes/declaration_nodes.h"
+
+namespace parser {
+
+/**
+ * @brief Hands out the bodies of top-level functions one at a time
+ *
+ * A streamed function is checked as a declaration with the rest of the
+ * program, but its body is only a source range. load() parses, type-checks
+ * and folds the body, and release() frees it again, so the AST holds no
+ * more bodies than are in use at once. Loads nest: a body stays until it
+ * is released as often as it was loaded. Both may be called from several
+ * threads at once.
+ */
+class BodyStream {
+public:
+  virtual ~BodyStream() = default;
+
+  /**
+   * @brief Checks whether a function's body is left to the stream
+   */
+  virtual bool streams(const nodes::FunctionDeclNode *function) const = 0;
+
+  /**
+   * @brief Gives a streamed function its body until it is released
+   * @return True if the body parsed and checked; its errors are reported
+   */
+  virtual bool load(const nodes::FunctionDeclNode *function) = 0;
+
+  /**
+   * @brief Gives up a body load() gave, freeing it once nothing holds it
+   */
+  virtual void release(const nodes::FunctionDeclNode *function) = 0;
+};
+
+} // namespace parser
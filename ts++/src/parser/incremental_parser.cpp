@@ -0,0 +1,232 @@
+/*****************************************************************************
+ * File: incremental_parser.cpp
+ * Description: Implementation of edit-driven reparsing
+ *****************************************************************************/
+
+#include "incremental_parser.h"
+#include "lexer/lexer.h"
+#include "parser/parser.h"
+#include "parser/top_level_split.h"
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+
+namespace parser {
+
+IncrementalParser::IncrementalParser(std::string filename)
+    : filename_(std::move(filename)) {
+  parse("");
+}
+
+IncrementalParser::~IncrementalParser() {
+  items_.clear();
+  byFile_.clear();
+  releaseUnusedFiles();
+}
+
+bool IncrementalParser::parse(std::string source) {
+  source_ = std::move(source);
+  core::FileId file = core::SourceManager::instance().addFile(filename_,
+                                                              source_);
+  files_.push_back(file);
+  std::vector<tokens::Token> tokens = lexer::Lexer(file).tokenize();
+  if (!tokens.empty() &&
+      tokens.back().getType() == tokens::TokenType::END_OF_FILE) {
+    tokens.pop_back();
+  }
+  lexedTokens_ = tokens.size();
+  items_ = parseItems(std::move(tokens), file, 0,
+                      static_cast<std::uint32_t>(source_.size()));
+  parsedItems_ = items_.size();
+  collectNodes();
+  releaseUnusedFiles();
+  return !hasErrors();
+}
+
+bool IncrementalParser::edit(const TextEdit &edit) {
+  if (edit.offset > source_.size() ||
+      edit.length > source_.size() - edit.offset) {
+    throw std::out_of_range("Edit outside of " + filename_);
+  }
+  source_.replace(edit.offset, edit.length, edit.text);
+  core::FileId file = core::SourceManager::instance().addFile(filename_,
+                                                              source_);
+  files_.push_back(file);
+  std::int64_t delta = static_cast<std::int64_t>(edit.text.size()) -
+                       static_cast<std::int64_t>(edit.length);
+  std::uint32_t editEnd = edit.offset + edit.length;
+  auto shifted = [&](const Item &item) {
+    return static_cast<std::uint32_t>(item.start + delta);
+  };
+
+  // Relexing starts at the item the edit is in. An edit at the very start
+  // of an item may join its first token to the last one before it.
+  size_t first = 0;
+  while (first + 1 < items_.size() && items_[first + 1]->start < edit.offset) {
+    ++first;
+  }
+  // Items starting past the edit are the ones that may be reused
+  size_t next = first + 1;
+  while (next < items_.size() && items_[next]->start < editEnd) {
+    ++next;
+  }
+
+  // Relex until a token starts where one of them does, at a safe cut; the
+  // text after it is unchanged, so it lexes and parses as it did before
+  lexer::Lexer lexer(file, items_[first]->start,
+                     static_cast<std::uint32_t>(source_.size()));
+  TopLevelScanner scanner;
+  std::vector<tokens::Token> relexed;
+  size_t reuse = items_.size();
+  while (true) {
+    tokens::Token token = lexer.next();
+    if (token.getType() == tokens::TokenType::END_OF_FILE) {
+      break;
+    }
+    while (next < items_.size() && shifted(*items_[next]) < token.getOffset()) {
+      ++next;
+    }
+    bool cut = scanner.next(token.getType());
+    if (cut && next < items_.size() && !token.isSynthetic() &&
+        token.getOffset() == shifted(*items_[next])) {
+      const tokens::Token &old = items_[next]->tokens.front();
+      if (token.getType() == old.getType() &&
+          token.getLength() == old.getLength()) {
+        reuse = next;
+        break;
+      }
+    }
+    relexed.push_back(token);
+  }
+  lexedTokens_ = relexed.size();
+
+  std::uint32_t end = reuse < items_.size()
+                          ? shifted(*items_[reuse])
+                          : static_cast<std::uint32_t>(source_.size());
+  Items parsed =
+      parseItems(std::move(relexed), file, items_[first]->start, end);
+  parsedItems_ = parsed.size();
+  for (size_t i = reuse; i < items_.size(); ++i) {
+    items_[i]->start = shifted(*items_[i]);
+  }
+  items_.erase(items_.begin() + first, items_.begin() + reuse);
+  items_.insert(items_.begin() + first, std::make_move_iterator(parsed.begin()),
+                std::make_move_iterator(parsed.end()));
+  collectNodes();
+  releaseUnusedFiles();
+  return !hasErrors();
+}
+
+IncrementalParser::Items
+IncrementalParser::parseItems(std::vector<tokens::Token> tokens,
+                              core::FileId file, std::uint32_t begin,
+                              std::uint32_t end) const {
+  Items items;
+  std::vector<size_t> starts = splitTopLevel(tokens, 1);
+  for (size_t i = 0; i < starts.size(); ++i) {
+    size_t last = i + 1 < starts.size() ? starts[i + 1] : tokens.size();
+    auto item = std::make_unique<Item>();
+    item->file = file;
+    item->start = i == 0 ? begin : tokens[starts[i]].getOffset();
+    item->bufferStart = item->start;
+    item->tokens.assign(tokens.begin() + starts[i], tokens.begin() + last);
+
+    // Each item ends in an END_OF_FILE token where the next one starts
+    std::vector<tokens::Token> stream = item->tokens;
+    std::uint32_t next = last < tokens.size() ? tokens[last].getOffset() : end;
+    stream.push_back(tokens::Token::createSynthetic(
+        tokens::TokenType::END_OF_FILE, file, next));
+    Parser parser(std::move(stream), item->diagnostics);
+    item->success = parser.parse(false);
+    item->ast = parser.takeAST();
+    items.push_back(std::move(item));
+  }
+  return items;
+}
+
+void IncrementalParser::collectNodes() {
+  nodes_.clear();
+  byFile_.clear();
+  for (size_t i = 0; i < items_.size(); ++i) {
+    const auto &nodes = items_[i]->ast.getNodes();
+    nodes_.insert(nodes_.end(), nodes.begin(), nodes.end());
+    byFile_[items_[i]->file].push_back(i);
+  }
+}
+
+void IncrementalParser::releaseUnusedFiles() {
+  auto unused = std::partition(files_.begin(), files_.end(),
+                               [&](core::FileId file) {
+                                 return byFile_.count(file) != 0;
+                               });
+  for (auto it = unused; it != files_.end(); ++it) {
+    core::SourceManager::instance().releaseFile(*it);
+  }
+  files_.erase(unused, files_.end());
+}
+
+std::vector<tokens::Token> IncrementalParser::getTokens() const {
+  std::vector<tokens::Token> tokens;
+  for (const auto &item : items_) {
+    tokens.insert(tokens.end(), item->tokens.begin(), item->tokens.end());
+  }
+  return tokens;
+}
+
+std::vector<std::uint32_t> IncrementalParser::getTokenOffsets() const {
+  std::vector<std::uint32_t> offsets;
+  for (const auto &item : items_) {
+    for (const auto &token : item->tokens) {
+      offsets.push_back(item->start + (token.getOffset() - item->bufferStart));
+    }
+  }
+  return offsets;
+}
+
+std::vector<core::Diagnostic> IncrementalParser::getDiagnostics() const {
+  std::vector<core::Diagnostic> diagnostics;
+  for (const auto &item : items_) {
+    const auto &own = item->diagnostics.getDiagnostics();
+    diagnostics.insert(diagnostics.end(), own.begin(), own.end());
+  }
+  return diagnostics;
+}
+
+bool IncrementalParser::hasErrors() const {
+  for (const auto &item : items_) {
+    if (!item->success || item->diagnostics.hasErrors()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+std::uint32_t IncrementalParser::currentOffset(core::FileId fileId,
+                                               std::uint32_t offset) const {
+  auto found = byFile_.find(fileId);
+  if (found == byFile_.end()) {
+    return offset;
+  }
+  // The last item of the buffer starting at or before the offset
+  const std::vector<size_t> &indices = found->second;
+  auto after = std::upper_bound(
+      indices.begin(), indices.end(), offset,
+      [&](std::uint32_t value, size_t i) {
+        return value < items_[i]->bufferStart;
+      });
+  if (after == indices.begin()) {
+    return offset;
+  }
+  size_t i = *(after - 1);
+  const Item &item = *items_[i];
+  std::uint32_t length =
+      (i + 1 < items_.size() ? items_[i + 1]->start
+                             : static_cast<std::uint32_t>(source_.size())) -
+      item.start;
+  if (offset > item.bufferStart + length) {
+    return offset;
+  }
+  return item.start + (offset - item.bufferStart);
+}
+
+} // namespace parser
@@ -0,0 +1,131 @@
+/*****************************************************************************
+ * File: incremental_parser.h
+ * Description: Reparses a document after an edit, reusing what it left alone
+ *****************************************************************************/
+
+#pragma once
+#include "core/common/macros.h"
+#include "core/common/source_manager.h"
+#include "core/diagnostics/error_reporter.h"
+#include "parser/ast.h"
+#include "tokens/tokens.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace parser {
+
+/**
+ * @brief Replaces [offset, offset + length) of a document with text
+ */
+struct TextEdit {
+  std::uint32_t offset = 0;
+  std::uint32_t length = 0;
+  std::string text;
+};
+
+/**
+ * @brief Keeps the parse of a document up to date as it is edited
+ *
+ * The document is held as the top-level items splitTopLevel would cut it
+ * into, each with its own tokens, nodes and diagnostics. An edit is relexed
+ * from the item it starts in until the lexer reaches the start of an item
+ * past the edit at a safe cut, and only the items in between are parsed
+ * again. The items after it are reused untouched, so the work an edit
+ * takes grows with the items it touches rather than with the document.
+ * An edit that leaves brackets unbalanced has no safe cut after it, and
+ * the rest of the document is parsed again.
+ *
+ * Every version of the document is a new SourceManager buffer. Reused
+ * tokens and nodes keep pointing into the buffer they were lexed from,
+ * which holds the same text; currentOffset maps them to the document. A
+ * buffer is released once no item is left from it, so a document keeps
+ * about one copy of its text however often it is edited.
+ */
+class IncrementalParser {
+public:
+  NON_COPYABLE(IncrementalParser);
+
+  explicit IncrementalParser(std::string filename);
+  ~IncrementalParser();
+
+  /**
+   * @brief Parses a new document from scratch
+   * @param source The document's text
+   * @return true if it parsed without errors
+   */
+  bool parse(std::string source);
+
+  /**
+   * @brief Applies an edit to the document and reparses what it touched
+   * @param edit The range to replace, which must lie within the document
+   * @return true if the document parsed without errors
+   */
+  bool edit(const TextEdit &edit);
+
+  const std::string &getSource() const { return source_; }
+
+  // Top-level nodes of the document, in order
+  const std::vector<nodes::NodePtr> &getNodes() const { return nodes_; }
+
+  // Tokens of the document, without the END_OF_FILE token
+  std::vector<tokens::Token> getTokens() const;
+
+  // Offsets of those tokens in the current document
+  std::vector<std::uint32_t> getTokenOffsets() const;
+
+  // Diagnostics of the document, in order
+  std::vector<core::Diagnostic> getDiagnostics() const;
+
+  bool hasErrors() const;
+
+  /**
+   * @brief Maps an offset in a buffer the document was lexed from
+   * @param fileId The buffer of a token or node location
+   * @param offset Its offset in that buffer
+   * @return Its offset in the current document
+   */
+  std::uint32_t currentOffset(core::FileId fileId, std::uint32_t offset) const;
+
+  // Whether a token or node location lies in a buffer of the document
+  bool ownsFile(core::FileId fileId) const { return byFile_.count(fileId); }
+
+  // Items the last parse or edit parsed, and tokens it lexed
+  size_t getParsedItems() const { return parsedItems_; }
+  size_t getLexedTokens() const { return lexedTokens_; }
+
+private:
+  struct Item {
+    core::FileId file = core::INVALID_FILE_ID; // Buffer it was lexed from
+    std::uint32_t start = 0;       // Offset of its text in the document
+    std::uint32_t bufferStart = 0; // Offset of the same text in file
+    std::vector<tokens::Token> tokens;
+    AST ast;
+    core::ErrorReporter diagnostics{false};
+    bool success = false;
+  };
+  using Items = std::vector<std::unique_ptr<Item>>;
+
+  // Parses the tokens lexed from [begin, end) of file into items
+  Items parseItems(std::vector<tokens::Token> tokens, core::FileId file,
+                   std::uint32_t begin, std::uint32_t end) const;
+  // Gathers the nodes of the items and indexes them by buffer
+  void collectNodes();
+  // Releases the buffers no item was lexed from
+  void releaseUnusedFiles();
+
+  std::string filename_;
+  std::string source_;
+  Items items_; // Never empty; the first starts at offset 0
+  std::vector<nodes::NodePtr> nodes_;
+  // Items of each buffer, in document order, which is also buffer order
+  std::unordered_map<core::FileId, std::vector<size_t>> byFile_;
+  std::vector<core::FileId> files_; // Buffers registered and not released
+  size_t parsedItems_ = 0;
+  size_t lexedTokens_ = 0;
+};
+
+} // namespace parser
@@ -5,25 +5,126 @@
 
 #pragma once
 #include "core/common/common_types.h"
+#include "core/common/macros.h"
 #include "parser/interfaces/base_interface.h"
+#include <cstdint>
 #include <memory>
+#include <type_traits>
 
 namespace nodes {
 
+/**
+ * @brief Concrete kind of an AST node
+ *
+ * Every node records its kind at construction so passes can dispatch with
+ * a switch instead of a chain of dynamic_casts. Kinds of one family are
+ * contiguous, and a subclass directly follows its parent, so family and
+ * subclass checks are simple range tests.
+ */
+enum class NodeKind : uint8_t {
+  // Expressions
+  BinaryExpression,
+  UnaryExpression,
+  LiteralExpression,
+  IdentifierExpression,
+  ArrayLiteral,
+  ConditionalExpression,
+  AssignmentExpression,
+  CallExpression,
+  MemberExpression,
+  IndexExpression,
+  ThisExpression,
+  NewExpression,
+  CastExpression,
+  CompileTimeExpression,
+  TemplateSpecialization,
+  PointerExpression,
+  FunctionExpression,
+  FirstExpression = BinaryExpression,
+  LastExpression = FunctionExpression,
+
+  // Attributes
+  Attribute,
+
+  // Statements
+  DeclarationStmt,
+  Block,
+  ExpressionStmt,
+  IfStmt,
+  WhileStmt,
+  DoWhileStmt,
+  ForStmt,
+  ForOfStmt,
+  BreakStmt,
+  ContinueStmt,
+  ReturnStmt,
+  TryStmt,
+  ThrowStmt,
+  SwitchStmt,
+  AssemblyStmt,
+  LabeledStatement,
+  FirstStatement = DeclarationStmt,
+  LastStatement = LabeledStatement,
+
+  // Declarations
+  VarDecl,
+  Parameter,
+  FunctionDecl,
+  GenericFunctionDecl,
+  ClassDecl,
+  GenericClassDecl,
+  ConstructorDecl,
+  MethodDecl,
+  FieldDecl,
+  PropertyDecl,
+  NamespaceDecl,
+  EnumMember,
+  EnumDecl,
+  MethodSignature,
+  PropertySignature,
+  InterfaceDecl,
+  GenericInterfaceDecl,
+  TypedefDecl,
+  FirstDeclaration = VarDecl,
+  LastDeclaration = TypedefDecl,
+
+  // Types
+  PrimitiveType,
+  NamedType,
+  QualifiedType,
+  ArrayType,
+  PointerType,
+  ReferenceType,
+  FunctionType,
+  TemplateType,
+  SmartPointerType,
+  AtomicType,
+  UnionType,
+  GenericParam,
+  BuiltinConstraint,
+  FirstType = PrimitiveType,
+  LastType = BuiltinConstraint
+};
+
 /**
  * @brief Base class for all AST nodes
  *
  * Provides common functionality for all nodes in the AST:
  * - Source location tracking for error reporting
+ * - Kind tag for switch dispatch and isa/cast/dyn_cast
  * - Visitor pattern support
- * - Memory management through smart pointers
+ * - Arena ownership through the parser::ASTContext
  */
 class BaseNode {
 public:
-  explicit BaseNode(const core::SourceLocation &loc) : location_(loc) {}
+  BaseNode(NodeKind kind, const core::SourceLocation &loc)
+      : location_(loc), nodeKind_(kind) {}
 
   virtual ~BaseNode() = default;
 
+  // Get the concrete node kind
+  NodeKind getNodeKind() const { return nodeKind_; }
+
   // Get source location for error reporting
   const core::SourceLocation &getLocation() const { return location_; }
 
@@ -31,10 +132,54 @@ public:
   virtual bool accept(interface::BaseInterface *visitor) = 0;
 
 protected:
+  // Checks whether a kind lies in the inclusive range [first, last]
+  static bool inKindRange(const BaseNode *node, NodeKind first,
+                          NodeKind last) {
+    return node->getNodeKind() >= first && node->getNodeKind() <= last;
+  }
+
   core::SourceLocation location_;
+  NodeKind nodeKind_;
 };
 
-// Smart pointer type for nodes
-using NodePtr = std::shared_ptr<BaseNode>;
+// Raw pointer type for nodes
+using NodePtr = BaseNode *;
+
+/*****************************************************************************
+ * Kind-Based Casting
+ *
+ * Each node class provides a static classof(const BaseNode *) that checks
+ * the kind tag, so these never touch RTTI.
+ *****************************************************************************/
+
+/**
+ * @brief Checks whether a non-null node is a T (or a subclass of T)
+ */
+template <typename T> bool isa(const BaseNode *node) {
+  ASSERT_MSG(node, "isa<> used on a null node");
+  return T::classof(node);
+}
+
+// Result of casting From * to T, preserving constness
+template <typename T, typename From>
+using CastResult =
+    typename std::conditional<std::is_const<From>::value, const T, T>::type *;
+
+/**
+ * @brief Downcasts a node that is known to be a T
+ */
+template <typename T, typename From> CastResult<T, From> cast(From *node) {
+  ASSERT_MSG(isa<T>(node), "cast<> to an incompatible node kind");
+  return static_cast<CastResult<T, From>>(node);
+}
+
+/**
+ * @brief Downcasts a node if it is a T, otherwise returns nullptr
+ *
+ * Null input yields nullptr, matching the dynamic_cast it replaces.
+ */
+template <typename T, typename From> CastResult<T, From> dyn_cast(From *node) {
+  return node && T::classof(node) ? cast<T>(node) : nullptr;
+}
 
-} // namespace nodes
\ No newline at end of file
+} // namespace nodes
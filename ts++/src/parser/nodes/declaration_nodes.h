@@ -8,6 +8,7 @@
 #include "expression_nodes.h"
 #include "tokens/token_type.h"
 #include "type_nodes.h"
+#include <cstdint>
 #include <memory>
 #include <vector>
 
@@ -15,16 +16,28 @@ namespace nodes {
 
 // Forward declaration for BlockNode - will be implemented later
 class BlockNode;
-using BlockPtr = std::shared_ptr<BlockNode>;
-using AttributePtr = std::shared_ptr<AttributeNode>;
+using BlockPtr = BlockNode *;
+using AttributePtr = AttributeNode *;
+
+/**
+ * Source range of a body the parser skipped, to be parsed when needed
+ */
+struct DeferredBody {
+  core::FileId file = core::INVALID_FILE_ID;
+  std::uint32_t begin = 0; // Offset of the opening brace
+  std::uint32_t end = 0;   // Offset just past the closing brace
+
+  explicit operator bool() const { return file != core::INVALID_FILE_ID; }
+};
 
 /**
  * Base class for all declaration nodes
  */
 class DeclarationNode : public BaseNode {
 public:
-  DeclarationNode(const std::string &name, const core::SourceLocation &loc)
-      : BaseNode(loc), name_(name) {}
+  DeclarationNode(NodeKind kind, const std::string &name,
+                  const core::SourceLocation &loc)
+      : BaseNode(kind, loc), name_(name) {}
 
   virtual ~DeclarationNode() = default;
 
@@ -34,12 +47,17 @@ public:
     attributes_.push_back(std::move(attr));
   }
 
+  static bool classof(const BaseNode *node) {
+    return inKindRange(node, NodeKind::FirstDeclaration,
+                       NodeKind::LastDeclaration);
+  }
+
 protected:
   std::string name_;                     // Declaration name
   std::vector<AttributePtr> attributes_; // Attributes (#stack, #inline, etc.)
 };
 
-using DeclPtr = std::shared_ptr<DeclarationNode>;
+using DeclPtr = DeclarationNode *;
 
 /**
  * Variable declaration node (let x: int = 42)
@@ -49,7 +67,7 @@ public:
   VarDeclNode(const std::string &name, TypePtr type, ExpressionPtr initializer,
               tokens::TokenType storageClass, bool isConst,
               const core::SourceLocation &loc)
-      : DeclarationNode(name, loc), type_(std::move(type)),
+      : DeclarationNode(NodeKind::VarDecl, name, loc), type_(std::move(type)),
         initializer_(std::move(initializer)), storageClass_(storageClass),
         isConst_(isConst) {}
 
@@ -62,6 +80,10 @@ public:
     return visitor->visitParse();
   }
 
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::VarDecl;
+  }
+
 private:
   TypePtr type_;                   // Variable type (can be nullptr if inferred)
   ExpressionPtr initializer_;      // Initial value (can be nullptr)
@@ -77,7 +99,7 @@ public:
   ParameterNode(const std::string &name, TypePtr type,
                 ExpressionPtr defaultValue, bool isRef, bool isConst,
                 const core::SourceLocation &loc)
-      : DeclarationNode(name, loc), type_(std::move(type)),
+      : DeclarationNode(NodeKind::Parameter, name, loc), type_(std::move(type)),
         defaultValue_(std::move(defaultValue)), isRef_(isRef),
         isConst_(isConst) {}
 
@@ -90,6 +112,10 @@ public:
     return visitor->visitParse();
   }
 
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::Parameter;
+  }
+
 private:
   TypePtr type_;               // Parameter type
   ExpressionPtr defaultValue_; // Default value (can be nullptr)
@@ -97,7 +123,7 @@ private:
   bool isConst_;               // Whether parameter is const
 };
 
-using ParamPtr = std::shared_ptr<ParameterNode>;
+using ParamPtr = ParameterNode *;
 
 /**
  * Function declaration node
@@ -108,8 +134,9 @@ public:
                    TypePtr returnType,
                    std::vector<TypePtr> throwsTypes,         // Add throws types
                    std::vector<tokens::TokenType> modifiers, // Add modifiers
-                   BlockPtr body, bool isAsync, const core::SourceLocation &loc)
-      : DeclarationNode(name, loc), parameters_(std::move(params)),
+                   BlockPtr body, bool isAsync, const core::SourceLocation &loc,
+                   NodeKind kind = NodeKind::FunctionDecl)
+      : DeclarationNode(kind, name, loc), parameters_(std::move(params)),
         returnType_(std::move(returnType)),
         throwsTypes_(std::move(throwsTypes)), modifiers_(std::move(modifiers)),
         body_(std::move(body)), isAsync_(isAsync) {}
@@ -125,10 +152,39 @@ public:
   BlockPtr getBody() const { return body_; }
   bool isAsync() const { return isAsync_; }
 
+  // A body parsed with deferred bodies is only a source range until
+  // parser::Parser::parseBodies() parses it
+  bool hasBody() const { return body_ || deferredBody_; }
+  const DeferredBody &getDeferredBody() const { return deferredBody_; }
+  void deferBody(DeferredBody body) { deferredBody_ = body; }
+  void setBody(BlockPtr body) {
+    body_ = body;
+    deferredBody_ = DeferredBody();
+  }
+
+  // Instruction sets from #target("..."), e.g. "avx2,arch=haswell"
+  const std::string &getTarget() const { return target_; }
+  void setTarget(std::string target) { target_ = std::move(target); }
+
+  // An extern "C" declaration has no body and is called with the C
+  // calling convention; a variadic one takes more arguments after its
+  // parameters, as C's ... does
+  bool isExternC() const { return externC_; }
+  bool isVariadic() const { return variadic_; }
+  void setExternC(bool variadic) {
+    externC_ = true;
+    variadic_ = variadic;
+  }
+
   bool accept(interface::BaseInterface *visitor) override {
     return visitor->visitParse();
   }
 
+  static bool classof(const BaseNode *node) {
+    return inKindRange(node, NodeKind::FunctionDecl,
+                       NodeKind::GenericFunctionDecl);
+  }
+
 private:
   std::vector<ParamPtr> parameters_;
   TypePtr returnType_;
@@ -136,6 +192,10 @@ private:
   std::vector<tokens::TokenType> modifiers_; // Store function modifiers
   BlockPtr body_;
   bool isAsync_;
+  std::string target_; // Empty without #target
+  DeferredBody deferredBody_; // Set while the body is not parsed
+  bool externC_ = false;
+  bool variadic_ = false;
 };
 
 /**
@@ -152,7 +212,8 @@ public:
       BlockPtr body, bool isAsync, const core::SourceLocation &loc)
       : FunctionDeclNode(name, std::move(params), std::move(returnType),
                          std::move(throwsTypes), // Pass throws types to base
-                         std::move(modifiers), std::move(body), isAsync, loc),
+                         std::move(modifiers), std::move(body), isAsync, loc,
+                         NodeKind::GenericFunctionDecl),
         genericParams_(std::move(genericParams)),
         constraints_(std::move(constraints)) {}
 
@@ -167,6 +228,10 @@ public:
     return visitor->visitParse();
   }
 
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::GenericFunctionDecl;
+  }
+
 private:
   std::vector<TypePtr> genericParams_;
   std::vector<std::pair<std::string, TypePtr>> constraints_;
@@ -180,8 +245,10 @@ public:
   ClassDeclNode(const std::string &name,
                 std::vector<tokens::TokenType> classModifiers,
                 TypePtr baseClass, std::vector<TypePtr> interfaces,
-                std::vector<DeclPtr> members, const core::SourceLocation &loc)
-      : DeclarationNode(name, loc), classModifiers_(std::move(classModifiers)),
+                std::vector<DeclPtr> members, const core::SourceLocation &loc,
+                NodeKind kind = NodeKind::ClassDecl)
+      : DeclarationNode(kind, name, loc),
+        classModifiers_(std::move(classModifiers)),
         baseClass_(std::move(baseClass)), interfaces_(std::move(interfaces)),
         members_(std::move(members)) {}
 
@@ -192,16 +259,25 @@ public:
   const std::vector<TypePtr> &getInterfaces() const { return interfaces_; }
   const std::vector<DeclPtr> &getMembers() const { return members_; }
 
+  // Byte alignment from #aligned(N); 0 keeps the natural alignment
+  unsigned getAlignment() const { return alignment_; }
+  void setAlignment(unsigned alignment) { alignment_ = alignment; }
+
   bool accept(interface::BaseInterface *visitor) override {
     return visitor->visitParse();
   }
 
+  static bool classof(const BaseNode *node) {
+    return inKindRange(node, NodeKind::ClassDecl, NodeKind::GenericClassDecl);
+  }
+
 private:
   std::vector<tokens::TokenType>
       classModifiers_;              // #aligned, #packed, #abstract
   TypePtr baseClass_;               // Base class (can be nullptr)
   std::vector<TypePtr> interfaces_; // Implemented interfaces
   std::vector<DeclPtr> members_;    // Class members
+  unsigned alignment_ = 0;          // #aligned(N) in bytes, 0 if natural
 };
 
 class GenericClassDeclNode : public ClassDeclNode {
@@ -213,13 +289,18 @@ public:
                        std::vector<TypePtr> genericParams,
                        const core::SourceLocation &loc)
       : ClassDeclNode(name, std::move(classModifiers), std::move(baseClass),
-                      std::move(interfaces), std::move(members), loc),
+                      std::move(interfaces), std::move(members), loc,
+                      NodeKind::GenericClassDecl),
         genericParams_(std::move(genericParams)) {}
 
   const std::vector<TypePtr> &getGenericParams() const {
     return genericParams_;
   }
 
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::GenericClassDecl;
+  }
+
 private:
   std::vector<TypePtr> genericParams_;
 };
@@ -229,8 +310,9 @@ public:
   ConstructorDeclNode(tokens::TokenType accessModifier,
                       std::vector<ParamPtr> parameters, BlockPtr body,
                       const core::SourceLocation &loc)
-      : DeclarationNode("constructor", loc), accessModifier_(accessModifier),
-        parameters_(std::move(parameters)), body_(std::move(body)) {}
+      : DeclarationNode(NodeKind::ConstructorDecl, "constructor", loc),
+        accessModifier_(accessModifier), parameters_(std::move(parameters)),
+        body_(std::move(body)) {}
 
   tokens::TokenType getAccessModifier() const { return accessModifier_; }
   const std::vector<ParamPtr> &getParameters() const { return parameters_; }
@@ -242,6 +324,10 @@ public:
     return visitor->visitParse();
   }
 
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::ConstructorDecl;
+  }
+
 private:
   tokens::TokenType accessModifier_; // e.g. PUBLIC, PRIVATE, PROTECTED
   std::vector<ParamPtr> parameters_; // List of parameters
@@ -256,8 +342,9 @@ public:
                  std::vector<TypePtr> throwsTypes,
                  std::vector<tokens::TokenType> modifiers, BlockPtr body,
                  const core::SourceLocation &loc)
-      : DeclarationNode(methodName, loc), accessModifier_(accessModifier),
-        parameters_(std::move(parameters)), returnType_(std::move(returnType)),
+      : DeclarationNode(NodeKind::MethodDecl, methodName, loc),
+        accessModifier_(accessModifier), parameters_(std::move(parameters)),
+        returnType_(std::move(returnType)),
         throwsTypes_(std::move(throwsTypes)), modifiers_(std::move(modifiers)),
         body_(std::move(body)) {}
 
@@ -270,11 +357,28 @@ public:
   }
   BlockPtr getBody() const { return body_; }
 
+  // As for FunctionDeclNode, the body may be deferred
+  bool hasBody() const { return body_ || deferredBody_; }
+  const DeferredBody &getDeferredBody() const { return deferredBody_; }
+  void deferBody(DeferredBody body) { deferredBody_ = body; }
+  void setBody(BlockPtr body) {
+    body_ = body;
+    deferredBody_ = DeferredBody();
+  }
+
+  // Instruction sets from #target("..."), e.g. "avx2,arch=haswell"
+  const std::string &getTarget() const { return target_; }
+  void setTarget(std::string target) { target_ = std::move(target); }
+
   bool accept(interface::BaseInterface *visitor) override {
     // e.g. visitor->visitMethod(this);
     return visitor->visitParse();
   }
 
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::MethodDecl;
+  }
+
 private:
   tokens::TokenType accessModifier_;
   std::vector<ParamPtr> parameters_;
@@ -282,6 +386,8 @@ private:
   std::vector<TypePtr> throwsTypes_;
   std::vector<tokens::TokenType> modifiers_; // e.g. #inline, #virtual, #unsafe
   BlockPtr body_;
+  std::string target_; // Empty without #target
+  DeferredBody deferredBody_; // Set while the body is not parsed
 };
 
 class FieldDeclNode : public DeclarationNode {
@@ -289,9 +395,9 @@ public:
   FieldDeclNode(const std::string &name, tokens::TokenType accessModifier,
                 bool isConst, TypePtr type, ExpressionPtr initializer,
                 const core::SourceLocation &loc)
-      : DeclarationNode(name, loc), accessModifier_(accessModifier),
-        isConst_(isConst), type_(std::move(type)),
-        initializer_(std::move(initializer)) {}
+      : DeclarationNode(NodeKind::FieldDecl, name, loc),
+        accessModifier_(accessModifier), isConst_(isConst),
+        type_(std::move(type)), initializer_(std::move(initializer)) {}
 
   tokens::TokenType getAccessModifier() const { return accessModifier_; }
   bool isConst() const { return isConst_; }
@@ -303,6 +409,10 @@ public:
     return visitor->visitParse();
   }
 
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::FieldDecl;
+  }
+
 private:
   tokens::TokenType accessModifier_; // e.g. PUBLIC, PRIVATE, PROTECTED
   bool isConst_;                     // declared with 'const' vs 'let'
@@ -319,9 +429,9 @@ public:
                    tokens::TokenType accessModifier, PropertyKind kind,
                    TypePtr propertyType, // e.g. :int
                    BlockPtr body, const core::SourceLocation &loc)
-      : DeclarationNode(propName, loc), accessModifier_(accessModifier),
-        kind_(kind), propertyType_(std::move(propertyType)),
-        body_(std::move(body)) {}
+      : DeclarationNode(NodeKind::PropertyDecl, propName, loc),
+        accessModifier_(accessModifier), kind_(kind),
+        propertyType_(std::move(propertyType)), body_(std::move(body)) {}
 
   // For a setter (where you'd have a parameter):
   // You could add another constructor or store a ParameterNode for "value".
@@ -336,6 +446,10 @@ public:
     return visitor->visitParse();
   }
 
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::PropertyDecl;
+  }
+
 private:
   tokens::TokenType accessModifier_;
   PropertyKind kind_;    // Getter vs. Setter
@@ -350,7 +464,8 @@ class NamespaceDeclNode : public DeclarationNode {
 public:
   NamespaceDeclNode(const std::string &name, std::vector<DeclPtr> declarations,
                     const core::SourceLocation &loc)
-      : DeclarationNode(name, loc), declarations_(std::move(declarations)) {}
+      : DeclarationNode(NodeKind::NamespaceDecl, name, loc),
+        declarations_(std::move(declarations)) {}
 
   const std::vector<DeclPtr> &getDeclarations() const { return declarations_; }
 
@@ -358,6 +473,10 @@ public:
     return visitor->visitParse();
   }
 
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::NamespaceDecl;
+  }
+
 private:
   std::vector<DeclPtr> declarations_; // Declarations inside the namespace
 };
@@ -370,19 +489,30 @@ public:
   EnumMemberNode(const std::string &name,
                  ExpressionPtr value, // Optional explicit value
                  const core::SourceLocation &loc)
-      : DeclarationNode(name, loc), value_(std::move(value)) {}
+      : DeclarationNode(NodeKind::EnumMember, name, loc),
+        value_(std::move(value)) {}
 
   ExpressionPtr getValue() const { return value_; }
 
+  // Value folded by the type checker: the explicit value, or one more than
+  // the previous member's
+  int64_t getConstantValue() const { return constantValue_; }
+  void setConstantValue(int64_t value) { constantValue_ = value; }
+
   bool accept(interface::BaseInterface *visitor) override {
     return visitor->visitParse();
   }
 
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::EnumMember;
+  }
+
 private:
   ExpressionPtr value_; // Optional explicit value for the enum member
+  int64_t constantValue_ = 0;
 };
 
-using EnumMemberPtr = std::shared_ptr<EnumMemberNode>;
+using EnumMemberPtr = EnumMemberNode *;
 
 /**
  * Enum declaration node
@@ -393,7 +523,8 @@ public:
       const std::string &name,
       TypePtr underlyingType, // Optional underlying type (e.g., int, string)
       std::vector<EnumMemberPtr> members, const core::SourceLocation &loc)
-      : DeclarationNode(name, loc), underlyingType_(std::move(underlyingType)),
+      : DeclarationNode(NodeKind::EnumDecl, name, loc),
+        underlyingType_(std::move(underlyingType)),
         members_(std::move(members)) {}
 
   TypePtr getUnderlyingType() const { return underlyingType_; }
@@ -403,6 +534,10 @@ public:
     return visitor->visitParse();
   }
 
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::EnumDecl;
+  }
+
 private:
   TypePtr underlyingType_;             // Optional underlying type
   std::vector<EnumMemberPtr> members_; // Enum members
@@ -417,8 +552,9 @@ public:
                       std::vector<ParamPtr> parameters, TypePtr returnType,
                       std::vector<TypePtr> throwsTypes,
                       const core::SourceLocation &loc)
-      : DeclarationNode(name, loc), accessModifier_(accessModifier),
-        parameters_(std::move(parameters)), returnType_(std::move(returnType)),
+      : DeclarationNode(NodeKind::MethodSignature, name, loc),
+        accessModifier_(accessModifier), parameters_(std::move(parameters)),
+        returnType_(std::move(returnType)),
         throwsTypes_(std::move(throwsTypes)) {}
 
   tokens::TokenType getAccessModifier() const { return accessModifier_; }
@@ -430,6 +566,10 @@ public:
     return visitor->visitParse();
   }
 
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::MethodSignature;
+  }
+
 private:
   tokens::TokenType accessModifier_; // public, private, protected
   std::vector<ParamPtr> parameters_; // Method parameters
@@ -446,8 +586,9 @@ public:
                         tokens::TokenType accessModifier, TypePtr type,
                         bool hasGetter, bool hasSetter,
                         const core::SourceLocation &loc)
-      : DeclarationNode(name, loc), accessModifier_(accessModifier),
-        type_(std::move(type)), hasGetter_(hasGetter), hasSetter_(hasSetter) {}
+      : DeclarationNode(NodeKind::PropertySignature, name, loc),
+        accessModifier_(accessModifier), type_(std::move(type)),
+        hasGetter_(hasGetter), hasSetter_(hasSetter) {}
 
   tokens::TokenType getAccessModifier() const { return accessModifier_; }
   TypePtr getType() const { return type_; }
@@ -458,6 +599,10 @@ public:
     return visitor->visitParse();
   }
 
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::PropertySignature;
+  }
+
 private:
   tokens::TokenType accessModifier_; // public, private, protected
   TypePtr type_;                     // Property type
@@ -474,8 +619,9 @@ public:
                     std::vector<TypePtr> extendedInterfaces,
                     std::vector<DeclPtr> members,
                     bool isZeroCast, // #zerocast attribute
-                    const core::SourceLocation &loc)
-      : DeclarationNode(name, loc),
+                    const core::SourceLocation &loc,
+                    NodeKind kind = NodeKind::InterfaceDecl)
+      : DeclarationNode(kind, name, loc),
         extendedInterfaces_(std::move(extendedInterfaces)),
         members_(std::move(members)), isZeroCast_(isZeroCast) {}
 
@@ -491,6 +637,11 @@ public:
     return visitor->visitParse();
   }
 
+  static bool classof(const BaseNode *node) {
+    return inKindRange(node, NodeKind::InterfaceDecl,
+                       NodeKind::GenericInterfaceDecl);
+  }
+
 private:
   std::vector<TypePtr> extendedInterfaces_; // Interfaces that this one extends
   std::vector<DeclPtr>
@@ -509,7 +660,8 @@ public:
                            std::vector<TypePtr> genericParams,
                            const core::SourceLocation &loc)
       : InterfaceDeclNode(name, std::move(extendedInterfaces),
-                          std::move(members), isZeroCast, loc),
+                          std::move(members), isZeroCast, loc,
+                          NodeKind::GenericInterfaceDecl),
         genericParams_(std::move(genericParams)) {}
 
   const std::vector<TypePtr> &getGenericParams() const {
@@ -520,6 +672,10 @@ public:
     return visitor->visitParse();
   }
 
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::GenericInterfaceDecl;
+  }
+
 private:
   std::vector<TypePtr> genericParams_; // Generic type parameters
 };
@@ -531,7 +687,8 @@ class TypedefDeclNode : public DeclarationNode {
 public:
   TypedefDeclNode(const std::string &name, TypePtr aliasedType,
                   const core::SourceLocation &loc)
-      : DeclarationNode(name, loc), aliasedType_(std::move(aliasedType)) {}
+      : DeclarationNode(NodeKind::TypedefDecl, name, loc),
+        aliasedType_(std::move(aliasedType)) {}
 
   TypePtr getAliasedType() const { return aliasedType_; }
 
@@ -539,6 +696,10 @@ public:
     return visitor->visitParse();
   }
 
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::TypedefDecl;
+  }
+
 private:
   TypePtr aliasedType_; // Type being aliased
 };
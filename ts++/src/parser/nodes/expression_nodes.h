@@ -5,48 +5,92 @@
 
 #pragma once
 #include "base_node.h"
+#include "core/common/interner.h"
+#include "tokens/literal_value.h"
 #include "tokens/token_type.h"
+#include <memory>
+#include <string>
 #include <vector>
 
+namespace visitors {
+class ResolvedType;
+} // namespace visitors
+
 namespace nodes {
 
 class ParameterNode;
-using ParamPtr = std::shared_ptr<ParameterNode>;
+using ParamPtr = ParameterNode *;
 class BlockNode;
-using BlockPtr = std::shared_ptr<BlockNode>;
+using BlockPtr = BlockNode *;
 class TypeNode;
-using TypePtr = std::shared_ptr<TypeNode>;
+using TypePtr = TypeNode *;
 
 /**
  * @brief Base class for all expression nodes
  */
 class ExpressionNode : public BaseNode {
 public:
-  ExpressionNode(const core::SourceLocation &loc, tokens::TokenType type)
-      : BaseNode(loc), expressionType_(type) {}
+  ExpressionNode(NodeKind kind, const core::SourceLocation &loc,
+                 tokens::TokenType type)
+      : BaseNode(kind, loc), expressionType_(type) {}
 
   tokens::TokenType getExpressionType() const { return expressionType_; }
   bool accept(interface::BaseInterface *visitor) override {
     return visitor->visitParse();
   }
 
+  // The interned type the checker resolved, so code generation need not
+  // derive it again; null if unchecked, ill-typed or in a generic body
+  const std::shared_ptr<visitors::ResolvedType> &getResolvedType() const {
+    return resolvedType_;
+  }
+  void setResolvedType(std::shared_ptr<visitors::ResolvedType> type) const {
+    resolvedType_ = std::move(type);
+  }
+
+  // The value the constant folder computed, of the resolved type (or int,
+  // for the size of an array type); code generation emits it as is
+  bool isFolded() const { return folded_; }
+  core::LiteralValue getFoldedValue() const { return foldedValue_; }
+  void setFoldedValue(core::LiteralValue value) const {
+    foldedValue_ = value;
+    folded_ = true;
+  }
+  void clearFoldedValue() const { folded_ = false; }
+
+  static bool classof(const BaseNode *node) {
+    return inKindRange(node, NodeKind::FirstExpression,
+                       NodeKind::LastExpression);
+  }
+
 protected:
   tokens::TokenType expressionType_;
+
+  // Written by the one checker that visits the node, once it is parsed
+  mutable std::shared_ptr<visitors::ResolvedType> resolvedType_;
+
+  // Written by the folder that visits the node, once it is checked
+  mutable bool folded_ = false;
+  mutable core::LiteralValue foldedValue_;
 };
 
-using ExpressionPtr = std::shared_ptr<ExpressionNode>;
+using ExpressionPtr = ExpressionNode *;
 
 // Binary expressions (a + b, x * y)
 class BinaryExpressionNode : public ExpressionNode {
 public:
   BinaryExpressionNode(const core::SourceLocation &loc, tokens::TokenType op,
                        ExpressionPtr left, ExpressionPtr right)
-      : ExpressionNode(loc, op), left_(std::move(left)),
-        right_(std::move(right)) {}
+      : ExpressionNode(NodeKind::BinaryExpression, loc, op),
+        left_(std::move(left)), right_(std::move(right)) {}
 
   ExpressionPtr getLeft() const { return left_; }
   ExpressionPtr getRight() const { return right_; }
 
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::BinaryExpression;
+  }
+
 private:
   ExpressionPtr left_;
   ExpressionPtr right_;
@@ -57,12 +101,16 @@ class UnaryExpressionNode : public ExpressionNode {
 public:
   UnaryExpressionNode(const core::SourceLocation &loc, tokens::TokenType op,
                       ExpressionPtr operand, bool isPrefix)
-      : ExpressionNode(loc, op), operand_(std::move(operand)),
-        isPrefix_(isPrefix) {}
+      : ExpressionNode(NodeKind::UnaryExpression, loc, op),
+        operand_(std::move(operand)), isPrefix_(isPrefix) {}
 
   ExpressionPtr getOperand() const { return operand_; }
   bool isPrefix() const { return isPrefix_; }
 
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::UnaryExpression;
+  }
+
 private:
   ExpressionPtr operand_;
   bool isPrefix_;
@@ -72,26 +120,88 @@ private:
 class LiteralExpressionNode : public ExpressionNode {
 public:
   LiteralExpressionNode(const core::SourceLocation &loc, tokens::TokenType type,
-                        std::string value)
-      : ExpressionNode(loc, type), value_(std::move(value)) {}
+                        core::Symbol value)
+      : ExpressionNode(NodeKind::LiteralExpression, loc, type), value_(value) {
+    if (type == tokens::TokenType::NUMBER) {
+      number_ = tokens::decodeNumber(value_.str());
+    }
+  }
+
+  core::Symbol getSymbol() const { return value_; }
+  const std::string &getValue() const { return value_.str(); }
+  // Decoded once here; Invalid unless this is a NUMBER literal
+  const tokens::NumberValue &getNumber() const { return number_; }
 
-  const std::string &getValue() const { return value_; }
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::LiteralExpression;
+  }
 
 private:
-  std::string value_;
+  core::Symbol value_; // Interned literal spelling
+  tokens::NumberValue number_;
+};
+
+/**
+ * @brief A test of what a value holds: typeof x == "T", or != for the
+ * opposite. Against a union it compares the tag that says which arm the
+ * value holds.
+ */
+struct TypeTest {
+  ExpressionPtr operand = nullptr; // x
+  std::string typeName;            // T, without its quotes
+  bool negated = false;            // Written with !=
 };
 
+/**
+ * @brief Takes a typeof test apart, with the literal on either side
+ * @return False if the expression is not a typeof test
+ */
+inline bool getTypeTest(const ExpressionNode *expr, TypeTest &test) {
+  auto binary = dyn_cast<BinaryExpressionNode>(expr);
+  if (!binary) {
+    return false;
+  }
+  tokens::TokenType op = binary->getExpressionType();
+  if (op != tokens::TokenType::EQUALS_EQUALS &&
+      op != tokens::TokenType::EXCLAIM_EQUALS) {
+    return false;
+  }
+  auto typeOf = dyn_cast<UnaryExpressionNode>(binary->getLeft());
+  auto literal = dyn_cast<LiteralExpressionNode>(binary->getRight());
+  if (!typeOf) {
+    typeOf = dyn_cast<UnaryExpressionNode>(binary->getRight());
+    literal = dyn_cast<LiteralExpressionNode>(binary->getLeft());
+  }
+  if (!typeOf || typeOf->getExpressionType() != tokens::TokenType::TYPEOF ||
+      !literal ||
+      literal->getExpressionType() != tokens::TokenType::STRING_LITERAL ||
+      literal->getValue().size() < 2) {
+    return false;
+  }
+  const std::string &text = literal->getValue();
+  test.operand = typeOf->getOperand();
+  test.typeName = text.substr(1, text.size() - 2);
+  test.negated = op == tokens::TokenType::EXCLAIM_EQUALS;
+  return true;
+}
+
 // Identifier expression (variable names, function names)
 class IdentifierExpressionNode : public ExpressionNode {
 public:
-  IdentifierExpressionNode(const core::SourceLocation &loc, std::string name)
-      : ExpressionNode(loc, tokens::TokenType::IDENTIFIER),
-        name_(std::move(name)) {}
+  IdentifierExpressionNode(const core::SourceLocation &loc, core::Symbol name)
+      : ExpressionNode(NodeKind::IdentifierExpression, loc,
+                       tokens::TokenType::IDENTIFIER),
+        name_(name) {}
 
-  const std::string &getName() const { return name_; }
+  core::Symbol getSymbol() const { return name_; }
+  const std::string &getName() const { return name_.str(); }
+
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::IdentifierExpression;
+  }
 
 private:
-  std::string name_;
+  core::Symbol name_; // Interned identifier
 };
 
 // Array literal expression [1, 2, 3]
@@ -99,11 +209,16 @@ class ArrayLiteralNode : public ExpressionNode {
 public:
   ArrayLiteralNode(const core::SourceLocation &loc,
                    std::vector<ExpressionPtr> elements)
-      : ExpressionNode(loc, tokens::TokenType::LEFT_BRACKET),
+      : ExpressionNode(NodeKind::ArrayLiteral, loc,
+                       tokens::TokenType::LEFT_BRACKET),
         elements_(std::move(elements)) {}
 
   const std::vector<ExpressionPtr> &getElements() const { return elements_; }
 
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::ArrayLiteral;
+  }
+
 private:
   std::vector<ExpressionPtr> elements_;
 };
@@ -114,7 +229,8 @@ public:
   ConditionalExpressionNode(const core::SourceLocation &loc,
                             ExpressionPtr condition, ExpressionPtr trueExpr,
                             ExpressionPtr falseExpr)
-      : ExpressionNode(loc, tokens::TokenType::QUESTION),
+      : ExpressionNode(NodeKind::ConditionalExpression, loc,
+                       tokens::TokenType::QUESTION),
         condition_(std::move(condition)), trueExpr_(std::move(trueExpr)),
         falseExpr_(std::move(falseExpr)) {}
 
@@ -122,6 +238,10 @@ public:
   ExpressionPtr getTrueExpression() const { return trueExpr_; }
   ExpressionPtr getFalseExpression() const { return falseExpr_; }
 
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::ConditionalExpression;
+  }
+
 private:
   ExpressionPtr condition_;
   ExpressionPtr trueExpr_;
@@ -134,12 +254,16 @@ public:
   AssignmentExpressionNode(const core::SourceLocation &loc,
                            tokens::TokenType op, ExpressionPtr target,
                            ExpressionPtr value)
-      : ExpressionNode(loc, op), target_(std::move(target)),
-        value_(std::move(value)) {}
+      : ExpressionNode(NodeKind::AssignmentExpression, loc, op),
+        target_(std::move(target)), value_(std::move(value)) {}
 
   ExpressionPtr getTarget() const { return target_; }
   ExpressionPtr getValue() const { return value_; }
 
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::AssignmentExpression;
+  }
+
 private:
   ExpressionPtr target_;
   ExpressionPtr value_;
@@ -151,7 +275,8 @@ public:
   CallExpressionNode(const core::SourceLocation &loc, ExpressionPtr callee,
                      std::vector<ExpressionPtr> arguments,
                      std::vector<std::string> typeArguments = {})
-      : ExpressionNode(loc, tokens::TokenType::LEFT_PAREN),
+      : ExpressionNode(NodeKind::CallExpression, loc,
+                       tokens::TokenType::LEFT_PAREN),
         callee_(std::move(callee)), arguments_(std::move(arguments)),
         typeArguments_(std::move(typeArguments)) {}
 
@@ -161,6 +286,10 @@ public:
     return typeArguments_;
   }
 
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::CallExpression;
+  }
+
 private:
   ExpressionPtr callee_;
   std::vector<ExpressionPtr> arguments_;
@@ -171,19 +300,24 @@ private:
 class MemberExpressionNode : public ExpressionNode {
 public:
   MemberExpressionNode(const core::SourceLocation &loc, ExpressionPtr object,
-                       std::string member, bool isPointer)
-      : ExpressionNode(loc, isPointer ? tokens::TokenType::AT
-                                      : tokens::TokenType::DOT),
-        object_(std::move(object)), member_(std::move(member)),
-        isPointer_(isPointer) {}
+                       core::Symbol member, bool isPointer)
+      : ExpressionNode(NodeKind::MemberExpression, loc,
+                       isPointer ? tokens::TokenType::AT
+                                 : tokens::TokenType::DOT),
+        object_(std::move(object)), member_(member), isPointer_(isPointer) {}
 
   ExpressionPtr getObject() const { return object_; }
-  const std::string &getMember() const { return member_; }
+  core::Symbol getMemberSymbol() const { return member_; }
+  const std::string &getMember() const { return member_.str(); }
   bool isPointer() const { return isPointer_; }
 
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::MemberExpression;
+  }
+
 private:
   ExpressionPtr object_;
-  std::string member_;
+  core::Symbol member_; // Interned, so members are looked up by address
   bool isPointer_;
 };
 
@@ -192,12 +326,17 @@ class IndexExpressionNode : public ExpressionNode {
 public:
   IndexExpressionNode(const core::SourceLocation &loc, ExpressionPtr array,
                       ExpressionPtr index)
-      : ExpressionNode(loc, tokens::TokenType::LEFT_BRACKET),
+      : ExpressionNode(NodeKind::IndexExpression, loc,
+                       tokens::TokenType::LEFT_BRACKET),
         array_(std::move(array)), index_(std::move(index)) {}
 
   ExpressionPtr getArray() const { return array_; }
   ExpressionPtr getIndex() const { return index_; }
 
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::IndexExpression;
+  }
+
 private:
   ExpressionPtr array_;
   ExpressionPtr index_;
@@ -207,26 +346,41 @@ private:
 class ThisExpressionNode : public ExpressionNode {
 public:
   explicit ThisExpressionNode(const core::SourceLocation &loc)
-      : ExpressionNode(loc, tokens::TokenType::THIS) {}
+      : ExpressionNode(NodeKind::ThisExpression, loc,
+                       tokens::TokenType::THIS) {}
   bool accept(interface::BaseInterface *visitor) override {
     return visitor->visitParse();
   }
+
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::ThisExpression;
+  }
 };
 
 // New expression (new Type(args))
 class NewExpressionNode : public ExpressionNode {
 public:
   NewExpressionNode(const core::SourceLocation &loc, std::string className,
-                    std::vector<ExpressionPtr> arguments)
-      : ExpressionNode(loc, tokens::TokenType::NEW),
-        className_(std::move(className)), arguments_(std::move(arguments)) {}
+                    std::vector<ExpressionPtr> arguments,
+                    std::vector<std::string> typeArguments = {})
+      : ExpressionNode(NodeKind::NewExpression, loc, tokens::TokenType::NEW),
+        className_(std::move(className)), arguments_(std::move(arguments)),
+        typeArguments_(std::move(typeArguments)) {}
 
   const std::string &getClassName() const { return className_; }
   const std::vector<ExpressionPtr> &getArguments() const { return arguments_; }
+  const std::vector<std::string> &getTypeArguments() const {
+    return typeArguments_;
+  }
+
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::NewExpression;
+  }
 
 private:
   std::string className_;
   std::vector<ExpressionPtr> arguments_;
+  std::vector<std::string> typeArguments_; // Arguments of a generic class
 };
 
 // Cast expression (cast<Type>expr)
@@ -234,13 +388,18 @@ class CastExpressionNode : public ExpressionNode {
 public:
   CastExpressionNode(const core::SourceLocation &loc, std::string targetType,
                      ExpressionPtr expression)
-      : ExpressionNode(loc, tokens::TokenType::IDENTIFIER),
+      : ExpressionNode(NodeKind::CastExpression, loc,
+                       tokens::TokenType::IDENTIFIER),
         targetType_(std::move(targetType)), expression_(std::move(expression)) {
   }
 
   const std::string &getTargetType() const { return targetType_; }
   ExpressionPtr getExpression() const { return expression_; }
 
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::CastExpression;
+  }
+
 private:
   std::string targetType_;
   ExpressionPtr expression_;
@@ -251,10 +410,15 @@ class CompileTimeExpressionNode : public ExpressionNode {
 public:
   CompileTimeExpressionNode(const core::SourceLocation &loc,
                             tokens::TokenType kind, ExpressionPtr operand)
-      : ExpressionNode(loc, kind), operand_(std::move(operand)) {}
+      : ExpressionNode(NodeKind::CompileTimeExpression, loc, kind),
+        operand_(std::move(operand)) {}
 
   ExpressionPtr getOperand() const { return operand_; }
 
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::CompileTimeExpression;
+  }
+
 private:
   ExpressionPtr operand_;
 };
@@ -265,7 +429,8 @@ public:
   TemplateSpecializationNode(const core::SourceLocation &loc,
                              ExpressionPtr base,
                              std::vector<std::string> typeArguments)
-      : ExpressionNode(loc, tokens::TokenType::TEMPLATE),
+      : ExpressionNode(NodeKind::TemplateSpecialization, loc,
+                       tokens::TokenType::TEMPLATE),
         base_(std::move(base)), typeArguments_(std::move(typeArguments)) {}
 
   ExpressionPtr getBase() const { return base_; }
@@ -273,6 +438,10 @@ public:
     return typeArguments_;
   }
 
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::TemplateSpecialization;
+  }
+
 private:
   ExpressionPtr base_;
   std::vector<std::string> typeArguments_;
@@ -289,13 +458,17 @@ public:
 
   PointerExpressionNode(const core::SourceLocation &loc, ExpressionPtr operand,
                         PointerKind kind, uint32_t alignment = 0)
-      : ExpressionNode(loc, tokens::TokenType::AT),
+      : ExpressionNode(NodeKind::PointerExpression, loc, tokens::TokenType::AT),
         operand_(std::move(operand)), kind_(kind), alignment_(alignment) {}
 
   ExpressionPtr getOperand() const { return operand_; }
   PointerKind getKind() const { return kind_; }
   uint32_t getAlignment() const { return alignment_; }
 
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::PointerExpression;
+  }
+
 private:
   ExpressionPtr operand_;
   PointerKind kind_;
@@ -309,7 +482,8 @@ class AttributeNode : public BaseNode {
 public:
   AttributeNode(const std::string &name, ExpressionPtr argument,
                 const core::SourceLocation &loc)
-      : BaseNode(loc), name_(name), argument_(std::move(argument)) {}
+      : BaseNode(NodeKind::Attribute, loc), name_(name),
+        argument_(std::move(argument)) {}
 
   const std::string &getName() const { return name_; }
   ExpressionPtr getArgument() const { return argument_; }
@@ -318,6 +492,10 @@ public:
     return visitor->visitParse();
   }
 
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::Attribute;
+  }
+
 private:
   std::string name_; // Attribute name without '#' prefix
   ExpressionPtr
@@ -331,7 +509,8 @@ class FunctionExpressionNode : public ExpressionNode {
 public:
   FunctionExpressionNode(std::vector<ParamPtr> parameters, TypePtr returnType,
                          BlockPtr body, const core::SourceLocation &loc)
-      : ExpressionNode(loc, tokens::TokenType::FUNCTION),
+      : ExpressionNode(NodeKind::FunctionExpression, loc,
+                       tokens::TokenType::FUNCTION),
         parameters_(std::move(parameters)), returnType_(std::move(returnType)),
         body_(std::move(body)) {}
 
@@ -343,6 +522,10 @@ public:
     return visitor->visitParse();
   }
 
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::FunctionExpression;
+  }
+
 private:
   std::vector<ParamPtr> parameters_;
   TypePtr returnType_;
@@ -18,11 +18,16 @@ namespace nodes {
  */
 class StatementNode : public BaseNode {
 public:
-  explicit StatementNode(const core::SourceLocation &loc) : BaseNode(loc) {}
+  StatementNode(NodeKind kind, const core::SourceLocation &loc)
+      : BaseNode(kind, loc) {}
   virtual ~StatementNode() = default;
+
+  static bool classof(const BaseNode *node) {
+    return inKindRange(node, NodeKind::FirstStatement, NodeKind::LastStatement);
+  }
 };
 
-using StmtPtr = std::shared_ptr<StatementNode>;
+using StmtPtr = StatementNode *;
 
 /**
  * Represents a single case in a switch statement
@@ -39,7 +44,8 @@ struct SwitchCase {
 class DeclarationStmtNode : public StatementNode {
 public:
   DeclarationStmtNode(DeclPtr declaration, const core::SourceLocation &loc)
-      : StatementNode(loc), declaration_(std::move(declaration)) {}
+      : StatementNode(NodeKind::DeclarationStmt, loc),
+        declaration_(std::move(declaration)) {}
 
   const DeclPtr &getDeclaration() const { return declaration_; }
 
@@ -47,6 +53,10 @@ public:
     return visitor->visitParse();
   }
 
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::DeclarationStmt;
+  }
+
 private:
   DeclPtr declaration_;
 };
@@ -56,16 +66,25 @@ private:
  */
 class BlockNode : public StatementNode {
 public:
-  BlockNode(std::vector<StmtPtr> statements, const core::SourceLocation &loc)
-      : StatementNode(loc), statements_(std::move(statements)) {}
+  BlockNode(std::vector<StmtPtr> statements, const core::SourceLocation &loc,
+            bool isArena = false)
+      : StatementNode(NodeKind::Block, loc),
+        statements_(std::move(statements)), isArena_(isArena) {}
 
   const std::vector<StmtPtr> &getStatements() const { return statements_; }
+  // #arena { ... }: new allocates from a region freed when the block ends
+  bool isArena() const { return isArena_; }
   bool accept(interface::BaseInterface *visitor) override {
     return visitor->visitParse();
   }
 
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::Block;
+  }
+
 private:
   std::vector<StmtPtr> statements_;
+  bool isArena_;
 };
 
 /**
@@ -74,13 +93,18 @@ private:
 class ExpressionStmtNode : public StatementNode {
 public:
   ExpressionStmtNode(ExpressionPtr expression, const core::SourceLocation &loc)
-      : StatementNode(loc), expression_(std::move(expression)) {}
+      : StatementNode(NodeKind::ExpressionStmt, loc),
+        expression_(std::move(expression)) {}
 
   ExpressionPtr getExpression() const { return expression_; }
   bool accept(interface::BaseInterface *visitor) override {
     return visitor->visitParse();
   }
 
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::ExpressionStmt;
+  }
+
 private:
   ExpressionPtr expression_;
 };
@@ -92,7 +116,7 @@ class IfStmtNode : public StatementNode {
 public:
   IfStmtNode(ExpressionPtr condition, StmtPtr thenBranch, StmtPtr elseBranch,
              const core::SourceLocation &loc)
-      : StatementNode(loc), condition_(std::move(condition)),
+      : StatementNode(NodeKind::IfStmt, loc), condition_(std::move(condition)),
         thenBranch_(std::move(thenBranch)), elseBranch_(std::move(elseBranch)) {
   }
 
@@ -103,6 +127,10 @@ public:
     return visitor->visitParse();
   }
 
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::IfStmt;
+  }
+
 private:
   ExpressionPtr condition_;
   StmtPtr thenBranch_;
@@ -116,8 +144,8 @@ class WhileStmtNode : public StatementNode {
 public:
   WhileStmtNode(ExpressionPtr condition, StmtPtr body,
                 const core::SourceLocation &loc)
-      : StatementNode(loc), condition_(std::move(condition)),
-        body_(std::move(body)) {}
+      : StatementNode(NodeKind::WhileStmt, loc),
+        condition_(std::move(condition)), body_(std::move(body)) {}
 
   ExpressionPtr getCondition() const { return condition_; }
   StmtPtr getBody() const { return body_; }
@@ -125,6 +153,10 @@ public:
     return visitor->visitParse();
   }
 
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::WhileStmt;
+  }
+
 private:
   ExpressionPtr condition_;
   StmtPtr body_;
@@ -137,7 +169,7 @@ class DoWhileStmtNode : public StatementNode {
 public:
   DoWhileStmtNode(StmtPtr body, ExpressionPtr condition,
                   const core::SourceLocation &loc)
-      : StatementNode(loc), body_(std::move(body)),
+      : StatementNode(NodeKind::DoWhileStmt, loc), body_(std::move(body)),
         condition_(std::move(condition)) {}
 
   StmtPtr getBody() const { return body_; }
@@ -146,6 +178,10 @@ public:
     return visitor->visitParse();
   }
 
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::DoWhileStmt;
+  }
+
 private:
   StmtPtr body_;
   ExpressionPtr condition_;
@@ -158,7 +194,7 @@ class ForStmtNode : public StatementNode {
 public:
   ForStmtNode(StmtPtr init, ExpressionPtr condition, ExpressionPtr increment,
               StmtPtr body, const core::SourceLocation &loc)
-      : StatementNode(loc), initializer_(std::move(init)),
+      : StatementNode(NodeKind::ForStmt, loc), initializer_(std::move(init)),
         condition_(std::move(condition)), increment_(std::move(increment)),
         body_(std::move(body)) {}
 
@@ -170,6 +206,10 @@ public:
     return visitor->visitParse();
   }
 
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::ForStmt;
+  }
+
 private:
   StmtPtr initializer_;
   ExpressionPtr condition_;
@@ -178,17 +218,20 @@ private:
 };
 
 /**
- * For-of statement: for (let x of expr) stmt
+ * For-of statement: #parallel? for (let x of expr) stmt
  */
 class ForOfStmtNode : public StatementNode {
 public:
   ForOfStmtNode(bool isConst, const std::string &identifier,
                 ExpressionPtr iterable, StmtPtr body,
-                const core::SourceLocation &loc)
-      : StatementNode(loc), isConst_(isConst), identifier_(identifier),
+                const core::SourceLocation &loc, bool isParallel = false)
+      : StatementNode(NodeKind::ForOfStmt, loc), isConst_(isConst),
+        isParallel_(isParallel), identifier_(identifier),
         iterable_(std::move(iterable)), body_(std::move(body)) {}
 
   bool isConst() const { return isConst_; }
+  // Iterations may run concurrently on the runtime's worker threads
+  bool isParallel() const { return isParallel_; }
   const std::string &getIdentifier() const { return identifier_; }
   ExpressionPtr getIterable() const { return iterable_; }
   StmtPtr getBody() const { return body_; }
@@ -196,8 +239,13 @@ public:
     return visitor->visitParse();
   }
 
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::ForOfStmt;
+  }
+
 private:
   bool isConst_;
+  bool isParallel_;
   std::string identifier_;
   ExpressionPtr iterable_;
   StmtPtr body_;
@@ -209,13 +257,17 @@ private:
 class BreakStmtNode : public StatementNode {
 public:
   BreakStmtNode(std::string label, const core::SourceLocation &loc)
-      : StatementNode(loc), label_(std::move(label)) {}
+      : StatementNode(NodeKind::BreakStmt, loc), label_(std::move(label)) {}
 
   const std::string &getLabel() const { return label_; }
   bool accept(interface::BaseInterface *visitor) override {
     return visitor->visitParse();
   }
 
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::BreakStmt;
+  }
+
 private:
   std::string label_; // Optional label
 };
@@ -226,13 +278,17 @@ private:
 class ContinueStmtNode : public StatementNode {
 public:
   ContinueStmtNode(std::string label, const core::SourceLocation &loc)
-      : StatementNode(loc), label_(std::move(label)) {}
+      : StatementNode(NodeKind::ContinueStmt, loc), label_(std::move(label)) {}
 
   const std::string &getLabel() const { return label_; }
   bool accept(interface::BaseInterface *visitor) override {
     return visitor->visitParse();
   }
 
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::ContinueStmt;
+  }
+
 private:
   std::string label_; // Optional label
 };
@@ -243,13 +299,17 @@ private:
 class ReturnStmtNode : public StatementNode {
 public:
   ReturnStmtNode(ExpressionPtr value, const core::SourceLocation &loc)
-      : StatementNode(loc), value_(std::move(value)) {}
+      : StatementNode(NodeKind::ReturnStmt, loc), value_(std::move(value)) {}
 
   ExpressionPtr getValue() const { return value_; }
   bool accept(interface::BaseInterface *visitor) override {
     return visitor->visitParse();
   }
 
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::ReturnStmt;
+  }
+
 private:
   ExpressionPtr value_; // Optional return value
 };
@@ -261,13 +321,13 @@ class TryStmtNode : public StatementNode {
 public:
   struct CatchClause {
     std::string parameter;
-    TypePtr parameterType;
-    StmtPtr body;
+    TypePtr parameterType = nullptr;
+    StmtPtr body = nullptr;
   };
 
   TryStmtNode(StmtPtr tryBlock, std::vector<CatchClause> catchClauses,
               StmtPtr finallyBlock, const core::SourceLocation &loc)
-      : StatementNode(loc), tryBlock_(std::move(tryBlock)),
+      : StatementNode(NodeKind::TryStmt, loc), tryBlock_(std::move(tryBlock)),
         catchClauses_(std::move(catchClauses)),
         finallyBlock_(std::move(finallyBlock)) {}
 
@@ -280,6 +340,10 @@ public:
     return visitor->visitParse();
   }
 
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::TryStmt;
+  }
+
 private:
   StmtPtr tryBlock_;
   std::vector<CatchClause> catchClauses_;
@@ -292,13 +356,17 @@ private:
 class ThrowStmtNode : public StatementNode {
 public:
   ThrowStmtNode(ExpressionPtr value, const core::SourceLocation &loc)
-      : StatementNode(loc), value_(std::move(value)) {}
+      : StatementNode(NodeKind::ThrowStmt, loc), value_(std::move(value)) {}
 
   ExpressionPtr getValue() const { return value_; }
   bool accept(interface::BaseInterface *visitor) override {
     return visitor->visitParse();
   }
 
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::ThrowStmt;
+  }
+
 private:
   ExpressionPtr value_;
 };
@@ -310,8 +378,8 @@ class SwitchStmtNode : public StatementNode {
 public:
   SwitchStmtNode(ExpressionPtr expression, std::vector<SwitchCase> cases,
                  const core::SourceLocation &loc)
-      : StatementNode(loc), expression_(std::move(expression)),
-        cases_(std::move(cases)) {}
+      : StatementNode(NodeKind::SwitchStmt, loc),
+        expression_(std::move(expression)), cases_(std::move(cases)) {}
 
   ExpressionPtr getExpression() const { return expression_; }
   const std::vector<SwitchCase> &getCases() const { return cases_; }
@@ -319,32 +387,68 @@ public:
     return visitor->visitParse();
   }
 
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::SwitchStmt;
+  }
+
 private:
   ExpressionPtr expression_;
   std::vector<SwitchCase> cases_;
 };
 
 /**
- * Assembly statement: #asm("...")
+ * An operand of an assembly statement: [name] "constraint"(expression)
+ */
+struct AsmOperand {
+  std::string name;         // Symbolic name for %[name], or empty
+  std::string constraint;   // The constraint as written, with its quotes
+  ExpressionPtr expression; // An lvalue for outputs
+
+  AsmOperand(std::string name, std::string constraint, ExpressionPtr expression)
+      : name(std::move(name)), constraint(std::move(constraint)),
+        expression(expression) {}
+};
+
+/**
+ * Assembly statement: #asm("...") or, with GCC-style operands,
+ * #asm("..." : outputs : inputs : clobbers)
  */
 class AssemblyStmtNode : public StatementNode {
 public:
-  AssemblyStmtNode(std::string code, std::vector<std::string> constraints,
+  AssemblyStmtNode(std::string code, const core::SourceLocation &loc)
+      : StatementNode(NodeKind::AssemblyStmt, loc), code_(std::move(code)) {}
+
+  AssemblyStmtNode(std::string code, std::vector<AsmOperand> outputs,
+                   std::vector<AsmOperand> inputs,
+                   std::vector<std::string> clobbers,
                    const core::SourceLocation &loc)
-      : StatementNode(loc), code_(std::move(code)),
-        constraints_(std::move(constraints)) {}
+      : StatementNode(NodeKind::AssemblyStmt, loc), code_(std::move(code)),
+        outputs_(std::move(outputs)), inputs_(std::move(inputs)),
+        clobbers_(std::move(clobbers)), extended_(true) {}
 
   const std::string &getCode() const { return code_; }
-  const std::vector<std::string> &getConstraints() const {
-    return constraints_;
-  }
+  const std::vector<AsmOperand> &getOutputs() const { return outputs_; }
+  const std::vector<AsmOperand> &getInputs() const { return inputs_; }
+  // Clobbered registers, "cc" and "memory", with their quotes
+  const std::vector<std::string> &getClobbers() const { return clobbers_; }
+  // Whether the code is a template that names operands with %, even if
+  // it has none
+  bool isExtended() const { return extended_; }
+
   bool accept(interface::BaseInterface *visitor) override {
     return visitor->visitParse();
   }
 
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::AssemblyStmt;
+  }
+
 private:
   std::string code_;
-  std::vector<std::string> constraints_;
+  std::vector<AsmOperand> outputs_;
+  std::vector<AsmOperand> inputs_;
+  std::vector<std::string> clobbers_;
+  bool extended_ = false;
 };
 
 /**
@@ -354,7 +458,8 @@ class LabeledStatementNode : public StatementNode {
 public:
     LabeledStatementNode(const std::string& label, StmtPtr statement, 
                          const core::SourceLocation& loc)
-        : StatementNode(loc), label_(label), statement_(std::move(statement)) {}
+        : StatementNode(NodeKind::LabeledStatement, loc), label_(label),
+          statement_(std::move(statement)) {}
 
     const std::string& getLabel() const { return label_; }
     StmtPtr getStatement() const { return statement_; }
@@ -363,6 +468,10 @@ public:
         return visitor->visitParse();
     }
 
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::LabeledStatement;
+  }
+
 private:
     std::string label_;
     StmtPtr statement_;
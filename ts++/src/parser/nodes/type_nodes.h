@@ -6,6 +6,7 @@
 #pragma once
 #include "base_node.h"
 #include "core/common/common_types.h"
+#include "core/common/interner.h"
 #include "tokens/token_type.h"
 #include <memory>
 #include <unordered_set>
@@ -15,14 +16,15 @@ namespace nodes {
 
 // Forward declarations
 class ExpressionNode;
-using ExpressionPtr = std::shared_ptr<ExpressionNode>;
+using ExpressionPtr = ExpressionNode *;
 
 /**
  * Base class for all type nodes in the AST
  */
 class TypeNode : public BaseNode {
 public:
-  TypeNode(const core::SourceLocation &loc) : BaseNode(loc) {}
+  TypeNode(NodeKind kind, const core::SourceLocation &loc)
+      : BaseNode(kind, loc) {}
   virtual ~TypeNode() = default;
 
   // Type-specific methods
@@ -34,32 +36,41 @@ public:
   virtual bool isTemplate() const { return false; }
 
   virtual std::string toString() const = 0;
+
+  static bool classof(const BaseNode *node) {
+    return inKindRange(node, NodeKind::FirstType, NodeKind::LastType);
+  }
 };
 
-using TypePtr = std::shared_ptr<TypeNode>;
+using TypePtr = TypeNode *;
 
 /**
- * Primitive type node (void, int, float, etc.)
+ * Primitive type node (void, int, float, etc.), or a built-in vector of
+ * 2, 4, 8 or 16 ints or floats (int4, float8, ...)
  */
 class PrimitiveTypeNode : public TypeNode {
 public:
-  PrimitiveTypeNode(tokens::TokenType type, const core::SourceLocation &loc)
-      : TypeNode(loc), type_(type) {}
+  PrimitiveTypeNode(tokens::TokenType type, const core::SourceLocation &loc,
+                    unsigned lanes = 0)
+      : TypeNode(NodeKind::PrimitiveType, loc), type_(type), lanes_(lanes) {}
 
   tokens::TokenType getType() const { return type_; }
+  unsigned getLanes() const { return lanes_; }
+  bool isVector() const { return lanes_ != 0; }
   bool isPrimitive() const override { return true; }
   bool isVoid() const override { return type_ == tokens::TokenType::VOID; }
   bool accept(interface::BaseInterface *visitor) override {
     return visitor->visitParse();
   };
   std::string toString() const override {
+    std::string lanes = lanes_ ? std::to_string(lanes_) : "";
     switch (type_) {
     case tokens::TokenType::VOID:
       return "void";
     case tokens::TokenType::INT:
-      return "int";
+      return "int" + lanes;
     case tokens::TokenType::FLOAT:
-      return "float";
+      return "float" + lanes;
     case tokens::TokenType::BOOLEAN:
       return "boolean";
     case tokens::TokenType::STRING:
@@ -69,8 +80,35 @@ public:
     }
   }
 
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::PrimitiveType;
+  }
+
+  /**
+   * @brief Recognizes the name of a vector type
+   * @param name An identifier such as float4 or int16
+   * @param element Receives INT or FLOAT
+   * @return The number of lanes, or 0 if the name is not a vector type
+   */
+  static unsigned parseVectorName(const std::string &name,
+                                  tokens::TokenType &element) {
+    std::string lanes;
+    if (name.compare(0, 5, "float") == 0) {
+      element = tokens::TokenType::FLOAT;
+      lanes = name.substr(5);
+    } else if (name.compare(0, 3, "int") == 0) {
+      element = tokens::TokenType::INT;
+      lanes = name.substr(3);
+    }
+    if (lanes == "2" || lanes == "4" || lanes == "8" || lanes == "16") {
+      return static_cast<unsigned>(std::stoul(lanes));
+    }
+    return 0;
+  }
+
 private:
   tokens::TokenType type_; // VOID, INT, FLOAT, etc.
+  unsigned lanes_;         // Elements of a vector type; 0 for scalars
 };
 
 /**
@@ -79,7 +117,7 @@ private:
 class NamedTypeNode : public TypeNode {
 public:
   NamedTypeNode(const std::string &name, const core::SourceLocation &loc)
-      : TypeNode(loc), name_(name) {}
+      : TypeNode(NodeKind::NamedType, loc), name_(name) {}
 
   const std::string &getName() const { return name_; }
   bool accept(interface::BaseInterface *visitor) override {
@@ -87,6 +125,10 @@ public:
   };
   std::string toString() const override { return name_; }
 
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::NamedType;
+  }
+
 private:
   std::string name_;
 };
@@ -98,9 +140,14 @@ class QualifiedTypeNode : public TypeNode {
 public:
   QualifiedTypeNode(std::vector<std::string> qualifiers,
                     const core::SourceLocation &loc)
-      : TypeNode(loc), qualifiers_(std::move(qualifiers)) {}
+      : TypeNode(NodeKind::QualifiedType, loc),
+        qualifiers_(std::move(qualifiers)),
+        symbol_(core::Interner::instance().intern(toString())) {}
 
   const std::vector<std::string> &getQualifiers() const { return qualifiers_; }
+  // The whole dotted name, interned once; namespace members are declared
+  // under it
+  core::Symbol getSymbol() const { return symbol_; }
   bool accept(interface::BaseInterface *visitor) override {
     return visitor->visitParse();
   };
@@ -117,8 +164,13 @@ public:
     return result;
   }
 
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::QualifiedType;
+  }
+
 private:
   std::vector<std::string> qualifiers_;
+  core::Symbol symbol_; // Interned "Outer.Inner.Name"
 };
 
 /**
@@ -128,8 +180,8 @@ class ArrayTypeNode : public TypeNode {
 public:
   ArrayTypeNode(TypePtr elementType, ExpressionPtr size,
                 const core::SourceLocation &loc)
-      : TypeNode(loc), elementType_(std::move(elementType)),
-        size_(std::move(size)) {}
+      : TypeNode(NodeKind::ArrayType, loc),
+        elementType_(std::move(elementType)), size_(std::move(size)) {}
 
   TypePtr getElementType() const { return elementType_; }
   ExpressionPtr getSize() const { return size_; }
@@ -144,6 +196,10 @@ public:
     return result;
   }
 
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::ArrayType;
+  }
+
 private:
   TypePtr elementType_; // Type of array elements
   ExpressionPtr size_;  // Optional size expression
@@ -161,14 +217,15 @@ public:
     Aligned // T@aligned(N)
   };
 
-  PointerTypeNode(TypePtr baseType, PointerKind kind, ExpressionPtr alignment,
+  PointerTypeNode(TypePtr baseType, PointerKind kind, unsigned alignment,
                   const core::SourceLocation &loc)
-      : TypeNode(loc), baseType_(std::move(baseType)), kind_(kind),
-        alignment_(std::move(alignment)) {}
+      : TypeNode(NodeKind::PointerType, loc), baseType_(std::move(baseType)),
+        kind_(kind), alignment_(alignment) {}
 
   TypePtr getBaseType() const { return baseType_; }
   PointerKind getKind() const { return kind_; }
-  ExpressionPtr getAlignment() const { return alignment_; }
+  // Byte alignment from aligned(N), a power of two; 0 unless Aligned
+  unsigned getAlignment() const { return alignment_; }
   bool isPointer() const override { return true; }
   bool accept(interface::BaseInterface *visitor) override {
     return visitor->visitParse();
@@ -192,10 +249,14 @@ public:
     return oss.str();
   }
 
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::PointerType;
+  }
+
 private:
   TypePtr baseType_;        // Type being pointed to
   PointerKind kind_;        // Kind of pointer
-  ExpressionPtr alignment_; // Alignment for aligned pointers
+  unsigned alignment_;       // Alignment for aligned pointers
 };
 
 /**
@@ -204,7 +265,8 @@ private:
 class ReferenceTypeNode : public TypeNode {
 public:
   ReferenceTypeNode(TypePtr baseType, const core::SourceLocation &loc)
-      : TypeNode(loc), baseType_(std::move(baseType)) {}
+      : TypeNode(NodeKind::ReferenceType, loc),
+        baseType_(std::move(baseType)) {}
 
   TypePtr getBaseType() const { return baseType_; }
   bool accept(interface::BaseInterface *visitor) override {
@@ -212,6 +274,10 @@ public:
   };
   std::string toString() const override { return baseType_->toString() + "&"; }
 
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::ReferenceType;
+  }
+
 private:
   TypePtr baseType_;
 };
@@ -223,7 +289,8 @@ class FunctionTypeNode : public TypeNode {
 public:
   FunctionTypeNode(const std::vector<TypePtr> &paramTypes, TypePtr returnType,
                    const core::SourceLocation &location)
-      : TypeNode(location), paramTypes_(paramTypes), returnType_(returnType) {}
+      : TypeNode(NodeKind::FunctionType, location), paramTypes_(paramTypes),
+        returnType_(returnType) {}
 
   // Override visitor accept method
   TypePtr getReturnType() const { return returnType_; }
@@ -247,6 +314,10 @@ public:
     return oss.str();
   }
 
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::FunctionType;
+  }
+
 private:
   std::vector<TypePtr> paramTypes_;
   TypePtr returnType_;
@@ -259,7 +330,7 @@ class TemplateTypeNode : public TypeNode {
 public:
   TemplateTypeNode(TypePtr baseType, std::vector<TypePtr> arguments,
                    const core::SourceLocation &loc)
-      : TypeNode(loc), baseType_(std::move(baseType)),
+      : TypeNode(NodeKind::TemplateType, loc), baseType_(std::move(baseType)),
         arguments_(std::move(arguments)) {}
 
   TypePtr getBaseType() const { return baseType_; }
@@ -281,6 +352,10 @@ public:
     return oss.str();
   }
 
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::TemplateType;
+  }
+
 private:
   TypePtr baseType_;               // Template type being instantiated
   std::vector<TypePtr> arguments_; // Template arguments
@@ -295,7 +370,8 @@ public:
 
   SmartPointerTypeNode(TypePtr pointeeType, SmartPointerKind kind,
                        const core::SourceLocation &loc)
-      : TypeNode(loc), pointeeType_(std::move(pointeeType)), kind_(kind) {}
+      : TypeNode(NodeKind::SmartPointerType, loc),
+        pointeeType_(std::move(pointeeType)), kind_(kind) {}
 
   TypePtr getPointeeType() const { return pointeeType_; }
   SmartPointerKind getKind() const { return kind_; }
@@ -318,18 +394,47 @@ public:
     return kindStr + "<" + pointeeType_->toString() + ">";
   }
 
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::SmartPointerType;
+  }
+
 private:
   TypePtr pointeeType_;
   SmartPointerKind kind_;
 };
 
+/**
+ * Atomic value type (#atomic<int>, #atomic<Node@>)
+ */
+class AtomicTypeNode : public TypeNode {
+public:
+  AtomicTypeNode(TypePtr valueType, const core::SourceLocation &loc)
+      : TypeNode(NodeKind::AtomicType, loc), valueType_(std::move(valueType)) {}
+
+  TypePtr getValueType() const { return valueType_; }
+  bool accept(interface::BaseInterface *visitor) override {
+    return visitor->visitParse();
+  };
+  std::string toString() const override {
+    return "#atomic<" + valueType_->toString() + ">";
+  }
+
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::AtomicType;
+  }
+
+private:
+  TypePtr valueType_;
+};
+
 /**
  * unioun type node (int | float | string)
  */
 class UnionTypeNode : public TypeNode {
 public:
   UnionTypeNode(TypePtr left, TypePtr right, const core::SourceLocation &loc)
-      : TypeNode(loc), left_(std::move(left)), right_(std::move(right)) {}
+      : TypeNode(NodeKind::UnionType, loc), left_(std::move(left)),
+        right_(std::move(right)) {}
 
   TypePtr getLeft() const { return left_; }
   TypePtr getRight() const { return right_; }
@@ -343,6 +448,10 @@ public:
     return left_->toString() + " | " + right_->toString();
   }
 
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::UnionType;
+  }
+
 private:
   TypePtr left_;
   TypePtr right_;
@@ -352,7 +461,7 @@ class GenericParamNode : public nodes::TypeNode {
 public:
   GenericParamNode(std::string name, std::vector<nodes::TypePtr> constraints,
                    const core::SourceLocation &loc)
-      : TypeNode(loc), name_(std::move(name)),
+      : TypeNode(NodeKind::GenericParam, loc), name_(std::move(name)),
         constraints_(std::move(constraints)) {}
 
   const std::string &getName() const { return name_; }
@@ -379,6 +488,10 @@ public:
     return visitor->visitParse();
   }
 
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::GenericParam;
+  }
+
 private:
   std::string name_;
   std::vector<nodes::TypePtr> constraints_;
@@ -389,7 +502,8 @@ class BuiltinConstraintNode : public nodes::TypeNode {
 public:
   BuiltinConstraintNode(std::string constraintName,
                         const core::SourceLocation &loc)
-      : TypeNode(loc), constraintName_(std::move(constraintName)) {}
+      : TypeNode(NodeKind::BuiltinConstraint, loc),
+        constraintName_(std::move(constraintName)) {}
 
   const std::string &getConstraintName() const { return constraintName_; }
 
@@ -399,6 +513,10 @@ public:
     return visitor->visitParse();
   }
 
+  static bool classof(const BaseNode *node) {
+    return node->getNodeKind() == NodeKind::BuiltinConstraint;
+  }
+
 private:
   std::string constraintName_;
 };
@@ -4,29 +4,92 @@
  *****************************************************************************/
 
 #include "parser.h"
+#include "lexer/lexer.h"
 
 namespace parser {
 
+namespace {
+
+// Lexes and parses one deferred body, and installs it in its node
+template <typename Node>
+bool parseBody(Node *node, ASTContext &context,
+               core::ErrorReporter &errorReporter) {
+  const nodes::DeferredBody &range = node->getDeferredBody();
+  tokens::TokenStream tokens(
+      lexer::Lexer(range.file, range.begin, range.end).tokenize());
+  try {
+    // The block parser recovers from some errors, so count them too
+    const int errorsBefore = errorReporter.errorCount();
+    visitors::BaseParseVisitor visitor(tokens, errorReporter, context);
+    nodes::BlockPtr body = visitor.parseBody();
+    if (!body) {
+      return false;
+    }
+    node->setBody(body);
+    return errorReporter.errorCount() == errorsBefore;
+  } catch (const std::exception &e) {
+    errorReporter.error(tokens.peek().getLocation(),
+                        std::string("Unexpected error during compilation: ") +
+                            e.what());
+    return false;
+  }
+}
+
+// Parses the deferred bodies among declarations and what they contain
+bool parseBodiesIn(const std::vector<nodes::NodePtr> &declarations,
+                   ASTContext &context, core::ErrorReporter &errorReporter,
+                   const std::unordered_set<const nodes::BaseNode *> &skip) {
+  bool success = true;
+  for (nodes::NodePtr node : declarations) {
+    if (auto stmt = nodes::dyn_cast<nodes::DeclarationStmtNode>(node)) {
+      node = stmt->getDeclaration();
+    }
+    if (auto function = nodes::dyn_cast<nodes::FunctionDeclNode>(node)) {
+      if (function->getDeferredBody() && !skip.count(function)) {
+        success = parseBody(function, context, errorReporter) && success;
+      }
+    } else if (auto method = nodes::dyn_cast<nodes::MethodDeclNode>(node)) {
+      if (method->getDeferredBody()) {
+        success = parseBody(method, context, errorReporter) && success;
+      }
+    } else if (auto cls = nodes::dyn_cast<nodes::ClassDeclNode>(node)) {
+      std::vector<nodes::NodePtr> members(cls->getMembers().begin(),
+                                          cls->getMembers().end());
+      success = parseBodiesIn(members, context, errorReporter, {}) && success;
+    } else if (auto ns = nodes::dyn_cast<nodes::NamespaceDeclNode>(node)) {
+      std::vector<nodes::NodePtr> members(ns->getDeclarations().begin(),
+                                          ns->getDeclarations().end());
+      success = parseBodiesIn(members, context, errorReporter, {}) && success;
+    }
+  }
+  return success;
+}
+
+} // namespace
+
 Parser::Parser(std::vector<tokens::Token> tokens,
-               core::ErrorReporter &errorReporter)
-    : tokens_(std::move(tokens)), errorReporter_(errorReporter), ast_(),
-      visitor_(
-          std::make_unique<visitors::BaseVisitor>(tokens_, errorReporter_)) {}
+               core::ErrorReporter &errorReporter,
+               visitors::TypeScope *globalScope)
+    : tokens_(std::move(tokens)), errorReporter_(errorReporter),
+      visitor_(std::make_unique<visitors::BaseVisitor>(
+          tokens_, errorReporter_, globalScope)) {}
+
+Parser::Parser(tokens::TokenStream tokens, core::ErrorReporter &errorReporter,
+               visitors::TypeScope *globalScope)
+    : tokens_(std::move(tokens)), errorReporter_(errorReporter),
+      visitor_(std::make_unique<visitors::BaseVisitor>(
+          tokens_, errorReporter_, globalScope)) {}
 
-bool Parser::parse() {
+bool Parser::parse(bool typeCheck) {
   try {
     // Clear previous parse results
-    ast_.clear();
     errorReporter_.clear();
 
     // Start the parsing and type checking process
-    if (!visitor_->compile()) {  // Changed from parse() to compile()
+    if (!(typeCheck ? visitor_->compile() : visitor_->parse())) {
       return false;
     }
 
-    // Get the AST from the visitor
-    ast_ = visitor_->getAST();
-
     // Check for any errors that occurred during parsing or type checking
     return !hasErrors();
   } catch (const std::exception &e) {
@@ -41,4 +104,15 @@ bool Parser::parse() {
   }
 }
 
-} // namespace parser
\ No newline at end of file
+bool Parser::parseBodies(
+    AST &ast, core::ErrorReporter &errorReporter,
+    const std::unordered_set<const nodes::BaseNode *> &skip) {
+  return parseBodiesIn(ast.getNodes(), ast.getContext(), errorReporter, skip);
+}
+
+bool Parser::parseBody(nodes::FunctionDeclNode *function, ASTContext &context,
+                       core::ErrorReporter &errorReporter) {
+  return parser::parseBody(function, context, errorReporter);
+}
+
+} // namespace parser
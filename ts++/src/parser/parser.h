@@ -8,19 +8,46 @@
 #include "parser/ast.h"
 #include "parser/visitors/base_visitor.h"
 #include "tokens/stream/token_stream.h"
+#include <unordered_set>
 
 namespace parser {
 
 class Parser {
 public:
+  // globalScope, if given, carries declarations over from earlier parses
   explicit Parser(std::vector<tokens::Token> tokens,
-                  core::ErrorReporter &errorReporter);
+                  core::ErrorReporter &errorReporter,
+                  visitors::TypeScope *globalScope = nullptr);
 
-  // Parse the token stream and build AST
-  bool parse();
+  // Parses a stream that may lex its tokens as they are read
+  explicit Parser(tokens::TokenStream tokens,
+                  core::ErrorReporter &errorReporter,
+                  visitors::TypeScope *globalScope = nullptr);
+
+  // Parse the token stream and build AST. Without typeCheck the caller
+  // type-checks the AST, as a multi-file build does across all its files.
+  bool parse(bool typeCheck = true);
+
+  // Skip function and method bodies, keeping only their source ranges,
+  // for callers that want the declarations or parse bodies on demand
+  void setDeferBodies(bool defer) { visitor_->setDeferBodies(defer); }
+
+  // Parse the deferred bodies of an AST's functions and methods into its
+  // arena, except those of the top-level functions in skip
+  static bool
+  parseBodies(AST &ast, core::ErrorReporter &errorReporter,
+              const std::unordered_set<const nodes::BaseNode *> &skip = {});
+
+  // Parse one function's deferred body into a given arena, e.g. one freed
+  // once the body has been generated
+  static bool parseBody(nodes::FunctionDeclNode *function, ASTContext &context,
+                        core::ErrorReporter &errorReporter);
 
   // Access the AST and errors
-  const AST &getAST() const { return ast_; }
+  const AST &getAST() const { return visitor_->getAST(); }
+
+  // Take the AST, to keep its nodes once the parser is gone
+  AST takeAST() { return visitor_->takeAST(); }
   bool hasErrors() const { return errorReporter_.hasErrors(); }
   const std::vector<core::Diagnostic> &getErrors() const {
     return errorReporter_.getDiagnostics();
@@ -29,7 +56,6 @@ public:
 private:
   tokens::TokenStream tokens_;                // Token stream being parsed
   core::ErrorReporter &errorReporter_;        // Error reporting 
-  AST ast_;                                   // AST being built
   std::unique_ptr<visitors::BaseVisitor> visitor_; // Main visitor for parsing
 };
 
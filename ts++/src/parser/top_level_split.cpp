@@ -0,0 +1,81 @@
+/*****************************************************************************
+ * File: top_level_split.cpp
+ * Description: Implementation of the top-level declaration pre-scan
+ *****************************************************************************/
+
+#include "top_level_split.h"
+
+namespace parser {
+
+namespace {
+
+// Tokens that start a declaration ending in a block of its own
+bool startsDeclaration(tokens::TokenType type) {
+  switch (type) {
+  case tokens::TokenType::FUNCTION:
+  case tokens::TokenType::ASYNC:
+  case tokens::TokenType::CLASS:
+  case tokens::TokenType::ABSTRACT:
+  case tokens::TokenType::INTERFACE:
+  case tokens::TokenType::ENUM:
+  case tokens::TokenType::NAMESPACE:
+  case tokens::TokenType::TYPEDEF:
+  case tokens::TokenType::ATTRIBUTE:
+    return true;
+  default:
+    return tokens::isFunctionModifier(type);
+  }
+}
+
+} // namespace
+
+bool TopLevelScanner::next(tokens::TokenType type) {
+  if (broken_) {
+    return false;
+  }
+  bool cut = false;
+  if (!started_ || itemEnded_) {
+    declaration_ = startsDeclaration(type);
+    cut = started_ && declaration_;
+    started_ = true;
+  }
+
+  itemEnded_ = false;
+  switch (type) {
+  case tokens::TokenType::LEFT_BRACE:
+  case tokens::TokenType::LEFT_PAREN:
+  case tokens::TokenType::LEFT_BRACKET:
+    ++depth_;
+    break;
+  case tokens::TokenType::RIGHT_BRACE:
+    // Only a declaration's block ends it; an if still has its else
+    itemEnded_ = --depth_ == 0 && declaration_;
+    break;
+  case tokens::TokenType::RIGHT_PAREN:
+  case tokens::TokenType::RIGHT_BRACKET:
+    --depth_;
+    break;
+  case tokens::TokenType::SEMICOLON:
+    itemEnded_ = depth_ == 0;
+    break;
+  default:
+    break;
+  }
+  // Unbalanced brackets are a syntax error; the rest stays in one part
+  broken_ = depth_ < 0;
+  return cut;
+}
+
+std::vector<size_t> splitTopLevel(const std::vector<tokens::Token> &tokens,
+                                  size_t partTokens) {
+  std::vector<size_t> starts = {0};
+  TopLevelScanner scanner;
+  for (size_t i = 0; i < tokens.size(); ++i) {
+    if (scanner.next(tokens[i].getType()) && i - starts.back() >= partTokens) {
+      starts.push_back(i);
+    }
+  }
+  return starts;
+}
+
+} // namespace parser
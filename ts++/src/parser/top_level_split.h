@@ -0,0 +1,54 @@
+/*****************************************************************************
+ * File: top_level_split.h
+ * Description: Splits a file's tokens between its top-level declarations
+ *****************************************************************************/
+
+#pragma once
+#include "tokens/tokens.h"
+#include <cstddef>
+#include <vector>
+
+namespace parser {
+
+/**
+ * @brief Finds safe cuts between top-level declarations a token at a time
+ *
+ * Fed a file's tokens in order from its start, or from an earlier safe
+ * cut, it tells for each token whether a part may start at it.
+ */
+class TopLevelScanner {
+public:
+  /**
+   * @brief Feeds the next token
+   * @param type The token's type
+   * @return Whether a part may start at this token
+   */
+  bool next(tokens::TokenType type);
+
+private:
+  int depth_ = 0;            // Bracket depth
+  bool started_ = false;     // A token has been fed
+  bool declaration_ = false; // The current item began with a declaration
+  bool itemEnded_ = false;   // The last token ended an item
+  bool broken_ = false;      // Brackets went unbalanced; nothing is cut
+};
+
+/**
+ * @brief Finds where a file's tokens can be cut into separately parsed parts
+ *
+ * Function, class, namespace and the like end in a balanced brace, and
+ * variables and statements in a semicolon, so a single pass that counts
+ * bracket depth finds the top-level declarations without parsing them.
+ * A cut is only made in front of a declaration keyword at depth 0 that
+ * starts a new item: after a ';', or after the '}' closing an item that
+ * itself began with such a keyword. A cut that cannot be proven safe is
+ * not made, so the parts parse to the same nodes the whole file would.
+ *
+ * @param tokens The file's tokens, ending with END_OF_FILE
+ * @param partTokens Tokens a part should have at least
+ * @return The first token index of every part, starting with 0
+ */
+std::vector<size_t> splitTopLevel(const std::vector<tokens::Token> &tokens,
+                                  size_t partTokens);
+
+} // namespace parser
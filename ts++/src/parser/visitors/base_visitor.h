@@ -15,14 +15,16 @@ namespace visitors {
 class BaseVisitor {
 public:
   explicit BaseVisitor(tokens::TokenStream &tokens,
-                       core::ErrorReporter &errorReporter)
+                       core::ErrorReporter &errorReporter,
+                       TypeScope *globalScope = nullptr)
       : tokens_(tokens), errorReporter_(errorReporter),
         parseVisitor_(
-            std::make_unique<BaseParseVisitor>(tokens_, errorReporter_)),
+            std::make_unique<BaseParseVisitor>(tokens_, errorReporter_,
+                                               ast_.getContext())),
         // Initialize the type check visitor
         typeCheckVisitor_(
             std::make_unique<TypeCheckVisitor>(
-                errorReporter_)) {}
+                errorReporter_, globalScope)) {}
 
   // Prevent copying but allow moving
   BaseVisitor(const BaseVisitor &) = delete;
@@ -78,9 +80,13 @@ public:
     return true;
   }
 
+  // Skip function and method bodies while parsing
+  void setDeferBodies(bool defer) { parseVisitor_->setDeferBodies(defer); }
+
   // AST management
-  void addNode(nodes::NodePtr node) { ast_.addNode(std::move(node)); }
-  const parser::AST &getAST() { return ast_; }
+  void addNode(nodes::NodePtr node) { ast_.addNode(node); }
+  const parser::AST &getAST() const { return ast_; }
+  parser::AST takeAST() { return std::move(ast_); }
 
 private:
   tokens::TokenStream &tokens_;
@@ -0,0 +1,690 @@
+#include "comptime_evaluator.h"
+#include "parser/visitors/constant_folder/constant_arithmetic.h"
+#include "parser/visitors/type_check_visitor/resolved_type.h"
+#include <algorithm>
+#include <climits>
+
+namespace visitors {
+
+namespace {
+
+using Value = ComptimeEvaluator::Value;
+using Kind = Value::Kind;
+
+// Scalars share the constant folder's arithmetic, and its kinds' order
+static_assert(static_cast<int>(Kind::Bool) ==
+              static_cast<int>(Constant::Kind::Bool));
+
+Constant toConstant(const Value &value) {
+  return {static_cast<Constant::Kind>(value.kind), value.scalar};
+}
+
+Value fromConstant(const Constant &constant) {
+  Value result;
+  result.kind = static_cast<Kind>(constant.kind);
+  result.scalar = constant.value;
+  return result;
+}
+
+Value intValue(int64_t value) { return fromConstant(intConstant(value)); }
+
+Value floatValue(double value) { return fromConstant(floatConstant(value)); }
+
+Value boolValue(bool value) { return fromConstant(boolConstant(value)); }
+
+const char *kindName(Kind kind) {
+  switch (kind) {
+  case Kind::Int:
+    return "int";
+  case Kind::Float:
+    return "float";
+  case Kind::Bool:
+    return "boolean";
+  default:
+    return "array";
+  }
+}
+
+} // namespace
+
+void ComptimeEvaluator::declareAST(const parser::AST &ast) {
+  releaseBodies();
+  functions_.clear();
+  globals_.clear();
+  enumMembers_.clear();
+  values_.clear();
+  for (nodes::NodePtr node : ast.getNodes()) {
+    if (auto stmt = nodes::dyn_cast<nodes::DeclarationStmtNode>(node)) {
+      node = stmt->getDeclaration();
+    }
+    if (auto function = nodes::dyn_cast<nodes::FunctionDeclNode>(node)) {
+      // Generic functions have no one body to run
+      if (function->getNodeKind() == nodes::NodeKind::FunctionDecl) {
+        functions_[function->getName()] = function;
+      }
+    } else if (auto var = nodes::dyn_cast<nodes::VarDeclNode>(node)) {
+      globals_[var->getName()] = var;
+    } else if (auto enumDecl = nodes::dyn_cast<nodes::EnumDeclNode>(node)) {
+      for (const auto *member : enumDecl->getMembers()) {
+        enumMembers_[enumDecl->getName() + "." + member->getName()] =
+            member->getConstantValue();
+      }
+    }
+  }
+}
+
+std::optional<Value>
+ComptimeEvaluator::evaluate(const nodes::VarDeclNode *node) {
+  error_.reset();
+  steps_ = 0;
+  try {
+    return evaluateGlobal(node);
+  } catch (const Failure &) {
+    locals_.clear();
+    frame_ = 0;
+    depth_ = 0;
+    evaluating_.clear();
+    return std::nullopt;
+  }
+}
+
+void ComptimeEvaluator::fail(const core::SourceLocation &location,
+                             const std::string &message) {
+  error_.emplace(message, location);
+  throw Failure();
+}
+
+void ComptimeEvaluator::step(const core::SourceLocation &location) {
+  if (++steps_ > stepLimit_) {
+    fail(location, "Compile-time evaluation did not finish within " +
+                       std::to_string(stepLimit_) + " steps");
+  }
+}
+
+Value ComptimeEvaluator::evaluateGlobal(const nodes::VarDeclNode *node) {
+  auto known = values_.find(node);
+  if (known != values_.end()) {
+    return known->second;
+  }
+  if (!node->isConst() || !node->getInitializer()) {
+    fail(node->getLocation(), "Cannot read '" + node->getName() +
+                                  "' at compile time; it is not a constant");
+  }
+  if (std::find(evaluating_.begin(), evaluating_.end(), node) !=
+      evaluating_.end()) {
+    fail(node->getLocation(),
+         "Constant '" + node->getName() + "' depends on itself");
+  }
+
+  // A global's initializer sees no locals of the function reading it
+  evaluating_.push_back(node);
+  size_t frame = frame_;
+  frame_ = locals_.size();
+  Value value = eval(node->getInitializer());
+  if (node->getType()) {
+    Value like = zeroOf(node->getType(), node->getLocation());
+    value = convert(std::move(value), like, node->getLocation());
+  }
+  frame_ = frame;
+  evaluating_.pop_back();
+  return values_[node] = std::move(value);
+}
+
+Value ComptimeEvaluator::zeroOf(const nodes::TypeNode *type,
+                                const core::SourceLocation &at) {
+  if (!type) {
+    fail(at, "Values evaluated at compile time need a declared type");
+  }
+  if (auto primitive = nodes::dyn_cast<nodes::PrimitiveTypeNode>(type)) {
+    if (!primitive->isVector()) {
+      switch (primitive->getType()) {
+      case tokens::TokenType::INT:
+        return intValue(0);
+      case tokens::TokenType::FLOAT:
+        return floatValue(0);
+      case tokens::TokenType::BOOLEAN:
+        return boolValue(false);
+      default:
+        break;
+      }
+    }
+  } else if (auto named = nodes::dyn_cast<nodes::NamedTypeNode>(type)) {
+    // A for loop's variable names its primitive type
+    if (named->getName() == "int") {
+      return intValue(0);
+    }
+    if (named->getName() == "float") {
+      return floatValue(0);
+    }
+    if (named->getName() == "bool") {
+      return boolValue(false);
+    }
+  } else if (auto array = nodes::dyn_cast<nodes::ArrayTypeNode>(type)) {
+    // The folder gave each constant size its value
+    const nodes::ExpressionNode *size = array->getSize();
+    if (size && size->isFolded()) {
+      Value result;
+      result.kind = Kind::Array;
+      result.elements.assign(size->getFoldedValue().int_value,
+                             zeroOf(array->getElementType(), at));
+      return result;
+    }
+    fail(at, "Arrays evaluated at compile time need a constant size");
+  }
+  fail(at, "Only int, float, boolean and sized arrays of them can be "
+           "evaluated at compile time");
+}
+
+Value ComptimeEvaluator::convert(Value value, const Value &like,
+                                 const core::SourceLocation &at) {
+  if (like.kind == Kind::Array) {
+    if (value.kind != Kind::Array ||
+        value.elements.size() != like.elements.size()) {
+      fail(at, "Array of " + std::to_string(value.elements.size()) +
+                   " elements does not fit one of " +
+                   std::to_string(like.elements.size()));
+    }
+    for (size_t i = 0; i < value.elements.size(); ++i) {
+      value.elements[i] =
+          convert(std::move(value.elements[i]), like.elements[i], at);
+    }
+    return value;
+  }
+  if (value.kind == like.kind) {
+    return value;
+  }
+  if (like.kind == Kind::Float && value.kind == Kind::Int) {
+    return floatValue(asFloat(toConstant(value)));
+  }
+  fail(at, std::string("Cannot convert ") + kindName(value.kind) + " to " +
+               kindName(like.kind) + " at compile time");
+}
+
+ComptimeEvaluator::Flow
+ComptimeEvaluator::execute(const nodes::StatementNode *node) {
+  using namespace nodes;
+  if (!node) {
+    return Flow::Normal;
+  }
+  step(node->getLocation());
+  switch (node->getNodeKind()) {
+  case NodeKind::Block:
+    return executeBlock(cast<BlockNode>(node));
+  case NodeKind::DeclarationStmt: {
+    auto var = dyn_cast<VarDeclNode>(
+        cast<DeclarationStmtNode>(node)->getDeclaration());
+    if (!var) {
+      break;
+    }
+    declareLocal(var);
+    return Flow::Normal;
+  }
+  case NodeKind::ExpressionStmt:
+    eval(cast<ExpressionStmtNode>(node)->getExpression());
+    return Flow::Normal;
+  case NodeKind::IfStmt: {
+    auto ifStmt = cast<IfStmtNode>(node);
+    return evalCondition(ifStmt->getCondition())
+               ? execute(ifStmt->getThenBranch())
+               : execute(ifStmt->getElseBranch());
+  }
+  case NodeKind::WhileStmt: {
+    auto whileStmt = cast<WhileStmtNode>(node);
+    bool exit = false;
+    while (!exit && evalCondition(whileStmt->getCondition())) {
+      Flow flow = executeLoopBody(whileStmt->getBody(), exit);
+      if (flow == Flow::Return) {
+        return flow;
+      }
+    }
+    return Flow::Normal;
+  }
+  case NodeKind::DoWhileStmt: {
+    auto doWhile = cast<DoWhileStmtNode>(node);
+    bool exit = false;
+    do {
+      Flow flow = executeLoopBody(doWhile->getBody(), exit);
+      if (flow == Flow::Return) {
+        return flow;
+      }
+    } while (!exit && evalCondition(doWhile->getCondition()));
+    return Flow::Normal;
+  }
+  case NodeKind::ForStmt: {
+    auto forStmt = cast<ForStmtNode>(node);
+    size_t scope = locals_.size();
+    Flow flow = execute(forStmt->getInitializer());
+    bool exit = false;
+    while (flow == Flow::Normal && !exit &&
+           (!forStmt->getCondition() ||
+            evalCondition(forStmt->getCondition()))) {
+      flow = executeLoopBody(forStmt->getBody(), exit);
+      if (flow == Flow::Normal && !exit && forStmt->getIncrement()) {
+        eval(forStmt->getIncrement());
+      }
+    }
+    locals_.resize(scope);
+    return flow;
+  }
+  case NodeKind::BreakStmt:
+    if (!cast<BreakStmtNode>(node)->getLabel().empty()) {
+      break;
+    }
+    return Flow::Break;
+  case NodeKind::ContinueStmt:
+    if (!cast<ContinueStmtNode>(node)->getLabel().empty()) {
+      break;
+    }
+    return Flow::Continue;
+  case NodeKind::ReturnStmt: {
+    auto value = cast<ReturnStmtNode>(node)->getValue();
+    returned_.reset();
+    if (value) {
+      returned_ = eval(value);
+    }
+    return Flow::Return;
+  }
+  default:
+    break;
+  }
+  fail(node->getLocation(),
+       "This statement cannot be evaluated at compile time");
+}
+
+ComptimeEvaluator::Flow
+ComptimeEvaluator::executeBlock(const nodes::BlockNode *node) {
+  size_t scope = locals_.size();
+  Flow flow = Flow::Normal;
+  for (const auto &stmt : node->getStatements()) {
+    auto statement = nodes::dyn_cast<nodes::StatementNode>(stmt);
+    if (!statement) {
+      fail(node->getLocation(),
+           "This statement cannot be evaluated at compile time");
+    }
+    flow = execute(statement);
+    if (flow != Flow::Normal) {
+      break;
+    }
+  }
+  locals_.resize(scope);
+  return flow;
+}
+
+ComptimeEvaluator::Flow
+ComptimeEvaluator::executeLoopBody(const nodes::StatementNode *body,
+                                   bool &exit) {
+  Flow flow = execute(body);
+  exit = flow == Flow::Break;
+  return flow == Flow::Return ? flow : Flow::Normal;
+}
+
+void ComptimeEvaluator::declareLocal(const nodes::VarDeclNode *node) {
+  Value value;
+  if (node->getType()) {
+    value = zeroOf(node->getType(), node->getLocation());
+    if (node->getInitializer()) {
+      value = convert(eval(node->getInitializer()), value, node->getLocation());
+    }
+  } else if (node->getInitializer()) {
+    value = eval(node->getInitializer());
+  }
+  locals_.emplace_back(node->getName(), std::move(value));
+}
+
+Value ComptimeEvaluator::eval(const nodes::ExpressionNode *node) {
+  using namespace nodes;
+  // The folder has already worked out constant subexpressions
+  if (node->isFolded() && node->getResolvedType()) {
+    switch (node->getResolvedType()->getKind()) {
+    case ResolvedType::TypeKind::Int:
+      return intValue(node->getFoldedValue().int_value);
+    case ResolvedType::TypeKind::Float:
+      return floatValue(node->getFoldedValue().float_value);
+    case ResolvedType::TypeKind::Bool:
+      return boolValue(node->getFoldedValue().bool_value);
+    default:
+      break;
+    }
+  }
+
+  switch (node->getNodeKind()) {
+  case NodeKind::LiteralExpression:
+    return evalLiteral(cast<LiteralExpressionNode>(node));
+  case NodeKind::IdentifierExpression:
+  case NodeKind::IndexExpression: {
+    if (auto index = dyn_cast<IndexExpressionNode>(node);
+        index && !isPlace(index)) {
+      // An element of a temporary, such as a call's result
+      Value array = eval(index->getArray());
+      Value position = eval(index->getIndex());
+      if (array.kind != Kind::Array || position.kind != Kind::Int) {
+        break;
+      }
+      int64_t i = position.scalar.int_value;
+      if (i < 0 || static_cast<size_t>(i) >= array.elements.size()) {
+        fail(node->getLocation(),
+             "Index " + std::to_string(i) + " is out of bounds at compile "
+                                            "time");
+      }
+      return std::move(array.elements[i]);
+    }
+    return *place(node, false);
+  }
+  case NodeKind::BinaryExpression:
+    return evalBinary(cast<BinaryExpressionNode>(node));
+  case NodeKind::UnaryExpression:
+    return evalUnary(cast<UnaryExpressionNode>(node));
+  case NodeKind::AssignmentExpression:
+    return evalAssignment(cast<AssignmentExpressionNode>(node));
+  case NodeKind::CallExpression:
+    return evalCall(cast<CallExpressionNode>(node));
+  case NodeKind::MemberExpression:
+    return evalMember(cast<MemberExpressionNode>(node));
+  case NodeKind::ConditionalExpression: {
+    auto conditional = cast<ConditionalExpressionNode>(node);
+    return evalCondition(conditional->getCondition())
+               ? eval(conditional->getTrueExpression())
+               : eval(conditional->getFalseExpression());
+  }
+  case NodeKind::CompileTimeExpression: {
+    auto compileTime = cast<CompileTimeExpressionNode>(node);
+    if (compileTime->getExpressionType() != tokens::TokenType::CONST_EXPR) {
+      break;
+    }
+    return eval(compileTime->getOperand());
+  }
+  case NodeKind::ArrayLiteral: {
+    Value result;
+    result.kind = Kind::Array;
+    for (const auto &element : cast<ArrayLiteralNode>(node)->getElements()) {
+      result.elements.push_back(eval(element));
+    }
+    return result;
+  }
+  default:
+    break;
+  }
+  fail(node->getLocation(),
+       "This expression cannot be evaluated at compile time");
+}
+
+Value ComptimeEvaluator::evalLiteral(const nodes::LiteralExpressionNode *node) {
+  switch (node->getExpressionType()) {
+  case tokens::TokenType::NUMBER: {
+    // A fraction or exponent makes a float literal
+    const tokens::NumberValue &number = node->getNumber();
+    if (number.isFloat()) {
+      return floatValue(number.real);
+    }
+    if (number.isInteger() && number.integer <= INT_MAX) {
+      return intValue(static_cast<int64_t>(number.integer));
+    }
+    break;
+  }
+  case tokens::TokenType::TRUE:
+    return boolValue(true);
+  case tokens::TokenType::FALSE:
+    return boolValue(false);
+  default:
+    break;
+  }
+  fail(node->getLocation(), "Literal '" + node->getValue() +
+                                "' cannot be evaluated at compile time");
+}
+
+Value ComptimeEvaluator::evalBinary(const nodes::BinaryExpressionNode *node) {
+  Value left = eval(node->getLeft());
+  Value right = eval(node->getRight());
+  tokens::TokenType op = node->getExpressionType();
+  const core::SourceLocation &at = node->getLocation();
+  if (left.kind == Kind::Array || right.kind == Kind::Array) {
+    fail(at, "Arrays have no operators at compile time");
+  }
+
+  ArithmeticError error;
+  std::optional<Constant> result =
+      applyBinary(op, toConstant(left), toConstant(right), error);
+  if (result) {
+    return fromConstant(*result);
+  }
+  switch (error) {
+  case ArithmeticError::Operands:
+    fail(at, "Invalid operands in binary expression");
+  case ArithmeticError::DivisionByZero:
+    fail(at, "Division by zero at compile time");
+  case ArithmeticError::Overflow:
+    fail(at, "Division overflows at compile time");
+  default:
+    fail(at, "Unsupported binary operator at compile time");
+  }
+}
+
+Value ComptimeEvaluator::evalUnary(const nodes::UnaryExpressionNode *node) {
+  tokens::TokenType op = node->getExpressionType();
+  const core::SourceLocation &at = node->getLocation();
+  if (op == tokens::TokenType::PLUS_PLUS ||
+      op == tokens::TokenType::MINUS_MINUS) {
+    Value *target = place(node->getOperand(), true);
+    if (!target || target->kind == Kind::Array ||
+        target->kind == Kind::Bool) {
+      fail(at, "Invalid operand of increment at compile time");
+    }
+    Value before = *target;
+    int delta = op == tokens::TokenType::PLUS_PLUS ? 1 : -1;
+    *target = target->kind == Kind::Int
+                  ? intValue(static_cast<int64_t>(before.scalar.int_value) +
+                             delta)
+                  : floatValue(before.scalar.float_value + delta);
+    return node->isPrefix() ? *target : before;
+  }
+
+  Value operand = eval(node->getOperand());
+  if (operand.kind != Kind::Array) {
+    if (std::optional<Constant> result = applyUnary(op, toConstant(operand))) {
+      return fromConstant(*result);
+    }
+  }
+  fail(at, "Unsupported unary operator at compile time");
+}
+
+Value ComptimeEvaluator::evalAssignment(
+    const nodes::AssignmentExpressionNode *node) {
+  if (node->getExpressionType() != tokens::TokenType::EQUALS) {
+    fail(node->getLocation(),
+         "Compound assignment cannot be evaluated at compile time");
+  }
+  // The value first: a call in it may move the locals
+  Value value = eval(node->getValue());
+  Value *target = place(node->getTarget(), true);
+  if (!target) {
+    fail(node->getLocation(),
+         "Only locals and their elements can be assigned at compile time");
+  }
+  *target = convert(std::move(value), *target, node->getLocation());
+  return *target;
+}
+
+Value ComptimeEvaluator::evalCall(const nodes::CallExpressionNode *node) {
+  auto callee =
+      nodes::dyn_cast<nodes::IdentifierExpressionNode>(node->getCallee());
+  auto found = callee && !lookupLocal(callee->getName())
+                   ? functions_.find(callee->getName())
+                   : functions_.end();
+  if (found == functions_.end()) {
+    fail(node->getLocation(),
+         "Only top-level functions can be called at compile time");
+  }
+  const nodes::FunctionDeclNode *function = found->second;
+  if (bodyStream_ && bodyStream_->streams(function) &&
+      !loaded_.count(function)) {
+    if (!bodyStream_->load(function)) {
+      fail(node->getLocation(), "Function '" + function->getName() +
+                                    "' did not compile");
+    }
+    loaded_.insert(function);
+  }
+  if (!function->getBody() || function->isAsync() || function->isExternC()) {
+    fail(node->getLocation(), "Function '" + function->getName() +
+                                  "' cannot be called at compile time");
+  }
+  const auto &params = function->getParameters();
+  const auto &arguments = node->getArguments();
+  if (arguments.size() > params.size()) {
+    fail(node->getLocation(),
+         "Too many arguments to '" + function->getName() + "'");
+  }
+  if (++depth_ > kMaxCallDepth) {
+    fail(node->getLocation(), "Compile-time calls nest deeper than " +
+                                  std::to_string(kMaxCallDepth));
+  }
+  step(node->getLocation());
+
+  // Arguments are copied in, defaults evaluated where the callee is
+  std::vector<Value> values;
+  for (size_t i = 0; i < params.size(); ++i) {
+    const nodes::ParameterNode *param = params[i];
+    if (param->isRef()) {
+      fail(param->getLocation(),
+           "ref parameters cannot be passed at compile time");
+    }
+    const nodes::ExpressionNode *argument =
+        i < arguments.size() ? arguments[i] : param->getDefaultValue();
+    if (!argument) {
+      fail(node->getLocation(),
+           "Missing argument for '" + param->getName() + "'");
+    }
+    values.push_back(convert(eval(argument),
+                             zeroOf(param->getType(), param->getLocation()),
+                             argument->getLocation()));
+  }
+
+  size_t frame = frame_;
+  frame_ = locals_.size();
+  for (size_t i = 0; i < params.size(); ++i) {
+    locals_.emplace_back(params[i]->getName(), std::move(values[i]));
+  }
+  returned_.reset();
+  Flow flow = executeBlock(function->getBody());
+  std::optional<Value> result =
+      flow == Flow::Return ? std::move(returned_) : std::nullopt;
+  returned_.reset();
+  locals_.resize(frame_);
+  frame_ = frame;
+  --depth_;
+
+  const nodes::TypeNode *returnType = function->getReturnType();
+  if (!returnType) {
+    return result ? std::move(*result) : Value();
+  }
+  if (!returnType->isVoid()) {
+    if (!result) {
+      fail(function->getLocation(), "Function '" + function->getName() +
+                                        "' ended without returning a value");
+    }
+    return convert(std::move(*result),
+                   zeroOf(returnType, function->getLocation()),
+                   function->getLocation());
+  }
+  return Value();
+}
+
+Value ComptimeEvaluator::evalMember(const nodes::MemberExpressionNode *node) {
+  // Enum members, unless a variable hides the enum
+  auto object =
+      nodes::dyn_cast<nodes::IdentifierExpressionNode>(node->getObject());
+  if (object && !lookupLocal(object->getName()) &&
+      !globals_.count(object->getName())) {
+    auto member =
+        enumMembers_.find(object->getName() + "." + node->getMember());
+    if (member != enumMembers_.end()) {
+      return intValue(member->second);
+    }
+  }
+  if (node->getMember() == "length") {
+    Value temporary;
+    const Value *array = nullptr;
+    if (isPlace(node->getObject())) {
+      array = place(node->getObject(), false);
+    } else {
+      temporary = eval(node->getObject());
+      array = &temporary;
+    }
+    if (array->kind == Kind::Array) {
+      return intValue(static_cast<int64_t>(array->elements.size()));
+    }
+  }
+  fail(node->getLocation(), "Member '" + node->getMember() +
+                                "' cannot be evaluated at compile time");
+}
+
+bool ComptimeEvaluator::evalCondition(const nodes::ExpressionNode *node) {
+  Value value = eval(node);
+  if (value.kind != Kind::Bool) {
+    fail(node->getLocation(), "Condition is not a boolean");
+  }
+  return value.scalar.bool_value;
+}
+
+bool ComptimeEvaluator::isPlace(const nodes::ExpressionNode *node) {
+  while (auto index = nodes::dyn_cast<nodes::IndexExpressionNode>(node)) {
+    node = index->getArray();
+  }
+  return nodes::isa<nodes::IdentifierExpressionNode>(node);
+}
+
+Value *ComptimeEvaluator::place(const nodes::ExpressionNode *node,
+                                bool write) {
+  if (auto identifier =
+          nodes::dyn_cast<nodes::IdentifierExpressionNode>(node)) {
+    if (Value *local = lookupLocal(identifier->getName())) {
+      return local;
+    }
+    auto global = globals_.find(identifier->getName());
+    if (global == globals_.end()) {
+      fail(node->getLocation(), "'" + identifier->getName() +
+                                    "' cannot be evaluated at compile time");
+    }
+    if (write) {
+      fail(node->getLocation(), "Cannot assign global '" +
+                                    identifier->getName() +
+                                    "' at compile time");
+    }
+    evaluateGlobal(global->second);
+    return &values_[global->second];
+  }
+
+  auto index = nodes::dyn_cast<nodes::IndexExpressionNode>(node);
+  if (!index || !isPlace(index)) {
+    return nullptr;
+  }
+  // The index first: a call in it may move the locals
+  Value position = eval(index->getIndex());
+  Value *array = place(index->getArray(), write);
+  if (array->kind != Kind::Array || position.kind != Kind::Int) {
+    fail(node->getLocation(), "Invalid index at compile time");
+  }
+  int64_t i = position.scalar.int_value;
+  if (i < 0 || static_cast<size_t>(i) >= array->elements.size()) {
+    fail(node->getLocation(), "Index " + std::to_string(i) +
+                                  " is out of bounds at compile time");
+  }
+  return &array->elements[i];
+}
+
+void ComptimeEvaluator::releaseBodies() {
+  for (const nodes::FunctionDeclNode *function : loaded_) {
+    bodyStream_->release(function);
+  }
+  loaded_.clear();
+}
+
+Value *ComptimeEvaluator::lookupLocal(const std::string &name) {
+  for (size_t i = locals_.size(); i > frame_; --i) {
+    if (locals_[i - 1].first == name) {
+      return &locals_[i - 1].second;
+    }
+  }
+  return nullptr;
+}
+
+} // namespace visitors
@@ -0,0 +1,131 @@
+#pragma once
+#include "core/common/common_types.h"
+#include "parser/ast.h"
+#include "parser/body_stream.h"
+#include "parser/nodes/declaration_nodes.h"
+#include "parser/nodes/expression_nodes.h"
+#include "parser/nodes/statement_nodes.h"
+#include "parser/nodes/type_nodes.h"
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace visitors {
+
+/**
+ * @brief Runs the initializers of #comptime constants while compiling
+ *
+ * An AST interpreter over the checked program. It calls top-level
+ * functions, declares and assigns locals, indexes and assigns the elements
+ * of sized arrays, and runs if, while, do-while and for statements with
+ * break, continue and return. Values are int, float, boolean and sized
+ * arrays of them, and arithmetic matches the code generator's as the
+ * constant folder's does: int is 32 bits and wraps, int division
+ * truncates, float is single precision, and mixed arithmetic happens in
+ * float. Arrays are values, copied when passed, returned or assigned.
+ *
+ * Reading a global that is not const, dividing by zero, indexing out of
+ * bounds, or anything the interpreter does not know (objects, strings,
+ * pointers, methods, I/O) fails the evaluation with an error, as does
+ * running for more than a step budget, so a runaway loop stops the build
+ * instead of hanging it.
+ */
+class ComptimeEvaluator {
+public:
+  // A value of the interpreted program
+  struct Value {
+    enum class Kind { Int, Float, Bool, Array };
+    Kind kind = Kind::Int;
+    core::LiteralValue scalar;  // Unless an array
+    std::vector<Value> elements; // Of an array
+  };
+
+  // Statements and calls run before an evaluation gives up
+  static constexpr size_t kDefaultStepLimit = 10000000;
+  static constexpr size_t kMaxCallDepth = 1000;
+
+  explicit ComptimeEvaluator(size_t stepLimit = kDefaultStepLimit)
+      : stepLimit_(stepLimit) {}
+  ~ComptimeEvaluator() { releaseBodies(); }
+
+  /**
+   * @brief Loads the bodies of streamed functions from a stream when they
+   * are called, keeping them until the next module
+   */
+  void setBodyStream(parser::BodyStream *stream) { bodyStream_ = stream; }
+
+  /**
+   * @brief Records the functions, constants and enums of a module,
+   * forgetting those of the last one
+   */
+  void declareAST(const parser::AST &ast);
+
+  /**
+   * @brief Evaluates the initializer of a global constant, once
+   * @return Its value, converted to the declared type; nothing if the
+   *         evaluation failed, and getError() says why
+   */
+  std::optional<Value> evaluate(const nodes::VarDeclNode *node);
+
+  const core::Error &getError() const { return *error_; }
+
+private:
+  // Thrown to abandon an evaluation; error_ holds the reason
+  struct Failure {};
+
+  enum class Flow { Normal, Break, Continue, Return };
+
+  [[noreturn]] void fail(const core::SourceLocation &location,
+                         const std::string &message);
+  void step(const core::SourceLocation &location);
+
+  Value evaluateGlobal(const nodes::VarDeclNode *node);
+  Value zeroOf(const nodes::TypeNode *type, const core::SourceLocation &at);
+  Value convert(Value value, const Value &like,
+                const core::SourceLocation &at);
+
+  Flow execute(const nodes::StatementNode *node);
+  Flow executeBlock(const nodes::BlockNode *node);
+  Flow executeLoopBody(const nodes::StatementNode *body, bool &exit);
+  void declareLocal(const nodes::VarDeclNode *node);
+
+  Value eval(const nodes::ExpressionNode *node);
+  Value evalLiteral(const nodes::LiteralExpressionNode *node);
+  Value evalBinary(const nodes::BinaryExpressionNode *node);
+  Value evalUnary(const nodes::UnaryExpressionNode *node);
+  Value evalAssignment(const nodes::AssignmentExpressionNode *node);
+  Value evalCall(const nodes::CallExpressionNode *node);
+  Value evalMember(const nodes::MemberExpressionNode *node);
+  bool evalCondition(const nodes::ExpressionNode *node);
+
+  // The storage an identifier or an element of one names; writes reach
+  // locals only
+  static bool isPlace(const nodes::ExpressionNode *node);
+  Value *place(const nodes::ExpressionNode *node, bool write);
+  Value *lookupLocal(const std::string &name);
+  void releaseBodies();
+
+  parser::BodyStream *bodyStream_ = nullptr;
+  std::unordered_set<const nodes::FunctionDeclNode *> loaded_; // From it
+  size_t stepLimit_;
+  size_t steps_ = 0;
+  std::optional<core::Error> error_;
+
+  std::unordered_map<std::string, const nodes::FunctionDeclNode *> functions_;
+  std::unordered_map<std::string, const nodes::VarDeclNode *> globals_;
+  std::unordered_map<std::string, int64_t> enumMembers_; // "Enum.Member"
+  std::unordered_map<const nodes::VarDeclNode *, Value> values_;
+  std::vector<const nodes::VarDeclNode *> evaluating_; // Cycle detection
+
+  // Locals of every running call, innermost last; a call sees its own
+  std::vector<std::pair<std::string, Value>> locals_;
+  size_t frame_ = 0;
+  size_t depth_ = 0;
+  std::optional<Value> returned_;
+};
+
+} // namespace visitors
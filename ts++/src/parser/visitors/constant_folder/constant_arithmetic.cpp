@@ -0,0 +1,139 @@
+#include "constant_arithmetic.h"
+#include <climits>
+
+namespace visitors {
+
+using Kind = Constant::Kind;
+
+Constant intConstant(int64_t value) {
+  // Int arithmetic wraps around at 32 bits
+  return {Kind::Int, core::LiteralValue(static_cast<core::Int>(
+                         static_cast<uint32_t>(value)))};
+}
+
+Constant floatConstant(double value) {
+  return {Kind::Float, core::LiteralValue(static_cast<core::Float>(value))};
+}
+
+Constant boolConstant(bool value) {
+  return {Kind::Bool, core::LiteralValue(static_cast<core::Bool>(value))};
+}
+
+float asFloat(const Constant &constant) {
+  return constant.kind == Kind::Int
+             ? static_cast<float>(constant.value.int_value)
+             : constant.value.float_value;
+}
+
+std::optional<Constant> applyBinary(tokens::TokenType op, const Constant &left,
+                                    const Constant &right,
+                                    ArithmeticError &error) {
+  if (left.kind == Kind::Bool || right.kind == Kind::Bool) {
+    bool a = left.value.bool_value;
+    bool b = right.value.bool_value;
+    if (left.kind == right.kind && op == tokens::TokenType::EQUALS_EQUALS) {
+      return boolConstant(a == b);
+    }
+    if (left.kind == right.kind && op == tokens::TokenType::EXCLAIM_EQUALS) {
+      return boolConstant(a != b);
+    }
+    error = ArithmeticError::Operands;
+    return std::nullopt;
+  }
+
+  if (left.kind == Kind::Int && right.kind == Kind::Int) {
+    int64_t a = left.value.int_value;
+    int64_t b = right.value.int_value;
+    switch (op) {
+    case tokens::TokenType::PLUS:
+      return intConstant(a + b);
+    case tokens::TokenType::MINUS:
+      return intConstant(a - b);
+    case tokens::TokenType::STAR:
+      return intConstant(a * b);
+    case tokens::TokenType::SLASH:
+    case tokens::TokenType::PERCENT:
+      // Both trap at run time
+      if (b == 0) {
+        error = ArithmeticError::DivisionByZero;
+        return std::nullopt;
+      }
+      if (a == INT_MIN && b == -1) {
+        error = ArithmeticError::Overflow;
+        return std::nullopt;
+      }
+      return intConstant(op == tokens::TokenType::SLASH ? a / b : a % b);
+    case tokens::TokenType::EQUALS_EQUALS:
+      return boolConstant(a == b);
+    case tokens::TokenType::EXCLAIM_EQUALS:
+      return boolConstant(a != b);
+    case tokens::TokenType::LESS:
+      return boolConstant(a < b);
+    case tokens::TokenType::GREATER:
+      return boolConstant(a > b);
+    case tokens::TokenType::LESS_EQUALS:
+      return boolConstant(a <= b);
+    case tokens::TokenType::GREATER_EQUALS:
+      return boolConstant(a >= b);
+    default:
+      error = ArithmeticError::Operator;
+      return std::nullopt;
+    }
+  }
+
+  float a = asFloat(left);
+  float b = asFloat(right);
+  switch (op) {
+  case tokens::TokenType::PLUS:
+    return floatConstant(a + b);
+  case tokens::TokenType::MINUS:
+    return floatConstant(a - b);
+  case tokens::TokenType::STAR:
+    return floatConstant(a * b);
+  case tokens::TokenType::SLASH:
+    return floatConstant(a / b);
+  case tokens::TokenType::EQUALS_EQUALS:
+    return boolConstant(a == b);
+  case tokens::TokenType::EXCLAIM_EQUALS:
+    return boolConstant(a < b || a > b);
+  case tokens::TokenType::LESS:
+    return boolConstant(a < b);
+  case tokens::TokenType::GREATER:
+    return boolConstant(a > b);
+  case tokens::TokenType::LESS_EQUALS:
+    return boolConstant(a <= b);
+  case tokens::TokenType::GREATER_EQUALS:
+    return boolConstant(a >= b);
+  default:
+    error = ArithmeticError::Operator;
+    return std::nullopt;
+  }
+}
+
+std::optional<Constant> applyUnary(tokens::TokenType op,
+                                   const Constant &operand) {
+  switch (op) {
+  case tokens::TokenType::PLUS:
+    if (operand.kind != Kind::Bool) {
+      return operand;
+    }
+    return std::nullopt;
+  case tokens::TokenType::MINUS:
+    if (operand.kind == Kind::Int) {
+      return intConstant(-static_cast<int64_t>(operand.value.int_value));
+    }
+    if (operand.kind == Kind::Float) {
+      return floatConstant(-operand.value.float_value);
+    }
+    return std::nullopt;
+  case tokens::TokenType::EXCLAIM:
+    if (operand.kind == Kind::Bool) {
+      return boolConstant(!operand.value.bool_value);
+    }
+    return std::nullopt;
+  default:
+    return std::nullopt;
+  }
+}
+
+} // namespace visitors
@@ -0,0 +1,55 @@
+#pragma once
+#include "core/common/common_types.h"
+#include "tokens/token_type.h"
+#include <cstdint>
+#include <optional>
+
+namespace visitors {
+
+/**
+ * @brief An int, float or bool known while compiling, and the type it has
+ * in the generated code
+ */
+struct Constant {
+  enum class Kind { Int, Float, Bool };
+  Kind kind;
+  core::LiteralValue value;
+};
+
+/// Why an operator has no constant result
+enum class ArithmeticError {
+  Operands,       ///< Bool mixed with a number, or an operator bools lack
+  Operator,       ///< The operator has no constant form
+  DivisionByZero, ///< Int division or remainder by zero, which traps
+  Overflow        ///< INT_MIN / -1, which traps too
+};
+
+Constant intConstant(int64_t value);
+Constant floatConstant(double value);
+Constant boolConstant(bool value);
+
+/// An int widened to float the way mixed arithmetic widens it
+float asFloat(const Constant &constant);
+
+/**
+ * @brief Applies a binary operator the way the generated code does
+ *
+ * int is 32 bits and wraps, int division truncates, float is single
+ * precision, mixed arithmetic happens in float, and float comparisons are
+ * ordered, so they are all false for NaN. The constant folder and the
+ * #comptime evaluator both use it, so they cannot disagree.
+ *
+ * @param error Set to the reason when there is no result
+ */
+std::optional<Constant> applyBinary(tokens::TokenType op, const Constant &left,
+                                    const Constant &right,
+                                    ArithmeticError &error);
+
+/**
+ * @brief Applies a unary +, - or ! the way the generated code does
+ * @return Nothing if the operand's kind has no such operator
+ */
+std::optional<Constant> applyUnary(tokens::TokenType op,
+                                   const Constant &operand);
+
+} // namespace visitors
@@ -0,0 +1,591 @@
+#include "constant_folder.h"
+#include "parser/visitors/type_check_visitor/resolved_type.h"
+#include <climits>
+#include <cstdlib>
+
+namespace visitors {
+
+namespace {
+
+using Constant = ConstantFolder::Constant;
+using Kind = Constant::Kind;
+
+// The kind a checked type has in the generated code, if it can be folded
+std::optional<Kind> kindOf(const nodes::ExpressionNode *node) {
+  const auto &type = node->getResolvedType();
+  if (!type) {
+    return std::nullopt;
+  }
+  switch (type->getKind()) {
+  case ResolvedType::TypeKind::Int:
+    return Kind::Int;
+  case ResolvedType::TypeKind::Float:
+    return Kind::Float;
+  case ResolvedType::TypeKind::Bool:
+    return Kind::Bool;
+  default:
+    return std::nullopt;
+  }
+}
+
+// The kind a declared type stores, if it is int, float or boolean
+std::optional<Kind> kindOf(const nodes::TypeNode *type) {
+  auto primitive = nodes::dyn_cast<nodes::PrimitiveTypeNode>(type);
+  if (!primitive || primitive->isVector()) {
+    return std::nullopt;
+  }
+  switch (primitive->getType()) {
+  case tokens::TokenType::INT:
+    return Kind::Int;
+  case tokens::TokenType::FLOAT:
+    return Kind::Float;
+  case tokens::TokenType::BOOLEAN:
+    return Kind::Bool;
+  default:
+    return std::nullopt;
+  }
+}
+
+} // namespace
+
+ConstantFolder::ConstantFolder(core::ErrorReporter &errorReporter,
+                               Globals *globals)
+    : errorReporter_(errorReporter), globals_(globals) {}
+
+void ConstantFolder::declareAST(const parser::AST &ast) {
+  for (const auto &node : ast.getNodes()) {
+    if (auto var = nodes::dyn_cast<nodes::VarDeclNode>(node)) {
+      globals_->names[var->getName()] = bindingOf(var);
+    } else if (auto enumDecl = nodes::dyn_cast<nodes::EnumDeclNode>(node)) {
+      for (const auto *member : enumDecl->getMembers()) {
+        globals_->enumMembers[enumDecl->getName() + "." + member->getName()] =
+            member->getConstantValue();
+      }
+    } else if (auto ns = nodes::dyn_cast<nodes::NamespaceDeclNode>(node)) {
+      // Enums are known by their own name wherever they are declared
+      for (const auto *decl : ns->getDeclarations()) {
+        if (auto enumDecl = nodes::dyn_cast<nodes::EnumDeclNode>(decl)) {
+          for (const auto *member : enumDecl->getMembers()) {
+            globals_->enumMembers[enumDecl->getName() + "." +
+                                  member->getName()] =
+                member->getConstantValue();
+          }
+        }
+      }
+    } else if (auto decl = nodes::dyn_cast<nodes::DeclarationNode>(node)) {
+      if (!nodes::isa<nodes::EnumDeclNode>(decl)) {
+        globals_->names.emplace(decl->getName(), Binding());
+      }
+    }
+  }
+}
+
+bool ConstantFolder::foldDefinitions(
+    const parser::AST &ast,
+    const std::unordered_set<const nodes::BaseNode *> &skip) {
+  for (const auto &node : ast.getNodes()) {
+    const nodes::BaseNode *declaration = node;
+    if (auto stmt = nodes::dyn_cast<nodes::DeclarationStmtNode>(node)) {
+      declaration = stmt->getDeclaration();
+    }
+    // Global variables were folded as they were declared
+    if (skip.count(declaration) || nodes::isa<nodes::VarDeclNode>(node)) {
+      continue;
+    }
+    foldNode(node);
+  }
+  return !errorReporter_.hasErrors();
+}
+
+bool ConstantFolder::foldDefinition(const nodes::BaseNode *node) {
+  foldNode(node);
+  return !errorReporter_.hasErrors();
+}
+
+void ConstantFolder::declare(const std::string &name, Binding binding) {
+  locals_.emplace_back(name, binding);
+}
+
+ConstantFolder::Binding
+ConstantFolder::bindingOf(const nodes::VarDeclNode *node) {
+  foldType(node->getType());
+  std::optional<Constant> value = fold(node->getInitializer());
+  std::optional<Kind> kind = kindOf(node->getType());
+  if (!node->isConst() || !value) {
+    value.reset();
+  } else if (kind == Kind::Float && value->kind == Kind::Int) {
+    value = floatConstant(asFloat(*value));
+  } else if (node->getType() && kind != value->kind) {
+    value.reset();
+  }
+  return {node->isConst(), value};
+}
+
+const ConstantFolder::Binding *
+ConstantFolder::lookup(const std::string &name) const {
+  for (auto it = locals_.rbegin(); it != locals_.rend(); ++it) {
+    if (it->first == name) {
+      return &it->second;
+    }
+  }
+  auto global = globals_->names.find(name);
+  return global != globals_->names.end() ? &global->second : nullptr;
+}
+
+void ConstantFolder::foldNode(const nodes::BaseNode *node) {
+  if (!node) {
+    return;
+  }
+  if (auto stmt = nodes::dyn_cast<nodes::StatementNode>(node)) {
+    foldStatement(stmt);
+  } else if (auto decl = nodes::dyn_cast<nodes::DeclarationNode>(node)) {
+    foldDeclaration(decl);
+  } else if (auto expr = nodes::dyn_cast<nodes::ExpressionNode>(node)) {
+    fold(expr);
+  }
+}
+
+void ConstantFolder::foldStatement(const nodes::StatementNode *node) {
+  using namespace nodes;
+  switch (node->getNodeKind()) {
+  case NodeKind::DeclarationStmt:
+    foldDeclaration(cast<DeclarationStmtNode>(node)->getDeclaration());
+    break;
+  case NodeKind::Block: {
+    size_t scope = mark();
+    for (const auto &stmt : cast<BlockNode>(node)->getStatements()) {
+      foldNode(stmt);
+    }
+    restore(scope);
+    break;
+  }
+  case NodeKind::ExpressionStmt:
+    fold(cast<ExpressionStmtNode>(node)->getExpression());
+    break;
+  case NodeKind::IfStmt: {
+    auto ifStmt = cast<IfStmtNode>(node);
+    fold(ifStmt->getCondition());
+    foldNode(ifStmt->getThenBranch());
+    foldNode(ifStmt->getElseBranch());
+    break;
+  }
+  case NodeKind::WhileStmt: {
+    auto whileStmt = cast<WhileStmtNode>(node);
+    fold(whileStmt->getCondition());
+    foldNode(whileStmt->getBody());
+    break;
+  }
+  case NodeKind::DoWhileStmt: {
+    auto doWhile = cast<DoWhileStmtNode>(node);
+    foldNode(doWhile->getBody());
+    fold(doWhile->getCondition());
+    break;
+  }
+  case NodeKind::ForStmt: {
+    auto forStmt = cast<ForStmtNode>(node);
+    size_t scope = mark();
+    foldNode(forStmt->getInitializer());
+    fold(forStmt->getCondition());
+    fold(forStmt->getIncrement());
+    foldNode(forStmt->getBody());
+    restore(scope);
+    break;
+  }
+  case NodeKind::ForOfStmt: {
+    auto forOf = cast<ForOfStmtNode>(node);
+    fold(forOf->getIterable());
+    size_t scope = mark();
+    declare(forOf->getIdentifier());
+    foldNode(forOf->getBody());
+    restore(scope);
+    break;
+  }
+  case NodeKind::ReturnStmt:
+    fold(cast<ReturnStmtNode>(node)->getValue());
+    break;
+  case NodeKind::ThrowStmt:
+    fold(cast<ThrowStmtNode>(node)->getValue());
+    break;
+  case NodeKind::AssemblyStmt: {
+    auto assembly = cast<AssemblyStmtNode>(node);
+    for (const auto &output : assembly->getOutputs()) {
+      foldTarget(output.expression, "assign to");
+    }
+    for (const auto &input : assembly->getInputs()) {
+      fold(input.expression);
+    }
+    break;
+  }
+  case NodeKind::TryStmt: {
+    auto tryStmt = cast<TryStmtNode>(node);
+    foldNode(tryStmt->getTryBlock());
+    for (const auto &clause : tryStmt->getCatchClauses()) {
+      size_t scope = mark();
+      declare(clause.parameter);
+      foldNode(clause.body);
+      restore(scope);
+    }
+    foldNode(tryStmt->getFinallyBlock());
+    break;
+  }
+  case NodeKind::SwitchStmt: {
+    auto switchStmt = cast<SwitchStmtNode>(node);
+    fold(switchStmt->getExpression());
+    size_t scope = mark();
+    for (const auto &switchCase : switchStmt->getCases()) {
+      fold(switchCase.value);
+      for (const auto &stmt : switchCase.body) {
+        foldNode(stmt);
+      }
+    }
+    restore(scope);
+    break;
+  }
+  case NodeKind::LabeledStatement:
+    foldNode(cast<LabeledStatementNode>(node)->getStatement());
+    break;
+  default:
+    break;
+  }
+}
+
+void ConstantFolder::foldDeclaration(const nodes::DeclarationNode *node) {
+  using namespace nodes;
+  if (!node) {
+    return;
+  }
+  switch (node->getNodeKind()) {
+  case NodeKind::VarDecl:
+    declare(node->getName(), bindingOf(cast<VarDeclNode>(node)));
+    break;
+  case NodeKind::FunctionDecl:
+  case NodeKind::GenericFunctionDecl: {
+    auto function = cast<FunctionDeclNode>(node);
+    declare(function->getName());
+    foldFunction(function->getParameters(), function->getReturnType(),
+                 function->getBody());
+    break;
+  }
+  case NodeKind::ClassDecl:
+  case NodeKind::GenericClassDecl:
+    declare(node->getName());
+    foldClass(cast<ClassDeclNode>(node));
+    break;
+  case NodeKind::NamespaceDecl: {
+    // The members of a namespace are not folded by name
+    size_t scope = mark();
+    auto ns = cast<NamespaceDeclNode>(node);
+    for (const auto *decl : ns->getDeclarations()) {
+      if (!isa<EnumDeclNode>(decl)) {
+        declare(decl->getName());
+      }
+    }
+    for (const auto *decl : ns->getDeclarations()) {
+      if (auto var = dyn_cast<VarDeclNode>(decl)) {
+        foldType(var->getType());
+        fold(var->getInitializer());
+      } else {
+        foldDeclaration(decl);
+      }
+    }
+    restore(scope);
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+void ConstantFolder::foldFunction(const std::vector<nodes::ParamPtr> &params,
+                                  const nodes::TypeNode *returnType,
+                                  const nodes::BlockNode *body) {
+  size_t scope = mark();
+  for (const auto *param : params) {
+    foldType(param->getType());
+    fold(param->getDefaultValue());
+    declare(param->getName());
+  }
+  foldType(returnType);
+  foldNode(body);
+  restore(scope);
+}
+
+void ConstantFolder::foldClass(const nodes::ClassDeclNode *node) {
+  using namespace nodes;
+  // Fields are in scope in every method, whatever their initializer
+  size_t scope = mark();
+  for (const auto *member : node->getMembers()) {
+    if (auto field = dyn_cast<FieldDeclNode>(member)) {
+      declare(field->getName());
+    }
+  }
+  for (const auto *member : node->getMembers()) {
+    switch (member->getNodeKind()) {
+    case NodeKind::FieldDecl: {
+      auto field = cast<FieldDeclNode>(member);
+      foldType(field->getType());
+      fold(field->getInitializer());
+      break;
+    }
+    case NodeKind::ConstructorDecl: {
+      auto constructor = cast<ConstructorDeclNode>(member);
+      foldFunction(constructor->getParameters(), nullptr,
+                   constructor->getBody());
+      break;
+    }
+    case NodeKind::MethodDecl: {
+      auto method = cast<MethodDeclNode>(member);
+      foldFunction(method->getParameters(), method->getReturnType(),
+                   method->getBody());
+      break;
+    }
+    case NodeKind::PropertyDecl: {
+      // A setter's argument is named value
+      auto property = cast<PropertyDeclNode>(member);
+      size_t accessor = mark();
+      declare("value");
+      foldType(property->getPropertyType());
+      foldNode(property->getBody());
+      restore(accessor);
+      break;
+    }
+    default:
+      foldDeclaration(member);
+      break;
+    }
+  }
+  restore(scope);
+}
+
+void ConstantFolder::foldType(const nodes::TypeNode *type) {
+  using namespace nodes;
+  while (type) {
+    if (auto array = dyn_cast<ArrayTypeNode>(type)) {
+      // Sizes are not type-checked, so they are folded by their own value
+      const ExpressionNode *size = array->getSize();
+      std::optional<Constant> value = fold(size);
+      if (value && value->kind == Kind::Int && value->value.int_value >= 0) {
+        size->setFoldedValue(value->value);
+      } else if (size) {
+        size->clearFoldedValue();
+      }
+      type = array->getElementType();
+    } else if (auto pointer = dyn_cast<PointerTypeNode>(type)) {
+      type = pointer->getBaseType();
+    } else if (auto reference = dyn_cast<ReferenceTypeNode>(type)) {
+      type = reference->getBaseType();
+    } else if (auto smart = dyn_cast<SmartPointerTypeNode>(type)) {
+      type = smart->getPointeeType();
+    } else if (auto atomic = dyn_cast<AtomicTypeNode>(type)) {
+      type = atomic->getValueType();
+    } else {
+      return;
+    }
+  }
+}
+
+std::optional<Constant>
+ConstantFolder::fold(const nodes::ExpressionNode *node) {
+  if (!node) {
+    return std::nullopt;
+  }
+  // A node checked again may have lost a value it had before
+  std::optional<Constant> value = foldKind(node);
+  if (value && kindOf(node) == value->kind) {
+    node->setFoldedValue(value->value);
+  } else {
+    node->clearFoldedValue();
+  }
+  return value;
+}
+
+std::optional<Constant>
+ConstantFolder::foldKind(const nodes::ExpressionNode *node) {
+  using namespace nodes;
+  switch (node->getNodeKind()) {
+  case NodeKind::LiteralExpression:
+    return foldLiteral(cast<LiteralExpressionNode>(node));
+  case NodeKind::IdentifierExpression:
+    return foldIdentifier(cast<IdentifierExpressionNode>(node));
+  case NodeKind::BinaryExpression:
+    return foldBinary(cast<BinaryExpressionNode>(node));
+  case NodeKind::UnaryExpression:
+    return foldUnary(cast<UnaryExpressionNode>(node));
+  case NodeKind::MemberExpression: {
+    auto member = cast<MemberExpressionNode>(node);
+    if (std::optional<Constant> value = foldEnumMember(member)) {
+      return value;
+    }
+    fold(member->getObject());
+    return std::nullopt;
+  }
+  case NodeKind::CompileTimeExpression: {
+    // #const has the value of its operand; #sizeof and #alignof depend on
+    // the target, and #typeof is not a number
+    auto compileTime = cast<CompileTimeExpressionNode>(node);
+    std::optional<Constant> value = fold(compileTime->getOperand());
+    return compileTime->getExpressionType() == tokens::TokenType::CONST_EXPR
+               ? value
+               : std::nullopt;
+  }
+  case NodeKind::ConditionalExpression: {
+    auto conditional = cast<ConditionalExpressionNode>(node);
+    std::optional<Constant> condition = fold(conditional->getCondition());
+    std::optional<Constant> whenTrue = fold(conditional->getTrueExpression());
+    std::optional<Constant> whenFalse =
+        fold(conditional->getFalseExpression());
+    if (!condition || condition->kind != Kind::Bool) {
+      return std::nullopt;
+    }
+    return condition->value.bool_value ? whenTrue : whenFalse;
+  }
+  case NodeKind::AssignmentExpression: {
+    auto assignment = cast<AssignmentExpressionNode>(node);
+    foldTarget(assignment->getTarget(), "assign to");
+    fold(assignment->getValue());
+    return std::nullopt;
+  }
+  case NodeKind::ArrayLiteral:
+    for (const auto &element : cast<ArrayLiteralNode>(node)->getElements()) {
+      fold(element);
+    }
+    return std::nullopt;
+  case NodeKind::CallExpression: {
+    auto call = cast<CallExpressionNode>(node);
+    fold(call->getCallee());
+    for (const auto &arg : call->getArguments()) {
+      fold(arg);
+    }
+    return std::nullopt;
+  }
+  case NodeKind::IndexExpression: {
+    auto index = cast<IndexExpressionNode>(node);
+    fold(index->getArray());
+    fold(index->getIndex());
+    return std::nullopt;
+  }
+  case NodeKind::NewExpression:
+    for (const auto &arg : cast<NewExpressionNode>(node)->getArguments()) {
+      fold(arg);
+    }
+    return std::nullopt;
+  case NodeKind::CastExpression:
+    fold(cast<CastExpressionNode>(node)->getExpression());
+    return std::nullopt;
+  case NodeKind::PointerExpression:
+    // A pointer is taken to the variable, not to its value
+    foldTarget(cast<PointerExpressionNode>(node)->getOperand(), nullptr);
+    return std::nullopt;
+  case NodeKind::FunctionExpression: {
+    auto function = cast<FunctionExpressionNode>(node);
+    foldFunction(function->getParameters(), function->getReturnType(),
+                 function->getBody());
+    return std::nullopt;
+  }
+  default:
+    return std::nullopt;
+  }
+}
+
+std::optional<Constant>
+ConstantFolder::foldLiteral(const nodes::LiteralExpressionNode *node) {
+  switch (node->getExpressionType()) {
+  case tokens::TokenType::NUMBER: {
+    // A fraction or exponent makes a float literal, as in the checker
+    const tokens::NumberValue &number = node->getNumber();
+    if (number.isFloat()) {
+      return floatConstant(number.real);
+    }
+    if (!number.isInteger() || number.integer > INT_MAX) {
+      return std::nullopt;
+    }
+    return intConstant(static_cast<long long>(number.integer));
+  }
+  case tokens::TokenType::TRUE:
+    return boolConstant(true);
+  case tokens::TokenType::FALSE:
+    return boolConstant(false);
+  default:
+    return std::nullopt;
+  }
+}
+
+std::optional<Constant>
+ConstantFolder::foldIdentifier(const nodes::IdentifierExpressionNode *node) {
+  const Binding *binding = lookup(node->getName());
+  return binding ? binding->value : std::nullopt;
+}
+
+std::optional<Constant>
+ConstantFolder::foldEnumMember(const nodes::MemberExpressionNode *node) {
+  auto object =
+      nodes::dyn_cast<nodes::IdentifierExpressionNode>(node->getObject());
+  // Variables hide the enum's name, as in code generation
+  if (!object || lookup(object->getName())) {
+    return std::nullopt;
+  }
+  auto it = globals_->enumMembers.find(object->getName() + "." +
+                                       node->getMember());
+  if (it == globals_->enumMembers.end()) {
+    return std::nullopt;
+  }
+  return intConstant(it->second);
+}
+
+std::optional<Constant>
+ConstantFolder::foldBinary(const nodes::BinaryExpressionNode *node) {
+  std::optional<Constant> left = fold(node->getLeft());
+  std::optional<Constant> right = fold(node->getRight());
+  if (!left || !right) {
+    return std::nullopt;
+  }
+
+  // What would trap or has no constant form is left to run time
+  ArithmeticError error;
+  return applyBinary(node->getExpressionType(), *left, *right, error);
+}
+
+std::optional<Constant>
+ConstantFolder::foldUnary(const nodes::UnaryExpressionNode *node) {
+  tokens::TokenType op = node->getExpressionType();
+  if (op == tokens::TokenType::PLUS_PLUS ||
+      op == tokens::TokenType::MINUS_MINUS) {
+    foldTarget(node->getOperand(), "modify");
+    return std::nullopt;
+  }
+
+  std::optional<Constant> operand = fold(node->getOperand());
+  if (!operand) {
+    return std::nullopt;
+  }
+  return applyUnary(op, *operand);
+}
+
+void ConstantFolder::foldTarget(const nodes::ExpressionNode *target,
+                                const char *action) {
+  auto variable = nodes::dyn_cast<nodes::IdentifierExpressionNode>(
+      target);
+  if (!variable) {
+    // Only the subexpressions of a member or element are values
+    if (auto member =
+            nodes::dyn_cast<nodes::MemberExpressionNode>(target)) {
+      fold(member->getObject());
+    } else if (auto index =
+                   nodes::dyn_cast<nodes::IndexExpressionNode>(
+                       target)) {
+      fold(index->getArray());
+      fold(index->getIndex());
+    } else {
+      fold(target);
+    }
+    return;
+  }
+  const Binding *binding = lookup(variable->getName());
+  if (action && binding && binding->isConst) {
+    errorReporter_.error(variable->getLocation(),
+                         std::string("Cannot ") + action + " constant '" +
+                             variable->getName() + "'");
+  }
+}
+
+} // namespace visitors
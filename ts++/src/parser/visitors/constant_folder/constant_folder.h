@@ -0,0 +1,108 @@
+#pragma once
+#include "constant_arithmetic.h"
+#include "core/common/common_types.h"
+#include "core/diagnostics/error_reporter.h"
+#include "parser/ast.h"
+#include "parser/nodes/declaration_nodes.h"
+#include "parser/nodes/expression_nodes.h"
+#include "parser/nodes/statement_nodes.h"
+#include "parser/nodes/type_nodes.h"
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace visitors {
+
+/**
+ * @brief Folds the constant expressions of a type-checked AST
+ *
+ * Literals, const variables with constant initializers, enum members and
+ * the arithmetic, comparisons and negations of them are evaluated the way
+ * the code generator would evaluate them at run time: int is 32 bits and
+ * wraps, int division truncates, float is single precision, and mixed
+ * arithmetic happens in float. An expression whose checked type is the
+ * int, float or bool it evaluates to is annotated with its value, which
+ * the code generator emits as an immediate instead of the loads and
+ * instructions it would otherwise emit even at -O0. Sizes of array types
+ * are folded too, so int[N] has an inline size when N is a constant.
+ *
+ * Division by zero, and whatever else would trap or has no single result,
+ * is left to run time. Since a const must never change for its uses to be
+ * replaced by its value, assigning to a const, or incrementing it, is an
+ * error.
+ */
+class ConstantFolder {
+public:
+  // A folded value and the type it has in the generated code
+  using Constant = visitors::Constant;
+
+  // What a name stands for; any binding hides an enum of that name
+  struct Binding {
+    bool isConst = false;
+    std::optional<Constant> value; // If const with a constant initializer
+  };
+
+  // The top-level names of a program
+  struct Globals {
+    std::unordered_map<std::string, Binding> names;
+    std::unordered_map<std::string, int64_t> enumMembers; // "Enum.Member"
+  };
+
+  ConstantFolder(core::ErrorReporter &errorReporter, Globals *globals);
+
+  // The two halves of folding, as for type checking. declareAST folds the
+  // initializers of global variables and records enum members; it runs
+  // once over every file, in order. foldDefinitions folds the rest of a
+  // file, reading the globals only, so the files of a program may be
+  // folded at once. Definitions in skip are left out.
+  void declareAST(const parser::AST &ast);
+  bool foldDefinitions(
+      const parser::AST &ast,
+      const std::unordered_set<const nodes::BaseNode *> &skip = {});
+
+  // Folds one definition foldDefinitions left out, such as a function
+  // whose body was only parsed later
+  bool foldDefinition(const nodes::BaseNode *node);
+
+private:
+  // Locals hide globals and enclosing locals from where they are declared
+  void declare(const std::string &name, Binding binding);
+  void declare(const std::string &name) { declare(name, Binding()); }
+  Binding bindingOf(const nodes::VarDeclNode *node);
+  size_t mark() const { return locals_.size(); }
+  void restore(size_t mark) { locals_.resize(mark); }
+  const Binding *lookup(const std::string &name) const;
+
+  void foldNode(const nodes::BaseNode *node);
+  void foldStatement(const nodes::StatementNode *node);
+  void foldDeclaration(const nodes::DeclarationNode *node);
+  void foldFunction(const std::vector<nodes::ParamPtr> &params,
+                    const nodes::TypeNode *returnType,
+                    const nodes::BlockNode *body);
+  void foldClass(const nodes::ClassDeclNode *node);
+  void foldType(const nodes::TypeNode *type);
+
+  // Folds the subexpressions of an expression and returns its value
+  std::optional<Constant> fold(const nodes::ExpressionNode *node);
+  std::optional<Constant> foldKind(const nodes::ExpressionNode *node);
+  std::optional<Constant> foldLiteral(const nodes::LiteralExpressionNode *node);
+  std::optional<Constant>
+  foldIdentifier(const nodes::IdentifierExpressionNode *node);
+  std::optional<Constant>
+  foldEnumMember(const nodes::MemberExpressionNode *node);
+  std::optional<Constant> foldBinary(const nodes::BinaryExpressionNode *node);
+  std::optional<Constant> foldUnary(const nodes::UnaryExpressionNode *node);
+
+  // Folds what is stored to, which is not a value itself
+  void foldTarget(const nodes::ExpressionNode *target, const char *action);
+
+  core::ErrorReporter &errorReporter_;
+  Globals *globals_;
+  std::vector<std::pair<std::string, Binding>> locals_;
+};
+
+} // namespace visitors
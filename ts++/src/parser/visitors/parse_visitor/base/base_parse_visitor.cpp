@@ -6,19 +6,20 @@
 namespace visitors {
 
 BaseParseVisitor::BaseParseVisitor(tokens::TokenStream &tokens,
-                                   core::ErrorReporter &errorReporter)
-    : tokens_(tokens), errorReporter_(errorReporter) {
+                                   core::ErrorReporter &errorReporter,
+                                   parser::ASTContext &context)
+    : tokens_(tokens), errorReporter_(errorReporter), context_(context) {
   // Initialize in the correct order
   expressionVisitor_ =
-      std::make_unique<ExpressionParseVisitor>(tokens, errorReporter);
+      std::make_unique<ExpressionParseVisitor>(tokens, errorReporter, context);
 
   // Create statement visitor with expression visitor
   statementVisitor_ = std::make_unique<StatementParseVisitor>(
-      tokens, errorReporter, *expressionVisitor_);
+      tokens, errorReporter, context, *expressionVisitor_);
 
   // Create declaration visitor
   declarationVisitor_ = std::make_unique<DeclarationParseVisitor>(
-      tokens, errorReporter, *expressionVisitor_, *statementVisitor_);
+      tokens, errorReporter, context, *expressionVisitor_, *statementVisitor_);
 
   // Now set the declaration visitor on the statement visitor
   statementVisitor_->setDeclarationVisitor(declarationVisitor_.get());
@@ -62,6 +63,20 @@ bool BaseParseVisitor::visitParse() {
   }
 }
 
+nodes::BlockPtr BaseParseVisitor::parseBody() {
+  if (!tokens_.check(tokens::TokenType::LEFT_BRACE)) {
+    error("Expected '{' before function body");
+    return nullptr;
+  }
+  tokens_.advance();
+  nodes::BlockPtr body = statementVisitor_->parseBlock();
+  if (body && !tokens_.isAtEnd()) {
+    error("Unexpected token after function body");
+    return nullptr;
+  }
+  return body;
+}
+
 nodes::NodePtr BaseParseVisitor::parseDeclaration() {
   return declarationVisitor_->parseDeclaration();
 }
@@ -71,27 +86,22 @@ nodes::NodePtr BaseParseVisitor::parseStatement() {
 }
 
 bool BaseParseVisitor::isDeclarationStart() const {
-  return tokens_.check(tokens::TokenType::STACK) ||
-         tokens_.check(tokens::TokenType::HEAP) ||
-         tokens_.check(tokens::TokenType::STATIC) ||
-         tokens_.check(tokens::TokenType::PACKED) ||
-         tokens_.check(tokens::TokenType::ALIGNED) ||
-         tokens_.check(tokens::TokenType::ABSTRACT) ||
-         tokens_.check(tokens::TokenType::ATTRIBUTE) ||
-         tokens_.check(tokens::TokenType::LET) ||
-         tokens_.check(tokens::TokenType::CONST) ||
-         (tokens_.check(tokens::TokenType::FUNCTION) &&
-          tokens_.peek().getType() == tokens::TokenType::IDENTIFIER) ||
-         tokens_.check(tokens::TokenType::CLASS) ||
-         tokens_.check(tokens::TokenType::PUBLIC) ||
-         tokens_.check(tokens::TokenType::PRIVATE) ||
-         tokens_.check(tokens::TokenType::PROTECTED) ||
-         tokens_.check(tokens::TokenType::INTERFACE) ||
-         tokens_.check(tokens::TokenType::ENUM) ||
-         tokens_.check(tokens::TokenType::NAMESPACE) ||
-         tokens_.check(tokens::TokenType::TYPEDEF) ||
-         tokens_.check(tokens::TokenType::ZEROCAST) ||
-         tokens::isFunctionModifier(tokens_.peek().getType());
+  using tokens::TokenType;
+  // Functions take the statement path, which wraps them in a statement
+  static constexpr tokens::TokenSet kDeclarationStart =
+      tokens::TokenSet{TokenType::STACK,     TokenType::HEAP,
+                       TokenType::STATIC,    TokenType::PACKED,
+                       TokenType::ALIGNED,   TokenType::ABSTRACT,
+                       TokenType::ATTRIBUTE, TokenType::LET,
+                       TokenType::CONST,     TokenType::CLASS,
+                       TokenType::PUBLIC,    TokenType::PRIVATE,
+                       TokenType::PROTECTED, TokenType::INTERFACE,
+                       TokenType::ENUM,      TokenType::NAMESPACE,
+                       TokenType::TYPEDEF,   TokenType::ZEROCAST,
+                       TokenType::SOA,       TokenType::COMPTIME} |
+      tokens::TokenSet::range(TokenType::FUNC_MOD_BEGIN,
+                              TokenType::FUNC_MOD_END);
+  return tokens_.checkAny(kDeclarationStart);
 }
 
 void BaseParseVisitor::synchronize() {
@@ -105,6 +115,7 @@ void BaseParseVisitor::synchronize() {
     switch (tokens_.peek().getType()) {
     case tokens::TokenType::CLASS:
     case tokens::TokenType::FUNCTION:
+    case tokens::TokenType::ASYNC:
     case tokens::TokenType::LET:
     case tokens::TokenType::CONST:
     case tokens::TokenType::IF:
@@ -1,5 +1,6 @@
 #pragma once
 #include "core/diagnostics/error_reporter.h"
+#include "parser/ast_context.h"
 #include "parser/interfaces/base_interface.h"
 #include "parser/visitors/parse_visitor/declaration/declaration_parse_visitor.h"
 #include "parser/visitors/parse_visitor/expression/expression_parse_visitor.h"
@@ -13,7 +14,8 @@ namespace visitors {
 class BaseParseVisitor : public interface::BaseInterface {
 public:
   explicit BaseParseVisitor(tokens::TokenStream &tokens,
-                            core::ErrorReporter &errorReporter);
+                            core::ErrorReporter &errorReporter,
+                            parser::ASTContext &context);
   ~BaseParseVisitor() override = default;
 
   // Main parse entry point
@@ -22,6 +24,14 @@ public:
   // Access parsed nodes
   const std::vector<nodes::NodePtr> &getNodes() const { return nodes_; }
 
+  // Skip function and method bodies, recording their source ranges
+  void setDeferBodies(bool defer) {
+    declarationVisitor_->setDeferBodies(defer);
+  }
+
+  // Parse a deferred body: a block and nothing after it
+  nodes::BlockPtr parseBody();
+
 private:
   // Node parsing helpers
   nodes::NodePtr parseDeclaration();
@@ -35,6 +45,7 @@ private:
   // Core resources
   tokens::TokenStream &tokens_;
   core::ErrorReporter &errorReporter_;
+  parser::ASTContext &context_;
   std::vector<nodes::NodePtr> nodes_;
 
   // Main parsers - order matters for initialization
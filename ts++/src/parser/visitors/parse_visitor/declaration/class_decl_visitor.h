@@ -1,5 +1,6 @@
 #pragma once
 #include "core/diagnostics/error_reporter.h"
+#include "parser/ast_context.h"
 #include "ideclaration_visitor.h"
 #include "parser/nodes/declaration_nodes.h"
 #include "parser/visitors/parse_visitor/expression/iexpression_visitor.h"
@@ -15,15 +16,17 @@ class ClassDeclarationVisitor {
 public:
   ClassDeclarationVisitor(tokens::TokenStream &tokens,
                           core::ErrorReporter &errorReporter,
+                          parser::ASTContext &context,
                           IDeclarationVisitor &declVisitor,
                           IExpressionVisitor &exprVisitor,
                           IStatementVisitor &stmtVisitor)
-      : tokens_(tokens), errorReporter_(errorReporter),
+      : tokens_(tokens), errorReporter_(errorReporter), context_(context),
         declVisitor_(declVisitor), exprVisitor_(exprVisitor),
         stmtVisitor_(stmtVisitor) {}
 
   nodes::DeclPtr
-  parseClassDecl(const std::vector<tokens::TokenType> &initialModifiers = {}) {
+  parseClassDecl(const std::vector<tokens::TokenType> &initialModifiers = {},
+                 unsigned alignment = 0) {
     auto location = tokens_.peek().getLocation();
     std::vector<tokens::TokenType> modifiers = initialModifiers;
 
@@ -39,7 +42,7 @@ public:
       error("Expected class name after 'class'");
       return nullptr;
     }
-    auto className = tokens_.peek().getLexeme();
+    std::string className(tokens_.peek().getLexeme());
     tokens_.advance();
 
     // Parse optional generic parameters
@@ -52,7 +55,7 @@ public:
     }
 
     // Parse optional "extends" (base class)
-    nodes::TypePtr baseClass;
+    nodes::TypePtr baseClass = nullptr;
     if (tokens_.peek().getLexeme() == "extends") {
       tokens_.advance();
       baseClass = declVisitor_.parseType();
@@ -118,15 +121,18 @@ public:
     }
 
     // Create appropriate class node based on whether it has generic parameters
+    nodes::ClassDeclNode *classDecl = nullptr;
     if (!genericParams.empty()) {
-      return std::make_shared<nodes::GenericClassDeclNode>(
+      classDecl = context_.create<nodes::GenericClassDeclNode>(
           className, modifiers, std::move(baseClass), std::move(interfaces),
           std::move(members), std::move(genericParams), location);
     } else {
-      return std::make_shared<nodes::ClassDeclNode>(
+      classDecl = context_.create<nodes::ClassDeclNode>(
           className, modifiers, std::move(baseClass), std::move(interfaces),
           std::move(members), location);
     }
+    classDecl->setAlignment(alignment);
+    return classDecl;
   }
 
   nodes::DeclPtr parseMemberDecl() {
@@ -135,10 +141,13 @@ public:
 
       // Check for an access modifier using lexeme
       std::vector<tokens::TokenType> modifiers;
-      parseMethodModifiers(modifiers);
+      std::string target;
+      if (!parseMethodModifiers(modifiers, target)) {
+        return nullptr;
+      }
 
       tokens::TokenType accessModifier = tokens::TokenType::ERROR_TOKEN;
-      std::string accessLexeme = tokens_.peek().getLexeme();
+      std::string accessLexeme(tokens_.peek().getLexeme());
       if (accessLexeme == "public" || accessLexeme == "private" ||
           accessLexeme == "protected") {
         accessModifier = tokens_.peek().getType();
@@ -146,11 +155,11 @@ public:
       }
 
       // Handle different member types USING LEXEMES
-      std::string tokenLexeme = tokens_.peek().getLexeme();
+      std::string tokenLexeme(tokens_.peek().getLexeme());
       if (tokenLexeme == "constructor") {
         return parseConstructor(accessModifier);
       } else if (tokenLexeme == "function") {
-        return parseMethod(accessModifier, modifiers);
+        return parseMethod(accessModifier, modifiers, target);
       } else if (tokenLexeme == "let" || tokenLexeme == "const") {
         return parseField(accessModifier);
       } else if (tokenLexeme == "get") {
@@ -184,7 +193,7 @@ public:
       error("Expected class name after 'class'");
       return nullptr;
     }
-    auto className = tokens_.peek().getLexeme();
+    std::string className(tokens_.peek().getLexeme());
     tokens_.advance();
 
     // Parse optional generic parameters
@@ -197,7 +206,7 @@ public:
     }
 
     // Parse optional "extends" (base class)
-    nodes::TypePtr baseClass;
+    nodes::TypePtr baseClass = nullptr;
     if (tokens_.peek().getLexeme() == "extends") {
       tokens_.advance();
       baseClass = declVisitor_.parseType();
@@ -263,28 +272,48 @@ public:
     std::vector<tokens::TokenType> classModifiers;
 
     if (!genericParams.empty()) {
-      return std::make_shared<nodes::GenericClassDeclNode>(
+      return context_.create<nodes::GenericClassDeclNode>(
           className, classModifiers, std::move(baseClass),
           std::move(interfaces), std::move(members), std::move(genericParams),
           location);
     } else {
-      return std::make_shared<nodes::ClassDeclNode>(
+      return context_.create<nodes::ClassDeclNode>(
           className, classModifiers, std::move(baseClass),
           std::move(interfaces), std::move(members), location);
     }
   }
 
-  bool parseMethodModifiers(std::vector<tokens::TokenType> &modifiers) {
+  bool parseMethodModifiers(std::vector<tokens::TokenType> &modifiers,
+                            std::string &target) {
     while (true) {
       auto token = tokens_.peek();
       tokens::TokenType type = token.getType();
-      std::string lexeme = token.getLexeme();
+      std::string lexeme(token.getLexeme());
 
       // Check for function modifiers by lexeme
       if (lexeme == "#inline" || lexeme == "#virtual" || lexeme == "#unsafe" ||
           lexeme == "#simd" || lexeme.substr(0, 1) == "#") {
         modifiers.push_back(type);
         tokens_.advance();
+
+        // #target names the instruction sets: #target("avx2")
+        if (lexeme == "#target") {
+          if (!match(tokens::TokenType::LEFT_PAREN) ||
+              !match(tokens::TokenType::STRING_LITERAL)) {
+            error("Expected a string naming the target, e.g. "
+                  "#target(\"avx2\")");
+            return false;
+          }
+          target = std::string(tokens_.previous().getLexeme());
+          if (target.size() >= 2 &&
+              (target.front() == '"' || target.front() == '\'')) {
+            target = target.substr(1, target.size() - 2);
+          }
+          if (!match(tokens::TokenType::RIGHT_PAREN)) {
+            error("Expected ')' after target string");
+            return false;
+          }
+        }
       } else {
         break;
       }
@@ -335,14 +364,15 @@ public:
     }
 
     // Build a ConstructorDeclNode
-    return std::make_shared<nodes::ConstructorDeclNode>(
+    return context_.create<nodes::ConstructorDeclNode>(
         accessModifier, std::move(parameters), std::move(body), location);
   }
 
   // Update the function declaration to accept modifiers
   nodes::DeclPtr
   parseMethod(tokens::TokenType accessModifier,
-              const std::vector<tokens::TokenType> &methodModifiers = {}) {
+              const std::vector<tokens::TokenType> &methodModifiers = {},
+              const std::string &target = "") {
     auto location = tokens_.peek().getLocation();
 
     // Consume the 'function' keyword - using lexeme check
@@ -357,7 +387,7 @@ public:
       error("Expected method name after 'function'");
       return nullptr;
     }
-    auto methodName = tokens_.peek().getLexeme();
+    std::string methodName(tokens_.peek().getLexeme());
     tokens_.advance();
 
     // Parse parameter list
@@ -381,7 +411,7 @@ public:
     tokens_.advance();
 
     // Parse optional return type
-    nodes::TypePtr returnType;
+    nodes::TypePtr returnType = nullptr;
     if (tokens_.peek().getLexeme() == ":") {
       tokens_.advance();
       returnType = declVisitor_.parseType();
@@ -410,23 +440,36 @@ public:
     }
 
     tokens_.advance(); // Consume the opening brace
-    auto body = stmtVisitor_.parseBlock();
-    if (!body) {
-      return nullptr;
+    nodes::BlockPtr body = nullptr;
+    nodes::DeferredBody deferred;
+    if (declVisitor_.defersBodies()) {
+      if (!declVisitor_.skipBody(deferred)) {
+        return nullptr;
+      }
+    } else {
+      body = stmtVisitor_.parseBlock();
+      if (!body) {
+        return nullptr;
+      }
     }
 
     // Create the method node - now passing methodModifiers
-    return std::make_shared<nodes::MethodDeclNode>(
+    auto method = context_.create<nodes::MethodDeclNode>(
         methodName, accessModifier, std::move(parameters),
         std::move(returnType), std::move(throwsTypes), methodModifiers,
         std::move(body), location);
+    method->setTarget(target);
+    if (deferred) {
+      method->deferBody(deferred);
+    }
+    return method;
   }
 
   nodes::DeclPtr parseField(tokens::TokenType accessModifier,
                             bool isConst = false) {
     auto location = tokens_.peek().getLocation();
 
-    std::string tokenLexeme = tokens_.peek().getLexeme();
+    std::string tokenLexeme(tokens_.peek().getLexeme());
     if (tokenLexeme == "let") {
       isConst = false;
       tokens_.advance();
@@ -443,11 +486,11 @@ public:
       error("Expected field name");
       return nullptr;
     }
-    auto fieldName = tokens_.peek().getLexeme();
+    std::string fieldName(tokens_.peek().getLexeme());
     tokens_.advance();
 
     // optional type annotation: ": Type"
-    nodes::TypePtr fieldType;
+    nodes::TypePtr fieldType = nullptr;
     if (tokens_.peek().getLexeme() == ":") {
       tokens_.advance();
       fieldType = declVisitor_.parseType();
@@ -457,7 +500,7 @@ public:
     }
 
     // optional initializer: "= expression"
-    nodes::ExpressionPtr initializer;
+    nodes::ExpressionPtr initializer = nullptr;
     if (tokens_.peek().getLexeme() == "=") {
       tokens_.advance();
       initializer = exprVisitor_.parseExpression();
@@ -474,7 +517,7 @@ public:
     tokens_.advance();
 
     // Build FieldDeclNode
-    return std::make_shared<nodes::FieldDeclNode>(
+    return context_.create<nodes::FieldDeclNode>(
         fieldName, accessModifier, isConst, std::move(fieldType),
         std::move(initializer), location);
   }
@@ -494,7 +537,7 @@ public:
       error("Expected property name after 'get'");
       return nullptr;
     }
-    auto propName = tokens_.peek().getLexeme();
+    std::string propName(tokens_.peek().getLexeme());
     tokens_.advance();
 
     // Optional parameter list (may not be present)
@@ -508,7 +551,7 @@ public:
     }
 
     // optional return type: e.g.  : int
-    nodes::TypePtr returnType;
+    nodes::TypePtr returnType = nullptr;
     if (tokens_.peek().getLexeme() == ":") {
       tokens_.advance();
       returnType = declVisitor_.parseType();
@@ -530,7 +573,7 @@ public:
     }
 
     // Build a property-decl node in "getter" mode
-    return std::make_shared<nodes::PropertyDeclNode>(
+    return context_.create<nodes::PropertyDeclNode>(
         propName, accessModifier, nodes::PropertyKind::Getter, returnType, body,
         location);
   }
@@ -550,7 +593,7 @@ public:
       error("Expected property name after 'set'");
       return nullptr;
     }
-    auto propName = tokens_.peek().getLexeme();
+    std::string propName(tokens_.peek().getLexeme());
     tokens_.advance();
 
     // Parse parameter for setter (value: Type)
@@ -566,10 +609,10 @@ public:
       return nullptr;
     }
 
-    auto paramName = tokens_.peek().getLexeme();
+    std::string paramName(tokens_.peek().getLexeme());
     tokens_.advance();
 
-    nodes::TypePtr paramType;
+    nodes::TypePtr paramType = nullptr;
     if (tokens_.peek().getLexeme() == ":") {
       tokens_.advance();
       paramType = declVisitor_.parseType();
@@ -597,7 +640,7 @@ public:
     }
 
     // Build a property-decl node in "setter" mode
-    return std::make_shared<nodes::PropertyDeclNode>(
+    return context_.create<nodes::PropertyDeclNode>(
         propName, accessModifier, nodes::PropertyKind::Setter, paramType, body,
         location);
   }
@@ -610,7 +653,7 @@ public:
       }
 
       // Get parameter name
-      auto paramName = tokens_.peek().getLexeme();
+      std::string paramName(tokens_.peek().getLexeme());
       auto paramLoc = tokens_.peek().getLocation();
       tokens_.advance();
 
@@ -625,12 +668,12 @@ public:
           return false;
         }
 
-        auto constraintName = tokens_.peek().getLexeme();
+        std::string constraintName(tokens_.peek().getLexeme());
         auto constraintLoc = tokens_.peek().getLocation();
         tokens_.advance();
 
         // Create a constraint node - either built-in or named type
-        auto constraintNode = std::make_shared<nodes::NamedTypeNode>(
+        auto constraintNode = context_.create<nodes::NamedTypeNode>(
             constraintName, constraintLoc);
         constraints.push_back(constraintNode);
 
@@ -643,18 +686,18 @@ public:
             return false;
           }
 
-          auto secondConstraintName = tokens_.peek().getLexeme();
+          std::string secondConstraintName(tokens_.peek().getLexeme());
           auto secondConstraintLoc = tokens_.peek().getLocation();
           tokens_.advance();
 
-          auto additionalConstraint = std::make_shared<nodes::NamedTypeNode>(
+          auto additionalConstraint = context_.create<nodes::NamedTypeNode>(
               secondConstraintName, secondConstraintLoc);
           constraints.push_back(additionalConstraint);
         }
       }
 
       // Build the generic parameter node
-      auto gpNode = std::make_shared<nodes::GenericParamNode>(
+      auto gpNode = context_.create<nodes::GenericParamNode>(
           paramName, std::move(constraints), paramLoc);
       outParams.push_back(gpNode);
 
@@ -714,11 +757,11 @@ public:
       error("Expected parameter name");
       return nullptr;
     }
-    auto paramName = tokens_.peek().getLexeme();
+    std::string paramName(tokens_.peek().getLexeme());
     tokens_.advance();
 
     // optional type: ": Type"
-    nodes::TypePtr paramType;
+    nodes::TypePtr paramType = nullptr;
     if (tokens_.peek().getLexeme() == ":") {
       tokens_.advance();
       paramType = declVisitor_.parseType();
@@ -728,7 +771,7 @@ public:
     }
 
     // optional default value: "= expression"
-    nodes::ExpressionPtr defaultValue;
+    nodes::ExpressionPtr defaultValue = nullptr;
     if (tokens_.peek().getLexeme() == "=") {
       tokens_.advance();
       defaultValue = exprVisitor_.parseExpression();
@@ -737,7 +780,7 @@ public:
       }
     }
 
-    return std::make_shared<nodes::ParameterNode>(
+    return context_.create<nodes::ParameterNode>(
         paramName, std::move(paramType), std::move(defaultValue), isRef,
         isConst, loc);
   }
@@ -771,7 +814,7 @@ private:
         return;
 
       // Use lexeme checks for keywords
-      std::string lexeme = tokens_.peek().getLexeme();
+      std::string lexeme(tokens_.peek().getLexeme());
       if (lexeme == "class" || lexeme == "function" ||
           lexeme == "constructor" || lexeme == "let" || lexeme == "const" ||
           lexeme == "public" || lexeme == "private" || lexeme == "protected" ||
@@ -788,6 +831,7 @@ private:
 
   tokens::TokenStream &tokens_;
   core::ErrorReporter &errorReporter_;
+  parser::ASTContext &context_;
   IDeclarationVisitor &declVisitor_;
   IExpressionVisitor &exprVisitor_;
   IStatementVisitor &stmtVisitor_;
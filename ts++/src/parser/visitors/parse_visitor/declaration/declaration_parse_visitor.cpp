@@ -1,30 +1,32 @@
 #include "declaration_parse_visitor.h"
 #include "parser/visitors/parse_visitor/expression/iexpression_visitor.h"
+#include "tokens/literal_value.h"
 #include "tokens/token_type.h"
 #include <cassert>
-#include <iostream>
 #include <ostream>
 
 namespace visitors {
 
 DeclarationParseVisitor::DeclarationParseVisitor(
     tokens::TokenStream &tokens, core::ErrorReporter &errorReporter,
-    IExpressionVisitor &exprVisitor, IStatementVisitor &stmtVisitor)
-    : tokens_(tokens), errorReporter_(errorReporter), exprVisitor_(exprVisitor),
-      stmtVisitor_(stmtVisitor),
-      varDeclVisitor_(tokens, errorReporter, exprVisitor, *this),
-      funcDeclVisitor_(tokens, errorReporter, exprVisitor, *this, stmtVisitor),
-      classDeclVisitor_(tokens, errorReporter, *this, exprVisitor, stmtVisitor),
+    parser::ASTContext &context, IExpressionVisitor &exprVisitor,
+    IStatementVisitor &stmtVisitor)
+    : tokens_(tokens), errorReporter_(errorReporter), context_(context),
+      exprVisitor_(exprVisitor), stmtVisitor_(stmtVisitor),
+      varDeclVisitor_(tokens, errorReporter, context, exprVisitor, *this),
+      funcDeclVisitor_(tokens, errorReporter, context, exprVisitor, *this,
+                       stmtVisitor),
+      classDeclVisitor_(tokens, errorReporter, context, *this, exprVisitor,
+                        stmtVisitor),
       // Initialize the new visitor components
       namespaceVisitor_(std::make_unique<NamespaceParseVisitor>(
-          tokens, errorReporter, *this)),
+          tokens, errorReporter, context, *this)),
       interfaceVisitor_(std::make_unique<InterfaceParseVisitor>(
-          tokens, errorReporter, *this, exprVisitor)),
-      enumVisitor_(std::make_unique<EnumParseVisitor>(tokens, errorReporter,
-                                                      *this, exprVisitor)),
-      typedefVisitor_(
-          std::make_unique<TypedefParseVisitor>(tokens, errorReporter, *this)) {
-}
+          tokens, errorReporter, context, *this, exprVisitor)),
+      enumVisitor_(std::make_unique<EnumParseVisitor>(
+          tokens, errorReporter, context, *this, exprVisitor)),
+      typedefVisitor_(std::make_unique<TypedefParseVisitor>(
+          tokens, errorReporter, context, *this)) {}
 
 nodes::DeclPtr DeclarationParseVisitor::parseDeclaration() {
   try {
@@ -58,6 +60,11 @@ nodes::DeclPtr DeclarationParseVisitor::parseDeclaration() {
       return typedefVisitor_->parseTypedefDecl();
     }
 
+    // Check for a C function declaration
+    if (check(tokens::TokenType::EXTERN)) {
+      return funcDeclVisitor_.parseExternDecl();
+    }
+
     // Check for access modifiers first (for class members)
     tokens::TokenType accessModifier = tokens::TokenType::ERROR_TOKEN;
     if (check(tokens::TokenType::PUBLIC) || check(tokens::TokenType::PRIVATE) ||
@@ -102,26 +109,43 @@ nodes::DeclPtr DeclarationParseVisitor::parseDeclaration() {
           tokens::TokenType::PUBLIC); // Default to public
     }
 
-    // Parse storage modifiers (#heap, #stack, #static)
+    // Parse storage modifiers (#heap, #stack, #static, #comptime)
     tokens::TokenType storageClass = tokens::TokenType::ERROR_TOKEN;
     if (check(tokens::TokenType::STACK) || check(tokens::TokenType::HEAP) ||
-        check(tokens::TokenType::STATIC) || check(tokens::TokenType::WEAK)) {
+        check(tokens::TokenType::STATIC) || check(tokens::TokenType::WEAK) ||
+        check(tokens::TokenType::COMPTIME)) {
       storageClass = tokens_.peek().getType();
       tokens_.advance();
     }
 
-    // Parse class modifiers
+    // Parse class modifiers; a #stack class is a value type
     std::vector<tokens::TokenType> classModifiers;
+    unsigned classAlignment = 0;
+    if (storageClass == tokens::TokenType::STACK &&
+        (check(tokens::TokenType::CLASS) || check(tokens::TokenType::ALIGNED) ||
+         check(tokens::TokenType::PACKED) ||
+         check(tokens::TokenType::ABSTRACT) || check(tokens::TokenType::SOA))) {
+      classModifiers.push_back(storageClass);
+    }
     while (check(tokens::TokenType::ALIGNED) ||
            check(tokens::TokenType::PACKED) ||
-           check(tokens::TokenType::ABSTRACT)) {
+           check(tokens::TokenType::ABSTRACT) ||
+           check(tokens::TokenType::SOA)) {
       tokens::TokenType modifierType = tokens_.peek().getType();
       tokens_.advance(); // Consume the modifier
       classModifiers.push_back(modifierType);
 
+      // #aligned takes an optional byte alignment: #aligned(64)
+      if (modifierType == tokens::TokenType::ALIGNED &&
+          check(tokens::TokenType::LEFT_PAREN) &&
+          !parseAlignmentArgument(classAlignment)) {
+        return nullptr;
+      }
+
       // Check for CLASS after modifier
       if (check(tokens::TokenType::CLASS)) {
-        auto classDecl = classDeclVisitor_.parseClassDecl(classModifiers);
+        auto classDecl =
+            classDeclVisitor_.parseClassDecl(classModifiers, classAlignment);
         if (!classDecl) {
           return nullptr;
         }
@@ -131,11 +155,14 @@ nodes::DeclPtr DeclarationParseVisitor::parseDeclaration() {
 
     // Parse function modifiers
     std::vector<tokens::TokenType> modifiers;
-    parseFunctionModifiers(modifiers);
+    std::string target;
+    if (!parseFunctionModifiers(modifiers, target)) {
+      return nullptr;
+    }
 
     // Check for function declaration
     if (check(tokens::TokenType::FUNCTION) || check(tokens::TokenType::ASYNC)) {
-      auto funcDecl = funcDeclVisitor_.parseFuncDecl(modifiers);
+      auto funcDecl = funcDeclVisitor_.parseFuncDecl(modifiers, target);
       if (!funcDecl)
         return nullptr;
       return funcDecl;
@@ -143,7 +170,8 @@ nodes::DeclPtr DeclarationParseVisitor::parseDeclaration() {
 
     // Check directly for CLASS
     if (check(tokens::TokenType::CLASS)) {
-      auto classDecl = classDeclVisitor_.parseClassDecl(classModifiers);
+      auto classDecl =
+          classDeclVisitor_.parseClassDecl(classModifiers, classAlignment);
       if (!classDecl) {
         return nullptr;
       }
@@ -159,10 +187,10 @@ nodes::DeclPtr DeclarationParseVisitor::parseDeclaration() {
         error("Expected variable name");
         return nullptr;
       }
-      auto name = tokens_.previous().getLexeme();
+      std::string name(tokens_.previous().getLexeme());
 
       // Parse optional type annotation
-      nodes::TypePtr type;
+      nodes::TypePtr type = nullptr;
       if (match(tokens::TokenType::COLON)) {
         type = parseType();
         if (!type)
@@ -170,7 +198,7 @@ nodes::DeclPtr DeclarationParseVisitor::parseDeclaration() {
       }
 
       // Parse initializer
-      nodes::ExpressionPtr initializer;
+      nodes::ExpressionPtr initializer = nullptr;
       if (match(tokens::TokenType::EQUALS)) {
         initializer = exprVisitor_.parseExpression();
         if (!initializer)
@@ -186,11 +214,9 @@ nodes::DeclPtr DeclarationParseVisitor::parseDeclaration() {
       }
 
       // Create variable declaration with storage class
-      return std::make_shared<nodes::VarDeclNode>(
+      return context_.create<nodes::VarDeclNode>(
           name, type, initializer, storageClass, isConst, location);
     }
-    std::cout << "current token: " << tokens_.getCurrentToken().getLexeme()
-              << std::endl;
     error("Expected declaration");
     return nullptr;
   } catch (const std::exception &e) {
@@ -200,7 +226,7 @@ nodes::DeclPtr DeclarationParseVisitor::parseDeclaration() {
 }
 
 bool DeclarationParseVisitor::parseFunctionModifiers(
-    std::vector<tokens::TokenType> &modifiers) {
+    std::vector<tokens::TokenType> &modifiers, std::string &target) {
   while (true) {
     auto token = tokens_.peek();
     tokens::TokenType type = token.getType();
@@ -212,6 +238,12 @@ bool DeclarationParseVisitor::parseFunctionModifiers(
         tokens::isFunctionModifier(type)) {
       modifiers.push_back(type);
       tokens_.advance();
+
+      // #target names the instruction sets: #target("avx2")
+      if (type == tokens::TokenType::TARGET &&
+          !parseTargetArgument(target)) {
+        return false;
+      }
     } else {
       break;
     }
@@ -219,6 +251,48 @@ bool DeclarationParseVisitor::parseFunctionModifiers(
   return true;
 }
 
+bool DeclarationParseVisitor::parseTargetArgument(std::string &target) {
+  if (!consume(tokens::TokenType::LEFT_PAREN, "Expected '(' after #target")) {
+    return false;
+  }
+
+  if (!match(tokens::TokenType::STRING_LITERAL)) {
+    error("Expected a string naming the target, e.g. #target(\"avx2\")");
+    return false;
+  }
+  target = std::string(tokens_.previous().getLexeme());
+  if (target.size() >= 2 && (target.front() == '"' || target.front() == '\'')) {
+    target = target.substr(1, target.size() - 2);
+  }
+
+  return consume(tokens::TokenType::RIGHT_PAREN,
+                 "Expected ')' after target string");
+}
+
+bool DeclarationParseVisitor::parseAlignmentArgument(unsigned &alignment) {
+  if (!consume(tokens::TokenType::LEFT_PAREN, "Expected '(' after aligned")) {
+    return false;
+  }
+
+  if (!match(tokens::TokenType::NUMBER)) {
+    error("Expected alignment value");
+    return false;
+  }
+
+  // Alignments are byte counts and must be powers of two
+  std::string lexeme(tokens_.previous().getLexeme());
+  tokens::NumberValue number = tokens::decodeNumber(lexeme);
+  uint64_t value = number.isInteger() ? number.integer : 0;
+  if (value == 0 || value > (1u << 29) || (value & (value - 1)) != 0) {
+    error("Alignment must be a power of two: " + lexeme);
+    return false;
+  }
+  alignment = static_cast<unsigned>(value);
+
+  return consume(tokens::TokenType::RIGHT_PAREN,
+                 "Expected ')' after alignment value");
+}
+
 bool DeclarationParseVisitor::parseClassModifiers(
     std::vector<tokens::TokenType> &modifiers) {
   while (true) {
@@ -228,7 +302,8 @@ bool DeclarationParseVisitor::parseClassModifiers(
     // Check for function modifiers tokens directly
     if (type == tokens::TokenType::ALIGNED ||
         type == tokens::TokenType::PACKED ||
-        type == tokens::TokenType::ABSTRACT) {
+        type == tokens::TokenType::ABSTRACT ||
+        type == tokens::TokenType::SOA) {
       modifiers.push_back(type);
       tokens_.advance();
     } else {
@@ -251,8 +326,11 @@ nodes::TypePtr DeclarationParseVisitor::parseType() {
       check(tokens::TokenType::WEAK)) {
     return parseSmartPointerType(location);
   }
+  if (check(tokens::TokenType::ATOMIC)) {
+    return parseAtomicType(location);
+  }
 
-  nodes::TypePtr type;
+  nodes::TypePtr type = nullptr;
   // If the next token is IDENTIFIER and the following token is '<', then it's a
   // template type.
   if (check(tokens::TokenType::IDENTIFIER) &&
@@ -277,7 +355,7 @@ nodes::TypePtr DeclarationParseVisitor::parseType() {
       if (!type)
         return nullptr;
     } else if (match(tokens::TokenType::AMPERSAND)) {
-      type = std::make_shared<nodes::ReferenceTypeNode>(type, location);
+      type = context_.create<nodes::ReferenceTypeNode>(type, location);
     } else if (match(tokens::TokenType::PIPE)) {
       type = parseUnionType(type, location);
       if (!type)
@@ -342,8 +420,8 @@ nodes::TypePtr DeclarationParseVisitor::parseFunctionType(
 
   // Construct and return the function type node
   // Use the correct parameter order to match the FunctionTypeNode constructor
-  return std::make_shared<nodes::FunctionTypeNode>(paramTypes, returnType,
-                                                   location);
+  return context_.create<nodes::FunctionTypeNode>(paramTypes, returnType,
+                                                  location);
 }
 
 nodes::TypePtr DeclarationParseVisitor::parseSmartPointerType(
@@ -373,8 +451,25 @@ nodes::TypePtr DeclarationParseVisitor::parseSmartPointerType(
                     ? nodes::SmartPointerTypeNode::SmartPointerKind::Unique
                     : nodes::SmartPointerTypeNode::SmartPointerKind::Weak;
 
-  return std::make_shared<nodes::SmartPointerTypeNode>(pointeeType, spKind,
-                                                       location);
+  return context_.create<nodes::SmartPointerTypeNode>(pointeeType, spKind,
+                                                      location);
+}
+
+nodes::TypePtr
+DeclarationParseVisitor::parseAtomicType(const core::SourceLocation &location) {
+  tokens_.advance(); // '#atomic'
+
+  if (!consume(tokens::TokenType::LESS, "Expected '<' after '#atomic'")) {
+    return nullptr;
+  }
+  auto valueType = parseType();
+  if (!valueType)
+    return nullptr;
+  if (!consume(tokens::TokenType::GREATER,
+               "Expected '>' after atomic value type")) {
+    return nullptr;
+  }
+  return context_.create<nodes::AtomicTypeNode>(valueType, location);
 }
 
 nodes::TypePtr DeclarationParseVisitor::parsePrimaryType() {
@@ -386,19 +481,30 @@ nodes::TypePtr DeclarationParseVisitor::parsePrimaryType() {
       tokens_.peek().getType() <= tokens::TokenType::TYPE_END) {
     auto type = tokens_.peek().getType();
     tokens_.advance();
-    return std::make_shared<nodes::PrimitiveTypeNode>(type, startLocation);
+    return context_.create<nodes::PrimitiveTypeNode>(type, startLocation);
+  }
+  // Vector types are named like identifiers: float4, int16, ...
+  tokens::TokenType element;
+  if (check(tokens::TokenType::IDENTIFIER) &&
+      tokens_.peekNext().getType() != tokens::TokenType::DOT) {
+    if (unsigned lanes = nodes::PrimitiveTypeNode::parseVectorName(
+            std::string(tokens_.peek().getLexeme()), element)) {
+      tokens_.advance();
+      return context_.create<nodes::PrimitiveTypeNode>(element, startLocation,
+                                                       lanes);
+    }
   }
   // Handle Named and Qualified Types
-  else if (check(tokens::TokenType::IDENTIFIER)) {
+  if (check(tokens::TokenType::IDENTIFIER)) {
     std::vector<std::string> identifiers;
-    identifiers.push_back(tokens_.peek().getLexeme());
+    identifiers.emplace_back(tokens_.peek().getLexeme());
     tokens_.advance(); // Consume the first identifier
 
     // Loop while we see a DOT followed by an IDENTIFIER
     while (check(tokens::TokenType::DOT) &&
            tokens_.peekNext().getType() == tokens::TokenType::IDENTIFIER) {
       tokens_.advance(); // Consume the DOT
-      identifiers.push_back(
+      identifiers.emplace_back(
           tokens_.peek().getLexeme()); // Store the next identifier
       tokens_.advance();               // Consume the identifier
     }
@@ -408,12 +514,12 @@ nodes::TypePtr DeclarationParseVisitor::parsePrimaryType() {
     if (identifiers.size() > 1) {
       // It's a qualified name (e.g., Namespace.Type)
       // Use the startLocation for the node
-      return std::make_shared<nodes::QualifiedTypeNode>(std::move(identifiers),
-                                                        startLocation);
+      return context_.create<nodes::QualifiedTypeNode>(std::move(identifiers),
+                                                       startLocation);
     } else {
       // It's just a simple named type
-      return std::make_shared<nodes::NamedTypeNode>(identifiers[0],
-                                                    startLocation);
+      return context_.create<nodes::NamedTypeNode>(identifiers[0],
+                                                   startLocation);
     }
   }
 
@@ -426,40 +532,25 @@ nodes::TypePtr DeclarationParseVisitor::parsePointerType(
   // Handle pointer modifiers
   nodes::PointerTypeNode::PointerKind kind =
       nodes::PointerTypeNode::PointerKind::Raw;
-  nodes::ExpressionPtr alignment;
+  unsigned alignment = 0;
 
   if (match(tokens::TokenType::UNSAFE)) {
     kind = nodes::PointerTypeNode::PointerKind::Unsafe;
   } else if (match(tokens::TokenType::ALIGNED)) {
     kind = nodes::PointerTypeNode::PointerKind::Aligned;
-
-    if (!consume(tokens::TokenType::LEFT_PAREN, "Expected '(' after aligned")) {
-      return nullptr;
-    }
-
-    if (!match(tokens::TokenType::NUMBER)) {
-      error("Expected alignment value");
-      return nullptr;
-    }
-
-    alignment = std::make_shared<nodes::LiteralExpressionNode>(
-        tokens_.previous().getLocation(), tokens::TokenType::NUMBER,
-        tokens_.previous().getLexeme());
-
-    if (!consume(tokens::TokenType::RIGHT_PAREN,
-                 "Expected ')' after alignment value")) {
+    if (!parseAlignmentArgument(alignment)) {
       return nullptr;
     }
   }
 
-  return std::make_shared<nodes::PointerTypeNode>(baseType, kind, alignment,
-                                                  location);
+  return context_.create<nodes::PointerTypeNode>(baseType, kind, alignment,
+                                                 location);
 }
 
 nodes::TypePtr
 DeclarationParseVisitor::parseArrayType(nodes::TypePtr elementType,
                                         const core::SourceLocation &location) {
-  nodes::ExpressionPtr sizeExpr;
+  nodes::ExpressionPtr sizeExpr = nullptr;
   if (!check(tokens::TokenType::RIGHT_BRACKET)) {
     sizeExpr = exprVisitor_.parseExpression();
     if (!sizeExpr)
@@ -471,8 +562,8 @@ DeclarationParseVisitor::parseArrayType(nodes::TypePtr elementType,
     return nullptr;
   }
 
-  return std::make_shared<nodes::ArrayTypeNode>(elementType, sizeExpr,
-                                                location);
+  return context_.create<nodes::ArrayTypeNode>(elementType, sizeExpr,
+                                               location);
 }
 
 nodes::TypePtr
@@ -482,12 +573,12 @@ DeclarationParseVisitor::parseUnionType(nodes::TypePtr leftType,
   if (!rightType)
     return nullptr;
 
-  return std::make_shared<nodes::UnionTypeNode>(leftType, rightType, location);
+  return context_.create<nodes::UnionTypeNode>(leftType, rightType, location);
 }
 
 nodes::TypePtr DeclarationParseVisitor::parseTemplateType(
     const core::SourceLocation &location) {
-  auto templateName = tokens_.peek().getLexeme();
+  std::string templateName(tokens_.peek().getLexeme());
   tokens_.advance();
 
   if (!consume(tokens::TokenType::LESS, "Expected '<' after template name")) {
@@ -507,8 +598,8 @@ nodes::TypePtr DeclarationParseVisitor::parseTemplateType(
     return nullptr;
   }
 
-  return std::make_shared<nodes::TemplateTypeNode>(
-      std::make_shared<nodes::NamedTypeNode>(templateName, location),
+  return context_.create<nodes::TemplateTypeNode>(
+      context_.create<nodes::NamedTypeNode>(templateName, location),
       std::move(typeArgs), location);
 }
 
@@ -516,12 +607,30 @@ nodes::BlockPtr DeclarationParseVisitor::parseBlock() {
   return stmtVisitor_.parseBlock();
 }
 
+bool DeclarationParseVisitor::skipBody(nodes::DeferredBody &body) {
+  // Braces only nest, so the body ends at the brace matching the first
+  body.file = tokens_.previous().getFileId();
+  body.begin = tokens_.previous().getOffset();
+  int depth = 1;
+  while (!tokens_.isAtEnd()) {
+    tokens::TokenType type = tokens_.advance().getType();
+    if (type == tokens::TokenType::LEFT_BRACE) {
+      ++depth;
+    } else if (type == tokens::TokenType::RIGHT_BRACE && --depth == 0) {
+      body.end = tokens_.previous().getOffset() + 1;
+      return true;
+    }
+  }
+  error("Expected '}' after block");
+  return false;
+}
+
 tokens::TokenType DeclarationParseVisitor::parseStorageClass() {
   if (!check(tokens::TokenType::ATTRIBUTE)) {
     return tokens::TokenType::ERROR_TOKEN;
   }
 
-  std::string lexeme = tokens_.peek().getLexeme();
+  std::string lexeme(tokens_.peek().getLexeme());
   tokens_.advance();
 
   if (lexeme == "#stack")
@@ -556,7 +665,7 @@ std::vector<nodes::AttributePtr> DeclarationParseVisitor::parseAttributeList() {
 
 nodes::AttributePtr DeclarationParseVisitor::parseAttribute() {
   auto location = tokens_.previous().getLocation();
-  std::string lexeme = tokens_.previous().getLexeme();
+  std::string lexeme(tokens_.previous().getLexeme());
 
   // Remove '#' prefix if present
   if (!lexeme.empty() && lexeme[0] == '#') {
@@ -567,7 +676,7 @@ nodes::AttributePtr DeclarationParseVisitor::parseAttribute() {
   }
 
   // Parse attribute argument if present
-  nodes::ExpressionPtr argument;
+  nodes::ExpressionPtr argument = nullptr;
   if (match(tokens::TokenType::LEFT_PAREN)) {
     argument = exprVisitor_.parseExpression();
     if (!argument)
@@ -579,7 +688,7 @@ nodes::AttributePtr DeclarationParseVisitor::parseAttribute() {
     }
   }
 
-  return std::make_shared<nodes::AttributeNode>(lexeme, argument, location);
+  return context_.create<nodes::AttributeNode>(lexeme, argument, location);
 }
 
 nodes::DeclPtr DeclarationParseVisitor::parseNamespaceDecl() {
@@ -19,6 +19,7 @@ class DeclarationParseVisitor : public IDeclarationVisitor {
 public:
   DeclarationParseVisitor(tokens::TokenStream &tokens,
                           core::ErrorReporter &errorReporter,
+                          parser::ASTContext &context,
                           IExpressionVisitor &exprVisitor,
                           IStatementVisitor &stmtVisitor);
 
@@ -30,10 +31,16 @@ public:
   nodes::DeclPtr parseEnumDecl() override;
   nodes::DeclPtr parseTypedefDecl() override;
 
+  // Skip function and method bodies, recording their source ranges
+  void setDeferBodies(bool defer) { deferBodies_ = defer; }
+  bool defersBodies() const override { return deferBodies_; }
+  bool skipBody(nodes::DeferredBody &body) override;
+
   // Helper methods for type parsing (used by other visitors)
   nodes::TypePtr parsePrimaryType();
   nodes::TypePtr parseTemplateType(const core::SourceLocation &location);
   nodes::TypePtr parseSmartPointerType(const core::SourceLocation &location);
+  nodes::TypePtr parseAtomicType(const core::SourceLocation &location);
   nodes::TypePtr parseUnionType(nodes::TypePtr leftType,
                                 const core::SourceLocation &location);
   nodes::TypePtr parseArrayType(nodes::TypePtr elementType,
@@ -46,8 +53,11 @@ public:
   tokens::TokenType parseStorageClass();
   std::vector<nodes::AttributePtr> parseAttributeList();
   nodes::AttributePtr parseAttribute();
-  bool parseFunctionModifiers(std::vector<tokens::TokenType> &modifiers);
+  bool parseFunctionModifiers(std::vector<tokens::TokenType> &modifiers,
+                              std::string &target);
   bool parseClassModifiers(std::vector<tokens::TokenType> &modifiers);
+  bool parseAlignmentArgument(unsigned &alignment);
+  bool parseTargetArgument(std::string &target);
 
   // Utility methods
   bool match(tokens::TokenType type);
@@ -59,6 +69,7 @@ private:
   // Resources
   tokens::TokenStream &tokens_;
   core::ErrorReporter &errorReporter_;
+  parser::ASTContext &context_;
   IExpressionVisitor &exprVisitor_;
   IStatementVisitor &stmtVisitor_;
 
@@ -72,5 +83,7 @@ private:
   std::unique_ptr<InterfaceParseVisitor> interfaceVisitor_;
   std::unique_ptr<EnumParseVisitor> enumVisitor_;
   std::unique_ptr<TypedefParseVisitor> typedefVisitor_;
+
+  bool deferBodies_ = false; // Bodies are skipped, see setDeferBodies()
 };
 } // namespace visitors
\ No newline at end of file
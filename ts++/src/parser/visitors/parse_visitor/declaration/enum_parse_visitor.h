@@ -1,5 +1,6 @@
 #pragma once
 #include "core/diagnostics/error_reporter.h"
+#include "parser/ast_context.h"
 #include "ideclaration_visitor.h"
 #include "parser/nodes/declaration_nodes.h"
 #include "parser/visitors/parse_visitor/expression/iexpression_visitor.h"
@@ -13,9 +14,10 @@ class EnumParseVisitor {
 public:
   EnumParseVisitor(tokens::TokenStream &tokens,
                    core::ErrorReporter &errorReporter,
+                   parser::ASTContext &context,
                    IDeclarationVisitor &declVisitor,
                    IExpressionVisitor &exprVisitor)
-      : tokens_(tokens), errorReporter_(errorReporter),
+      : tokens_(tokens), errorReporter_(errorReporter), context_(context),
         declVisitor_(declVisitor), exprVisitor_(exprVisitor) {}
 
   /**
@@ -34,10 +36,10 @@ public:
     if (!consume(tokens::TokenType::IDENTIFIER, "Expected enum name")) {
       return nullptr;
     }
-    std::string name = tokens_.previous().getLexeme();
+    std::string name(tokens_.previous().getLexeme());
 
     // Parse optional underlying type
-    nodes::TypePtr underlyingType;
+    nodes::TypePtr underlyingType = nullptr;
     if (match(tokens::TokenType::COLON)) {
       underlyingType = declVisitor_.parseType();
       if (!underlyingType) {
@@ -89,7 +91,7 @@ while (!check(tokens::TokenType::RIGHT_BRACE) && !tokens_.isAtEnd()) {
       return nullptr;
     }
 
-    return std::make_shared<nodes::EnumDeclNode>(
+    return context_.create<nodes::EnumDeclNode>(
         name, std::move(underlyingType), std::move(members), location);
   }
 
@@ -105,10 +107,10 @@ private:
     if (!consume(tokens::TokenType::IDENTIFIER, "Expected enum member name")) {
       return nullptr;
     }
-    std::string memberName = tokens_.previous().getLexeme();
+    std::string memberName(tokens_.previous().getLexeme());
 
     // Parse optional explicit value
-    nodes::ExpressionPtr value;
+    nodes::ExpressionPtr value = nullptr;
     if (match(tokens::TokenType::EQUALS)) {
       value = exprVisitor_.parseExpression();
       if (!value) {
@@ -116,12 +118,13 @@ private:
       }
     }
 
-    return std::make_shared<nodes::EnumMemberNode>(memberName, std::move(value),
-                                                   location);
+    return context_.create<nodes::EnumMemberNode>(memberName, std::move(value),
+                                                  location);
   }
 
   tokens::TokenStream &tokens_;
   core::ErrorReporter &errorReporter_;
+  parser::ASTContext &context_;
   IDeclarationVisitor &declVisitor_;
   IExpressionVisitor &exprVisitor_;
 
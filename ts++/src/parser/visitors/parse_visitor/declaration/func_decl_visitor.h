@@ -1,5 +1,6 @@
 #pragma once
 #include "core/diagnostics/error_reporter.h"
+#include "parser/ast_context.h"
 #include "ideclaration_visitor.h"
 #include "parser/nodes/declaration_nodes.h"
 #include "parser/visitors/parse_visitor/expression/iexpression_visitor.h"
@@ -18,21 +19,24 @@ class FunctionDeclarationVisitor {
 public:
   FunctionDeclarationVisitor(tokens::TokenStream &tokens,
                              core::ErrorReporter &errorReporter,
+                             parser::ASTContext &context,
                              IExpressionVisitor &exprVisitor,
                              IDeclarationVisitor &declVisitor,
                              IStatementVisitor &stmtVisitor)
-      : tokens_(tokens), errorReporter_(errorReporter),
+      : tokens_(tokens), errorReporter_(errorReporter), context_(context),
         exprVisitor_(exprVisitor), declVisitor_(declVisitor),
         stmtVisitor_(stmtVisitor) {}
 
   nodes::DeclPtr
-  parseFuncDecl(const std::vector<tokens::TokenType> &initialModifiers = {}) {
+  parseFuncDecl(const std::vector<tokens::TokenType> &initialModifiers = {},
+                const std::string &target = "") {
     auto location = tokens_.peek().getLocation();
 
     // Use the modifiers passed from DeclarationParseVisitor
     std::vector<tokens::TokenType> modifiers = initialModifiers;
 
-    // Parse 'function' keyword
+    // Parse 'function' keyword, which 'async' may precede
+    bool isAsync = match(tokens::TokenType::ASYNC);
     if (!match(tokens::TokenType::FUNCTION)) {
       error("Expected 'function' keyword");
       return nullptr;
@@ -43,7 +47,7 @@ public:
       error("Expected function name");
       return nullptr;
     }
-    auto name = tokens_.previous().getLexeme();
+    std::string name(tokens_.previous().getLexeme());
 
     // Parse generic parameters if present
     std::vector<nodes::TypePtr> genericParams;
@@ -53,7 +57,7 @@ public:
           error("Expected generic parameter name");
           return nullptr;
         }
-        auto paramName = tokens_.previous().getLexeme();
+        std::string paramName(tokens_.previous().getLexeme());
         auto paramLocation = tokens_.previous().getLocation();
 
         // Check for constraints (extends TypeConstraint)
@@ -67,7 +71,7 @@ public:
         }
 
         // Create a GenericParamNode instead of NamedTypeNode
-        genericParams.push_back(std::make_shared<nodes::GenericParamNode>(
+        genericParams.push_back(context_.create<nodes::GenericParamNode>(
             paramName, std::move(constraints), paramLocation));
 
       } while (match(tokens::TokenType::COMMA));
@@ -100,7 +104,7 @@ public:
     }
 
     // Parse return type
-    nodes::TypePtr returnType;
+    nodes::TypePtr returnType = nullptr;
     if (match(tokens::TokenType::COLON)) {
       returnType = declVisitor_.parseType();
       if (!returnType)
@@ -115,7 +119,7 @@ public:
           error("Expected type parameter name in constraint");
           return nullptr;
         }
-        auto paramName = tokens_.previous().getLexeme();
+        std::string paramName(tokens_.previous().getLexeme());
 
         if (!consume(tokens::TokenType::COLON,
                      "Expected ':' after type parameter")) {
@@ -141,30 +145,119 @@ public:
       } while (match(tokens::TokenType::COMMA));
     }
 
-    // Parse function body
+    // Parse function body; a generic one is instantiated by its callers,
+    // so it is never deferred
     if (!match(tokens::TokenType::LEFT_BRACE)) {
       error("Expected '{' before function body");
       return nullptr;
     }
-    auto body = stmtVisitor_.parseBlock();
-    if (!body)
-      return nullptr;
+    nodes::BlockPtr body = nullptr;
+    nodes::DeferredBody deferred;
+    if (declVisitor_.defersBodies() && genericParams.empty()) {
+      if (!declVisitor_.skipBody(deferred))
+        return nullptr;
+    } else {
+      body = stmtVisitor_.parseBlock();
+      if (!body)
+        return nullptr;
+    }
 
     // Create appropriate node based on whether it's generic
+    nodes::FunctionDeclNode *function;
     if (!genericParams.empty()) {
-      return std::make_shared<nodes::GenericFunctionDeclNode>(
+      function = context_.create<nodes::GenericFunctionDeclNode>(
           name, std::move(genericParams), std::move(parameters),
           std::move(returnType), std::move(constraints), std::move(throwsTypes),
-          std::move(modifiers), std::move(body),
-          false, // isAsync
-          location);
+          std::move(modifiers), std::move(body), isAsync, location);
     } else {
-      return std::make_shared<nodes::FunctionDeclNode>(
+      function = context_.create<nodes::FunctionDeclNode>(
           name, std::move(parameters), std::move(returnType),
           std::move(throwsTypes), std::move(modifiers), std::move(body),
-          false, // isAsync
-          location);
+          isAsync, location);
+    }
+    function->setTarget(target);
+    if (deferred) {
+      function->deferBody(deferred);
+    }
+    return function;
+  }
+
+  // extern "C" function name(params, ...): type; declares a function
+  // defined by C code, with no body
+  nodes::DeclPtr parseExternDecl() {
+    auto location = tokens_.peek().getLocation();
+    tokens_.advance(); // Consume 'extern'
+
+    if (!match(tokens::TokenType::STRING_LITERAL) ||
+        tokens_.previous().getLexeme() != "\"C\"") {
+      error("Expected \"C\" after 'extern'");
+      return nullptr;
+    }
+    if (check(tokens::TokenType::ASYNC)) {
+      error("A C function cannot be async");
+      return nullptr;
+    }
+    if (!match(tokens::TokenType::FUNCTION)) {
+      error("Expected 'function' after extern \"C\"");
+      return nullptr;
+    }
+    if (!match(tokens::TokenType::IDENTIFIER)) {
+      error("Expected function name");
+      return nullptr;
+    }
+    std::string name(tokens_.previous().getLexeme());
+    if (check(tokens::TokenType::LESS)) {
+      error("C function '" + name + "' cannot be generic");
+      return nullptr;
+    }
+
+    // Parameters, which '...' may end
+    if (!consume(tokens::TokenType::LEFT_PAREN,
+                 "Expected '(' after function name")) {
+      return nullptr;
+    }
+    std::vector<nodes::ParamPtr> parameters;
+    bool variadic = false;
+    if (!check(tokens::TokenType::RIGHT_PAREN)) {
+      do {
+        if (match(tokens::TokenType::ELLIPSIS)) {
+          variadic = true;
+          break;
+        }
+        auto param = parseParameter();
+        if (!param)
+          return nullptr;
+        if (param->isRef() || param->getDefaultValue()) {
+          error("Parameters of C function '" + name +
+                "' cannot be ref or have default values");
+          return nullptr;
+        }
+        parameters.push_back(std::move(param));
+      } while (match(tokens::TokenType::COMMA));
+    }
+    if (!consume(tokens::TokenType::RIGHT_PAREN,
+                 variadic ? "Expected ')' after '...'"
+                          : "Expected ')' after parameters")) {
+      return nullptr;
     }
+
+    nodes::TypePtr returnType = nullptr;
+    if (match(tokens::TokenType::COLON)) {
+      returnType = declVisitor_.parseType();
+      if (!returnType)
+        return nullptr;
+    }
+    if (!consume(tokens::TokenType::SEMICOLON,
+                 "Expected ';' after C function declaration")) {
+      return nullptr;
+    }
+
+    auto function = context_.create<nodes::FunctionDeclNode>(
+        name, std::move(parameters), std::move(returnType),
+        std::vector<nodes::TypePtr>(), std::vector<tokens::TokenType>(),
+        nullptr, false, location);
+    function->setExternC(variadic);
+    return function;
   }
 
   // Helper method to parse type constraints
@@ -173,17 +266,17 @@ public:
 
     // Check for built-in constraints
     if (match(tokens::TokenType::IDENTIFIER)) {
-      std::string constraintName = tokens_.previous().getLexeme();
+      std::string constraintName(tokens_.previous().getLexeme());
 
       // Handle built-in constraints like "number", "comparable", etc.
       if (nodes::isValidBuiltinConstraint(constraintName)) {
-        return std::make_shared<nodes::BuiltinConstraintNode>(
+        return context_.create<nodes::BuiltinConstraintNode>(
             constraintName, tokens_.previous().getLocation());
       }
 
       // Not a built-in constraint, so it must be a user-defined type
       // Create a named type node
-      return std::make_shared<nodes::NamedTypeNode>(
+      return context_.create<nodes::NamedTypeNode>(
           constraintName, tokens_.previous().getLocation());
     }
 
@@ -213,7 +306,7 @@ private:
       error("Expected parameter name");
       return nullptr;
     }
-    auto name = tokens_.previous().getLexeme();
+    std::string name(tokens_.previous().getLexeme());
 
     // Parse parameter type
     if (!consume(tokens::TokenType::COLON,
@@ -239,7 +332,7 @@ private:
     }
 
     // Create parameter node with ref/const flags
-    return std::make_shared<nodes::ParameterNode>(
+    return context_.create<nodes::ParameterNode>(
         name, std::move(type), std::move(defaultValue),
         isRef,   // Now passing the ref flag
         isConst, // Now passing the const flag
@@ -273,6 +366,7 @@ private:
 
   tokens::TokenStream &tokens_;
   core::ErrorReporter &errorReporter_;
+  parser::ASTContext &context_;
   IExpressionVisitor &exprVisitor_;
   IDeclarationVisitor &declVisitor_;
   IStatementVisitor &stmtVisitor_;
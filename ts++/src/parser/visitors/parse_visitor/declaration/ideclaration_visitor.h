@@ -15,4 +15,13 @@ public:
   virtual nodes::DeclPtr parseInterfaceDecl() { return parseDeclaration(); }
   virtual nodes::DeclPtr parseEnumDecl() { return parseDeclaration(); }
   virtual nodes::DeclPtr parseTypedefDecl() { return parseDeclaration(); }
+
+  // Whether function and method bodies are skipped, to be parsed later
+  virtual bool defersBodies() const { return false; }
+
+  // Skips a body whose '{' was just consumed, recording where it is
+  virtual bool skipBody(nodes::DeferredBody &body) {
+    (void)body;
+    return false;
+  }
 };
\ No newline at end of file
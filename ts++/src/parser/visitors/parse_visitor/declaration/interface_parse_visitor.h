@@ -1,11 +1,11 @@
 #pragma once
 #include "core/diagnostics/error_reporter.h"
+#include "parser/ast_context.h"
 #include "ideclaration_visitor.h"
 #include "parser/nodes/declaration_nodes.h"
 #include "parser/visitors/parse_visitor/expression/iexpression_visitor.h"
 #include "tokens/stream/token_stream.h"
 #include "tokens/token_type.h"
-#include <iostream>
 #include <ostream>
 #include <vector>
 
@@ -15,9 +15,10 @@ class InterfaceParseVisitor {
 public:
   InterfaceParseVisitor(tokens::TokenStream &tokens,
                         core::ErrorReporter &errorReporter,
+                        parser::ASTContext &context,
                         IDeclarationVisitor &declVisitor,
                         IExpressionVisitor &exprVisitor)
-      : tokens_(tokens), errorReporter_(errorReporter),
+      : tokens_(tokens), errorReporter_(errorReporter), context_(context),
         declVisitor_(declVisitor), exprVisitor_(exprVisitor) {}
 
   /**
@@ -34,8 +35,6 @@ public:
       isZeroCast = true;
       tokens_.advance();
     }
-    std::cout << "current token: " << tokens_.getCurrentToken().getLexeme()
-              << std::endl;
     // Expect 'interface' keyword
     if (!consume(tokens::TokenType::INTERFACE,
                  "Expected 'interface' keyword")) {
@@ -46,7 +45,7 @@ public:
     if (!consume(tokens::TokenType::IDENTIFIER, "Expected interface name")) {
       return nullptr;
     }
-    std::string name = tokens_.previous().getLexeme();
+    std::string name(tokens_.previous().getLexeme());
 
     // Check for generic parameters
     std::vector<nodes::TypePtr> genericParams;
@@ -58,7 +57,7 @@ public:
           return nullptr;
         }
 
-        std::string paramName = tokens_.previous().getLexeme();
+        std::string paramName(tokens_.previous().getLexeme());
         auto paramLoc = tokens_.previous().getLocation();
 
         // Check for constraints (extends T)
@@ -81,7 +80,7 @@ public:
           }
         }
 
-        genericParams.push_back(std::make_shared<nodes::GenericParamNode>(
+        genericParams.push_back(context_.create<nodes::GenericParamNode>(
             paramName, std::move(constraints), paramLoc));
 
       } while (match(tokens::TokenType::COMMA));
@@ -131,11 +130,11 @@ public:
 
     // Create appropriate interface node
     if (genericParams.empty()) {
-      return std::make_shared<nodes::InterfaceDeclNode>(
+      return context_.create<nodes::InterfaceDeclNode>(
           name, std::move(extendedInterfaces), std::move(members), isZeroCast,
           location);
     } else {
-      return std::make_shared<nodes::GenericInterfaceDeclNode>(
+      return context_.create<nodes::GenericInterfaceDeclNode>(
           name, std::move(extendedInterfaces), std::move(members), isZeroCast,
           std::move(genericParams), location);
     }
@@ -165,7 +164,7 @@ private:
 
     // Parse method signature (no function keyword in interfaces)
     if (match(tokens::TokenType::IDENTIFIER)) {
-      std::string methodName = tokens_.previous().getLexeme();
+      std::string methodName(tokens_.previous().getLexeme());
 
       // Parse parameter list
       if (!consume(tokens::TokenType::LEFT_PAREN,
@@ -218,7 +217,7 @@ private:
         return nullptr;
       }
 
-      return std::make_shared<nodes::MethodSignatureNode>(
+      return context_.create<nodes::MethodSignatureNode>(
           methodName, accessModifier, std::move(parameters),
           std::move(returnType), std::move(throwsTypes), location);
     }
@@ -237,7 +236,7 @@ private:
     if (!consume(tokens::TokenType::IDENTIFIER, "Expected property name")) {
       return nullptr;
     }
-    std::string propertyName = tokens_.previous().getLexeme();
+    std::string propertyName(tokens_.previous().getLexeme());
 
     // Parse parameters for setters
     if (hasSetter) {
@@ -275,7 +274,7 @@ private:
       return nullptr;
     }
 
-    return std::make_shared<nodes::PropertySignatureNode>(
+    return context_.create<nodes::PropertySignatureNode>(
         propertyName, accessModifier, std::move(type), hasGetter, hasSetter,
         location);
   }
@@ -300,7 +299,7 @@ private:
     if (!consume(tokens::TokenType::IDENTIFIER, "Expected parameter name")) {
       return nullptr;
     }
-    std::string paramName = tokens_.previous().getLexeme();
+    std::string paramName(tokens_.previous().getLexeme());
 
     // Parse type annotation
     if (!consume(tokens::TokenType::COLON,
@@ -314,7 +313,7 @@ private:
     }
 
     // Parse optional default value
-    nodes::ExpressionPtr defaultValue;
+    nodes::ExpressionPtr defaultValue = nullptr;
     if (match(tokens::TokenType::EQUALS)) {
       defaultValue = exprVisitor_.parseExpression();
       if (!defaultValue) {
@@ -322,13 +321,14 @@ private:
       }
     }
 
-    return std::make_shared<nodes::ParameterNode>(paramName, std::move(type),
-                                                  std::move(defaultValue),
-                                                  isRef, isConst, location);
+    return context_.create<nodes::ParameterNode>(paramName, std::move(type),
+                                                 std::move(defaultValue),
+                                                 isRef, isConst, location);
   }
 
   tokens::TokenStream &tokens_;
   core::ErrorReporter &errorReporter_;
+  parser::ASTContext &context_;
   IDeclarationVisitor &declVisitor_;
   IExpressionVisitor &exprVisitor_;
 
@@ -1,5 +1,6 @@
 #pragma once
 #include "core/diagnostics/error_reporter.h"
+#include "parser/ast_context.h"
 #include "ideclaration_visitor.h"
 #include "parser/nodes/declaration_nodes.h"
 #include "tokens/stream/token_stream.h"
@@ -11,8 +12,9 @@ class NamespaceParseVisitor {
 public:
   NamespaceParseVisitor(tokens::TokenStream &tokens,
                         core::ErrorReporter &errorReporter,
+                        parser::ASTContext &context,
                         IDeclarationVisitor &declVisitor)
-      : tokens_(tokens), errorReporter_(errorReporter),
+      : tokens_(tokens), errorReporter_(errorReporter), context_(context),
         declVisitor_(declVisitor) {}
 
   /**
@@ -32,7 +34,7 @@ public:
     if (!consume(tokens::TokenType::IDENTIFIER, "Expected namespace name")) {
       return nullptr;
     }
-    std::string name = tokens_.previous().getLexeme();
+    std::string name(tokens_.previous().getLexeme());
 
     // Parse namespace body
     if (!consume(tokens::TokenType::LEFT_BRACE,
@@ -58,13 +60,14 @@ public:
       return nullptr;
     }
 
-    return std::make_shared<nodes::NamespaceDeclNode>(
+    return context_.create<nodes::NamespaceDeclNode>(
         name, std::move(declarations), location);
   }
 
 private:
   tokens::TokenStream &tokens_;
   core::ErrorReporter &errorReporter_;
+  parser::ASTContext &context_;
   IDeclarationVisitor &declVisitor_;
 
   // Helper methods for token handling
@@ -105,6 +108,7 @@ private:
       switch (tokens_.peek().getType()) {
       case tokens::TokenType::CLASS:
       case tokens::TokenType::FUNCTION:
+      case tokens::TokenType::ASYNC:
       case tokens::TokenType::LET:
       case tokens::TokenType::CONST:
       case tokens::TokenType::INTERFACE:
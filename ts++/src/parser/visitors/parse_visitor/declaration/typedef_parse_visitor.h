@@ -1,5 +1,6 @@
 #pragma once
 #include "core/diagnostics/error_reporter.h"
+#include "parser/ast_context.h"
 #include "ideclaration_visitor.h"
 #include "parser/nodes/declaration_nodes.h"
 #include "tokens/stream/token_stream.h"
@@ -10,8 +11,9 @@ class TypedefParseVisitor {
 public:
   TypedefParseVisitor(tokens::TokenStream &tokens,
                       core::ErrorReporter &errorReporter,
+                      parser::ASTContext &context,
                       IDeclarationVisitor &declVisitor)
-      : tokens_(tokens), errorReporter_(errorReporter),
+      : tokens_(tokens), errorReporter_(errorReporter), context_(context),
         declVisitor_(declVisitor) {}
 
   /**
@@ -30,7 +32,7 @@ public:
     if (!consume(tokens::TokenType::IDENTIFIER, "Expected type alias name")) {
       return nullptr;
     }
-    std::string name = tokens_.previous().getLexeme();
+    std::string name(tokens_.previous().getLexeme());
 
     // Expect equals sign
     if (!consume(tokens::TokenType::EQUALS,
@@ -50,13 +52,14 @@ public:
       return nullptr;
     }
 
-    return std::make_shared<nodes::TypedefDeclNode>(
+    return context_.create<nodes::TypedefDeclNode>(
         name, std::move(aliasedType), location);
   }
 
 private:
   tokens::TokenStream &tokens_;
   core::ErrorReporter &errorReporter_;
+  parser::ASTContext &context_;
   IDeclarationVisitor &declVisitor_;
 
   // Helper methods
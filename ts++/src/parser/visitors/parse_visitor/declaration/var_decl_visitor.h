@@ -1,5 +1,6 @@
 #pragma once
 #include "core/diagnostics/error_reporter.h"
+#include "parser/ast_context.h"
 #include "ideclaration_visitor.h"
 #include "parser/nodes/declaration_nodes.h"
 #include "parser/visitors/parse_visitor/expression/iexpression_visitor.h"
@@ -14,9 +15,10 @@ class VariableDeclarationVisitor {
 public:
   VariableDeclarationVisitor(tokens::TokenStream &tokens,
                              core::ErrorReporter &errorReporter,
+                             parser::ASTContext &context,
                              IExpressionVisitor &exprVisitor,
                              IDeclarationVisitor &declVisitor)
-      : tokens_(tokens), errorReporter_(errorReporter),
+      : tokens_(tokens), errorReporter_(errorReporter), context_(context),
         exprVisitor_(exprVisitor), declVisitor_(declVisitor) {}
 
   nodes::DeclPtr parseVarDecl(bool isConst, tokens::TokenType storageClass) {
@@ -26,10 +28,10 @@ public:
       error("Expected variable name");
       return nullptr;
     }
-    auto name = tokens_.previous().getLexeme();
+    std::string name(tokens_.previous().getLexeme());
 
     // Parse type annotation if present
-    nodes::TypePtr type;
+    nodes::TypePtr type = nullptr;
     if (match(tokens::TokenType::COLON)) {
       type = declVisitor_.parseType();
       if (!type)
@@ -37,7 +39,7 @@ public:
     }
 
     // Parse initializer if present
-    nodes::ExpressionPtr initializer;
+    nodes::ExpressionPtr initializer = nullptr;
     if (match(tokens::TokenType::EQUALS)) {
       initializer = exprVisitor_.parseExpression();
       if (!initializer)
@@ -53,7 +55,7 @@ public:
     }
 
     // Create variable declaration with storage class
-    return std::make_shared<nodes::VarDeclNode>(
+    return context_.create<nodes::VarDeclNode>(
         name, type, initializer,
         storageClass, // Pass through the storage class
         isConst, location);
@@ -87,6 +89,7 @@ private:
 
   tokens::TokenStream &tokens_;
   core::ErrorReporter &errorReporter_;
+  parser::ASTContext &context_;
   IExpressionVisitor &exprVisitor_;
   IDeclarationVisitor &declVisitor_;
 };
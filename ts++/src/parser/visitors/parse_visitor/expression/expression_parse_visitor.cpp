@@ -8,18 +8,15 @@ namespace visitors {
 
 ExpressionParseVisitor::ExpressionParseVisitor(
     tokens::TokenStream &tokens, core::ErrorReporter &errorReporter,
-    IDeclarationVisitor *declVisitor, IStatementVisitor *stmtVisitor)
-    : tokens_(tokens), errorReporter_(errorReporter), declVisitor_(declVisitor),
-      stmtVisitor_(stmtVisitor), binaryVisitor_(tokens, errorReporter, *this),
-      unaryVisitor_(tokens, errorReporter, *this),
-      primaryVisitor_(tokens, errorReporter, *this),
-      callVisitor_(tokens, errorReporter, *this),
-      castVisitor_(tokens, errorReporter, *this) {}
+    parser::ASTContext &context, IDeclarationVisitor *declVisitor,
+    IStatementVisitor *stmtVisitor)
+    : tokens_(tokens), errorReporter_(errorReporter), context_(context),
+      declVisitor_(declVisitor), stmtVisitor_(stmtVisitor) {}
 
 nodes::ExpressionPtr ExpressionParseVisitor::parseExpression() {
   try {
     // Start with lowest precedence
-    return parseAssignment();
+    return parseBinding(0);
   } catch (const std::exception &e) {
     errorReporter_.error(tokens_.peek().getLocation(),
                          std::string("Error parsing expression: ") + e.what());
@@ -27,97 +24,243 @@ nodes::ExpressionPtr ExpressionParseVisitor::parseExpression() {
   }
 }
 
-nodes::ExpressionPtr ExpressionParseVisitor::parseAssignment() {
-  auto expr = parseComparison(); // Changed from parseAdditive to handle
-                                 // comparison operators
+nodes::ExpressionPtr ExpressionParseVisitor::parseBinding(
+    std::uint8_t minPower) {
+  auto expr = parsePrefix();
   if (!expr)
     return nullptr;
 
-  if (match(tokens::TokenType::EQUALS) ||
-      match(tokens::TokenType::PLUS_EQUALS) ||
-      match(tokens::TokenType::MINUS_EQUALS) ||
-      match(tokens::TokenType::STAR_EQUALS) ||
-      match(tokens::TokenType::SLASH_EQUALS)) {
-
-    auto op = tokens_.previous().getType();
-    auto value = parseAssignment();
-    if (!value)
+  // Every infix and postfix operator is one table lookup away
+  while (!tokens_.isAtEnd()) {
+    OperatorInfo info = getOperatorInfo(tokens_.peek().getType());
+    if (info.lbp <= minPower)
+      break;
+    expr = parseOperator(expr, info);
+    if (!expr)
       return nullptr;
-
-    return std::make_shared<nodes::AssignmentExpressionNode>(
-        expr->getLocation(), op, expr, value);
   }
-
   return expr;
 }
 
-nodes::ExpressionPtr ExpressionParseVisitor::parseComparison() {
-  auto expr = parseAdditive();
-  if (!expr)
-    return nullptr;
+nodes::ExpressionPtr ExpressionParseVisitor::parsePrefix() {
+  auto type = tokens_.peek().getType();
+  if (type == tokens::TokenType::NEW) {
+    tokens_.advance();
+    return parseNewExpression();
+  }
 
-  while (match(tokens::TokenType::LESS) ||
-         match(tokens::TokenType::LESS_EQUALS) ||
-         match(tokens::TokenType::GREATER) ||
-         match(tokens::TokenType::GREATER_EQUALS) ||
-         match(tokens::TokenType::EQUALS_EQUALS) ||
-         match(tokens::TokenType::EXCLAIM_EQUALS)) {
+  // 'await' and 'typeof' are keywords outside the operator table, but
+  // bind like '-'
+  if (type == tokens::TokenType::AWAIT || type == tokens::TokenType::TYPEOF ||
+      getOperatorInfo(type).prefix) {
+    auto op = tokens_.advance();
+    auto operand = parseBinding(kPrefix);
+    if (!operand)
+      return nullptr;
+    return context_.create<nodes::UnaryExpressionNode>(
+        op.getLocation(), op.getType(), operand, true // isPrefix = true
+    );
+  }
+
+  return parsePrimary();
+}
 
-    auto op = tokens_.previous().getType();
-    auto right = parseAdditive();
+nodes::ExpressionPtr
+ExpressionParseVisitor::parseOperator(nodes::ExpressionPtr left,
+                                      const OperatorInfo &info) {
+  auto op = tokens_.advance();
+  switch (info.kind) {
+  case OperatorKind::Binary:
+  case OperatorKind::Assignment: {
+    auto right = parseBinding(info.rbp);
     if (!right)
       return nullptr;
+    if (info.kind == OperatorKind::Assignment) {
+      return context_.create<nodes::AssignmentExpressionNode>(
+          left->getLocation(), op.getType(), left, right);
+    }
+    return context_.create<nodes::BinaryExpressionNode>(
+        left->getLocation(), op.getType(), left, right);
+  }
+
+  case OperatorKind::Postfix:
+    return context_.create<nodes::UnaryExpressionNode>(
+        op.getLocation(), op.getType(), left, false // isPrefix = false
+    );
 
-    expr = std::make_shared<nodes::BinaryExpressionNode>(expr->getLocation(),
-                                                         op, expr, right);
+  case OperatorKind::Call: {
+    std::vector<nodes::ExpressionPtr> arguments;
+    if (!parseArguments(arguments, "Expected ')' after function arguments")) {
+      return nullptr;
+    }
+    return context_.create<nodes::CallExpressionNode>(
+        left->getLocation(), left, std::move(arguments));
   }
 
-  return expr;
+  case OperatorKind::Member: {
+    if (!check(tokens::TokenType::IDENTIFIER)) {
+      error("Expected property name after '.'");
+      return nullptr;
+    }
+    auto member = tokens_.advance();
+    return context_.create<nodes::MemberExpressionNode>(
+        member.getLocation(), left,
+        core::Interner::instance().intern(member.getLexeme()),
+        false // isPointer flag (false for dot notation)
+    );
+  }
+
+  case OperatorKind::Index: {
+    auto index = parseExpression();
+    if (!index)
+      return nullptr;
+    if (!consume(tokens::TokenType::RIGHT_BRACKET,
+                 "Expected ']' after array index")) {
+      return nullptr;
+    }
+    return context_.create<nodes::IndexExpressionNode>(left->getLocation(),
+                                                       left, index);
+  }
+
+  case OperatorKind::None:
+    break;
+  }
+  error("Expected expression");
+  return nullptr;
 }
 
-nodes::ExpressionPtr ExpressionParseVisitor::parseAdditive() {
-  auto expr = parseMultiplicative();
-  if (!expr)
-    return nullptr;
+// Parses a primary expression (array literals, "this", identifiers, literals,
+// function expressions or parenthesized expressions)
+nodes::ExpressionPtr ExpressionParseVisitor::parsePrimary() {
+  if (match(tokens::TokenType::LEFT_BRACKET)) {
+    return parseArrayLiteral();
+  }
 
-  while (match(tokens::TokenType::PLUS) || match(tokens::TokenType::MINUS)) {
-    auto op = tokens_.previous().getType();
-    auto right = parseMultiplicative();
-    if (!right)
+  if (match(tokens::TokenType::THIS)) {
+    return context_.create<nodes::ThisExpressionNode>(
+        tokens_.previous().getLocation());
+  }
+
+  if (match(tokens::TokenType::IDENTIFIER)) {
+    auto token = tokens_.previous();
+    nodes::ExpressionPtr expr = context_.create<nodes::IdentifierExpressionNode>(
+        token.getLocation(),
+        core::Interner::instance().intern(token.getLexeme()));
+    // '<' after a name is a comparison unless type arguments and '(' follow
+    if (check(tokens::TokenType::LESS) && isGenericCall()) {
+      return parseGenericCall(expr);
+    }
+    return expr;
+  }
+
+  if (match(tokens::TokenType::NUMBER) ||
+      match(tokens::TokenType::STRING_LITERAL) ||
+      match(tokens::TokenType::TRUE) || match(tokens::TokenType::FALSE)) {
+    auto token = tokens_.previous();
+    return context_.create<nodes::LiteralExpressionNode>(
+        token.getLocation(), token.getType(),
+        core::Interner::instance().intern(token.getLexeme()));
+  }
+
+  if (match(tokens::TokenType::LEFT_PAREN)) {
+    auto expr = parseExpression();
+    if (!expr)
       return nullptr;
+    if (!consume(tokens::TokenType::RIGHT_PAREN,
+                 "Expected ')' after expression")) {
+      return nullptr;
+    }
+    return expr;
+  }
 
-    expr = std::make_shared<nodes::BinaryExpressionNode>(expr->getLocation(),
-                                                         op, expr, right);
+  if (check(tokens::TokenType::FUNCTION)) {
+    return parseFunctionExpression();
   }
 
-  return expr;
+  error("Expected expression");
+  return nullptr;
 }
 
-nodes::ExpressionPtr ExpressionParseVisitor::parseMultiplicative() {
-  auto expr = parseUnary();
-  if (!expr)
-    return nullptr;
+// Parses an array literal, e.g. [elem1, elem2, ...]
+nodes::ExpressionPtr ExpressionParseVisitor::parseArrayLiteral() {
+  auto location = tokens_.previous().getLocation();
+  std::vector<nodes::ExpressionPtr> elements;
 
-  while (match(tokens::TokenType::STAR) || match(tokens::TokenType::SLASH) ||
-         match(tokens::TokenType::PERCENT)) {
-    auto op = tokens_.previous().getType();
-    auto right = parseUnary();
-    if (!right)
+  if (match(tokens::TokenType::RIGHT_BRACKET)) {
+    return context_.create<nodes::ArrayLiteralNode>(location,
+                                                    std::move(elements));
+  }
+
+  do {
+    auto element = parseExpression();
+    if (!element)
       return nullptr;
+    elements.push_back(std::move(element));
+  } while (match(tokens::TokenType::COMMA));
 
-    expr = std::make_shared<nodes::BinaryExpressionNode>(expr->getLocation(),
-                                                         op, expr, right);
+  if (!consume(tokens::TokenType::RIGHT_BRACKET,
+               "Expected ']' after array elements")) {
+    return nullptr;
   }
 
-  return expr;
+  return context_.create<nodes::ArrayLiteralNode>(location,
+                                                  std::move(elements));
 }
 
-nodes::ExpressionPtr ExpressionParseVisitor::parsePrimary() {
-  return primaryVisitor_.parsePrimary();
+// Looks ahead, from a '<', for type arguments followed by '('
+bool ExpressionParseVisitor::isGenericCall() {
+  auto isTypeName = [this]() {
+    return check(tokens::TokenType::IDENTIFIER) ||
+           tokens::isType(tokens_.peek().getType());
+  };
+
+  size_t savedPos = tokens_.savePosition();
+  tokens_.advance(); // Consume '<'
+  bool isGeneric = false;
+  if (isTypeName()) {
+    tokens_.advance();
+    while (match(tokens::TokenType::COMMA) && isTypeName()) {
+      tokens_.advance();
+    }
+    isGeneric = match(tokens::TokenType::GREATER) &&
+                check(tokens::TokenType::LEFT_PAREN);
+  }
+  tokens_.restorePosition(savedPos);
+  return isGeneric;
 }
 
-nodes::ExpressionPtr ExpressionParseVisitor::parseUnary() {
-  return unaryVisitor_.parseUnary();
+// Parses a generic function call: identifier<Type>(args)
+nodes::ExpressionPtr
+ExpressionParseVisitor::parseGenericCall(nodes::ExpressionPtr callee) {
+  tokens_.advance(); // Consume '<', which isGenericCall has checked
+
+  std::vector<std::string> typeArgs;
+  do {
+    typeArgs.emplace_back(tokens_.advance().getLexeme());
+  } while (match(tokens::TokenType::COMMA));
+
+  tokens_.advance(); // Consume '>'
+  tokens_.advance(); // Consume '('
+  std::vector<nodes::ExpressionPtr> arguments;
+  if (!parseArguments(arguments, "Expected ')' after function arguments")) {
+    return nullptr;
+  }
+  return context_.create<nodes::CallExpressionNode>(
+      callee->getLocation(), callee, std::move(arguments), std::move(typeArgs));
+}
+
+// Parses arguments up to and including the ')' after them
+bool ExpressionParseVisitor::parseArguments(
+    std::vector<nodes::ExpressionPtr> &arguments, const std::string &message) {
+  if (!check(tokens::TokenType::RIGHT_PAREN)) {
+    do {
+      auto arg = parseExpression();
+      if (!arg)
+        return false;
+      arguments.push_back(std::move(arg));
+    } while (match(tokens::TokenType::COMMA));
+  }
+  return consume(tokens::TokenType::RIGHT_PAREN, message);
 }
 
 nodes::TypePtr ExpressionParseVisitor::parseType() {
@@ -144,7 +287,7 @@ nodes::TypePtr ExpressionParseVisitor::parseType() {
     return nullptr;
   }
 
-  return std::make_shared<nodes::NamedTypeNode>(typeName, location);
+  return context_.create<nodes::NamedTypeNode>(typeName, location);
 }
 
 nodes::ExpressionPtr ExpressionParseVisitor::parseNewExpression() {
@@ -156,7 +299,27 @@ nodes::ExpressionPtr ExpressionParseVisitor::parseNewExpression() {
     return nullptr;
   }
 
-  std::string className = tokens_.previous().getLexeme();
+  std::string className(tokens_.previous().getLexeme());
+
+  // Parse type arguments of a generic class: new Box<int>()
+  std::vector<std::string> typeArguments;
+  if (match(tokens::TokenType::LESS)) {
+    do {
+      if (!check(tokens::TokenType::IDENTIFIER) &&
+          !(tokens_.peek().getType() >= tokens::TokenType::TYPE_BEGIN &&
+            tokens_.peek().getType() <= tokens::TokenType::TYPE_END)) {
+        error("Expected type name in generic type arguments");
+        return nullptr;
+      }
+      typeArguments.emplace_back(tokens_.peek().getLexeme());
+      tokens_.advance();
+    } while (match(tokens::TokenType::COMMA));
+
+    if (!consume(tokens::TokenType::GREATER,
+                 "Expected '>' after generic type arguments")) {
+      return nullptr;
+    }
+  }
 
   // Parse constructor arguments
   if (!consume(tokens::TokenType::LEFT_PAREN,
@@ -165,22 +328,12 @@ nodes::ExpressionPtr ExpressionParseVisitor::parseNewExpression() {
   }
 
   std::vector<nodes::ExpressionPtr> arguments;
-  if (!check(tokens::TokenType::RIGHT_PAREN)) {
-    do {
-      auto arg = parseExpression();
-      if (!arg)
-        return nullptr;
-      arguments.push_back(std::move(arg));
-    } while (match(tokens::TokenType::COMMA));
-  }
-
-  if (!consume(tokens::TokenType::RIGHT_PAREN,
-               "Expected ')' after constructor arguments")) {
+  if (!parseArguments(arguments, "Expected ')' after constructor arguments")) {
     return nullptr;
   }
 
-  return std::make_shared<nodes::NewExpressionNode>(location, className,
-                                                    std::move(arguments));
+  return context_.create<nodes::NewExpressionNode>(
+      location, className, std::move(arguments), std::move(typeArguments));
 }
 
 // Add to ExpressionParseVisitor class
@@ -216,7 +369,7 @@ nodes::ExpressionPtr ExpressionParseVisitor::parseFunctionExpression() {
   }
 
   // Parse optional return type
-  nodes::TypePtr returnType;
+  nodes::TypePtr returnType = nullptr;
   if (match(tokens::TokenType::COLON)) {
     returnType = declVisitor_->parseType();
     if (!returnType) {
@@ -236,7 +389,7 @@ nodes::ExpressionPtr ExpressionParseVisitor::parseFunctionExpression() {
   }
 
   // Create a function expression node
-  return std::make_shared<nodes::FunctionExpressionNode>(
+  return context_.create<nodes::FunctionExpressionNode>(
       std::move(parameters), std::move(returnType), std::move(body), location);
 }
 // Add to ExpressionParseVisitor class in expression_parse_visitor.cpp
@@ -258,7 +411,7 @@ nodes::ParamPtr ExpressionParseVisitor::parseParameter() {
     error("Expected parameter name");
     return nullptr;
   }
-  auto name = tokens_.previous().getLexeme();
+  std::string name(tokens_.previous().getLexeme());
 
   // Parse parameter type
   if (!consume(tokens::TokenType::COLON, "Expected ':' after parameter name")) {
@@ -287,7 +440,7 @@ nodes::ParamPtr ExpressionParseVisitor::parseParameter() {
   }
 
   // Create parameter node with ref/const flags
-  return std::make_shared<nodes::ParameterNode>(
+  return context_.create<nodes::ParameterNode>(
       name, std::move(type), std::move(defaultValue), isRef, isConst, location);
 }
 
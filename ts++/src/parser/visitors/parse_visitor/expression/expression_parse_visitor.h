@@ -1,21 +1,22 @@
 #pragma once
-#include "binary_visitor.h"
-#include "call_visitor.h"
-#include "cast_visitor.h"
+#include "core/diagnostics/error_reporter.h"
 #include "iexpression_visitor.h"
+#include "operator_table.h"
+#include "parser/ast_context.h"
 #include "parser/nodes/expression_nodes.h"
 #include "parser/nodes/type_nodes.h"
 #include "parser/visitors/parse_visitor/declaration/ideclaration_visitor.h"
 #include "parser/visitors/parse_visitor/statement/istatement_visitor.h"
-#include "primary_visitor.h"
-#include "unary_visitor.h"
+#include "tokens/stream/token_stream.h"
 #include <cassert>
+#include <vector>
 
 namespace visitors {
 class ExpressionParseVisitor : public IExpressionVisitor {
 public:
   ExpressionParseVisitor(tokens::TokenStream &tokens,
                          core::ErrorReporter &errorReporter,
+                         parser::ASTContext &context,
                          IDeclarationVisitor *declVisitor = nullptr,
                          IStatementVisitor *stmtVisitor = nullptr);
 
@@ -29,25 +30,24 @@ public:
   }
   // Main public interface
   nodes::ExpressionPtr parseExpression() override;
-  nodes::ExpressionPtr parsePrimary() override;
-  nodes::ExpressionPtr parseUnary() override;
   nodes::TypePtr parseType() override;
   nodes::ExpressionPtr parseNewExpression() override;
   nodes::ExpressionPtr parseFunctionExpression() override;
-  nodes::ExpressionPtr parseAdditive();
-  nodes::ExpressionPtr parseAssignment();
-  nodes::ExpressionPtr parseMultiplicative();
-  nodes::ExpressionPtr parseComparison();
   nodes::ParamPtr parseParameter();
 
-  // Friend declarations for sub-visitors
-  friend class BinaryExpressionVisitor;
-  friend class UnaryExpressionVisitor;
-  friend class PrimaryExpressionVisitor;
-  friend class CallExpressionVisitor;
-  friend class CastExpressionVisitor;
-
 private:
+  // Pratt parsing, driven by kOperatorTable
+  nodes::ExpressionPtr parseBinding(std::uint8_t minPower);
+  nodes::ExpressionPtr parsePrefix();
+  nodes::ExpressionPtr parseOperator(nodes::ExpressionPtr left,
+                                     const OperatorInfo &info);
+  nodes::ExpressionPtr parsePrimary();
+  nodes::ExpressionPtr parseArrayLiteral();
+  nodes::ExpressionPtr parseGenericCall(nodes::ExpressionPtr callee);
+  bool isGenericCall();
+  bool parseArguments(std::vector<nodes::ExpressionPtr> &arguments,
+                      const std::string &message);
+
   // Utility methods
   bool match(tokens::TokenType type);
   bool check(tokens::TokenType type) const;
@@ -63,16 +63,10 @@ private:
   // Member variables
   tokens::TokenStream &tokens_;
   core::ErrorReporter &errorReporter_;
+  parser::ASTContext &context_;
 
   IDeclarationVisitor *declVisitor_ = nullptr;
   IStatementVisitor *stmtVisitor_ = nullptr;
-
-  // Sub-visitors
-  BinaryExpressionVisitor binaryVisitor_;
-  UnaryExpressionVisitor unaryVisitor_;
-  PrimaryExpressionVisitor primaryVisitor_;
-  CallExpressionVisitor callVisitor_;
-  CastExpressionVisitor castVisitor_;
 };
 
 } // namespace visitors
@@ -8,10 +8,8 @@ class IExpressionVisitor {
 public:
   virtual ~IExpressionVisitor() = default;
 
-  // Core parsing methods required by sub-visitors
+  // Core parsing methods required by the declaration and statement visitors
   virtual nodes::ExpressionPtr parseExpression() = 0;
-  virtual nodes::ExpressionPtr parsePrimary() = 0;
-  virtual nodes::ExpressionPtr parseUnary() = 0;
   virtual nodes::TypePtr parseType() = 0;
   virtual nodes::ExpressionPtr parseNewExpression() = 0;
   virtual nodes::ExpressionPtr parseFunctionExpression() = 0;
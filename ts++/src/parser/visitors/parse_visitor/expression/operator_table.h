@@ -0,0 +1,112 @@
+#pragma once
+#include "tokens/token_type.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace visitors {
+
+// What an operator token builds when it follows an operand
+enum class OperatorKind : std::uint8_t {
+  None,       // Ends the expression
+  Binary,     // a + b
+  Assignment, // a = b, a += b
+  Postfix,    // a++
+  Call,       // a(b)
+  Member,     // a.b
+  Index       // a[b]
+};
+
+/**
+ * @brief How an operator token binds to the operands around it
+ *
+ * A Pratt parser keeps extending its left operand while the next token's
+ * left binding power is above the one it was called with, and parses the
+ * right operand with the right binding power. An rbp equal to the lbp
+ * makes the operator left associative; one below it, right associative.
+ */
+struct OperatorInfo {
+  std::uint8_t lbp = 0;
+  std::uint8_t rbp = 0;
+  OperatorKind kind = OperatorKind::None;
+  bool prefix = false; // Also a prefix operator, whose operand binds at kPrefix
+};
+
+// Binding powers, from loosest to tightest
+constexpr std::uint8_t kAssignment = 10;
+constexpr std::uint8_t kComparison = 20; // Equality shares this level
+constexpr std::uint8_t kAdditive = 30;
+constexpr std::uint8_t kMultiplicative = 40;
+constexpr std::uint8_t kPrefix = 50;
+constexpr std::uint8_t kPostfix = 60;
+
+// Operators and delimiters are adjacent ranges, so one array covers both
+static_assert(static_cast<int>(tokens::TokenType::DELIMITER_BEGIN) ==
+              static_cast<int>(tokens::TokenType::OPERATOR_END) + 1);
+constexpr std::size_t kOperatorTableSize =
+    static_cast<std::size_t>(tokens::TokenType::DELIMITER_END) -
+    static_cast<std::size_t>(tokens::TokenType::OPERATOR_BEGIN) + 1;
+
+constexpr std::size_t operatorIndex(tokens::TokenType type) {
+  return static_cast<std::size_t>(type) -
+         static_cast<std::size_t>(tokens::TokenType::OPERATOR_BEGIN);
+}
+
+constexpr std::array<OperatorInfo, kOperatorTableSize> kOperatorTable = [] {
+  using tokens::TokenType;
+  std::array<OperatorInfo, kOperatorTableSize> table{};
+  auto left = [&](TokenType type, std::uint8_t power) {
+    table[operatorIndex(type)] = {power, power, OperatorKind::Binary, false};
+  };
+  auto assign = [&](TokenType type) {
+    std::uint8_t rbp = kAssignment - 1;
+    table[operatorIndex(type)] = {kAssignment, rbp, OperatorKind::Assignment,
+                                  false};
+  };
+  auto postfix = [&](TokenType type, OperatorKind kind) {
+    table[operatorIndex(type)] = {kPostfix, 0, kind, false};
+  };
+
+  assign(TokenType::EQUALS);
+  assign(TokenType::PLUS_EQUALS);
+  assign(TokenType::MINUS_EQUALS);
+  assign(TokenType::STAR_EQUALS);
+  assign(TokenType::SLASH_EQUALS);
+
+  left(TokenType::LESS, kComparison);
+  left(TokenType::LESS_EQUALS, kComparison);
+  left(TokenType::GREATER, kComparison);
+  left(TokenType::GREATER_EQUALS, kComparison);
+  left(TokenType::EQUALS_EQUALS, kComparison);
+  left(TokenType::EXCLAIM_EQUALS, kComparison);
+  left(TokenType::PLUS, kAdditive);
+  left(TokenType::MINUS, kAdditive);
+  left(TokenType::STAR, kMultiplicative);
+  left(TokenType::SLASH, kMultiplicative);
+  left(TokenType::PERCENT, kMultiplicative);
+
+  postfix(TokenType::PLUS_PLUS, OperatorKind::Postfix);
+  postfix(TokenType::MINUS_MINUS, OperatorKind::Postfix);
+  postfix(TokenType::LEFT_PAREN, OperatorKind::Call);
+  postfix(TokenType::DOT, OperatorKind::Member);
+  postfix(TokenType::LEFT_BRACKET, OperatorKind::Index);
+
+  // '-' and '*' are infix too; '@' dereferences and '~' complements
+  for (TokenType type : {TokenType::MINUS, TokenType::EXCLAIM, TokenType::TILDE,
+                         TokenType::PLUS_PLUS, TokenType::MINUS_MINUS,
+                         TokenType::STAR, TokenType::AT}) {
+    table[operatorIndex(type)].prefix = true;
+  }
+  return table;
+}();
+
+// The binding of a token; tokens outside the table end an expression
+constexpr OperatorInfo getOperatorInfo(tokens::TokenType type) {
+  if (type < tokens::TokenType::OPERATOR_BEGIN ||
+      type > tokens::TokenType::DELIMITER_END) {
+    return {};
+  }
+  return kOperatorTable[operatorIndex(type)];
+}
+
+} // namespace visitors
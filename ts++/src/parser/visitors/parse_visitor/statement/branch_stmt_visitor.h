@@ -1,5 +1,6 @@
 #pragma once
 #include "core/diagnostics/error_reporter.h"
+#include "parser/ast_context.h"
 #include "parser/nodes/statement_nodes.h"
 #include "parser/visitors/parse_visitor/expression/iexpression_visitor.h"
 #include "parser/visitors/parse_visitor/statement/istatement_visitor.h"
@@ -16,9 +17,10 @@ class BranchStatementVisitor {
 public:
   BranchStatementVisitor(tokens::TokenStream &tokens,
                          core::ErrorReporter &errorReporter,
+                         parser::ASTContext &context,
                          IExpressionVisitor &exprVisitor,
                          IStatementVisitor &stmtVisitor)
-      : tokens_(tokens), errorReporter_(errorReporter),
+      : tokens_(tokens), errorReporter_(errorReporter), context_(context),
         exprVisitor_(exprVisitor), stmtVisitor_(stmtVisitor) {}
 
   nodes::StmtPtr parseIfStatement() {
@@ -46,7 +48,7 @@ public:
     }
 
     // Parse optional else branch
-    nodes::StmtPtr elseBranch;
+    nodes::StmtPtr elseBranch = nullptr;
     if (match(tokens::TokenType::ELSE)) {
       elseBranch = stmtVisitor_.parseStatement();
       if (!elseBranch) {
@@ -54,8 +56,8 @@ public:
       }
     }
 
-    return std::make_shared<nodes::IfStmtNode>(condition, thenBranch,
-                                               elseBranch, location);
+    return context_.create<nodes::IfStmtNode>(condition, thenBranch,
+                                              elseBranch, location);
   }
 
   nodes::StmtPtr parseSwitchStatement() {
@@ -148,7 +150,8 @@ public:
       return nullptr;
     }
     
-    return std::make_shared<nodes::SwitchStmtNode>(expression, std::move(cases), location);
+    return context_.create<nodes::SwitchStmtNode>(expression, std::move(cases),
+                                                  location);
   }
 
 private:
@@ -179,6 +182,7 @@ private:
 
   tokens::TokenStream &tokens_;
   core::ErrorReporter &errorReporter_;
+  parser::ASTContext &context_;
   IExpressionVisitor &exprVisitor_;
   IStatementVisitor &stmtVisitor_;
   ;
@@ -1,5 +1,6 @@
 #pragma once
 #include "core/diagnostics/error_reporter.h"
+#include "parser/ast_context.h"
 #include "parser/nodes/statement_nodes.h"
 #include "parser/visitors/parse_visitor/expression/iexpression_visitor.h"
 #include "tokens/stream/token_stream.h"
@@ -12,13 +13,14 @@ class FlowControlVisitor {
 public:
   FlowControlVisitor(tokens::TokenStream &tokens,
                      core::ErrorReporter &errorReporter,
+                     parser::ASTContext &context,
                      IExpressionVisitor &exprVisitor)
-      : tokens_(tokens), errorReporter_(errorReporter),
+      : tokens_(tokens), errorReporter_(errorReporter), context_(context),
         exprVisitor_(exprVisitor) {}
 
   nodes::StmtPtr parseReturn() {
     auto location = tokens_.previous().getLocation();
-    nodes::ExpressionPtr value;
+    nodes::ExpressionPtr value = nullptr;
 
     // Check for value after return
     if (tokens_.peek().getLexeme() != ";") {
@@ -33,7 +35,7 @@ public:
     }
     tokens_.advance(); // Consume semicolon
 
-    return std::make_shared<nodes::ReturnStmtNode>(value, location);
+    return context_.create<nodes::ReturnStmtNode>(value, location);
   }
 
   nodes::StmtPtr parseBreak() {
@@ -52,7 +54,7 @@ public:
     }
     tokens_.advance();
 
-    return std::make_shared<nodes::BreakStmtNode>(std::move(label), location);
+    return context_.create<nodes::BreakStmtNode>(std::move(label), location);
   }
 
   nodes::StmtPtr parseContinue() {
@@ -71,8 +73,8 @@ public:
     }
     tokens_.advance();
 
-    return std::make_shared<nodes::ContinueStmtNode>(std::move(label),
-                                                     location);
+    return context_.create<nodes::ContinueStmtNode>(std::move(label),
+                                                    location);
   }
 
   nodes::StmtPtr parseThrow() {
@@ -88,7 +90,7 @@ public:
     }
     tokens_.advance();
 
-    return std::make_shared<nodes::ThrowStmtNode>(value, location);
+    return context_.create<nodes::ThrowStmtNode>(value, location);
   }
 
 private:
@@ -119,6 +121,7 @@ private:
 
   tokens::TokenStream &tokens_;
   core::ErrorReporter &errorReporter_;
+  parser::ASTContext &context_;
   IExpressionVisitor &exprVisitor_;
 };
 
@@ -1,5 +1,6 @@
 #pragma once
 #include "core/diagnostics/error_reporter.h"
+#include "parser/ast_context.h"
 #include "parser/nodes/statement_nodes.h"
 #include "parser/visitors/parse_visitor/expression/iexpression_visitor.h"
 #include "parser/visitors/parse_visitor/statement/istatement_visitor.h"
@@ -11,9 +12,10 @@ class LoopStatementVisitor {
 public:
   LoopStatementVisitor(tokens::TokenStream &tokens,
                        core::ErrorReporter &errorReporter,
+                       parser::ASTContext &context,
                        IExpressionVisitor &exprVisitor,
                        IStatementVisitor &stmtVisitor)
-      : tokens_(tokens), errorReporter_(errorReporter),
+      : tokens_(tokens), errorReporter_(errorReporter), context_(context),
         exprVisitor_(exprVisitor), stmtVisitor_(stmtVisitor) {}
 
   // Parse while statement: while (condition) statement
@@ -37,7 +39,7 @@ public:
     if (!body)
       return nullptr;
 
-    return std::make_shared<nodes::WhileStmtNode>(condition, body, location);
+    return context_.create<nodes::WhileStmtNode>(condition, body, location);
   }
 
   // Parse do-while statement: do statement while (condition);
@@ -70,12 +72,12 @@ public:
       return nullptr;
     }
 
-    return std::make_shared<nodes::DoWhileStmtNode>(body, condition, location);
+    return context_.create<nodes::DoWhileStmtNode>(body, condition, location);
   }
 
   // Parse for statement: for (init; condition; increment) statement
-  // Parse for statement: for (init; condition; increment) statement
-  nodes::StmtPtr parseForStatement() {
+  // isParallel is set after '#parallel', which only a for-of may follow
+  nodes::StmtPtr parseForStatement(bool isParallel = false) {
     auto location = tokens_.previous().getLocation();
 
     if (!consume(tokens::TokenType::LEFT_PAREN, "Expected '(' after 'for'")) {
@@ -88,6 +90,9 @@ public:
       isConst = true;
     } else if (match(tokens::TokenType::LET)) {
       isConst = false;
+    } else if (isParallel) {
+      error("#parallel applies to for-of loops");
+      return nullptr;
     } else {
       return parseTraditionalFor(location);
     }
@@ -96,10 +101,10 @@ public:
       error("Expected variable name in for loop");
       return nullptr;
     }
-    auto identifier = tokens_.previous().getLexeme();
+    std::string identifier(tokens_.previous().getLexeme());
 
     // Optional type annotation
-    nodes::TypePtr type;
+    nodes::TypePtr type = nullptr;
     if (match(tokens::TokenType::COLON)) {
       type = exprVisitor_.parseType();
       if (!type)
@@ -121,8 +126,13 @@ public:
       if (!body)
         return nullptr;
 
-      return std::make_shared<nodes::ForOfStmtNode>(isConst, identifier,
-                                                    iterable, body, location);
+      return context_.create<nodes::ForOfStmtNode>(
+          isConst, identifier, iterable, body, location, isParallel);
+    }
+
+    if (isParallel) {
+      error("#parallel applies to for-of loops");
+      return nullptr;
     }
 
     // Regular for loop with variable declaration
@@ -147,8 +157,8 @@ private:
     if (!body)
       return nullptr;
 
-    return std::make_shared<nodes::ForOfStmtNode>(isConst, identifier, iterable,
-                                                  body, location);
+    return context_.create<nodes::ForOfStmtNode>(isConst, identifier, iterable,
+                                                 body, location);
   }
 
   // Parse regular for loop with variable declaration
@@ -166,13 +176,13 @@ private:
       return nullptr;
 
     // Create variable declaration
-    auto varDecl = std::make_shared<nodes::VarDeclNode>(
+    auto varDecl = context_.create<nodes::VarDeclNode>(
         identifier, varType, initialValue, tokens::TokenType::ERROR_TOKEN,
         isConst, location);
 
     // Create declaration statement
     auto initializer =
-        std::make_shared<nodes::DeclarationStmtNode>(varDecl, location);
+        context_.create<nodes::DeclarationStmtNode>(varDecl, location);
 
     if (!consume(tokens::TokenType::SEMICOLON,
                  "Expected ';' after for loop initializer")) {
@@ -184,7 +194,7 @@ private:
 
   // Parse traditional for loop (no declaration)
   nodes::StmtPtr parseTraditionalFor(const core::SourceLocation &location) {
-    nodes::StmtPtr initializer;
+    nodes::StmtPtr initializer = nullptr;
     if (!match(tokens::TokenType::SEMICOLON)) {
       auto expr = exprVisitor_.parseExpression();
       if (!expr)
@@ -195,7 +205,7 @@ private:
         return nullptr;
       }
 
-      initializer = std::make_shared<nodes::ExpressionStmtNode>(expr, location);
+      initializer = context_.create<nodes::ExpressionStmtNode>(expr, location);
     }
 
     return parseForRest(location, initializer);
@@ -205,7 +215,7 @@ private:
   nodes::StmtPtr parseForRest(const core::SourceLocation &location,
                               nodes::StmtPtr initializer) {
     // Parse condition
-    nodes::ExpressionPtr condition;
+    nodes::ExpressionPtr condition = nullptr;
     if (!match(tokens::TokenType::SEMICOLON)) {
       condition = exprVisitor_.parseExpression();
       if (!condition)
@@ -218,7 +228,7 @@ private:
     }
 
     // Parse increment
-    nodes::ExpressionPtr increment;
+    nodes::ExpressionPtr increment = nullptr;
     if (!check(tokens::TokenType::RIGHT_PAREN)) {
       increment = exprVisitor_.parseExpression();
       if (!increment)
@@ -234,8 +244,8 @@ private:
     if (!body)
       return nullptr;
 
-    return std::make_shared<nodes::ForStmtNode>(initializer, condition,
-                                                increment, body, location);
+    return context_.create<nodes::ForStmtNode>(initializer, condition,
+                                               increment, body, location);
   }
 
   // Utility methods
@@ -266,6 +276,7 @@ private:
 
   tokens::TokenStream &tokens_;
   core::ErrorReporter &errorReporter_;
+  parser::ASTContext &context_;
   IExpressionVisitor &exprVisitor_;
   IStatementVisitor &stmtVisitor_;
 };
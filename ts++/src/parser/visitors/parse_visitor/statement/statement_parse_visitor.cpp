@@ -18,7 +18,7 @@ nodes::StmtPtr StatementParseVisitor::parseExpressionStatement() {
   if (tokens_.peek().getType() == tokens::TokenType::IDENTIFIER &&
       tokens_.peekNext().getLexeme() == ":") {
     auto location = tokens_.peek().getLocation();
-    auto label = tokens_.advance().getLexeme();
+    std::string label(tokens_.advance().getLexeme());
 
     // Consume the colon
     tokens_.advance();
@@ -28,7 +28,7 @@ nodes::StmtPtr StatementParseVisitor::parseExpressionStatement() {
     if (!statement)
       return nullptr;
 
-    return std::make_shared<nodes::LabeledStatementNode>(
+    return context_.create<nodes::LabeledStatementNode>(
         label, std::move(statement), location);
   }
 
@@ -42,11 +42,11 @@ nodes::StmtPtr StatementParseVisitor::parseExpressionStatement() {
   }
   tokens_.advance();
 
-  return std::make_shared<nodes::ExpressionStmtNode>(expr, location);
+  return context_.create<nodes::ExpressionStmtNode>(expr, location);
 }
 
 nodes::StmtPtr StatementParseVisitor::parseAssemblyStatement() {
-  auto location = tokens_.previous().getLocation();
+  auto location = tokens_.peek().getLocation();
   tokens_.advance();
   if (tokens_.peek().getLexeme() != "(") {
     error("Expected '(' after '#asm'");
@@ -58,35 +58,93 @@ nodes::StmtPtr StatementParseVisitor::parseAssemblyStatement() {
     error("Expected string literal containing assembly code");
     return nullptr;
   }
-  std::string asmCode = tokens_.peek().getLexeme();
+  std::string asmCode(tokens_.peek().getLexeme());
   tokens_.advance();
 
-  std::vector<std::string> constraints;
-
-  while (tokens_.peek().getLexeme() == ",") {
-    tokens_.advance();
-    if (tokens_.peek().getType() != tokens::TokenType::STRING_LITERAL) {
-      error("Expected constraint string");
+  // A ':' makes the code a template with GCC-style operand sections
+  if (!match(tokens::TokenType::COLON)) {
+    if (!consume(tokens::TokenType::RIGHT_PAREN,
+                 "Expected ')' after assembly code") ||
+        !consume(tokens::TokenType::SEMICOLON,
+                 "Expected ';' after assembly statement")) {
       return nullptr;
     }
-    constraints.push_back(tokens_.peek().getLexeme());
-    tokens_.advance();
+    return context_.create<nodes::AssemblyStmtNode>(asmCode, location);
   }
 
-  if (tokens_.peek().getLexeme() != ")") {
-    error("Expected ')' after assembly code");
+  std::vector<nodes::AsmOperand> outputs;
+  std::vector<nodes::AsmOperand> inputs;
+  std::vector<std::string> clobbers;
+  if (!parseAssemblyOperands(outputs)) {
     return nullptr;
   }
-  tokens_.advance();
+  if (match(tokens::TokenType::COLON)) {
+    if (!parseAssemblyOperands(inputs)) {
+      return nullptr;
+    }
+    if (match(tokens::TokenType::COLON) &&
+        check(tokens::TokenType::STRING_LITERAL)) {
+      do {
+        if (!check(tokens::TokenType::STRING_LITERAL)) {
+          error("Expected clobbered register");
+          return nullptr;
+        }
+        clobbers.emplace_back(tokens_.advance().getLexeme());
+      } while (match(tokens::TokenType::COMMA));
+    }
+  }
 
-  if (tokens_.peek().getLexeme() != ";") {
-    error("Expected ';' after assembly statement");
+  if (!consume(tokens::TokenType::RIGHT_PAREN,
+               "Expected ')' after assembly operands") ||
+      !consume(tokens::TokenType::SEMICOLON,
+               "Expected ';' after assembly statement")) {
     return nullptr;
   }
-  tokens_.advance();
+  return context_.create<nodes::AssemblyStmtNode>(
+      asmCode, std::move(outputs), std::move(inputs), std::move(clobbers),
+      location);
+}
 
-  return std::make_shared<nodes::AssemblyStmtNode>(
-      asmCode, std::move(constraints), location);
+bool StatementParseVisitor::parseAssemblyOperands(
+    std::vector<nodes::AsmOperand> &operands) {
+  // A section may be empty
+  if (!check(tokens::TokenType::STRING_LITERAL) &&
+      !check(tokens::TokenType::LEFT_BRACKET)) {
+    return true;
+  }
+  do {
+    std::string name;
+    if (match(tokens::TokenType::LEFT_BRACKET)) {
+      if (!consume(tokens::TokenType::IDENTIFIER,
+                   "Expected operand name after '['")) {
+        return false;
+      }
+      name = std::string(tokens_.previous().getLexeme());
+      if (!consume(tokens::TokenType::RIGHT_BRACKET,
+                   "Expected ']' after operand name")) {
+        return false;
+      }
+    }
+    if (!check(tokens::TokenType::STRING_LITERAL)) {
+      error("Expected operand constraint string");
+      return false;
+    }
+    std::string constraint(tokens_.advance().getLexeme());
+    if (!consume(tokens::TokenType::LEFT_PAREN,
+                 "Expected '(' after operand constraint")) {
+      return false;
+    }
+    auto expression = exprVisitor_.parseExpression();
+    if (!expression) {
+      return false;
+    }
+    if (!consume(tokens::TokenType::RIGHT_PAREN,
+                 "Expected ')' after operand expression")) {
+      return false;
+    }
+    operands.emplace_back(std::move(name), std::move(constraint), expression);
+  } while (match(tokens::TokenType::COMMA));
+  return true;
 }
 
 } // namespace visitors
\ No newline at end of file
@@ -18,13 +18,14 @@ class StatementParseVisitor : public IStatementVisitor {
 public:
   StatementParseVisitor(tokens::TokenStream &tokens,
                         core::ErrorReporter &errorReporter,
+                        parser::ASTContext &context,
                         IExpressionVisitor &exprVisitor)
-      : tokens_(tokens), errorReporter_(errorReporter),
+      : tokens_(tokens), errorReporter_(errorReporter), context_(context),
         exprVisitor_(exprVisitor),
-        branchVisitor_(tokens, errorReporter, exprVisitor, *this),
-        loopVisitor_(tokens, errorReporter, exprVisitor, *this),
-        flowVisitor_(tokens, errorReporter, exprVisitor),
-        tryVisitor_(tokens, errorReporter, *this) {}
+        branchVisitor_(tokens, errorReporter, context, exprVisitor, *this),
+        loopVisitor_(tokens, errorReporter, context, exprVisitor, *this),
+        flowVisitor_(tokens, errorReporter, context, exprVisitor),
+        tryVisitor_(tokens, errorReporter, context, exprVisitor, *this) {}
 
   void setDeclarationVisitor(IDeclarationVisitor *declVisitor) {
     declVisitor_ = declVisitor;
@@ -36,7 +37,7 @@ public:
       if (tokens_.peek().getType() == tokens::TokenType::IDENTIFIER &&
           tokens_.peekNext().getLexeme() == ":") {
         // This is a labeled statement
-        auto label = tokens_.peek().getLexeme();
+        std::string label(tokens_.peek().getLexeme());
         auto location = tokens_.peek().getLocation();
 
         // Consume the identifier and colon
@@ -49,15 +50,15 @@ public:
           return nullptr;
 
         // Create a labeled statement node
-        return std::make_shared<nodes::LabeledStatementNode>(label, statement,
-                                                             location);
+        return context_.create<nodes::LabeledStatementNode>(label, statement,
+                                                            location);
       }
 
       // Special handling for return statements
       if (tokens_.peek().getLexeme() == "return") {
         tokens_.advance(); // Consume "return"
         auto location = tokens_.previous().getLocation();
-        nodes::ExpressionPtr value;
+        nodes::ExpressionPtr value = nullptr;
 
         // Check for value after return
         if (tokens_.peek().getLexeme() != ";") {
@@ -72,7 +73,7 @@ public:
         }
         tokens_.advance(); // Consume semicolon
 
-        return std::make_shared<nodes::ReturnStmtNode>(value, location);
+        return context_.create<nodes::ReturnStmtNode>(value, location);
       }
 
       // Check for declarations
@@ -111,6 +112,32 @@ public:
         return loopVisitor_.parseForStatement();
       }
 
+      if (tokens_.peek().getType() == tokens::TokenType::PARALLEL) {
+        tokens_.advance();
+        if (tokens_.peek().getLexeme() != "for") {
+          error("Expected 'for' after '#parallel'");
+          return nullptr;
+        }
+        tokens_.advance();
+        return loopVisitor_.parseForStatement(true);
+      }
+
+      if (tokens_.peek().getType() == tokens::TokenType::ARENA) {
+        auto location = tokens_.peek().getLocation();
+        tokens_.advance();
+        if (tokens_.peek().getLexeme() != "{") {
+          error("Expected '{' after '#arena'");
+          return nullptr;
+        }
+        tokens_.advance();
+        auto block = parseBlock();
+        if (!block) {
+          return nullptr;
+        }
+        return context_.create<nodes::BlockNode>(block->getStatements(),
+                                                 location, true);
+      }
+
       if (tokens_.peek().getLexeme() == "try") {
         tokens_.advance();
         return tryVisitor_.parseTryStatement();
@@ -172,7 +199,7 @@ public:
     // Advance past the closing brace
     tokens_.advance();
 
-    return std::make_shared<nodes::BlockNode>(std::move(statements), location);
+    return context_.create<nodes::BlockNode>(std::move(statements), location);
   }
 
 private:
@@ -180,24 +207,30 @@ private:
     // Let the declaration visitor handle the declaration
     if (auto decl = declVisitor_->parseDeclaration()) {
       // Wrap it in a statement node
-      return std::make_shared<nodes::DeclarationStmtNode>(std::move(decl),
-                                                          decl->getLocation());
+      return context_.create<nodes::DeclarationStmtNode>(std::move(decl),
+                                                         decl->getLocation());
     }
     return nullptr;
   }
 
   bool isDeclarationStart() const {
-    std::string lexeme = tokens_.peek().getLexeme();
-    // Check for class-related declarations using lexemes
-    return lexeme == "let" || lexeme == "const" || lexeme == "function" ||
-           lexeme == "class" || lexeme == "constructor" || lexeme == "public" ||
-           lexeme == "private" || lexeme == "protected" || lexeme == "stack" ||
-           lexeme == "heap" || lexeme == "static" || lexeme == "aligned" ||
-           lexeme == "packed" || lexeme == "abstract";
+    static constexpr tokens::TokenSet kDeclarationStart = {
+        tokens::TokenType::LET,         tokens::TokenType::CONST,
+        tokens::TokenType::FUNCTION,    tokens::TokenType::CLASS,
+        tokens::TokenType::CONSTRUCTOR, tokens::TokenType::PUBLIC,
+        tokens::TokenType::PRIVATE,     tokens::TokenType::PROTECTED,
+        tokens::TokenType::STACK,       tokens::TokenType::HEAP,
+        tokens::TokenType::STATIC,      tokens::TokenType::ALIGNED,
+        tokens::TokenType::PACKED,      tokens::TokenType::ABSTRACT,
+        tokens::TokenType::ASYNC,       tokens::TokenType::EXTERN,
+        tokens::TokenType::COMPTIME};
+    return tokens_.checkAny(kDeclarationStart);
   }
 
   nodes::StmtPtr parseExpressionStatement();
   nodes::StmtPtr parseAssemblyStatement();
+  // Parses one comma-separated section of [name] "constraint"(expression)
+  bool parseAssemblyOperands(std::vector<nodes::AsmOperand> &operands);
 
   // Utility methods
   inline bool match(tokens::TokenType type) {
@@ -234,7 +267,7 @@ private:
       }
 
       // Use lexemes for keyword checks
-      std::string lexeme = tokens_.peek().getLexeme();
+      std::string lexeme(tokens_.peek().getLexeme());
       if (lexeme == "class" || lexeme == "function" || lexeme == "let" ||
           lexeme == "const" || lexeme == "if" || lexeme == "while" ||
           lexeme == "return" || lexeme == "}" || lexeme == "{") {
@@ -246,6 +279,7 @@ private:
 
   tokens::TokenStream &tokens_;
   core::ErrorReporter &errorReporter_;
+  parser::ASTContext &context_;
   IExpressionVisitor &exprVisitor_;
   IDeclarationVisitor *declVisitor_ = nullptr;
 
@@ -1,7 +1,9 @@
 // trycatch_stmt.visitor.h
 #pragma once
 #include "core/diagnostics/error_reporter.h"
+#include "parser/ast_context.h"
 #include "parser/nodes/statement_nodes.h"
+#include "parser/visitors/parse_visitor/expression/iexpression_visitor.h"
 #include "parser/visitors/parse_visitor/statement/istatement_visitor.h"
 #include "tokens/stream/token_stream.h"
 
@@ -13,9 +15,11 @@ class TryCatchStatementVisitor {
 public:
   TryCatchStatementVisitor(tokens::TokenStream &tokens,
                            core::ErrorReporter &errorReporter,
+                           parser::ASTContext &context,
+                           IExpressionVisitor &exprVisitor,
                            IStatementVisitor &stmtVisitor)
-      : tokens_(tokens), errorReporter_(errorReporter),
-        stmtVisitor_(stmtVisitor) {}
+      : tokens_(tokens), errorReporter_(errorReporter), context_(context),
+        exprVisitor_(exprVisitor), stmtVisitor_(stmtVisitor) {}
 
   nodes::StmtPtr parseTryStatement() {
     auto location = tokens_.previous().getLocation();
@@ -36,7 +40,7 @@ public:
     }
 
     // Parse optional finally block (fix by checking for FINALLY token type)
-    nodes::StmtPtr finallyBlock;
+    nodes::StmtPtr finallyBlock = nullptr;
     if (match(tokens::TokenType::FINALLY)) { // Add FINALLY to TokenType enum
       finallyBlock = stmtVisitor_.parseStatement();
       if (!finallyBlock)
@@ -49,7 +53,7 @@ public:
       return nullptr;
     }
 
-    return std::make_shared<nodes::TryStmtNode>(
+    return context_.create<nodes::TryStmtNode>(
         tryBlock, std::move(catchClauses), finallyBlock, location);
   }
 
@@ -68,18 +72,14 @@ private:
     }
     clause.parameter = tokens_.previous().getLexeme();
 
-    // Parse optional parameter type
+    // Parse optional parameter type; without one the clause catches
+    // everything
     if (match(tokens::TokenType::COLON)) {
-      // Note: We need type parsing capabilities here
-      // For now, just expect an identifier as the type
-      if (!match(tokens::TokenType::IDENTIFIER)) {
+      clause.parameterType = exprVisitor_.parseType();
+      if (!clause.parameterType) {
         error("Expected type after ':'");
         return clause;
       }
-      auto typeName = tokens_.previous().getLexeme();
-      auto typeLocation = tokens_.previous().getLocation();
-      clause.parameterType =
-          std::make_shared<nodes::NamedTypeNode>(typeName, typeLocation);
     }
 
     if (!consume(tokens::TokenType::RIGHT_PAREN,
@@ -119,8 +119,9 @@ private:
 
   tokens::TokenStream &tokens_;
   core::ErrorReporter &errorReporter_;
+  parser::ASTContext &context_;
+  IExpressionVisitor &exprVisitor_;
   IStatementVisitor &stmtVisitor_;
-  ;
 };
 
 } // namespace visitors
\ No newline at end of file
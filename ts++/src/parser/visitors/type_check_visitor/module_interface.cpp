@@ -0,0 +1,635 @@
+/*****************************************************************************
+ * File: module_interface.cpp
+ * Description: Writing and lazily reading binary module interfaces.
+ *****************************************************************************/
+
+#include "module_interface.h"
+#include "parser/nodes/declaration_nodes.h"
+#include "parser/nodes/statement_nodes.h"
+#include "type_context.h"
+#include <algorithm>
+#include <filesystem>
+#include <unordered_map>
+
+namespace visitors {
+
+namespace {
+
+constexpr char kMagic[4] = {'T', 'S', 'P', 'I'};
+constexpr uint32_t kVersion = 4;
+
+// Header fields after the magic, then the size of each table entry
+constexpr uint32_t kHeaderSize = 4 + 7 * 4;
+constexpr uint32_t kDeclarationSize = 3 * 4; // Name, kind, type
+constexpr uint32_t kClassSize = 2 * 4;       // Name, record
+constexpr uint32_t kTypeSize = 4;            // Record
+
+// Type record flags: the unsafe bit of a pointer, the async and variadic
+// bits of a function, the bytes bit of a slice, the kind of a smart
+// pointer or the lanes of a vector
+uint32_t typeFlags(const ResolvedType &type) {
+  switch (type.getKind()) {
+  case ResolvedType::TypeKind::Pointer:
+    return type.isUnsafe() ? 1 : 0;
+  case ResolvedType::TypeKind::Function:
+    return (type.isAsync() ? 1 : 0) | (type.isVariadic() ? 2 : 0);
+  case ResolvedType::TypeKind::Slice:
+    return type.isBytes() ? 1 : 0;
+  case ResolvedType::TypeKind::Smart:
+    return static_cast<uint32_t>(type.getSmartKind());
+  case ResolvedType::TypeKind::Vector:
+    return type.getLanes();
+  default:
+    return 0;
+  }
+}
+
+// Components in the order a type record lists them
+std::vector<std::shared_ptr<ResolvedType>>
+typeComponents(const ResolvedType &type) {
+  switch (type.getKind()) {
+  case ResolvedType::TypeKind::Array:
+  case ResolvedType::TypeKind::Atomic:
+  case ResolvedType::TypeKind::Slice:
+  case ResolvedType::TypeKind::Vector:
+    return {type.getElementType()};
+  case ResolvedType::TypeKind::Pointer:
+  case ResolvedType::TypeKind::Reference:
+  case ResolvedType::TypeKind::Smart:
+    return {type.getPointeeType()};
+  case ResolvedType::TypeKind::Function: {
+    std::vector<std::shared_ptr<ResolvedType>> components{
+        type.getReturnType()};
+    const auto &params = type.getParameterTypes();
+    components.insert(components.end(), params.begin(), params.end());
+    return components;
+  }
+  case ResolvedType::TypeKind::Union:
+    return {type.getLeftType(), type.getRightType()};
+  case ResolvedType::TypeKind::Template:
+    return type.getTemplateArgs();
+  default:
+    return {};
+  }
+}
+
+bool hasName(ResolvedType::TypeKind kind) {
+  return kind == ResolvedType::TypeKind::Named ||
+         kind == ResolvedType::TypeKind::Template;
+}
+
+void appendU32(std::string &out, uint32_t value) {
+  for (int shift = 0; shift < 32; shift += 8) {
+    out.push_back(static_cast<char>((value >> shift) & 0xff));
+  }
+}
+
+// Collects the tables of an interface, then lays them out
+class InterfaceWriter {
+public:
+  void addDeclaration(const std::string &name, ModuleInterface::Kind kind,
+                      const std::shared_ptr<ResolvedType> &type) {
+    if (type) {
+      declarations_.push_back({name, kind, addType(type)});
+    }
+  }
+
+  std::string finish();
+
+private:
+  struct Declaration {
+    std::string name;
+    ModuleInterface::Kind kind;
+    uint32_t type;
+  };
+
+  struct Class {
+    std::string name;
+    std::vector<uint32_t> supertypes;
+    std::vector<std::pair<std::string, uint32_t>> members;
+  };
+
+  // Indexes a type after its components, so records only point backwards
+  uint32_t addType(const std::shared_ptr<ResolvedType> &type) {
+    auto it = typeIndex_.find(type.get());
+    if (it != typeIndex_.end()) {
+      return it->second;
+    }
+
+    std::vector<uint32_t> components;
+    for (const auto &component : typeComponents(*type)) {
+      components.push_back(addType(component));
+    }
+    uint32_t index = static_cast<uint32_t>(types_.size());
+    types_.push_back({type.get(), std::move(components)});
+    typeIndex_.emplace(type.get(), index);
+
+    // A class's members may name the class itself, which is indexed now
+    if (type->getKind() == ResolvedType::TypeKind::Named) {
+      addClass(type);
+    }
+    return index;
+  }
+
+  void addClass(const std::shared_ptr<ResolvedType> &type) {
+    auto info = TypeContext::instance().getClassInfo(*type);
+    if (info.supertypes.empty() && info.members.empty()) {
+      return;
+    }
+    Class record{type->getName(), {}, {}};
+    for (const auto &supertype : info.supertypes) {
+      record.supertypes.push_back(addType(supertype));
+    }
+    for (const auto &[name, memberType] : info.members) {
+      record.members.emplace_back(name.str(), addType(memberType));
+    }
+    std::sort(record.members.begin(), record.members.end());
+    classes_.push_back(std::move(record));
+  }
+
+  // Appends a string to the records once, returning its offset
+  uint32_t addString(const std::string &text) {
+    auto it = strings_.find(text);
+    if (it != strings_.end()) {
+      return it->second;
+    }
+    uint32_t offset = recordBase_ + static_cast<uint32_t>(records_.size());
+    appendU32(records_, static_cast<uint32_t>(text.size()));
+    records_ += text;
+    strings_.emplace(text, offset);
+    return offset;
+  }
+
+  struct Type {
+    const ResolvedType *type;
+    std::vector<uint32_t> components;
+  };
+
+  std::vector<Declaration> declarations_;
+  std::vector<Class> classes_;
+  std::vector<Type> types_;
+  std::unordered_map<const ResolvedType *, uint32_t> typeIndex_;
+  std::unordered_map<std::string, uint32_t> strings_;
+  std::string records_;
+  uint32_t recordBase_ = 0;
+};
+
+std::string InterfaceWriter::finish() {
+  // Sorted so a reader can binary-search; a redeclaration keeps the last
+  std::stable_sort(declarations_.begin(), declarations_.end(),
+                   [](const Declaration &a, const Declaration &b) {
+                     return std::tie(a.name, a.kind) < std::tie(b.name, b.kind);
+                   });
+  std::reverse(declarations_.begin(), declarations_.end());
+  declarations_.erase(
+      std::unique(declarations_.begin(), declarations_.end(),
+                  [](const Declaration &a, const Declaration &b) {
+                    return a.name == b.name && a.kind == b.kind;
+                  }),
+      declarations_.end());
+  std::reverse(declarations_.begin(), declarations_.end());
+  std::sort(classes_.begin(), classes_.end(),
+            [](const Class &a, const Class &b) { return a.name < b.name; });
+
+  const uint32_t declarationTable = kHeaderSize;
+  const uint32_t classTable =
+      declarationTable + kDeclarationSize * declarations_.size();
+  const uint32_t typeTable = classTable + kClassSize * classes_.size();
+  recordBase_ = typeTable + kTypeSize * types_.size();
+
+  std::string tables;
+  for (const auto &declaration : declarations_) {
+    appendU32(tables, addString(declaration.name));
+    appendU32(tables, static_cast<uint32_t>(declaration.kind));
+    appendU32(tables, declaration.type);
+  }
+  for (const auto &record : classes_) {
+    appendU32(tables, addString(record.name));
+    std::vector<std::pair<uint32_t, uint32_t>> members;
+    for (const auto &[name, type] : record.members) {
+      members.emplace_back(addString(name), type);
+    }
+    appendU32(tables, recordBase_ + static_cast<uint32_t>(records_.size()));
+    appendU32(records_, static_cast<uint32_t>(record.supertypes.size()));
+    for (uint32_t supertype : record.supertypes) {
+      appendU32(records_, supertype);
+    }
+    appendU32(records_, static_cast<uint32_t>(members.size()));
+    for (const auto &[name, type] : members) {
+      appendU32(records_, name);
+      appendU32(records_, type);
+    }
+  }
+  for (const auto &entry : types_) {
+    uint32_t name = hasName(entry.type->getKind())
+                        ? addString(entry.type->getName())
+                        : 0;
+    appendU32(tables, recordBase_ + static_cast<uint32_t>(records_.size()));
+    appendU32(records_, static_cast<uint32_t>(entry.type->getKind()));
+    appendU32(records_, typeFlags(*entry.type));
+    appendU32(records_, name);
+    appendU32(records_, static_cast<uint32_t>(entry.components.size()));
+    for (uint32_t component : entry.components) {
+      appendU32(records_, component);
+    }
+  }
+
+  std::string out(kMagic, sizeof(kMagic));
+  for (uint32_t field :
+       {kVersion, static_cast<uint32_t>(declarations_.size()),
+        declarationTable, static_cast<uint32_t>(classes_.size()), classTable,
+        static_cast<uint32_t>(types_.size()), typeTable}) {
+    appendU32(out, field);
+  }
+  return out + tables + records_;
+}
+
+} // namespace
+
+std::string ModuleInterface::serialize(const parser::AST &ast,
+                                       const TypeScope &scope) {
+  InterfaceWriter writer;
+  for (nodes::NodePtr node : ast.getNodes()) {
+    if (auto stmt = nodes::dyn_cast<nodes::DeclarationStmtNode>(node)) {
+      node = stmt->getDeclaration();
+    }
+
+    switch (node->getNodeKind()) {
+    case nodes::NodeKind::FunctionDecl: {
+      // A C function is declared again by each module that calls it, so
+      // that its calls follow the C convention
+      auto function = nodes::cast<nodes::FunctionDeclNode>(node);
+      if (!function->isExternC()) {
+        writer.addDeclaration(function->getName(), Kind::Function,
+                              scope.lookupFunction(function->getName()));
+      }
+      break;
+    }
+    case nodes::NodeKind::EnumDecl: {
+      // The enum's name is an int type and a value holding its constants
+      const auto &name = nodes::cast<nodes::EnumDeclNode>(node)->getName();
+      writer.addDeclaration(name, Kind::Type, scope.lookupType(name));
+      writer.addDeclaration(name, Kind::Variable, scope.lookupVariable(name));
+      break;
+    }
+    case nodes::NodeKind::ClassDecl:
+    case nodes::NodeKind::InterfaceDecl:
+    case nodes::NodeKind::TypedefDecl: {
+      const auto &name = nodes::cast<nodes::DeclarationNode>(node)->getName();
+      writer.addDeclaration(name, Kind::Type, scope.lookupType(name));
+      break;
+    }
+    default:
+      break;
+    }
+  }
+  return writer.finish();
+}
+
+std::unique_ptr<ModuleInterface>
+ModuleInterface::open(const std::string &path, std::string &error) {
+  auto buffer = core::SourceBuffer::fromFile(path);
+  if (!buffer) {
+    error = "Could not read interface: " + path;
+    return nullptr;
+  }
+
+  std::unique_ptr<ModuleInterface> interface(new ModuleInterface());
+  interface->data_ = buffer->getText();
+  interface->buffer_ = std::move(buffer);
+
+  uint32_t version = 0;
+  const std::string_view data = interface->data_;
+  if (data.size() < kHeaderSize ||
+      data.substr(0, sizeof(kMagic)) != std::string_view(kMagic, 4)) {
+    error = "Not an interface file: " + path;
+    return nullptr;
+  }
+  interface->readU32(4, version);
+  if (version != kVersion) {
+    error = "Interface was written by another compiler version: " + path;
+    return nullptr;
+  }
+  interface->readU32(8, interface->declarationCount_);
+  interface->readU32(12, interface->declarationTable_);
+  interface->readU32(16, interface->classCount_);
+  interface->readU32(20, interface->classTable_);
+  interface->readU32(24, interface->typeCount_);
+  interface->readU32(28, interface->typeTable_);
+
+  // Tables must lie inside the file; records are checked as they are read
+  auto fits = [&](uint32_t offset, uint32_t count, uint32_t size) {
+    return static_cast<uint64_t>(offset) + static_cast<uint64_t>(count) * size <=
+           data.size();
+  };
+  if (!fits(interface->declarationTable_, interface->declarationCount_,
+            kDeclarationSize) ||
+      !fits(interface->classTable_, interface->classCount_, kClassSize) ||
+      !fits(interface->typeTable_, interface->typeCount_, kTypeSize)) {
+    error = "Corrupt interface file: " + path;
+    return nullptr;
+  }
+
+  interface->types_.resize(interface->typeCount_);
+  interface->decodedClasses_.resize(interface->classCount_);
+  return interface;
+}
+
+std::shared_ptr<ModuleInterface>
+ModuleInterface::openShared(const std::string &path, std::string &error) {
+  struct Entry {
+    uintmax_t size;
+    std::filesystem::file_time_type modified;
+    std::shared_ptr<ModuleInterface> interface;
+  };
+  static std::mutex mutex;
+  static std::unordered_map<std::string, Entry> opened;
+
+  // A rewritten file is opened again; the old mapping stays with its users
+  std::error_code status;
+  uintmax_t size = std::filesystem::file_size(path, status);
+  auto modified = std::filesystem::last_write_time(path, status);
+  if (status) {
+    return open(path, error);
+  }
+  std::string key =
+      std::filesystem::absolute(path, status).lexically_normal().string();
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = opened.find(key);
+  if (it != opened.end() && it->second.size == size &&
+      it->second.modified == modified) {
+    return it->second.interface;
+  }
+  std::shared_ptr<ModuleInterface> interface = open(path, error);
+  if (interface) {
+    opened[key] = {size, modified, interface};
+  }
+  return interface;
+}
+
+std::shared_ptr<ResolvedType> ModuleInterface::lookup(core::Symbol name,
+                                                      Kind kind) const {
+  const std::string &text = name.str();
+  auto compare = [&](uint32_t index) {
+    uint32_t entry = declarationTable_ + index * kDeclarationSize;
+    uint32_t entryKind = 0;
+    std::string_view entryName;
+    readName(entry, entryName);
+    readU32(entry + 4, entryKind);
+    if (int order = entryName.compare(text)) {
+      return order;
+    }
+    return static_cast<int>(entryKind) - static_cast<int>(kind);
+  };
+
+  uint32_t low = 0;
+  uint32_t high = declarationCount_;
+  while (low < high) {
+    uint32_t middle = low + (high - low) / 2;
+    int order = compare(middle);
+    if (order == 0) {
+      uint32_t type = 0;
+      readU32(declarationTable_ + middle * kDeclarationSize + 8, type);
+      std::lock_guard<std::mutex> lock(mutex_);
+      return decodeType(type);
+    }
+    if (order < 0) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  return nullptr;
+}
+
+size_t ModuleInterface::getDecodedTypeCount() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return std::count_if(types_.begin(), types_.end(),
+                       [](const auto &type) { return type != nullptr; });
+}
+
+std::shared_ptr<ResolvedType> ModuleInterface::decodeType(uint32_t index) const {
+  if (index >= typeCount_) {
+    return nullptr;
+  }
+  if (types_[index]) {
+    return types_[index];
+  }
+
+  uint32_t record = 0;
+  uint32_t kindValue = 0;
+  uint32_t flags = 0;
+  uint32_t nameOffset = 0;
+  uint32_t count = 0;
+  if (!readU32(typeTable_ + index * kTypeSize, record) ||
+      !readU32(record, kindValue) || !readU32(record + 4, flags) ||
+      !readU32(record + 8, nameOffset) || !readU32(record + 12, count) ||
+      kindValue > static_cast<uint32_t>(ResolvedType::TypeKind::Error)) {
+    return nullptr;
+  }
+
+  // Components precede the type, which also rules out cycles
+  std::vector<std::shared_ptr<ResolvedType>> components;
+  for (uint32_t i = 0; i < count; ++i) {
+    uint32_t component = 0;
+    if (!readU32(record + 16 + i * 4, component) || component >= index) {
+      return nullptr;
+    }
+    components.push_back(decodeType(component));
+    if (!components.back()) {
+      return nullptr;
+    }
+  }
+  std::string_view name;
+  auto kind = static_cast<ResolvedType::TypeKind>(kindValue);
+  if (hasName(kind) && !readString(nameOffset, name)) {
+    return nullptr;
+  }
+
+  auto &types = TypeContext::instance();
+  std::shared_ptr<ResolvedType> type;
+  switch (kind) {
+  case ResolvedType::TypeKind::Void:
+    type = types.getVoid();
+    break;
+  case ResolvedType::TypeKind::Int:
+    type = types.getInt();
+    break;
+  case ResolvedType::TypeKind::Float:
+    type = types.getFloat();
+    break;
+  case ResolvedType::TypeKind::Bool:
+    type = types.getBool();
+    break;
+  case ResolvedType::TypeKind::String:
+    type = types.getString();
+    break;
+  case ResolvedType::TypeKind::Error:
+    type = types.getError();
+    break;
+  case ResolvedType::TypeKind::Named:
+    type = types.getNamed(std::string(name));
+    break;
+  case ResolvedType::TypeKind::Array:
+    if (count == 1) {
+      type = types.getArray(components[0]);
+    }
+    break;
+  case ResolvedType::TypeKind::Pointer:
+    if (count == 1) {
+      type = types.getPointer(components[0], flags & 1);
+    }
+    break;
+  case ResolvedType::TypeKind::Reference:
+    if (count == 1) {
+      type = types.getReference(components[0]);
+    }
+    break;
+  case ResolvedType::TypeKind::Smart:
+    if (count == 1 && flags <= static_cast<uint32_t>(
+                                   ResolvedType::SmartKind::Weak)) {
+      type = types.getSmart(components[0],
+                            static_cast<ResolvedType::SmartKind>(flags));
+    }
+    break;
+  case ResolvedType::TypeKind::Function:
+    if (count >= 1) {
+      type = types.getFunction(
+          components[0],
+          std::vector<std::shared_ptr<ResolvedType>>(components.begin() + 1,
+                                                     components.end()),
+          (flags & 1) != 0, (flags & 2) != 0);
+    }
+    break;
+  case ResolvedType::TypeKind::Union:
+    if (count == 2) {
+      type = types.getUnion(components[0], components[1]);
+    }
+    break;
+  case ResolvedType::TypeKind::Template:
+    type = types.getTemplate(std::string(name), components);
+    break;
+  case ResolvedType::TypeKind::Atomic:
+    if (count == 1) {
+      type = types.getAtomic(components[0]);
+    }
+    break;
+  case ResolvedType::TypeKind::Slice:
+    if (count == 1) {
+      type = types.getSlice(components[0], flags & 1);
+    }
+    break;
+  case ResolvedType::TypeKind::Vector:
+    if (count == 1 && flags != 0) {
+      type = types.getVector(components[0], flags);
+    }
+    break;
+  }
+
+  types_[index] = type;
+  if (type && kind == ResolvedType::TypeKind::Named) {
+    decodeClass(type);
+  }
+  return type;
+}
+
+void ModuleInterface::decodeClass(
+    const std::shared_ptr<ResolvedType> &type) const {
+  // Binary search of the class table by name
+  uint32_t low = 0;
+  uint32_t high = classCount_;
+  uint32_t index = classCount_;
+  while (low < high) {
+    uint32_t middle = low + (high - low) / 2;
+    std::string_view name;
+    readName(classTable_ + middle * kClassSize, name);
+    int order = name.compare(type->getName());
+    if (order == 0) {
+      index = middle;
+      break;
+    }
+    if (order < 0) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  if (index == classCount_ || decodedClasses_[index]) {
+    return;
+  }
+  decodedClasses_[index] = true;
+
+  // A class the program declares itself wins over an imported one
+  auto &types = TypeContext::instance();
+  auto existing = types.getClassInfo(*type);
+  if (!existing.supertypes.empty() || !existing.members.empty()) {
+    return;
+  }
+
+  // Members may refer back to the class, which is already decoded
+  uint32_t record = 0;
+  uint32_t count = 0;
+  if (!readU32(classTable_ + index * kClassSize + 4, record) ||
+      !readU32(record, count)) {
+    return;
+  }
+  std::vector<std::shared_ptr<ResolvedType>> supertypes;
+  uint32_t offset = record + 4;
+  for (uint32_t i = 0; i < count; ++i, offset += 4) {
+    uint32_t supertype = 0;
+    if (!readU32(offset, supertype)) {
+      return;
+    }
+    if (auto decoded = decodeType(supertype)) {
+      supertypes.push_back(decoded);
+    }
+  }
+
+  std::unordered_map<core::Symbol, std::shared_ptr<ResolvedType>> members;
+  if (!readU32(offset, count)) {
+    return;
+  }
+  offset += 4;
+  for (uint32_t i = 0; i < count; ++i, offset += 8) {
+    uint32_t nameOffset = 0;
+    uint32_t memberType = 0;
+    std::string_view name;
+    if (!readU32(offset, nameOffset) || !readU32(offset + 4, memberType) ||
+        !readString(nameOffset, name)) {
+      return;
+    }
+    if (auto decoded = decodeType(memberType)) {
+      members[core::Interner::instance().intern(name)] = decoded;
+    }
+  }
+  types.declareClass(type, std::move(supertypes), std::move(members));
+}
+
+bool ModuleInterface::readU32(uint32_t offset, uint32_t &value) const {
+  if (static_cast<uint64_t>(offset) + 4 > data_.size()) {
+    return false;
+  }
+  value = 0;
+  for (int i = 3; i >= 0; --i) {
+    value = (value << 8) | static_cast<unsigned char>(data_[offset + i]);
+  }
+  return true;
+}
+
+bool ModuleInterface::readString(uint32_t offset,
+                                 std::string_view &value) const {
+  uint32_t length = 0;
+  if (!readU32(offset, length) ||
+      static_cast<uint64_t>(offset) + 4 + length > data_.size()) {
+    return false;
+  }
+  value = data_.substr(offset + 4, length);
+  return true;
+}
+
+bool ModuleInterface::readName(uint32_t entry, std::string_view &value) const {
+  uint32_t offset = 0;
+  return readU32(entry, offset) && readString(offset, value);
+}
+
+} // namespace visitors
@@ -0,0 +1,135 @@
+/*****************************************************************************
+ * File: module_interface.h
+ * Description: Binary interface of the declarations a program exports
+ *
+ * Contains:
+ * - Serialization of the typed top-level declarations of an AST
+ * - Memory-mapped, per-declaration lazy loading of a serialized interface
+ *****************************************************************************/
+
+#pragma once
+#include "core/common/interner.h"
+#include "core/common/macros.h"
+#include "core/common/source_buffer.h"
+#include "parser/ast.h"
+#include "resolved_type.h"
+#include "type_scope.h"
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace visitors {
+
+/**
+ * @class ModuleInterface
+ * @brief Typed declarations of a separately compiled program
+ *
+ * An interface holds what declareAST() entered into the global scope for
+ * the classes, interfaces, enums, typedefs and functions of an AST, and
+ * what the TypeContext recorded about the members and supertypes of its
+ * classes, so that a dependent compilation can type-check against it
+ * without lexing or parsing the sources. Generic declarations are left
+ * out, since their uses are instantiated from the bodies, and so are the
+ * members of namespaces, which are not visible outside them.
+ *
+ * The file is a header followed by four tables, all little-endian:
+ *
+ *   header        "TSPI", version, and the count and offset of each table
+ *   declarations  (name, scope kind, type) sorted by name and kind
+ *   classes       (name, record) sorted by name
+ *   types         offset of each type record; components come first
+ *   records       types, class members and length-prefixed strings
+ *
+ * Opening an interface only maps the file and checks the header. A lookup
+ * binary-searches the declarations and decodes just the types it reaches,
+ * once; a named type brings in the members of its class the first time it
+ * is decoded. Importing a large interface thus costs what is used. Lookups
+ * may come from several threads.
+ */
+class ModuleInterface {
+public:
+  NON_COPYABLE(ModuleInterface);
+
+  // Kinds of declaration, matching the name spaces of a TypeScope
+  enum class Kind : uint8_t { Variable, Function, Type };
+
+  /**
+   * @brief Serializes the exported declarations of an AST
+   * @param ast The declarations, already declared into scope
+   * @param scope Global scope holding their types
+   * @return The interface file contents
+   */
+  static std::string serialize(const parser::AST &ast, const TypeScope &scope);
+
+  /**
+   * @brief Maps an interface file and checks its header
+   * @param path Path of the interface file
+   * @param error Set to the reason when the file cannot be used
+   * @return The interface, or nullptr on error
+   */
+  static std::unique_ptr<ModuleInterface> open(const std::string &path,
+                                               std::string &error);
+
+  /**
+   * @brief Opens an interface once per process while the file is unchanged
+   *
+   * A compile server opens what its clients import before it forks their
+   * compilations, so each compilation finds the interfaces mapped already.
+   *
+   * @param path Path of the interface file
+   * @param error Set to the reason when the file cannot be used
+   * @return The interface, or nullptr on error
+   */
+  static std::shared_ptr<ModuleInterface> openShared(const std::string &path,
+                                                     std::string &error);
+
+  /**
+   * @brief Finds an exported declaration, decoding it on first use
+   * @return Its type, or nullptr if the interface does not declare it
+   */
+  std::shared_ptr<ResolvedType> lookup(core::Symbol name, Kind kind) const;
+
+  // Number of declarations in the interface
+  size_t getDeclarationCount() const { return declarationCount_; }
+
+  // Number of types decoded so far
+  size_t getDecodedTypeCount() const;
+
+private:
+  ModuleInterface() = default;
+
+  /**
+   * @brief Decodes a type and its components, memoized; requires mutex_
+   * @return The type, or nullptr if the record is malformed
+   */
+  std::shared_ptr<ResolvedType> decodeType(uint32_t index) const;
+
+  /**
+   * @brief Records the members of a named class type; requires mutex_
+   */
+  void decodeClass(const std::shared_ptr<ResolvedType> &type) const;
+
+  // Bounds-checked reads from the mapped file; a string is length-prefixed
+  bool readU32(uint32_t offset, uint32_t &value) const;
+  bool readString(uint32_t offset, std::string_view &value) const;
+  // Reads the string the first field of a table entry points to
+  bool readName(uint32_t entry, std::string_view &value) const;
+
+  std::unique_ptr<core::SourceBuffer> buffer_; ///< Mapped file
+  std::string_view data_;                      ///< Its contents
+  uint32_t declarationCount_ = 0;              ///< Declaration table size
+  uint32_t declarationTable_ = 0;              ///< Its offset
+  uint32_t classCount_ = 0;                    ///< Class table size
+  uint32_t classTable_ = 0;                    ///< Its offset
+  uint32_t typeCount_ = 0;                     ///< Type table size
+  uint32_t typeTable_ = 0;                     ///< Its offset
+
+  mutable std::mutex mutex_;                                 ///< Guards below
+  mutable std::vector<std::shared_ptr<ResolvedType>> types_; ///< Decoded
+  mutable std::vector<bool> decodedClasses_;                 ///< By class
+};
+
+} // namespace visitors
@@ -1,97 +1,24 @@
 #include "resolved_type.h"
+#include "type_context.h"
+#include <algorithm>
 #include <sstream>
 
 namespace visitors {
 
-// Static factory methods for creating different types
-ResolvedType ResolvedType::Void() {
-  ResolvedType type(TypeKind::Void);
-  return type;
-}
-
-ResolvedType ResolvedType::Int() {
-  ResolvedType type(TypeKind::Int);
-  return type;
-}
-
-ResolvedType ResolvedType::Float() {
-  ResolvedType type(TypeKind::Float);
-  return type;
-}
-
-ResolvedType ResolvedType::Bool() {
-  ResolvedType type(TypeKind::Bool);
-  return type;
-}
-
-ResolvedType ResolvedType::String() {
-  ResolvedType type(TypeKind::String);
-  return type;
-}
-
-ResolvedType ResolvedType::Named(const std::string &name) {
-  ResolvedType type(TypeKind::Named);
-  type.name_ = name;
-  return type;
-}
-
-ResolvedType ResolvedType::Array(std::shared_ptr<ResolvedType> elementType) {
-  ResolvedType type(TypeKind::Array);
-  type.elementType_ = std::move(elementType);
-  return type;
-}
-
-ResolvedType ResolvedType::Pointer(std::shared_ptr<ResolvedType> pointeeType,
-                                   bool isUnsafe) {
-  ResolvedType type(TypeKind::Pointer);
-  type.pointeeType_ = std::move(pointeeType);
-  type.isUnsafe_ = isUnsafe;
-  return type;
-}
-
-ResolvedType ResolvedType::Reference(std::shared_ptr<ResolvedType> refType) {
-  ResolvedType type(TypeKind::Reference);
-  type.pointeeType_ = std::move(refType);
-  return type;
-}
-
-ResolvedType
-ResolvedType::Function(std::shared_ptr<ResolvedType> returnType,
-                       std::vector<std::shared_ptr<ResolvedType>> paramTypes) {
-  ResolvedType type(TypeKind::Function);
-  type.returnType_ = std::move(returnType);
-  type.paramTypes_ = std::move(paramTypes);
-  return type;
-}
-
-ResolvedType ResolvedType::Smart(std::shared_ptr<ResolvedType> pointeeType,
-                                 SmartKind kind) {
-  ResolvedType type(TypeKind::Smart);
-  type.pointeeType_ = std::move(pointeeType);
-  type.smartKind_ = kind;
-  return type;
-}
-
-ResolvedType ResolvedType::Union(std::shared_ptr<ResolvedType> left,
-                                 std::shared_ptr<ResolvedType> right) {
-  ResolvedType type(TypeKind::Union);
-  type.leftType_ = std::move(left);
-  type.rightType_ = std::move(right);
-  return type;
-}
-
-ResolvedType
-ResolvedType::Template(const std::string &name,
-                       std::vector<std::shared_ptr<ResolvedType>> args) {
-  ResolvedType type(TypeKind::Template);
-  type.name_ = name;
-  type.templateArgs_ = std::move(args);
-  return type;
+bool ResolvedType::isAssignableTo(const ResolvedType &other) const {
+  return TypeContext::instance().isAssignable(*this, other);
 }
 
-ResolvedType ResolvedType::Error() { return ResolvedType(TypeKind::Error); }
+bool ResolvedType::checkAssignableTo(const ResolvedType &other) const {
+  // An atomic is shared through its address and never copied; a plain
+  // value initializes one
+  if (kind_ == TypeKind::Atomic && other.kind_ != TypeKind::Error) {
+    return false;
+  }
+  if (other.kind_ == TypeKind::Atomic && kind_ != TypeKind::Error) {
+    return isAssignableTo(*other.elementType_);
+  }
 
-bool ResolvedType::isAssignableTo(const ResolvedType &other) const {
   // If types are identical, they're assignable
   if (equals(other)) {
     return true;
@@ -103,6 +30,12 @@ bool ResolvedType::isAssignableTo(const ResolvedType &other) const {
     return true;
   }
 
+  // A union is assignable where each of its arms is
+  if (kind_ == TypeKind::Union) {
+    return leftType_->isAssignableTo(other) &&
+           rightType_->isAssignableTo(other);
+  }
+
   // If target is a union type, check if source is assignable to either part
   if (other.kind_ == TypeKind::Union) {
     return isAssignableTo(*other.leftType_) ||
@@ -114,6 +47,29 @@ bool ResolvedType::isAssignableTo(const ResolvedType &other) const {
     return true; // Implicit int to float is safe
   }
 
+  // A class converts to the classes it extends and interfaces it implements
+  auto &context = TypeContext::instance();
+  if (kind_ == TypeKind::Named && other.kind_ == TypeKind::Named) {
+    return context.isSubtype(*this, other);
+  }
+
+  // A pointer to a class converts to a pointer to one of its bases, and to
+  // a value of an interface it implements
+  if (kind_ == TypeKind::Pointer && pointeeType_->kind_ == TypeKind::Named) {
+    if (other.kind_ == TypeKind::Pointer &&
+        other.pointeeType_->kind_ == TypeKind::Named) {
+      return context.isSubtype(*pointeeType_, *other.pointeeType_);
+    }
+    if (other.kind_ == TypeKind::Named) {
+      return context.isSubtype(*pointeeType_, other);
+    }
+  }
+
+  // A new object can be held by a raw pointer
+  if (kind_ == TypeKind::Named && other.kind_ == TypeKind::Pointer) {
+    return isAssignableTo(*other.pointeeType_);
+  }
+
   // Smart pointer assignability
   if (kind_ == TypeKind::Smart && other.kind_ == TypeKind::Smart) {
     // Check smart pointer compatibility rules
@@ -121,21 +77,42 @@ bool ResolvedType::isAssignableTo(const ResolvedType &other) const {
       return pointeeType_->isAssignableTo(*other.pointeeType_);
     }
 
-    // Allow shared to weak conversion
-    if (smartKind_ == SmartKind::Shared &&
-        other.smartKind_ == SmartKind::Weak) {
+    // Allow shared to weak conversion, and locking weak back to shared
+    if ((smartKind_ == SmartKind::Shared &&
+         other.smartKind_ == SmartKind::Weak) ||
+        (smartKind_ == SmartKind::Weak &&
+         other.smartKind_ == SmartKind::Shared)) {
       return pointeeType_->isAssignableTo(*other.pointeeType_);
     }
   }
 
+  // A new object can be owned by a shared or unique pointer
+  if (kind_ == TypeKind::Named && other.kind_ == TypeKind::Smart &&
+      other.smartKind_ != SmartKind::Weak) {
+    return isAssignableTo(*other.pointeeType_);
+  }
+
   // Arrays can be assigned if their element types are compatible
   if (kind_ == TypeKind::Array && other.kind_ == TypeKind::Array) {
     return elementType_->isAssignableTo(*other.elementType_);
   }
 
+  // Arrays and strings are viewed in place, element types unchanged
+  if (other.kind_ == TypeKind::Slice) {
+    if (other.isBytes_) {
+      return kind_ == TypeKind::String;
+    }
+    return kind_ == TypeKind::Array && elementType_->equals(*other.elementType_);
+  }
+
   // Function types can be assigned if they're compatible (contravariant params,
   // covariant return)
   if (kind_ == TypeKind::Function && other.kind_ == TypeKind::Function) {
+    // Async functions are called differently from the others
+    if (isAsync_ != other.isAsync_ || isVariadic_ != other.isVariadic_) {
+      return false;
+    }
+
     // Check return type compatibility (covariant)
     if (!returnType_->isAssignableTo(*other.returnType_)) {
       return false;
@@ -255,80 +232,24 @@ bool ResolvedType::isExplicitlyConvertibleTo(const ResolvedType &other) const {
   return false;
 }
 
-bool ResolvedType::equals(const ResolvedType &other) const {
-  // If the kinds are different, the types are not equal
-  if (kind_ != other.kind_) {
-    return false;
+std::vector<std::shared_ptr<ResolvedType>>
+ResolvedType::getUnionArms() const {
+  std::vector<std::shared_ptr<ResolvedType>> arms;
+  if (kind_ != TypeKind::Union) {
+    return arms;
   }
-
-  // Check equality based on type kind
-  switch (kind_) {
-  case TypeKind::Void:
-  case TypeKind::Int:
-  case TypeKind::Float:
-  case TypeKind::Bool:
-  case TypeKind::String:
-  case TypeKind::Error:
-    return true; // Basic types of same kind are equal
-
-  case TypeKind::Named:
-    return name_ == other.name_;
-
-  case TypeKind::Array:
-    return elementType_->equals(*other.elementType_);
-
-  case TypeKind::Pointer:
-    return pointeeType_->equals(*other.pointeeType_) &&
-           isUnsafe_ == other.isUnsafe_;
-
-  case TypeKind::Reference:
-    return pointeeType_->equals(*other.pointeeType_);
-
-  case TypeKind::Function:
-    // Check return type
-    if (!returnType_->equals(*other.returnType_)) {
-      return false;
-    }
-
-    // Check parameter types
-    if (paramTypes_.size() != other.paramTypes_.size()) {
-      return false;
+  for (const auto &side : {leftType_, rightType_}) {
+    auto nested = side->getUnionArms();
+    if (nested.empty()) {
+      nested.push_back(side);
     }
-
-    for (size_t i = 0; i < paramTypes_.size(); i++) {
-      if (!paramTypes_[i]->equals(*other.paramTypes_[i])) {
-        return false;
-      }
-    }
-    return true;
-
-  case TypeKind::Smart:
-    return pointeeType_->equals(*other.pointeeType_) &&
-           smartKind_ == other.smartKind_;
-
-  case TypeKind::Union:
-    // For unions, order doesn't matter: A|B == B|A
-    return (leftType_->equals(*other.leftType_) &&
-            rightType_->equals(*other.rightType_)) ||
-           (leftType_->equals(*other.rightType_) &&
-            rightType_->equals(*other.leftType_));
-
-  case TypeKind::Template:
-    if (name_ != other.name_ ||
-        templateArgs_.size() != other.templateArgs_.size()) {
-      return false;
-    }
-
-    for (size_t i = 0; i < templateArgs_.size(); i++) {
-      if (!templateArgs_[i]->equals(*other.templateArgs_[i])) {
-        return false;
+    for (auto &arm : nested) {
+      if (std::find(arms.begin(), arms.end(), arm) == arms.end()) {
+        arms.push_back(std::move(arm));
       }
     }
-    return true;
-
-  default:
-    return false;
   }
+  return arms;
 }
 
 std::string ResolvedType::toString() const {
@@ -358,12 +279,15 @@ std::string ResolvedType::toString() const {
   case TypeKind::Reference:
     return pointeeType_->toString() + "&";
   case TypeKind::Function:
-    oss << "function(";
+    oss << (isAsync_ ? "async function(" : "function(");
     for (size_t i = 0; i < paramTypes_.size(); ++i) {
       if (i > 0)
         oss << ", ";
       oss << paramTypes_[i]->toString();
     }
+    if (isVariadic_) {
+      oss << (paramTypes_.empty() ? "..." : ", ...");
+    }
     oss << "): " << returnType_->toString();
     return oss.str();
   case TypeKind::Smart:
@@ -388,6 +312,12 @@ std::string ResolvedType::toString() const {
     }
     oss << ">";
     return oss.str();
+  case TypeKind::Atomic:
+    return "#atomic<" + elementType_->toString() + ">";
+  case TypeKind::Slice:
+    return isBytes_ ? "bytes" : "slice<" + elementType_->toString() + ">";
+  case TypeKind::Vector:
+    return elementType_->toString() + std::to_string(lanes_);
   case TypeKind::Error:
     return "error_type";
   default:
@@ -395,4 +325,11 @@ std::string ResolvedType::toString() const {
   }
 }
 
+size_t ResolvedType::getContainerArity(const std::string &name) {
+  if (name == "MpmcQueue" || name == "SpscQueue") {
+    return 1;
+  }
+  return name == "ConcurrentMap" ? 2 : 0;
+}
+
 } // namespace visitors
\ No newline at end of file
@@ -10,6 +10,8 @@ namespace visitors {
  *
  * This class encapsulates all type information for a resolved type,
  * including its kind, underlying type details, and any generic parameters.
+ * Instances are immutable and uniqued by the TypeContext, so two types are
+ * equal exactly when they are the same object.
  */
 class ResolvedType {
 public:
@@ -28,39 +30,20 @@ public:
     Smart,     // Smart pointer types
     Union,     // Union types
     Template,  // Template specialization
+    Atomic,    // Atomic value types
+    Slice,     // Read-only views of elements stored elsewhere
+    Vector,    // Fixed-width SIMD vectors of ints or floats
     Error      // Error or unknown type
   };
 
   // Smart pointer kinds
   enum class SmartKind { Shared, Unique, Weak };
 
-  // Constructors for different kinds of types
-  static ResolvedType Void();
-  static ResolvedType Int();
-  static ResolvedType Float();
-  static ResolvedType Bool();
-  static ResolvedType String();
-  static ResolvedType Named(const std::string &name);
-  static ResolvedType Array(std::shared_ptr<ResolvedType> elementType);
-  static ResolvedType Pointer(std::shared_ptr<ResolvedType> pointeeType,
-                              bool isUnsafe = false);
-  static ResolvedType Reference(std::shared_ptr<ResolvedType> refType);
-  static ResolvedType
-  Function(std::shared_ptr<ResolvedType> returnType,
-           std::vector<std::shared_ptr<ResolvedType>> paramTypes);
-  static ResolvedType Smart(std::shared_ptr<ResolvedType> pointeeType,
-                            SmartKind kind);
-  static ResolvedType Union(std::shared_ptr<ResolvedType> left,
-                            std::shared_ptr<ResolvedType> right);
-  static ResolvedType Template(const std::string &name,
-                               std::vector<std::shared_ptr<ResolvedType>> args);
-  static ResolvedType Error();
-
   // Type comparison and checking
-  bool isAssignableTo(const ResolvedType &other) const;
+  bool isAssignableTo(const ResolvedType &other) const; // Memoized
   bool isImplicitlyConvertibleTo(const ResolvedType &other) const;
   bool isExplicitlyConvertibleTo(const ResolvedType &other) const;
-  bool equals(const ResolvedType &other) const;
+  bool equals(const ResolvedType &other) const { return this == &other; }
 
   // Accessors
   TypeKind getKind() const { return kind_; }
@@ -74,29 +57,50 @@ public:
   SmartKind getSmartKind() const { return smartKind_; }
   std::shared_ptr<ResolvedType> getLeftType() const { return leftType_; }
   std::shared_ptr<ResolvedType> getRightType() const { return rightType_; }
+  // Arms of a union in written order, nested unions flattened and repeats
+  // dropped; empty for any other type
+  std::vector<std::shared_ptr<ResolvedType>> getUnionArms() const;
   const std::vector<std::shared_ptr<ResolvedType>> &getTemplateArgs() const {
     return templateArgs_;
   }
   bool isUnsafe() const { return isUnsafe_; }
+  bool isAsync() const { return isAsync_; }
+  bool isVariadic() const { return isVariadic_; }
+  bool isBytes() const { return isBytes_; }
+  unsigned getLanes() const { return lanes_; }
 
   // String representation
   std::string toString() const;
 
+  // Type arguments taken by a built-in concurrent container, e.g. 2 for
+  // ConcurrentMap<K, V>; 0 for other names
+  static size_t getContainerArity(const std::string &name);
+
 private:
-  ResolvedType(TypeKind kind) : kind_(kind), isUnsafe_(false) {}
+  friend class TypeContext;
+
+  explicit ResolvedType(TypeKind kind) : kind_(kind), isUnsafe_(false) {}
+
+  // Uncached assignability; components go through the memoized check
+  bool checkAssignableTo(const ResolvedType &other) const;
 
   TypeKind kind_;
   std::string name_;                                      // For named types
-  std::shared_ptr<ResolvedType> elementType_;             // For array types
+  std::shared_ptr<ResolvedType>
+      elementType_; // For array, atomic, slice and vector types
   std::shared_ptr<ResolvedType> pointeeType_;             // For pointer types
   std::shared_ptr<ResolvedType> returnType_;              // For function types
   std::vector<std::shared_ptr<ResolvedType>> paramTypes_; // For function types
-  SmartKind smartKind_;                     // For smart pointer types
+  SmartKind smartKind_ = SmartKind::Shared; // For smart pointer types
   std::shared_ptr<ResolvedType> leftType_;  // For union types
   std::shared_ptr<ResolvedType> rightType_; // For union types
   std::vector<std::shared_ptr<ResolvedType>>
       templateArgs_; // For template types
   bool isUnsafe_;    // For unsafe pointers
+  bool isAsync_ = false; // For async function types
+  bool isVariadic_ = false; // For C functions taking more arguments
+  bool isBytes_ = false; // For slices of bytes, read as ints
+  unsigned lanes_ = 0;   // For vector types
 };
 
 } // namespace visitors
\ No newline at end of file
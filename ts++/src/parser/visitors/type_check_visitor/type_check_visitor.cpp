@@ -1,118 +1,394 @@
 #include "type_check_visitor.h"
 #include "parser/nodes/expression_nodes.h"
 #include "tokens/token_type.h"
+#include <algorithm>
+#include <cctype>
 #include <iostream>
 
 namespace visitors {
 
-TypeCheckVisitor::TypeCheckVisitor(core::ErrorReporter &errorReporter)
-    : errorReporter_(errorReporter), inLoop_(false), inTryBlock_(false) {
+namespace {
+
+// Whether a value of the type refers to an object instead of copying it.
+// #shared objects are counted, never allocated in an arena.
+bool holdsReference(const ResolvedType &type) {
+  return type.getKind() == ResolvedType::TypeKind::Pointer ||
+         type.getKind() == ResolvedType::TypeKind::Reference ||
+         (type.getKind() == ResolvedType::TypeKind::Smart &&
+          type.getSmartKind() == ResolvedType::SmartKind::Unique);
+}
+
+// Whether the elements of an array or slice are counted pointers, which
+// threads cannot share before each is published
+bool holdsCountedElements(const ResolvedType &type) {
+  if (type.getKind() != ResolvedType::TypeKind::Array &&
+      type.getKind() != ResolvedType::TypeKind::Slice) {
+    return false;
+  }
+  auto element = type.getElementType();
+  return element && element->getKind() == ResolvedType::TypeKind::Smart &&
+         element->getSmartKind() != ResolvedType::SmartKind::Unique;
+}
+
+// Reads a lane index written as a decimal literal
+bool literalLane(const nodes::ExpressionNode *expr, unsigned long long &lane) {
+  auto literal = nodes::dyn_cast<nodes::LiteralExpressionNode>(expr);
+  if (!literal || literal->getExpressionType() != tokens::TokenType::NUMBER ||
+      literal->getValue().empty() || literal->getValue().size() > 9 ||
+      literal->getValue().find_first_not_of("0123456789") !=
+          std::string::npos) {
+    return false;
+  }
+  lane = std::stoull(literal->getValue());
+  return true;
+}
+
+// The variable an lvalue is part of, then the fields and elements that lead
+// to it; an element whose index is not a literal is "[]". False for values
+// that are not stored anywhere.
+bool accessPath(const nodes::ExpressionNode *expr,
+                std::vector<std::string> &path) {
+  if (auto ident = nodes::dyn_cast<nodes::IdentifierExpressionNode>(expr)) {
+    path.push_back(ident->getName());
+    return true;
+  }
+  if (nodes::isa<nodes::ThisExpressionNode>(expr)) {
+    path.push_back("this");
+    return true;
+  }
+  if (auto member = nodes::dyn_cast<nodes::MemberExpressionNode>(expr)) {
+    auto type = member->getResolvedType();
+    if ((type && type->getKind() == ResolvedType::TypeKind::Function) ||
+        !accessPath(member->getObject(), path)) {
+      path.clear();
+      return false;
+    }
+    path.push_back("." + member->getMember());
+    return true;
+  }
+  if (auto index = nodes::dyn_cast<nodes::IndexExpressionNode>(expr)) {
+    auto arrayType = index->getArray()->getResolvedType();
+    if (!arrayType || arrayType->getKind() != ResolvedType::TypeKind::Array ||
+        !accessPath(index->getArray(), path)) {
+      path.clear();
+      return false;
+    }
+    unsigned long long element;
+    path.push_back(literalLane(index->getIndex(), element)
+                       ? "[" + std::to_string(element) + "]"
+                       : "[]");
+    return true;
+  }
+  return false;
+}
 
-  // Initialize built-in types
-  voidType_ = std::make_shared<ResolvedType>(ResolvedType::Void());
-  intType_ = std::make_shared<ResolvedType>(ResolvedType::Int());
-  floatType_ = std::make_shared<ResolvedType>(ResolvedType::Float());
-  boolType_ = std::make_shared<ResolvedType>(ResolvedType::Bool());
-  stringType_ = std::make_shared<ResolvedType>(ResolvedType::String());
-  errorType_ = std::make_shared<ResolvedType>(ResolvedType::Error());
+// Whether two access paths may reach the same storage: one leads into the
+// other, unless a literal index or a field tells them apart
+bool mayOverlap(const std::vector<std::string> &a,
+                const std::vector<std::string> &b) {
+  for (size_t i = 0; i < a.size() && i < b.size(); i++) {
+    bool anyElement = (a[i] == "[]" && b[i][0] == '[') ||
+                      (b[i] == "[]" && a[i][0] == '[');
+    if (a[i] != b[i] && !anyElement) {
+      return false;
+    }
+  }
+  return true;
+}
 
-  // Initialize global scope
-  currentScope_ = std::make_shared<TypeScope>();
+std::string joinPath(const std::vector<std::string> &path) {
+  std::string joined;
+  for (const auto &step : path) {
+    joined += step == "[]" ? "[...]" : step;
+  }
+  return joined;
+}
+
+} // namespace
+
+TypeCheckVisitor::TypeCheckVisitor(core::ErrorReporter &errorReporter,
+                                   TypeScope *globalScope)
+    : errorReporter_(&errorReporter), types_(TypeContext::instance()),
+      scope_(globalScope ? *globalScope : ownScope_), inLoop_(false),
+      inSwitch_(false), inTryBlock_(false) {
+
+  // Initialize built-in types
+  voidType_ = types_.getVoid();
+  intType_ = types_.getInt();
+  floatType_ = types_.getFloat();
+  boolType_ = types_.getBool();
+  stringType_ = types_.getString();
+  errorType_ = types_.getError();
 
   // Add built-in types to global scope
-  currentScope_->declareType("void", voidType_);
-  currentScope_->declareType("int", intType_);
-  currentScope_->declareType("float", floatType_);
-  currentScope_->declareType("bool", boolType_);
-  currentScope_->declareType("string", stringType_);
+  scope_.declareType("void", voidType_);
+  scope_.declareType("int", intType_);
+  scope_.declareType("float", floatType_);
+  scope_.declareType("bool", boolType_);
+  scope_.declareType("string", stringType_);
+  scope_.declareType("bytes", types_.getSlice(intType_, true));
+  for (unsigned lanes : {2, 4, 8, 16}) {
+    scope_.declareType("int" + std::to_string(lanes),
+                       types_.getVector(intType_, lanes));
+    scope_.declareType("float" + std::to_string(lanes),
+                       types_.getVector(floatType_, lanes));
+  }
+
+  // Async builtins the runtime's executor provides: sleep(ms) resumes
+  // once the delay has passed, readable(fd) and writable(fd) once the
+  // descriptor is ready
+  scope_.declareFunction("sleep",
+                         types_.getFunction(voidType_, {intType_}, true));
+  scope_.declareFunction("readable",
+                         types_.getFunction(voidType_, {intType_}, true));
+  scope_.declareFunction("writable",
+                         types_.getFunction(voidType_, {intType_}, true));
+
+  // mapFile(path) views a whole file's bytes through a read-only mapping,
+  // or none if it cannot be opened; unmapFile releases the mapping
+  auto bytesType = types_.getSlice(intType_, true);
+  scope_.declareFunction("mapFile",
+                         types_.getFunction(bytesType, {stringType_}));
+  scope_.declareFunction("unmapFile",
+                         types_.getFunction(voidType_, {bytesType}));
 }
 
 bool TypeCheckVisitor::checkAST(const parser::AST &ast) {
+  declareAST(ast);
+  return checkDefinitions(ast);
+}
+
+void TypeCheckVisitor::declareAST(const parser::AST &ast) {
   const auto &nodes = ast.getNodes();
-  bool success = true;
 
-  // First pass: collect all type declarations
+  // Class and interface names come first, so that signatures and bodies
+  // can refer to types declared later in the file
   for (const auto &node : nodes) {
-    if (auto classDecl =
-            std::dynamic_pointer_cast<nodes::ClassDeclNode>(node)) {
-      auto type = visitClassDecl(classDecl.get());
-      currentScope_->declareType(classDecl->getName(), type);
-    } else if (auto genericClass =
-                   std::dynamic_pointer_cast<nodes::GenericClassDeclNode>(
-                       node)) {
-      auto type = visitGenericClassDecl(genericClass.get());
-      currentScope_->declareType(genericClass->getName(), type);
-    } else if (auto enumDecl =
-                   std::dynamic_pointer_cast<nodes::EnumDeclNode>(node)) {
-      auto type = visitEnumDecl(enumDecl.get());
-      currentScope_->declareType(enumDecl->getName(), type);
-    } else if (auto interfaceDecl =
-                   std::dynamic_pointer_cast<nodes::InterfaceDeclNode>(node)) {
-      auto type = visitInterfaceDecl(interfaceDecl.get());
-      currentScope_->declareType(interfaceDecl->getName(), type);
-    } else if (auto genericInterface =
-                   std::dynamic_pointer_cast<nodes::GenericInterfaceDeclNode>(
-                       node)) {
-      auto type = visitGenericInterfaceDecl(genericInterface.get());
-      currentScope_->declareType(genericInterface->getName(), type);
-    } else if (auto typedefDecl =
-                   std::dynamic_pointer_cast<nodes::TypedefDeclNode>(node)) {
-      auto type = visitTypedefDecl(typedefDecl.get());
-      currentScope_->declareType(typedefDecl->getName(), type);
-    }
-  }
-
-  // Second pass: check all declarations and statements
+    if (node->getNodeKind() == nodes::NodeKind::ClassDecl ||
+        node->getNodeKind() == nodes::NodeKind::InterfaceDecl) {
+      auto decl = nodes::cast<nodes::DeclarationNode>(node);
+      scope_.declareType(decl->getName(), types_.getNamed(decl->getName()));
+    }
+  }
+
+  // Then their supertypes and members, before any body is checked
   for (const auto &node : nodes) {
-    if (auto varDecl = std::dynamic_pointer_cast<nodes::VarDeclNode>(node)) {
-      auto type = visitVarDecl(varDecl.get());
-      if (type->getKind() == ResolvedType::TypeKind::Error) {
-        success = false;
-      }
-    } else if (auto funcDecl =
-                   std::dynamic_pointer_cast<nodes::FunctionDeclNode>(node)) {
-      auto type = visitFuncDecl(funcDecl.get());
-      if (type->getKind() == ResolvedType::TypeKind::Error) {
-        success = false;
-      }
-    } else if (auto genericFunc =
-                   std::dynamic_pointer_cast<nodes::GenericFunctionDeclNode>(
-                       node)) {
-      auto type = visitGenericFuncDecl(genericFunc.get());
-      if (type->getKind() == ResolvedType::TypeKind::Error) {
-        success = false;
+    if (node->getNodeKind() == nodes::NodeKind::ClassDecl) {
+      declareClassMembers(nodes::cast<nodes::ClassDeclNode>(node));
+    } else if (node->getNodeKind() == nodes::NodeKind::InterfaceDecl) {
+      declareInterfaceMembers(nodes::cast<nodes::InterfaceDeclNode>(node));
+    }
+  }
+
+  // Then the types that are only known once their declaration is visited
+  for (const auto &node : nodes) {
+    const nodes::DeclarationNode *decl = nullptr;
+    std::shared_ptr<ResolvedType> type;
+
+    switch (node->getNodeKind()) {
+    case nodes::NodeKind::GenericClassDecl:
+      decl = nodes::cast<nodes::GenericClassDeclNode>(node);
+      type = visitGenericClassDecl(
+          nodes::cast<nodes::GenericClassDeclNode>(node));
+      break;
+    case nodes::NodeKind::EnumDecl:
+      decl = nodes::cast<nodes::EnumDeclNode>(node);
+      type = visitEnumDecl(nodes::cast<nodes::EnumDeclNode>(node));
+      break;
+    case nodes::NodeKind::InterfaceDecl:
+      decl = nodes::cast<nodes::InterfaceDeclNode>(node);
+      type = visitInterfaceDecl(nodes::cast<nodes::InterfaceDeclNode>(node));
+      break;
+    case nodes::NodeKind::GenericInterfaceDecl:
+      decl = nodes::cast<nodes::GenericInterfaceDeclNode>(node);
+      type = visitGenericInterfaceDecl(
+          nodes::cast<nodes::GenericInterfaceDeclNode>(node));
+      break;
+    case nodes::NodeKind::TypedefDecl:
+      decl = nodes::cast<nodes::TypedefDeclNode>(node);
+      type = visitTypedefDecl(nodes::cast<nodes::TypedefDeclNode>(node));
+      break;
+    default:
+      break;
+    }
+
+    if (decl) {
+      scope_.declareType(decl->getName(), type);
+    }
+  }
+
+  // Types declared in namespaces, under their qualified names, so a
+  // qualified type is a single lookup wherever it is used
+  for (const auto &node : nodes) {
+    if (node->getNodeKind() == nodes::NodeKind::NamespaceDecl) {
+      declareNamespaceTypes(nodes::cast<nodes::NamespaceDeclNode>(node), "");
+    }
+  }
+
+  // Function signatures, so that a function can call one declared after it
+  for (nodes::NodePtr node : nodes) {
+    if (auto stmt = nodes::dyn_cast<nodes::DeclarationStmtNode>(node)) {
+      node = stmt->getDeclaration();
+    }
+    if (node->getNodeKind() == nodes::NodeKind::FunctionDecl) {
+      auto function = nodes::cast<nodes::FunctionDeclNode>(node);
+      scope_.declareFunction(function->getName(), functionSignature(function));
+    }
+  }
+}
+
+bool TypeCheckVisitor::checkDefinitions(
+    const parser::AST &ast,
+    const std::unordered_set<const nodes::BaseNode *> &skip) {
+  const auto &nodes = ast.getNodes();
+  bool success = true;
+  core::ErrorReporter *reporter = errorReporter_;
+
+  // Class bodies first, then every other declaration and statement
+  for (const auto &node : nodes) {
+    if (node->getNodeKind() == nodes::NodeKind::ClassDecl) {
+      if (deferred_) {
+        deferBody(node);
+      } else {
+        visitClassDecl(nodes::cast<nodes::ClassDeclNode>(node));
       }
-    } else if (auto namespaceDecl =
-                   std::dynamic_pointer_cast<nodes::NamespaceDeclNode>(node)) {
-      auto type = visitNamespaceDecl(namespaceDecl.get());
-      if (type->getKind() == ResolvedType::TypeKind::Error) {
-        success = false;
+    }
+  }
+
+  for (const auto &node : nodes) {
+    std::shared_ptr<ResolvedType> type;
+    const nodes::BaseNode *declaration = node;
+    if (auto stmt = nodes::dyn_cast<nodes::DeclarationStmtNode>(node)) {
+      declaration = stmt->getDeclaration();
+    }
+    if (skip.count(declaration)) {
+      continue;
+    }
+    if (deferred_) {
+      if (declaration->getNodeKind() == nodes::NodeKind::FunctionDecl) {
+        deferBody(declaration);
+        continue;
       }
-    } else if (auto stmt =
-                   std::dynamic_pointer_cast<nodes::StatementNode>(node)) {
-      auto type = visitStmt(stmt.get());
-      if (type->getKind() == ResolvedType::TypeKind::Error) {
-        success = false;
+      checkInPlace();
+    }
+
+    switch (node->getNodeKind()) {
+    case nodes::NodeKind::VarDecl:
+      type = visitVarDecl(nodes::cast<nodes::VarDeclNode>(node));
+      break;
+    case nodes::NodeKind::FunctionDecl:
+      type = visitFuncDecl(nodes::cast<nodes::FunctionDeclNode>(node));
+      break;
+    case nodes::NodeKind::GenericFunctionDecl:
+      type = visitGenericFuncDecl(
+          nodes::cast<nodes::GenericFunctionDeclNode>(node));
+      break;
+    case nodes::NodeKind::NamespaceDecl:
+      type = visitNamespaceDecl(nodes::cast<nodes::NamespaceDeclNode>(node));
+      break;
+    default:
+      if (nodes::isa<nodes::StatementNode>(node)) {
+        type = visitStmt(nodes::cast<nodes::StatementNode>(node));
       }
+      break;
+    }
+
+    if (type && type->getKind() == ResolvedType::TypeKind::Error) {
+      success = false;
     }
   }
 
+  errorReporter_ = reporter;
+  globals_.reset();
   return success;
 }
 
+void TypeCheckVisitor::deferBodies(
+    std::vector<std::unique_ptr<DeferredCheck>> *checks, size_t batchSize) {
+  deferred_ = checks;
+  batchSize_ = std::max<size_t>(batchSize, 1);
+}
+
+void TypeCheckVisitor::deferBody(const nodes::BaseNode *node) {
+  DeferredCheck *batch =
+      deferred_->empty() ? nullptr : deferred_->back().get();
+  if (!globals_) {
+    // The scope changed since the last snapshot, or none was taken yet
+    auto globals = std::make_shared<Globals>();
+    globals->scope = scope_;
+    globals->genericParams = genericParams_;
+    globals->valueClasses = valueClasses_;
+    globals_ = std::move(globals);
+    batch = nullptr;
+  }
+  if (!batch || batch->globals != globals_ ||
+      batch->definitions.size() >= batchSize_) {
+    deferred_->push_back(std::make_unique<DeferredCheck>());
+    batch = deferred_->back().get();
+    batch->globals = globals_;
+  }
+  batch->definitions.push_back(node);
+}
+
+void TypeCheckVisitor::checkInPlace() {
+  // What is checked in place may extend the scope under later bodies
+  globals_.reset();
+  if (deferred_->empty() || deferred_->back()->isPending()) {
+    deferred_->push_back(std::make_unique<DeferredCheck>());
+  }
+  errorReporter_ = &deferred_->back()->diagnostics;
+}
+
+void TypeCheckVisitor::DeferredCheck::check() {
+  if (!globals) {
+    return;
+  }
+
+  // Locals go into a scope of this batch's own over the shared snapshot
+  TypeScope scope(&globals->scope);
+  TypeCheckVisitor checker(diagnostics, &scope);
+  checker.genericParams_ = globals->genericParams;
+  checker.valueClasses_ = globals->valueClasses;
+  for (const nodes::BaseNode *node : definitions) {
+    if (auto classDecl = nodes::dyn_cast<nodes::ClassDeclNode>(node)) {
+      checker.visitClassDecl(classDecl);
+      continue;
+    }
+    auto type =
+        checker.visitFuncDecl(nodes::cast<nodes::FunctionDeclNode>(node));
+    if (type && type->getKind() == ResolvedType::TypeKind::Error) {
+      success = false;
+    }
+  }
+  globals.reset();
+}
+
 // Declaration visitors
 std::shared_ptr<ResolvedType>
 TypeCheckVisitor::visitVarDecl(const nodes::VarDeclNode *node) {
-  // Check the initializer if present
-  std::shared_ptr<ResolvedType> initType = nullptr;
-  if (node->getInitializer()) {
-    initType = visitExpr(node->getInitializer().get());
+  // #comptime initializers run once, while compiling, so only global
+  // constants have one
+  if (node->getStorageClass() == tokens::TokenType::COMPTIME &&
+      (scope_.getDepth() != 0 || !node->isConst())) {
+    error(node->getLocation(), "#comptime declaration '" + node->getName() +
+                                   "' must be a global const");
   }
 
   // Get the declared type if present
   std::shared_ptr<ResolvedType> declaredType = nullptr;
   if (node->getType()) {
-    declaredType = visitType(node->getType().get());
+    declaredType = visitType(node->getType());
+  }
+
+  // Check the initializer if present; [] takes the declared array type
+  std::shared_ptr<ResolvedType> initType = nullptr;
+  auto literal =
+      nodes::dyn_cast<nodes::ArrayLiteralNode>(node->getInitializer());
+  if (literal && literal->getElements().empty() && declaredType &&
+      declaredType->getKind() == ResolvedType::TypeKind::Array) {
+    initType = declaredType;
+  } else if (node->getInitializer()) {
+    initType = visitExpr(node->getInitializer());
   }
 
   // Determine the variable's type
@@ -130,7 +406,11 @@ TypeCheckVisitor::visitVarDecl(const nodes::VarDeclNode *node) {
       }
     }
   } else if (initType) {
-    // Type inference from initializer
+    // Type inference from initializer; atomics are never copied
+    if (initType->getKind() == ResolvedType::TypeKind::Atomic) {
+      error(node->getLocation(), "Cannot copy " + initType->toString());
+      return errorType_;
+    }
     varType = initType;
   } else {
     error(node->getLocation(), "Variable declaration needs either a type or an "
@@ -138,63 +418,160 @@ TypeCheckVisitor::visitVarDecl(const nodes::VarDeclNode *node) {
     return errorType_;
   }
 
+  // Variables of an #arena block may refer to the objects it allocates
+  if (!arenas_.empty()) {
+    arenas_.back().declared.insert(node->getName());
+    if (node->getInitializer() && refersToArena(node->getInitializer()) &&
+        holdsReference(*varType)) {
+      arenas_.back().references.insert(node->getName());
+    }
+  }
+
   // Add variable to current scope
-  currentScope_->declareVariable(node->getName(), varType);
+  scope_.declareVariable(node->getName(), varType);
   return varType;
 }
 
 std::shared_ptr<ResolvedType>
 TypeCheckVisitor::visitFuncDecl(const nodes::FunctionDeclNode *node) {
-  // Process return type
-  std::shared_ptr<ResolvedType> returnType;
-  if (node->getReturnType()) {
-    returnType = visitType(node->getReturnType().get());
-  } else {
-    returnType = voidType_;
+  auto functionType = functionSignature(node);
+  auto returnType = functionType->getReturnType();
+
+  // C code sees numbers, pointers and class values
+  if (node->isExternC()) {
+    auto types = functionType->getParameterTypes();
+    types.push_back(returnType);
+    for (size_t i = 0; i < types.size(); ++i) {
+      const auto &type = types[i];
+      switch (type->getKind()) {
+      case ResolvedType::TypeKind::Int:
+      case ResolvedType::TypeKind::Float:
+      case ResolvedType::TypeKind::Bool:
+      case ResolvedType::TypeKind::Pointer:
+      case ResolvedType::TypeKind::Named:
+      case ResolvedType::TypeKind::Error:
+        break;
+      case ResolvedType::TypeKind::Void:
+        if (i + 1 == types.size()) {
+          break;
+        }
+        [[fallthrough]];
+      default:
+        error(node->getLocation(), "C function '" + node->getName() +
+                                       "' cannot pass " + type->toString());
+      }
+    }
   }
 
-  // Process parameters
-  std::vector<std::shared_ptr<ResolvedType>> paramTypes;
-  for (const auto &param : node->getParameters()) {
-    auto paramType = visitParameter(param.get());
-    paramTypes.push_back(paramType);
+  // The benchmark runner calls it with no arguments and drops the result
+  if (std::find(node->getModifiers().begin(), node->getModifiers().end(),
+                tokens::TokenType::BENCH) != node->getModifiers().end()) {
+    auto kind = returnType->getKind();
+    if (!node->getParameters().empty()) {
+      error(node->getLocation(), "#bench function '" + node->getName() +
+                                     "' cannot take parameters");
+    } else if (node->isAsync()) {
+      error(node->getLocation(),
+            "#bench function '" + node->getName() + "' cannot be async");
+    } else if (kind != ResolvedType::TypeKind::Void &&
+               kind != ResolvedType::TypeKind::Int &&
+               kind != ResolvedType::TypeKind::Float &&
+               kind != ResolvedType::TypeKind::Bool &&
+               kind != ResolvedType::TypeKind::Error) {
+      error(node->getLocation(), "#bench function '" + node->getName() +
+                                     "' cannot return " +
+                                     returnType->toString());
+    }
   }
 
-  // Create function type
-  auto functionType = std::make_shared<ResolvedType>(
-      ResolvedType::Function(returnType, paramTypes));
-
   // Add function to current scope
-  currentScope_->declareFunction(node->getName(), functionType);
+  scope_.declareFunction(node->getName(), functionType);
 
   // Check function body with new scope
   enterFunctionScope(returnType);
+  bool wasAsync = inAsyncFunction_;
+  inAsyncFunction_ = node->isAsync();
 
   // Add parameters to function scope
   for (const auto &param : node->getParameters()) {
-    auto paramType = visitParameter(param.get());
-    currentScope_->declareVariable(param->getName(), paramType);
+    declareParameter(param);
   }
 
   if (node->getBody()) {
-    visitBlock(node->getBody().get());
+    visitBlock(node->getBody());
   }
 
+  inAsyncFunction_ = wasAsync;
   exitFunctionScope();
   return functionType;
 }
 
+void TypeCheckVisitor::declareParameter(const nodes::ParameterNode *param) {
+  auto paramType = visitParameter(param);
+  if (param->isRef()) {
+    // A task or specialization would be handed a copy, not the caller's
+    // variable
+    if (inAsyncFunction_ || genericDepth_ > 0) {
+      error(param->getLocation(),
+            std::string(inAsyncFunction_ ? "Async" : "Generic") +
+                " functions cannot take ref parameter '" + param->getName() +
+                "'");
+    }
+    paramType = paramType->getPointeeType();
+  }
+  scope_.declareVariable(param->getName(), paramType);
+}
+
+std::shared_ptr<ResolvedType>
+TypeCheckVisitor::functionSignature(const nodes::FunctionDeclNode *node) {
+  std::shared_ptr<ResolvedType> returnType =
+      node->getReturnType() ? visitType(node->getReturnType()) : voidType_;
+
+  std::vector<std::shared_ptr<ResolvedType>> paramTypes;
+  for (const auto &param : node->getParameters()) {
+    paramTypes.push_back(visitParameter(param));
+  }
+  return types_.getFunction(returnType, paramTypes, node->isAsync(),
+                            node->isVariadic());
+}
+
 std::shared_ptr<ResolvedType> TypeCheckVisitor::visitGenericFuncDecl(
     const nodes::GenericFunctionDeclNode *node) {
-  // For now, treat generic functions similar to regular functions
-  // In a complete implementation, we would handle generic parameter constraints
-  return visitFuncDecl(node);
+  if (node->isAsync()) {
+    error(node->getLocation(), "Generic function '" + node->getName() +
+                                   "' cannot be async");
+    return errorType_;
+  }
+
+  // The signature and body see the type parameters as named types
+  auto typeParams = enterGenericScope(node->getGenericParams());
+  ++genericDepth_;
+  auto functionType = visitFuncDecl(node);
+  --genericDepth_;
+  exitScope();
+
+  // The declaration made inside the generic scope ended with it
+  scope_.declareFunction(node->getName(), functionType);
+  auto existing = genericParams_.find(functionType.get());
+  if (existing != genericParams_.end() &&
+      existing->second.constraints != typeParams.constraints) {
+    // Generic functions of one signature but other constraints cannot be
+    // told apart by their type, so none of their constraints is checked
+    std::fill(typeParams.constraints.begin(), typeParams.constraints.end(),
+              nullptr);
+  }
+  genericParams_[functionType.get()] = std::move(typeParams);
+  return functionType;
 }
 
 std::shared_ptr<ResolvedType>
 TypeCheckVisitor::visitClassDecl(const nodes::ClassDeclNode *node) {
-  auto classType =
-      std::make_shared<ResolvedType>(ResolvedType::Named(node->getName()));
+  auto classType = types_.getNamed(node->getName());
+
+  // Classes in namespaces miss the pre-pass; redeclaring is harmless
+  if (node->getNodeKind() == nodes::NodeKind::ClassDecl) {
+    declareClassMembers(node);
+  }
 
   // Enter class scope
   enterScope();
@@ -202,41 +579,178 @@ TypeCheckVisitor::visitClassDecl(const nodes::ClassDeclNode *node) {
 
   // Process base class if present
   if (node->getBaseClass()) {
-    visitType(node->getBaseClass().get());
+    visitType(node->getBaseClass());
   }
 
   // Process interfaces
   for (const auto &interface : node->getInterfaces()) {
-    visitType(interface.get());
+    visitType(interface);
   }
 
   // Process class members
   for (const auto &member : node->getMembers()) {
-    if (auto methodDecl =
-            std::dynamic_pointer_cast<nodes::MethodDeclNode>(member)) {
-      visitMethodDecl(methodDecl.get());
-    } else if (auto fieldDecl =
-                   std::dynamic_pointer_cast<nodes::FieldDeclNode>(member)) {
-      visitFieldDecl(fieldDecl.get());
+    if (auto methodDecl = nodes::dyn_cast<nodes::MethodDeclNode>(member)) {
+      visitMethodDecl(methodDecl);
+    } else if (auto fieldDecl = nodes::dyn_cast<nodes::FieldDeclNode>(member)) {
+      visitFieldDecl(fieldDecl);
     } else if (auto ctorDecl =
-                   std::dynamic_pointer_cast<nodes::ConstructorDeclNode>(
-                       member)) {
-      visitConstructorDecl(ctorDecl.get());
+                   nodes::dyn_cast<nodes::ConstructorDeclNode>(member)) {
+      visitConstructorDecl(ctorDecl);
     } else if (auto propDecl =
-                   std::dynamic_pointer_cast<nodes::PropertyDeclNode>(member)) {
-      visitPropertyDecl(propDecl.get());
+                   nodes::dyn_cast<nodes::PropertyDeclNode>(member)) {
+      visitPropertyDecl(propDecl);
     }
   }
 
   currentClassType_ = nullptr;
   exitScope();
+
+  if (node->getNodeKind() == nodes::NodeKind::ClassDecl) {
+    checkClassConformance(node, classType);
+  }
   return classType;
 }
 
+void TypeCheckVisitor::declareClassMembers(const nodes::ClassDeclNode *node) {
+  auto &interner = core::Interner::instance();
+
+  const auto &modifiers = node->getClassModifiers();
+  if (std::find(modifiers.begin(), modifiers.end(), tokens::TokenType::STACK) !=
+      modifiers.end()) {
+    valueClasses_.insert(node->getName());
+  }
+  // Arrays of a #soa class keep one column per field
+  if (std::find(modifiers.begin(), modifiers.end(), tokens::TokenType::SOA) !=
+          modifiers.end() &&
+      std::none_of(node->getMembers().begin(), node->getMembers().end(),
+                   [](nodes::DeclPtr member) {
+                     return nodes::isa<nodes::FieldDeclNode>(member);
+                   })) {
+    error(node->getLocation(),
+          "#soa class '" + node->getName() + "' needs at least one field");
+  }
+
+  std::vector<std::shared_ptr<ResolvedType>> supertypes;
+  if (node->getBaseClass()) {
+    supertypes.push_back(visitType(node->getBaseClass()));
+  }
+  for (const auto &interface : node->getInterfaces()) {
+    supertypes.push_back(visitType(interface));
+  }
+
+  std::unordered_map<core::Symbol, std::shared_ptr<ResolvedType>> members;
+  for (const auto &member : node->getMembers()) {
+    if (auto method = nodes::dyn_cast<nodes::MethodDeclNode>(member)) {
+      members[interner.intern(method->getName())] =
+          methodType(method->getParameters(), method->getReturnType());
+    } else if (auto field = nodes::dyn_cast<nodes::FieldDeclNode>(member)) {
+      // Inferred field types are only known once the initializer is checked
+      if (field->getType()) {
+        members[interner.intern(field->getName())] =
+            visitType(field->getType());
+      }
+    }
+  }
+
+  types_.declareClass(types_.getNamed(node->getName()), std::move(supertypes),
+                      std::move(members));
+}
+
+void TypeCheckVisitor::declareInterfaceMembers(
+    const nodes::InterfaceDeclNode *node) {
+  auto &interner = core::Interner::instance();
+
+  std::vector<std::shared_ptr<ResolvedType>> supertypes;
+  for (const auto &extended : node->getExtendedInterfaces()) {
+    supertypes.push_back(visitType(extended));
+  }
+
+  std::unordered_map<core::Symbol, std::shared_ptr<ResolvedType>> members;
+  for (const auto &member : node->getMembers()) {
+    if (auto method = nodes::dyn_cast<nodes::MethodSignatureNode>(member)) {
+      members[interner.intern(method->getName())] =
+          methodType(method->getParameters(), method->getReturnType());
+    }
+  }
+
+  types_.declareClass(types_.getNamed(node->getName()), std::move(supertypes),
+                      std::move(members));
+}
+
+void TypeCheckVisitor::checkClassConformance(
+    const nodes::ClassDeclNode *node,
+    const std::shared_ptr<ResolvedType> &classType) {
+  auto &interner = core::Interner::instance();
+
+  // An override keeps the signature of the method it replaces
+  if (node->getBaseClass()) {
+    auto baseType = visitType(node->getBaseClass());
+    for (const auto &member : node->getMembers()) {
+      auto method = nodes::dyn_cast<nodes::MethodDeclNode>(member);
+      if (!method) {
+        continue;
+      }
+      auto inherited =
+          types_.lookupMember(*baseType, interner.intern(method->getName()));
+      if (inherited &&
+          inherited->getKind() == ResolvedType::TypeKind::Function &&
+          !inherited->equals(
+              *methodType(method->getParameters(), method->getReturnType()))) {
+        error(method->getLocation(),
+              "Method '" + method->getName() +
+                  "' does not match the signature of the method it overrides");
+      }
+    }
+  }
+
+  // Every method of an implemented interface, and of the interfaces it
+  // extends, must be provided with the same signature
+  std::vector<const ResolvedType *> interfaces;
+  for (const auto &interface : node->getInterfaces()) {
+    auto interfaceType = visitType(interface);
+    interfaces.push_back(interfaceType.get());
+    auto extended = types_.getSupertypes(*interfaceType);
+    interfaces.insert(interfaces.end(), extended.begin(), extended.end());
+  }
+  std::unordered_set<const ResolvedType *> checked;
+  for (const ResolvedType *interface : interfaces) {
+    // An interface reached along several paths is checked once
+    if (!checked.insert(interface).second) {
+      continue;
+    }
+    auto info = types_.getClassInfo(*interface);
+    for (const auto &[name, signature] : info.members) {
+      auto provided = types_.lookupMember(*classType, name);
+      if (!provided || !provided->equals(*signature)) {
+        error(node->getLocation(),
+              "Class '" + node->getName() + "' does not implement '" +
+                  interner.lookup(name) + "' of interface '" +
+                  interface->getName() + "'");
+      }
+    }
+  }
+}
+
+std::shared_ptr<ResolvedType>
+TypeCheckVisitor::methodType(const std::vector<nodes::ParamPtr> &params,
+                             const nodes::TypeNode *returnType) {
+  std::vector<std::shared_ptr<ResolvedType>> paramTypes;
+  for (const auto &param : params) {
+    paramTypes.push_back(visitParameter(param));
+  }
+  return types_.getFunction(returnType ? visitType(returnType) : voidType_,
+                            paramTypes);
+}
+
 std::shared_ptr<ResolvedType> TypeCheckVisitor::visitGenericClassDecl(
     const nodes::GenericClassDeclNode *node) {
-  // For now, treat generic classes similar to regular classes
-  return visitClassDecl(node);
+  // Members see the type parameters as named types
+  enterGenericScope(node->getGenericParams());
+  ++genericDepth_;
+  auto classType = visitClassDecl(node);
+  --genericDepth_;
+  exitScope();
+  return classType;
 }
 
 std::shared_ptr<ResolvedType>
@@ -244,25 +758,23 @@ TypeCheckVisitor::visitConstructorDecl(const nodes::ConstructorDeclNode *node) {
   // Process parameters
   std::vector<std::shared_ptr<ResolvedType>> paramTypes;
   for (const auto &param : node->getParameters()) {
-    auto paramType = visitParameter(param.get());
+    auto paramType = visitParameter(param);
     paramTypes.push_back(paramType);
   }
 
   // Constructor returns the class type
-  auto constructorType = std::make_shared<ResolvedType>(
-      ResolvedType::Function(currentClassType_, paramTypes));
+  auto constructorType = types_.getFunction(currentClassType_, paramTypes);
 
   // Check constructor body
   enterFunctionScope(currentClassType_);
 
   // Add parameters to scope
   for (const auto &param : node->getParameters()) {
-    auto paramType = visitParameter(param.get());
-    currentScope_->declareVariable(param->getName(), paramType);
+    declareParameter(param);
   }
 
   if (node->getBody()) {
-    visitBlock(node->getBody().get());
+    visitBlock(node->getBody());
   }
 
   exitFunctionScope();
@@ -274,7 +786,7 @@ TypeCheckVisitor::visitMethodDecl(const nodes::MethodDeclNode *node) {
   // Process return type
   std::shared_ptr<ResolvedType> returnType;
   if (node->getReturnType()) {
-    returnType = visitType(node->getReturnType().get());
+    returnType = visitType(node->getReturnType());
   } else {
     returnType = voidType_;
   }
@@ -282,24 +794,22 @@ TypeCheckVisitor::visitMethodDecl(const nodes::MethodDeclNode *node) {
   // Process parameters
   std::vector<std::shared_ptr<ResolvedType>> paramTypes;
   for (const auto &param : node->getParameters()) {
-    auto paramType = visitParameter(param.get());
+    auto paramType = visitParameter(param);
     paramTypes.push_back(paramType);
   }
 
-  auto methodType = std::make_shared<ResolvedType>(
-      ResolvedType::Function(returnType, paramTypes));
+  auto methodType = types_.getFunction(returnType, paramTypes);
 
   // Check method body
   enterFunctionScope(returnType);
 
   // Add parameters to scope
   for (const auto &param : node->getParameters()) {
-    auto paramType = visitParameter(param.get());
-    currentScope_->declareVariable(param->getName(), paramType);
+    declareParameter(param);
   }
 
   if (node->getBody()) {
-    visitBlock(node->getBody().get());
+    visitBlock(node->getBody());
   }
 
   exitFunctionScope();
@@ -311,9 +821,9 @@ TypeCheckVisitor::visitFieldDecl(const nodes::FieldDeclNode *node) {
   // Get field type
   std::shared_ptr<ResolvedType> fieldType;
   if (node->getType()) {
-    fieldType = visitType(node->getType().get());
+    fieldType = visitType(node->getType());
   } else if (node->getInitializer()) {
-    fieldType = visitExpr(node->getInitializer().get());
+    fieldType = visitExpr(node->getInitializer());
   } else {
     error(node->getLocation(),
           "Field must have either explicit type or initializer");
@@ -322,26 +832,26 @@ TypeCheckVisitor::visitFieldDecl(const nodes::FieldDeclNode *node) {
 
   // Check initializer if present
   if (node->getInitializer()) {
-    auto initType = visitExpr(node->getInitializer().get());
+    auto initType = visitExpr(node->getInitializer());
     if (!checkAssignmentCompatibility(fieldType, initType,
                                       node->getLocation())) {
       error(node->getLocation(), "Field initializer type mismatch");
     }
   }
 
-  currentScope_->declareVariable(node->getName(), fieldType);
+  scope_.declareVariable(node->getName(), fieldType);
   return fieldType;
 }
 
 std::shared_ptr<ResolvedType>
 TypeCheckVisitor::visitPropertyDecl(const nodes::PropertyDeclNode *node) {
   // Get property type
-  auto propertyType = visitType(node->getPropertyType().get());
+  auto propertyType = visitType(node->getPropertyType());
 
   // Check property body
   enterFunctionScope(propertyType);
   if (node->getBody()) {
-    visitBlock(node->getBody().get());
+    visitBlock(node->getBody());
   }
   exitFunctionScope();
 
@@ -350,28 +860,158 @@ TypeCheckVisitor::visitPropertyDecl(const nodes::PropertyDeclNode *node) {
 
 std::shared_ptr<ResolvedType>
 TypeCheckVisitor::visitEnumDecl(const nodes::EnumDeclNode *node) {
-  auto enumType =
-      std::make_shared<ResolvedType>(ResolvedType::Named(node->getName()));
+  // An enum value is an int. The enum's name also names a value whose
+  // members are the enum's constants, so Color.Red reads like a member.
+  auto enumType = types_.getNamed(node->getName());
+  std::unordered_map<core::Symbol, std::shared_ptr<ResolvedType>> members;
+  for (const auto &member : node->getMembers()) {
+    members[core::Interner::instance().intern(member->getName())] = intType_;
+  }
+  types_.declareClass(enumType, {}, std::move(members));
+  scope_.declareType(node->getName(), intType_);
+  scope_.declareVariable(node->getName(), enumType);
 
   // Check underlying type if present
   std::shared_ptr<ResolvedType> underlyingType = intType_; // Default to int
   if (node->getUnderlyingType()) {
-    underlyingType = visitType(node->getUnderlyingType().get());
+    underlyingType = visitType(node->getUnderlyingType());
+  }
+
+  // Values are folded here so code generation sees constants, and a switch
+  // over the enum can become a jump table
+  const auto &enumMembers = node->getMembers();
+  int64_t next = 0;
+  for (size_t i = 0; i < enumMembers.size(); ++i) {
+    auto member = enumMembers[i];
+    visitEnumMember(member);
+    int64_t value = next;
+    if (member->getValue() &&
+        !foldEnumValue(node, i, member->getValue(), value)) {
+      error(member->getLocation(),
+            "Enum member value must be a constant integer");
+    } else if (value < INT32_MIN || value > INT32_MAX) {
+      error(member->getLocation(), "Enum member value does not fit in int");
+    }
+    member->setConstantValue(value);
+    next = value + 1;
   }
 
-  // Process enum members
-  for (const auto &member : node->getMembers()) {
-    visitEnumMember(member.get());
+  return intType_;
+}
+
+bool TypeCheckVisitor::foldEnumValue(const nodes::EnumDeclNode *node,
+                                     size_t folded,
+                                     const nodes::ExpressionNode *value,
+                                     int64_t &result) {
+  switch (value->getNodeKind()) {
+  case nodes::NodeKind::LiteralExpression: {
+    auto literal = nodes::cast<nodes::LiteralExpressionNode>(value);
+    const tokens::NumberValue &number = literal->getNumber();
+    if (literal->getExpressionType() != tokens::TokenType::NUMBER ||
+        !number.isInteger() || number.integer > INT64_MAX) {
+      return false;
+    }
+    result = static_cast<int64_t>(number.integer);
+    return true;
+  }
+
+  case nodes::NodeKind::UnaryExpression: {
+    auto unary = nodes::cast<nodes::UnaryExpressionNode>(value);
+    int64_t operand;
+    if (!foldEnumValue(node, folded, unary->getOperand(), operand)) {
+      return false;
+    }
+    switch (unary->getExpressionType()) {
+    case tokens::TokenType::MINUS:
+      result = -operand;
+      return true;
+    case tokens::TokenType::PLUS:
+      result = operand;
+      return true;
+    case tokens::TokenType::TILDE:
+      result = ~operand;
+      return true;
+    default:
+      return false;
+    }
+  }
+
+  case nodes::NodeKind::BinaryExpression: {
+    auto binary = nodes::cast<nodes::BinaryExpressionNode>(value);
+    int64_t left, right;
+    if (!foldEnumValue(node, folded, binary->getLeft(), left) ||
+        !foldEnumValue(node, folded, binary->getRight(), right)) {
+      return false;
+    }
+    switch (binary->getExpressionType()) {
+    case tokens::TokenType::PLUS:
+      result = left + right;
+      return true;
+    case tokens::TokenType::MINUS:
+      result = left - right;
+      return true;
+    case tokens::TokenType::STAR:
+      result = left * right;
+      return true;
+    case tokens::TokenType::SLASH:
+    case tokens::TokenType::PERCENT:
+      if (right == 0) {
+        return false;
+      }
+      result = binary->getExpressionType() == tokens::TokenType::SLASH
+                   ? left / right
+                   : left % right;
+      return true;
+    case tokens::TokenType::LEFT_SHIFT:
+    case tokens::TokenType::RIGHT_SHIFT:
+      if (right < 0 || right >= 32) {
+        return false;
+      }
+      result = binary->getExpressionType() == tokens::TokenType::LEFT_SHIFT
+                   ? left << right
+                   : left >> right;
+      return true;
+    case tokens::TokenType::AMPERSAND:
+      result = left & right;
+      return true;
+    case tokens::TokenType::PIPE:
+      result = left | right;
+      return true;
+    case tokens::TokenType::CARET:
+      result = left ^ right;
+      return true;
+    default:
+      return false;
+    }
+  }
+
+  case nodes::NodeKind::MemberExpression: {
+    // Only the members declared earlier have values yet
+    auto member = nodes::cast<nodes::MemberExpressionNode>(value);
+    auto object =
+        nodes::dyn_cast<nodes::IdentifierExpressionNode>(member->getObject());
+    if (!object || object->getName() != node->getName()) {
+      return false;
+    }
+    for (size_t i = 0; i < folded; ++i) {
+      if (node->getMembers()[i]->getName() == member->getMember()) {
+        result = node->getMembers()[i]->getConstantValue();
+        return true;
+      }
+    }
+    return false;
   }
 
-  return enumType;
+  default:
+    return false;
+  }
 }
 
 std::shared_ptr<ResolvedType>
 TypeCheckVisitor::visitEnumMember(const nodes::EnumMemberNode *node) {
   // Check member value if present
   if (node->getValue()) {
-    auto valueType = visitExpr(node->getValue().get());
+    auto valueType = visitExpr(node->getValue());
     // Should be compatible with enum's underlying type
     if (!valueType->isAssignableTo(*intType_)) {
       error(node->getLocation(),
@@ -383,25 +1023,22 @@ TypeCheckVisitor::visitEnumMember(const nodes::EnumMemberNode *node) {
 
 std::shared_ptr<ResolvedType>
 TypeCheckVisitor::visitInterfaceDecl(const nodes::InterfaceDeclNode *node) {
-  auto interfaceType =
-      std::make_shared<ResolvedType>(ResolvedType::Named(node->getName()));
+  auto interfaceType = types_.getNamed(node->getName());
 
   enterScope();
 
   // Process extended interfaces
   for (const auto &extended : node->getExtendedInterfaces()) {
-    visitType(extended.get());
+    visitType(extended);
   }
 
   // Process interface members
   for (const auto &member : node->getMembers()) {
-    if (auto methodSig =
-            std::dynamic_pointer_cast<nodes::MethodSignatureNode>(member)) {
-      visitMethodSignature(methodSig.get());
+    if (auto methodSig = nodes::dyn_cast<nodes::MethodSignatureNode>(member)) {
+      visitMethodSignature(methodSig);
     } else if (auto propSig =
-                   std::dynamic_pointer_cast<nodes::PropertySignatureNode>(
-                       member)) {
-      visitPropertySignature(propSig.get());
+                   nodes::dyn_cast<nodes::PropertySignatureNode>(member)) {
+      visitPropertySignature(propSig);
     }
   }
 
@@ -418,22 +1055,41 @@ std::shared_ptr<ResolvedType> TypeCheckVisitor::visitGenericInterfaceDecl(
 std::shared_ptr<ResolvedType>
 TypeCheckVisitor::visitMethodSignature(const nodes::MethodSignatureNode *node) {
   // Process return type
-  auto returnType = visitType(node->getReturnType().get());
+  auto returnType = visitType(node->getReturnType());
 
   // Process parameters
   std::vector<std::shared_ptr<ResolvedType>> paramTypes;
   for (const auto &param : node->getParameters()) {
-    auto paramType = visitParameter(param.get());
+    auto paramType = visitParameter(param);
     paramTypes.push_back(paramType);
   }
 
-  return std::make_shared<ResolvedType>(
-      ResolvedType::Function(returnType, paramTypes));
+  return types_.getFunction(returnType, paramTypes);
 }
 
 std::shared_ptr<ResolvedType> TypeCheckVisitor::visitPropertySignature(
     const nodes::PropertySignatureNode *node) {
-  return visitType(node->getType().get());
+  return visitType(node->getType());
+}
+
+void TypeCheckVisitor::declareNamespaceTypes(
+    const nodes::NamespaceDeclNode *node, const std::string &prefix) {
+  std::string qualified = prefix + node->getName() + ".";
+  for (const auto &decl : node->getDeclarations()) {
+    switch (decl->getNodeKind()) {
+    case nodes::NodeKind::ClassDecl:
+    case nodes::NodeKind::InterfaceDecl:
+      scope_.declareType(qualified + decl->getName(),
+                         types_.getNamed(decl->getName()));
+      break;
+    case nodes::NodeKind::NamespaceDecl:
+      declareNamespaceTypes(nodes::cast<nodes::NamespaceDeclNode>(decl),
+                            qualified);
+      break;
+    default:
+      break;
+    }
+  }
 }
 
 std::shared_ptr<ResolvedType>
@@ -442,14 +1098,12 @@ TypeCheckVisitor::visitNamespaceDecl(const nodes::NamespaceDeclNode *node) {
 
   // Process all declarations in the namespace
   for (const auto &decl : node->getDeclarations()) {
-    if (auto varDecl = std::dynamic_pointer_cast<nodes::VarDeclNode>(decl)) {
-      visitVarDecl(varDecl.get());
-    } else if (auto funcDecl =
-                   std::dynamic_pointer_cast<nodes::FunctionDeclNode>(decl)) {
-      visitFuncDecl(funcDecl.get());
-    } else if (auto classDecl =
-                   std::dynamic_pointer_cast<nodes::ClassDeclNode>(decl)) {
-      visitClassDecl(classDecl.get());
+    if (auto varDecl = nodes::dyn_cast<nodes::VarDeclNode>(decl)) {
+      visitVarDecl(varDecl);
+    } else if (auto funcDecl = nodes::dyn_cast<nodes::FunctionDeclNode>(decl)) {
+      visitFuncDecl(funcDecl);
+    } else if (auto classDecl = nodes::dyn_cast<nodes::ClassDeclNode>(decl)) {
+      visitClassDecl(classDecl);
     }
   }
 
@@ -459,24 +1113,23 @@ TypeCheckVisitor::visitNamespaceDecl(const nodes::NamespaceDeclNode *node) {
 
 std::shared_ptr<ResolvedType>
 TypeCheckVisitor::visitTypedefDecl(const nodes::TypedefDeclNode *node) {
-  auto aliasedType = visitType(node->getAliasedType().get());
-  currentScope_->declareType(node->getName(), aliasedType);
+  auto aliasedType = visitType(node->getAliasedType());
+  scope_.declareType(node->getName(), aliasedType);
   return aliasedType;
 }
 
 std::shared_ptr<ResolvedType>
 TypeCheckVisitor::visitParameter(const nodes::ParameterNode *node) {
-  auto paramType = visitType(node->getType().get());
+  auto paramType = visitType(node->getType());
 
   // Handle reference parameters
   if (node->isRef()) {
-    paramType =
-        std::make_shared<ResolvedType>(ResolvedType::Reference(paramType));
+    paramType = types_.getReference(paramType);
   }
 
   // Check default value if present
   if (node->getDefaultValue()) {
-    auto defaultType = visitExpr(node->getDefaultValue().get());
+    auto defaultType = visitExpr(node->getDefaultValue());
     if (!checkAssignmentCompatibility(paramType, defaultType,
                                       node->getLocation())) {
       error(node->getLocation(), "Parameter default value type mismatch");
@@ -490,7 +1143,7 @@ std::shared_ptr<ResolvedType>
 TypeCheckVisitor::visitAttribute(const nodes::AttributeNode *node) {
   // Check attribute argument if present
   if (node->getArgument()) {
-    visitExpr(node->getArgument().get());
+    visitExpr(node->getArgument());
   }
   return voidType_;
 }
@@ -498,50 +1151,40 @@ TypeCheckVisitor::visitAttribute(const nodes::AttributeNode *node) {
 // Statement visitors
 std::shared_ptr<ResolvedType>
 TypeCheckVisitor::visitStmt(const nodes::StatementNode *node) {
-  if (auto exprStmt = dynamic_cast<const nodes::ExpressionStmtNode *>(node)) {
-    return visitExprStmt(exprStmt);
-  } else if (auto blockStmt = dynamic_cast<const nodes::BlockNode *>(node)) {
-    return visitBlock(blockStmt);
-  } else if (auto ifStmt = dynamic_cast<const nodes::IfStmtNode *>(node)) {
-    return visitIfStmt(ifStmt);
-  } else if (auto whileStmt =
-                 dynamic_cast<const nodes::WhileStmtNode *>(node)) {
-    return visitWhileStmt(whileStmt);
-  } else if (auto doWhileStmt =
-                 dynamic_cast<const nodes::DoWhileStmtNode *>(node)) {
-    return visitDoWhileStmt(doWhileStmt);
-  } else if (auto forStmt = dynamic_cast<const nodes::ForStmtNode *>(node)) {
-    return visitForStmt(forStmt);
-  } else if (auto forOfStmt =
-                 dynamic_cast<const nodes::ForOfStmtNode *>(node)) {
-    return visitForOfStmt(forOfStmt);
-  } else if (auto returnStmt =
-                 dynamic_cast<const nodes::ReturnStmtNode *>(node)) {
-    return visitReturnStmt(returnStmt);
-  } else if (auto breakStmt =
-                 dynamic_cast<const nodes::BreakStmtNode *>(node)) {
-    return visitBreakStmt(breakStmt);
-  } else if (auto continueStmt =
-                 dynamic_cast<const nodes::ContinueStmtNode *>(node)) {
-    return visitContinueStmt(continueStmt);
-  } else if (auto switchStmt =
-                 dynamic_cast<const nodes::SwitchStmtNode *>(node)) {
-    return visitSwitchStmt(switchStmt);
-  } else if (auto tryStmt = dynamic_cast<const nodes::TryStmtNode *>(node)) {
-    return visitTryStmt(tryStmt);
-  } else if (auto throwStmt =
-                 dynamic_cast<const nodes::ThrowStmtNode *>(node)) {
-    return visitThrowStmt(throwStmt);
-  } else if (auto asmStmt =
-                 dynamic_cast<const nodes::AssemblyStmtNode *>(node)) {
-    return visitAssemblyStmt(asmStmt);
-  } else if (auto labeledStmt =
-                 dynamic_cast<const nodes::LabeledStatementNode *>(node)) {
-    return visitLabeledStmt(labeledStmt);
-  } else if (auto declStmt =
-                 dynamic_cast<const nodes::DeclarationStmtNode *>(node)) {
-    return visitDeclarationStmt(declStmt);
-  } else {
+  switch (node->getNodeKind()) {
+  case nodes::NodeKind::ExpressionStmt:
+    return visitExprStmt(nodes::cast<nodes::ExpressionStmtNode>(node));
+  case nodes::NodeKind::Block:
+    return visitBlock(nodes::cast<nodes::BlockNode>(node));
+  case nodes::NodeKind::IfStmt:
+    return visitIfStmt(nodes::cast<nodes::IfStmtNode>(node));
+  case nodes::NodeKind::WhileStmt:
+    return visitWhileStmt(nodes::cast<nodes::WhileStmtNode>(node));
+  case nodes::NodeKind::DoWhileStmt:
+    return visitDoWhileStmt(nodes::cast<nodes::DoWhileStmtNode>(node));
+  case nodes::NodeKind::ForStmt:
+    return visitForStmt(nodes::cast<nodes::ForStmtNode>(node));
+  case nodes::NodeKind::ForOfStmt:
+    return visitForOfStmt(nodes::cast<nodes::ForOfStmtNode>(node));
+  case nodes::NodeKind::ReturnStmt:
+    return visitReturnStmt(nodes::cast<nodes::ReturnStmtNode>(node));
+  case nodes::NodeKind::BreakStmt:
+    return visitBreakStmt(nodes::cast<nodes::BreakStmtNode>(node));
+  case nodes::NodeKind::ContinueStmt:
+    return visitContinueStmt(nodes::cast<nodes::ContinueStmtNode>(node));
+  case nodes::NodeKind::SwitchStmt:
+    return visitSwitchStmt(nodes::cast<nodes::SwitchStmtNode>(node));
+  case nodes::NodeKind::TryStmt:
+    return visitTryStmt(nodes::cast<nodes::TryStmtNode>(node));
+  case nodes::NodeKind::ThrowStmt:
+    return visitThrowStmt(nodes::cast<nodes::ThrowStmtNode>(node));
+  case nodes::NodeKind::AssemblyStmt:
+    return visitAssemblyStmt(nodes::cast<nodes::AssemblyStmtNode>(node));
+  case nodes::NodeKind::LabeledStatement:
+    return visitLabeledStmt(nodes::cast<nodes::LabeledStatementNode>(node));
+  case nodes::NodeKind::DeclarationStmt:
+    return visitDeclarationStmt(nodes::cast<nodes::DeclarationStmtNode>(node));
+  default:
     error(node->getLocation(), "Unhandled statement type in type checking");
     return errorType_;
   }
@@ -552,19 +1195,19 @@ TypeCheckVisitor::visitStmt(const nodes::StatementNode *node) {
 // *node) {
 //   auto decl = node->getDeclaration();
 
-//   if (auto varDecl = std::dynamic_pointer_cast<nodes::VarDeclNode>(decl)) {
+//   if (auto varDecl = dynamic_cast<nodes::VarDeclNode *>(decl)) {
 //     return visitVarDecl(varDecl.get());
 //   } else if (auto funcDecl =
-//                  std::dynamic_pointer_cast<nodes::FunctionDeclNode>(decl)) {
+//                  dynamic_cast<nodes::FunctionDeclNode *>(decl)) {
 //     return visitFuncDecl(funcDecl.get());
 //   } else if (auto classDecl =
-//                  std::dynamic_pointer_cast<nodes::ClassDeclNode>(decl)) {
+//                  dynamic_cast<nodes::ClassDeclNode *>(decl)) {
 //     return visitClassDecl(classDecl.get());
 //   } else if (auto enumDecl =
-//                  std::dynamic_pointer_cast<nodes::EnumDeclNode>(decl)) {
+//                  dynamic_cast<nodes::EnumDeclNode *>(decl)) {
 //     return visitEnumDecl(enumDecl.get());
 //   } else if (auto interfaceDecl =
-//                  std::dynamic_pointer_cast<nodes::InterfaceDeclNode>(decl)) {
+//                  dynamic_cast<nodes::InterfaceDeclNode *>(decl)) {
 //     return visitInterfaceDecl(interfaceDecl.get());
 //   } else {
 //     error(node->getLocation(), "Unsupported declaration in statement");
@@ -574,34 +1217,49 @@ TypeCheckVisitor::visitStmt(const nodes::StatementNode *node) {
 
 std::shared_ptr<ResolvedType>
 TypeCheckVisitor::visitExprStmt(const nodes::ExpressionStmtNode *node) {
-  visitExpr(node->getExpression().get());
+  visitExpr(node->getExpression());
   return voidType_;
 }
 
 std::shared_ptr<ResolvedType>
 TypeCheckVisitor::visitBlock(const nodes::BlockNode *node) {
   enterScope();
+  if (node->isArena()) {
+    arenas_.emplace_back();
+  }
 
   for (const auto &stmt : node->getStatements()) {
-    visitStmt(stmt.get());
+    visitStmt(stmt);
   }
 
+  if (node->isArena()) {
+    arenas_.pop_back();
+  }
   exitScope();
   return voidType_;
 }
 
 std::shared_ptr<ResolvedType>
 TypeCheckVisitor::visitIfStmt(const nodes::IfStmtNode *node) {
-  auto condType = visitExpr(node->getCondition().get());
+  auto condType = visitExpr(node->getCondition());
   if (!condType->isImplicitlyConvertibleTo(*boolType_)) {
     error(node->getCondition()->getLocation(),
           "If condition must be convertible to boolean");
   }
 
-  visitStmt(node->getThenBranch().get());
+  // A typeof test narrows the variable it checks in each branch
+  bool narrowed = narrowByTypeTest(node->getCondition(), true);
+  visitStmt(node->getThenBranch());
+  if (narrowed) {
+    exitScope();
+  }
 
   if (node->getElseBranch()) {
-    visitStmt(node->getElseBranch().get());
+    narrowed = narrowByTypeTest(node->getCondition(), false);
+    visitStmt(node->getElseBranch());
+    if (narrowed) {
+      exitScope();
+    }
   }
 
   return voidType_;
@@ -609,7 +1267,7 @@ TypeCheckVisitor::visitIfStmt(const nodes::IfStmtNode *node) {
 
 std::shared_ptr<ResolvedType>
 TypeCheckVisitor::visitWhileStmt(const nodes::WhileStmtNode *node) {
-  auto condType = visitExpr(node->getCondition().get());
+  auto condType = visitExpr(node->getCondition());
   if (!condType->isImplicitlyConvertibleTo(*boolType_)) {
     error(node->getCondition()->getLocation(),
           "While condition must be convertible to boolean");
@@ -617,7 +1275,7 @@ TypeCheckVisitor::visitWhileStmt(const nodes::WhileStmtNode *node) {
 
   bool wasInLoop = inLoop_;
   inLoop_ = true;
-  visitStmt(node->getBody().get());
+  visitStmt(node->getBody());
   inLoop_ = wasInLoop;
 
   return voidType_;
@@ -627,10 +1285,10 @@ std::shared_ptr<ResolvedType>
 TypeCheckVisitor::visitDoWhileStmt(const nodes::DoWhileStmtNode *node) {
   bool wasInLoop = inLoop_;
   inLoop_ = true;
-  visitStmt(node->getBody().get());
+  visitStmt(node->getBody());
   inLoop_ = wasInLoop;
 
-  auto condType = visitExpr(node->getCondition().get());
+  auto condType = visitExpr(node->getCondition());
   if (!condType->isImplicitlyConvertibleTo(*boolType_)) {
     error(node->getCondition()->getLocation(),
           "Do-while condition must be convertible to boolean");
@@ -644,11 +1302,11 @@ TypeCheckVisitor::visitForStmt(const nodes::ForStmtNode *node) {
   enterScope();
 
   if (node->getInitializer()) {
-    visitStmt(node->getInitializer().get());
+    visitStmt(node->getInitializer());
   }
 
   if (node->getCondition()) {
-    auto condType = visitExpr(node->getCondition().get());
+    auto condType = visitExpr(node->getCondition());
     if (!condType->isImplicitlyConvertibleTo(*boolType_)) {
       error(node->getCondition()->getLocation(),
             "For loop condition must be convertible to boolean");
@@ -656,12 +1314,12 @@ TypeCheckVisitor::visitForStmt(const nodes::ForStmtNode *node) {
   }
 
   if (node->getIncrement()) {
-    visitExpr(node->getIncrement().get());
+    visitExpr(node->getIncrement());
   }
 
   bool wasInLoop = inLoop_;
   inLoop_ = true;
-  visitStmt(node->getBody().get());
+  visitStmt(node->getBody());
   inLoop_ = wasInLoop;
 
   exitScope();
@@ -672,24 +1330,48 @@ std::shared_ptr<ResolvedType>
 TypeCheckVisitor::visitForOfStmt(const nodes::ForOfStmtNode *node) {
   enterScope();
 
-  auto iterableType = visitExpr(node->getIterable().get());
+  auto iterableType = visitExpr(node->getIterable());
 
-  // Check if iterable is actually iterable (array, etc.)
-  if (iterableType->getKind() != ResolvedType::TypeKind::Array) {
+  // Check if iterable is actually iterable (array, slice)
+  bool iterable = iterableType->getKind() == ResolvedType::TypeKind::Array ||
+                  iterableType->getKind() == ResolvedType::TypeKind::Slice;
+  if (!iterable) {
     warning(node->getIterable()->getLocation(),
             "For-of requires an iterable type");
   }
 
   // Declare the loop variable
-  auto elementType = iterableType->getKind() == ResolvedType::TypeKind::Array
-                         ? iterableType->getElementType()
-                         : errorType_;
+  auto elementType = iterable ? iterableType->getElementType() : errorType_;
 
-  currentScope_->declareVariable(node->getIdentifier(), elementType);
+  scope_.declareVariable(node->getIdentifier(), elementType);
+
+  if (node->isParallel()) {
+    // Each iteration runs as its own call on some worker thread, so only
+    // continue, which ends that call, may leave it
+    if (holdsCountedElements(*iterableType)) {
+      error(node->getIterable()->getLocation(),
+            "A #parallel loop cannot iterate over #shared or #weak pointers");
+    }
+    bool wasInLoop = inLoop_;
+    bool wasInSwitch = inSwitch_;
+    bool wasInParallel = inParallelBody_;
+    size_t parallelDepth = parallelDepth_;
+    inLoop_ = false;
+    inSwitch_ = false;
+    inParallelBody_ = true;
+    parallelDepth_ = scope_.getDepth();
+    visitStmt(node->getBody());
+    inLoop_ = wasInLoop;
+    inSwitch_ = wasInSwitch;
+    inParallelBody_ = wasInParallel;
+    parallelDepth_ = parallelDepth;
+    exitScope();
+    return voidType_;
+  }
 
   bool wasInLoop = inLoop_;
   inLoop_ = true;
-  visitStmt(node->getBody().get());
+  visitStmt(node->getBody());
   inLoop_ = wasInLoop;
 
   exitScope();
@@ -698,15 +1380,17 @@ TypeCheckVisitor::visitForOfStmt(const nodes::ForOfStmtNode *node) {
 
 std::shared_ptr<ResolvedType>
 TypeCheckVisitor::visitBreakStmt(const nodes::BreakStmtNode *node) {
-  if (!inLoop_) {
-    error(node->getLocation(), "Break statement must be inside a loop");
+  if (!inLoop_ && !inSwitch_) {
+    error(node->getLocation(),
+          inParallelBody_ ? "break cannot leave a #parallel loop"
+                          : "Break statement must be inside a loop or switch");
   }
   return voidType_;
 }
 
 std::shared_ptr<ResolvedType>
 TypeCheckVisitor::visitContinueStmt(const nodes::ContinueStmtNode *node) {
-  if (!inLoop_) {
+  if (!inLoop_ && !inParallelBody_) {
     error(node->getLocation(), "Continue statement must be inside a loop");
   }
   return voidType_;
@@ -714,9 +1398,19 @@ TypeCheckVisitor::visitContinueStmt(const nodes::ContinueStmtNode *node) {
 
 std::shared_ptr<ResolvedType>
 TypeCheckVisitor::visitReturnStmt(const nodes::ReturnStmtNode *node) {
+  if (inParallelBody_) {
+    error(node->getLocation(), "return cannot leave a #parallel loop");
+  }
   std::shared_ptr<ResolvedType> returnedType = voidType_;
   if (node->getValue()) {
-    returnedType = visitExpr(node->getValue().get());
+    returnedType = visitExpr(node->getValue());
+    if (!arenas_.empty() && refersToArena(node->getValue()) &&
+        currentFunctionReturnType_ &&
+        holdsReference(*currentFunctionReturnType_)) {
+      error(node->getLocation(), "An object allocated in an #arena block "
+                                 "cannot be returned from it");
+      return errorType_;
+    }
   }
 
   if (currentFunctionReturnType_ &&
@@ -730,9 +1424,15 @@ TypeCheckVisitor::visitReturnStmt(const nodes::ReturnStmtNode *node) {
 
 std::shared_ptr<ResolvedType>
 TypeCheckVisitor::visitTryStmt(const nodes::TryStmtNode *node) {
+  if (inAsyncFunction_) {
+    error(node->getLocation(), "try is not supported in async functions");
+  }
+  if (inParallelBody_) {
+    error(node->getLocation(), "try is not supported in #parallel loops");
+  }
   bool wasInTry = inTryBlock_;
   inTryBlock_ = true;
-  visitStmt(node->getTryBlock().get());
+  visitStmt(node->getTryBlock());
   inTryBlock_ = wasInTry;
 
   // Check catch clauses
@@ -741,19 +1441,19 @@ TypeCheckVisitor::visitTryStmt(const nodes::TryStmtNode *node) {
 
     // Declare catch parameter
     if (catchClause.parameterType) {
-      auto paramType = visitType(catchClause.parameterType.get());
-      currentScope_->declareVariable(catchClause.parameter, paramType);
+      auto paramType = visitType(catchClause.parameterType);
+      scope_.declareVariable(catchClause.parameter, paramType);
     } else {
       // Default exception type
-      currentScope_->declareVariable(catchClause.parameter, errorType_);
+      scope_.declareVariable(catchClause.parameter, errorType_);
     }
 
-    visitStmt(catchClause.body.get());
+    visitStmt(catchClause.body);
     exitScope();
   }
 
   if (node->getFinallyBlock()) {
-    visitStmt(node->getFinallyBlock().get());
+    visitStmt(node->getFinallyBlock());
   }
 
   return voidType_;
@@ -761,29 +1461,80 @@ TypeCheckVisitor::visitTryStmt(const nodes::TryStmtNode *node) {
 
 std::shared_ptr<ResolvedType>
 TypeCheckVisitor::visitThrowStmt(const nodes::ThrowStmtNode *node) {
-  visitExpr(node->getValue().get());
+  if (inAsyncFunction_) {
+    error(node->getLocation(), "throw is not supported in async functions");
+  }
+  if (inParallelBody_) {
+    error(node->getLocation(), "throw cannot leave a #parallel loop");
+  }
+  visitExpr(node->getValue());
   return voidType_;
 }
 
 std::shared_ptr<ResolvedType>
 TypeCheckVisitor::visitSwitchStmt(const nodes::SwitchStmtNode *node) {
-  auto exprType = visitExpr(node->getExpression().get());
+  auto exprType = visitExpr(node->getExpression());
+
+  // switch (typeof x) on a union selects by tag; each label names an arm
+  auto typeOf =
+      nodes::dyn_cast<nodes::UnaryExpressionNode>(node->getExpression());
+  std::shared_ptr<ResolvedType> tested;
+  if (typeOf && typeOf->getExpressionType() == tokens::TokenType::TYPEOF) {
+    tested = typeOf->getOperand()->getResolvedType();
+  }
+  bool byTag = tested && tested->getKind() == ResolvedType::TypeKind::Union;
 
+  bool wasInSwitch = inSwitch_;
+  inSwitch_ = true;
+  bool reachedByFallthrough = false;
   for (const auto &switchCase : node->getCases()) {
+    nodes::TypeTest test;
     if (!switchCase.isDefault && switchCase.value) {
-      auto caseType = visitExpr(switchCase.value.get());
+      auto caseType = visitExpr(switchCase.value);
       if (!caseType->isAssignableTo(*exprType)) {
         error(switchCase.value->getLocation(),
               "Case value type doesn't match switch expression type");
       }
+      auto literal =
+          nodes::dyn_cast<nodes::LiteralExpressionNode>(switchCase.value);
+      if (byTag && (!literal || literal->getExpressionType() !=
+                                    tokens::TokenType::STRING_LITERAL)) {
+        error(switchCase.value->getLocation(),
+              "Case of a typeof switch must name a type");
+      } else if (byTag) {
+        const std::string &text = literal->getValue();
+        test.operand = typeOf->getOperand();
+        test.typeName = text.substr(1, text.size() - 2);
+        checkTypeTest(test, switchCase.value->getLocation());
+      }
     }
 
+    // A body that the one before may fall into holds any arm
     enterScope();
+    if (test.operand && !reachedByFallthrough) {
+      if (auto ident = nodes::dyn_cast<nodes::IdentifierExpressionNode>(
+              test.operand)) {
+        for (const auto &arm : tested->getUnionArms()) {
+          if (arm->toString() == test.typeName) {
+            scope_.declareVariable(ident->getSymbol(), arm);
+          }
+        }
+      }
+    }
     for (const auto &stmt : switchCase.body) {
-      visitStmt(stmt.get());
+      visitStmt(stmt);
     }
     exitScope();
+
+    const nodes::StatementNode *last =
+        switchCase.body.empty() ? nullptr : switchCase.body.back();
+    reachedByFallthrough =
+        !last || (!nodes::isa<nodes::BreakStmtNode>(last) &&
+                  !nodes::isa<nodes::ReturnStmtNode>(last) &&
+                  !nodes::isa<nodes::ContinueStmtNode>(last) &&
+                  !nodes::isa<nodes::ThrowStmtNode>(last));
   }
+  inSwitch_ = wasInSwitch;
 
   return voidType_;
 }
@@ -795,70 +1546,137 @@ TypeCheckVisitor::visitAssemblyStmt(const nodes::AssemblyStmtNode *node) {
     return errorType_;
   }
 
-  // Assembly statements are executed for side effects
-  return voidType_;
-}
-
-std::shared_ptr<ResolvedType>
-TypeCheckVisitor::visitLabeledStmt(const nodes::LabeledStatementNode *node) {
+  // Operands are bound as GCC binds them: outputs are written, so they
+  // must be lvalues; register operands hold numbers and pointers, while
+  // a memory operand ("m") may be any lvalue
+  const auto &outputs = node->getOutputs();
+  auto checkOperand = [&](const nodes::AsmOperand &operand, bool isOutput) {
+    std::string constraint =
+        operand.constraint.size() >= 2
+            ? operand.constraint.substr(1, operand.constraint.size() - 2)
+            : operand.constraint;
+    auto type = visitExpr(operand.expression);
+    auto location = operand.expression->getLocation();
+    bool writes = !constraint.empty() &&
+                  (constraint[0] == '=' || constraint[0] == '+');
+    if (isOutput != writes) {
+      error(location, isOutput ? "Output constraint \"" + constraint +
+                                     "\" must start with '=' or '+'"
+                               : "Input constraint \"" + constraint +
+                                     "\" cannot start with '=' or '+'");
+      return;
+    }
+    std::string codes = constraint.substr(writes ? 1 : 0);
+    if (!codes.empty() && codes[0] == '&') {
+      codes.erase(0, 1);
+    }
+    if (codes.empty()) {
+      error(location, "Assembly operand needs a constraint");
+      return;
+    }
+    bool tied = std::all_of(codes.begin(), codes.end(), [](char c) {
+      return std::isdigit(static_cast<unsigned char>(c)) != 0;
+    });
+    if (tied && (codes.size() > 2 || std::stoul(codes) >= outputs.size())) {
+      error(location, "Constraint \"" + constraint +
+                          "\" does not name an output operand");
+      return;
+    }
+    bool memory = codes == "m";
+    if ((isOutput || memory) &&
+        !nodes::isa<nodes::IdentifierExpressionNode>(operand.expression) &&
+        !nodes::isa<nodes::MemberExpressionNode>(operand.expression) &&
+        !nodes::isa<nodes::IndexExpressionNode>(operand.expression)) {
+      error(location, isOutput
+                          ? "Output operand of an assembly statement must "
+                            "be assignable"
+                          : "Memory operand of an assembly statement must "
+                            "be a variable, field or element");
+      return;
+    }
+    auto kind = type->getKind();
+    if (!memory && kind != ResolvedType::TypeKind::Int &&
+        kind != ResolvedType::TypeKind::Float &&
+        kind != ResolvedType::TypeKind::Pointer &&
+        kind != ResolvedType::TypeKind::Error) {
+      error(location, "Cannot bind " + type->toString() +
+                          " to a register operand of an assembly statement");
+    }
+  };
+  for (const auto &output : outputs) {
+    checkOperand(output, true);
+  }
+  for (const auto &input : node->getInputs()) {
+    checkOperand(input, false);
+  }
+
+  // Assembly statements are executed for side effects
+  return voidType_;
+}
+
+std::shared_ptr<ResolvedType>
+TypeCheckVisitor::visitLabeledStmt(const nodes::LabeledStatementNode *node) {
   // Just check the labeled statement
-  return visitStmt(node->getStatement().get());
+  return visitStmt(node->getStatement());
 }
 
 // Expression visitors
 std::shared_ptr<ResolvedType>
 TypeCheckVisitor::visitExpr(const nodes::ExpressionNode *node) {
-  if (auto binary = dynamic_cast<const nodes::BinaryExpressionNode *>(node)) {
-    return visitBinaryExpr(binary);
-  } else if (auto unary =
-                 dynamic_cast<const nodes::UnaryExpressionNode *>(node)) {
-    return visitUnaryExpr(unary);
-  } else if (auto literal =
-                 dynamic_cast<const nodes::LiteralExpressionNode *>(node)) {
-    return visitLiteralExpr(literal);
-  } else if (auto identifier =
-                 dynamic_cast<const nodes::IdentifierExpressionNode *>(node)) {
-    return visitIdentifierExpr(identifier);
-  } else if (auto call =
-                 dynamic_cast<const nodes::CallExpressionNode *>(node)) {
-    return visitCallExpr(call);
-  } else if (auto assignment =
-                 dynamic_cast<const nodes::AssignmentExpressionNode *>(node)) {
-    return visitAssignmentExpr(assignment);
-  } else if (auto member =
-                 dynamic_cast<const nodes::MemberExpressionNode *>(node)) {
-    return visitMemberExpr(member);
-  } else if (auto index =
-                 dynamic_cast<const nodes::IndexExpressionNode *>(node)) {
-    return visitIndexExpr(index);
-  } else if (auto newExpr =
-                 dynamic_cast<const nodes::NewExpressionNode *>(node)) {
-    return visitNewExpr(newExpr);
-  } else if (auto cast =
-                 dynamic_cast<const nodes::CastExpressionNode *>(node)) {
-    return visitCastExpr(cast);
-  } else if (auto array = dynamic_cast<const nodes::ArrayLiteralNode *>(node)) {
-    return visitArrayLiteral(array);
-  } else if (auto conditional =
-                 dynamic_cast<const nodes::ConditionalExpressionNode *>(node)) {
-    return visitConditionalExpr(conditional);
-  } else if (auto thisExpr =
-                 dynamic_cast<const nodes::ThisExpressionNode *>(node)) {
-    return visitThisExpr(thisExpr);
-  } else if (auto compileTime =
-                 dynamic_cast<const nodes::CompileTimeExpressionNode *>(node)) {
-    return visitCompileTimeExpr(compileTime);
-  } else if (auto templateSpec =
-                 dynamic_cast<const nodes::TemplateSpecializationNode *>(
-                     node)) {
-    return visitTemplateSpecialization(templateSpec);
-  } else if (auto pointerExpr =
-                 dynamic_cast<const nodes::PointerExpressionNode *>(node)) {
-    return visitPointerExpr(pointerExpr);
-  } else if (auto funcExpr =
-                 dynamic_cast<const nodes::FunctionExpressionNode *>(node)) {
-    return visitFunctionExpr(funcExpr);
-  } else {
+  auto type = visitExprKind(node);
+
+  // A generic body is generated once per specialization, each with types
+  // of its own, so only code outside generics keeps what was resolved
+  if (genericDepth_ == 0 && type &&
+      type->getKind() != ResolvedType::TypeKind::Error) {
+    node->setResolvedType(type);
+  }
+  return type;
+}
+
+std::shared_ptr<ResolvedType>
+TypeCheckVisitor::visitExprKind(const nodes::ExpressionNode *node) {
+  switch (node->getNodeKind()) {
+  case nodes::NodeKind::BinaryExpression:
+    return visitBinaryExpr(nodes::cast<nodes::BinaryExpressionNode>(node));
+  case nodes::NodeKind::UnaryExpression:
+    return visitUnaryExpr(nodes::cast<nodes::UnaryExpressionNode>(node));
+  case nodes::NodeKind::LiteralExpression:
+    return visitLiteralExpr(nodes::cast<nodes::LiteralExpressionNode>(node));
+  case nodes::NodeKind::IdentifierExpression:
+    return visitIdentifierExpr(
+        nodes::cast<nodes::IdentifierExpressionNode>(node));
+  case nodes::NodeKind::CallExpression:
+    return visitCallExpr(nodes::cast<nodes::CallExpressionNode>(node));
+  case nodes::NodeKind::AssignmentExpression:
+    return visitAssignmentExpr(
+        nodes::cast<nodes::AssignmentExpressionNode>(node));
+  case nodes::NodeKind::MemberExpression:
+    return visitMemberExpr(nodes::cast<nodes::MemberExpressionNode>(node));
+  case nodes::NodeKind::IndexExpression:
+    return visitIndexExpr(nodes::cast<nodes::IndexExpressionNode>(node));
+  case nodes::NodeKind::NewExpression:
+    return visitNewExpr(nodes::cast<nodes::NewExpressionNode>(node));
+  case nodes::NodeKind::CastExpression:
+    return visitCastExpr(nodes::cast<nodes::CastExpressionNode>(node));
+  case nodes::NodeKind::ArrayLiteral:
+    return visitArrayLiteral(nodes::cast<nodes::ArrayLiteralNode>(node));
+  case nodes::NodeKind::ConditionalExpression:
+    return visitConditionalExpr(
+        nodes::cast<nodes::ConditionalExpressionNode>(node));
+  case nodes::NodeKind::ThisExpression:
+    return visitThisExpr(nodes::cast<nodes::ThisExpressionNode>(node));
+  case nodes::NodeKind::CompileTimeExpression:
+    return visitCompileTimeExpr(
+        nodes::cast<nodes::CompileTimeExpressionNode>(node));
+  case nodes::NodeKind::TemplateSpecialization:
+    return visitTemplateSpecialization(
+        nodes::cast<nodes::TemplateSpecializationNode>(node));
+  case nodes::NodeKind::PointerExpression:
+    return visitPointerExpr(nodes::cast<nodes::PointerExpressionNode>(node));
+  case nodes::NodeKind::FunctionExpression:
+    return visitFunctionExpr(nodes::cast<nodes::FunctionExpressionNode>(node));
+  default:
     error(node->getLocation(), "Unhandled expression type in type checking");
     return errorType_;
   }
@@ -866,16 +1684,74 @@ TypeCheckVisitor::visitExpr(const nodes::ExpressionNode *node) {
 
 std::shared_ptr<ResolvedType>
 TypeCheckVisitor::visitBinaryExpr(const nodes::BinaryExpressionNode *node) {
-  auto leftType = visitExpr(node->getLeft().get());
-  auto rightType = visitExpr(node->getRight().get());
+  auto leftType = visitExpr(node->getLeft());
+  auto rightType = visitExpr(node->getRight());
 
+  nodes::TypeTest test;
+  if (nodes::getTypeTest(node, test)) {
+    checkTypeTest(test, node->getLocation());
+  }
   return checkBinaryOp(node->getExpressionType(), leftType, rightType,
                        node->getLocation());
 }
 
+void TypeCheckVisitor::checkTypeTest(const nodes::TypeTest &test,
+                                     const core::SourceLocation &location) {
+  auto type = test.operand->getResolvedType();
+  if (!type || type->getKind() != ResolvedType::TypeKind::Union) {
+    return;
+  }
+  for (const auto &arm : type->getUnionArms()) {
+    if (arm->toString() == test.typeName) {
+      return;
+    }
+  }
+  error(location, "'" + test.typeName + "' is not a type of " +
+                      type->toString());
+}
+
+bool TypeCheckVisitor::narrowByTypeTest(const nodes::ExpressionNode *condition,
+                                        bool holds) {
+  nodes::TypeTest test;
+  if (!nodes::getTypeTest(condition, test)) {
+    return false;
+  }
+  auto ident = nodes::dyn_cast<nodes::IdentifierExpressionNode>(test.operand);
+  auto type = test.operand->getResolvedType();
+  if (!ident || !type || type->getKind() != ResolvedType::TypeKind::Union) {
+    return false;
+  }
+
+  // Where the test fails, only a union of two is left with one arm
+  auto arms = type->getUnionArms();
+  std::shared_ptr<ResolvedType> narrowed;
+  for (size_t i = 0; i < arms.size(); ++i) {
+    if (arms[i]->toString() != test.typeName) {
+      continue;
+    }
+    if (holds != test.negated) {
+      narrowed = arms[i];
+    } else if (arms.size() == 2) {
+      narrowed = arms[1 - i];
+    }
+  }
+  if (!narrowed) {
+    return false;
+  }
+  enterScope();
+  scope_.declareVariable(ident->getSymbol(), narrowed);
+  return true;
+}
+
 std::shared_ptr<ResolvedType>
 TypeCheckVisitor::visitUnaryExpr(const nodes::UnaryExpressionNode *node) {
-  auto operandType = visitExpr(node->getOperand().get());
+  if (node->getExpressionType() == tokens::TokenType::AWAIT) {
+    return visitAwaitExpr(node);
+  }
+  auto operandType = visitExpr(node->getOperand());
+  if (node->getExpressionType() == tokens::TokenType::TYPEOF) {
+    return stringType_; // The name of the type it holds
+  }
   return checkUnaryOp(node->getExpressionType(), operandType, node->isPrefix(),
                       node->getLocation());
 }
@@ -883,12 +1759,19 @@ TypeCheckVisitor::visitUnaryExpr(const nodes::UnaryExpressionNode *node) {
 std::shared_ptr<ResolvedType>
 TypeCheckVisitor::visitLiteralExpr(const nodes::LiteralExpressionNode *node) {
   switch (node->getExpressionType()) {
-  case tokens::TokenType::NUMBER:
-    if (node->getValue().find('.') != std::string::npos) {
+  case tokens::TokenType::NUMBER: {
+    // A fraction or exponent makes a float literal, as in code generation
+    const tokens::NumberValue &number = node->getNumber();
+    if (number.isFloat()) {
       return floatType_;
-    } else {
-      return intType_;
     }
+    if (!number.isInteger() || number.integer > INT32_MAX) {
+      error(node->getLocation(),
+            "Integer literal does not fit in an int: " + node->getValue());
+      return errorType_;
+    }
+    return intType_;
+  }
   case tokens::TokenType::STRING_LITERAL:
     return stringType_;
   case tokens::TokenType::TRUE:
@@ -902,10 +1785,10 @@ TypeCheckVisitor::visitLiteralExpr(const nodes::LiteralExpressionNode *node) {
 
 std::shared_ptr<ResolvedType> TypeCheckVisitor::visitIdentifierExpr(
     const nodes::IdentifierExpressionNode *node) {
-  auto varType = currentScope_->lookupVariable(node->getName());
+  auto varType = scope_.lookupVariable(node->getSymbol());
 
   if (!varType) {
-    varType = currentScope_->lookupFunction(node->getName());
+    varType = scope_.lookupFunction(node->getSymbol());
   }
 
   if (!varType) {
@@ -913,29 +1796,164 @@ std::shared_ptr<ResolvedType> TypeCheckVisitor::visitIdentifierExpr(
     return errorType_;
   }
 
+  // Codegen publishes the counted pointers a #parallel loop shares, but
+  // not every element of an array of them
+  if (inParallelBody_ && holdsCountedElements(*varType)) {
+    size_t depth = scope_.getVariableDepth(node->getSymbol());
+    if (depth > 0 && depth < parallelDepth_) {
+      error(node->getLocation(),
+            "A #parallel loop cannot share '" + node->getName() +
+                "', an array of #shared or #weak pointers");
+    }
+  }
+
   return varType;
 }
 
 std::shared_ptr<ResolvedType>
 TypeCheckVisitor::visitCallExpr(const nodes::CallExpressionNode *node) {
-  auto calleeType = visitExpr(node->getCallee().get());
+  // float4(x, y, z, w) builds a vector, unless a variable or function
+  // hides the type's name
+  if (auto ident = nodes::dyn_cast<nodes::IdentifierExpressionNode>(
+          node->getCallee())) {
+    auto type = scope_.lookupType(ident->getName());
+    if (type && type->getKind() == ResolvedType::TypeKind::Vector &&
+        !scope_.lookupVariable(ident->getSymbol()) &&
+        !scope_.lookupFunction(ident->getSymbol())) {
+      return checkVectorConstruction(node, type);
+    }
+    if (ident->getName() == "blackBox" &&
+        !scope_.lookupVariable(ident->getSymbol()) &&
+        !scope_.lookupFunction(ident->getSymbol())) {
+      return checkBlackBox(node);
+    }
+  }
+
+  auto calleeType = visitExpr(node->getCallee());
+  if (calleeType->getKind() == ResolvedType::TypeKind::Error) {
+    return errorType_; // Already reported
+  }
 
   if (calleeType->getKind() != ResolvedType::TypeKind::Function) {
     error(node->getCallee()->getLocation(), "Cannot call non-function type");
     return errorType_;
   }
+  if (node->getCallee() == atomicMember_) {
+    return checkAtomicCall(node, calleeType);
+  }
+  if (node->getCallee() == vectorMember_) {
+    return checkVectorCall(node, calleeType);
+  }
+
+  auto resultType =
+      checkFunctionCall(calleeType, node->getArguments(),
+                        node->getTypeArguments(), node->getLocation());
 
-  return checkFunctionCall(calleeType, node->getArguments(),
-                           node->getTypeArguments(), node->getLocation());
+  // Tasks belong to the thread that starts them, which a #parallel
+  // iteration does not choose
+  if (calleeType->isAsync() && inParallelBody_) {
+    error(node->getLocation(), "async calls are not allowed in #parallel loops");
+    return errorType_;
+  }
+  // A task would keep allocating into the arena after it is released
+  if (calleeType->isAsync() && !arenas_.empty() && node != awaitedCall_) {
+    error(node->getLocation(), "async calls are not allowed in #arena blocks");
+    return errorType_;
+  }
+
+  // Inside an async function, an async call that is not awaited starts a
+  // task that runs on by itself; elsewhere the call waits for the result
+  if (calleeType->isAsync() && inAsyncFunction_ && node != awaitedCall_ &&
+      resultType->getKind() != ResolvedType::TypeKind::Error) {
+    return voidType_;
+  }
+  return resultType;
+}
+
+std::shared_ptr<ResolvedType>
+TypeCheckVisitor::visitAwaitExpr(const nodes::UnaryExpressionNode *node) {
+  if (!inAsyncFunction_) {
+    error(node->getLocation(), "'await' is only allowed in async functions");
+    return errorType_;
+  }
+  // Other tasks would allocate into the arena while this one waits
+  if (!arenas_.empty()) {
+    error(node->getLocation(), "'await' is not allowed in #arena blocks");
+    return errorType_;
+  }
+  auto call = nodes::dyn_cast<nodes::CallExpressionNode>(node->getOperand());
+  if (!call) {
+    error(node->getLocation(), "'await' needs a call to an async function");
+    return errorType_;
+  }
+
+  auto wasAwaited = awaitedCall_;
+  awaitedCall_ = call;
+  auto resultType = visitExpr(call);
+  awaitedCall_ = wasAwaited;
+
+  auto calleeType = call->getCallee()->getResolvedType();
+  if (resultType->getKind() != ResolvedType::TypeKind::Error &&
+      (!calleeType || !calleeType->isAsync())) {
+    error(node->getLocation(), "'await' needs a call to an async function");
+    return errorType_;
+  }
+  return resultType;
 }
 
 std::shared_ptr<ResolvedType> TypeCheckVisitor::visitAssignmentExpr(
     const nodes::AssignmentExpressionNode *node) {
-  auto targetType = visitExpr(node->getTarget().get());
-  auto valueType = visitExpr(node->getValue().get());
+  auto targetType = visitExpr(node->getTarget());
+  auto valueType = visitExpr(node->getValue());
 
   auto op = node->getExpressionType();
 
+  // Slices only read what they view
+  auto indexed = nodes::dyn_cast<nodes::IndexExpressionNode>(node->getTarget());
+  if (indexed && indexed->getArray()->getResolvedType() &&
+      indexed->getArray()->getResolvedType()->getKind() ==
+          ResolvedType::TypeKind::Slice) {
+    error(node->getLocation(),
+          "Cannot assign through " +
+              indexed->getArray()->getResolvedType()->toString() +
+              "; slices are read-only");
+    return errorType_;
+  }
+
+  // A closure has its own copy of the enclosing function's locals
+  if (auto ident =
+          nodes::dyn_cast<nodes::IdentifierExpressionNode>(node->getTarget())) {
+    size_t depth = scope_.getVariableDepth(ident->getSymbol());
+    if (!closureDepths_.empty() && depth > 0 &&
+        depth <= closureDepths_.back()) {
+      error(node->getLocation(), "Closures capture '" + ident->getName() +
+                                     "' by value; it cannot be assigned "
+                                     "here");
+      return errorType_;
+    }
+  }
+
+  // Objects of an #arena block are released with it
+  if (op == tokens::TokenType::EQUALS && !arenas_.empty() &&
+      refersToArena(node->getValue()) && holdsReference(*targetType)) {
+    if (outlivesArena(node->getTarget())) {
+      error(node->getLocation(), "A reference to an object allocated in an "
+                                 "#arena block cannot be stored outside it");
+      return errorType_;
+    }
+    if (auto ident = nodes::dyn_cast<nodes::IdentifierExpressionNode>(
+            node->getTarget())) {
+      arenas_.back().references.insert(ident->getName());
+    }
+  }
+
+  // A plain store would not be atomic
+  if (targetType->getKind() == ResolvedType::TypeKind::Atomic) {
+    error(node->getLocation(),
+          "Use store() to assign to " + targetType->toString());
+    return errorType_;
+  }
+
   if (op == tokens::TokenType::EQUALS) {
     if (!checkAssignmentCompatibility(targetType, valueType,
                                       node->getLocation())) {
@@ -980,20 +1998,93 @@ std::shared_ptr<ResolvedType> TypeCheckVisitor::visitAssignmentExpr(
 
 std::shared_ptr<ResolvedType>
 TypeCheckVisitor::visitMemberExpr(const nodes::MemberExpressionNode *node) {
-  auto objectType = visitExpr(node->getObject().get());
+  // Members are reached the same way through pointers and references
+  auto objectType = visitExpr(node->getObject());
+  while (objectType->getKind() == ResolvedType::TypeKind::Pointer ||
+         objectType->getKind() == ResolvedType::TypeKind::Reference ||
+         objectType->getKind() == ResolvedType::TypeKind::Smart) {
+    objectType = objectType->getPointeeType();
+  }
+  if (objectType->getKind() == ResolvedType::TypeKind::Error) {
+    return errorType_;
+  }
+  // Arrays, slices and strings know their length; arrays also grow, and
+  // slices narrow to slice(begin, end)
+  if ((objectType->getKind() == ResolvedType::TypeKind::Array ||
+       objectType->getKind() == ResolvedType::TypeKind::Slice ||
+       objectType->getKind() == ResolvedType::TypeKind::String) &&
+      node->getMember() == "length") {
+    return intType_;
+  }
+  if (objectType->getKind() == ResolvedType::TypeKind::Slice &&
+      node->getMember() == "slice") {
+    return types_.getFunction(objectType, {intType_, intType_});
+  }
+  if (objectType->getKind() == ResolvedType::TypeKind::Array) {
+    if (node->getMember() == "push") {
+      return types_.getFunction(voidType_, {objectType->getElementType()});
+    }
+    if (node->getMember() == "reserve") {
+      return types_.getFunction(voidType_, {intType_});
+    }
+  }
+  if (objectType->getKind() == ResolvedType::TypeKind::Template &&
+      isContainerName(objectType->getName())) {
+    auto methodType = containerMethodType(node->getMember(), objectType);
+    if (!methodType) {
+      error(node->getLocation(), objectType->toString() + " has no method '" +
+                                     node->getMember() + "'");
+      return errorType_;
+    }
+    return methodType;
+  }
+  if (objectType->getKind() == ResolvedType::TypeKind::Atomic) {
+    auto methodType =
+        atomicMethodType(node->getMember(), objectType->getElementType());
+    if (!methodType) {
+      error(node->getLocation(), objectType->toString() +
+                                     " has no operation '" +
+                                     node->getMember() + "'");
+      return errorType_;
+    }
+    atomicMember_ = node;
+    return methodType;
+  }
+  if (objectType->getKind() == ResolvedType::TypeKind::Vector) {
+    auto methodType = vectorMethodType(node->getMember(), objectType);
+    if (!methodType) {
+      error(node->getLocation(), objectType->toString() +
+                                     " has no operation '" +
+                                     node->getMember() + "'");
+      return errorType_;
+    }
+    vectorMember_ = node;
+    return methodType;
+  }
+  if (objectType->getKind() != ResolvedType::TypeKind::Named) {
+    error(node->getLocation(), "Cannot access member '" + node->getMember() +
+                                   "' of " + objectType->toString());
+    return errorType_;
+  }
 
-  // For now, just return error type since we don't have complete member lookup
-  error(node->getLocation(),
-        "Member access type checking not fully implemented");
-  return errorType_;
+  auto member = types_.lookupMember(*objectType, node->getMemberSymbol());
+  if (!member) {
+    error(node->getLocation(), "'" + objectType->getName() +
+                                   "' has no member '" + node->getMember() +
+                                   "'");
+    return errorType_;
+  }
+  return member;
 }
 
 std::shared_ptr<ResolvedType>
 TypeCheckVisitor::visitIndexExpr(const nodes::IndexExpressionNode *node) {
-  auto arrayType = visitExpr(node->getArray().get());
-  auto indexType = visitExpr(node->getIndex().get());
+  auto arrayType = visitExpr(node->getArray());
+  auto indexType = visitExpr(node->getIndex());
 
-  if (arrayType->getKind() != ResolvedType::TypeKind::Array) {
+  if (arrayType->getKind() != ResolvedType::TypeKind::Array &&
+      arrayType->getKind() != ResolvedType::TypeKind::Slice &&
+      arrayType->getKind() != ResolvedType::TypeKind::Vector) {
     error(node->getArray()->getLocation(), "Cannot index non-array type");
     return errorType_;
   }
@@ -1007,15 +2098,38 @@ TypeCheckVisitor::visitIndexExpr(const nodes::IndexExpressionNode *node) {
 
 std::shared_ptr<ResolvedType>
 TypeCheckVisitor::visitNewExpr(const nodes::NewExpressionNode *node) {
-  auto classType = currentScope_->lookupType(node->getClassName());
+  if (isContainerName(node->getClassName())) {
+    return visitContainerNew(node);
+  }
+  auto classType = scope_.lookupType(node->getClassName());
   if (!classType) {
     error(node->getLocation(), "Undefined class: " + node->getClassName());
     return errorType_;
   }
+  if (valueClasses_.count(node->getClassName())) {
+    error(node->getLocation(), "'" + node->getClassName() +
+                                   "' is a #stack class; declare a variable "
+                                   "of it instead of using new");
+    return errorType_;
+  }
 
   // Check constructor arguments (simplified)
   for (const auto &arg : node->getArguments()) {
-    visitExpr(arg.get());
+    visitExpr(arg);
+  }
+
+  // new Box<int>() creates the specialization named by its type arguments
+  if (!node->getTypeArguments().empty()) {
+    std::vector<std::shared_ptr<ResolvedType>> typeArgs;
+    for (const auto &name : node->getTypeArguments()) {
+      auto typeArg = scope_.lookupType(name);
+      if (!typeArg) {
+        error(node->getLocation(), "Undefined type: " + name);
+        return errorType_;
+      }
+      typeArgs.push_back(typeArg);
+    }
+    return types_.getTemplate(node->getClassName(), typeArgs);
   }
 
   return classType;
@@ -1023,8 +2137,8 @@ TypeCheckVisitor::visitNewExpr(const nodes::NewExpressionNode *node) {
 
 std::shared_ptr<ResolvedType>
 TypeCheckVisitor::visitCastExpr(const nodes::CastExpressionNode *node) {
-  auto exprType = visitExpr(node->getExpression().get());
-  auto targetType = currentScope_->lookupType(node->getTargetType());
+  auto exprType = visitExpr(node->getExpression());
+  auto targetType = scope_.lookupType(node->getTargetType());
 
   if (!targetType) {
     error(node->getLocation(), "Undefined type: " + node->getTargetType());
@@ -1048,10 +2162,10 @@ TypeCheckVisitor::visitArrayLiteral(const nodes::ArrayLiteralNode *node) {
     return errorType_;
   }
 
-  auto elementType = visitExpr(elements[0].get());
+  auto elementType = visitExpr(elements[0]);
 
   for (size_t i = 1; i < elements.size(); i++) {
-    auto nextType = visitExpr(elements[i].get());
+    auto nextType = visitExpr(elements[i]);
     if (!nextType->isAssignableTo(*elementType)) {
       error(elements[i]->getLocation(),
             "Array elements must have compatible types");
@@ -1059,19 +2173,19 @@ TypeCheckVisitor::visitArrayLiteral(const nodes::ArrayLiteralNode *node) {
     }
   }
 
-  return std::make_shared<ResolvedType>(ResolvedType::Array(elementType));
+  return types_.getArray(elementType);
 }
 
 std::shared_ptr<ResolvedType> TypeCheckVisitor::visitConditionalExpr(
     const nodes::ConditionalExpressionNode *node) {
-  auto condType = visitExpr(node->getCondition().get());
+  auto condType = visitExpr(node->getCondition());
   if (!condType->isImplicitlyConvertibleTo(*boolType_)) {
     error(node->getCondition()->getLocation(),
           "Conditional expression condition must be boolean");
   }
 
-  auto trueType = visitExpr(node->getTrueExpression().get());
-  auto falseType = visitExpr(node->getFalseExpression().get());
+  auto trueType = visitExpr(node->getTrueExpression());
+  auto falseType = visitExpr(node->getFalseExpression());
 
   // Return the more general type
   if (trueType->isAssignableTo(*falseType)) {
@@ -1096,16 +2210,16 @@ TypeCheckVisitor::visitThisExpr(const nodes::ThisExpressionNode *node) {
 
 std::shared_ptr<ResolvedType> TypeCheckVisitor::visitCompileTimeExpr(
     const nodes::CompileTimeExpressionNode *node) {
-  visitExpr(node->getOperand().get());
+  visitExpr(node->getOperand());
 
   // Compile-time expressions typically return compile-time constants
   // For simplicity, return the operand type
-  return visitExpr(node->getOperand().get());
+  return visitExpr(node->getOperand());
 }
 
 std::shared_ptr<ResolvedType> TypeCheckVisitor::visitTemplateSpecialization(
     const nodes::TemplateSpecializationNode *node) {
-  auto baseType = visitExpr(node->getBase().get());
+  auto baseType = visitExpr(node->getBase());
 
   // For now, return the base type
   // In a complete implementation, we would resolve the template specialization
@@ -1114,12 +2228,11 @@ std::shared_ptr<ResolvedType> TypeCheckVisitor::visitTemplateSpecialization(
 
 std::shared_ptr<ResolvedType>
 TypeCheckVisitor::visitPointerExpr(const nodes::PointerExpressionNode *node) {
-  auto operandType = visitExpr(node->getOperand().get());
+  auto operandType = visitExpr(node->getOperand());
 
   bool isUnsafe =
       (node->getKind() == nodes::PointerExpressionNode::PointerKind::Unsafe);
-  return std::make_shared<ResolvedType>(
-      ResolvedType::Pointer(operandType, isUnsafe));
+  return types_.getPointer(operandType, isUnsafe);
 }
 
 std::shared_ptr<ResolvedType>
@@ -1127,70 +2240,81 @@ TypeCheckVisitor::visitFunctionExpr(const nodes::FunctionExpressionNode *node) {
   // Process return type
   std::shared_ptr<ResolvedType> returnType;
   if (node->getReturnType()) {
-    returnType = visitType(node->getReturnType().get());
+    returnType = visitType(node->getReturnType());
   } else {
     returnType = voidType_;
   }
 
-  // Process parameters
+  // Process parameters; a closure cannot outlive what a ref names
   std::vector<std::shared_ptr<ResolvedType>> paramTypes;
   for (const auto &param : node->getParameters()) {
-    auto paramType = visitParameter(param.get());
+    if (param->isRef()) {
+      error(param->getLocation(), "Parameter '" + param->getName() +
+                                      "' of a function expression cannot "
+                                      "be ref");
+    }
+    auto paramType = visitParameter(param);
     paramTypes.push_back(paramType);
   }
 
-  // Check function body
+  // Check function body, which runs whenever the closure is called: the
+  // enclosing function's loops and result are not its own
+  auto outerReturnType = currentFunctionReturnType_;
+  bool outerLoop = inLoop_;
+  bool outerSwitch = inSwitch_;
+  bool outerAsync = inAsyncFunction_;
+  inLoop_ = inSwitch_ = inAsyncFunction_ = false;
+  closureDepths_.push_back(scope_.getDepth());
   enterFunctionScope(returnType);
 
   for (const auto &param : node->getParameters()) {
-    auto paramType = visitParameter(param.get());
-    currentScope_->declareVariable(param->getName(), paramType);
+    declareParameter(param);
   }
 
-  visitBlock(node->getBody().get());
+  visitBlock(node->getBody());
   exitFunctionScope();
+  closureDepths_.pop_back();
+  currentFunctionReturnType_ = outerReturnType;
+  inLoop_ = outerLoop;
+  inSwitch_ = outerSwitch;
+  inAsyncFunction_ = outerAsync;
 
-  return std::make_shared<ResolvedType>(
-      ResolvedType::Function(returnType, paramTypes));
+  return types_.getFunction(returnType, paramTypes);
 }
 
 // Type visitors
 std::shared_ptr<ResolvedType>
 TypeCheckVisitor::visitType(const nodes::TypeNode *node) {
-  if (auto primitive = dynamic_cast<const nodes::PrimitiveTypeNode *>(node)) {
-    return visitPrimitiveType(primitive);
-  } else if (auto named = dynamic_cast<const nodes::NamedTypeNode *>(node)) {
-    return visitNamedType(named);
-  } else if (auto qualified =
-                 dynamic_cast<const nodes::QualifiedTypeNode *>(node)) {
-    return visitQualifiedType(qualified);
-  } else if (auto array = dynamic_cast<const nodes::ArrayTypeNode *>(node)) {
-    return visitArrayType(array);
-  } else if (auto pointer =
-                 dynamic_cast<const nodes::PointerTypeNode *>(node)) {
-    return visitPointerType(pointer);
-  } else if (auto reference =
-                 dynamic_cast<const nodes::ReferenceTypeNode *>(node)) {
-    return visitReferenceType(reference);
-  } else if (auto function =
-                 dynamic_cast<const nodes::FunctionTypeNode *>(node)) {
-    return visitFunctionType(function);
-  } else if (auto templateType =
-                 dynamic_cast<const nodes::TemplateTypeNode *>(node)) {
-    return visitTemplateType(templateType);
-  } else if (auto smartPointer =
-                 dynamic_cast<const nodes::SmartPointerTypeNode *>(node)) {
-    return visitSmartPointerType(smartPointer);
-  } else if (auto unionType =
-                 dynamic_cast<const nodes::UnionTypeNode *>(node)) {
-    return visitUnionType(unionType);
-  } else if (auto genericParam =
-                 dynamic_cast<const nodes::GenericParamNode *>(node)) {
-    return visitGenericParam(genericParam);
-  } else if (auto builtinConstraint =
-                 dynamic_cast<const nodes::BuiltinConstraintNode *>(node)) {
-    return visitBuiltinConstraint(builtinConstraint);
-  } else {
+  switch (node->getNodeKind()) {
+  case nodes::NodeKind::PrimitiveType:
+    return visitPrimitiveType(nodes::cast<nodes::PrimitiveTypeNode>(node));
+  case nodes::NodeKind::NamedType:
+    return visitNamedType(nodes::cast<nodes::NamedTypeNode>(node));
+  case nodes::NodeKind::QualifiedType:
+    return visitQualifiedType(nodes::cast<nodes::QualifiedTypeNode>(node));
+  case nodes::NodeKind::ArrayType:
+    return visitArrayType(nodes::cast<nodes::ArrayTypeNode>(node));
+  case nodes::NodeKind::PointerType:
+    return visitPointerType(nodes::cast<nodes::PointerTypeNode>(node));
+  case nodes::NodeKind::ReferenceType:
+    return visitReferenceType(nodes::cast<nodes::ReferenceTypeNode>(node));
+  case nodes::NodeKind::FunctionType:
+    return visitFunctionType(nodes::cast<nodes::FunctionTypeNode>(node));
+  case nodes::NodeKind::TemplateType:
+    return visitTemplateType(nodes::cast<nodes::TemplateTypeNode>(node));
+  case nodes::NodeKind::SmartPointerType:
+    return visitSmartPointerType(
+        nodes::cast<nodes::SmartPointerTypeNode>(node));
+  case nodes::NodeKind::AtomicType:
+    return visitAtomicType(nodes::cast<nodes::AtomicTypeNode>(node));
+  case nodes::NodeKind::UnionType:
+    return visitUnionType(nodes::cast<nodes::UnionTypeNode>(node));
+  case nodes::NodeKind::GenericParam:
+    return visitGenericParam(nodes::cast<nodes::GenericParamNode>(node));
+  case nodes::NodeKind::BuiltinConstraint:
+    return visitBuiltinConstraint(
+        nodes::cast<nodes::BuiltinConstraintNode>(node));
+  default:
     error(node->getLocation(), "Unhandled type in type checking");
     return errorType_;
   }
@@ -1198,6 +2322,11 @@ TypeCheckVisitor::visitType(const nodes::TypeNode *node) {
 
 std::shared_ptr<ResolvedType>
 TypeCheckVisitor::visitPrimitiveType(const nodes::PrimitiveTypeNode *node) {
+  if (node->isVector()) {
+    return types_.getVector(
+        node->getType() == tokens::TokenType::FLOAT ? floatType_ : intType_,
+        node->getLanes());
+  }
   switch (node->getType()) {
   case tokens::TokenType::VOID:
     return voidType_;
@@ -1217,7 +2346,7 @@ TypeCheckVisitor::visitPrimitiveType(const nodes::PrimitiveTypeNode *node) {
 
 std::shared_ptr<ResolvedType>
 TypeCheckVisitor::visitNamedType(const nodes::NamedTypeNode *node) {
-  auto type = currentScope_->lookupType(node->getName());
+  auto type = scope_.lookupType(node->getName());
   if (!type) {
     error(node->getLocation(), "Undefined type: " + node->getName());
     return errorType_;
@@ -1227,17 +2356,15 @@ TypeCheckVisitor::visitNamedType(const nodes::NamedTypeNode *node) {
 
 std::shared_ptr<ResolvedType>
 TypeCheckVisitor::visitQualifiedType(const nodes::QualifiedTypeNode *node) {
-  // For now, just treat as named type using the last qualifier
-  const auto &qualifiers = node->getQualifiers();
-  if (qualifiers.empty()) {
+  if (node->getQualifiers().empty()) {
     error(node->getLocation(), "Empty qualified type");
     return errorType_;
   }
 
-  // In a complete implementation, we would resolve the namespace chain
-  auto type = currentScope_->lookupType(qualifiers.back());
+  // declareAST entered namespace members under their whole dotted name
+  auto type = scope_.lookupType(node->getSymbol());
   if (!type) {
-    error(node->getLocation(), "Undefined qualified type");
+    error(node->getLocation(), "Undefined type: " + node->toString());
     return errorType_;
   }
   return type;
@@ -1245,53 +2372,69 @@ TypeCheckVisitor::visitQualifiedType(const nodes::QualifiedTypeNode *node) {
 
 std::shared_ptr<ResolvedType>
 TypeCheckVisitor::visitArrayType(const nodes::ArrayTypeNode *node) {
-  auto elementType = visitType(node->getElementType().get());
+  auto elementType = visitType(node->getElementType());
 
   if (node->getSize()) {
-    auto sizeType = visitExpr(node->getSize().get());
+    auto sizeType = visitExpr(node->getSize());
     if (!sizeType->isAssignableTo(*intType_)) {
       error(node->getSize()->getLocation(), "Array size must be an integer");
     }
   }
 
-  return std::make_shared<ResolvedType>(ResolvedType::Array(elementType));
+  return types_.getArray(elementType);
 }
 
 std::shared_ptr<ResolvedType>
 TypeCheckVisitor::visitPointerType(const nodes::PointerTypeNode *node) {
-  auto pointeeType = visitType(node->getBaseType().get());
+  auto pointeeType = visitType(node->getBaseType());
   bool isUnsafe =
       node->getKind() == nodes::PointerTypeNode::PointerKind::Unsafe;
-  return std::make_shared<ResolvedType>(
-      ResolvedType::Pointer(pointeeType, isUnsafe));
+  return types_.getPointer(pointeeType, isUnsafe);
 }
 
 std::shared_ptr<ResolvedType>
 TypeCheckVisitor::visitReferenceType(const nodes::ReferenceTypeNode *node) {
-  auto baseType = visitType(node->getBaseType().get());
-  return std::make_shared<ResolvedType>(ResolvedType::Reference(baseType));
+  auto baseType = visitType(node->getBaseType());
+  return types_.getReference(baseType);
 }
 
 std::shared_ptr<ResolvedType>
 TypeCheckVisitor::visitFunctionType(const nodes::FunctionTypeNode *node) {
-  auto returnType = visitType(node->getReturnType().get());
+  auto returnType = visitType(node->getReturnType());
 
   std::vector<std::shared_ptr<ResolvedType>> paramTypes;
   for (const auto &paramType : node->getParameterTypes()) {
-    paramTypes.push_back(visitType(paramType.get()));
+    paramTypes.push_back(visitType(paramType));
   }
 
-  return std::make_shared<ResolvedType>(
-      ResolvedType::Function(returnType, paramTypes));
+  return types_.getFunction(returnType, paramTypes);
 }
 
 std::shared_ptr<ResolvedType>
 TypeCheckVisitor::visitTemplateType(const nodes::TemplateTypeNode *node) {
-  auto baseType = visitType(node->getBaseType().get());
+  // slice<T> is built in, unless a class takes the name
+  auto named = nodes::dyn_cast<nodes::NamedTypeNode>(node->getBaseType());
+  if (named && named->getName() == "slice" && !scope_.lookupType("slice")) {
+    if (node->getArguments().size() != 1) {
+      error(node->getLocation(), "slice takes one element type");
+      return errorType_;
+    }
+    return types_.getSlice(visitType(node->getArguments()[0]));
+  }
+  // So are the concurrent containers
+  if (named && isContainerName(named->getName())) {
+    std::vector<std::shared_ptr<ResolvedType>> argTypes;
+    for (const auto &argType : node->getArguments()) {
+      argTypes.push_back(visitType(argType));
+    }
+    return checkContainerType(named->getName(), argTypes, node->getLocation());
+  }
+
+  auto baseType = visitType(node->getBaseType());
 
   std::vector<std::shared_ptr<ResolvedType>> argTypes;
   for (const auto &argType : node->getArguments()) {
-    argTypes.push_back(visitType(argType.get()));
+    argTypes.push_back(visitType(argType));
   }
 
   if (baseType->getKind() != ResolvedType::TypeKind::Named) {
@@ -1300,13 +2443,12 @@ TypeCheckVisitor::visitTemplateType(const nodes::TemplateTypeNode *node) {
     return errorType_;
   }
 
-  return std::make_shared<ResolvedType>(
-      ResolvedType::Template(baseType->getName(), argTypes));
+  return types_.getTemplate(baseType->getName(), argTypes);
 }
 
 std::shared_ptr<ResolvedType> TypeCheckVisitor::visitSmartPointerType(
     const nodes::SmartPointerTypeNode *node) {
-  auto pointeeType = visitType(node->getPointeeType().get());
+  auto pointeeType = visitType(node->getPointeeType());
 
   ResolvedType::SmartKind kind;
   switch (node->getKind()) {
@@ -1324,26 +2466,43 @@ std::shared_ptr<ResolvedType> TypeCheckVisitor::visitSmartPointerType(
     return errorType_;
   }
 
-  return std::make_shared<ResolvedType>(ResolvedType::Smart(pointeeType, kind));
+  return types_.getSmart(pointeeType, kind);
+}
+
+std::shared_ptr<ResolvedType>
+TypeCheckVisitor::visitAtomicType(const nodes::AtomicTypeNode *node) {
+  auto valueType = visitType(node->getValueType());
+  switch (valueType->getKind()) {
+  case ResolvedType::TypeKind::Int:
+  case ResolvedType::TypeKind::Float:
+  case ResolvedType::TypeKind::Bool:
+  case ResolvedType::TypeKind::Pointer:
+    return types_.getAtomic(valueType);
+  case ResolvedType::TypeKind::Error:
+    return errorType_;
+  default:
+    error(node->getLocation(), "#atomic needs an int, float, bool or "
+                               "pointer value, not " +
+                                   valueType->toString());
+    return errorType_;
+  }
 }
 
 std::shared_ptr<ResolvedType>
 TypeCheckVisitor::visitUnionType(const nodes::UnionTypeNode *node) {
-  auto leftType = visitType(node->getLeft().get());
-  auto rightType = visitType(node->getRight().get());
-  return std::make_shared<ResolvedType>(
-      ResolvedType::Union(leftType, rightType));
+  auto leftType = visitType(node->getLeft());
+  auto rightType = visitType(node->getRight());
+  return types_.getUnion(leftType, rightType);
 }
 
 std::shared_ptr<ResolvedType>
 TypeCheckVisitor::visitGenericParam(const nodes::GenericParamNode *node) {
   // Generic parameters are treated as named types during type checking
-  auto genericType =
-      std::make_shared<ResolvedType>(ResolvedType::Named(node->getName()));
+  auto genericType = types_.getNamed(node->getName());
 
   // Check constraints
   for (const auto &constraint : node->getConstraints()) {
-    visitType(constraint.get());
+    visitType(constraint);
   }
 
   return genericType;
@@ -1352,50 +2511,83 @@ TypeCheckVisitor::visitGenericParam(const nodes::GenericParamNode *node) {
 std::shared_ptr<ResolvedType> TypeCheckVisitor::visitBuiltinConstraint(
     const nodes::BuiltinConstraintNode *node) {
   // Builtin constraints are compile-time constructs, return a placeholder type
-  return std::make_shared<ResolvedType>(
-      ResolvedType::Named(node->getConstraintName()));
+  return types_.getNamed(node->getConstraintName());
 }
 
 // Helper methods
 void TypeCheckVisitor::error(const core::SourceLocation &location,
                              const std::string &message) {
-  errorReporter_.error(location, message);
+  errorReporter_->error(location, message);
 }
 
 void TypeCheckVisitor::warning(const core::SourceLocation &location,
                                const std::string &message) {
-  errorReporter_.warning(location, message);
+  errorReporter_->warning(location, message);
 }
 
-void TypeCheckVisitor::enterScope() {
-  currentScope_ = currentScope_->createChildScope();
-}
+void TypeCheckVisitor::enterScope() { scope_.enterScope(); }
 
-void TypeCheckVisitor::exitScope() {
-  if (currentScope_->createChildScope()) {
-    currentScope_ =
-        currentScope_->createChildScope(); // This should be parent, but we
-                                           // don't have parent accessor
-  }
-}
+void TypeCheckVisitor::exitScope() { scope_.exitScope(); }
 
 void TypeCheckVisitor::enterFunctionScope(
     std::shared_ptr<ResolvedType> returnType) {
   enterScope();
   currentFunctionReturnType_ = returnType;
+  // A nested function's body runs whenever it is called
+  outerArenas_.push_back(std::move(arenas_));
+  arenas_.clear();
 }
 
 void TypeCheckVisitor::exitFunctionScope() {
   currentFunctionReturnType_ = nullptr;
+  arenas_ = std::move(outerArenas_.back());
+  outerArenas_.pop_back();
   exitScope();
 }
 
+bool TypeCheckVisitor::refersToArena(const nodes::ExpressionNode *expr) const {
+  if (auto newExpr = nodes::dyn_cast<nodes::NewExpressionNode>(expr)) {
+    // Concurrent containers belong to the runtime
+    return ResolvedType::getContainerArity(newExpr->getClassName()) == 0;
+  }
+  if (auto ident = nodes::dyn_cast<nodes::IdentifierExpressionNode>(expr)) {
+    for (const auto &arena : arenas_) {
+      if (arena.references.count(ident->getName())) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+bool TypeCheckVisitor::outlivesArena(
+    const nodes::ExpressionNode *target) const {
+  // Storing into a field or element stores into the variable's object
+  while (true) {
+    if (auto member = nodes::dyn_cast<nodes::MemberExpressionNode>(target)) {
+      target = member->getObject();
+    } else if (auto index =
+                   nodes::dyn_cast<nodes::IndexExpressionNode>(target)) {
+      target = index->getArray();
+    } else {
+      break;
+    }
+  }
+  auto ident = nodes::dyn_cast<nodes::IdentifierExpressionNode>(target);
+  return !ident || !arenas_.back().declared.count(ident->getName());
+}
+
 std::shared_ptr<ResolvedType>
 TypeCheckVisitor::checkBinaryOp(tokens::TokenType op,
                                 std::shared_ptr<ResolvedType> leftType,
                                 std::shared_ptr<ResolvedType> rightType,
                                 const core::SourceLocation &location) {
 
+  if (leftType->getKind() == ResolvedType::TypeKind::Vector ||
+      rightType->getKind() == ResolvedType::TypeKind::Vector) {
+    return checkVectorOp(op, leftType, rightType, location);
+  }
+
   // Handle arithmetic operators
   if (tokens::isArithmeticOperator(op)) {
     if ((leftType->getKind() == ResolvedType::TypeKind::Int ||
@@ -1464,7 +2656,8 @@ std::shared_ptr<ResolvedType> TypeCheckVisitor::checkUnaryOp(
   case tokens::TokenType::PLUS:
   case tokens::TokenType::MINUS:
     if (operandType->getKind() == ResolvedType::TypeKind::Int ||
-        operandType->getKind() == ResolvedType::TypeKind::Float) {
+        operandType->getKind() == ResolvedType::TypeKind::Float ||
+        operandType->getKind() == ResolvedType::TypeKind::Vector) {
       return operandType;
     }
     error(location, "Unary +/- requires numeric operand");
@@ -1503,7 +2696,7 @@ std::shared_ptr<ResolvedType> TypeCheckVisitor::checkUnaryOp(
 
   case tokens::TokenType::AT:
     // Address-of operator
-    return std::make_shared<ResolvedType>(ResolvedType::Pointer(operandType));
+    return types_.getPointer(operandType);
 
   default:
     error(location, "Unhandled unary operator in type checking");
@@ -1536,22 +2729,664 @@ std::shared_ptr<ResolvedType> TypeCheckVisitor::checkFunctionCall(
     return errorType_;
   }
 
-  const auto &paramTypes = calleeType->getParameterTypes();
+  auto paramTypes = calleeType->getParameterTypes();
+  auto returnType = calleeType->getReturnType();
 
-  if (paramTypes.size() != args.size()) {
+  // A variadic C function takes its parameters and then any others
+  if (paramTypes.size() != args.size() &&
+      (!calleeType->isVariadic() || args.size() < paramTypes.size())) {
     error(location, "Wrong number of arguments");
     return errorType_;
   }
 
+  std::vector<std::shared_ptr<ResolvedType>> argTypes;
+  for (const auto &arg : args) {
+    argTypes.push_back(visitExpr(arg));
+  }
+
+  // A generic call is checked against the signature of its specialization
+  auto generic = genericParams_.find(calleeType.get());
+  if (generic != genericParams_.end()) {
+    const auto &typeParams = generic->second.types;
+    const auto &constraints = generic->second.constraints;
+    TypeBindings bindings;
+    for (const auto &typeParam : typeParams) {
+      bindings.emplace(typeParam.get(), nullptr);
+    }
+
+    if (!typeArgs.empty()) {
+      if (typeArgs.size() != typeParams.size()) {
+        error(location, "Wrong number of type arguments");
+        return errorType_;
+      }
+      for (size_t i = 0; i < typeArgs.size(); i++) {
+        auto typeArg = scope_.lookupType(typeArgs[i]);
+        if (!typeArg) {
+          error(location, "Undefined type: " + typeArgs[i]);
+          return errorType_;
+        }
+        bindings[typeParams[i].get()] = typeArg;
+      }
+    } else {
+      for (size_t i = 0; i < args.size(); i++) {
+        inferTypeArguments(paramTypes[i], argTypes[i], bindings);
+      }
+      for (const auto &typeParam : typeParams) {
+        if (!bindings[typeParam.get()]) {
+          error(location,
+                "Cannot infer type argument: " + typeParam->getName());
+          return errorType_;
+        }
+      }
+    }
+
+    // Types in a generic body are only resolved per specialization
+    for (size_t i = 0; i < typeParams.size() && genericDepth_ == 0; i++) {
+      const auto &bound = bindings[typeParams[i].get()];
+      if (constraints[i] && !satisfiesConstraint(*bound, *constraints[i])) {
+        error(location, "Type argument " + bound->toString() +
+                            " does not satisfy the constraint " +
+                            constraints[i]->toString() + " on " +
+                            typeParams[i]->getName());
+        return errorType_;
+      }
+    }
+
+    for (auto &paramType : paramTypes) {
+      paramType = substituteType(paramType, bindings);
+    }
+    returnType = substituteType(returnType, bindings);
+  } else if (!typeArgs.empty()) {
+    error(location, "Type arguments given to a non-generic function");
+    return errorType_;
+  }
+
   // Check each argument type
-  for (size_t i = 0; i < args.size(); i++) {
-    auto argType = visitExpr(args[i].get());
-    if (!argType->isAssignableTo(*paramTypes[i])) {
+  for (size_t i = 0; i < paramTypes.size(); i++) {
+    if (paramTypes[i]->getKind() != ResolvedType::TypeKind::Reference &&
+        !argTypes[i]->isAssignableTo(*paramTypes[i])) {
       error(args[i]->getLocation(), "Argument type mismatch");
     }
   }
+  checkRefArguments(paramTypes, argTypes, args);
+  // C's ... takes numbers and pointers
+  for (size_t i = paramTypes.size(); i < args.size(); i++) {
+    auto kind = argTypes[i]->getKind();
+    if (kind != ResolvedType::TypeKind::Int &&
+        kind != ResolvedType::TypeKind::Float &&
+        kind != ResolvedType::TypeKind::Bool &&
+        kind != ResolvedType::TypeKind::Pointer &&
+        kind != ResolvedType::TypeKind::Error) {
+      error(args[i]->getLocation(), "Cannot pass " + argTypes[i]->toString() +
+                                        " as a variadic argument");
+    }
+  }
+
+  return returnType;
+}
+
+void TypeCheckVisitor::checkRefArguments(
+    const std::vector<std::shared_ptr<ResolvedType>> &paramTypes,
+    const std::vector<std::shared_ptr<ResolvedType>> &argTypes,
+    const std::vector<nodes::ExpressionPtr> &args) {
+  std::vector<std::vector<std::string>> paths(args.size());
+  bool anyRef = false;
+  for (size_t i = 0; i < paramTypes.size(); i++) {
+    if (paramTypes[i]->getKind() != ResolvedType::TypeKind::Reference) {
+      accessPath(args[i], paths[i]);
+      continue;
+    }
+    anyRef = true;
+    auto referenced = paramTypes[i]->getPointeeType();
+    if (genericDepth_ > 0) {
+      // Types in a generic body are only resolved per specialization
+      error(args[i]->getLocation(),
+            "Generic functions cannot pass ref arguments");
+    } else if (!accessPath(args[i], paths[i])) {
+      error(args[i]->getLocation(),
+            "A ref argument must be a variable, field or array element");
+    } else if (!argTypes[i]->equals(*referenced) &&
+               argTypes[i]->getKind() != ResolvedType::TypeKind::Error &&
+               referenced->getKind() != ResolvedType::TypeKind::Error) {
+      error(args[i]->getLocation(), "Argument type mismatch: " +
+                                        argTypes[i]->toString() +
+                                        " passed to ref " +
+                                        referenced->toString());
+    }
+  }
+  if (!anyRef) {
+    return;
+  }
+
+  // The callee may assume that nothing else it is given reaches the
+  // storage of a ref argument; copied numbers cannot
+  for (size_t i = 0; i < paramTypes.size(); i++) {
+    if (paramTypes[i]->getKind() != ResolvedType::TypeKind::Reference ||
+        paths[i].empty()) {
+      continue;
+    }
+    for (size_t j = 0; j < args.size(); j++) {
+      if (j == i || paths[j].empty()) {
+        continue;
+      }
+      bool byRef = j < paramTypes.size() &&
+                   paramTypes[j]->getKind() ==
+                       ResolvedType::TypeKind::Reference;
+      auto kind = argTypes[j]->getKind();
+      if (!byRef && (kind == ResolvedType::TypeKind::Int ||
+                     kind == ResolvedType::TypeKind::Float ||
+                     kind == ResolvedType::TypeKind::Bool ||
+                     kind == ResolvedType::TypeKind::String ||
+                     kind == ResolvedType::TypeKind::Vector)) {
+        continue;
+      }
+      // Each overlapping pair of ref arguments is reported once
+      if ((!byRef || j > i) && mayOverlap(paths[i], paths[j])) {
+        error(args[j]->getLocation(),
+              "Argument overlaps the ref argument '" +
+                  joinPath(paths[i]) + "'");
+      }
+    }
+  }
+}
+
+TypeCheckVisitor::GenericParams TypeCheckVisitor::enterGenericScope(
+    const std::vector<nodes::TypePtr> &genericParams) {
+  enterScope();
+
+  GenericParams typeParams;
+  for (const auto &param : genericParams) {
+    auto genericParam = nodes::dyn_cast<nodes::GenericParamNode>(param);
+    if (!genericParam) {
+      error(param->getLocation(), "Expected a generic parameter");
+      continue;
+    }
+    // Declared first so constraints may refer to the parameter itself
+    auto type = types_.getNamed(genericParam->getName());
+    scope_.declareType(genericParam->getName(), type);
+    std::shared_ptr<ResolvedType> constraint;
+    for (const auto &bound : genericParam->getConstraints()) {
+      constraint = visitType(bound);
+    }
+    typeParams.types.push_back(type);
+    typeParams.constraints.push_back(constraint);
+  }
+  return typeParams;
+}
+
+bool TypeCheckVisitor::satisfiesConstraint(const ResolvedType &type,
+                                           const ResolvedType &constraint) {
+  if (type.getKind() == ResolvedType::TypeKind::Error ||
+      constraint.getKind() == ResolvedType::TypeKind::Error) {
+    return true;
+  }
+  // Of the builtin constraints only number restricts the argument yet
+  if (constraint.getKind() == ResolvedType::TypeKind::Named &&
+      nodes::isValidBuiltinConstraint(constraint.getName())) {
+    return constraint.getName() != "number" ||
+           type.getKind() == ResolvedType::TypeKind::Int ||
+           type.getKind() == ResolvedType::TypeKind::Float;
+  }
+  // A class or interface bound is met by what converts to it; the answer is
+  // cached per pair, and hierarchies are closed over once
+  return types_.isAssignable(type, constraint);
+}
+
+void TypeCheckVisitor::inferTypeArguments(
+    const std::shared_ptr<ResolvedType> &paramType,
+    const std::shared_ptr<ResolvedType> &argType, TypeBindings &bindings) {
+  // The first argument that reaches a parameter decides its binding
+  auto binding = bindings.find(paramType.get());
+  if (binding != bindings.end()) {
+    if (!binding->second) {
+      binding->second = argType;
+    }
+    return;
+  }
+
+  if (paramType->getKind() != argType->getKind()) {
+    return;
+  }
+
+  switch (paramType->getKind()) {
+  case ResolvedType::TypeKind::Array:
+  case ResolvedType::TypeKind::Slice:
+    inferTypeArguments(paramType->getElementType(), argType->getElementType(),
+                       bindings);
+    break;
+  case ResolvedType::TypeKind::Pointer:
+  case ResolvedType::TypeKind::Reference:
+  case ResolvedType::TypeKind::Smart:
+    inferTypeArguments(paramType->getPointeeType(), argType->getPointeeType(),
+                       bindings);
+    break;
+  case ResolvedType::TypeKind::Template: {
+    const auto &paramArgs = paramType->getTemplateArgs();
+    const auto &argArgs = argType->getTemplateArgs();
+    if (paramType->getName() == argType->getName() &&
+        paramArgs.size() == argArgs.size()) {
+      for (size_t i = 0; i < paramArgs.size(); i++) {
+        inferTypeArguments(paramArgs[i], argArgs[i], bindings);
+      }
+    }
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+std::shared_ptr<ResolvedType>
+TypeCheckVisitor::substituteType(const std::shared_ptr<ResolvedType> &type,
+                                 const TypeBindings &bindings) {
+  if (!type) {
+    return type;
+  }
+
+  auto binding = bindings.find(type.get());
+  if (binding != bindings.end() && binding->second) {
+    return binding->second;
+  }
+
+  // Components are substituted first, so the result is interned as usual
+  switch (type->getKind()) {
+  case ResolvedType::TypeKind::Array:
+    return types_.getArray(substituteType(type->getElementType(), bindings));
+  case ResolvedType::TypeKind::Slice:
+    return types_.getSlice(substituteType(type->getElementType(), bindings),
+                           type->isBytes());
+  case ResolvedType::TypeKind::Pointer:
+    return types_.getPointer(substituteType(type->getPointeeType(), bindings),
+                             type->isUnsafe());
+  case ResolvedType::TypeKind::Reference:
+    return types_.getReference(
+        substituteType(type->getPointeeType(), bindings));
+  case ResolvedType::TypeKind::Smart:
+    return types_.getSmart(substituteType(type->getPointeeType(), bindings),
+                           type->getSmartKind());
+  case ResolvedType::TypeKind::Union:
+    return types_.getUnion(substituteType(type->getLeftType(), bindings),
+                           substituteType(type->getRightType(), bindings));
+  case ResolvedType::TypeKind::Function: {
+    std::vector<std::shared_ptr<ResolvedType>> paramTypes;
+    for (const auto &paramType : type->getParameterTypes()) {
+      paramTypes.push_back(substituteType(paramType, bindings));
+    }
+    return types_.getFunction(substituteType(type->getReturnType(), bindings),
+                              paramTypes);
+  }
+  case ResolvedType::TypeKind::Template: {
+    std::vector<std::shared_ptr<ResolvedType>> args;
+    for (const auto &arg : type->getTemplateArgs()) {
+      args.push_back(substituteType(arg, bindings));
+    }
+    return types_.getTemplate(type->getName(), args);
+  }
+  default:
+    return type;
+  }
+}
+
+std::shared_ptr<ResolvedType> TypeCheckVisitor::atomicMethodType(
+    const std::string &name, const std::shared_ptr<ResolvedType> &valueType) {
+  auto kind = valueType->getKind();
+  if (name == "load") {
+    return types_.getFunction(valueType, {stringType_});
+  }
+  if (name == "store") {
+    return types_.getFunction(voidType_, {valueType, stringType_});
+  }
+  if (name == "exchange") {
+    return types_.getFunction(valueType, {valueType, stringType_});
+  }
+  if (name == "compareExchange") {
+    return types_.getFunction(boolType_, {valueType, valueType, stringType_});
+  }
+  if ((name == "fetchAdd" || name == "fetchSub") &&
+      (kind == ResolvedType::TypeKind::Int ||
+       kind == ResolvedType::TypeKind::Float)) {
+    return types_.getFunction(valueType, {valueType, stringType_});
+  }
+  if ((name == "fetchAnd" || name == "fetchOr" || name == "fetchXor") &&
+      kind == ResolvedType::TypeKind::Int) {
+    return types_.getFunction(valueType, {valueType, stringType_});
+  }
+  return nullptr;
+}
+
+std::shared_ptr<ResolvedType>
+TypeCheckVisitor::checkAtomicCall(const nodes::CallExpressionNode *node,
+                                  const std::shared_ptr<ResolvedType> &methodType) {
+  const auto &name =
+      nodes::cast<nodes::MemberExpressionNode>(node->getCallee())->getMember();
+  const auto &args = node->getArguments();
+  const auto &paramTypes = methodType->getParameterTypes();
+  size_t operands = paramTypes.size() - 1;
+  if (args.size() != operands && args.size() != paramTypes.size()) {
+    error(node->getLocation(), "Wrong number of arguments");
+    return errorType_;
+  }
+
+  for (size_t i = 0; i < operands; i++) {
+    auto argType = visitExpr(args[i]);
+    if (!checkAssignmentCompatibility(paramTypes[i], argType,
+                                      args[i]->getLocation())) {
+      return errorType_;
+    }
+  }
+
+  // The order is a string literal the code generator reads
+  if (args.size() == paramTypes.size()) {
+    const auto *orderArg = args.back();
+    visitExpr(orderArg);
+    auto literal = nodes::dyn_cast<nodes::LiteralExpressionNode>(orderArg);
+    std::string order;
+    if (literal &&
+        literal->getExpressionType() == tokens::TokenType::STRING_LITERAL &&
+        literal->getValue().size() >= 2) {
+      order = literal->getValue().substr(1, literal->getValue().size() - 2);
+    }
+    if (order != "relaxed" && order != "acquire" && order != "release" &&
+        order != "acq_rel" && order != "seq_cst") {
+      error(orderArg->getLocation(),
+            "Memory order must be \"relaxed\", \"acquire\", \"release\", "
+            "\"acq_rel\" or \"seq_cst\"");
+      return errorType_;
+    }
+    if ((name == "load" && (order == "release" || order == "acq_rel")) ||
+        (name == "store" && (order == "acquire" || order == "acq_rel"))) {
+      error(orderArg->getLocation(),
+            "An atomic " + name + " cannot be " + order);
+      return errorType_;
+    }
+  }
+  return methodType->getReturnType();
+}
+
+std::shared_ptr<ResolvedType>
+TypeCheckVisitor::checkVectorOp(tokens::TokenType op,
+                                const std::shared_ptr<ResolvedType> &leftType,
+                                const std::shared_ptr<ResolvedType> &rightType,
+                                const core::SourceLocation &location) {
+  if (leftType->getKind() == ResolvedType::TypeKind::Error ||
+      rightType->getKind() == ResolvedType::TypeKind::Error) {
+    return errorType_;
+  }
+
+  // A scalar operand is broadcast to every lane of the vector one
+  auto vectorType =
+      leftType->getKind() == ResolvedType::TypeKind::Vector ? leftType
+                                                            : rightType;
+  auto otherType = vectorType == leftType ? rightType : leftType;
+  auto elementType = vectorType->getElementType();
+  if (otherType->getKind() == ResolvedType::TypeKind::Vector
+          ? otherType != vectorType
+          : !otherType->isAssignableTo(*elementType)) {
+    error(location, "Cannot combine " + leftType->toString() + " and " +
+                        rightType->toString());
+    return errorType_;
+  }
+
+  if (tokens::isArithmeticOperator(op)) {
+    return vectorType;
+  }
+  if (tokens::isBitwiseOperator(op)) {
+    if (elementType == intType_) {
+      return vectorType;
+    }
+    error(location, "Bitwise operators require integer operands");
+    return errorType_;
+  }
+  // Comparisons give a mask: -1 in each lane where they hold, else 0
+  if (tokens::isComparisonOperator(op)) {
+    return types_.getVector(intType_, vectorType->getLanes());
+  }
+  error(location, "Operator is not defined on " + vectorType->toString());
+  return errorType_;
+}
+
+std::shared_ptr<ResolvedType> TypeCheckVisitor::checkVectorConstruction(
+    const nodes::CallExpressionNode *node,
+    const std::shared_ptr<ResolvedType> &vectorType) {
+  const auto &args = node->getArguments();
+  if (args.size() != 1 && args.size() != vectorType->getLanes()) {
+    error(node->getLocation(),
+          vectorType->toString() + " takes one value for every lane, or " +
+              "one for all of them");
+    return errorType_;
+  }
+  for (const auto &arg : args) {
+    auto argType = visitExpr(arg);
+    if (!checkAssignmentCompatibility(vectorType->getElementType(), argType,
+                                      arg->getLocation())) {
+      return errorType_;
+    }
+  }
+  return vectorType;
+}
+
+std::shared_ptr<ResolvedType>
+TypeCheckVisitor::checkBlackBox(const nodes::CallExpressionNode *node) {
+  const auto &args = node->getArguments();
+  if (args.size() != 1) {
+    error(node->getLocation(), "blackBox takes one argument");
+    return errorType_;
+  }
+  auto argType = visitExpr(args[0]);
+  // A copy of an owning pointer would be released twice
+  switch (argType->getKind()) {
+  case ResolvedType::TypeKind::Void:
+  case ResolvedType::TypeKind::Smart:
+  case ResolvedType::TypeKind::Atomic:
+    error(args[0]->getLocation(),
+          "blackBox cannot take " + argType->toString());
+    return errorType_;
+  default:
+    break;
+  }
+  return argType;
+}
+
+std::shared_ptr<ResolvedType> TypeCheckVisitor::vectorMethodType(
+    const std::string &name, const std::shared_ptr<ResolvedType> &vectorType) {
+  auto elementType = vectorType->getElementType();
+  if (name == "extract") {
+    return types_.getFunction(elementType, {intType_});
+  }
+  if (name == "insert") {
+    return types_.getFunction(vectorType, {intType_, elementType});
+  }
+  if (name == "sum" || name == "product" || name == "min" || name == "max") {
+    return types_.getFunction(elementType, {});
+  }
+  // Takes constant lane indices, after the vector to draw from as well
+  if (name == "shuffle") {
+    return types_.getFunction(vectorType, {}, false, true);
+  }
+  return nullptr;
+}
+
+std::shared_ptr<ResolvedType>
+TypeCheckVisitor::checkVectorCall(const nodes::CallExpressionNode *node,
+                                  const std::shared_ptr<ResolvedType> &methodType) {
+  if (!methodType->isVariadic()) {
+    auto resultType = checkFunctionCall(methodType, node->getArguments(), {},
+                                        node->getLocation());
+    // A lane index that is known must be one of the vector's
+    auto vectorType = nodes::cast<nodes::MemberExpressionNode>(node->getCallee())
+                          ->getObject()
+                          ->getResolvedType();
+    unsigned long long lane = 0;
+    if (resultType->getKind() != ResolvedType::TypeKind::Error &&
+        !node->getArguments().empty() &&
+        vectorType->getKind() == ResolvedType::TypeKind::Vector &&
+        literalLane(node->getArguments()[0], lane) &&
+        lane >= vectorType->getLanes()) {
+      error(node->getArguments()[0]->getLocation(),
+            "Lane " + std::to_string(lane) + " is out of range for " +
+                vectorType->toString());
+      return errorType_;
+    }
+    return resultType;
+  }
+
+  // shuffle([other,] indices...): the result has a lane for each index,
+  // numbering the lanes of other after the vector's own
+  auto vectorType = methodType->getReturnType();
+  const auto &args = node->getArguments();
+  size_t first = 0;
+  unsigned sources = 1;
+  if (!args.empty()) {
+    auto argType = visitExpr(args[0]);
+    if (argType->getKind() == ResolvedType::TypeKind::Vector) {
+      if (argType != vectorType) {
+        error(args[0]->getLocation(), "Cannot shuffle " +
+                                          vectorType->toString() + " with " +
+                                          argType->toString());
+        return errorType_;
+      }
+      first = 1;
+      sources = 2;
+    }
+  }
+  size_t lanes = args.size() - first;
+  if (lanes != 2 && lanes != 4 && lanes != 8 && lanes != 16) {
+    error(node->getLocation(), "A shuffle takes 2, 4, 8 or 16 lane indices");
+    return errorType_;
+  }
+  for (size_t i = first; i < args.size(); ++i) {
+    if (i > 0) {
+      visitExpr(args[i]);
+    }
+    unsigned long long lane = 0;
+    if (!literalLane(args[i], lane)) {
+      error(args[i]->getLocation(),
+            "Shuffle lane indices must be integer literals");
+      return errorType_;
+    }
+    if (lane >= sources * vectorType->getLanes()) {
+      error(args[i]->getLocation(),
+            "Lane " + std::to_string(lane) + " is out of range for " +
+                (sources == 2 ? "two " + vectorType->toString() + "s"
+                              : vectorType->toString()));
+      return errorType_;
+    }
+  }
+  return types_.getVector(vectorType->getElementType(),
+                          static_cast<unsigned>(lanes));
+}
 
-  return calleeType->getReturnType();
+bool TypeCheckVisitor::isContainerName(const std::string &name) {
+  return ResolvedType::getContainerArity(name) != 0 &&
+         !scope_.lookupType(name);
+}
+
+std::shared_ptr<ResolvedType> TypeCheckVisitor::checkContainerType(
+    const std::string &name,
+    const std::vector<std::shared_ptr<ResolvedType>> &typeArgs,
+    const core::SourceLocation &location) {
+  size_t arity = ResolvedType::getContainerArity(name);
+  if (typeArgs.size() != arity) {
+    error(location, name + (arity == 1 ? " takes one element type"
+                                       : " takes a key and a value type"));
+    return errorType_;
+  }
+  for (const auto &typeArg : typeArgs) {
+    if (typeArg->getKind() == ResolvedType::TypeKind::Error) {
+      return errorType_;
+    }
+    // Elements are copied bit for bit, so none may count references
+    if (typeArg->getKind() == ResolvedType::TypeKind::Void ||
+        typeArg->getKind() == ResolvedType::TypeKind::Smart ||
+        typeArg->getKind() == ResolvedType::TypeKind::Atomic) {
+      error(location, name + " cannot hold " + typeArg->toString());
+      return errorType_;
+    }
+  }
+  // Keys are hashed as 64-bit integers
+  auto keyKind = typeArgs[0]->getKind();
+  if (arity == 2 && keyKind != ResolvedType::TypeKind::Int &&
+      keyKind != ResolvedType::TypeKind::Bool &&
+      keyKind != ResolvedType::TypeKind::Pointer) {
+    error(location, name + " keys must be int, bool or pointers, not " +
+                        typeArgs[0]->toString());
+    return errorType_;
+  }
+  return types_.getTemplate(name, typeArgs);
+}
+
+std::shared_ptr<ResolvedType> TypeCheckVisitor::containerMethodType(
+    const std::string &name,
+    const std::shared_ptr<ResolvedType> &containerType) {
+  const auto &typeArgs = containerType->getTemplateArgs();
+  if (containerType->getName() != "ConcurrentMap") {
+    const auto &element = typeArgs[0];
+    if (name == "push") {
+      return types_.getFunction(voidType_, {element});
+    }
+    if (name == "tryPush") {
+      return types_.getFunction(boolType_, {element});
+    }
+    if (name == "pop") {
+      return types_.getFunction(element, {});
+    }
+    // An empty queue gives back the argument
+    if (name == "tryPop") {
+      return types_.getFunction(element, {element});
+    }
+    return nullptr;
+  }
+
+  const auto &key = typeArgs[0];
+  const auto &value = typeArgs[1];
+  if (name == "put") {
+    return types_.getFunction(voidType_, {key, value});
+  }
+  // A missing key gives back the second argument; get is a keyword
+  if (name == "find") {
+    return types_.getFunction(value, {key, value});
+  }
+  if (name == "has" || name == "remove") {
+    return types_.getFunction(boolType_, {key});
+  }
+  if (name == "size") {
+    return types_.getFunction(intType_, {});
+  }
+  return nullptr;
+}
+
+std::shared_ptr<ResolvedType>
+TypeCheckVisitor::visitContainerNew(const nodes::NewExpressionNode *node) {
+  const auto &name = node->getClassName();
+  std::vector<std::shared_ptr<ResolvedType>> typeArgs;
+  for (const auto &typeName : node->getTypeArguments()) {
+    auto typeArg = scope_.lookupType(typeName);
+    if (!typeArg) {
+      error(node->getLocation(), "Undefined type: " + typeName);
+      return errorType_;
+    }
+    typeArgs.push_back(typeArg);
+  }
+  auto containerType = checkContainerType(name, typeArgs, node->getLocation());
+  if (containerType->getKind() == ResolvedType::TypeKind::Error) {
+    return errorType_;
+  }
+
+  // Queues are bounded, so they are given a capacity; maps grow
+  const auto &args = node->getArguments();
+  size_t expected = name == "ConcurrentMap" ? 0 : 1;
+  if (args.size() != expected) {
+    error(node->getLocation(),
+          name + (expected ? " takes a capacity" : " takes no arguments"));
+    return errorType_;
+  }
+  for (const auto &arg : args) {
+    if (!visitExpr(arg)->isAssignableTo(*intType_)) {
+      error(arg->getLocation(), "Queue capacity must be an integer");
+      return errorType_;
+    }
+  }
+  return containerType;
 }
 
 std::shared_ptr<ResolvedType> TypeCheckVisitor::resolveGenericType(
@@ -1560,7 +3395,7 @@ std::shared_ptr<ResolvedType> TypeCheckVisitor::resolveGenericType(
     const core::SourceLocation &location) {
 
   // For now, just return a template type
-  return std::make_shared<ResolvedType>(ResolvedType::Template(name, typeArgs));
+  return types_.getTemplate(name, typeArgs);
 }
 
 // Fix the visitDeclarationStmt method - there was a typo
@@ -1568,21 +3403,25 @@ std::shared_ptr<ResolvedType>
 TypeCheckVisitor::visitDeclarationStmt(const nodes::DeclarationStmtNode *node) {
   auto decl = node->getDeclaration();
 
-  if (auto varDecl = std::dynamic_pointer_cast<nodes::VarDeclNode>(decl)) {
-    return visitVarDecl(varDecl.get());
-  } else if (auto funcDecl =
-                 std::dynamic_pointer_cast<nodes::FunctionDeclNode>(decl)) {
-    return visitFuncDecl(funcDecl.get());
-  } else if (auto classDecl =
-                 std::dynamic_pointer_cast<nodes::ClassDeclNode>(decl)) {
-    return visitClassDecl(classDecl.get());
-  } else if (auto enumDecl =
-                 std::dynamic_pointer_cast<nodes::EnumDeclNode>(decl)) {
-    return visitEnumDecl(enumDecl.get());
-  } else if (auto interfaceDecl =
-                 std::dynamic_pointer_cast<nodes::InterfaceDeclNode>(decl)) {
-    return visitInterfaceDecl(interfaceDecl.get());
-  } else {
+  switch (decl->getNodeKind()) {
+  case nodes::NodeKind::VarDecl:
+    return visitVarDecl(nodes::cast<nodes::VarDeclNode>(decl));
+  case nodes::NodeKind::FunctionDecl:
+    return visitFuncDecl(nodes::cast<nodes::FunctionDeclNode>(decl));
+  case nodes::NodeKind::GenericFunctionDecl:
+    return visitGenericFuncDecl(
+        nodes::cast<nodes::GenericFunctionDeclNode>(decl));
+  case nodes::NodeKind::ClassDecl:
+    return visitClassDecl(nodes::cast<nodes::ClassDeclNode>(decl));
+  case nodes::NodeKind::GenericClassDecl:
+    return visitGenericClassDecl(
+        nodes::cast<nodes::GenericClassDeclNode>(decl));
+  case nodes::NodeKind::EnumDecl:
+    return visitEnumDecl(nodes::cast<nodes::EnumDeclNode>(decl));
+  case nodes::NodeKind::InterfaceDecl:
+  case nodes::NodeKind::GenericInterfaceDecl:
+    return visitInterfaceDecl(nodes::cast<nodes::InterfaceDeclNode>(decl));
+  default:
     error(node->getLocation(), "Unsupported declaration in statement");
     return errorType_;
   }
@@ -6,8 +6,11 @@
 #include "parser/nodes/statement_nodes.h"
 #include "parser/nodes/type_nodes.h"
 #include "resolved_type.h"
+#include "type_context.h"
 #include "type_scope.h"
 #include <memory>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace visitors {
 
@@ -19,11 +22,69 @@ namespace visitors {
  */
 class TypeCheckVisitor {
 public:
-  explicit TypeCheckVisitor(core::ErrorReporter &errorReporter);
+  // A shared global scope keeps declarations alive across checks (REPL)
+  explicit TypeCheckVisitor(core::ErrorReporter &errorReporter,
+                            TypeScope *globalScope = nullptr);
 
   // Entry point for type checking an AST
   bool checkAST(const parser::AST &ast);
 
+  // The two halves of checkAST. declareAST enters types, class members and
+  // function signatures into the scope; checkDefinitions checks bodies and
+  // statements against it. The files of a program are declared into one
+  // scope, then checked independently against copies of it. Definitions in
+  // skip are left unchecked, as when an incremental build reuses their code.
+  void declareAST(const parser::AST &ast);
+  bool checkDefinitions(
+      const parser::AST &ast,
+      const std::unordered_set<const nodes::BaseNode *> &skip = {});
+
+  // Type parameters of a generic function and the constraint on each
+  struct GenericParams {
+    std::vector<std::shared_ptr<ResolvedType>> types;
+    std::vector<std::shared_ptr<ResolvedType>> constraints; // Null if none
+  };
+
+  // Generic functions by their interned function type
+  using GenericParamMap =
+      std::unordered_map<const ResolvedType *, GenericParams>;
+
+  // The global scope and generic functions as deferred bodies see them
+  struct Globals {
+    TypeScope scope;
+    GenericParamMap genericParams;
+    std::unordered_set<std::string> valueClasses;
+  };
+
+  /**
+   * @brief A stretch of the definitions checkDefinitions went through
+   *
+   * Class and function bodies only read the global scope, so they need not
+   * be checked where they appear. When bodies are deferred, each run of
+   * them between definitions that extend the scope is cut into batches
+   * that share a snapshot of the scope as it stood there. check() gives a
+   * batch a visitor and a local scope of its own over the snapshot, so
+   * batches may be checked on several threads at once. What was checked in
+   * place collects its diagnostics in stretches of its own, and appending
+   * the stretches in order reports every diagnostic in source order.
+   */
+  struct DeferredCheck {
+    // Checks the batch; nothing to do for a stretch checked in place
+    void check();
+    bool isPending() const { return globals != nullptr; }
+
+    std::shared_ptr<const Globals> globals; // Set while pending
+    std::vector<const nodes::BaseNode *> definitions; // Classes and functions
+    core::ErrorReporter diagnostics{false};
+    bool success = true;
+  };
+
+  // Makes checkDefinitions leave class and function bodies to batches of
+  // up to batchSize definitions, appended to checks with the stretches
+  // checked in place; the caller checks the batches and reports them all
+  void deferBodies(std::vector<std::unique_ptr<DeferredCheck>> *checks,
+                   size_t batchSize);
+
   // Declaration visitors
   std::shared_ptr<ResolvedType> visitVarDecl(const nodes::VarDeclNode *node);
   std::shared_ptr<ResolvedType> visitFuncDecl(const nodes::FunctionDeclNode *node);
@@ -68,6 +129,7 @@ public:
   std::shared_ptr<ResolvedType> visitExpr(const nodes::ExpressionNode *node);
   std::shared_ptr<ResolvedType> visitBinaryExpr(const nodes::BinaryExpressionNode *node);
   std::shared_ptr<ResolvedType> visitUnaryExpr(const nodes::UnaryExpressionNode *node);
+  std::shared_ptr<ResolvedType> visitAwaitExpr(const nodes::UnaryExpressionNode *node);
   std::shared_ptr<ResolvedType> visitLiteralExpr(const nodes::LiteralExpressionNode *node);
   std::shared_ptr<ResolvedType> visitIdentifierExpr(const nodes::IdentifierExpressionNode *node);
   std::shared_ptr<ResolvedType> visitCallExpr(const nodes::CallExpressionNode *node);
@@ -95,11 +157,15 @@ public:
   std::shared_ptr<ResolvedType> visitFunctionType(const nodes::FunctionTypeNode *node);
   std::shared_ptr<ResolvedType> visitTemplateType(const nodes::TemplateTypeNode *node);
   std::shared_ptr<ResolvedType> visitSmartPointerType(const nodes::SmartPointerTypeNode *node);
+  std::shared_ptr<ResolvedType> visitAtomicType(const nodes::AtomicTypeNode *node);
   std::shared_ptr<ResolvedType> visitUnionType(const nodes::UnionTypeNode *node);
   std::shared_ptr<ResolvedType> visitGenericParam(const nodes::GenericParamNode *node);
   std::shared_ptr<ResolvedType> visitBuiltinConstraint(const nodes::BuiltinConstraintNode *node);
 
 private:
+  // Checks an expression by kind; visitExpr records the result on the node
+  std::shared_ptr<ResolvedType> visitExprKind(const nodes::ExpressionNode *node);
+
   // Report a type error
   void error(const core::SourceLocation &location, const std::string &message);
   void warning(const core::SourceLocation &location, const std::string &message);
@@ -127,12 +193,158 @@ private:
       const std::vector<std::string> &typeArgs,
       const core::SourceLocation &location);
 
+  // Checks that ref arguments are variables, fields or elements of exactly
+  // the parameter's type, and that none overlaps another argument
+  void checkRefArguments(
+      const std::vector<std::shared_ptr<ResolvedType>> &paramTypes,
+      const std::vector<std::shared_ptr<ResolvedType>> &argTypes,
+      const std::vector<nodes::ExpressionPtr> &args);
+
+  // Checks that a typeof test against a union names one of its arms
+  void checkTypeTest(const nodes::TypeTest &test,
+                     const core::SourceLocation &location);
+
+  // Opens a scope in which the variable a typeof test checks has the arm
+  // it holds when the test gives `holds`; false if nothing is narrowed
+  bool narrowByTypeTest(const nodes::ExpressionNode *condition, bool holds);
+
+  // The type of an atomic operation, its memory order last; null if the
+  // value type has no such operation
+  std::shared_ptr<ResolvedType>
+  atomicMethodType(const std::string &name,
+                   const std::shared_ptr<ResolvedType> &valueType);
+
+  // Checks a call of an atomic operation, whose memory order may be left out
+  std::shared_ptr<ResolvedType>
+  checkAtomicCall(const nodes::CallExpressionNode *node,
+                  const std::shared_ptr<ResolvedType> &methodType);
+
+  // Checks an operator with a vector operand; the other operand is a vector
+  // of the same type or a scalar for every lane
+  std::shared_ptr<ResolvedType>
+  checkVectorOp(tokens::TokenType op,
+                const std::shared_ptr<ResolvedType> &leftType,
+                const std::shared_ptr<ResolvedType> &rightType,
+                const core::SourceLocation &location);
+
+  // Checks float4(x, y, z, w), or float4(x) for the same value in each lane
+  std::shared_ptr<ResolvedType>
+  checkVectorConstruction(const nodes::CallExpressionNode *node,
+                          const std::shared_ptr<ResolvedType> &vectorType);
+
+  // Checks blackBox(x), which gives back x as a value the optimizer cannot
+  // see through or drop
+  std::shared_ptr<ResolvedType>
+  checkBlackBox(const nodes::CallExpressionNode *node);
+
+  // The type of a vector's lane access, shuffle or reduction; null if it
+  // has none. A shuffle's type is variadic; its call is checked apart.
+  std::shared_ptr<ResolvedType>
+  vectorMethodType(const std::string &name,
+                   const std::shared_ptr<ResolvedType> &vectorType);
+
+  // Checks a call of a vector operation, including a shuffle's constant
+  // lane indices
+  std::shared_ptr<ResolvedType>
+  checkVectorCall(const nodes::CallExpressionNode *node,
+                  const std::shared_ptr<ResolvedType> &methodType);
+
+  // Whether an expression evaluates to an object allocated in an open
+  // #arena block: a new expression or a variable that refers to one
+  bool refersToArena(const nodes::ExpressionNode *expr) const;
+
+  // Whether an assignment target outlives the innermost #arena block: it is
+  // not a variable declared in the block, or a field or element of one
+  bool outlivesArena(const nodes::ExpressionNode *target) const;
+
+  // Whether a name stands for a built-in concurrent container, which a
+  // user type of the same name hides
+  bool isContainerName(const std::string &name);
+
+  // Makes MpmcQueue<T>, SpscQueue<T> or ConcurrentMap<K, V> after checking
+  // what they may hold
+  std::shared_ptr<ResolvedType>
+  checkContainerType(const std::string &name,
+                     const std::vector<std::shared_ptr<ResolvedType>> &typeArgs,
+                     const core::SourceLocation &location);
+
+  // The type of a concurrent container's method; null if it has none
+  std::shared_ptr<ResolvedType>
+  containerMethodType(const std::string &name,
+                      const std::shared_ptr<ResolvedType> &containerType);
+
+  // Checks new MpmcQueue<T>(capacity) and the other containers
+  std::shared_ptr<ResolvedType>
+  visitContainerNew(const nodes::NewExpressionNode *node);
+
   // Helper for generic type resolution
   std::shared_ptr<ResolvedType> resolveGenericType(
       const std::string &name,
       const std::vector<std::shared_ptr<ResolvedType>> &typeArgs,
       const core::SourceLocation &location);
 
+  // Appends a body to the current batch, starting one if need be
+  void deferBody(const nodes::BaseNode *node);
+
+  // Sends diagnostics to a stretch checked in place, starting one if need be
+  void checkInPlace();
+
+  // Type parameter to argument bindings of one generic call
+  using TypeBindings =
+      std::unordered_map<const ResolvedType *, std::shared_ptr<ResolvedType>>;
+
+  // Declares generic parameters as types in a new scope; returns the types
+  // and their constraints
+  GenericParams
+  enterGenericScope(const std::vector<nodes::TypePtr> &genericParams);
+
+  // Checks a type argument against the constraint on its parameter
+  bool satisfiesConstraint(const ResolvedType &type,
+                           const ResolvedType &constraint);
+
+  // Binds the type parameters in a parameter type from an argument type
+  void inferTypeArguments(const std::shared_ptr<ResolvedType> &paramType,
+                          const std::shared_ptr<ResolvedType> &argType,
+                          TypeBindings &bindings);
+
+  // Replaces bound type parameters within a type
+  std::shared_ptr<ResolvedType>
+  substituteType(const std::shared_ptr<ResolvedType> &type,
+                 const TypeBindings &bindings);
+
+  // Declares a parameter in the body's scope; a ref parameter is used as
+  // the variable it refers to
+  void declareParameter(const nodes::ParameterNode *param);
+
+  // Resolves a function's return and parameter types
+  std::shared_ptr<ResolvedType>
+  functionSignature(const nodes::FunctionDeclNode *node);
+
+  // Records a class's supertypes and the types of its fields and methods
+  void declareClassMembers(const nodes::ClassDeclNode *node);
+
+  // Records an interface's extended interfaces and method signatures
+  void declareInterfaceMembers(const nodes::InterfaceDeclNode *node);
+
+  // Declares the classes and interfaces of a namespace, and of those
+  // nested in it, under their qualified names; prefix ends with a dot
+  void declareNamespaceTypes(const nodes::NamespaceDeclNode *node,
+                             const std::string &prefix);
+
+  // Folds an enum member's explicit value, which may name the first
+  // `folded` members of the same enum; false if it is not a constant integer
+  bool foldEnumValue(const nodes::EnumDeclNode *node, size_t folded,
+                     const nodes::ExpressionNode *value, int64_t &result);
+
+  // Checks overrides and implemented interfaces against their signatures
+  void checkClassConformance(const nodes::ClassDeclNode *node,
+                             const std::shared_ptr<ResolvedType> &classType);
+
+  // Function type of a method from its parameters and return type
+  std::shared_ptr<ResolvedType>
+  methodType(const std::vector<nodes::ParamPtr> &params,
+             const nodes::TypeNode *returnType);
+
   // Scope management helpers
   void enterScope();
   void exitScope();
@@ -140,12 +352,40 @@ private:
   void exitFunctionScope();
 
   // Current type checking state
-  core::ErrorReporter &errorReporter_;
-  std::shared_ptr<TypeScope> currentScope_;
+  core::ErrorReporter *errorReporter_; // The current stretch's when deferring
+  TypeContext &types_; // Uniquing table for every type built
+  TypeScope ownScope_; // Used when no global scope is shared
+  TypeScope &scope_; // Flat table for every open scope
   std::shared_ptr<ResolvedType> currentFunctionReturnType_; // For return statement checking
   std::shared_ptr<ResolvedType> currentClassType_; // For 'this' context
   bool inLoop_; // For break/continue checking
+  bool inSwitch_; // Break also leaves a switch
   bool inTryBlock_; // For throw/catch checking
+  bool inParallelBody_ = false; // Nothing may leave a #parallel iteration
+  size_t parallelDepth_ = 0; // Scopes outside the #parallel loop's iterations
+  bool inAsyncFunction_ = false; // Await is allowed; async calls may spawn
+  const nodes::CallExpressionNode *awaitedCall_ = nullptr; // Operand of await
+
+  // An open #arena block: the variables declared in it, and those of them
+  // that refer to objects it allocated
+  struct ArenaScope {
+    std::unordered_set<std::string> declared;
+    std::unordered_set<std::string> references;
+  };
+  std::vector<ArenaScope> arenas_; // Innermost last
+  std::vector<std::vector<ArenaScope>> outerArenas_; // Of enclosing functions
+  std::vector<size_t> closureDepths_; // Scopes outside each function expression
+  const nodes::MemberExpressionNode *atomicMember_ = nullptr; // Last atomic operation
+  const nodes::MemberExpressionNode *vectorMember_ = nullptr; // Last vector operation
+  unsigned genericDepth_ = 0; // Generic functions and classes being checked
+
+  GenericParamMap genericParams_; // Of the generic functions checked so far
+  std::unordered_set<std::string> valueClasses_; // #stack classes, never new'd
+
+  // Where deferred bodies go; null while bodies are checked in place
+  std::vector<std::unique_ptr<DeferredCheck>> *deferred_ = nullptr;
+  size_t batchSize_ = 0;
+  std::shared_ptr<const Globals> globals_; // Snapshot still up to date
 
   // Builtin type instances
   std::shared_ptr<ResolvedType> voidType_;
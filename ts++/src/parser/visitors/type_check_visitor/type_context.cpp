@@ -0,0 +1,359 @@
+/*****************************************************************************
+ * File: type_context.cpp
+ * Description: Implementation of the resolved type uniquing table.
+ *****************************************************************************/
+
+#include "type_context.h"
+#include <algorithm>
+#include <functional>
+
+namespace visitors {
+
+namespace {
+
+// Mixes a value into a running hash (boost::hash_combine)
+inline void combine(size_t &seed, size_t value) {
+  seed ^= value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2);
+}
+
+std::vector<const ResolvedType *>
+addresses(const std::vector<TypeContext::TypePtr> &types) {
+  std::vector<const ResolvedType *> result;
+  result.reserve(types.size());
+  for (const auto &type : types) {
+    result.push_back(type.get());
+  }
+  return result;
+}
+
+} // namespace
+
+size_t TypeContext::TypeKeyHash::operator()(const TypeKey &key) const {
+  size_t seed = std::hash<int>()(static_cast<int>(key.kind));
+  combine(seed, std::hash<core::Symbol>()(key.name));
+  combine(seed, std::hash<const ResolvedType *>()(key.first));
+  combine(seed, std::hash<const ResolvedType *>()(key.second));
+  for (const ResolvedType *type : key.list) {
+    combine(seed, std::hash<const ResolvedType *>()(type));
+  }
+  combine(seed, std::hash<int>()(key.flags));
+  return seed;
+}
+
+size_t TypeContext::PairHash::operator()(
+    const std::pair<const ResolvedType *, const ResolvedType *> &pair) const {
+  size_t seed = std::hash<const ResolvedType *>()(pair.first);
+  combine(seed, std::hash<const ResolvedType *>()(pair.second));
+  return seed;
+}
+
+/*****************************************************************************
+ * Uniquing
+ *****************************************************************************/
+
+TypeContext::TypePtr TypeContext::unique(const TypeKey &key,
+                                         ResolvedType prototype) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  auto it = types_.find(key);
+  if (it != types_.end()) {
+    return it->second;
+  }
+
+  TypePtr type(new ResolvedType(std::move(prototype)));
+  types_.emplace(key, type);
+  return type;
+}
+
+TypeContext::TypePtr TypeContext::getBuiltin(ResolvedType::TypeKind kind) {
+  TypeKey key;
+  key.kind = kind;
+  return unique(key, ResolvedType(kind));
+}
+
+TypeContext::TypePtr TypeContext::getVoid() {
+  return getBuiltin(ResolvedType::TypeKind::Void);
+}
+
+TypeContext::TypePtr TypeContext::getInt() {
+  return getBuiltin(ResolvedType::TypeKind::Int);
+}
+
+TypeContext::TypePtr TypeContext::getFloat() {
+  return getBuiltin(ResolvedType::TypeKind::Float);
+}
+
+TypeContext::TypePtr TypeContext::getBool() {
+  return getBuiltin(ResolvedType::TypeKind::Bool);
+}
+
+TypeContext::TypePtr TypeContext::getString() {
+  return getBuiltin(ResolvedType::TypeKind::String);
+}
+
+TypeContext::TypePtr TypeContext::getError() {
+  return getBuiltin(ResolvedType::TypeKind::Error);
+}
+
+TypeContext::TypePtr TypeContext::getNamed(const std::string &name) {
+  TypeKey key;
+  key.kind = ResolvedType::TypeKind::Named;
+  key.name = core::Interner::instance().intern(name);
+
+  ResolvedType type(key.kind);
+  type.name_ = name;
+  return unique(key, std::move(type));
+}
+
+TypeContext::TypePtr TypeContext::getArray(const TypePtr &elementType) {
+  TypeKey key;
+  key.kind = ResolvedType::TypeKind::Array;
+  key.first = elementType.get();
+
+  ResolvedType type(key.kind);
+  type.elementType_ = elementType;
+  return unique(key, std::move(type));
+}
+
+TypeContext::TypePtr TypeContext::getPointer(const TypePtr &pointeeType,
+                                             bool isUnsafe) {
+  TypeKey key;
+  key.kind = ResolvedType::TypeKind::Pointer;
+  key.first = pointeeType.get();
+  key.flags = isUnsafe;
+
+  ResolvedType type(key.kind);
+  type.pointeeType_ = pointeeType;
+  type.isUnsafe_ = isUnsafe;
+  return unique(key, std::move(type));
+}
+
+TypeContext::TypePtr TypeContext::getReference(const TypePtr &refType) {
+  TypeKey key;
+  key.kind = ResolvedType::TypeKind::Reference;
+  key.first = refType.get();
+
+  ResolvedType type(key.kind);
+  type.pointeeType_ = refType;
+  return unique(key, std::move(type));
+}
+
+TypeContext::TypePtr
+TypeContext::getFunction(const TypePtr &returnType,
+                         const std::vector<TypePtr> &paramTypes,
+                         bool isAsync, bool isVariadic) {
+  TypeKey key;
+  key.kind = ResolvedType::TypeKind::Function;
+  key.first = returnType.get();
+  key.list = addresses(paramTypes);
+  key.flags = isAsync | isVariadic << 1;
+
+  ResolvedType type(key.kind);
+  type.returnType_ = returnType;
+  type.paramTypes_ = paramTypes;
+  type.isAsync_ = isAsync;
+  type.isVariadic_ = isVariadic;
+  return unique(key, std::move(type));
+}
+
+TypeContext::TypePtr TypeContext::getSmart(const TypePtr &pointeeType,
+                                           ResolvedType::SmartKind kind) {
+  TypeKey key;
+  key.kind = ResolvedType::TypeKind::Smart;
+  key.first = pointeeType.get();
+  key.flags = static_cast<int>(kind);
+
+  ResolvedType type(key.kind);
+  type.pointeeType_ = pointeeType;
+  type.smartKind_ = kind;
+  return unique(key, std::move(type));
+}
+
+TypeContext::TypePtr TypeContext::getAtomic(const TypePtr &valueType) {
+  TypeKey key;
+  key.kind = ResolvedType::TypeKind::Atomic;
+  key.first = valueType.get();
+
+  ResolvedType type(key.kind);
+  type.elementType_ = valueType;
+  return unique(key, std::move(type));
+}
+
+TypeContext::TypePtr TypeContext::getSlice(const TypePtr &elementType,
+                                           bool isBytes) {
+  TypeKey key;
+  key.kind = ResolvedType::TypeKind::Slice;
+  key.first = elementType.get();
+  key.flags = isBytes ? 1 : 0;
+
+  ResolvedType type(key.kind);
+  type.elementType_ = elementType;
+  type.isBytes_ = isBytes;
+  return unique(key, std::move(type));
+}
+
+TypeContext::TypePtr TypeContext::getVector(const TypePtr &elementType,
+                                            unsigned lanes) {
+  TypeKey key;
+  key.kind = ResolvedType::TypeKind::Vector;
+  key.first = elementType.get();
+  key.flags = static_cast<int>(lanes);
+
+  ResolvedType type(key.kind);
+  type.elementType_ = elementType;
+  type.lanes_ = lanes;
+  return unique(key, std::move(type));
+}
+
+TypeContext::TypePtr TypeContext::getUnion(const TypePtr &left,
+                                           const TypePtr &right) {
+  TypeKey key;
+  key.kind = ResolvedType::TypeKind::Union;
+
+  // Union equality ignores arm order; reuse the mirrored union if it exists
+  key.first = right.get();
+  key.second = left.get();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = types_.find(key);
+    if (it != types_.end()) {
+      return it->second;
+    }
+  }
+
+  key.first = left.get();
+  key.second = right.get();
+
+  ResolvedType type(key.kind);
+  type.leftType_ = left;
+  type.rightType_ = right;
+  return unique(key, std::move(type));
+}
+
+TypeContext::TypePtr
+TypeContext::getTemplate(const std::string &name,
+                         const std::vector<TypePtr> &args) {
+  TypeKey key;
+  key.kind = ResolvedType::TypeKind::Template;
+  key.name = core::Interner::instance().intern(name);
+  key.list = addresses(args);
+
+  ResolvedType type(key.kind);
+  type.name_ = name;
+  type.templateArgs_ = args;
+  return unique(key, std::move(type));
+}
+
+size_t TypeContext::getTypeCount() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return types_.size();
+}
+
+/*****************************************************************************
+ * Relations
+ *****************************************************************************/
+
+bool TypeContext::isAssignable(const ResolvedType &from,
+                               const ResolvedType &to) {
+  auto pair = std::make_pair(&from, &to);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = assignable_.find(pair);
+    if (it != assignable_.end()) {
+      return it->second;
+    }
+  }
+
+  // Computed unlocked: the check recurses into component pairs
+  bool result = from.checkAssignableTo(to);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  assignable_.emplace(pair, result);
+  return result;
+}
+
+/*****************************************************************************
+ * Classes
+ *****************************************************************************/
+
+void TypeContext::declareClass(const TypePtr &type,
+                               std::vector<TypePtr> supertypes,
+                               std::unordered_map<core::Symbol, TypePtr> members) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto &info = classes_[type.get()];
+  // Classes are declared again before their bodies are checked; the
+  // hierarchy only changes if a name was declared differently
+  if (info.supertypes != supertypes) {
+    ancestries_.clear();
+    assignable_.clear();
+  }
+  info = {std::move(supertypes), std::move(members)};
+}
+
+const TypeContext::Ancestry &
+TypeContext::getAncestry(const ResolvedType *type) {
+  auto cached = ancestries_.find(type);
+  if (cached != ancestries_.end()) {
+    return cached->second;
+  }
+
+  // Cycles are cut by the set; a type is not its own supertype
+  Ancestry ancestry;
+  for (size_t i = 0; i <= ancestry.order.size(); ++i) {
+    auto it = classes_.find(i == 0 ? type : ancestry.order[i - 1]);
+    if (it == classes_.end()) {
+      continue;
+    }
+    for (const auto &parent : it->second.supertypes) {
+      if (parent.get() != type &&
+          ancestry.members.insert(parent.get()).second) {
+        ancestry.order.push_back(parent.get());
+      }
+    }
+  }
+  return ancestries_.emplace(type, std::move(ancestry)).first->second;
+}
+
+bool TypeContext::isSubtype(const ResolvedType &type,
+                            const ResolvedType &supertype) {
+  if (&type == &supertype) {
+    return true;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  return getAncestry(&type).members.count(&supertype) != 0;
+}
+
+std::vector<const ResolvedType *>
+TypeContext::getSupertypes(const ResolvedType &type) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return getAncestry(&type).order;
+}
+
+TypeContext::TypePtr TypeContext::lookupMember(const ResolvedType &type,
+                                               core::Symbol name) {
+  // Breadth first, so a class's own members hide inherited ones
+  std::vector<const ResolvedType *> pending{&type};
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (size_t i = 0; i < pending.size() && i < 64; ++i) {
+    auto it = classes_.find(pending[i]);
+    if (it == classes_.end()) {
+      continue;
+    }
+    auto member = it->second.members.find(name);
+    if (member != it->second.members.end()) {
+      return member->second;
+    }
+    for (const auto &parent : it->second.supertypes) {
+      pending.push_back(parent.get());
+    }
+  }
+  return nullptr;
+}
+
+TypeContext::ClassInfo TypeContext::getClassInfo(const ResolvedType &type) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = classes_.find(&type);
+  return it == classes_.end() ? ClassInfo() : it->second;
+}
+
+} // namespace visitors
@@ -0,0 +1,177 @@
+/*****************************************************************************
+ * File: type_context.h
+ * Description: Uniquing table for resolved types
+ *
+ * Contains:
+ * - Hash-consed construction of every ResolvedType
+ * - Memoized assignability between type pairs
+ * - Supertypes and members of declared classes and interfaces
+ * - Transitively closed class and interface hierarchies
+ *****************************************************************************/
+
+#pragma once
+#include "core/common/interner.h"
+#include "core/common/macros.h"
+#include "resolved_type.h"
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace visitors {
+
+/**
+ * @class TypeContext
+ * @brief Owns one immutable instance of every distinct resolved type
+ *
+ * Types are built bottom-up from already-uniqued components, so a type is
+ * identified by its kind, name, flags and the addresses of its components.
+ * Structurally identical types therefore share one instance and compare by
+ * pointer. A union and its mirror (A | B, B | A) share the instance that was
+ * created first.
+ */
+class TypeContext {
+  SINGLETON(TypeContext);
+
+public:
+  using TypePtr = std::shared_ptr<ResolvedType>;
+
+  // Builtin types
+  TypePtr getVoid();
+  TypePtr getInt();
+  TypePtr getFloat();
+  TypePtr getBool();
+  TypePtr getString();
+  TypePtr getError();
+
+  // Composite types; components must come from this context
+  TypePtr getNamed(const std::string &name);
+  TypePtr getArray(const TypePtr &elementType);
+  TypePtr getPointer(const TypePtr &pointeeType, bool isUnsafe = false);
+  TypePtr getReference(const TypePtr &refType);
+  TypePtr getFunction(const TypePtr &returnType,
+                      const std::vector<TypePtr> &paramTypes,
+                      bool isAsync = false, bool isVariadic = false);
+  TypePtr getSmart(const TypePtr &pointeeType, ResolvedType::SmartKind kind);
+  TypePtr getAtomic(const TypePtr &valueType);
+  TypePtr getSlice(const TypePtr &elementType, bool isBytes = false);
+  TypePtr getVector(const TypePtr &elementType, unsigned lanes);
+  TypePtr getUnion(const TypePtr &left, const TypePtr &right);
+  TypePtr getTemplate(const std::string &name,
+                      const std::vector<TypePtr> &args);
+
+  /**
+   * @brief Checks assignability, caching the result per (from, to) pair
+   */
+  bool isAssignable(const ResolvedType &from, const ResolvedType &to);
+
+  /**
+   * @brief Records the base class, interfaces and members of a class or
+   * interface
+   *
+   * Replaces what an earlier declaration of the same name recorded. If the
+   * supertypes changed, cached hierarchies and assignability are forgotten.
+   *
+   * @param type The named class or interface type
+   * @param supertypes Base class and implemented or extended interfaces
+   * @param members Field types and method function types by name
+   */
+  void declareClass(const TypePtr &type, std::vector<TypePtr> supertypes,
+                    std::unordered_map<core::Symbol, TypePtr> members);
+
+  /**
+   * @brief Checks whether a type is, extends or implements another
+   *
+   * The first query for a type closes its hierarchy over; later queries
+   * for it are a single lookup.
+   */
+  bool isSubtype(const ResolvedType &type, const ResolvedType &supertype);
+
+  /**
+   * @brief Gets every class and interface a type extends or implements,
+   * directly or not, nearest first and each once
+   */
+  std::vector<const ResolvedType *> getSupertypes(const ResolvedType &type);
+
+  /**
+   * @brief Finds a member declared by a type or inherited from a supertype
+   * @return The member's type, or nullptr if there is none
+   */
+  TypePtr lookupMember(const ResolvedType &type, core::Symbol name);
+
+  // What declareClass() recorded for a class or interface
+  struct ClassInfo {
+    std::vector<TypePtr> supertypes;
+    std::unordered_map<core::Symbol, TypePtr> members;
+  };
+
+  /**
+   * @brief Gets a copy of what was recorded for a class or interface
+   * @return The record, empty for types that were never declared
+   */
+  ClassInfo getClassInfo(const ResolvedType &type);
+
+  // Number of distinct types created so far
+  size_t getTypeCount() const;
+
+private:
+  // Shallow identity of a type: components are compared by address
+  struct TypeKey {
+    ResolvedType::TypeKind kind;
+    core::Symbol name;
+    const ResolvedType *first = nullptr;    // Element, pointee, return, left
+    const ResolvedType *second = nullptr;   // Right arm of a union
+    std::vector<const ResolvedType *> list; // Parameters or template args
+    int flags = 0; // Unsafe, async or variadic bits; smart kind; lanes
+
+    bool operator==(const TypeKey &other) const {
+      return kind == other.kind && name == other.name &&
+             first == other.first && second == other.second &&
+             list == other.list && flags == other.flags;
+    }
+  };
+
+  struct TypeKeyHash {
+    size_t operator()(const TypeKey &key) const;
+  };
+
+  struct PairHash {
+    size_t operator()(
+        const std::pair<const ResolvedType *, const ResolvedType *> &pair)
+        const;
+  };
+
+  /**
+   * @brief Returns the instance for a key, adopting the prototype if new
+   */
+  TypePtr unique(const TypeKey &key, ResolvedType prototype);
+
+  TypePtr getBuiltin(ResolvedType::TypeKind kind);
+
+  // Transitive supertypes of a type, breadth first, in order and as a set
+  struct Ancestry {
+    std::vector<const ResolvedType *> order;
+    std::unordered_set<const ResolvedType *> members;
+  };
+
+  /**
+   * @brief Returns the closed hierarchy of a type, computing it if new
+   *
+   * Called with mutex_ held.
+   */
+  const Ancestry &getAncestry(const ResolvedType *type);
+
+  std::unordered_map<TypeKey, TypePtr, TypeKeyHash> types_;
+  std::unordered_map<std::pair<const ResolvedType *, const ResolvedType *>,
+                     bool, PairHash>
+      assignable_;
+  std::unordered_map<const ResolvedType *, ClassInfo> classes_;
+  std::unordered_map<const ResolvedType *, Ancestry> ancestries_;
+  mutable std::mutex mutex_;
+};
+
+} // namespace visitors
@@ -1,81 +1,129 @@
 #include "type_scope.h"
+#include "module_interface.h"
 #include "resolved_type.h"
+#include <algorithm>
 
 namespace visitors {
 
-// Variable declaration and lookup methods
-void TypeScope::declareVariable(const std::string &name,
-                                std::shared_ptr<ResolvedType> type) {
-  variables_[name] = std::move(type);
+// Scope management methods
+void TypeScope::enterScope() {
+  marks_.push_back(static_cast<uint32_t>(entries_.size()));
 }
 
-std::shared_ptr<ResolvedType>
-TypeScope::lookupVariable(const std::string &name) const {
-  // Try to find in current scope
-  auto it = variables_.find(name);
-  if (it != variables_.end()) {
-    return it->second;
+void TypeScope::exitScope() {
+  // The global scope is never popped
+  if (marks_.empty()) {
+    return;
   }
 
-  // If not found and we have a parent scope, try looking there
-  if (parent_) {
-    return parent_->lookupVariable(name);
-  }
+  uint32_t mark = marks_.back();
+  marks_.pop_back();
 
-  // Not found anywhere
-  return nullptr;
+  // Unwind in reverse so every key ends up at its next outer entry. Keys
+  // stay in the index (possibly as kNoEntry) so redeclaring them later
+  // reuses the node.
+  while (entries_.size() > mark) {
+    const Entry &entry = entries_.back();
+    innermost_[entry.key] = entry.shadowed;
+    entries_.pop_back();
+  }
 }
 
-// Function declaration and lookup methods
-void TypeScope::declareFunction(const std::string &name,
-                                std::shared_ptr<ResolvedType> type) {
-  functions_[name] = std::move(type);
+// Shared declaration and lookup
+void TypeScope::declare(core::Symbol name, Namespace space,
+                        std::shared_ptr<ResolvedType> type) {
+  uint64_t key = makeKey(name, space);
+  uint32_t scopeStart = marks_.empty() ? 0 : marks_.back();
+
+  auto it = innermost_.find(key);
+  uint32_t previous = it != innermost_.end() ? it->second : kNoEntry;
+
+  // Redeclaring in the same scope replaces the existing entry
+  if (previous != kNoEntry && previous >= scopeStart) {
+    entries_[previous].type = std::move(type);
+    return;
+  }
+
+  uint32_t index = static_cast<uint32_t>(entries_.size());
+  entries_.push_back({key, std::move(type), previous});
+  if (it != innermost_.end()) {
+    it->second = index;
+  } else {
+    innermost_.emplace(key, index);
+  }
 }
 
-std::shared_ptr<ResolvedType>
-TypeScope::lookupFunction(const std::string &name) const {
-  // Try to find in current scope
-  auto it = functions_.find(name);
-  if (it != functions_.end()) {
-    return it->second;
+size_t TypeScope::getVariableDepth(core::Symbol name) const {
+  auto it = innermost_.find(makeKey(name, Namespace::Variable));
+  if (it == innermost_.end() || it->second == kNoEntry) {
+    return 0;
   }
+  // Scope N starts at marks_[N - 1]
+  return std::upper_bound(marks_.begin(), marks_.end(), it->second) -
+         marks_.begin();
+}
 
-  // If not found and we have a parent scope, try looking there
+std::shared_ptr<ResolvedType> TypeScope::lookup(core::Symbol name,
+                                                Namespace space) const {
+  auto it = innermost_.find(makeKey(name, space));
+  if (it != innermost_.end() && it->second != kNoEntry) {
+    return entries_[it->second].type;
+  }
   if (parent_) {
-    return parent_->lookupFunction(name);
+    return parent_->lookup(name, space);
   }
 
-  // Not found anywhere
+  // The kinds of an interface are the name spaces of a scope
+  static_assert(static_cast<int>(ModuleInterface::Kind::Variable) ==
+                        static_cast<int>(Namespace::Variable) &&
+                    static_cast<int>(ModuleInterface::Kind::Function) ==
+                        static_cast<int>(Namespace::Function) &&
+                    static_cast<int>(ModuleInterface::Kind::Type) ==
+                        static_cast<int>(Namespace::Type),
+                "interface kinds must match scope name spaces");
+  for (const auto &import : imports_) {
+    if (auto type = import->lookup(
+            name, static_cast<ModuleInterface::Kind>(space))) {
+      return type;
+    }
+  }
   return nullptr;
 }
 
-// Type declaration and lookup methods
-void TypeScope::declareType(const std::string &name,
-                            std::shared_ptr<ResolvedType> type) {
-  types_[name] = std::move(type);
+void TypeScope::addImport(std::shared_ptr<const ModuleInterface> interface) {
+  imports_.push_back(std::move(interface));
+}
+
+// Variable declaration and lookup methods
+void TypeScope::declareVariable(core::Symbol name,
+                                std::shared_ptr<ResolvedType> type) {
+  declare(name, Namespace::Variable, std::move(type));
 }
 
 std::shared_ptr<ResolvedType>
-TypeScope::lookupType(const std::string &name) const {
-  // Try to find in current scope
-  auto it = types_.find(name);
-  if (it != types_.end()) {
-    return it->second;
-  }
+TypeScope::lookupVariable(core::Symbol name) const {
+  return lookup(name, Namespace::Variable);
+}
 
-  // If not found and we have a parent scope, try looking there
-  if (parent_) {
-    return parent_->lookupType(name);
-  }
+// Function declaration and lookup methods
+void TypeScope::declareFunction(core::Symbol name,
+                                std::shared_ptr<ResolvedType> type) {
+  declare(name, Namespace::Function, std::move(type));
+}
 
-  // Not found anywhere
-  return nullptr;
+std::shared_ptr<ResolvedType>
+TypeScope::lookupFunction(core::Symbol name) const {
+  return lookup(name, Namespace::Function);
+}
+
+// Type declaration and lookup methods
+void TypeScope::declareType(core::Symbol name,
+                            std::shared_ptr<ResolvedType> type) {
+  declare(name, Namespace::Type, std::move(type));
 }
 
-// Create a new scope with this scope as parent
-std::shared_ptr<TypeScope> TypeScope::createChildScope() const {
-  return std::make_shared<TypeScope>(
-      const_cast<TypeScope *>(this)->shared_from_this());
+std::shared_ptr<ResolvedType> TypeScope::lookupType(core::Symbol name) const {
+  return lookup(name, Namespace::Type);
 }
 
-} // namespace visitors
\ No newline at end of file
+} // namespace visitors
@@ -1,45 +1,112 @@
 #pragma once
+#include "core/common/interner.h"
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 namespace visitors {
 
-// Forward declaration
+// Forward declarations
 class ResolvedType;
+class ModuleInterface;
 
 /**
- * @brief Scope for type checking
+ * @brief Scoped symbol table for type checking
  *
- * Maintains a symbol table for variables, functions, and types in the current
- * scope.
+ * Holds variables, functions, and types of every open scope in one flat
+ * table. Declarations are appended to a single entry stack and each interned
+ * name maps to its innermost entry, so a lookup is one hash probe whatever
+ * the nesting depth. Entering a scope records a mark; leaving it truncates
+ * the stack back to the mark and restores any shadowed entries, so neither
+ * allocates.
+ *
+ * Names no scope declares are looked up in the parent scope, if any, and
+ * then in the imported module interfaces, in import order, which decode a
+ * declaration on its first use.
  */
-class TypeScope : public std::enable_shared_from_this<TypeScope> {
+class TypeScope {
 public:
-  TypeScope(std::shared_ptr<TypeScope> parent = nullptr) : parent_(parent) {}
+  TypeScope() = default;
+
+  // A scope over a read-only one, which must outlive it. Names it does not
+  // declare are looked up there, so threads may share the one underneath.
+  explicit TypeScope(const TypeScope *parent) : parent_(parent) {}
+
+  // Scope management
+  void enterScope();
+  void exitScope();
+  size_t getDepth() const { return marks_.size(); }
 
   // Variable declarations
-  void declareVariable(const std::string &name,
-                       std::shared_ptr<ResolvedType> type);
-  std::shared_ptr<ResolvedType> lookupVariable(const std::string &name) const;
+  void declareVariable(core::Symbol name, std::shared_ptr<ResolvedType> type);
+  std::shared_ptr<ResolvedType> lookupVariable(core::Symbol name) const;
+  // Depth of the scope declaring a variable's innermost entry; 0 for the
+  // global scope and for names it does not declare
+  size_t getVariableDepth(core::Symbol name) const;
 
   // Function declarations
-  void declareFunction(const std::string &name,
-                       std::shared_ptr<ResolvedType> type);
-  std::shared_ptr<ResolvedType> lookupFunction(const std::string &name) const;
+  void declareFunction(core::Symbol name, std::shared_ptr<ResolvedType> type);
+  std::shared_ptr<ResolvedType> lookupFunction(core::Symbol name) const;
 
   // Type declarations
-  void declareType(const std::string &name, std::shared_ptr<ResolvedType> type);
-  std::shared_ptr<ResolvedType> lookupType(const std::string &name) const;
+  void declareType(core::Symbol name, std::shared_ptr<ResolvedType> type);
+  std::shared_ptr<ResolvedType> lookupType(core::Symbol name) const;
 
-  // Create a new nested scope
-  std::shared_ptr<TypeScope> createChildScope() const;
+  // Makes an interface's declarations visible behind every scope
+  void addImport(std::shared_ptr<const ModuleInterface> interface);
+
+  // Convenience overloads that intern the name first
+  void declareVariable(const std::string &name,
+                       std::shared_ptr<ResolvedType> type) {
+    declareVariable(core::Interner::instance().intern(name), std::move(type));
+  }
+  std::shared_ptr<ResolvedType> lookupVariable(const std::string &name) const {
+    return lookupVariable(core::Interner::instance().intern(name));
+  }
+  void declareFunction(const std::string &name,
+                       std::shared_ptr<ResolvedType> type) {
+    declareFunction(core::Interner::instance().intern(name), std::move(type));
+  }
+  std::shared_ptr<ResolvedType> lookupFunction(const std::string &name) const {
+    return lookupFunction(core::Interner::instance().intern(name));
+  }
+  void declareType(const std::string &name,
+                   std::shared_ptr<ResolvedType> type) {
+    declareType(core::Interner::instance().intern(name), std::move(type));
+  }
+  std::shared_ptr<ResolvedType> lookupType(const std::string &name) const {
+    return lookupType(core::Interner::instance().intern(name));
+  }
 
 private:
-  std::shared_ptr<TypeScope> parent_;
-  std::unordered_map<std::string, std::shared_ptr<ResolvedType>> variables_;
-  std::unordered_map<std::string, std::shared_ptr<ResolvedType>> functions_;
-  std::unordered_map<std::string, std::shared_ptr<ResolvedType>> types_;
+  // Separate name spaces share the table through the key
+  enum class Namespace : uint8_t { Variable, Function, Type };
+
+  static constexpr uint32_t kNoEntry = UINT32_MAX;
+
+  struct Entry {
+    uint64_t key;                       // Symbol and namespace
+    std::shared_ptr<ResolvedType> type; // Declared type
+    uint32_t shadowed;                  // Outer entry with the same key
+  };
+
+  static uint64_t makeKey(core::Symbol name, Namespace space) {
+    return (static_cast<uint64_t>(name.getId()) << 2) |
+           static_cast<uint64_t>(space);
+  }
+
+  void declare(core::Symbol name, Namespace space,
+               std::shared_ptr<ResolvedType> type);
+  std::shared_ptr<ResolvedType> lookup(core::Symbol name,
+                                       Namespace space) const;
+
+  std::vector<Entry> entries_;                       // All open declarations
+  std::vector<uint32_t> marks_;                      // Stack size per scope
+  std::unordered_map<uint64_t, uint32_t> innermost_; // Key -> entry index
+  std::vector<std::shared_ptr<const ModuleInterface>> imports_; // Fallbacks
+  const TypeScope *parent_ = nullptr; // Read-only scope underneath
 };
 
-} // namespace visitors
\ No newline at end of file
+} // namespace visitors
@@ -7,7 +7,7 @@
 namespace repl {
 
 Repl::Repl(core::ErrorReporter &errorReporter)
-    : errorReporter_(errorReporter) {}
+    : errorReporter_(errorReporter), codeGen_(errorReporter, "tspp_repl") {}
 
 void Repl::printWelcome() {
   std::cout << "TSPP REPL v0.1.0\n";
@@ -25,7 +25,8 @@ void Repl::processLine(const std::string &line) {
     lexer::Lexer lexer(line, "<repl>");
     auto tokens = lexer.tokenize();
 
-    if (tokens.empty()) {
+    // Blank and comment-only lines leave nothing but the end of input
+    if (tokens.empty() || tokens.front().isEOF()) {
       return;
     }
 
@@ -36,23 +37,21 @@ void Repl::processLine(const std::string &line) {
     }
 
     // Parsing
-    parser::Parser parser(std::move(tokens), errorReporter_);
+    parser::Parser parser(std::move(tokens), errorReporter_, &globals_);
     if (!parser.parse()) {
-      if (errorReporter_.hasErrors()) {
-        errorReporter_.printAllErrors();
-      }
+      errorReporter_.flush();
       return;
     }
 
     // Print AST if enabled
     if (showAst_) {
-      const auto &ast = parser.getAST();
-      // TODO: Add AST printer visitor
-      // parser::ASTPrinterVisitor printer;
-      // printer.print(ast);
-      // std::cout << printer.getOutput() << "\n";
+      printAST(parser.getAST());
     }
 
+    // Compile the line into the running session and execute it
+    codeGen_.executeIncremental(parser.getAST());
+    errorReporter_.flush();
+
   } catch (const std::exception &e) {
     std::cerr << "Error: " << e.what() << "\n";
   }
@@ -1,5 +1,7 @@
 #pragma once
+#include "../codegen/llvm/llvm_code_gen.h"
 #include "../core/diagnostics/error_reporter.h"
+#include "../parser/visitors/type_check_visitor/type_scope.h"
 #include <string>
 
 namespace repl {
@@ -11,6 +13,8 @@ public:
 
 private:
   core::ErrorReporter &errorReporter_;
+  codegen::LLVMCodeGen codeGen_; // Persistent JIT session across lines
+  visitors::TypeScope globals_;  // Declarations of every accepted line
   bool showTokens_ = false; // Added flag for token output
   bool showAst_ = true;     // Added flag for AST output
 
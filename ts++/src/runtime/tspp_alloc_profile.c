@@ -0,0 +1,336 @@
+#define _POSIX_C_SOURCE 200809L
+#include "runtime/tspp_runtime.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef __wasm__
+#include <pthread.h>
+#endif
+
+/*
+ * Statistics of -alloc-profile sites. The allocator reports each object
+ * of a profiled new expression, and each release of a stamped one, to a
+ * small hash table of the calling thread, with no locks or atomics; the
+ * tables are merged into the totals under a lock, which exit writes as a
+ * pprof profile.
+ */
+
+typedef struct site_stats {
+  const tspp_alloc_site *site; /* NULL in an empty slot */
+  uint64_t objects;            /* Allocated */
+  uint64_t scoped;             /* Of those, never freed one by one */
+  uint64_t freed;              /* Released by tspp_free(), on any thread */
+  uint64_t lifetime;           /* Nanoseconds the freed objects lived */
+} site_stats;
+
+#define LOCAL_SLOTS 256 /* Per thread; merged when three quarters are used */
+
+typedef struct local_table {
+  site_stats slots[LOCAL_SLOTS];
+  size_t used;
+} local_table;
+
+static _Thread_local local_table *local;
+
+static site_stats *totals; /* Open addressing, like the local tables */
+static size_t totals_capacity;
+static size_t totals_used;
+
+#ifndef __wasm__
+static pthread_mutex_t totals_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t setup_once = PTHREAD_ONCE_INIT;
+static pthread_key_t table_key; /* Merges a thread's table when it exits */
+#endif
+
+/* The slot holding site, or the empty one where it belongs */
+static site_stats *find_slot(site_stats *slots, size_t capacity,
+                             const tspp_alloc_site *site) {
+  size_t index = (size_t)(((uintptr_t)site >> 3) * 0x9e3779b97f4a7c15u) &
+                 (capacity - 1);
+  while (slots[index].site && slots[index].site != site) {
+    index = (index + 1) & (capacity - 1);
+  }
+  return &slots[index];
+}
+
+/* Adds a thread's statistics of one site to the totals; holds the lock */
+static void merge(const site_stats *stats) {
+  if ((totals_used + 1) * 4 > totals_capacity * 3) {
+    size_t capacity = totals_capacity ? totals_capacity * 2 : LOCAL_SLOTS;
+    site_stats *slots = calloc(capacity, sizeof(site_stats));
+    if (!slots) {
+      return;
+    }
+    for (size_t i = 0; i < totals_capacity; ++i) {
+      if (totals[i].site) {
+        *find_slot(slots, capacity, totals[i].site) = totals[i];
+      }
+    }
+    free(totals);
+    totals = slots;
+    totals_capacity = capacity;
+  }
+
+  site_stats *total = find_slot(totals, totals_capacity, stats->site);
+  if (!total->site) {
+    total->site = stats->site;
+    ++totals_used;
+  }
+  total->objects += stats->objects;
+  total->scoped += stats->scoped;
+  total->freed += stats->freed;
+  total->lifetime += stats->lifetime;
+}
+
+static void lock_totals(void) {
+#ifndef __wasm__
+  pthread_mutex_lock(&totals_lock);
+#endif
+}
+
+static void unlock_totals(void) {
+#ifndef __wasm__
+  pthread_mutex_unlock(&totals_lock);
+#endif
+}
+
+static void merge_table(local_table *table) {
+  if (table->used == 0) {
+    return;
+  }
+  lock_totals();
+  for (size_t i = 0; i < LOCAL_SLOTS; ++i) {
+    if (table->slots[i].site) {
+      merge(&table->slots[i]);
+    }
+  }
+  unlock_totals();
+  memset(table->slots, 0, sizeof(table->slots));
+  table->used = 0;
+}
+
+#ifndef __wasm__
+static void release_table(void *table) {
+  merge_table(table);
+  free(table);
+}
+
+static void setup(void) {
+  pthread_key_create(&table_key, release_table);
+  atexit(tspp_alloc_profile_write);
+}
+#endif
+
+/* The calling thread's statistics of a site, or NULL when out of memory */
+static site_stats *local_stats(const tspp_alloc_site *site) {
+  local_table *table = local;
+  if (!table) {
+#ifndef __wasm__
+    pthread_once(&setup_once, setup);
+#else
+    static int setup_done;
+    if (!setup_done) {
+      setup_done = 1;
+      atexit(tspp_alloc_profile_write);
+    }
+#endif
+    table = calloc(1, sizeof(local_table));
+    if (!table) {
+      return NULL;
+    }
+#ifndef __wasm__
+    pthread_setspecific(table_key, table);
+#endif
+    local = table;
+  }
+
+  site_stats *stats = find_slot(table->slots, LOCAL_SLOTS, site);
+  if (!stats->site) {
+    if ((table->used + 1) * 4 > LOCAL_SLOTS * 3) {
+      merge_table(table);
+      stats = find_slot(table->slots, LOCAL_SLOTS, site);
+    }
+    stats->site = site;
+    ++table->used;
+  }
+  return stats;
+}
+
+void tspp_alloc_profile_record(const tspp_alloc_site *site, int scoped) {
+  site_stats *stats = local_stats(site);
+  if (stats) {
+    ++stats->objects;
+    stats->scoped += scoped != 0;
+  }
+}
+
+void tspp_alloc_profile_release(const tspp_alloc_site *site,
+                                uint64_t lifetime) {
+  site_stats *stats = local_stats(site);
+  if (stats) {
+    ++stats->freed;
+    stats->lifetime += lifetime;
+  }
+}
+
+void tspp_alloc_profile_flush(void) {
+  if (local) {
+    merge_table(local);
+  }
+}
+
+/*
+ * A profile.proto message, the format pprof reads, built in memory. Only
+ * varints and length-delimited fields are needed.
+ */
+typedef struct message {
+  unsigned char *data;
+  size_t size;
+  size_t capacity;
+  int failed; /* Out of memory; the profile is not written */
+} message;
+
+static void put_bytes(message *out, const void *bytes, size_t count) {
+  if (out->failed || count == 0) {
+    return;
+  }
+  if (count > out->capacity - out->size) {
+    size_t capacity = out->capacity ? out->capacity : 256;
+    while (count > capacity - out->size) {
+      capacity *= 2;
+    }
+    unsigned char *data = realloc(out->data, capacity);
+    if (!data) {
+      out->failed = 1;
+      return;
+    }
+    out->data = data;
+    out->capacity = capacity;
+  }
+  memcpy(out->data + out->size, bytes, count);
+  out->size += count;
+}
+
+static void put_varint(message *out, uint64_t value) {
+  unsigned char bytes[10];
+  size_t count = 0;
+  do {
+    bytes[count] = (unsigned char)(value & 0x7f);
+    value >>= 7;
+    if (value) {
+      bytes[count] |= 0x80;
+    }
+    ++count;
+  } while (value);
+  put_bytes(out, bytes, count);
+}
+
+static void put_int(message *out, unsigned field, uint64_t value) {
+  put_varint(out, (uint64_t)field << 3);
+  put_varint(out, value);
+}
+
+static void put_field(message *out, unsigned field, const void *bytes,
+                      size_t count) {
+  put_varint(out, (uint64_t)field << 3 | 2);
+  put_varint(out, count);
+  put_bytes(out, bytes, count);
+}
+
+/* Appends a nested message and empties it for reuse */
+static void put_message(message *out, unsigned field, message *nested) {
+  out->failed |= nested->failed;
+  put_field(out, field, nested->data, nested->size);
+  nested->size = 0;
+}
+
+/* Appends to string_table, returning the string's index */
+static uint64_t put_string(message *profile, uint64_t *strings,
+                           const char *text) {
+  put_field(profile, 6, text, strlen(text));
+  return (*strings)++;
+}
+
+static void put_value_type(message *profile, message *scratch,
+                           uint64_t *strings, const char *type,
+                           const char *unit) {
+  put_int(scratch, 1, put_string(profile, strings, type));
+  put_int(scratch, 2, put_string(profile, strings, unit));
+  put_message(profile, 1, scratch);
+}
+
+/* One location per site, in the function holding it */
+static void put_site(message *profile, message *scratch, message *line,
+                     uint64_t *strings, uint64_t id, const site_stats *stats) {
+  const tspp_alloc_site *site = stats->site;
+  put_int(scratch, 1, id);
+  put_int(scratch, 2, put_string(profile, strings, site->function));
+  put_int(scratch, 4, put_string(profile, strings, site->file));
+  put_message(profile, 5, scratch);
+
+  put_int(line, 1, id);
+  put_int(line, 2, (uint64_t)site->line);
+  put_int(line, 3, (uint64_t)site->column);
+  put_int(scratch, 1, id);
+  put_message(scratch, 4, line);
+  put_message(profile, 4, scratch);
+
+  uint64_t live = stats->objects - stats->scoped;
+  live = live > stats->freed ? live - stats->freed : 0;
+  uint64_t values[5] = {stats->objects, stats->objects * site->size, live,
+                        live * site->size, stats->lifetime};
+  put_varint(line, id);
+  put_message(scratch, 1, line);
+  for (size_t i = 0; i < 5; ++i) {
+    put_varint(line, values[i]);
+  }
+  put_message(scratch, 2, line);
+  put_int(line, 1, put_string(profile, strings, "type"));
+  put_int(line, 2, put_string(profile, strings, site->type));
+  put_message(scratch, 3, line);
+  put_message(profile, 2, scratch);
+}
+
+void tspp_alloc_profile_write(void) {
+  tspp_alloc_profile_flush();
+  lock_totals();
+  site_stats *sites = totals;
+  size_t capacity = totals_capacity;
+  totals = NULL;
+  totals_capacity = 0;
+  totals_used = 0;
+  unlock_totals();
+  if (!sites) {
+    return;
+  }
+
+  message profile = {0}, scratch = {0}, line = {0};
+  uint64_t strings = 0;
+  put_string(&profile, &strings, "");
+  put_value_type(&profile, &scratch, &strings, "alloc_objects", "count");
+  put_value_type(&profile, &scratch, &strings, "alloc_space", "bytes");
+  put_value_type(&profile, &scratch, &strings, "inuse_objects", "count");
+  put_value_type(&profile, &scratch, &strings, "inuse_space", "bytes");
+  put_value_type(&profile, &scratch, &strings, "lifetime", "nanoseconds");
+  uint64_t id = 0;
+  for (size_t i = 0; i < capacity; ++i) {
+    if (sites[i].site && sites[i].objects != 0) {
+      put_site(&profile, &scratch, &line, &strings, ++id, &sites[i]);
+    }
+  }
+  put_int(&profile, 14, put_string(&profile, &strings, "alloc_space"));
+  profile.failed |= scratch.failed | line.failed;
+
+  const char *path = getenv("TSPP_ALLOC_PROFILE_FILE");
+  FILE *file = profile.failed
+                   ? NULL
+                   : fopen(path && *path ? path : "tspp.alloc.pprof", "wb");
+  if (file) {
+    fwrite(profile.data, 1, profile.size, file);
+    fclose(file);
+  }
+  free(profile.data);
+  free(scratch.data);
+  free(line.data);
+  free(sites);
+}
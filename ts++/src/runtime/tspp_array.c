@@ -0,0 +1,50 @@
+#include "runtime/tspp_runtime.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+_Static_assert(sizeof(tspp_array) == 24, "the compiler emits { T*, i64, i64 }");
+
+/* Smallest capacity a growing array gets */
+#define TSPP_ARRAY_MIN_CAPACITY 4
+
+static void reallocate(tspp_array *array, int64_t capacity,
+                       int64_t element_size, int64_t align) {
+  void *data = tspp_alloc((size_t)(capacity * element_size), (size_t)align);
+  if (!data) {
+    fputs("tspp: out of memory while growing an array\n", stderr);
+    abort();
+  }
+  if (array->length != 0) {
+    memcpy(data, array->data, (size_t)(array->length * element_size));
+  }
+  if (array->capacity != 0) {
+    tspp_free(array->data);
+  }
+  array->data = data;
+  array->capacity = capacity;
+}
+
+void tspp_array_grow(tspp_array *array, int64_t element_size, int64_t align) {
+  int64_t capacity = array->capacity * 2;
+  if (capacity < TSPP_ARRAY_MIN_CAPACITY) {
+    capacity = TSPP_ARRAY_MIN_CAPACITY;
+  }
+  if (capacity <= array->length) {
+    capacity = array->length + 1;
+  }
+  reallocate(array, capacity, element_size, align);
+}
+
+void tspp_array_reserve(tspp_array *array, int64_t capacity,
+                        int64_t element_size, int64_t align) {
+  if (capacity > array->capacity && capacity > array->length) {
+    reallocate(array, capacity, element_size, align);
+  }
+}
+
+void tspp_array_free(tspp_array *array) {
+  if (array->capacity != 0) {
+    tspp_free(array->data);
+  }
+}
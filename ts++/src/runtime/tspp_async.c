@@ -0,0 +1,460 @@
+#define _POSIX_C_SOURCE 200809L
+#include "runtime/tspp_runtime.h"
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+_Static_assert(sizeof(tspp_task) == 16, "the compiler emits { i8*, i32 }");
+
+/*
+ * Every coroutine frame starts with the functions that resume and destroy
+ * it, the layout LLVM's switch lowering gives frames; the resume function
+ * is cleared when the coroutine reaches its final suspend point.
+ */
+typedef void (*coroutine_fn)(void *);
+
+static void resume(void *handle) { ((coroutine_fn *)handle)[0](handle); }
+static void destroy(void *handle) { ((coroutine_fn *)handle)[1](handle); }
+static int is_done(void *handle) {
+  return ((coroutine_fn *)handle)[0] == NULL;
+}
+
+/* Something waiting: a suspended coroutine, or a blocked caller's flag */
+typedef struct waiter {
+  void *handle;
+  int *flag;
+} waiter;
+
+typedef struct timer {
+  uint64_t deadline; /* CLOCK_MONOTONIC nanoseconds */
+  uint64_t order;    /* Breaks ties so equal deadlines fire in order */
+  waiter waiter;
+} timer;
+
+/* The registration of a descriptor, freed once it fires */
+typedef struct fd_waiter {
+  int fd;
+  waiter waiter;
+} fd_waiter;
+
+/* Entries in each thread's submission queue */
+#define RING_ENTRIES 256
+
+/* user_data of the timeout that bounds a wait; registrations are never 0 */
+#define TIMEOUT_TAG 0
+
+/*
+ * An io_uring, driven through its system calls: the kernel shares the
+ * queues with us, so submissions are written and completions read in
+ * place, and one io_uring_enter submits everything queued and waits.
+ */
+typedef struct ring {
+  int fd;
+  unsigned *sq_head;
+  unsigned *sq_tail;
+  unsigned sq_mask;
+  unsigned *sq_array;
+  struct io_uring_sqe *sqes;
+  unsigned *cq_head;
+  unsigned *cq_tail;
+  unsigned cq_mask;
+  struct io_uring_cqe *cqes;
+  unsigned queued;          /* Submissions the kernel has not seen */
+  uint64_t timeout_armed;   /* Deadline of the earliest pending timeout, or 0 */
+  struct __kernel_timespec timeout;
+} ring;
+
+enum { BACKEND_NONE, BACKEND_URING, BACKEND_EPOLL };
+
+/* Per-thread: coroutines only ever resume on the thread that runs them */
+typedef struct executor {
+  void **ready; /* Ring buffer of handles to resume */
+  size_t ready_head;
+  size_t ready_count;
+  size_t ready_capacity;
+  timer *timers; /* Binary min-heap by deadline */
+  size_t timer_count;
+  size_t timer_capacity;
+  uint64_t next_order;
+  int backend; /* Chosen by the first descriptor wait */
+  ring ring;
+  int epoll_fd;
+  size_t fd_waiters;
+} executor;
+
+static _Thread_local executor loop = {.epoll_fd = -1};
+
+static void *grow(void *items, size_t *capacity, size_t item_size) {
+  size_t grown = *capacity ? *capacity * 2 : 16;
+  void *resized = realloc(items, grown * item_size);
+  if (!resized) {
+    tspp_runtime_fail("out of memory while scheduling a task", NULL);
+  }
+  *capacity = grown;
+  return resized;
+}
+
+static uint64_t now(void) {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return (uint64_t)time.tv_sec * 1000000000u + (uint64_t)time.tv_nsec;
+}
+
+static void schedule(void *handle) {
+  if (loop.ready_count == loop.ready_capacity) {
+    /* Unwrap the ring before it grows, so its new half is empty */
+    size_t capacity = loop.ready_capacity;
+    loop.ready = grow(loop.ready, &loop.ready_capacity, sizeof(void *));
+    memcpy(loop.ready + capacity, loop.ready, loop.ready_head * sizeof(void *));
+  }
+  loop.ready[(loop.ready_head + loop.ready_count) % loop.ready_capacity] =
+      handle;
+  ++loop.ready_count;
+}
+
+static void wake(waiter waiter) {
+  if (waiter.handle) {
+    schedule(waiter.handle);
+  } else {
+    *waiter.flag = 1;
+  }
+}
+
+static int timer_before(const timer *a, const timer *b) {
+  return a->deadline < b->deadline ||
+         (a->deadline == b->deadline && a->order < b->order);
+}
+
+static void add_timer(uint64_t deadline, waiter waiter) {
+  if (loop.timer_count == loop.timer_capacity) {
+    loop.timers = grow(loop.timers, &loop.timer_capacity, sizeof(timer));
+  }
+  timer added = {deadline, loop.next_order++, waiter};
+  size_t slot = loop.timer_count++;
+  while (slot != 0 && timer_before(&added, &loop.timers[(slot - 1) / 2])) {
+    loop.timers[slot] = loop.timers[(slot - 1) / 2];
+    slot = (slot - 1) / 2;
+  }
+  loop.timers[slot] = added;
+}
+
+static timer pop_timer(void) {
+  timer first = loop.timers[0];
+  timer last = loop.timers[--loop.timer_count];
+  size_t slot = 0;
+  for (;;) {
+    size_t child = slot * 2 + 1;
+    if (child >= loop.timer_count) {
+      break;
+    }
+    if (child + 1 < loop.timer_count &&
+        timer_before(&loop.timers[child + 1], &loop.timers[child])) {
+      ++child;
+    }
+    if (!timer_before(&loop.timers[child], &last)) {
+      break;
+    }
+    loop.timers[slot] = loop.timers[child];
+    slot = child;
+  }
+  loop.timers[slot] = last;
+  return first;
+}
+
+/* Sets up the thread's ring; 0 if the kernel has no io_uring or denies it */
+static int ring_setup(void) {
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  params.flags = IORING_SETUP_CLAMP;
+  int fd = (int)syscall(__NR_io_uring_setup, RING_ENTRIES, &params);
+  if (fd < 0) {
+    return 0;
+  }
+
+  size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  size_t cq_size =
+      params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  int single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if (single && cq_size > sq_size) {
+    sq_size = cq_size;
+  }
+  char *sq = mmap(NULL, sq_size, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+  char *cq = sq;
+  if (sq != MAP_FAILED && !single) {
+    cq = mmap(NULL, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+              fd, IORING_OFF_CQ_RING);
+  }
+  void *sqes = MAP_FAILED;
+  if (sq != MAP_FAILED && cq != MAP_FAILED) {
+    sqes = mmap(NULL, params.sq_entries * sizeof(struct io_uring_sqe),
+                PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                IORING_OFF_SQES);
+  }
+  if (sqes == MAP_FAILED) {
+    tspp_runtime_fail("cannot map an io_uring", NULL);
+  }
+
+  ring *r = &loop.ring;
+  r->fd = fd;
+  r->sq_head = (unsigned *)(sq + params.sq_off.head);
+  r->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+  r->sq_mask = *(unsigned *)(sq + params.sq_off.ring_mask);
+  r->sq_array = (unsigned *)(sq + params.sq_off.array);
+  r->sqes = sqes;
+  r->cq_head = (unsigned *)(cq + params.cq_off.head);
+  r->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+  r->cq_mask = *(unsigned *)(cq + params.cq_off.ring_mask);
+  r->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+  return 1;
+}
+
+/* Submits what is queued and waits for at least wait_for completions */
+static void ring_enter(unsigned wait_for) {
+  ring *r = &loop.ring;
+  int submitted =
+      (int)syscall(__NR_io_uring_enter, r->fd, r->queued, wait_for,
+                   wait_for ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+  if (submitted >= 0) {
+    r->queued -= (unsigned)submitted;
+    return;
+  }
+  /* Interrupted waits return to the loop, which waits again if it must;
+     a full completion queue needs reaping first */
+  if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+    tspp_runtime_fail("io_uring_enter failed", NULL);
+  }
+}
+
+static unsigned ring_reap(void);
+
+/* Claims the next submission queue entry, submitting a full queue first */
+static struct io_uring_sqe *ring_get_sqe(void) {
+  ring *r = &loop.ring;
+  unsigned tail = *r->sq_tail;
+  while (tail - __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE) > r->sq_mask) {
+    ring_enter(0);
+    ring_reap();
+  }
+  unsigned index = tail & r->sq_mask;
+  struct io_uring_sqe *sqe = &r->sqes[index];
+  memset(sqe, 0, sizeof(*sqe));
+  r->sq_array[index] = index;
+  return sqe;
+}
+
+/* Publishes the entry ring_get_sqe() returned; the kernel sees it on the
+   next io_uring_enter */
+static void ring_queue(void) {
+  ring *r = &loop.ring;
+  __atomic_store_n(r->sq_tail, *r->sq_tail + 1, __ATOMIC_RELEASE);
+  ++r->queued;
+}
+
+/* Wakes what the completions waited for; returns how many were reaped */
+static unsigned ring_reap(void) {
+  ring *r = &loop.ring;
+  unsigned head = *r->cq_head;
+  unsigned tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+  unsigned reaped = tail - head;
+  for (; head != tail; ++head) {
+    struct io_uring_cqe *cqe = &r->cqes[head & r->cq_mask];
+    if (cqe->user_data == TIMEOUT_TAG) {
+      r->timeout_armed = 0;
+      continue;
+    }
+    /* An error, such as a closed descriptor, wakes the waiter too; its
+       next call will say so */
+    fd_waiter *registration = (fd_waiter *)(uintptr_t)cqe->user_data;
+    --loop.fd_waiters;
+    wake(registration->waiter);
+    free(registration);
+  }
+  __atomic_store_n(r->cq_head, head, __ATOMIC_RELEASE);
+  return reaped;
+}
+
+/* Makes sure a pending timeout ends the next wait by the deadline */
+static void ring_arm_timeout(uint64_t deadline) {
+  ring *r = &loop.ring;
+  if (r->timeout_armed != 0 && r->timeout_armed <= deadline) {
+    return;
+  }
+  /* The kernel reads the time when the entry is submitted */
+  r->timeout.tv_sec = (int64_t)(deadline / 1000000000u);
+  r->timeout.tv_nsec = (long long)(deadline % 1000000000u);
+  struct io_uring_sqe *sqe = ring_get_sqe();
+  sqe->opcode = IORING_OP_TIMEOUT;
+  sqe->fd = -1;
+  sqe->addr = (uintptr_t)&r->timeout;
+  sqe->len = 1;
+  sqe->timeout_flags = IORING_TIMEOUT_ABS;
+  sqe->user_data = TIMEOUT_TAG;
+  ring_queue();
+  r->timeout_armed = deadline;
+}
+
+static void choose_backend(void) {
+  const char *setting = getenv("TSPP_IO");
+  if (!(setting && strcmp(setting, "epoll") == 0) && ring_setup()) {
+    loop.backend = BACKEND_URING;
+    return;
+  }
+  loop.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (loop.epoll_fd < 0) {
+    tspp_runtime_fail("cannot create an epoll instance", NULL);
+  }
+  loop.backend = BACKEND_EPOLL;
+}
+
+static void add_fd_waiter(int32_t fd, int32_t events, waiter waiter) {
+  if (loop.backend == BACKEND_NONE) {
+    choose_backend();
+  }
+  fd_waiter *registration = malloc(sizeof(fd_waiter));
+  if (!registration) {
+    tspp_runtime_fail("out of memory while scheduling a task", NULL);
+  }
+  registration->fd = fd;
+  registration->waiter = waiter;
+
+  /* Queued only: the executor submits every wait at once when it runs out
+     of ready tasks */
+  if (loop.backend == BACKEND_URING) {
+    struct io_uring_sqe *sqe = ring_get_sqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = ((events & TSPP_WAIT_READABLE) ? POLLIN : 0) |
+                         ((events & TSPP_WAIT_WRITABLE) ? POLLOUT : 0);
+    sqe->user_data = (uintptr_t)registration;
+    ring_queue();
+    ++loop.fd_waiters;
+    return;
+  }
+
+  struct epoll_event event;
+  memset(&event, 0, sizeof(event));
+  event.events = EPOLLONESHOT;
+  event.events |= (events & TSPP_WAIT_READABLE) ? EPOLLIN : 0;
+  event.events |= (events & TSPP_WAIT_WRITABLE) ? EPOLLOUT : 0;
+  event.data.ptr = registration;
+  if (epoll_ctl(loop.epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+    if (errno == EEXIST) {
+      tspp_runtime_fail("two tasks wait on the same descriptor", NULL);
+    }
+    /* A descriptor epoll cannot watch, such as a regular file, is always
+       ready; so is one that is closed, whose next call will say so */
+    free(registration);
+    wake(waiter);
+    return;
+  }
+  ++loop.fd_waiters;
+}
+
+/*
+ * Waits for the next descriptor or timer and wakes what waited on it. Only
+ * called with nothing ready to run.
+ */
+static void poll_events(void) {
+  int timeout = -1;
+  if (loop.timer_count != 0) {
+    uint64_t current = now();
+    uint64_t deadline = loop.timers[0].deadline;
+    uint64_t wait = deadline > current ? deadline - current : 0;
+    /* Rounded up, so the timer is due when the wait ends */
+    uint64_t millis = (wait + 999999) / 1000000;
+    timeout = millis > 1000000 ? 1000000 : (int)millis;
+  } else if (loop.fd_waiters == 0) {
+    tspp_runtime_fail("every task is suspended and nothing can resume one",
+                      NULL);
+  }
+
+  if (loop.fd_waiters != 0 && loop.backend == BACKEND_URING) {
+    /* Completions that are already in need no system call */
+    if (ring_reap() == 0) {
+      if (loop.timer_count != 0) {
+        ring_arm_timeout(loop.timers[0].deadline);
+      }
+      ring_enter(1);
+      ring_reap();
+    }
+  } else if (loop.fd_waiters != 0) {
+    struct epoll_event events[64];
+    int count = epoll_wait(loop.epoll_fd, events, 64, timeout);
+    if (count < 0 && errno != EINTR) {
+      tspp_runtime_fail("epoll_wait failed", NULL);
+    }
+    for (int i = 0; i < count; ++i) {
+      fd_waiter *registration = events[i].data.ptr;
+      epoll_ctl(loop.epoll_fd, EPOLL_CTL_DEL, registration->fd, NULL);
+      --loop.fd_waiters;
+      wake(registration->waiter);
+      free(registration);
+    }
+  } else if (timeout > 0) {
+    struct timespec wait = {timeout / 1000, (long)(timeout % 1000) * 1000000};
+    nanosleep(&wait, NULL);
+  }
+
+  uint64_t current = now();
+  while (loop.timer_count != 0 && loop.timers[0].deadline <= current) {
+    wake(pop_timer().waiter);
+  }
+}
+
+/* Runs tasks until the handle completes or, without one, the flag is set */
+static void run_until(void *handle, const int *flag) {
+  for (;;) {
+    while (loop.ready_count != 0 && !(handle ? is_done(handle) : *flag)) {
+      void *next = loop.ready[loop.ready_head];
+      loop.ready_head = (loop.ready_head + 1) % loop.ready_capacity;
+      --loop.ready_count;
+      resume(next);
+    }
+    if (handle ? is_done(handle) : *flag) {
+      return;
+    }
+    poll_events();
+  }
+}
+
+int tspp_task_complete(tspp_task *task) {
+  if (task->continuation) {
+    schedule(task->continuation);
+  }
+  return task->detached;
+}
+
+void tspp_task_spawn(void *handle, tspp_task *task) {
+  if (is_done(handle)) {
+    destroy(handle);
+  } else {
+    task->detached = 1;
+  }
+}
+
+void tspp_task_run(void *handle) { run_until(handle, NULL); }
+
+void tspp_async_sleep(void *handle, int32_t millis) {
+  int elapsed = 0;
+  uint64_t delay = millis > 0 ? (uint64_t)millis * 1000000u : 0;
+  add_timer(now() + delay, (waiter){handle, handle ? NULL : &elapsed});
+  if (!handle) {
+    run_until(NULL, &elapsed);
+  }
+}
+
+void tspp_async_wait_fd(void *handle, int32_t fd, int32_t events) {
+  int ready = 0;
+  add_fd_waiter(fd, events, (waiter){handle, handle ? NULL : &ready});
+  if (!handle) {
+    run_until(NULL, &ready);
+  }
+}
@@ -0,0 +1,397 @@
+#define _POSIX_C_SOURCE 200809L
+#include "runtime/tspp_runtime.h"
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Containers shared between threads. Elements are copied in and out by
+ * size, so one implementation serves every element type; the compiler
+ * passes each element's address. Counters that different threads write
+ * live on cache lines of their own.
+ */
+
+#define CACHE_LINE 64
+
+static void *allocate(size_t size) {
+  void *memory = NULL;
+  if (posix_memalign(&memory, CACHE_LINE, size) != 0) {
+    tspp_runtime_fail("out of memory while creating a concurrent container",
+                      NULL);
+  }
+  memset(memory, 0, size);
+  return memory;
+}
+
+static size_t round_up(size_t value, size_t align) {
+  return (value + align - 1) & ~(align - 1);
+}
+
+/* Queues hold at least 2 elements, a power of two so indices wrap by mask */
+static size_t queue_capacity(int64_t capacity) {
+  size_t rounded = 2;
+  while ((int64_t)rounded < capacity) {
+    rounded *= 2;
+  }
+  return rounded;
+}
+
+/* Waits a little longer each time a full or empty queue is retried */
+static void back_off(unsigned *attempts) {
+  if (++*attempts < 64) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+  } else {
+    sched_yield();
+  }
+}
+
+/*
+ * Bounded multi-producer multi-consumer queue, after Dmitry Vyukov's:
+ * each cell carries a sequence number that says whose turn it is, so a
+ * push or pop claims its cell with one compare-and-swap on a position
+ * and never waits for another thread that is between its steps.
+ */
+struct tspp_mpmc {
+  _Alignas(CACHE_LINE) atomic_size_t push_position;
+  _Alignas(CACHE_LINE) atomic_size_t pop_position;
+  _Alignas(CACHE_LINE) size_t mask;
+  size_t element_size;
+  size_t element_offset; /* From the start of a cell */
+  size_t cell_size;
+  char *cells;
+};
+
+static atomic_size_t *cell_sequence(const tspp_mpmc *queue, size_t position) {
+  return (atomic_size_t *)(queue->cells +
+                           (position & queue->mask) * queue->cell_size);
+}
+
+tspp_mpmc *tspp_mpmc_new(int64_t capacity, int64_t element_size,
+                         int64_t align) {
+  size_t cells = queue_capacity(capacity);
+  size_t offset = round_up(sizeof(atomic_size_t), (size_t)align);
+  size_t cell_size = round_up(offset + (size_t)element_size,
+                              offset > (size_t)align ? offset : (size_t)align);
+  tspp_mpmc *queue = allocate(sizeof(tspp_mpmc));
+  queue->mask = cells - 1;
+  queue->element_size = (size_t)element_size;
+  queue->element_offset = offset;
+  queue->cell_size = cell_size;
+  queue->cells = allocate(cells * cell_size);
+  for (size_t i = 0; i < cells; ++i) {
+    atomic_init(cell_sequence(queue, i), i);
+  }
+  return queue;
+}
+
+int32_t tspp_mpmc_try_push(tspp_mpmc *queue, const void *element) {
+  size_t position =
+      atomic_load_explicit(&queue->push_position, memory_order_relaxed);
+  for (;;) {
+    atomic_size_t *sequence = cell_sequence(queue, position);
+    size_t turn = atomic_load_explicit(sequence, memory_order_acquire);
+    intptr_t difference = (intptr_t)turn - (intptr_t)position;
+    if (difference == 0) {
+      if (atomic_compare_exchange_weak_explicit(
+              &queue->push_position, &position, position + 1,
+              memory_order_relaxed, memory_order_relaxed)) {
+        memcpy((char *)sequence + queue->element_offset, element,
+               queue->element_size);
+        atomic_store_explicit(sequence, position + 1, memory_order_release);
+        return 1;
+      }
+    } else if (difference < 0) {
+      return 0; /* The cell still holds the element from a lap ago */
+    } else {
+      position =
+          atomic_load_explicit(&queue->push_position, memory_order_relaxed);
+    }
+  }
+}
+
+int32_t tspp_mpmc_try_pop(tspp_mpmc *queue, void *element) {
+  size_t position =
+      atomic_load_explicit(&queue->pop_position, memory_order_relaxed);
+  for (;;) {
+    atomic_size_t *sequence = cell_sequence(queue, position);
+    size_t turn = atomic_load_explicit(sequence, memory_order_acquire);
+    intptr_t difference = (intptr_t)turn - (intptr_t)(position + 1);
+    if (difference == 0) {
+      if (atomic_compare_exchange_weak_explicit(
+              &queue->pop_position, &position, position + 1,
+              memory_order_relaxed, memory_order_relaxed)) {
+        memcpy(element, (char *)sequence + queue->element_offset,
+               queue->element_size);
+        /* The cell is free for the push one lap ahead */
+        atomic_store_explicit(sequence, position + queue->mask + 1,
+                              memory_order_release);
+        return 1;
+      }
+    } else if (difference < 0) {
+      return 0; /* Nothing has been pushed into the cell yet */
+    } else {
+      position =
+          atomic_load_explicit(&queue->pop_position, memory_order_relaxed);
+    }
+  }
+}
+
+void tspp_mpmc_push(tspp_mpmc *queue, const void *element) {
+  unsigned attempts = 0;
+  while (!tspp_mpmc_try_push(queue, element)) {
+    back_off(&attempts);
+  }
+}
+
+void tspp_mpmc_pop(tspp_mpmc *queue, void *element) {
+  unsigned attempts = 0;
+  while (!tspp_mpmc_try_pop(queue, element)) {
+    back_off(&attempts);
+  }
+}
+
+/*
+ * Bounded single-producer single-consumer queue: a ring whose producer
+ * owns the tail and consumer the head. Each side keeps a stale copy of the
+ * other's index and reloads it only when the ring looks full or empty, so
+ * the indices' cache lines rarely move between the two cores.
+ */
+struct tspp_spsc {
+  _Alignas(CACHE_LINE) atomic_size_t tail; /* Next slot to fill */
+  size_t cached_head;
+  _Alignas(CACHE_LINE) atomic_size_t head; /* Next slot to empty */
+  size_t cached_tail;
+  _Alignas(CACHE_LINE) size_t mask;
+  size_t element_size;
+  size_t stride; /* Between slots */
+  char *slots;
+};
+
+tspp_spsc *tspp_spsc_new(int64_t capacity, int64_t element_size,
+                         int64_t align) {
+  size_t slots = queue_capacity(capacity);
+  tspp_spsc *queue = allocate(sizeof(tspp_spsc));
+  queue->mask = slots - 1;
+  queue->element_size = (size_t)element_size;
+  queue->stride = round_up((size_t)element_size, (size_t)align);
+  queue->slots = allocate(slots * queue->stride);
+  return queue;
+}
+
+static char *spsc_slot(const tspp_spsc *queue, size_t index) {
+  return queue->slots + (index & queue->mask) * queue->stride;
+}
+
+int32_t tspp_spsc_try_push(tspp_spsc *queue, const void *element) {
+  size_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+  if (tail - queue->cached_head > queue->mask) {
+    queue->cached_head =
+        atomic_load_explicit(&queue->head, memory_order_acquire);
+    if (tail - queue->cached_head > queue->mask) {
+      return 0;
+    }
+  }
+  memcpy(spsc_slot(queue, tail), element, queue->element_size);
+  atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+  return 1;
+}
+
+int32_t tspp_spsc_try_pop(tspp_spsc *queue, void *element) {
+  size_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+  if (head == queue->cached_tail) {
+    queue->cached_tail =
+        atomic_load_explicit(&queue->tail, memory_order_acquire);
+    if (head == queue->cached_tail) {
+      return 0;
+    }
+  }
+  memcpy(element, spsc_slot(queue, head), queue->element_size);
+  atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+  return 1;
+}
+
+void tspp_spsc_push(tspp_spsc *queue, const void *element) {
+  unsigned attempts = 0;
+  while (!tspp_spsc_try_push(queue, element)) {
+    back_off(&attempts);
+  }
+}
+
+void tspp_spsc_pop(tspp_spsc *queue, void *element) {
+  unsigned attempts = 0;
+  while (!tspp_spsc_try_pop(queue, element)) {
+    back_off(&attempts);
+  }
+}
+
+/*
+ * Hash map from 64-bit keys, split into shards by the top bits of the
+ * key's hash. Each shard is an open-addressed table behind a lock of its
+ * own, so threads that touch different shards never contend, and a shard
+ * grows without stopping the others.
+ */
+#define MAP_SHARD_BITS 6
+#define MAP_SHARDS (1 << MAP_SHARD_BITS)
+
+enum { SLOT_EMPTY, SLOT_FULL, SLOT_REMOVED };
+
+typedef struct map_shard {
+  _Alignas(CACHE_LINE) atomic_flag lock;
+  size_t capacity; /* A power of two, or 0 before the first put */
+  size_t used;     /* Full and removed slots, which both end probes */
+  atomic_size_t count;
+  int64_t *keys;
+  unsigned char *states;
+  char *values;
+} map_shard;
+
+struct tspp_map {
+  size_t value_size;
+  size_t stride; /* Between values */
+  map_shard shards[MAP_SHARDS];
+};
+
+/* The finalizer of splitmix64, which spreads nearby keys over all bits */
+static uint64_t hash_key(int64_t key) {
+  uint64_t hash = (uint64_t)key;
+  hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9u;
+  hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebu;
+  return hash ^ (hash >> 31);
+}
+
+static map_shard *lock_shard(tspp_map *map, uint64_t hash) {
+  map_shard *shard = &map->shards[hash >> (64 - MAP_SHARD_BITS)];
+  unsigned attempts = 0;
+  while (atomic_flag_test_and_set_explicit(&shard->lock,
+                                           memory_order_acquire)) {
+    back_off(&attempts);
+  }
+  return shard;
+}
+
+static void unlock_shard(map_shard *shard) {
+  atomic_flag_clear_explicit(&shard->lock, memory_order_release);
+}
+
+/* The key's slot, or the empty slot that ends its probe */
+static size_t find_slot(const map_shard *shard, uint64_t hash, int64_t key) {
+  size_t mask = shard->capacity - 1;
+  size_t slot = hash & mask;
+  while (shard->states[slot] != SLOT_EMPTY &&
+         !(shard->states[slot] == SLOT_FULL && shard->keys[slot] == key)) {
+    slot = (slot + 1) & mask;
+  }
+  return slot;
+}
+
+/* Rebuilds the table with room for twice its entries, dropping removals */
+static void grow_shard(tspp_map *map, map_shard *shard) {
+  size_t old_capacity = shard->capacity;
+  int64_t *old_keys = shard->keys;
+  unsigned char *old_states = shard->states;
+  char *old_values = shard->values;
+
+  size_t count = atomic_load_explicit(&shard->count, memory_order_relaxed);
+  size_t capacity = 8;
+  while (capacity < count * 4) {
+    capacity *= 2;
+  }
+  shard->capacity = capacity;
+  shard->used = count;
+  shard->keys = allocate(capacity * sizeof(int64_t));
+  shard->states = allocate(capacity);
+  shard->values = allocate(capacity * map->stride);
+  for (size_t i = 0; i < old_capacity; ++i) {
+    if (old_states[i] == SLOT_FULL) {
+      size_t slot = find_slot(shard, hash_key(old_keys[i]), old_keys[i]);
+      shard->keys[slot] = old_keys[i];
+      shard->states[slot] = SLOT_FULL;
+      memcpy(shard->values + slot * map->stride,
+             old_values + i * map->stride, map->value_size);
+    }
+  }
+  free(old_keys);
+  free(old_states);
+  free(old_values);
+}
+
+tspp_map *tspp_map_new(int64_t value_size, int64_t align) {
+  tspp_map *map = allocate(sizeof(tspp_map));
+  map->value_size = (size_t)value_size;
+  map->stride = round_up((size_t)value_size, (size_t)align);
+  for (size_t i = 0; i < MAP_SHARDS; ++i) {
+    atomic_flag_clear(&map->shards[i].lock);
+  }
+  return map;
+}
+
+void tspp_map_put(tspp_map *map, int64_t key, const void *value) {
+  uint64_t hash = hash_key(key);
+  map_shard *shard = lock_shard(map, hash);
+  /* At most 3/4 full, counting removals, so probes stay short */
+  if ((shard->used + 1) * 4 > shard->capacity * 3) {
+    grow_shard(map, shard);
+  }
+  size_t slot = find_slot(shard, hash, key);
+  if (shard->states[slot] != SLOT_FULL) {
+    shard->keys[slot] = key;
+    shard->states[slot] = SLOT_FULL;
+    ++shard->used;
+    atomic_store_explicit(
+        &shard->count,
+        atomic_load_explicit(&shard->count, memory_order_relaxed) + 1,
+        memory_order_relaxed);
+  }
+  memcpy(shard->values + slot * map->stride, value, map->value_size);
+  unlock_shard(shard);
+}
+
+int32_t tspp_map_get(tspp_map *map, int64_t key, void *value) {
+  uint64_t hash = hash_key(key);
+  map_shard *shard = lock_shard(map, hash);
+  int32_t found = 0;
+  if (shard->capacity != 0) {
+    size_t slot = find_slot(shard, hash, key);
+    if (shard->states[slot] == SLOT_FULL) {
+      found = 1;
+      if (value) {
+        memcpy(value, shard->values + slot * map->stride, map->value_size);
+      }
+    }
+  }
+  unlock_shard(shard);
+  return found;
+}
+
+int32_t tspp_map_remove(tspp_map *map, int64_t key) {
+  uint64_t hash = hash_key(key);
+  map_shard *shard = lock_shard(map, hash);
+  int32_t found = 0;
+  if (shard->capacity != 0) {
+    size_t slot = find_slot(shard, hash, key);
+    if (shard->states[slot] == SLOT_FULL) {
+      /* Later keys of the probe still go past the slot */
+      shard->states[slot] = SLOT_REMOVED;
+      atomic_store_explicit(
+          &shard->count,
+          atomic_load_explicit(&shard->count, memory_order_relaxed) - 1,
+          memory_order_relaxed);
+      found = 1;
+    }
+  }
+  unlock_shard(shard);
+  return found;
+}
+
+int64_t tspp_map_size(tspp_map *map) {
+  size_t total = 0;
+  for (size_t i = 0; i < MAP_SHARDS; ++i) {
+    total += atomic_load_explicit(&map->shards[i].count, memory_order_relaxed);
+  }
+  return (int64_t)total;
+}
@@ -0,0 +1,83 @@
+#define _POSIX_C_SOURCE 200809L
+#include "runtime/tspp_runtime.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Counters of -instrument= modules. Counting happens in generated code;
+ * the runtime only collects each thread's counts and writes the totals.
+ */
+
+static _Atomic(tspp_counters *) tables;
+static pthread_once_t write_once = PTHREAD_ONCE_INIT;
+
+typedef struct site_count {
+  uint64_t count;
+  const char *site;
+} site_count;
+
+/* Most frequent first; ties in site order, so the output is stable */
+static int by_count(const void *left, const void *right) {
+  const site_count *a = left;
+  const site_count *b = right;
+  if (a->count != b->count) {
+    return a->count < b->count ? 1 : -1;
+  }
+  return strcmp(a->site, b->site);
+}
+
+void tspp_counters_write(void) {
+  tspp_counters_flush();
+  tspp_counters *head = atomic_exchange(&tables, NULL);
+
+  size_t total = 0;
+  for (tspp_counters *table = head; table; table = table->next) {
+    total += (size_t)table->count;
+  }
+  site_count *counts = total ? malloc(sizeof(site_count) * total) : NULL;
+  if (!counts) {
+    return;
+  }
+  size_t used = 0;
+  for (tspp_counters *table = head; table; table = table->next) {
+    for (int64_t i = 0; i < table->count; ++i) {
+      uint64_t count =
+          atomic_load_explicit((_Atomic uint64_t *)&table->totals[i],
+                               memory_order_relaxed);
+      if (count != 0) {
+        counts[used++] = (site_count){count, table->sites[i]};
+      }
+    }
+  }
+  qsort(counts, used, sizeof(site_count), by_count);
+
+  const char *path = getenv("TSPP_COUNTERS_FILE");
+  FILE *file = fopen(path && *path ? path : "tspp.counters", "w");
+  if (file) {
+    for (size_t i = 0; i < used; ++i) {
+      fprintf(file, "%llu\t%s\n", (unsigned long long)counts[i].count,
+              counts[i].site);
+    }
+    fclose(file);
+  }
+  free(counts);
+}
+
+static void register_write(void) { atexit(tspp_counters_write); }
+
+void tspp_counters_register(tspp_counters *counters) {
+  pthread_once(&write_once, register_write);
+  counters->next = atomic_load(&tables);
+  while (!atomic_compare_exchange_weak(&tables, &counters->next, counters)) {
+  }
+}
+
+void tspp_counters_flush(void) {
+  for (tspp_counters *table = atomic_load(&tables); table;
+       table = table->next) {
+    table->flush();
+  }
+}
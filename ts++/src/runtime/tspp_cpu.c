@@ -0,0 +1,81 @@
+#include "runtime/tspp_runtime.h"
+#include <string.h>
+#if defined(__aarch64__) && defined(__linux__)
+#include <sys/auxv.h>
+#endif
+
+/*
+ * Feature names are LLVM's, as #target spells them. A name this file does
+ * not know counts as unsupported, so a version that needs it is never
+ * picked over the default.
+ */
+
+static int has_name(const char *name, size_t length, const char *known) {
+  return strlen(known) == length && memcmp(name, known, length) == 0;
+}
+
+static int supports(const char *name, size_t length) {
+#if defined(__x86_64__) || defined(__i386__)
+  /* The builtin checks that the OS saves the wider registers as well */
+#define FEATURE(known)                                                         \
+  if (has_name(name, length, known)) {                                         \
+    return __builtin_cpu_supports(known);                                      \
+  }
+  FEATURE("sse3")
+  FEATURE("ssse3")
+  FEATURE("sse4.1")
+  FEATURE("sse4.2")
+  FEATURE("popcnt")
+  FEATURE("avx")
+  FEATURE("avx2")
+  FEATURE("fma")
+  FEATURE("bmi")
+  FEATURE("bmi2")
+  FEATURE("avx512f")
+  FEATURE("avx512cd")
+  FEATURE("avx512dq")
+  FEATURE("avx512bw")
+  FEATURE("avx512vl")
+#undef FEATURE
+#elif defined(__aarch64__) && defined(__linux__)
+  unsigned long hwcap = getauxval(AT_HWCAP);
+  if (has_name(name, length, "neon")) {
+    return (hwcap & HWCAP_ASIMD) != 0;
+  }
+  if (has_name(name, length, "aes")) {
+    return (hwcap & HWCAP_AES) != 0;
+  }
+  if (has_name(name, length, "crc")) {
+    return (hwcap & HWCAP_CRC32) != 0;
+  }
+  if (has_name(name, length, "lse")) {
+    return (hwcap & HWCAP_ATOMICS) != 0;
+  }
+#ifdef HWCAP_SVE
+  if (has_name(name, length, "sve")) {
+    return (hwcap & HWCAP_SVE) != 0;
+  }
+#endif
+#else
+  (void)name;
+  (void)length;
+  (void)has_name;
+#endif
+  return 0;
+}
+
+int tspp_cpu_supports(const char *features) {
+#if defined(__x86_64__) || defined(__i386__)
+  /* Resolvers may run before the constructor that fills in the model */
+  __builtin_cpu_init();
+#endif
+  while (*features) {
+    const char *end = strchr(features, ',');
+    size_t length = end ? (size_t)(end - features) : strlen(features);
+    if (!supports(features, length)) {
+      return 0;
+    }
+    features += end ? length + 1 : length;
+  }
+  return 1;
+}
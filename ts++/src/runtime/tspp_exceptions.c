@@ -0,0 +1,314 @@
+#include "runtime/tspp_runtime.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unwind.h>
+
+/*
+ * Exceptions follow the Itanium C++ ABI: tspp_throw hands an
+ * _Unwind_Exception to the system unwinder, which calls tspp_personality
+ * for each frame, first to find a handler and then to run the landing pads
+ * between the throw and that handler. Nothing is registered on entry to a
+ * try block, so code that does not throw pays nothing.
+ */
+
+/* "TSPP\0\0\0\0"; exceptions of other languages carry their own class */
+#define TSPP_EXCEPTION_CLASS ((uint64_t)0x5453505000000000ull)
+
+typedef struct tspp_exception {
+  const tspp_type_info *type;
+  size_t size;
+  struct _Unwind_Exception header; /* What landing pads receive */
+  _Alignas(16) unsigned char value[]; /* Copy of the thrown value */
+} tspp_exception;
+
+static tspp_exception *from_header(struct _Unwind_Exception *header) {
+  return (tspp_exception *)((char *)header - offsetof(tspp_exception, header));
+}
+
+static void release_exception(_Unwind_Reason_Code reason,
+                              struct _Unwind_Exception *header) {
+  (void)reason;
+  free(from_header(header));
+}
+
+void tspp_throw(const tspp_type_info *type, const void *value,
+                uint64_t size) {
+  tspp_exception *exception = malloc(sizeof(tspp_exception) + size);
+  if (!exception) {
+    fputs("tspp: out of memory while throwing an exception\n", stderr);
+    abort();
+  }
+  memset(&exception->header, 0, sizeof(exception->header));
+  exception->type = type;
+  exception->size = size;
+  exception->header.exception_class = TSPP_EXCEPTION_CLASS;
+  exception->header.exception_cleanup = release_exception;
+  if (size != 0) {
+    memcpy(exception->value, value, size);
+  }
+
+  /* Only returns when no frame has a handler for the exception */
+  _Unwind_RaiseException(&exception->header);
+  tspp_flush();
+  fprintf(stderr, "tspp: uncaught exception of type %s\n",
+          type && type->name ? type->name : "unknown");
+  abort();
+}
+
+void tspp_catch(void *exception, void *value, uint64_t size) {
+  tspp_exception *caught = from_header(exception);
+  if (size > caught->size) {
+    memset(value, 0, size);
+    size = caught->size;
+  }
+  if (size != 0) {
+    memcpy(value, caught->value, size);
+  }
+  free(caught);
+}
+
+/* A handler for a class also catches classes derived from it. Typeinfos
+   are merged by the linker, but names are compared as well in case a
+   JIT session ends up with more than one copy. */
+static int catches(const tspp_type_info *handler, const tspp_type_info *type) {
+  for (; type; type = type->base) {
+    if (type == handler ||
+        (type->name && handler->name && strcmp(type->name, handler->name) == 0)) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/* DWARF pointer encodings used in the LSDA */
+enum {
+  DW_EH_PE_absptr = 0x00,
+  DW_EH_PE_uleb128 = 0x01,
+  DW_EH_PE_udata2 = 0x02,
+  DW_EH_PE_udata4 = 0x03,
+  DW_EH_PE_udata8 = 0x04,
+  DW_EH_PE_sleb128 = 0x09,
+  DW_EH_PE_sdata2 = 0x0a,
+  DW_EH_PE_sdata4 = 0x0b,
+  DW_EH_PE_sdata8 = 0x0c,
+  DW_EH_PE_pcrel = 0x10,
+  DW_EH_PE_indirect = 0x80,
+  DW_EH_PE_omit = 0xff,
+};
+
+static uintptr_t read_uleb128(const uint8_t **data) {
+  uintptr_t result = 0;
+  unsigned shift = 0;
+  uint8_t byte;
+  do {
+    byte = *(*data)++;
+    result |= (uintptr_t)(byte & 0x7f) << shift;
+    shift += 7;
+  } while (byte & 0x80);
+  return result;
+}
+
+static intptr_t read_sleb128(const uint8_t **data) {
+  uintptr_t result = 0;
+  unsigned shift = 0;
+  uint8_t byte;
+  do {
+    byte = *(*data)++;
+    result |= (uintptr_t)(byte & 0x7f) << shift;
+    shift += 7;
+  } while (byte & 0x80);
+  if ((byte & 0x40) && shift < sizeof(result) * 8) {
+    result |= ~(uintptr_t)0 << shift;
+  }
+  return (intptr_t)result;
+}
+
+static uintptr_t read_encoded(const uint8_t **data, uint8_t encoding) {
+  if (encoding == DW_EH_PE_omit) {
+    return 0;
+  }
+  const uint8_t *start = *data;
+  uintptr_t result;
+  switch (encoding & 0x0f) {
+  case DW_EH_PE_absptr:
+    memcpy(&result, *data, sizeof(result));
+    *data += sizeof(result);
+    break;
+  case DW_EH_PE_uleb128:
+    result = read_uleb128(data);
+    break;
+  case DW_EH_PE_sleb128:
+    result = (uintptr_t)read_sleb128(data);
+    break;
+  case DW_EH_PE_udata2: {
+    uint16_t value;
+    memcpy(&value, *data, sizeof(value));
+    *data += sizeof(value);
+    result = value;
+    break;
+  }
+  case DW_EH_PE_sdata2: {
+    int16_t value;
+    memcpy(&value, *data, sizeof(value));
+    *data += sizeof(value);
+    result = (uintptr_t)(intptr_t)value;
+    break;
+  }
+  case DW_EH_PE_udata4: {
+    uint32_t value;
+    memcpy(&value, *data, sizeof(value));
+    *data += sizeof(value);
+    result = value;
+    break;
+  }
+  case DW_EH_PE_sdata4: {
+    int32_t value;
+    memcpy(&value, *data, sizeof(value));
+    *data += sizeof(value);
+    result = (uintptr_t)(intptr_t)value;
+    break;
+  }
+  case DW_EH_PE_udata8:
+  case DW_EH_PE_sdata8: {
+    uint64_t value;
+    memcpy(&value, *data, sizeof(value));
+    *data += sizeof(value);
+    result = (uintptr_t)value;
+    break;
+  }
+  default:
+    abort();
+  }
+
+  /* Text, data and function relative forms are not emitted on ELF */
+  if (result != 0) {
+    if ((encoding & 0x70) == DW_EH_PE_pcrel) {
+      result += (uintptr_t)start;
+    }
+    if (encoding & DW_EH_PE_indirect) {
+      result = *(const uintptr_t *)result;
+    }
+  }
+  return result;
+}
+
+static size_t encoded_size(uint8_t encoding) {
+  switch (encoding & 0x0f) {
+  case DW_EH_PE_absptr:
+    return sizeof(uintptr_t);
+  case DW_EH_PE_udata2:
+  case DW_EH_PE_sdata2:
+    return 2;
+  case DW_EH_PE_udata4:
+  case DW_EH_PE_sdata4:
+    return 4;
+  case DW_EH_PE_udata8:
+  case DW_EH_PE_sdata8:
+    return 8;
+  default:
+    abort();
+  }
+}
+
+int tspp_personality(int version, int actions, uint64_t exception_class,
+                     void *exception, void *context) {
+  struct _Unwind_Context *frame = context;
+  if (version != 1) {
+    return _URC_FATAL_PHASE1_ERROR;
+  }
+  const uint8_t *lsda = _Unwind_GetLanguageSpecificData(frame);
+  if (!lsda) {
+    return _URC_CONTINUE_UNWIND;
+  }
+
+  /* Header: landing pad base, type table and call-site table encodings */
+  uintptr_t function_start = _Unwind_GetRegionStart(frame);
+  uint8_t lp_start_encoding = *lsda++;
+  uintptr_t lp_start = lp_start_encoding == DW_EH_PE_omit
+                           ? function_start
+                           : read_encoded(&lsda, lp_start_encoding);
+  uint8_t type_encoding = *lsda++;
+  const uint8_t *type_table = NULL;
+  if (type_encoding != DW_EH_PE_omit) {
+    uintptr_t offset = read_uleb128(&lsda);
+    type_table = lsda + offset;
+  }
+  uint8_t site_encoding = *lsda++;
+  uintptr_t site_table_length = read_uleb128(&lsda);
+  const uint8_t *site = lsda;
+  const uint8_t *action_table = lsda + site_table_length;
+
+  /* The return address may be the first byte after the call */
+  int before_instruction = 0;
+  uintptr_t ip = _Unwind_GetIPInfo(frame, &before_instruction);
+  if (!before_instruction) {
+    --ip;
+  }
+  uintptr_t offset = ip - function_start;
+
+  /* Call sites are sorted by start; one without a landing pad unwinds */
+  uintptr_t landing_pad = 0;
+  uintptr_t action = 0;
+  while (site < action_table) {
+    uintptr_t start = read_encoded(&site, site_encoding);
+    uintptr_t length = read_encoded(&site, site_encoding);
+    uintptr_t pad = read_encoded(&site, site_encoding);
+    uintptr_t record = read_uleb128(&site);
+    if (offset < start) {
+      break;
+    }
+    if (offset < start + length) {
+      landing_pad = pad;
+      action = record;
+      break;
+    }
+  }
+  if (landing_pad == 0) {
+    return _URC_CONTINUE_UNWIND;
+  }
+
+  /* Walk the action chain: a positive filter names a catch clause's type,
+     zero a cleanup */
+  int own = exception_class == TSPP_EXCEPTION_CLASS;
+  const tspp_type_info *type = own ? from_header(exception)->type : NULL;
+  intptr_t selector = 0;
+  int cleanup = action == 0;
+  if (action != 0) {
+    const uint8_t *record = action_table + action - 1;
+    for (;;) {
+      intptr_t filter = read_sleb128(&record);
+      const uint8_t *next = record;
+      intptr_t displacement = read_sleb128(&record);
+      if (filter > 0 && type_table) {
+        const uint8_t *entry =
+            type_table - (uintptr_t)filter * encoded_size(type_encoding);
+        const tspp_type_info *handler =
+            (const tspp_type_info *)read_encoded(&entry, type_encoding);
+        if (own && (!handler || catches(handler, type))) {
+          selector = filter;
+          break;
+        }
+      } else if (filter == 0) {
+        cleanup = 1;
+      }
+      if (displacement == 0) {
+        break;
+      }
+      record = next + displacement;
+    }
+  }
+
+  if (actions & _UA_SEARCH_PHASE) {
+    return selector != 0 ? _URC_HANDLER_FOUND : _URC_CONTINUE_UNWIND;
+  }
+  if (selector == 0 && !cleanup) {
+    return _URC_CONTINUE_UNWIND;
+  }
+  _Unwind_SetGR(frame, __builtin_eh_return_data_regno(0),
+                (uintptr_t)exception);
+  _Unwind_SetGR(frame, __builtin_eh_return_data_regno(1),
+                (uintptr_t)selector);
+  _Unwind_SetIP(frame, lp_start + landing_pad);
+  return _URC_INSTALL_CONTEXT;
+}
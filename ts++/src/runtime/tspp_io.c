@@ -0,0 +1,192 @@
+#define _POSIX_C_SOURCE 200809L
+#include "runtime/tspp_runtime.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef __wasm__
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define TSPP_OUTPUT_SIZE ((size_t)64 * 1024)
+
+/* Per-thread output; registered with the key on its first write. Not
+   static, so writes inlined from the runtime bitcode fill the same buffer */
+typedef struct tspp_output {
+  size_t used;
+  int registered;
+  char data[TSPP_OUTPUT_SIZE];
+} tspp_output;
+
+_Thread_local tspp_output tspp_thread_output;
+
+#ifdef __wasm__
+/* The embedder writes output; a wasm module has no file descriptors */
+__attribute__((import_module("env"), import_name("tspp_host_write"))) void
+tspp_host_write(const char *data, uint32_t size);
+
+static void write_all(const char *data, size_t size) {
+  tspp_host_write(data, (uint32_t)size);
+}
+#else
+pthread_once_t tspp_output_once = PTHREAD_ONCE_INIT;
+pthread_key_t tspp_output_key;
+
+/* Writes all of data to stdout, retrying interrupted and partial writes */
+static void write_all(const char *data, size_t size) {
+  while (size != 0) {
+    ssize_t written = write(STDOUT_FILENO, data, size);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return; /* Nothing to report to once stdout is gone */
+    }
+    data += written;
+    size -= (size_t)written;
+  }
+}
+#endif
+
+static void flush_output(tspp_output *buffer) {
+#ifndef __wasm__
+  fflush(stdout);
+#endif
+  write_all(buffer->data, buffer->used);
+  buffer->used = 0;
+}
+
+#ifdef __wasm__
+/* A module is single-threaded; the embedder calls tspp_flush at the end */
+static tspp_output *current_output(void) {
+  tspp_thread_output.registered = 1;
+  return &tspp_thread_output;
+}
+#else
+/* Runs as a thread exits, while its thread-locals are still alive */
+static void flush_thread(void *buffer) { flush_output(buffer); }
+
+/* exit() flushes the thread that calls it; others flush as they end */
+static void flush_at_exit(void) { flush_output(&tspp_thread_output); }
+
+static void init_output(void) {
+  pthread_key_create(&tspp_output_key, flush_thread);
+  atexit(flush_at_exit);
+}
+
+static tspp_output *current_output(void) {
+  if (!tspp_thread_output.registered) {
+    pthread_once(&tspp_output_once, init_output);
+    pthread_setspecific(tspp_output_key, &tspp_thread_output);
+    tspp_thread_output.registered = 1;
+  }
+  return &tspp_thread_output;
+}
+#endif
+
+void tspp_write(const char *data, uint64_t size) {
+  tspp_output *buffer = current_output();
+  if (size > TSPP_OUTPUT_SIZE - buffer->used) {
+    flush_output(buffer);
+    if (size >= TSPP_OUTPUT_SIZE) {
+      write_all(data, size);
+      return;
+    }
+  }
+  memcpy(buffer->data + buffer->used, data, size);
+  buffer->used += size;
+}
+
+void tspp_write_int(int64_t value) {
+  char digits[20];
+  size_t start = sizeof(digits);
+  /* Negated as unsigned so INT64_MIN does not overflow */
+  uint64_t magnitude = value < 0 ? 0 - (uint64_t)value : (uint64_t)value;
+  do {
+    digits[--start] = (char)('0' + magnitude % 10);
+    magnitude /= 10;
+  } while (magnitude != 0);
+  if (value < 0) {
+    tspp_write("-", 1);
+  }
+  tspp_write(digits + start, sizeof(digits) - start);
+}
+
+void tspp_write_float(double value) {
+  if (isnan(value)) {
+    tspp_write("nan", 3);
+    return;
+  }
+  if (isinf(value)) {
+    tspp_write(value < 0 ? "-inf" : "inf", value < 0 ? 4 : 3);
+    return;
+  }
+
+  /*
+   * Every precision from the shortest one that round-trips up reads back
+   * as the same value, so that one can be found by bisection; 17 digits
+   * always do.
+   */
+  char text[32];
+  int low = 1;
+  int high = 17;
+  while (low < high) {
+    int precision = (low + high) / 2;
+    int length = snprintf(text, sizeof(text), "%.*g", precision, value);
+    if (length > 0 && strtod(text, NULL) == value) {
+      high = precision;
+    } else {
+      low = precision + 1;
+    }
+  }
+  int length = snprintf(text, sizeof(text), "%.*g", low, value);
+  tspp_write(text, (size_t)length);
+}
+
+void tspp_flush(void) {
+  if (tspp_thread_output.registered) {
+    flush_output(&tspp_thread_output);
+  }
+}
+
+void tspp_map_file(tspp_bytes *result, const tspp_string *path) {
+  result->data = NULL;
+  result->length = 0;
+#ifdef __wasm__
+  (void)path; /* No file system; reads as an empty file */
+#else
+  int fd = open(tspp_string_data(path), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return;
+  }
+  struct stat status;
+  if (fstat(fd, &status) == 0 && S_ISREG(status.st_mode) &&
+      status.st_size > 0) {
+    /* The mapping keeps the file open on its own */
+    void *data = mmap(NULL, (size_t)status.st_size, PROT_READ, MAP_PRIVATE,
+                      fd, 0);
+    if (data != MAP_FAILED) {
+      posix_madvise(data, (size_t)status.st_size, POSIX_MADV_SEQUENTIAL);
+      result->data = data;
+      result->length = status.st_size;
+    }
+  }
+  close(fd);
+#endif
+}
+
+void tspp_unmap_file(const uint8_t *data, int64_t length) {
+#ifndef __wasm__
+  if (data) {
+    munmap((void *)data, (size_t)length);
+  }
+#else
+  (void)data;
+  (void)length;
+#endif
+}
@@ -0,0 +1,481 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE /* CPU affinity */
+#elif !defined(__linux__)
+#define _POSIX_C_SOURCE 200809L
+#endif
+#include "runtime/tspp_runtime.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*
+ * One worker per core, each owning a Chase-Lev deque of index ranges.
+ * A worker splits its range in halves, pushing the upper half and keeping
+ * the lower, until the range is one chunk; idle workers steal the oldest,
+ * largest range from a random victim and split it in turn. Deques follow
+ * Lê, Pop, Cohen and Zappa Nardelli, "Correct and Efficient Work-Stealing
+ * for Weak Memory Models" (PPoPP 2013), with a fixed capacity: a range
+ * that does not fit runs unsplit.
+ *
+ * On Linux, pool threads are pinned to the CPUs the process may use, taken
+ * node by node as sysfs lists them, and thieves try the workers of their
+ * own NUMA node before crossing to another. A loop starts by posting each
+ * worker a contiguous home block of its iterations, so that loops of the
+ * same length run the same iterations on the same worker: the pages a
+ * loop initializes are first touched on the node that later loops process
+ * them on. Workers of a machine with several nodes also place their
+ * allocator slabs on their own node.
+ */
+
+#define TSPP_DEQUE_CAPACITY 1024
+#define TSPP_MAX_WORKERS 256
+#define TSPP_MAX_NODES 64
+#define TSPP_CHUNKS_PER_WORKER 8
+
+/* A loop in progress, on the stack of the thread that started it */
+typedef struct parallel_loop {
+  tspp_parallel_body body;
+  void *env;
+  int32_t grain;            /* Iterations a range stops splitting at */
+  atomic_int_fast32_t left; /* Iterations not yet finished */
+} parallel_loop;
+
+typedef struct range_task {
+  parallel_loop *loop;
+  int32_t begin;
+  int32_t end;
+} range_task;
+
+typedef struct worker {
+  _Alignas(64) atomic_int_fast64_t top; /* Thieves take from here */
+  _Alignas(64) atomic_int_fast64_t bottom; /* The owner pushes and pops here */
+  _Atomic(range_task *) slots[TSPP_DEQUE_CAPACITY];
+  _Alignas(64) _Atomic(range_task *) mailbox; /* A posted home block */
+  atomic_int node; /* NUMA node; worker 0's is that of its current thread */
+  unsigned seed;   /* Picks steal victims */
+} worker;
+
+static struct {
+  worker *workers; /* workers[0] belongs to threads outside the pool */
+  int count;
+  int node_count; /* NUMA nodes the workers are spread over */
+  pthread_mutex_t external; /* Held by the outside thread using workers[0] */
+  pthread_mutex_t lock;     /* Guards sleeping */
+  pthread_cond_t wake;
+  atomic_int sleepers;
+  atomic_long queued; /* Ranges pushed and not yet taken */
+} pool = {.external = PTHREAD_MUTEX_INITIALIZER,
+          .lock = PTHREAD_MUTEX_INITIALIZER,
+          .wake = PTHREAD_COND_INITIALIZER};
+
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+
+/* The worker the calling thread is, or NULL outside the pool */
+static _Thread_local worker *self;
+
+/* The CPUs the process may run on, grouped by NUMA node */
+static struct {
+  int cpus[TSPP_MAX_WORKERS];
+  int nodes[TSPP_MAX_WORKERS]; /* The node of each of cpus */
+  int count;                   /* 0 where affinity is not known */
+  int node_count;
+#ifdef __linux__
+  short cpu_nodes[CPU_SETSIZE];
+#endif
+} topology;
+
+static int push(worker *owner, range_task *task) {
+  int_fast64_t bottom =
+      atomic_load_explicit(&owner->bottom, memory_order_relaxed);
+  int_fast64_t top = atomic_load_explicit(&owner->top, memory_order_acquire);
+  if (bottom - top >= TSPP_DEQUE_CAPACITY) {
+    return 0;
+  }
+  atomic_store_explicit(&owner->slots[bottom % TSPP_DEQUE_CAPACITY], task,
+                        memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  atomic_store_explicit(&owner->bottom, bottom + 1, memory_order_relaxed);
+  return 1;
+}
+
+static range_task *pop(worker *owner) {
+  int_fast64_t bottom =
+      atomic_load_explicit(&owner->bottom, memory_order_relaxed) - 1;
+  atomic_store_explicit(&owner->bottom, bottom, memory_order_relaxed);
+  atomic_thread_fence(memory_order_seq_cst);
+  int_fast64_t top = atomic_load_explicit(&owner->top, memory_order_relaxed);
+  if (top > bottom) {
+    atomic_store_explicit(&owner->bottom, bottom + 1, memory_order_relaxed);
+    return NULL;
+  }
+  range_task *task = atomic_load_explicit(
+      &owner->slots[bottom % TSPP_DEQUE_CAPACITY], memory_order_relaxed);
+  if (top == bottom) {
+    /* The last range; a thief may be taking it too */
+    if (!atomic_compare_exchange_strong_explicit(&owner->top, &top, top + 1,
+                                                 memory_order_seq_cst,
+                                                 memory_order_relaxed)) {
+      task = NULL;
+    }
+    atomic_store_explicit(&owner->bottom, bottom + 1, memory_order_relaxed);
+  }
+  return task;
+}
+
+static range_task *steal(worker *victim) {
+  int_fast64_t top = atomic_load_explicit(&victim->top, memory_order_acquire);
+  atomic_thread_fence(memory_order_seq_cst);
+  int_fast64_t bottom =
+      atomic_load_explicit(&victim->bottom, memory_order_acquire);
+  if (top >= bottom) {
+    return NULL;
+  }
+  range_task *task = atomic_load_explicit(
+      &victim->slots[top % TSPP_DEQUE_CAPACITY], memory_order_relaxed);
+  if (!atomic_compare_exchange_strong_explicit(&victim->top, &top, top + 1,
+                                               memory_order_seq_cst,
+                                               memory_order_relaxed)) {
+    return NULL; /* Lost the range to its owner or another thief */
+  }
+  return task;
+}
+
+/* Takes the home block posted to a worker; anyone may */
+static range_task *take_mail(worker *owner) {
+  if (!atomic_load_explicit(&owner->mailbox, memory_order_relaxed)) {
+    return NULL;
+  }
+  return atomic_exchange_explicit(&owner->mailbox, NULL,
+                                  memory_order_acquire);
+}
+
+/* Steals from the deques of the thief's node, then of the other nodes.
+   Home blocks are taken from other workers only when no deque has work,
+   so that they stay with their worker unless it is busy. */
+static range_task *steal_any(worker *me) {
+  /* xorshift; each worker's own sequence, so no shared state */
+  me->seed ^= me->seed << 13;
+  me->seed ^= me->seed >> 17;
+  me->seed ^= me->seed << 5;
+  int first = (int)(me->seed % (unsigned)pool.count);
+  int node = atomic_load_explicit(&me->node, memory_order_relaxed);
+  for (int pass = 0; pass < 4; ++pass) {
+    int local = pass % 2 == 0;
+    if (!local && pool.node_count == 1) {
+      continue;
+    }
+    for (int i = 0; i < pool.count; ++i) {
+      worker *victim = &pool.workers[(first + i) % pool.count];
+      if (victim == me ||
+          (pool.node_count > 1 &&
+           (atomic_load_explicit(&victim->node, memory_order_relaxed) ==
+            node) != local)) {
+        continue;
+      }
+      range_task *task = pass < 2 ? steal(victim) : take_mail(victim);
+      if (task) {
+        return task;
+      }
+    }
+  }
+  return NULL;
+}
+
+static range_task *find_work(worker *me) {
+  range_task *task = pop(me);
+  if (!task) {
+    task = take_mail(me);
+  }
+  if (!task) {
+    task = steal_any(me);
+  }
+  if (task) {
+    atomic_fetch_sub(&pool.queued, 1);
+  }
+  return task;
+}
+
+static void run_range(worker *me, parallel_loop *loop, int32_t begin,
+                      int32_t end) {
+  while (end - begin > loop->grain) {
+    int32_t middle = begin + (end - begin) / 2;
+    range_task *task = tspp_alloc(sizeof(range_task), _Alignof(range_task));
+    if (!task) {
+      tspp_runtime_fail("out of memory while splitting a parallel loop", NULL);
+    }
+    *task = (range_task){loop, middle, end};
+    if (!push(me, task)) {
+      tspp_free(task);
+      break;
+    }
+    atomic_fetch_add(&pool.queued, 1);
+    if (atomic_load(&pool.sleepers) != 0) {
+      pthread_mutex_lock(&pool.lock);
+      pthread_cond_signal(&pool.wake);
+      pthread_mutex_unlock(&pool.lock);
+    }
+    end = middle;
+  }
+  loop->body(loop->env, begin, end);
+
+  /* Pool threads never end, so their output would otherwise wait for
+     their next chunk, after whatever the loop's caller prints next; the
+     same goes for their -instrument= counts and -alloc-profile tables,
+     which exit cannot reach */
+  if (me != &pool.workers[0]) {
+    tspp_flush();
+    tspp_counters_flush();
+    tspp_alloc_profile_flush();
+  }
+  /* Publishes the iterations' writes to the thread waiting for the loop,
+     which may return and free it as soon as this lands */
+  atomic_fetch_sub_explicit(&loop->left, end - begin, memory_order_acq_rel);
+}
+
+static void run_task(worker *me, range_task *task) {
+  range_task range = *task;
+  tspp_free(task);
+  run_range(me, range.loop, range.begin, range.end);
+}
+
+/* Hands a worker iterations [begin, end) as its home block. If its
+   mailbox is full, the block goes on the caller's deque for anyone to
+   steal, and if that is full too, the caller runs it. */
+static void post(worker *me, worker *home, parallel_loop *loop,
+                 int32_t begin, int32_t end) {
+  range_task *task = tspp_alloc(sizeof(range_task), _Alignof(range_task));
+  if (!task) {
+    tspp_runtime_fail("out of memory while starting a parallel loop", NULL);
+  }
+  *task = (range_task){loop, begin, end};
+  range_task *empty = NULL;
+  if (atomic_compare_exchange_strong_explicit(&home->mailbox, &empty, task,
+                                              memory_order_release,
+                                              memory_order_relaxed) ||
+      push(me, task)) {
+    atomic_fetch_add(&pool.queued, 1);
+    return;
+  }
+  tspp_free(task);
+  run_range(me, loop, begin, end);
+}
+
+static void *work(void *arg) {
+  self = arg;
+  /* Slabs stay on the node by default when there is only one */
+  if (pool.node_count > 1) {
+    tspp_set_thread_node(atomic_load(&self->node));
+  }
+  for (;;) {
+    range_task *task = find_work(self);
+    if (task) {
+      run_task(self, task);
+      continue;
+    }
+    /* A push either sees this sleeper and signals, or happened before
+       the check and is seen by it */
+    pthread_mutex_lock(&pool.lock);
+    atomic_fetch_add(&pool.sleepers, 1);
+    while (atomic_load(&pool.queued) == 0) {
+      pthread_cond_wait(&pool.wake, &pool.lock);
+    }
+    atomic_fetch_sub(&pool.sleepers, 1);
+    pthread_mutex_unlock(&pool.lock);
+  }
+  return NULL;
+}
+
+/* Reads which node each CPU belongs to from sysfs, and lists the CPUs
+   the process may run on, node by node. CPUs no node lists count as node
+   0, and without sysfs the machine is one node. */
+static void discover_topology(void) {
+#ifdef __linux__
+  cpu_set_t allowed;
+  if (sched_getaffinity(0, sizeof allowed, &allowed) != 0) {
+    return;
+  }
+  for (int node = 0; node < TSPP_MAX_NODES; ++node) {
+    char path[64];
+    snprintf(path, sizeof path, "/sys/devices/system/node/node%d/cpulist",
+             node);
+    FILE *file = fopen(path, "r");
+    if (!file) {
+      continue;
+    }
+    /* A list of ranges such as 0-3,8-11 */
+    int first;
+    while (fscanf(file, "%d", &first) == 1) {
+      int last = first;
+      int next = fgetc(file);
+      if (next == '-') {
+        if (fscanf(file, "%d", &last) != 1) {
+          break;
+        }
+        next = fgetc(file);
+      }
+      for (int cpu = first < 0 ? 0 : first; cpu <= last && cpu < CPU_SETSIZE;
+           ++cpu) {
+        topology.cpu_nodes[cpu] = (short)node;
+      }
+      if (next != ',') {
+        break;
+      }
+    }
+    fclose(file);
+  }
+
+  for (int node = 0; node < TSPP_MAX_NODES; ++node) {
+    int found = 0;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+      if (topology.count < TSPP_MAX_WORKERS && CPU_ISSET(cpu, &allowed) &&
+          topology.cpu_nodes[cpu] == node) {
+        topology.cpus[topology.count] = cpu;
+        topology.nodes[topology.count] = node;
+        ++topology.count;
+        found = 1;
+      }
+    }
+    topology.node_count += found;
+  }
+#endif
+}
+
+/* The node of the CPU the calling thread runs on */
+static int current_node(void) {
+#ifdef __linux__
+  int cpu = sched_getcpu();
+  if (cpu >= 0 && cpu < CPU_SETSIZE) {
+    return topology.cpu_nodes[cpu];
+  }
+#endif
+  return 0;
+}
+
+static void start_pool(void) {
+  discover_topology();
+  long count = topology.count ? topology.count : sysconf(_SC_NPROCESSORS_ONLN);
+  const char *setting = getenv("TSPP_WORKERS");
+  if (setting && *setting) {
+    count = strtol(setting, NULL, 10);
+  }
+  if (count < 1) {
+    count = 1;
+  } else if (count > TSPP_MAX_WORKERS) {
+    count = TSPP_MAX_WORKERS;
+  }
+
+  pool.count = (int)count;
+  pool.workers = tspp_alloc(sizeof(worker) * (size_t)count, _Alignof(worker));
+  if (!pool.workers) {
+    tspp_runtime_fail("out of memory while starting the parallel workers",
+                      NULL);
+  }
+  /* With more workers than CPUs, they wrap around; TSPP_AFFINITY=none
+     leaves placement to the scheduler */
+  const char *affinity = getenv("TSPP_AFFINITY");
+  int pin = topology.count > 0 && !(affinity && strcmp(affinity, "none") == 0);
+  pool.node_count = topology.node_count > 1 && pin ? topology.node_count : 1;
+  for (int i = 0; i < pool.count; ++i) {
+    worker *slot = &pool.workers[i];
+    atomic_init(&slot->top, 0);
+    atomic_init(&slot->bottom, 0);
+    atomic_init(&slot->mailbox, NULL);
+    atomic_init(&slot->node,
+                pool.node_count > 1 ? topology.nodes[i % topology.count] : 0);
+    slot->seed = 2654435761u * (unsigned)(i + 1);
+  }
+
+  /* Each thread starts on its CPU, so its stack is on its node too */
+  for (int i = 1; i < pool.count; ++i) {
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
+#ifdef __linux__
+    if (pin) {
+      cpu_set_t cpus;
+      CPU_ZERO(&cpus);
+      CPU_SET(topology.cpus[i % topology.count], &cpus);
+      pthread_attr_setaffinity_np(&attributes, sizeof cpus, &cpus);
+    }
+#endif
+    pthread_t thread;
+    if (pthread_create(&thread, &attributes, work, &pool.workers[i]) != 0) {
+      tspp_runtime_fail("cannot start the parallel workers", NULL);
+    }
+    pthread_attr_destroy(&attributes);
+  }
+}
+
+void tspp_parallel_for(tspp_parallel_body body, void *env, int32_t count) {
+  if (count <= 0) {
+    return;
+  }
+  pthread_once(&pool_once, start_pool);
+  if (pool.count == 1 || count == 1) {
+    body(env, 0, count);
+    return;
+  }
+
+  /* Threads outside the pool take turns as worker 0, which is not pinned
+     and takes the node of wherever the thread runs */
+  int outside = self == NULL;
+  if (outside) {
+    pthread_mutex_lock(&pool.external);
+    self = &pool.workers[0];
+    if (pool.node_count > 1) {
+      atomic_store_explicit(&self->node, current_node(),
+                            memory_order_relaxed);
+    }
+  }
+  worker *me = self;
+
+  /* Worker i's home block is the i-th of as many equal blocks as there
+     are workers; the caller runs its own */
+  int32_t grain = count / (pool.count * TSPP_CHUNKS_PER_WORKER);
+  parallel_loop loop = {body, env, grain > 0 ? grain : 1, count};
+  int index = (int)(me - pool.workers);
+  int32_t own_begin = 0;
+  int32_t own_end = 0;
+  for (int i = 0; i < pool.count; ++i) {
+    int32_t begin = (int32_t)((int64_t)count * i / pool.count);
+    int32_t end = (int32_t)((int64_t)count * (i + 1) / pool.count);
+    if (i == index) {
+      own_begin = begin;
+      own_end = end;
+    } else if (begin < end) {
+      post(me, &pool.workers[i], &loop, begin, end);
+    }
+  }
+  if (atomic_load(&pool.sleepers) != 0) {
+    pthread_mutex_lock(&pool.lock);
+    pthread_cond_broadcast(&pool.wake);
+    pthread_mutex_unlock(&pool.lock);
+  }
+  if (own_begin < own_end) {
+    run_range(me, &loop, own_begin, own_end);
+  }
+
+  /* Help with whatever is queued, this loop's ranges or not, until the
+     ranges thieves took are done */
+  while (atomic_load_explicit(&loop.left, memory_order_acquire) != 0) {
+    range_task *task = find_work(me);
+    if (task) {
+      run_task(me, task);
+    } else {
+      sched_yield();
+    }
+  }
+
+  if (outside) {
+    self = NULL;
+    pthread_mutex_unlock(&pool.external);
+  }
+}
+
+void tspp_parallel_uncaught(void) {
+  tspp_runtime_fail("an exception left an iteration of a #parallel loop", NULL);
+}
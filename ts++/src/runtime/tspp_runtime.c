@@ -0,0 +1,889 @@
+#define _POSIX_C_SOURCE 200112L
+#ifdef __linux__
+#define _DEFAULT_SOURCE /* syscall */
+#endif
+#include "runtime/tspp_runtime.h"
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/*
+ * Every block lives in a slab aligned to its own size, so masking a pointer
+ * finds the slab header and with it the size class. Large allocations get a
+ * slab-aligned header of their own and are handed back to the C allocator.
+ */
+#define TSPP_SLAB_SIZE ((uintptr_t)64 * 1024)
+#define TSPP_SLAB_HEADER ((size_t)64)  /* Header room; blocks start after */
+#define TSPP_SLAB_MAGIC 0x74737070u    /* "tspp" */
+#define TSPP_LARGE_CLASS UINT32_MAX    /* Size class of large allocations */
+#define TSPP_ARENA_CLASS (UINT32_MAX - 1) /* Size class of arena chunks */
+#define TSPP_STAMPED_CLASS (UINT32_MAX - 2) /* Large, after a site stamp */
+#define TSPP_MIN_ALIGN ((size_t)16)    /* Matches malloc's guarantee */
+#define TSPP_CLASS_COUNT 20
+
+/* 16-byte steps for small objects, then four classes per doubling */
+static const uint32_t kClassSizes[TSPP_CLASS_COUNT] = {
+    16,  32,  48,  64,   80,   96,   112,  128,  192,  256,
+    384, 512, 768, 1024, 1536, 2048, 3072, 4096, 6144, 8192};
+
+typedef struct tspp_slab {
+  uint32_t magic;      /* TSPP_SLAB_MAGIC */
+  uint32_t size_class; /* Index into kClassSizes, or TSPP_LARGE_CLASS */
+} tspp_slab;
+
+typedef struct tspp_block {
+  struct tspp_block *next; /* Next free block of the same class */
+} tspp_block;
+
+/* Per-thread allocator state; no locks on either path */
+typedef struct tspp_heap {
+  tspp_block *free[TSPP_CLASS_COUNT]; /* Released blocks */
+  char *bump[TSPP_CLASS_COUNT];       /* Unused tail of the current slab */
+  char *end[TSPP_CLASS_COUNT];
+  uint64_t allocations; /* Objects handed out, arenas included */
+} tspp_heap;
+
+/* Not static, like the rest of the allocator's state: fast paths inlined
+   from the runtime bitcode into a program share it with this copy */
+_Thread_local tspp_heap tspp_thread_heap;
+
+/* Smallest class that fits size and keeps blocks aligned to align */
+static unsigned size_class(size_t size, size_t align) {
+  unsigned index = 8;
+  if (size <= 128) {
+    index = (unsigned)((size + 15) / 16) - 1;
+  } else {
+    while (index < TSPP_CLASS_COUNT && kClassSizes[index] < size) {
+      ++index;
+    }
+  }
+  /* Blocks sit at a multiple of their size past a 64-aligned header */
+  while (index < TSPP_CLASS_COUNT && kClassSizes[index] % align != 0) {
+    ++index;
+  }
+  return index;
+}
+
+/* The NUMA node a pinned #parallel worker's slabs are placed on, or -1 */
+_Thread_local int tspp_thread_node = -1;
+
+void tspp_set_thread_node(int node) { tspp_thread_node = node; }
+
+/* Prefers the thread's node for the pages of a fresh slab, and moves any
+   the C allocator had already placed elsewhere */
+static void place_on_node(void *memory, size_t size) {
+#if defined(__linux__) && defined(SYS_mbind)
+  int node = tspp_thread_node;
+  if (node < 0 || node >= (int)(sizeof(unsigned long) * 8)) {
+    return;
+  }
+  const int preferred = 1;  /* MPOL_PREFERRED */
+  const int move = 1 << 1;  /* MPOL_MF_MOVE */
+  unsigned long nodes = 1ul << node;
+  syscall(SYS_mbind, memory, size, preferred, &nodes,
+          sizeof(nodes) * 8 + 1, move);
+#else
+  (void)memory;
+  (void)size;
+#endif
+}
+
+static void *alloc_slab(size_t size, uint32_t size_class) {
+  void *memory = NULL;
+  if (posix_memalign(&memory, TSPP_SLAB_SIZE, size) != 0) {
+    return NULL;
+  }
+  if (tspp_thread_node >= 0) {
+    place_on_node(memory, size);
+  }
+  tspp_slab *slab = memory;
+  slab->magic = TSPP_SLAB_MAGIC;
+  slab->size_class = size_class;
+  return slab;
+}
+
+static void *alloc_large(size_t size, size_t align) {
+  /* The header must stay within the first slab-sized chunk */
+  size_t offset = align > TSPP_SLAB_HEADER ? align : TSPP_SLAB_HEADER;
+  if (offset >= TSPP_SLAB_SIZE || size > SIZE_MAX - offset) {
+    return NULL;
+  }
+  char *slab = alloc_slab(offset + size, TSPP_LARGE_CLASS);
+  return slab ? slab + offset : NULL;
+}
+
+static int refill(unsigned index) {
+  char *slab = alloc_slab(TSPP_SLAB_SIZE, index);
+  if (!slab) {
+    return 0;
+  }
+  size_t block_size = kClassSizes[index];
+  size_t count = (TSPP_SLAB_SIZE - TSPP_SLAB_HEADER) / block_size;
+  tspp_thread_heap.bump[index] = slab + TSPP_SLAB_HEADER;
+  tspp_thread_heap.end[index] =
+      tspp_thread_heap.bump[index] + count * block_size;
+  return 1;
+}
+
+/* TSPP_ALLOC=system hands every request to the C allocator, so leak
+   checkers see each object rather than the slabs holding them */
+int tspp_system_mode = -1;
+
+static int use_system_allocator(void) {
+  int mode = __atomic_load_n(&tspp_system_mode, __ATOMIC_RELAXED);
+  if (mode < 0) {
+    const char *setting = getenv("TSPP_ALLOC");
+    mode = setting && strcmp(setting, "system") == 0;
+    __atomic_store_n(&tspp_system_mode, mode, __ATOMIC_RELAXED);
+  }
+  return mode;
+}
+
+void *tspp_alloc(uint64_t size, uint64_t align) {
+  assert(align != 0 && (align & (align - 1)) == 0);
+  if (align < TSPP_MIN_ALIGN) {
+    align = TSPP_MIN_ALIGN;
+  }
+  if (size == 0) {
+    size = 1;
+  }
+  ++tspp_thread_heap.allocations;
+
+  if (use_system_allocator()) {
+    void *memory = NULL;
+    return posix_memalign(&memory, align, size) == 0 ? memory : NULL;
+  }
+
+  unsigned index = align <= TSPP_SLAB_HEADER ? size_class(size, align)
+                                             : TSPP_CLASS_COUNT;
+  if (index == TSPP_CLASS_COUNT) {
+    return alloc_large(size, align);
+  }
+
+  tspp_block *block = tspp_thread_heap.free[index];
+  if (block) {
+    tspp_thread_heap.free[index] = block->next;
+    return block;
+  }
+
+  if (tspp_thread_heap.bump[index] == tspp_thread_heap.end[index] &&
+      !refill(index)) {
+    return NULL;
+  }
+  void *object = tspp_thread_heap.bump[index];
+  tspp_thread_heap.bump[index] += kClassSizes[index];
+  return object;
+}
+
+/*
+ * -alloc-profile stamps each heap object of a profiled new expression
+ * with its site and allocation time, in a prefix the size of the object's
+ * alignment. The object then starts inside its block rather than at the
+ * block's start, which is how tspp_free() tells it apart; a large one has
+ * a slab of its own, whose class says so instead.
+ */
+typedef struct tspp_alloc_stamp {
+  const tspp_alloc_site *site;
+  uint64_t time; /* Nanoseconds on the monotonic clock */
+} tspp_alloc_stamp;
+
+int tspp_alloc_profiling; /* Set once a stamped object exists */
+
+static uint64_t now_nanoseconds(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+static void release_stamped(void *object) {
+  tspp_alloc_stamp *stamp = (tspp_alloc_stamp *)object - 1;
+  tspp_alloc_profile_release(stamp->site, now_nanoseconds() - stamp->time);
+}
+
+void tspp_free(void *ptr) {
+  if (!ptr) {
+    return;
+  }
+  if (use_system_allocator()) {
+    free(ptr);
+    return;
+  }
+
+  tspp_slab *slab = (tspp_slab *)((uintptr_t)ptr & ~(TSPP_SLAB_SIZE - 1));
+  assert(slab->magic == TSPP_SLAB_MAGIC);
+  if (slab->size_class == TSPP_LARGE_CLASS) {
+    free(slab);
+    return;
+  }
+  if (slab->size_class == TSPP_ARENA_CLASS) {
+    return; /* Released with its arena */
+  }
+  if (slab->size_class == TSPP_STAMPED_CLASS) {
+    release_stamped(ptr);
+    free(slab);
+    return;
+  }
+  if (__atomic_load_n(&tspp_alloc_profiling, __ATOMIC_RELAXED)) {
+    size_t offset = (size_t)((char *)ptr - (char *)slab - TSPP_SLAB_HEADER) %
+                    kClassSizes[slab->size_class];
+    if (offset != 0) {
+      release_stamped(ptr);
+      ptr = (char *)ptr - offset;
+    }
+  }
+
+  tspp_block *block = ptr;
+  block->next = tspp_thread_heap.free[slab->size_class];
+  tspp_thread_heap.free[slab->size_class] = block;
+}
+
+/*
+ * An arena is a chain of slab-aligned chunks whose blocks are never freed
+ * one by one: allocation bumps a pointer and leaving the scope releases
+ * every chunk. The arena itself lives in its first chunk's header, and each
+ * thread keeps one spare chunk so a scope entered per request does not go
+ * to the C allocator. Requests too large for a chunk get one of their own.
+ */
+typedef struct tspp_arena_chunk {
+  tspp_slab slab; /* size_class is TSPP_ARENA_CLASS, so tspp_free skips it */
+  struct tspp_arena_chunk *next; /* Older chunks of the same arena */
+} tspp_arena_chunk;
+
+struct tspp_arena {
+  tspp_arena_chunk chunk; /* The first chunk's header */
+  tspp_arena *parent;     /* The scope this one is nested in */
+  char *bump;             /* Unused tail of the newest chunk */
+  char *end;
+};
+
+_Static_assert(sizeof(tspp_arena) <= TSPP_SLAB_HEADER,
+               "an arena must fit in its first chunk's header");
+
+_Thread_local tspp_arena *tspp_current_arena;
+_Thread_local tspp_arena_chunk *tspp_spare_chunk;
+
+static tspp_arena_chunk *alloc_chunk(size_t size) {
+  if (size == TSPP_SLAB_SIZE && tspp_spare_chunk) {
+    tspp_arena_chunk *chunk = tspp_spare_chunk;
+    tspp_spare_chunk = NULL;
+    return chunk;
+  }
+  return alloc_slab(size, TSPP_ARENA_CLASS);
+}
+
+tspp_arena *tspp_arena_enter(void) {
+  /* Objects keep coming from the heap, where leak checkers see them */
+  if (use_system_allocator()) {
+    return NULL;
+  }
+  tspp_arena *arena = (tspp_arena *)alloc_chunk(TSPP_SLAB_SIZE);
+  if (!arena) {
+    return NULL;
+  }
+  arena->chunk.next = NULL;
+  arena->parent = tspp_current_arena;
+  arena->bump = (char *)arena + TSPP_SLAB_HEADER;
+  arena->end = (char *)arena + TSPP_SLAB_SIZE;
+  tspp_current_arena = arena;
+  return arena;
+}
+
+void tspp_arena_exit(tspp_arena *arena) {
+  if (!arena) {
+    return;
+  }
+  tspp_current_arena = arena->parent;
+  tspp_arena_chunk *chunk = arena->chunk.next;
+  while (chunk) {
+    tspp_arena_chunk *next = chunk->next;
+    free(chunk);
+    chunk = next;
+  }
+  if (tspp_spare_chunk) {
+    free(arena);
+  } else {
+    tspp_spare_chunk = &arena->chunk;
+  }
+}
+
+static void *arena_alloc(tspp_arena *arena, size_t size, size_t align) {
+  char *object = (char *)(((uintptr_t)arena->bump + align - 1) & ~(align - 1));
+  if (object <= arena->end && size <= (size_t)(arena->end - object)) {
+    arena->bump = object + size;
+    return object;
+  }
+
+  /* Large requests are chained behind the current chunk, which keeps its
+     free tail */
+  size_t offset = align > TSPP_SLAB_HEADER ? align : TSPP_SLAB_HEADER;
+  if (offset >= TSPP_SLAB_SIZE || size > SIZE_MAX - offset) {
+    return NULL;
+  }
+  size_t needed = offset + size;
+  int large = needed > TSPP_SLAB_SIZE / 4;
+  tspp_arena_chunk *chunk =
+      alloc_chunk(large && needed > TSPP_SLAB_SIZE ? needed : TSPP_SLAB_SIZE);
+  if (!chunk) {
+    return NULL;
+  }
+  chunk->next = arena->chunk.next;
+  arena->chunk.next = chunk;
+  object = (char *)chunk + offset;
+  if (!large) {
+    arena->bump = object + size;
+    arena->end = (char *)chunk + TSPP_SLAB_SIZE;
+  }
+  return object;
+}
+
+void *tspp_new(uint64_t size, uint64_t align) {
+  tspp_arena *arena = tspp_current_arena;
+  if (!arena) {
+    return tspp_alloc(size, align);
+  }
+  if (align < TSPP_MIN_ALIGN) {
+    align = TSPP_MIN_ALIGN;
+  }
+  ++tspp_thread_heap.allocations;
+  return arena_alloc(arena, size == 0 ? 1 : size, align);
+}
+
+uint64_t tspp_alloc_count(void) { return tspp_thread_heap.allocations; }
+
+/* An object of a profiled new expression outside any #arena */
+static void *alloc_stamped(uint64_t size, uint64_t align,
+                           const tspp_alloc_site *site) {
+  if (use_system_allocator()) {
+    tspp_alloc_profile_record(site, 1);
+    return tspp_alloc(size, align);
+  }
+  if (align < sizeof(tspp_alloc_stamp)) {
+    align = sizeof(tspp_alloc_stamp);
+  }
+  if (size == 0) {
+    size = 1; /* Keeps the object inside its block */
+  }
+  if (size > UINT64_MAX - align) {
+    return NULL;
+  }
+  char *memory = tspp_alloc(align + size, align);
+  if (!memory) {
+    return NULL;
+  }
+  tspp_slab *slab = (tspp_slab *)((uintptr_t)memory & ~(TSPP_SLAB_SIZE - 1));
+  if (slab->size_class == TSPP_LARGE_CLASS) {
+    slab->size_class = TSPP_STAMPED_CLASS;
+  }
+  if (!__atomic_load_n(&tspp_alloc_profiling, __ATOMIC_RELAXED)) {
+    __atomic_store_n(&tspp_alloc_profiling, 1, __ATOMIC_RELAXED);
+  }
+
+  void *object = memory + align;
+  tspp_alloc_stamp *stamp = (tspp_alloc_stamp *)object - 1;
+  stamp->site = site;
+  stamp->time = now_nanoseconds();
+  tspp_alloc_profile_record(site, 0);
+  return object;
+}
+
+void *tspp_new_at(uint64_t size, uint64_t align, const tspp_alloc_site *site) {
+  if (tspp_current_arena) {
+    tspp_alloc_profile_record(site, 1);
+    return tspp_new(size, align);
+  }
+  return alloc_stamped(size, align, site);
+}
+
+/*
+ * Shared objects carry their counts in a header right before the object.
+ * The strong references together hold one weak reference, so the memory
+ * outlives the last strong reference while #weak pointers remain.
+ */
+typedef struct tspp_shared_header {
+  const tspp_shared_type *type; /* Counted fields, or NULL for none */
+  uint32_t strong;   /* #shared pointers */
+  uint32_t weak;     /* #weak pointers, plus one while strong > 0 */
+  uint32_t offset;   /* Bytes from the allocation to the object */
+  uint32_t atomic;   /* Set once the object is reachable from other threads */
+  uint32_t color;    /* Cycle collector state, TSPP_BLACK outside it */
+  uint32_t buffered; /* Whether a candidate buffer holds the object */
+} tspp_shared_header;
+
+/*
+ * Cycles are found by trial deletion (Bacon and Rajan, 2001). A strong
+ * release that leaves references makes the object a candidate root; it is
+ * colored purple and buffered, the buffer holding a weak reference so the
+ * memory stays. A slice takes candidates off the buffer and subtracts the
+ * references among everything reachable from them (gray). Objects whose
+ * count stays positive are referenced from outside and restore what they
+ * reach (black); the rest are garbage (white) and are freed.
+ *
+ * Each thread collects the objects it has not published, so the counts
+ * change under no one else. A slice stops taking candidates once it has
+ * traced TSPP_CYCLE_SLICE objects, and one runs whenever
+ * TSPP_CYCLE_TRIGGER candidates are waiting. The bound is checked between
+ * candidates only: the graph a candidate reaches is traced, scanned and
+ * collected within one slice, as the counts it lowers must be restored
+ * before the program runs again, so a candidate reaching a large graph
+ * makes a pause as long as that graph.
+ */
+#define TSPP_BLACK 0u  /* In use */
+#define TSPP_GRAY 1u   /* References from within the traced graph removed */
+#define TSPP_WHITE 2u  /* Garbage unless something black reaches it */
+#define TSPP_PURPLE 3u /* Candidate root */
+#define TSPP_CYCLE_TRIGGER ((size_t)4096)
+#define TSPP_CYCLE_SLICE ((size_t)16384)
+
+typedef struct tspp_object_stack {
+  tspp_shared_header **items;
+  size_t count;
+  size_t capacity;
+} tspp_object_stack;
+
+/* Per-thread collector state; the stacks keep their storage between uses */
+typedef struct tspp_cycle_state {
+  tspp_object_stack roots;   /* Candidate roots */
+  tspp_object_stack batch;   /* Candidates of the running slice */
+  tspp_object_stack work;    /* Objects left to trace */
+  tspp_object_stack restore; /* Objects left to color black */
+  tspp_object_stack garbage; /* White objects to free */
+  tspp_object_stack dying;   /* Objects left to destroy */
+  int collecting;
+} tspp_cycle_state;
+
+_Thread_local tspp_cycle_state tspp_cycles;
+
+static tspp_shared_header *shared_header(void *object) {
+  return (tspp_shared_header *)object - 1;
+}
+
+static void *header_object(tspp_shared_header *header) { return header + 1; }
+
+static int is_published(tspp_shared_header *header) {
+  return __atomic_load_n(&header->atomic, __ATOMIC_RELAXED) != 0;
+}
+
+/* The object a counted field refers to, or NULL */
+static tspp_shared_header *field_target(tspp_shared_header *header,
+                                        uint32_t field) {
+  void *target;
+  memcpy(&target, (char *)header_object(header) + header->type->offsets[field],
+         sizeof(target));
+  return target ? shared_header(target) : NULL;
+}
+
+/* Returns 0 when the stack cannot grow */
+static int stack_push(tspp_object_stack *stack, tspp_shared_header *header) {
+  if (stack->count == stack->capacity) {
+    size_t capacity = stack->capacity ? stack->capacity * 2 : 256;
+    tspp_shared_header **items =
+        realloc(stack->items, capacity * sizeof(*items));
+    if (!items) {
+      return 0;
+    }
+    stack->items = items;
+    stack->capacity = capacity;
+  }
+  stack->items[stack->count++] = header;
+  return 1;
+}
+
+/* Unpublished objects belong to one thread; plain arithmetic suffices */
+static void count_add(tspp_shared_header *header, uint32_t *count) {
+  if (is_published(header)) {
+    __atomic_fetch_add(count, 1, __ATOMIC_RELAXED);
+  } else {
+    ++*count;
+  }
+}
+
+/* Returns the count after the decrement */
+static uint32_t count_sub(tspp_shared_header *header, uint32_t *count) {
+  if (is_published(header)) {
+    return __atomic_sub_fetch(count, 1, __ATOMIC_ACQ_REL);
+  }
+  return --*count;
+}
+
+/* Allocates with tspp_alloc, or stamped for a profiled site */
+static void *shared_alloc(uint64_t size, uint64_t align,
+                          const tspp_shared_type *type,
+                          const tspp_alloc_site *site) {
+  while (align < sizeof(tspp_shared_header)) {
+    align *= 2;
+  }
+  /* The header sits right before the object, which keeps its alignment */
+  if (size > SIZE_MAX - align) {
+    return NULL;
+  }
+  char *memory = site ? alloc_stamped(align + size, align, site)
+                      : tspp_alloc(align + size, align);
+  if (!memory) {
+    return NULL;
+  }
+
+  void *object = memory + align;
+  tspp_shared_header *header = shared_header(object);
+  header->type = type && type->shared_count + type->weak_count ? type : NULL;
+  header->strong = 1;
+  header->weak = 1;
+  header->offset = (uint32_t)align;
+  header->atomic = 0;
+  header->color = TSPP_BLACK;
+  header->buffered = 0;
+  return object;
+}
+
+void *tspp_shared_alloc(uint64_t size, uint64_t align,
+                        const tspp_shared_type *type) {
+  return shared_alloc(size, align, type, NULL);
+}
+
+void *tspp_shared_alloc_at(uint64_t size, uint64_t align,
+                           const tspp_shared_type *type,
+                           const tspp_alloc_site *site) {
+  return shared_alloc(size, align, type, site);
+}
+
+void tspp_shared_publish(void *object) {
+  if (!object || is_published(shared_header(object))) {
+    return;
+  }
+  /* Everything the object refers to becomes reachable with it */
+  tspp_object_stack pending = {NULL, 0, 0};
+  tspp_shared_header *header = shared_header(object);
+  while (header) {
+    __atomic_store_n(&header->atomic, 1, __ATOMIC_RELEASE);
+    const tspp_shared_type *type = header->type;
+    for (uint32_t i = 0; type && i < type->shared_count + type->weak_count;
+         ++i) {
+      tspp_shared_header *target = field_target(header, i);
+      if (target && !is_published(target) && !stack_push(&pending, target)) {
+        abort(); /* Another thread could see an unpublished object */
+      }
+    }
+    header = pending.count ? pending.items[--pending.count] : NULL;
+  }
+  free(pending.items);
+}
+
+void tspp_shared_retain(void *object) {
+  if (object) {
+    tspp_shared_header *header = shared_header(object);
+    count_add(header, &header->strong);
+  }
+}
+
+/* Buffers an object whose count dropped but not to zero */
+static void possible_root(tspp_shared_header *header) {
+  if (!header->type || !header->type->shared_count || is_published(header)) {
+    return; /* Cannot be in a cycle this thread collects */
+  }
+  header->color = TSPP_PURPLE;
+  if (!header->buffered && stack_push(&tspp_cycles.roots, header)) {
+    header->buffered = 1;
+    ++header->weak;
+  }
+}
+
+/* Releases the fields of an object whose last strong reference went away,
+   and of the objects that die in turn, then drops the weak reference
+   their strong ones held */
+static void destroy(tspp_shared_header *header) {
+  tspp_object_stack *dying = &tspp_cycles.dying;
+  size_t base = dying->count;
+  while (header) {
+    const tspp_shared_type *type = header->type;
+    for (uint32_t i = 0; type && i < type->shared_count; ++i) {
+      tspp_shared_header *target = field_target(header, i);
+      if (!target) {
+        continue;
+      }
+      if (count_sub(target, &target->strong) != 0) {
+        possible_root(target);
+      } else if (!stack_push(dying, target)) {
+        destroy(target); /* Out of memory; recurse instead */
+      }
+    }
+    for (uint32_t i = 0; type && i < type->weak_count; ++i) {
+      tspp_shared_header *target = field_target(header, type->shared_count + i);
+      if (target) {
+        tspp_weak_release(header_object(target));
+      }
+    }
+    header->color = TSPP_BLACK;
+    tspp_weak_release(header_object(header));
+    header = dying->count > base ? dying->items[--dying->count] : NULL;
+  }
+}
+
+/* The unpublished object a #shared field of a traced object refers to */
+static tspp_shared_header *traced_target(tspp_shared_header *header,
+                                         uint32_t field) {
+  tspp_shared_header *target = field_target(header, field);
+  return target && !is_published(target) ? target : NULL;
+}
+
+/* Grays everything reachable from a root, removing the references among
+   it; returns how many objects it grayed */
+static size_t mark_gray(tspp_shared_header *root) {
+  tspp_object_stack *work = &tspp_cycles.work;
+  size_t marked = 0;
+  if (root->color == TSPP_GRAY || !stack_push(work, root)) {
+    return 0;
+  }
+  root->color = TSPP_GRAY;
+  while (work->count) {
+    tspp_shared_header *header = work->items[--work->count];
+    ++marked;
+    for (uint32_t i = 0; header->type && i < header->type->shared_count;
+         ++i) {
+      tspp_shared_header *target = traced_target(header, i);
+      if (!target) {
+        continue;
+      }
+      --target->strong;
+      if (target->color != TSPP_GRAY) {
+        target->color = TSPP_GRAY;
+        if (!stack_push(work, target)) {
+          abort(); /* The counts cannot be restored */
+        }
+      }
+    }
+  }
+  return marked;
+}
+
+/* Gives back the references an object still in use and what it reaches
+   hold on each other */
+static void scan_black(tspp_shared_header *header) {
+  tspp_object_stack *restore = &tspp_cycles.restore;
+  header->color = TSPP_BLACK;
+  while (header) {
+    for (uint32_t i = 0; header->type && i < header->type->shared_count;
+         ++i) {
+      tspp_shared_header *target = traced_target(header, i);
+      if (!target) {
+        continue;
+      }
+      ++target->strong;
+      if (target->color != TSPP_BLACK) {
+        target->color = TSPP_BLACK;
+        if (!stack_push(restore, target)) {
+          abort();
+        }
+      }
+    }
+    header = restore->count ? restore->items[--restore->count] : NULL;
+  }
+}
+
+/* Splits the gray graph of a root into live (black) and garbage (white) */
+static void scan(tspp_shared_header *root) {
+  tspp_object_stack *work = &tspp_cycles.work;
+  if (!stack_push(work, root)) {
+    abort();
+  }
+  while (work->count) {
+    tspp_shared_header *header = work->items[--work->count];
+    if (header->color != TSPP_GRAY) {
+      continue;
+    }
+    if (header->strong > 0) {
+      scan_black(header);
+      continue;
+    }
+    header->color = TSPP_WHITE;
+    for (uint32_t i = 0; header->type && i < header->type->shared_count;
+         ++i) {
+      tspp_shared_header *target = traced_target(header, i);
+      if (target && !stack_push(work, target)) {
+        abort();
+      }
+    }
+  }
+}
+
+/* Moves the white objects reachable from a root to the garbage */
+static void collect_white(tspp_shared_header *root) {
+  tspp_object_stack *work = &tspp_cycles.work;
+  if (!stack_push(work, root)) {
+    abort();
+  }
+  while (work->count) {
+    tspp_shared_header *header = work->items[--work->count];
+    if (header->color != TSPP_WHITE) {
+      continue;
+    }
+    header->color = TSPP_BLACK;
+    if (!stack_push(&tspp_cycles.garbage, header)) {
+      abort();
+    }
+    for (uint32_t i = 0; header->type && i < header->type->shared_count;
+         ++i) {
+      tspp_shared_header *target = traced_target(header, i);
+      if (target && !stack_push(work, target)) {
+        abort();
+      }
+    }
+  }
+}
+
+/* Frees the garbage of a slice. Its counts already leave out the
+   references among it; those to published objects were never removed. */
+static void free_garbage(void) {
+  tspp_object_stack *garbage = &tspp_cycles.garbage;
+  for (size_t i = 0; i < garbage->count; ++i) {
+    tspp_shared_header *header = garbage->items[i];
+    const tspp_shared_type *type = header->type;
+    for (uint32_t j = 0; type && j < type->shared_count; ++j) {
+      tspp_shared_header *target = field_target(header, j);
+      if (target && is_published(target)) {
+        tspp_shared_release(header_object(target));
+      }
+    }
+    for (uint32_t j = 0; type && j < type->weak_count; ++j) {
+      tspp_shared_header *target = field_target(header, type->shared_count + j);
+      if (target) {
+        tspp_weak_release(header_object(target));
+      }
+    }
+  }
+  /* Only now, as the fields of one may refer to another */
+  for (size_t i = 0; i < garbage->count; ++i) {
+    tspp_weak_release(header_object(garbage->items[i]));
+  }
+  garbage->count = 0;
+}
+
+/* Runs trial deletion from candidates until a slice's worth is traced */
+static void collect_slice(void) {
+  tspp_object_stack *roots = &tspp_cycles.roots;
+  tspp_object_stack *batch = &tspp_cycles.batch;
+  tspp_cycles.collecting = 1;
+
+  size_t traced = 0;
+  while (roots->count && traced < TSPP_CYCLE_SLICE) {
+    tspp_shared_header *header = roots->items[--roots->count];
+    if (header->color == TSPP_PURPLE && header->strong > 0 &&
+        !is_published(header) && stack_push(batch, header)) {
+      traced += mark_gray(header);
+      continue;
+    }
+    /* Retained since, dead or published: not a candidate any more */
+    header->buffered = 0;
+    if (header->color == TSPP_PURPLE) {
+      header->color = TSPP_BLACK;
+    }
+    tspp_weak_release(header_object(header));
+  }
+  for (size_t i = 0; i < batch->count; ++i) {
+    scan(batch->items[i]);
+  }
+  for (size_t i = 0; i < batch->count; ++i) {
+    batch->items[i]->buffered = 0;
+    collect_white(batch->items[i]);
+  }
+  free_garbage();
+  for (size_t i = 0; i < batch->count; ++i) {
+    tspp_weak_release(header_object(batch->items[i]));
+  }
+  batch->count = 0;
+
+  tspp_cycles.collecting = 0;
+}
+
+void tspp_shared_release(void *object) {
+  if (!object) {
+    return;
+  }
+  tspp_shared_header *header = shared_header(object);
+  if (count_sub(header, &header->strong) == 0) {
+    destroy(header);
+  } else {
+    possible_root(header);
+  }
+  if (tspp_cycles.roots.count >= TSPP_CYCLE_TRIGGER &&
+      !tspp_cycles.collecting) {
+    collect_slice();
+  }
+}
+
+void tspp_shared_collect(void) {
+  while (tspp_cycles.roots.count && !tspp_cycles.collecting) {
+    collect_slice();
+  }
+}
+
+void tspp_weak_retain(void *object) {
+  if (object) {
+    tspp_shared_header *header = shared_header(object);
+    count_add(header, &header->weak);
+  }
+}
+
+void tspp_weak_release(void *object) {
+  if (!object) {
+    return;
+  }
+  tspp_shared_header *header = shared_header(object);
+  if (count_sub(header, &header->weak) == 0) {
+    tspp_free((char *)object - header->offset);
+  }
+}
+
+void *tspp_weak_lock(void *object) {
+  if (!object) {
+    return NULL;
+  }
+  tspp_shared_header *header = shared_header(object);
+  if (!__atomic_load_n(&header->atomic, __ATOMIC_RELAXED)) {
+    if (header->strong == 0) {
+      return NULL;
+    }
+    ++header->strong;
+    return object;
+  }
+
+  /* Only take a reference while another one keeps the object alive */
+  uint32_t strong = __atomic_load_n(&header->strong, __ATOMIC_RELAXED);
+  do {
+    if (strong == 0) {
+      return NULL;
+    }
+  } while (!__atomic_compare_exchange_n(&header->strong, &strong, strong + 1,
+                                        1, __ATOMIC_ACQUIRE,
+                                        __ATOMIC_RELAXED));
+  return object;
+}
+
+/* Starts a failure report; output written so far goes out first */
+static void begin_failure(const tspp_check_site *site) {
+  tspp_flush();
+  fputs("tspp: ", stderr);
+  if (site) {
+    fprintf(stderr, "%s:%d:%d: ", site->file, (int)site->line,
+            (int)site->column);
+  }
+}
+
+void tspp_bounds_fail(int32_t index, int32_t length,
+                      const tspp_check_site *site) {
+  begin_failure(site);
+  fprintf(stderr, "index %d is out of bounds for length %d\n", (int)index,
+          (int)length);
+  abort();
+}
+
+void tspp_runtime_fail(const char *message, const tspp_check_site *site) {
+  begin_failure(site);
+  fprintf(stderr, "%s\n", message);
+  abort();
+}
@@ -0,0 +1,711 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @file tspp_runtime.h
+ * @brief Runtime support linked into every tspp program
+ *
+ * Written in C so generated executables link it with a plain C driver and
+ * no C++ runtime. Sizes are uint64_t, the i64 the compiler passes on every
+ * target, so the same calls link on wasm32, where size_t is 32 bits.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Allocates an object for new and #heap storage
+ *
+ * Small requests are served from thread-local free lists, one per size
+ * class, carved out of 64 KiB slabs. Larger or more strictly aligned
+ * requests go to the C allocator. Setting TSPP_ALLOC=system in the
+ * environment sends every request to the C allocator, which lets leak
+ * checkers track individual objects.
+ *
+ * @param size Object size in bytes
+ * @param align Required alignment, a power of two
+ * @return The object, or NULL when out of memory
+ */
+void *tspp_alloc(uint64_t size, uint64_t align);
+
+/**
+ * @brief Releases an object returned by tspp_alloc
+ *
+ * The block joins the calling thread's free list for its size class, so
+ * objects may be freed on a thread other than the one that allocated them.
+ *
+ * @param ptr The object, or NULL
+ */
+void tspp_free(void *ptr);
+
+/**
+ * @brief Objects allocated by the new expressions of an #arena block
+ */
+typedef struct tspp_arena tspp_arena;
+
+/**
+ * @brief Opens an arena; until it is closed, tspp_new() on this thread
+ * allocates from it by bumping a pointer
+ *
+ * Arenas nest. Blocks in an arena may be passed to tspp_free(), which
+ * ignores them.
+ *
+ * @return The arena, or NULL when out of memory or with TSPP_ALLOC=system,
+ *         in which case tspp_new() keeps allocating from the heap
+ */
+tspp_arena *tspp_arena_enter(void);
+
+/**
+ * @brief Closes the innermost arena, releasing every object in it at once
+ * @param arena The arena tspp_arena_enter() returned, or NULL
+ */
+void tspp_arena_exit(tspp_arena *arena);
+
+/**
+ * @brief Allocates the object of a new expression
+ *
+ * Comes from the calling thread's innermost open arena, if any, and
+ * otherwise from tspp_alloc().
+ *
+ * @param size Object size in bytes
+ * @param align Required alignment, a power of two
+ * @return The object, or NULL when out of memory
+ */
+void *tspp_new(uint64_t size, uint64_t align);
+
+/**
+ * @brief Gets how many objects the calling thread has allocated
+ *
+ * Counts every tspp_alloc() and every tspp_new() served by an arena, and
+ * only ever grows; the #bench runner reads it before and after a run.
+ */
+uint64_t tspp_alloc_count(void);
+
+/**
+ * @brief Where a class keeps its #shared and #weak fields
+ *
+ * Emitted by the code generator for each class a #shared object is made
+ * of. Fields are released when the object dies, and the cycle collector
+ * follows the #shared ones.
+ */
+typedef struct tspp_shared_type {
+  uint32_t shared_count;   /* #shared fields, first in offsets */
+  uint32_t weak_count;     /* #weak fields, after them */
+  const uint32_t *offsets; /* Byte offset of each field in the object */
+} tspp_shared_type;
+
+/**
+ * @brief Allocates an object owned by #shared pointers
+ *
+ * The object starts with one strong reference. Counts live in a header
+ * just before it and are updated with plain arithmetic until the object
+ * is published.
+ *
+ * @param size Object size in bytes
+ * @param align Required alignment, a power of two
+ * @param type The object's counted fields, or NULL if it has none
+ * @return The object, or NULL when out of memory
+ */
+void *tspp_shared_alloc(uint64_t size, uint64_t align,
+                        const tspp_shared_type *type);
+
+/**
+ * @brief Switches an object to atomic reference counting
+ *
+ * Called when a #shared or #weak pointer is stored where other threads can
+ * reach it. Must run before the first other thread sees the object. The
+ * objects its fields refer to are published with it, so an object stored
+ * in a field of a published object must be published first.
+ *
+ * @param object A tspp_shared_alloc object, or NULL
+ */
+void tspp_shared_publish(void *object);
+
+/** @brief Adds a strong reference; NULL is ignored */
+void tspp_shared_retain(void *object);
+
+/**
+ * @brief Drops a strong reference; NULL is ignored
+ *
+ * An object that loses its last reference releases its fields. One that
+ * keeps some may be garbage in a cycle: unpublished objects with #shared
+ * fields become candidate roots of the calling thread's cycle collector,
+ * which runs a slice whenever enough candidates are buffered.
+ */
+void tspp_shared_release(void *object);
+
+/**
+ * @brief Collects the calling thread's garbage cycles
+ *
+ * Runs the collector's slices until no candidate root is left. Cycles
+ * through published objects are not collected.
+ */
+void tspp_shared_collect(void);
+
+/** @brief Adds a weak reference; NULL is ignored */
+void tspp_weak_retain(void *object);
+
+/** @brief Drops a weak reference; NULL is ignored */
+void tspp_weak_release(void *object);
+
+/**
+ * @brief Turns a weak reference into a strong one
+ * @param object Object held by a #weak pointer, or NULL
+ * @return The object with a new strong reference, or NULL if it has died
+ */
+void *tspp_weak_lock(void *object);
+
+/**
+ * Strings shorter than this are stored inside the string value: in the
+ * data pointer and the capacity that follows it, or with 32-bit pointers,
+ * which leave a gap before the capacity, in the pointer alone
+ */
+#define TSPP_STRING_SMALL ((int)(sizeof(void *) == 8 ? 16 : sizeof(void *)))
+
+/**
+ * @brief Value of a tspp string
+ *
+ * The length comes first so that short strings can keep their bytes,
+ * NUL-terminated, in the 16 bytes that follow it; those strings never
+ * allocate. Longer strings point at NUL-terminated bytes, which are a
+ * literal's constant when capacity is 0 and a tspp_alloc block otherwise.
+ * Strings are immutable, so copies share their bytes.
+ */
+typedef struct tspp_string {
+  int64_t length; /* Bytes, without the terminating NUL */
+  union {
+    char small[TSPP_STRING_SMALL]; /* length < TSPP_STRING_SMALL */
+    struct {
+      const char *data;
+      int64_t capacity; /* Bytes allocated for data, 0 if not owned */
+    } large;
+  } bytes;
+} tspp_string;
+
+/**
+ * @brief Gets the NUL-terminated bytes of a string
+ * @param string The string; short strings are read in place
+ */
+const char *tspp_string_data(const tspp_string *string);
+
+/**
+ * @brief Concatenates strings with a single allocation
+ *
+ * The compiler collects a whole chain such as a + b + c + d into one
+ * call, so no intermediate strings are built. A short result allocates
+ * nothing.
+ *
+ * @param result Receives the concatenation
+ * @param parts The strings to join, in order
+ * @param count Number of parts
+ */
+void tspp_string_concat(tspp_string *result, const tspp_string *parts,
+                        int32_t count);
+
+/**
+ * @brief Compares two strings byte by byte
+ * @return 1 if they are equal, 0 otherwise; lengths are compared first
+ */
+int32_t tspp_string_equals(const tspp_string *a, const tspp_string *b);
+
+/**
+ * @brief Frees the bytes of a string that owns them
+ *
+ * Emitted where a string local goes out of scope or is overwritten,
+ * unless its value was copied somewhere that may outlive it.
+ *
+ * @param string The string
+ */
+void tspp_string_free(tspp_string *string);
+
+/**
+ * @brief Value of a growable array, T[]
+ *
+ * Elements are stored unboxed and contiguously. Array values are copied
+ * shallowly: copies share their elements until one of them grows, which
+ * moves its elements to a new block and frees the old one.
+ */
+typedef struct tspp_array {
+  void *data;       /* The elements, a tspp_alloc block */
+  int64_t length;   /* Elements in use */
+  int64_t capacity; /* Elements allocated; 0 when data is not owned */
+} tspp_array;
+
+/**
+ * @brief Makes room for one more element
+ *
+ * The capacity doubles, so a sequence of pushes copies each element a
+ * constant number of times on average.
+ *
+ * @param array The full array
+ * @param element_size Size of an element in bytes
+ * @param align Alignment of an element
+ */
+void tspp_array_grow(tspp_array *array, int64_t element_size, int64_t align);
+
+/**
+ * @brief Allocates room for at least capacity elements up front
+ *
+ * Does nothing if the array already has the room, so a loop of pushes
+ * that follows never reallocates.
+ *
+ * @param array The array
+ * @param capacity Number of elements to make room for
+ * @param element_size Size of an element in bytes
+ * @param align Alignment of an element
+ */
+void tspp_array_reserve(tspp_array *array, int64_t capacity,
+                        int64_t element_size, int64_t align);
+
+/**
+ * @brief Frees the elements of an array that owns them
+ *
+ * Emitted where a T[] local goes out of scope or is overwritten, unless
+ * its value was copied somewhere that may outlive it. An array with a
+ * capacity of 0 does not own its elements and is left alone.
+ *
+ * @param array The array
+ */
+void tspp_array_free(tspp_array *array);
+
+/**
+ * @brief Where a runtime check is in the source
+ *
+ * Emitted as a constant per check; the failure path passes its address,
+ * which is only read once the check has failed.
+ */
+typedef struct tspp_check_site {
+  const char *file; /* Source file */
+  int32_t line;
+  int32_t column;
+} tspp_check_site;
+
+/**
+ * @brief Reports an array index outside 0..length-1 and aborts
+ *
+ * Called from the cold branch of the bounds check on each array access
+ * the compiler could not prove safe.
+ *
+ * @param site The access, or NULL if it is not known
+ */
+void tspp_bounds_fail(int32_t index, int32_t length,
+                      const tspp_check_site *site) __attribute__((noreturn));
+
+/**
+ * @brief Reports a failed runtime check and aborts
+ *
+ * The cold branch of every other check calls this one function, so a
+ * check costs its compare and a branch on the hot path.
+ *
+ * @param message What went wrong
+ * @param site The check, or NULL if it is not known
+ */
+void tspp_runtime_fail(const char *message, const tspp_check_site *site)
+    __attribute__((noreturn));
+
+/**
+ * @brief Identifies the type of a thrown value
+ *
+ * Emitted once per class or primitive type as a constant named
+ * Type.typeinfo. A handler for a class also catches the classes derived
+ * from it.
+ */
+typedef struct tspp_type_info {
+  const struct tspp_type_info *base; /* Typeinfo of the base class, or NULL */
+  const char *name;                  /* Source name of the type */
+} tspp_type_info;
+
+/**
+ * @brief Throws a copy of a value
+ *
+ * Unwinds through the generated code's landing pads with the system
+ * unwinder; code that does not throw runs no extra instructions. An
+ * exception no handler catches is reported and aborts the program.
+ *
+ * @param type Typeinfo of the value
+ * @param value The value, copied into the exception
+ * @param size Size of the value in bytes
+ */
+void tspp_throw(const tspp_type_info *type, const void *value, uint64_t size)
+    __attribute__((noreturn));
+
+/**
+ * @brief Takes the value out of a caught exception and releases it
+ * @param exception The exception pointer delivered to the landing pad
+ * @param value Receives up to size bytes of the thrown value
+ * @param size Size of the handler's parameter, 0 if it has none
+ */
+void tspp_catch(void *exception, void *value, uint64_t size);
+
+/**
+ * @brief Personality routine of functions with landing pads
+ *
+ * Reads the call-site and action tables the compiler emits and selects
+ * the first catch clause whose type matches the exception. Exceptions
+ * thrown by other languages only run cleanups.
+ */
+int tspp_personality(int version, int actions, uint64_t exception_class,
+                     void *exception, void *context);
+
+/**
+ * @brief Tests the host for instruction sets
+ *
+ * Multiversioned functions call this once, on their first call, to pick
+ * the version to run.
+ *
+ * @param features Comma-separated LLVM feature names, such as "avx2,fma"
+ * @return 1 if the host supports every feature, 0 otherwise
+ */
+int tspp_cpu_supports(const char *features);
+
+/**
+ * @brief Appends bytes to standard output
+ *
+ * Output collects in a 64 KiB buffer per thread and reaches the file
+ * descriptor in one write when the buffer fills, when the thread ends,
+ * at exit, or on tspp_flush(). Writes larger than the buffer bypass it.
+ *
+ * @param data The bytes
+ * @param size Number of bytes
+ */
+void tspp_write(const char *data, uint64_t size);
+
+/** @brief Appends the decimal form of an integer to standard output */
+void tspp_write_int(int64_t value);
+
+/**
+ * @brief Appends a floating-point value to standard output
+ *
+ * Uses the shortest decimal form that reads back as the same double;
+ * infinities and NaNs print as inf, -inf and nan.
+ */
+void tspp_write_float(double value);
+
+/**
+ * @brief Writes out the calling thread's buffered output
+ *
+ * Output the C library buffered for stdout goes first, so text printed
+ * through either reaches the descriptor in order.
+ */
+void tspp_flush(void);
+
+/**
+ * @brief Value of a bytes slice: a read-only view that owns nothing
+ */
+typedef struct tspp_bytes {
+  const uint8_t *data; /* The first byte viewed */
+  int64_t length;      /* Bytes viewed */
+} tspp_bytes;
+
+/**
+ * @brief Maps a whole file into memory, read-only
+ *
+ * The pages are shared with the page cache, so nothing is copied and only
+ * the pages read are loaded. The mapping is advised for sequential reads.
+ *
+ * @param result Receives the view; empty if the file cannot be opened or
+ *        mapped, or is empty
+ * @param path Path of the file
+ */
+void tspp_map_file(tspp_bytes *result, const tspp_string *path);
+
+/**
+ * @brief Releases a mapping made by tspp_map_file
+ * @param data The view's first byte; NULL does nothing
+ * @param length The view's length
+ */
+void tspp_unmap_file(const uint8_t *data, int64_t length);
+
+/**
+ * @brief Start of the promise of every async function
+ *
+ * An async function compiles to a coroutine whose frame holds this header
+ * followed by its result. Tasks run on the thread that starts them, and
+ * are resumed by that thread's executor, which waits on timers and on
+ * descriptors once no task is ready. Descriptor waits go through an
+ * io_uring: they are queued in memory shared with the kernel and submitted
+ * together, with the wait for their completions, in one system call. Where
+ * io_uring is unavailable, or TSPP_IO=epoll is set, epoll is used instead.
+ */
+typedef struct tspp_task {
+  void *continuation; /* Coroutine awaiting this one, or NULL */
+  int32_t detached;   /* Nobody awaits the task; it frees itself */
+} tspp_task;
+
+/** @brief Events tspp_async_wait_fd() waits for */
+#define TSPP_WAIT_READABLE 1
+#define TSPP_WAIT_WRITABLE 2
+
+/**
+ * @brief Called by a task that has finished
+ *
+ * Schedules the coroutine awaiting the task, if any.
+ *
+ * @param task The task's promise
+ * @return Nonzero when the task is detached and must free its frame
+ * instead of suspending
+ */
+int tspp_task_complete(tspp_task *task);
+
+/**
+ * @brief Lets a task run on without anyone awaiting it
+ *
+ * Called for an async call made without await inside an async function.
+ * A task that already finished is destroyed.
+ *
+ * @param handle The task's coroutine
+ * @param task Its promise
+ */
+void tspp_task_spawn(void *handle, tspp_task *task);
+
+/**
+ * @brief Runs the executor until a task finishes
+ *
+ * Called for an async call made outside any async function; other tasks
+ * run too while it waits. The caller reads the result and destroys the
+ * coroutine. Aborts when nothing is left that could resume a task.
+ *
+ * @param handle The task's coroutine
+ */
+void tspp_task_run(void *handle);
+
+/**
+ * @brief Resumes a coroutine once a delay has passed
+ *
+ * Coroutines due at the same time resume in the order they slept.
+ *
+ * @param handle The coroutine, which suspends next; NULL runs other tasks
+ * until the delay has passed, then returns
+ * @param millis Delay in milliseconds; negative ones count as 0
+ */
+void tspp_async_sleep(void *handle, int32_t millis);
+
+/**
+ * @brief Resumes a coroutine once a descriptor is ready
+ *
+ * One task at a time may wait on a descriptor. Regular files are always
+ * ready.
+ *
+ * @param handle The coroutine, which suspends next; NULL runs other tasks
+ * until the descriptor is ready, then returns
+ * @param fd The descriptor
+ * @param events TSPP_WAIT_READABLE, TSPP_WAIT_WRITABLE or both
+ */
+void tspp_async_wait_fd(void *handle, int32_t fd, int32_t events);
+
+/** @brief Runs iterations [begin, end) of a #parallel loop's body */
+typedef void (*tspp_parallel_body)(void *env, int32_t begin, int32_t end);
+
+/**
+ * @brief Runs the iterations of a #parallel loop across the cores
+ *
+ * A pool of worker threads, one per core the process may use or
+ * TSPP_WORKERS if set, starts with the first loop. On Linux each worker is
+ * pinned to a core, filling one NUMA node before the next, unless
+ * TSPP_AFFINITY=none. Each worker is posted an equal, contiguous block of
+ * the iterations, so the same worker runs the same block in loops of the
+ * same length. A block is split into about eight chunks, which idle
+ * workers steal from busy ones, on their own node first. The calling
+ * thread works too, and returns once every iteration is done. Loops may
+ * nest.
+ *
+ * @param body The outlined loop body
+ * @param env The body's view of the caller's variables
+ * @param count Number of iterations; none run unless it is positive
+ */
+void tspp_parallel_for(tspp_parallel_body body, void *env, int32_t count);
+
+/**
+ * @brief Reports an exception that escaped a #parallel loop iteration and
+ * aborts; iterations may run on threads it cannot unwind to
+ */
+void tspp_parallel_uncaught(void) __attribute__((noreturn));
+
+/**
+ * @brief Places the slabs the calling thread allocates from now on on a
+ * NUMA node, or wherever it runs for -1; for the #parallel workers
+ */
+void tspp_set_thread_node(int node);
+
+/**
+ * @brief Bounded queue any number of threads push to and pop from
+ *
+ * Each cell carries a sequence number, so threads claim cells with a
+ * compare-and-swap and never wait on one another; only a full or empty
+ * queue makes push or pop wait.
+ */
+typedef struct tspp_mpmc tspp_mpmc;
+
+/**
+ * @brief Creates an MPMC queue; it is never freed
+ * @param capacity Elements it holds, rounded up to a power of two
+ * @param element_size Bytes copied per element
+ * @param align The element type's alignment, a power of two
+ */
+tspp_mpmc *tspp_mpmc_new(int64_t capacity, int64_t element_size,
+                         int64_t align);
+
+/** @brief Copies an element in; returns 0 if the queue is full */
+int32_t tspp_mpmc_try_push(tspp_mpmc *queue, const void *element);
+
+/** @brief Copies the oldest element out; returns 0 if the queue is empty */
+int32_t tspp_mpmc_try_pop(tspp_mpmc *queue, void *element);
+
+/** @brief Copies an element in, waiting while the queue is full */
+void tspp_mpmc_push(tspp_mpmc *queue, const void *element);
+
+/** @brief Copies the oldest element out, waiting while the queue is empty */
+void tspp_mpmc_pop(tspp_mpmc *queue, void *element);
+
+/**
+ * @brief Bounded queue with one pushing thread and one popping thread
+ *
+ * Cheaper than tspp_mpmc: each side writes only its own index. Pushing or
+ * popping from two threads at once corrupts it.
+ */
+typedef struct tspp_spsc tspp_spsc;
+
+/** @brief Creates an SPSC queue; see tspp_mpmc_new() */
+tspp_spsc *tspp_spsc_new(int64_t capacity, int64_t element_size,
+                         int64_t align);
+
+/** @brief Copies an element in; returns 0 if the queue is full */
+int32_t tspp_spsc_try_push(tspp_spsc *queue, const void *element);
+
+/** @brief Copies the oldest element out; returns 0 if the queue is empty */
+int32_t tspp_spsc_try_pop(tspp_spsc *queue, void *element);
+
+/** @brief Copies an element in, waiting while the queue is full */
+void tspp_spsc_push(tspp_spsc *queue, const void *element);
+
+/** @brief Copies the oldest element out, waiting while the queue is empty */
+void tspp_spsc_pop(tspp_spsc *queue, void *element);
+
+/**
+ * @brief Hash map from 64-bit keys that threads share
+ *
+ * Keys hash to one of 64 shards, each an open-addressed table with its own
+ * spinlock, so threads working on different keys seldom contend.
+ */
+typedef struct tspp_map tspp_map;
+
+/**
+ * @brief Creates an empty map; it is never freed
+ * @param value_size Bytes copied per value
+ * @param align The value type's alignment, a power of two
+ */
+tspp_map *tspp_map_new(int64_t value_size, int64_t align);
+
+/** @brief Copies a value in, replacing any the key had */
+void tspp_map_put(tspp_map *map, int64_t key, const void *value);
+
+/**
+ * @brief Looks a key up
+ * @param value Receives a copy of the key's value if found; may be NULL
+ * @return 1 if the key was present, else 0
+ */
+int32_t tspp_map_get(tspp_map *map, int64_t key, void *value);
+
+/** @brief Removes a key; returns 0 if it was absent */
+int32_t tspp_map_remove(tspp_map *map, int64_t key);
+
+/**
+ * @brief Counts the keys; puts and removes that race with it may or may
+ * not be counted
+ */
+int64_t tspp_map_size(tspp_map *map);
+
+/**
+ * @brief Counters of a module compiled with -instrument=
+ *
+ * Every thread counts function entries and loop iterations in
+ * thread-local counters of its own. The module registers this table
+ * before main; the runtime adds a #parallel worker's counts to the totals
+ * after each chunk it runs, and the calling thread's at exit, when it
+ * writes all sites with a nonzero total, most frequent first, to
+ * TSPP_COUNTERS_FILE (tspp.counters by default).
+ */
+typedef struct tspp_counters {
+  int64_t count;              /* Counted sites */
+  uint64_t *totals;           /* Flushed counts, per site */
+  const char *const *sites;   /* "file:line:column kind name", per site */
+  void (*flush)(void);        /* Adds the calling thread's counts to totals */
+  struct tspp_counters *next; /* Next registered table */
+} tspp_counters;
+
+/** @brief Adds a module's counters to those written at exit */
+void tspp_counters_register(tspp_counters *counters);
+
+/** @brief Adds the calling thread's counts to every module's totals */
+void tspp_counters_flush(void);
+
+/**
+ * @brief Writes the totals now and forgets every table, so exit writes
+ * nothing; for the JIT, which frees the tables before exit
+ */
+void tspp_counters_write(void);
+
+/**
+ * @brief A new expression of a module compiled with -alloc-profile
+ */
+typedef struct tspp_alloc_site {
+  const char *function; /* Function holding the expression */
+  const char *file;     /* Source file */
+  const char *type;     /* Class of the objects */
+  int32_t line;
+  int32_t column;
+  uint64_t size; /* Bytes of each object */
+} tspp_alloc_site;
+
+/**
+ * @brief tspp_new for a profiled new expression
+ *
+ * Counts the object against its site in a table of the calling thread.
+ * Heap objects are stamped, in a prefix, with the site and the time, so
+ * tspp_free() can record how long they lived. Objects of #arena blocks,
+ * and every object with TSPP_ALLOC=system, are counted but not stamped;
+ * they are never in use in the profile.
+ *
+ * The tables are merged when they fill, after each chunk a #parallel
+ * worker runs, when a thread exits and at exit, which writes a pprof
+ * profile to TSPP_ALLOC_PROFILE_FILE (tspp.alloc.pprof by default). Its
+ * sample types are alloc_objects, alloc_space, inuse_objects, inuse_space
+ * and lifetime, the total nanoseconds the freed objects lived.
+ *
+ * @param site The expression; outlives the program's allocations
+ */
+void *tspp_new_at(uint64_t size, uint64_t align, const tspp_alloc_site *site);
+
+/** @brief tspp_shared_alloc for a profiled new expression */
+void *tspp_shared_alloc_at(uint64_t size, uint64_t align,
+                           const tspp_shared_type *type,
+                           const tspp_alloc_site *site);
+
+/** @brief Adds the calling thread's allocation table to the totals */
+void tspp_alloc_profile_flush(void);
+
+/**
+ * @brief Writes the allocation profile now and starts it over, so exit
+ * writes nothing; for the JIT, which frees the sites before exit
+ */
+void tspp_alloc_profile_write(void);
+
+/**
+ * @brief Counts an allocation at a site; for the allocator
+ * @param scoped Whether the object is released with its #arena rather
+ *        than by tspp_free()
+ */
+void tspp_alloc_profile_record(const tspp_alloc_site *site, int scoped);
+
+/**
+ * @brief Counts the release of a stamped object; for the allocator
+ * @param lifetime Nanoseconds since it was allocated
+ */
+void tspp_alloc_profile_release(const tspp_alloc_site *site,
+                                uint64_t lifetime);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,58 @@
+#include "runtime/tspp_runtime.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+_Static_assert(sizeof(tspp_string) == 24, "the compiler emits { i64, i8*, i64 }");
+
+const char *tspp_string_data(const tspp_string *string) {
+  return string->length < TSPP_STRING_SMALL ? string->bytes.small
+                                            : string->bytes.large.data;
+}
+
+void tspp_string_concat(tspp_string *result, const tspp_string *parts,
+                        int32_t count) {
+  int64_t length = 0;
+  for (int32_t i = 0; i < count; ++i) {
+    length += parts[i].length;
+  }
+
+  /* Short results are built in place; longer ones get one exact block */
+  char *out = result->bytes.small;
+  if (length >= TSPP_STRING_SMALL) {
+    out = tspp_alloc((size_t)length + 1, 1);
+    if (!out) {
+      fputs("tspp: out of memory while concatenating strings\n", stderr);
+      abort();
+    }
+  }
+  /* Parts may alias the result, so copy them before it is overwritten */
+  char small[TSPP_STRING_SMALL];
+  char *cursor = out == result->bytes.small ? small : out;
+  for (int32_t i = 0; i < count; ++i) {
+    memcpy(cursor, tspp_string_data(&parts[i]), (size_t)parts[i].length);
+    cursor += parts[i].length;
+  }
+  *cursor = '\0';
+
+  if (out == result->bytes.small) {
+    memcpy(result->bytes.small, small, sizeof(small));
+  } else {
+    result->bytes.large.data = out;
+    result->bytes.large.capacity = length + 1;
+  }
+  result->length = length;
+}
+
+void tspp_string_free(tspp_string *string) {
+  if (string->length >= TSPP_STRING_SMALL &&
+      string->bytes.large.capacity != 0) {
+    tspp_free((void *)string->bytes.large.data);
+  }
+}
+
+int32_t tspp_string_equals(const tspp_string *a, const tspp_string *b) {
+  return a->length == b->length &&
+         memcmp(tspp_string_data(a), tspp_string_data(b),
+                (size_t)a->length) == 0;
+}
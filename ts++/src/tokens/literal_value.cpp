@@ -0,0 +1,146 @@
+/*****************************************************************************
+ * File: literal_value.cpp
+ * Description: Number parsing and escape decoding for literal lexemes
+ *****************************************************************************/
+
+#include "literal_value.h"
+#include <charconv>
+
+namespace tokens {
+
+namespace {
+
+int hexDigit(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  c = static_cast<char>(c | 0x20);
+  return c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+}
+
+// Value of count hex digits at text[i], or -1 if there are not as many
+long hexValue(std::string_view text, size_t i, int count) {
+  if (i + count > text.size()) {
+    return -1;
+  }
+  long value = 0;
+  for (int d = 0; d < count; ++d) {
+    int digit = hexDigit(text[i + d]);
+    if (digit < 0) {
+      return -1;
+    }
+    value = value * 16 + digit;
+  }
+  return value;
+}
+
+void appendUTF8(unsigned long code, std::string &out) {
+  if (code < 0x80) {
+    out += static_cast<char>(code);
+  } else if (code < 0x800) {
+    out += static_cast<char>(0xC0 | (code >> 6));
+    out += static_cast<char>(0x80 | (code & 0x3F));
+  } else {
+    out += static_cast<char>(0xE0 | (code >> 12));
+    out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+    out += static_cast<char>(0x80 | (code & 0x3F));
+  }
+}
+
+} // namespace
+
+NumberValue decodeNumber(std::string_view lexeme) {
+  // Underscores are copied out; literals long enough not to fit are
+  // rejected rather than allocated for
+  char digits[128];
+  if (lexeme.find('_') != std::string_view::npos) {
+    size_t length = 0;
+    for (char c : lexeme) {
+      if (c == '_') {
+        continue;
+      }
+      if (length == sizeof(digits)) {
+        return NumberValue();
+      }
+      digits[length++] = c;
+    }
+    lexeme = std::string_view(digits, length);
+  }
+
+  int base = 10;
+  if (lexeme.size() > 2 && lexeme[0] == '0' &&
+      (lexeme[1] == 'x' || lexeme[1] == 'X')) {
+    base = 16;
+  } else if (lexeme.size() > 2 && lexeme[0] == '0' &&
+             (lexeme[1] == 'b' || lexeme[1] == 'B')) {
+    base = 2;
+  }
+  const char *begin = lexeme.data() + (base == 10 ? 0 : 2);
+  const char *end = lexeme.data() + lexeme.size();
+
+  NumberValue value;
+  std::from_chars_result result;
+  if (base == 10 && lexeme.find_first_of(".eE") != std::string_view::npos) {
+    result = std::from_chars(begin, end, value.real);
+    value.kind = NumberValue::Kind::Float;
+  } else {
+    result = std::from_chars(begin, end, value.integer, base);
+    value.kind = NumberValue::Kind::Integer;
+  }
+  if (result.ec != std::errc() || result.ptr != end || begin == end) {
+    return NumberValue();
+  }
+  return value;
+}
+
+void appendUnescaped(std::string_view body, std::string &out) {
+  out.reserve(out.size() + body.size());
+  for (size_t i = 0; i < body.size(); ++i) {
+    if (body[i] != '\\' || i + 1 == body.size()) {
+      out += body[i];
+      continue;
+    }
+    long code = -1;
+    switch (body[i + 1]) {
+    case 'n':
+      out += '\n';
+      break;
+    case 'r':
+      out += '\r';
+      break;
+    case 't':
+      out += '\t';
+      break;
+    case '0':
+      out += '\0';
+      break;
+    case '\\':
+    case '\'':
+    case '"':
+      out += body[i + 1];
+      break;
+    case 'x':
+      if ((code = hexValue(body, i + 2, 2)) >= 0) {
+        out += static_cast<char>(code);
+        i += 2;
+        break;
+      }
+      out += body[i];
+      continue;
+    case 'u':
+      if ((code = hexValue(body, i + 2, 4)) >= 0) {
+        appendUTF8(static_cast<unsigned long>(code), out);
+        i += 4;
+        break;
+      }
+      out += body[i];
+      continue;
+    default:
+      out += body[i];
+      continue;
+    }
+    ++i;
+  }
+}
+
+} // namespace tokens
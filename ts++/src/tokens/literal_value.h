@@ -0,0 +1,52 @@
+/*****************************************************************************
+ * File: literal_value.h
+ * Description: Decodes the values of number and string literal lexemes
+ *****************************************************************************/
+
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace tokens {
+
+/**
+ * @brief Value of a number literal
+ *
+ * A fraction or exponent makes a float, unless the number is hexadecimal;
+ * 0x and 0b prefixes give integers in base 16 and 2. Underscores between
+ * digits are ignored.
+ */
+struct NumberValue {
+  enum class Kind : std::uint8_t {
+    Integer,
+    Float,
+    Invalid // Malformed, or out of range
+  };
+
+  Kind kind = Kind::Invalid;
+  std::uint64_t integer = 0; ///< Value of an Integer
+  double real = 0;           ///< Value of a Float
+
+  bool isInteger() const { return kind == Kind::Integer; }
+  bool isFloat() const { return kind == Kind::Float; }
+  bool isValid() const { return kind != Kind::Invalid; }
+};
+
+/**
+ * @brief Parses a NUMBER lexeme with std::from_chars, without allocating
+ */
+NumberValue decodeNumber(std::string_view lexeme);
+
+/**
+ * @brief Appends the characters a string literal's body stands for
+ *
+ * Resolves the escapes the lexer accepts: \n \r \t \0 \\ \' \", \xHH as a
+ * byte and \uHHHH as UTF-8. Any other backslash is kept as written.
+ *
+ * @param body The literal without its quotes
+ * @param out Buffer the characters are appended to
+ */
+void appendUnescaped(std::string_view body, std::string &out);
+
+} // namespace tokens
@@ -6,10 +6,20 @@
 
 #include "token_stream.h"
 #include "core/common/common_types.h"
+#include <algorithm>
+#include <cassert>
 #include <iostream>
 
 namespace tokens {
 
+namespace {
+
+// Consumed tokens a pulled stream keeps, for previous() and for callers
+// that hold a reference to a token across a few advances
+constexpr size_t kKeptHistory = 16;
+
+} // namespace
+
 /*****************************************************************************
  * Constructor Implementation
  *****************************************************************************/
@@ -17,23 +27,49 @@ TokenStream::TokenStream(std::vector<Token> tokens)
     : tokens_(std::move(tokens)), current_(0) {
   // Safety: Ensure stream always ends with EOF token
   if (tokens_.empty() || tokens_.back().getType() != TokenType::END_OF_FILE) {
-    tokens_.push_back(
-        Token(TokenType::END_OF_FILE, "", core::SourceLocation(0, 0)));
+    tokens_.push_back(Token::createSynthetic(TokenType::END_OF_FILE,
+                                             core::INVALID_FILE_ID, 0));
   }
 }
 
+TokenStream::TokenStream(TokenSource source)
+    : current_(0), source_(std::move(source)) {}
+
 /*****************************************************************************
  * Token Access Methods
  *****************************************************************************/
 
-const Token &TokenStream::peek() const {
-  // If at end or beyond, return the EOF token
-  if (current_ >= tokens_.size() ||
-      (current_ < tokens_.size() &&
-       tokens_[current_].getType() == TokenType::END_OF_FILE)) {
-    return tokens_.back();
+const Token &TokenStream::at(size_t position) const {
+  if (!source_) {
+    return tokens_[std::min(position, tokens_.size() - 1)];
+  }
+
+  // Pull up to the position; the last token pulled is the EOF token
+  while (!exhausted_ && base_ + window_.size() <= position) {
+    window_.push_back(source_());
+    exhausted_ = window_.back().getType() == TokenType::END_OF_FILE;
   }
-  return tokens_[current_];
+  assert(position >= base_ && "Token was dropped from the stream's window");
+  return window_[std::min(position - base_, window_.size() - 1)];
+}
+
+void TokenStream::trim() {
+  if (!source_) {
+    return;
+  }
+  size_t keep = current_ > kKeptHistory ? current_ - kKeptHistory : 0;
+  for (size_t position : saved_) {
+    keep = std::min(keep, position);
+  }
+  while (base_ < keep && window_.size() > 1) {
+    window_.pop_front();
+    ++base_;
+  }
+}
+
+const Token &TokenStream::peek() const {
+  // At or beyond the end this is the EOF token
+  return at(current_);
 }
 
 const Token &TokenStream::peekNext(int n) const {
@@ -42,32 +78,24 @@ const Token &TokenStream::peekNext(int n) const {
     n = 1;
   }
   // Return EOF token if next position beyond stream bounds
-  if (current_ + n >= tokens_.size()) {
-    return tokens_.back();
-  }
-  return tokens_[current_ + n];
+  return at(current_ + n);
 }
 
 const Token &TokenStream::previous() const {
-  // Handle boundary cases
-  if (current_ <= 0) {
-    return tokens_[0]; // At start: return first token
-  }
-  if (current_ >= tokens_.size()) {
-    return tokens_[tokens_.size() - 2]; // Return last real token, not EOF
-  }
-  return tokens_[current_ - 1];
+  // At start: return first token
+  return at(current_ == 0 ? 0 : current_ - 1);
 }
 
 Token TokenStream::advance() {
   // If already at end, don't advance further
   if (isAtEnd()) {
-    return tokens_.back();
+    return peek();
   }
 
   // Otherwise, move forward and return the token we were at
-  Token token = tokens_[current_];
+  Token token = at(current_);
   current_++;
+  trim();
   return token;
 }
 
@@ -76,21 +104,18 @@ Token TokenStream::advance() {
  *****************************************************************************/
 
 bool TokenStream::isAtEnd() const {
-  // Simple end check: either we're at the EOF token or beyond bounds
-  return current_ >= tokens_.size() - 1 ||
-         (current_ < tokens_.size() &&
-          tokens_[current_].getType() == TokenType::END_OF_FILE);
+  // The EOF token ends the stream, so anything beyond reads as it too
+  return peek().getType() == TokenType::END_OF_FILE;
 }
 
 bool TokenStream::check(TokenType type) const {
-  // Explicitly check for EOF case
-  if (current_ >= tokens_.size()) {
-    return type == TokenType::END_OF_FILE;
-  }
-
   return peek().getType() == type;
 }
 
+bool TokenStream::checkAny(const TokenSet &types) const {
+  return types.contains(peek().getType());
+}
+
 bool TokenStream::match(TokenType type) {
   if (check(type)) {
     advance();
@@ -99,12 +124,10 @@ bool TokenStream::match(TokenType type) {
   return false;
 }
 
-bool TokenStream::matchAny(const std::vector<TokenType> &types) {
-  // Try to match any of the provided types
-  for (const auto &type : types) {
-    if (match(type)) {
-      return true;
-    }
+bool TokenStream::matchAny(const TokenSet &types) {
+  if (checkAny(types)) {
+    advance();
+    return true;
   }
   return false;
 }
@@ -113,21 +136,31 @@ bool TokenStream::matchAny(const std::vector<TokenType> &types) {
  * Position Management
  *****************************************************************************/
 void TokenStream::setPosition(size_t position) {
-  // Ensure position stays within valid bounds
-  if (position < tokens_.size() - 1) { // Subtract 1 to avoid EOF
+  // Ensure position stays within valid bounds, short of the EOF token
+  if (at(position).getType() != TokenType::END_OF_FILE) {
     current_ = position;
   } else {
-    current_ = tokens_.size() - 2; // Set to last real token, not EOF
+    size_t end = source_ ? base_ + window_.size() - 1 : tokens_.size() - 1;
+    current_ = end > 0 ? end - 1 : 0; // Set to last real token, not EOF
   }
+  trim();
 }
 
 size_t TokenStream::getCurrentPosition() const { return current_; }
 
-// New method: Save current position
-size_t TokenStream::savePosition() const { return current_; }
+size_t TokenStream::savePosition() {
+  saved_.push_back(current_);
+  return current_;
+}
 
-// New method: Restore saved position
-void TokenStream::restorePosition(size_t position) { setPosition(position); }
+void TokenStream::restorePosition(size_t position) {
+  // Release the most recent save of this position
+  auto it = std::find(saved_.rbegin(), saved_.rend(), position);
+  if (it != saved_.rend()) {
+    saved_.erase(std::next(it).base());
+  }
+  setPosition(position);
+}
 
 /*****************************************************************************
  * Error Recovery
@@ -148,6 +181,7 @@ void TokenStream::synchronize() {
     // Or at the start of major declarations/statements
     switch (peek().getType()) {
     case TokenType::FUNCTION:    // Function declaration
+    case TokenType::ASYNC:       // Async function declaration
     case TokenType::LET:         // Variable declaration
     case TokenType::FOR:         // For loop
     case TokenType::IF:          // If statement
@@ -161,11 +195,6 @@ void TokenStream::synchronize() {
   }
 }
 
-Token TokenStream::getCurrentToken() {
-  if (current_ < tokens_.size()) {
-    return tokens_[current_];
-  }
-  return tokens_.back(); // Return EOF if beyond bounds
-}
+Token TokenStream::getCurrentToken() { return peek(); }
 
 } // namespace tokens
\ No newline at end of file
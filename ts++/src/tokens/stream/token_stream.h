@@ -7,6 +7,8 @@
 
 #pragma once
 #include "../tokens.h"
+#include <deque>
+#include <functional>
 #include <vector>
 
 namespace tokens {
@@ -22,9 +24,21 @@ namespace tokens {
  * - Token type matching and pattern matching
  * - Error recovery through synchronization
  * - Position tracking and management
+ *
+ * A stream either holds every token of its input, or pulls them from a
+ * source as the parser reads them. A pulled stream keeps only a window:
+ * the tokens lexed ahead for lookahead, a few already consumed for
+ * previous(), and those from the oldest position still saved by
+ * savePosition(). Its memory does not grow with the input.
  */
 class TokenStream {
 public:
+  /**
+   * @brief Produces the tokens of a pulled stream one at a time
+   * @note Returns END_OF_FILE at the end of the input, and again after it
+   */
+  using TokenSource = std::function<Token()>;
+
   /**
    * @brief Constructs a token stream from a vector of tokens
    * @param tokens Vector of tokens to manage (takes ownership)
@@ -32,6 +46,12 @@ public:
    */
   explicit TokenStream(std::vector<Token> tokens);
 
+  /**
+   * @brief Constructs a stream that pulls its tokens when they are needed
+   * @param source Produces the next token
+   */
+  explicit TokenStream(TokenSource source);
+
   /**
    * @brief Peek at current token without consuming it
    * @return Reference to current token
@@ -75,10 +95,10 @@ public:
 
   /**
    * @brief Try to match current token against multiple types
-   * @param types Vector of TokenTypes to match against
+   * @param types Set of TokenTypes to match against
    * @return true if any type matched and token consumed
    */
-  bool matchAny(const std::vector<TokenType> &types);
+  bool matchAny(const TokenSet &types);
 
   /**
    * @brief Synchronize stream state after error
@@ -102,8 +122,10 @@ public:
   /**
    * @brief Save current position for later restoration
    * @return Current position index
+   * @note A pulled stream keeps the tokens from a saved position on until
+   *       it is restored
    */
-  size_t savePosition() const;
+  size_t savePosition();
 
   /**
    * @brief Restore previously saved position
@@ -118,14 +140,39 @@ public:
    */
   bool check(TokenType type) const;
 
+  /**
+   * @brief Check if current token is any of several types without consuming
+   * @param types Set of TokenTypes to check against
+   * @return true if the current token's type is in the set
+   */
+  bool checkAny(const TokenSet &types) const;
+
   /*
    * return current token
    */
   Token getCurrentToken();
 
 private:
+  /**
+   * @brief Gets the token at a position, pulling tokens up to it
+   * @return The token, or the EOF token past the end
+   */
+  const Token &at(size_t position) const;
+
+  /**
+   * @brief Drops pulled tokens that no position can reach anymore
+   */
+  void trim();
+
   std::vector<Token> tokens_; ///< Storage for token sequence
   size_t current_;            ///< Current position in token stream
+
+  // State of a pulled stream; the window grows as tokens are peeked at
+  TokenSource source_;                ///< Empty if every token is held
+  mutable std::deque<Token> window_;  ///< Pulled tokens from base_ on
+  size_t base_ = 0;                   ///< Position of window_.front()
+  mutable bool exhausted_ = false;    ///< Whether EOF was pulled
+  std::vector<size_t> saved_;         ///< Positions saved, not restored
 };
 
 } // namespace tokens
\ No newline at end of file
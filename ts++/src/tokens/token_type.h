@@ -1,4 +1,8 @@
 #pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
 
 namespace tokens {
 
@@ -6,7 +10,7 @@ namespace tokens {
  * Enumeration of all possible token types in the language.
  * Each section represents a different category of tokens.
  */
-enum class TokenType {
+enum class TokenType : std::uint16_t {
   /*****************************************************************************
    * Declaration Keywords
    *****************************************************************************/
@@ -20,6 +24,7 @@ enum class TokenType {
   CONSTRUCTOR,      // 'CONSTRUCTOR' method to init class
   TYPEDEF,          // 'typedef' keyword for type aliases
   NAMESPACE,        // 'namespace' keyword for namespace declarations
+  EXTERN,           // 'extern' keyword for foreign function declarations
   TEMPLATE,         // 'template' keyword for template declarations
   NEW,              // 'new' keyword to create new class instance
   GET,
@@ -87,6 +92,7 @@ enum class TokenType {
   SHARED,                // '#shared' smart pointer type
   UNIQUE,                // '#unique' smart pointer type
   WEAK,                  // '#weak' smart pointer type
+  ATOMIC,                // '#atomic' atomic value type
   ATTRIBUTE,             // '#'
   STORAGE_END = ATTRIBUTE,
 
@@ -99,6 +105,10 @@ enum class TokenType {
   UNSAFE,                  // '#unsafe' function modifier
   SIMD,                    // '#simd' function modifier
   TARGET,                  // '#target' platform specific code
+  TAILCALL,                // '#tailcall' function modifier
+  COLD,                    // '#cold' function modifier
+  NOALIAS,                 // '#noalias' function modifier
+  BENCH,                   // '#bench' microbenchmark function
   REF,                     // 'ref' parameter modifier
   FUNC_MOD_END = REF,
 
@@ -110,6 +120,7 @@ enum class TokenType {
   PACKED,                    // '#packed' memory layout
   ABSTRACT,                  // '#abstract' class modifier
   ZEROCAST,                  // '#zerocast' interface modifier
+  SOA,                       // '#soa' structure-of-arrays layout
   EXTENDS,                   // 'extends' inheritance
   IMPLEMENTS,                // 'implements' interface implementation
   CLASS_MOD_END = IMPLEMENTS,
@@ -122,8 +133,11 @@ enum class TokenType {
   SIZEOF,                     // '#sizeof' operator
   ALIGNOF,                    // '#alignof' operator
   TYPEOF,                     // '#typeof' operator
+  COMPTIME,                   // '#comptime' compile-time evaluated constant
   ASM,                        // '#asm' inline assembly
-  COMPILE_END = ASM,
+  PARALLEL,                   // '#parallel' loop attribute
+  ARENA,                      // '#arena' block attribute
+  COMPILE_END = ARENA,
 
   /*****************************************************************************
    * Literals and Values
@@ -192,6 +206,7 @@ enum class TokenType {
   COLON,    // ':'
   ARROW,    // '->'
   DOT,      // '.'
+  ELLIPSIS, // '...'
   AT,       // '@'
   OPERATOR_END = AT,
 
@@ -225,6 +240,92 @@ enum class TokenType {
   END_OF_FILE
 };
 
+/**
+ * @brief A set of token types, one bit per TokenType
+ *
+ * Sets are built at compile time, and checking a token against one is a
+ * shift and a mask, with nothing to allocate or hash.
+ */
+class TokenSet {
+public:
+  constexpr TokenSet() = default;
+  constexpr TokenSet(std::initializer_list<TokenType> types) {
+    for (TokenType type : types) {
+      insert(type);
+    }
+  }
+
+  // Every type from first to last, as the *_BEGIN/*_END markers delimit
+  static constexpr TokenSet range(TokenType first, TokenType last) {
+    TokenSet set;
+    for (auto i = index(first); i <= index(last); ++i) {
+      set.words_[i / 64] |= std::uint64_t(1) << (i % 64);
+    }
+    return set;
+  }
+
+  constexpr TokenSet &insert(TokenType type) {
+    words_[index(type) / 64] |= std::uint64_t(1) << (index(type) % 64);
+    return *this;
+  }
+
+  constexpr bool contains(TokenType type) const {
+    return (words_[index(type) / 64] >> (index(type) % 64)) & 1;
+  }
+
+  constexpr TokenSet operator|(const TokenSet &other) const {
+    TokenSet set = *this;
+    for (std::size_t i = 0; i < kWords; ++i) {
+      set.words_[i] |= other.words_[i];
+    }
+    return set;
+  }
+
+private:
+  static constexpr std::size_t index(TokenType type) {
+    return static_cast<std::size_t>(type);
+  }
+
+  static constexpr std::size_t kWords =
+      static_cast<std::size_t>(TokenType::END_OF_FILE) / 64 + 1;
+  std::array<std::uint64_t, kWords> words_{};
+};
+
+inline constexpr TokenSet kAssignmentOperators = {
+    TokenType::EQUALS,           TokenType::PLUS_EQUALS,
+    TokenType::MINUS_EQUALS,     TokenType::STAR_EQUALS,
+    TokenType::SLASH_EQUALS,     TokenType::PERCENT_EQUALS,
+    TokenType::AMPERSAND_EQUALS, TokenType::PIPE_EQUALS,
+    TokenType::CARET_EQUALS};
+
+inline constexpr TokenSet kArithmeticOperators = {
+    TokenType::PLUS,      TokenType::MINUS,   TokenType::STAR,
+    TokenType::SLASH,     TokenType::PERCENT, TokenType::PLUS_PLUS,
+    TokenType::MINUS_MINUS};
+
+inline constexpr TokenSet kBitwiseOperators = {
+    TokenType::AMPERSAND, TokenType::PIPE, TokenType::CARET, TokenType::TILDE};
+
+inline constexpr TokenSet kLogicalOperators = {
+    TokenType::EXCLAIM, TokenType::AMPERSAND_AMPERSAND, TokenType::PIPE_PIPE};
+
+inline constexpr TokenSet kComparisonOperators = {
+    TokenType::EQUALS_EQUALS, TokenType::EXCLAIM_EQUALS,
+    TokenType::LESS,          TokenType::GREATER,
+    TokenType::LESS_EQUALS,   TokenType::GREATER_EQUALS};
+
+inline constexpr TokenSet kGenericConstraints = {
+    TokenType::WHERE, TokenType::EXTENDS, TokenType::IMPLEMENTS};
+
+// Unary operators by position; '+' and '-' are binary too
+inline constexpr TokenSet kDualPurposeOperators = {TokenType::PLUS,
+                                                   TokenType::MINUS};
+inline constexpr TokenSet kPrefixOperators =
+    TokenSet{TokenType::EXCLAIM, TokenType::TILDE} | kDualPurposeOperators;
+inline constexpr TokenSet kPostfixOperators =
+    TokenSet{TokenType::PLUS_PLUS, TokenType::MINUS_MINUS} |
+    kDualPurposeOperators;
+
 /**
  * Token category check functions implementation
  */
@@ -253,80 +354,30 @@ inline bool isOperator(TokenType type) {
 }
 
 inline bool isAssignmentOperator(TokenType type) {
-  static const TokenType assignmentOps[] = {
-      TokenType::EQUALS,           TokenType::PLUS_EQUALS,
-      TokenType::MINUS_EQUALS,     TokenType::STAR_EQUALS,
-      TokenType::SLASH_EQUALS,     TokenType::PERCENT_EQUALS,
-      TokenType::AMPERSAND_EQUALS, TokenType::PIPE_EQUALS,
-      TokenType::CARET_EQUALS};
-
-  for (const auto &op : assignmentOps) {
-    if (type == op)
-      return true;
-  }
-  return false;
+  return kAssignmentOperators.contains(type);
 }
 
 inline bool isArithmeticOperator(TokenType type) {
-  static const TokenType arithmeticOps[] = {
-      TokenType::PLUS,       TokenType::MINUS,   TokenType::STAR,
-      TokenType::SLASH,      TokenType::PERCENT, TokenType::PLUS_PLUS,
-      TokenType::MINUS_MINUS};
-
-  for (const auto &op : arithmeticOps) {
-    if (type == op)
-      return true;
-  }
-  return false;
+  return kArithmeticOperators.contains(type);
 }
 
 inline bool isBitwiseOperator(TokenType type) {
-  static const TokenType bitwiseOps[] = {TokenType::AMPERSAND, TokenType::PIPE,
-                                         TokenType::CARET, TokenType::TILDE};
-
-  for (const auto &op : bitwiseOps) {
-    if (type == op)
-      return true;
-  }
-  return false;
+  return kBitwiseOperators.contains(type);
 }
 
 inline bool isLogicalOperator(TokenType type) {
-  static const TokenType logicalOps[] = {
-      TokenType::EXCLAIM, TokenType::AMPERSAND_AMPERSAND, TokenType::PIPE_PIPE};
-
-  for (const auto &op : logicalOps) {
-    if (type == op)
-      return true;
-  }
-  return false;
+  return kLogicalOperators.contains(type);
 }
 
 inline bool isComparisonOperator(TokenType type) {
-  static const TokenType comparisonOps[] = {
-      TokenType::EQUALS_EQUALS, TokenType::EXCLAIM_EQUALS,
-      TokenType::LESS,          TokenType::GREATER,
-      TokenType::LESS_EQUALS,   TokenType::GREATER_EQUALS};
-
-  for (const auto &op : comparisonOps) {
-    if (type == op)
-      return true;
-  }
-  return false;
+  return kComparisonOperators.contains(type);
 }
 
 /**
  * Additional checker functions for enhanced language features
  */
 inline bool isGenericConstraint(TokenType type) {
-  static const TokenType constraintOps[] = {
-      TokenType::WHERE, TokenType::EXTENDS, TokenType::IMPLEMENTS};
-
-  for (const auto &op : constraintOps) {
-    if (type == op)
-      return true;
-  }
-  return false;
+  return kGenericConstraints.contains(type);
 }
 
 inline bool isTemplateKeyword(TokenType type) {
@@ -337,52 +388,14 @@ inline bool isTemplateKeyword(TokenType type) {
  * Enhanced operator classification that considers operator context
  */
 inline bool isUnaryOperator(TokenType type, bool prefixPosition = true) {
-  // Operators that can only be prefix unary
-  static const TokenType prefixOnlyOps[] = {TokenType::EXCLAIM,
-                                            TokenType::TILDE};
-
-  // Operators that can only be postfix unary
-  static const TokenType postfixOnlyOps[] = {TokenType::PLUS_PLUS,
-                                             TokenType::MINUS_MINUS};
-
-  // Operators that can be both unary and binary
-  static const TokenType dualOps[] = {TokenType::PLUS, TokenType::MINUS};
-
-  if (prefixPosition) {
-    for (const auto &op : prefixOnlyOps) {
-      if (type == op)
-        return true;
-    }
-  }
-
-  // Check postfix operators if not in prefix position
-  if (!prefixPosition) {
-    for (const auto &op : postfixOnlyOps) {
-      if (type == op)
-        return true;
-    }
-  }
-
-  // Check dual-purpose operators in either position
-  for (const auto &op : dualOps) {
-    if (type == op)
-      return true;
-  }
-
-  return false;
+  return (prefixPosition ? kPrefixOperators : kPostfixOperators).contains(type);
 }
 
 /**
  * Helper function to determine if a token can be both unary and binary
  */
 inline bool isDualPurposeOperator(TokenType type) {
-  static const TokenType dualOps[] = {TokenType::PLUS, TokenType::MINUS};
-
-  for (const auto &op : dualOps) {
-    if (type == op)
-      return true;
-  }
-  return false;
+  return kDualPurposeOperators.contains(type);
 }
 
 /**
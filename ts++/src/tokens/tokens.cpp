@@ -0,0 +1,100 @@
+/*****************************************************************************
+ * File: tokens.cpp
+ * Description: Out-of-line Token accessors that resolve lexemes, locations
+ * and error messages through the SourceManager and the error side table.
+ *****************************************************************************/
+
+#include "tokens.h"
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+
+namespace tokens {
+
+namespace {
+
+/**
+ * Side table holding error messages keyed by file id, then offset. A
+ * file's messages go with its buffer.
+ */
+class TokenErrorTable {
+public:
+  static TokenErrorTable &instance() {
+    static TokenErrorTable table;
+    return table;
+  }
+
+  void set(core::FileId fileId, std::uint32_t offset, std::string message) {
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    messages_[fileId][offset] = std::move(message);
+  }
+
+  std::optional<std::string> get(core::FileId fileId,
+                                 std::uint32_t offset) const {
+    // Readers only contend with the lexer recording a new error
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto file = messages_.find(fileId);
+    if (file == messages_.end()) {
+      return std::nullopt;
+    }
+    auto it = file->second.find(offset);
+    if (it == file->second.end()) {
+      return std::nullopt;
+    }
+    return it->second;
+  }
+
+private:
+  TokenErrorTable() {
+    core::SourceManager::instance().onRelease([this](core::FileId fileId) {
+      std::unique_lock<std::shared_mutex> lock(mutex_);
+      messages_.erase(fileId);
+    });
+  }
+
+  std::unordered_map<core::FileId,
+                     std::unordered_map<std::uint32_t, std::string>>
+      messages_;
+  mutable std::shared_mutex mutex_;
+};
+
+// Spelling of tokens the lexer inserts without source text
+std::string_view syntheticLexeme(TokenType type) {
+  switch (type) {
+  case TokenType::SEMICOLON:
+    return ";";
+  default:
+    return "";
+  }
+}
+
+} // namespace
+
+Token Token::createError(core::FileId fileId, std::uint32_t offset,
+                         std::uint32_t length, std::string errorMessage) {
+  TokenErrorTable::instance().set(fileId, offset, std::move(errorMessage));
+  return Token(TokenType::ERROR_TOKEN, fileId, offset, length);
+}
+
+std::string_view Token::getLexeme() const {
+  if (isSynthetic()) {
+    return syntheticLexeme(type_);
+  }
+  return core::SourceManager::instance().getBuffer(fileId_).substr(offset_,
+                                                                   length_);
+}
+
+core::SourceLocation Token::getLocation() const {
+  auto [line, column] =
+      core::SourceManager::instance().getLineColumn(fileId_, offset_);
+  return core::SourceLocation(fileId_, offset_, line, column);
+}
+
+std::optional<std::string> Token::getErrorMessage() const {
+  if (!isError()) {
+    return std::nullopt;
+  }
+  return TokenErrorTable::instance().get(fileId_, offset_);
+}
+
+} // namespace tokens
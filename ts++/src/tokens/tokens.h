@@ -1,42 +1,69 @@
 #pragma once
 #include "core/common/common_types.h"
 #include "token_type.h"
+#include <cstdint>
 #include <optional>
 #include <string>
+#include <string_view>
 
 namespace tokens {
 
 /**
  * Class representing a token with type, lexeme, and location information
+ *
+ * Tokens are packed into 16 bytes: the lexeme is a view into the source
+ * buffer owned by core::SourceManager, and line/column are derived from the
+ * buffer offset on demand. Error messages live in a side table so the common
+ * case does not pay for them.
  */
 class Token {
 public:
   /**
-   * Regular token constructor
+   * Token flags stored alongside the type
    */
-  Token(TokenType type, std::string lexeme, core::SourceLocation location)
-      : type_(type), lexeme_(std::move(lexeme)),
-        location_(std::move(location)) {}
+  enum Flags : std::uint16_t {
+    NONE = 0,
+    SYNTHETIC = 1 << 0 // Lexeme is not present in the source buffer
+  };
 
   /**
-   * Factory method for creating error tokens
+   * Regular token constructor (lexeme is source[offset, offset + length))
+   */
+  Token(TokenType type, core::FileId fileId, std::uint32_t offset,
+        std::uint32_t length)
+      : offset_(offset), length_(length), fileId_(fileId), type_(type),
+        flags_(NONE) {}
+
+  /**
+   * Factory method for tokens that do not appear in the source, such as
+   * inserted semicolons and the end-of-file marker
    */
-  static Token createError(std::string lexeme, core::SourceLocation location,
-                           std::string errorMessage) {
-    Token token(TokenType::ERROR_TOKEN, std::move(lexeme), std::move(location));
-    token.errorMessage_ = std::move(errorMessage);
+  static Token createSynthetic(TokenType type, core::FileId fileId,
+                               std::uint32_t offset) {
+    Token token(type, fileId, offset, 0);
+    token.flags_ = SYNTHETIC;
     return token;
   }
 
+  /**
+   * Factory method for creating error tokens
+   */
+  static Token createError(core::FileId fileId, std::uint32_t offset,
+                           std::uint32_t length, std::string errorMessage);
+
   /**
    * Token information access
    */
   TokenType getType() const { return type_; }
-  const std::string &getLexeme() const { return lexeme_; }
-  const core::SourceLocation &getLocation() const { return location_; }
-  const std::optional<std::string> &getErrorMessage() const {
-    return errorMessage_;
-  }
+  std::string_view getLexeme() const;
+  core::SourceLocation getLocation() const;
+  std::optional<std::string> getErrorMessage() const;
+
+  // Raw location data
+  core::FileId getFileId() const { return fileId_; }
+  std::uint32_t getOffset() const { return offset_; }
+  std::uint32_t getLength() const { return length_; }
+  bool isSynthetic() const { return (flags_ & SYNTHETIC) != 0; }
 
   /**
    * Token classification methods
@@ -55,10 +82,13 @@ public:
   bool isSpecial() const { return tokens::isSpecial(type_); }
 
 private:
-  TokenType type_;                          // Type of token
-  std::string lexeme_;                      // Actual text of token
-  core::SourceLocation location_;                 // Position in source
-  std::optional<std::string> errorMessage_; // Error information if any
+  std::uint32_t offset_; // Byte offset of the lexeme in the source buffer
+  std::uint32_t length_; // Length of the lexeme in bytes
+  core::FileId fileId_;  // Source buffer owning the lexeme
+  TokenType type_;       // Type of token
+  std::uint16_t flags_;  // Token flags (see Flags)
 };
 
-} // namespace tokens
\ No newline at end of file
+static_assert(sizeof(Token) == 16, "Token should stay packed in 16 bytes");
+
+} // namespace tokens
@@ -1,12 +1,13 @@
 # Test the generated LLVM IR
+TSPP=${TSPP:-./build/src/tspp}
 
 # 1. View the generated LLVM IR
 echo "=== Generated LLVM IR ==="
 cat test.tspp.ll
 
 echo -e "\n=== Verifying LLVM IR ==="
-# 2. Verify the LLVM IR is valid
-llvm-as test.tspp.ll -o test.bc
+# 2. Verify the LLVM IR is valid (tspp verifies it while emitting bitcode)
+$TSPP -emit=bc test.tspp -o test.bc
 if [ $? -eq 0 ]; then
     echo "✅ LLVM IR is valid!"
 else
@@ -15,8 +16,8 @@ else
 fi
 
 echo -e "\n=== Compiling to Executable ==="
-# 3. Compile the LLVM IR to an executable
-clang test.tspp.ll -o test_program
+# 3. Compile straight to an executable
+$TSPP -emit=exe test.tspp -o test_program
 if [ $? -eq 0 ]; then
     echo "✅ Successfully compiled to executable!"
 else
@@ -36,7 +37,7 @@ echo "lli exit code: $?"
 
 echo -e "\n=== Assembly Generation ==="
 # 6. Generate assembly code to see what was produced
-llc test.tspp.ll -o test.s
+$TSPP -S test.tspp -o test.s
 echo "✅ Assembly generated in test.s"
 echo "First 20 lines of assembly:"
 head -20 test.s
\ No newline at end of file
@@ -0,0 +1,60 @@
+/* C side of c_functions.tspp, compiled by the system C compiler */
+#include <stdarg.h>
+#include <stdbool.h>
+
+typedef struct {
+  float x, y, z;
+} Vec3;
+
+typedef struct {
+  int id;
+  float weight;
+} Tagged;
+
+typedef struct {
+  int a, b, c, d, e;
+} Wide;
+
+float dot(Vec3 p, Vec3 q) { return p.x * q.x + p.y * q.y + p.z * q.z; }
+
+Vec3 scale(Vec3 v, float k) {
+  Vec3 r = {v.x * k, v.y * k, v.z * k};
+  return r;
+}
+
+Tagged retag(Tagged t, int id) {
+  t.id = id;
+  return t;
+}
+
+Wide widen(int seed) {
+  Wide w = {seed, seed + 1, seed + 2, seed + 3, seed + 4};
+  return w;
+}
+
+int sum_wide(Wide w) { return w.a + w.b + w.c + w.d + w.e; }
+
+bool is_even(int n) { return n % 2 == 0; }
+
+/* Variadic arguments arrive promoted: floats as doubles, bools as ints */
+int sum_ints(int count, ...) {
+  va_list args;
+  va_start(args, count);
+  int sum = 0;
+  for (int i = 0; i < count; ++i) {
+    sum += va_arg(args, int);
+  }
+  va_end(args);
+  return sum;
+}
+
+float sum_floats(int count, ...) {
+  va_list args;
+  va_start(args, count);
+  double sum = 0;
+  for (int i = 0; i < count; ++i) {
+    sum += va_arg(args, double);
+  }
+  va_end(args);
+  return (float)sum;
+}
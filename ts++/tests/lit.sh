@@ -0,0 +1,37 @@
+#!/bin/bash
+# Runs the "// RUN:" lines of a test file, lit style.
+#
+# Usage: lit.sh <test file> <scratch dir>
+# Substitutions: %tspp, %FileCheck, %profdata, %cc, %runtime, %s (the test
+# file), %S (its directory) and %t (a scratch path unique to the test).
+# Every RUN line must succeed.
+
+set -o pipefail
+
+test_file=$1
+scratch=$2/$(basename "$test_file")
+mkdir -p "$(dirname "$scratch")"
+
+# The compiler is built with ASan; allocations it keeps until exit are fine
+export ASAN_OPTIONS=${ASAN_OPTIONS:-detect_leaks=0}
+
+status=0
+while IFS= read -r line; do
+  command=${line#*RUN: }
+  command=${command//%tspp/$TSPP}
+  command=${command//%FileCheck/$FILECHECK}
+  command=${command//%profdata/$PROFDATA}
+  command=${command//%cc/$CC}
+  command=${command//%runtime/$TSPP_RUNTIME}
+  command=${command//%s/$test_file}
+  command=${command//%S/$(dirname "$test_file")}
+  command=${command//%t/$scratch}
+  echo "RUN: $command"
+  if ! bash -c "set -o pipefail; $command"; then
+    echo "FAILED: $command"
+    status=1
+    break
+  fi
+done < <(grep -E '^\s*//\s*RUN:' "$test_file")
+
+exit $status
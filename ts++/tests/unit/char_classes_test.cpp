@@ -0,0 +1,88 @@
+#include "core/common/source_manager.h"
+#include "lexer/lexer.h"
+#include "lexer/patterns/char_classes.h"
+#include "test_support.h"
+#include <cctype>
+#include <string>
+#include <vector>
+
+namespace {
+
+using namespace lexer;
+
+// On ASCII the table agrees with <cctype> in the C locale, and no byte
+// above it is a letter, digit or blank
+void testAgreesWithCType() {
+  for (int c = 0; c < 256; ++c) {
+    char byte = static_cast<char>(c);
+    bool ascii = c < 128;
+    EXPECT(chars::isDigit(byte) == (ascii && std::isdigit(c)));
+    EXPECT(chars::isHexDigit(byte) == (ascii && std::isxdigit(c)));
+    EXPECT(chars::is(byte, chars::kIdentifierStart) ==
+           (ascii && (std::isalpha(c) || c == '_')));
+    EXPECT(chars::is(byte, chars::kIdentifierPart) ==
+           (ascii && (std::isalnum(c) || c == '_')));
+    EXPECT(chars::isWhitespace(byte) == (ascii && std::isspace(c)));
+    EXPECT(chars::isBlank(byte) == (ascii && std::isspace(c) && c != '\n'));
+  }
+}
+
+// Well-formed sequences only, whole and with valid second bytes
+void testUtf8Length() {
+  auto length = [](const std::string &bytes) {
+    return chars::utf8Length(bytes.data(), bytes.size());
+  };
+  EXPECT(length("\xC3\xA4") == 2);         // ä
+  EXPECT(length("\xE9\x9D\xA2x") == 3);    // 面
+  EXPECT(length("\xF0\x9F\x98\x80") == 4); // U+1F600
+  EXPECT(length("a") == 0);
+  EXPECT(length("") == 0);
+  EXPECT(length("\xA4") == 0);             // Continuation byte alone
+  EXPECT(length("\xC3") == 0);             // Cut short
+  EXPECT(length("\xC3x") == 0);
+  EXPECT(length("\xC0\xAF") == 0);         // Overlong '/'
+  EXPECT(length("\xE0\x80\xAF") == 0);     // Overlong '/'
+  EXPECT(length("\xED\xA0\x80") == 0);     // Surrogate
+  EXPECT(length("\xF4\x90\x80\x80") == 0); // Past U+10FFFF
+  EXPECT(length("\xFF") == 0);
+}
+
+// Identifiers take non-ASCII characters whole, anywhere in the name
+void testIdentifiers() {
+  std::string source = "let größe = länge_2 + 面积\n\xC3x\n";
+  core::FileId id =
+      core::SourceManager::instance().addFile("chars.tspp", source);
+  Lexer lexer(id);
+  std::vector<tokens::Token> all = lexer.tokenize();
+
+  std::vector<std::string> identifiers;
+  for (const auto &token : all) {
+    if (token.getType() == tokens::TokenType::IDENTIFIER) {
+      identifiers.emplace_back(token.getLexeme());
+    }
+  }
+  EXPECT(identifiers.size() == 4);
+  if (identifiers.size() == 4) {
+    EXPECT(identifiers[0] == "größe");
+    EXPECT(identifiers[1] == "länge_2");
+    EXPECT(identifiers[2] == "面积");
+    EXPECT(identifiers[3] == "x");
+  }
+  // The lead byte without its continuation is the one bad character
+  size_t invalid = 0;
+  for (const auto &error : lexer.getErrors()) {
+    if (error.find("Invalid UTF-8 sequence") != std::string::npos) {
+      ++invalid;
+    }
+  }
+  EXPECT(invalid == 1);
+}
+
+} // namespace
+
+int main() {
+  testAgreesWithCType();
+  testUtf8Length();
+  testIdentifiers();
+  return TEST_RESULT();
+}
@@ -0,0 +1,89 @@
+#include "core/common/source_manager.h"
+#include "core/diagnostics/error_reporter.h"
+#include "driver/dependency_graph.h"
+#include "lexer/lexer.h"
+#include "parser/parser.h"
+#include "test_support.h"
+#include <string>
+#include <unordered_set>
+
+namespace {
+
+const nodes::FunctionDeclNode *function(const parser::AST &ast, size_t i) {
+  nodes::NodePtr node = ast.getNodes()[i];
+  if (auto stmt = nodes::dyn_cast<nodes::DeclarationStmtNode>(node)) {
+    node = stmt->getDeclaration();
+  }
+  return nodes::dyn_cast<nodes::FunctionDeclNode>(node);
+}
+
+} // namespace
+
+int main() {
+  std::string source = "function add(a: int, b: int): int {\n"
+                       "  while (a > b) { a = a - 1; }\n"
+                       "  return a + b;\n"
+                       "}\n"
+                       "function id<T>(x: T): T { return x; }\n"
+                       "class Box {\n"
+                       "  let v: int;\n"
+                       "  function value(): int { return this.v; }\n"
+                       "}\n"
+                       "function twice(n: int): int { return add(n, n); }\n";
+  core::FileId id =
+      core::SourceManager::instance().addFile("deferred.tspp", source);
+
+  core::ErrorReporter reporter(false);
+  parser::Parser eager(lexer::Lexer(id).tokenize(), reporter);
+  EXPECT(eager.parse(false));
+  parser::Parser deferring(lexer::Lexer(id).tokenize(), reporter);
+  deferring.setDeferBodies(true);
+  EXPECT(deferring.parse(false));
+  parser::AST ast = deferring.takeAST();
+  EXPECT(ast.getNodes().size() == eager.getAST().getNodes().size());
+
+  // Bodies are source ranges, except generic ones, which callers need
+  const nodes::FunctionDeclNode *add = function(ast, 0);
+  EXPECT(add && !add->getBody() && add->hasBody());
+  EXPECT(add->getDeferredBody().begin == source.find('{'));
+  EXPECT(add->getDeferredBody().end == source.find("}\nfunction id") + 1);
+  EXPECT(function(ast, 1) && function(ast, 1)->getBody());
+
+  // Functions fingerprint alike whether their bodies were parsed or not
+  driver::DependencyGraph lazyGraph(ast);
+  driver::DependencyGraph eagerGraph(eager.getAST());
+  EXPECT(lazyGraph.getFunctions().size() ==
+         eagerGraph.getFunctions().size());
+  for (size_t i = 0; i < lazyGraph.getFunctions().size(); ++i) {
+    EXPECT(lazyGraph.getFingerprint(lazyGraph.getFunctions()[i]) ==
+           eagerGraph.getFingerprint(eagerGraph.getFunctions()[i]));
+  }
+
+  // Parsing on demand fills in every body but the skipped ones
+  const nodes::FunctionDeclNode *twice = function(ast, 3);
+  std::unordered_set<const nodes::BaseNode *> skip = {twice};
+  EXPECT(parser::Parser::parseBodies(ast, reporter, skip));
+  EXPECT(add->getBody() && !add->getDeferredBody());
+  EXPECT(add->getBody()->getStatements().size() ==
+         function(eager.getAST(), 0)->getBody()->getStatements().size());
+  EXPECT(!twice->getBody() && twice->getDeferredBody());
+  EXPECT(parser::Parser::parseBodies(ast, reporter));
+  EXPECT(twice->getBody());
+  EXPECT(!reporter.hasErrors());
+
+  // A syntax error in a body is found when it is parsed, where it is
+  std::string broken = "function f(): int {\n  return (1;\n}\n"
+                       "function g(): int { return 2; }\n";
+  core::FileId brokenId =
+      core::SourceManager::instance().addFile("broken.tspp", broken);
+  parser::Parser skipping(lexer::Lexer(brokenId).tokenize(), reporter);
+  skipping.setDeferBodies(true);
+  EXPECT(skipping.parse(false));
+  parser::AST brokenAST = skipping.takeAST();
+  EXPECT(!parser::Parser::parseBodies(brokenAST, reporter));
+  EXPECT(reporter.getDiagnostics().size() == 1);
+  EXPECT(reporter.getDiagnostics()[0].location.getLine() == 2);
+  EXPECT(function(brokenAST, 1)->getBody());
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,144 @@
+#include "core/common/source_manager.h"
+#include "core/diagnostics/error_reporter.h"
+#include "lexer/lexer.h"
+#include "parser/nodes/declaration_nodes.h"
+#include "parser/nodes/statement_nodes.h"
+#include "parser/parser.h"
+#include "test_support.h"
+#include <string>
+
+namespace {
+
+// The spelling of the operators the cases below use
+std::string spell(tokens::TokenType type) {
+  switch (type) {
+  case tokens::TokenType::PLUS:
+    return "+";
+  case tokens::TokenType::MINUS:
+    return "-";
+  case tokens::TokenType::STAR:
+    return "*";
+  case tokens::TokenType::SLASH:
+    return "/";
+  case tokens::TokenType::PERCENT:
+    return "%";
+  case tokens::TokenType::EXCLAIM:
+    return "!";
+  case tokens::TokenType::LESS:
+    return "<";
+  case tokens::TokenType::EQUALS_EQUALS:
+    return "==";
+  case tokens::TokenType::EQUALS:
+    return "=";
+  case tokens::TokenType::PLUS_EQUALS:
+    return "+=";
+  case tokens::TokenType::PLUS_PLUS:
+    return "++";
+  default:
+    return "?";
+  }
+}
+
+// Writes an expression as a parenthesized tree, e.g. (+ a (* b c))
+std::string tree(const nodes::ExpressionNode *expr) {
+  using namespace nodes;
+  if (auto id = dyn_cast<IdentifierExpressionNode>(expr)) {
+    return id->getName();
+  }
+  if (auto literal = dyn_cast<LiteralExpressionNode>(expr)) {
+    return literal->getValue();
+  }
+  std::string op = spell(expr->getExpressionType());
+  if (auto binary = dyn_cast<BinaryExpressionNode>(expr)) {
+    return "(" + op + " " + tree(binary->getLeft()) + " " +
+           tree(binary->getRight()) + ")";
+  }
+  if (auto assign = dyn_cast<AssignmentExpressionNode>(expr)) {
+    return "(" + op + " " + tree(assign->getTarget()) + " " +
+           tree(assign->getValue()) + ")";
+  }
+  if (auto unary = dyn_cast<UnaryExpressionNode>(expr)) {
+    return "(" + op + (unary->isPrefix() ? " " : "post ") +
+           tree(unary->getOperand()) + ")";
+  }
+  if (auto call = dyn_cast<CallExpressionNode>(expr)) {
+    std::string result = "(call " + tree(call->getCallee());
+    for (auto arg : call->getArguments()) {
+      result += " " + tree(arg);
+    }
+    return result + ")";
+  }
+  if (auto member = dyn_cast<MemberExpressionNode>(expr)) {
+    return "(. " + tree(member->getObject()) + " " + member->getMember() + ")";
+  }
+  if (auto index = dyn_cast<IndexExpressionNode>(expr)) {
+    return "([] " + tree(index->getArray()) + " " + tree(index->getIndex()) +
+           ")";
+  }
+  return "?";
+}
+
+// Parses an expression statement and returns its tree, or "" on an error
+std::string parse(const std::string &expression) {
+  static int count = 0;
+  std::string source = "function f(): void {\n  " + expression + ";\n}\n";
+  core::FileId id = core::SourceManager::instance().addFile(
+      "expr" + std::to_string(count++) + ".tspp", source);
+  core::ErrorReporter reporter(false);
+  parser::Parser parser(lexer::Lexer(id).tokenize(), reporter);
+  if (!parser.parse(false) || reporter.hasErrors()) {
+    return "";
+  }
+
+  nodes::NodePtr node = parser.getAST().getNodes()[0];
+  if (auto stmt = nodes::dyn_cast<nodes::DeclarationStmtNode>(node)) {
+    node = stmt->getDeclaration();
+  }
+  auto function = nodes::dyn_cast<nodes::FunctionDeclNode>(node);
+  auto body = function->getBody()->getStatements();
+  if (body.size() != 1) {
+    return "";
+  }
+  auto stmt = nodes::dyn_cast<nodes::ExpressionStmtNode>(body[0]);
+  return stmt ? tree(stmt->getExpression()) : "";
+}
+
+} // namespace
+
+int main() {
+  // Precedence and associativity of the binary operators
+  EXPECT(parse("a + b * c") == "(+ a (* b c))");
+  EXPECT(parse("a * b + c % d") == "(+ (* a b) (% c d))");
+  EXPECT(parse("a - b - c") == "(- (- a b) c)");
+  EXPECT(parse("a / b / c") == "(/ (/ a b) c)");
+  EXPECT(parse("a + b < c - d") == "(< (+ a b) (- c d))");
+  EXPECT(parse("a < b == c") == "(== (< a b) c)");
+
+  // Assignment binds loosest, to the right
+  EXPECT(parse("a = b = c + d") == "(= a (= b (+ c d)))");
+  EXPECT(parse("a += b * 2") == "(+= a (* b 2))");
+  EXPECT(parse("a.b = c < d") == "(= (. a b) (< c d))");
+
+  // Prefix operators bind tighter than binary ones, postfix tighter still
+  EXPECT(parse("-a * b") == "(* (- a) b)");
+  EXPECT(parse("!a == b") == "(== (! a) b)");
+  EXPECT(parse("-a.b(c)[d]") == "(- ([] (call (. a b) c) d))");
+  EXPECT(parse("-a++") == "(- (++post a))");
+  EXPECT(parse("a - -b") == "(- a (- b))");
+  EXPECT(parse("*p + 1") == "(+ (* p) 1)");
+
+  // Calls, members and indexing chain left to right
+  EXPECT(parse("f(a, b + 1)(c)") == "(call (call f a (+ b 1)) c)");
+  EXPECT(parse("a[i + 1].b") == "(. ([] a (+ i 1)) b)");
+  EXPECT(parse("(a + b) * c") == "(* (+ a b) c)");
+  EXPECT(parse("id<int>(a) + 1") == "(+ (call id a) 1)");
+  EXPECT(parse("a < b") == "(< a b)");
+
+  // Malformed expressions are errors
+  EXPECT(parse("a +").empty());
+  EXPECT(parse("a.").empty());
+  EXPECT(parse("f(a").empty());
+  EXPECT(parse("a[1").empty());
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,149 @@
+#include "core/common/source_manager.h"
+#include "lexer/lexer.h"
+#include "parser/incremental_parser.h"
+#include "parser/nodes/declaration_nodes.h"
+#include "parser/nodes/statement_nodes.h"
+#include "test_support.h"
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+std::string function(int i) {
+  std::string n = std::to_string(i);
+  return "function f" + n + "(a: int): int {\n  while (a > " + n +
+         ") { a = a - 1; }\n  return a;\n}\n";
+}
+
+const nodes::FunctionDeclNode *declared(nodes::NodePtr node) {
+  if (auto stmt = nodes::dyn_cast<nodes::DeclarationStmtNode>(node)) {
+    node = stmt->getDeclaration();
+  }
+  return nodes::dyn_cast<nodes::FunctionDeclNode>(node);
+}
+
+std::vector<std::string> names(const parser::IncrementalParser &parser) {
+  std::vector<std::string> result;
+  for (auto node : parser.getNodes()) {
+    auto function = declared(node);
+    result.push_back(function ? function->getName() : "?");
+  }
+  return result;
+}
+
+// Whether the tokens kept match lexing the current text from scratch
+bool relexesTheSame(const parser::IncrementalParser &parser) {
+  core::FileId id = core::SourceManager::instance().addFile(
+      "fresh.tspp", parser.getSource());
+  std::vector<tokens::Token> fresh = lexer::Lexer(id).tokenize();
+  if (!fresh.empty() &&
+      fresh.back().getType() == tokens::TokenType::END_OF_FILE) {
+    fresh.pop_back();
+  }
+  std::vector<tokens::Token> kept = parser.getTokens();
+  if (kept.size() != fresh.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < kept.size(); ++i) {
+    if (kept[i].getType() != fresh[i].getType() ||
+        kept[i].getLexeme() != fresh[i].getLexeme()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Applies an edit replacing the first `from` after `after` with `to`
+bool replace(parser::IncrementalParser &parser, const std::string &after,
+             const std::string &from, const std::string &to) {
+  size_t at = parser.getSource().find(from, parser.getSource().find(after));
+  return parser.edit({static_cast<std::uint32_t>(at),
+                      static_cast<std::uint32_t>(from.size()), to});
+}
+
+} // namespace
+
+int main() {
+  std::string source;
+  for (int i = 0; i < 200; ++i) {
+    source += function(i);
+  }
+  parser::IncrementalParser parser("document.tspp");
+  EXPECT(parser.parse(source));
+  EXPECT(parser.getNodes().size() == 200);
+  std::vector<nodes::NodePtr> before = parser.getNodes();
+
+  // An edit inside a body reparses just that function
+  EXPECT(replace(parser, "function f100(", "return a;", "return a + 1;"));
+  EXPECT(parser.getParsedItems() == 1);
+  EXPECT(parser.getLexedTokens() < 40);
+  EXPECT(relexesTheSame(parser));
+  EXPECT(parser.getNodes().size() == 200);
+  EXPECT(parser.getNodes()[100] != before[100]);
+  EXPECT(parser.getNodes()[99] == before[99]);
+  EXPECT(parser.getNodes()[101] == before[101]);
+  auto body = declared(parser.getNodes()[100])->getBody()->getStatements();
+  auto ret = nodes::dyn_cast<nodes::ReturnStmtNode>(body.back());
+  EXPECT(ret && nodes::isa<nodes::BinaryExpressionNode>(ret->getValue()));
+
+  // A buffer no item is left from is released
+  auto &sources = core::SourceManager::instance();
+  core::FileId edited = parser.getNodes()[100]->getLocation().getFileId();
+  core::FileId original = parser.getNodes()[99]->getLocation().getFileId();
+  EXPECT(replace(parser, "function f100(", "a + 1;", "a + 2;"));
+  EXPECT(!parser.ownsFile(edited));
+  std::thread([&] {
+    // A thread that never read the released buffer finds nothing there
+    EXPECT(sources.getBuffer(edited).empty());
+    EXPECT(!sources.getBuffer(original).empty());
+  }).join();
+
+  // Reused nodes keep their locations, which map to the current text
+  EXPECT(replace(parser, "function f3(", "while", "\n\n  while"));
+  EXPECT(parser.getParsedItems() == 1);
+  const core::SourceLocation &location =
+      declared(parser.getNodes()[150])->getLocation();
+  EXPECT(location.getFileId() !=
+         declared(parser.getNodes()[3])->getLocation().getFileId());
+  EXPECT(parser.currentOffset(location.getFileId(), location.getOffset()) ==
+         parser.getSource().find("function f150("));
+
+  // New declarations come out as items of their own; an edit at the start
+  // of an item relexes the one before it too
+  EXPECT(replace(parser, "function f50(", "function f50(", function(1000) +
+                                                            "function f50("));
+  EXPECT(parser.getParsedItems() == 3);
+  EXPECT(relexesTheSame(parser));
+  std::vector<std::string> declaredNames = names(parser);
+  EXPECT(declaredNames.size() == 201);
+  EXPECT(declaredNames[50] == "f1000" && declaredNames[51] == "f50");
+
+  // Tokens joined across an item boundary are relexed together
+  EXPECT(!replace(parser, "function f7(", "}\nfunction f8", "}\nfunction8"));
+  EXPECT(relexesTheSame(parser));
+  EXPECT(replace(parser, "function f7(", "function8", "function f8"));
+  EXPECT(relexesTheSame(parser));
+  EXPECT(names(parser) == declaredNames);
+
+  // An unclosed block reparses the rest of the document, and closing it
+  // again recovers every declaration
+  EXPECT(!replace(parser, "function f20(", "{ a = a - 1; }", "{ a = a - 1;"));
+  EXPECT(parser.getParsedItems() < 10);
+  EXPECT(parser.getLexedTokens() > 100);
+  EXPECT(parser.hasErrors() && !parser.getDiagnostics().empty());
+  EXPECT(replace(parser, "function f20(", "{ a = a - 1;", "{ a = a - 1; }"));
+  EXPECT(!parser.hasErrors());
+  EXPECT(names(parser) == declaredNames);
+  EXPECT(relexesTheSame(parser));
+
+  // Deleting a declaration drops its node
+  size_t at = parser.getSource().find("function f199(");
+  EXPECT(parser.edit({static_cast<std::uint32_t>(at),
+                      static_cast<std::uint32_t>(function(199).size()), ""}));
+  EXPECT(parser.getNodes().size() == 200);
+  EXPECT(names(parser).back() == "f198");
+  EXPECT(relexesTheSame(parser));
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,118 @@
+#include "codegen/llvm/llvm_jit.h"
+#include "codegen/llvm/llvm_utils.h"
+#include "test_support.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Process.h"
+#include <memory>
+
+namespace {
+
+// Builds a module defining `name` to return `value`, optionally through a
+// call to an external function that does not exist
+llvm::orc::ThreadSafeModule makeModule(const std::string &name, int value,
+                                       bool callMissing) {
+  auto context = std::make_unique<llvm::LLVMContext>();
+  auto module = std::make_unique<llvm::Module>(name, *context);
+  auto *int32 = llvm::Type::getInt32Ty(*context);
+  auto *type = llvm::FunctionType::get(int32, false);
+
+  auto *function = llvm::Function::Create(
+      type, llvm::Function::ExternalLinkage, name, module.get());
+  llvm::IRBuilder<> builder(
+      llvm::BasicBlock::Create(*context, "entry", function));
+  if (callMissing) {
+    auto callee = module->getOrInsertFunction("tspp_test_missing", type);
+    builder.CreateCall(callee);
+  }
+  builder.CreateRet(llvm::ConstantInt::get(int32, value));
+
+  return llvm::orc::ThreadSafeModule(std::move(module), std::move(context));
+}
+
+// Runs `cached` in a session of its own that keeps objects in directory
+int runCached(const std::string &directory, unsigned &loaded) {
+  codegen::LLVMJIT jit;
+  jit.setObjectCacheDirectory(directory);
+  EXPECT(jit.addModule(makeModule("cached", 7, false)));
+  uint64_t address = jit.lookup("cached");
+
+  // The body is compiled, or loaded, on the first call
+  int result = address ? reinterpret_cast<int (*)()>(address)() : -1;
+  loaded = jit.getCachedObjectCount();
+  return result;
+}
+
+// A second session loads the object the first one compiled
+void testObjectCache() {
+  llvm::SmallString<128> directory;
+  EXPECT(!llvm::sys::fs::createUniqueDirectory("tspp-jit-cache", directory));
+  unsigned loaded = 0;
+  EXPECT(runCached(directory.str().str(), loaded) == 7 && loaded == 0);
+  EXPECT(runCached(directory.str().str(), loaded) == 7 && loaded > 0);
+  llvm::sys::fs::remove_directories(directory);
+}
+
+// Mangled generic names read back as tspp spells them
+void testDemangle() {
+  using codegen::LLVMUtils::demangleFunctionName;
+  EXPECT(demangleFunctionName("main") == "main");
+  EXPECT(demangleFunctionName("_Z3Boxi.get") == "Box<int>.get");
+  EXPECT(demangleFunctionName("_Z4pairfb") == "pair<float, bool>");
+  EXPECT(demangleFunctionName("_Z5firstP3Boxi") == "first<Box@, int>");
+  EXPECT(demangleFunctionName("_Z") == "_Z");
+}
+
+// A profiled session names each function in /tmp/perf-<pid>.map, demangled
+void testPerfMap() {
+  std::string path = "/tmp/perf-" +
+                     std::to_string(llvm::sys::Process::getProcessId()) +
+                     ".map";
+  llvm::sys::fs::remove(path);
+  {
+    codegen::LLVMJIT jit;
+    jit.setProfiling(true);
+    auto module = makeModule("_Z3Boxi.get", 5, false);
+    EXPECT(jit.addModuleNow(std::move(module)));
+    uint64_t address = jit.lookup("_Z3Boxi.get");
+    EXPECT(address != 0 && reinterpret_cast<int (*)()>(address)() == 5);
+  }
+  auto buffer = llvm::MemoryBuffer::getFile(path);
+  EXPECT(bool(buffer));
+  if (buffer) {
+    EXPECT((*buffer)->getBuffer().contains(" Box<int>.get\n"));
+  }
+  llvm::sys::fs::remove(path);
+}
+
+} // namespace
+
+int main() {
+  testObjectCache();
+  testDemangle();
+  testPerfMap();
+
+  codegen::LLVMJIT jit;
+  EXPECT(jit.initialize());
+
+  // An unresolved symbol is reported when the module is added
+  EXPECT(!jit.addModuleNow(makeModule("broken", 1, true)));
+  EXPECT(jit.getLastError().find("tspp_test_missing") != std::string::npos);
+
+  // The failed module was removed, so its name can be defined again
+  EXPECT(jit.addModuleNow(makeModule("broken", 2, false)));
+  uint64_t address = jit.lookup("broken");
+  EXPECT(address != 0);
+  if (address) {
+    EXPECT(reinterpret_cast<int (*)()>(address)() == 2);
+  }
+
+  // The session keeps working for later modules
+  EXPECT(jit.addModuleNow(makeModule("later", 3, false)));
+  address = jit.lookup("later");
+  EXPECT(address != 0 && reinterpret_cast<int (*)()>(address)() == 3);
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,79 @@
+#include "core/common/source_manager.h"
+#include "lexer/lexer.h"
+#include "lexer/line_split.h"
+#include "test_support.h"
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Lexes a buffer whole, then in chunks on threads, and compares the tokens
+bool sameTokens(const std::string &name, const std::string &source,
+                size_t chunkBytes) {
+  core::FileId id = core::SourceManager::instance().addFile(name, source);
+  std::vector<tokens::Token> whole = lexer::Lexer(id).tokenize();
+
+  std::vector<std::thread> threads;
+  std::vector<tokens::Token> chunked = lexer::Lexer::tokenizeInChunks(
+      id, chunkBytes,
+      [&threads](std::function<void()> task) { threads.emplace_back(task); });
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  if (whole.size() != chunked.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < whole.size(); ++i) {
+    if (whole[i].getType() != chunked[i].getType() ||
+        whole[i].getOffset() != chunked[i].getOffset() ||
+        whole[i].getLength() != chunked[i].getLength()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+int main() {
+  // Cuts follow the chunk size, right after a line break
+  std::string source = "let a = 1\nlet b = 2\nlet c = 3\nlet d = 4\n";
+  EXPECT(lexer::findLineSplits(source, 15) ==
+         std::vector<std::uint32_t>({0, 20}));
+  EXPECT(lexer::findLineSplits(source, 1000) ==
+         std::vector<std::uint32_t>({0}));
+
+  // Not inside block comments, nor after quotes and comment openers that
+  // literals and line comments hide
+  source = "/* one\ntwo */ let a = \"/*\"\nlet b = '\"'\n// \"\nlet c = 3\n";
+  EXPECT(lexer::findLineSplits(source, 1) ==
+         std::vector<std::uint32_t>({0, 27, 39, 44}));
+  source = "let s = \"unterminated\nlet t = 1\n";
+  EXPECT(lexer::findLineSplits(source, 1) ==
+         std::vector<std::uint32_t>({0, 22}));
+
+  // Chunks lex to the tokens of the whole buffer, with the semicolons
+  // line breaks insert at their seams
+  std::string program;
+  for (int i = 0; i < 2000; ++i) {
+    std::string n = std::to_string(i);
+    program += "function f" + n + "(a: int): int {\n  let s = \"x /* " + n +
+               "\"\n  /* a comment\n     over lines */\n  return a + " + n +
+               "\n}\n";
+  }
+  EXPECT(sameTokens("chunks.tspp", program, 4096));
+
+  // A cut the pre-pass gets wrong falls back to lexing the whole buffer:
+  // the tab ends the string early for the lexer, which then opens the
+  // comment the pre-pass took as part of the string
+  std::string tricky = "let s = \"a\tb /* c\" d\n";
+  for (int i = 0; i < 200; ++i) {
+    tricky += "let v" + std::to_string(i) + " = " + std::to_string(i) + "\n";
+  }
+  tricky += "*/ let done = 1\n";
+  EXPECT(lexer::findLineSplits(tricky, 64).size() > 1);
+  EXPECT(sameTokens("tricky.tspp", tricky, 64));
+  return TEST_RESULT();
+}
@@ -0,0 +1,53 @@
+#include "test_support.h"
+#include "tokens/literal_value.h"
+#include <string>
+
+namespace {
+
+void testNumbers() {
+  using tokens::decodeNumber;
+  EXPECT(decodeNumber("42").isInteger() && decodeNumber("42").integer == 42);
+  EXPECT(decodeNumber("0x1F").integer == 31);
+  EXPECT(decodeNumber("0XfF").integer == 255);
+  EXPECT(decodeNumber("0b1010").integer == 10);
+  EXPECT(decodeNumber("1_000_000").integer == 1000000);
+  EXPECT(decodeNumber("0xFF_FF").integer == 65535);
+
+  // A leading zero is still decimal
+  EXPECT(decodeNumber("010").integer == 10);
+
+  // A fraction or exponent makes a float, but not in hex digits
+  EXPECT(decodeNumber("2.5").isFloat() && decodeNumber("2.5").real == 2.5);
+  EXPECT(decodeNumber("1e3").isFloat() && decodeNumber("1e3").real == 1000);
+  EXPECT(decodeNumber("0x1E").isInteger() && decodeNumber("0x1E").integer == 30);
+
+  EXPECT(!decodeNumber("").isValid());
+  EXPECT(!decodeNumber("0x").isValid());
+  EXPECT(!decodeNumber("0b102").isValid());
+  EXPECT(!decodeNumber("99999999999999999999999").isValid());
+}
+
+void testEscapes() {
+  auto unescape = [](std::string_view body) {
+    std::string out = "<";
+    tokens::appendUnescaped(body, out);
+    return out;
+  };
+  EXPECT(unescape("a\\nb\\tc") == "<a\nb\tc");
+  EXPECT(unescape("\\\"q\\\" \\'s\\' \\\\") == "<\"q\" 's' \\");
+  EXPECT(unescape("\\r\\0!") == std::string("<\r\0!", 4));
+  EXPECT(unescape("\\x41\\x7a") == "<Az");
+  EXPECT(unescape("\\u00e9\\u20AC") == "<\xC3\xA9\xE2\x82\xAC");
+
+  // Anything else keeps its backslash
+  EXPECT(unescape("\\q \\x4") == "<\\q \\x4");
+  EXPECT(unescape("end\\") == "<end\\");
+}
+
+} // namespace
+
+int main() {
+  testNumbers();
+  testEscapes();
+  return TEST_RESULT();
+}
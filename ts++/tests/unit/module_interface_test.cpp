@@ -0,0 +1,105 @@
+#include "core/diagnostics/error_reporter.h"
+#include "lexer/lexer.h"
+#include "parser/parser.h"
+#include "parser/visitors/type_check_visitor/module_interface.h"
+#include "parser/visitors/type_check_visitor/type_check_visitor.h"
+#include "test_support.h"
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+namespace {
+
+using visitors::ModuleInterface;
+
+void writeFile(const char *path, const std::string &contents) {
+  std::ofstream(path, std::ios::binary) << contents;
+}
+
+core::Symbol symbol(const char *name) {
+  return core::Interner::instance().intern(name);
+}
+
+} // namespace
+
+int main() {
+  // Enough declarations that decoding everything would show
+  std::string source = "class Node { let value: int; let next: Node; }\n"
+                       "enum Mode { Fast, Safe }\n"
+                       "function head(n: Node): Node { return n; }\n";
+  for (int i = 0; i < 50; ++i) {
+    std::string n = std::to_string(i);
+    source += "function f" + n + "(a: int[], b: float): bool[] { return []; }\n";
+  }
+
+  core::ErrorReporter reporter(false);
+  lexer::Lexer lexer(source, "interface_unit.tspp");
+  parser::Parser parser(lexer.tokenize(), reporter);
+  EXPECT(parser.parse(false));
+  visitors::TypeScope scope;
+  visitors::TypeCheckVisitor(reporter, &scope).declareAST(parser.getAST());
+  EXPECT(!reporter.hasErrors());
+
+  std::string contents = ModuleInterface::serialize(parser.getAST(), scope);
+  EXPECT(ModuleInterface::serialize(parser.getAST(), scope) == contents);
+
+  const char *path = "module_interface_test.tspi";
+  writeFile(path, contents);
+  std::string error;
+  auto interface = ModuleInterface::open(path, error);
+  EXPECT(interface != nullptr);
+  if (!interface) {
+    return TEST_RESULT();
+  }
+
+  // Nothing is decoded until it is looked up, and then only what it needs
+  EXPECT(interface->getDeclarationCount() == 54);
+  EXPECT(interface->getDecodedTypeCount() == 0);
+  auto f7 = interface->lookup(symbol("f7"), ModuleInterface::Kind::Function);
+  EXPECT(f7 && f7 == scope.lookupFunction("f7"));
+  size_t decoded = interface->getDecodedTypeCount();
+  EXPECT(decoded > 0 && decoded <= 6);
+  EXPECT(interface->lookup(symbol("f8"), ModuleInterface::Kind::Function) ==
+         f7);
+  EXPECT(interface->getDecodedTypeCount() == decoded);
+  EXPECT(!interface->lookup(symbol("f7"), ModuleInterface::Kind::Type));
+  EXPECT(!interface->lookup(symbol("missing"),
+                            ModuleInterface::Kind::Function));
+
+  // An enum is both an int type and a value holding its constants
+  EXPECT(interface->lookup(symbol("Mode"), ModuleInterface::Kind::Type) ==
+         scope.lookupType("Mode"));
+  EXPECT(interface->lookup(symbol("Mode"), ModuleInterface::Kind::Variable) ==
+         scope.lookupVariable("Mode"));
+
+  // A scope falls back to its imports for names it does not declare
+  visitors::TypeScope importer;
+  importer.addImport(std::move(interface));
+  auto head = importer.lookupFunction("head");
+  EXPECT(head && head == scope.lookupFunction("head"));
+  auto &types = visitors::TypeContext::instance();
+  auto node = types.getNamed("Node");
+  EXPECT(types.lookupMember(*node, symbol("next")) == node);
+  importer.declareFunction("head", types.getInt());
+  EXPECT(importer.lookupFunction("head") == types.getInt());
+
+  // Damaged files are rejected up front or decode to nothing
+  writeFile(path, "TSPX" + contents.substr(4));
+  EXPECT(!ModuleInterface::open(path, error));
+  writeFile(path, contents.substr(0, 20));
+  EXPECT(!ModuleInterface::open(path, error));
+  std::string corrupt = contents;
+  for (size_t i = 200; i < corrupt.size(); i += 7) {
+    corrupt[i] = '\xff';
+  }
+  writeFile(path, corrupt);
+  if (auto damaged = ModuleInterface::open(path, error)) {
+    for (int i = 0; i < 50; ++i) {
+      std::string name = "f" + std::to_string(i);
+      damaged->lookup(symbol(name.c_str()), ModuleInterface::Kind::Function);
+    }
+  }
+
+  std::remove(path);
+  return TEST_RESULT();
+}
@@ -0,0 +1,75 @@
+#include "runtime/tspp_runtime.h"
+#include "test_support.h"
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+bool aligned(void *ptr, uintptr_t align) {
+  return reinterpret_cast<uintptr_t>(ptr) % align == 0;
+}
+
+// Objects fill chunk after chunk, keep their alignment and stay intact
+// until the arena closes; tspp_free leaves them alone
+void testBumpAllocation() {
+  tspp_arena *arena = tspp_arena_enter();
+  EXPECT(arena != nullptr);
+  std::vector<int64_t *> objects;
+  for (int64_t i = 0; i < 100000; ++i) {
+    auto object = static_cast<int64_t *>(tspp_new(24, 8));
+    EXPECT(aligned(object, 16));
+    object[0] = i;
+    object[2] = -i;
+    objects.push_back(object);
+  }
+  tspp_free(objects[5]);
+  void *wide = tspp_new(64, 256);
+  EXPECT(aligned(wide, 256));
+  for (int64_t i = 0; i < 100000; ++i) {
+    EXPECT(objects[i][0] == i && objects[i][2] == -i);
+  }
+  tspp_arena_exit(arena);
+}
+
+// A request larger than a chunk gets its own, and the chunk it interrupted
+// keeps serving small ones
+void testLargeObjects() {
+  tspp_arena *arena = tspp_arena_enter();
+  auto first = static_cast<char *>(tspp_new(16, 16));
+  auto large = static_cast<char *>(tspp_new(1 << 22, 64));
+  std::memset(large, 7, 1 << 22);
+  auto second = static_cast<char *>(tspp_new(16, 16));
+  EXPECT(second == first + 16);
+  EXPECT(large[(1 << 22) - 1] == 7);
+  tspp_free(large);
+  tspp_arena_exit(arena);
+}
+
+// Inner arenas take the allocations until they close; outside any arena
+// objects come from the heap and are freed one by one
+void testNesting() {
+  tspp_arena *outer = tspp_arena_enter();
+  auto before = static_cast<char *>(tspp_new(32, 16));
+  tspp_arena *inner = tspp_arena_enter();
+  EXPECT(inner != outer);
+  tspp_new(32, 16);
+  tspp_arena_exit(inner);
+  auto after = static_cast<char *>(tspp_new(32, 16));
+  EXPECT(after == before + 32);
+  tspp_arena_exit(outer);
+
+  void *heap = tspp_new(32, 16);
+  EXPECT(heap != nullptr);
+  tspp_free(heap);
+  tspp_arena_exit(nullptr);
+}
+
+} // namespace
+
+int main() {
+  testBumpAllocation();
+  testLargeObjects();
+  testNesting();
+  return TEST_RESULT();
+}
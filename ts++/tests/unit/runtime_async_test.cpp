@@ -0,0 +1,67 @@
+#include "runtime/tspp_runtime.h"
+#include "test_support.h"
+#include <cstdlib>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+// Stands in for a coroutine frame: the executor only calls the resume
+// function at its start, which marks the frame done by clearing it
+struct FakeFrame {
+  void (*resume)(void *);
+  void (*destroy)(void *);
+  int resumed;
+};
+
+void resumeFrame(void *handle) {
+  auto frame = static_cast<FakeFrame *>(handle);
+  ++frame->resumed;
+  frame->resume = nullptr;
+}
+
+void destroyFrame(void *) {}
+
+// Many tasks wait on pipes while the caller sleeps; every write wakes its
+// task before the sleep ends
+void testDescriptorWaits() {
+  constexpr int kPipes = 100;
+  std::vector<int> fds(kPipes * 2);
+  std::vector<FakeFrame> frames(kPipes, {resumeFrame, destroyFrame, 0});
+  for (int i = 0; i < kPipes; ++i) {
+    EXPECT(pipe(&fds[i * 2]) == 0);
+    tspp_async_wait_fd(&frames[i], fds[i * 2], TSPP_WAIT_READABLE);
+  }
+  for (int i = 0; i < kPipes; i += 2) {
+    EXPECT(write(fds[i * 2 + 1], "x", 1) == 1);
+  }
+  tspp_async_sleep(nullptr, 20);
+  for (int i = 0; i < kPipes; ++i) {
+    EXPECT(frames[i].resumed == (i % 2 == 0 ? 1 : 0));
+  }
+
+  // The rest wake once written to, and a blocking wait returns when its
+  // descriptor is ready
+  for (int i = 1; i < kPipes; i += 2) {
+    EXPECT(write(fds[i * 2 + 1], "x", 1) == 1);
+  }
+  tspp_async_wait_fd(nullptr, fds[1], TSPP_WAIT_WRITABLE);
+  tspp_async_sleep(nullptr, 0);
+  for (int i = 0; i < kPipes; ++i) {
+    EXPECT(frames[i].resumed == 1);
+  }
+  for (int fd : fds) {
+    close(fd);
+  }
+}
+
+} // namespace
+
+int main() {
+  // Each thread picks its backend on its first wait
+  std::thread([] { testDescriptorWaits(); }).join();
+  setenv("TSPP_IO", "epoll", 1);
+  std::thread([] { testDescriptorWaits(); }).join();
+  return TEST_RESULT();
+}
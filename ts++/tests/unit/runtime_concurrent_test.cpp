@@ -0,0 +1,121 @@
+#include "runtime/tspp_runtime.h"
+#include "test_support.h"
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr int kThreads = 4;
+constexpr int64_t kPerThread = 20000;
+
+// Producers push disjoint ranges through a small queue while consumers pop;
+// every value comes out exactly once
+void testMpmcQueue() {
+  tspp_mpmc *queue = tspp_mpmc_new(64, sizeof(int64_t), alignof(int64_t));
+  std::vector<std::atomic<int>> seen(kThreads * kPerThread);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([queue, t] {
+      for (int64_t i = 0; i < kPerThread; ++i) {
+        int64_t value = t * kPerThread + i;
+        tspp_mpmc_push(queue, &value);
+      }
+    });
+    threads.emplace_back([queue, &seen] {
+      for (int64_t i = 0; i < kPerThread; ++i) {
+        int64_t value = -1;
+        tspp_mpmc_pop(queue, &value);
+        ++seen[value];
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  for (auto &count : seen) {
+    EXPECT(count == 1);
+  }
+  int64_t value = 0;
+  EXPECT(tspp_mpmc_try_pop(queue, &value) == 0);
+
+  // A capacity is rounded up to a power of two
+  tspp_mpmc *small = tspp_mpmc_new(3, sizeof(int64_t), alignof(int64_t));
+  for (value = 0; value < 4; ++value) {
+    EXPECT(tspp_mpmc_try_push(small, &value) == 1);
+  }
+  EXPECT(tspp_mpmc_try_push(small, &value) == 0);
+  EXPECT(tspp_mpmc_try_pop(small, &value) == 1 && value == 0);
+}
+
+// One thread pushes in order and another sees the same order; odd element
+// sizes are copied whole
+void testSpscQueue() {
+  struct Triple {
+    int16_t a, b, c;
+  };
+  tspp_spsc *queue = tspp_spsc_new(16, sizeof(Triple), alignof(Triple));
+  std::thread producer([queue] {
+    for (int16_t i = 0; i < 10000; ++i) {
+      Triple triple{i, static_cast<int16_t>(i + 1), static_cast<int16_t>(-i)};
+      tspp_spsc_push(queue, &triple);
+    }
+  });
+  for (int16_t i = 0; i < 10000; ++i) {
+    Triple triple{};
+    tspp_spsc_pop(queue, &triple);
+    EXPECT(triple.a == i && triple.b == i + 1 && triple.c == -i);
+  }
+  producer.join();
+  Triple triple{};
+  EXPECT(tspp_spsc_try_pop(queue, &triple) == 0);
+}
+
+// Threads fill and empty overlapping key ranges; the shards grow as they go
+void testMap() {
+  tspp_map *map = tspp_map_new(sizeof(double), alignof(double));
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([map, t] {
+      for (int64_t key = t; key < kThreads * kPerThread; key += kThreads) {
+        double value = key * 0.5;
+        tspp_map_put(map, key, &value);
+      }
+      // Every thread removes the odd keys it put
+      for (int64_t key = t; key < kThreads * kPerThread; key += kThreads) {
+        if (key % 2 == 1) {
+          EXPECT(tspp_map_remove(map, key) == 1);
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  EXPECT(tspp_map_size(map) == kThreads * kPerThread / 2);
+  for (int64_t key = 0; key < kThreads * kPerThread; ++key) {
+    double value = -1;
+    EXPECT(tspp_map_get(map, key, &value) == (key % 2 == 0 ? 1 : 0));
+    EXPECT(value == (key % 2 == 0 ? key * 0.5 : -1));
+  }
+
+  // Putting a key again replaces its value; negative keys hash like others
+  double value = 7;
+  tspp_map_put(map, -3, &value);
+  value = 8;
+  tspp_map_put(map, -3, &value);
+  EXPECT(tspp_map_get(map, -3, &value) == 1 && value == 8);
+  EXPECT(tspp_map_get(map, -3, nullptr) == 1);
+  EXPECT(tspp_map_remove(map, -3) == 1);
+  EXPECT(tspp_map_remove(map, -3) == 0);
+}
+
+} // namespace
+
+int main() {
+  testMpmcQueue();
+  testSpscQueue();
+  testMap();
+  return TEST_RESULT();
+}
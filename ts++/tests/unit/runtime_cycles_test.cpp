@@ -0,0 +1,201 @@
+#include "runtime/tspp_runtime.h"
+#include "test_support.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace {
+
+// A class with two #shared fields and a #weak one
+struct Node {
+  Node *next;
+  Node *other;
+  Node *back;
+  int64_t value;
+};
+
+const uint32_t kNodeOffsets[] = {offsetof(Node, next), offsetof(Node, other),
+                                 offsetof(Node, back)};
+const tspp_shared_type kNodeType = {2, 1, kNodeOffsets};
+
+Node *makeNode(int64_t value) {
+  auto node = static_cast<Node *>(
+      tspp_shared_alloc(sizeof(Node), alignof(Node), &kNodeType));
+  node->next = nullptr;
+  node->other = nullptr;
+  node->back = nullptr;
+  node->value = value;
+  return node;
+}
+
+// Stores into a #shared field as the generated code does
+void set(Node *&field, Node *value) {
+  tspp_shared_retain(value);
+  Node *previous = field;
+  field = value;
+  tspp_shared_release(previous);
+}
+
+void setNext(Node *node, Node *next) { set(node->next, next); }
+
+// A weak reference that outlives the strong ones, to watch an object die
+Node *watch(Node *node) {
+  tspp_weak_retain(node);
+  return node;
+}
+
+bool alive(Node *watched) {
+  auto locked = static_cast<Node *>(tspp_weak_lock(watched));
+  tspp_shared_release(locked);
+  return locked != nullptr;
+}
+
+// A ring whose last outside reference is dropped is freed by a collection,
+// and releases what its members refer to outside the ring
+void testRing() {
+  Node *outside = makeNode(-1);
+  Node *watched = watch(outside);
+  Node *first = makeNode(0);
+  Node *ring = watch(first);
+  Node *last = first;
+  for (int64_t i = 1; i < 10; ++i) {
+    Node *node = makeNode(i);
+    setNext(last, node);
+    tspp_shared_release(node);
+    last = node;
+  }
+  setNext(last, first);
+  set(first->next->other, outside);
+  tspp_shared_release(outside);
+
+  tspp_shared_release(first);
+  EXPECT(alive(ring));
+  tspp_shared_collect();
+  EXPECT(!alive(ring));
+  EXPECT(!alive(watched));
+  tspp_weak_release(ring);
+  tspp_weak_release(watched);
+}
+
+// A class with no counted fields, allocated without a type
+struct Leaf {
+  int64_t value;
+};
+
+// Garbage cycles free the objects they own that have no fields to trace
+void testLeafInCycle() {
+  auto leaf = static_cast<Leaf *>(
+      tspp_shared_alloc(sizeof(Leaf), alignof(Leaf), nullptr));
+  leaf->value = 7;
+  Node *watchedLeaf = watch(reinterpret_cast<Node *>(leaf));
+  Node *a = makeNode(1);
+  Node *b = makeNode(2);
+  setNext(a, b);
+  setNext(b, a);
+  set(a->other, reinterpret_cast<Node *>(leaf));
+  tspp_shared_release(reinterpret_cast<Node *>(leaf));
+  tspp_shared_release(b);
+  Node *watched = watch(a);
+  tspp_shared_release(a);
+  tspp_shared_collect();
+  EXPECT(!alive(watched));
+  EXPECT(!alive(watchedLeaf));
+  tspp_weak_release(watched);
+  tspp_weak_release(watchedLeaf);
+}
+
+// A cycle still referenced from outside keeps every count it had
+void testLiveCycle() {
+  Node *a = makeNode(1);
+  Node *b = makeNode(2);
+  setNext(a, b);
+  setNext(b, a);
+  tspp_shared_retain(b);
+  tspp_shared_release(b);
+  tspp_shared_collect();
+  EXPECT(a->next == b && b->next == a);
+
+  // Once a is dropped too, the pair is garbage
+  Node *watched = watch(b);
+  tspp_shared_release(b);
+  tspp_shared_release(a);
+  tspp_shared_collect();
+  EXPECT(!alive(watched));
+  tspp_weak_release(watched);
+}
+
+// Weak fields do not keep a cycle alive, and dying objects release them
+void testWeakFields() {
+  Node *parent = makeNode(1);
+  Node *child = makeNode(2);
+  setNext(parent, child);
+  tspp_weak_retain(parent);
+  child->back = parent;
+  Node *watched = watch(child);
+  tspp_shared_release(child);
+  tspp_shared_release(parent);
+  EXPECT(!alive(watched));
+  tspp_weak_release(watched);
+}
+
+// Long chains die without recursion, and enough garbage cycles start a
+// collection without being asked
+void testChainsAndSlices() {
+  Node *head = makeNode(0);
+  Node *last = head;
+  for (int64_t i = 1; i < 1000000; ++i) {
+    Node *node = makeNode(i);
+    setNext(last, node);
+    tspp_shared_release(node);
+    last = node;
+  }
+  Node *tail = watch(last);
+  tspp_shared_release(head);
+  EXPECT(!alive(tail));
+  tspp_weak_release(tail);
+
+  std::vector<Node *> watched;
+  for (int i = 0; i < 20000; ++i) {
+    Node *a = makeNode(i);
+    Node *b = makeNode(i);
+    setNext(a, b);
+    setNext(b, a);
+    tspp_shared_release(b);
+    if (i < 8) {
+      watched.push_back(watch(a));
+    }
+    tspp_shared_release(a);
+  }
+  for (Node *node : watched) {
+    EXPECT(!alive(node));
+    tspp_weak_release(node);
+  }
+  tspp_shared_collect();
+}
+
+// Published objects are not collected by a thread of their own
+void testPublished() {
+  Node *a = makeNode(1);
+  Node *b = makeNode(2);
+  setNext(a, b);
+  setNext(b, a);
+  tspp_shared_publish(a);
+  Node *watched = watch(b);
+  tspp_shared_release(b);
+  tspp_shared_release(a);
+  tspp_shared_collect();
+  EXPECT(alive(watched));
+  tspp_weak_release(watched);
+}
+
+} // namespace
+
+int main() {
+  testRing();
+  testLeafInCycle();
+  testLiveCycle();
+  testWeakFields();
+  testChainsAndSlices();
+  testPublished();
+  return TEST_RESULT();
+}
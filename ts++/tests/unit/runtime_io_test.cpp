@@ -0,0 +1,129 @@
+#include "runtime/tspp_runtime.h"
+#include "test_support.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+
+namespace {
+
+// Runs body with standard output sent to a file and returns what it wrote
+template <typename Body> std::string captureOutput(Body body) {
+  std::fflush(stdout);
+  std::FILE *file = std::tmpfile();
+  int saved = dup(STDOUT_FILENO);
+  dup2(fileno(file), STDOUT_FILENO);
+  body();
+  tspp_flush();
+  dup2(saved, STDOUT_FILENO);
+  close(saved);
+
+  std::string text;
+  std::rewind(file);
+  char chunk[4096];
+  size_t read;
+  while ((read = std::fread(chunk, 1, sizeof(chunk), file)) != 0) {
+    text.append(chunk, read);
+  }
+  std::fclose(file);
+  return text;
+}
+
+void testIntegers() {
+  EXPECT(captureOutput([] { tspp_write_int(0); }) == "0");
+  EXPECT(captureOutput([] { tspp_write_int(-42); }) == "-42");
+  EXPECT(captureOutput([] { tspp_write_int(INT64_MAX); }) ==
+         "9223372036854775807");
+  EXPECT(captureOutput([] { tspp_write_int(INT64_MIN); }) ==
+         "-9223372036854775808");
+}
+
+void testFloats() {
+  EXPECT(captureOutput([] { tspp_write_float(0.1); }) == "0.1");
+  EXPECT(captureOutput([] { tspp_write_float(-2.5); }) == "-2.5");
+  EXPECT(captureOutput([] { tspp_write_float(1.0 / 3.0); }) ==
+         "0.3333333333333333");
+  EXPECT(captureOutput([] { tspp_write_float(1e300); }) == "1e+300");
+  EXPECT(captureOutput([] { tspp_write_float(1.0 / 0.0); }) == "inf");
+  EXPECT(captureOutput([] { tspp_write_float(-1.0 / 0.0); }) == "-inf");
+  EXPECT(captureOutput([] { tspp_write_float(0.0 / 0.0); }) == "nan");
+}
+
+void testOrdering() {
+  // Buffered text stays behind C library output written after it until a
+  // flush, which sends the C library's first
+  EXPECT(captureOutput([] {
+           tspp_write("a", 1);
+           std::fputs("b", stdout);
+         }) == "ba");
+  EXPECT(captureOutput([] {
+           std::fputs("a", stdout);
+           tspp_write("b", 1);
+         }) == "ab");
+}
+
+void testLargeWrites() {
+  // Fills the buffer past its size, then writes more than it holds at once
+  std::string small(1000, 'x');
+  std::string large(100 * 1024, 'y');
+  std::string text = captureOutput([&] {
+    for (int i = 0; i < 70; ++i) {
+      tspp_write(small.data(), small.size());
+    }
+    tspp_write(large.data(), large.size());
+  });
+  EXPECT(text == std::string(70000, 'x') + large);
+}
+
+// Views path through a tspp string, which points at it
+tspp_bytes mapPath(const std::string &path) {
+  tspp_string string;
+  string.length = static_cast<int64_t>(path.size());
+  if (path.size() < TSPP_STRING_SMALL) {
+    std::memcpy(string.bytes.small, path.c_str(), path.size() + 1);
+  } else {
+    string.bytes.large.data = path.c_str();
+    string.bytes.large.capacity = 0;
+  }
+  tspp_bytes bytes;
+  tspp_map_file(&bytes, &string);
+  return bytes;
+}
+
+void testMappedFiles() {
+  char path[] = "/tmp/tspp_map_XXXXXX";
+  int fd = mkstemp(path);
+  EXPECT(fd >= 0);
+  std::string contents(10000, 'z');
+  contents += "end";
+  EXPECT(write(fd, contents.data(), contents.size()) ==
+         static_cast<ssize_t>(contents.size()));
+
+  tspp_bytes bytes = mapPath(path);
+  EXPECT(bytes.length == static_cast<int64_t>(contents.size()));
+  EXPECT(bytes.data && std::memcmp(bytes.data, contents.data(),
+                                   contents.size()) == 0);
+  tspp_unmap_file(bytes.data, bytes.length);
+
+  // Empty and missing files map to empty views
+  EXPECT(ftruncate(fd, 0) == 0);
+  bytes = mapPath(path);
+  EXPECT(!bytes.data && bytes.length == 0);
+  close(fd);
+  unlink(path);
+  bytes = mapPath(path);
+  EXPECT(!bytes.data && bytes.length == 0);
+  tspp_unmap_file(bytes.data, bytes.length);
+}
+
+} // namespace
+
+int main() {
+  testIntegers();
+  testFloats();
+  testOrdering();
+  testLargeWrites();
+  testMappedFiles();
+  return TEST_RESULT();
+}
@@ -0,0 +1,124 @@
+#include "runtime/tspp_runtime.h"
+#include "test_support.h"
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <pthread.h>
+#include <sched.h>
+#include <vector>
+
+namespace {
+
+struct Visits {
+  std::vector<std::atomic<int>> counts;
+  explicit Visits(int32_t count) : counts(count) {}
+};
+
+void visit(void *env, int32_t begin, int32_t end) {
+  auto visits = static_cast<Visits *>(env);
+  for (int32_t i = begin; i < end; ++i) {
+    ++visits->counts[i];
+  }
+}
+
+// Home blocks and the ranges split from them cover every iteration once,
+// also with fewer iterations than workers
+void testCoverage() {
+  for (int32_t count : {1, 2, 3, 5, 64, 1000, 100003}) {
+    Visits visits(count);
+    tspp_parallel_for(visit, &visits, count);
+    for (auto &seen : visits.counts) {
+      EXPECT(seen == 1);
+    }
+  }
+}
+
+struct Nested {
+  Visits inner{8 * 100};
+};
+
+void nestedRow(void *env, int32_t begin, int32_t end) {
+  auto nested = static_cast<Nested *>(env);
+  for (int32_t row = begin; row < end; ++row) {
+    struct Row {
+      Nested *nested;
+      int32_t row;
+    } context{nested, row};
+    tspp_parallel_for(
+        [](void *env, int32_t begin, int32_t end) {
+          auto context = static_cast<Row *>(env);
+          for (int32_t i = begin; i < end; ++i) {
+            ++context->nested->inner.counts[context->row * 100 + i];
+          }
+        },
+        &context, 100);
+  }
+}
+
+// A loop inside an iteration posts its blocks while the outer loop's may
+// still be in the mailboxes
+void testNesting() {
+  Nested nested;
+  tspp_parallel_for(nestedRow, &nested, 8);
+  for (auto &seen : nested.inner.counts) {
+    EXPECT(seen == 1);
+  }
+}
+
+struct Placement {
+  pthread_t caller;
+  std::atomic<int> unpinned{0};
+  std::atomic<int> allocationFailures{0};
+};
+
+// Pool threads run on one CPU each, and allocate from slabs of their own
+void checkPlacement(void *env, int32_t begin, int32_t end) {
+  auto placement = static_cast<Placement *>(env);
+  if (!pthread_equal(pthread_self(), placement->caller)) {
+#ifdef __linux__
+    cpu_set_t cpus;
+    if (pthread_getaffinity_np(pthread_self(), sizeof cpus, &cpus) == 0 &&
+        CPU_COUNT(&cpus) != 1) {
+      ++placement->unpinned;
+    }
+#endif
+  }
+  for (int32_t i = begin; i < end; ++i) {
+    void *object = tspp_alloc(48, 16);
+    if (!object) {
+      ++placement->allocationFailures;
+    }
+    tspp_free(object);
+  }
+}
+
+void testPlacement() {
+  Placement placement;
+  placement.caller = pthread_self();
+  tspp_parallel_for(checkPlacement, &placement, 4096);
+  EXPECT(placement.unpinned == 0);
+  EXPECT(placement.allocationFailures == 0);
+
+  // Slabs placed on a node are ordinary memory
+  tspp_set_thread_node(0);
+  std::vector<void *> objects;
+  for (int i = 0; i < 10000; ++i) {
+    objects.push_back(tspp_alloc(256, 16));
+    EXPECT(objects.back() != nullptr);
+  }
+  for (void *object : objects) {
+    tspp_free(object);
+  }
+  tspp_set_thread_node(-1);
+}
+
+} // namespace
+
+int main() {
+  // More workers than this machine may have cores, so they wrap around
+  setenv("TSPP_WORKERS", "4", 1);
+  testCoverage();
+  testNesting();
+  testPlacement();
+  return TEST_RESULT();
+}
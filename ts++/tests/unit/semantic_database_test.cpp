@@ -0,0 +1,174 @@
+#include "lsp/language_server.h"
+#include "lsp/semantic_database.h"
+#include "test_support.h"
+#include <sstream>
+#include <string>
+
+namespace {
+
+std::string function(int i) {
+  std::string n = std::to_string(i);
+  return "function f" + n + "(a: int): int {\n  let b: int = a + " + n +
+         ";\n  return b;\n}\n";
+}
+
+// Position of the first `text` after `after` in a document
+lsp::Position find(lsp::SemanticDatabase &database, const std::string &path,
+                   const std::string &after, const std::string &text) {
+  const std::string &source = database.getText(path);
+  size_t at = source.find(text, source.find(after));
+  return database.toPosition(path, static_cast<std::uint32_t>(at));
+}
+
+// Replaces the first `from` after `after` in a document with `to`
+void replace(lsp::SemanticDatabase &database, const std::string &path,
+             const std::string &after, const std::string &from,
+             const std::string &to) {
+  const std::string &source = database.getText(path);
+  size_t at = source.find(from, source.find(after));
+  database.applyEdit(path, {static_cast<std::uint32_t>(at),
+                            static_cast<std::uint32_t>(from.size()), to});
+}
+
+std::string frame(const std::string &content) {
+  return "Content-Length: " + std::to_string(content.size()) + "\r\n\r\n" +
+         content;
+}
+
+} // namespace
+
+int main() {
+  lsp::SemanticDatabase database;
+  std::string shapes = "class Point {\n  let x: int;\n}\n"
+                       "function origin(): Point {\n  return new Point();\n}\n";
+  std::string main;
+  for (int i = 0; i < 100; ++i) {
+    main += function(i);
+  }
+  main += "function g(p: Point): int {\n  return f7(p.x);\n}\n";
+  database.setText("/project/shapes.tspp", shapes);
+  database.setText("/project/main.tspp", main);
+
+  EXPECT(database.diagnostics("/project/main.tspp").empty());
+  EXPECT(database.diagnostics("/project/shapes.tspp").empty());
+  EXPECT(database.getStats().declarations == 1);
+  EXPECT(database.getStats().checkedDefinitions == 102);
+
+  // Asking again computes nothing
+  auto stats = database.getStats();
+  EXPECT(database.diagnostics("/project/main.tspp").empty());
+  EXPECT(database.getStats().diagnostics == stats.diagnostics);
+  EXPECT(database.getStats().signatures == stats.signatures);
+
+  // An error in a body checks that body again, and nothing else
+  auto changed = database.diagnosticsChangedAt("/project/main.tspp");
+  replace(database, "/project/main.tspp", "function f50(", "return b;",
+          "return missing;");
+  const auto &errors = database.diagnostics("/project/main.tspp");
+  EXPECT(errors.size() == 1);
+  EXPECT(!errors.empty() &&
+         errors[0].range.start ==
+             find(database, "/project/main.tspp", "function f50(", "missing") &&
+         errors[0].range.end.character - errors[0].range.start.character == 7);
+  EXPECT(database.getStats().declarations == 1);
+  EXPECT(database.getStats().checkedDefinitions == 103);
+  EXPECT(database.diagnosticsChangedAt("/project/main.tspp") > changed);
+  EXPECT(database.diagnostics("/project/shapes.tspp").empty());
+
+  // Lines inserted above move the diagnostics of reused definitions
+  replace(database, "/project/main.tspp", "function f10(", "let", "\n\n  let");
+  EXPECT(database.diagnostics("/project/main.tspp").size() == 1);
+  EXPECT(database.diagnostics("/project/main.tspp")[0].range.start ==
+         find(database, "/project/main.tspp", "function f50(", "missing"));
+  EXPECT(database.getStats().checkedDefinitions == 104);
+
+  // A changed signature declares the program again and checks every body
+  replace(database, "/project/shapes.tspp", "x: int", "x: int", "x: float");
+  auto declarations = database.getStats().declarations;
+  EXPECT(database.diagnostics("/project/main.tspp").size() == 2);
+  EXPECT(database.getStats().declarations == declarations + 1);
+  replace(database, "/project/shapes.tspp", "x: float", "x: float", "x: int");
+  replace(database, "/project/main.tspp", "function f50(", "missing", "b");
+  EXPECT(database.diagnostics("/project/main.tspp").empty());
+
+  // Whitespace and comments leave the signature as it was
+  declarations = database.getStats().declarations;
+  replace(database, "/project/shapes.tspp", "class", "class", "// Shapes\nclass");
+  EXPECT(database.diagnostics("/project/main.tspp").empty());
+  EXPECT(database.getStats().declarations == declarations);
+
+  // Definitions and hovers across documents
+  auto position = find(database, "/project/main.tspp", "function g(", "f7");
+  auto location = database.definition("/project/main.tspp", position);
+  EXPECT(location && location->path == "/project/main.tspp" &&
+         location->range.start ==
+             find(database, "/project/main.tspp", "function f7(", "f7"));
+  EXPECT(database.hover("/project/main.tspp", position) ==
+         "f7: function(int): int");
+  position = find(database, "/project/main.tspp", "function g(", "Point");
+  location = database.definition("/project/main.tspp", position);
+  EXPECT(location && location->path == "/project/shapes.tspp" &&
+         location->range.start ==
+             find(database, "/project/shapes.tspp", "class", "Point"));
+  EXPECT(database.hover("/project/main.tspp", position) == "class Point");
+  position = find(database, "/project/main.tspp", "function g(", "x");
+  EXPECT(database.hover("/project/main.tspp", position) == "x: int");
+  position = find(database, "/project/main.tspp", "function f3(", "b;");
+  location = database.definition("/project/main.tspp", position);
+  EXPECT(location && location->range.start ==
+                         find(database, "/project/main.tspp", "function f3(",
+                              "b: int"));
+  EXPECT(database.hover("/project/main.tspp", position) == "b: int");
+  EXPECT(!database.definition("/project/main.tspp", {0, 0}));
+
+  // The server speaks JSON-RPC over the same database
+  std::string uri = "file:///project/doc%20one.tspp";
+  std::string input =
+      frame(R"({"jsonrpc":"2.0","id":1,"method":"initialize","params":{}})") +
+      frame(R"({"jsonrpc":"2.0","method":"textDocument/didOpen","params":{)"
+            R"("textDocument":{"uri":")" + uri + R"(","text":)"
+            R"("function f(): int {\n  return 1;\n}\n"}}})") +
+      frame(R"({"jsonrpc":"2.0","method":"textDocument/didChange","params":{)"
+            R"("textDocument":{"uri":")" + uri + R"("},"contentChanges":[{)"
+            R"("range":{"start":{"line":1,"character":9},)"
+            R"("end":{"line":1,"character":10}},"text":"oops"}]}})") +
+      frame(R"({"jsonrpc":"2.0","id":2,"method":"textDocument/hover",)"
+            R"("params":{"textDocument":{"uri":")" + uri + R"("},)"
+            R"("position":{"line":0,"character":9}}})") +
+      frame(R"({"jsonrpc":"2.0","id":3,"method":"unknown"})") +
+      frame(R"({"jsonrpc":"2.0","id":4,"method":"shutdown"})") +
+      frame(R"({"jsonrpc":"2.0","method":"exit"})");
+  std::istringstream in(input);
+  std::ostringstream out;
+  lsp::LanguageServer server(in, out);
+  EXPECT(server.run() == 0);
+  std::string output = out.str();
+  EXPECT(output.find(R"("hoverProvider":true)") != std::string::npos);
+  EXPECT(output.find(R"("diagnostics":[])") != std::string::npos);
+  EXPECT(output.find(R"("uri":"file:///project/doc%20one.tspp")") !=
+         std::string::npos);
+  EXPECT(output.find("oops") != std::string::npos);
+  EXPECT(output.find(R"("value":"f: function(): int")") != std::string::npos);
+  EXPECT(output.find(R"("code":-32601)") != std::string::npos);
+  EXPECT(server.getDatabase().getText("/project/doc one.tspp") ==
+         "function f(): int {\n  return oops;\n}\n");
+
+  // Bad lengths are answered with an error instead of ending the server
+  std::istringstream badIn(
+      "Content-Length: abc\r\n\r\n" +
+      frame(R"({"jsonrpc":"2.0","id":5,"method":"shutdown"})") +
+      "Content-Length: 99999999999999999999999\r\n\r\n" +
+      "Content-Length: 1000000000\r\n\r\n{}");
+  std::ostringstream badOut;
+  lsp::LanguageServer badServer(badIn, badOut);
+  EXPECT(badServer.run() == 1);
+  std::string answered = badOut.str();
+  EXPECT(answered.find("Invalid Content-Length: abc") != std::string::npos);
+  EXPECT(answered.find("Invalid Content-Length: 99999999999999999999999") !=
+         std::string::npos);
+  EXPECT(answered.find("Content-Length 1000000000 is over the limit") !=
+         std::string::npos);
+  EXPECT(answered.find(R"("id":5)") != std::string::npos);
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,67 @@
+#include "core/common/source_manager.h"
+#include "test_support.h"
+#include "tokens/tokens.h"
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+int main() {
+  auto &sources = core::SourceManager::instance();
+  core::FileId id = sources.addFile("unit.tspp", "let a = 1;\nlet bc = 22;\n");
+
+  // Lexemes and locations resolve the same on every thread
+  tokens::Token name(tokens::TokenType::IDENTIFIER, id, 15, 2);
+  std::atomic<int> mismatches{0};
+  std::vector<std::thread> readers;
+  for (int t = 0; t < 4; ++t) {
+    readers.emplace_back([&] {
+      for (int i = 0; i < 10000; ++i) {
+        core::SourceLocation location = name.getLocation();
+        if (name.getLexeme() != "bc" || location.getLine() != 2 ||
+            location.getColumn() != 5) {
+          ++mismatches;
+        }
+      }
+    });
+  }
+  for (auto &reader : readers) {
+    reader.join();
+  }
+  EXPECT(mismatches == 0);
+  EXPECT(sources.getLineContent(id, 2) == "let bc = 22;");
+  EXPECT(sources.getFilename(id) == "unit.tspp");
+
+  // Files registered by name are read on first use
+  const char *path = "source_manager_test.tmp";
+  std::ofstream(path) << "first\nsecond";
+  core::FileId lazy = sources.getFileId(path);
+  EXPECT(sources.getBuffer(lazy) == "first\nsecond");
+  EXPECT(sources.getLineColumn(lazy, 7).first == 2);
+  std::remove(path);
+
+  // Files registered later are visible to threads that queried earlier ones
+  core::FileId later = sources.addFile("later.tspp", "x");
+  EXPECT(sources.getBuffer(later) == "x");
+  EXPECT(sources.getBuffer(core::INVALID_FILE_ID).empty());
+
+  // A released buffer is gone, and its id is not handed out again
+  core::FileId released = sources.addFile("released.tspp", "y");
+  sources.releaseFile(released);
+  EXPECT(sources.getBuffer(released).empty());
+  EXPECT(sources.getFilename(released).empty());
+  EXPECT(sources.addFile("released.tspp", "z") > released);
+  sources.releaseFile(released);
+
+  // The lexer's error messages go with their buffer
+  core::FileId lexed = sources.addFile("lexed.tspp", "@");
+  tokens::Token bad =
+      tokens::Token::createError(lexed, 0, 1, "Unexpected character");
+  EXPECT(bad.getErrorMessage() == std::optional<std::string>(
+                                      "Unexpected character"));
+  sources.releaseFile(lexed);
+  EXPECT(!bad.getErrorMessage());
+
+  return TEST_RESULT();
+}
@@ -0,0 +1,77 @@
+#include "codegen/llvm/llvm_string_switch.h"
+#include "test_support.h"
+#include <random>
+#include <set>
+
+namespace {
+
+using codegen::StringSwitchPlan;
+
+// Every label has a slot of its own, and slotOf() finds it from the bytes
+void expectPerfect(const std::vector<std::string> &labels) {
+  StringSwitchPlan plan;
+  EXPECT(plan.build(labels));
+  EXPECT(plan.slots.size() == labels.size());
+  EXPECT(plan.displacements.size() == size_t(1) << plan.bucketBits);
+  std::set<uint32_t> seen;
+  for (size_t i = 0; i < labels.size(); ++i) {
+    EXPECT(plan.slots[i] < (1u << plan.slotBits));
+    EXPECT(plan.slotOf(labels[i].data()) == plan.slots[i]);
+    seen.insert(plan.slots[i]);
+  }
+  EXPECT(seen.size() == labels.size());
+}
+
+// Only the bytes where labels differ are hashed
+void testPositions() {
+  StringSwitchPlan plan;
+  EXPECT(plan.build({"get", "set", "del"}));
+  EXPECT(plan.positions.size() == 1);
+  EXPECT(plan.positions[0] == 0);
+
+  EXPECT(plan.build({"user.name", "user.mail", "user.role", "user.home"}));
+  EXPECT(plan.positions.size() == 1);
+  EXPECT(plan.positions[0] == 5);
+
+  // Labels differing only at the end, and pairwise at several places
+  expectPerfect({"config-key-0001", "config-key-0002", "config-key-0003"});
+  expectPerfect({"aa", "ab", "ba", "bb"});
+}
+
+// Hundreds of random keys of one length still get a table that is at
+// least half full
+void testManyLabels() {
+  std::mt19937 random(7);
+  for (size_t count : {2, 5, 17, 64, 300, 1000}) {
+    std::set<std::string> keys;
+    while (keys.size() < count) {
+      std::string key(12, 'a');
+      for (char &c : key) {
+        c = char('a' + random() % 26);
+      }
+      keys.insert(key);
+    }
+    std::vector<std::string> labels(keys.begin(), keys.end());
+    expectPerfect(labels);
+
+    StringSwitchPlan plan;
+    plan.build(labels);
+    EXPECT(size_t(1) << plan.slotBits < 2 * count);
+  }
+}
+
+// Equal labels cannot be separated
+void testDuplicates() {
+  StringSwitchPlan plan;
+  EXPECT(!plan.build({"same", "same"}));
+  EXPECT(!plan.build({}));
+}
+
+} // namespace
+
+int main() {
+  testPositions();
+  testManyLabels();
+  testDuplicates();
+  return TEST_RESULT();
+}
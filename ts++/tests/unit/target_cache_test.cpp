@@ -0,0 +1,68 @@
+#include "codegen/llvm/llvm_target.h"
+#include "test_support.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+
+namespace {
+
+codegen::CodeGenOptions optionsFor(const std::string &triple) {
+  codegen::CodeGenOptions options;
+  EXPECT(options.parseFlag("--target=" + triple));
+  EXPECT(options.parseFlag("--cpu=generic"));
+  return options;
+}
+
+// A target's machine is created once and handed to later code generators
+void testReuse() {
+  codegen::CodeGenOptions options = optionsFor("x86_64-unknown-linux-gnu");
+  unsigned before = codegen::LLVMTarget::getCreatedMachineCount();
+  llvm::TargetMachine *first;
+  {
+    codegen::LLVMTarget target;
+    EXPECT(target.initialize(options));
+    first = target.getTargetMachine();
+  }
+  codegen::LLVMTarget target;
+  EXPECT(target.initialize(options));
+  EXPECT(target.getTargetMachine() == first);
+  EXPECT(codegen::LLVMTarget::getCreatedMachineCount() == before + 1);
+
+  // One held at the same time gets a machine of its own
+  codegen::LLVMTarget concurrent;
+  EXPECT(concurrent.initialize(options));
+  EXPECT(concurrent.getTargetMachine() != first);
+  EXPECT(codegen::LLVMTarget::getCreatedMachineCount() == before + 2);
+}
+
+// Each triple has its own machine, and modules take its data layout
+void testCrossTargets() {
+  codegen::LLVMTarget target;
+  EXPECT(target.initialize(optionsFor("x86_64-unknown-linux-gnu")));
+  {
+    codegen::LLVMTarget arm;
+    EXPECT(arm.initialize(optionsFor("aarch64-unknown-linux-gnu")));
+    EXPECT(arm.getTriple().getArch() == llvm::Triple::aarch64);
+    EXPECT(arm.getTargetMachine() != target.getTargetMachine());
+
+    llvm::LLVMContext context;
+    llvm::Module module("cross", context);
+    arm.configureModule(module);
+    EXPECT(module.getTargetTriple() == "aarch64-unknown-linux-gnu");
+    EXPECT(module.getDataLayout() ==
+           arm.getTargetMachine()->createDataLayout());
+  }
+
+  // Switching to a triple built before takes its machine back
+  unsigned before = codegen::LLVMTarget::getCreatedMachineCount();
+  EXPECT(target.initialize(optionsFor("aarch64-unknown-linux-gnu")));
+  EXPECT(target.initialize(optionsFor("x86_64-unknown-linux-gnu")));
+  EXPECT(codegen::LLVMTarget::getCreatedMachineCount() == before);
+}
+
+} // namespace
+
+int main() {
+  testReuse();
+  testCrossTargets();
+  return TEST_RESULT();
+}
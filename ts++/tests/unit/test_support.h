@@ -0,0 +1,36 @@
+#pragma once
+#include <cstdlib>
+#include <iostream>
+
+/**
+ * @file test_support.h
+ * @brief Minimal assertions for the unit test executables
+ *
+ * A failed EXPECT prints its location and marks the test as failed; the
+ * executable returns TEST_RESULT() from main so ctest sees the outcome.
+ */
+
+namespace test {
+
+// Number of failed expectations in this executable
+inline int &failures() {
+  static int count = 0;
+  return count;
+}
+
+inline void report(const char *file, int line, const char *expression) {
+  std::cerr << file << ":" << line << ": expectation failed: " << expression
+            << "\n";
+  ++failures();
+}
+
+} // namespace test
+
+#define EXPECT(condition)                                                      \
+  do {                                                                         \
+    if (!(condition)) {                                                        \
+      ::test::report(__FILE__, __LINE__, #condition);                          \
+    }                                                                          \
+  } while (false)
+
+#define TEST_RESULT() (::test::failures() == 0 ? EXIT_SUCCESS : EXIT_FAILURE)
@@ -0,0 +1,86 @@
+#include "core/common/source_manager.h"
+#include "lexer/lexer.h"
+#include "test_support.h"
+#include "tokens/stream/token_stream.h"
+#include <string>
+#include <vector>
+
+int main() {
+  std::string source = "function f(a: int): int {\n  return a + 1\n}\n"
+                       "let x = f(2)\n/* trailing */";
+  for (int i = 0; i < 2000; ++i) {
+    source += "let v" + std::to_string(i) + " = " + std::to_string(i) + "\n";
+  }
+  core::FileId id = core::SourceManager::instance().addFile("stream.tspp",
+                                                            source);
+
+  // Lexing on demand yields the tokens tokenize() does, inserted
+  // semicolons included, and ends in EOF however often it is asked
+  std::vector<tokens::Token> all = lexer::Lexer(id).tokenize();
+  lexer::Lexer lexer(id);
+  size_t mismatches = 0;
+  for (const auto &expected : all) {
+    tokens::Token token = lexer.next();
+    if (token.getType() != expected.getType() ||
+        token.getLexeme() != expected.getLexeme()) {
+      ++mismatches;
+    }
+  }
+  EXPECT(mismatches == 0);
+  EXPECT(lexer.next().getType() == tokens::TokenType::END_OF_FILE);
+
+  // A pulled stream only lexes as far as it is peeked
+  size_t pulled = 0;
+  lexer::Lexer counted(id);
+  tokens::TokenStream stream([&] {
+    ++pulled;
+    return counted.next();
+  });
+  EXPECT(stream.peek().getType() == tokens::TokenType::FUNCTION);
+  EXPECT(stream.peekNext(2).getType() == tokens::TokenType::LEFT_PAREN);
+  EXPECT(pulled == 3);
+
+  // A saved position is kept however far the stream moves on
+  stream.advance();
+  size_t saved = stream.savePosition();
+  for (int i = 0; i < 100; ++i) {
+    stream.advance();
+  }
+  EXPECT(stream.previous().getType() == all[100].getType());
+  stream.restorePosition(saved);
+  EXPECT(stream.peek().getLexeme() == "f");
+  EXPECT(pulled == 101);
+
+  // Held and pulled streams agree from there to the end
+  tokens::TokenStream held(all);
+  held.advance();
+  mismatches = 0;
+  while (!held.isAtEnd()) {
+    if (held.advance().getLexeme() != stream.advance().getLexeme()) {
+      ++mismatches;
+    }
+  }
+  EXPECT(mismatches == 0);
+  EXPECT(stream.isAtEnd());
+  EXPECT(stream.advance().getType() == tokens::TokenType::END_OF_FILE);
+
+  // Token sets hold the types put in them, across word boundaries
+  using tokens::TokenType;
+  constexpr tokens::TokenSet keywords = {TokenType::FUNCTION, TokenType::LET};
+  static_assert(keywords.contains(TokenType::LET));
+  static_assert(!keywords.contains(TokenType::CLASS));
+  constexpr tokens::TokenSet delimiters = tokens::TokenSet::range(
+      TokenType::DELIMITER_BEGIN, TokenType::DELIMITER_END);
+  static_assert(delimiters.contains(TokenType::COMMA) &&
+                !delimiters.contains(TokenType::AT) &&
+                !delimiters.contains(TokenType::YIELD));
+  static_assert((keywords | tokens::TokenSet{TokenType::END_OF_FILE})
+                    .contains(TokenType::END_OF_FILE));
+  tokens::TokenStream sets(all);
+  EXPECT(sets.checkAny(keywords));
+  EXPECT(!sets.matchAny(delimiters));
+  EXPECT(sets.matchAny(keywords));
+  EXPECT(sets.peek().getType() == TokenType::IDENTIFIER);
+
+  return TEST_RESULT();
+}
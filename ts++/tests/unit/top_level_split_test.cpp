@@ -0,0 +1,79 @@
+#include "core/common/source_manager.h"
+#include "core/diagnostics/error_reporter.h"
+#include "lexer/lexer.h"
+#include "parser/parser.h"
+#include "parser/top_level_split.h"
+#include "test_support.h"
+#include <string>
+#include <vector>
+
+namespace {
+
+std::vector<tokens::Token> lex(const std::string &name,
+                               const std::string &source) {
+  core::FileId id = core::SourceManager::instance().addFile(name, source);
+  return lexer::Lexer(id).tokenize();
+}
+
+// The names declared where parts start, after the first
+std::vector<std::string> cuts(const std::vector<tokens::Token> &tokens,
+                              size_t partTokens) {
+  std::vector<std::string> names;
+  std::vector<size_t> starts = parser::splitTopLevel(tokens, partTokens);
+  for (size_t i = 1; i < starts.size(); ++i) {
+    names.push_back(std::string(tokens[starts[i] + 1].getLexeme()));
+  }
+  return names;
+}
+
+} // namespace
+
+int main() {
+  // Parts start at declaration keywords after a block or semicolon
+  auto tokens = lex("decls.tspp", "function a(): int { return 1; }\n"
+                                  "let x: int = 2;\n"
+                                  "class C { f: int; }\n"
+                                  "enum E { A, B }\n");
+  EXPECT(cuts(tokens, 1) == std::vector<std::string>({"C", "E"}));
+  EXPECT(parser::splitTopLevel(tokens, 1000).size() == 1);
+
+  // A statement's block may be followed by more of it, so only its
+  // semicolon ends it, and nothing after unbalanced brackets is cut
+  tokens = lex("statements.tspp", "let f = function(): int { return 1; }\n"
+                                  "function g(): int { return 2; }\n"
+                                  "let y: int = 3;\n"
+                                  "function h(): int { return 4; }\n"
+                                  "while (true) { break; }\n"
+                                  "function i(): int { return (5; }\n"
+                                  "function j(): int { return 6; }\n");
+  EXPECT(cuts(tokens, 1) == std::vector<std::string>({"h"}));
+
+  // Parsing the parts finds the nodes parsing the whole file does
+  std::string source;
+  for (int i = 0; i < 200; ++i) {
+    std::string n = std::to_string(i);
+    source += "function f" + n + "(a: int): int {\n  while (a > " + n +
+              ") { a = a - 1; }\n  return a;\n}\n";
+  }
+  tokens = lex("parts.tspp", source);
+  std::vector<size_t> starts = parser::splitTopLevel(tokens, 100);
+  EXPECT(starts.size() > 10);
+
+  core::ErrorReporter whole(false);
+  parser::Parser parser(tokens, whole);
+  EXPECT(parser.parse(false));
+  size_t nodes = 0;
+  for (size_t i = 0; i < starts.size(); ++i) {
+    size_t end = i + 1 < starts.size() ? starts[i + 1] : tokens.size();
+    core::ErrorReporter diagnostics(false);
+    parser::Parser part(std::vector<tokens::Token>(tokens.begin() + starts[i],
+                                                   tokens.begin() + end),
+                        diagnostics);
+    EXPECT(part.parse(false));
+    nodes += part.getAST().getNodes().size();
+  }
+  EXPECT(nodes == parser.getAST().getNodes().size());
+  EXPECT(nodes == 200);
+
+  return TEST_RESULT();
+}